@@ -0,0 +1,145 @@
+/*
+ * Minimal benchmarking framework, modeled after Google Benchmark.
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace bench
+{
+/**
+ * Passed to every benchmark function. All work done inside the keepRunning() loop is measured;
+ * setup and teardown outside of the loop are not.
+ *
+ *  UAVCAN_BENCHMARK(Foo)
+ *  {
+ *      Setup setup;
+ *      while (state.keepRunning())
+ *      {
+ *          doSomething();
+ *      }
+ *      state.setItemsProcessed(state.getIterations());
+ *  }
+ */
+class State
+{
+public:
+    typedef std::vector<std::pair<std::string, double> > Counters;
+
+private:
+    const uint64_t max_iterations_;
+    uint64_t iterations_;
+    uint64_t items_processed_;
+    uint64_t bytes_processed_;
+    double started_at_real_;
+    double started_at_cpu_;
+    double elapsed_real_;
+    double elapsed_cpu_;
+    std::string error_;
+    Counters counters_;
+
+    void start();
+    void stop();
+
+public:
+    explicit State(uint64_t max_iterations)
+        : max_iterations_(max_iterations)
+        , iterations_(0)
+        , items_processed_(0)
+        , bytes_processed_(0)
+        , started_at_real_(0)
+        , started_at_cpu_(0)
+        , elapsed_real_(0)
+        , elapsed_cpu_(0)
+    { }
+
+    bool keepRunning()
+    {
+        if (iterations_ == 0)
+        {
+            start();
+        }
+        if (iterations_ < max_iterations_)
+        {
+            iterations_++;
+            return true;
+        }
+        stop();
+        return false;
+    }
+
+    /**
+     * Items are benchmark-specific units of work, e.g. frames or transfers; they are reported per second.
+     */
+    void setItemsProcessed(uint64_t items) { items_processed_ = items; }
+    void setBytesProcessed(uint64_t bytes) { bytes_processed_ = bytes; }
+
+    /**
+     * Marks the benchmark as failed; the results will be reported with the error message.
+     * The benchmark function should return as soon as possible after this call.
+     */
+    void setError(const std::string& message) { error_ = message; }
+
+    /**
+     * Benchmark-specific results that are not rates of the real time, e.g. latencies measured in simulated time.
+     * They are reported as is, in the order of the first call; setting a counter again overwrites its value.
+     */
+    void setCounter(const std::string& name, double value)
+    {
+        for (Counters::iterator it = counters_.begin(); it != counters_.end(); ++it)
+        {
+            if (it->first == name)
+            {
+                it->second = value;
+                return;
+            }
+        }
+        counters_.push_back(std::make_pair(name, value));
+    }
+
+    uint64_t getIterations() const { return iterations_; }
+    uint64_t getItemsProcessed() const { return items_processed_; }
+    uint64_t getBytesProcessed() const { return bytes_processed_; }
+    double getElapsedRealSec() const { return elapsed_real_; }
+    double getElapsedCpuSec() const { return elapsed_cpu_; }
+    const std::string& getError() const { return error_; }
+    const Counters& getCounters() const { return counters_; }
+};
+
+typedef void (*Function)(State&);
+
+/**
+ * Benchmarks register themselves in a global list at static initialization time; see UAVCAN_BENCHMARK().
+ */
+struct Registration
+{
+    const char* const name;
+    const Function function;
+    Registration* const next;
+
+    Registration(const char* arg_name, Function arg_function);
+
+    static Registration* getFirst();
+};
+
+/**
+ * Prevents the compiler from optimizing away a computation whose result is not used otherwise.
+ */
+template <typename T>
+inline void doNotOptimize(const T& value)
+{
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+}
+
+#define UAVCAN_BENCHMARK(name) \
+    static void bench_##name(::bench::State& state); \
+    static ::bench::Registration bench_registration_##name(#name, &bench_##name); \
+    static void bench_##name(::bench::State& state)
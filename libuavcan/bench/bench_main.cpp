@@ -0,0 +1,330 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <uavcan/build_config.hpp>
+#include <uavcan/dynamic_memory.hpp>
+#include "bench.hpp"
+
+namespace bench
+{
+namespace
+{
+
+Registration* first_registration = NULL;
+
+double getTimeSec(clockid_t clock_id)
+{
+    timespec ts = timespec();
+    (void)clock_gettime(clock_id, &ts);
+    return double(ts.tv_sec) + double(ts.tv_nsec) * 1e-9;
+}
+
+struct Options
+{
+    std::string filter;
+    std::string format;
+    double min_time_sec;
+    uint64_t fixed_iterations;
+
+    Options()
+        : format("console")
+        , min_time_sec(0.5)
+        , fixed_iterations(0)
+    { }
+};
+
+struct Result
+{
+    std::string name;
+    uint64_t iterations;
+    double real_time_ns;        ///< Per iteration
+    double cpu_time_ns;         ///< Per iteration
+    double items_per_second;
+    double bytes_per_second;
+    std::string error;
+    State::Counters counters;
+};
+
+Result run(const Registration& reg, const Options& opt)
+{
+    uint64_t iterations = (opt.fixed_iterations > 0) ? opt.fixed_iterations : 1;
+    while (true)
+    {
+        State state(iterations);
+        reg.function(state);
+
+        const bool done = !state.getError().empty() ||
+                          (opt.fixed_iterations > 0) ||
+                          (state.getElapsedRealSec() >= opt.min_time_sec) ||
+                          (iterations >= 1000000000ULL);
+        if (done)
+        {
+            Result res;
+            res.name = reg.name;
+            res.iterations = state.getIterations();
+            const double n = double((res.iterations > 0) ? res.iterations : 1);
+            const double real = state.getElapsedRealSec();
+            res.real_time_ns = real * 1e9 / n;
+            res.cpu_time_ns = state.getElapsedCpuSec() * 1e9 / n;
+            res.items_per_second = (real > 0) ? (double(state.getItemsProcessed()) / real) : 0.0;
+            res.bytes_per_second = (real > 0) ? (double(state.getBytesProcessed()) / real) : 0.0;
+            res.error = state.getError();
+            res.counters = state.getCounters();
+            return res;
+        }
+
+        // Same growth policy as in Google Benchmark: aim slightly above the minimum time, but at most 10x per step
+        double multiplier = opt.min_time_sec * 1.4 / ((state.getElapsedRealSec() > 1e-9) ?
+                                                      state.getElapsedRealSec() : 1e-9);
+        multiplier = (multiplier > 10.0) ? 10.0 : ((multiplier < 2.0) ? 2.0 : multiplier);
+        iterations = uint64_t(double(iterations) * multiplier);
+    }
+}
+
+std::string escapeJson(const std::string& s)
+{
+    std::string out;
+    for (std::size_t i = 0; i < s.length(); i++)
+    {
+        if ((s[i] == '"') || (s[i] == '\\'))
+        {
+            out += '\\';
+        }
+        out += s[i];
+    }
+    return out;
+}
+
+void printConsoleHeader()
+{
+    std::printf("%-40s %14s %14s %12s %14s %14s\n", "Benchmark", "Time, ns", "CPU, ns", "Iterations", "Items/s",
+                "Bytes/s");
+    std::printf("%s\n", std::string(113, '-').c_str());
+}
+
+void printConsole(const Result& res)
+{
+    if (!res.error.empty())
+    {
+        std::printf("%-40s ERROR: %s\n", res.name.c_str(), res.error.c_str());
+        return;
+    }
+    std::printf("%-40s %14.1f %14.1f %12llu %14.0f %14.0f", res.name.c_str(), res.real_time_ns, res.cpu_time_ns,
+                static_cast<unsigned long long>(res.iterations), res.items_per_second, res.bytes_per_second);
+    for (std::size_t i = 0; i < res.counters.size(); i++)
+    {
+        std::printf(" %s=%g", res.counters[i].first.c_str(), res.counters[i].second);
+    }
+    std::printf("\n");
+    std::fflush(stdout);
+}
+
+/**
+ * Every counter gets its own column, which is left empty for the benchmarks that don't report it.
+ */
+void printCsv(const std::vector<Result>& results)
+{
+    std::vector<std::string> counter_names;
+    for (std::size_t i = 0; i < results.size(); i++)
+    {
+        for (std::size_t k = 0; k < results[i].counters.size(); k++)
+        {
+            const std::string& name = results[i].counters[k].first;
+            if (std::find(counter_names.begin(), counter_names.end(), name) == counter_names.end())
+            {
+                counter_names.push_back(name);
+            }
+        }
+    }
+
+    std::printf("name,iterations,real_time,cpu_time,time_unit,items_per_second,bytes_per_second,error");
+    for (std::size_t i = 0; i < counter_names.size(); i++)
+    {
+        std::printf(",%s", counter_names[i].c_str());
+    }
+    std::printf("\n");
+
+    for (std::size_t i = 0; i < results.size(); i++)
+    {
+        const Result& r = results[i];
+        std::printf("%s,%llu,%.3f,%.3f,ns,%.3f,%.3f,\"%s\"", r.name.c_str(),
+                    static_cast<unsigned long long>(r.iterations), r.real_time_ns, r.cpu_time_ns,
+                    r.items_per_second, r.bytes_per_second, r.error.c_str());
+        for (std::size_t k = 0; k < counter_names.size(); k++)
+        {
+            std::printf(",");
+            for (std::size_t c = 0; c < r.counters.size(); c++)
+            {
+                if (r.counters[c].first == counter_names[k])
+                {
+                    std::printf("%.3f", r.counters[c].second);
+                }
+            }
+        }
+        std::printf("\n");
+    }
+}
+
+/**
+ * The layout follows the JSON output of Google Benchmark, so that the existing comparison tools can be used.
+ */
+void printJson(const std::vector<Result>& results, const Options& opt)
+{
+    std::printf("{\n  \"context\": {\n");
+    std::printf("    \"library\": \"libuavcan\",\n");
+    std::printf("    \"cpp_version\": \"%s\",\n", (UAVCAN_CPP_VERSION == UAVCAN_CPP11) ? "C++11" : "C++03");
+    std::printf("    \"mem_pool_block_size\": %u,\n", unsigned(uavcan::MemPoolBlockSize));
+    std::printf("    \"min_time\": %.3f\n", opt.min_time_sec);
+    std::printf("  },\n  \"benchmarks\": [");
+    for (std::size_t i = 0; i < results.size(); i++)
+    {
+        const Result& r = results[i];
+        std::printf("%s\n    {\n", (i > 0) ? "," : "");
+        std::printf("      \"name\": \"%s\",\n", escapeJson(r.name).c_str());
+        if (!r.error.empty())
+        {
+            std::printf("      \"error_occurred\": true,\n");
+            std::printf("      \"error_message\": \"%s\",\n", escapeJson(r.error).c_str());
+        }
+        std::printf("      \"iterations\": %llu,\n", static_cast<unsigned long long>(r.iterations));
+        std::printf("      \"real_time\": %.3f,\n", r.real_time_ns);
+        std::printf("      \"cpu_time\": %.3f,\n", r.cpu_time_ns);
+        std::printf("      \"time_unit\": \"ns\",\n");
+        std::printf("      \"items_per_second\": %.3f,\n", r.items_per_second);
+        std::printf("      \"bytes_per_second\": %.3f", r.bytes_per_second);
+        // Counters are top-level fields, as in Google Benchmark
+        for (std::size_t k = 0; k < r.counters.size(); k++)
+        {
+            std::printf(",\n      \"%s\": %.3f", escapeJson(r.counters[k].first).c_str(), r.counters[k].second);
+        }
+        std::printf("\n");
+        std::printf("    }");
+    }
+    std::printf("\n  ]\n}\n");
+}
+
+bool parseOptions(int argc, char** argv, Options& out)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        const std::string::size_type eq = arg.find('=');
+        const std::string key = arg.substr(0, eq);
+        const std::string value = (eq == std::string::npos) ? std::string() : arg.substr(eq + 1);
+
+        if (key == "--filter")
+        {
+            out.filter = value;
+        }
+        else if ((key == "--format") && ((value == "console") || (value == "json") || (value == "csv")))
+        {
+            out.format = value;
+        }
+        else if ((key == "--min-time") && !value.empty())
+        {
+            out.min_time_sec = std::atof(value.c_str());
+        }
+        else if ((key == "--iterations") && !value.empty())
+        {
+            out.fixed_iterations = std::strtoull(value.c_str(), NULL, 10);
+        }
+        else
+        {
+            std::fprintf(stderr,
+                         "Usage: %s [--filter=<substring>] [--format=console|json|csv] [--min-time=<sec>] "
+                         "[--iterations=<n>]\n", argv[0]);
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+void State::start()
+{
+    started_at_real_ = getTimeSec(CLOCK_MONOTONIC);
+    started_at_cpu_ = getTimeSec(CLOCK_PROCESS_CPUTIME_ID);
+}
+
+void State::stop()
+{
+    elapsed_real_ = getTimeSec(CLOCK_MONOTONIC) - started_at_real_;
+    elapsed_cpu_ = getTimeSec(CLOCK_PROCESS_CPUTIME_ID) - started_at_cpu_;
+}
+
+Registration::Registration(const char* arg_name, Function arg_function)
+    : name(arg_name)
+    , function(arg_function)
+    , next(first_registration)
+{
+    first_registration = this;
+}
+
+Registration* Registration::getFirst() { return first_registration; }
+
+}
+
+int main(int argc, char** argv)
+{
+    bench::Options opt;
+    if (!bench::parseOptions(argc, argv, opt))
+    {
+        return 1;
+    }
+
+    // Registrations are prepended, so the list is reversed to run the benchmarks in a stable, sorted order
+    std::vector<const bench::Registration*> regs;
+    for (const bench::Registration* r = bench::Registration::getFirst(); r != NULL; r = r->next)
+    {
+        if (opt.filter.empty() || (std::string(r->name).find(opt.filter) != std::string::npos))
+        {
+            regs.push_back(r);
+        }
+    }
+    for (std::size_t i = 1; i < regs.size(); i++)
+    {
+        for (std::size_t k = i; (k > 0) && (std::strcmp(regs[k - 1]->name, regs[k]->name) > 0); k--)
+        {
+            const bench::Registration* const tmp = regs[k];
+            regs[k] = regs[k - 1];
+            regs[k - 1] = tmp;
+        }
+    }
+
+    const bool console = opt.format == "console";
+    if (console)
+    {
+        bench::printConsoleHeader();
+    }
+
+    std::vector<bench::Result> results;
+    bool failed = false;
+    for (std::size_t i = 0; i < regs.size(); i++)
+    {
+        results.push_back(bench::run(*regs[i], opt));
+        failed = failed || !results.back().error.empty();
+        if (console)
+        {
+            bench::printConsole(results.back());
+        }
+    }
+
+    if (opt.format == "json")
+    {
+        bench::printJson(results, opt);
+    }
+    else if (opt.format == "csv")
+    {
+        bench::printCsv(results);
+    }
+    return failed ? 1 : 0;
+}
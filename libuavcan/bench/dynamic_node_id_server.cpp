@@ -0,0 +1,475 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <cstdlib>
+#include <map>
+#include <vector>
+#include <uavcan/protocol/dynamic_node_id_server/distributed.hpp>
+#include <uavcan/protocol/dynamic_node_id_client.hpp>
+#include "bench.hpp"
+#include "virtual_bus.hpp"
+
+/*
+ * Simulation of the distributed dynamic node ID allocator: a cluster of Raft servers and a number of allocatees
+ * share one virtual bus in simulated time. All metrics except the items per second are measured in simulated time,
+ * so they don't depend on the speed of the host; the real time shows how expensive the simulation itself is.
+ */
+namespace
+{
+
+using uavcan::dynamic_node_id_server::IStorageBackend;
+using uavcan::dynamic_node_id_server::IEventTracer;
+using uavcan::dynamic_node_id_server::DistributedServer;
+
+typedef uavcan::protocol::dynamic_node_id::server::AppendEntries AppendEntries;
+
+const uavcan::uint64_t SimulationStepUSec = 1000;
+
+/**
+ * Memory storage that blocks the calling node for the specified time on every write, i.e. on every committed
+ * batch and every set() call outside of a batch, which is how a flash or file system backend behaves.
+ * Since the time is simulated, blocking means advancing the clock, so the other nodes see the delay as well.
+ */
+class SimulatedStorageBackend : public IStorageBackend
+{
+    typedef std::map<String, String> Container;
+    Container container_;
+
+    const SystemClockMock& clock_;
+    const uavcan::uint64_t write_delay_usec_;
+    bool in_batch_;
+
+    void sync() const { clock_.advance(write_delay_usec_); }
+
+public:
+    SimulatedStorageBackend(const SystemClockMock& clock, uavcan::uint64_t write_delay_usec)
+        : clock_(clock)
+        , write_delay_usec_(write_delay_usec)
+        , in_batch_(false)
+    { }
+
+    virtual String get(const String& key) const
+    {
+        const Container::const_iterator it = container_.find(key);
+        return (it == container_.end()) ? String() : it->second;
+    }
+
+    virtual void set(const String& key, const String& value)
+    {
+        if (value.empty())
+        {
+            container_.erase(key);
+        }
+        else
+        {
+            container_[key] = value;
+        }
+        if (!in_batch_)
+        {
+            sync();
+        }
+    }
+
+    virtual void beginBatch() { in_batch_ = true; }
+
+    virtual int commitBatch()
+    {
+        in_batch_ = false;
+        sync();
+        return 0;
+    }
+};
+
+/**
+ * Measures the commit latency: from the moment an entry is appended to the log of the leader, which always
+ * happens before the followers get it, until the leader commits it. The tracer is shared by all servers.
+ */
+class CommitLatencyTracer : public IEventTracer
+{
+    typedef std::map<uavcan::int64_t, uavcan::uint64_t> AppendTimes;
+
+    const SystemClockMock& clock_;
+    AppendTimes append_times_;      ///< Log index --> monotonic time of the first append, usec
+    uavcan::uint64_t latency_sum_usec_;
+    uavcan::uint64_t latency_max_usec_;
+    unsigned num_commits_;
+
+    virtual void onEvent(uavcan::dynamic_node_id_server::TraceCode event_code, uavcan::int64_t event_argument)
+    {
+        if (event_code == uavcan::dynamic_node_id_server::TraceRaftLogAppend)
+        {
+            (void)append_times_.insert(std::make_pair(event_argument, clock_.monotonic));
+        }
+        else if (event_code == uavcan::dynamic_node_id_server::TraceRaftLogRemove)
+        {
+            // Uncommitted entries removed by a follower will be appended again by the new leader
+            append_times_.erase(append_times_.upper_bound(event_argument), append_times_.end());
+        }
+        else if (event_code == uavcan::dynamic_node_id_server::TraceRaftNewEntryCommitted)
+        {
+            const AppendTimes::iterator it = append_times_.find(event_argument);
+            if (it != append_times_.end())
+            {
+                const uavcan::uint64_t latency = clock_.monotonic - it->second;
+                latency_sum_usec_ += latency;
+                latency_max_usec_ = (latency > latency_max_usec_) ? latency : latency_max_usec_;
+                num_commits_++;
+                AppendTimes::iterator next = it;
+                ++next;
+                append_times_.erase(append_times_.begin(), next);
+            }
+        }
+        else
+        {
+            ;   // Not interesting
+        }
+    }
+
+public:
+    explicit CommitLatencyTracer(const SystemClockMock& clock)
+        : clock_(clock)
+    {
+        resetStats();
+    }
+
+    void resetStats()
+    {
+        latency_sum_usec_ = 0;
+        latency_max_usec_ = 0;
+        num_commits_ = 0;
+    }
+
+    unsigned getNumCommits() const { return num_commits_; }
+    double getMeanLatencyMSec() const
+    {
+        return (num_commits_ > 0) ? (double(latency_sum_usec_) / double(num_commits_) / 1000.0) : 0.0;
+    }
+    double getMaxLatencyMSec() const { return double(latency_max_usec_) / 1000.0; }
+};
+
+struct ServerEnvironment
+{
+    bench::VirtualCanDriver driver;
+    bench::VirtualNode<4096> node;
+    SimulatedStorageBackend storage;
+    DistributedServer* server;
+
+    ServerEnvironment(SystemClockMock& clock, uavcan::NodeID node_id, uavcan::uint64_t storage_delay_usec)
+        : driver(clock)
+        , node(driver, clock, node_id)
+        , storage(clock, storage_delay_usec)
+        , server(NULL)
+    { }
+
+    ~ServerEnvironment() { kill(); }
+
+    void kill()
+    {
+        delete server;
+        server = NULL;
+    }
+
+    bool isLeader() const { return (server != NULL) && server->getRaftCore().isLeader(); }
+};
+
+struct ClientEnvironment
+{
+    bench::VirtualCanDriver driver;
+    bench::VirtualNode<> node;
+    uavcan::DynamicNodeIDClient client;
+    uavcan::MonotonicTime completed_at;
+
+    explicit ClientEnvironment(SystemClockMock& clock)
+        : driver(clock)
+        , node(driver, clock, uavcan::NodeID())
+        , client(node)
+    { }
+};
+
+struct Metrics
+{
+    double allocations_per_sec;
+    double mean_allocation_time_ms;
+    double mean_commit_latency_ms;
+    double max_commit_latency_ms;
+    double failover_time_ms;
+
+    Metrics()
+        : allocations_per_sec(0)
+        , mean_allocation_time_ms(0)
+        , mean_commit_latency_ms(0)
+        , max_commit_latency_ms(0)
+        , failover_time_ms(0)
+    { }
+};
+
+/**
+ * One run of the scenario:
+ *  1. The cluster is started and elects its leader.
+ *  2. All clients are started at once, the run lasts until all of them are allocated.
+ *  3. The leader is killed, the run lasts until the remaining servers elect the new one.
+ */
+class ClusterSimulation
+{
+    SystemClockMock clock_;
+    CommitLatencyTracer tracer_;
+    std::vector<ServerEnvironment*> servers_;
+    std::vector<ClientEnvironment*> clients_;
+    std::vector<bench::VirtualCanDriver*> drivers_;
+    std::vector<uavcan::INode*> nodes_;
+
+    void spinOnce()
+    {
+        for (std::size_t i = 0; i < nodes_.size(); i++)
+        {
+            (void)nodes_[i]->spinOnce();
+        }
+        clock_.advance(SimulationStepUSec);
+    }
+
+    int findOnlyLeader() const
+    {
+        int leader = -1;
+        for (std::size_t i = 0; i < servers_.size(); i++)
+        {
+            if (servers_[i]->isLeader())
+            {
+                if (leader >= 0)
+                {
+                    return -1;
+                }
+                leader = int(i);
+            }
+        }
+        return leader;
+    }
+
+    bool isLeaderUpToDate() const
+    {
+        const int leader = findOnlyLeader();
+        if (leader < 0)
+        {
+            return false;
+        }
+        const uavcan::dynamic_node_id_server::distributed::RaftCore& raft =
+            servers_[unsigned(leader)]->server->getRaftCore();
+        return raft.getCommitIndex() == raft.getPersistentState().getLog().getLastIndex();
+    }
+
+    unsigned countAllocatedClients()
+    {
+        unsigned num_allocated = 0;
+        for (std::size_t i = 0; i < clients_.size(); i++)
+        {
+            if (clients_[i]->client.isAllocationComplete())
+            {
+                if (clients_[i]->completed_at.isZero())
+                {
+                    clients_[i]->completed_at = clock_.getMonotonic();
+                }
+                num_allocated++;
+            }
+        }
+        return num_allocated;
+    }
+
+    void connect(bench::VirtualCanDriver& driver, uavcan::INode& node)
+    {
+        for (std::size_t i = 0; i < drivers_.size(); i++)
+        {
+            driver.connect(*drivers_[i]);
+        }
+        drivers_.push_back(&driver);
+        nodes_.push_back(&node);
+    }
+
+public:
+    ClusterSimulation(unsigned cluster_size, unsigned num_clients, uavcan::uint64_t storage_delay_usec)
+        : clock_(1000000)
+        , tracer_(clock_)
+    {
+        for (unsigned i = 0; i < cluster_size; i++)
+        {
+            servers_.push_back(new ServerEnvironment(clock_, uavcan::NodeID(uavcan::uint8_t(i + 1)),
+                                                     storage_delay_usec));
+            connect(servers_.back()->driver, servers_.back()->node);
+        }
+        for (unsigned i = 0; i < num_clients; i++)
+        {
+            clients_.push_back(new ClientEnvironment(clock_));
+            connect(clients_.back()->driver, clients_.back()->node);
+        }
+    }
+
+    ~ClusterSimulation()
+    {
+        for (std::size_t i = 0; i < servers_.size(); i++)
+        {
+            delete servers_[i];
+        }
+        for (std::size_t i = 0; i < clients_.size(); i++)
+        {
+            delete clients_[i];
+        }
+    }
+
+    /**
+     * Returns an error message, or NULL if the scenario has been completed successfully.
+     */
+    const char* run(Metrics& out_metrics)
+    {
+        // Same sequence of random timeouts in every run
+        std::srand(42);
+
+        const uavcan::MonotonicDuration max_election_time =
+            uavcan::MonotonicDuration::fromMSec(AppendEntries::Request::DEFAULT_MAX_ELECTION_TIMEOUT_MS * 4 + 1000);
+        const uavcan::MonotonicDuration max_allocation_time = uavcan::MonotonicDuration::fromMSec(60000);
+
+        /*
+         * Election
+         */
+        for (std::size_t i = 0; i < servers_.size(); i++)
+        {
+            uavcan::dynamic_node_id_server::UniqueID unique_id;
+            unique_id[0] = 0xAA;
+            unique_id[1] = uavcan::uint8_t(i + 1);
+            servers_[i]->server = new DistributedServer(servers_[i]->node, servers_[i]->storage, tracer_);
+            if (servers_[i]->server->init(unique_id, uavcan::uint8_t(servers_.size())) < 0)
+            {
+                return "Server initialization failure";
+            }
+        }
+
+        const uavcan::MonotonicTime started_at = clock_.getMonotonic();
+        while (!isLeaderUpToDate())
+        {
+            if ((clock_.getMonotonic() - started_at) > max_election_time)
+            {
+                return "Leader was not elected";
+            }
+            spinOnce();
+        }
+
+        /*
+         * Allocation
+         */
+        tracer_.resetStats();
+        for (std::size_t i = 0; i < clients_.size(); i++)
+        {
+            uavcan::DynamicNodeIDClient::UniqueID unique_id;
+            unique_id[0] = 0xCC;
+            unique_id[1] = uavcan::uint8_t(i + 1);
+            if (clients_[i]->client.start(unique_id) < 0)
+            {
+                return "Client initialization failure";
+            }
+        }
+
+        const uavcan::MonotonicTime allocation_started_at = clock_.getMonotonic();
+        while (countAllocatedClients() < clients_.size())
+        {
+            if ((clock_.getMonotonic() - allocation_started_at) > max_allocation_time)
+            {
+                return "Allocation timed out";
+            }
+            spinOnce();
+        }
+        const double allocation_time_sec =
+            double((clock_.getMonotonic() - allocation_started_at).toUSec()) * 1e-6;
+
+        double allocation_time_sum_ms = 0;
+        for (std::size_t i = 0; i < clients_.size(); i++)
+        {
+            allocation_time_sum_ms += double((clients_[i]->completed_at - allocation_started_at).toUSec()) * 1e-3;
+        }
+
+        out_metrics.allocations_per_sec = double(clients_.size()) / allocation_time_sec;
+        out_metrics.mean_allocation_time_ms = allocation_time_sum_ms / double(clients_.size());
+        out_metrics.mean_commit_latency_ms = tracer_.getMeanLatencyMSec();
+        out_metrics.max_commit_latency_ms = tracer_.getMaxLatencyMSec();
+
+        /*
+         * Failover
+         */
+        const int old_leader = findOnlyLeader();
+        if (old_leader < 0)
+        {
+            return "Leader was lost during allocation";
+        }
+        servers_[unsigned(old_leader)]->kill();
+
+        const uavcan::MonotonicTime killed_at = clock_.getMonotonic();
+        while (findOnlyLeader() < 0)
+        {
+            if ((clock_.getMonotonic() - killed_at) > max_election_time)
+            {
+                return "New leader was not elected";
+            }
+            spinOnce();
+        }
+        out_metrics.failover_time_ms = double((clock_.getMonotonic() - killed_at).toUSec()) * 1e-3;
+
+        return NULL;
+    }
+};
+
+void runCluster(bench::State& state, unsigned cluster_size, unsigned num_clients, uavcan::uint64_t storage_delay_usec)
+{
+    Metrics sum;
+    while (state.keepRunning())
+    {
+        ClusterSimulation simulation(cluster_size, num_clients, storage_delay_usec);
+        Metrics metrics;
+        const char* const error = simulation.run(metrics);
+        if (error != NULL)
+        {
+            state.setError(error);
+            return;
+        }
+        sum.allocations_per_sec += metrics.allocations_per_sec;
+        sum.mean_allocation_time_ms += metrics.mean_allocation_time_ms;
+        sum.mean_commit_latency_ms += metrics.mean_commit_latency_ms;
+        sum.max_commit_latency_ms = (metrics.max_commit_latency_ms > sum.max_commit_latency_ms) ?
+                                    metrics.max_commit_latency_ms : sum.max_commit_latency_ms;
+        sum.failover_time_ms += metrics.failover_time_ms;
+    }
+
+    const double n = double(state.getIterations());
+    state.setItemsProcessed(state.getIterations() * num_clients);
+    state.setCounter("alloc_per_sec", sum.allocations_per_sec / n);
+    state.setCounter("alloc_time_ms", sum.mean_allocation_time_ms / n);
+    state.setCounter("commit_latency_ms", sum.mean_commit_latency_ms / n);
+    state.setCounter("max_commit_latency_ms", sum.max_commit_latency_ms);
+    state.setCounter("failover_ms", sum.failover_time_ms / n);
+}
+
+}
+
+/*
+ * Items are allocations; storage delay is per write of the backend.
+ */
+UAVCAN_BENCHMARK(RaftCluster3Servers16Clients)
+{
+    runCluster(state, 3, 16, 0);
+}
+
+UAVCAN_BENCHMARK(RaftCluster5Servers16Clients)
+{
+    runCluster(state, 5, 16, 0);
+}
+
+UAVCAN_BENCHMARK(RaftCluster3Servers16ClientsSlowStorage)
+{
+    runCluster(state, 3, 16, 20000);
+}
+
+UAVCAN_BENCHMARK(RaftCluster5Servers16ClientsSlowStorage)
+{
+    runCluster(state, 5, 16, 20000);
+}
+
+UAVCAN_BENCHMARK(RaftCluster3Servers64Clients)
+{
+    runCluster(state, 3, 64, 0);
+}
@@ -0,0 +1,225 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <vector>
+#include <uavcan/transport/frame.hpp>
+#include "bench.hpp"
+#include "virtual_bus.hpp"
+
+namespace
+{
+/**
+ * The frame parser as it was before the lookup tables were introduced: the fields are decoded with branches,
+ * then the frame is validated with a series of checks, exactly like Frame::isValid() does.
+ * It is kept here as the baseline for the parser benchmarks.
+ */
+struct ReferenceFrame
+{
+    uavcan::uint8_t payload[uavcan::CanFrame::MaxDataLen];
+    uavcan::uint8_t priority;
+    uavcan::TransferType transfer_type;
+    uavcan::uint16_t data_type_id;
+    uavcan::uint8_t payload_len;
+    uavcan::uint8_t src_node_id;
+    uavcan::uint8_t dst_node_id;
+    uavcan::uint8_t transfer_id;
+    bool start_of_transfer;
+    bool end_of_transfer;
+    bool toggle;
+
+    bool isValid() const
+    {
+        if (start_of_transfer && toggle)
+        {
+            return false;
+        }
+        if ((src_node_id != 0) && (src_node_id == dst_node_id))
+        {
+            return false;
+        }
+        if ((transfer_type == uavcan::TransferTypeMessageBroadcast) != (dst_node_id == 0))
+        {
+            return false;
+        }
+        if ((src_node_id == 0) &&
+            (!start_of_transfer || !end_of_transfer || (transfer_type != uavcan::TransferTypeMessageBroadcast)))
+        {
+            return false;
+        }
+        if (payload_len > (uavcan::CanFrame::MaxDataLen - 1))
+        {
+            return false;
+        }
+        const uavcan::DataTypeKind kind = uavcan::getDataTypeKindForTransferType(transfer_type);
+        if (!uavcan::DataTypeID(data_type_id).isValidForDataTypeKind(kind))
+        {
+            return false;
+        }
+        return priority <= uavcan::TransferPriority::NumericallyMax;
+    }
+
+    bool parse(const uavcan::CanFrame& can_frame)
+    {
+        if (can_frame.isErrorFrame() || can_frame.isRemoteTransmissionRequest() || !can_frame.isExtended())
+        {
+            return false;
+        }
+        if ((can_frame.dlc > sizeof(can_frame.data)) || (can_frame.dlc < 1))
+        {
+            return false;
+        }
+
+        const uavcan::uint32_t id = can_frame.id & uavcan::CanFrame::MaskExtID;
+
+        priority = uavcan::uint8_t((id >> 24) & 0x1FU);
+        src_node_id = uavcan::uint8_t(id & 0x7FU);
+
+        const bool service_not_message = ((id >> 7) & 1U) != 0U;
+        if (service_not_message)
+        {
+            const bool request_not_response = ((id >> 15) & 1U) != 0U;
+            transfer_type = request_not_response ? uavcan::TransferTypeServiceRequest :
+                                                   uavcan::TransferTypeServiceResponse;
+            dst_node_id = uavcan::uint8_t((id >> 8) & 0x7FU);
+            data_type_id = uavcan::uint16_t((id >> 16) & 0xFFU);
+        }
+        else
+        {
+            transfer_type = uavcan::TransferTypeMessageBroadcast;
+            dst_node_id = 0;
+            data_type_id = uavcan::uint16_t((id >> 8) & 0xFFFFU);
+            if (src_node_id == 0)
+            {
+                data_type_id = uavcan::uint16_t(data_type_id & 3U);
+            }
+        }
+
+        payload_len = uavcan::uint8_t(can_frame.dlc - 1U);
+        (void)uavcan::copy(can_frame.data, can_frame.data + payload_len, payload);
+
+        const uavcan::uint8_t tail = can_frame.data[can_frame.dlc - 1U];
+        start_of_transfer = (tail & (1U << 7)) != 0;
+        end_of_transfer   = (tail & (1U << 6)) != 0;
+        toggle            = (tail & (1U << 5)) != 0;
+        transfer_id = uavcan::uint8_t(tail & uavcan::TransferID::Max);
+
+        return isValid();
+    }
+};
+
+enum TrafficMix
+{
+    TrafficMixMessages,     ///< Single frame messages from many nodes
+    TrafficMixRealistic     ///< Messages, multi-frame transfers, services, anonymous and invalid frames
+};
+
+/**
+ * The traffic is generated deterministically, so that every run measures the same frames.
+ */
+std::vector<uavcan::CanFrame> makeTraffic(TrafficMix mix)
+{
+    static const unsigned NumNodes = 32;
+    const uavcan::DataTypeDescriptor msg_type = bench::makeDataType(uavcan::DataTypeKindMessage, 1030);
+    const uavcan::DataTypeDescriptor srv_type = bench::makeDataType(uavcan::DataTypeKindService, 11);
+
+    uavcan::uint8_t payload[64];
+    for (unsigned i = 0; i < sizeof(payload); i++)
+    {
+        payload[i] = uavcan::uint8_t(i * 37U);
+    }
+
+    std::vector<uavcan::CanFrame> traffic;
+    for (unsigned i = 0; i < 256; i++)
+    {
+        const uavcan::NodeID src(uavcan::uint8_t(1 + (i % NumNodes)));
+        const uavcan::NodeID dst(uavcan::uint8_t(1 + ((i + 1) % NumNodes)));
+        const uavcan::TransferID tid = uavcan::TransferID(uavcan::uint8_t(i & uavcan::TransferID::Max));
+        std::vector<uavcan::CanFrame> frames;
+
+        const unsigned kind = (mix == TrafficMixMessages) ? 0U : (i % 20U);
+        if (kind < 12)          // 60% single frame messages
+        {
+            frames = bench::makeTransferFrames(msg_type, uavcan::TransferTypeMessageBroadcast, src,
+                                               uavcan::NodeID::Broadcast, tid, payload, 7);
+        }
+        else if (kind < 15)     // 15% multi-frame messages
+        {
+            frames = bench::makeTransferFrames(msg_type, uavcan::TransferTypeMessageBroadcast, src,
+                                               uavcan::NodeID::Broadcast, tid, payload, 40);
+        }
+        else if (kind < 18)     // 15% service requests and responses
+        {
+            frames = bench::makeTransferFrames(srv_type, (kind == 16) ? uavcan::TransferTypeServiceResponse :
+                                                                        uavcan::TransferTypeServiceRequest,
+                                               src, dst, tid, payload, 5);
+        }
+        else if (kind < 19)     // 5% anonymous messages
+        {
+            frames = bench::makeTransferFrames(bench::makeDataType(uavcan::DataTypeKindMessage, 1),
+                                               uavcan::TransferTypeMessageBroadcast, uavcan::NodeID::Broadcast,
+                                               uavcan::NodeID::Broadcast, tid, payload, 6);
+        }
+        else                    // 5% invalid: a service frame addressed to the sender itself
+        {
+            frames = bench::makeTransferFrames(srv_type, uavcan::TransferTypeServiceRequest, src, dst, tid,
+                                               payload, 5);
+            frames[0].id = (frames[0].id & ~(0x7FU << 8)) | (uavcan::uint32_t(src.get()) << 8);
+        }
+        traffic.insert(traffic.end(), frames.begin(), frames.end());
+    }
+    return traffic;
+}
+
+template <typename FrameType>
+void runFrameParse(bench::State& state, TrafficMix mix)
+{
+    const std::vector<uavcan::CanFrame> traffic = makeTraffic(mix);
+
+    // Both parsers must agree on every frame, otherwise the comparison is meaningless
+    for (std::vector<uavcan::CanFrame>::const_iterator it = traffic.begin(); it != traffic.end(); ++it)
+    {
+        uavcan::Frame frame;
+        ReferenceFrame reference;
+        if (frame.parse(*it) != reference.parse(*it))
+        {
+            state.setError("The parsers disagree");
+            return;
+        }
+    }
+
+    FrameType frame;
+    uavcan::uint64_t num_valid = 0;
+    while (state.keepRunning())
+    {
+        for (std::vector<uavcan::CanFrame>::const_iterator it = traffic.begin(); it != traffic.end(); ++it)
+        {
+            num_valid += frame.parse(*it) ? 1U : 0U;
+        }
+        bench::doNotOptimize(frame);
+    }
+    bench::doNotOptimize(num_valid);
+    state.setItemsProcessed(state.getIterations() * traffic.size());
+}
+
+}
+
+UAVCAN_BENCHMARK(FrameParseMessages)
+{
+    runFrameParse<uavcan::Frame>(state, TrafficMixMessages);
+}
+
+UAVCAN_BENCHMARK(FrameParseMessagesReference)
+{
+    runFrameParse<ReferenceFrame>(state, TrafficMixMessages);
+}
+
+UAVCAN_BENCHMARK(FrameParseRealistic)
+{
+    runFrameParse<uavcan::Frame>(state, TrafficMixRealistic);
+}
+
+UAVCAN_BENCHMARK(FrameParseRealisticReference)
+{
+    runFrameParse<ReferenceFrame>(state, TrafficMixRealistic);
+}
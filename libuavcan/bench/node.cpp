@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <vector>
+#include <uavcan/node/publisher.hpp>
+#include <uavcan/node/subscriber.hpp>
+#include <uavcan/transport/transfer_buffer.hpp>
+#include <uavcan/protocol/debug/LogMessage.hpp>
+#include "bench.hpp"
+#include "virtual_bus.hpp"
+
+namespace
+{
+
+typedef uavcan::protocol::debug::LogMessage Message;
+
+const char* const MessageText = "The quick brown fox jumps over the lazy dog, repeatedly.";
+
+void initMessage(Message& msg)
+{
+    msg.level.value = uavcan::protocol::debug::LogLevel::INFO;
+    msg.source = "bench";
+    msg.text = MessageText;
+}
+
+struct MessageCounter
+{
+    uavcan::uint64_t* counter;
+
+    MessageCounter() : counter(NULL) { }
+    explicit MessageCounter(uavcan::uint64_t* arg_counter) : counter(arg_counter) { }
+
+    void operator()(const Message&) const
+    {
+        if (counter != NULL)
+        {
+            (*counter)++;
+        }
+    }
+};
+
+struct NodeEnvironment
+{
+    bench::VirtualCanDriver driver;
+    bench::VirtualNode<> node;
+    uavcan::Publisher<Message> publisher;
+    uavcan::Subscriber<Message, MessageCounter> subscriber;
+    uavcan::uint64_t num_received;
+
+    NodeEnvironment(SystemClockMock& clock, uavcan::NodeID node_id)
+        : driver(clock)
+        , node(driver, clock, node_id)
+        , publisher(node)
+        , subscriber(node)
+        , num_received(0)
+    { }
+
+    int init()
+    {
+        const int res = publisher.init();
+        if (res < 0)
+        {
+            return res;
+        }
+        return subscriber.start(MessageCounter(&num_received));
+    }
+};
+
+/**
+ * Every node broadcasts one multi-frame message per iteration, which is then received by all other nodes.
+ */
+void runNetwork(bench::State& state, unsigned num_nodes)
+{
+    SystemClockMock clock(1000000);
+    std::vector<NodeEnvironment*> nodes;
+    for (unsigned i = 0; i < num_nodes; i++)
+    {
+        nodes.push_back(new NodeEnvironment(clock, uavcan::NodeID(uavcan::uint8_t(i + 1))));
+        for (unsigned k = 0; k < i; k++)
+        {
+            nodes[i]->driver.connect(nodes[k]->driver);
+        }
+    }
+
+    bool ok = true;
+    for (unsigned i = 0; i < num_nodes; i++)
+    {
+        ok = ok && (nodes[i]->init() >= 0);
+    }
+
+    Message msg;
+    initMessage(msg);
+
+    while (ok && state.keepRunning())
+    {
+        for (unsigned i = 0; i < num_nodes; i++)
+        {
+            (void)nodes[i]->publisher.broadcast(msg);
+        }
+        for (unsigned i = 0; i < num_nodes; i++)
+        {
+            (void)nodes[i]->node.spinOnce();
+        }
+        clock.advance(1000);
+    }
+
+    uavcan::uint64_t num_received = 0;
+    uavcan::uint64_t num_failures = 0;
+    for (unsigned i = 0; i < num_nodes; i++)
+    {
+        num_received += nodes[i]->num_received;
+        num_failures += nodes[i]->node.getInternalFailureCount();
+        delete nodes[i];
+    }
+
+    if (!ok)
+    {
+        state.setError("Initialization failure");
+    }
+    else if ((num_failures > 0) || (num_received != state.getIterations() * num_nodes * (num_nodes - 1)))
+    {
+        state.setError("Some messages were lost");
+    }
+    state.setItemsProcessed(num_received);
+}
+
+}
+
+/**
+ * Includes the overhead of the generated code, which is shared by all DSDL definitions.
+ */
+UAVCAN_BENCHMARK(DsdlEncodeDecode)
+{
+    Message msg;
+    initMessage(msg);
+    Message decoded;
+
+    while (state.keepRunning())
+    {
+        uavcan::StaticTransferBuffer<128> buf;
+        {
+            uavcan::BitStream bs(buf);
+            uavcan::ScalarCodec codec(bs);
+            if (Message::encode(msg, codec) <= 0)
+            {
+                state.setError("Encoding failed");
+                return;
+            }
+        }
+        {
+            uavcan::BitStream bs(buf);
+            uavcan::ScalarCodec codec(bs);
+            if (Message::decode(decoded, codec) <= 0)
+            {
+                state.setError("Decoding failed");
+                return;
+            }
+        }
+        bench::doNotOptimize(decoded);
+    }
+    if (!(decoded == msg))
+    {
+        state.setError("Decoded message does not match");
+    }
+    state.setItemsProcessed(state.getIterations());
+}
+
+UAVCAN_BENCHMARK(Network2Nodes)
+{
+    runNetwork(state, 2);
+}
+
+UAVCAN_BENCHMARK(Network8Nodes)
+{
+    runNetwork(state, 8);
+}
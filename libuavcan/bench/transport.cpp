@@ -0,0 +1,216 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <uavcan/transport/can_io.hpp>
+#include <uavcan/transport/dispatcher.hpp>
+#include <uavcan/transport/transfer_listener.hpp>
+#include <uavcan/transport/transfer_sender.hpp>
+#include "bench.hpp"
+#include "virtual_bus.hpp"
+
+namespace
+{
+
+class CountingListener : public uavcan::TransferListener
+{
+    uavcan::uint64_t num_transfers_;
+
+    virtual void handleIncomingTransfer(uavcan::IncomingTransfer& transfer)
+    {
+        num_transfers_++;
+        transfer.release();
+    }
+
+public:
+    CountingListener(uavcan::TransferPerfCounter& perf, const uavcan::DataTypeDescriptor& data_type,
+                     uavcan::IPoolAllocator& allocator)
+        : uavcan::TransferListener(perf, data_type, 256, allocator)
+        , num_transfers_(0)
+    { }
+
+    uavcan::uint64_t getNumTransfers() const { return num_transfers_; }
+};
+
+const unsigned NumTxQueueFrames = 32;
+
+void runTxQueue(bench::State& state, uavcan::CanTxQueue::Mode mode)
+{
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * NumTxQueueFrames * 2, uavcan::MemPoolBlockSize> pool;
+    SystemClockMock clock(1000000);
+    uavcan::CanTxQueue queue(pool, clock, NumTxQueueFrames * 2);
+    if (queue.setMode(mode) < 0)
+    {
+        state.setError("Could not set the queue mode");
+        return;
+    }
+
+    const uavcan::uint8_t data[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+    const uavcan::MonotonicTime deadline = clock.getMonotonic() + uavcan::MonotonicDuration::fromMSec(100);
+
+    while (state.keepRunning())
+    {
+        for (unsigned i = 0; i < NumTxQueueFrames; i++)
+        {
+            // CAN IDs are scattered so that the frames don't arrive in priority order
+            const uavcan::CanFrame frame(((i * 7919U) & 0x1FFFFFFFU) | uavcan::CanFrame::FlagEFF, data, 8);
+            queue.push(frame, deadline, (i & 1U) ? uavcan::CanTxQueue::Volatile : uavcan::CanTxQueue::Persistent,
+                       0);
+        }
+        while (true)
+        {
+            uavcan::CanTxQueue::Entry* entry = queue.peek();
+            if (entry == NULL)
+            {
+                break;
+            }
+            queue.remove(entry);
+        }
+    }
+    if (pool.getNumUsedBlocks() != 0)
+    {
+        state.setError("Memory leak");
+    }
+    state.setItemsProcessed(state.getIterations() * NumTxQueueFrames);
+}
+
+/**
+ * Feeds transfers from many nodes into the dispatcher; every iteration delivers one transfer from each node.
+ */
+void runDispatcherReception(bench::State& state, unsigned payload_len)
+{
+    static const unsigned NumSources = 16;
+    static const unsigned NumTransferIDs = uavcan::TransferID::Max + 1;
+
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 256, uavcan::MemPoolBlockSize> pool;
+    SystemClockMock clock(1000000);
+    bench::VirtualCanDriver driver(clock);
+    uavcan::Dispatcher dispatcher(driver, pool, clock);
+    (void)dispatcher.setNodeID(1);
+
+    const uavcan::DataTypeDescriptor data_type = bench::makeDataType(uavcan::DataTypeKindMessage, 100);
+    CountingListener listener(dispatcher.getTransferPerfCounter(), data_type, pool);
+    (void)dispatcher.registerMessageListener(&listener);
+
+    std::vector<uavcan::uint8_t> payload(payload_len);
+    for (unsigned i = 0; i < payload_len; i++)
+    {
+        payload[i] = uavcan::uint8_t(i * 31U);
+    }
+
+    // Pre-compiling the frames, so that the benchmark measures only the reception path
+    std::vector<std::vector<uavcan::CanFrame> > frames(NumTransferIDs);
+    for (unsigned tid = 0; tid < NumTransferIDs; tid++)
+    {
+        for (unsigned src = 0; src < NumSources; src++)
+        {
+            const std::vector<uavcan::CanFrame> tr =
+                bench::makeTransferFrames(data_type, uavcan::TransferTypeMessageBroadcast,
+                                          uavcan::NodeID(uavcan::uint8_t(10 + src)), uavcan::NodeID::Broadcast,
+                                          uavcan::TransferID(uavcan::uint8_t(tid)), &payload[0], payload_len);
+            frames[tid].insert(frames[tid].end(), tr.begin(), tr.end());
+        }
+    }
+
+    unsigned tid = 0;
+    while (state.keepRunning())
+    {
+        const std::vector<uavcan::CanFrame>& batch = frames[tid];
+        for (std::vector<uavcan::CanFrame>::const_iterator it = batch.begin(); it != batch.end(); ++it)
+        {
+            driver.pushRx(*it);
+        }
+        (void)dispatcher.spinOnce();
+        clock.advance(1000);
+        tid = (tid + 1) % NumTransferIDs;
+    }
+
+    if (listener.getNumTransfers() != state.getIterations() * NumSources)
+    {
+        state.setError("Some transfers were lost");
+    }
+    state.setItemsProcessed(listener.getNumTransfers());
+    state.setBytesProcessed(listener.getNumTransfers() * payload_len);
+    dispatcher.unregisterMessageListener(&listener);
+}
+
+void runTransferSender(bench::State& state, unsigned payload_len)
+{
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 64, uavcan::MemPoolBlockSize> pool;
+    SystemClockMock clock(1000000);
+    bench::VirtualCanDriver driver(clock);
+    bench::VirtualCanDriver sink(clock);     // Nobody reads from it, so it is cleared periodically
+    driver.connect(sink);
+    uavcan::Dispatcher dispatcher(driver, pool, clock);
+    (void)dispatcher.setNodeID(1);
+
+    const uavcan::DataTypeDescriptor data_type = bench::makeDataType(uavcan::DataTypeKindMessage, 100);
+    uavcan::TransferSender sender(dispatcher, data_type, uavcan::CanTxQueue::Volatile);
+
+    std::vector<uavcan::uint8_t> payload(payload_len);
+    for (unsigned i = 0; i < payload_len; i++)
+    {
+        payload[i] = uavcan::uint8_t(i * 31U);
+    }
+
+    uavcan::uint64_t num_failures = 0;
+    while (state.keepRunning())
+    {
+        const uavcan::MonotonicTime deadline = clock.getMonotonic() + uavcan::MonotonicDuration::fromMSec(10);
+        if (sender.send(&payload[0], payload_len, deadline, uavcan::MonotonicTime(),
+                        uavcan::TransferTypeMessageBroadcast, uavcan::NodeID::Broadcast) < 0)
+        {
+            num_failures++;
+        }
+        if ((state.getIterations() % 256) == 0)
+        {
+            uavcan::CanFrame frame;
+            uavcan::MonotonicTime ts_mono;
+            uavcan::UtcTime ts_utc;
+            uavcan::CanIOFlags flags = 0;
+            while (sink.receive(frame, ts_mono, ts_utc, flags) > 0)
+            {
+            }
+        }
+        clock.advance(100);
+    }
+
+    if (num_failures > 0)
+    {
+        state.setError("Some transfers were not sent");
+    }
+    state.setItemsProcessed(state.getIterations());
+    state.setBytesProcessed(state.getIterations() * payload_len);
+}
+
+}
+
+UAVCAN_BENCHMARK(CanTxQueuePushPopLinkedList)
+{
+    runTxQueue(state, uavcan::CanTxQueue::ModeLinkedList);
+}
+
+UAVCAN_BENCHMARK(CanTxQueuePushPopTreap)
+{
+    runTxQueue(state, uavcan::CanTxQueue::ModeTreap);
+}
+
+UAVCAN_BENCHMARK(DispatcherReceiveSingleFrame)
+{
+    runDispatcherReception(state, 7);
+}
+
+UAVCAN_BENCHMARK(DispatcherReceiveMultiFrame)
+{
+    runDispatcherReception(state, 64);
+}
+
+UAVCAN_BENCHMARK(TransferSenderSingleFrame)
+{
+    runTransferSender(state, 7);
+}
+
+UAVCAN_BENCHMARK(TransferSenderMultiFrame)
+{
+    runTransferSender(state, 64);
+}
@@ -0,0 +1,173 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <uavcan/dynamic_memory.hpp>
+#include <uavcan/util/map.hpp>
+#include <uavcan/util/hash_map.hpp>
+#include <uavcan/marshal/bit_stream.hpp>
+#include <uavcan/marshal/scalar_codec.hpp>
+#include <uavcan/transport/transfer_buffer.hpp>
+#include "bench.hpp"
+
+namespace
+{
+
+struct IntKey
+{
+    int value;
+
+    IntKey() : value(-1) { }
+    IntKey(int arg_value) : value(arg_value) { }  // Implicit
+
+    bool operator==(const IntKey& rhs) const { return value == rhs.value; }
+
+    unsigned getHash() const { return unsigned(value); }
+};
+
+const int NumMapKeys = 48;
+
+/// Visits the keys in a fixed pseudo-random order, so that the results don't depend on the insertion order
+int getKeyByIndex(int index) { return ((index * 29) % NumMapKeys) + 1; }
+
+}
+
+UAVCAN_BENCHMARK(MapInsertAccessRemove)
+{
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 64, uavcan::MemPoolBlockSize> pool;
+    uavcan::Map<short, short> map(pool);
+
+    while (state.keepRunning())
+    {
+        for (int i = 0; i < NumMapKeys; i++)
+        {
+            (void)map.insert(short(getKeyByIndex(i)), short(i));
+        }
+        for (int i = 0; i < NumMapKeys; i++)
+        {
+            bench::doNotOptimize(map.access(short(getKeyByIndex(NumMapKeys - 1 - i))));
+        }
+        for (int i = 0; i < NumMapKeys; i++)
+        {
+            map.remove(short(getKeyByIndex(i)));
+        }
+    }
+    if (!map.isEmpty())
+    {
+        state.setError("Map is not empty");
+    }
+    state.setItemsProcessed(state.getIterations() * NumMapKeys);
+}
+
+UAVCAN_BENCHMARK(HashMapInsertAccessRemove)
+{
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 64, uavcan::MemPoolBlockSize> pool;
+    uavcan::HashMap<IntKey, long, 16> map(pool);
+
+    while (state.keepRunning())
+    {
+        for (int i = 0; i < NumMapKeys; i++)
+        {
+            (void)map.insert(getKeyByIndex(i), i);
+        }
+        for (int i = 0; i < NumMapKeys; i++)
+        {
+            bench::doNotOptimize(map.access(getKeyByIndex(NumMapKeys - 1 - i)));
+        }
+        for (int i = 0; i < NumMapKeys; i++)
+        {
+            map.remove(getKeyByIndex(i));
+        }
+    }
+    if (!map.isEmpty())
+    {
+        state.setError("HashMap is not empty");
+    }
+    state.setItemsProcessed(state.getIterations() * NumMapKeys);
+}
+
+/**
+ * Unaligned writes and reads, which is the worst case for the bit stream.
+ */
+UAVCAN_BENCHMARK(BitStreamUnalignedWriteRead)
+{
+    static const unsigned BufferSize = 256;
+    uavcan::StaticTransferBuffer<BufferSize> buf;
+    const uint8_t data[] = { 0xDE, 0xAD, 0xBE, 0xEF, 0x12, 0x34, 0x56, 0x78 };
+    uint8_t readback[sizeof(data)] = {};
+
+    while (state.keepRunning())
+    {
+        {
+            uavcan::BitStream bs(buf);
+            (void)bs.write(data, 3);
+            for (unsigned i = 0; i < (BufferSize - 1) / sizeof(data); i++)
+            {
+                (void)bs.write(data, sizeof(data) * 8);
+            }
+        }
+        {
+            uavcan::BitStream bs(buf);
+            (void)bs.read(readback, 3);
+            for (unsigned i = 0; i < (BufferSize - 1) / sizeof(data); i++)
+            {
+                (void)bs.read(readback, sizeof(readback) * 8);
+            }
+        }
+        bench::doNotOptimize(readback);
+    }
+    if (readback[0] != data[0])
+    {
+        state.setError("Data mismatch");
+    }
+    state.setBytesProcessed(state.getIterations() * ((BufferSize - 1) / sizeof(data)) * sizeof(data) * 2);
+}
+
+/**
+ * A mix of field widths typical for DSDL definitions.
+ */
+UAVCAN_BENCHMARK(ScalarCodecEncodeDecode)
+{
+    static const unsigned NumRecords = 16;
+    uavcan::StaticTransferBuffer<NumRecords * 16> buf;
+    uint64_t checksum = 0;
+
+    while (state.keepRunning())
+    {
+        {
+            uavcan::BitStream bs(buf);
+            uavcan::ScalarCodec codec(bs);
+            for (unsigned i = 0; i < NumRecords; i++)
+            {
+                (void)codec.encode<1>(uint8_t(i & 1U));
+                (void)codec.encode<7>(uint8_t(i));
+                (void)codec.encode<12>(int16_t(-int(i) * 100));
+                (void)codec.encode<20>(uint32_t(i * 12345U));
+                (void)codec.encode<32>(uint32_t(0xDEADBEEFU ^ i));
+                (void)codec.encode<56>(uint64_t(i) << 40);
+            }
+        }
+        {
+            uavcan::BitStream bs(buf);
+            uavcan::ScalarCodec codec(bs);
+            for (unsigned i = 0; i < NumRecords; i++)
+            {
+                uint8_t u1 = 0;
+                uint8_t u7 = 0;
+                int16_t i12 = 0;
+                uint32_t u20 = 0;
+                uint32_t u32 = 0;
+                uint64_t u56 = 0;
+                (void)codec.decode<1>(u1);
+                (void)codec.decode<7>(u7);
+                (void)codec.decode<12>(i12);
+                (void)codec.decode<20>(u20);
+                (void)codec.decode<32>(u32);
+                (void)codec.decode<56>(u56);
+                checksum += u1 + u7 + uint64_t(int64_t(i12)) + u20 + u32 + u56;
+            }
+        }
+        bench::doNotOptimize(checksum);
+    }
+    state.setItemsProcessed(state.getIterations() * NumRecords * 6 * 2);
+}
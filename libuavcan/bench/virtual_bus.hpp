@@ -0,0 +1,190 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#pragma once
+
+#include <iostream>
+#include <deque>
+#include <vector>
+#include <uavcan/driver/can.hpp>
+#include <uavcan/node/abstract_node.hpp>
+#include <uavcan/transport/frame.hpp>
+#include <uavcan/transport/crc.hpp>
+#include <uavcan/data_type.hpp>
+#include "../test/clock.hpp"
+
+namespace bench
+{
+/**
+ * Single-interface CAN driver connected to a virtual bus shared with other drivers.
+ * Unlike the driver mocks used by the tests, it does not validate anything and never blocks, so the driver
+ * overhead is negligible compared to the library code being measured. When there is nothing to do,
+ * select() advances the mock clock to the deadline, so that the spin loops terminate in mock time.
+ */
+class VirtualCanDriver : public uavcan::ICanDriver, public uavcan::ICanIface
+{
+    SystemClockMock& clock_;
+    std::vector<VirtualCanDriver*> peers_;
+    std::deque<uavcan::CanFrame> rx_;
+    std::deque<uavcan::CanFrame> loopback_;
+    uavcan::uint64_t num_tx_frames_;
+
+public:
+    explicit VirtualCanDriver(SystemClockMock& clock)
+        : clock_(clock)
+        , num_tx_frames_(0)
+    { }
+
+    void connect(VirtualCanDriver& other)
+    {
+        peers_.push_back(&other);
+        other.peers_.push_back(this);
+    }
+
+    void pushRx(const uavcan::CanFrame& frame) { rx_.push_back(frame); }
+
+    bool hasPendingRx() const { return !rx_.empty() || !loopback_.empty(); }
+    uavcan::uint64_t getNumTxFrames() const { return num_tx_frames_; }
+
+    virtual uavcan::int16_t send(const uavcan::CanFrame& frame, uavcan::MonotonicTime, uavcan::CanIOFlags flags)
+    {
+        for (std::vector<VirtualCanDriver*>::const_iterator it = peers_.begin(); it != peers_.end(); ++it)
+        {
+            (*it)->rx_.push_back(frame);
+        }
+        if (flags & uavcan::CanIOFlagLoopback)
+        {
+            loopback_.push_back(frame);
+        }
+        num_tx_frames_++;
+        return 1;
+    }
+
+    virtual uavcan::int16_t receive(uavcan::CanFrame& out_frame, uavcan::MonotonicTime& out_ts_monotonic,
+                                    uavcan::UtcTime& out_ts_utc, uavcan::CanIOFlags& out_flags)
+    {
+        std::deque<uavcan::CanFrame>& queue = loopback_.empty() ? rx_ : loopback_;
+        if (queue.empty())
+        {
+            return 0;
+        }
+        out_flags = loopback_.empty() ? 0 : uavcan::CanIOFlagLoopback;
+        out_frame = queue.front();
+        queue.pop_front();
+        out_ts_monotonic = clock_.getMonotonic();
+        out_ts_utc = clock_.getUtc();
+        return 1;
+    }
+
+    virtual uavcan::int16_t select(uavcan::CanSelectMasks& inout_masks,
+                                   const uavcan::CanFrame* (&)[uavcan::MaxCanIfaces],
+                                   uavcan::MonotonicTime blocking_deadline)
+    {
+        inout_masks.read = uavcan::uint8_t(hasPendingRx() ? (inout_masks.read & 1U) : 0U);
+        inout_masks.write &= 1U;
+        if ((inout_masks.read | inout_masks.write) != 0)
+        {
+            return 1;
+        }
+        const uavcan::MonotonicDuration diff = blocking_deadline - clock_.getMonotonic();
+        if (diff.isPositive())
+        {
+            clock_.advance(uint64_t(diff.toUSec()));
+        }
+        return 0;
+    }
+
+    virtual uavcan::int16_t configureFilters(const uavcan::CanFilterConfig*, uavcan::uint16_t) { return 0; }
+    virtual uavcan::uint16_t getNumFilters() const { return 0; }
+    virtual uavcan::uint64_t getErrorCount() const { return 0; }
+
+    virtual uavcan::ICanIface* getIface(uavcan::uint8_t iface_index) { return (iface_index == 0) ? this : NULL; }
+    virtual uavcan::uint8_t getNumIfaces() const { return 1; }
+};
+
+/**
+ * Minimal node with its own memory pool; the servers of the protocol layer need more memory than the default.
+ */
+template <unsigned NumPoolBlocks = 512>
+class VirtualNode : public uavcan::INode
+{
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * NumPoolBlocks, uavcan::MemPoolBlockSize> pool_;
+    uavcan::Scheduler scheduler_;
+    uavcan::uint64_t internal_failure_count_;
+
+public:
+    VirtualNode(uavcan::ICanDriver& can_driver, uavcan::ISystemClock& clock, uavcan::NodeID self_node_id)
+        : scheduler_(can_driver, pool_, clock)
+        , internal_failure_count_(0)
+    {
+        if (self_node_id.isUnicast())
+        {
+            (void)setNodeID(self_node_id);
+        }
+    }
+
+    virtual void registerInternalFailure(const char*) { internal_failure_count_++; }
+
+    virtual uavcan::IPoolAllocator& getAllocator() { return pool_; }
+    virtual uavcan::Scheduler& getScheduler() { return scheduler_; }
+    virtual const uavcan::Scheduler& getScheduler() const { return scheduler_; }
+
+    uavcan::uint64_t getInternalFailureCount() const { return internal_failure_count_; }
+};
+
+/**
+ * Splits the payload into CAN frames the same way the transfer sender does, including the transfer CRC.
+ */
+inline std::vector<uavcan::CanFrame> makeTransferFrames(const uavcan::DataTypeDescriptor& data_type,
+                                                        uavcan::TransferType transfer_type,
+                                                        uavcan::NodeID src_node_id, uavcan::NodeID dst_node_id,
+                                                        uavcan::TransferID tid,
+                                                        const uavcan::uint8_t* payload, unsigned payload_len)
+{
+    std::vector<uavcan::uint8_t> raw;
+    if (payload_len > (sizeof(uavcan::CanFrame::data) - 1U))
+    {
+        uavcan::TransferCRC crc = data_type.getSignature().toTransferCRC();
+        crc.add(payload, uavcan::uint16_t(payload_len));
+        raw.push_back(uavcan::uint8_t(crc.get() & 0xFFU));
+        raw.push_back(uavcan::uint8_t(crc.get() >> 8));
+    }
+    raw.insert(raw.end(), payload, payload + payload_len);
+
+    uavcan::Frame frame(data_type.getID(), transfer_type, src_node_id, dst_node_id, tid);
+    frame.setStartOfTransfer(true);
+
+    std::vector<uavcan::CanFrame> output;
+    unsigned offset = 0;
+    while (true)
+    {
+        const int res = frame.setPayload(raw.empty() ? NULL : &raw[offset], unsigned(raw.size() - offset));
+        if (res < 0)
+        {
+            break;
+        }
+        offset += unsigned(res);
+        frame.setEndOfTransfer(offset >= raw.size());
+
+        uavcan::CanFrame can_frame;
+        (void)frame.compile(can_frame);
+        output.push_back(can_frame);
+
+        if (frame.isEndOfTransfer())
+        {
+            break;
+        }
+        frame.setStartOfTransfer(false);
+        frame.flipToggle();
+    }
+    return output;
+}
+
+inline uavcan::DataTypeDescriptor makeDataType(uavcan::DataTypeKind kind, uavcan::uint16_t id)
+{
+    const uavcan::DataTypeSignature signature(0xDEADBEEF00000000ULL | (uavcan::uint64_t(kind) << 16) | id);
+    return uavcan::DataTypeDescriptor(kind, id, signature, "bench.Type");
+}
+
+}
@@ -12,7 +12,7 @@ It is based on the DSDL parsing package from pyuavcan.
 '''
 
 from __future__ import division, absolute_import, print_function, unicode_literals
-import sys, os, logging, errno, re
+import sys, os, logging, errno, re, struct
 from .pyratemp import Template
 from uavcan import dsdl
 
@@ -33,7 +33,8 @@ class DsdlCompilerException(Exception):
 
 logger = logging.getLogger(__name__)
 
-def run(source_dirs, include_dirs, output_dir):
+def run(source_dirs, include_dirs, output_dir, pooled_array_threshold=None, layout_database=None,
+        instantiation_source=None):
     '''
     This function takes a list of root namespace directories (containing DSDL definition files to parse), a
     possibly empty list of search directories (containing DSDL definition files that can be referenced from the types
@@ -49,6 +50,15 @@ def run(source_dirs, include_dirs, output_dir):
         include_dirs   List of root namespace directories with referenced types (possibly empty). This list is
                        automaitcally extended with source_dirs.
         output_dir     Output directory path. Will be created if doesn't exist.
+        pooled_array_threshold  If specified, the dynamic arrays whose inline storage would take at least this
+                       many bytes are generated with ::uavcan::ArrayModeDynamicPooled, i.e. their storage is
+                       allocated from ::uavcan::PooledArrayAllocator as needed. None disables this (default).
+        layout_database  If specified, the layout bytecode of all parsed types is written into this file, which
+                       can be loaded at run time with ::uavcan::DataTypeLayoutDatabase in order to decode the
+                       types without the generated code. None disables this (default).
+        instantiation_source  If specified, a C++ source file that explicitly instantiates all parsed types is
+                       written into this file; it must be compiled with UAVCAN_EXPLICIT_INSTANTIATION enabled and
+                       linked with the application. None disables this (default).
     '''
     assert isinstance(source_dirs, list)
     assert isinstance(include_dirs, list)
@@ -59,7 +69,11 @@ def run(source_dirs, include_dirs, output_dir):
         die('No type definitions were found')
 
     logger.info('%d types total', len(types))
-    run_generator(types, output_dir)
+    run_generator(types, output_dir, pooled_array_threshold)
+    if layout_database:
+        run_layout_generator(types, layout_database)
+    if instantiation_source:
+        run_instantiation_generator(types, instantiation_source)
 
 # -----------------
 
@@ -96,7 +110,7 @@ def run_parser(source_dirs, search_dirs):
         die(ex)
     return types
 
-def run_generator(types, dest_dir):
+def run_generator(types, dest_dir, pooled_array_threshold):
     try:
         template_expander = make_template_expander(TEMPLATE_FILENAME)
         dest_dir = os.path.abspath(dest_dir)  # Removing '..'
@@ -104,19 +118,36 @@ def run_generator(types, dest_dir):
         for t in types:
             logger.info('Generating type %s', t.full_name)
             filename = os.path.join(dest_dir, type_output_filename(t))
-            text = generate_one_type(template_expander, t)
+            text = generate_one_type(template_expander, t, pooled_array_threshold)
             write_generated_data(filename, text)
     except Exception as ex:
         logger.info('Generator failure', exc_info=True)
         die(ex)
 
-def write_generated_data(filename, data):
+def run_layout_generator(types, filename):
+    try:
+        logger.info('Generating layout database for %d types', len(types))
+        write_generated_data(os.path.abspath(filename), generate_layout_database(types), binary=True)
+    except Exception as ex:
+        logger.info('Layout generator failure', exc_info=True)
+        die(ex)
+
+def run_instantiation_generator(types, filename):
+    try:
+        logger.info('Generating explicit instantiations for %d types', len(types))
+        write_generated_data(os.path.abspath(filename), generate_instantiation_source(types))
+    except Exception as ex:
+        logger.info('Instantiation generator failure', exc_info=True)
+        die(ex)
+
+def write_generated_data(filename, data, binary=False):
     dirname = os.path.dirname(filename)
     makedirs(dirname)
+    mode = 'b' if binary else ''
 
     # Lazy update - file will not be rewritten if its content is not going to change
     if os.path.exists(filename):
-        with open(filename) as f:
+        with open(filename, 'r' + mode) as f:
             existing_data = f.read()
         if data == existing_data:
             logger.info('Up to date [%s]', pretty_filename(filename))
@@ -127,14 +158,46 @@ def write_generated_data(filename, data):
         logger.info('Creating [%s]', pretty_filename(filename))
 
     # Full rewrite
-    with open(filename, 'w') as f:
+    with open(filename, 'w' + mode) as f:
         f.write(data)
     try:
         os.chmod(filename, OUTPUT_FILE_PERMISSIONS)
     except (OSError, IOError) as ex:
         logger.warning('Failed to set permissions for %s: %s', pretty_filename(filename), ex)
 
-def type_to_cpp_type(t):
+def cpp_storage_size(t):
+    '''Approximate size of the C++ storage of a value of the given DSDL type, in bytes.'''
+    if t.category == t.CATEGORY_PRIMITIVE:
+        if t.kind == t.KIND_FLOAT:
+            return 8 if t.bitlen > 32 else 4
+        return next(x for x in (1, 2, 4, 8) if t.bitlen <= x * 8)
+    if t.category == t.CATEGORY_ARRAY:
+        return t.max_size * cpp_storage_size(t.value_type)
+    return max(1, (t.get_max_bitlen() + 7) // 8)
+
+def is_pooled_array(t, pooled_array_threshold):
+    if pooled_array_threshold is None or t.mode != t.MODE_DYNAMIC:
+        return False
+    bit_array = t.value_type.category == t.CATEGORY_PRIMITIVE and t.value_type.bitlen == 1
+    return not bit_array and cpp_storage_size(t) >= pooled_array_threshold
+
+def view_fixed_bitlen(t):
+    '''Bit length of the serialized values of the given type if it is the same for all values, otherwise None.'''
+    if t.category in (t.CATEGORY_PRIMITIVE, t.CATEGORY_VOID):
+        return t.bitlen
+    if t.category == t.CATEGORY_ARRAY:
+        element_bitlen = view_fixed_bitlen(t.value_type)
+        if t.mode != t.MODE_STATIC or element_bitlen is None:
+            return None
+        return t.max_size * element_bitlen
+    bitlens = [view_fixed_bitlen(a.type) for a in t.fields]
+    if None in bitlens:
+        return None
+    if t.union and t.fields:
+        return len(t.fields).bit_length() + bitlens[0] if len(set(bitlens)) == 1 else None
+    return sum(bitlens)
+
+def type_to_cpp_type(t, pooled_array_threshold=None):
     if t.category == t.CATEGORY_PRIMITIVE:
         cast_mode = {
             t.CAST_MODE_SATURATED: '::uavcan::CastModeSaturate',
@@ -150,11 +213,13 @@ def type_to_cpp_type(t):
             }[t.kind]
             return '::uavcan::IntegerSpec< %d, %s, %s >' % (t.bitlen, signedness, cast_mode)
     elif t.category == t.CATEGORY_ARRAY:
-        value_type = type_to_cpp_type(t.value_type)
+        value_type = type_to_cpp_type(t.value_type, pooled_array_threshold)
         mode = {
             t.MODE_STATIC: '::uavcan::ArrayModeStatic',
             t.MODE_DYNAMIC: '::uavcan::ArrayModeDynamic',
         }[t.mode]
+        if is_pooled_array(t, pooled_array_threshold):
+            mode = '::uavcan::ArrayModeDynamicPooled'
         return '::uavcan::Array< %s, %s, %d >' % (value_type, mode, t.max_size)
     elif t.category == t.CATEGORY_COMPOUND:
         return '::' + t.full_name.replace('.', '::')
@@ -163,7 +228,7 @@ def type_to_cpp_type(t):
     else:
         raise DsdlCompilerException('Unknown type category: %s' % t.category)
 
-def generate_one_type(template_expander, t):
+def generate_one_type(template_expander, t, pooled_array_threshold=None):
     t.short_name = t.full_name.split('.')[-1]
     t.cpp_type_name = t.short_name + '_'
     t.cpp_full_type_name = '::' + t.full_name.replace('.', '::')
@@ -190,7 +255,7 @@ def generate_one_type(template_expander, t):
     def inject_cpp_types(attributes):
         void_index = 0
         for a in attributes:
-            a.cpp_type = type_to_cpp_type(a.type)
+            a.cpp_type = type_to_cpp_type(a.type, pooled_array_threshold)
             a.void = a.type.category == a.type.CATEGORY_VOID
             if a.void:
                 assert not a.name
@@ -211,6 +276,79 @@ def generate_one_type(template_expander, t):
         t.request_union = t.request_union and len(t.request_fields)
         t.response_union = t.response_union and len(t.response_fields)
 
+    # Fused codec info - bit offsets of the fields are known at compile time if the layout is fully static
+    def inject_fused_codec_info(fields, union):
+        def element_bitlen_and_count(t):
+            if t.category in (t.CATEGORY_PRIMITIVE, t.CATEGORY_VOID):
+                return t.bitlen, None
+            if t.category == t.CATEGORY_ARRAY and t.mode == t.MODE_STATIC and \
+               t.value_type.category == t.CATEGORY_PRIMITIVE:
+                return t.value_type.bitlen, t.max_size
+        if union or not fields:
+            return False
+        offset = 0
+        for a in fields:
+            info = element_bitlen_and_count(a.type)
+            if info is None:
+                return False
+            a.fused_bitlen, a.fused_count = info
+            a.fused_offset = offset
+            offset += a.fused_bitlen * (a.fused_count or 1)
+        return True
+
+    if t.kind == t.KIND_MESSAGE:
+        t.fused = inject_fused_codec_info(t.fields, t.union)
+    else:
+        t.request_fused = inject_fused_codec_info(t.request_fields, t.request_union)
+        t.response_fused = inject_fused_codec_info(t.response_fields, t.response_union)
+
+    # View info - locations of the fields for the generated read-only views, see uavcan/marshal/payload_view.hpp
+    def inject_view_info(fields, union):
+        segments = []       # Non-last dynamic arrays; the offsets of the following fields are computed at run time
+        offset = 0          # Relative to the beginning of the current segment; None if unknown
+        for idx, a in enumerate(fields):
+            last = union or idx == len(fields) - 1
+            if union:
+                offset = len(fields).bit_length()
+            a.view_kind = None
+            if offset is None:
+                continue
+            if segments:
+                a.view_offset = 'getSegmentOffset(%d)' % len(segments)
+                a.view_segment_offset = 'segments_[%d]' % (len(segments) - 1)
+                if offset:
+                    a.view_offset += ' + %d' % offset
+                    a.view_segment_offset += ' + %d' % offset
+            else:
+                a.view_offset = a.view_segment_offset = str(offset)
+            a.view_tao = 'getTailArrayOptMode()' if last else '::uavcan::TailArrayOptDisabled'
+            t = a.type
+            if t.category in (t.CATEGORY_PRIMITIVE, t.CATEGORY_VOID):
+                a.view_kind = None if a.void else 'scalar'
+                offset += t.bitlen
+            elif t.category == t.CATEGORY_ARRAY:
+                if view_fixed_bitlen(t.value_type) is None:
+                    offset = None   # Elements of variable length can't be indexed
+                elif t.mode == t.MODE_STATIC:
+                    a.view_kind = 'static_array'
+                    offset += view_fixed_bitlen(t)
+                else:
+                    a.view_kind = 'dynamic_array'
+                    if not last:
+                        segments.append(a)
+                        offset = 0
+            elif t.category == t.CATEGORY_COMPOUND:
+                a.view_kind = 'compound'
+                bitlen = view_fixed_bitlen(t)
+                offset = None if bitlen is None else offset + bitlen
+        return segments
+
+    if t.kind == t.KIND_MESSAGE:
+        t.view_segments = inject_view_info(t.fields, t.union)
+    else:
+        t.request_view_segments = inject_view_info(t.request_fields, t.request_union)
+        t.response_view_segments = inject_view_info(t.response_fields, t.response_union)
+
     # Constant properties
     def inject_constant_info(constants):
         for c in constants:
@@ -242,6 +380,119 @@ def generate_one_type(template_expander, t):
     text = text.replace('{\n\n ', '{\n ')
     return text
 
+# -----------------
+# Layout bytecode for the run time decoder; see uavcan/marshal/layout_decoder.hpp for the format
+
+LAYOUT_DATABASE_MAGIC = b'ULDB'
+LAYOUT_DATABASE_VERSION = 1
+LAYOUT_NO_DEFAULT_DTID = 0xFFFF
+
+(LAYOUT_OP_STRUCT, LAYOUT_OP_UNION, LAYOUT_OP_UNSIGNED, LAYOUT_OP_SIGNED, LAYOUT_OP_FLOAT, LAYOUT_OP_BOOL,
+ LAYOUT_OP_VOID, LAYOUT_OP_STATIC_ARRAY, LAYOUT_OP_DYNAMIC_ARRAY) = range(1, 10)
+
+LAYOUT_ARRAY_FLAG_TAIL_OPTIMIZABLE = 1
+
+def layout_min_bitlen(t):
+    '''Same as MinBitLen of the generated code; defines whether a dynamic array can be tail optimized.'''
+    if t.category in (t.CATEGORY_PRIMITIVE, t.CATEGORY_VOID):
+        return t.bitlen
+    if t.category == t.CATEGORY_ARRAY:
+        return t.max_size * layout_min_bitlen(t.value_type) if t.mode == t.MODE_STATIC else 0
+    if t.union and t.fields:
+        return len(t.fields).bit_length() + min(layout_min_bitlen(a.type) for a in t.fields)
+    return sum(layout_min_bitlen(a.type) for a in t.fields)
+
+def layout_struct_code(fields, union):
+    if len(fields) > 0xFF:
+        die('Too many fields for the layout bytecode: %d' % len(fields))
+    if union and fields:
+        code = bytearray(struct.pack('<BBB', LAYOUT_OP_UNION, len(fields), len(fields).bit_length()))
+    else:
+        code = bytearray(struct.pack('<BB', LAYOUT_OP_STRUCT, len(fields)))
+    for a in fields:
+        # Void fields are unnamed; the names may have been assigned by the C++ generator already
+        name = b'' if a.type.category == a.type.CATEGORY_VOID else a.name.encode('ascii')
+        code += struct.pack('<B', len(name)) + name + b'\0'
+        code += layout_value_code(a.type)
+    return code
+
+def layout_value_code(t):
+    if t.category == t.CATEGORY_PRIMITIVE:
+        if t.kind == t.KIND_BOOLEAN:
+            return bytearray(struct.pack('<B', LAYOUT_OP_BOOL))
+        opcode = {
+            t.KIND_UNSIGNED_INT: LAYOUT_OP_UNSIGNED,
+            t.KIND_SIGNED_INT: LAYOUT_OP_SIGNED,
+            t.KIND_FLOAT: LAYOUT_OP_FLOAT,
+        }[t.kind]
+        return bytearray(struct.pack('<BB', opcode, t.bitlen))
+    elif t.category == t.CATEGORY_VOID:
+        return bytearray(struct.pack('<BB', LAYOUT_OP_VOID, t.bitlen))
+    elif t.category == t.CATEGORY_ARRAY:
+        if t.max_size > 0xFFFF:
+            die('Array is too long for the layout bytecode: %d' % t.max_size)
+        if t.mode == t.MODE_STATIC:
+            code = bytearray(struct.pack('<BH', LAYOUT_OP_STATIC_ARRAY, t.max_size))
+        else:
+            flags = LAYOUT_ARRAY_FLAG_TAIL_OPTIMIZABLE if layout_min_bitlen(t.value_type) >= 8 else 0
+            code = bytearray(struct.pack('<BHBB', LAYOUT_OP_DYNAMIC_ARRAY, t.max_size, t.max_size.bit_length(),
+                                         flags))
+        return code + layout_value_code(t.value_type)
+    elif t.category == t.CATEGORY_COMPOUND:
+        return layout_struct_code(t.fields, t.union)    # Nested types are inlined
+    else:
+        raise DsdlCompilerException('Unknown type category: %s' % t.category)
+
+def generate_layout_database(types):
+    records = []
+    for t in types:
+        if t.kind == t.KIND_MESSAGE:
+            kind, codes = 1, [layout_struct_code(t.fields, t.union)]
+        else:
+            kind, codes = 0, [layout_struct_code(t.request_fields, t.request_union),
+                              layout_struct_code(t.response_fields, t.response_union)]
+        name = t.full_name.encode('ascii')
+        record = bytearray(struct.pack('<QB', t.get_data_type_signature(), len(name)) + name + b'\0')
+        for code in codes:
+            if len(code) > 0xFFFF:
+                die('Layout bytecode of %s is too long' % t.full_name)
+            record += struct.pack('<H', len(code)) + code
+        dtid = LAYOUT_NO_DEFAULT_DTID if t.default_dtid is None else t.default_dtid
+        records.append((kind, dtid, t.full_name, record))
+
+    # The index is sorted by kind and data type ID, so the decoder can use binary search
+    records.sort(key=lambda x: x[:3])
+    header = bytearray(LAYOUT_DATABASE_MAGIC + struct.pack('<BBH', LAYOUT_DATABASE_VERSION, 0, len(records)))
+    index, body = bytearray(), bytearray()
+    offset = len(header) + 8 * len(records)
+    for kind, dtid, _, record in records:
+        index += struct.pack('<HBBI', dtid, kind, 0, offset + len(body))
+        body += record
+    return bytes(header + index + body)
+
+def generate_instantiation_source(types):
+    types = sorted(types, key=lambda t: t.full_name)
+    lines = ['/*',
+             ' * Explicit instantiation of the UAVCAN data structures for libuavcan.',
+             ' * Refer to UAVCAN_EXPLICIT_INSTANTIATION.',
+             ' *',
+             ' * Autogenerated, do not edit.',
+             ' */',
+             '',
+             '#include <uavcan/build_config.hpp>',
+             '']
+    lines += ['#include <%s>' % type_output_filename(t).replace(os.path.sep, '/') for t in types]
+    lines += ['', '#if UAVCAN_EXPLICIT_INSTANTIATION', '']
+    for t in types:
+        cpp_type_name = '::' + t.full_name.replace('.', '::') + '_'
+        if t.kind == t.KIND_SERVICE:
+            lines.append('template struct %s::Request_<0>;' % cpp_type_name)
+            lines.append('template struct %s::Response_<0>;' % cpp_type_name)
+        else:
+            lines.append('template struct %s<0>;' % cpp_type_name)
+    lines += ['', '#endif', '']
+    return '\n'.join(lines)
+
 def make_template_expander(filename):
     '''
     Templating is based on pyratemp (http://www.simple-is-better.org/template/pyratemp.html).
@@ -0,0 +1,114 @@
+#!/bin/sh
+#
+# Memory footprint report: sizes of the key classes (see probe.cpp) and flash usage of every translation unit of
+# the library, for every build configuration listed below. Nothing is linked or executed, so any cross compiler
+# can be used, which gives the numbers for the actual target:
+#
+#   CXXFLAGS="-mcpu=cortex-m3 -mthumb -fno-exceptions -fno-rtti" ./footprint.sh arm-none-eabi-g++ arm-none-eabi-nm
+#
+# Arguments are the compiler and nm; the size utility is derived from the nm name unless specified as the third
+# argument. The compiler flags are taken from CXXFLAGS (default -Os); extra include directories, e.g. the DSDL
+# compiler output, from FOOTPRINT_INCLUDES. The report is a table with one column per configuration; n/a means that
+# the configuration could not be built, e.g. the pool block size is too small for the pointer size of the target.
+# The CMake target footprint_report runs this script with the host compiler.
+#
+
+set -e
+
+CXX=${1:-g++}
+NM=${2:-nm}
+SIZE=${3:-$(echo "$NM" | sed 's/nm$/size/')}
+CXXFLAGS=${CXXFLAGS:--Os}
+
+LIBUAVCAN_DIR=$(cd "$(dirname "$0")/.." && pwd)
+INCLUDES="-I$LIBUAVCAN_DIR/include -I$LIBUAVCAN_DIR/include/dsdlc_generated $FOOTPRINT_INCLUDES"
+
+# name:flags
+CONFIGS="
+c++03,block48:-std=c++03 -DUAVCAN_MEM_POOL_BLOCK_SIZE=48
+c++03,block56:-std=c++03 -DUAVCAN_MEM_POOL_BLOCK_SIZE=56
+c++03,block64:-std=c++03 -DUAVCAN_MEM_POOL_BLOCK_SIZE=64
+c++03,tiny,block48:-std=c++03 -DUAVCAN_TINY=1 -DUAVCAN_MEM_POOL_BLOCK_SIZE=48
+c++03,tiny,block56:-std=c++03 -DUAVCAN_TINY=1 -DUAVCAN_MEM_POOL_BLOCK_SIZE=56
+c++03,tiny,block64:-std=c++03 -DUAVCAN_TINY=1 -DUAVCAN_MEM_POOL_BLOCK_SIZE=64
+c++11,block48:-std=c++11 -DUAVCAN_MEM_POOL_BLOCK_SIZE=48
+c++11,block56:-std=c++11 -DUAVCAN_MEM_POOL_BLOCK_SIZE=56
+c++11,block64:-std=c++11 -DUAVCAN_MEM_POOL_BLOCK_SIZE=64
+c++11,tiny,block48:-std=c++11 -DUAVCAN_TINY=1 -DUAVCAN_MEM_POOL_BLOCK_SIZE=48
+c++11,tiny,block56:-std=c++11 -DUAVCAN_TINY=1 -DUAVCAN_MEM_POOL_BLOCK_SIZE=56
+c++11,tiny,block64:-std=c++11 -DUAVCAN_TINY=1 -DUAVCAN_MEM_POOL_BLOCK_SIZE=64
+"
+
+num_cores=$(grep -c ^processor /proc/cpuinfo 2>/dev/null || echo 4)
+
+work_dir=$(mktemp -d)
+trap 'rm -rf "$work_dir"' EXIT
+
+sources=$(cd "$LIBUAVCAN_DIR/src" && find . -name '*.cpp' | sed 's|^\./||' | sort)
+
+echo "$CONFIGS" | while IFS=: read -r name flags; do
+    [ -z "$name" ] && continue
+    out="$work_dir/$name"
+    mkdir -p "$out"
+    values="$out/values"
+    : > "$values"
+
+    # Class sizes and other compile time values
+    if $CXX $CXXFLAGS $flags $INCLUDES -c "$LIBUAVCAN_DIR/footprint/probe.cpp" -o "$out/probe.o" 2>"$out/probe.log"
+    then
+        $NM -S "$out/probe.o" | grep ' uavcan_footprint_' | \
+            while read -r addr size type symbol; do
+                echo "${symbol#uavcan_footprint_} $((0x$size))"
+            done | sort >> "$values"
+    fi
+
+    # Flash usage of every translation unit (text + data); the total is reported only if all of them were built
+    total=0
+    complete=1
+    for src in $sources; do
+        obj="$out/$(echo "$src" | tr '/' '_').o"
+        echo "$LIBUAVCAN_DIR/src/$src $obj"
+    done | xargs -P "$num_cores" -n 2 sh -c "$CXX $CXXFLAGS $flags $INCLUDES -c \"\$0\" -o \"\$1\" 2>/dev/null || true"
+    for src in $sources; do
+        obj="$out/$(echo "$src" | tr '/' '_').o"
+        if [ -f "$obj" ]; then
+            flash=$($SIZE "$obj" | awk 'NR == 2 { print $1 + $2 }')
+            total=$((total + flash))
+            echo "flash_$src $flash" >> "$values"
+        else
+            complete=0
+        fi
+    done
+    if [ "$complete" -eq 1 ]; then
+        echo "flash_total $total" >> "$values"
+    fi
+    echo "$name" >> "$work_dir/configs"
+done
+
+# Table: one row per value, one column per configuration
+# shellcheck disable=SC2046
+awk '
+    BEGIN {
+        for (i = 1; i < ARGC; i++) {
+            column[ARGV[i]] = i
+            name = ARGV[i]
+            sub(/\/values$/, "", name)
+            sub(/.*\//, "", name)
+            config[i] = name
+        }
+    }
+    {
+        if (!($1 in seen)) { seen[$1] = 1; rows[++num_rows] = $1 }
+        value[$1, column[FILENAME]] = $2
+    }
+    END {
+        printf "%-56s", ""
+        for (c = 1; c < ARGC; c++) { printf " %18s", config[c] }
+        printf "\n"
+        for (r = 1; r <= num_rows; r++) {
+            printf "%-56s", rows[r]
+            for (c = 1; c < ARGC; c++) { printf " %18s", ((rows[r], c) in value) ? value[rows[r], c] : "n/a" }
+            printf "\n"
+        }
+    }
+' $(while read -r c; do echo "$work_dir/$c/values"; done < "$work_dir/configs")
@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ *
+ * Memory footprint probe, see footprint.sh.
+ *
+ * Every probe is an array whose size is the value of interest, so the values are read from the symbol table of the
+ * object file with nm. The translation unit is never linked or executed, which makes it possible to probe the
+ * layout produced by any cross compiler for the target MCU.
+ */
+
+#include <uavcan/uavcan.hpp>
+#if !UAVCAN_TINY
+# include <uavcan/node/sub_node.hpp>
+#endif
+#include <uavcan/protocol/node_status_monitor.hpp>
+#include <uavcan/protocol/global_time_sync_slave.hpp>
+#include <uavcan/protocol/dynamic_node_id_client.hpp>
+#include <uavcan/protocol/file_server.hpp>
+#include <uavcan/protocol/firmware_update_trigger.hpp>
+#include <uavcan/protocol/NodeStatus.hpp>
+#include <uavcan/protocol/GetNodeInfo.hpp>
+
+#define UAVCAN_FOOTPRINT_PROBE(name, value) \
+    extern "C" { extern char uavcan_footprint_##name[value]; char uavcan_footprint_##name[value]; }
+
+#define UAVCAN_FOOTPRINT_SIZEOF(name, type)     UAVCAN_FOOTPRINT_PROBE(sizeof_##name, sizeof(type))
+
+#define UAVCAN_FOOTPRINT_KV_PER_BLOCK(name, map_type) \
+    UAVCAN_FOOTPRINT_PROBE(kv_per_block_##name, unsigned(map_type::NumKVPairsPerBlock))
+
+namespace
+{
+
+typedef uavcan::Node<0> Node;               ///< The pool is not included; Node<MemPoolSize> adds MemPoolSize bytes
+#if !UAVCAN_TINY
+typedef uavcan::SubNode<0> SubNode;
+#endif
+typedef uavcan::Publisher<uavcan::protocol::NodeStatus> NodeStatusPublisher;
+typedef uavcan::Subscriber<uavcan::protocol::NodeStatus> NodeStatusSubscriber;
+typedef uavcan::ServiceServer<uavcan::protocol::GetNodeInfo> GetNodeInfoServer;
+typedef uavcan::ServiceClient<uavcan::protocol::GetNodeInfo> GetNodeInfoClient;
+typedef uavcan::Map<uavcan::NodeID, uavcan::FileServerReadStats> FileServerReadStatsMap;
+typedef uavcan::Map<uavcan::NodeID, uavcan::FirmwareUpdateTrigger::FirmwareFilePath> FirmwareFilePathMap;
+
+}
+
+/*
+ * Node
+ */
+UAVCAN_FOOTPRINT_SIZEOF(Node,                           Node)
+#if !UAVCAN_TINY
+UAVCAN_FOOTPRINT_SIZEOF(SubNode,                        SubNode)
+#endif
+UAVCAN_FOOTPRINT_SIZEOF(Scheduler,                      uavcan::Scheduler)
+UAVCAN_FOOTPRINT_SIZEOF(NodeStatusProvider,             uavcan::NodeStatusProvider)
+UAVCAN_FOOTPRINT_SIZEOF(Timer,                          uavcan::TimerBase)
+UAVCAN_FOOTPRINT_SIZEOF(Publisher_NodeStatus,           NodeStatusPublisher)
+UAVCAN_FOOTPRINT_SIZEOF(Subscriber_NodeStatus,          NodeStatusSubscriber)
+UAVCAN_FOOTPRINT_SIZEOF(ServiceServer_GetNodeInfo,      GetNodeInfoServer)
+UAVCAN_FOOTPRINT_SIZEOF(ServiceClient_GetNodeInfo,      GetNodeInfoClient)
+
+/*
+ * Transport
+ */
+UAVCAN_FOOTPRINT_SIZEOF(Dispatcher,                     uavcan::Dispatcher)
+UAVCAN_FOOTPRINT_SIZEOF(CanIOManager,                   uavcan::CanIOManager)
+UAVCAN_FOOTPRINT_SIZEOF(CanTxQueue,                     uavcan::CanTxQueue)
+UAVCAN_FOOTPRINT_SIZEOF(CanTxQueue_Entry,               uavcan::CanTxQueue::Entry)
+UAVCAN_FOOTPRINT_SIZEOF(TransferListener,               uavcan::TransferListener)
+UAVCAN_FOOTPRINT_SIZEOF(TransferListenerWithNodeIndex,  uavcan::TransferListenerWithNodeIndex)
+UAVCAN_FOOTPRINT_SIZEOF(TransferReceiver,               uavcan::TransferReceiver)
+UAVCAN_FOOTPRINT_SIZEOF(TransferBufferManagerEntry,     uavcan::TransferBufferManagerEntry)
+UAVCAN_FOOTPRINT_SIZEOF(ReassemblyTable,                uavcan::ReassemblyTable)
+UAVCAN_FOOTPRINT_SIZEOF(OutgoingTransferRegistry,       uavcan::OutgoingTransferRegistry)
+UAVCAN_FOOTPRINT_SIZEOF(TransferPerfCounter,            uavcan::TransferPerfCounter)
+
+/*
+ * Protocol
+ */
+UAVCAN_FOOTPRINT_SIZEOF(NodeStatusMonitor,              uavcan::NodeStatusMonitor)
+UAVCAN_FOOTPRINT_SIZEOF(GlobalTimeSyncSlave,            uavcan::GlobalTimeSyncSlave)
+UAVCAN_FOOTPRINT_SIZEOF(DynamicNodeIDClient,            uavcan::DynamicNodeIDClient)
+
+/*
+ * Number of the entries of the library maps per memory pool block
+ */
+UAVCAN_FOOTPRINT_KV_PER_BLOCK(FileServerReadStats,      FileServerReadStatsMap)
+UAVCAN_FOOTPRINT_KV_PER_BLOCK(FirmwareFilePath,         FirmwareFilePathMap)
+
+/*
+ * Build configuration
+ */
+UAVCAN_FOOTPRINT_PROBE(config_MemPoolBlockSize,         uavcan::MemPoolBlockSize)
+UAVCAN_FOOTPRINT_PROBE(config_MaxCanIfaces,             unsigned(uavcan::MaxCanIfaces))
@@ -82,6 +82,18 @@
 # endif
 #endif
 
+/**
+ * Marks functions that can be evaluated at compile time in C++11 mode, e.g. data type signature computation.
+ * Such functions are written as a single return statement, so that in C++03 mode they are plain inline functions.
+ */
+#ifndef UAVCAN_CONSTEXPR
+# if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
+#  define UAVCAN_CONSTEXPR constexpr
+# else
+#  define UAVCAN_CONSTEXPR
+# endif
+#endif
+
 /**
  * Declaration visibility
  * http://gcc.gnu.org/wiki/Visibility
@@ -100,6 +112,175 @@
 # define UAVCAN_TINY 0
 #endif
 
+/**
+ * Bounded-time mode for the nodes that need worst case execution time guarantees on small platforms.
+ * It makes the platform-dependent defaults select the lookup structures whose cost does not grow with the number
+ * of listeners, receivers, transfer IDs, pending calls and timers, i.e. the same ones as on general-purpose
+ * platforms, at the cost of their RAM; see DispatcherListenerIndexSize, TransferListenerNumReceiverBuckets,
+ * OutgoingTransferRegistryNumBuckets, ServiceClientNumCallBuckets, and UAVCAN_DEADLINE_SCHEDULER_TIMER_WHEEL.
+ * The linked-list TX queue is kept, because its cost is bounded by the queue capacity rather than randomized.
+ * For full determinism combine it with @ref StaticTransportAllocator and @ref StaticListenerTable, and verify
+ * the result with UAVCAN_EXECUTION_TIME_STATS. Disabled by default.
+ */
+#ifndef UAVCAN_BOUNDED_TIME
+# define UAVCAN_BOUNDED_TIME 0
+#endif
+
+/**
+ * Process the transfer CRC four bytes at a time using slice-by-4 lookup tables, which costs additional 1.5 KB of ROM.
+ * Has no effect if UAVCAN_TINY is enabled. By default it is enabled only on general-purpose platforms.
+ */
+#ifndef UAVCAN_CRC_SLICE_BY_4
+# define UAVCAN_CRC_SLICE_BY_4 UAVCAN_GENERAL_PURPOSE_PLATFORM
+#endif
+
+/**
+ * Encode and decode the generated data types with fully static layout (no dynamic arrays, unions or nested types)
+ * through a single packed byte array instead of walking the fields one by one, which is several times faster at
+ * the cost of some ROM. Has no effect on other data types. It is disabled if UAVCAN_TINY is enabled.
+ */
+#ifndef UAVCAN_DSDL_FUSED_CODEC
+# define UAVCAN_DSDL_FUSED_CODEC (!UAVCAN_TINY)
+#endif
+
+/**
+ * Keep the deadline handlers (timers, service call timeouts, ...) in a hierarchical timer wheel instead of a list
+ * sorted by deadline. This makes arming and cancelling a deadline handler O(1) instead of O(N), which matters for
+ * nodes that run many timers concurrently, at the cost of 128 pointers of RAM per node.
+ * By default it is enabled only on general-purpose platforms and in the bounded-time mode.
+ */
+#ifndef UAVCAN_DEADLINE_SCHEDULER_TIMER_WHEEL
+# define UAVCAN_DEADLINE_SCHEDULER_TIMER_WHEEL (UAVCAN_GENERAL_PURPOSE_PLATFORM || UAVCAN_BOUNDED_TIME)
+#endif
+
+/**
+ * Collect latency histograms for the stages of the TX and RX pipelines, see @ref LatencyStage.
+ * This costs one system clock reading per stage per frame or transfer, and about 80 bytes of RAM per stage.
+ * The histograms can be accessed via @ref INode::getLatencyHistogram(). Disabled by default.
+ * It is always disabled if UAVCAN_TINY is enabled.
+ */
+#ifndef UAVCAN_LATENCY_STATS
+# define UAVCAN_LATENCY_STATS 0
+#endif
+#if UAVCAN_TINY && UAVCAN_LATENCY_STATS
+# undef UAVCAN_LATENCY_STATS
+# define UAVCAN_LATENCY_STATS 0
+#endif
+
+/**
+ * Measure the execution time of the stages of @ref Node::spin() and of the TX path in cycles of the platform's
+ * cycle counter, see @ref ExecutionStage and @ref ICycleCounter. This costs two cycle counter readings per stage
+ * and about 110 bytes of RAM per stage. Nothing is measured until the cycle counter is installed via
+ * @ref INode::setCycleCounter(). The histograms can be accessed via @ref INode::getExecutionTimeHistogram().
+ * Disabled by default. It is always disabled if UAVCAN_TINY is enabled.
+ */
+#ifndef UAVCAN_EXECUTION_TIME_STATS
+# define UAVCAN_EXECUTION_TIME_STATS 0
+#endif
+#if UAVCAN_TINY && UAVCAN_EXECUTION_TIME_STATS
+# undef UAVCAN_EXECUTION_TIME_STATS
+# define UAVCAN_EXECUTION_TIME_STATS 0
+#endif
+
+/**
+ * Measure the time the library spends in RX processing, TX processing, deadline handlers and application callbacks
+ * per measurement window, excluding the time blocked in select(), see @ref DutyCycleCounter. This costs one
+ * monotonic clock reading per transition between these activities, i.e. a few per frame and per callback.
+ * The results can be accessed via @ref INode::getDutyCycleCounter(), and can be reported via the vendor-specific
+ * status code of uavcan.protocol.NodeStatus, see @ref NodeStatusProvider::setDutyCycleReporting().
+ * Disabled by default. It is always disabled if UAVCAN_TINY is enabled.
+ */
+#ifndef UAVCAN_DUTY_CYCLE_STATS
+# define UAVCAN_DUTY_CYCLE_STATS 0
+#endif
+#if UAVCAN_TINY && UAVCAN_DUTY_CYCLE_STATS
+# undef UAVCAN_DUTY_CYCLE_STATS
+# define UAVCAN_DUTY_CYCLE_STATS 0
+#endif
+
+/**
+ * Count the frames, bytes, transfers and errors separately for every data type the node publishes or subscribes to,
+ * see @ref DataTypePerfCounters. The counters are updated once per frame and once per transfer, and cost 36 bytes
+ * of RAM per table slot, see UAVCAN_DATA_TYPE_PERF_STATS_CAPACITY. Disabled by default.
+ * It is always disabled if UAVCAN_TINY is enabled.
+ */
+#ifndef UAVCAN_DATA_TYPE_PERF_STATS
+# define UAVCAN_DATA_TYPE_PERF_STATS 0
+#endif
+#if UAVCAN_TINY && UAVCAN_DATA_TYPE_PERF_STATS
+# undef UAVCAN_DATA_TYPE_PERF_STATS
+# define UAVCAN_DATA_TYPE_PERF_STATS 0
+#endif
+
+/**
+ * Record the transport events (frames received and sent, transfers completed, CRC errors, memory exhaustion,
+ * TX queue drops, timer events) into a ring of compact binary records, see @ref EventTrace. Recording an event
+ * costs a few stores and, for the events that are not timestamped already, one system clock reading; the ring
+ * costs 12 bytes of RAM per record, see UAVCAN_EVENT_TRACE_CAPACITY. Disabled by default.
+ * It is always disabled if UAVCAN_TINY is enabled.
+ */
+#ifndef UAVCAN_EVENT_TRACE
+# define UAVCAN_EVENT_TRACE 0
+#endif
+#if UAVCAN_TINY && UAVCAN_EVENT_TRACE
+# undef UAVCAN_EVENT_TRACE
+# define UAVCAN_EVENT_TRACE 0
+#endif
+
+/**
+ * Support the priority aging of the TX queues, which bounds the queueing latency of low priority frames under
+ * sustained high priority load, see @ref CanTxQueue::setAgingPercent(). Every TX queue entry stores the time
+ * it was queued at, which is shared with UAVCAN_LATENCY_STATS; on some platforms this makes the list entries
+ * singly linked. Disabled by default. It is always disabled if UAVCAN_TINY is enabled.
+ */
+#ifndef UAVCAN_TX_QUEUE_AGING
+# define UAVCAN_TX_QUEUE_AGING 0
+#endif
+#if UAVCAN_TINY && UAVCAN_TX_QUEUE_AGING
+# undef UAVCAN_TX_QUEUE_AGING
+# define UAVCAN_TX_QUEUE_AGING 0
+#endif
+
+/**
+ * Queue the frames that are pending on several interfaces once, in a TX queue shared by the interfaces, instead of
+ * copying them into the queue of every interface, see @ref CanIOManager. This saves pool blocks on redundant
+ * interfaces at the cost of one more TX queue in every CanIOManager instance.
+ * By default it is enabled only on general-purpose platforms. It is always disabled if UAVCAN_TINY is enabled.
+ */
+#ifndef UAVCAN_SHARED_TX_QUEUE
+# if UAVCAN_GENERAL_PURPOSE_PLATFORM
+#  define UAVCAN_SHARED_TX_QUEUE 1
+# else
+#  define UAVCAN_SHARED_TX_QUEUE 0
+# endif
+#endif
+#if UAVCAN_TINY && UAVCAN_SHARED_TX_QUEUE
+# undef UAVCAN_SHARED_TX_QUEUE
+# define UAVCAN_SHARED_TX_QUEUE 0
+#endif
+
+/**
+ * Attribute the pool memory usage to the library subsystems (TX queue, transfer buffers, etc), see
+ * @ref PoolUsageTracker. This helps to size the memory pool of a node properly.
+ * Costs two extra pointers per container and 4 bytes of RAM per tag per pool allocator. Disabled by default.
+ */
+#ifndef UAVCAN_POOL_USAGE_TRACKING
+# define UAVCAN_POOL_USAGE_TRACKING 0
+#endif
+
+/**
+ * Maximum number of log messages that @ref Logger can hold in the deferred mode, see @ref Logger::setDeferredMode().
+ * Every slot costs about 128 bytes of RAM per logger. Zero disables the deferred mode completely.
+ * By default it is enabled only on general-purpose platforms.
+ */
+#ifndef UAVCAN_LOGGER_DEFERRED_QUEUE_LENGTH
+# if UAVCAN_GENERAL_PURPOSE_PLATFORM && !UAVCAN_TINY
+#  define UAVCAN_LOGGER_DEFERRED_QUEUE_LENGTH 8
+# else
+#  define UAVCAN_LOGGER_DEFERRED_QUEUE_LENGTH 0
+# endif
+#endif
+
 /**
  * Disable the global data type registry, which can save some space on embedded systems.
  */
@@ -107,6 +288,65 @@
 # define UAVCAN_NO_GLOBAL_DATA_TYPE_REGISTRY 0
 #endif
 
+/**
+ * Register the generated data types that have a default Data Type ID at link time rather than before main().
+ * Their descriptors are then constant-initialized and stored in ROM, and the registry finds them via a table of
+ * pointers that the linker collects in the section "uavcan_data_types"; no RAM and no startup code is needed per type.
+ * Data types without a default Data Type ID can still be registered at run time, but a statically registered
+ * data type can't be re-registered with a different ID.
+ *
+ * Requires C++11 and GCC or Clang targeting ELF. The linker takes care of the table automatically if the section is
+ * not mentioned in the linker script; custom linker scripts that place it explicitly must wrap it in KEEP() and
+ * define the symbols __start_uavcan_data_types and __stop_uavcan_data_types around it. Disabled by default.
+ */
+#ifndef UAVCAN_STATIC_DATA_TYPE_REGISTRY
+# define UAVCAN_STATIC_DATA_TYPE_REGISTRY 0
+#endif
+#if UAVCAN_STATIC_DATA_TYPE_REGISTRY
+# if UAVCAN_CPP_VERSION < UAVCAN_CPP11
+#  error UAVCAN_STATIC_DATA_TYPE_REGISTRY requires C++11
+# endif
+# if !defined(__GNUC__)
+#  error UAVCAN_STATIC_DATA_TYPE_REGISTRY requires GCC or Clang
+# endif
+# if UAVCAN_NO_GLOBAL_DATA_TYPE_REGISTRY
+#  error UAVCAN_STATIC_DATA_TYPE_REGISTRY conflicts with UAVCAN_NO_GLOBAL_DATA_TYPE_REGISTRY
+# endif
+#endif
+
+/**
+ * Don't instantiate the methods of the generated data types (coding, comparison, constants) in every translation
+ * unit that uses them; instead, they are instantiated once in the source file that is produced by the DSDL compiler
+ * with the option --instantiation-source, which must be compiled and linked with the application. This reduces the
+ * compilation time and the size of the object files; the CMake build does that for the standard data types when
+ * the option UAVCAN_EXPLICIT_INSTANTIATION is set. The instantiation sources of the application-specific data types
+ * must be generated and linked as well, otherwise the build will fail with undefined references.
+ *
+ * Requires C++11; ignored in C++03 mode. Disabled by default.
+ */
+#ifndef UAVCAN_EXPLICIT_INSTANTIATION
+# define UAVCAN_EXPLICIT_INSTANTIATION 0
+#endif
+#if UAVCAN_EXPLICIT_INSTANTIATION && (UAVCAN_CPP_VERSION < UAVCAN_CPP11)
+# undef UAVCAN_EXPLICIT_INSTANTIATION
+# define UAVCAN_EXPLICIT_INSTANTIATION 0
+#endif
+
+/**
+ * Maximum number of data types, messages and services together, that are indexed by the global data type registry
+ * when it gets frozen. Lookups by name or by data type ID are then performed via hash tables, so they take constant
+ * time instead of walking the list of all registered types. If more types are registered, the lists are used.
+ * Costs about sizeof(void*) + 12 bytes of RAM per slot. Must be a power of two; zero disables the index.
+ * By default it is enabled only on general-purpose platforms.
+ */
+#ifndef UAVCAN_DATA_TYPE_REGISTRY_INDEX_CAPACITY
+# if UAVCAN_GENERAL_PURPOSE_PLATFORM && !UAVCAN_TINY
+#  define UAVCAN_DATA_TYPE_REGISTRY_INDEX_CAPACITY 512
+# else
+#  define UAVCAN_DATA_TYPE_REGISTRY_INDEX_CAPACITY 0
+# endif
+#endif
+
 /**
  * toString() methods will be disabled by default, unless the library is built for a general-purpose target like Linux.
  * It is not recommended to enable toString() on embedded targets as code size will explode.
@@ -151,6 +391,29 @@
 # define UAVCAN_USE_EXTERNAL_FLOAT16_CONVERSION 0
 #endif
 
+/**
+ * Use the float16 conversion instructions of the target if the compiler exposes them: F16C on x86 (e.g. -mf16c),
+ * NEON on AArch64, and the half-precision FPU extension on ARMv7 (e.g. Cortex-M4F/M7 with -mfp16-format=ieee).
+ * Arrays of float16 are then converted several elements per instruction where possible.
+ * Both the hardware and the software conversion round exact ties to even and encode NaNs in the same way,
+ * so the results do not depend on this option. Disabled by default.
+ * Has no effect if UAVCAN_USE_EXTERNAL_FLOAT16_CONVERSION is enabled.
+ */
+#ifndef UAVCAN_USE_HARDWARE_FLOAT16_CONVERSION
+# define UAVCAN_USE_HARDWARE_FLOAT16_CONVERSION 0
+#endif
+
+/**
+ * CAN FD support - frames carrying up to 64 bytes of data instead of 8.
+ * This makes every CAN frame object about 8 times larger, including the ones stored in the TX queue,
+ * so the memory pool block size is increased accordingly. The CAN driver must be able to transmit and receive
+ * CAN FD frames; see @ref ICanIface.
+ * Disabled by default.
+ */
+#ifndef UAVCAN_CAN_FD
+# define UAVCAN_CAN_FD 0
+#endif
+
 /**
  * Run time checks.
  * Resolves to the standard assert() by default.
@@ -183,6 +446,17 @@
 # endif
 #endif
 
+/**
+ * Keeps a function out of its callers, so that its stack frame is allocated only when it is actually called.
+ */
+#ifndef UAVCAN_NOINLINE
+# if __GNUC__
+#  define UAVCAN_NOINLINE __attribute__((noinline))
+# else
+#  define UAVCAN_NOINLINE
+# endif
+#endif
+
 namespace uavcan
 {
 /**
@@ -202,6 +476,9 @@ namespace uavcan
 #ifdef UAVCAN_MEM_POOL_BLOCK_SIZE
 /// Explicitly specified by the user.
 static const unsigned MemPoolBlockSize = UAVCAN_MEM_POOL_BLOCK_SIZE;
+#elif UAVCAN_CAN_FD
+/// TX queue entries contain a CAN FD frame, which doesn't fit the default block size.
+static const unsigned MemPoolBlockSize = 128;
 #elif defined(__BIGGEST_ALIGNMENT__) && (__BIGGEST_ALIGNMENT__ <= 8)
 /// Convenient default for GCC-like compilers - if alignment allows, pool block size can be safely reduced.
 static const unsigned MemPoolBlockSize = 56;
@@ -255,6 +532,220 @@ static const unsigned MaxCanAcceptanceFilters = UAVCAN_MAX_CAN_ACCEPTANCE_FILTER
 static const unsigned MaxCanAcceptanceFilters = 32;
 #endif
 
+/**
+ * Size of the hash index that the dispatcher uses to look up transfer listeners by data type ID.
+ * Every listener registry (messages, service requests, service responses) keeps its own index, which costs
+ * this number of pointers of RAM per registry. Must be a power of two; zero disables the index, in which case
+ * listeners are found by linear search through the sorted list.
+ * By default the index is enabled only on general-purpose platforms and in the bounded-time mode.
+ */
+#ifdef UAVCAN_DISPATCHER_LISTENER_INDEX_SIZE
+/// Explicitly specified by the user.
+static const unsigned DispatcherListenerIndexSize = UAVCAN_DISPATCHER_LISTENER_INDEX_SIZE;
+#elif UAVCAN_GENERAL_PURPOSE_PLATFORM || UAVCAN_BOUNDED_TIME
+static const unsigned DispatcherListenerIndexSize = 64;
+#else
+static const unsigned DispatcherListenerIndexSize = 0;
+#endif
+
+typedef char _power_of_two_check_for_DISPATCHER_LISTENER_INDEX_SIZE[
+    ((DispatcherListenerIndexSize & (DispatcherListenerIndexSize - 1)) == 0) ? 1 : -1];
+
+/**
+ * Number of data types that can be tracked by @ref DataTypePerfCounters, see UAVCAN_DATA_TYPE_PERF_STATS.
+ * The traffic of the data types that don't fit is accumulated in a single overflow entry.
+ * Must be a power of two.
+ */
+#ifdef UAVCAN_DATA_TYPE_PERF_STATS_CAPACITY
+/// Explicitly specified by the user.
+static const unsigned DataTypePerfStatsCapacity = UAVCAN_DATA_TYPE_PERF_STATS_CAPACITY;
+#else
+static const unsigned DataTypePerfStatsCapacity = 16;
+#endif
+
+typedef char _power_of_two_check_for_DATA_TYPE_PERF_STATS_CAPACITY[
+    ((DataTypePerfStatsCapacity > 0) && ((DataTypePerfStatsCapacity & (DataTypePerfStatsCapacity - 1)) == 0)) ?
+    1 : -1];
+
+/**
+ * Number of records of @ref EventTrace, see UAVCAN_EVENT_TRACE. Once the ring is full, the oldest records are
+ * overwritten. Must be a power of two.
+ */
+#ifdef UAVCAN_EVENT_TRACE_CAPACITY
+/// Explicitly specified by the user.
+static const unsigned EventTraceCapacity = UAVCAN_EVENT_TRACE_CAPACITY;
+#else
+static const unsigned EventTraceCapacity = 256;
+#endif
+
+typedef char _power_of_two_check_for_EVENT_TRACE_CAPACITY[
+    ((EventTraceCapacity > 0) && ((EventTraceCapacity & (EventTraceCapacity - 1)) == 0)) ? 1 : -1];
+
+/**
+ * Number of hash buckets that every transfer listener uses to look up transfer receivers by source node ID.
+ * Each bucket costs one pointer of RAM per transfer listener. One bucket turns the lookup into linear search.
+ * By default, the lookup is hashed only on general-purpose platforms and in
+ * the bounded-time mode.
+ */
+#ifdef UAVCAN_TRANSFER_LISTENER_NUM_RECEIVER_BUCKETS
+/// Explicitly specified by the user.
+static const unsigned TransferListenerNumReceiverBuckets = UAVCAN_TRANSFER_LISTENER_NUM_RECEIVER_BUCKETS;
+#elif UAVCAN_GENERAL_PURPOSE_PLATFORM || UAVCAN_BOUNDED_TIME
+static const unsigned TransferListenerNumReceiverBuckets = 32;
+#else
+static const unsigned TransferListenerNumReceiverBuckets = 1;
+#endif
+
+/**
+ * Number of hash buckets of @ref ReassemblyTable, which looks up the transfer receivers of all listeners of the node
+ * by listener, source node ID, and transfer type. Each bucket costs one pointer of RAM per table; the table is
+ * optional, so nothing is spent unless it is used.
+ */
+#ifdef UAVCAN_REASSEMBLY_TABLE_NUM_BUCKETS
+/// Explicitly specified by the user.
+static const unsigned ReassemblyTableNumBuckets = UAVCAN_REASSEMBLY_TABLE_NUM_BUCKETS;
+#else
+static const unsigned ReassemblyTableNumBuckets = 64;
+#endif
+
+/**
+ * Number of hash buckets that the outgoing transfer registry uses to look up the Transfer ID state by
+ * data type ID, transfer type and destination node ID. Each bucket costs one pointer of RAM per node.
+ * Zero makes the registry use the more compact Map<> container with linear search, which stores several
+ * entries per memory pool block. By default, the lookup is hashed only on general-purpose platforms and in
+ * the bounded-time mode.
+ */
+#ifdef UAVCAN_OUTGOING_TRANSFER_REGISTRY_NUM_BUCKETS
+/// Explicitly specified by the user.
+static const unsigned OutgoingTransferRegistryNumBuckets = UAVCAN_OUTGOING_TRANSFER_REGISTRY_NUM_BUCKETS;
+#elif UAVCAN_GENERAL_PURPOSE_PLATFORM || UAVCAN_BOUNDED_TIME
+static const unsigned OutgoingTransferRegistryNumBuckets = 64;
+#else
+static const unsigned OutgoingTransferRegistryNumBuckets = 0;
+#endif
+
+/**
+ * Number of hash buckets that every service client uses to match the responses with the pending calls.
+ * Each bucket costs one pointer of RAM per service client. One bucket turns the lookup into linear search.
+ * By default, the lookup is hashed only on general-purpose platforms and in
+ * the bounded-time mode.
+ */
+#ifdef UAVCAN_SERVICE_CLIENT_NUM_CALL_BUCKETS
+/// Explicitly specified by the user.
+static const unsigned ServiceClientNumCallBuckets = UAVCAN_SERVICE_CLIENT_NUM_CALL_BUCKETS;
+#elif UAVCAN_GENERAL_PURPOSE_PLATFORM || UAVCAN_BOUNDED_TIME
+static const unsigned ServiceClientNumCallBuckets = 32;
+#else
+static const unsigned ServiceClientNumCallBuckets = 1;
+#endif
+
+/**
+ * Maximum number of CAN frames the dispatcher fetches from the driver per select() call.
+ * The frames are buffered on the stack, so this costs roughly 40 bytes of stack per frame.
+ * Value of 1 means that every frame is read with a separate select() call, like in older versions of the library.
+ */
+#ifdef UAVCAN_DISPATCHER_RX_BATCH_SIZE
+/// Explicitly specified by the user.
+static const unsigned DispatcherRxBatchSize = UAVCAN_DISPATCHER_RX_BATCH_SIZE;
+#elif UAVCAN_GENERAL_PURPOSE_PLATFORM
+static const unsigned DispatcherRxBatchSize = 16;
+#else
+static const unsigned DispatcherRxBatchSize = 1;
+#endif
+
+/**
+ * Cache line size of the target, in bytes; must be a power of two.
+ * Used to align the memory chunks that the heap-based pool allocator obtains from the heap, see
+ * @ref HeapBasedPoolAllocator. Exact value only matters for performance.
+ */
+#ifdef UAVCAN_CACHE_LINE_SIZE
+/// Explicitly specified by the user.
+static const unsigned CacheLineSize = UAVCAN_CACHE_LINE_SIZE;
+#elif UAVCAN_GENERAL_PURPOSE_PLATFORM
+static const unsigned CacheLineSize = 64;
+#else
+static const unsigned CacheLineSize = 32;
+#endif
+
+typedef char _power_of_two_check_for_CACHE_LINE_SIZE[
+    ((CacheLineSize > 0) && ((CacheLineSize & (CacheLineSize - 1)) == 0)) ? 1 : -1];
+
+/**
+ * Maximum number of forwarding routes of @ref CanBridge.
+ */
+#ifdef UAVCAN_CAN_BRIDGE_MAX_ROUTES
+/// Explicitly specified by the user.
+static const unsigned CanBridgeMaxRoutes = UAVCAN_CAN_BRIDGE_MAX_ROUTES;
+#else
+static const unsigned CanBridgeMaxRoutes = 16;
+#endif
+
+/**
+ * Number of frames that @ref CanBridge can hold per direction while the destination bus is busy.
+ * Each frame costs roughly 32 bytes of RAM. A fully loaded 1 Mbit/s bus carries about 8 frames per millisecond.
+ */
+#ifdef UAVCAN_CAN_BRIDGE_QUEUE_CAPACITY
+/// Explicitly specified by the user.
+static const unsigned CanBridgeQueueCapacity = UAVCAN_CAN_BRIDGE_QUEUE_CAPACITY;
+#elif UAVCAN_GENERAL_PURPOSE_PLATFORM
+static const unsigned CanBridgeQueueCapacity = 256;
+#else
+static const unsigned CanBridgeQueueCapacity = 32;
+#endif
+
+/**
+ * Number of recently forwarded frames per bus that @ref CanBridge remembers to detect forwarding loops;
+ * must be a power of two. Each entry costs 16 bytes of RAM; it should be large enough to hold all frames
+ * forwarded within the loop guard window.
+ */
+#ifdef UAVCAN_CAN_BRIDGE_LOOP_GUARD_SIZE
+/// Explicitly specified by the user.
+static const unsigned CanBridgeLoopGuardSize = UAVCAN_CAN_BRIDGE_LOOP_GUARD_SIZE;
+#elif UAVCAN_GENERAL_PURPOSE_PLATFORM
+static const unsigned CanBridgeLoopGuardSize = 256;
+#else
+static const unsigned CanBridgeLoopGuardSize = 32;
+#endif
+
+typedef char _power_of_two_check_for_CAN_BRIDGE_LOOP_GUARD_SIZE[
+    ((CanBridgeLoopGuardSize > 0) && ((CanBridgeLoopGuardSize & (CanBridgeLoopGuardSize - 1)) == 0)) ? 1 : -1];
+
+/**
+ * Number of frame streams that @ref RedundantFrameFilter can track at once; must be a power of two, at least four.
+ * Each entry costs 16 bytes of RAM. The filter is not available if UAVCAN_TINY is set.
+ */
+#ifdef UAVCAN_REDUNDANT_FRAME_FILTER_SIZE
+/// Explicitly specified by the user.
+static const unsigned RedundantFrameFilterSize = UAVCAN_REDUNDANT_FRAME_FILTER_SIZE;
+#elif UAVCAN_GENERAL_PURPOSE_PLATFORM
+static const unsigned RedundantFrameFilterSize = 256;
+#else
+static const unsigned RedundantFrameFilterSize = 32;
+#endif
+
+typedef char _power_of_two_check_for_REDUNDANT_FRAME_FILTER_SIZE[
+    ((RedundantFrameFilterSize >= 4) && ((RedundantFrameFilterSize & (RedundantFrameFilterSize - 1)) == 0)) ? 1 : -1];
+
+/**
+ * Maximum number of dispatchers, i.e. nodes and sub nodes, that can be connected to one @ref LocalTransferBus.
+ */
+#ifdef UAVCAN_LOCAL_TRANSFER_BUS_MAX_DISPATCHERS
+/// Explicitly specified by the user.
+static const unsigned LocalTransferBusMaxDispatchers = UAVCAN_LOCAL_TRANSFER_BUS_MAX_DISPATCHERS;
+#else
+static const unsigned LocalTransferBusMaxDispatchers = 8;
+#endif
+
+/**
+ * Maximum number of message data types that can be delivered locally by one @ref LocalTransferBus.
+ */
+#ifdef UAVCAN_LOCAL_TRANSFER_BUS_MAX_DATA_TYPES
+/// Explicitly specified by the user.
+static const unsigned LocalTransferBusMaxDataTypes = UAVCAN_LOCAL_TRANSFER_BUS_MAX_DATA_TYPES;
+#else
+static const unsigned LocalTransferBusMaxDataTypes = 16;
+#endif
+
 }
 
 #endif // UAVCAN_BUILD_CONFIG_HPP_INCLUDED
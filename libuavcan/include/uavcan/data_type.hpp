@@ -10,12 +10,11 @@
 #include <uavcan/std.hpp>
 #include <uavcan/build_config.hpp>
 #include <uavcan/transport/transfer.hpp>
+#include <uavcan/transport/crc.hpp>
 
 namespace uavcan
 {
 
-class UAVCAN_EXPORT TransferCRC;
-
 enum DataTypeKind
 {
     DataTypeKindService,
@@ -55,7 +54,7 @@ public:
 
     DataTypeID() : value_(0xFFFFFFFFUL) { }
 
-    DataTypeID(uint16_t id)  // Implicit
+    UAVCAN_CONSTEXPR DataTypeID(uint16_t id)  // Implicit
         : value_(id)
     { }
 
@@ -101,27 +100,60 @@ public:
     void add(const uint8_t* bytes, unsigned len);
 
     uint64_t get() const { return crc_ ^ 0xFFFFFFFFFFFFFFFFULL; }
-};
 
+    /**
+     * Bitwise implementation that can be evaluated at compile time; operates on the raw register value,
+     * i.e. without the output xor. Adds the @p num_bytes least significant bytes of @p x, least significant first.
+     */
+    static UAVCAN_CONSTEXPR uint64_t addBitwise(uint64_t crc, uint64_t x, unsigned num_bytes)
+    {
+        return (num_bytes == 0) ? crc : addBitwise(shiftBitwise(crc ^ ((x & 0xFFU) << 56), 8), x >> 8, num_bytes - 1U);
+    }
+
+    static UAVCAN_CONSTEXPR uint64_t shiftBitwise(uint64_t crc, unsigned num_bits)
+    {
+        return (num_bits == 0) ? crc :
+               shiftBitwise((crc & (uint64_t(1) << 63)) ? ((crc << 1) ^ 0x42F0E1EBA9EA3693ULL) : (crc << 1),
+                            num_bits - 1U);
+    }
+};
 
+/**
+ * All methods except extend() can be evaluated at compile time in C++11 mode; the generated data types
+ * provide their signatures as compile-time constants as well.
+ */
 class UAVCAN_EXPORT DataTypeSignature
 {
     uint64_t value_;
 
-    void mixin64(uint64_t x);
+    static UAVCAN_CONSTEXPR uint64_t mixin64(uint64_t value, uint64_t x)
+    {
+        return DataTypeSignatureCRC::addBitwise(value ^ 0xFFFFFFFFFFFFFFFFULL, x, 8) ^ 0xFFFFFFFFFFFFFFFFULL;
+    }
 
 public:
-    DataTypeSignature() : value_(0) { }
-    explicit DataTypeSignature(uint64_t value) : value_(value) { }
+    UAVCAN_CONSTEXPR DataTypeSignature() : value_(0) { }
+    UAVCAN_CONSTEXPR explicit DataTypeSignature(uint64_t value) : value_(value) { }
 
-    void extend(DataTypeSignature dts);
+    void extend(DataTypeSignature dts) { *this = extended(dts); }
 
-    TransferCRC toTransferCRC() const;
+    /**
+     * Same as @ref extend(), but returns the result instead of modifying this object.
+     */
+    UAVCAN_CONSTEXPR DataTypeSignature extended(DataTypeSignature dts) const
+    {
+        return DataTypeSignature(mixin64(mixin64(value_, dts.value_), value_));
+    }
+
+    UAVCAN_CONSTEXPR TransferCRC toTransferCRC() const
+    {
+        return TransferCRC(TransferCRC::addBitwise(TransferCRC().get(), value_, 8));
+    }
 
-    uint64_t get() const { return value_; }
+    UAVCAN_CONSTEXPR uint64_t get() const { return value_; }
 
-    bool operator==(DataTypeSignature rhs) const { return value_ == rhs.value_; }
-    bool operator!=(DataTypeSignature rhs) const { return !operator==(rhs); }
+    UAVCAN_CONSTEXPR bool operator==(DataTypeSignature rhs) const { return value_ == rhs.value_; }
+    UAVCAN_CONSTEXPR bool operator!=(DataTypeSignature rhs) const { return !operator==(rhs); }
 };
 
 /**
@@ -153,6 +185,23 @@ public:
         UAVCAN_ASSERT(std::strlen(name) <= MaxFullNameLen);
     }
 
+    /**
+     * Tag for the constructor below.
+     */
+    struct ConstantInit { };
+
+    /**
+     * Allows to create descriptors at compile time, see UAVCAN_STATIC_DATA_TYPE_REGISTRY.
+     * The arguments are not validated here; use @ref isValid().
+     */
+    UAVCAN_CONSTEXPR DataTypeDescriptor(ConstantInit, DataTypeKind kind, DataTypeID id, DataTypeSignature signature,
+                                        const char* name) :
+        signature_(signature),
+        full_name_(name),
+        kind_(kind),
+        id_(id)
+    { }
+
     bool isValid() const;
 
     DataTypeKind getKind() const { return kind_; }
@@ -29,11 +29,16 @@ struct UAVCAN_EXPORT CanFrame
     static const uint32_t FlagRTR = 1U << 30;                  ///< Remote transmission request
     static const uint32_t FlagERR = 1U << 29;                  ///< Error frame
 
-    static const uint8_t MaxDataLen = 8;
+    static const uint8_t MaxClassicDataLen = 8;             ///< Classic CAN (2.0A/B)
+#if UAVCAN_CAN_FD
+    static const uint8_t MaxDataLen = 64;                   ///< CAN FD
+#else
+    static const uint8_t MaxDataLen = MaxClassicDataLen;
+#endif
 
     uint32_t id;                ///< CAN ID with flags (above)
     uint8_t data[MaxDataLen];
-    uint8_t dlc;                ///< Data Length Code
+    uint8_t dlc;                ///< Data length in bytes; for CAN FD it may differ from the DLC field, see below
 
     CanFrame() :
         id(0),
@@ -61,6 +66,25 @@ struct UAVCAN_EXPORT CanFrame
     bool isRemoteTransmissionRequest() const { return id & FlagRTR; }
     bool isErrorFrame()                const { return id & FlagERR; }
 
+    /**
+     * True if the frame can't be transmitted as a classic CAN frame, i.e. it requires CAN FD.
+     */
+    bool isCanFD() const { return dlc > MaxClassicDataLen; }
+
+    /**
+     * CAN FD DLC mapping. Above 8 bytes, only the lengths 12, 16, 20, 24, 32, 48 and 64 can be represented.
+     * Classic CAN uses only the codes 0..8, which map to themselves.
+     * Lengths that are not representable are rounded up to the nearest representable length.
+     */
+    static uint8_t dlcToDataLength(uint8_t dlc);
+    static uint8_t dataLengthToDlc(uint8_t data_len);
+
+    /**
+     * Returns the largest representable data length that does not exceed the argument nor MaxDataLen.
+     * With classic CAN it's simply min(data_len, 8).
+     */
+    static uint8_t roundDownDataLength(unsigned data_len);
+
 #if UAVCAN_TOSTRING
     enum StringRepresentation
     {
@@ -126,13 +150,41 @@ struct UAVCAN_EXPORT CanSelectMasks
  *                                affect the case of arbitration loss, in which case the retransmission will work
  *                                as usual. This flag is used together with anonymous messages which allows to
  *                                implement CSMA bus access. Read the spec for details.
+ *
+ * @ref CanIOFlagReplacePending - Used by the library internally, never passed to the driver. A queued single-frame
+ *                                transfer carrying this flag is replaced by a newer one of the same data type,
+ *                                transfer type, and source (and destination) node, see @ref CanTxQueue.
  */
 typedef uint16_t CanIOFlags;
 static const CanIOFlags CanIOFlagLoopback = 1;
 static const CanIOFlags CanIOFlagAbortOnError = 2;
+static const CanIOFlags CanIOFlagReplacePending = 4;
+
+/**
+ * Received CAN frame with timestamps, as returned by @ref ICanIface::receiveBatch().
+ * The interface index is assigned by the library, drivers don't need to set it.
+ */
+struct UAVCAN_EXPORT CanRxFrame : public CanFrame
+{
+    MonotonicTime ts_mono;
+    UtcTime ts_utc;
+    uint8_t iface_index;
+
+    CanRxFrame()
+        : iface_index(0)
+    { }
+
+#if UAVCAN_TOSTRING
+    std::string toString(StringRepresentation mode = StrTight) const;
+#endif
+};
 
 /**
  * Single non-blocking CAN interface.
+ *
+ * If the library is built with UAVCAN_CAN_FD, the frames longer than 8 bytes (@ref CanFrame::isCanFD()) must be
+ * transmitted as CAN FD frames, and received CAN FD frames must be reported with their full data length.
+ * The data length of such frames is always representable by the CAN FD DLC (@ref CanFrame::dataLengthToDlc()).
  */
 class UAVCAN_EXPORT ICanIface
 {
@@ -172,6 +224,47 @@ public:
     virtual int16_t receive(CanFrame& out_frame, MonotonicTime& out_ts_monotonic, UtcTime& out_ts_utc,
                             CanIOFlags& out_flags) = 0;
 
+    /**
+     * Non-blocking reception of multiple frames at once.
+     *
+     * This method is optional. The default implementation calls @ref receive() repeatedly until the RX buffer is
+     * empty or the output arrays are full. Drivers can override it if the underlying platform allows to fetch
+     * several frames at once more efficiently (e.g. with one system call).
+     *
+     * The semantics of timestamps and flags are the same as for @ref receive().
+     *
+     * @param [out] out_frames   Array of at least max_frames frames; iface_index should be left untouched.
+     * @param [out] out_flags    Array of at least max_frames flags, one per frame.
+     * @param [in]  max_frames   Maximum number of frames to read.
+     * @return Number of frames received (0 if RX buffer is empty), negative for error.
+     */
+    virtual int16_t receiveBatch(CanRxFrame* out_frames, CanIOFlags* out_flags, uint16_t max_frames);
+
+    /**
+     * Non-blocking lookup of the frame that the next call of @ref receive() would return; the frame is left in
+     * the RX buffer. This allows the library to process the frames of several interfaces in the order of CAN
+     * arbitration rather than in the order of interface indexes.
+     *
+     * This method is optional. The default implementation returns -ErrNotSupported; the frames of such
+     * interfaces are processed in the order of interface indexes after the frames of the interfaces that
+     * support it.
+     *
+     * @param [out] out_can_id   CAN ID of the frame with the flags, see @ref CanFrame::id.
+     * @return 1 = frame is available, 0 = RX buffer empty, negative if not supported or error.
+     */
+    virtual int16_t peekRxFrameId(uint32_t& out_can_id);
+
+    /**
+     * Number of frames that @ref send() would accept right now in a row, without an intermediate select() call.
+     * Drivers that keep their own TX queue (e.g. refilled from the TX interrupt) and transmit its frames in the
+     * order of CAN arbitration, preserving the order of frames with the same CAN ID, can report its free space here;
+     * the library then hands the pending frames off to the driver in batches rather than one per select() call, so
+     * that the transmission continues back-to-back regardless of how often the library is spinning.
+     *
+     * This method is optional. The default implementation returns zero, which means one frame per select() call.
+     */
+    virtual uint16_t getNumFreeTxSlots() const;
+
     /**
      * Configure the hardware CAN filters. @ref CanFilterConfig.
      *
@@ -184,6 +277,16 @@ public:
      */
     virtual uint16_t getNumFilters() const = 0;
 
+    /**
+     * Number of hardware filters that @ref configureFilters() would use for the specified configuration.
+     * Drivers that can pack several configurations into one hardware filter (e.g. exact CAN IDs into a filter
+     * bank in list mode) can override this, so that the library merges the configurations only as far as
+     * necessary to fit @ref getNumFilters(); the result must not exceed the number of configurations.
+     *
+     * This method is optional. The default implementation returns num_configs, i.e. one filter per configuration.
+     */
+    virtual uint16_t getNumFiltersRequired(const CanFilterConfig* filter_configs, uint16_t num_configs) const;
+
     /**
      * Continuously incrementing counter of hardware errors.
      * Arbitration lost should not be treated as a hardware error.
@@ -0,0 +1,36 @@
+/*
+ * Cycle counter driver interface.
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_DRIVER_CYCLE_COUNTER_HPP_INCLUDED
+#define UAVCAN_DRIVER_CYCLE_COUNTER_HPP_INCLUDED
+
+#include <uavcan/std.hpp>
+#include <uavcan/build_config.hpp>
+
+namespace uavcan
+{
+/**
+ * High resolution free-running counter used to measure the execution time, see UAVCAN_EXECUTION_TIME_STATS.
+ * This interface is optional; the library does not use it unless the application installs it.
+ */
+class UAVCAN_EXPORT ICycleCounter
+{
+public:
+    virtual ~ICycleCounter() { }
+
+    /**
+     * Returns the current value of the counter. The counter shall increment at a constant rate, preferably the
+     * CPU clock rate, and it may wrap around; the intervals are computed modulo 2^32.
+     * This method is called twice per measured stage, so it should take only a few cycles.
+     *
+     * On ARMv7-M (Cortex-M3/M4/M7) use the DWT CYCCNT register. On x86 use RDTSC; on other POSIX systems
+     * clock_gettime() with CLOCK_MONOTONIC_RAW in nanoseconds will do.
+     */
+    virtual uint32_t getCycleCount() const = 0;
+};
+
+}
+
+#endif // UAVCAN_DRIVER_CYCLE_COUNTER_HPP_INCLUDED
@@ -15,6 +15,75 @@
 
 namespace uavcan
 {
+/**
+ * Library subsystems that the pool memory usage is attributed to, see @ref PoolUsageTracker.
+ */
+enum PoolUsageTag
+{
+    PoolUsageTagOther,                      ///< Everything that is not listed below, including the application
+    PoolUsageTagTxQueue,                    ///< CAN TX queue entries
+    PoolUsageTagTransferReceivers,          ///< Transfer receiver state (per data type, per remote node)
+    PoolUsageTagTransferBuffers,            ///< Buffers of multi-frame transfers being received
+    PoolUsageTagOutgoingTransferRegistry,   ///< Transfer ID state of the outgoing transfers
+    PoolUsageTagServiceCalls,               ///< Pending service calls
+    NumPoolUsageTags
+};
+
+#if UAVCAN_POOL_USAGE_TRACKING
+/**
+ * Keeps the number of currently used blocks and its peak value per subsystem.
+ * An instance is owned by the pool allocator; it can be accessed via @ref IPoolAllocator::getUsageTracker().
+ *
+ * Only the allocations made via @ref TaggedPoolAllocator are counted; the library containers use it internally.
+ * The tracker is not synchronized, so the counters may be inaccurate if the pool is shared between threads.
+ */
+class UAVCAN_EXPORT PoolUsageTracker : Noncopyable
+{
+public:
+    struct Snapshot
+    {
+        uint16_t num_used_blocks[NumPoolUsageTags];
+        uint16_t peak_num_used_blocks[NumPoolUsageTags];
+    };
+
+private:
+    Snapshot state_;
+
+public:
+    PoolUsageTracker() { reset(); }
+
+    void registerAllocation(PoolUsageTag tag);
+    void registerDeallocation(PoolUsageTag tag);
+
+    uint16_t getNumUsedBlocks(PoolUsageTag tag) const
+    {
+        return (tag < NumPoolUsageTags) ? state_.num_used_blocks[tag] : 0;
+    }
+
+    /**
+     * Returns the maximum number of blocks used by the given subsystem at the same time.
+     * Note that the subsystems don't necessarily peak at the same time, so the sum of the peak values can exceed
+     * the peak usage of the pool.
+     */
+    uint16_t getPeakNumUsedBlocks(PoolUsageTag tag) const
+    {
+        return (tag < NumPoolUsageTags) ? state_.peak_num_used_blocks[tag] : 0;
+    }
+
+    /**
+     * Returns the counters of all subsystems at once.
+     */
+    Snapshot getSnapshot() const { return state_; }
+
+    /**
+     * Resets the peak values to the current values.
+     */
+    void resetPeaks();
+
+    void reset();
+};
+#endif
+
 /**
  * This interface is used by other library components that need dynamic memory.
  */
@@ -30,7 +99,69 @@ public:
      * Returns the maximum number of blocks this allocator can allocate.
      */
     virtual uint16_t getBlockCapacity() const = 0;
+
+    /**
+     * Allocates up to num_blocks blocks of the specified size at once.
+     * Returns the number of blocks actually allocated; the pointers are stored in out_ptrs.
+     * Default implementation calls allocate() in a loop; thread-safe allocators can override this in order to
+     * take the lock only once per batch.
+     */
+    virtual unsigned allocateBatch(std::size_t size, void** out_ptrs, unsigned num_blocks);
+
+    /**
+     * Deallocates num_blocks blocks at once.
+     * Default implementation calls deallocate() in a loop.
+     */
+    virtual void deallocateBatch(void* const* ptrs, unsigned num_blocks);
+
+    /**
+     * Returns the allocator that the given subsystem should allocate its memory from; the library containers
+     * select it once upon construction. Default implementation returns this allocator itself,
+     * see @ref PartitionedPoolAllocator.
+     */
+    virtual IPoolAllocator& getPartition(PoolUsageTag tag)
+    {
+        (void)tag;
+        return *this;
+    }
+
+#if UAVCAN_POOL_USAGE_TRACKING
+    /**
+     * Returns the tracker that the allocations via @ref TaggedPoolAllocator should be registered with,
+     * or NULL if this allocator doesn't support usage tracking (this is the default).
+     */
+    virtual PoolUsageTracker* getUsageTracker() { return NULL; }
+#endif
+};
+
+#if UAVCAN_POOL_USAGE_TRACKING
+/**
+ * Forwards all calls to the underlying allocator and registers them with its usage tracker under the given tag.
+ *
+ * This allocator doesn't provide a usage tracker of its own, so nested tagged allocators that are constructed
+ * on top of it do not count anything; i.e. the memory is attributed to the outermost tag.
+ */
+class UAVCAN_EXPORT TaggedPoolAllocator : public IPoolAllocator
+{
+    IPoolAllocator& allocator_;
+    PoolUsageTracker* const tracker_;
+    const PoolUsageTag tag_;
+
+public:
+    TaggedPoolAllocator(IPoolAllocator& allocator, PoolUsageTag tag)
+        : allocator_(allocator.getPartition(tag))
+        , tracker_(allocator.getUsageTracker())
+        , tag_(tag)
+    { }
+
+    virtual void* allocate(std::size_t size);
+    virtual void deallocate(const void* ptr);
+
+    virtual uint16_t getBlockCapacity() const { return allocator_.getBlockCapacity(); }
+
+    PoolUsageTag getTag() const { return tag_; }
 };
+#endif
 
 /**
  * Classic implementation of a pool allocator (Meyers).
@@ -68,6 +199,9 @@ class UAVCAN_EXPORT PoolAllocator : public IPoolAllocator,
 
     uint16_t used_;
     uint16_t max_used_;
+#if UAVCAN_POOL_USAGE_TRACKING
+    PoolUsageTracker usage_tracker_;
+#endif
 
 public:
     static const uint16_t NumBlocks = PoolSize / BlockSize;
@@ -79,6 +213,13 @@ public:
 
     virtual uint16_t getBlockCapacity() const { return NumBlocks; }
 
+    virtual unsigned allocateBatch(std::size_t size, void** out_ptrs, unsigned num_blocks);
+    virtual void deallocateBatch(void* const* ptrs, unsigned num_blocks);
+
+#if UAVCAN_POOL_USAGE_TRACKING
+    virtual PoolUsageTracker* getUsageTracker() { return &usage_tracker_; }
+#endif
+
     /**
      * Return the number of blocks that are currently allocated/unallocated.
      */
@@ -106,28 +247,485 @@ public:
     }
 };
 
+/**
+ * Block budget shared by several @ref LimitedPoolAllocator instances.
+ * Every member is guaranteed its own number of blocks; beyond that, the members borrow the blocks of the budget
+ * that are not committed to anyone else. A part of the budget can be reserved for high priority allocations,
+ * so that low priority allocations of one member can't consume it.
+ */
+class UAVCAN_EXPORT SharedPoolQuota : Noncopyable
+{
+    uint16_t max_blocks_;
+    uint16_t reserved_blocks_;
+    uint16_t committed_blocks_;         ///< Sum of guaranteed and borrowed blocks of all members
+
+public:
+    SharedPoolQuota()
+        : max_blocks_(0)
+        , reserved_blocks_(0)
+        , committed_blocks_(0)
+    { }
+
+    void setLimits(uint16_t max_blocks, uint16_t reserved_blocks)
+    {
+        max_blocks_ = max_blocks;
+        reserved_blocks_ = min(reserved_blocks, max_blocks);
+    }
+
+    /**
+     * Number of blocks that can be borrowed right now.
+     */
+    uint16_t getNumBorrowableBlocks(bool high_priority) const
+    {
+        const unsigned limit = high_priority ? max_blocks_ : unsigned(max_blocks_ - reserved_blocks_);
+        return (limit > committed_blocks_) ? static_cast<uint16_t>(limit - committed_blocks_) : uint16_t(0);
+    }
+
+    bool borrow(bool high_priority)
+    {
+        if (getNumBorrowableBlocks(high_priority) > 0)
+        {
+            committed_blocks_++;
+            return true;
+        }
+        return false;
+    }
+
+    void giveBack(uint16_t num_blocks = 1)
+    {
+        UAVCAN_ASSERT(committed_blocks_ >= num_blocks);
+        committed_blocks_ = (committed_blocks_ > num_blocks) ? static_cast<uint16_t>(committed_blocks_ - num_blocks)
+                                                               : uint16_t(0);
+    }
+
+    /**
+     * Commits the blocks unconditionally; this is used to account for the guaranteed blocks of a new member.
+     */
+    void commit(uint16_t num_blocks)
+    {
+        committed_blocks_ = static_cast<uint16_t>(min(unsigned(committed_blocks_) + num_blocks, 0xFFFFU));
+    }
+
+    uint16_t getMaxBlocks() const { return max_blocks_; }
+    uint16_t getNumReservedBlocks() const { return reserved_blocks_; }
+    uint16_t getNumCommittedBlocks() const { return committed_blocks_; }
+};
+
 /**
  * Limits the maximum number of blocks that can be allocated in a given allocator.
+ * If pool usage tracking is enabled, the allocated blocks are attributed to the specified subsystem tag.
+ *
+ * Alternatively, the limit can be taken from a @ref SharedPoolQuota, see @ref setSharedQuota().
  */
 class LimitedPoolAllocator : public IPoolAllocator
 {
+#if UAVCAN_POOL_USAGE_TRACKING
+    TaggedPoolAllocator allocator_;
+#else
     IPoolAllocator& allocator_;
+#endif
+    SharedPoolQuota* shared_quota_;
     const uint16_t max_blocks_;
+    uint16_t guaranteed_blocks_;        ///< Used only with the shared quota
     uint16_t used_blocks_;
 
+    uint16_t getNumCommittedBlocks() const { return max(used_blocks_, guaranteed_blocks_); }
+
 public:
-    LimitedPoolAllocator(IPoolAllocator& allocator, std::size_t max_blocks)
-        : allocator_(allocator)
+    LimitedPoolAllocator(IPoolAllocator& allocator, std::size_t max_blocks, PoolUsageTag tag = PoolUsageTagOther)
+#if UAVCAN_POOL_USAGE_TRACKING
+        : allocator_(allocator, tag)
+#else
+        : allocator_(allocator.getPartition(tag))
+#endif
+        , shared_quota_(NULL)
         , max_blocks_(static_cast<uint16_t>(min<std::size_t>(max_blocks, 0xFFFFU)))
+        , guaranteed_blocks_(0)
         , used_blocks_(0)
     {
         UAVCAN_ASSERT(max_blocks_ > 0);
     }
 
+    ~LimitedPoolAllocator() { setSharedQuota(NULL, 0); }
+
+    /**
+     * Replaces the fixed limit with the specified number of guaranteed blocks plus the blocks that can be borrowed
+     * from the shared quota. Null pointer restores the fixed limit. The blocks that are already allocated are
+     * accounted for, so this can be done at any time; the quota object must outlive the allocator.
+     */
+    void setSharedQuota(SharedPoolQuota* quota, uint16_t guaranteed_blocks);
+    SharedPoolQuota* getSharedQuota() const { return shared_quota_; }
+
     virtual void* allocate(std::size_t size);
     virtual void deallocate(const void* ptr);
 
+    /**
+     * High priority allocations may use the reserved part of the shared quota.
+     * Without the shared quota this is the same as the plain allocate().
+     */
+    void* allocate(std::size_t size, bool high_priority);
+
     virtual uint16_t getBlockCapacity() const;
+
+    uint16_t getNumUsedBlocks() const { return used_blocks_; }
+
+    /**
+     * Remaining quota; the underlying allocator may run out of blocks earlier if it is shared.
+     */
+    uint16_t getNumFreeBlocks() const
+    {
+        const uint16_t capacity = getBlockCapacity();
+        return (capacity > used_blocks_) ? static_cast<uint16_t>(capacity - used_blocks_) : uint16_t(0);
+    }
+};
+
+/**
+ * Splits the underlying allocator between the library subsystems listed in @ref PoolUsageTag, so that a burst
+ * in one subsystem (e.g. reassembly of large incoming transfers) can't take the memory that is reserved for the
+ * others (e.g. the TX queues). Every subsystem is guaranteed its reserved number of blocks, and may use the blocks
+ * that are not reserved by anyone else; nothing is reserved by default.
+ *
+ * The library containers allocate from their partition via @ref getPartition(); everything else, including the
+ * application, allocates directly from this allocator, which is accounted as @ref PoolUsageTagOther.
+ * The memory must be deallocated via the same allocator it was allocated from.
+ *
+ * Usage example:
+ *   uavcan::PoolAllocator<16384, uavcan::MemPoolBlockSize> pool;
+ *   uavcan::PartitionedPoolAllocator allocator(pool);
+ *   allocator.setReservation(uavcan::PoolUsageTagTxQueue, 64);
+ *   uavcan::Node<> node(can_driver, system_clock, allocator);
+ */
+class UAVCAN_EXPORT PartitionedPoolAllocator : public IPoolAllocator,
+                                               Noncopyable
+{
+    class Partition : public IPoolAllocator
+    {
+        IPoolAllocator* allocator_;
+        SharedPoolQuota* quota_;
+        uint16_t reserved_blocks_;
+        uint16_t used_blocks_;
+
+        uint16_t getNumCommittedBlocks() const { return max(used_blocks_, reserved_blocks_); }
+
+    public:
+        Partition()
+            : allocator_(NULL)
+            , quota_(NULL)
+            , reserved_blocks_(0)
+            , used_blocks_(0)
+        { }
+
+        void init(IPoolAllocator& allocator, SharedPoolQuota& quota)
+        {
+            allocator_ = &allocator;
+            quota_ = &quota;
+        }
+
+        void setReservation(uint16_t num_blocks);
+        uint16_t getReservation() const { return reserved_blocks_; }
+        uint16_t getNumUsedBlocks() const { return used_blocks_; }
+
+        virtual void* allocate(std::size_t size);
+        virtual void deallocate(const void* ptr);
+        virtual uint16_t getBlockCapacity() const;
+    };
+
+    IPoolAllocator& allocator_;
+    SharedPoolQuota quota_;
+    Partition partitions_[NumPoolUsageTags];
+
+public:
+    explicit PartitionedPoolAllocator(IPoolAllocator& allocator);
+
+    /**
+     * Sets the number of blocks guaranteed to the subsystem. The blocks that are already in use by the subsystem
+     * count against its reservation. The sum of all reservations can't exceed the capacity of the underlying
+     * allocator. Returns negative error code.
+     */
+    int setReservation(PoolUsageTag tag, uint16_t num_blocks);
+    uint16_t getReservation(PoolUsageTag tag) const;
+
+    uint16_t getNumUsedBlocks(PoolUsageTag tag) const;
+
+    /**
+     * Number of blocks the subsystem can allocate right now, counting its unused reservation.
+     */
+    uint16_t getNumFreeBlocks(PoolUsageTag tag) const;
+
+    virtual void* allocate(std::size_t size);
+    virtual void deallocate(const void* ptr);
+
+    virtual uint16_t getBlockCapacity() const { return allocator_.getBlockCapacity(); }
+
+    virtual IPoolAllocator& getPartition(PoolUsageTag tag);
+
+#if UAVCAN_POOL_USAGE_TRACKING
+    virtual PoolUsageTracker* getUsageTracker() { return allocator_.getUsageTracker(); }
+#endif
+};
+
+/**
+ * Serves the allocations from its own statically allocated blocks first, and from the fallback allocator once
+ * they are exhausted. This guarantees NumBlocks blocks to a single user regardless of the load on the shared pool,
+ * and the allocation from the own blocks takes constant time. Requests for more than one block are never served
+ * by the fallback allocator, so the own blocks are not bypassed by the contiguous allocations.
+ */
+template <uint16_t NumBlocks>
+class UAVCAN_EXPORT ReservedPoolAllocator : public IPoolAllocator,
+                                            Noncopyable
+{
+    PoolAllocator<std::size_t(NumBlocks) * MemPoolBlockSize, MemPoolBlockSize> reserved_;
+    IPoolAllocator& fallback_;
+    uint32_t num_fallback_allocations_;
+
+    bool isReserved(const void* ptr) const
+    {
+        const uint8_t* const p = static_cast<const uint8_t*>(ptr);
+        const uint8_t* const begin = reinterpret_cast<const uint8_t*>(&reserved_);
+        return (p >= begin) && (p < (begin + sizeof(reserved_)));
+    }
+
+public:
+    explicit ReservedPoolAllocator(IPoolAllocator& fallback)
+        : fallback_(fallback)
+        , num_fallback_allocations_(0)
+    {
+        StaticAssert<(NumBlocks > 0)>::check();
+    }
+
+    virtual void* allocate(std::size_t size)
+    {
+        void* ptr = reserved_.allocate(size);
+        if ((ptr == NULL) && (size <= MemPoolBlockSize))
+        {
+            ptr = fallback_.allocate(size);
+            if (ptr != NULL)
+            {
+                num_fallback_allocations_++;
+            }
+        }
+        return ptr;
+    }
+
+    virtual void deallocate(const void* ptr)
+    {
+        if (ptr == NULL)
+        {
+            return;
+        }
+        if (isReserved(ptr))
+        {
+            reserved_.deallocate(ptr);
+        }
+        else
+        {
+            fallback_.deallocate(ptr);
+        }
+    }
+
+    virtual uint16_t getBlockCapacity() const
+    {
+        return static_cast<uint16_t>(min(unsigned(NumBlocks) + fallback_.getBlockCapacity(), 0xFFFFU));
+    }
+
+    uint16_t getNumReservedBlocks() const { return NumBlocks; }
+
+    /**
+     * Number of the own blocks in use.
+     */
+    uint16_t getNumUsedReservedBlocks() const { return reserved_.getNumUsedBlocks(); }
+
+    /**
+     * How many times the own blocks were exhausted and the fallback allocator had to be used.
+     */
+    uint32_t getNumFallbackAllocations() const { return num_fallback_allocations_; }
+};
+
+/**
+ * Pool allocator with several fixed size classes: 16, 32, 64, 128 and 256 bytes.
+ *
+ * Each allocation is served from the smallest size class that can fit the requested size; if that class is
+ * exhausted, the next larger class is used. This allows to reduce memory footprint compared to PoolAllocator<>,
+ * where every object is padded to the same block size, at the cost of having to configure the number of blocks
+ * per size class. A size class can be disabled by setting its number of blocks to zero.
+ *
+ * Thread safety is optional and works the same way as in PoolAllocator<>.
+ */
+template <uint16_t NumBlocks16,
+          uint16_t NumBlocks32,
+          uint16_t NumBlocks64,
+          uint16_t NumBlocks128,
+          uint16_t NumBlocks256,
+          typename RaiiSynchronizer = char>
+class UAVCAN_EXPORT MultiPoolAllocator : public IPoolAllocator,
+                                         Noncopyable
+{
+public:
+    enum { NumSizeClasses = 5 };
+    enum { MinBlockSize = 16 };
+
+    static const std::size_t PoolSize = std::size_t(NumBlocks16) * 16U + std::size_t(NumBlocks32) * 32U +
+                                        std::size_t(NumBlocks64) * 64U + std::size_t(NumBlocks128) * 128U +
+                                        std::size_t(NumBlocks256) * 256U;
+
+    static const unsigned NumBlocks = unsigned(NumBlocks16) + unsigned(NumBlocks32) + unsigned(NumBlocks64) +
+                                      unsigned(NumBlocks128) + unsigned(NumBlocks256);
+
+private:
+    struct Node
+    {
+        Node* next;
+    };
+
+    struct SizeClass
+    {
+        Node* free_list;
+        uint16_t used;
+        uint16_t max_used;
+    };
+
+    SizeClass classes_[NumSizeClasses];
+#if UAVCAN_POOL_USAGE_TRACKING
+    PoolUsageTracker usage_tracker_;
+#endif
+    union
+    {
+         uint8_t bytes[PoolSize];
+         long double _aligner1;
+         long long _aligner2;
+         Node _aligner3;
+    } pool_;
+
+    static std::size_t getSizeClassOffset(unsigned size_class);
+
+public:
+    MultiPoolAllocator();
+
+    virtual void* allocate(std::size_t size);
+    virtual void deallocate(const void* ptr);
+
+    virtual uint16_t getBlockCapacity() const { return uint16_t(NumBlocks); }
+
+#if UAVCAN_POOL_USAGE_TRACKING
+    virtual PoolUsageTracker* getUsageTracker() { return &usage_tracker_; }
+#endif
+
+    /**
+     * Block size of the given size class, in bytes.
+     */
+    static uint16_t getBlockSize(unsigned size_class)
+    {
+        UAVCAN_ASSERT(size_class < NumSizeClasses);
+        return uint16_t(unsigned(MinBlockSize) << size_class);
+    }
+
+    /**
+     * Total number of blocks in the given size class, as configured via the template arguments.
+     */
+    static uint16_t getNumBlocks(unsigned size_class);
+
+    /**
+     * Return the number of blocks that are currently allocated in the given size class.
+     */
+    uint16_t getNumUsedBlocks(unsigned size_class) const
+    {
+        RaiiSynchronizer lock;
+        (void)lock;
+        return (size_class < NumSizeClasses) ? classes_[size_class].used : 0;
+    }
+
+    /**
+     * Return the number of blocks that are currently allocated, all size classes combined.
+     */
+    uint16_t getNumUsedBlocks() const;
+
+    /**
+     * Returns the maximum number of blocks in the given size class that were ever allocated at the same time.
+     */
+    uint16_t getPeakNumUsedBlocks(unsigned size_class) const
+    {
+        RaiiSynchronizer lock;
+        (void)lock;
+        return (size_class < NumSizeClasses) ? classes_[size_class].max_used : 0;
+    }
+};
+
+/**
+ * Unsynchronized front-end for a shared thread-safe allocator.
+ *
+ * Each thread that uses the shared allocator (e.g. a Node and its SubNodes running in different threads) should
+ * have its own instance of this class. Freed blocks are kept in a local magazine and reused without locking;
+ * the magazine is refilled from and flushed to the shared allocator in batches of MagazineSize / 2 blocks, so the
+ * shared lock is taken once per batch rather than once per block.
+ *
+ * All blocks are requested from the shared allocator with the same size (BlockSize), so that any cached block can
+ * serve any request; requests larger than that will fail, same as with PoolAllocator<>.
+ *
+ * Note that the shared allocator counts the blocks cached in magazines as used, since they are not available to
+ * other threads. The number of blocks actually held by the application via this instance is reported by
+ * getNumUsedBlocks() and getPeakNumUsedBlocks(), which have the same semantics as in PoolAllocator<>.
+ * The pool usage tracker of the shared allocator is not accessible via this class, because it is not synchronized;
+ * hence the allocations made via magazines are not attributed to the subsystems.
+ *
+ * This class is NOT thread-safe; an instance must be used only from the thread that owns it.
+ */
+template <unsigned MagazineSize, std::size_t BlockSize = MemPoolBlockSize>
+class UAVCAN_EXPORT PoolAllocatorMagazine : public IPoolAllocator,
+                                            Noncopyable
+{
+    enum { BatchSize = (MagazineSize + 1U) / 2U };
+
+    IPoolAllocator& shared_;
+    void* blocks_[MagazineSize];
+    uint16_t num_cached_;
+    uint16_t used_;
+    uint16_t max_used_;
+
+public:
+    explicit PoolAllocatorMagazine(IPoolAllocator& shared_allocator) :
+        shared_(shared_allocator),
+        num_cached_(0),
+        used_(0),
+        max_used_(0)
+    {
+        StaticAssert<(MagazineSize >= 2)>::check();
+        StaticAssert<(MagazineSize <= 0xFFFFU)>::check();
+    }
+
+    /**
+     * Returns all cached blocks to the shared allocator.
+     * Blocks that are currently held by the application will be returned to the shared allocator upon deallocation.
+     */
+    ~PoolAllocatorMagazine() { flush(); }
+
+    virtual void* allocate(std::size_t size);
+    virtual void deallocate(const void* ptr);
+
+    virtual uint16_t getBlockCapacity() const { return shared_.getBlockCapacity(); }
+
+    /**
+     * Returns all cached blocks to the shared allocator.
+     */
+    void flush()
+    {
+        shared_.deallocateBatch(blocks_, num_cached_);
+        num_cached_ = 0;
+    }
+
+    /**
+     * Number of blocks that are currently held by the application via this instance.
+     */
+    uint16_t getNumUsedBlocks() const { return used_; }
+
+    /**
+     * Returns the maximum number of blocks that were ever held by the application via this instance at once.
+     */
+    uint16_t getPeakNumUsedBlocks() const { return max_used_; }
+
+    /**
+     * Number of free blocks that are cached locally and therefore unavailable to other threads.
+     */
+    uint16_t getNumCachedBlocks() const { return num_cached_; }
 };
 
 // ----------------------------------------------------------------------------
@@ -201,6 +799,264 @@ void PoolAllocator<PoolSize, BlockSize, RaiiSynchronizer>::deallocate(const void
     used_--;
 }
 
+template <std::size_t PoolSize, uint8_t BlockSize, typename RaiiSynchronizer>
+unsigned PoolAllocator<PoolSize, BlockSize, RaiiSynchronizer>::allocateBatch(std::size_t size, void** out_ptrs,
+                                                                              unsigned num_blocks)
+{
+    if (size > BlockSize || out_ptrs == NULL)
+    {
+        return 0;
+    }
+
+    RaiiSynchronizer lock;
+    (void)lock;
+
+    unsigned num_allocated = 0;
+    while ((num_allocated < num_blocks) && (free_list_ != NULL))
+    {
+        out_ptrs[num_allocated++] = free_list_;
+        free_list_ = free_list_->next;
+    }
+
+    // Statistics
+    used_ = static_cast<uint16_t>(used_ + num_allocated);
+    UAVCAN_ASSERT(used_ <= NumBlocks);
+    if (used_ > max_used_)
+    {
+        max_used_ = used_;
+    }
+
+    return num_allocated;
+}
+
+template <std::size_t PoolSize, uint8_t BlockSize, typename RaiiSynchronizer>
+void PoolAllocator<PoolSize, BlockSize, RaiiSynchronizer>::deallocateBatch(void* const* ptrs, unsigned num_blocks)
+{
+    if (ptrs == NULL)
+    {
+        return;
+    }
+
+    RaiiSynchronizer lock;
+    (void)lock;
+
+    for (unsigned i = 0; i < num_blocks; i++)
+    {
+        if (ptrs[i] == NULL)
+        {
+            continue;
+        }
+        Node* p = static_cast<Node*>(ptrs[i]);
+        p->next = free_list_;
+        free_list_ = p;
+
+        // Statistics
+        UAVCAN_ASSERT(used_ > 0);
+        used_--;
+    }
+}
+
+/*
+ * MultiPoolAllocator<>
+ */
+template <uint16_t N16, uint16_t N32, uint16_t N64, uint16_t N128, uint16_t N256, typename RaiiSynchronizer>
+const std::size_t MultiPoolAllocator<N16, N32, N64, N128, N256, RaiiSynchronizer>::PoolSize;
+
+template <uint16_t N16, uint16_t N32, uint16_t N64, uint16_t N128, uint16_t N256, typename RaiiSynchronizer>
+const unsigned MultiPoolAllocator<N16, N32, N64, N128, N256, RaiiSynchronizer>::NumBlocks;
+
+template <uint16_t N16, uint16_t N32, uint16_t N64, uint16_t N128, uint16_t N256, typename RaiiSynchronizer>
+uint16_t MultiPoolAllocator<N16, N32, N64, N128, N256, RaiiSynchronizer>::getNumBlocks(unsigned size_class)
+{
+    switch (size_class)
+    {
+    case 0: return N16;
+    case 1: return N32;
+    case 2: return N64;
+    case 3: return N128;
+    case 4: return N256;
+    default: return 0;
+    }
+}
+
+template <uint16_t N16, uint16_t N32, uint16_t N64, uint16_t N128, uint16_t N256, typename RaiiSynchronizer>
+std::size_t MultiPoolAllocator<N16, N32, N64, N128, N256, RaiiSynchronizer>::getSizeClassOffset(unsigned size_class)
+{
+    std::size_t offset = 0;
+    for (unsigned i = 0; i < size_class; i++)
+    {
+        offset += std::size_t(getNumBlocks(i)) * getBlockSize(i);
+    }
+    return offset;
+}
+
+template <uint16_t N16, uint16_t N32, uint16_t N64, uint16_t N128, uint16_t N256, typename RaiiSynchronizer>
+MultiPoolAllocator<N16, N32, N64, N128, N256, RaiiSynchronizer>::MultiPoolAllocator()
+{
+    // The limit is imposed by the width of the pool usage tracking variables.
+    StaticAssert<(NumBlocks > 0)>::check();
+    StaticAssert<(NumBlocks <= 0xFFFFU)>::check();
+
+    (void)std::memset(pool_.bytes, 0, PoolSize);
+
+    for (unsigned cls = 0; cls < NumSizeClasses; cls++)
+    {
+        SizeClass& sc = classes_[cls];
+        sc.free_list = NULL;
+        sc.used = 0;
+        sc.max_used = 0;
+
+        // Building the free list in reverse order, so that the blocks will be allocated in ascending address order
+        uint8_t* const base = pool_.bytes + getSizeClassOffset(cls);
+        for (unsigned i = getNumBlocks(cls); i > 0; i--)
+        {
+            Node* const node = reinterpret_cast<Node*>(base + (i - 1U) * getBlockSize(cls));
+            node->next = sc.free_list;
+            sc.free_list = node;
+        }
+    }
+}
+
+template <uint16_t N16, uint16_t N32, uint16_t N64, uint16_t N128, uint16_t N256, typename RaiiSynchronizer>
+void* MultiPoolAllocator<N16, N32, N64, N128, N256, RaiiSynchronizer>::allocate(std::size_t size)
+{
+    RaiiSynchronizer lock;
+    (void)lock;
+
+    for (unsigned cls = 0; cls < NumSizeClasses; cls++)
+    {
+        SizeClass& sc = classes_[cls];
+        if ((size > getBlockSize(cls)) || (sc.free_list == NULL))
+        {
+            continue;
+        }
+
+        void* const pmem = sc.free_list;
+        sc.free_list = sc.free_list->next;
+
+        // Statistics
+        UAVCAN_ASSERT(sc.used < getNumBlocks(cls));
+        sc.used++;
+        if (sc.used > sc.max_used)
+        {
+            sc.max_used = sc.used;
+        }
+        return pmem;
+    }
+    return NULL;
+}
+
+template <uint16_t N16, uint16_t N32, uint16_t N64, uint16_t N128, uint16_t N256, typename RaiiSynchronizer>
+void MultiPoolAllocator<N16, N32, N64, N128, N256, RaiiSynchronizer>::deallocate(const void* ptr)
+{
+    if (ptr == NULL)
+    {
+        return;
+    }
+
+    const uint8_t* const p = static_cast<const uint8_t*>(ptr);
+    UAVCAN_ASSERT((p >= pool_.bytes) && (p < (pool_.bytes + PoolSize)));
+
+    // Size classes are laid out in ascending order, so the owner is the last class that starts at or below ptr
+    unsigned cls = NumSizeClasses;
+    while (cls > 0)
+    {
+        cls--;
+        if ((getNumBlocks(cls) > 0) && (p >= (pool_.bytes + getSizeClassOffset(cls))))
+        {
+            break;
+        }
+    }
+
+    RaiiSynchronizer lock;
+    (void)lock;
+
+    SizeClass& sc = classes_[cls];
+    Node* const node = static_cast<Node*>(const_cast<void*>(ptr));
+    node->next = sc.free_list;
+    sc.free_list = node;
+
+    // Statistics
+    UAVCAN_ASSERT(sc.used > 0);
+    sc.used--;
+}
+
+template <uint16_t N16, uint16_t N32, uint16_t N64, uint16_t N128, uint16_t N256, typename RaiiSynchronizer>
+uint16_t MultiPoolAllocator<N16, N32, N64, N128, N256, RaiiSynchronizer>::getNumUsedBlocks() const
+{
+    RaiiSynchronizer lock;
+    (void)lock;
+    unsigned total = 0;
+    for (unsigned cls = 0; cls < NumSizeClasses; cls++)
+    {
+        total += classes_[cls].used;
+    }
+    return uint16_t(total);
+}
+
+
+/*
+ * PoolAllocatorMagazine<>
+ */
+template <unsigned MagazineSize, std::size_t BlockSize>
+void* PoolAllocatorMagazine<MagazineSize, BlockSize>::allocate(std::size_t size)
+{
+    if (size > BlockSize)
+    {
+        return NULL;
+    }
+
+    if (num_cached_ == 0)
+    {
+        num_cached_ = static_cast<uint16_t>(shared_.allocateBatch(BlockSize, blocks_, BatchSize));
+        if (num_cached_ == 0)
+        {
+            return NULL;
+        }
+    }
+
+    num_cached_--;
+    void* const pmem = blocks_[num_cached_];
+
+    // Statistics
+    used_++;
+    if (used_ > max_used_)
+    {
+        max_used_ = used_;
+    }
+
+    return pmem;
+}
+
+template <unsigned MagazineSize, std::size_t BlockSize>
+void PoolAllocatorMagazine<MagazineSize, BlockSize>::deallocate(const void* ptr)
+{
+    if (ptr == NULL)
+    {
+        return;
+    }
+
+    if (num_cached_ >= MagazineSize)
+    {
+        // Flushing the older half, keeping the recently freed blocks which are more likely to be in cache
+        num_cached_ = static_cast<uint16_t>(num_cached_ - BatchSize);
+        shared_.deallocateBatch(blocks_, BatchSize);
+        for (unsigned i = 0; i < num_cached_; i++)
+        {
+            blocks_[i] = blocks_[i + BatchSize];
+        }
+    }
+
+    blocks_[num_cached_++] = const_cast<void*>(ptr);
+
+    // Statistics
+    UAVCAN_ASSERT(used_ > 0);
+    if (used_ > 0)
+    {
+        used_--;
+    }
+}
+
 }
 
 #endif // UAVCAN_DYNAMIC_MEMORY_HPP_INCLUDED
@@ -35,6 +35,8 @@ const int16_t ErrLogic                   = 10;
 const int16_t ErrPassiveMode             = 11;  ///< Operation not permitted in passive mode
 const int16_t ErrTransferTooLong         = 12;  ///< Transfer of this length cannot be sent with given transfer type
 const int16_t ErrInvalidConfiguration    = 13;
+const int16_t ErrRateLimited             = 14;  ///< Rejected by traffic shaping, see @ref TokenBucket
+const int16_t ErrNotSupported            = 15;  ///< Optional feature not implemented by the driver
 /**
  * @}
  */
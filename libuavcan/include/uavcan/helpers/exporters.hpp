@@ -0,0 +1,197 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_HELPERS_EXPORTERS_HPP_INCLUDED
+#define UAVCAN_HELPERS_EXPORTERS_HPP_INCLUDED
+
+#include <uavcan/build_config.hpp>
+#include <uavcan/error.hpp>
+#include <uavcan/util/templates.hpp>
+#include <uavcan/marshal/char_format_spec.hpp>
+#include <uavcan/marshal/scalar_codec.hpp>
+#include <uavcan/marshal/type_util.hpp>
+#include <uavcan/transport/transfer_buffer.hpp>
+
+namespace uavcan
+{
+/**
+ * Output stream that writes into a buffer provided by the application, for use with @ref YamlStreamer and
+ * @ref JsonStreamer. It neither allocates memory nor uses the C library's printf(), see @ref CharFormatSpec.
+ * The output is always null terminated; the text that doesn't fit the buffer is dropped.
+ *
+ * Usage:
+ *      char buffer[200];
+ *      BufferOStream s(buffer, sizeof(buffer));
+ *      s << "Status: " << msg;
+ */
+class UAVCAN_EXPORT BufferOStream : Noncopyable
+{
+    char* const buffer_;
+    const unsigned capacity_;       ///< Excluding the null terminator
+    unsigned length_;
+    bool truncated_;
+
+public:
+    BufferOStream(char* buffer, unsigned size)
+        : buffer_(buffer)
+        , capacity_(((buffer == NULL) || (size == 0)) ? 0U : (size - 1U))
+        , length_(0)
+        , truncated_(false)
+    {
+        reset();
+    }
+
+    void write(const char* data, unsigned len)
+    {
+        if (len > (capacity_ - length_))
+        {
+            len = capacity_ - length_;
+            truncated_ = true;
+        }
+        copy(data, data + len, buffer_ + length_);
+        length_ += len;
+        if (buffer_ != NULL)
+        {
+            buffer_[length_] = '\0';
+        }
+    }
+
+    /**
+     * Empties the buffer.
+     */
+    void reset()
+    {
+        length_ = 0;
+        truncated_ = false;
+        if (buffer_ != NULL)
+        {
+            buffer_[0] = '\0';
+        }
+    }
+
+    /**
+     * Length of the output excluding the null terminator.
+     */
+    unsigned getLength() const { return length_; }
+
+    /**
+     * Whether some output has been dropped because the buffer is full.
+     */
+    bool isTruncated() const { return truncated_; }
+};
+
+inline BufferOStream& operator<<(BufferOStream& s, const char* x)
+{
+    unsigned len = 0;
+    while (x[len] != '\0')
+    {
+        len++;
+    }
+    s.write(x, len);
+    return s;
+}
+
+inline BufferOStream& operator<<(BufferOStream& s, char x) { s.write(&x, 1); return s; }
+
+inline BufferOStream& operator<<(BufferOStream& s, unsigned long long x)
+{
+    char buf[CharFormatSpec::MaxOutputLength];
+    s.write(buf, CharFormatSpec().formatUnsigned(x, buf));
+    return s;
+}
+
+inline BufferOStream& operator<<(BufferOStream& s, long long x)
+{
+    char buf[CharFormatSpec::MaxOutputLength];
+    s.write(buf, CharFormatSpec().formatSigned(x, sizeof(x), buf));
+    return s;
+}
+
+inline BufferOStream& operator<<(BufferOStream& s, long x)           { return s << static_cast<long long>(x); }
+inline BufferOStream& operator<<(BufferOStream& s, unsigned long x)
+{
+    return s << static_cast<unsigned long long>(x);
+}
+
+inline BufferOStream& operator<<(BufferOStream& s, int x)            { return s << static_cast<long long>(x); }
+inline BufferOStream& operator<<(BufferOStream& s, unsigned int x)
+{
+    return s << static_cast<unsigned long long>(x);
+}
+
+inline BufferOStream& operator<<(BufferOStream& s, short x)          { return s << static_cast<long long>(x); }
+inline BufferOStream& operator<<(BufferOStream& s, unsigned short x)
+{
+    return s << static_cast<unsigned long long>(x);
+}
+
+inline BufferOStream& operator<<(BufferOStream& s, double x)
+{
+    char buf[CharFormatSpec::MaxOutputLength];
+    s.write(buf, CharFormatSpec().formatFloat(x, buf));
+    return s;
+}
+
+inline BufferOStream& operator<<(BufferOStream& s, float x)        { return s << static_cast<double>(x); }
+inline BufferOStream& operator<<(BufferOStream& s, long double x)  { return s << static_cast<double>(x); }
+
+/**
+ * Writes a DSDL data structure, e.g. a message or a service request, into the buffer as compact JSON:
+ *      {"uptime_sec":12,"health":0,"mode":0,"sub_mode":0,"vendor_specific_status_code":0}
+ * Unions are written as objects with the single member that is selected; DSDL bool (uint1) is written as
+ * true/false; string-like arrays (uint8[<=N]) are written as strings, and the bytes that are not printable ASCII
+ * characters are escaped as \u00XX; infinities and NaN are written as null, because JSON can't represent them.
+ *
+ * The output is null terminated.
+ * Returns the length of the output excluding the null terminator, or -ErrMemory if it doesn't fit the buffer;
+ * in the latter case the buffer contains the truncated output.
+ */
+template <typename DataStruct>
+int exportJson(const DataStruct& obj, char* buffer, unsigned size)
+{
+    BufferOStream s(buffer, size);
+    JsonStreamer<DataStruct>::stream(s, obj);
+    return s.isTruncated() ? -ErrMemory : int(s.getLength());
+}
+
+/**
+ * Same as @ref exportJson(), but the output is YAML, the same one that is produced by the stream operators of the
+ * generated types.
+ */
+template <typename DataStruct>
+int exportYaml(const DataStruct& obj, char* buffer, unsigned size)
+{
+    BufferOStream s(buffer, size);
+    YamlStreamer<DataStruct>::stream(s, obj, 0);
+    return s.isTruncated() ? -ErrMemory : int(s.getLength());
+}
+
+/**
+ * Writes a DSDL data structure into the buffer in compact binary form, which is the DSDL serialization with the
+ * tail array optimization, i.e. the same bytes as the payload of the transfer. The buffer of
+ * (DataStruct::MaxBitLen + 7) / 8 bytes fits any value. The data can be restored with DataStruct::decode().
+ *
+ * Returns the number of bytes written, or -ErrMemory if the data doesn't fit the buffer.
+ */
+template <typename DataStruct>
+int exportBinary(const DataStruct& obj, uint8_t* buffer, unsigned size)
+{
+    if (buffer == NULL)
+    {
+        return -ErrInvalidParam;
+    }
+    StaticTransferBufferImpl transfer_buffer(buffer, uint16_t(min(size, 0xFFFFU)));
+    BitStream bitstream(transfer_buffer);
+    ScalarCodec codec(bitstream);
+    const int res = DataStruct::encode(obj, codec, TailArrayOptEnabled);
+    if (res < 0)
+    {
+        return res;
+    }
+    return (res == 0) ? -ErrMemory : int(transfer_buffer.getMaxWritePos());
+}
+
+}
+
+#endif // UAVCAN_HELPERS_EXPORTERS_HPP_INCLUDED
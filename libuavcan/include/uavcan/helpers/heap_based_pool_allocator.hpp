@@ -9,6 +9,7 @@
 #include <uavcan/build_config.hpp>
 #include <uavcan/debug.hpp>
 #include <uavcan/dynamic_memory.hpp>
+#include <uavcan/util/templates.hpp>
 
 namespace uavcan
 {
@@ -16,14 +17,21 @@ namespace uavcan
  * A special-purpose implementation of a pool allocator that keeps the pool in the heap using malloc()/free().
  * The pool grows dynamically, ad-hoc, thus using as little memory as possible.
  *
+ * The pool is obtained from the heap in chunks of BlocksPerChunk blocks (the third template argument), one malloc()
+ * per chunk. Chunks of more than one block are aligned at the cache line boundary (see @ref CacheLineSize).
+ * The default is one block per chunk, which keeps the memory overhead minimal; on platforms where the heap is
+ * large, it is recommended to use bigger chunks (e.g. 32..256 blocks), because it reduces heap fragmentation and
+ * makes the latency of the first allocations much more uniform.
+ *
  * Allocated blocks will not be freed back automatically, but there are two ways to force their deallocation:
- *  - Call @ref shrink() - this method frees all blocks that are unused at the moment.
+ *  - Call @ref shrink() - this method frees all chunks that are entirely unused at the moment.
  *  - Destroy the object - the desctructor calls @ref shrink().
  *
  * The pool can be limited in growth with hard and soft limits.
  * The soft limit defines the value that will be reported via @ref IPoolAllocator::getBlockCapacity().
  * The hard limit defines the maximum number of blocks that can be allocated from heap.
  * Typically, the hard limit should be equal or greater than the soft limit.
+ * The last chunk is made smaller if necessary in order to not exceed the hard limit.
  *
  * The allocator can be made thread-safe (optional) by means of providing a RAII-lock type via the second template
  * argument. The allocator uses the lock only to access the shared state, therefore critical sections are only a few
@@ -36,7 +44,8 @@ namespace uavcan
  *     };
  */
 template <std::size_t BlockSize,
-          typename RaiiSynchronizer = char>
+          typename RaiiSynchronizer = char,
+          unsigned BlocksPerChunk = 1>
 class UAVCAN_EXPORT HeapBasedPoolAllocator : public IPoolAllocator,
                                              Noncopyable
 {
@@ -49,6 +58,22 @@ class UAVCAN_EXPORT HeapBasedPoolAllocator : public IPoolAllocator,
         long long _aligner2;
     };
 
+    /**
+     * Placed right after the last block of the chunk, so that the blocks are aligned the same way as the memory
+     * returned by malloc(), or at the cache line boundary for multi-block chunks.
+     */
+    struct Chunk
+    {
+        Chunk* next;
+        void* memory;           ///< Pointer returned by malloc()
+        uint16_t num_blocks;
+        uint16_t num_free;      ///< Only valid inside shrink()
+
+        Node* getFirstBlock() { return reinterpret_cast<Node*>(this) - num_blocks; }
+    };
+
+    enum { ChunkAlignmentPadding = (BlocksPerChunk > 1) ? (CacheLineSize - 1) : 0 };
+
     const uint16_t capacity_soft_limit_;
     const uint16_t capacity_hard_limit_;
 
@@ -56,6 +81,87 @@ class UAVCAN_EXPORT HeapBasedPoolAllocator : public IPoolAllocator,
     uint16_t num_allocated_blocks_;
 
     Node* reserve_;
+    Chunk* chunks_;
+
+    static Chunk* allocateChunk(uint16_t num_blocks)
+    {
+        uint8_t* const memory = static_cast<uint8_t*>(std::malloc(sizeof(Node) * num_blocks + sizeof(Chunk) +
+                                                                  ChunkAlignmentPadding));
+        if (memory == NULL)
+        {
+            return NULL;
+        }
+
+        const std::size_t misalignment = reinterpret_cast<std::size_t>(memory) & ChunkAlignmentPadding;
+        Node* const blocks =
+            reinterpret_cast<Node*>(memory + ((misalignment > 0) ? (ChunkAlignmentPadding + 1 - misalignment) : 0));
+
+        Chunk* const chunk = reinterpret_cast<Chunk*>(blocks + num_blocks);
+        chunk->next = NULL;
+        chunk->memory = memory;
+        chunk->num_blocks = num_blocks;
+        chunk->num_free = 0;
+
+        for (uint16_t i = 0; i < (num_blocks - 1U); i++)
+        {
+            blocks[i].next = &blocks[i + 1U];
+        }
+        blocks[num_blocks - 1U].next = NULL;
+
+        return chunk;
+    }
+
+    /**
+     * Sorts a singly linked list (either blocks or chunks) by address. Merge sort, O(n log n), no extra memory.
+     */
+    template <typename T>
+    static T* sortByAddress(T* head)
+    {
+        if ((head == NULL) || (head->next == NULL))
+        {
+            return head;
+        }
+
+        // Splitting in halves
+        T* slow = head;
+        for (T* fast = head->next; (fast != NULL) && (fast->next != NULL); fast = fast->next->next)
+        {
+            slow = slow->next;
+        }
+        T* a = head;
+        T* b = slow->next;
+        slow->next = NULL;
+
+        a = sortByAddress(a);
+        b = sortByAddress(b);
+
+        // Merging
+        T* result = NULL;
+        T** tail = &result;
+        while ((a != NULL) && (b != NULL))
+        {
+            T** const smaller = (a < b) ? &a : &b;
+            *tail = *smaller;
+            tail = &(*smaller)->next;
+            *smaller = (*smaller)->next;
+        }
+        *tail = (a != NULL) ? a : b;
+        return result;
+    }
+
+    /**
+     * Given that the block belongs to one of the chunks in the address-ordered list, returns its chunk.
+     * Consecutive calls must be made for blocks in ascending order of addresses.
+     */
+    static Chunk* findChunk(Chunk* chunk, const Node* block)
+    {
+        while (reinterpret_cast<const Node*>(chunk) <= block)
+        {
+            chunk = chunk->next;
+            UAVCAN_ASSERT(chunk != NULL);
+        }
+        return chunk;
+    }
 
 public:
     /**
@@ -75,12 +181,16 @@ public:
                                                        static_cast<uint32_t>(NumericTraits<uint16_t>::max())))),
         num_reserved_blocks_(0),
         num_allocated_blocks_(0),
-        reserve_(NULL)
-    { }
+        reserve_(NULL),
+        chunks_(NULL)
+    {
+        StaticAssert<(BlocksPerChunk >= 1)>::check();
+        StaticAssert<(BlocksPerChunk <= 0xFFFFU)>::check();
+    }
 
     /**
-     * The destructor de-allocates all blocks that are currently in the reserve.
-     * BLOCKS THAT ARE CURRENTLY HELD BY THE APPLICATION WILL LEAK.
+     * The destructor de-allocates all chunks that are currently entirely in the reserve.
+     * BLOCKS THAT ARE CURRENTLY HELD BY THE APPLICATION WILL LEAK, ALONG WITH THEIR CHUNKS.
      */
     ~HeapBasedPoolAllocator()
     {
@@ -95,7 +205,7 @@ public:
 
     /**
      * Takes a block from the reserve, unless it's empty.
-     * In the latter case, allocates a new block in the heap.
+     * In the latter case, allocates a new chunk in the heap.
      */
     virtual void* allocate(std::size_t size)
     {
@@ -104,6 +214,7 @@ public:
             return NULL;
         }
 
+        uint16_t num_blocks = 0;
         {
             RaiiSynchronizer lock;
             (void)lock;
@@ -121,19 +232,37 @@ public:
             {
                 return NULL;
             }
+
+            // The blocks are accounted for in advance, so that concurrent callers could not exceed the hard limit
+            num_blocks = static_cast<uint16_t>(min(static_cast<unsigned>(capacity_hard_limit_ - num_reserved_blocks_),
+                                                   BlocksPerChunk));
+            num_reserved_blocks_ = static_cast<uint16_t>(num_reserved_blocks_ + num_blocks);
         }
 
         // Unlikely branch
-        void* const m = std::malloc(sizeof(Node));
-        if (m != NULL)
+        Chunk* const chunk = allocateChunk(num_blocks);
+
+        RaiiSynchronizer lock;
+        (void)lock;
+
+        if (chunk == NULL)
         {
-            RaiiSynchronizer lock;
-            (void)lock;
+            num_reserved_blocks_ = static_cast<uint16_t>(num_reserved_blocks_ - num_blocks);
+            return NULL;
+        }
+
+        chunk->next = chunks_;
+        chunks_ = chunk;
 
-            num_reserved_blocks_++;
-            num_allocated_blocks_++;
+        // The first block goes to the caller, the rest of the chunk goes to the reserve
+        Node* const first = chunk->getFirstBlock();
+        if (num_blocks > 1)
+        {
+            first[num_blocks - 1U].next = reserve_;
+            reserve_ = first->next;
         }
-        return m;
+        num_allocated_blocks_++;
+        return first;
     }
 
     /**
@@ -166,31 +295,125 @@ public:
     uint16_t getBlockCapacityHardLimit() const { return capacity_hard_limit_; }
 
     /**
-     * Frees all blocks that are not in use at the moment.
-     * Post-condition is getNumAllocatedBlocks() == getNumReservedBlocks().
+     * Frees all chunks whose blocks are not in use at the moment, except the first num_spare_chunks of them.
+     * The spare chunks provide hysteresis: if the application calls this method periodically, keeping a few
+     * spare chunks prevents the pool from being freed and re-acquired over and over when the load fluctuates.
+     *
+     * The method runs in O(n log n) of the number of reserved blocks, most of the time outside of the critical
+     * section; allocations made concurrently may be served from new chunks. As a side effect, the reserve gets
+     * sorted by address, so that subsequent allocations access the memory sequentially.
+     *
+     * With one block per chunk and no spare chunks, the post-condition is
+     * getNumAllocatedBlocks() == getNumReservedBlocks().
      */
-    void shrink()
+    void shrink(uint16_t num_spare_chunks = 0)
     {
-        Node* p = NULL;
-        for (;;)
+        Node* blocks = NULL;
+        Chunk* chunks = NULL;
+        {
+            RaiiSynchronizer lock;
+            (void)lock;
+            if (reserve_ == NULL)
+            {
+                return;
+            }
+            blocks = reserve_;
+            chunks = chunks_;
+            reserve_ = NULL;
+            chunks_ = NULL;
+        }
+
+        // Counting the free blocks per chunk. Chunks and blocks added to the pool meanwhile are not affected.
+        blocks = sortByAddress(blocks);
+        chunks = sortByAddress(chunks);
+
+        for (Chunk* c = chunks; c != NULL; c = c->next)
+        {
+            c->num_free = 0;
+        }
         {
+            Chunk* c = chunks;
+            for (Node* b = blocks; b != NULL; b = b->next)
             {
-                RaiiSynchronizer lock;
-                (void)lock;
-                // Removing from reserve and updating the counter.
-                p = reserve_;
-                if (p != NULL)
+                c = findChunk(c, b);
+                c->num_free++;
+            }
+        }
+
+        // Removing the blocks of the chunks that are about to be freed from the reserve
+        Chunk* released_chunks = NULL;
+        Chunk* kept_chunks = NULL;
+        Chunk** kept_chunks_tail = &kept_chunks;
+        Node* kept_blocks = NULL;
+        Node** kept_blocks_tail = &kept_blocks;
+        uint16_t num_released_blocks = 0;
+        {
+            Chunk* c = chunks;
+            Node* b = blocks;
+            while (c != NULL)
+            {
+                Chunk* const next_chunk = c->next;
+                bool release = false;
+                if (c->num_free == c->num_blocks)
+                {
+                    if (num_spare_chunks > 0)
+                    {
+                        num_spare_chunks--;
+                    }
+                    else
+                    {
+                        release = true;
+                    }
+                }
+                if (release)
                 {
-                    reserve_ = reserve_->next;
-                    num_reserved_blocks_--;
+                    num_released_blocks = static_cast<uint16_t>(num_released_blocks + c->num_blocks);
+                    c->next = released_chunks;
+                    released_chunks = c;
                 }
                 else
                 {
-                    break;
+                    *kept_chunks_tail = c;
+                    kept_chunks_tail = &c->next;
+                }
+                while ((b != NULL) && (reinterpret_cast<Node*>(c) > b))
+                {
+                    if (!release)
+                    {
+                        *kept_blocks_tail = b;
+                        kept_blocks_tail = &b->next;
+                    }
+                    b = b->next;
                 }
+                c = next_chunk;
+            }
+            UAVCAN_ASSERT(b == NULL);
+            *kept_chunks_tail = NULL;
+            *kept_blocks_tail = NULL;
+        }
+
+        // Putting the rest back, then freeing, having left the critical section
+        {
+            RaiiSynchronizer lock;
+            (void)lock;
+            if (kept_blocks != NULL)
+            {
+                *kept_blocks_tail = reserve_;
+                reserve_ = kept_blocks;
+            }
+            if (kept_chunks != NULL)
+            {
+                *kept_chunks_tail = chunks_;
+                chunks_ = kept_chunks;
             }
-            // Then freeing, having left the critical section.
-            std::free(p);
+            num_reserved_blocks_ = static_cast<uint16_t>(num_reserved_blocks_ - num_released_blocks);
+        }
+
+        while (released_chunks != NULL)
+        {
+            Chunk* const c = released_chunks;
+            released_chunks = released_chunks->next;
+            std::free(c->memory);
         }
     }
 
@@ -213,6 +436,21 @@ public:
         (void)lock;
         return num_reserved_blocks_;
     }
+
+    /**
+     * Number of chunks that are acquired from the heap.
+     */
+    unsigned getNumChunks() const
+    {
+        RaiiSynchronizer lock;
+        (void)lock;
+        unsigned n = 0;
+        for (const Chunk* c = chunks_; c != NULL; c = c->next)
+        {
+            n++;
+        }
+        return n;
+    }
 };
 
 }
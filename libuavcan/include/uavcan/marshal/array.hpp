@@ -10,11 +10,14 @@
 #include <cstring>
 #include <cmath>
 #include <uavcan/error.hpp>
+#include <uavcan/dynamic_memory.hpp>
 #include <uavcan/util/bitset.hpp>
+#include <uavcan/util/placement_new.hpp>
 #include <uavcan/util/templates.hpp>
 #include <uavcan/build_config.hpp>
 #include <uavcan/marshal/type_util.hpp>
 #include <uavcan/marshal/integer_spec.hpp>
+#include <uavcan/marshal/float_spec.hpp>
 #include <uavcan/std.hpp>
 
 #ifndef UAVCAN_CPP_VERSION
@@ -32,7 +35,36 @@
 namespace uavcan
 {
 
-enum ArrayMode { ArrayModeStatic, ArrayModeDynamic };
+/**
+ * Dynamic arrays store the elements inline, in a buffer that can fit the maximum number of elements.
+ * Pooled dynamic arrays allocate the storage for the actual number of elements from @ref PooledArrayAllocator;
+ * this mode is used by the DSDL compiler for the large arrays if requested, see its option --pooled-arrays.
+ */
+enum ArrayMode { ArrayModeStatic, ArrayModeDynamic, ArrayModeDynamicPooled };
+
+/**
+ * Provides memory to the arrays with @ref ArrayModeDynamicPooled. The storage of an array is allocated as one
+ * contiguous chunk that is grown as the array grows, so the allocator must be able to serve chunks larger than
+ * a memory pool block, e.g. @ref MultiPoolAllocator; the largest chunk required is (MaxSize + 1) elements.
+ *
+ * With no allocator set, which is the default, the pooled arrays can't hold any elements: the decoding fails with
+ * -ErrMemory, and the modifying methods have no effect. Every array keeps the pointer to the allocator where its
+ * storage comes from, so the allocator can be replaced at any time, but it must outlive all of its arrays.
+ *
+ * Usage example:
+ *   static uavcan::MultiPoolAllocator<0, 32, 32, 16, 8> array_pool;
+ *   uavcan::PooledArrayAllocator::setAllocator(&array_pool);
+ */
+class UAVCAN_EXPORT PooledArrayAllocator
+{
+    static IPoolAllocator* allocator_;
+
+    PooledArrayAllocator();
+
+public:
+    static void setAllocator(IPoolAllocator* allocator) { allocator_ = allocator; }
+    static IPoolAllocator* getAllocator() { return allocator_; }
+};
 
 /**
  * Properties of a square matrix; assuming row-major representation.
@@ -52,17 +84,11 @@ struct SquareMatrixTraits
 };
 
 /**
- * This class can be used to detect properties of square matrices.
- * Element iterator is a random access forward constant iterator.
+ * Packing modes of square matrices, from the most to the least compact one.
+ * Please refer to the specification to learn more about matrix packing.
  */
-template <typename ElementIterator, unsigned NumElements>
-class SquareMatrixAnalyzer : public SquareMatrixTraits<NumElements>
+struct UAVCAN_EXPORT SquareMatrixPacking
 {
-    typedef SquareMatrixTraits<NumElements> Traits;
-
-    const ElementIterator first_;
-
-public:
     enum PackingMode
     {
         PackingModeEmpty,
@@ -71,7 +97,21 @@ public:
         PackingModeSymmetric,
         PackingModeFull
     };
+};
 
+/**
+ * This class can be used to detect properties of square matrices.
+ * Element iterator is a random access forward constant iterator.
+ */
+template <typename ElementIterator, unsigned NumElements>
+class SquareMatrixAnalyzer : public SquareMatrixTraits<NumElements>
+                           , public SquareMatrixPacking
+{
+    typedef SquareMatrixTraits<NumElements> Traits;
+
+    const ElementIterator first_;
+
+public:
     SquareMatrixAnalyzer(ElementIterator first_element_iterator)
         : first_(first_element_iterator)
     {
@@ -144,25 +184,64 @@ public:
         return true;
     }
 
+    /**
+     * Same result as checking the properties above one by one, but every element is visited at most once,
+     * and the scan stops as soon as only the full packing is left. The dimensions are compile-time constants,
+     * so the loops are unrolled for the commonly used 3x3, 6x6 and 9x9 matrices.
+     */
     PackingMode detectOptimalPackingMode() const
     {
-        if (areAllElementsNan())
+        bool all_nan = true;
+        bool scalar = true;
+        bool diagonal = true;
+        bool symmetric = true;
+
+        ElementIterator it = first_;
+        for (int row = 0; row < Traits::NumRowsCols; ++row)
+        {
+            for (int col = 0; col < Traits::NumRowsCols; ++col, ++it)
+            {
+                if (all_nan && !isNaN(*it))
+                {
+                    all_nan = false;
+                }
+                if (row == col)
+                {
+                    if (scalar && !areClose(*it, *first_))
+                    {
+                        scalar = false;
+                    }
+                    continue;
+                }
+                if (diagonal && !isCloseToZero(*it))
+                {
+                    diagonal = false;
+                    scalar = false;
+                }
+                if (symmetric && (col > row) && !areClose(*it, *accessElementAtRowCol(col, row)))
+                {
+                    symmetric = false;
+                }
+                if (!all_nan && !diagonal && !symmetric)
+                {
+                    return PackingModeFull;
+                }
+            }
+        }
+
+        if (all_nan)
         {
             return PackingModeEmpty;
         }
-        if (isScalar())
+        if (scalar)
         {
             return PackingModeScalar;
         }
-        if (isDiagonal())
+        if (diagonal)
         {
             return PackingModeDiagonal;
         }
-        if (isSymmetric())
-        {
-            return PackingModeSymmetric;
-        }
-        return PackingModeFull;
+        return symmetric ? PackingModeSymmetric : PackingModeFull;
     }
 };
 
@@ -244,6 +323,8 @@ protected:
         }
     }
 
+    bool reserve(unsigned) const { return true; }
+
     void shrink()
     {
         if (size_ > 0)
@@ -405,6 +486,210 @@ public:
     bool operator[](SizeType pos) const { return at(pos); }
 };
 
+/**
+ * Dynamic array that allocates the storage for the actual number of elements from @ref PooledArrayAllocator,
+ * rather than containing it. All elements of the allocated storage are constructed, same as with the inline buffer;
+ * the storage is kept when the array shrinks and released when the array is destroyed.
+ * If the storage can't be allocated, the array is not modified, and a copy of the array is empty.
+ */
+template <typename T, unsigned MaxSize>
+class UAVCAN_EXPORT ArrayImpl<T, ArrayModeDynamicPooled, MaxSize> : public DynamicArrayBase<MaxSize>
+{
+    typedef ArrayImpl<T, ArrayModeDynamicPooled, MaxSize> SelfType;
+    typedef DynamicArrayBase<MaxSize> Base;
+
+public:
+    enum
+    {
+        /// True if the array contents can be interpreted as a 8-bit string (ASCII or UTF8).
+        IsStringLike = IsIntegerSpec<T>::Result && (T::MaxBitLen == 8 || T::MaxBitLen == 7)
+    };
+
+    typedef typename StorageType<T>::Type ValueType;
+    typedef typename Base::SizeType SizeType;
+
+private:
+    enum { MinNumAllocated = 8 };
+    enum { NumExtraElements = IsStringLike ? 1 : 0 };
+
+    IPoolAllocator* allocator_;
+    ValueType* data_;
+    SizeType num_allocated_;
+
+    static ValueType& getNullElement()
+    {
+        static ValueType null_element;      // Accessed only if the range check fails while there's no storage
+        return null_element;
+    }
+
+    void release()
+    {
+        if (data_ != NULL)
+        {
+            for (unsigned i = 0; i < (unsigned(num_allocated_) + unsigned(NumExtraElements)); i++)
+            {
+                data_[i].~ValueType();
+            }
+            UAVCAN_ASSERT(allocator_ != NULL);
+            allocator_->deallocate(data_);
+            data_ = NULL;
+        }
+        num_allocated_ = 0;
+    }
+
+    void assign(const SelfType& rhs)
+    {
+        Base::clear();
+        if (reserve(rhs.size()))
+        {
+            for (SizeType i = 0; i < rhs.size(); i++)
+            {
+                Base::grow();
+                data_[i] = rhs.data_[i];
+            }
+        }
+    }
+
+protected:
+    ~ArrayImpl() { release(); }
+
+public:
+    using Base::size;
+    using Base::capacity;
+
+    ArrayImpl()
+        : allocator_(NULL)
+        , data_(NULL)
+        , num_allocated_(0)
+    { }
+
+    ArrayImpl(const SelfType& rhs)
+        : Base()
+        , allocator_(NULL)
+        , data_(NULL)
+        , num_allocated_(0)
+    {
+        assign(rhs);
+    }
+
+    SelfType& operator=(const SelfType& rhs)
+    {
+        if (this != &rhs)
+        {
+            assign(rhs);
+        }
+        return *this;
+    }
+
+    /**
+     * Makes sure that the storage can fit the specified number of elements (limited to MaxSize), allocating it
+     * if necessary. Returns false if the storage could not be allocated. The same method of the arrays with inline
+     * storage always succeeds.
+     */
+    bool reserve(unsigned num_elements)
+    {
+        num_elements = min(num_elements, unsigned(MaxSize));
+        if (num_elements <= num_allocated_)
+        {
+            return true;
+        }
+        IPoolAllocator* const allocator = (data_ != NULL) ? allocator_ : PooledArrayAllocator::getAllocator();
+        if (allocator == NULL)
+        {
+            return false;
+        }
+
+        const unsigned new_num_allocated =
+            min(unsigned(MaxSize), max(num_elements, max(unsigned(num_allocated_) * 2U, unsigned(MinNumAllocated))));
+        const unsigned new_num_elements = new_num_allocated + unsigned(NumExtraElements);
+        ValueType* const new_data = static_cast<ValueType*>(allocator->allocate(sizeof(ValueType) * new_num_elements));
+        if (new_data == NULL)
+        {
+            return false;
+        }
+
+        for (unsigned i = 0; i < new_num_elements; i++)
+        {
+            if (i < num_allocated_)
+            {
+                new (&new_data[i]) ValueType(data_[i]);
+            }
+            else
+            {
+                new (&new_data[i]) ValueType();
+            }
+        }
+        release();
+        allocator_ = allocator;
+        data_ = new_data;
+        num_allocated_ = SizeType(new_num_allocated);
+        return true;
+    }
+
+    /**
+     * Number of elements the allocated storage can fit; see @ref reserve().
+     */
+    SizeType getNumAllocated() const { return num_allocated_; }
+
+    /**
+     * @ref ArrayImpl::c_str()
+     */
+    const char* c_str() const
+    {
+        StaticAssert<IsStringLike>::check();
+        if (data_ == NULL)
+        {
+            return "";
+        }
+        UAVCAN_ASSERT(size() < (num_allocated_ + 1U));
+        data_[size()] = 0;                           // Ad-hoc string termination
+        return reinterpret_cast<const char*>(data_);
+    }
+
+    /**
+     * @ref ArrayImpl::at()
+     */
+    ValueType& at(SizeType pos)
+    {
+        const SizeType index = Base::validateRange(pos);
+        return (data_ != NULL) ? data_[index] : getNullElement();
+    }
+    const ValueType& at(SizeType pos) const
+    {
+        const SizeType index = Base::validateRange(pos);
+        return (data_ != NULL) ? data_[index] : getNullElement();
+    }
+
+    ValueType& operator[](SizeType pos)             { return at(pos); }
+    const ValueType& operator[](SizeType pos) const { return at(pos); }
+
+    ValueType* begin()             { return data_; }
+    const ValueType* begin() const { return data_; }
+    ValueType* end()               { return data_ + ((data_ != NULL) ? Base::size() : 0U); }
+    const ValueType* end()   const { return data_ + ((data_ != NULL) ? Base::size() : 0U); }
+    ValueType& front()             { return at(0U); }
+    const ValueType& front() const { return at(0U); }
+    ValueType& back()              { return at((Base::size() == 0U) ? 0U : SizeType(Base::size() - 1U)); }
+    const ValueType& back()  const { return at((Base::size() == 0U) ? 0U : SizeType(Base::size() - 1U)); }
+
+    template <typename R>
+    bool operator<(const R& rhs) const
+    {
+        return ::uavcan::lexicographical_compare(begin(), end(), rhs.begin(), rhs.end());
+    }
+
+    typedef ValueType* iterator;
+    typedef const ValueType* const_iterator;
+};
+
+/**
+ * Bit arrays are compact enough to be stored inline, so the pooled mode makes no difference for them.
+ */
+template <unsigned MaxSize, CastMode CastMode>
+class UAVCAN_EXPORT ArrayImpl<IntegerSpec<1, SignednessUnsigned, CastMode>, ArrayModeDynamicPooled, MaxSize>
+    : public ArrayImpl<IntegerSpec<1, SignednessUnsigned, CastMode>, ArrayModeDynamic, MaxSize>
+{ };
+
 /**
  * Zero length arrays are not allowed
  */
@@ -414,7 +699,7 @@ template <typename T, ArrayMode ArrayMode> class ArrayImpl<T, ArrayMode, 0>;
  * Generic array implementation.
  * This class is compatible with most standard library functions operating on containers (e.g. std::sort(),
  * std::lexicographical_compare(), etc.).
- * No dynamic memory is used.
+ * No dynamic memory is used, except by the arrays with @ref ArrayModeDynamicPooled.
  * All functions that can modify the array or access elements are range checking. If the range error occurs:
  * - if exceptions are enabled, std::out_of_range will be thrown;
  * - if UAVCAN_ASSERT() is enabled, program will be terminated on UAVCAN_ASSERT(0);
@@ -426,6 +711,8 @@ class UAVCAN_EXPORT Array : public ArrayImpl<T, ArrayMode, MaxSize_>
     typedef ArrayImpl<T, ArrayMode, MaxSize_> Base;
     typedef Array<T, ArrayMode, MaxSize_> SelfType;
 
+    enum { HasBulkCodec = IsFloat16Spec<T>::Result || IsByteAlignedIntegerSpec<T>::Result };
+
     static bool isOptimizedTailArray(TailArrayOptimizationMode tao_mode)
     {
         return (T::MinBitLen >= 8) && (tao_mode == TailArrayOptEnabled);
@@ -434,6 +721,16 @@ class UAVCAN_EXPORT Array : public ArrayImpl<T, ArrayMode, MaxSize_>
     int encodeImpl(ScalarCodec& codec, const TailArrayOptimizationMode tao_mode, FalseType) const  /// Static
     {
         UAVCAN_ASSERT(size() > 0);
+        return encodeElements(codec, tao_mode, BooleanType<HasBulkCodec>());
+    }
+
+    int encodeElements(ScalarCodec& codec, const TailArrayOptimizationMode, TrueType) const   /// In bulk
+    {
+        return RawValueType::encodeArray(Base::begin(), unsigned(size()), codec);
+    }
+
+    int encodeElements(ScalarCodec& codec, const TailArrayOptimizationMode tao_mode, FalseType) const
+    {
         for (SizeType i = 0; i < size(); i++)
         {
             const bool last_item = i == (size() - 1);
@@ -470,6 +767,16 @@ class UAVCAN_EXPORT Array : public ArrayImpl<T, ArrayMode, MaxSize_>
     int decodeImpl(ScalarCodec& codec, const TailArrayOptimizationMode tao_mode, FalseType)  /// Static
     {
         UAVCAN_ASSERT(size() > 0);
+        return decodeElements(codec, tao_mode, BooleanType<HasBulkCodec>());
+    }
+
+    int decodeElements(ScalarCodec& codec, const TailArrayOptimizationMode, TrueType)     /// In bulk
+    {
+        return RawValueType::decodeArray(Base::begin(), unsigned(size()), codec);
+    }
+
+    int decodeElements(ScalarCodec& codec, const TailArrayOptimizationMode tao_mode, FalseType)
+    {
         for (SizeType i = 0; i < size(); i++)
         {
             const bool last_item = i == (size() - 1);
@@ -510,6 +817,10 @@ class UAVCAN_EXPORT Array : public ArrayImpl<T, ArrayMode, MaxSize_>
                 {
                     return -ErrInvalidMarshalData;
                 }
+                if (!Base::reserve(unsigned(size()) + 1U))
+                {
+                    return -ErrMemory;
+                }
                 push_back(value);
             }
         }
@@ -526,6 +837,10 @@ class UAVCAN_EXPORT Array : public ArrayImpl<T, ArrayMode, MaxSize_>
             {
                 return -ErrInvalidMarshalData;
             }
+            if (!Base::reserve(sz))
+            {
+                return -ErrMemory;
+            }
             resize(sz);
             if (sz == 0)
             {
@@ -541,7 +856,16 @@ class UAVCAN_EXPORT Array : public ArrayImpl<T, ArrayMode, MaxSize_>
 #endif
 
     template <typename InputIter>
-    void packSquareMatrixImpl(const InputIter src_row_major)
+    SquareMatrixPacking::PackingMode packSquareMatrixImpl(const InputIter src_row_major)
+    {
+        const SquareMatrixAnalyzer<InputIter, MaxSize> analyzer(src_row_major);
+        const SquareMatrixPacking::PackingMode mode = analyzer.detectOptimalPackingMode();
+        packSquareMatrixImpl(src_row_major, mode);
+        return mode;
+    }
+
+    template <typename InputIter>
+    void packSquareMatrixImpl(const InputIter src_row_major, const SquareMatrixPacking::PackingMode mode)
     {
         StaticAssert<IsDynamic>::check();
 
@@ -550,7 +874,7 @@ class UAVCAN_EXPORT Array : public ArrayImpl<T, ArrayMode, MaxSize_>
         typedef SquareMatrixAnalyzer<InputIter, MaxSize> Analyzer;
         const Analyzer analyzer(src_row_major);
 
-        switch (analyzer.detectOptimalPackingMode())
+        switch (mode)
         {
         case Analyzer::PackingModeEmpty:
         {
@@ -666,7 +990,7 @@ public:
     using Base::size;
     using Base::capacity;
 
-    enum { IsDynamic = ArrayMode == ArrayModeDynamic };
+    enum { IsDynamic = ArrayMode != ArrayModeStatic };
     enum { MaxSize = MaxSize_ };
     enum
     {
@@ -717,8 +1041,11 @@ public:
     void pop_back() { Base::shrink(); }
     void push_back(const ValueType& value)
     {
-        Base::grow();
-        Base::at(SizeType(size() - 1)) = value;
+        if (Base::reserve(unsigned(size()) + 1U))
+        {
+            Base::grow();
+            Base::at(SizeType(size() - 1)) = value;
+        }
     }
 
     /**
@@ -899,6 +1226,10 @@ public:
         }
         // Add some hardcore runtime checks for the format string correctness?
 
+        if (!Base::reserve(capacity()))
+        {
+            return;
+        }
         ValueType* const ptr = Base::end();
         UAVCAN_ASSERT(capacity() >= size());
         const SizeType max_size = SizeType(capacity() - size());
@@ -953,11 +1284,24 @@ public:
      * Fills this array as a packed square matrix from a static array.
      * Please refer to the specification to learn more about matrix packing.
      * Note that matrix packing code uses @ref areClose() for comparison.
+     * Returns the detected packing mode, which can be passed to the overload below next time if the structure
+     * of the matrix is known not to change.
+     */
+    template <typename ScalarType>
+    SquareMatrixPacking::PackingMode packSquareMatrix(const ScalarType (&src_row_major)[MaxSize])
+    {
+        return packSquareMatrixImpl<const ScalarType*>(src_row_major);
+    }
+
+    /**
+     * Fills this array as a packed square matrix from a static array, using the specified packing mode instead
+     * of detecting one. The matrix is not analyzed at all, i.e. the elements that the mode doesn't represent
+     * are discarded; e.g. a diagonal packing keeps only the diagonal of any matrix.
      */
     template <typename ScalarType>
-    void packSquareMatrix(const ScalarType (&src_row_major)[MaxSize])
+    void packSquareMatrix(const ScalarType (&src_row_major)[MaxSize], SquareMatrixPacking::PackingMode mode)
     {
-        packSquareMatrixImpl<const ScalarType*>(src_row_major);
+        packSquareMatrixImpl<const ScalarType*>(src_row_major, mode);
     }
 
     /**
@@ -965,7 +1309,7 @@ public:
      * Please refer to the specification to learn more about matrix packing.
      * Note that matrix packing code uses @ref areClose() for comparison.
      */
-    void packSquareMatrix()
+    SquareMatrixPacking::PackingMode packSquareMatrix()
     {
         if (this->size() == MaxSize)
         {
@@ -974,7 +1318,7 @@ public:
             {
                 matrix[i] = this->at(i);
             }
-            packSquareMatrix(matrix);
+            return packSquareMatrix(matrix);
         }
         else if (this->size() == 0)
         {
@@ -989,7 +1333,7 @@ public:
             this->clear();
 #endif
         }
-
+        return SquareMatrixPacking::PackingModeEmpty;
     }
 
     /**
@@ -1001,12 +1345,13 @@ public:
      * Note that matrix packing code uses @ref areClose() for comparison.
      */
     template <typename R>
-    typename EnableIf<sizeof(((const R*)(0U))->begin()) && sizeof(((const R*)(0U))->size())>::Type
+    typename EnableIf<sizeof(((const R*)(0U))->begin()) && sizeof(((const R*)(0U))->size()),
+                      SquareMatrixPacking::PackingMode>::Type
     packSquareMatrix(const R& src_row_major)
     {
         if (src_row_major.size() == MaxSize)
         {
-            packSquareMatrixImpl(src_row_major.begin());
+            return packSquareMatrixImpl(src_row_major.begin());
         }
         else if (src_row_major.size() == 0)
         {
@@ -1019,6 +1364,29 @@ public:
 #else
             UAVCAN_ASSERT(0);
             this->clear();
+#endif
+        }
+        return SquareMatrixPacking::PackingModeEmpty;
+    }
+
+    /**
+     * Same as above, using the specified packing mode instead of detecting one, see the static array overload.
+     */
+    template <typename R>
+    typename EnableIf<sizeof(((const R*)(0U))->begin()) && sizeof(((const R*)(0U))->size())>::Type
+    packSquareMatrix(const R& src_row_major, SquareMatrixPacking::PackingMode mode)
+    {
+        if (src_row_major.size() == MaxSize)
+        {
+            packSquareMatrixImpl(src_row_major.begin(), mode);
+        }
+        else
+        {
+#if UAVCAN_EXCEPTIONS
+            throw std::out_of_range("uavcan::Array::packSquareMatrix()");
+#else
+            UAVCAN_ASSERT(0);
+            this->clear();
 #endif
         }
     }
@@ -1261,6 +1629,77 @@ public:
     }
 };
 
+/**
+ * JSON streamer specification for any Array<>
+ */
+template <typename T, ArrayMode ArrayMode, unsigned MaxSize>
+class UAVCAN_EXPORT JsonStreamer<Array<T, ArrayMode, MaxSize> >
+{
+    typedef Array<T, ArrayMode, MaxSize> ArrayType;
+
+    template <typename Stream>
+    static void streamImpl(Stream& s, const ArrayType& array, TrueType)
+    {
+        static const char Hex[] = "0123456789abcdef";
+        s << '"';
+        for (typename ArrayType::SizeType i = 0; i < array.size(); i++)
+        {
+            const unsigned c = unsigned(array.at(i)) & 0xFFU;
+            if (c == '"' || c == '\\')
+            {
+                s << '\\' << char(c);
+            }
+            else if (c >= 32 && c <= 126)
+            {
+                s << char(c);
+            }
+            else if (c == '\n')
+            {
+                s << "\\n";
+            }
+            else if (c == '\r')
+            {
+                s << "\\r";
+            }
+            else if (c == '\t')
+            {
+                s << "\\t";
+            }
+            else
+            {
+                s << "\\u00" << Hex[c >> 4] << Hex[c & 0xFU];
+            }
+        }
+        s << '"';
+    }
+
+    template <typename Stream>
+    static void streamImpl(Stream& s, const ArrayType& array, FalseType)
+    {
+        s << '[';
+        for (typename ArrayType::SizeType i = 0; i < array.size(); i++)
+        {
+            if (i > 0)
+            {
+                s << ',';
+            }
+            JsonStreamer<T>::stream(s, array.at(i));
+        }
+        s << ']';
+    }
+
+public:
+    /**
+     * String-like arrays are written as JSON strings, where the bytes that are not printable ASCII characters are
+     * escaped; other arrays are written as JSON arrays.
+     */
+    template <typename Stream>
+    static void stream(Stream& s, const ArrayType& array)
+    {
+        streamImpl(s, array, BooleanType<(ArrayType::IsStringLike != 0)>());
+    }
+};
+
 }
 
 #endif // UAVCAN_MARSHAL_ARRAY_HPP_INCLUDED
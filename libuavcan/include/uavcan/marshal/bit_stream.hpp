@@ -32,12 +32,23 @@ class UAVCAN_EXPORT BitStream
 {
     static const unsigned MaxBytesPerRW = 16;
 
+    /**
+     * Unaligned fields that fit this number of bytes together with the bit offset are shifted in a 64-bit word,
+     * whereas longer ones are handled by bitarrayCopy().
+     */
+    static const unsigned AccumulatorBytes = 8;
+
     ITransferBuffer& buf_;
+    const uint8_t* contiguous_data_;  ///< If the buffer is contiguous, reads bypass ITransferBuffer::read()
+    unsigned contiguous_len_;
     unsigned bit_offset_;
     uint8_t byte_cache_;
 
     static inline unsigned bitlenToBytelen(unsigned bits) { return (bits + 7) / 8; }
 
+    static uint64_t loadAccumulator(const uint8_t* bytes, unsigned bytelen);
+    static void storeAccumulator(uint64_t acc, uint8_t* bytes, unsigned bytelen);
+
     static inline void copyBitArrayAlignedToUnaligned(const uint8_t* src_org, unsigned src_len,
                                                       uint8_t* dst_org, unsigned dst_offset)
     {
@@ -63,10 +74,13 @@ public:
 
     explicit BitStream(ITransferBuffer& buf)
         : buf_(buf)
+        , contiguous_data_(NULL)
+        , contiguous_len_(0)
         , bit_offset_(0)
         , byte_cache_(0)
     {
         StaticAssert<sizeof(uint8_t) == 1>::check();
+        contiguous_data_ = buf_.getContiguousData(contiguous_len_);
     }
 
     /**
@@ -75,6 +89,8 @@ public:
      *   Hex:     55       2d
      *   Bits:    01010101 00101101
      *   Indices: 0  ..  7 8  ..  15
+     * A call can transfer at most MaxBitsPerRW bits, unless both the stream position and the length are
+     * byte aligned; such calls are a plain block copy and are not limited in length.
      * Return values:
      *   Negative - Error
      *   Zero     - Out of buffer space
@@ -83,6 +99,8 @@ public:
     int write(const uint8_t* bytes, const unsigned bitlen);
     int read(uint8_t* bytes, const unsigned bitlen);
 
+    bool isByteAligned() const { return (bit_offset_ % 8) == 0; }
+
 #if UAVCAN_TOSTRING
     std::string toString() const;
 #endif
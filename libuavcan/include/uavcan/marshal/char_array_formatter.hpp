@@ -7,63 +7,124 @@
 
 #include <uavcan/build_config.hpp>
 #include <uavcan/marshal/array.hpp>
+#include <uavcan/marshal/char_format_spec.hpp>
 
 #if !defined(UAVCAN_CPP_VERSION) || !defined(UAVCAN_CPP11)
 # error UAVCAN_CPP_VERSION
 #endif
 
-#if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
-# include <type_traits>
-#endif
-
 namespace uavcan
 {
-
-#if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
-
+/**
+ * Formats text into a string-like array, truncating it if it doesn't fit.
+ * With C++11, any number of arguments is supported and the formatting is type safe; refer to @ref CharFormatSpec.
+ * With C++03, only one argument is supported.
+ * The formatting doesn't use the C library, which matters for logging from time-critical code on
+ * microcontrollers, where printf() is both large and slow.
+ */
 template <typename ArrayType_>
 class UAVCAN_EXPORT CharArrayFormatter
 {
     ArrayType_& array_;
 
-    template <typename T>
-    typename std::enable_if<std::is_floating_point<T>::value>::type
-    writeValue(T value)
+    void append(const char* data, unsigned len)
     {
-        array_.template appendFormatted<double>("%g", double(value));
+        for (unsigned i = 0; (i < len) && (array_.size() < array_.capacity()); i++)
+        {
+            array_.push_back(typename ArrayType_::ValueType(data[i]));
+        }
     }
 
-    template <typename T>
-    typename std::enable_if<std::is_integral<T>::value>::type
-    writeValue(T value)
+    void appendPadding(unsigned len)
     {
-        if (std::is_same<T, char>())
+        for (unsigned i = 0; (i < len) && (array_.size() < array_.capacity()); i++)
         {
-            if (array_.size() != array_.capacity())
-            {
-                array_.push_back(typename ArrayType_::ValueType(value));
-            }
+            array_.push_back(typename ArrayType_::ValueType(' '));
         }
-        else if (std::is_signed<T>())
+    }
+
+    void appendChar(char c)
+    {
+        if (array_.size() < array_.capacity())
         {
-            array_.template appendFormatted<long long>("%lli", static_cast<long long>(value));
+            array_.push_back(typename ArrayType_::ValueType(c));
         }
-        else
+    }
+
+    void appendUnsigned(unsigned long long value, const CharFormatSpec& spec)
+    {
+        if (spec.conversion == 'c')
         {
-            array_.template appendFormatted<unsigned long long>("%llu", static_cast<unsigned long long>(value));
+            appendChar(char(value));
+            return;
         }
+        char buf[CharFormatSpec::MaxOutputLength];
+        append(buf, spec.formatUnsigned(value, buf));
     }
 
-    template <typename T>
-    typename std::enable_if<std::is_pointer<T>::value && !std::is_same<T, const char*>::value>::type
-    writeValue(T value)
+    void appendSigned(long long value, unsigned type_size, const CharFormatSpec& spec)
     {
-        array_.template appendFormatted<const void*>("%p", static_cast<const void*>(value));
+        if (spec.conversion == 'c')
+        {
+            appendChar(char(value));
+            return;
+        }
+        char buf[CharFormatSpec::MaxOutputLength];
+        append(buf, spec.formatSigned(value, type_size, buf));
     }
 
-    void writeValue(const char* value)
+    void writeValue(bool value, const CharFormatSpec& spec)                  { appendUnsigned(value ? 1U : 0U, spec); }
+    void writeValue(char value, const CharFormatSpec&)                       { appendChar(value); }
+    void writeValue(signed char value, const CharFormatSpec& spec)           { appendSigned(value, 1, spec); }
+    void writeValue(unsigned char value, const CharFormatSpec& spec)         { appendUnsigned(value, spec); }
+    void writeValue(short value, const CharFormatSpec& spec)          { appendSigned(value, sizeof(value), spec); }
+    void writeValue(unsigned short value, const CharFormatSpec& spec)        { appendUnsigned(value, spec); }
+    void writeValue(int value, const CharFormatSpec& spec)            { appendSigned(value, sizeof(value), spec); }
+    void writeValue(unsigned int value, const CharFormatSpec& spec)          { appendUnsigned(value, spec); }
+    void writeValue(long value, const CharFormatSpec& spec)           { appendSigned(value, sizeof(value), spec); }
+    void writeValue(unsigned long value, const CharFormatSpec& spec)         { appendUnsigned(value, spec); }
+    void writeValue(long long value, const CharFormatSpec& spec)      { appendSigned(value, sizeof(value), spec); }
+    void writeValue(unsigned long long value, const CharFormatSpec& spec)    { appendUnsigned(value, spec); }
+
+    void writeValue(double value, const CharFormatSpec& spec)
     {
-        array_.template appendFormatted<const char*>("%s", value);
+        char buf[CharFormatSpec::MaxOutputLength];
+        append(buf, spec.formatFloat(value, buf));
+    }
+    void writeValue(float value, const CharFormatSpec& spec)       { writeValue(static_cast<double>(value), spec); }
+    void writeValue(long double value, const CharFormatSpec& spec) { writeValue(static_cast<double>(value), spec); }
+
+    void writeValue(const void* value, const CharFormatSpec& spec)
+    {
+        char buf[CharFormatSpec::MaxOutputLength];
+        append(buf, spec.formatPointer(value, buf));
+    }
+
+    void writeValue(const char* value, const CharFormatSpec& spec)
+    {
+        if (value == NULL)
+        {
+            value = "(null)";
+        }
+        const unsigned len = spec.getStringLength(value);
+        const unsigned padding = spec.getStringPadding(len);
+        if (!spec.left_align)
+        {
+            appendPadding(padding);
+        }
+        append(value, len);
+        if (spec.left_align)
+        {
+            appendPadding(padding);
+        }
+    }
+
+    void writeText(const char* text)
+    {
+        while ((text != NULL) && (*text != '\0') && (array_.size() < array_.capacity()))
+        {
+            array_.push_back(typename ArrayType_::ValueType(*text++));
+        }
     }
 
 public:
@@ -76,11 +137,21 @@ public:
     ArrayType& getArray() { return array_; }
     const ArrayType& getArray() const { return array_; }
 
+    /**
+     * The text is written as is; the percent characters are not expanded.
+     */
     void write(const char* text)
     {
-        writeValue(text);
+        writeText(text);
     }
 
+#if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
+
+    /**
+     * Every specification is replaced with the next argument; "%%" is replaced with "%" as long as there are
+     * arguments left. The arguments that don't have a specification are ignored; the specifications that don't
+     * have an argument are written as is.
+     */
     template <typename T, typename... Args>
     void write(const char* s, T value, Args... args)
     {
@@ -91,51 +162,46 @@ public:
                 s += 1;
                 if (*s != '%')
                 {
-                    writeValue(value);
-                    write(++s, args...);
+                    CharFormatSpec spec;
+                    s = spec.parse(s);
+                    writeValue(value, spec);
+                    write(s, args...);
                     break;
                 }
             }
-            writeValue(*s++);
+            appendChar(*s++);
         }
     }
-};
 
 #else
 
-template <typename ArrayType_>
-class UAVCAN_EXPORT CharArrayFormatter
-{
-    ArrayType_& array_;
-
-public:
-    typedef ArrayType_ ArrayType;
-
-    CharArrayFormatter(ArrayType& array)
-        : array_(array)
-    { }
-
-    ArrayType& getArray() { return array_; }
-    const ArrayType& getArray() const { return array_; }
-
-    void write(const char* const text)
-    {
-        array_.template appendFormatted<const char*>("%s", text);
-    }
-
     /**
-     * This version does not support more than one formatted argument, though it can be improved.
-     * And it is unsafe.
-     * There is typesafe version for C++11 above.
+     * This version does not support more than one formatted argument.
+     * The specifications that follow the first one are written as is. There is a variadic version for C++11.
      */
     template <typename A>
-    void write(const char* const format, const A value)
+    void write(const char* s, const A value)
     {
-        array_.template appendFormatted<A>(format, value);
+        while (s && *s)
+        {
+            if (*s == '%')
+            {
+                s += 1;
+                if (*s != '%')
+                {
+                    CharFormatSpec spec;
+                    s = spec.parse(s);
+                    writeValue(value, spec);
+                    write(s);
+                    break;
+                }
+            }
+            appendChar(*s++);
+        }
     }
-};
 
 #endif
+};
 
 }
 
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_MARSHAL_CHAR_FORMAT_SPEC_HPP_INCLUDED
+#define UAVCAN_MARSHAL_CHAR_FORMAT_SPEC_HPP_INCLUDED
+
+#include <uavcan/build_config.hpp>
+#include <uavcan/std.hpp>
+
+namespace uavcan
+{
+/**
+ * Conversion specification of @ref CharArrayFormatter and the formatting of individual values, which doesn't
+ * depend on the C library's printf(): "%[flags][width][.precision][length]conversion".
+ *
+ * The formatting is defined by the type of the argument, the conversion character only refines it:
+ *  - integers:     decimal by default; "x", "X", "o" select the base, "c" prints the character;
+ *  - floats:       like "%g" by default; "f", "F", "e", "E", "g", "G" are supported;
+ *  - const char*:  the string; precision limits its length;
+ *  - pointers:     hexadecimal with the "0x" prefix.
+ * The flags "-", "0", "+", " ", "#" are supported, as well as width and precision; "*" is not, it is treated as
+ * a conversion character, so "%*" prints any argument with the default formatting. Length modifiers are ignored.
+ *
+ * Differences from printf(): fixed-point notation is used only for the values below 1e17, larger values are
+ * printed in exponential notation; no more than 17 significant digits are printed; width is limited by
+ * @ref MaxFieldWidth.
+ */
+class UAVCAN_EXPORT CharFormatSpec
+{
+    unsigned assemble(const char* prefix, const char* body, unsigned body_len, bool zero_pad_allowed,
+                      char* out) const;
+
+public:
+    enum { MaxFieldWidth = 40 };
+    enum { MaxOutputLength = 64 };      ///< Size of the output buffer of the format methods
+
+    uint8_t width;
+    uint8_t precision;
+    char conversion;
+    bool has_precision;
+    bool left_align;
+    bool zero_pad;
+    bool force_sign;
+    bool space_sign;
+    bool alternate_form;
+
+    CharFormatSpec()
+        : width(0)
+        , precision(0)
+        , conversion('\0')
+        , has_precision(false)
+        , left_align(false)
+        , zero_pad(false)
+        , force_sign(false)
+        , space_sign(false)
+        , alternate_form(false)
+    { }
+
+    /**
+     * Parses the specification that follows a percent character.
+     * Returns the pointer past the conversion character, or to the null terminator if the string ends prematurely.
+     */
+    const char* parse(const char* s);
+
+    /**
+     * These methods write the formatted value into the buffer of @ref MaxOutputLength characters without the
+     * null terminator, and return the number of characters written.
+     * The size of the signed type is needed to print negative values in hexadecimal and octal.
+     * @{
+     */
+    unsigned formatUnsigned(unsigned long long value, char* out) const;
+    unsigned formatSigned(long long value, unsigned type_size, char* out) const;
+    unsigned formatFloat(double value, char* out) const;
+    unsigned formatPointer(const void* value, char* out) const;
+    /**
+     * @}
+     */
+
+    /**
+     * Number of the string's characters to print and the padding, considering precision and width.
+     */
+    unsigned getStringLength(const char* s) const;
+    unsigned getStringPadding(unsigned string_length) const
+    {
+        return (width > string_length) ? (width - string_length) : 0U;
+    }
+};
+
+}
+
+#endif // UAVCAN_MARSHAL_CHAR_FORMAT_SPEC_HPP_INCLUDED
@@ -12,6 +12,7 @@
 #include <uavcan/build_config.hpp>
 #include <uavcan/marshal/type_util.hpp>
 #include <uavcan/marshal/integer_spec.hpp>
+#include <uavcan/marshal/char_format_spec.hpp>
 
 #ifndef UAVCAN_CPP_VERSION
 # error UAVCAN_CPP_VERSION
@@ -61,6 +62,37 @@ public:
     static std::float_round_style roundstyle() { return std::round_to_nearest; }
 #endif
 
+    /**
+     * Bulk float16 conversion of arrays.
+     * The hardware instructions of the target are used if available, see UAVCAN_USE_HARDWARE_FLOAT16_CONVERSION;
+     * the results are always the same as those of the element-wise conversion.
+     */
+    static void convertToHalf(const float* src, uint16_t* dst, unsigned count);
+    static void convertFromHalf(const uint16_t* src, float* dst, unsigned count);
+
+    template <unsigned BitLen>
+    static void toIeeeArray(const typename NativeFloatSelector<BitLen>::Type* src,
+                            typename IntegerSpec<BitLen, SignednessUnsigned, CastModeTruncate>::StorageType* dst,
+                            unsigned count)
+    {
+        for (unsigned i = 0; i < count; i++)
+        {
+            dst[i] = toIeee<BitLen>(src[i]);
+        }
+    }
+
+    template <unsigned BitLen>
+    static void toNativeArray(
+        const typename IntegerSpec<BitLen, SignednessUnsigned, CastModeTruncate>::StorageType* src,
+        typename NativeFloatSelector<BitLen>::Type* dst,
+        unsigned count)
+    {
+        for (unsigned i = 0; i < count; i++)
+        {
+            dst[i] = toNative<BitLen>(src[i]);
+        }
+    }
+
     template <unsigned BitLen>
     static typename IntegerSpec<BitLen, SignednessUnsigned, CastModeTruncate>::StorageType
     toIeee(typename NativeFloatSelector<BitLen>::Type value)
@@ -103,6 +135,16 @@ IEEE754Converter::toNative<16>(typename IntegerSpec<16, SignednessUnsigned, Cast
 {
     return halfToNativeIeee(value);
 }
+template <>
+inline void IEEE754Converter::toIeeeArray<16>(const float* src, uint16_t* dst, unsigned count)
+{
+    convertToHalf(src, dst, count);
+}
+template <>
+inline void IEEE754Converter::toNativeArray<16>(const uint16_t* src, float* dst, unsigned count)
+{
+    convertFromHalf(src, dst, count);
+}
 
 
 template <unsigned BitLen> struct IEEE754Limits;
@@ -131,6 +173,10 @@ class UAVCAN_EXPORT FloatSpec : public IEEE754Limits<BitLen_>
 {
     FloatSpec();
 
+    typedef typename IntegerSpec<BitLen_, SignednessUnsigned, CastModeTruncate>::StorageType RawType;
+
+    enum { BulkChunkSize = 16 };
+
 public:
     enum { BitLen = BitLen_ };
     enum { MinBitLen = BitLen };
@@ -177,6 +223,91 @@ public:
         return res;
     }
 
+    /**
+     * Conversion to and from the wire representation, which is used by the generated fused codecs.
+     */
+    static uint64_t toRawBits(StorageType value)
+    {
+        // cppcheck-suppress duplicateExpression
+        if (CastMode == CastModeSaturate)
+        {
+            saturate(value);
+        }
+        else
+        {
+            truncate(value);
+        }
+        return uint64_t(IEEE754Converter::toIeee<BitLen>(value));
+    }
+
+    static StorageType fromRawBits(uint64_t bits)
+    {
+        return IEEE754Converter::toNative<BitLen>(
+            typename IntegerSpec<BitLen, SignednessUnsigned, CastModeTruncate>::StorageType(bits));
+    }
+
+    /**
+     * Bulk versions of encode() and decode(), used by the arrays of float16.
+     * The values are converted in chunks, so that the conversion of a whole chunk is done in one pass.
+     */
+    static int encodeArray(const StorageType* values, unsigned count, ScalarCodec& codec)
+    {
+        StorageType chunk[BulkChunkSize];
+        RawType raw[BulkChunkSize];
+        while (count > 0)
+        {
+            const unsigned chunk_size = min(count, unsigned(BulkChunkSize));
+            for (unsigned i = 0; i < chunk_size; i++)
+            {
+                chunk[i] = values[i];
+                // cppcheck-suppress duplicateExpression
+                if (CastMode == CastModeSaturate)
+                {
+                    saturate(chunk[i]);
+                }
+                else
+                {
+                    truncate(chunk[i]);
+                }
+            }
+            IEEE754Converter::toIeeeArray<BitLen>(chunk, raw, chunk_size);
+            for (unsigned i = 0; i < chunk_size; i++)
+            {
+                const int res = codec.encode<BitLen>(raw[i]);
+                if (res <= 0)
+                {
+                    return res;
+                }
+            }
+            values += chunk_size;
+            count -= chunk_size;
+        }
+        return 1;
+    }
+
+    static int decodeArray(StorageType* out_values, unsigned count, ScalarCodec& codec)
+    {
+        RawType raw[BulkChunkSize];
+        while (count > 0)
+        {
+            const unsigned chunk_size = min(count, unsigned(BulkChunkSize));
+            for (unsigned i = 0; i < chunk_size; i++)
+            {
+                raw[i] = 0;
+                const int res = codec.decode<BitLen>(raw[i]);
+                if (res <= 0)
+                {
+                    IEEE754Converter::toNativeArray<BitLen>(raw, out_values, i);
+                    return res;
+                }
+            }
+            IEEE754Converter::toNativeArray<BitLen>(raw, out_values, chunk_size);
+            out_values += chunk_size;
+            count -= chunk_size;
+        }
+        return 1;
+    }
+
     static void extendDataTypeSignature(DataTypeSignature&) { }
 
 private:
@@ -220,6 +351,19 @@ private:
 };
 
 
+template <typename T>
+struct IsFloat16Spec
+{
+    enum { Result = 0 };
+};
+
+template <CastMode CastMode>
+struct IsFloat16Spec<FloatSpec<16, CastMode> >
+{
+    enum { Result = 1 };
+};
+
+
 template <unsigned BitLen, CastMode CastMode>
 class UAVCAN_EXPORT YamlStreamer<FloatSpec<BitLen, CastMode> >
 {
@@ -233,6 +377,34 @@ public:
     }
 };
 
+template <unsigned BitLen, CastMode CastMode>
+class UAVCAN_EXPORT JsonStreamer<FloatSpec<BitLen, CastMode> >
+{
+    typedef typename FloatSpec<BitLen, CastMode>::StorageType StorageType;
+
+public:
+    /**
+     * The value is written with as many significant digits as needed to represent the precision of the type.
+     * JSON can't represent infinities and NaN, so they are written as null.
+     */
+    template <typename Stream>  // cppcheck-suppress passedByValue
+    static void stream(Stream& s, const StorageType value)
+    {
+        if (!isFinite(value))
+        {
+            s << "null";
+            return;
+        }
+        CharFormatSpec spec;
+        spec.conversion = 'g';
+        spec.has_precision = true;
+        spec.precision = uint8_t((BitLen > 32) ? 17 : ((BitLen > 16) ? 9 : 5));
+        char buffer[CharFormatSpec::MaxOutputLength + 1];
+        buffer[spec.formatFloat(static_cast<double>(value), buffer)] = '\0';
+        s << static_cast<const char*>(buffer);
+    }
+};
+
 }
 
 #endif // UAVCAN_MARSHAL_FLOAT_SPEC_HPP_INCLUDED
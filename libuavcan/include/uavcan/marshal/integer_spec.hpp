@@ -128,6 +128,72 @@ public:
         return codec.decode<BitLen>(out_value);
     }
 
+    /**
+     * Conversion to and from the wire representation, which is used by the generated fused codecs.
+     * The cast mode is applied in the same way as in @ref encode().
+     */
+    static uint64_t toRawBits(StorageType value)
+    {
+        validate();
+        // cppcheck-suppress duplicateExpression
+        if (CastMode == CastModeSaturate)
+        {
+            saturate(value);
+        }
+        return uint64_t(UnsignedStorageType(value) & mask());
+    }
+
+    static StorageType fromRawBits(uint64_t bits)
+    {
+        validate();
+        if (IsSigned && (bits & (uint64_t(1) << (static_cast<unsigned>(BitLen) - 1U))))
+        {
+            bits |= ~uint64_t(mask());  // Sign extension
+        }
+        return StorageType(bits);
+    }
+
+    /**
+     * Bulk encoding and decoding of arrays, used by @ref Array<> for the types that fill their storage completely
+     * (see @ref IsByteAlignedIntegerSpec). The cast mode doesn't matter for them, therefore on little endian hosts
+     * the whole array is passed to the stream as a single block, whatever its bit alignment is.
+     */
+    static int encodeArray(const StorageType* values, unsigned count, ScalarCodec& codec)
+    {
+        StaticAssert<(BitLen == (sizeof(StorageType) * 8))>::check();
+        if ((sizeof(StorageType) == 1) || ScalarCodec::isLittleEndianHost())
+        {
+            return codec.encodeBlock(reinterpret_cast<const uint8_t*>(values), count * unsigned(BitLen));
+        }
+        for (unsigned i = 0; i < count; i++)
+        {
+            const int res = codec.encode<BitLen>(values[i]);
+            if (res <= 0)
+            {
+                return res;
+            }
+        }
+        return 1;
+    }
+
+    static int decodeArray(StorageType* out_values, unsigned count, ScalarCodec& codec)
+    {
+        StaticAssert<(BitLen == (sizeof(StorageType) * 8))>::check();
+        if ((sizeof(StorageType) == 1) || ScalarCodec::isLittleEndianHost())
+        {
+            return codec.decodeBlock(reinterpret_cast<uint8_t*>(out_values), count * unsigned(BitLen));
+        }
+        for (unsigned i = 0; i < count; i++)
+        {
+            const int res = codec.decode<BitLen>(out_values[i]);
+            if (res <= 0)
+            {
+                return res;
+            }
+        }
+        return 1;
+    }
+
     static void extendDataTypeSignature(DataTypeSignature&) { }
 };
 
@@ -165,6 +231,9 @@ public:
         return codec.decode<BitLen>(out_value);
     }
 
+    static uint64_t toRawBits(StorageType value) { return value ? 1U : 0U; }
+    static StorageType fromRawBits(uint64_t bits) { return bits != 0; }
+
     static void extendDataTypeSignature(DataTypeSignature&) { }
 };
 
@@ -187,6 +256,21 @@ struct IsIntegerSpec<IntegerSpec<BitLen, Signedness, CastMode> >
     enum { Result = 1 };
 };
 
+/**
+ * Integers that occupy their storage type completely, i.e. 8, 16, 32 and 64 bits long.
+ */
+template <typename T>
+struct IsByteAlignedIntegerSpec
+{
+    enum { Result = 0 };
+};
+
+template <unsigned BitLen, Signedness Signedness, CastMode CastMode>
+struct IsByteAlignedIntegerSpec<IntegerSpec<BitLen, Signedness, CastMode> >
+{
+    enum { Result = (BitLen == 8) || (BitLen == 16) || (BitLen == 32) || (BitLen == 64) };
+};
+
 
 template <unsigned BitLen, Signedness Signedness, CastMode CastMode>
 class UAVCAN_EXPORT YamlStreamer<IntegerSpec<BitLen, Signedness, CastMode> >
@@ -205,6 +289,30 @@ public:
     }
 };
 
+template <unsigned BitLen, Signedness Signedness, CastMode CastMode>
+class UAVCAN_EXPORT JsonStreamer<IntegerSpec<BitLen, Signedness, CastMode> >
+{
+    typedef IntegerSpec<BitLen, Signedness, CastMode> RawType;
+    typedef typename RawType::StorageType StorageType;
+
+public:
+    /**
+     * Single-bit unsigned integers, i.e. DSDL bool, are written as true or false.
+     */
+    template <typename Stream>  // cppcheck-suppress passedByValue
+    static void stream(Stream& s, const StorageType value)
+    {
+        if ((BitLen == 1) && !RawType::IsSigned)
+        {
+            s << (value ? "true" : "false");
+            return;
+        }
+        typedef typename Select<(sizeof(StorageType) >= sizeof(int)), StorageType,
+                                typename Select<RawType::IsSigned, int, unsigned>::Result >::Result TempType;
+        s << TempType(value);
+    }
+};
+
 }
 
 #endif // UAVCAN_MARSHAL_INTEGER_SPEC_HPP_INCLUDED
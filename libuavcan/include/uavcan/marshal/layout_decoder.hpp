@@ -0,0 +1,254 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_MARSHAL_LAYOUT_DECODER_HPP_INCLUDED
+#define UAVCAN_MARSHAL_LAYOUT_DECODER_HPP_INCLUDED
+
+#include <uavcan/std.hpp>
+#include <uavcan/build_config.hpp>
+#include <uavcan/error.hpp>
+#include <uavcan/data_type.hpp>
+#include <uavcan/marshal/type_util.hpp>
+#include <uavcan/transport/transfer.hpp>
+#include <uavcan/util/templates.hpp>
+
+#if UAVCAN_TINY
+# error "This functionality is not available in tiny mode"
+#endif
+
+namespace uavcan
+{
+/**
+ * Opcodes of the layout bytecode, which is emitted by the DSDL compiler (option --layout-database) and
+ * interpreted by @ref LayoutDecoder. Every value is encoded as an opcode byte followed by its operands;
+ * multi-byte operands are little endian:
+ *
+ *   Struct         u8 num_fields, then num_fields times: u8 name_len, name, '\0', value
+ *   Union          u8 num_fields, u8 tag_bitlen, then the fields as above
+ *   Unsigned       u8 bitlen
+ *   Signed         u8 bitlen
+ *   Float          u8 bitlen (16, 32 or 64)
+ *   Bool           -
+ *   Void           u8 bitlen
+ *   StaticArray    u16 size, element value
+ *   DynamicArray   u16 max_size, u8 length_bitlen, u8 flags (LayoutArrayFlagTailOptimizable), element value
+ *
+ * Nested compound types are inlined, so the layout of every data type is self-contained. Void fields have
+ * empty names. The bit offsets of the fields are not stored, since they follow from the bit lengths.
+ */
+enum LayoutOpcode
+{
+    LayoutOpStruct       = 1,
+    LayoutOpUnion        = 2,
+    LayoutOpUnsigned     = 3,
+    LayoutOpSigned       = 4,
+    LayoutOpFloat        = 5,
+    LayoutOpBool         = 6,
+    LayoutOpVoid         = 7,
+    LayoutOpStaticArray  = 8,
+    LayoutOpDynamicArray = 9
+};
+
+/**
+ * Flags of LayoutOpDynamicArray.
+ * TailOptimizable is set if the minimum bit length of the element is at least 8 bits, i.e. the length prefix of
+ * the array is omitted when the array is the last field of the top-level data structure, see
+ * @ref TailArrayOptimizationMode.
+ */
+enum LayoutArrayFlags
+{
+    LayoutArrayFlagTailOptimizable = 1
+};
+
+/**
+ * Layout of a data type from @ref DataTypeLayoutDatabase; it refers to the memory of the database.
+ * Services have separate layouts for the request and the response.
+ */
+class UAVCAN_EXPORT DataTypeLayout
+{
+    friend class DataTypeLayoutDatabase;
+
+    const char* full_name_;
+    const uint8_t* code_[2];
+    uint16_t code_len_[2];
+    DataTypeSignature signature_;
+    uint16_t default_dtid_;
+    DataTypeKind kind_;
+
+public:
+    static const uint16_t NoDefaultDataTypeID = 0xFFFF;     ///< Hence message data type ID 65535 can't be looked up
+
+    DataTypeLayout()
+        : full_name_("")
+        , default_dtid_(NoDefaultDataTypeID)
+        , kind_(DataTypeKindMessage)
+    {
+        code_[0] = code_[1] = NULL;
+        code_len_[0] = code_len_[1] = 0;
+    }
+
+    const char* getFullName() const { return full_name_; }
+    DataTypeSignature getSignature() const { return signature_; }
+    DataTypeKind getKind() const { return kind_; }
+
+    bool hasDefaultDataTypeID() const { return default_dtid_ != NoDefaultDataTypeID; }
+    DataTypeID getDefaultDataTypeID() const { return DataTypeID(default_dtid_); }
+
+    /**
+     * Bytecode of the payload of the given transfer type; the response layout is used for service responses,
+     * the request (or message) layout otherwise.
+     */
+    const uint8_t* getCode(TransferType transfer_type) const { return code_[codeIndex(transfer_type)]; }
+    unsigned getCodeLength(TransferType transfer_type) const { return code_len_[codeIndex(transfer_type)]; }
+
+private:
+    unsigned codeIndex(TransferType transfer_type) const
+    {
+        return ((kind_ == DataTypeKindService) && (transfer_type == TransferTypeServiceResponse)) ? 1U : 0U;
+    }
+};
+
+/**
+ * Read-only view of a layout database file produced by the DSDL compiler; the database is not copied,
+ * so its memory must outlive this object. The file format (integers are little endian):
+ *
+ *   Header     "ULDB", u8 version, u8 reserved, u16 num_types
+ *   Index      num_types times: u16 default_dtid, u8 kind, u8 reserved, u32 record_offset;
+ *              sorted by kind and data type ID, types without default data type ID (0xFFFF) are last
+ *   Records    u64 signature, u8 name_len, full name, '\0', then the bytecode of the message,
+ *              or of the request and the response: u16 code_len, code
+ *
+ * The lookups by data type ID are a binary search over the index, therefore it is cheap to keep
+ * thousands of data types in one database.
+ */
+class UAVCAN_EXPORT DataTypeLayoutDatabase
+{
+    static const unsigned HeaderSize = 8;
+    static const unsigned IndexEntrySize = 8;
+
+    const uint8_t* data_;
+    unsigned size_;
+    unsigned num_types_;
+
+    static uint16_t readU16(const uint8_t* p) { return uint16_t(p[0] | (p[1] << 8)); }
+
+    int parseRecord(unsigned index, DataTypeLayout& out_layout) const;
+
+public:
+    static const uint8_t FormatVersion = 1;
+
+    DataTypeLayoutDatabase()
+        : data_(NULL)
+        , size_(0)
+        , num_types_(0)
+    { }
+
+    /**
+     * Validates the database and makes it available for lookups.
+     * @return 0 on success, negative error code if the data is not a valid layout database.
+     */
+    int init(const uint8_t* data, unsigned size);
+
+    bool isInitialized() const { return data_ != NULL; }
+
+    unsigned getNumTypes() const { return num_types_; }
+
+    /**
+     * @return True if the index is valid.
+     */
+    bool getLayout(unsigned index, DataTypeLayout& out_layout) const;
+
+    /**
+     * Lookup by the default data type ID.
+     * @return True if found.
+     */
+    bool find(DataTypeKind kind, DataTypeID dtid, DataTypeLayout& out_layout) const;
+
+    /**
+     * Lookup by the full data type name, e.g. "uavcan.protocol.NodeStatus"; this is a linear search.
+     * @return True if found.
+     */
+    bool find(const char* full_name, DataTypeLayout& out_layout) const;
+};
+
+/**
+ * Receives the decoded values from @ref LayoutDecoder, in the order of the fields.
+ * The names point into the database; they are empty for the elements of arrays and for the top-level structure.
+ * Void fields are not reported. Only the selected field of a union is reported.
+ */
+class UAVCAN_EXPORT ILayoutVisitor
+{
+public:
+    virtual ~ILayoutVisitor() { }
+
+    virtual void onBeginStruct(const char* name, bool is_union) = 0;
+    virtual void onEndStruct() = 0;
+
+    virtual void onBeginArray(const char* name) = 0;
+    virtual void onEndArray(unsigned size) = 0;
+
+    virtual void onUnsigned(const char* name, uint64_t value) = 0;
+    virtual void onSigned(const char* name, int64_t value) = 0;
+    virtual void onFloat(const char* name, double value, unsigned bitlen) = 0;
+    virtual void onBool(const char* name, bool value) = 0;
+};
+
+/**
+ * Decodes serialized payloads according to the layout bytecode, without the generated code of the data types,
+ * e.g. for bus monitors and loggers that handle many data types that are not compiled in.
+ * The decoding follows the same rules as the generated code, including the tail array optimization; the payload
+ * is a contiguous byte array, as accumulated by the transfer buffers. The decoder doesn't allocate memory.
+ *
+ * If decoding fails midway, the visitor may have received a part of the values already.
+ */
+class UAVCAN_EXPORT LayoutDecoder : Noncopyable
+{
+public:
+    /// Protection against malformed bytecode; the data types of the standard set are far below this limit
+    enum { MaxNestingDepth = 32 };
+
+private:
+    const uint8_t* const code_end_;
+    const uint8_t* const payload_;
+    const unsigned payload_bitlen_;
+    unsigned bit_offset_;
+    ILayoutVisitor& visitor_;
+
+    LayoutDecoder(const uint8_t* code_end, const uint8_t* payload, unsigned payload_len, ILayoutVisitor& visitor)
+        : code_end_(code_end)
+        , payload_(payload)
+        , payload_bitlen_(payload_len * 8U)
+        , bit_offset_(0)
+        , visitor_(visitor)
+    { }
+
+    bool readCode(const uint8_t*& pc, unsigned num_bytes, unsigned& out_value) const;
+    bool readBits(unsigned bitlen, uint64_t& out_value);
+
+    int skipValue(const uint8_t*& pc, unsigned depth) const;
+    int skipToFieldValue(const uint8_t*& pc, const char*& out_name) const;
+
+    int decodeValue(const uint8_t*& pc, const char* name, TailArrayOptimizationMode tao_mode, unsigned depth);
+    int decodeStruct(const uint8_t*& pc, const char* name, TailArrayOptimizationMode tao_mode, unsigned depth,
+                     bool is_union);
+    int decodeArray(const uint8_t*& pc, const char* name, TailArrayOptimizationMode tao_mode, unsigned depth,
+                    bool is_dynamic);
+
+public:
+    /**
+     * @param layout            Layout of the data type.
+     * @param transfer_type     Selects the request or the response layout of a service.
+     * @param payload           Transfer payload; may be null if the length is zero.
+     * @param visitor           Receives the values.
+     * @return                  0 on success;
+     *                          -ErrInvalidMarshalData if the payload doesn't match the layout;
+     *                          -ErrInvalidParam if the bytecode is malformed.
+     */
+    static int decode(const DataTypeLayout& layout, TransferType transfer_type,
+                      const uint8_t* payload, unsigned payload_len, ILayoutVisitor& visitor);
+};
+
+}
+
+#endif // UAVCAN_MARSHAL_LAYOUT_DECODER_HPP_INCLUDED
@@ -0,0 +1,191 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_MARSHAL_PAYLOAD_VIEW_HPP_INCLUDED
+#define UAVCAN_MARSHAL_PAYLOAD_VIEW_HPP_INCLUDED
+
+#include <uavcan/std.hpp>
+#include <uavcan/build_config.hpp>
+#include <uavcan/marshal/type_util.hpp>
+#include <uavcan/marshal/scalar_codec.hpp>
+#include <uavcan/util/templates.hpp>
+
+namespace uavcan
+{
+
+template <typename T> class PayloadArrayView;
+
+/**
+ * Base class of the read-only views generated for every data type (nested class DataType::View).
+ * A view refers to a serialized payload and extracts the fields on demand, so a subscriber that needs only
+ * a few fields of a large message doesn't have to decode it completely:
+ *
+ *   const uavcan::protocol::NodeStatus::View view(payload, payload_len);
+ *   const uint32_t uptime = view.uptime_sec();
+ *
+ * The bit offsets of the fields are compile-time constants, except for the fields that follow a dynamic array,
+ * which are located using an offset table that the view builds upon first access.
+ * Fields that follow a nested data type of variable length have no accessors; use the regular decoding for them.
+ *
+ * The view doesn't validate the payload: reading past the end of the payload yields zeros, and the lengths
+ * of dynamic arrays are clamped to their maximum size. The payload memory must outlive the view.
+ * Everything except the constructors is used by the generated code only.
+ */
+class UAVCAN_EXPORT PayloadView
+{
+    const uint8_t* payload_;
+    unsigned payload_bitlen_;
+    unsigned bit_offset_;
+    TailArrayOptimizationMode tao_mode_;
+
+public:
+    /**
+     * Empty payload; all fields read as zeros.
+     */
+    PayloadView()
+        : payload_(NULL)
+        , payload_bitlen_(0)
+        , bit_offset_(0)
+        , tao_mode_(TailArrayOptDisabled)
+    { }
+
+    /**
+     * Top-level data structure; the tail array optimization is enabled, as for the transfer payloads.
+     */
+    PayloadView(const uint8_t* payload, unsigned payload_len)
+        : payload_(payload)
+        , payload_bitlen_(payload_len * 8U)
+        , bit_offset_(0)
+        , tao_mode_(TailArrayOptEnabled)
+    { }
+
+    /**
+     * Nested data structure at the given bit offset relative to the parent.
+     */
+    PayloadView(const PayloadView& parent, unsigned bit_offset, TailArrayOptimizationMode tao_mode)
+        : payload_(parent.payload_)
+        , payload_bitlen_(parent.payload_bitlen_)
+        , bit_offset_(parent.bit_offset_ + bit_offset)
+        , tao_mode_(tao_mode)
+    { }
+
+    const uint8_t* getPayload() const { return payload_; }
+    unsigned getPayloadBitLen() const { return payload_bitlen_; }
+    unsigned getBitOffset() const { return bit_offset_; }
+    TailArrayOptimizationMode getTailArrayOptMode() const { return tao_mode_; }
+
+    /**
+     * Number of bits of the payload after the given offset relative to this view.
+     */
+    unsigned getRemainingBitLen(unsigned offset) const
+    {
+        const unsigned abs_offset = bit_offset_ + offset;
+        return (abs_offset < payload_bitlen_) ? (payload_bitlen_ - abs_offset) : 0U;
+    }
+
+    /**
+     * Raw bits at the given offset relative to this view; zero if the payload is too short.
+     */
+    uint64_t readRawBits(unsigned offset, unsigned bitlen) const
+    {
+        if (getRemainingBitLen(offset) < bitlen)
+        {
+            return 0;
+        }
+        return ScalarCodec::unpackBits(payload_, bit_offset_ + offset, bitlen);
+    }
+
+    template <typename ArrayType>
+    PayloadArrayView<typename ArrayType::RawValueType> makeStaticArrayView(unsigned offset) const
+    {
+        return PayloadArrayView<typename ArrayType::RawValueType>(*this, offset, unsigned(ArrayType::MaxSize));
+    }
+
+    /**
+     * The tail array optimization applies under the same conditions as for @ref Array.
+     */
+    template <typename ArrayType>
+    PayloadArrayView<typename ArrayType::RawValueType>
+    makeDynamicArrayView(unsigned offset, TailArrayOptimizationMode tao_mode) const
+    {
+        typedef typename ArrayType::RawValueType RawValueType;
+        if ((tao_mode == TailArrayOptEnabled) && (unsigned(RawValueType::MinBitLen) >= 8U))
+        {
+            const unsigned size = getRemainingBitLen(offset) / unsigned(RawValueType::MaxBitLen);
+            return PayloadArrayView<RawValueType>(*this, offset, min(size, unsigned(ArrayType::MaxSize)));
+        }
+        const unsigned prefix_bitlen = IntegerBitLen<ArrayType::MaxSize>::Result;
+        const unsigned size = unsigned(readRawBits(offset, prefix_bitlen));
+        return PayloadArrayView<RawValueType>(*this, offset + prefix_bitlen, min(size, unsigned(ArrayType::MaxSize)));
+    }
+
+    /**
+     * Offset of the data that follows a dynamic array that is not the last field.
+     */
+    template <typename ArrayType>
+    unsigned getDynamicArrayEnd(unsigned offset) const
+    {
+        const unsigned prefix_bitlen = IntegerBitLen<ArrayType::MaxSize>::Result;
+        const unsigned size = min(unsigned(readRawBits(offset, prefix_bitlen)), unsigned(ArrayType::MaxSize));
+        return offset + prefix_bitlen + size * unsigned(ArrayType::RawValueType::MaxBitLen);
+    }
+};
+
+/**
+ * Compile-time: element accessor of @ref PayloadArrayView.
+ * Primitive elements are decoded into their storage type; nested data types are represented by their views.
+ */
+template <typename T, typename Enable = void>
+struct PayloadViewElement
+{
+    typedef typename T::View Type;
+    static Type get(const PayloadView& array, unsigned offset) { return Type(array, offset, TailArrayOptDisabled); }
+};
+template <typename T>
+struct PayloadViewElement<T, typename EnableIfType<typename T::StorageType>::Type>
+{
+    typedef typename T::StorageType Type;
+    static Type get(const PayloadView& array, unsigned offset)
+    {
+        return T::fromRawBits(array.readRawBits(offset, unsigned(T::BitLen)));
+    }
+};
+
+/**
+ * Read-only view of an array field; the elements are of fixed length.
+ * Out of range indexes yield zero values.
+ */
+template <typename T>
+class UAVCAN_EXPORT PayloadArrayView : public PayloadView
+{
+    unsigned size_;
+
+public:
+    typedef typename PayloadViewElement<T>::Type ValueType;
+
+    enum { ElementBitLen = T::MaxBitLen };
+
+    PayloadArrayView(const PayloadView& parent, unsigned bit_offset, unsigned size)
+        : PayloadView(parent, bit_offset, TailArrayOptDisabled)
+        , size_(size)
+    {
+        StaticAssert<unsigned(T::MinBitLen) == unsigned(T::MaxBitLen)>::check();
+    }
+
+    unsigned size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    ValueType operator[](unsigned index) const
+    {
+        if (index >= size_)
+        {
+            return PayloadViewElement<T>::get(PayloadView(), 0);
+        }
+        return PayloadViewElement<T>::get(*this, index * unsigned(ElementBitLen));
+    }
+};
+
+}
+
+#endif // UAVCAN_MARSHAL_PAYLOAD_VIEW_HPP_INCLUDED
@@ -19,6 +19,8 @@ namespace uavcan
  */
 class UAVCAN_EXPORT ScalarCodec
 {
+    static const unsigned MaxBlockChunkBits = BitStream::MaxBitsPerRW - 8;
+
     BitStream& stream_;
 
     static void swapByteOrder(uint8_t* bytes, unsigned len);
@@ -27,13 +29,7 @@ class UAVCAN_EXPORT ScalarCodec
     static typename EnableIf<(BitLen > 8)>::Type
     convertByteOrder(uint8_t (&bytes)[Size])
     {
-#if defined(BYTE_ORDER) && defined(BIG_ENDIAN)
-        static const bool big_endian = BYTE_ORDER == BIG_ENDIAN;
-#else
-        union { long int l; char c[sizeof(long int)]; } u;
-        u.l = 1;
-        const bool big_endian = u.c[sizeof(long int) - 1] == 1;
-#endif
+        const bool big_endian = !isLittleEndianHost();
         /*
          * I didn't have any big endian machine nearby, so big endian support wasn't tested yet.
          * It is likely to be OK anyway, so feel free to remove this UAVCAN_ASSERT() as needed.
@@ -91,11 +87,79 @@ public:
         : stream_(stream)
     { }
 
+    /**
+     * On little endian hosts, arrays of integers whose bit length matches the storage type have the same
+     * representation in memory and on the wire, so they can be passed through @ref encodeBlock() as is.
+     */
+    static inline bool isLittleEndianHost()
+    {
+#if defined(BYTE_ORDER) && defined(BIG_ENDIAN)
+        static const bool big_endian = BYTE_ORDER == BIG_ENDIAN;
+#else
+        union { long int l; char c[sizeof(long int)]; } u;
+        u.l = 1;
+        const bool big_endian = u.c[sizeof(long int) - 1] == 1;
+#endif
+        return !big_endian;
+    }
+
     template <unsigned BitLen, typename T>
     int encode(const T value);
 
     template <unsigned BitLen, typename T>
     int decode(T& value);
+
+    /**
+     * Write/read a pre-packed bit array of arbitrary length, see @ref BitStream for the bit order.
+     * These are used by the generated code of data types with fully static layout: fields are packed into a local
+     * byte array at compile-time known offsets with @ref packBits(), and then the whole array is passed to the
+     * stream at once, instead of going through the stream field by field.
+     * If the stream is byte aligned and the length is a whole number of bytes, the block is copied in one go;
+     * otherwise it is shifted into place in chunks.
+     * Return values are the same as for the single value methods.
+     */
+    int encodeBlock(const uint8_t* bytes, unsigned bitlen);
+    int decodeBlock(uint8_t* bytes, unsigned bitlen);
+
+    /**
+     * Places the BitLen least significant bits of the value into a zero-initialized bit array at the given offset,
+     * in the same wire format as @ref encode() would produce. Unpacking is the inverse operation; sign extension
+     * is left to the caller. When the arguments are compile-time constants, this folds into a few shifts and masks.
+     */
+    static inline void packBits(uint8_t* bytes, unsigned bit_offset, unsigned bitlen, uint64_t value)
+    {
+        for (unsigned i = 0; i < bitlen; i += 8)
+        {
+            // Every byte of the little-endian value goes MSB-first; bits of the last incomplete byte are left-aligned
+            const unsigned n = ((bitlen - i) < 8U) ? (bitlen - i) : 8U;
+            const unsigned shift = bit_offset % 8U;
+            const unsigned window = unsigned((value >> i) & ((1U << n) - 1U)) << (16U - n - shift);
+            bytes[bit_offset / 8U] = uint8_t(bytes[bit_offset / 8U] | (window >> 8));
+            if ((shift + n) > 8U)
+            {
+                bytes[bit_offset / 8U + 1U] = uint8_t(bytes[bit_offset / 8U + 1U] | (window & 0xFFU));
+            }
+            bit_offset += n;
+        }
+    }
+
+    static inline uint64_t unpackBits(const uint8_t* bytes, unsigned bit_offset, unsigned bitlen)
+    {
+        uint64_t value = 0;
+        for (unsigned i = 0; i < bitlen; i += 8)
+        {
+            const unsigned n = ((bitlen - i) < 8U) ? (bitlen - i) : 8U;
+            const unsigned shift = bit_offset % 8U;
+            unsigned window = unsigned(bytes[bit_offset / 8U]) << 8;
+            if ((shift + n) > 8U)
+            {
+                window |= bytes[bit_offset / 8U + 1U];
+            }
+            value |= uint64_t((window >> (16U - n - shift)) & ((1U << n) - 1U)) << i;
+            bit_offset += n;
+        }
+        return value;
+    }
 };
 
 // ----------------------------------------------------------------------------
@@ -83,6 +83,12 @@ public:
 template <typename T>
 class UAVCAN_EXPORT YamlStreamer;
 
+/**
+ * Streams a given value into compact JSON string. Please see the specializations.
+ */
+template <typename T>
+class UAVCAN_EXPORT JsonStreamer;
+
 }
 
 #endif // UAVCAN_MARSHAL_TYPE_UTIL_HPP_INCLUDED
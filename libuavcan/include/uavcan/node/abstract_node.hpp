@@ -123,6 +123,76 @@ public:
     void removeRxFrameListener()                       { getDispatcher().removeRxFrameListener(); }
     void installRxFrameListener(IRxFrameListener* lst) { getDispatcher().installRxFrameListener(lst); }
 #endif
+
+#if UAVCAN_LATENCY_STATS
+    /**
+     * Latency histograms of the TX and RX pipelines; see @ref LatencyStage.
+     * The histograms are shared by all publishers and subscribers of the node and can be reset by the application.
+     */
+    const LatencyHistogram& getLatencyHistogram(LatencyStage stage) const
+    {
+        return getDispatcher().getTransferPerfCounter().getLatencyHistogram(stage);
+    }
+    LatencyHistogram& getLatencyHistogram(LatencyStage stage)
+    {
+        return getDispatcher().getTransferPerfCounter().getLatencyHistogram(stage);
+    }
+#endif
+
+#if UAVCAN_EXECUTION_TIME_STATS
+    /**
+     * Execution time measurements are taken only while the cycle counter is installed; see @ref ExecutionStage.
+     * The cycle counter object must outlive the node, or it must be removed by passing a null pointer.
+     */
+    void setCycleCounter(const ICycleCounter* cycle_counter)
+    {
+        getDispatcher().getTransferPerfCounter().setCycleCounter(cycle_counter);
+    }
+
+    /**
+     * Execution time histograms of the stages of @ref spin(); see @ref ExecutionStage.
+     * The histograms can be reset by the application, e.g. after the initialization, which is usually not
+     * representative of the steady state.
+     */
+    const ExecutionTimeHistogram& getExecutionTimeHistogram(ExecutionStage stage) const
+    {
+        return getDispatcher().getTransferPerfCounter().getExecutionTimeHistogram(stage);
+    }
+    ExecutionTimeHistogram& getExecutionTimeHistogram(ExecutionStage stage)
+    {
+        return getDispatcher().getTransferPerfCounter().getExecutionTimeHistogram(stage);
+    }
+#endif
+
+#if UAVCAN_DUTY_CYCLE_STATS
+    /**
+     * Time spent by the library in RX and TX processing, deadline handlers and callbacks per measurement window;
+     * see @ref DutyCycleCounter.
+     */
+    const DutyCycleCounter& getDutyCycleCounter() const
+    {
+        return getDispatcher().getTransferPerfCounter().getDutyCycleCounter();
+    }
+    DutyCycleCounter& getDutyCycleCounter() { return getDispatcher().getTransferPerfCounter().getDutyCycleCounter(); }
+#endif
+
+#if UAVCAN_EVENT_TRACE
+    /**
+     * Binary trace of the transport events of the node; see @ref EventTrace.
+     */
+    const EventTrace& getEventTrace() const { return getDispatcher().getTransferPerfCounter().getEventTrace(); }
+    EventTrace& getEventTrace() { return getDispatcher().getTransferPerfCounter().getEventTrace(); }
+#endif
+
+#if UAVCAN_DATA_TYPE_PERF_STATS
+    /**
+     * Traffic counters of the individual data types; see @ref DataTypePerfCounters.
+     */
+    const DataTypePerfCounters& getDataTypePerfCounters() const
+    {
+        return getDispatcher().getTransferPerfCounter().getDataTypePerfCounters();
+    }
+#endif
 };
 
 }
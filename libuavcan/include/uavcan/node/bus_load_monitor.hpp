@@ -0,0 +1,324 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_NODE_BUS_LOAD_MONITOR_HPP_INCLUDED
+#define UAVCAN_NODE_BUS_LOAD_MONITOR_HPP_INCLUDED
+
+#include <uavcan/build_config.hpp>
+#include <uavcan/error.hpp>
+#include <uavcan/node/timer.hpp>
+#include <uavcan/node/abstract_node.hpp>
+#include <uavcan/transport/dispatcher.hpp>
+#include <uavcan/util/linked_list.hpp>
+#include <uavcan/util/templates.hpp>
+
+#if !UAVCAN_TINY
+
+namespace uavcan
+{
+/**
+ * Congestion levels reported by @ref BusLoadMonitor, in the ascending order of severity.
+ */
+enum BusCongestionLevel
+{
+    BusCongestionLevelNormal,
+    BusCongestionLevelElevated,
+    BusCongestionLevelHigh,
+    BusCongestionLevelCritical,
+    NumBusCongestionLevels
+};
+
+/**
+ * The most recent evaluation of @ref BusLoadMonitor.
+ * Load is expressed in per mille of the bus capacity; it may slightly exceed 1000, since the frame length
+ * is estimated conservatively.
+ */
+struct UAVCAN_EXPORT BusLoadEstimate
+{
+    BusCongestionLevel level;
+    uint16_t iface_load_permille[MaxCanIfaces];     ///< Filtered load of every bus
+    uint16_t max_load_permille;                     ///< Maximum of the above; the level is based on this value
+    uint32_t num_tx_errors;                         ///< TX errors and rejected frames during the last interval
+    MonotonicTime timestamp;
+
+    BusLoadEstimate()
+        : level(BusCongestionLevelNormal)
+        , max_load_permille(0)
+        , num_tx_errors(0)
+    {
+        fill_n(iface_load_permille, unsigned(MaxCanIfaces), uint16_t(0));
+    }
+};
+
+/**
+ * Implement this interface and register it with @ref BusLoadMonitor::addCongestionListener() to be notified
+ * when the congestion level changes.
+ */
+class UAVCAN_EXPORT IBusCongestionListener : public LinkedListNode<IBusCongestionListener>
+{
+public:
+    virtual ~IBusCongestionListener() { }
+
+    virtual void handleBusCongestionLevelChange(const BusLoadEstimate& estimate) = 0;
+};
+
+/**
+ * Estimates the utilization of the buses as seen by the local node, and turns it into a congestion level
+ * with configurable thresholds and hysteresis.
+ *
+ * The RX and loopback frames are observed through @ref IRxFrameListener; their length in bits is computed from
+ * the DLC, including the worst case bit stuffing. The transmitted frames that are not looped back are counted
+ * via @ref CanIfacePerfCounters and accounted for as frames of the maximum length. Every update interval, the bits
+ * of the interval are divided by the bit rate of the bus, and the result is smoothed with an exponential moving
+ * average. Since the TX errors of the interface and the frames rejected by the TX queues are the first symptom
+ * of congestion for low priority traffic, any of them during the interval raises the level to at least
+ * @ref BusCongestionLevelHigh.
+ *
+ * The dispatcher holds only one RX frame listener; the monitor forwards all frames to the listener that was
+ * installed before it was started, and restores it when stopped. It must be stopped before that listener
+ * is destroyed, and a listener installed after the monitor will replace it.
+ */
+class UAVCAN_EXPORT BusLoadMonitor : public IRxFrameListener, private TimerBase
+{
+public:
+    enum { DefaultThresholdElevatedPermille = 500 };
+    enum { DefaultThresholdHighPermille = 700 };
+    enum { DefaultThresholdCriticalPermille = 850 };
+    enum { DefaultHysteresisPermille = 50 };
+
+private:
+    struct IfaceState
+    {
+        uint32_t num_bits;
+        uint32_t num_loopback_frames;
+        uint64_t prev_frames_tx;
+        uint64_t prev_errors;
+
+        IfaceState()
+            : num_bits(0)
+            , num_loopback_frames(0)
+            , prev_frames_tx(0)
+            , prev_errors(0)
+        { }
+    };
+
+    INode& node_;
+    IfaceState ifaces_[MaxCanIfaces];
+    BusLoadEstimate estimate_;
+    LinkedListRoot<IBusCongestionListener> listeners_;
+    IRxFrameListener* next_listener_;
+    MonotonicTime prev_update_;
+    uint32_t bitrate_;
+    uint16_t thresholds_[NumBusCongestionLevels - 1];
+    uint16_t hysteresis_;
+    bool started_;
+
+    BusCongestionLevel computeLevel(uint16_t load_permille, uint32_t num_tx_errors) const;
+
+    virtual void handleRxFrame(const CanRxFrame& frame, CanIOFlags flags);
+    virtual void handleTimerEvent(const TimerEvent& event);
+
+public:
+    explicit BusLoadMonitor(INode& node)
+        : TimerBase(node)
+        , node_(node)
+        , next_listener_(NULL)
+        , bitrate_(0)
+        , hysteresis_(DefaultHysteresisPermille)
+        , started_(false)
+    {
+        thresholds_[0] = DefaultThresholdElevatedPermille;
+        thresholds_[1] = DefaultThresholdHighPermille;
+        thresholds_[2] = DefaultThresholdCriticalPermille;
+    }
+
+    ~BusLoadMonitor() { stop(); }
+
+    static MonotonicDuration getDefaultUpdateInterval() { return MonotonicDuration::fromMSec(200); }
+
+    /**
+     * Length of a CAN frame with 29-bit ID on the wire, including the interframe space and the worst case
+     * bit stuffing.
+     */
+    static unsigned getFrameBitLength(uint8_t dlc)
+    {
+        const unsigned data_bits = 8U * min(dlc, uint8_t(CanFrame::MaxDataLen));
+        return 67U + data_bits + (53U + data_bits) / 4U;
+    }
+
+    /**
+     * @param bitrate           Bit rate of the buses, bits per second; the same for all interfaces.
+     * @param update_interval   How often the load is evaluated and the listeners are notified.
+     * Returns negative error code if the parameters are invalid.
+     */
+    int start(uint32_t bitrate, MonotonicDuration update_interval = getDefaultUpdateInterval());
+
+    void stop();
+
+    bool isStarted() const { return started_; }
+
+    /**
+     * The level is raised when the load reaches its threshold, and lowered when the load drops below the
+     * threshold by more than the hysteresis. The thresholds must be in the ascending order.
+     * Returns negative error code if the thresholds are invalid.
+     */
+    int setThresholds(uint16_t elevated_permille, uint16_t high_permille, uint16_t critical_permille);
+
+    uint16_t getThreshold(BusCongestionLevel level) const
+    {
+        return (level > BusCongestionLevelNormal && level < NumBusCongestionLevels) ? thresholds_[level - 1] : 0;
+    }
+
+    void setHysteresis(uint16_t hysteresis_permille) { hysteresis_ = hysteresis_permille; }
+    uint16_t getHysteresis() const { return hysteresis_; }
+
+    uint32_t getBitrate() const { return bitrate_; }
+
+    const BusLoadEstimate& getEstimate() const { return estimate_; }
+    BusCongestionLevel getCongestionLevel() const { return estimate_.level; }
+
+    /**
+     * The listeners are invoked from the update in the order of registration, only when the level changes.
+     */
+    void addCongestionListener(IBusCongestionListener* listener);
+    void removeCongestionListener(IBusCongestionListener* listener);
+    unsigned getNumCongestionListeners() const { return listeners_.getLength(); }
+};
+
+/**
+ * Slows down the non-critical periodic activities, e.g. publications, when the bus is congested, by multiplying
+ * the periods of the registered timers by the factor of the current congestion level. The timers are restarted
+ * with the new period at every level change; the timers that are not running are left alone, so they can be
+ * stopped and started by the application as usual, as long as they are started with the nominal period.
+ *
+ *   uavcan::BusLoadMonitor monitor(node);
+ *   uavcan::PublicationRateController<4> controller;
+ *   controller.add(telemetry_timer, uavcan::MonotonicDuration::fromMSec(20));
+ *   monitor.addCongestionListener(&controller);
+ *   monitor.start(1000000);
+ *
+ * Timers that run within a @ref TimerGroup can't be controlled, since the period belongs to the group.
+ *
+ * @tparam MaxTimers    Number of timers that can be registered.
+ */
+template <unsigned MaxTimers>
+class UAVCAN_EXPORT PublicationRateController : public IBusCongestionListener, Noncopyable
+{
+    struct Entry
+    {
+        TimerBase* timer;
+        MonotonicDuration nominal_period;
+
+        Entry() : timer(NULL) { }
+    };
+
+    Entry entries_[MaxTimers];
+    uint8_t multipliers_[NumBusCongestionLevels];
+    BusCongestionLevel level_;
+
+    void apply(const Entry& entry) const
+    {
+        if (entry.timer->isRunning() && (entry.timer->getGroup() == NULL))
+        {
+            entry.timer->startPeriodic(entry.nominal_period * multipliers_[level_]);
+        }
+    }
+
+    virtual void handleBusCongestionLevelChange(const BusLoadEstimate& estimate)
+    {
+        level_ = estimate.level;
+        for (unsigned i = 0; i < MaxTimers; i++)
+        {
+            if (entries_[i].timer != NULL)
+            {
+                apply(entries_[i]);
+            }
+        }
+    }
+
+public:
+    PublicationRateController()
+        : level_(BusCongestionLevelNormal)
+    {
+        StaticAssert<(MaxTimers > 0)>::check();
+        multipliers_[BusCongestionLevelNormal] = 1;
+        multipliers_[BusCongestionLevelElevated] = 2;
+        multipliers_[BusCongestionLevelHigh] = 4;
+        multipliers_[BusCongestionLevelCritical] = 8;
+    }
+
+    /**
+     * Registers the timer; if it is running, it is restarted with the period for the current congestion level.
+     * Returns negative error code if there is no free slot or the timer is already registered.
+     */
+    int add(TimerBase& timer, MonotonicDuration nominal_period)
+    {
+        if (!nominal_period.isPositive())
+        {
+            return -ErrInvalidParam;
+        }
+        Entry* free_entry = NULL;
+        for (unsigned i = 0; i < MaxTimers; i++)
+        {
+            if (entries_[i].timer == &timer)
+            {
+                return -ErrLogic;
+            }
+            if (entries_[i].timer == NULL && free_entry == NULL)
+            {
+                free_entry = &entries_[i];
+            }
+        }
+        if (free_entry == NULL)
+        {
+            return -ErrMemory;
+        }
+        free_entry->timer = &timer;
+        free_entry->nominal_period = nominal_period;
+        apply(*free_entry);
+        return 0;
+    }
+
+    /**
+     * Unregisters the timer; if it is running, it is restarted with the nominal period.
+     */
+    void remove(TimerBase& timer)
+    {
+        for (unsigned i = 0; i < MaxTimers; i++)
+        {
+            if (entries_[i].timer == &timer)
+            {
+                if (timer.isRunning() && (timer.getGroup() == NULL))
+                {
+                    timer.startPeriodic(entries_[i].nominal_period);
+                }
+                entries_[i] = Entry();
+            }
+        }
+    }
+
+    /**
+     * Period multiplier for the congestion level; the default multipliers are 1, 2, 4, and 8.
+     * Zero is not allowed. Takes effect at the next level change.
+     */
+    void setPeriodMultiplier(BusCongestionLevel level, uint8_t multiplier)
+    {
+        if (level < NumBusCongestionLevels && multiplier > 0)
+        {
+            multipliers_[level] = multiplier;
+        }
+    }
+    uint8_t getPeriodMultiplier(BusCongestionLevel level) const
+    {
+        return (level < NumBusCongestionLevels) ? multipliers_[level] : 1U;
+    }
+
+    BusCongestionLevel getCongestionLevel() const { return level_; }
+};
+
+}
+
+#endif // !UAVCAN_TINY
+
+#endif // UAVCAN_NODE_BUS_LOAD_MONITOR_HPP_INCLUDED
@@ -12,17 +12,26 @@
 #include <uavcan/debug.hpp>
 #include <uavcan/transport/transfer_buffer.hpp>
 #include <uavcan/transport/transfer_sender.hpp>
+#include <uavcan/transport/token_bucket.hpp>
 #include <uavcan/marshal/scalar_codec.hpp>
 #include <uavcan/marshal/types.hpp>
 
 namespace uavcan
 {
 
+class UAVCAN_EXPORT TxCompletionMonitorBase;
+
 class GenericPublisherBase : Noncopyable
 {
     TransferSender sender_;
     MonotonicDuration tx_timeout_;
     INode& node_;
+    TokenBucket shaper_;
+    uint32_t rate_limited_cnt_;
+#if !UAVCAN_TINY
+    TxCompletionMonitorBase* tx_completion_monitor_;
+#endif
+    OutgoingTransferBufferImpl* scratch_buffer_;
 
 protected:
     GenericPublisherBase(INode& node, MonotonicDuration tx_timeout,
@@ -30,6 +39,11 @@ protected:
         : sender_(node.getDispatcher(), max_transfer_interval)
         , tx_timeout_(tx_timeout)
         , node_(node)
+        , rate_limited_cnt_(0)
+#if !UAVCAN_TINY
+        , tx_completion_monitor_(NULL)
+#endif
+        , scratch_buffer_(NULL)
     {
         setTxTimeout(tx_timeout);
 #if UAVCAN_DEBUG
@@ -45,12 +59,19 @@ protected:
 
     MonotonicTime getTxDeadline() const;
 
-    int genericPublish(const StaticTransferBufferImpl& buffer, TransferType transfer_type,
-                       NodeID dst_node_id, TransferID* tid, MonotonicTime blocking_deadline);
+    /**
+     * The TX deadline is computed from the moment the publication was requested, so that the time spent
+     * encoding the transfer is accounted for; this moment is also used for @ref LatencyStageTxPublishToTransport.
+     */
+    int genericPublish(OutgoingTransferBufferImpl& buffer, TransferType transfer_type,
+                       NodeID dst_node_id, TransferID* tid, MonotonicTime blocking_deadline,
+                       MonotonicTime published_at);
 
     TransferSender& getTransferSender() { return sender_; }
     const TransferSender& getTransferSender() const { return sender_; }
 
+    void setScratchBufferUnchecked(OutgoingTransferBufferImpl* buffer) { scratch_buffer_ = buffer; }
+
 public:
     static MonotonicDuration getMinTxTimeout() { return MonotonicDuration::fromUSec(200); }
     static MonotonicDuration getMaxTxTimeout() { return MonotonicDuration::fromMSec(60000); }
@@ -73,6 +94,62 @@ public:
     TransferPriority getPriority() const { return sender_.getPriority(); }
     void setPriority(const TransferPriority prio) { sender_.setPriority(prio); }
 
+    /**
+     * Last value wins: if a single-frame transfer of this publisher is still waiting in the TX queue when the next
+     * one is published, the queued one will be discarded instead of being transmitted after it.
+     * Recommended for high-rate periodic messages where only the freshest value matters.
+     * Multi-frame transfers are not affected. Disabled by default.
+     */
+    void setReplacePending(bool replace)
+    {
+        const CanIOFlags flags = sender_.getCanIOFlags();
+        sender_.setCanIOFlags(CanIOFlags(replace ? (flags | CanIOFlagReplacePending) :
+                                                   (flags & ~CanIOFlagReplacePending)));
+    }
+    bool isReplacePendingEnabled() const { return (sender_.getCanIOFlags() & CanIOFlagReplacePending) != 0; }
+
+    /**
+     * Limits the average rate of this publisher to the specified number of payload bytes per second, allowing
+     * bursts of up to burst_bytes. Publications that exceed the budget fail with @ref ErrRateLimited.
+     * Zero rate removes the limit, which is the default. Transfers longer than the burst will never pass.
+     * See also @ref CanIOManager::setIfaceTxRateLimit().
+     */
+    void setRateLimit(uint32_t bytes_per_sec, uint32_t burst_bytes) { shaper_.configure(bytes_per_sec, burst_bytes); }
+    uint32_t getRateLimitBytesPerSec() const { return shaper_.getRate(); }
+
+    /**
+     * Number of publications rejected because of the rate limit.
+     */
+    uint32_t getRateLimitedTransferCount() const { return rate_limited_cnt_; }
+
+    /**
+     * Backpressure: occupancy of the TX queues of the interfaces this publisher sends to, the worst among them.
+     * Producers of bulk data can use it to pace themselves before the frames start being rejected;
+     * e.g. a one-shot timer can be started with the estimated drain time.
+     * See @ref CanIOManager::getIfaceTxQueueStatus().
+     */
+    CanIfaceTxQueueStatus getTxQueueStatus() const;
+
+#if !UAVCAN_TINY
+    /**
+     * Reports every transfer published from now on to the monitor, which will learn when it has been transmitted
+     * or that it has expired; see @ref TxCompletionMonitor. This enables @ref CanIOFlagLoopback.
+     * Once all slots of the monitor are occupied, publishing fails with @ref ErrMemory.
+     * Pass NULL to detach the monitor, which also disables the loopback flag. The monitor must outlive the
+     * publisher, or be detached before destruction.
+     */
+    void setTxCompletionMonitor(TxCompletionMonitorBase* monitor)
+    {
+        tx_completion_monitor_ = monitor;
+        const CanIOFlags flags = sender_.getCanIOFlags();
+        sender_.setCanIOFlags(CanIOFlags((monitor != NULL) ? (flags | CanIOFlagLoopback) :
+                                                              (flags & ~CanIOFlagLoopback)));
+    }
+    TxCompletionMonitorBase* getTxCompletionMonitor() const { return tx_completion_monitor_; }
+#endif
+
+    OutgoingTransferBufferImpl* getScratchBuffer() const { return scratch_buffer_; }
+
     INode& getNode() const { return node_; }
 };
 
@@ -84,14 +161,13 @@ public:
 template <typename DataSpec, typename DataStruct>
 class UAVCAN_EXPORT GenericPublisher : public GenericPublisherBase
 {
-    struct ZeroTransferBuffer : public StaticTransferBufferImpl
-    {
-        ZeroTransferBuffer() : StaticTransferBufferImpl(NULL, 0) { }
-    };
+public:
+    /**
+     * Buffer that can hold an encoded object of this type, see @ref encode().
+     */
+    typedef OutgoingTransferBuffer<BitLenToByteLen<DataStruct::MaxBitLen>::Result> EncodedBuffer;
 
-    typedef typename Select<DataStruct::MaxBitLen == 0,
-                            ZeroTransferBuffer,
-                            StaticTransferBuffer<BitLenToByteLen<DataStruct::MaxBitLen>::Result> >::Result Buffer;
+private:
 
     enum
     {
@@ -106,6 +182,10 @@ class UAVCAN_EXPORT GenericPublisher : public GenericPublisherBase
     int genericPublish(const DataStruct& message, TransferType transfer_type, NodeID dst_node_id,
                        TransferID* tid, MonotonicTime blocking_deadline);
 
+    UAVCAN_NOINLINE
+    int publishFromStackBuffer(const DataStruct& message, TransferType transfer_type, NodeID dst_node_id,
+                               TransferID* tid, MonotonicTime blocking_deadline, MonotonicTime published_at);
+
 public:
     /**
      * @param max_transfer_interval     Maximum expected time interval between subsequent publications. Leave default.
@@ -146,6 +226,45 @@ public:
     {
         return genericPublish(message, transfer_type, dst_node_id, &tid, blocking_deadline);
     }
+
+    /**
+     * Encodes the object into the buffer once, so that it can be published many times with @ref publishEncoded()
+     * without being encoded again. This is useful for rarely changing data, e.g. responses of idempotent services.
+     * Returns negative error code.
+     */
+    int encode(const DataStruct& message, EncodedBuffer& out_buffer);
+
+    /**
+     * Same as @ref publish(), but the payload is taken from a buffer populated by @ref encode() of this publisher.
+     * The buffer is not modified, except for the headroom; the transfer CRC is computed only once.
+     */
+    int publishEncoded(OutgoingTransferBufferImpl& buffer, TransferType transfer_type, NodeID dst_node_id,
+                       MonotonicTime blocking_deadline = MonotonicTime());
+
+    int publishEncoded(OutgoingTransferBufferImpl& buffer, TransferType transfer_type, NodeID dst_node_id,
+                       TransferID tid, MonotonicTime blocking_deadline = MonotonicTime());
+
+    /**
+     * By default, every publication encodes the object into a temporary buffer on the stack, which takes as many
+     * bytes as the maximum length of the encoded object; for large data types this may determine the stack size
+     * of the publishing task. This option makes the publisher encode into the given buffer instead.
+     *
+     * The buffer can be shared by several publishers of the same node, even of different data types, because
+     * the library is not reentrant: a publication never starts while another one is in progress, and the buffer
+     * is not used once the publication method has returned. The buffer must outlive the publisher, or be detached
+     * before destruction. Pass NULL to return to the stack buffer.
+     *
+     * @return  Negative error code; -ErrInvalidParam if the buffer is too small for this data type.
+     */
+    int setScratchBuffer(OutgoingTransferBufferImpl* buffer)
+    {
+        if ((buffer != NULL) && (buffer->getSize() < unsigned(BitLenToByteLen<DataStruct::MaxBitLen>::Result)))
+        {
+            return -ErrInvalidParam;
+        }
+        setScratchBufferUnchecked(buffer);
+        return 0;
+    }
 };
 
 // ----------------------------------------------------------------------------
@@ -185,7 +304,33 @@ int GenericPublisher<DataSpec, DataStruct>::genericPublish(const DataStruct& mes
         return res;
     }
 
-    Buffer buffer;
+    const MonotonicTime published_at = getNode().getMonotonicTime();
+
+    OutgoingTransferBufferImpl* const scratch = getScratchBuffer();
+    if (scratch == NULL)
+    {
+        return publishFromStackBuffer(message, transfer_type, dst_node_id, tid, blocking_deadline, published_at);
+    }
+
+    scratch->reset(getTransferSender().getCrcBase());
+
+    const int encode_res = doEncode(message, *scratch);
+    if (encode_res < 0)
+    {
+        return encode_res;
+    }
+
+    return GenericPublisherBase::genericPublish(*scratch, transfer_type, dst_node_id, tid, blocking_deadline,
+                                                published_at);
+}
+
+template <typename DataSpec, typename DataStruct>
+int GenericPublisher<DataSpec, DataStruct>::publishFromStackBuffer(const DataStruct& message,
+                                                                   TransferType transfer_type, NodeID dst_node_id,
+                                                                   TransferID* tid, MonotonicTime blocking_deadline,
+                                                                   MonotonicTime published_at)
+{
+    EncodedBuffer buffer(getTransferSender().getCrcBase());
 
     const int encode_res = doEncode(message, buffer);
     if (encode_res < 0)
@@ -193,7 +338,48 @@ int GenericPublisher<DataSpec, DataStruct>::genericPublish(const DataStruct& mes
         return encode_res;
     }
 
-    return GenericPublisherBase::genericPublish(buffer, transfer_type, dst_node_id, tid, blocking_deadline);
+    return GenericPublisherBase::genericPublish(buffer, transfer_type, dst_node_id, tid, blocking_deadline,
+                                                published_at);
+}
+
+template <typename DataSpec, typename DataStruct>
+int GenericPublisher<DataSpec, DataStruct>::encode(const DataStruct& message, EncodedBuffer& out_buffer)
+{
+    const int res = checkInit();
+    if (res < 0)
+    {
+        return res;
+    }
+    out_buffer.reset(getTransferSender().getCrcBase());
+    return doEncode(message, out_buffer);
+}
+
+template <typename DataSpec, typename DataStruct>
+int GenericPublisher<DataSpec, DataStruct>::publishEncoded(OutgoingTransferBufferImpl& buffer,
+                                                           TransferType transfer_type, NodeID dst_node_id,
+                                                           MonotonicTime blocking_deadline)
+{
+    const int res = checkInit();
+    if (res < 0)
+    {
+        return res;
+    }
+    return GenericPublisherBase::genericPublish(buffer, transfer_type, dst_node_id, NULL, blocking_deadline,
+                                                getNode().getMonotonicTime());
+}
+
+template <typename DataSpec, typename DataStruct>
+int GenericPublisher<DataSpec, DataStruct>::publishEncoded(OutgoingTransferBufferImpl& buffer,
+                                                           TransferType transfer_type, NodeID dst_node_id,
+                                                           TransferID tid, MonotonicTime blocking_deadline)
+{
+    const int res = checkInit();
+    if (res < 0)
+    {
+        return res;
+    }
+    return GenericPublisherBase::genericPublish(buffer, transfer_type, dst_node_id, &tid, blocking_deadline,
+                                                getNode().getMonotonicTime());
 }
 
 }
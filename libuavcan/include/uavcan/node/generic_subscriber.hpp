@@ -13,6 +13,7 @@
 #include <uavcan/util/lazy_constructor.hpp>
 #include <uavcan/debug.hpp>
 #include <uavcan/transport/transfer_listener.hpp>
+#include <uavcan/transport/transfer_buffer.hpp>
 #include <uavcan/marshal/scalar_codec.hpp>
 #include <uavcan/marshal/types.hpp>
 
@@ -86,6 +87,96 @@ static Stream& operator<<(Stream& s, const ReceivedDataStructure<DataType>& rds)
     return s;
 }
 
+#if !UAVCAN_TINY
+/**
+ * Bounded FIFO of received transfers whose processing is deferred until the scheduler invokes the deferred
+ * callbacks, see @ref DeferredCallbackHandler. Payloads are copied into the node's memory pool.
+ * When the queue is full, the oldest transfer is dropped to make room for the new one.
+ */
+class UAVCAN_EXPORT DeferredTransferQueue : public DeferredCallbackHandler
+{
+    struct Item
+    {
+        Item* next;
+        TransferBufferManagerEntry* payload;
+        MonotonicTime ts_mono;
+        UtcTime ts_utc;
+        TransferPriority priority;
+        TransferID transfer_id;
+        NodeID src_node_id;
+        uint8_t transfer_type;
+        uint8_t iface_index;
+        bool anonymous;
+
+        Item()
+            : next(NULL)
+            , payload(NULL)
+            , transfer_type(0)
+            , iface_index(0)
+            , anonymous(false)
+        { }
+    };
+
+    class Transfer;
+
+    IPoolAllocator& allocator_;
+    Item* head_;
+    Item* tail_;
+    uint16_t len_;
+    uint16_t capacity_;
+    uint32_t drop_cnt_;
+
+    Item* pop();
+    void destroy(Item* item);
+
+    virtual void handleDeferredCallback();
+
+protected:
+    DeferredTransferQueue(Scheduler& scheduler, IPoolAllocator& allocator)
+        : DeferredCallbackHandler(scheduler)
+        , allocator_(allocator)
+        , head_(NULL)
+        , tail_(NULL)
+        , len_(0)
+        , capacity_(0)
+        , drop_cnt_(0)
+    {
+        IsDynamicallyAllocatable<Item>::check();
+    }
+
+    ~DeferredTransferQueue() { clear(); }
+
+    /**
+     * The transfer is valid only until this function returns.
+     */
+    virtual void handleDeferredTransfer(IncomingTransfer& transfer) = 0;
+
+public:
+    /**
+     * Copies the transfer into the queue and schedules its processing.
+     * Returns negative error code if the transfer could not be queued.
+     */
+    int push(IncomingTransfer& transfer, uint16_t max_size);
+
+    /**
+     * Discards all queued transfers.
+     */
+    void clear();
+
+    /**
+     * Zero capacity means that the queue is disabled. Shrinking the queue drops the oldest transfers.
+     */
+    uint16_t getCapacity() const { return capacity_; }
+    void setCapacity(uint16_t capacity);
+
+    unsigned getLength() const { return len_; }
+
+    /**
+     * Number of transfers dropped because the queue was full or because the pool was exhausted.
+     */
+    uint32_t getDropCount() const { return drop_cnt_; }
+};
+#endif
 
 class GenericSubscriberBase : Noncopyable
 {
@@ -102,6 +193,11 @@ protected:
 
     int genericStart(TransferListener* listener, bool (Dispatcher::*registration_method)(TransferListener*));
 
+    /**
+     * Freezes the global data type registry and looks up the data type; returns null if it is not registered.
+     */
+    static const DataTypeDescriptor* findDataTypeDescriptor(DataTypeKind kind, const char* full_name);
+
     void stop(TransferListener* listener);
 
 public:
@@ -116,8 +212,8 @@ public:
 };
 
 /**
- * Please note that the reference passed to the RX callback points to a stack-allocated object, which means
- * that it gets invalidated shortly after the callback returns.
+ * Please note that the reference passed to the RX callback points to a stack-allocated object (or to the decode slot,
+ * see @ref setDecodeSlot()), which means that it gets invalidated shortly after the callback returns.
  */
 template <typename DataSpec, typename DataStruct, typename TransferListenerType>
 class UAVCAN_EXPORT GenericSubscriber : public GenericSubscriberBase
@@ -149,10 +245,36 @@ class UAVCAN_EXPORT GenericSubscriber : public GenericSubscriberBase
 
     LazyConstructor<TransferForwarder> forwarder_;
 
+#if !UAVCAN_TINY
+    class DeferredForwarder : public DeferredTransferQueue
+    {
+        SelfType& obj_;
+
+        void handleDeferredTransfer(IncomingTransfer& transfer)
+        {
+            obj_.decodeAndHandle(transfer);
+        }
+
+    public:
+        explicit DeferredForwarder(SelfType& obj)
+            : DeferredTransferQueue(obj.node_.getScheduler(), obj.node_.getAllocator())
+            , obj_(obj)
+        { }
+    };
+
+    DeferredForwarder deferred_;
+#endif
+
+    enum { MaxBufferSize = BitLenToByteLen<DataStruct::MaxBitLen>::Result };
+
     int checkInit();
 
     void handleIncomingTransfer(IncomingTransfer& transfer);
 
+    void decodeAndHandle(IncomingTransfer& transfer);
+
+    void decodeOnStackAndHandle(IncomingTransfer& transfer);
+
     int genericStart(bool (Dispatcher::*registration_method)(TransferListener*));
 
 protected:
@@ -165,7 +287,28 @@ protected:
         { }
     };
 
-    explicit GenericSubscriber(INode& node) : GenericSubscriberBase(node)
+public:
+    /**
+     * Storage for the received data structure, see @ref setDecodeSlot().
+     */
+    class DecodeSlot : ::uavcan::Noncopyable
+    {
+        friend class GenericSubscriber;
+        LazyConstructor<ReceivedDataStructureSpec> obj_;
+    };
+
+private:
+    DecodeSlot* decode_slot_;
+
+    void decodeAndHandle(IncomingTransfer& transfer, ReceivedDataStructureSpec& rx_struct);
+
+protected:
+    explicit GenericSubscriber(INode& node)
+        : GenericSubscriberBase(node)
+#if !UAVCAN_TINY
+        , deferred_(*this)
+#endif
+        , decode_slot_(NULL)
     { }
 
     virtual ~GenericSubscriber() { stop(); }
@@ -201,6 +344,50 @@ protected:
         forwarder_->allowAnonymousTransfers();
     }
 
+    /**
+     * See @ref TransferListener::setDecimation(). Can be called before the subscription is started.
+     * Returns negative error code.
+     */
+    int setDecimation(uint8_t factor, MonotonicDuration min_interval = MonotonicDuration())
+    {
+        const int res = checkInit();
+        if (res >= 0)
+        {
+            forwarder_->setDecimation(factor, min_interval);
+        }
+        return res;
+    }
+
+    /**
+     * See @ref TransferListener::setOnChangeMode(). Can be called before the subscription is started.
+     * Returns negative error code.
+     */
+    int setOnChangeMode(bool enabled, MonotonicDuration heartbeat = MonotonicDuration())
+    {
+        const int res = checkInit();
+        if (res >= 0)
+        {
+            forwarder_->setOnChangeMode(enabled, heartbeat);
+        }
+        return res;
+    }
+
+    uint32_t getNumSkippedTransfers() const
+    {
+        return forwarder_.isConstructed() ? forwarder_->getNumSkippedTransfers() : 0;
+    }
+
+    /**
+     * The received data structures are decoded into the specified slot rather than on the stack, which matters
+     * for the large data structures and small thread stacks; null pointer restores the default. The slot is
+     * normally allocated statically, one per subscriber; it is occupied only while the callback is running, so
+     * a nested reception (e.g. if the callback spins the node) falls back to the stack.
+     * With the pooled arrays (see @ref ArrayModeDynamicPooled), the memory used by a decoded data structure is then
+     * proportional to the actual payload.
+     */
+    void setDecodeSlot(DecodeSlot* slot) { decode_slot_ = slot; }
+    DecodeSlot* getDecodeSlot() const { return decode_slot_; }
+
     /**
      * Terminate the subscription.
      * Dispatcher core will remove this instance from the subscribers list.
@@ -209,8 +396,39 @@ protected:
     {
         UAVCAN_TRACE("GenericSubscriber", "Stop; dtname=%s", DataSpec::getDataTypeFullName());
         GenericSubscriberBase::stop(forwarder_);
+#if !UAVCAN_TINY
+        deferred_.clear();
+#endif
     }
 
+#if !UAVCAN_TINY
+    /**
+     * In the deferred dispatch mode, received transfers are not decoded and passed to the callback immediately,
+     * but queued and processed by the scheduler after the IO, in the order of the priority class. This way a slow
+     * callback doesn't delay reception of the subsequent frames, and the callbacks of the more important
+     * subscribers run first. If the queue overflows, the oldest transfers are dropped.
+     * The queued payloads are stored in the node's memory pool, which must be sized accordingly.
+     */
+    void enableDeferredDispatch(uint16_t max_queue_len,
+                                DeferredCallbackPriority priority = DeferredCallbackPriorityNormal)
+    {
+        UAVCAN_ASSERT(max_queue_len > 0);
+        deferred_.setCapacity(max_queue_len);
+        deferred_.setPriority(priority);
+    }
+
+    /**
+     * The queued transfers are discarded.
+     */
+    void disableDeferredDispatch() { deferred_.setCapacity(0); }
+
+    bool isDeferredDispatchEnabled() const { return deferred_.getCapacity() > 0; }
+
+    unsigned getNumDeferredTransfers() const { return deferred_.getLength(); }
+
+    uint32_t getDeferredTransferDropCount() const { return deferred_.getDropCount(); }
+#endif
+
     TransferListenerType* getTransferListener() { return forwarder_; }
 };
 
@@ -227,28 +445,67 @@ int GenericSubscriber<DataSpec, DataStruct, TransferListenerType>::checkInit()
         return 0;
     }
 
-    GlobalDataTypeRegistry::instance().freeze();
     const DataTypeDescriptor* const descr =
-        GlobalDataTypeRegistry::instance().find(DataTypeKind(DataSpec::DataTypeKind), DataSpec::getDataTypeFullName());
+        findDataTypeDescriptor(DataTypeKind(DataSpec::DataTypeKind), DataSpec::getDataTypeFullName());
     if (descr == NULL)
     {
-        UAVCAN_TRACE("GenericSubscriber", "Type [%s] is not registered", DataSpec::getDataTypeFullName());
         return -ErrUnknownDataType;
     }
 
-    static const uint16_t MaxBufferSize = BitLenToByteLen<DataStruct::MaxBitLen>::Result;
-
     forwarder_.template construct<SelfType&, const DataTypeDescriptor&, uint16_t, IPoolAllocator&>
-        (*this, *descr, MaxBufferSize, node_.getAllocator());
+        (*this, *descr, uint16_t(MaxBufferSize), node_.getAllocator());
 
     return 0;
 }
 
 template <typename DataSpec, typename DataStruct, typename TransferListenerType>
 void GenericSubscriber<DataSpec, DataStruct, TransferListenerType>::handleIncomingTransfer(IncomingTransfer& transfer)
+{
+#if !UAVCAN_TINY
+    if (deferred_.getCapacity() > 0)
+    {
+        const int res = deferred_.push(transfer, uint16_t(MaxBufferSize));
+        if (res < 0)
+        {
+            UAVCAN_TRACE("GenericSubscriber", "Failed to defer the transfer [%i] [%s]",
+                         res, DataSpec::getDataTypeFullName());
+        }
+        return;
+    }
+#endif
+    decodeAndHandle(transfer);
+}
+
+template <typename DataSpec, typename DataStruct, typename TransferListenerType>
+void GenericSubscriber<DataSpec, DataStruct, TransferListenerType>::decodeAndHandle(IncomingTransfer& transfer)
+{
+    if ((decode_slot_ != NULL) && !decode_slot_->obj_.isConstructed())
+    {
+        DecodeSlot& slot = *decode_slot_;                   // The pointer may be changed from the callback
+        slot.obj_.template construct<const IncomingTransfer*>(&transfer);
+        decodeAndHandle(transfer, *slot.obj_);
+        slot.obj_.destroy();
+    }
+    else
+    {
+        decodeOnStackAndHandle(transfer);
+    }
+}
+
+/*
+ * This is a separate function, so that the stack frame is not taken unless the data structure is decoded on the stack
+ */
+template <typename DataSpec, typename DataStruct, typename TransferListenerType>
+void GenericSubscriber<DataSpec, DataStruct, TransferListenerType>::decodeOnStackAndHandle(IncomingTransfer& transfer)
 {
     ReceivedDataStructureSpec rx_struct(&transfer);
+    decodeAndHandle(transfer, rx_struct);
+}
 
+template <typename DataSpec, typename DataStruct, typename TransferListenerType>
+void GenericSubscriber<DataSpec, DataStruct, TransferListenerType>::
+decodeAndHandle(IncomingTransfer& transfer, ReceivedDataStructureSpec& rx_struct)
+{
     /*
      * Decoding into the temporary storage
      */
@@ -265,13 +522,19 @@ void GenericSubscriber<DataSpec, DataStruct, TransferListenerType>::handleIncomi
         UAVCAN_TRACE("GenericSubscriber", "Unable to decode the message [%i] [%s]",
                      decode_res, DataSpec::getDataTypeFullName());
         failure_count_++;
-        node_.getDispatcher().getTransferPerfCounter().addError();
+        node_.getDispatcher().getTransferPerfCounter().addRxErrors(forwarder_->getDataTypeDescriptor().getKind(),
+                                                                   forwarder_->getDataTypeDescriptor().getID(), 1);
         return;
     }
 
     /*
      * Invoking the callback
      */
+    node_.getDispatcher().getTransferPerfCounter().sampleLatency(LatencyStageRxDriverToCallback,
+                                                                  transfer.getMonotonicTimestamp());
+#if UAVCAN_DUTY_CYCLE_STATS
+    const DutyCycleScope duty_cycle_scope(&node_.getDispatcher().getTransferPerfCounter(), DutyCycleCategoryCallbacks);
+#endif
     handleReceivedDataStruct(rx_struct);
 }
 
@@ -25,7 +25,8 @@ namespace uavcan
  *
  * Also, the mapping between Data Type name and its Data Type ID is also stored in this singleton.
  * UAVCAN data types with default Data Type ID that are autogenerated by the libuavcan DSDL compiler
- * are registered automatically before main() (refer to the generated headers to see how exactly).
+ * are registered automatically before main() (refer to the generated headers to see how exactly),
+ * or at link time if UAVCAN_STATIC_DATA_TYPE_REGISTRY is enabled.
  * Data types that don't have a default Data Type ID must be registered manually using the methods
  * of this class (read the method documentation).
  *
@@ -78,7 +79,58 @@ private:
     mutable List srvs_;
     bool frozen_;
 
-    GlobalDataTypeRegistry() : frozen_(false) { }
+#if UAVCAN_DATA_TYPE_REGISTRY_INDEX_CAPACITY > 0
+    /*
+     * Built once by freeze(), since the set of types can't change afterwards.
+     * The hash tables are twice as large as the descriptor array, so that the probe sequences stay short;
+     * they contain descriptor indexes plus one, zero marks an empty slot.
+     */
+    enum { IndexCapacity = UAVCAN_DATA_TYPE_REGISTRY_INDEX_CAPACITY };
+    enum { IndexTableSize = IndexCapacity * 2 };
+
+    const DataTypeDescriptor* index_descriptors_[IndexCapacity];
+    uint32_t index_name_hashes_[IndexCapacity];
+    uint16_t index_by_name_[IndexTableSize];
+    uint16_t index_by_id_[IndexTableSize];
+    bool indexed_;
+
+    static unsigned computeIdHash(DataTypeKind kind, DataTypeID id)
+    {
+        return unsigned(((uint32_t(kind) << 16) | id.get()) * 2654435761U) >> 16;  // Knuth's multiplicative hash
+    }
+
+    void buildIndex();
+    void addToIndex(const DataTypeDescriptor& descriptor, unsigned position);
+    const DataTypeDescriptor* findIndexed(DataTypeKind kind, const char* name) const;
+    const DataTypeDescriptor* findIndexed(DataTypeKind kind, DataTypeID dtid) const;
+#endif
+
+#if UAVCAN_STATIC_DATA_TYPE_REGISTRY
+    /*
+     * The table of the descriptors that were registered at link time, see DefaultDataTypeRegistrator.
+     */
+    static const DataTypeDescriptor* const* getStaticBegin();
+    static const DataTypeDescriptor* const* getStaticEnd();
+
+    static unsigned countStatic(DataTypeKind kind);
+    static const DataTypeDescriptor* findStatic(DataTypeKind kind, const char* name);
+    static const DataTypeDescriptor* findStatic(DataTypeKind kind, DataTypeID dtid);
+    static void checkStatic();
+#endif
+
+    GlobalDataTypeRegistry()
+        : frozen_(false)
+#if UAVCAN_DATA_TYPE_REGISTRY_INDEX_CAPACITY > 0
+        , indexed_(false)
+#endif
+    {
+#if UAVCAN_DATA_TYPE_REGISTRY_INDEX_CAPACITY > 0
+        StaticAssert<((IndexCapacity & (IndexCapacity - 1)) == 0)>::check();     // Must be a power of two
+        StaticAssert<(IndexCapacity < 0xFFFF)>::check();
+#endif
+    }
+
+    static uint32_t computeNameHash(const char* name);
 
     List* selectList(DataTypeKind kind) const;
 
@@ -95,6 +147,7 @@ public:
      * Register a data type 'Type' with ID 'id'.
      * If this data type was registered earlier, its old registration will be overridden.
      * This method will fail if the data type registry is frozen.
+     * Data types that were registered at link time can't be overridden; this method will report a collision.
      *
      * @tparam Type     Autogenerated UAVCAN data type to register. Data types are generated by the
      *                  libuavcan DSDL compiler from DSDL definitions.
@@ -148,12 +201,39 @@ public:
     /**
      * Returns the number of registered message types.
      */
-    unsigned getNumMessageTypes() const { return msgs_.getLength(); }
+    unsigned getNumMessageTypes() const
+    {
+#if UAVCAN_STATIC_DATA_TYPE_REGISTRY
+        return msgs_.getLength() + countStatic(DataTypeKindMessage);
+#else
+        return msgs_.getLength();
+#endif
+    }
 
     /**
      * Returns the number of registered service types.
      */
-    unsigned getNumServiceTypes() const { return srvs_.getLength(); }
+    unsigned getNumServiceTypes() const
+    {
+#if UAVCAN_STATIC_DATA_TYPE_REGISTRY
+        return srvs_.getLength() + countStatic(DataTypeKindService);
+#else
+        return srvs_.getLength();
+#endif
+    }
+
+    /**
+     * Whether the lookups are served by the index that is built by @ref freeze(),
+     * see UAVCAN_DATA_TYPE_REGISTRY_INDEX_CAPACITY.
+     */
+    bool isIndexed() const
+    {
+#if UAVCAN_DATA_TYPE_REGISTRY_INDEX_CAPACITY > 0
+        return indexed_;
+#else
+        return false;
+#endif
+    }
 
 #if UAVCAN_DEBUG
     /// Required for unit testing
@@ -162,6 +242,9 @@ public:
         UAVCAN_TRACE("GlobalDataTypeRegistry", "Reset; was frozen: %i, num msgs: %u, num srvs: %u",
                      int(frozen_), getNumMessageTypes(), getNumServiceTypes());
         frozen_ = false;
+#if UAVCAN_DATA_TYPE_REGISTRY_INDEX_CAPACITY > 0
+        indexed_ = false;
+#endif
         while (msgs_.get())
         {
             msgs_.remove(msgs_.get());
@@ -180,11 +263,35 @@ public:
  * if a generated data type header file is not included by any translation
  * unit of the application, the data type will not be registered.
  *
+ * If UAVCAN_STATIC_DATA_TYPE_REGISTRY is enabled, nothing is executed before main(); instead, the descriptor
+ * of the data type is constant-initialized, and a pointer to it is emitted into the section "uavcan_data_types".
+ * The pointer is placed into a COMDAT group named after the descriptor, so that the linker keeps only one copy
+ * no matter how many translation units include the header. This is done in assembly because GCC ignores the
+ * section attribute on the static members of class templates.
+ *
  * Data type needs to have a default ID to be registrable by this class.
  */
 template <typename Type>
 struct UAVCAN_EXPORT DefaultDataTypeRegistrator
 {
+#if UAVCAN_STATIC_DATA_TYPE_REGISTRY
+    /// Hidden, so that its address is a link-time constant even in position independent code
+    __attribute__((visibility("hidden"))) static const DataTypeDescriptor Descriptor;
+
+    __attribute__((used)) static const DataTypeDescriptor* emitTableEntry()
+    {
+        __asm__(".pushsection uavcan_data_types,\"awG\",%%progbits,%c0,comdat\n\t"
+                ".balign %c1\n\t"
+                ".dc.a %c0\n\t"
+                ".popsection"
+                : : "i"(&Descriptor), "i"(sizeof(void*)));
+        return &Descriptor;
+    }
+
+    const DataTypeDescriptor* (* const table_entry_emitter_)();
+
+    constexpr DefaultDataTypeRegistrator() : table_entry_emitter_(&emitTableEntry) { }
+#else
     DefaultDataTypeRegistrator()
     {
 #if !UAVCAN_NO_GLOBAL_DATA_TYPE_REGISTRY
@@ -197,8 +304,18 @@ struct UAVCAN_EXPORT DefaultDataTypeRegistrator
         }
 #endif
     }
+#endif
 };
 
+#if UAVCAN_STATIC_DATA_TYPE_REGISTRY
+template <typename Type>
+const DataTypeDescriptor DefaultDataTypeRegistrator<Type>::Descriptor(DataTypeDescriptor::ConstantInit(),
+                                                                       DataTypeKind(Type::DataTypeKind),
+                                                                       DataTypeID(Type::DefaultDataTypeID),
+                                                                       Type::getDataTypeSignature(),
+                                                                       Type::getDataTypeFullName());
+#endif
+
 // ----------------------------------------------------------------------------
 
 /*
@@ -0,0 +1,199 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_NODE_MULTI_SERVICE_CLIENT_HPP_INCLUDED
+#define UAVCAN_NODE_MULTI_SERVICE_CLIENT_HPP_INCLUDED
+
+#include <uavcan/build_config.hpp>
+#include <uavcan/node/service_client.hpp>
+#include <uavcan/util/method_binder.hpp>
+
+namespace uavcan
+{
+/**
+ * Sends the same request to a group of servers and collects the results, one per server, e.g. to restart
+ * or to reconfigure a fleet of nodes. The request is encoded only once, see @ref ServiceClient::callMultiple().
+ *
+ * The results are available as soon as they arrive; the group call is finished when every server has either
+ * responded or timed out. Starting a new group call discards the results and cancels the pending calls
+ * of the previous one.
+ *
+ * @tparam DataType_        Service data type.
+ * @tparam MaxServers_      Maximum number of servers per group call; the results are stored in this object,
+ *                          so the memory footprint is proportional to MaxServers_ times the size of the response.
+ */
+template <typename DataType_, unsigned MaxServers_>
+class UAVCAN_EXPORT MultiServiceClient : Noncopyable
+{
+public:
+    typedef DataType_ DataType;
+    typedef typename DataType::Request RequestType;
+    typedef typename DataType::Response ResponseType;
+    typedef ServiceCallResult<DataType> ServiceCallResultType;
+
+    enum { MaxServers = MaxServers_ };
+
+    /**
+     * Outcome of the call to one server.
+     */
+    struct Result
+    {
+        enum Status
+        {
+            Pending,        ///< Waiting for the response
+            Success,        ///< The response is available
+            ErrorTimeout,   ///< The server didn't respond in time
+            ErrorNotSent    ///< The request could not be sent, e.g. because the Node ID is invalid
+        };
+
+        NodeID server_node_id;
+        ServiceCallID call_id;
+        Status status;
+        ResponseType response;  ///< Valid only if the call was successful
+
+        Result() : status(Pending) { }
+
+        bool isSuccessful() const { return status == Success; }
+        bool isFinished() const { return status != Pending; }
+    };
+
+private:
+    typedef MultiServiceClient<DataType_, MaxServers_> SelfType;
+    typedef MethodBinder<SelfType*, void (SelfType::*)(const ServiceCallResultType&)> Callback;
+
+public:
+    typedef ServiceClient<DataType, Callback> ServiceClientType;
+
+private:
+    ServiceClientType client_;
+    Result results_[MaxServers];
+    unsigned num_results_;
+
+    void handleResult(const ServiceCallResultType& result)
+    {
+        for (unsigned i = 0; i < num_results_; i++)
+        {
+            Result& r = results_[i];
+            if ((r.status == Result::Pending) && (r.call_id == result.getCallID()))
+            {
+                if (result.isSuccessful())
+                {
+                    r.status = Result::Success;
+                    r.response = result.getResponse();
+                }
+                else
+                {
+                    r.status = Result::ErrorTimeout;
+                }
+                return;
+            }
+        }
+        UAVCAN_TRACE("MultiServiceClient", "Unexpected result, nid=%d", int(result.getCallID().server_node_id.get()));
+    }
+
+public:
+    explicit MultiServiceClient(INode& node)
+        : client_(node)
+        , num_results_(0)
+    {
+        StaticAssert<(MaxServers > 0)>::check();
+        client_.setCallback(Callback(this, &SelfType::handleResult));
+    }
+
+    /**
+     * Shall be called before first use.
+     * Returns negative error code.
+     */
+    int init() { return client_.init(); }
+
+    /**
+     * Starts a new group call; the results of the previous one are discarded.
+     * @return  Number of calls that have been started, see @ref ServiceClient::callMultiple();
+     *          -ErrInvalidParam if there are more servers than MaxServers.
+     */
+    int call(const NodeID* server_node_ids, unsigned num_servers, const RequestType& request)
+    {
+        if (num_servers > unsigned(MaxServers))
+        {
+            return -ErrInvalidParam;
+        }
+        cancel();
+
+        ServiceCallID call_ids[MaxServers];
+        const int res = client_.callMultiple(server_node_ids, num_servers, request, call_ids);
+        if (res < 0)
+        {
+            return res;
+        }
+
+        for (unsigned i = 0; i < num_servers; i++)
+        {
+            Result& r = results_[i];
+            r = Result();
+            r.server_node_id = server_node_ids[i];
+            r.call_id = call_ids[i];
+            r.status = call_ids[i].isValid() ? Result::Pending : Result::ErrorNotSent;
+        }
+        num_results_ = num_servers;
+        return res;
+    }
+
+    /**
+     * Cancels the pending calls of the current group call and discards the results.
+     */
+    void cancel()
+    {
+        client_.cancelAllCalls();
+        num_results_ = 0;
+    }
+
+    /**
+     * Whether every server of the current group call has either responded or failed.
+     */
+    bool isFinished() const { return !client_.hasPendingCalls(); }
+
+    /**
+     * Results in the same order as the servers were passed to @ref call().
+     */
+    unsigned getNumResults() const { return num_results_; }
+    const Result& getResult(unsigned index) const
+    {
+        UAVCAN_ASSERT(index < num_results_);
+        return results_[(index < num_results_) ? index : 0];
+    }
+
+    unsigned getNumSuccessful() const
+    {
+        unsigned num = 0;
+        for (unsigned i = 0; i < num_results_; i++)
+        {
+            num += results_[i].isSuccessful() ? 1U : 0U;
+        }
+        return num;
+    }
+
+    /**
+     * Returns the response of the given server, or null if it has not responded (yet).
+     */
+    const ResponseType* findResponse(NodeID server_node_id) const
+    {
+        for (unsigned i = 0; i < num_results_; i++)
+        {
+            if (results_[i].isSuccessful() && (results_[i].server_node_id == server_node_id))
+            {
+                return &results_[i].response;
+            }
+        }
+        return NULL;
+    }
+
+    /**
+     * Request timeout, priority and other settings of the calls.
+     */
+    ServiceClientType& getServiceClient() { return client_; }
+};
+
+}
+
+#endif // UAVCAN_NODE_MULTI_SERVICE_CLIENT_HPP_INCLUDED
@@ -33,6 +33,8 @@ namespace uavcan
  * @tparam MemPoolSize      Size of memory pool for this node, in bytes.
  *                          Please refer to the documentation for details.
  *                          If this value is zero, the constructor will accept a reference to user-provided allocator.
+ *                          In order to reserve memory for critical subsystems, such as the TX queues, provide
+ *                          a @ref PartitionedPoolAllocator.
  */
 template <std::size_t MemPoolSize = 0>
 class UAVCAN_EXPORT Node : public INode
@@ -56,11 +58,31 @@ class UAVCAN_EXPORT Node : public INode
 
     uint64_t internal_failure_cnt_;
     bool started_;
+#if !UAVCAN_TINY
+    bool optional_services_deferred_;
+#endif
 
     void commonInit()
     {
         internal_failure_cnt_ = 0;
         started_ = false;
+#if !UAVCAN_TINY
+        optional_services_deferred_ = false;
+#endif
+    }
+
+    int startOptionalServices();
+
+    int startDeferredServices()
+    {
+#if !UAVCAN_TINY
+        if (optional_services_deferred_)
+        {
+            optional_services_deferred_ = false;
+            return startOptionalServices();
+        }
+#endif
+        return 0;
     }
 
 protected:
@@ -121,7 +143,8 @@ public:
     {
         if (started_)
         {
-            return INode::spin(deadline);
+            const int res = startDeferredServices();
+            return (res < 0) ? res : INode::spin(deadline);
         }
         return -ErrNotInited;
     }
@@ -130,7 +153,8 @@ public:
     {
         if (started_)
         {
-            return INode::spin(duration);
+            const int res = startDeferredServices();
+            return (res < 0) ? res : INode::spin(duration);
         }
         return -ErrNotInited;
     }
@@ -139,7 +163,8 @@ public:
     {
         if (started_)
         {
-            return INode::spinOnce();
+            const int res = startDeferredServices();
+            return (res < 0) ? res : INode::spinOnce();
         }
         return -ErrNotInited;
     }
@@ -159,6 +184,31 @@ public:
      */
     int start(const TransferPriority node_status_transfer_priority = TransferPriority::Default);
 
+    /**
+     * Same as @ref start(), but only the mandatory functionality is started immediately: NodeStatus is published
+     * and the GetNodeInfo server is started. The optional services, i.e. the data type info provider, the logger,
+     * the restart request server and the transport stats provider, are started by the first call to spin() or
+     * spinOnce(), after the first NodeStatus has been sent; until then, they don't respond to requests.
+     * This minimizes the time from power-on to the first publication, which is important for the nodes that must
+     * join the bus quickly, e.g. after a brownout; see also UAVCAN_STATIC_DATA_TYPE_REGISTRY.
+     *
+     * If the optional services fail to start, the spin method returns the error; the node should be restarted
+     * in that case, like if start() has failed. In UAVCAN_TINY mode it is the same as start().
+     */
+    int startFast(const TransferPriority node_status_transfer_priority = TransferPriority::Default);
+
+    /**
+     * Whether the optional services are still waiting for the first spin after @ref startFast().
+     */
+    bool areOptionalServicesDeferred() const
+    {
+#if UAVCAN_TINY
+        return false;
+#else
+        return optional_services_deferred_;
+#endif
+    }
+
     /**
      * Gets/sets the node name, e.g. "com.example.product_name". The node name can be set only once.
      * The name must be set before the node is started, otherwise the node will refuse to start up.
@@ -271,46 +321,60 @@ public:
 // ----------------------------------------------------------------------------
 
 template <std::size_t MemPoolSize_>
-int Node<MemPoolSize_>::start(const TransferPriority priority)
+int Node<MemPoolSize_>::startOptionalServices()
 {
-    if (started_)
+#if UAVCAN_TINY
+    return 0;
+#else
+    int res = proto_dtp_.start();
+    if (res >= 0)
     {
-        return 0;
+        res = proto_logger_.init();
     }
-    GlobalDataTypeRegistry::instance().freeze();
-
-    int res = 0;
-    res = proto_nsp_.startAndPublish(priority);
-    if (res < 0)
+    if (res >= 0)
     {
-        goto fail;
+        res = proto_rrs_.start();
     }
-#if !UAVCAN_TINY
-    res = proto_dtp_.start();
-    if (res < 0)
+    if (res >= 0)
     {
-        goto fail;
+        res = proto_tsp_.start();
     }
-    res = proto_logger_.init();
-    if (res < 0)
+    return res;
+#endif
+}
+
+template <std::size_t MemPoolSize_>
+int Node<MemPoolSize_>::start(const TransferPriority priority)
+{
+    if (started_)
     {
-        goto fail;
+        return 0;
     }
-    res = proto_rrs_.start();
-    if (res < 0)
+    GlobalDataTypeRegistry::instance().freeze();
+
+    int res = proto_nsp_.startAndPublish(priority);
+    if (res >= 0)
     {
-        goto fail;
+        res = startOptionalServices();
     }
-    res = proto_tsp_.start();
-    if (res < 0)
+    started_ = res >= 0;
+    return res;
+}
+
+template <std::size_t MemPoolSize_>
+int Node<MemPoolSize_>::startFast(const TransferPriority priority)
+{
+    if (started_)
     {
-        goto fail;
+        return 0;
     }
-#endif
+    GlobalDataTypeRegistry::instance().freeze();
+
+    const int res = proto_nsp_.startAndPublish(priority);
     started_ = res >= 0;
-    return res;
-fail:
-    UAVCAN_ASSERT(res < 0);
+#if !UAVCAN_TINY
+    optional_services_deferred_ = started_;
+#endif
     return res;
 }
 
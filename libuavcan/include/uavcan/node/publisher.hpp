@@ -81,6 +81,18 @@ public:
     using BaseType::setTxTimeout;
     using BaseType::getPriority;
     using BaseType::setPriority;
+    using BaseType::setReplacePending;
+    using BaseType::isReplacePendingEnabled;
+    using BaseType::setRateLimit;
+    using BaseType::getRateLimitBytesPerSec;
+    using BaseType::getRateLimitedTransferCount;
+    using BaseType::getTxQueueStatus;
+    using BaseType::setScratchBuffer;
+    using BaseType::getScratchBuffer;
+#if !UAVCAN_TINY
+    using BaseType::setTxCompletionMonitor;
+    using BaseType::getTxCompletionMonitor;
+#endif
     using BaseType::getNode;
 };
 
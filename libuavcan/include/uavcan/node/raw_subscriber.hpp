@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_NODE_RAW_SUBSCRIBER_HPP_INCLUDED
+#define UAVCAN_NODE_RAW_SUBSCRIBER_HPP_INCLUDED
+
+#include <uavcan/build_config.hpp>
+#include <uavcan/node/generic_subscriber.hpp>
+
+#if !defined(UAVCAN_CPP_VERSION) || !defined(UAVCAN_CPP11)
+# error UAVCAN_CPP_VERSION
+#endif
+
+#if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
+# include <functional>
+#endif
+
+namespace uavcan
+{
+/**
+ * Use this class to receive messages without decoding them, e.g. for bridging or logging.
+ * The callback receives the reassembled transfer, which provides the payload via
+ * @ref IncomingTransfer::read() or @ref IncomingTransfer::getContiguousData(), and the transfer metadata.
+ * The transfer object is valid only until the callback returns.
+ *
+ * @tparam DataType_        Message data type; it is used only to find the data type ID and the signature,
+ *                          and to limit the payload length.
+ *
+ * @tparam Callback_        Type of the callback, invoked with a reference to @ref IncomingTransfer.
+ *                          In C++11 mode this type defaults to std::function<>.
+ *                          In C++03 mode this type defaults to a plain function pointer; use binder to
+ *                          call member functions as callbacks.
+ *
+ * @tparam TransferListener_ Transfer listener implementation used by the transport layer,
+ *                          see @ref Subscriber.
+ */
+template <typename DataType_,
+#if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
+          typename Callback_ = std::function<void (IncomingTransfer&)>,
+#else
+          typename Callback_ = void (*)(IncomingTransfer&),
+#endif
+          typename TransferListener_ = TransferListener
+          >
+class UAVCAN_EXPORT RawSubscriber : public GenericSubscriberBase
+{
+public:
+    typedef DataType_ DataType;
+    typedef Callback_ Callback;
+
+    enum { MaxPayloadLen = BitLenToByteLen<DataType::MaxBitLen>::Result };
+
+private:
+    typedef RawSubscriber<DataType_, Callback_, TransferListener_> SelfType;
+
+    class TransferForwarder : public TransferListener_
+    {
+        SelfType& obj_;
+
+        void handleIncomingTransfer(IncomingTransfer& transfer)
+        {
+            obj_.handleIncomingTransfer(transfer);
+        }
+
+    public:
+        TransferForwarder(SelfType& obj,
+                          const DataTypeDescriptor& data_type,
+                          uint16_t max_buffer_size,
+                          IPoolAllocator& allocator) :
+            TransferListener_(obj.node_.getDispatcher().getTransferPerfCounter(),
+                              data_type,
+                              max_buffer_size,
+                              allocator),
+            obj_(obj)
+        { }
+    };
+
+    LazyConstructor<TransferForwarder> forwarder_;
+    Callback callback_;
+
+    int checkInit()
+    {
+        if (!forwarder_)
+        {
+            const DataTypeDescriptor* const descr =
+                findDataTypeDescriptor(DataTypeKindMessage, DataType::getDataTypeFullName());
+            if (descr == NULL)
+            {
+                return -ErrUnknownDataType;
+            }
+            forwarder_.template construct<SelfType&, const DataTypeDescriptor&, uint16_t, IPoolAllocator&>
+                (*this, *descr, uint16_t(MaxPayloadLen), node_.getAllocator());
+        }
+        return 0;
+    }
+
+    void handleIncomingTransfer(IncomingTransfer& transfer)
+    {
+        if (coerceOrFallback<bool>(callback_, true))
+        {
+            node_.getDispatcher().getTransferPerfCounter().sampleLatency(LatencyStageRxDriverToCallback,
+                                                                          transfer.getMonotonicTimestamp());
+            callback_(transfer);
+        }
+        else
+        {
+            handleFatalError("RawSub clbk");
+        }
+    }
+
+public:
+    explicit RawSubscriber(INode& node)
+        : GenericSubscriberBase(node)
+        , callback_()
+    {
+        StaticAssert<DataTypeKind(DataType::DataTypeKind) == DataTypeKindMessage>::check();
+    }
+
+    ~RawSubscriber() { stop(); }
+
+    /**
+     * Begin receiving messages.
+     * Each message will be passed to the application via the callback.
+     * Returns negative error code.
+     */
+    int start(const Callback& callback)
+    {
+        stop();
+
+        if (!coerceOrFallback<bool>(callback, true))
+        {
+            UAVCAN_TRACE("RawSubscriber", "Invalid callback");
+            return -ErrInvalidParam;
+        }
+        callback_ = callback;
+
+        const int res = checkInit();
+        if (res < 0)
+        {
+            return res;
+        }
+
+        UAVCAN_TRACE("RawSubscriber", "Start; dtname=%s", DataType::getDataTypeFullName());
+        return GenericSubscriberBase::genericStart(forwarder_, &Dispatcher::registerMessageListener);
+    }
+
+    /**
+     * See @ref Subscriber.
+     */
+    void allowAnonymousTransfers()
+    {
+        forwarder_->allowAnonymousTransfers();
+    }
+
+    /**
+     * See @ref TransferListener::setDecimation(). Can be called before the subscription is started.
+     * Returns negative error code.
+     */
+    int setDecimation(uint8_t factor, MonotonicDuration min_interval = MonotonicDuration())
+    {
+        const int res = checkInit();
+        if (res >= 0)
+        {
+            forwarder_->setDecimation(factor, min_interval);
+        }
+        return res;
+    }
+
+    /**
+     * See @ref TransferListener::setOnChangeMode(). Can be called before the subscription is started.
+     * Returns negative error code.
+     */
+    int setOnChangeMode(bool enabled, MonotonicDuration heartbeat = MonotonicDuration())
+    {
+        const int res = checkInit();
+        if (res >= 0)
+        {
+            forwarder_->setOnChangeMode(enabled, heartbeat);
+        }
+        return res;
+    }
+
+    uint32_t getNumSkippedTransfers() const
+    {
+        return forwarder_.isConstructed() ? forwarder_->getNumSkippedTransfers() : 0;
+    }
+
+    /**
+     * Terminate the subscription.
+     */
+    void stop()
+    {
+        GenericSubscriberBase::stop(forwarder_);
+    }
+};
+
+}
+
+#endif // UAVCAN_NODE_RAW_SUBSCRIBER_HPP_INCLUDED
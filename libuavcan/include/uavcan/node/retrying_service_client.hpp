@@ -0,0 +1,269 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_NODE_RETRYING_SERVICE_CLIENT_HPP_INCLUDED
+#define UAVCAN_NODE_RETRYING_SERVICE_CLIENT_HPP_INCLUDED
+
+#include <uavcan/build_config.hpp>
+#include <uavcan/node/service_client.hpp>
+#include <uavcan/node/timer.hpp>
+#include <uavcan/util/method_binder.hpp>
+
+#if !defined(UAVCAN_CPP_VERSION) || !defined(UAVCAN_CPP11)
+# error UAVCAN_CPP_VERSION
+#endif
+
+#if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
+# include <functional>
+#endif
+
+namespace uavcan
+{
+/**
+ * Delays between the retries of a failed operation: the delay doubles with every attempt up to the maximum,
+ * and a random part of it (the jitter) is subtracted, so that the nodes that failed at the same moment,
+ * e.g. because of a bus overload, don't retry in sync.
+ *
+ * The pseudo-random generator is not suitable for anything but the jitter; seed it differently on every node,
+ * e.g. with the Node ID and the current time.
+ */
+class UAVCAN_EXPORT RetryBackoff
+{
+    MonotonicDuration initial_delay_;
+    MonotonicDuration max_delay_;
+    uint32_t rng_state_;
+    uint8_t jitter_percent_;
+    uint8_t num_attempts_;
+
+    uint32_t getRandom();
+
+public:
+    enum { DefaultJitterPercent = 50 };
+
+    static MonotonicDuration getDefaultInitialDelay() { return MonotonicDuration::fromMSec(100); }
+    static MonotonicDuration getDefaultMaxDelay() { return MonotonicDuration::fromMSec(5000); }
+
+    RetryBackoff()
+        : initial_delay_(getDefaultInitialDelay())
+        , max_delay_(getDefaultMaxDelay())
+        , rng_state_(1)
+        , jitter_percent_(DefaultJitterPercent)
+        , num_attempts_(0)
+    { }
+
+    /**
+     * @param initial_delay     Delay before the first retry, without jitter.
+     * @param max_delay         The delay stops growing at this value; it can't be less than the initial delay.
+     * @param jitter_percent    Up to this percentage of the delay is subtracted randomly; 0 disables the jitter,
+     *                          100 makes the delay uniformly distributed between zero and the nominal value.
+     */
+    void configure(MonotonicDuration initial_delay, MonotonicDuration max_delay, uint8_t jitter_percent);
+
+    void seed(uint32_t value) { rng_state_ = (value == 0) ? 1U : value; }  // Zero state is not allowed
+
+    /**
+     * Delay before the next attempt; every call counts as an attempt.
+     */
+    MonotonicDuration getNextDelay();
+
+    /**
+     * Starts over from the initial delay, e.g. after a success.
+     */
+    void reset() { num_attempts_ = 0; }
+
+    unsigned getNumAttempts() const { return num_attempts_; }
+
+    MonotonicDuration getInitialDelay() const { return initial_delay_; }
+    MonotonicDuration getMaxDelay() const { return max_delay_; }
+    uint8_t getJitterPercent() const { return jitter_percent_; }
+};
+
+/**
+ * Service client that repeats the call if the server doesn't respond, with exponential backoff and jitter
+ * between the attempts (see @ref RetryBackoff). Every attempt is a new call with its own transfer ID.
+ * The callback is invoked once per call, with the first response or with the failure of the last attempt.
+ *
+ * The request is copied into this object, since it has to be sent again; one call can be in progress
+ * at a time. For adaptive timeouts of the attempts, attach an RTT estimator to the wrapped client:
+ *
+ *   uavcan::ServiceRttEstimator<8> estimator;
+ *   retrying_client.getServiceClient().setRttEstimator(&estimator);
+ *
+ * @tparam DataType_        Service data type.
+ * @tparam Callback_        Same as for @ref ServiceClient.
+ */
+template <typename DataType_,
+#if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
+          typename Callback_ = std::function<void (const ServiceCallResult<DataType_>&)>
+#else
+          typename Callback_ = void (*)(const ServiceCallResult<DataType_>&)
+#endif
+          >
+class UAVCAN_EXPORT RetryingServiceClient : Noncopyable
+{
+public:
+    typedef DataType_ DataType;
+    typedef typename DataType::Request RequestType;
+    typedef typename DataType::Response ResponseType;
+    typedef ServiceCallResult<DataType> ServiceCallResultType;
+    typedef Callback_ Callback;
+
+    enum { DefaultMaxAttempts = 3 };
+
+private:
+    typedef RetryingServiceClient<DataType_, Callback_> SelfType;
+    typedef MethodBinder<SelfType*, void (SelfType::*)(const ServiceCallResultType&)> ResultCallback;
+    typedef MethodBinder<SelfType*, void (SelfType::*)(const TimerEvent&)> TimerCallback;
+
+public:
+    typedef ServiceClient<DataType, ResultCallback> ServiceClientType;
+
+private:
+    struct NoResponse : public ReceivedDataStructure<ResponseType>
+    {
+        NoResponse() { }
+    };
+
+    ServiceClientType client_;
+    TimerEventForwarder<TimerCallback> retry_timer_;
+    RetryBackoff backoff_;
+    Callback callback_;
+    RequestType request_;
+    ServiceCallID call_id_;             ///< Of the current attempt
+    uint8_t max_attempts_;
+    bool pending_;
+
+    void finish(const ServiceCallResultType& result)
+    {
+        pending_ = false;
+        if (coerceOrFallback<bool>(callback_, true))
+        {
+            callback_(result);
+        }
+        else
+        {
+            handleFatalError("Srv client clbk");
+        }
+    }
+
+    void handleResult(const ServiceCallResultType& result)
+    {
+        if (!pending_ || !(result.getCallID() == call_id_))
+        {
+            UAVCAN_TRACE("RetryingServiceClient", "Stale result, nid=%d", int(result.getCallID().server_node_id.get()));
+            return;
+        }
+        if (result.isSuccessful() || ((backoff_.getNumAttempts() + 1U) >= max_attempts_))
+        {
+            finish(result);
+            return;
+        }
+        retry_timer_.startOneShotWithDelay(backoff_.getNextDelay());
+        UAVCAN_TRACE("RetryingServiceClient", "Retry %u to nid=%d scheduled", backoff_.getNumAttempts(),
+                     int(call_id_.server_node_id.get()));
+    }
+
+    void handleRetryTimer(const TimerEvent&)
+    {
+        ServiceCallID call_id;
+        const int res = client_.call(call_id_.server_node_id, request_, call_id);
+        if (res < 0)
+        {
+            UAVCAN_TRACE("RetryingServiceClient", "Retry failed, error: %i", res);
+            NoResponse no_response;
+            ServiceCallResultType result(ServiceCallResultType::ErrorTimeout, call_id_, no_response);
+            finish(result);
+            return;
+        }
+        call_id_ = call_id;
+    }
+
+public:
+    explicit RetryingServiceClient(INode& node, const Callback& callback = Callback())
+        : client_(node)
+        , retry_timer_(node)
+        , callback_(callback)
+        , max_attempts_(DefaultMaxAttempts)
+        , pending_(false)
+    {
+        client_.setCallback(ResultCallback(this, &SelfType::handleResult));
+        retry_timer_.setCallback(TimerCallback(this, &SelfType::handleRetryTimer));
+    }
+
+    /**
+     * Shall be called before first use.
+     * Returns negative error code.
+     */
+    int init() { return client_.init(); }
+
+    /**
+     * Starts a new call; the pending one, if any, is cancelled and its callback will not be invoked.
+     * Returns negative error code if the first attempt could not be made; the callback will not be invoked then.
+     */
+    int call(NodeID server_node_id, const RequestType& request)
+    {
+        cancel();
+        if (!coerceOrFallback<bool>(callback_, true))
+        {
+            UAVCAN_TRACE("RetryingServiceClient", "Invalid callback");
+            return -ErrInvalidConfiguration;
+        }
+
+        INode& node = client_.getNode();
+        backoff_.seed(uint32_t(node.getMonotonicTime().toUSec()) ^ (uint32_t(node.getNodeID().get()) << 24));
+        backoff_.reset();
+
+        request_ = request;
+        const int res = client_.call(server_node_id, request_, call_id_);
+        if (res < 0)
+        {
+            return res;
+        }
+        pending_ = true;
+        return res;
+    }
+
+    /**
+     * Cancels the pending call, including the scheduled retries.
+     */
+    void cancel()
+    {
+        retry_timer_.stop();
+        if (pending_)
+        {
+            client_.cancelCall(call_id_);
+            pending_ = false;
+        }
+    }
+
+    bool isPending() const { return pending_; }
+
+    /**
+     * Number of retries made or scheduled for the current call.
+     */
+    unsigned getNumRetries() const { return backoff_.getNumAttempts(); }
+
+    /**
+     * Total number of attempts per call, including the first one; at least one. Default is @ref DefaultMaxAttempts.
+     */
+    uint8_t getMaxAttempts() const { return max_attempts_; }
+    void setMaxAttempts(uint8_t num) { max_attempts_ = max(num, uint8_t(1)); }
+
+    /**
+     * Delays between the attempts; see @ref RetryBackoff::configure().
+     */
+    RetryBackoff& getBackoff() { return backoff_; }
+
+    const Callback& getCallback() const { return callback_; }
+    void setCallback(const Callback& cb) { callback_ = cb; }
+
+    /**
+     * Request timeout, priority and other settings of the attempts.
+     */
+    ServiceClientType& getServiceClient() { return client_; }
+};
+
+}
+
+#endif // UAVCAN_NODE_RETRYING_SERVICE_CLIENT_HPP_INCLUDED
@@ -7,22 +7,37 @@
 
 #include <uavcan/error.hpp>
 #include <uavcan/util/linked_list.hpp>
+#include <uavcan/util/templates.hpp>
 #include <uavcan/transport/dispatcher.hpp>
 
 namespace uavcan
 {
 
 class UAVCAN_EXPORT Scheduler;
+class UAVCAN_EXPORT DeadlineScheduler;
+class UAVCAN_EXPORT DeferredCallbackScheduler;
 
-class UAVCAN_EXPORT DeadlineHandler : public LinkedListNode<DeadlineHandler>, Noncopyable
+/**
+ * The handlers are doubly linked, so that they can be stopped in constant time; timers are re-armed very often.
+ */
+class UAVCAN_EXPORT DeadlineHandler : public DoublyLinkedListNode<DeadlineHandler>, Noncopyable
 {
+    friend class DeadlineScheduler;
+
     MonotonicTime deadline_;
+#if UAVCAN_DEADLINE_SCHEDULER_TIMER_WHEEL
+    uint8_t wheel_slot_;        ///< Index of the timer wheel slot the handler is linked into, if running
+#endif
 
 protected:
     Scheduler& scheduler_;
 
     explicit DeadlineHandler(Scheduler& scheduler)
-        : scheduler_(scheduler)
+        :
+#if UAVCAN_DEADLINE_SCHEDULER_TIMER_WHEEL
+        wheel_slot_(0xFF),
+#endif
+        scheduler_(scheduler)
     { }
 
     virtual ~DeadlineHandler() { stop(); }
@@ -42,26 +57,160 @@ public:
     Scheduler& getScheduler() const { return scheduler_; }
 };
 
+/**
+ * Priority class of a deferred callback; the callbacks of a higher class are always invoked first.
+ */
+enum DeferredCallbackPriority
+{
+    DeferredCallbackPriorityCritical,   ///< E.g. control loops
+    DeferredCallbackPriorityNormal,
+    DeferredCallbackPriorityLow,        ///< E.g. logging
+    NumDeferredCallbackPriorities
+};
+
+/**
+ * Deferred callbacks are invoked by the scheduler immediately after the IO is processed, outside of the
+ * reception path, so that a slow callback doesn't delay reception of the subsequent frames.
+ * Handlers of the same priority class are invoked in the order of scheduling.
+ */
+class UAVCAN_EXPORT DeferredCallbackHandler : public DoublyLinkedListNode<DeferredCallbackHandler>, Noncopyable
+{
+    uint8_t priority_;
+
+protected:
+    Scheduler& scheduler_;
+
+    explicit DeferredCallbackHandler(Scheduler& scheduler,
+                                     DeferredCallbackPriority priority = DeferredCallbackPriorityNormal)
+        : priority_(uint8_t(priority))
+        , scheduler_(scheduler)
+    { }
+
+    virtual ~DeferredCallbackHandler() { cancel(); }
+
+public:
+    /**
+     * Invoked once per @ref schedule() call. If the handler schedules itself again from here, it will be invoked
+     * again after the other pending handlers of the same priority class, within the same spin.
+     */
+    virtual void handleDeferredCallback() = 0;
+
+    /**
+     * Does nothing if the handler is already scheduled.
+     */
+    void schedule();
+    void cancel();
+
+    bool isScheduled() const;
+
+    DeferredCallbackPriority getPriority() const { return DeferredCallbackPriority(priority_); }
+    void setPriority(DeferredCallbackPriority priority);
+
+    Scheduler& getScheduler() const { return scheduler_; }
+};
+
 
+/**
+ * Keeps track of the registered deadline handlers.
+ *
+ * If UAVCAN_DEADLINE_SCHEDULER_TIMER_WHEEL is enabled, the handlers are stored in a hierarchical timer wheel
+ * with NumLevels levels of NumSlots slots each. A level 0 slot spans one tick of 2^TickShift microseconds,
+ * a slot of every next level spans NumSlots slots of the previous level; the slots of the upper levels are
+ * cascaded down as the wheel advances. Deadlines that are further away than the wheel can represent (about
+ * 18 minutes) are parked in the last slot and re-cascaded until they come into range. Adding and removing a
+ * handler is O(1), and the deadlines are still honored exactly rather than rounded to the tick.
+ * Otherwise the handlers are kept in a list sorted by deadline.
+ */
 class UAVCAN_EXPORT DeadlineScheduler : Noncopyable
 {
+#if UAVCAN_DEADLINE_SCHEDULER_TIMER_WHEEL
+    enum { TickShift = 10 };
+    enum { SlotBits = 5 };
+    enum { NumSlots = 1 << SlotBits };
+    enum { NumLevels = 4 };
+    enum { NoSlot = 0xFF };
+
+    LinkedListRoot<DeadlineHandler> slots_[NumLevels * NumSlots];
+    uint32_t occupied_slots_[NumLevels];    ///< Bit per slot, set if the slot is not empty
+    uint64_t current_tick_;                 ///< All level 0 slots before this tick are processed
+    unsigned num_handlers_;
+
+    void place(DeadlineHandler* mdh);
+    unsigned cascade(unsigned level);
+    void advance(uint64_t target_tick);
+    DeadlineHandler* findDueHandler(MonotonicTime ts);
+    static DeadlineHandler* findEarliestInSlot(const LinkedListRoot<DeadlineHandler>& slot);
+#else
     LinkedListRoot<DeadlineHandler> handlers_;  // Ordered by deadline, lowest first
+#endif
 
 public:
+#if UAVCAN_DEADLINE_SCHEDULER_TIMER_WHEEL
+    DeadlineScheduler()
+        : current_tick_(0)
+        , num_handlers_(0)
+    {
+        fill(occupied_slots_, occupied_slots_ + NumLevels, uint32_t(0));
+    }
+#endif
+
     void add(DeadlineHandler* mdh);
     void remove(DeadlineHandler* mdh);
     bool doesExist(const DeadlineHandler* mdh) const;
+#if UAVCAN_DEADLINE_SCHEDULER_TIMER_WHEEL
+    unsigned getNumHandlers() const { return num_handlers_; }
+#else
     unsigned getNumHandlers() const { return handlers_.getLength(); }
+#endif
 
     MonotonicTime pollAndGetMonotonicTime(ISystemClock& sysclock);
+
+    /**
+     * Returns the deadline of the earliest handler, or the maximum time value if there are no handlers.
+     * With the timer wheel, this may return an earlier time if there are deadlines that are out of the wheel range;
+     * it is guaranteed that no handler will be missed if the caller wakes up at the returned time.
+     * Complexity is O(N) in the worst case with the timer wheel, but in practice it scans only a few slots.
+     */
     MonotonicTime getEarliestDeadline() const;
 };
 
+/**
+ * Keeps track of the scheduled deferred callback handlers, ordered by priority class.
+ */
+class UAVCAN_EXPORT DeferredCallbackScheduler : Noncopyable
+{
+    LinkedListRoot<DeferredCallbackHandler> handlers_;
+
+public:
+    void add(DeferredCallbackHandler* dch);
+    void remove(DeferredCallbackHandler* dch);
+    bool doesExist(const DeferredCallbackHandler* dch) const;
+    bool isEmpty() const { return handlers_.isEmpty(); }
+    unsigned getNumHandlers() const { return handlers_.getLength(); }
+
+    /**
+     * Invokes the scheduled handlers until there are none left, including those that were scheduled
+     * by the callbacks. Returns the number of invocations.
+     */
+    unsigned run();
+};
+
 /**
  * This class distributes processing time between library components (IO handling, deadline callbacks, ...).
  */
 class UAVCAN_EXPORT Scheduler : Noncopyable
 {
+public:
+    /**
+     * SpinModeFixedResolution (default) - the driver is polled at least once per deadline resolution period,
+     * see @ref getDeadlineResolution().
+     * SpinModeTickless - the scheduler computes the next wakeup time from the earliest deadline handler,
+     * the TX queue deadlines and the cleanup period, and blocks in select() until that time or until IO.
+     * This mode minimizes the number of wakeups, which is preferable on low power nodes.
+     */
+    enum SpinMode { SpinModeFixedResolution, SpinModeTickless };
+
+private:
     enum { DefaultDeadlineResolutionMs = 5 };
     enum { MinDeadlineResolutionMs = 1 };
     enum { MaxDeadlineResolutionMs = 100 };
@@ -69,12 +218,16 @@ class UAVCAN_EXPORT Scheduler : Noncopyable
     enum { DefaultCleanupPeriodMs = 1000 };
     enum { MinCleanupPeriodMs = 10 };
     enum { MaxCleanupPeriodMs = 10000 };
+    enum { CleanupStepsPerPeriod = 8 };
 
     DeadlineScheduler deadline_scheduler_;
+    DeferredCallbackScheduler deferred_callback_scheduler_;
     Dispatcher dispatcher_;
-    MonotonicTime prev_cleanup_ts_;
+    MonotonicTime prev_cleanup_ts_;         ///< Last cleanup step
+    MonotonicTime cleanup_pass_ts_;         ///< Last completed cleanup pass
     MonotonicDuration deadline_resolution_;
     MonotonicDuration cleanup_period_;
+    uint8_t spin_mode_;
     bool inside_spin_;
 
     struct InsideSpinSetter
@@ -88,15 +241,20 @@ class UAVCAN_EXPORT Scheduler : Noncopyable
         ~InsideSpinSetter() { owner.inside_spin_ = false; }
     };
 
-    MonotonicTime computeDispatcherSpinDeadline(MonotonicTime spin_deadline) const;
+    MonotonicTime computeDispatcherSpinDeadline(MonotonicTime spin_deadline, MonotonicTime ts) const;
+    MonotonicTime computeTicklessWakeupTime(MonotonicTime spin_deadline) const;
+    void runDeferredCallbacks();
     void pollCleanup(MonotonicTime mono_ts, uint32_t num_frames_processed_with_last_spin);
+    MonotonicTime pollDeadlineHandlers();
 
 public:
     Scheduler(ICanDriver& can_driver, IPoolAllocator& allocator, ISystemClock& sysclock)
         : dispatcher_(can_driver, allocator, sysclock)
         , prev_cleanup_ts_(sysclock.getMonotonic())
+        , cleanup_pass_ts_(prev_cleanup_ts_)
         , deadline_resolution_(MonotonicDuration::fromMSec(DefaultDeadlineResolutionMs))
         , cleanup_period_(MonotonicDuration::fromMSec(DefaultCleanupPeriodMs))
+        , spin_mode_(SpinModeFixedResolution)
         , inside_spin_(false)
     { }
 
@@ -109,13 +267,25 @@ public:
 
     /**
      * Non-blocking version of @ref spin() - spins until all pending frames and events are processed,
-     * or until some error occurs. If there's nothing to do, returns immediately.
+     * or until some error occurs. If there's nothing to do, returns immediately. The number of frames
+     * processed per call can be limited with @ref Dispatcher::setMaxFramesPerSpin().
      * Returns negative error code.
      */
     int spinOnce();
 
+    /**
+     * Returns the time when the library needs to be given control next, disregarding IO: the earliest of the
+     * deadline handlers, the periodic cleanup, and the expiration of the queued TX frames.
+     * This allows to run the node from an external event loop: wait for IO on the driver or for this time,
+     * whichever comes first, then call @ref spinOnce(). The result must be re-read after every spin, since
+     * the callbacks may add new deadline handlers.
+     */
+    MonotonicTime getNextWakeupTime() const { return computeTicklessWakeupTime(MonotonicTime::getMax()); }
+
     DeadlineScheduler& getDeadlineScheduler() { return deadline_scheduler_; }
 
+    DeferredCallbackScheduler& getDeferredCallbackScheduler() { return deferred_callback_scheduler_; }
+
     Dispatcher& getDispatcher()             { return dispatcher_; }
     const Dispatcher& getDispatcher() const { return dispatcher_; }
 
@@ -135,10 +305,19 @@ public:
         deadline_resolution_ = res;
     }
 
+    /**
+     * See @ref SpinMode. The wakeup rate can be monitored via @ref Dispatcher::getNumWakeups().
+     */
+    SpinMode getSpinMode() const { return SpinMode(spin_mode_); }
+    void setSpinMode(SpinMode mode) { spin_mode_ = uint8_t(mode); }
+
     /**
      * How often the scheduler will run cleanup (listeners, outgoing transfer registry, ...).
      * Cleanup execution time grows linearly with number of listeners and number of items
      * in the Outgoing Transfer ID registry.
+     * The listeners are processed in several smaller steps spread over the period, so that the node doesn't
+     * stall on a long cleanup; if the spin loop doesn't wake up often enough for that (e.g. in the tickless mode),
+     * the remaining part of the pass is done at once when the period expires.
      * Lower period increases CPU usage.
      */
     MonotonicDuration getCleanupPeriod() const { return cleanup_period_; }
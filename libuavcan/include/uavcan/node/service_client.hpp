@@ -6,9 +6,10 @@
 #define UAVCAN_NODE_SERVICE_CLIENT_HPP_INCLUDED
 
 #include <uavcan/build_config.hpp>
-#include <uavcan/util/multiset.hpp>
+#include <uavcan/dynamic_memory.hpp>
 #include <uavcan/node/generic_publisher.hpp>
 #include <uavcan/node/generic_subscriber.hpp>
+#include <uavcan/node/service_rtt_estimator.hpp>
 
 #if !defined(UAVCAN_CPP_VERSION) || !defined(UAVCAN_CPP11)
 # error UAVCAN_CPP_VERSION
@@ -45,6 +46,109 @@ struct ServiceCallID
     bool isValid() const { return server_node_id.isUnicast(); }
 };
 
+/**
+ * Pending calls of a service client, indexed by call ID and ordered by deadline.
+ * Each pending call takes one memory pool block.
+ *
+ * Calls are matched via a hash table of ServiceClientNumCallBuckets buckets.
+ * The deadline queue is sorted by insertion from its tail; since the request timeout rarely changes, new calls
+ * normally expire last, which makes insertion O(1). Expired calls are removed from the head in O(1).
+ *
+ * Non-unique call IDs are allowed; the oldest matching call is removed first.
+ */
+class UAVCAN_EXPORT ServiceCallRegistry : Noncopyable
+{
+    struct Entry
+    {
+        Entry* next_in_bucket;
+        Entry* prev_by_deadline;
+        Entry* next_by_deadline;
+        MonotonicTime deadline;
+        MonotonicTime started_at;
+        ServiceCallID id;
+
+        Entry(ServiceCallID arg_id, MonotonicTime arg_deadline, MonotonicTime arg_started_at)
+            : next_in_bucket(NULL)
+            , prev_by_deadline(NULL)
+            , next_by_deadline(NULL)
+            , deadline(arg_deadline)
+            , started_at(arg_started_at)
+            , id(arg_id)
+        {
+            IsDynamicallyAllocatable<Entry>::check();
+        }
+    };
+
+    enum { NumBuckets = (ServiceClientNumCallBuckets > 0) ? ServiceClientNumCallBuckets : 1 };
+
+#if UAVCAN_POOL_USAGE_TRACKING
+    TaggedPoolAllocator allocator_;
+#else
+    IPoolAllocator& allocator_;
+#endif
+    Entry* buckets_[NumBuckets];
+    Entry* head_;               ///< Earliest deadline
+    Entry* tail_;               ///< Latest deadline
+    unsigned size_;
+
+    static unsigned getBucketIndex(ServiceCallID id)
+    {
+        return (unsigned(id.server_node_id.get()) * 32U + id.transfer_id.get()) % unsigned(NumBuckets);
+    }
+
+    Entry* findOldest(ServiceCallID id, Entry** out_prev_in_bucket) const;
+
+    void destroy(Entry* entry, Entry* prev_in_bucket);
+
+public:
+    explicit ServiceCallRegistry(IPoolAllocator& allocator);
+
+    ~ServiceCallRegistry() { clear(); }
+
+    /**
+     * The start time is only stored, it is reported back by @ref remove().
+     * Returns negative error code.
+     */
+    int add(ServiceCallID id, MonotonicTime deadline, MonotonicTime started_at = MonotonicTime());
+
+    /**
+     * Returns true if the call was found and removed. Complexity is O(N / NumBuckets).
+     */
+    bool remove(ServiceCallID id, MonotonicTime* out_started_at = NULL);
+
+    /**
+     * Complexity is O(N / NumBuckets).
+     */
+    bool contains(ServiceCallID id) const { return findOldest(id, NULL) != NULL; }
+
+    /**
+     * Complexity is O(N).
+     */
+    bool containsServer(NodeID server_node_id) const;
+
+    /**
+     * If the earliest pending call has expired by the specified time, removes it and returns its call ID;
+     * otherwise returns an invalid call ID. Complexity is O(1).
+     */
+    ServiceCallID removeFirstExpired(MonotonicTime ts);
+
+    /**
+     * Returns zero if there are no pending calls.
+     */
+    MonotonicTime getEarliestDeadline() const { return (head_ == NULL) ? MonotonicTime() : head_->deadline; }
+
+    void clear();
+
+    /**
+     * Calls are ordered by deadline. Complexity is O(index).
+     * If the index is out of range, an invalid call ID will be returned.
+     */
+    ServiceCallID getByIndex(unsigned index) const;
+
+    unsigned getSize() const { return size_; }
+    bool isEmpty() const { return size_ == 0; }
+};
+
 /**
  * Object of this type will be returned to the application as a result of service call.
  * Note that application ALWAYS gets this result, even when it times out or fails because of some other reason.
@@ -118,65 +222,55 @@ class ServiceClientBase : protected ITransferAcceptanceFilter
                         , protected DeadlineHandler
 {
     const DataTypeDescriptor* data_type_descriptor_;  ///< This will be initialized at the time of first call
+#if !UAVCAN_TINY
+    ServiceRttEstimatorBase* rtt_estimator_;
+#endif
 
 protected:
-    class CallState : DeadlineHandler
-    {
-        ServiceClientBase& owner_;
-        const ServiceCallID id_;
-        bool timed_out_;
-
-        virtual void handleDeadline(MonotonicTime);
-
-    public:
-        CallState(INode& node, ServiceClientBase& owner, ServiceCallID call_id)
-            : DeadlineHandler(node.getScheduler())
-            , owner_(owner)
-            , id_(call_id)
-            , timed_out_(false)
-        {
-            UAVCAN_ASSERT(id_.isValid());
-            DeadlineHandler::startWithDelay(owner_.request_timeout_);
-        }
-
-        ServiceCallID getCallID() const { return id_; }
-
-        bool hasTimedOut() const { return timed_out_; }
-
-        static bool hasTimedOutPredicate(const CallState& cs) { return cs.hasTimedOut(); }
-
-        bool operator==(const CallState& rhs) const
-        {
-            return (&owner_ == &rhs.owner_) && (id_ == rhs.id_);
-        }
-    };
-
-    struct CallStateMatchingPredicate
-    {
-        const ServiceCallID id;
-        CallStateMatchingPredicate(ServiceCallID reference) : id(reference) { }
-        bool operator()(const CallState& state) const { return (state.getCallID() == id) && !state.hasTimedOut(); }
-    };
-
-    struct ServerSearchPredicate
-    {
-        const NodeID server_node_id;
-        ServerSearchPredicate(NodeID nid) : server_node_id(nid) { }
-        bool operator()(const CallState& state) const { return state.getCallID().server_node_id == server_node_id; }
-    };
+    /**
+     * All pending calls share the deadline handler of the client, which is armed for the earliest deadline.
+     */
+    ServiceCallRegistry call_registry_;
 
     MonotonicDuration request_timeout_;
 
+    bool response_listener_registered_;
+    bool persistent_response_listener_;
+
     ServiceClientBase(INode& node)
         : DeadlineHandler(node.getScheduler())
         , data_type_descriptor_(NULL)
+#if !UAVCAN_TINY
+        , rtt_estimator_(NULL)
+#endif
+        , call_registry_(node.getAllocator())
         , request_timeout_(getDefaultRequestTimeout())
+        , response_listener_registered_(false)
+        , persistent_response_listener_(false)
     { }
 
     virtual ~ServiceClientBase() { }
 
+    /**
+     * Arms the deadline handler for the earliest pending call, or stops it if there are no pending calls.
+     */
+    void updateDeadline();
+
     int prepareToCall(INode& node, const char* dtname, NodeID server_node_id, ServiceCallID& out_call_id);
 
+    /**
+     * Timeout of a new call; adaptive if the RTT estimator is attached.
+     */
+    MonotonicDuration getRequestTimeoutForServer(NodeID server_node_id) const;
+
+    /**
+     * Removes the call and reports its outcome to the RTT estimator.
+     * Returns false if the call was not pending.
+     */
+    bool completeCall(ServiceCallID call_id, MonotonicTime response_ts);
+
+    void handleCallTimeout(ServiceCallID call_id);
+
 public:
     /**
      * It's not recommended to override default timeouts.
@@ -185,6 +279,24 @@ public:
     static MonotonicDuration getDefaultRequestTimeout() { return MonotonicDuration::fromMSec(500); }
     static MonotonicDuration getMinRequestTimeout() { return MonotonicDuration::fromMSec(10); }
     static MonotonicDuration getMaxRequestTimeout() { return MonotonicDuration::fromMSec(60000); }
+
+    /**
+     * See ServiceClient<>::setPersistentResponseListener().
+     */
+    bool isResponseListenerPersistent() const { return persistent_response_listener_; }
+
+#if !UAVCAN_TINY
+    /**
+     * Makes the timeout of every new call adaptive: it is computed by the estimator from the round trip times
+     * of the previous calls to the same server and bounded by @ref getMinRequestTimeout() and
+     * @ref getMaxRequestTimeout(); the request timeout of the client is used for the servers that have not
+     * responded yet. Every response and every timeout is reported to the estimator.
+     * See @ref ServiceRttEstimator. The estimator may be shared by several clients of similar services.
+     * Pass NULL to return to the fixed timeout. The estimator must outlive the client, or be detached first.
+     */
+    void setRttEstimator(ServiceRttEstimatorBase* estimator) { rtt_estimator_ = estimator; }
+    ServiceRttEstimatorBase* getRttEstimator() const { return rtt_estimator_; }
+#endif
 };
 
 /**
@@ -231,34 +343,6 @@ private:
     typedef GenericPublisher<DataType, RequestType> PublisherType;
     typedef GenericSubscriber<DataType, ResponseType, TransferListenerWithFilter> SubscriberType;
 
-    typedef Multiset<CallState> CallRegistry;
-
-    struct TimeoutCallbackCaller
-    {
-        ServiceClient& owner;
-
-        TimeoutCallbackCaller(ServiceClient& arg_owner) : owner(arg_owner) { }
-
-        void operator()(const CallState& state)
-        {
-            if (state.hasTimedOut())
-            {
-                UAVCAN_TRACE("ServiceClient::TimeoutCallbackCaller", "Timeout from nid=%d, tid=%d, dtname=%s",
-                             int(state.getCallID().server_node_id.get()), int(state.getCallID().transfer_id.get()),
-                             DataType::getDataTypeFullName());
-
-                typename SubscriberType::ReceivedDataStructureSpec rx_struct; // Default-initialized
-
-                ServiceCallResultType result(ServiceCallResultType::ErrorTimeout, state.getCallID(),
-                                             rx_struct);    // Mutable!
-
-                owner.invokeCallback(result);
-            }
-        }
-    };
-
-    CallRegistry call_registry_;
-
     PublisherType publisher_;
     Callback callback_;
 
@@ -272,6 +356,9 @@ private:
 
     int addCallState(ServiceCallID call_id);
 
+    int startResponseListener();
+    void stopResponseListenerIfIdle();
+
 public:
     /**
      * @param node      Node instance this client will be registered with.
@@ -280,7 +367,6 @@ public:
     explicit ServiceClient(INode& node, const Callback& callback = Callback())
         : SubscriberType(node)
         , ServiceClientBase(node)
-        , call_registry_(node.getAllocator())
         , publisher_(node, getDefaultRequestTimeout())
         , callback_(callback)
     {
@@ -291,7 +377,11 @@ public:
 #endif
     }
 
-    virtual ~ServiceClient() { cancelAllCalls(); }
+    virtual ~ServiceClient()
+    {
+        cancelAllCalls();
+        SubscriberType::stop();     // Even in the persistent mode, since the acceptance filter is being destroyed
+    }
 
     /**
      * Shall be called before first use.
@@ -330,6 +420,24 @@ public:
      */
     int call(NodeID server_node_id, const RequestType& request, ServiceCallID& out_call_id);
 
+    /**
+     * Sends the same request to several servers, e.g. to restart a group of nodes. The request is encoded and its
+     * transfer CRC is computed only once; every server gets a separate call with its own transfer ID, so the
+     * callback will be invoked once per server, exactly like with @ref call().
+     * See @ref MultiServiceClient for a convenient way to collect the responses.
+     *
+     * @param server_node_ids   Servers to call; invalid or duplicate entries make the corresponding calls fail.
+     * @param num_servers       Number of entries in server_node_ids.
+     * @param request           Request to send to every server.
+     * @param out_call_ids      Optional array of num_servers entries; receives the call IDs in the same order.
+     *                          If a call couldn't be started, its call ID will be invalid.
+     *
+     * @return                  Number of calls that have been started, which can be less than num_servers;
+     *                          negative error code if none could be started.
+     */
+    int callMultiple(const NodeID* server_node_ids, unsigned num_servers, const RequestType& request,
+                     ServiceCallID* out_call_ids = NULL);
+
     /**
      * Cancels certain call referred via call ID structure.
      */
@@ -346,8 +454,9 @@ public:
     bool hasPendingCallToServer(NodeID server_node_id) const;
 
     /**
-     * This method allows to traverse pending calls. If the index is out of range, an invalid call ID will be returned.
-     * Warning: average complexity is O(index); worst case complexity is O(size).
+     * This method allows to traverse pending calls, ordered by deadline.
+     * If the index is out of range, an invalid call ID will be returned.
+     * Warning: complexity is O(index).
      */
     ServiceCallID getCallIDByIndex(unsigned index) const;
 
@@ -358,14 +467,13 @@ public:
     void setCallback(const Callback& cb) { callback_ = cb; }
 
     /**
-     * Complexity is O(N) of number of pending calls.
-     * Note that the number of pending calls will not be updated until the callback is executed.
+     * Complexity is O(1).
+     * Note that a call is no longer pending by the time its callback is executed.
      */
     unsigned getNumPendingCalls() const { return call_registry_.getSize(); }
 
     /**
      * Complexity is O(1).
-     * Note that the number of pending calls will not be updated until the callback is executed.
      */
     bool hasPendingCalls() const { return !call_registry_.isEmpty(); }
 
@@ -379,7 +487,7 @@ public:
     /**
      * Request timeouts. Note that changing the request timeout will not affect calls that are already pending.
      * There is no such config as TX timeout - TX timeouts are configured automagically according to request timeouts.
-     * Not recommended to change.
+     * Not recommended to change; consider the adaptive timeouts instead, see @ref setRttEstimator().
      */
     MonotonicDuration getRequestTimeout() const { return request_timeout_; }
     void setRequestTimeout(MonotonicDuration timeout)
@@ -398,6 +506,28 @@ public:
      */
     TransferPriority getPriority() const { return publisher_.getPriority(); }
     void setPriority(const TransferPriority prio) { publisher_.setPriority(prio); }
+
+    /**
+     * Buffer the requests are encoded into instead of the stack, see @ref GenericPublisher::setScratchBuffer().
+     */
+    int setScratchBuffer(OutgoingTransferBufferImpl* buffer) { return publisher_.setScratchBuffer(buffer); }
+
+    /**
+     * By default, the response listener is registered with the dispatcher when the first call is made, and it is
+     * unregistered as soon as there are no pending calls left. This keeps the processing of unrelated incoming
+     * service responses fast, but every burst of calls pays for the registration, which involves list insertion,
+     * index rebuild, and, possibly, reconfiguration of the CAN acceptance filters.
+     *
+     * In the persistent mode, the listener stays registered from the first call until the client is destroyed or
+     * the mode is disabled, so the calls don't incur any registration overhead, and the reassembly state of the
+     * listener (transfer receivers and buffers) is reused across the calls rather than being re-created.
+     * This is recommended for clients that make calls frequently.
+     */
+    void setPersistentResponseListener(bool persistent)
+    {
+        persistent_response_listener_ = persistent;
+        stopResponseListenerIfIdle();
+    }
 };
 
 // ----------------------------------------------------------------------------
@@ -405,6 +535,10 @@ public:
 template <typename DataType_, typename Callback_>
 void ServiceClient<DataType_, Callback_>::invokeCallback(ServiceCallResultType& result)
 {
+#if UAVCAN_DUTY_CYCLE_STATS
+    const DutyCycleScope duty_cycle_scope(&SubscriberType::getNode().getDispatcher().getTransferPerfCounter(),
+                                          DutyCycleCategoryCallbacks);
+#endif
     if (coerceOrFallback<bool>(callback_, true))
     {
         callback_(result);
@@ -420,9 +554,7 @@ bool ServiceClient<DataType_, Callback_>::shouldAcceptFrame(const RxFrame& frame
 {
     UAVCAN_ASSERT(frame.getTransferType() == TransferTypeServiceResponse); // Other types filtered out by dispatcher
 
-    return NULL != call_registry_.find(CallStateMatchingPredicate(ServiceCallID(frame.getSrcNodeID(),
-                                                                                frame.getTransferID())));
-
+    return call_registry_.contains(ServiceCallID(frame.getSrcNodeID(), frame.getTransferID()));
 }
 
 template <typename DataType_, typename Callback_>
@@ -431,56 +563,106 @@ void ServiceClient<DataType_, Callback_>::handleReceivedDataStruct(ReceivedDataS
     UAVCAN_ASSERT(response.getTransferType() == TransferTypeServiceResponse);
 
     ServiceCallID call_id(response.getSrcNodeID(), response.getTransferID());
-    cancelCall(call_id);
+    (void)completeCall(call_id, response.getMonotonicTimestamp());
+    stopResponseListenerIfIdle();
     ServiceCallResultType result(ServiceCallResultType::Success, call_id, response);    // Mutable!
     invokeCallback(result);
 }
 
 
 template <typename DataType_, typename Callback_>
-void ServiceClient<DataType_, Callback_>::handleDeadline(MonotonicTime)
+void ServiceClient<DataType_, Callback_>::handleDeadline(MonotonicTime current)
 {
     UAVCAN_TRACE("ServiceClient", "Shared deadline event received");
     /*
-     * Invoking callbacks for timed out call state objects.
+     * Every call is removed before its callback is invoked, so the callback is free to start or cancel calls.
      */
-    TimeoutCallbackCaller callback_caller(*this);
-    call_registry_.template forEach<TimeoutCallbackCaller&>(callback_caller);
+    while (true)
+    {
+        const ServiceCallID call_id = call_registry_.removeFirstExpired(current);
+        if (!call_id.isValid())
+        {
+            break;
+        }
+        UAVCAN_TRACE("ServiceClient", "Timeout from nid=%d, tid=%d, dtname=%s",
+                     int(call_id.server_node_id.get()), int(call_id.transfer_id.get()),
+                     DataType::getDataTypeFullName());
+        handleCallTimeout(call_id);
+
+        typename SubscriberType::ReceivedDataStructureSpec rx_struct; // Default-initialized
+
+        ServiceCallResultType result(ServiceCallResultType::ErrorTimeout, call_id, rx_struct);    // Mutable!
+
+        invokeCallback(result);
+    }
+    updateDeadline();
+    stopResponseListenerIfIdle();
+}
+
+template <typename DataType_, typename Callback_>
+int ServiceClient<DataType_, Callback_>::startResponseListener()
+{
+    if (response_listener_registered_)
+    {
+        return 0;
+    }
+
+    const int subscriber_res = SubscriberType::startAsServiceResponseListener();
+    if (subscriber_res < 0)
+    {
+        UAVCAN_TRACE("ServiceClient", "Failed to start the subscriber, error: %i", subscriber_res);
+        return subscriber_res;
+    }
+
     /*
-     * Removing timed out objects.
-     * This operation cannot be merged with the previous one because that will not work with recursive calls.
+     * Configuring the listener so it will accept only the matching responses
      */
-    call_registry_.removeAllWhere(&CallState::hasTimedOutPredicate);
+    TransferListenerWithFilter* const tl = SubscriberType::getTransferListener();
+    if (tl == NULL)
+    {
+        UAVCAN_ASSERT(0);  // Must have been created
+        SubscriberType::stop();
+        return -ErrLogic;
+    }
+    tl->installAcceptanceFilter(this);
+
+    response_listener_registered_ = true;
+    return 0;
+}
+
+template <typename DataType_, typename Callback_>
+void ServiceClient<DataType_, Callback_>::stopResponseListenerIfIdle()
+{
     /*
      * Subscriber does not need to be registered if we don't have any pending calls.
      * Removing it makes processing of incoming frames a bit faster.
      */
-    if (call_registry_.isEmpty())
+    if (response_listener_registered_ && !persistent_response_listener_ && call_registry_.isEmpty())
     {
         SubscriberType::stop();
+        response_listener_registered_ = false;
     }
 }
 
 template <typename DataType_, typename Callback_>
 int ServiceClient<DataType_, Callback_>::addCallState(ServiceCallID call_id)
 {
-    if (call_registry_.isEmpty())
+    const int subscriber_res = startResponseListener();
+    if (subscriber_res < 0)
     {
-        const int subscriber_res = SubscriberType::startAsServiceResponseListener();
-        if (subscriber_res < 0)
-        {
-            UAVCAN_TRACE("ServiceClient", "Failed to start the subscriber, error: %i", subscriber_res);
-            return subscriber_res;
-        }
+        return subscriber_res;
     }
 
-    if (NULL == call_registry_.template emplace<INode&, ServiceClientBase&, ServiceCallID>(SubscriberType::getNode(),
-                                                                                           *this, call_id))
+    const MonotonicTime now = SubscriberType::getNode().getMonotonicTime();
+    const int add_res =
+        call_registry_.add(call_id, now + getRequestTimeoutForServer(call_id.server_node_id), now);
+    if (add_res < 0)
     {
-        SubscriberType::stop();
-        return -ErrMemory;
+        stopResponseListenerIfIdle();
+        return add_res;
     }
 
+    updateDeadline();
     return 0;
 }
 
@@ -513,7 +695,7 @@ int ServiceClient<DataType_, Callback_>::call(NodeID server_node_id, const Reque
     }
 
     /*
-     * Initializing the call state - this will start the subscriber ad-hoc
+     * Initializing the call state - this will start the subscriber ad-hoc unless it's running already
      */
     const int call_state_res = addCallState(out_call_id);
     if (call_state_res < 0)
@@ -522,19 +704,6 @@ int ServiceClient<DataType_, Callback_>::call(NodeID server_node_id, const Reque
         return call_state_res;
     }
 
-    /*
-     * Configuring the listener so it will accept only the matching responses
-     * TODO move to init(), but this requires to somewhat refactor GenericSubscriber<> (remove TransferForwarder)
-     */
-    TransferListenerWithFilter* const tl = SubscriberType::getTransferListener();
-    if (tl == NULL)
-    {
-        UAVCAN_ASSERT(0);  // Must have been created
-        cancelCall(out_call_id);
-        return -ErrLogic;
-    }
-    tl->installAcceptanceFilter(this);
-
     /*
      * Publishing the request
      */
@@ -550,34 +719,99 @@ int ServiceClient<DataType_, Callback_>::call(NodeID server_node_id, const Reque
     return publisher_res;
 }
 
+template <typename DataType_, typename Callback_>
+int ServiceClient<DataType_, Callback_>::callMultiple(const NodeID* server_node_ids, unsigned num_servers,
+                                                      const RequestType& request, ServiceCallID* out_call_ids)
+{
+    if (!coerceOrFallback<bool>(callback_, true))
+    {
+        UAVCAN_TRACE("ServiceClient", "Invalid callback");
+        return -ErrInvalidConfiguration;
+    }
+    if ((server_node_ids == NULL) && (num_servers > 0))
+    {
+        return -ErrInvalidParam;
+    }
+
+    /*
+     * Encoding once - the payload and the transfer CRC don't depend on the destination
+     */
+    typename PublisherType::EncodedBuffer buffer((TransferCRC()));
+    const int encode_res = publisher_.encode(request, buffer);
+    if (encode_res < 0)
+    {
+        UAVCAN_TRACE("ServiceClient", "Failed to encode the request, error: %i", encode_res);
+        return encode_res;
+    }
+
+    int num_started = 0;
+    int last_error = 0;
+    for (unsigned i = 0; i < num_servers; i++)
+    {
+        ServiceCallID call_id;
+        int res = prepareToCall(SubscriberType::getNode(), DataType::getDataTypeFullName(), server_node_ids[i],
+                                call_id);
+        if (res >= 0)
+        {
+            res = addCallState(call_id);
+        }
+        if (res >= 0)
+        {
+            res = publisher_.publishEncoded(buffer, TransferTypeServiceRequest, server_node_ids[i],
+                                            call_id.transfer_id);
+            if (res < 0)
+            {
+                cancelCall(call_id);
+            }
+        }
+
+        if (res < 0)
+        {
+            UAVCAN_TRACE("ServiceClient", "Failed to call nid=%d, error: %i", int(server_node_ids[i].get()), res);
+            last_error = res;
+            call_id = ServiceCallID();
+        }
+        else
+        {
+            num_started++;
+        }
+        if (out_call_ids != NULL)
+        {
+            out_call_ids[i] = call_id;
+        }
+    }
+
+    return ((num_started > 0) || (num_servers == 0)) ? num_started : last_error;
+}
+
 template <typename DataType_, typename Callback_>
 void ServiceClient<DataType_, Callback_>::cancelCall(ServiceCallID call_id)
 {
-    call_registry_.removeFirstWhere(CallStateMatchingPredicate(call_id));
-    if (call_registry_.isEmpty())
+    if (call_registry_.remove(call_id))
     {
-        SubscriberType::stop();
+        updateDeadline();
     }
+    stopResponseListenerIfIdle();
 }
 
 template <typename DataType_, typename Callback_>
 void ServiceClient<DataType_, Callback_>::cancelAllCalls()
 {
     call_registry_.clear();
-    SubscriberType::stop();
+    updateDeadline();
+    stopResponseListenerIfIdle();
 }
 
 template <typename DataType_, typename Callback_>
 bool ServiceClient<DataType_, Callback_>::hasPendingCallToServer(NodeID server_node_id) const
 {
-    return NULL != call_registry_.find(ServerSearchPredicate(server_node_id));
+    return call_registry_.containsServer(server_node_id);
 }
 
 template <typename DataType_, typename Callback_>
 ServiceCallID ServiceClient<DataType_, Callback_>::getCallIDByIndex(unsigned index) const
 {
-    const CallState* const id = call_registry_.getByIndex(index);
-    return (id == NULL) ? ServiceCallID() : id->getCallID();
+    return call_registry_.getByIndex(index);
 }
 
 }
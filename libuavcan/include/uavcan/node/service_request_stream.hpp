@@ -0,0 +1,394 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_NODE_SERVICE_REQUEST_STREAM_HPP_INCLUDED
+#define UAVCAN_NODE_SERVICE_REQUEST_STREAM_HPP_INCLUDED
+
+#include <uavcan/build_config.hpp>
+#include <uavcan/debug.hpp>
+#include <uavcan/node/service_client.hpp>
+#include <uavcan/util/method_binder.hpp>
+
+namespace uavcan
+{
+/**
+ * Applications that use @ref ServiceRequestStream should implement this interface.
+ * Requests are identified by indices, counting from zero.
+ */
+template <typename DataType>
+class UAVCAN_EXPORT IServiceRequestStreamHandler
+{
+public:
+    typedef typename DataType::Request RequestType;
+    typedef typename DataType::Response ResponseType;
+
+    /**
+     * Called when the stream is ready to send the request with the specified index.
+     * Failed requests are repeated, so the same index can be requested more than once; the produced request must be
+     * the same every time.
+     * @param index         Index of the request
+     * @param out_request   Request to fill
+     * @return              False if there are no more requests; higher indices will not be requested afterwards.
+     */
+    virtual bool produceRequest(uint32_t index, RequestType& out_request) = 0;
+
+    /**
+     * Called in the order of request indices, regardless of the order in which the responses have arrived.
+     * @param index         Index of the request
+     * @param response      Response to the request; the reference invalidates once the method returns
+     */
+    virtual void handleResponse(uint32_t index, const ResponseType& response) = 0;
+
+    /**
+     * Called if the request could not be completed within the allowed number of attempts.
+     * Responses to all preceding requests have been delivered by that time. The stream is stopped when this method
+     * is called, so no further requests will be made and no further responses will be delivered.
+     * @param index         Index of the failed request
+     */
+    virtual void handleFailure(uint32_t index) = 0;
+
+    /**
+     * Called once all produced requests have been completed and their responses delivered.
+     * Default implementation does nothing.
+     */
+    virtual void handleCompletion() { }
+
+    virtual ~IServiceRequestStreamHandler() { }
+};
+
+/**
+ * This class helps to perform bulk operations that consist of many successive service calls to the same server,
+ * such as reading all parameters by index or reading a file chunk by chunk. Instead of making one call at a time,
+ * it keeps a window of up to MaxWindowSize calls in flight, so throughput is not bound by the round trip time.
+ *
+ * Responses are matched with requests by call ID (server node ID and transfer ID), and delivered to the application
+ * strictly in the order of request indices. A request is repeated if it times out. If it fails after the configured
+ * number of attempts, the stream stops; refer to @ref IServiceRequestStreamHandler.
+ *
+ * The window size starts at MaxWindowSize and adapts to the observed timeouts: it is halved once per window
+ * upon timeout, and increased by one after a window's worth of successful calls.
+ *
+ * Responses that arrived ahead of the preceding ones are stored in the stream object, so its size is roughly
+ * MaxWindowSize times the size of the response structure. Every call in flight also takes one pool block.
+ *
+ * Use one stream object per server.
+ *
+ * @tparam DataType_        Service data type.
+ *
+ * @tparam MaxWindowSize_   Maximum number of requests in the window, including those that have been responded to but
+ *                          are not yet delivered. Cannot exceed TransferID::Half, because all calls in flight to the
+ *                          server must have different transfer IDs.
+ */
+template <typename DataType_, unsigned MaxWindowSize_ = 8>
+class UAVCAN_EXPORT ServiceRequestStream : Noncopyable
+{
+public:
+    typedef DataType_ DataType;
+    typedef typename DataType::Request RequestType;
+    typedef typename DataType::Response ResponseType;
+    typedef IServiceRequestStreamHandler<DataType> Handler;
+
+    enum { MaxWindowSize = MaxWindowSize_ };
+    enum { DefaultMaxRequestAttempts = 3 };
+
+private:
+    typedef MethodBinder<ServiceRequestStream*,
+                         void (ServiceRequestStream::*)(const ServiceCallResult<DataType>&)> CallResultCallback;
+
+    struct Slot
+    {
+        ResponseType response;
+        ServiceCallID call_id;
+        uint8_t num_attempts;
+        bool pending;                   ///< The call is in flight
+        bool completed;                 ///< Either responded to or failed
+        bool successful;
+
+        Slot()
+            : num_attempts(0)
+            , pending(false)
+            , completed(false)
+            , successful(false)
+        { }
+    };
+
+    ServiceClient<DataType, CallResultCallback> client_;
+    Handler& handler_;
+    Slot slots_[MaxWindowSize];
+    NodeID server_node_id_;                     ///< Invalid if not running
+    uint32_t next_index_to_deliver_;
+    uint32_t next_index_to_request_;
+    uint32_t window_reduction_index_;           ///< Timeouts of preceding requests don't reduce the window again
+    uint32_t num_timeouts_;
+    uint8_t window_size_;
+    uint8_t num_successes_at_window_size_;
+    uint8_t max_request_attempts_;
+    bool requests_exhausted_;
+    bool failed_;                               ///< No more requests will be made
+
+    Slot& getSlot(uint32_t index) { return slots_[index % unsigned(MaxWindowSize)]; }
+
+    void call(uint32_t index, const RequestType& request)
+    {
+        Slot& slot = getSlot(index);
+        slot.num_attempts++;
+        const int res = client_.call(server_node_id_, request, slot.call_id);
+        if (res < 0)
+        {
+            UAVCAN_TRACE("ServiceRequestStream", "Failed to send request %u, error: %i", unsigned(index), res);
+            slot.completed = true;
+            failed_ = true;
+        }
+        else
+        {
+            slot.pending = true;
+        }
+    }
+
+    void fillWindow()
+    {
+        while (isRunning() && !failed_ && !requests_exhausted_ &&
+               ((next_index_to_request_ - next_index_to_deliver_) < window_size_))
+        {
+            const uint32_t index = next_index_to_request_;
+            RequestType request;
+            if (!handler_.produceRequest(index, request))
+            {
+                requests_exhausted_ = true;
+                break;
+            }
+            if (!isRunning())
+            {
+                break;              // Stopped by the handler
+            }
+            getSlot(index) = Slot();
+            next_index_to_request_++;
+            call(index, request);
+        }
+    }
+
+    void repeatRequest(uint32_t index)
+    {
+        RequestType request;
+        const bool produced = handler_.produceRequest(index, request);
+        if (!isRunning())
+        {
+            return;
+        }
+        if (produced)
+        {
+            call(index, request);
+        }
+        else
+        {
+            UAVCAN_TRACE("ServiceRequestStream", "Request %u could not be repeated", unsigned(index));
+            getSlot(index).completed = true;
+            failed_ = true;
+        }
+    }
+
+    void deliverCompleted()
+    {
+        while (isRunning() && (next_index_to_deliver_ != next_index_to_request_))
+        {
+            Slot& slot = getSlot(next_index_to_deliver_);
+            if (!slot.completed)
+            {
+                break;
+            }
+            const uint32_t index = next_index_to_deliver_++;
+            if (slot.successful)
+            {
+                handler_.handleResponse(index, slot.response);
+            }
+            else
+            {
+                stop();
+                handler_.handleFailure(index);
+            }
+        }
+    }
+
+    void advance()
+    {
+        deliverCompleted();
+        fillWindow();
+        deliverCompleted();         // Requests that could not be sent are reported immediately
+
+        if (isRunning() && requests_exhausted_ && (next_index_to_deliver_ == next_index_to_request_))
+        {
+            stop();
+            handler_.handleCompletion();
+        }
+    }
+
+    void handleSuccessfulCall()
+    {
+        num_successes_at_window_size_++;
+        if ((num_successes_at_window_size_ >= window_size_) && (window_size_ < MaxWindowSize))
+        {
+            window_size_++;
+            num_successes_at_window_size_ = 0;
+            UAVCAN_TRACE("ServiceRequestStream", "Window size increased to %u", unsigned(window_size_));
+        }
+    }
+
+    void handleTimedOutCall(uint32_t index)
+    {
+        num_timeouts_++;
+        num_successes_at_window_size_ = 0;
+        /*
+         * Calls that were in flight at the time of the previous reduction are likely to have been lost for the same
+         * reason, so their timeouts don't reduce the window again.
+         */
+        if (int32_t(index - window_reduction_index_) >= 0)
+        {
+            window_size_ = uint8_t(max(window_size_ / 2U, 1U));
+            window_reduction_index_ = next_index_to_request_;
+            UAVCAN_TRACE("ServiceRequestStream", "Window size reduced to %u", unsigned(window_size_));
+        }
+    }
+
+    void handleCallResult(const ServiceCallResult<DataType>& result)
+    {
+        uint32_t index = next_index_to_deliver_;
+        for (; index != next_index_to_request_; index++)
+        {
+            const Slot& slot = getSlot(index);
+            if (slot.pending && (slot.call_id == result.getCallID()))
+            {
+                break;
+            }
+        }
+        if (index == next_index_to_request_)
+        {
+            UAVCAN_ASSERT(0);       // All calls are cancelled when the stream is stopped
+            return;
+        }
+
+        Slot& slot = getSlot(index);
+        slot.pending = false;
+
+        if (result.isSuccessful())
+        {
+            slot.response = result.getResponse();
+            slot.completed = true;
+            slot.successful = true;
+            handleSuccessfulCall();
+        }
+        else
+        {
+            UAVCAN_TRACE("ServiceRequestStream", "Request %u timed out, attempt %u",
+                         unsigned(index), unsigned(slot.num_attempts));
+            handleTimedOutCall(index);
+            if ((slot.num_attempts < max_request_attempts_) && !failed_)
+            {
+                repeatRequest(index);
+            }
+            else
+            {
+                slot.completed = true;
+                failed_ = true;
+            }
+        }
+
+        advance();
+    }
+
+public:
+    ServiceRequestStream(INode& node, Handler& handler)
+        : client_(node)
+        , handler_(handler)
+        , next_index_to_deliver_(0)
+        , next_index_to_request_(0)
+        , window_reduction_index_(0)
+        , num_timeouts_(0)
+        , window_size_(MaxWindowSize)
+        , num_successes_at_window_size_(0)
+        , max_request_attempts_(DefaultMaxRequestAttempts)
+        , requests_exhausted_(false)
+        , failed_(false)
+    {
+        StaticAssert<(MaxWindowSize >= 1)>::check();
+        StaticAssert<(MaxWindowSize <= TransferID::Half)>::check();
+        client_.setCallback(CallResultCallback(this, &ServiceRequestStream::handleCallResult));
+    }
+
+    /**
+     * Starts the stream from the request number zero. If the stream is already running, it will be restarted.
+     * Note that the handler can be invoked from this method, e.g. if there are no requests at all.
+     * The window size and the number of timeouts are retained between runs.
+     * Returns negative error code.
+     */
+    int start(NodeID server_node_id)
+    {
+        if (!server_node_id.isUnicast())
+        {
+            return -ErrInvalidParam;
+        }
+        stop();
+
+        server_node_id_ = server_node_id;
+        next_index_to_deliver_ = 0;
+        next_index_to_request_ = 0;
+        window_reduction_index_ = 0;
+        requests_exhausted_ = false;
+        failed_ = false;
+
+        advance();
+        return 0;
+    }
+
+    /**
+     * Cancels all calls in flight. The handler will not be invoked afterwards.
+     */
+    void stop()
+    {
+        client_.cancelAllCalls();
+        server_node_id_ = NodeID();
+    }
+
+    bool isRunning() const { return server_node_id_.isUnicast(); }
+
+    /**
+     * Invalid if the stream is not running.
+     */
+    NodeID getServerNodeID() const { return server_node_id_; }
+
+    /**
+     * Current size of the window, which adapts to the observed timeouts.
+     */
+    unsigned getWindowSize() const { return window_size_; }
+
+    /**
+     * Number of requests whose responses have been delivered since the stream was started.
+     */
+    uint32_t getNumDeliveredResponses() const { return next_index_to_deliver_; }
+
+    unsigned getNumPendingCalls() const { return client_.getNumPendingCalls(); }
+
+    /**
+     * Total number of timed out calls, including those that were repeated successfully.
+     */
+    uint32_t getNumTimeouts() const { return num_timeouts_; }
+
+    /**
+     * How many times a request is sent before it is considered failed. The value cannot be less than one.
+     */
+    uint8_t getMaxRequestAttempts() const { return max_request_attempts_; }
+    void setMaxRequestAttempts(uint8_t num) { max_request_attempts_ = max(num, uint8_t(1)); }
+
+    /**
+     * Request timeout of the underlying service client; refer to @ref ServiceClient.
+     */
+    MonotonicDuration getRequestTimeout() const { return client_.getRequestTimeout(); }
+    void setRequestTimeout(MonotonicDuration timeout) { client_.setRequestTimeout(timeout); }
+
+    TransferPriority getPriority() const { return client_.getPriority(); }
+    void setPriority(const TransferPriority prio) { client_.setPriority(prio); }
+};
+
+}
+
+#endif // UAVCAN_NODE_SERVICE_REQUEST_STREAM_HPP_INCLUDED
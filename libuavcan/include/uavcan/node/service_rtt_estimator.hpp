@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_NODE_SERVICE_RTT_ESTIMATOR_HPP_INCLUDED
+#define UAVCAN_NODE_SERVICE_RTT_ESTIMATOR_HPP_INCLUDED
+
+#include <uavcan/std.hpp>
+#include <uavcan/build_config.hpp>
+#include <uavcan/time.hpp>
+#include <uavcan/transport/transfer.hpp>
+#include <uavcan/util/templates.hpp>
+
+#if !UAVCAN_TINY
+
+namespace uavcan
+{
+/**
+ * Estimates the round trip time of service calls per server the same way as TCP does (RFC 6298),
+ * so that the request timeout follows the actual latency of the server and of the bus:
+ *
+ *   RTTVAR = 3/4 * RTTVAR + 1/4 * |SRTT - R|
+ *   SRTT = 7/8 * SRTT + 1/8 * R
+ *   timeout = SRTT + 4 * RTTVAR
+ *
+ * The first sample R initializes SRTT to R and RTTVAR to R/2. Every timeout doubles the timeout of the server
+ * until the next response arrives. Karn's algorithm is not needed, because a retried request is a new call
+ * with its own transfer ID, so every response unambiguously belongs to one request.
+ *
+ * Attach the estimator to one or more clients with @ref ServiceClient::setRttEstimator(), which also bounds
+ * the timeout with @ref ServiceClientBase::getMinRequestTimeout() and @ref ServiceClientBase::getMaxRequestTimeout().
+ * Once all entries are occupied, the least recently updated one is reused for a new server.
+ */
+class UAVCAN_EXPORT ServiceRttEstimatorBase : Noncopyable
+{
+public:
+    struct Entry
+    {
+        uint32_t srtt_usec;             ///< Zero if there were no samples yet
+        uint32_t rttvar_usec;
+        uint32_t last_update;           ///< Value of the update counter, for the replacement policy
+        NodeID server_node_id;
+        uint8_t backoff_shift;          ///< Number of timeouts since the last sample, limited by MaxBackoffShift
+
+        Entry()
+            : srtt_usec(0)
+            , rttvar_usec(0)
+            , last_update(0)
+            , backoff_shift(0)
+        { }
+    };
+
+    enum { MaxBackoffShift = 6 };
+
+private:
+    Entry* const entries_;
+    const unsigned capacity_;
+    uint32_t update_counter_;
+
+    const Entry* find(NodeID server_node_id) const;
+    Entry* findOrCreate(NodeID server_node_id);
+
+protected:
+    ServiceRttEstimatorBase(Entry* entries, unsigned capacity)
+        : entries_(entries)
+        , capacity_(capacity)
+        , update_counter_(0)
+    {
+        UAVCAN_ASSERT((entries_ != NULL) && (capacity_ > 0));
+    }
+
+    ~ServiceRttEstimatorBase() { }
+
+public:
+    /**
+     * Measured time between the request and the response of a successful call.
+     */
+    void addSample(NodeID server_node_id, MonotonicDuration rtt);
+
+    /**
+     * Backs off the timeout of the server until the next sample.
+     */
+    void addTimeout(NodeID server_node_id);
+
+    /**
+     * Timeout for the next call to the server, not bounded.
+     * The default timeout is used (and backed off) for the servers that have not responded yet.
+     */
+    MonotonicDuration getRequestTimeout(NodeID server_node_id, MonotonicDuration default_timeout) const;
+
+    /**
+     * Zero if the server has not responded yet.
+     */
+    MonotonicDuration getSmoothedRtt(NodeID server_node_id) const;
+    MonotonicDuration getRttVariation(NodeID server_node_id) const;
+
+    /**
+     * Forgets all servers.
+     */
+    void reset();
+
+    unsigned getCapacity() const { return capacity_; }
+};
+
+/**
+ * @tparam NumServers   Number of servers whose state is kept; each takes 16 bytes.
+ */
+template <unsigned NumServers>
+class UAVCAN_EXPORT ServiceRttEstimator : public ServiceRttEstimatorBase
+{
+    Entry storage_[NumServers];
+
+public:
+    ServiceRttEstimator()
+        : ServiceRttEstimatorBase(storage_, NumServers)
+    {
+        StaticAssert<(NumServers > 0)>::check();
+    }
+};
+
+}
+
+#endif // !UAVCAN_TINY
+
+#endif // UAVCAN_NODE_SERVICE_RTT_ESTIMATOR_HPP_INCLUDED
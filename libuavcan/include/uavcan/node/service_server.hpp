@@ -8,6 +8,7 @@
 #include <uavcan/build_config.hpp>
 #include <uavcan/node/generic_publisher.hpp>
 #include <uavcan/node/generic_subscriber.hpp>
+#include <uavcan/node/service_client.hpp>
 
 #if !defined(UAVCAN_CPP_VERSION) || !defined(UAVCAN_CPP11)
 # error UAVCAN_CPP_VERSION
@@ -19,6 +20,25 @@
 
 namespace uavcan
 {
+/**
+ * Identifies a service request which response has been deferred by the server callback,
+ * see @ref ServiceResponseDataStructure::defer().
+ */
+struct UAVCAN_EXPORT ServiceResponseHandle
+{
+    ServiceCallID call_id;          ///< Node ID of the client and transfer ID of the request
+    TransferPriority priority;      ///< Priority of the request, see @ref ServiceServerBase::setResponsePriority()
+
+    ServiceResponseHandle() { }
+
+    ServiceResponseHandle(ServiceCallID arg_call_id, TransferPriority arg_priority)
+        : call_id(arg_call_id)
+        , priority(arg_priority)
+    { }
+
+    bool isValid() const { return call_id.isValid(); }
+};
+
 /**
  * This type can be used in place of the response type in a service server callback to get more advanced control
  * of service request processing.
@@ -40,15 +60,53 @@ template <typename ResponseDataType_>
 class ServiceResponseDataStructure : public ResponseDataType_
 {
     // Fields are weirdly named to avoid name clashing with the inherited data type
+    ServiceResponseHandle _handle_;
+    OutgoingTransferBufferImpl* _encoded_;
     bool _enabled_;
+    bool _deferred_;
 
 public:
     typedef ResponseDataType_ ResponseDataType;
 
     ServiceResponseDataStructure()
-        : _enabled_(true)
+        : _encoded_(NULL)
+        , _enabled_(true)
+        , _deferred_(false)
+    { }
+
+    explicit ServiceResponseDataStructure(const ServiceResponseHandle& handle)
+        : _handle_(handle)
+        , _encoded_(NULL)
+        , _enabled_(true)
+        , _deferred_(false)
     { }
 
+    /**
+     * Tells the server to not transmit the response when the callback returns. Instead, the application
+     * shall send the response later via @ref ServiceServer::respond() using the returned handle, e.g. from a timer
+     * callback once a slow operation is finished. Deferred requests that are not responded to within
+     * the deferred response timeout are discarded, see @ref ServiceServer::setDeferredResponseTimeout().
+     * The contents of this object are ignored once the response is deferred.
+     */
+    ServiceResponseHandle defer()
+    {
+        _deferred_ = true;
+        return _handle_;
+    }
+
+    /**
+     * Whether the response has been deferred, see @ref defer().
+     */
+    bool isResponseDeferred() const { return _deferred_; }
+
+    /**
+     * Tells the server to transmit the pre-encoded response instead of the contents of this object,
+     * see @ref ServiceServer::encodeResponse(). The buffer must not be modified until the callback returns.
+     */
+    void setEncodedResponse(OutgoingTransferBufferImpl& encoded) { _encoded_ = &encoded; }
+
+    OutgoingTransferBufferImpl* getEncodedResponse() const { return _encoded_; }
+
     /**
      * When disabled, the server will not transmit the response transfer.
      * By default it is enabled, i.e. response will be sent.
@@ -61,12 +119,126 @@ public:
     bool isResponseEnabled() const { return _enabled_; }
 };
 
+/**
+ * Do not use directly.
+ */
+class ServiceServerBase : protected DeadlineHandler
+{
+    /**
+     * All deferred requests share the deadline handler of the server, which is armed for the earliest deadline.
+     */
+    ServiceCallRegistry deferred_requests_;
+
+    MonotonicDuration deferred_response_timeout_;
+    uint32_t deferred_response_timeout_count_;
+    TransferPriority response_priority_;        ///< Invalid if the responses inherit the priority of the requests
+    bool response_priority_fixed_;
+
+    void updateDeadline();
+
+    virtual void handleDeadline(MonotonicTime current);
+
+protected:
+    explicit ServiceServerBase(INode& node)
+        : DeadlineHandler(node.getScheduler())
+        , deferred_requests_(node.getAllocator())
+        , deferred_response_timeout_(getDefaultDeferredResponseTimeout())
+        , deferred_response_timeout_count_(0)
+        , response_priority_fixed_(false)
+    { }
+
+    virtual ~ServiceServerBase() { }
+
+    /**
+     * The deadline is counted from the reception of the request. Returns negative error code.
+     */
+    int addDeferredRequest(ServiceCallID call_id, MonotonicTime request_ts);
+
+    /**
+     * Returns false if the request is unknown or has expired.
+     */
+    bool removeDeferredRequest(ServiceCallID call_id);
+
+    void removeAllDeferredRequests();
+
+public:
+    /**
+     * Clients normally don't wait for a response longer than their default request timeout.
+     */
+    static MonotonicDuration getDefaultDeferredResponseTimeout()
+    {
+        return ServiceClientBase::getDefaultRequestTimeout();
+    }
+
+    /**
+     * Change of this value will not affect pending deferred requests.
+     */
+    MonotonicDuration getDeferredResponseTimeout() const { return deferred_response_timeout_; }
+    void setDeferredResponseTimeout(MonotonicDuration timeout) { deferred_response_timeout_ = timeout; }
+
+    /**
+     * Returns the number of deferred requests that are waiting for response.
+     */
+    unsigned getNumPendingDeferredResponses() const { return deferred_requests_.getSize(); }
+
+    /**
+     * Returns the number of deferred requests that were discarded because they were not responded to in time.
+     */
+    uint32_t getDeferredResponseTimeoutCount() const { return deferred_response_timeout_count_; }
+
+    /**
+     * By default, the response is sent at the priority of the request it answers, so that a high priority request
+     * doesn't get a response that loses arbitration on a loaded bus. These methods override that per server:
+     *  - setResponsePriority() sends all responses at the specified priority regardless of the requests.
+     *  - setMinResponsePriority() keeps inheriting, but never goes below the specified priority; this is useful
+     *    for critical services that can be called by clients that use low priority requests.
+     *  - inheritResponsePriority() restores the default behavior.
+     * Deferred responses are affected as well, since the policy is applied when the response is sent.
+     */
+    void setResponsePriority(TransferPriority priority)
+    {
+        response_priority_ = priority;
+        response_priority_fixed_ = true;
+    }
+    void setMinResponsePriority(TransferPriority priority)
+    {
+        response_priority_ = priority;
+        response_priority_fixed_ = false;
+    }
+    void inheritResponsePriority()
+    {
+        response_priority_ = TransferPriority();
+        response_priority_fixed_ = false;
+    }
+
+    /**
+     * Priority of the response to a request of the specified priority, according to the settings above.
+     * Note that numerically lower values mean higher priority.
+     */
+    TransferPriority getResponsePriority(TransferPriority request_priority) const
+    {
+        if (!response_priority_.isValid())
+        {
+            return request_priority;
+        }
+        if (response_priority_fixed_ || !request_priority.isValid())
+        {
+            return response_priority_;
+        }
+        return (request_priority.get() < response_priority_.get()) ? request_priority : response_priority_;
+    }
+};
+
 /**
  * Use this class to implement UAVCAN service servers.
  *
  * Note that the references passed to the callback may point to stack-allocated objects, which means that the
  * references get invalidated once the callback returns.
  *
+ * If processing of a request takes a long time, the callback can defer the response instead of blocking the node,
+ * see @ref ServiceResponseDataStructure::defer() and @ref respond(). Each deferred request takes one memory pool
+ * block until it is responded to or expired.
+ *
  * @tparam DataType_        Service data type.
  *
  * @tparam Callback_        Service calls will be delivered through the callback of this type, and service
@@ -77,18 +249,24 @@ public:
  *                          In C++11 mode this type defaults to std::function<>.
  *                          In C++03 mode this type defaults to a plain function pointer; use binder to
  *                          call member functions as callbacks.
+ *
+ * @tparam TransferListener_ Transfer listener implementation used by the transport layer for the requests, e.g.
+ *                          @ref TransferListenerWithReservedSlots for the services that must never run out of
+ *                          reception memory.
  */
 template <typename DataType_,
 #if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
           typename Callback_ = std::function<void (const ReceivedDataStructure<typename DataType_::Request>&,
-                                                   ServiceResponseDataStructure<typename DataType_::Response>&)>
+                                                   ServiceResponseDataStructure<typename DataType_::Response>&)>,
 #else
           typename Callback_ = void (*)(const ReceivedDataStructure<typename DataType_::Request>&,
-                                        ServiceResponseDataStructure<typename DataType_::Response>&)
+                                        ServiceResponseDataStructure<typename DataType_::Response>&),
 #endif
+          typename TransferListener_ = TransferListener
           >
 class UAVCAN_EXPORT ServiceServer
-    : public GenericSubscriber<DataType_, typename DataType_::Request, TransferListener>
+    : public GenericSubscriber<DataType_, typename DataType_::Request, TransferListener_>
+    , public ServiceServerBase
 {
 public:
     typedef DataType_ DataType;
@@ -97,18 +275,47 @@ public:
     typedef Callback_ Callback;
 
 private:
-    typedef GenericSubscriber<DataType, RequestType, TransferListener> SubscriberType;
+    typedef GenericSubscriber<DataType, RequestType, TransferListener_> SubscriberType;
     typedef GenericPublisher<DataType, ResponseType> PublisherType;
 
+public:
+    typedef typename PublisherType::EncodedBuffer EncodedResponse;
+
+private:
+
     PublisherType publisher_;
     Callback callback_;
     uint32_t response_failure_count_;
 
+    /**
+     * The encoded response is used instead of the data structure if provided.
+     */
+    int publishResponse(const ResponseType& response, OutgoingTransferBufferImpl* encoded,
+                        const ServiceResponseHandle& handle)
+    {
+        publisher_.setPriority(getResponsePriority(handle.priority));
+
+        const int res = (encoded == NULL) ?
+            publisher_.publish(response, TransferTypeServiceResponse, handle.call_id.server_node_id,
+                               handle.call_id.transfer_id) :
+            publisher_.publishEncoded(*encoded, TransferTypeServiceResponse, handle.call_id.server_node_id,
+                                      handle.call_id.transfer_id);
+        if (res < 0)
+        {
+            UAVCAN_TRACE("ServiceServer", "Response publication failure: %i", res);
+            publisher_.getNode().getDispatcher().getTransferPerfCounter().addError();
+            response_failure_count_++;
+        }
+        return res;
+    }
+
     virtual void handleReceivedDataStruct(ReceivedDataStructure<RequestType>& request)
     {
         UAVCAN_ASSERT(request.getTransferType() == TransferTypeServiceRequest);
 
-        ServiceResponseDataStructure<ResponseType> response;
+        const ServiceResponseHandle handle(ServiceCallID(request.getSrcNodeID(), request.getTransferID()),
+                                           request.getPriority());
+        ServiceResponseDataStructure<ResponseType> response(handle);
 
         if (coerceOrFallback<bool>(callback_, true))
         {
@@ -120,19 +327,18 @@ private:
             handleFatalError("Srv serv clbk");
         }
 
-        if (response.isResponseEnabled())
+        if (response.isResponseDeferred())
         {
-            publisher_.setPriority(request.getPriority());      // Responding at the same priority.
-
-            const int res = publisher_.publish(response, TransferTypeServiceResponse, request.getSrcNodeID(),
-                                               request.getTransferID());
-            if (res < 0)
+            if (addDeferredRequest(handle.call_id, request.getMonotonicTimestamp()) < 0)
             {
-                UAVCAN_TRACE("ServiceServer", "Response publication failure: %i", res);
-                publisher_.getNode().getDispatcher().getTransferPerfCounter().addError();
+                UAVCAN_TRACE("ServiceServer", "Failed to defer the response");
                 response_failure_count_++;
             }
         }
+        else if (response.isResponseEnabled())
+        {
+            (void)publishResponse(response, response.getEncodedResponse(), handle);
+        }
         else
         {
             UAVCAN_TRACE("ServiceServer", "Response was suppressed by the application");
@@ -142,6 +348,7 @@ private:
 public:
     explicit ServiceServer(INode& node)
         : SubscriberType(node)
+        , ServiceServerBase(node)
         , publisher_(node, getDefaultTxTimeout())
         , callback_()
         , response_failure_count_(0)
@@ -176,9 +383,48 @@ public:
     }
 
     /**
-     * Stops the server.
+     * Stops the server. Pending deferred requests are discarded.
      */
-    using SubscriberType::stop;
+    void stop()
+    {
+        SubscriberType::stop();
+        removeAllDeferredRequests();
+    }
+
+    /**
+     * Sends the response to a deferred request, see @ref ServiceResponseDataStructure::defer().
+     * This method can be called at any time from the application context, e.g. from a timer callback.
+     * Returns negative error code; unknown or expired requests are rejected as @ref ErrInvalidParam.
+     */
+    int respond(const ServiceResponseHandle& handle, const ResponseType& response)
+    {
+        if (!removeDeferredRequest(handle.call_id))
+        {
+            UAVCAN_TRACE("ServiceServer", "Unknown or expired deferred request: nid=%d tid=%d",
+                         int(handle.call_id.server_node_id.get()), int(handle.call_id.transfer_id.get()));
+            return -ErrInvalidParam;
+        }
+        return publishResponse(response, NULL, handle);
+    }
+
+    /**
+     * Encodes the response once, so that the callback can send it to many clients without encoding it again, see
+     * @ref ServiceResponseDataStructure::setEncodedResponse(). This is useful for idempotent services which
+     * responses change rarely; the application must encode the response again when its contents change.
+     * Returns negative error code.
+     */
+    int encodeResponse(const ResponseType& response, EncodedResponse& out_encoded)
+    {
+        return publisher_.encode(response, out_encoded);
+    }
+
+    /**
+     * Discards a deferred request without responding to it. Returns false if the request is unknown or expired.
+     */
+    bool cancelDeferredResponse(const ServiceResponseHandle& handle)
+    {
+        return removeDeferredRequest(handle.call_id);
+    }
 
     static MonotonicDuration getDefaultTxTimeout() { return MonotonicDuration::fromMSec(1000); }
     static MonotonicDuration getMinTxTimeout() { return PublisherType::getMinTxTimeout(); }
@@ -187,6 +433,11 @@ public:
     MonotonicDuration getTxTimeout() const { return publisher_.getTxTimeout(); }
     void setTxTimeout(MonotonicDuration tx_timeout) { publisher_.setTxTimeout(tx_timeout); }
 
+    /**
+     * Buffer the responses are encoded into instead of the stack, see @ref GenericPublisher::setScratchBuffer().
+     */
+    int setScratchBuffer(OutgoingTransferBufferImpl* buffer) { return publisher_.setScratchBuffer(buffer); }
+
     /**
      * Returns the number of failed attempts to decode data structs. Generally, a failed attempt means either:
      * - Transient failure in the transport layer.
@@ -194,6 +445,12 @@ public:
      */
     uint32_t getRequestFailureCount() const { return SubscriberType::getFailureCount(); }
     uint32_t getResponseFailureCount() const { return response_failure_count_; }
+
+    /**
+     * The requests are decoded into the specified slot rather than on the stack; see @ref GenericSubscriber.
+     */
+    typedef typename SubscriberType::DecodeSlot RequestDecodeSlot;
+    void setRequestDecodeSlot(RequestDecodeSlot* slot) { SubscriberType::setDecodeSlot(slot); }
 };
 
 }
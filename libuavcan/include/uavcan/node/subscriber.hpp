@@ -34,22 +34,29 @@ namespace uavcan
  *                          In C++11 mode this type defaults to std::function<>.
  *                          In C++03 mode this type defaults to a plain function pointer; use binder to
  *                          call member functions as callbacks.
+ *
+ * @tparam TransferListener_ Transfer listener implementation used by the transport layer.
+ *                          Use @ref TransferListenerWithNodeIndex for messages that are published at a high
+ *                          rate by many nodes; it needs more memory, but the per-frame overhead is lower.
+ *                          Use @ref TransferListenerWithReservedSlots for the critical messages that must be
+ *                          received without competing for the shared memory pool.
  */
 template <typename DataType_,
 #if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
-          typename Callback_ = std::function<void (const ReceivedDataStructure<DataType_>&)>
+          typename Callback_ = std::function<void (const ReceivedDataStructure<DataType_>&)>,
 #else
-          typename Callback_ = void (*)(const ReceivedDataStructure<DataType_>&)
+          typename Callback_ = void (*)(const ReceivedDataStructure<DataType_>&),
 #endif
+          typename TransferListener_ = TransferListener
           >
 class UAVCAN_EXPORT Subscriber
-    : public GenericSubscriber<DataType_, DataType_, TransferListener>
+    : public GenericSubscriber<DataType_, DataType_, TransferListener_>
 {
 public:
     typedef Callback_ Callback;
 
 private:
-    typedef GenericSubscriber<DataType_, DataType_, TransferListener> BaseType;
+    typedef GenericSubscriber<DataType_, DataType_, TransferListener_> BaseType;
 
     Callback callback_;
 
@@ -97,6 +104,18 @@ public:
     using BaseType::allowAnonymousTransfers;
     using BaseType::stop;
     using BaseType::getFailureCount;
+    using BaseType::setDecimation;
+    using BaseType::setOnChangeMode;
+    using BaseType::getNumSkippedTransfers;
+    using BaseType::setDecodeSlot;
+    using BaseType::getDecodeSlot;
+#if !UAVCAN_TINY
+    using BaseType::enableDeferredDispatch;
+    using BaseType::disableDeferredDispatch;
+    using BaseType::isDeferredDispatchEnabled;
+    using BaseType::getNumDeferredTransfers;
+    using BaseType::getDeferredTransferDropCount;
+#endif
 };
 
 }
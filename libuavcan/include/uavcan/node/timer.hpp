@@ -25,6 +25,9 @@ namespace uavcan
 {
 
 class UAVCAN_EXPORT TimerBase;
+#if !UAVCAN_TINY
+class UAVCAN_EXPORT TimerGroup;
+#endif
 
 /**
  * Objects of this type will be supplied into timer callbacks.
@@ -44,22 +47,38 @@ struct UAVCAN_EXPORT TimerEvent
  * Inherit this class if you need a timer callback method in your class.
  */
 class UAVCAN_EXPORT TimerBase : private DeadlineHandler
+#if !UAVCAN_TINY
+                              , public DoublyLinkedListNode<TimerBase>
+#endif
 {
+#if !UAVCAN_TINY
+    friend class TimerGroup;
+
+    TimerGroup* group_;
+#endif
     MonotonicDuration period_;
 
     virtual void handleDeadline(MonotonicTime current);
 
 public:
-    using DeadlineHandler::stop;
-    using DeadlineHandler::isRunning;
-    using DeadlineHandler::getDeadline;
     using DeadlineHandler::getScheduler;
+#if !UAVCAN_TINY
+    using DoublyLinkedListNode<TimerBase>::getNextListNode;   // Hides the one of the deadline handler
+    using DoublyLinkedListNode<TimerBase>::setNextListNode;
+#endif
 
     explicit TimerBase(INode& node)
         : DeadlineHandler(node.getScheduler())
+#if !UAVCAN_TINY
+        , group_(NULL)
+#endif
         , period_(MonotonicDuration::getInfinite())
     { }
 
+#if !UAVCAN_TINY
+    virtual ~TimerBase() { stop(); }
+#endif
+
     /**
      * Various ways to start the timer - periodically or once.
      * If it is running already, it will be restarted.
@@ -70,6 +89,28 @@ public:
     void startOneShotWithDelay(MonotonicDuration delay);
     void startPeriodic(MonotonicDuration period);
 
+#if !UAVCAN_TINY
+    /**
+     * Starts the timer as a member of the group, with the period of the group; see @ref TimerGroup.
+     * The first event happens with the next event of the group, which may be sooner than one period from now.
+     */
+    void startPeriodic(TimerGroup& group);
+
+    /**
+     * Returns the group this timer is a member of, or null if the timer is not in a group.
+     */
+    TimerGroup* getGroup() const { return group_; }
+#endif
+
+    void stop();
+
+    bool isRunning() const;
+
+    /**
+     * Time of the next event; for the members of a group, this is the next event of the group.
+     */
+    MonotonicTime getDeadline() const;
+
     /**
      * Returns period if the timer is in periodic mode.
      * Returns infinite duration if the timer is in one-shot mode or stopped.
@@ -132,6 +173,57 @@ public:
     void setCallback(const Callback& callback) { callback_ = callback; }
 };
 
+#if !UAVCAN_TINY
+/**
+ * Periodic timers of the same period can be combined into a group, which takes one entry in the scheduler rather
+ * than one entry per timer: the scheduler is updated once per period of the group, regardless of the number of
+ * its members. Upon every event of the group, the callbacks of all members are invoked in a row, with the same
+ * scheduled time. The group doesn't accumulate error over time, same as a periodic timer.
+ *
+ * The members join the group with @ref TimerBase::startPeriodic(TimerGroup&), and leave it when they are stopped,
+ * restarted in a different mode, or destroyed. The group is running while it has members. The callbacks can stop and
+ * start any timers, including the members of the group being dispatched.
+ *
+ * Usage example:
+ *   uavcan::TimerGroup group_100ms(node, uavcan::MonotonicDuration::fromMSec(100));
+ *   timer_a.startPeriodic(group_100ms);
+ *   timer_b.startPeriodic(group_100ms);
+ */
+class UAVCAN_EXPORT TimerGroup : private DeadlineHandler
+{
+    friend class TimerBase;
+
+    LinkedListRoot<TimerBase> members_;
+    TimerBase* next_member_;        ///< Next member to dispatch; updated by remove() if removed meanwhile
+    const MonotonicDuration period_;
+
+    virtual void handleDeadline(MonotonicTime current);
+
+    void add(TimerBase& timer);
+    void remove(TimerBase& timer);
+
+public:
+    TimerGroup(INode& node, MonotonicDuration period)
+        : DeadlineHandler(node.getScheduler())
+        , next_member_(NULL)
+        , period_(period)
+    {
+        UAVCAN_ASSERT(period < MonotonicDuration::getInfinite());
+    }
+
+    /**
+     * The members are stopped.
+     */
+    virtual ~TimerGroup();
+
+    using DeadlineHandler::isRunning;
+    using DeadlineHandler::getDeadline;
+
+    MonotonicDuration getPeriod() const { return period_; }
+
+    unsigned getNumMembers() const { return members_.getLength(); }
+};
+#endif
 
 #if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
 
@@ -0,0 +1,190 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_NODE_TX_COMPLETION_MONITOR_HPP_INCLUDED
+#define UAVCAN_NODE_TX_COMPLETION_MONITOR_HPP_INCLUDED
+
+#include <uavcan/build_config.hpp>
+#include <uavcan/error.hpp>
+#include <uavcan/node/timer.hpp>
+#include <uavcan/node/abstract_node.hpp>
+#include <uavcan/transport/dispatcher.hpp>
+#include <uavcan/util/templates.hpp>
+
+#if !defined(UAVCAN_CPP_VERSION) || !defined(UAVCAN_CPP11)
+# error UAVCAN_CPP_VERSION
+#endif
+
+#if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
+# include <functional>
+#endif
+
+#if !UAVCAN_TINY
+
+namespace uavcan
+{
+/**
+ * Outcome of a transfer tracked by @ref TxCompletionMonitor.
+ */
+struct UAVCAN_EXPORT TxCompletionEvent
+{
+    enum Status
+    {
+        StatusTransmitted,  ///< The last frame has been transmitted on every interface
+        StatusExpired       ///< Not confirmed on some interfaces by the TX deadline (plus the grace period)
+    };
+
+    Status status;
+    DataTypeID data_type_id;
+    TransferType transfer_type;
+    NodeID dst_node_id;
+    TransferID transfer_id;
+    uint8_t iface_mask;             ///< Interfaces the transfer has been transmitted on
+    MonotonicTime published_at;     ///< When the publication was requested
+    MonotonicTime tx_deadline;
+    MonotonicTime tx_mono;          ///< Driver's TX timestamp of the last frame on the last interface; zero if none
+    UtcTime tx_utc;                 ///< Same, UTC; zero if the driver doesn't support UTC timestamping
+
+    TxCompletionEvent()
+        : status(StatusExpired)
+        , transfer_type(TransferTypeMessageBroadcast)
+        , iface_mask(0)
+    { }
+
+    /**
+     * Time from the publication to the transmission; infinite if the transfer has not been transmitted.
+     */
+    MonotonicDuration getLatency() const
+    {
+        return (status == StatusTransmitted) ? (tx_mono - published_at) : MonotonicDuration::getInfinite();
+    }
+};
+
+/**
+ * Reports when the transfers published by the attached publishers have actually been transmitted, or that
+ * they have expired instead. This is based on loopback frames, so the timestamps come from the driver; the
+ * publishers set @ref CanIOFlagLoopback on their frames while attached, see
+ * @ref GenericPublisherBase::setTxCompletionMonitor().
+ *
+ * The monitor can track a limited number of transfers at a time; while all slots are occupied, the attached
+ * publishers refuse to publish with @ref ErrMemory, which can be used for closed-loop flow control.
+ * Loopback frames are listened to only while there are pending transfers.
+ *
+ * One monitor can serve several publishers. Transfers published in passive mode are not tracked.
+ */
+class UAVCAN_EXPORT TxCompletionMonitorBase : protected LoopbackFrameListenerBase, private TimerBase
+{
+public:
+    struct Entry
+    {
+        TxCompletionEvent event;
+        uint8_t pending_iface_mask;     ///< Zero if the entry is free
+
+        Entry() : pending_iface_mask(0) { }
+    };
+
+private:
+    Entry* const entries_;
+    const uint16_t capacity_;
+    uint16_t num_pending_;
+    MonotonicDuration grace_period_;
+
+    void restartTimer();
+    void complete(Entry& entry, TxCompletionEvent::Status status);      ///< Releases the entry
+
+    virtual void handleLoopbackFrame(const RxFrame& frame);
+    virtual void handleTimerEvent(const TimerEvent& event);
+
+protected:
+    TxCompletionMonitorBase(INode& node, Entry* entries, uint16_t capacity)
+        : LoopbackFrameListenerBase(node.getDispatcher())
+        , TimerBase(node)
+        , entries_(entries)
+        , capacity_(capacity)
+        , num_pending_(0)
+        , grace_period_(getDefaultGracePeriod())
+    { }
+
+    ~TxCompletionMonitorBase() { }
+
+    virtual void handleTxCompletion(const TxCompletionEvent& event) = 0;
+
+public:
+    /**
+     * Loopback frames are delivered on the next spin() after the transmission, so a transfer is not reported
+     * expired until this much time has passed since its TX deadline.
+     */
+    static MonotonicDuration getDefaultGracePeriod() { return MonotonicDuration::fromMSec(10); }
+
+    MonotonicDuration getGracePeriod() const { return grace_period_; }
+    void setGracePeriod(MonotonicDuration grace_period) { grace_period_ = grace_period; }
+
+    /**
+     * Starts tracking of a transfer; the fields of the event up to tx_deadline must be populated,
+     * and iface_mask indicates the interfaces the transfer is sent to. This is normally done by the publisher.
+     * Returns negative error code if there are no free slots. Zero mask is an invalid parameter.
+     */
+    int track(const TxCompletionEvent& event, uint8_t iface_mask);
+
+    bool hasFreeSlots() const { return num_pending_ < capacity_; }
+    unsigned getNumPendingTransfers() const { return num_pending_; }
+    unsigned getCapacity() const { return capacity_; }
+
+    /**
+     * Reports all pending transfers as expired immediately.
+     */
+    void expireAll();
+};
+
+/**
+ * @tparam MaxPendingTransfers  Number of transfers that can be tracked at the same time.
+ *
+ * @tparam Callback_            Callback type, invoked with const reference to @ref TxCompletionEvent.
+ *                              In C++11 mode this type defaults to std::function<>.
+ *                              In C++03 mode this type defaults to a plain function pointer; use binder to
+ *                              call member functions as callbacks.
+ */
+template <unsigned MaxPendingTransfers = 8,
+#if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
+          typename Callback_ = std::function<void (const TxCompletionEvent&)>
+#else
+          typename Callback_ = void (*)(const TxCompletionEvent&)
+#endif
+          >
+class UAVCAN_EXPORT TxCompletionMonitor : public TxCompletionMonitorBase
+{
+public:
+    typedef Callback_ Callback;
+
+private:
+    Entry storage_[MaxPendingTransfers];
+    Callback callback_;
+
+    virtual void handleTxCompletion(const TxCompletionEvent& event)
+    {
+        if (coerceOrFallback<bool>(callback_, true))
+        {
+            callback_(event);
+        }
+    }
+
+public:
+    explicit TxCompletionMonitor(INode& node, const Callback& callback = Callback())
+        : TxCompletionMonitorBase(node, storage_, MaxPendingTransfers)
+        , callback_(callback)
+    {
+        StaticAssert<(MaxPendingTransfers > 0) && (MaxPendingTransfers <= 0xFFFFU)>::check();
+    }
+
+    ~TxCompletionMonitor() { stopListening(); }
+
+    const Callback& getCallback() const { return callback_; }
+    void setCallback(const Callback& cb) { callback_ = cb; }
+};
+
+}
+
+#endif // !UAVCAN_TINY
+
+#endif // UAVCAN_NODE_TX_COMPLETION_MONITOR_HPP_INCLUDED
@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_NODE_VIEW_SUBSCRIBER_HPP_INCLUDED
+#define UAVCAN_NODE_VIEW_SUBSCRIBER_HPP_INCLUDED
+
+#include <uavcan/build_config.hpp>
+#include <uavcan/node/raw_subscriber.hpp>
+#include <uavcan/util/method_binder.hpp>
+
+#if !defined(UAVCAN_CPP_VERSION) || !defined(UAVCAN_CPP11)
+# error UAVCAN_CPP_VERSION
+#endif
+
+#if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
+# include <functional>
+#endif
+
+namespace uavcan
+{
+/**
+ * Use this class instead of @ref Subscriber to receive messages without decoding them completely; the callback
+ * receives the generated read-only view of the message (DataType::View, see @ref PayloadView), which extracts
+ * the fields from the payload on demand. This is useful for large messages of which only a few fields are needed.
+ *
+ * The view refers to the reassembled payload directly if the transfer buffer is contiguous; otherwise the payload
+ * is copied into the internal buffer of the subscriber first. Both the view and the transfer object are valid only
+ * until the callback returns.
+ *
+ * @tparam DataType_        Message data type.
+ *
+ * @tparam Callback_        Type of the callback, invoked with a const reference to DataType::View and
+ *                          a reference to @ref IncomingTransfer, which provides the transfer metadata.
+ *                          In C++11 mode this type defaults to std::function<>.
+ *                          In C++03 mode this type defaults to a plain function pointer; use binder to
+ *                          call member functions as callbacks.
+ *
+ * @tparam TransferListener_ Transfer listener implementation used by the transport layer,
+ *                          see @ref Subscriber.
+ */
+template <typename DataType_,
+#if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
+          typename Callback_ = std::function<void (const typename DataType_::View&, IncomingTransfer&)>,
+#else
+          typename Callback_ = void (*)(const typename DataType_::View&, IncomingTransfer&),
+#endif
+          typename TransferListener_ = TransferListener
+          >
+class UAVCAN_EXPORT ViewSubscriber : Noncopyable
+{
+public:
+    typedef DataType_ DataType;
+    typedef Callback_ Callback;
+    typedef typename DataType::View View;
+
+private:
+    typedef ViewSubscriber<DataType_, Callback_, TransferListener_> SelfType;
+    typedef MethodBinder<SelfType*, void (SelfType::*)(IncomingTransfer&)> TransferCallback;
+    typedef RawSubscriber<DataType_, TransferCallback, TransferListener_> RawSubscriberType;
+
+    enum { BufferSize = (RawSubscriberType::MaxPayloadLen > 0) ? RawSubscriberType::MaxPayloadLen : 1 };
+
+    RawSubscriberType raw_;
+    Callback callback_;
+    uint8_t buffer_[BufferSize];      ///< Used only for non-contiguous transfer buffers
+
+    void handleTransfer(IncomingTransfer& transfer)
+    {
+        unsigned len = 0;
+        const uint8_t* data = transfer.getContiguousData(len);
+        if (data == NULL)
+        {
+            const int res = transfer.read(0, buffer_, unsigned(BufferSize));
+            if (res < 0)
+            {
+                UAVCAN_TRACE("ViewSubscriber", "Failed to read the payload: %i", res);
+                return;
+            }
+            data = buffer_;
+            len = unsigned(res);
+        }
+        const View view(data, len);
+        callback_(view, transfer);
+    }
+
+public:
+    explicit ViewSubscriber(INode& node)
+        : raw_(node)
+        , callback_()
+    { }
+
+    /**
+     * Begin receiving messages.
+     * Each message will be passed to the application via the callback.
+     * Returns negative error code.
+     */
+    int start(const Callback& callback)
+    {
+        stop();
+
+        if (!coerceOrFallback<bool>(callback, true))
+        {
+            UAVCAN_TRACE("ViewSubscriber", "Invalid callback");
+            return -ErrInvalidParam;
+        }
+        callback_ = callback;
+
+        return raw_.start(TransferCallback(this, &SelfType::handleTransfer));
+    }
+
+    /**
+     * See @ref Subscriber.
+     */
+    void allowAnonymousTransfers() { raw_.allowAnonymousTransfers(); }
+
+    /**
+     * See @ref RawSubscriber::setDecimation().
+     */
+    int setDecimation(uint8_t factor, MonotonicDuration min_interval = MonotonicDuration())
+    {
+        return raw_.setDecimation(factor, min_interval);
+    }
+
+    /**
+     * See @ref RawSubscriber::setOnChangeMode().
+     */
+    int setOnChangeMode(bool enabled, MonotonicDuration heartbeat = MonotonicDuration())
+    {
+        return raw_.setOnChangeMode(enabled, heartbeat);
+    }
+
+    uint32_t getNumSkippedTransfers() const { return raw_.getNumSkippedTransfers(); }
+
+    /**
+     * Terminate the subscription.
+     */
+    void stop() { raw_.stop(); }
+
+    INode& getNode() const { return raw_.getNode(); }
+};
+
+}
+
+#endif // UAVCAN_NODE_VIEW_SUBSCRIBER_HPP_INCLUDED
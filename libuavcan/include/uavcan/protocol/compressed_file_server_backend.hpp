@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_PROTOCOL_COMPRESSED_FILE_SERVER_BACKEND_HPP_INCLUDED
+#define UAVCAN_PROTOCOL_COMPRESSED_FILE_SERVER_BACKEND_HPP_INCLUDED
+
+#include <uavcan/build_config.hpp>
+#include <uavcan/util/lzss.hpp>
+#include <uavcan/protocol/derived_file_server_backend.hpp>
+
+namespace uavcan
+{
+/**
+ * Adds compressed versions of the files to another file server backend, so that the nodes that can decompress
+ * firmware images download them in fewer uavcan.protocol.file.Read requests, which reduces both the update time
+ * and the bus load by the compression ratio.
+ *
+ * The compressed version of a file is available under the path of the file with the suffix
+ * @ref getCompressedPathSuffix() appended; its format is described in @ref LzssCompressor. Refer to
+ * @ref DerivedFileServerBackend for the caching policy; the cache is normally large enough for one firmware image,
+ * which is then compressed once for all nodes. If the compressed image does not fit the cache, the request fails
+ * with FILE_TOO_LARGE and the node falls back to the original image.
+ *
+ * There is no capability negotiation at the protocol level, so it is done by the nodes as follows: a node that
+ * supports compressed images requests uavcan.protocol.file.GetInfo for the compressed path first; if that succeeds,
+ * it reads the compressed image and feeds the chunks to @ref LzssDecompressor, otherwise it reads the original
+ * image. Therefore neither @ref FirmwareUpdateTrigger nor the nodes that don't support compression are affected.
+ *
+ * Note that the object contains @ref LzssCompressor, which is about 40 KB.
+ */
+class UAVCAN_EXPORT CompressedFileServerBackend : public DerivedFileServerBackend
+{
+    class CacheWriter : public ILzssOutput
+    {
+        CompressedFileServerBackend& owner_;
+
+    public:
+        explicit CacheWriter(CompressedFileServerBackend& owner) : owner_(owner) { }
+
+        virtual int write(const uint8_t* data, unsigned size) { return owner_.appendToCache(data, size); }
+    };
+
+    CacheWriter writer_;
+    LzssCompressor compressor_;
+    const uint8_t window_log2_;
+
+    virtual int beginDerivedFile(uint32_t source_size)
+    {
+        return compressor_.begin(source_size, writer_, window_log2_);
+    }
+
+    virtual int processSourceChunk(const uint8_t* data, unsigned size) { return compressor_.feed(data, size); }
+
+    virtual int endDerivedFile() { return compressor_.isFinished() ? 0 : -ErrLogic; }
+
+public:
+    /**
+     * @param backend       Backend that provides the original files.
+     * @param cache         Buffer for the compressed image; its size limits the size of the images that can be served.
+     * @param cache_size    Size of the buffer in bytes.
+     * @param window_log2   LZSS window of the compressed images; the nodes must have a decompressor with a window
+     *                      that is not smaller than this. Refer to @ref LzssCompressor.
+     */
+    CompressedFileServerBackend(IFileServerBackend& backend, uint8_t* cache, uint32_t cache_size,
+                                uint8_t window_log2 = LzssMaxWindowLog2)
+        : DerivedFileServerBackend(backend, getCompressedPathSuffix(), cache, cache_size)
+        , writer_(*this)
+        , window_log2_(uint8_t(max(unsigned(LzssMinWindowLog2), min(unsigned(window_log2), LzssMaxWindowLog2))))
+    { }
+
+    /**
+     * The nodes append this suffix to the path of a file in order to request its compressed version.
+     */
+    static const char* getCompressedPathSuffix() { return ".lzss"; }
+
+    /**
+     * Returns the path of the compressed version of the file, or an empty path if it would be too long.
+     */
+    static Path makeCompressedPath(const Path& path) { return makeDerivedPath(path, getCompressedPathSuffix()); }
+};
+
+}
+
+#endif // Include guard
@@ -0,0 +1,286 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_PROTOCOL_DERIVED_FILE_SERVER_BACKEND_HPP_INCLUDED
+#define UAVCAN_PROTOCOL_DERIVED_FILE_SERVER_BACKEND_HPP_INCLUDED
+
+#include <uavcan/build_config.hpp>
+#include <uavcan/debug.hpp>
+#include <uavcan/protocol/file_server.hpp>
+
+namespace uavcan
+{
+/**
+ * Base for the backends that add derived versions of the files of another backend, e.g. compressed ones.
+ * The derived version of a file is available under the path of the file with a suffix appended; every other path
+ * is forwarded to the underlying backend as is. The derived files are read-only.
+ *
+ * The derived file is produced on the first request and cached in the buffer provided by the application, so that
+ * it can be served to many nodes without producing it again. The cache is revalidated upon every GetInfo request
+ * for the derived path: if the size of the original file has changed, the derived file is produced again. Write
+ * and Delete of the original file invalidate the cache as well. If the derived file does not fit the buffer, the
+ * request fails with FILE_TOO_LARGE.
+ *
+ * The derived class produces the file from the chunks of the original one, which are read in order.
+ */
+class UAVCAN_EXPORT DerivedFileServerBackend : public IFileServerBackend
+{
+    IFileServerBackend& backend_;
+    const char* const suffix_;
+    Path cached_path_;                  ///< Of the original file; empty if the cache is invalid
+    uint64_t cached_source_size_;
+    uint8_t* const cache_;
+    const uint32_t cache_capacity_;
+    uint32_t cache_size_;
+
+    bool splitDerivedPath(const Path& path, Path& out_original_path) const
+    {
+        const unsigned suffix_len = unsigned(std::strlen(suffix_));
+        if ((path.size() <= suffix_len) ||
+            !equal(path.begin() + (path.size() - suffix_len), path.end(), suffix_))
+        {
+            return false;
+        }
+        out_original_path.clear();
+        for (Path::SizeType i = 0; i < (path.size() - suffix_len); i++)
+        {
+            out_original_path.push_back(path[i]);
+        }
+        return true;
+    }
+
+    int16_t produce(const Path& path, uint64_t source_size)
+    {
+        invalidateCache();
+        if (source_size > NumericTraits<uint32_t>::max())
+        {
+            return Error::FILE_TOO_LARGE;
+        }
+
+        int res = beginDerivedFile(uint32_t(source_size));
+
+        uint8_t buffer[ReadSize];
+        uint32_t offset = 0;
+        while ((res >= 0) && (offset < source_size))
+        {
+            uint16_t size = ReadSize;
+            const int16_t read_res = backend_.read(path, offset, buffer, size);
+            if (read_res != Error::OK)
+            {
+                invalidateCache();
+                return read_res;
+            }
+            if ((size == 0) || (size > ReadSize) || (size > (source_size - offset)))
+            {
+                invalidateCache();
+                return Error::IO_ERROR;             // The file has been changed while being read
+            }
+            res = processSourceChunk(buffer, size);
+            offset += size;
+        }
+
+        if (res >= 0)
+        {
+            res = endDerivedFile();
+        }
+        if (res < 0)
+        {
+            UAVCAN_TRACE("DerivedFileServerBackend", "Failed to produce %s%s, error %i", path.c_str(), suffix_, res);
+            invalidateCache();
+            return (res == -ErrMemory) ? int16_t(Error::FILE_TOO_LARGE) : int16_t(Error::UNKNOWN_ERROR);
+        }
+
+        cached_path_ = path;
+        cached_source_size_ = source_size;
+        UAVCAN_TRACE("DerivedFileServerBackend", "%s%s produced, %u bytes from %u", path.c_str(), suffix_,
+                     unsigned(cache_size_), unsigned(source_size));
+        return Error::OK;
+    }
+
+    void invalidateCacheIfMatches(const Path& path)
+    {
+        if (path == cached_path_)
+        {
+            invalidateCache();
+        }
+    }
+
+protected:
+    /**
+     * @param backend       Backend that provides the original files.
+     * @param suffix        Suffix of the derived paths; the string must be static.
+     * @param cache         Buffer for the derived file; its size limits the size of the files that can be served.
+     * @param cache_size    Size of the buffer in bytes.
+     */
+    DerivedFileServerBackend(IFileServerBackend& backend, const char* suffix, uint8_t* cache, uint32_t cache_size)
+        : backend_(backend)
+        , suffix_(suffix)
+        , cached_source_size_(0)
+        , cache_(cache)
+        , cache_capacity_((cache == NULL) ? 0U : cache_size)
+        , cache_size_(0)
+    {
+        UAVCAN_ASSERT((suffix_ != NULL) && (suffix_[0] != '\0'));
+    }
+
+    /**
+     * These methods produce the derived file from the original one of the specified size, whose contents are
+     * passed to @ref processSourceChunk() in order. The output must be written via @ref appendToCache().
+     * They return negative error code; -ErrMemory is reported to the clients as FILE_TOO_LARGE.
+     * @{
+     */
+    virtual int beginDerivedFile(uint32_t source_size) = 0;
+    virtual int processSourceChunk(const uint8_t* data, unsigned size) = 0;
+    virtual int endDerivedFile() = 0;
+    /**
+     * @}
+     */
+
+    /**
+     * Returns -ErrMemory if the buffer is full.
+     */
+    int appendToCache(const uint8_t* data, unsigned size)
+    {
+        if (size > (cache_capacity_ - cache_size_))
+        {
+            return -ErrMemory;
+        }
+        copy(data, data + size, cache_ + cache_size_);
+        cache_size_ += size;
+        return 0;
+    }
+
+public:
+    /**
+     * Returns the path with the suffix appended, or an empty path if it would be too long.
+     */
+    static Path makeDerivedPath(const Path& path, const char* suffix)
+    {
+        Path out;
+        if ((path.size() + std::strlen(suffix)) <= path.capacity())
+        {
+            out = path;
+            out += suffix;
+        }
+        return out;
+    }
+
+    /**
+     * Drops the cached file; the next request for a derived file will produce it again.
+     */
+    void invalidateCache()
+    {
+        cached_path_.clear();
+        cached_source_size_ = 0;
+        cache_size_ = 0;
+    }
+
+    /**
+     * Path of the original file whose derived version is cached; empty if none.
+     */
+    const Path& getCachedPath() const { return cached_path_; }
+
+    uint32_t getCachedFileSize() const { return cache_size_; }
+
+    virtual int16_t getInfo(const Path& path, uint64_t& out_size, EntryType& out_type)
+    {
+        Path original_path;
+        if (!splitDerivedPath(path, original_path))
+        {
+            return backend_.getInfo(path, out_size, out_type);
+        }
+
+        uint64_t source_size = 0;
+        const int16_t res = backend_.getInfo(original_path, source_size, out_type);
+        if (res != Error::OK)
+        {
+            return res;
+        }
+        if ((out_type.flags & EntryType::FLAG_FILE) == 0)
+        {
+            return Error::NOT_FOUND;                // Directories have no derived versions
+        }
+
+        if ((original_path != cached_path_) || (source_size != cached_source_size_))
+        {
+            const int16_t produce_res = produce(original_path, source_size);
+            if (produce_res != Error::OK)
+            {
+                return produce_res;
+            }
+        }
+
+        out_size = cache_size_;
+        out_type.flags = uint8_t(out_type.flags & ~unsigned(EntryType::FLAG_WRITEABLE));
+        return Error::OK;
+    }
+
+    virtual int16_t read(const Path& path, const uint64_t offset, uint8_t* out_buffer, uint16_t& inout_size)
+    {
+        Path original_path;
+        if (!splitDerivedPath(path, original_path))
+        {
+            return backend_.read(path, offset, out_buffer, inout_size);
+        }
+
+        if (original_path != cached_path_)          // The file has not been requested via GetInfo yet
+        {
+            uint64_t source_size = 0;
+            EntryType type;
+            int16_t res = backend_.getInfo(original_path, source_size, type);
+            if (res == Error::OK)
+            {
+                res = produce(original_path, source_size);
+            }
+            if (res != Error::OK)
+            {
+                return res;
+            }
+        }
+
+        if (offset >= cache_size_)
+        {
+            inout_size = 0;
+        }
+        else
+        {
+            const uint32_t cache_offset = uint32_t(offset);
+            inout_size = uint16_t(min(uint32_t(inout_size), cache_size_ - cache_offset));
+            copy(cache_ + cache_offset, cache_ + cache_offset + inout_size, out_buffer);
+        }
+        return Error::OK;
+    }
+
+    virtual int16_t write(const Path& path, const uint64_t offset, const uint8_t* buffer, const uint16_t size)
+    {
+        Path original_path;
+        if (splitDerivedPath(path, original_path))
+        {
+            return Error::ACCESS_DENIED;
+        }
+        invalidateCacheIfMatches(path);
+        return backend_.write(path, offset, buffer, size);
+    }
+
+    virtual int16_t remove(const Path& path)
+    {
+        Path original_path;
+        if (splitDerivedPath(path, original_path))
+        {
+            return Error::ACCESS_DENIED;
+        }
+        invalidateCacheIfMatches(path);
+        return backend_.remove(path);
+    }
+
+    virtual int16_t getDirectoryEntryInfo(const Path& directory_path, const uint32_t entry_index,
+                                          EntryType& out_type, Path& out_entry_full_path)
+    {
+        return backend_.getDirectoryEntryInfo(directory_path, entry_index, out_type, out_entry_full_path);
+    }
+};
+
+}
+
+#endif // Include guard
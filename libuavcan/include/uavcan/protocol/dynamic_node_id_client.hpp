@@ -24,6 +24,11 @@ namespace uavcan
  * If the local node is equipped with redundant CAN interfaces, all of them will be used for publishing requests
  * and listening for responses.
  *
+ * The time to allocation is dominated by the randomized delays required by the specification. Where the bus is
+ * known to be quiet, e.g. the nodes are powered up one at a time, the delays can be shortened; refer to
+ * @ref setMaxFollowupDelay() and @ref setImmediateFirstRequest(). With CAN FD, the unique ID is delivered in two
+ * stages instead of three; refer to @ref setCanFDRequestsEnabled().
+ *
  * Once dynamic allocation is complete (or not needed anymore), the object can be deleted.
  *
  * Note that this class uses std::rand(), which must be correctly seeded before use.
@@ -52,8 +57,14 @@ class UAVCAN_EXPORT DynamicNodeIDClient : private TimerBase
     NodeID allocated_node_id_;
     NodeID allocator_node_id_;
 
+    MonotonicDuration max_followup_delay_;
+    bool immediate_first_request_;
+    bool can_fd_requests_enabled_;
+
     void terminate();
 
+    uint8_t getMaxUniqueIDBytesPerRequest() const;
+
     static MonotonicDuration getRandomDuration(uint32_t lower_bound_msec, uint32_t upper_bound_msec);
 
     void restartTimer(const Mode mode);
@@ -70,6 +81,9 @@ public:
         , dnida_pub_(node)
         , dnida_sub_(node)
         , size_of_received_unique_id_(0)
+        , max_followup_delay_(MonotonicDuration::fromMSec(protocol::dynamic_node_id::Allocation::MAX_FOLLOWUP_DELAY_MS))
+        , immediate_first_request_(false)
+        , can_fd_requests_enabled_(UAVCAN_CAN_FD != 0)
     { }
 
     /**
@@ -85,6 +99,31 @@ public:
               const NodeID preferred_node_id = NodeID::Broadcast,
               const TransferPriority transfer_priority = TransferPriority::OneHigherThanLowest);
 
+    /**
+     * The follow-up requests are published after a random delay, so that the clients that received the same
+     * follow-up response don't collide. On a quiet bus the delay can be reduced down to zero, in which case the
+     * follow-up requests are published at once. The value is limited by MAX_FOLLOWUP_DELAY_MS, which is default.
+     */
+    void setMaxFollowupDelay(MonotonicDuration delay);
+    MonotonicDuration getMaxFollowupDelay() const { return max_followup_delay_; }
+
+    /**
+     * If enabled, the first request is published right after @ref start() rather than after a random time slot.
+     * Meant for quiet buses too; the following requests, if the first one fails, are published at the normal rate.
+     * Disabled by default.
+     */
+    void setImmediateFirstRequest(bool enabled) { immediate_first_request_ = enabled; }
+    bool isImmediateFirstRequestEnabled() const { return immediate_first_request_; }
+
+    /**
+     * With CAN FD, a request carries as much of the unique ID as fits one frame, 14 bytes instead of 6, so the
+     * exchange takes two stages instead of three. All allocators on the bus must support that, which is the case
+     * for the ones that are built with CAN FD support.
+     * Enabled by default if the library is built with UAVCAN_CAN_FD; has no effect otherwise.
+     */
+    void setCanFDRequestsEnabled(bool enabled) { can_fd_requests_enabled_ = enabled; }
+    bool areCanFDRequestsEnabled() const { return can_fd_requests_enabled_; }
+
     /**
      * Use this method to determine when allocation is complete.
      */
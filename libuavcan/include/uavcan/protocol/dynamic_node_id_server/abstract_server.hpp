@@ -102,6 +102,12 @@ public:
         return true;
     }
 
+    /**
+     * Shares the node info retrieved by the application with the node discoverer, so that the nodes are not
+     * queried twice. Refer to @ref NodeDiscoverer::setNodeInfoRetriever().
+     */
+    int setNodeInfoRetriever(NodeInfoRetriever* retriever) { return node_discoverer_.setNodeInfoRetriever(retriever); }
+
     /**
      * This is useful for debugging/testing/monitoring.
      */
@@ -40,70 +40,80 @@ public:
 
 /**
  * This class manages communication with allocation clients.
- * Three-stage unique ID exchange is implemented here, as well as response publication.
+ * Multi-stage unique ID exchange is implemented here, as well as response publication.
+ *
+ * The stages are not required to be of any particular size: classic CAN clients deliver the unique ID in three
+ * stages (6, 6 and 4 bytes), whereas CAN FD clients fit more of it into one frame and need fewer stages.
+ * The first stage is marked by the first_part_of_unique_id flag; every following stage must continue the unique ID
+ * that was echoed in the last follow-up response.
+ *
+ * Only one exchange can be in progress at a time, because the follow-up responses are broadcast. First stage
+ * requests that arrive while an exchange is in progress are queued rather than dropped. When the exchange is
+ * completed or timed out, the follow-up response for the oldest queued request is published at once; the client
+ * that sent it recognizes its unique ID and continues the exchange without having to win another time slot.
+ * This keeps the allocator busy when many nodes request allocation at the same time, e.g. at power-on.
  */
 class AllocationRequestManager
 {
+public:
+    /**
+     * Maximum number of first stage requests that can wait while another exchange is in progress.
+     */
+    enum { MaxQueuedFirstStageRequests = 8 };
+
+private:
     typedef MethodBinder<AllocationRequestManager*,
                          void (AllocationRequestManager::*)(const ReceivedDataStructure<Allocation>&)>
         AllocationCallback;
 
+    struct QueuedFirstStageRequest
+    {
+        Allocation::FieldTypes::unique_id unique_id;
+        MonotonicTime timestamp;
+    };
+
     const MonotonicDuration stage_timeout_;
 
     MonotonicTime last_message_timestamp_;
     MonotonicTime last_activity_timestamp_;
     Allocation::FieldTypes::unique_id current_unique_id_;
 
+    QueuedFirstStageRequest queued_requests_[MaxQueuedFirstStageRequests];
+    uint8_t num_queued_requests_;
+
     IAllocationRequestHandler& handler_;
     IEventTracer& tracer_;
 
     Subscriber<Allocation, AllocationCallback> allocation_sub_;
     Publisher<Allocation> allocation_pub_;
 
-    enum { InvalidStage = 0 };
+    enum
+    {
+        InvalidStage,
+        FirstStage,
+        FollowingStage
+    };
 
     void trace(TraceCode code, int64_t argument) { tracer_.onEvent(code, argument); }
 
     static uint8_t detectRequestStage(const Allocation& msg)
     {
-        const uint8_t max_bytes_per_request = Allocation::MAX_LENGTH_OF_UNIQUE_ID_IN_REQUEST;
-
-        if ((msg.unique_id.size() != max_bytes_per_request) &&
-            (msg.unique_id.size() != (msg.unique_id.capacity() - max_bytes_per_request * 2U)) &&
-            (msg.unique_id.size() != msg.unique_id.capacity()))     // Future proofness for CAN FD
+        if (msg.unique_id.empty())
         {
             return InvalidStage;
         }
-        if (msg.first_part_of_unique_id)
-        {
-            return 1;       // Note that CAN FD frames can deliver the unique ID in one stage!
-        }
-        if (msg.unique_id.size() == Allocation::MAX_LENGTH_OF_UNIQUE_ID_IN_REQUEST)
-        {
-            return 2;
-        }
-        if (msg.unique_id.size() < Allocation::MAX_LENGTH_OF_UNIQUE_ID_IN_REQUEST)
-        {
-            return 3;
-        }
-        return InvalidStage;
+        // Note that CAN FD frames can deliver the unique ID in fewer stages, or even in one
+        return msg.first_part_of_unique_id ? FirstStage : FollowingStage;
     }
 
     uint8_t getExpectedStage() const
     {
-        if (current_unique_id_.empty())
-        {
-            return 1;
-        }
-        if (current_unique_id_.size() >= (Allocation::MAX_LENGTH_OF_UNIQUE_ID_IN_REQUEST * 2))
-        {
-            return 3;
-        }
-        if (current_unique_id_.size() >= Allocation::MAX_LENGTH_OF_UNIQUE_ID_IN_REQUEST)
-        {
-            return 2;
-        }
-        return InvalidStage;
+        return current_unique_id_.empty() ? FirstStage : FollowingStage;
+    }
+
+    static bool isPartialFirstStageRequest(const Allocation& msg)
+    {
+        return (detectRequestStage(msg) == FirstStage) && (msg.unique_id.size() < msg.unique_id.capacity());
     }
 
     void publishFollowupAllocationResponse()
@@ -125,6 +135,83 @@ class AllocationRequestManager
         }
     }
 
+    /**
+     * Requests that were not repeated for this long are considered abandoned, e.g. because the client was
+     * allocated by another server or restarted.
+     */
+    static MonotonicDuration getQueuedRequestTimeout()
+    {
+        return MonotonicDuration::fromMSec(Allocation::MAX_REQUEST_PERIOD_MS * 3);
+    }
+
+    void queueFirstStageRequest(const Allocation& msg, MonotonicTime timestamp)
+    {
+        for (uint8_t i = 0; i < num_queued_requests_; i++)
+        {
+            if (queued_requests_[i].unique_id == msg.unique_id)
+            {
+                queued_requests_[i].timestamp = timestamp;      // Keeping the place in the queue
+                return;
+            }
+        }
+        if (num_queued_requests_ < MaxQueuedFirstStageRequests)
+        {
+            queued_requests_[num_queued_requests_].unique_id = msg.unique_id;
+            queued_requests_[num_queued_requests_].timestamp = timestamp;
+            num_queued_requests_++;
+            trace(TraceAllocationRequestQueued, num_queued_requests_);
+        }
+    }
+
+    void removeQueuedRequestsMatching(const UniqueID& unique_id)
+    {
+        uint8_t num_kept = 0;
+        for (uint8_t i = 0; i < num_queued_requests_; i++)
+        {
+            if (!equal(queued_requests_[i].unique_id.begin(), queued_requests_[i].unique_id.end(), unique_id.begin()))
+            {
+                queued_requests_[num_kept++] = queued_requests_[i];
+            }
+        }
+        num_queued_requests_ = num_kept;
+    }
+
+    /**
+     * Starts the exchange with the oldest queued client. Returns true if started.
+     */
+    bool startQueuedExchange(MonotonicTime timestamp)
+    {
+        UAVCAN_ASSERT(current_unique_id_.empty());
+        while (num_queued_requests_ > 0)
+        {
+            const QueuedFirstStageRequest request = queued_requests_[0];
+            num_queued_requests_--;
+            for (uint8_t i = 0; i < num_queued_requests_; i++)
+            {
+                queued_requests_[i] = queued_requests_[i + 1];
+            }
+
+            if ((timestamp - request.timestamp) > getQueuedRequestTimeout())
+            {
+                continue;
+            }
+
+            if (!handler_.canPublishFollowupAllocationResponse())
+            {
+                trace(TraceAllocationFollowupDenied, 0);
+                num_queued_requests_ = 0;
+                return false;
+            }
+
+            current_unique_id_ = request.unique_id;
+            trace(TraceAllocationRequestAccepted, current_unique_id_.size());
+            publishFollowupAllocationResponse();
+            last_message_timestamp_ = timestamp;
+            return true;
+        }
+        return false;
+    }
+
     void handleAllocation(const ReceivedDataStructure<Allocation>& msg)
     {
         trace(TraceAllocationActivity, msg.getSrcNodeID().get());
@@ -143,6 +230,21 @@ class AllocationRequestManager
             UAVCAN_TRACE("AllocationRequestManager", "Stage timeout, reset");
             current_unique_id_.clear();
             trace(TraceAllocationFollowupTimeout, (msg.getMonotonicTimestamp() - last_message_timestamp_).toUSec());
+
+            /*
+             * The queued clients are served first, the new request, if any, waits in the queue
+             */
+            if (num_queued_requests_ > 0)
+            {
+                if (isPartialFirstStageRequest(msg))
+                {
+                    queueFirstStageRequest(msg, msg.getMonotonicTimestamp());
+                }
+                if (startQueuedExchange(msg.getMonotonicTimestamp()))
+                {
+                    return;
+                }
+            }
         }
 
         /*
@@ -155,16 +257,13 @@ class AllocationRequestManager
             return;             // Malformed request - ignore without resetting
         }
 
-        const uint8_t expected_stage = getExpectedStage();
-        if (expected_stage == InvalidStage)
-        {
-            UAVCAN_ASSERT(0);
-            return;
-        }
-
-        if (request_stage != expected_stage)
+        if (request_stage != getExpectedStage())
         {
             trace(TraceAllocationUnexpectedStage, request_stage);
+            if (isPartialFirstStageRequest(msg))
+            {
+                queueFirstStageRequest(msg, msg.getMonotonicTimestamp());   // Will be served later
+            }
             return;             // Ignore - stage mismatch
         }
 
@@ -210,6 +309,12 @@ class AllocationRequestManager
             }
 
             handler_.handleAllocationRequest(unique_id, msg.node_id);
+
+            removeQueuedRequestsMatching(unique_id);
+            if (startQueuedExchange(msg.getMonotonicTimestamp()))
+            {
+                return;
+            }
         }
         else
         {
@@ -233,6 +338,7 @@ class AllocationRequestManager
 public:
     AllocationRequestManager(INode& node, IEventTracer& tracer, IAllocationRequestHandler& handler)
         : stage_timeout_(MonotonicDuration::fromMSec(Allocation::FOLLOWUP_TIMEOUT_MS))
+        , num_queued_requests_(0)
         , handler_(handler)
         , tracer_(tracer)
         , allocation_sub_(node)
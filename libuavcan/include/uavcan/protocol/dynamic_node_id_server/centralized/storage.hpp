@@ -62,6 +62,40 @@ class Storage
         return array;
     }
 
+    int writeToStorage(const NodeID node_id, const UniqueID& unique_id, const OccupationMask& new_occupation_mask)
+    {
+        StorageMarshaller io(storage_);
+
+        // If next operations fail, we'll get a dangling entry, but it's absolutely OK.
+        {
+            uint32_t node_id_int = node_id.get();
+            int res = io.setAndGetBack(StorageMarshaller::convertUniqueIDToHex(unique_id), node_id_int);
+            if (res < 0)
+            {
+                return res;
+            }
+            if (node_id_int != node_id.get())
+            {
+                return -ErrFailure;
+            }
+        }
+
+        // Updating the mask in the storage
+        OccupationMaskArray occupation_array = maskToArray(new_occupation_mask);
+
+        int res = io.setAndGetBack(getOccupationMaskKey(), occupation_array);
+        if (res < 0)
+        {
+            return res;
+        }
+        if (occupation_array != maskToArray(new_occupation_mask))
+        {
+            return -ErrFailure;
+        }
+
+        return 0;
+    }
+
 public:
     Storage(IStorageBackend& storage) :
         storage_(storage)
@@ -82,6 +116,7 @@ public:
     /**
      * This method invokes storage IO.
      * Returned value indicates whether the entry was successfully appended.
+     * Both values are written as one storage batch.
      */
     int add(const NodeID node_id, const UniqueID& unique_id)
     {
@@ -90,35 +125,19 @@ public:
             return -ErrInvalidParam;
         }
 
-        StorageMarshaller io(storage_);
-
-        // If next operations fail, we'll get a dangling entry, but it's absolutely OK.
-        {
-            uint32_t node_id_int = node_id.get();
-            int res = io.setAndGetBack(StorageMarshaller::convertUniqueIDToHex(unique_id), node_id_int);
-            if (res < 0)
-            {
-                return res;
-            }
-            if (node_id_int != node_id.get())
-            {
-                return -ErrFailure;
-            }
-        }
-
-        // Updating the mask in the storage
         OccupationMask new_occupation_mask = occupation_mask_;
         new_occupation_mask[node_id.get()] = true;
-        OccupationMaskArray occupation_array = maskToArray(new_occupation_mask);
 
-        int res = io.setAndGetBack(getOccupationMaskKey(), occupation_array);
+        storage_.beginBatch();
+        const int res = writeToStorage(node_id, unique_id, new_occupation_mask);
+        const int commit_res = storage_.commitBatch();
         if (res < 0)
         {
             return res;
         }
-        if (occupation_array != maskToArray(new_occupation_mask))
+        if (commit_res < 0)
         {
-            return -ErrFailure;
+            return commit_res;
         }
 
         // Updating the cached mask only if the storage was updated successfully
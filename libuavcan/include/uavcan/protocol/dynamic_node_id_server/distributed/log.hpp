@@ -10,6 +10,7 @@
 #include <uavcan/protocol/dynamic_node_id_server/distributed/types.hpp>
 #include <uavcan/protocol/dynamic_node_id_server/storage_marshaller.hpp>
 #include <uavcan/protocol/dynamic_node_id_server/event.hpp>
+#include <uavcan/util/templates.hpp>
 
 namespace uavcan
 {
@@ -35,6 +36,51 @@ private:
     Entry entries_[Capacity];
     Index last_index_;             // Index zero always contains an empty entry
 
+    /*
+     * In-memory lookup tables that make the searches independent of the log length.
+     * They are rebuilt when the log is restored or truncated and updated incrementally upon append.
+     * If several entries share the same key, the one with the highest index is referenced.
+     */
+    enum { InvalidIndex = 0xFF };
+    enum { UniqueIDHashTableSize = Capacity * 2 };     ///< Must be a power of two; load factor is at most 1/2
+
+    Index node_id_index_[NodeID::Max + 1];                  ///< Node ID --> entry index
+    Index unique_id_hash_table_[UniqueIDHashTableSize];     ///< Open addressing with linear probing
+
+    static unsigned hashUniqueID(const UniqueID& unique_id)
+    {
+        uint32_t hash = 2166136261U;                        // FNV-1a
+        for (uint8_t i = 0; i < unique_id.size(); i++)
+        {
+            hash = (hash ^ unique_id[i]) * 16777619U;
+        }
+        return unsigned(hash ^ (hash >> 16)) & (UniqueIDHashTableSize - 1U);
+    }
+
+    void indexEntry(Index index)
+    {
+        const Entry& entry = entries_[index];
+        node_id_index_[entry.node_id] = index;
+
+        unsigned slot = hashUniqueID(entry.unique_id);
+        while ((unique_id_hash_table_[slot] != InvalidIndex) &&
+               (entries_[unique_id_hash_table_[slot]].unique_id != entry.unique_id))
+        {
+            slot = (slot + 1U) & (UniqueIDHashTableSize - 1U);
+        }
+        unique_id_hash_table_[slot] = index;
+    }
+
+    void rebuildIndex()
+    {
+        fill(node_id_index_, node_id_index_ + NodeID::Max + 1, Index(InvalidIndex));
+        fill(unique_id_hash_table_, unique_id_hash_table_ + UniqueIDHashTableSize, Index(InvalidIndex));
+        for (unsigned index = 0; index <= last_index_; index++)
+        {
+            indexEntry(Index(index));
+        }
+    }
+
     static IStorageBackend::String getLastIndexKey() { return "log_last_index"; }
 
     static IStorageBackend::String makeEntryKey(Index index, const char* postfix)
@@ -108,6 +154,18 @@ private:
         return (temp == entry) ? 0 : -ErrFailure;
     }
 
+    int writeEntryAndLastIndexToStorage(Index index, const Entry& entry, uint32_t& inout_last_index)
+    {
+        // If the last index could not be updated, we'll get a dangling entry, but it's absolutely OK.
+        const int res = writeEntryToStorage(index, entry);
+        if (res < 0)
+        {
+            return res;
+        }
+        StorageMarshaller io(storage_);
+        return io.setAndGetBack(getLastIndexKey(), inout_last_index);
+    }
+
     int initEmptyLogStorage()
     {
         StorageMarshaller io(storage_);
@@ -128,6 +186,7 @@ private:
          * left in an inconsistent state.
          */
         last_index_ = 0;
+        rebuildIndex();
         uint32_t stored_index = 0;
         res = io.setAndGetBack(getLastIndexKey(), stored_index);
         if (res < 0)
@@ -147,7 +206,9 @@ public:
         : storage_(storage)
         , tracer_(tracer)
         , last_index_(0)
-    { }
+    {
+        rebuildIndex();
+    }
 
     int init()
     {
@@ -191,6 +252,8 @@ public:
             }
         }
 
+        rebuildIndex();
+
         UAVCAN_TRACE("dynamic_node_id_server::distributed::Log", "Restored %u log entries", unsigned(last_index_));
         return 0;
     }
@@ -208,20 +271,18 @@ public:
 
         tracer_.onEvent(TraceRaftLogAppend, last_index_ + 1U);
 
-        // If next operations fail, we'll get a dangling entry, but it's absolutely OK.
-        int res = writeEntryToStorage(Index(last_index_ + 1), entry);
+        // The entry and the last index are written within one batch, so that the backend could store them at once
+        storage_.beginBatch();
+        uint32_t new_last_index = last_index_ + 1U;
+        int res = writeEntryAndLastIndexToStorage(Index(new_last_index), entry, new_last_index);
+        const int commit_res = storage_.commitBatch();
         if (res < 0)
         {
             return res;
         }
-
-        // Updating the last index
-        StorageMarshaller io(storage_);
-        uint32_t new_last_index = last_index_ + 1U;
-        res = io.setAndGetBack(getLastIndexKey(), new_last_index);
-        if (res < 0)
+        if (commit_res < 0)
         {
-            return res;
+            return commit_res;
         }
         if (new_last_index != last_index_ + 1U)
         {
@@ -229,6 +290,7 @@ public:
         }
         entries_[new_last_index] = entry;
         last_index_ = Index(new_last_index);
+        indexEntry(last_index_);
 
         UAVCAN_TRACE("dynamic_node_id_server::distributed::Log", "New entry, index %u, node ID %u, term %u",
                      unsigned(last_index_), unsigned(entry.node_id), unsigned(entry.term));
@@ -267,6 +329,7 @@ public:
             UAVCAN_TRACE("dynamic_node_id_server::distributed::Log", "Entries removed, last index %u --> %u",
                          unsigned(last_index_), unsigned(new_last_index));
             last_index_ = Index(new_last_index);
+            rebuildIndex();
         }
 
         // Removal operation leaves dangling entries in storage, it's OK
@@ -290,6 +353,42 @@ public:
 
     Index getLastIndex() const { return last_index_; }
 
+    /**
+     * These methods find the entry with the highest index that has the specified node ID or unique ID.
+     * Returned value indicates whether such entry exists; if it doesn't, the output argument will not be modified.
+     * These methods do not use storage IO; they take constant time regardless of the log length.
+     */
+    bool findLastEntryWithNodeID(NodeID node_id, Index& out_index) const
+    {
+        const Index index = node_id_index_[node_id.get()];
+        if (index == InvalidIndex)
+        {
+            return false;
+        }
+        UAVCAN_ASSERT((index <= last_index_) && (entries_[index].node_id == node_id.get()));
+        out_index = index;
+        return true;
+    }
+
+    bool findLastEntryWithUniqueID(const UniqueID& unique_id, Index& out_index) const
+    {
+        unsigned slot = hashUniqueID(unique_id);
+        while (unique_id_hash_table_[slot] != InvalidIndex)
+        {
+            const Index index = unique_id_hash_table_[slot];
+            UAVCAN_ASSERT(index <= last_index_);
+            if (entries_[index].unique_id == unique_id)
+            {
+                out_index = index;
+                return true;
+            }
+            slot = (slot + 1U) & (UniqueIDHashTableSize - 1U);
+        }
+        return false;
+    }
+
+    bool isNodeIDInLog(NodeID node_id) const { return node_id_index_[node_id.get()] != InvalidIndex; }
+
     bool isOtherLogUpToDate(Index other_last_index, Term other_last_term) const
     {
         UAVCAN_ASSERT(last_index_ < Capacity);
@@ -12,6 +12,7 @@
 #include <uavcan/node/timer.hpp>
 #include <uavcan/node/service_server.hpp>
 #include <uavcan/node/service_client.hpp>
+#include <uavcan/node/service_rtt_estimator.hpp>
 #include <uavcan/protocol/dynamic_node_id_server/distributed/types.hpp>
 #include <uavcan/protocol/dynamic_node_id_server/distributed/persistent_state.hpp>
 #include <uavcan/protocol/dynamic_node_id_server/distributed/cluster_manager.hpp>
@@ -60,6 +61,22 @@ public:
  *   - newer term in response (also switch to follower)
  *   - append entries request with term >= currentTerm
  *   - vote granted
+ *
+ * Elections:
+ *   - The election timeout is checked at the exact deadline rather than at the next update of the follower, and
+ *     the votes are counted as soon as the responses arrive. A new leader sends heartbeats to all followers at once.
+ *   - The election timeout is randomized within a range that is derived from the round trip time of the calls to
+ *     the other servers, which is usually much narrower than the range defined by the specification; the minimum
+ *     is @ref MinElectionTimeoutRandomizationMs, which is also used until the round trip time is known.
+ *   - The request timeouts follow the round trip time as well, bounded by the update interval.
+ *   - Pre-vote (see the Raft thesis, section 9.6): a candidate asks the other servers whether they would vote for
+ *     it before incrementing its term, so that a server that was disconnected from the cluster does not depose
+ *     the current leader when it comes back. A server grants the pre-vote if the candidate's log is up to date and
+ *     it has not heard from a leader within the minimal election timeout.
+ *     There is no dedicated field for that in the data type, so a pre-vote is a RequestVote request with zero term,
+ *     which is never used by the real elections. The servers that don't support pre-vote deny it; if the pre-vote
+ *     of a candidate is denied by a majority and no leader shows up, its next campaign is a real election, so that
+ *     it can still be elected in a cluster with such servers. Refer to @ref setPreVoteEnabled().
  */
 class RaftCore : private TimerBase
 {
@@ -86,8 +103,12 @@ private:
     typedef MethodBinder<RaftCore*, void (RaftCore::*)(const ServiceCallResult<RequestVote>&)>
         RequestVoteResponseCallback;
 
+    typedef MethodBinder<RaftCore*, void (RaftCore::*)(const TimerEvent&)> ElectionTimerCallback;
+
     struct PendingAppendEntriesFields
     {
+        ServiceCallID call_id;          ///< Invalid if not used
+        MonotonicTime started_at;
         Log::Index prev_log_index;
         Log::Index num_entries;
 
@@ -102,6 +123,27 @@ private:
      */
     enum { MaxNumFollowers = ClusterManager::MaxClusterSize - 1 };
 
+    /**
+     * A lagging follower is fed with up to this number of AppendEntries calls in flight; the next call is made as
+     * soon as a response arrives, rather than at the next update of this follower.
+     */
+    enum { MaxAppendEntriesCallsPerFollower = 4 };
+
+    enum { MaxPendingAppendEntriesCalls = MaxNumFollowers * MaxAppendEntriesCallsPerFollower };
+
+    /**
+     * Width of the randomization range of the election timeout: the round trip time multiplied by
+     * @ref ElectionTimeoutRandomizationPerRtt, but no less than @ref MinElectionTimeoutRandomizationMs and no more
+     * than the range defined by the specification.
+     */
+    enum { MinElectionTimeoutRandomizationMs = 500 };
+    enum { ElectionTimeoutRandomizationPerRtt = 16 };
+
+    /**
+     * Term of the RequestVote requests of the pre-vote campaigns.
+     */
+    enum { PreVoteTerm = 0 };
+
     IEventTracer& tracer_;
     IRaftLeaderMonitor& leader_monitor_;
 
@@ -114,12 +156,26 @@ private:
 
     MonotonicTime last_activity_timestamp_;
     MonotonicDuration randomized_activity_timeout_;
+    MonotonicTime last_leader_contact_timestamp_;   ///< Zero if no leader has been heard from
     ServerState server_state_;
 
     uint8_t next_server_index_;         ///< Next server to query AE from
     uint8_t num_votes_received_in_this_campaign_;
+    uint8_t num_vote_responses_in_this_campaign_;
+    MonotonicTime campaign_started_at_;
+    bool pre_vote_campaign_;
+    bool pre_vote_enabled_;
+    bool skip_next_pre_vote_;           ///< The last pre-vote was denied by a majority, see the class description
+
+    MonotonicDuration max_request_timeout_;         ///< Also the default one, see @ref getRequestTimeoutFor()
+
+    PendingAppendEntriesFields pending_append_entries_fields_[MaxPendingAppendEntriesCalls];
 
-    PendingAppendEntriesFields pending_append_entries_fields_;
+#if !UAVCAN_TINY
+    ServiceRttEstimator<MaxNumFollowers> rtt_estimator_;
+#endif
+
+    TimerEventForwarder<ElectionTimerCallback> election_timer_;
 
     /*
      * Transport
@@ -149,11 +205,13 @@ private:
 
         // Elections
         UAVCAN_ASSERT(server_state_ != ServerStateCandidate || !request_vote_client_.hasPendingCalls() ||
-                      persistent_state_.getVotedFor() == getNode().getNodeID());
+                      pre_vote_campaign_ || persistent_state_.getVotedFor() == getNode().getNodeID());
         UAVCAN_ASSERT(num_votes_received_in_this_campaign_ <= cluster_.getClusterSize());
+        UAVCAN_ASSERT(num_vote_responses_in_this_campaign_ < cluster_.getClusterSize());
+        UAVCAN_ASSERT(server_state_ == ServerStateCandidate || !pre_vote_campaign_);
 
         // Transport
-        UAVCAN_ASSERT(append_entries_client_.getNumPendingCalls() <= 1);
+        UAVCAN_ASSERT(append_entries_client_.getNumPendingCalls() <= MaxPendingAppendEntriesCalls);
         UAVCAN_ASSERT(request_vote_client_.getNumPendingCalls() <= cluster_.getNumKnownServers());
         UAVCAN_ASSERT(server_state_ != ServerStateCandidate || !append_entries_client_.hasPendingCalls());
         UAVCAN_ASSERT(server_state_ != ServerStateLeader    || !request_vote_client_.hasPendingCalls());
@@ -161,12 +219,35 @@ private:
                       (!append_entries_client_.hasPendingCalls() && !request_vote_client_.hasPendingCalls()));
     }
 
+    /**
+     * The longest smoothed round trip time among the other servers; zero if unknown.
+     */
+    MonotonicDuration getMaxRoundTripTime() const
+    {
+        MonotonicDuration rtt;
+#if !UAVCAN_TINY
+        for (uint8_t i = 0; i < cluster_.getNumKnownServers(); i++)
+        {
+            rtt = max(rtt, rtt_estimator_.getSmoothedRtt(cluster_.getRemoteServerNodeIDAtIndex(i)));
+        }
+#endif
+        return rtt;
+    }
+
+    int32_t getElectionTimeoutRandomizationRangeMSec() const
+    {
+        const int64_t max_range_msec = AppendEntries::Request::DEFAULT_MAX_ELECTION_TIMEOUT_MS -
+                                       AppendEntries::Request::DEFAULT_MIN_ELECTION_TIMEOUT_MS;
+        const int64_t range_msec = max(int64_t(MinElectionTimeoutRandomizationMs),
+                                       getMaxRoundTripTime().toMSec() * ElectionTimeoutRandomizationPerRtt);
+        return int32_t(min(range_msec, max_range_msec));
+    }
+
     void registerActivity()
     {
         last_activity_timestamp_ = getNode().getMonotonicTime();
 
-        static const int32_t randomization_range_msec = AppendEntries::Request::DEFAULT_MAX_ELECTION_TIMEOUT_MS -
-                                                        AppendEntries::Request::DEFAULT_MIN_ELECTION_TIMEOUT_MS;
+        const int32_t randomization_range_msec = getElectionTimeoutRandomizationRangeMSec();
         // coverity[dont_call]
         const int32_t random_msec = (std::rand() % randomization_range_msec) + 1;
 
@@ -175,6 +256,9 @@ private:
 
         UAVCAN_ASSERT(randomized_activity_timeout_.toMSec() > AppendEntries::Request::DEFAULT_MIN_ELECTION_TIMEOUT_MS);
         UAVCAN_ASSERT(randomized_activity_timeout_.toMSec() <= AppendEntries::Request::DEFAULT_MAX_ELECTION_TIMEOUT_MS);
+
+        election_timer_.startOneShotWithDeadline(last_activity_timestamp_ + randomized_activity_timeout_ +
+                                                 MonotonicDuration::fromUSec(1));
     }
 
     bool isActivityTimedOut() const
@@ -182,6 +266,45 @@ private:
         return getNode().getMonotonicTime() > (last_activity_timestamp_ + randomized_activity_timeout_);
     }
 
+    bool hasRecentLeaderContact() const
+    {
+        return !last_leader_contact_timestamp_.isZero() &&
+               (getNode().getMonotonicTime() < (last_leader_contact_timestamp_ +
+                   MonotonicDuration::fromMSec(AppendEntries::Request::DEFAULT_MIN_ELECTION_TIMEOUT_MS)));
+    }
+
+    /**
+     * Request timeout of the next call to the server: the adaptive one, bounded by the update interval.
+     */
+    MonotonicDuration getRequestTimeoutFor(NodeID node_id) const
+    {
+#if !UAVCAN_TINY
+        return min(rtt_estimator_.getRequestTimeout(node_id, max_request_timeout_), max_request_timeout_);
+#else
+        (void)node_id;
+        return max_request_timeout_;
+#endif
+    }
+
+    void registerCallResult(NodeID node_id, MonotonicTime started_at, bool successful, MonotonicTime response_ts)
+    {
+#if !UAVCAN_TINY
+        if (!successful)
+        {
+            rtt_estimator_.addTimeout(node_id);
+        }
+        else if (!started_at.isZero() && !response_ts.isZero() && (response_ts >= started_at))
+        {
+            rtt_estimator_.addSample(node_id, response_ts - started_at);
+        }
+#else
+        (void)node_id;
+        (void)started_at;
+        (void)successful;
+        (void)response_ts;
+#endif
+    }
+
     void handlePersistentStateUpdateError(int error)
     {
         UAVCAN_ASSERT(error < 0);
@@ -196,21 +319,28 @@ private:
         {
             switchState(ServerStateCandidate);
             registerActivity();
+            startCampaign(pre_vote_enabled_ && !skip_next_pre_vote_);
         }
     }
 
     void updateCandidate()
     {
-        if (num_votes_received_in_this_campaign_ > 0)
-        {
-            trace(TraceRaftElectionComplete, num_votes_received_in_this_campaign_);
-            const bool won = num_votes_received_in_this_campaign_ >= cluster_.getQuorumSize();
+        // Normally the campaign is resolved as soon as the last response arrives or times out
+        resolveCampaign();
+    }
 
-            UAVCAN_TRACE("dynamic_node_id_server::distributed::RaftCore", "Election complete, won: %d", int(won));
+    /**
+     * A pre-vote campaign does not affect the persistent state; the real election follows as soon as it is won.
+     */
+    void startCampaign(bool pre_vote)
+    {
+        UAVCAN_ASSERT(server_state_ == ServerStateCandidate);
 
-            switchState(won ? ServerStateLeader : ServerStateFollower);       // Start over or become leader
-        }
-        else
+        request_vote_client_.cancelAllCalls();
+        pre_vote_campaign_ = pre_vote;
+        skip_next_pre_vote_ = false;
+
+        if (!pre_vote)
         {
             // Set votedFor, abort on failure
             int res = persistent_state_.setVotedFor(getNode().getNodeID());
@@ -227,88 +357,208 @@ private:
                 handlePersistentStateUpdateError(res);
                 return;
             }
+        }
 
-            num_votes_received_in_this_campaign_ = 1;               // Voting for self
+        num_votes_received_in_this_campaign_ = 1;                   // Voting for self
+        num_vote_responses_in_this_campaign_ = 0;
+        campaign_started_at_ = getNode().getMonotonicTime();
 
-            RequestVote::Request req;
-            req.last_log_index = persistent_state_.getLog().getLastIndex();
-            req.last_log_term = persistent_state_.getLog().getEntryAtIndex(req.last_log_index)->term;
-            req.term = persistent_state_.getCurrentTerm();
+        RequestVote::Request req;
+        req.last_log_index = persistent_state_.getLog().getLastIndex();
+        req.last_log_term = persistent_state_.getLog().getEntryAtIndex(req.last_log_index)->term;
+        req.term = pre_vote ? Term(PreVoteTerm) : persistent_state_.getCurrentTerm();
 
-            for (uint8_t i = 0; i < MaxNumFollowers; i++)
+        for (uint8_t i = 0; i < MaxNumFollowers; i++)
+        {
+            const NodeID node_id = cluster_.getRemoteServerNodeIDAtIndex(i);
+            if (!node_id.isUnicast())
             {
-                const NodeID node_id = cluster_.getRemoteServerNodeIDAtIndex(i);
-                if (!node_id.isUnicast())
-                {
-                    break;
-                }
+                break;
+            }
 
-                UAVCAN_TRACE("dynamic_node_id_server::distributed::RaftCore",
-                             "Requesting vote from %d", int(node_id.get()));
-                trace(TraceRaftVoteRequestInitiation, node_id.get());
+            UAVCAN_TRACE("dynamic_node_id_server::distributed::RaftCore",
+                         "Requesting %s from %d", pre_vote ? "pre-vote" : "vote", int(node_id.get()));
+            trace(TraceRaftVoteRequestInitiation, node_id.get());
 
-                res = request_vote_client_.call(node_id, req);
-                if (res < 0)
-                {
-                    trace(TraceError, res);
-                }
+            request_vote_client_.setRequestTimeout(getRequestTimeoutFor(node_id));
+            const int res = request_vote_client_.call(node_id, req);
+            if (res < 0)
+            {
+                trace(TraceError, res);
             }
         }
+
+        resolveCampaign();
     }
 
-    void updateLeader()
+    /**
+     * Completes the campaign once it is won, or once all of the calls are completed.
+     */
+    void resolveCampaign()
     {
-        if (append_entries_client_.hasPendingCalls())
+        UAVCAN_ASSERT(server_state_ == ServerStateCandidate);
+
+        const bool won = num_votes_received_in_this_campaign_ >= cluster_.getQuorumSize();
+        if (!won && request_vote_client_.hasPendingCalls())
         {
-            append_entries_client_.cancelAllCalls();    // Refer to the response callback to learn why
+            return;
         }
 
-        if (cluster_.getClusterSize() > 1)
+        trace(TraceRaftElectionComplete, num_votes_received_in_this_campaign_);
+        UAVCAN_TRACE("dynamic_node_id_server::distributed::RaftCore", "%s complete, won: %d",
+                     pre_vote_campaign_ ? "Pre-vote" : "Election", int(won));
+
+        if (!won)
         {
-            const NodeID node_id = cluster_.getRemoteServerNodeIDAtIndex(next_server_index_);
-            UAVCAN_ASSERT(node_id.isUnicast());
+            skip_next_pre_vote_ = pre_vote_campaign_ &&
+                                  ((num_vote_responses_in_this_campaign_ + 1U) >= cluster_.getQuorumSize());
+            switchState(ServerStateFollower);                       // Start over
+        }
+        else if (pre_vote_campaign_)
+        {
+            startCampaign(false);
+        }
+        else
+        {
+            switchState(ServerStateLeader);
 
-            next_server_index_++;
-            if (next_server_index_ >= cluster_.getNumKnownServers())
+            for (uint8_t i = 0; (i < cluster_.getNumKnownServers()) && (server_state_ == ServerStateLeader); i++)
             {
-                next_server_index_ = 0;
+                feedFollower(cluster_.getRemoteServerNodeIDAtIndex(i), true);
+            }
+        }
+    }
+
+    /**
+     * Finds a free item if the call ID is invalid.
+     */
+    PendingAppendEntriesFields* findPendingAppendEntriesFields(ServiceCallID call_id)
+    {
+        for (unsigned i = 0; i < MaxPendingAppendEntriesCalls; i++)
+        {
+            const ServiceCallID& item_call_id = pending_append_entries_fields_[i].call_id;
+            if (call_id.isValid() ? (item_call_id == call_id) : !item_call_id.isValid())
+            {
+                return &pending_append_entries_fields_[i];
+            }
+        }
+        return NULL;
+    }
+
+    void cancelAppendEntriesCallsTo(NodeID node_id)
+    {
+        for (unsigned i = 0; i < MaxPendingAppendEntriesCalls; i++)
+        {
+            if (pending_append_entries_fields_[i].call_id.server_node_id == node_id)
+            {
+                append_entries_client_.cancelCall(pending_append_entries_fields_[i].call_id);
+                pending_append_entries_fields_[i] = PendingAppendEntriesFields();
             }
+        }
+    }
+
+    /**
+     * Returns the number of entries sent, or negative error code.
+     */
+    int callAppendEntries(NodeID node_id, Log::Index prev_log_index)
+    {
+        PendingAppendEntriesFields* const fields = findPendingAppendEntriesFields(ServiceCallID());
+        if (fields == NULL)
+        {
+            UAVCAN_ASSERT(0);       // Number of calls per follower is limited, so this is not possible
+            return -ErrLogic;
+        }
 
-            AppendEntries::Request req;
-            req.term = persistent_state_.getCurrentTerm();
-            req.leader_commit = commit_index_;
+        AppendEntries::Request req;
+        req.term = persistent_state_.getCurrentTerm();
+        req.leader_commit = commit_index_;
+
+        req.prev_log_index = prev_log_index;
+
+        const Entry* const entry = persistent_state_.getLog().getEntryAtIndex(req.prev_log_index);
+        if (entry == NULL)
+        {
+            UAVCAN_ASSERT(0);
+            handlePersistentStateUpdateError(-ErrLogic);
+            return -ErrLogic;
+        }
 
-            req.prev_log_index = Log::Index(cluster_.getServerNextIndex(node_id) - 1U);
+        req.prev_log_term = entry->term;
 
-            const Entry* const entry = persistent_state_.getLog().getEntryAtIndex(req.prev_log_index);
-            if (entry == NULL)
+        for (Log::Index index = Log::Index(prev_log_index + 1U);
+             index <= persistent_state_.getLog().getLastIndex();
+             index++)
+        {
+            req.entries.push_back(*persistent_state_.getLog().getEntryAtIndex(index));
+            if (req.entries.size() == req.entries.capacity())
             {
-                UAVCAN_ASSERT(0);
-                handlePersistentStateUpdateError(-ErrLogic);
-                return;
+                break;
             }
+        }
+
+        append_entries_client_.setRequestTimeout(getRequestTimeoutFor(node_id));
+        const int res = append_entries_client_.call(node_id, req, fields->call_id);
+        if (res < 0)
+        {
+            trace(TraceRaftAppendEntriesCallFailure, res);
+            *fields = PendingAppendEntriesFields();
+            return res;
+        }
 
-            req.prev_log_term = entry->term;
+        fields->started_at = getNode().getMonotonicTime();
+        fields->prev_log_index = req.prev_log_index;
+        fields->num_entries = Log::Index(req.entries.size());
+        return int(req.entries.size());
+    }
 
-            for (Log::Index index = cluster_.getServerNextIndex(node_id);
-                 index <= persistent_state_.getLog().getLastIndex();
-                 index++)
+    /**
+     * Sends the entries the follower is missing, continuing after the calls that are already in flight.
+     * If the follower is up to date and there are no calls in flight, an empty call can be sent as a heartbeat.
+     */
+    void feedFollower(NodeID node_id, bool send_heartbeat)
+    {
+        unsigned next_index = cluster_.getServerNextIndex(node_id);
+        unsigned num_pending_calls = 0;
+        for (unsigned i = 0; i < MaxPendingAppendEntriesCalls; i++)
+        {
+            const PendingAppendEntriesFields& fields = pending_append_entries_fields_[i];
+            if (fields.call_id.isValid() && (fields.call_id.server_node_id == node_id))
             {
-                req.entries.push_back(*persistent_state_.getLog().getEntryAtIndex(index));
-                if (req.entries.size() == req.entries.capacity())
-                {
-                    break;
-                }
+                num_pending_calls++;
+                next_index = max(next_index, fields.prev_log_index + fields.num_entries + 1U);
             }
+        }
 
-            pending_append_entries_fields_.num_entries = req.entries.size();
-            pending_append_entries_fields_.prev_log_index = req.prev_log_index;
+        send_heartbeat = send_heartbeat && (num_pending_calls == 0);
 
-            const int res = append_entries_client_.call(node_id, req);
+        while ((num_pending_calls < MaxAppendEntriesCallsPerFollower) &&
+               (send_heartbeat || (next_index <= persistent_state_.getLog().getLastIndex())))
+        {
+            const int res = callAppendEntries(node_id, Log::Index(next_index - 1U));
             if (res < 0)
             {
-                trace(TraceRaftAppendEntriesCallFailure, res);
+                break;
+            }
+            send_heartbeat = false;
+            next_index += unsigned(res);
+            num_pending_calls++;
+        }
+    }
+
+    void updateLeader()
+    {
+        if (cluster_.getClusterSize() > 1)
+        {
+            const NodeID node_id = cluster_.getRemoteServerNodeIDAtIndex(next_server_index_);
+            UAVCAN_ASSERT(node_id.isUnicast());
+
+            next_server_index_++;
+            if (next_server_index_ >= cluster_.getNumKnownServers())
+            {
+                next_server_index_ = 0;
             }
+
+            feedFollower(node_id, true);
         }
 
         propagateCommitIndex();
@@ -341,9 +591,13 @@ private:
 
         next_server_index_ = 0;
         num_votes_received_in_this_campaign_ = 0;
+        num_vote_responses_in_this_campaign_ = 0;
+        pre_vote_campaign_ = false;
 
         request_vote_client_.cancelAllCalls();
         append_entries_client_.cancelAllCalls();
+        fill(pending_append_entries_fields_, pending_append_entries_fields_ + MaxPendingAppendEntriesCalls,
+             PendingAppendEntriesFields());
 
         /*
          * Calling the switch handler
@@ -398,6 +652,12 @@ private:
 
                 // AT THIS POINT ALLOCATION IS COMPLETE
                 leader_monitor_.handleLogCommitOnLeader(*persistent_state_.getLog().getEntryAtIndex(commit_index_));
+
+                // The followers may have confirmed more entries at once; the monitor may have changed the state
+                if (server_state_ == ServerStateLeader)
+                {
+                    propagateCommitIndex();
+                }
             }
         }
     }
@@ -465,6 +725,9 @@ private:
         registerActivity();
         switchState(ServerStateFollower);
 
+        last_leader_contact_timestamp_ = getNode().getMonotonicTime();
+        skip_next_pre_vote_ = false;
+
         /*
          * Step 2
          * Reject the request if the assumed log index does not exist on the local node.
@@ -495,21 +758,30 @@ private:
         /*
          * Step 4
          * Update the log with new entries - this will possibly require to rewrite existing entries.
+         * Entries that are already in the log are kept, and so are the entries that follow them: the leader keeps
+         * several requests in flight, so this request may be older than the entries the log already has.
          * Ignore the request if the persistent state cannot be updated.
          */
-        if (request.prev_log_index != persistent_state_.getLog().getLastIndex())
+        for (uint8_t i = 0; i < request.entries.size(); i++)
         {
-            const int res = persistent_state_.getLog().removeEntriesWhereIndexGreater(request.prev_log_index);
-            if (res < 0)
+            const Log::Index index = Log::Index(request.prev_log_index + 1U + i);
+            const Entry* const existing_entry = persistent_state_.getLog().getEntryAtIndex(index);
+            if ((existing_entry != NULL) && (existing_entry->term == request.entries[i].term))
             {
-                trace(TraceRaftPersistStateUpdateError, res);
-                response.setResponseEnabled(false);
-                return;
+                continue;
+            }
+
+            if (existing_entry != NULL)
+            {
+                const int res = persistent_state_.getLog().removeEntriesWhereIndexGreaterOrEqual(index);
+                if (res < 0)
+                {
+                    trace(TraceRaftPersistStateUpdateError, res);
+                    response.setResponseEnabled(false);
+                    return;
+                }
             }
-        }
 
-        for (uint8_t i = 0; i < request.entries.size(); i++)
-        {
             const int res = persistent_state_.getLog().append(request.entries[i]);
             if (res < 0)
             {
@@ -523,9 +795,10 @@ private:
          * Step 5
          * Update the commit index.
          */
-        if (request.leader_commit > commit_index_)
+        const Log::Index last_new_index = Log::Index(request.prev_log_index + request.entries.size());
+        if ((request.leader_commit > commit_index_) && (last_new_index > commit_index_))
         {
-            commit_index_ = min(request.leader_commit, persistent_state_.getLog().getLastIndex());
+            commit_index_ = min(request.leader_commit, last_new_index);
             trace(TraceRaftCommitIndexUpdate, commit_index_);
         }
 
@@ -538,34 +811,62 @@ private:
         UAVCAN_ASSERT(server_state_ == ServerStateLeader);  // When state switches, all requests must be cancelled
         checkInvariants();
 
-        if (!result.isSuccessful())
+        PendingAppendEntriesFields* const fields = findPendingAppendEntriesFields(result.getCallID());
+        if (fields == NULL)
         {
+            UAVCAN_ASSERT(0);
             return;
         }
+        const PendingAppendEntriesFields call = *fields;
+        *fields = PendingAppendEntriesFields();
+
+        const NodeID node_id = result.getCallID().server_node_id;
+        registerCallResult(node_id, call.started_at, result.isSuccessful(),
+                           result.getResponse().getMonotonicTimestamp());
+
+        if (!result.isSuccessful())
+        {
+            return;                 // The follower will be fed again at its next update
+        }
 
         if (result.getResponse().term > persistent_state_.getCurrentTerm())
         {
             tryIncrementCurrentTermFromResponse(result.getResponse().term);
+            return;
         }
-        else
+
+        if (result.getResponse().success)
         {
-            if (result.getResponse().success)
+            const Log::Index match_index = Log::Index(call.prev_log_index + call.num_entries);
+            if (match_index > cluster_.getServerMatchIndex(node_id))
             {
-                cluster_.incrementServerNextIndexBy(result.getCallID().server_node_id,
-                                                    pending_append_entries_fields_.num_entries);
-                cluster_.setServerMatchIndex(result.getCallID().server_node_id,
-                                             Log::Index(pending_append_entries_fields_.prev_log_index +
-                                                        pending_append_entries_fields_.num_entries));
+                cluster_.setServerMatchIndex(node_id, match_index);
             }
-            else
+            if (match_index >= cluster_.getServerNextIndex(node_id))
+            {
+                cluster_.incrementServerNextIndexBy(node_id,
+                                                    Log::Index(match_index + 1U - cluster_.getServerNextIndex(node_id)));
+            }
+            propagateCommitIndex();
+        }
+        else
+        {
+            /*
+             * The calls that follow the rejected one will be rejected as well, so they are cancelled.
+             * The next index is not decremented if the call was made beyond it, i.e. if a preceding call was lost.
+             */
+            cancelAppendEntriesCallsTo(node_id);
+            if ((call.prev_log_index + 1U) == cluster_.getServerNextIndex(node_id))
             {
-                cluster_.decrementServerNextIndex(result.getCallID().server_node_id);
-                trace(TraceRaftAppendEntriesRespUnsucfl, result.getCallID().server_node_id.get());
+                cluster_.decrementServerNextIndex(node_id);
+                trace(TraceRaftAppendEntriesRespUnsucfl, node_id.get());
             }
         }
 
-        pending_append_entries_fields_ = PendingAppendEntriesFields();
-        // Rest of the logic is implemented in periodic update handlers.
+        if (server_state_ == ServerStateLeader)
+        {
+            feedFollower(node_id, false);
+        }
     }
 
     void handleRequestVoteRequest(const ReceivedDataStructure<RequestVote::Request>& request,
@@ -583,6 +884,18 @@ private:
 
         UAVCAN_ASSERT(response.isResponseEnabled());  // This is default
 
+        /*
+         * Pre-vote does not affect the local state.
+         */
+        if (request.term == Term(PreVoteTerm))
+        {
+            response.term = persistent_state_.getCurrentTerm();
+            response.vote_granted =
+                (server_state_ != ServerStateLeader) && !hasRecentLeaderContact() &&
+                persistent_state_.getLog().isOtherLogUpToDate(request.last_log_index, request.last_log_term);
+            return;
+        }
+
         /*
          * Checking if our current state is up to date.
          * The request will be ignored if persistent state cannot be updated.
@@ -647,8 +960,12 @@ private:
         UAVCAN_ASSERT(server_state_ == ServerStateCandidate); // When state switches, all requests must be cancelled
         checkInvariants();
 
+        registerCallResult(result.getCallID().server_node_id, campaign_started_at_, result.isSuccessful(),
+                           result.getResponse().getMonotonicTimestamp());
+
         if (!result.isSuccessful())
         {
+            resolveCampaign();
             return;
         }
 
@@ -657,16 +974,24 @@ private:
         if (result.getResponse().term > persistent_state_.getCurrentTerm())
         {
             tryIncrementCurrentTermFromResponse(result.getResponse().term);
+            return;
         }
-        else
+
+        num_vote_responses_in_this_campaign_++;
+        if (result.getResponse().vote_granted)
         {
-            if (result.getResponse().vote_granted)
-            {
-                num_votes_received_in_this_campaign_++;
-            }
+            num_votes_received_in_this_campaign_++;
+        }
+        resolveCampaign();
+    }
+
+    void handleElectionTimerEvent(const TimerEvent&)
+    {
+        if (TimerBase::isRunning() && (server_state_ == ServerStateFollower))     // Not before init() succeeds
+        {
+            checkInvariants();
+            updateFollower();
         }
-        // Rest of the logic is implemented in periodic update handlers.
-        // I'm no fan of asynchronous programming. At all.
     }
 
     virtual void handleTimerEvent(const TimerEvent&)
@@ -715,11 +1040,19 @@ public:
         , server_state_(ServerStateFollower)
         , next_server_index_(0)
         , num_votes_received_in_this_campaign_(0)
+        , num_vote_responses_in_this_campaign_(0)
+        , pre_vote_campaign_(false)
+        , pre_vote_enabled_(true)
+        , skip_next_pre_vote_(false)
+        , max_request_timeout_(ServiceClientBase::getDefaultRequestTimeout())
+        , election_timer_(node)
         , append_entries_srv_(node)
         , append_entries_client_(node)
         , request_vote_srv_(node)
         , request_vote_client_(node)
-    { }
+    {
+        election_timer_.setCallback(ElectionTimerCallback(this, &RaftCore::handleElectionTimerEvent));
+    }
 
     /**
      * Once started, the logic runs in the background until destructor is called.
@@ -735,6 +1068,10 @@ public:
         server_state_ = ServerStateFollower;
         next_server_index_ = 0;
         num_votes_received_in_this_campaign_ = 0;
+        num_vote_responses_in_this_campaign_ = 0;
+        pre_vote_campaign_ = false;
+        skip_next_pre_vote_ = false;
+        last_leader_contact_timestamp_ = MonotonicTime();
         commit_index_ = 0;
 
         registerActivity();
@@ -794,6 +1131,8 @@ public:
         UAVCAN_TRACE("dynamic_node_id_server::distributed::RaftCore",
                      "Update interval: %ld msec", static_cast<long>(update_interval.toMSec()));
 
+        max_request_timeout_ = min(append_entries_client_.getDefaultRequestTimeout(), update_interval);
+
         append_entries_client_.setRequestTimeout(min(append_entries_client_.getDefaultRequestTimeout(),
                                                      update_interval));
 
@@ -808,6 +1147,13 @@ public:
         return 0;
     }
 
+    /**
+     * Pre-vote is enabled by default; it should be disabled if most of the servers of the cluster don't support it.
+     * Refer to the class description.
+     */
+    void setPreVoteEnabled(bool enabled) { pre_vote_enabled_ = enabled; }
+    bool isPreVoteEnabled() const { return pre_vote_enabled_; }
+
     /**
      * This function is mostly needed for testing.
      */
@@ -864,6 +1210,17 @@ public:
         { }
     };
 
+private:
+    LazyConstructor<LogEntryInfo> makeLogEntryInfo(Log::Index index) const
+    {
+        const Entry* const entry = persistent_state_.getLog().getEntryAtIndex(index);
+        UAVCAN_ASSERT(entry != NULL);
+        LazyConstructor<LogEntryInfo> ret;
+        ret.construct<const LogEntryInfo&>(LogEntryInfo(*entry, index <= commit_index_));
+        return ret;
+    }
+
+public:
     /**
      * This method is used by the allocator to query existence of certain entries in the Raft log.
      * Predicate is a callable of the following prototype:
@@ -892,6 +1249,34 @@ public:
         return LazyConstructor<LogEntryInfo>();
     }
 
+    /**
+     * These methods find the log entry with the highest index that has the specified unique ID or node ID.
+     * They are equivalent to @ref traverseLogFromEndUntil() with an appropriate predicate, but they take constant
+     * time regardless of the log length.
+     */
+    LazyConstructor<LogEntryInfo> findLastLogEntryWithUniqueID(const UniqueID& unique_id) const
+    {
+        Log::Index index = 0;
+        return persistent_state_.getLog().findLastEntryWithUniqueID(unique_id, index) ?
+               makeLogEntryInfo(index) : LazyConstructor<LogEntryInfo>();
+    }
+
+    LazyConstructor<LogEntryInfo> findLastLogEntryWithNodeID(const NodeID node_id) const
+    {
+        Log::Index index = 0;
+        return persistent_state_.getLog().findLastEntryWithNodeID(node_id, index) ?
+               makeLogEntryInfo(index) : LazyConstructor<LogEntryInfo>();
+    }
+
+    /**
+     * Whether the node ID is used by any entry of the log, committed or not.
+     * This is equivalent to traversing the log with a node ID predicate, but it takes constant time.
+     */
+    bool isNodeIDInLog(const NodeID node_id) const
+    {
+        return persistent_state_.getLog().isNodeIDInLog(node_id);
+    }
+
     Log::Index getNumAllocations() const
     {
         // Remember that index zero contains a special-purpose entry that doesn't count as allocation
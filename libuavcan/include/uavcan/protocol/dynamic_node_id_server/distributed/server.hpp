@@ -25,34 +25,6 @@ namespace distributed
 class UAVCAN_EXPORT Server : public AbstractServer
                            , IRaftLeaderMonitor
 {
-    struct UniqueIDLogPredicate
-    {
-        const UniqueID unique_id;
-
-        UniqueIDLogPredicate(const UniqueID& uid)
-            : unique_id(uid)
-        { }
-
-        bool operator()(const RaftCore::LogEntryInfo& info) const
-        {
-            return info.entry.unique_id == unique_id;
-        }
-    };
-
-    struct NodeIDLogPredicate
-    {
-        const NodeID node_id;
-
-        NodeIDLogPredicate(const NodeID& nid)
-            : node_id(nid)
-        { }
-
-        bool operator()(const RaftCore::LogEntryInfo& info) const
-        {
-            return info.entry.node_id == node_id.get();
-        }
-    };
-
     /*
      * States
      */
@@ -97,7 +69,7 @@ class UAVCAN_EXPORT Server : public AbstractServer
          * otherwise the request will be ignored because only leader can add new allocations.
          */
         const LazyConstructor<RaftCore::LogEntryInfo> result =
-            raft_core_.traverseLogFromEndUntil(UniqueIDLogPredicate(unique_id));
+            raft_core_.findLastLogEntryWithUniqueID(unique_id);
 
          if (result.isConstructed())
          {
@@ -135,7 +107,7 @@ class UAVCAN_EXPORT Server : public AbstractServer
     virtual NodeAwareness checkNodeAwareness(NodeID node_id) const
     {
         const LazyConstructor<RaftCore::LogEntryInfo> result =
-            raft_core_.traverseLogFromEndUntil(NodeIDLogPredicate(node_id));
+            raft_core_.findLastLogEntryWithNodeID(node_id);
         if (result.isConstructed())
         {
             return result->committed ? NodeAwarenessKnownAndCommitted : NodeAwarenessKnownButNotCommitted;
@@ -148,7 +120,7 @@ class UAVCAN_EXPORT Server : public AbstractServer
 
     virtual void handleNewNodeDiscovery(const UniqueID* unique_id_or_null, NodeID node_id)
     {
-        if (raft_core_.traverseLogFromEndUntil(NodeIDLogPredicate(node_id)).isConstructed())
+        if (raft_core_.findLastLogEntryWithNodeID(node_id).isConstructed())
         {
             UAVCAN_ASSERT(0);   // Such node is already known, the class that called this method should have known that
             return;
@@ -181,7 +153,7 @@ class UAVCAN_EXPORT Server : public AbstractServer
         }
 
         const LazyConstructor<RaftCore::LogEntryInfo> result =
-            raft_core_.traverseLogFromEndUntil(NodeIDLogPredicate(node_.getNodeID()));
+            raft_core_.findLastLogEntryWithNodeID(node_.getNodeID());
 
         if (!result.isConstructed())
         {
@@ -196,7 +168,7 @@ class UAVCAN_EXPORT Server : public AbstractServer
     {
         UAVCAN_TRACE("dynamic_node_id_server::distributed::Server",
                      "Testing if node ID %d is taken", int(node_id.get()));
-        return raft_core_.traverseLogFromEndUntil(NodeIDLogPredicate(node_id));
+        return raft_core_.isNodeIDInLog(node_id);
     }
 
     void allocateNewNode(const UniqueID& unique_id, const NodeID preferred_node_id)
@@ -258,7 +230,7 @@ public:
          * Making sure that the server is started with the same node ID
          */
         const LazyConstructor<RaftCore::LogEntryInfo> own_log_entry =
-            raft_core_.traverseLogFromEndUntil(NodeIDLogPredicate(node_.getNodeID()));
+            raft_core_.findLastLogEntryWithNodeID(node_.getNodeID());
 
         if (own_log_entry.isConstructed())
         {
@@ -60,13 +60,13 @@ enum UAVCAN_EXPORT TraceCode
     TraceAllocationFollowupDenied,      // reason code (see sources for details)
     TraceAllocationFollowupTimeout,     // timeout value in microseconds
     TraceAllocationBadRequest,          // number of unique ID bytes in this request
-    TraceAllocationUnexpectedStage,     // stage number in the request - 1, 2, or 3
+    TraceAllocationUnexpectedStage,     // stage of the request - 1 for the first stage, 2 for the following ones
     // 35
     TraceAllocationRequestAccepted,     // number of bytes of unique ID after request
     TraceAllocationExchangeComplete,    // first 8 bytes of unique ID interpreted as signed 64 bit big endian
     TraceAllocationResponse,            // allocated node ID
     TraceAllocationActivity,            // source node ID of the message
-    Trace12,
+    TraceAllocationRequestQueued,       // number of queued first stage requests
     // 40
     TraceDiscoveryNewNodeFound,         // node ID
     TraceDiscoveryCommitCacheUpdated,   // node ID marked as committed
@@ -139,7 +139,7 @@ public:
             "AllocationExchangeComplete",
             "AllocationResponse",
             "AllocationActivity",
-            "",
+            "AllocationRequestQueued",
             "DiscoveryNewNodeFound",
             "DiscoveryCommitCacheUpdated",
             "DiscoveryNodeFinalized",
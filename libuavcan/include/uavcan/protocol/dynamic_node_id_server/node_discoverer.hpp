@@ -12,6 +12,7 @@
 #include <uavcan/node/timer.hpp>
 #include <uavcan/node/subscriber.hpp>
 #include <uavcan/node/service_client.hpp>
+#include <uavcan/protocol/node_info_retriever.hpp>
 #include <uavcan/protocol/dynamic_node_id_server/types.hpp>
 #include <uavcan/protocol/dynamic_node_id_server/event.hpp>
 #include <cassert>
@@ -64,8 +65,17 @@ public:
 /**
  * This class listens to NodeStatus messages from other nodes and retrieves their unique ID if they are not
  * known to the allocator.
+ *
+ * Several nodes are queried concurrently, one request per node at a time; the nodes that have been queried less
+ * are queried first. The number of requests per poll interval adapts the same way as in @ref NodeInfoRetriever:
+ * it is increased by one after a number of successful calls equal to the current value, up to
+ * @ref getMaxRequestsPerInterval(), and it is halved on every request timeout.
+ *
+ * If the application runs @ref NodeInfoRetriever on the same node, it can be shared via
+ * @ref setNodeInfoRetriever(), so that the nodes are not queried twice.
  */
 class NodeDiscoverer : TimerBase
+                     , INodeInfoListener
 {
     typedef MethodBinder<NodeDiscoverer*, void (NodeDiscoverer::*)(const ServiceCallResult<protocol::GetNodeInfo>&)>
         GetNodeInfoResponseCallback;
@@ -94,6 +104,36 @@ class NodeDiscoverer : TimerBase
 
     enum { TimerPollIntervalMs = 170 }; // ~ ceil(500 ms service timeout / 3)
 
+    enum { DefaultMaxRequestsPerInterval = 4 };
+
+    /**
+     * Picks the node with the least number of attempts among the ones that can be queried now.
+     */
+    class NodeToQuerySelector
+    {
+        const NodeDiscoverer& owner_;
+        NodeID& out_node_id_;
+        uint8_t& out_num_attempts_;
+
+    public:
+        NodeToQuerySelector(const NodeDiscoverer& owner, NodeID& out_node_id, uint8_t& out_num_attempts)
+            : owner_(owner)
+            , out_node_id_(out_node_id)
+            , out_num_attempts_(out_num_attempts)
+        { }
+
+        bool operator()(const NodeID& node_id, const NodeData& data) const
+        {
+            if ((!out_node_id_.isUnicast() || (data.num_get_node_info_attempts < out_num_attempts_)) &&
+                owner_.canQueryNow(node_id))
+            {
+                out_node_id_ = node_id;
+                out_num_attempts_ = data.num_get_node_info_attempts;
+            }
+            return false;       // The whole map is traversed
+        }
+    };
+
     /*
      * States
      */
@@ -106,6 +146,12 @@ class NodeDiscoverer : TimerBase
     ServiceClient<protocol::GetNodeInfo, GetNodeInfoResponseCallback> get_node_info_client_;
     Subscriber<protocol::NodeStatus, NodeStatusCallback> node_status_sub_;
 
+    NodeInfoRetriever* node_info_retriever_;
+
+    uint8_t max_requests_per_interval_;
+    uint8_t requests_per_interval_;
+    uint8_t num_successes_at_current_rate_;
+
     /*
      * Methods
      */
@@ -119,11 +165,43 @@ class NodeDiscoverer : TimerBase
         trace(TraceDiscoveryNodeRemoved, node_id.get());
     }
 
+    /**
+     * The nodes that will be queried by the node info retriever are not queried, unless it retries indefinitely.
+     */
+    bool canQueryNow(NodeID node_id) const
+    {
+        if (get_node_info_client_.hasPendingCallToServer(node_id))
+        {
+            return false;
+        }
+        return (node_info_retriever_ == NULL) ||
+               (node_info_retriever_->getNumRequestAttempts() == NodeInfoRetriever::UnlimitedRequestAttempts) ||
+               !node_info_retriever_->isNodeInfoRequestNeeded(node_id);
+    }
+
     NodeID pickNextNodeToQuery() const
     {
-        // This essentially means that we pick first available node. Remember that the map is unordered.
-        const NodeMap::KVPair* const pair = node_map_.getByIndex(0);
-        return (pair == NULL) ? NodeID() : pair->key;
+        NodeID node_id;
+        uint8_t num_attempts = 0;
+        (void)node_map_.find(NodeToQuerySelector(*this, node_id, num_attempts));
+        return node_id;
+    }
+
+    void reduceRequestRate()
+    {
+        requests_per_interval_ = max(uint8_t(requests_per_interval_ / 2U), uint8_t(1));
+        num_successes_at_current_rate_ = 0;
+    }
+
+    void increaseRequestRate()
+    {
+        num_successes_at_current_rate_++;
+        if ((num_successes_at_current_rate_ >= requests_per_interval_) &&
+            (requests_per_interval_ < max_requests_per_interval_))
+        {
+            requests_per_interval_++;
+            num_successes_at_current_rate_ = 0;
+        }
     }
 
     bool needToQuery(NodeID node_id)
@@ -209,11 +287,13 @@ class NodeDiscoverer : TimerBase
         {
             UAVCAN_TRACE("dynamic_node_id_server::NodeDiscoverer", "GetNodeInfo response from %d",
                          int(result.getCallID().server_node_id.get()));
+            increaseRequestRate();
             finalizeNodeDiscovery(&result.getResponse().hardware_version.unique_id, result.getCallID().server_node_id);
         }
         else
         {
             trace(TraceDiscoveryGetNodeInfoFailure, result.getCallID().server_node_id.get());
+            reduceRequestRate();
 
             NodeData* const data = node_map_.access(result.getCallID().server_node_id);
             if (data == NULL)
@@ -235,32 +315,30 @@ class NodeDiscoverer : TimerBase
 
     void handleTimerEvent(const TimerEvent&)
     {
-        if (get_node_info_client_.hasPendingCalls())
+        for (uint8_t i = 0; i < requests_per_interval_; i++)
         {
-            return;
-        }
+            const NodeID node_id = pickNextNodeToQueryAndCleanupMap();
+            if (!node_id.isUnicast() || !handler_.canDiscoverNewNodes())
+            {
+                break;  // Timer must continue to run while there are unknown nodes, in order to not stuck
+            }
 
-        const NodeID node_id = pickNextNodeToQueryAndCleanupMap();
-        if (!node_id.isUnicast())
-        {
-            trace(TraceDiscoveryTimerStop, 0);
-            stop();
-            return;
-        }
+            trace(TraceDiscoveryGetNodeInfoRequest, node_id.get());
 
-        if (!handler_.canDiscoverNewNodes())
-        {
-            return;     // Timer must continue to run in order to not stuck when it unlocks
+            UAVCAN_TRACE("dynamic_node_id_server::NodeDiscoverer", "Requesting GetNodeInfo from node %d",
+                         int(node_id.get()));
+            const int res = get_node_info_client_.call(node_id, protocol::GetNodeInfo::Request());
+            if (res < 0)
+            {
+                getNode().registerInternalFailure("NodeDiscoverer GetNodeInfo call");
+                break;
+            }
         }
 
-        trace(TraceDiscoveryGetNodeInfoRequest, node_id.get());
-
-        UAVCAN_TRACE("dynamic_node_id_server::NodeDiscoverer", "Requesting GetNodeInfo from node %d",
-                     int(node_id.get()));
-        const int res = get_node_info_client_.call(node_id, protocol::GetNodeInfo::Request());
-        if (res < 0)
+        if (node_map_.isEmpty())
         {
-            getNode().registerInternalFailure("NodeDiscoverer GetNodeInfo call");
+            trace(TraceDiscoveryTimerStop, 0);
+            stop();
         }
     }
 
@@ -299,6 +377,27 @@ class NodeDiscoverer : TimerBase
         }
     }
 
+    /*
+     * Methods of INodeInfoListener; only the nodes that are being discovered are of interest
+     */
+    virtual void handleNodeInfoRetrieved(NodeID node_id, const protocol::GetNodeInfo::Response& node_info)
+    {
+        if (handler_.canDiscoverNewNodes() && (node_map_.access(node_id) != NULL))
+        {
+            UAVCAN_TRACE("dynamic_node_id_server::NodeDiscoverer", "Node info of %d shared by the retriever",
+                         int(node_id.get()));
+            finalizeNodeDiscovery(&node_info.hardware_version.unique_id, node_id);
+        }
+    }
+
+    virtual void handleNodeInfoUnavailable(NodeID node_id)
+    {
+        if (handler_.canDiscoverNewNodes() && (node_map_.access(node_id) != NULL))
+        {
+            finalizeNodeDiscovery(NULL, node_id);
+        }
+    }
+
 public:
     NodeDiscoverer(INode& node, IEventTracer& tracer, INodeDiscoveryHandler& handler)
         : TimerBase(node)
@@ -307,8 +406,14 @@ public:
         , node_map_(node.getAllocator())
         , get_node_info_client_(node)
         , node_status_sub_(node)
+        , node_info_retriever_(NULL)
+        , max_requests_per_interval_(DefaultMaxRequestsPerInterval)
+        , requests_per_interval_(1)
+        , num_successes_at_current_rate_(0)
     { }
 
+    ~NodeDiscoverer() { (void)setNodeInfoRetriever(NULL); }
+
     int init(const TransferPriority priority)
     {
         int res = get_node_info_client_.init(priority);
@@ -330,6 +435,49 @@ public:
         return 0;
     }
 
+    /**
+     * Makes the discoverer use the node info obtained by the retriever instead of querying the nodes that the
+     * retriever is going to query anyway. The retriever must outlive the discoverer, or it must be removed by
+     * passing a null pointer. There is no retriever by default.
+     * Returns negative error code.
+     */
+    int setNodeInfoRetriever(NodeInfoRetriever* retriever)
+    {
+        if (node_info_retriever_ != NULL)
+        {
+            node_info_retriever_->removeListener(this);
+            node_info_retriever_ = NULL;
+        }
+        if (retriever != NULL)
+        {
+            const int res = retriever->addListener(this);
+            if (res < 0)
+            {
+                return res;
+            }
+            node_info_retriever_ = retriever;
+        }
+        return 0;
+    }
+
+    NodeInfoRetriever* getNodeInfoRetriever() const { return node_info_retriever_; }
+
+    /**
+     * Upper limit for the adaptive number of requests per poll interval; refer to the class documentation.
+     * Setting it to one disables the adaptation. The value cannot be less than one.
+     */
+    uint8_t getMaxRequestsPerInterval() const { return max_requests_per_interval_; }
+    void setMaxRequestsPerInterval(const uint8_t num)
+    {
+        max_requests_per_interval_ = max(num, uint8_t(1));
+        requests_per_interval_ = min(requests_per_interval_, max_requests_per_interval_);
+    }
+
+    /**
+     * Current number of requests per poll interval, as defined by the adaptation logic.
+     */
+    uint8_t getRequestsPerInterval() const { return requests_per_interval_; }
+
     /**
      * Returns true if there's at least one node with pending GetNodeInfo.
      */
@@ -53,6 +53,17 @@ public:
      */
     virtual void set(const String& key, const String& value) = 0;
 
+    /**
+     * The server calls these methods around groups of set() calls that must be stored together, e.g. all fields of
+     * a Raft log entry. This allows the backend to write the group at once and synchronize the storage only once
+     * per group, rather than once per value. Batches are never nested; get() may be called within a batch, in which
+     * case it must return the values that were set within the batch.
+     * The commit method returns negative error code if the batch could not be stored; the backend that does not
+     * support batches stores every value independently and does nothing here, which is the default behavior.
+     */
+    virtual void beginBatch() { }
+    virtual int commitBatch() { return 0; }
+
     virtual ~IStorageBackend() { }
 };
 
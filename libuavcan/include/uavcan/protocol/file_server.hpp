@@ -9,6 +9,7 @@
 #include <uavcan/debug.hpp>
 #include <uavcan/node/service_server.hpp>
 #include <uavcan/util/method_binder.hpp>
+#include <uavcan/util/map.hpp>
 // UAVCAN types
 #include <uavcan/protocol/file/GetInfo.hpp>
 #include <uavcan/protocol/file/GetDirectoryEntryInfo.hpp>
@@ -103,6 +104,36 @@ public:
     virtual ~IFileServerBackend() { }
 };
 
+/**
+ * Statistics of read requests from one client of the file server, e.g. a node that is downloading a firmware image.
+ * The request rate shows how close the client is to the limit of its request pipeline.
+ *
+ * A new session begins with the first request after a pause longer than
+ * @ref BasicFileServer::getReadSessionTimeout(); the counters of the previous session are discarded.
+ */
+struct UAVCAN_EXPORT FileServerReadStats
+{
+    MonotonicTime session_start;        ///< Reception time of the first request of the session
+    MonotonicTime last_request;         ///< Reception time of the last request
+    uint32_t num_requests;              ///< Requests in the current session
+    uint32_t num_bytes;                 ///< Bytes read in the current session
+
+    FileServerReadStats()
+        : num_requests(0)
+        , num_bytes(0)
+    { }
+
+    /**
+     * Average request rate of the current session, requests per second.
+     * Returns zero if there were less than two requests.
+     */
+    float getRequestRate() const
+    {
+        const int64_t usec = (last_request - session_start).toUSec();
+        return (usec > 0) ? (float(num_requests - 1U) * 1e6F / float(usec)) : 0.0F;
+    }
+};
+
 /**
  * Basic file server implements only the following services:
  *      uavcan.protocol.file.GetInfo
@@ -116,18 +147,44 @@ class BasicFileServer
             GetInfoCallback;
 
     typedef MethodBinder<BasicFileServer*,
-        void (BasicFileServer::*)(const protocol::file::Read::Request&, protocol::file::Read::Response&)>
+        void (BasicFileServer::*)(const ReceivedDataStructure<protocol::file::Read::Request>&,
+                                  protocol::file::Read::Response&)>
             ReadCallback;
 
     ServiceServer<protocol::file::GetInfo, GetInfoCallback> get_info_srv_;
     ServiceServer<protocol::file::Read, ReadCallback> read_srv_;
 
+    Map<NodeID, FileServerReadStats> read_stats_;
+
     void handleGetInfo(const protocol::file::GetInfo::Request& req, protocol::file::GetInfo::Response& resp)
     {
         resp.error.value = backend_.getInfo(req.path.path, resp.size, resp.entry_type);
     }
 
-    void handleRead(const protocol::file::Read::Request& req, protocol::file::Read::Response& resp)
+    void updateReadStats(NodeID client_node_id, MonotonicTime timestamp, unsigned num_bytes)
+    {
+        FileServerReadStats* stats = read_stats_.access(client_node_id);
+        if (stats == NULL)
+        {
+            stats = read_stats_.insert(client_node_id, FileServerReadStats());
+            if (stats == NULL)
+            {
+                return;                             // Out of memory - the statistics are not essential
+            }
+        }
+
+        if ((stats->num_requests == 0) || ((timestamp - stats->last_request) > getReadSessionTimeout()))
+        {
+            *stats = FileServerReadStats();
+            stats->session_start = timestamp;
+        }
+        stats->last_request = timestamp;
+        stats->num_requests++;
+        stats->num_bytes += num_bytes;
+    }
+
+    void handleRead(const ReceivedDataStructure<protocol::file::Read::Request>& req,
+                    protocol::file::Read::Response& resp)
     {
         uint16_t inout_size = resp.data.capacity();
 
@@ -149,6 +206,8 @@ class BasicFileServer
         {
             resp.data.resize(inout_size);
         }
+
+        updateReadStats(req.getSrcNodeID(), req.getMonotonicTimestamp(), resp.data.size());
     }
 
 protected:
@@ -158,6 +217,7 @@ public:
     BasicFileServer(INode& node, IFileServerBackend& backend)
         : get_info_srv_(node)
         , read_srv_(node)
+        , read_stats_(node.getAllocator())
         , backend_(backend)
     { }
 
@@ -177,6 +237,38 @@ public:
 
         return 0;
     }
+
+    /**
+     * Pause between read requests of a client after which a new statistics session begins.
+     */
+    static MonotonicDuration getReadSessionTimeout() { return MonotonicDuration::fromMSec(5000); }
+
+    /**
+     * Read statistics of the specified client. If the client has not read anything, all counters are zero.
+     * Statistics are kept in the node's memory pool, one entry per client.
+     */
+    FileServerReadStats getReadStats(NodeID client_node_id)
+    {
+        const FileServerReadStats* const stats = read_stats_.access(client_node_id);
+        return (stats == NULL) ? FileServerReadStats() : *stats;
+    }
+
+    /**
+     * Allows to traverse the clients that have read something since the last reset of the statistics.
+     * If the index is out of range, an invalid node ID will be returned.
+     */
+    NodeID getReadClientByIndex(unsigned index) const
+    {
+        const Map<NodeID, FileServerReadStats>::KVPair* const kv = read_stats_.getByIndex(index);
+        return (kv == NULL) ? NodeID() : kv->key;
+    }
+
+    unsigned getNumReadClients() const { return read_stats_.getSize(); }
+
+    /**
+     * Releases the memory used by the read statistics.
+     */
+    void resetReadStats() { read_stats_.clear(); }
 };
 
 /**
@@ -225,6 +317,12 @@ class FileServer : protected BasicFileServer
     }
 
 public:
+    using BasicFileServer::getReadSessionTimeout;
+    using BasicFileServer::getReadStats;
+    using BasicFileServer::getReadClientByIndex;
+    using BasicFileServer::getNumReadClients;
+    using BasicFileServer::resetReadStats;
+
     FileServer(INode& node, IFileServerBackend& backend)
         : BasicFileServer(node, backend)
         , write_srv_(node)
@@ -0,0 +1,459 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_PROTOCOL_FIRMWARE_BROADCASTER_HPP_INCLUDED
+#define UAVCAN_PROTOCOL_FIRMWARE_BROADCASTER_HPP_INCLUDED
+
+#include <uavcan/build_config.hpp>
+#include <uavcan/debug.hpp>
+#include <uavcan/node/publisher.hpp>
+#include <uavcan/node/subscriber.hpp>
+#include <uavcan/node/service_client.hpp>
+#include <uavcan/node/timer.hpp>
+#include <uavcan/transport/crc.hpp>
+#include <uavcan/util/bitset.hpp>
+#include <uavcan/util/method_binder.hpp>
+#include <uavcan/protocol/file_server.hpp>
+
+namespace uavcan
+{
+/**
+ * Identifies a firmware image in the broadcast stream; both sides compute it from the image path.
+ * This is CRC-16-CCITT of the path, the same one that is used for the transfers.
+ */
+inline uint16_t computeFirmwareImagePathCRC(const IFileServerBackend::Path& path)
+{
+    TransferCRC crc;
+    crc.add(path.begin(), path.size());
+    return crc.get();
+}
+
+/**
+ * Broadcasts a firmware image in chunks, so that many identical nodes can receive it at once, rather than
+ * reading it separately via uavcan.protocol.file.Read. This way the bus time required to update N nodes does not
+ * depend on N. The nodes that missed some chunks can read them via uavcan.protocol.file.Read from the file server
+ * that uses the same backend; refer to @ref FirmwareBroadcastListener.
+ *
+ * There is no standard message type for this purpose, so the application must provide a vendor-specific one.
+ * The message type must contain the following fields:
+ *
+ *      uint16 path_crc         # See computeFirmwareImagePathCRC()
+ *      uint40 offset           # Multiple of IFileServerBackend::ReadSize
+ *      uint8[<=256] data       # Shorter than 256 bytes (possibly empty) only at the end of the image
+ *
+ * The application would normally start the broadcaster once @ref IFirmwareVersionChecker decides that the nodes
+ * need to be updated with the image, and let @ref FirmwareUpdateTrigger request the update from them as usual.
+ *
+ * @tparam DataType_        Message type, see above.
+ */
+template <typename DataType_>
+class UAVCAN_EXPORT FirmwareBroadcaster : private TimerBase
+{
+public:
+    typedef DataType_ DataType;
+
+private:
+    Publisher<DataType> pub_;
+    IFileServerBackend& backend_;
+    IFileServerBackend::Path path_;
+    DataType msg_;
+    uint64_t offset_;
+    uint8_t num_passes_left_;
+
+    virtual void handleTimerEvent(const TimerEvent&)
+    {
+        msg_.offset = offset_;
+        uint16_t size = uint16_t(msg_.data.capacity());
+        msg_.data.resize(size);
+
+        const int16_t read_res = backend_.read(path_, offset_, msg_.data.begin(), size);
+        if ((read_res != 0) || (size > msg_.data.capacity()))
+        {
+            UAVCAN_TRACE("FirmwareBroadcaster", "Failed to read the image at offset %llu, error %i",
+                         static_cast<unsigned long long>(offset_), int(read_res));
+            stop();
+            return;
+        }
+        msg_.data.resize(size);
+
+        const int res = pub_.broadcast(msg_);
+        if (res < 0)
+        {
+            UAVCAN_TRACE("FirmwareBroadcaster", "Failed to broadcast the chunk at offset %llu, error %i",
+                         static_cast<unsigned long long>(offset_), res);
+            return;                             // The same chunk will be repeated next time
+        }
+
+        if (size < msg_.data.capacity())        // End of the image
+        {
+            offset_ = 0;
+            num_passes_left_--;
+            if (num_passes_left_ == 0)
+            {
+                UAVCAN_TRACE("FirmwareBroadcaster", "Finished");
+                stop();
+            }
+        }
+        else
+        {
+            offset_ += size;
+        }
+    }
+
+public:
+    FirmwareBroadcaster(INode& node, IFileServerBackend& backend)
+        : TimerBase(node)
+        , pub_(node)
+        , backend_(backend)
+        , offset_(0)
+        , num_passes_left_(0)
+    {
+        StaticAssert<(unsigned(DataType::FieldTypes::data::MaxSize) == unsigned(IFileServerBackend::ReadSize))>::check();
+    }
+
+    /**
+     * Chunks are broadcasted at this interval by default; a chunk takes roughly 40 CAN frames.
+     */
+    static MonotonicDuration getDefaultChunkInterval() { return MonotonicDuration::fromMSec(20); }
+
+    /**
+     * Starts broadcasting the image from the beginning. If the broadcaster is already running, it will be restarted.
+     * @param path              Path of the image, as it will be requested by the nodes via uavcan.protocol.file.Read.
+     * @param num_passes        How many times the whole image will be broadcasted. Late joiners will get the beginning
+     *                          of the image in the next pass, or read it from the file server.
+     * @param chunk_interval    Interval between chunks; this defines the bus load.
+     * @param priority          Transfer priority. The lowest one is used by default.
+     * Returns negative error code.
+     */
+    int start(const IFileServerBackend::Path& path,
+              uint8_t num_passes = 1,
+              MonotonicDuration chunk_interval = getDefaultChunkInterval(),
+              const TransferPriority priority = TransferPriority::Lowest)
+    {
+        if (path.empty() || (num_passes == 0) || !chunk_interval.isPositive())
+        {
+            return -ErrInvalidParam;
+        }
+
+        const int res = pub_.init(priority);
+        if (res < 0)
+        {
+            return res;
+        }
+        pub_.setTxTimeout(chunk_interval);
+
+        path_ = path;
+        msg_ = DataType();
+        msg_.path_crc = computeFirmwareImagePathCRC(path_);
+        offset_ = 0;
+        num_passes_left_ = num_passes;
+
+        UAVCAN_TRACE("FirmwareBroadcaster", "Starting; path_crc=0x%04x", unsigned(msg_.path_crc));
+        startPeriodic(chunk_interval);
+        return 0;
+    }
+
+    using TimerBase::stop;
+    using TimerBase::isRunning;
+
+    /**
+     * Offset of the next chunk to broadcast.
+     */
+    uint64_t getOffset() const { return offset_; }
+
+    uint8_t getNumPassesLeft() const { return num_passes_left_; }
+
+    const IFileServerBackend::Path& getPath() const { return path_; }
+};
+
+
+/**
+ * Firmware images received via @ref FirmwareBroadcastListener are written through this interface.
+ */
+class UAVCAN_EXPORT IFirmwareImageWriter
+{
+public:
+    /**
+     * Chunks can be written in any order, but every chunk is written only once.
+     * @param offset    Offset of the chunk, multiple of IFileServerBackend::ReadSize
+     * @return          Negative value on failure; this aborts the reception.
+     */
+    virtual int write(uint64_t offset, const uint8_t* data, uint16_t size) = 0;
+
+    /**
+     * Called once all chunks of the image have been written.
+     */
+    virtual void handleImageReceived(uint64_t image_size) = 0;
+
+    /**
+     * Called if the image could not be received, e.g. because it's too large, the file server does not respond,
+     * or the writer has failed.
+     */
+    virtual void handleImageReceptionFailure() = 0;
+
+    virtual ~IFirmwareImageWriter() { }
+};
+
+/**
+ * Receives a firmware image broadcasted by @ref FirmwareBroadcaster. The chunks that were missed, e.g. because
+ * the node joined in the middle of the broadcast, are read via uavcan.protocol.file.Read from the same server
+ * once the broadcast stops for @ref getBroadcastTimeout(). Repair requests are made one at a time.
+ *
+ * The image path is normally provided by uavcan.protocol.file.BeginFirmwareUpdate.
+ *
+ * @tparam DataType_        Message type, see @ref FirmwareBroadcaster.
+ * @tparam MaxImageSize_    Maximum size of the image, in bytes. The listener keeps one bit per chunk.
+ */
+template <typename DataType_, unsigned MaxImageSize_ = 1048576>
+class UAVCAN_EXPORT FirmwareBroadcastListener : private TimerBase
+{
+public:
+    typedef DataType_ DataType;
+
+    enum { MaxImageSize = MaxImageSize_ };
+    enum { MaxRepairAttempts = 3 };
+
+private:
+    typedef MethodBinder<FirmwareBroadcastListener*,
+                         void (FirmwareBroadcastListener::*)(const ReceivedDataStructure<DataType>&)>
+            ChunkCallback;
+
+    typedef MethodBinder<FirmwareBroadcastListener*,
+                         void (FirmwareBroadcastListener::*)(const ServiceCallResult<protocol::file::Read>&)>
+            ReadCallback;
+
+    enum { ChunkSize = IFileServerBackend::ReadSize };
+    enum { MaxChunks = (MaxImageSize + ChunkSize - 1) / ChunkSize };
+
+    Subscriber<DataType, ChunkCallback> sub_;
+    ServiceClient<protocol::file::Read, ReadCallback> read_client_;
+    IFirmwareImageWriter& writer_;
+    BitSet<MaxChunks> received_chunks_;
+    IFileServerBackend::Path path_;
+    MonotonicTime last_chunk_ts_;
+    uint64_t image_size_;                       ///< Valid only if the end of the image is known
+    uint64_t repair_offset_;
+    uint32_t num_received_chunks_;
+    NodeID server_node_id_;                     ///< Invalid if not running
+    uint16_t path_crc_;
+    uint8_t num_repair_failures_;               ///< Consecutive
+    bool end_known_;
+
+    uint32_t getNumChunks() const
+    {
+        return end_known_ ? uint32_t((image_size_ + ChunkSize - 1U) / ChunkSize) : uint32_t(MaxChunks);
+    }
+
+    void fail()
+    {
+        UAVCAN_TRACE("FirmwareBroadcastListener", "Failure");
+        stop();
+        writer_.handleImageReceptionFailure();
+    }
+
+    /**
+     * Returns false if the reception has been aborted.
+     */
+    bool acceptChunk(uint64_t offset, const uint8_t* data, uint16_t size)
+    {
+        if ((offset % ChunkSize) != 0)
+        {
+            return true;                        // Not produced by FirmwareBroadcaster, ignoring
+        }
+        const uint64_t index = offset / ChunkSize;
+
+        if (size < ChunkSize)
+        {
+            end_known_ = true;
+            image_size_ = offset + size;
+        }
+        if (size == 0)
+        {
+            return true;
+        }
+        if (index >= MaxChunks)
+        {
+            UAVCAN_TRACE("FirmwareBroadcastListener", "Image is too large");
+            fail();
+            return false;
+        }
+
+        if (!received_chunks_.test(std::size_t(index)))
+        {
+            if (writer_.write(offset, data, size) < 0)
+            {
+                fail();
+                return false;
+            }
+            received_chunks_.set(std::size_t(index));
+            num_received_chunks_++;
+        }
+
+        if (end_known_ && (num_received_chunks_ >= getNumChunks()))
+        {
+            UAVCAN_TRACE("FirmwareBroadcastListener", "Image received, %llu bytes",
+                         static_cast<unsigned long long>(image_size_));
+            stop();
+            writer_.handleImageReceived(image_size_);
+            return false;
+        }
+        return true;
+    }
+
+    void requestMissingChunk()
+    {
+        const uint32_t num_chunks = getNumChunks();
+        uint32_t index = 0;
+        while ((index < num_chunks) && received_chunks_.test(index))
+        {
+            index++;
+        }
+        // If all chunks are received but the end is still unknown, this reads the terminating empty chunk
+
+        protocol::file::Read::Request request;
+        request.offset = uint64_t(index) * ChunkSize;
+        request.path.path = path_;
+
+        const int res = read_client_.call(server_node_id_, request);
+        if (res < 0)
+        {
+            UAVCAN_TRACE("FirmwareBroadcastListener", "Failed to request the chunk %u, error %i", unsigned(index), res);
+            fail();
+            return;
+        }
+        repair_offset_ = request.offset;
+    }
+
+    bool isBroadcastIdle() const
+    {
+        return (sub_.getNode().getMonotonicTime() - last_chunk_ts_) >= getBroadcastTimeout();
+    }
+
+    void handleChunk(const ReceivedDataStructure<DataType>& msg)
+    {
+        if ((msg.getSrcNodeID() != server_node_id_) || (msg.path_crc != path_crc_))
+        {
+            return;
+        }
+        last_chunk_ts_ = msg.getMonotonicTimestamp();
+        (void)acceptChunk(msg.offset, msg.data.begin(), uint16_t(msg.data.size()));
+    }
+
+    void handleReadResult(const ServiceCallResult<protocol::file::Read>& result)
+    {
+        if (!result.isSuccessful())
+        {
+            num_repair_failures_++;
+            if (num_repair_failures_ >= MaxRepairAttempts)
+            {
+                fail();
+            }
+            return;                             // Will be repeated by the timer
+        }
+        num_repair_failures_ = 0;
+
+        const protocol::file::Read::Response& resp = result.getResponse();
+        if (resp.error.value != protocol::file::Error::OK)
+        {
+            UAVCAN_TRACE("FirmwareBroadcastListener", "File read error %i", int(resp.error.value));
+            fail();
+            return;
+        }
+
+        if (acceptChunk(repair_offset_, resp.data.begin(), uint16_t(resp.data.size())) && isBroadcastIdle())
+        {
+            requestMissingChunk();
+        }
+    }
+
+    virtual void handleTimerEvent(const TimerEvent&)
+    {
+        if (!read_client_.hasPendingCalls() && isBroadcastIdle())
+        {
+            requestMissingChunk();
+        }
+    }
+
+public:
+    FirmwareBroadcastListener(INode& node, IFirmwareImageWriter& writer)
+        : TimerBase(node)
+        , sub_(node)
+        , read_client_(node)
+        , writer_(writer)
+        , image_size_(0)
+        , repair_offset_(0)
+        , num_received_chunks_(0)
+        , path_crc_(0)
+        , num_repair_failures_(0)
+        , end_known_(false)
+    {
+        StaticAssert<(unsigned(DataType::FieldTypes::data::MaxSize) == unsigned(IFileServerBackend::ReadSize))>::check();
+    }
+
+    /**
+     * If the broadcast stops for this long, the missing chunks will be read from the server.
+     */
+    static MonotonicDuration getBroadcastTimeout() { return MonotonicDuration::fromMSec(1000); }
+
+    /**
+     * Starts receiving the image. If the listener is already running, the reception will be restarted.
+     * Note that if nothing is being broadcasted, the image will be read from the server after the broadcast timeout.
+     * @param server_node_id    Node ID of the file server that broadcasts the image.
+     * @param path              Path of the image on the file server.
+     * Returns negative error code.
+     */
+    int start(NodeID server_node_id, const IFileServerBackend::Path& path)
+    {
+        if (!server_node_id.isUnicast() || path.empty())
+        {
+            return -ErrInvalidParam;
+        }
+        stop();
+
+        int res = sub_.start(ChunkCallback(this, &FirmwareBroadcastListener::handleChunk));
+        if (res < 0)
+        {
+            return res;
+        }
+        res = read_client_.init();
+        if (res < 0)
+        {
+            sub_.stop();
+            return res;
+        }
+        read_client_.setCallback(ReadCallback(this, &FirmwareBroadcastListener::handleReadResult));
+
+        path_ = path;
+        path_crc_ = computeFirmwareImagePathCRC(path);
+        server_node_id_ = server_node_id;
+        received_chunks_.reset();
+        num_received_chunks_ = 0;
+        image_size_ = 0;
+        end_known_ = false;
+        num_repair_failures_ = 0;
+        last_chunk_ts_ = sub_.getNode().getMonotonicTime();
+
+        startPeriodic(MonotonicDuration::fromUSec(getBroadcastTimeout().toUSec() / 4));
+        return 0;
+    }
+
+    /**
+     * Stops the reception; the writer will not be called afterwards.
+     */
+    void stop()
+    {
+        TimerBase::stop();
+        sub_.stop();
+        read_client_.cancelAllCalls();
+        server_node_id_ = NodeID();
+    }
+
+    bool isRunning() const { return server_node_id_.isUnicast(); }
+
+    uint32_t getNumReceivedChunks() const { return num_received_chunks_; }
+};
+
+}
+
+#endif // UAVCAN_PROTOCOL_FIRMWARE_BROADCASTER_HPP_INCLUDED
@@ -0,0 +1,299 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_PROTOCOL_FIRMWARE_DELTA_HPP_INCLUDED
+#define UAVCAN_PROTOCOL_FIRMWARE_DELTA_HPP_INCLUDED
+
+#include <uavcan/build_config.hpp>
+#include <uavcan/data_type.hpp>
+#include <uavcan/protocol/derived_file_server_backend.hpp>
+
+namespace uavcan
+{
+/**
+ * CRC-64-WE, which identifies the blocks of firmware images; it is the same one that is used for the data type
+ * signatures.
+ */
+typedef DataTypeSignatureCRC FirmwareImageCRC;
+
+/**
+ * Block manifest of a firmware image, which allows a node to download only the blocks of the new image that differ
+ * from its current image, so that the duration of the update scales with the size of the change. The manifest is
+ * served by @ref FirmwareBlockManifestFileServerBackend; its format is as follows, all fields are little endian:
+ *
+ *      'U' 'B' 'M'             Magic
+ *      uint8 block_size_log2   From 8 to 16
+ *      uint32 image_size
+ *      uint64[N] block_crc     CRC-64-WE of every block, see @ref FirmwareImageCRC; the last block may be shorter
+ *      uint64 image_crc        CRC-64-WE of the whole image
+ *
+ * The node that supports delta updates proceeds as follows upon uavcan.protocol.file.BeginFirmwareUpdate:
+ *  1. Reads the manifest, whose path is the path of the image with @ref getFirmwareBlockManifestPathSuffix()
+ *     appended, and feeds it to @ref FirmwareBlockManifestParser; if the manifest is not available, the whole image
+ *     is downloaded.
+ *  2. Compares the block CRCs with the ones of its current image, and downloads only the differing blocks via
+ *     uavcan.protocol.file.Read at the offsets of these blocks; the rest is copied from the current image.
+ *  3. Verifies the image CRC of the result.
+ *
+ * The blocks are aligned to the beginning of the image, so a change that shifts the rest of the image, e.g. an
+ * insertion in the middle of the code, makes all the following blocks differ.
+ * @{
+ */
+static const unsigned FirmwareBlockManifestHeaderSize = 8;
+static const unsigned FirmwareBlockManifestCRCSize = 8;
+static const unsigned FirmwareBlockManifestMinBlockSizeLog2 = 8;
+static const unsigned FirmwareBlockManifestMaxBlockSizeLog2 = 16;
+
+inline const char* getFirmwareBlockManifestPathSuffix() { return ".blocks"; }
+/**
+ * @}
+ */
+
+/**
+ * Adds block manifests of the files to another file server backend, so that the nodes can perform delta updates.
+ * The format of the manifest is described above; it takes 16 bytes plus 8 bytes per block.
+ * Refer to @ref DerivedFileServerBackend for the caching policy.
+ */
+class UAVCAN_EXPORT FirmwareBlockManifestFileServerBackend : public DerivedFileServerBackend
+{
+    FirmwareImageCRC image_crc_;
+    FirmwareImageCRC block_crc_;
+    uint32_t block_fill_;
+    const uint8_t block_size_log2_;
+
+    int appendCRC(const FirmwareImageCRC& crc)
+    {
+        const uint64_t value = crc.get();
+        uint8_t bytes[FirmwareBlockManifestCRCSize];
+        for (unsigned i = 0; i < FirmwareBlockManifestCRCSize; i++)
+        {
+            bytes[i] = uint8_t((value >> (i * 8U)) & 0xFFU);
+        }
+        return appendToCache(bytes, FirmwareBlockManifestCRCSize);
+    }
+
+    virtual int beginDerivedFile(uint32_t source_size)
+    {
+        image_crc_ = FirmwareImageCRC();
+        block_crc_ = FirmwareImageCRC();
+        block_fill_ = 0;
+
+        const uint8_t header[FirmwareBlockManifestHeaderSize] =
+        {
+            'U', 'B', 'M', block_size_log2_,
+            uint8_t(source_size & 0xFFU), uint8_t((source_size >> 8) & 0xFFU),
+            uint8_t((source_size >> 16) & 0xFFU), uint8_t((source_size >> 24) & 0xFFU)
+        };
+        return appendToCache(header, FirmwareBlockManifestHeaderSize);
+    }
+
+    virtual int processSourceChunk(const uint8_t* data, unsigned size)
+    {
+        image_crc_.add(data, size);
+        while (size > 0)
+        {
+            const unsigned n = min(size, unsigned(getBlockSize() - block_fill_));
+            block_crc_.add(data, n);
+            block_fill_ += n;
+            data += n;
+            size -= n;
+            if (block_fill_ == getBlockSize())
+            {
+                const int res = appendCRC(block_crc_);
+                if (res < 0)
+                {
+                    return res;
+                }
+                block_crc_ = FirmwareImageCRC();
+                block_fill_ = 0;
+            }
+        }
+        return 0;
+    }
+
+    virtual int endDerivedFile()
+    {
+        if (block_fill_ > 0)
+        {
+            const int res = appendCRC(block_crc_);
+            if (res < 0)
+            {
+                return res;
+            }
+        }
+        return appendCRC(image_crc_);
+    }
+
+public:
+    /**
+     * @param backend           Backend that provides the firmware images.
+     * @param cache             Buffer for the manifest.
+     * @param cache_size        Size of the buffer in bytes; e.g. 8 KB are enough for 512 KB with 512-byte blocks.
+     * @param block_size_log2   Smaller blocks reduce the amount of data downloaded for a small change, at the cost of
+     *                          a larger manifest.
+     */
+    FirmwareBlockManifestFileServerBackend(IFileServerBackend& backend, uint8_t* cache, uint32_t cache_size,
+                                           uint8_t block_size_log2 = 9)
+        : DerivedFileServerBackend(backend, getFirmwareBlockManifestPathSuffix(), cache, cache_size)
+        , block_fill_(0)
+        , block_size_log2_(uint8_t(max(unsigned(FirmwareBlockManifestMinBlockSizeLog2),
+                                       min(unsigned(block_size_log2), FirmwareBlockManifestMaxBlockSizeLog2))))
+    { }
+
+    uint32_t getBlockSize() const { return 1U << block_size_log2_; }
+};
+
+/**
+ * Receives the block CRCs from @ref FirmwareBlockManifestParser.
+ */
+class UAVCAN_EXPORT IFirmwareBlockHandler
+{
+public:
+    /**
+     * Called for every block of the new image in order. The node would normally compare the CRC with the one of
+     * the same block of its current image, and remember the block for download if they differ.
+     * Returns negative error code; the parsing will be aborted.
+     */
+    virtual int handleFirmwareBlock(uint32_t block_index, uint32_t offset, uint32_t size, uint64_t crc) = 0;
+
+    virtual ~IFirmwareBlockHandler() { }
+};
+
+/**
+ * Streaming parser of the firmware block manifests; the manifest can be fed in chunks of any size, e.g. as they
+ * are received via uavcan.protocol.file.Read. The format is described above.
+ */
+class UAVCAN_EXPORT FirmwareBlockManifestParser
+{
+    uint8_t buffer_[FirmwareBlockManifestCRCSize];
+    uint64_t image_crc_;
+    uint32_t image_size_;
+    uint32_t num_blocks_;
+    uint32_t block_index_;
+    uint8_t buffer_size_;
+    uint8_t block_size_log2_;
+    bool finished_;
+    bool failed_;
+
+    static uint32_t readU32(const uint8_t* p)
+    {
+        return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+    }
+
+    static uint64_t readU64(const uint8_t* p) { return uint64_t(readU32(p)) | (uint64_t(readU32(p + 4)) << 32); }
+
+    bool isHeaderReceived() const { return block_size_log2_ != 0; }
+
+    unsigned getExpectedItemSize() const
+    {
+        return isHeaderReceived() ? FirmwareBlockManifestCRCSize : FirmwareBlockManifestHeaderSize;
+    }
+
+    int handleItem(IFirmwareBlockHandler& handler)
+    {
+        if (!isHeaderReceived())
+        {
+            if ((buffer_[0] != 'U') || (buffer_[1] != 'B') || (buffer_[2] != 'M') ||
+                (buffer_[3] < FirmwareBlockManifestMinBlockSizeLog2) ||
+                (buffer_[3] > FirmwareBlockManifestMaxBlockSizeLog2))
+            {
+                return -ErrInvalidMarshalData;
+            }
+            block_size_log2_ = buffer_[3];
+            image_size_ = readU32(buffer_ + 4);
+            num_blocks_ = uint32_t((uint64_t(image_size_) + getBlockSize() - 1U) >> block_size_log2_);
+            return 0;
+        }
+
+        const uint64_t crc = readU64(buffer_);
+        if (block_index_ == num_blocks_)
+        {
+            image_crc_ = crc;
+            finished_ = true;
+            return 0;
+        }
+
+        const uint32_t offset = block_index_ << block_size_log2_;
+        const uint32_t size = min(getBlockSize(), image_size_ - offset);
+        const int res = handler.handleFirmwareBlock(block_index_, offset, size, crc);
+        block_index_++;
+        return res;
+    }
+
+public:
+    FirmwareBlockManifestParser() { reset(); }
+
+    /**
+     * Prepares the parser for a new manifest.
+     */
+    void reset()
+    {
+        image_crc_ = 0;
+        image_size_ = 0;
+        num_blocks_ = 0;
+        block_index_ = 0;
+        buffer_size_ = 0;
+        block_size_log2_ = 0;
+        finished_ = false;
+        failed_ = false;
+    }
+
+    /**
+     * The handler is invoked for every block whose CRC is contained in the chunk.
+     * The bytes after the end of the manifest are ignored.
+     * Returns negative error code; the manifest cannot be continued after an error:
+     *  - @ref ErrInvalidMarshalData if the manifest is malformed;
+     *  - the error returned by the handler.
+     */
+    int feed(const uint8_t* data, unsigned size, IFirmwareBlockHandler& handler)
+    {
+        if (failed_)
+        {
+            return -ErrLogic;
+        }
+        if ((data == NULL) && (size > 0))
+        {
+            return -ErrInvalidParam;
+        }
+
+        for (unsigned i = 0; (i < size) && !finished_; i++)
+        {
+            buffer_[buffer_size_++] = data[i];
+            if (buffer_size_ == getExpectedItemSize())
+            {
+                const int res = handleItem(handler);
+                buffer_size_ = 0;
+                if (res < 0)
+                {
+                    failed_ = true;
+                    return res;
+                }
+            }
+        }
+        return 0;
+    }
+
+    bool isFinished() const { return finished_; }
+
+    /**
+     * These values are valid once the header is received.
+     * @{
+     */
+    uint32_t getImageSize() const { return image_size_; }
+    uint32_t getBlockSize() const { return isHeaderReceived() ? (1U << block_size_log2_) : 0U; }
+    uint32_t getNumBlocks() const { return num_blocks_; }
+    /**
+     * @}
+     */
+
+    /**
+     * CRC-64-WE of the whole new image, that should be used to verify the result of the update.
+     * Valid once the manifest is finished.
+     */
+    uint64_t getImageCRC() const { return image_crc_; }
+};
+
+}
+
+#endif // Include guard
@@ -9,7 +9,8 @@
 #include <uavcan/debug.hpp>
 #include <uavcan/node/service_client.hpp>
 #include <uavcan/util/method_binder.hpp>
-#include <uavcan/util/map.hpp>
+#include <uavcan/util/linked_list.hpp>
+#include <uavcan/util/placement_new.hpp>
 #include <uavcan/protocol/node_info_retriever.hpp>
 // UAVCAN types
 #include <uavcan/protocol/file/BeginFirmwareUpdate.hpp>
@@ -24,8 +25,8 @@ class IFirmwareVersionChecker
 {
 public:
     /**
-     * This value is limited by the pool block size minus some extra data. Please refer to the Map<> documentation
-     * for details. If this size is set too high, the compilation will fail in the Map<> template.
+     * This value is limited by the pool block size minus some extra data, because every distinct path is stored in
+     * one pool block. If this size is set too high, the compilation will fail in @ref FirmwareUpdateTrigger.
      */
     enum { MaxFirmwareFilePathLength = 40 };
 
@@ -101,8 +102,10 @@ public:
  * updates. The decision process of whether a firmware update is needed is relayed to the application via
  * @ref IFirmwareVersionChecker. If the application confirms that the update is needed, this class will begin
  * sending uavcan.protocol.file.BeginFirmwareUpdate periodically (period is configurable) to every node that
- * needs an update in a round-robin fashion. There are the following termination conditions for the periodical
- * sending process:
+ * needs an update. Requests to different nodes are sent concurrently, in a round-robin fashion, so that a large
+ * number of nodes is triggered in one pass; the number of concurrent requests and the rate at which requests are
+ * sent are limited, refer to @ref setMaxConcurrentRequests() and @ref setRequestSpacing(). There are the following
+ * termination conditions for the periodical sending process:
  *
  * - The node responds with confirmation. In this case the class will forget about the node on the assumption
  *   that its job is done here. Confirmation will be reported to the application via the interface.
@@ -126,8 +129,14 @@ public:
  * - dynamic node ID allocation server;
  * - file server.
  *
- * Implementation details: the class uses memory pool to keep the list of nodes that have not responded yet, which
- * limits the maximum length of the path to the firmware file, which is covered in @ref IFirmwareVersionChecker.
+ * The file server can also offer compressed images to the nodes that support them, which reduces the update time
+ * and the bus load; refer to @ref CompressedFileServerBackend. This does not affect this class, because the nodes
+ * negotiate the compression with the file server themselves, so the path of the original image is sent as usual.
+ *
+ * Implementation details: the pending nodes are kept in a table indexed by node ID, so the cost of every request
+ * does not depend on the number of pending nodes. The firmware paths are kept in the memory pool, one block per
+ * distinct path, which limits the maximum length of the path to the firmware file, which is covered in
+ * @ref IFirmwareVersionChecker.
  * To somewhat relieve the maximum path length limitation, the class can be supplied with a common prefix that
  * will be prepended to firmware pathes before sending requests.
  * Interval at which requests are being sent is configurable, but the default value should cover the needs of
@@ -143,30 +152,34 @@ class FirmwareUpdateTrigger : public INodeInfoListener,
     typedef IFirmwareVersionChecker::FirmwareFilePath FirmwareFilePath;
 
     enum { DefaultRequestIntervalMs = 1000 };   ///< Shall not be less than default service response timeout.
+    enum { DefaultRequestSpacingMs = 10 };
+    enum { DefaultMaxConcurrentRequests = 8 };
 
-    struct NextNodeIDSearchPredicate : ::uavcan::Noncopyable
+    /**
+     * Firmware paths are shared between the nodes that are updated with the same image, which is the usual case
+     * for large fleets; every entry occupies one pool block.
+     */
+    struct PathEntry : LinkedListNode<PathEntry>
     {
-        enum { DefaultOutput = 0xFFU };
+        FirmwareFilePath path;
+        uint8_t ref_count;
 
-        const FirmwareUpdateTrigger& owner;
-        uint8_t output;
-
-        NextNodeIDSearchPredicate(const FirmwareUpdateTrigger& arg_owner)
-            : owner(arg_owner)
-            , output(DefaultOutput)
-        { }
-
-        bool operator()(const NodeID node_id, const FirmwareFilePath&)
+        explicit PathEntry(const FirmwareFilePath& arg_path)
+            : path(arg_path)
+            , ref_count(0)
         {
-            if (node_id.get() > owner.last_queried_node_id_ &&
-                !owner.begin_fw_update_client_.hasPendingCallToServer(node_id))
-            {
-                output = min(output, node_id.get());
-            }
-            return false;
+            IsDynamicallyAllocatable<PathEntry>::check();
         }
     };
 
+    struct Entry
+    {
+        PathEntry* path;                    ///< NULL if the node is not pending
+        MonotonicTime last_request_at;
+
+        Entry() : path(NULL) { }
+    };
+
     /*
      * State
      */
@@ -176,13 +189,21 @@ class FirmwareUpdateTrigger : public INodeInfoListener,
 
     NodeInfoRetriever* node_info_retriever_;
 
-    Map<NodeID, FirmwareFilePath> pending_nodes_;
+    Entry entries_[NodeID::Max];            // [1, NodeID::Max]
+
+    LinkedListRoot<PathEntry> paths_;
 
     MonotonicDuration request_interval_;
 
+    MonotonicDuration request_spacing_;
+
     FirmwareFilePath common_path_prefix_;
 
-    mutable uint8_t last_queried_node_id_;
+    uint8_t num_pending_nodes_;
+
+    uint8_t max_concurrent_requests_;
+
+    uint8_t last_queried_node_id_;
 
     /*
      * Methods of INodeInfoListener
@@ -190,7 +211,7 @@ class FirmwareUpdateTrigger : public INodeInfoListener,
     virtual void handleNodeInfoUnavailable(NodeID node_id)
     {
         UAVCAN_TRACE("FirmwareUpdateTrigger", "Node ID %d could not provide GetNodeInfo response", int(node_id.get()));
-        pending_nodes_.remove(node_id); // For extra paranoia
+        removePendingNode(node_id); // For extra paranoia
     }
 
     virtual void handleNodeInfoRetrieved(const NodeID node_id, const protocol::GetNodeInfo::Response& node_info)
@@ -206,7 +227,7 @@ class FirmwareUpdateTrigger : public INodeInfoListener,
         else
         {
             UAVCAN_TRACE("FirmwareUpdateTrigger", "Node ID %d does not need update", int(node_id.get()));
-            pending_nodes_.remove(node_id);
+            removePendingNode(node_id);
         }
     }
 
@@ -214,7 +235,7 @@ class FirmwareUpdateTrigger : public INodeInfoListener,
     {
         if (event.status.mode == protocol::NodeStatus::MODE_OFFLINE)
         {
-            pending_nodes_.remove(event.node_id);
+            removePendingNode(event.node_id);
             UAVCAN_TRACE("FirmwareUpdateTrigger", "Node ID %d is offline hence forgotten", int(event.node_id.get()));
         }
     }
@@ -224,68 +245,135 @@ class FirmwareUpdateTrigger : public INodeInfoListener,
      */
     INode& getNode() { return begin_fw_update_client_.getNode(); }
 
-    void trySetPendingNode(const NodeID node_id, const FirmwareFilePath& path)
+    Entry* getEntry(NodeID node_id)
+    {
+        if (node_id.get() < 1 || node_id.get() > NodeID::Max)
+        {
+            UAVCAN_ASSERT(0);
+            return NULL;
+        }
+        return &entries_[node_id.get() - 1];
+    }
+
+    PathEntry* acquirePath(const FirmwareFilePath& path)
     {
-        if (NULL != pending_nodes_.insert(node_id, path))
+        PathEntry* p = paths_.get();
+        while ((p != NULL) && (p->path != path))
         {
-            if (!TimerBase::isRunning())
+            p = p->getNextListNode();
+        }
+
+        if (p == NULL)
+        {
+            void* const praw = getNode().getAllocator().allocate(sizeof(PathEntry));
+            if (praw == NULL)
             {
-                TimerBase::startPeriodic(request_interval_);
-                UAVCAN_TRACE("FirmwareUpdateTrigger", "Timer started");
+                return NULL;
             }
+            p = new (praw) PathEntry(path);
+            paths_.insertNew(p);
         }
-        else
+
+        p->ref_count++;
+        return p;
+    }
+
+    void releasePath(PathEntry* const p)
+    {
+        UAVCAN_ASSERT((p != NULL) && (p->ref_count > 0));
+        p->ref_count--;
+        if (p->ref_count == 0)
         {
-            getNode().registerInternalFailure("FirmwareUpdateTrigger OOM");
+            paths_.remove(p);
+            p->~PathEntry();
+            getNode().getAllocator().deallocate(p);
         }
     }
 
-    NodeID pickNextNodeID() const
+    void trySetPendingNode(const NodeID node_id, const FirmwareFilePath& path)
     {
-        // We can't do index search because indices are unstable in Map<>
-        // First try - from the current node up
-        NextNodeIDSearchPredicate s1(*this);
-        (void)pending_nodes_.find<NextNodeIDSearchPredicate&>(s1);
+        Entry* const entry = getEntry(node_id);
+        if (entry == NULL)
+        {
+            return;
+        }
 
-        if (s1.output != NextNodeIDSearchPredicate::DefaultOutput)
+        PathEntry* const new_path = acquirePath(path);
+        if (new_path == NULL)
         {
-            last_queried_node_id_ = s1.output;
+            getNode().registerInternalFailure("FirmwareUpdateTrigger OOM");
+            return;
+        }
+
+        if (entry->path != NULL)
+        {
+            releasePath(entry->path);
         }
-        else if (last_queried_node_id_ != 0)
+        else
         {
-            // Nothing was found, resetting the selector and trying again
-            UAVCAN_TRACE("FirmwareUpdateTrigger", "Node selector reset, last value: %d", int(last_queried_node_id_));
-            last_queried_node_id_ = 0;
+            num_pending_nodes_++;
+        }
+        entry->path = new_path;
+        entry->last_request_at = MonotonicTime();       // The first request will be sent as soon as possible
 
-            NextNodeIDSearchPredicate s2(*this);
-            (void)pending_nodes_.find<NextNodeIDSearchPredicate&>(s2);
+        if (!TimerBase::isRunning())
+        {
+            TimerBase::startPeriodic(request_spacing_);
+            UAVCAN_TRACE("FirmwareUpdateTrigger", "Timer started");
+        }
+    }
 
-            if (s2.output != NextNodeIDSearchPredicate::DefaultOutput)
-            {
-                last_queried_node_id_ = s2.output;
-            }
+    void removePendingNode(const NodeID node_id)
+    {
+        Entry* const entry = getEntry(node_id);
+        if ((entry != NULL) && (entry->path != NULL))
+        {
+            releasePath(entry->path);
+            entry->path = NULL;
+            UAVCAN_ASSERT(num_pending_nodes_ > 0);
+            num_pending_nodes_--;
         }
-        else
+    }
+
+    bool isReadyForRequest(const NodeID node_id, const Entry& entry, const MonotonicTime now) const
+    {
+        return (entry.path != NULL) &&
+               (entry.last_request_at.isZero() || ((now - entry.last_request_at) >= request_interval_)) &&
+               !begin_fw_update_client_.hasPendingCallToServer(node_id);
+    }
+
+    /**
+     * Continues the round-robin from the last queried node, so that every pending node is served once per pass.
+     * Returns an invalid node ID if none of the pending nodes can be queried now.
+     */
+    NodeID pickNextNodeID(const MonotonicTime now)
+    {
+        for (uint8_t i = 0; i < NodeID::Max; i++)
         {
-            ; // Hopeless
+            const uint8_t node_id = uint8_t((unsigned(last_queried_node_id_) + i) % NodeID::Max + 1U);
+            if (isReadyForRequest(node_id, entries_[node_id - 1], now))
+            {
+                last_queried_node_id_ = node_id;
+                UAVCAN_TRACE("FirmwareUpdateTrigger", "Next node ID to query: %d, pending nodes: %u, pending calls: %u",
+                             int(node_id), unsigned(num_pending_nodes_), begin_fw_update_client_.getNumPendingCalls());
+                return node_id;
+            }
         }
-        UAVCAN_TRACE("FirmwareUpdateTrigger", "Next node ID to query: %d, pending nodes: %u, pending calls: %u",
-                     int(last_queried_node_id_), pending_nodes_.getSize(),
-                     begin_fw_update_client_.getNumPendingCalls());
-        return last_queried_node_id_;
+        return NodeID();
     }
 
     void handleBeginFirmwareUpdateResponse(const ServiceCallResult<protocol::file::BeginFirmwareUpdate>& result)
     {
+        const NodeID node_id = result.getCallID().server_node_id;
+
         if (!result.isSuccessful())
         {
-            UAVCAN_TRACE("FirmwareUpdateTrigger", "Request to %d has timed out, will retry",
-                         int(result.getCallID().server_node_id.get()));
+            UAVCAN_TRACE("FirmwareUpdateTrigger", "Request to %d has timed out, will retry", int(node_id.get()));
             return;
         }
 
-        FirmwareFilePath* const old_path = pending_nodes_.access(result.getCallID().server_node_id);
-        if (old_path == NULL)
+        Entry* const entry = getEntry(node_id);
+        if ((entry == NULL) || (entry->path == NULL))
         {
             // The entry has been removed, assuming that it's not needed anymore
             return;
@@ -297,51 +385,67 @@ class FirmwareUpdateTrigger : public INodeInfoListener,
 
         if (confirmed)
         {
-            UAVCAN_TRACE("FirmwareUpdateTrigger", "Node %d confirmed the update request",
-                         int(result.getCallID().server_node_id.get()));
-            pending_nodes_.remove(result.getCallID().server_node_id);
-            checker_.handleFirmwareUpdateConfirmation(result.getCallID().server_node_id, result.getResponse());
+            UAVCAN_TRACE("FirmwareUpdateTrigger", "Node %d confirmed the update request", int(node_id.get()));
+            removePendingNode(node_id);
+            checker_.handleFirmwareUpdateConfirmation(node_id, result.getResponse());
         }
         else
         {
-            UAVCAN_ASSERT(old_path != NULL);
             UAVCAN_ASSERT(TimerBase::isRunning());
-            // We won't have to call trySetPendingNode(), because we'll directly update the old path via the pointer
 
-            const bool update_needed =
-                checker_.shouldRetryFirmwareUpdate(result.getCallID().server_node_id, result.getResponse(), *old_path);
+            // The path may be shared with other nodes, so the checker gets a copy
+            FirmwareFilePath path = entry->path->path;
+            const bool update_needed = checker_.shouldRetryFirmwareUpdate(node_id, result.getResponse(), path);
 
             if (!update_needed)
             {
-                UAVCAN_TRACE("FirmwareUpdateTrigger", "Node %d does not need retry",
-                             int(result.getCallID().server_node_id.get()));
-                pending_nodes_.remove(result.getCallID().server_node_id);
+                UAVCAN_TRACE("FirmwareUpdateTrigger", "Node %d does not need retry", int(node_id.get()));
+                removePendingNode(node_id);
+            }
+            else if ((entry->path != NULL) && (path != entry->path->path))
+            {
+                PathEntry* const new_path = acquirePath(path);
+                if (new_path != NULL)
+                {
+                    releasePath(entry->path);
+                    entry->path = new_path;
+                }
+                else
+                {
+                    getNode().registerInternalFailure("FirmwareUpdateTrigger OOM");
+                }
+            }
+            else
+            {
+                ;   // Retrying with the same path
             }
         }
     }
 
-    virtual void handleTimerEvent(const TimerEvent&)
+    virtual void handleTimerEvent(const TimerEvent& event)
     {
-        if (pending_nodes_.isEmpty())
+        if (num_pending_nodes_ == 0)
         {
             TimerBase::stop();
             UAVCAN_TRACE("FirmwareUpdateTrigger", "Timer stopped");
             return;
         }
 
-        const NodeID node_id = pickNextNodeID();
-        if (!node_id.isUnicast())
+        // One request per tick at most, which limits the rate
+        if (begin_fw_update_client_.getNumPendingCalls() >= max_concurrent_requests_)
         {
             return;
         }
 
-        FirmwareFilePath* const path = pending_nodes_.access(node_id);
-        if (path == NULL)
+        const NodeID node_id = pickNextNodeID(event.real_time);
+        if (!node_id.isUnicast())
         {
-            UAVCAN_ASSERT(0);   // pickNextNodeID() returned a node ID that is not present in the map
             return;
         }
 
+        Entry& entry = entries_[node_id.get() - 1];
+        UAVCAN_ASSERT(entry.path != NULL);
+
         protocol::file::BeginFirmwareUpdate::Request req;
 
         req.source_node_id = getNode().getNodeID().get();
@@ -350,11 +454,13 @@ class FirmwareUpdateTrigger : public INodeInfoListener,
             req.image_file_remote_path.path += common_path_prefix_.c_str();
             req.image_file_remote_path.path.push_back(protocol::file::Path::SEPARATOR);
         }
-        req.image_file_remote_path.path += path->c_str();
+        req.image_file_remote_path.path += entry.path->path.c_str();
 
         UAVCAN_TRACE("FirmwareUpdateTrigger", "Request to %d with path: %s",
                      int(node_id.get()), req.image_file_remote_path.path.c_str());
 
+        entry.last_request_at = event.real_time;
+
         const int call_res = begin_fw_update_client_.call(node_id, req);
         if (call_res < 0)
         {
@@ -368,8 +474,10 @@ public:
         , begin_fw_update_client_(node)
         , checker_(checker)
         , node_info_retriever_(NULL)
-        , pending_nodes_(node.getAllocator())
         , request_interval_(MonotonicDuration::fromMSec(DefaultRequestIntervalMs))
+        , request_spacing_(MonotonicDuration::fromMSec(DefaultRequestSpacingMs))
+        , num_pending_nodes_(0)
+        , max_concurrent_requests_(DefaultMaxConcurrentRequests)
         , last_queried_node_id_(0)
     { }
 
@@ -379,6 +487,11 @@ public:
         {
             node_info_retriever_->removeListener(this);
         }
+        for (uint8_t i = 1; i <= NodeID::Max; i++)
+        {
+            removePendingNode(i);
+        }
+        UAVCAN_ASSERT(paths_.isEmpty());
     }
 
     /**
@@ -436,7 +549,7 @@ public:
     }
 
     /**
-     * Interval at which uavcan.protocol.file.BeginFirmwareUpdate requests are being sent.
+     * Interval at which uavcan.protocol.file.BeginFirmwareUpdate requests are being sent to every pending node.
      * Note that default value should be OK for any use case.
      */
     MonotonicDuration getRequestInterval() const { return request_interval_; }
@@ -445,9 +558,26 @@ public:
         if (interval.isPositive())
         {
             request_interval_ = interval;
+        }
+        else
+        {
+            UAVCAN_ASSERT(0);
+        }
+    }
+
+    /**
+     * Minimum interval between two consecutive requests to any nodes, which limits the rate of requests and hence
+     * the bus load of a large update; e.g. 100 nodes are triggered in one second by default.
+     */
+    MonotonicDuration getRequestSpacing() const { return request_spacing_; }
+    void setRequestSpacing(const MonotonicDuration spacing)
+    {
+        if (spacing.isPositive())
+        {
+            request_spacing_ = spacing;
             if (TimerBase::isRunning())     // Restarting with new interval
             {
-                TimerBase::startPeriodic(request_interval_);
+                TimerBase::startPeriodic(request_spacing_);
             }
         }
         else
@@ -456,6 +586,23 @@ public:
         }
     }
 
+    /**
+     * Maximum number of requests that can await response at the same time; every one takes one pool block.
+     * Zero is not allowed.
+     */
+    uint8_t getMaxConcurrentRequests() const { return max_concurrent_requests_; }
+    void setMaxConcurrentRequests(const uint8_t num)
+    {
+        if (num > 0)
+        {
+            max_concurrent_requests_ = num;
+        }
+        else
+        {
+            UAVCAN_ASSERT(0);
+        }
+    }
+
     /**
      * This method is mostly needed for testing.
      * When triggering is not in progress, the class consumes zero CPU time.
@@ -464,7 +611,7 @@ public:
 
     unsigned getNumPendingNodes() const
     {
-        const unsigned ret = pending_nodes_.getSize();
+        const unsigned ret = num_pending_nodes_;
         UAVCAN_ASSERT((ret > 0) ? isTimerRunning() : true);
         return ret;
     }
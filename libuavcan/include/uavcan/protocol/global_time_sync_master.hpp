@@ -11,6 +11,7 @@
 #include <uavcan/util/method_binder.hpp>
 #include <uavcan/util/lazy_constructor.hpp>
 #include <uavcan/protocol/GlobalTimeSync.hpp>
+#include <uavcan/protocol/time_sync_stats.hpp>
 #include <uavcan/debug.hpp>
 #include <cstdlib>
 #include <cassert>
@@ -25,6 +26,10 @@ namespace uavcan
  * NOTE: In order for this class to work, the platform driver must implement
  *       CAN bus TX loopback with both UTC and monotonic timestamping.
  *
+ * The accuracy of the synchronization is defined by the accuracy of the TX timestamps, so the driver should take
+ * them as close to the moment of transmission as possible, preferably in hardware. The quality of the timestamps
+ * can be assessed via @ref getTxDelayStats().
+ *
  * Ref. M. Gergeleit, H. Streich - "Implementing a Distributed High-Resolution Real-Time Clock using the CAN-Bus"
  *
  * TODO: Enforce max one master per node
@@ -36,6 +41,8 @@ class UAVCAN_EXPORT GlobalTimeSyncMaster : protected LoopbackFrameListenerBase
         Publisher<protocol::GlobalTimeSync> pub_;
         MonotonicTime iface_prev_pub_mono_;
         UtcTime prev_tx_utc_;
+        UtcTime pub_utc_;
+        TimeSyncJitterStats tx_delay_stats_;
         const uint8_t iface_index_;
 
     public:
@@ -72,6 +79,12 @@ class UAVCAN_EXPORT GlobalTimeSyncMaster : protected LoopbackFrameListenerBase
                 return;
             }
             prev_tx_utc_ = ts;
+
+            if (!pub_utc_.isZero())
+            {
+                tx_delay_stats_.addSample((ts - pub_utc_).toUSec());
+                pub_utc_ = UtcTime();
+            }
         }
 
         int publish(TransferID tid, MonotonicTime current_time)
@@ -91,8 +104,12 @@ class UAVCAN_EXPORT GlobalTimeSyncMaster : protected LoopbackFrameListenerBase
             UAVCAN_TRACE("GlobalTimeSyncMaster", "Publishing %llu iface=%i tid=%i",
                          static_cast<unsigned long long>(msg.previous_transmission_timestamp_usec),
                          int(iface_index_), int(tid.get()));
+            pub_utc_ = pub_.getNode().getUtcTime();
             return pub_.broadcast(msg, tid);
         }
+
+        const TimeSyncJitterStats& getTxDelayStats() const { return tx_delay_stats_; }
+        void resetTxDelayStats() { tx_delay_stats_.reset(); }
     };
 
     INode& node_;
@@ -101,17 +118,18 @@ class UAVCAN_EXPORT GlobalTimeSyncMaster : protected LoopbackFrameListenerBase
     DataTypeID dtid_;
     bool initialized_;
 
-    virtual void handleLoopbackFrame(const RxFrame& frame)
+    /**
+     * The dispatcher delivers only the loopback frames of this data type, which are always sent by the local
+     * node, so only the timestamp and the tail byte are needed; the frame is not parsed.
+     */
+    virtual void handleLoopbackCanFrame(const CanRxFrame& can_frame)
     {
-        const uint8_t iface = frame.getIfaceIndex();
+        const uint8_t iface = can_frame.iface_index;
         if (initialized_ && iface < MaxCanIfaces)
         {
-            if (frame.getDataTypeID() == dtid_ &&
-                frame.getTransferType() == TransferTypeMessageBroadcast &&
-                frame.isStartOfTransfer() && frame.isEndOfTransfer() &&
-                frame.getSrcNodeID() == node_.getNodeID())
+            if (Frame::isSingleFrameTransfer(can_frame))
             {
-                iface_masters_[iface]->setTxTimestamp(frame.getUtcTimestamp());
+                iface_masters_[iface]->setTxTimestamp(can_frame.ts_utc);
             }
         }
         else
@@ -186,7 +204,7 @@ public:
         initialized_ = res >= 0;
         if (initialized_)
         {
-            LoopbackFrameListenerBase::startListening();
+            LoopbackFrameListenerBase::startListeningRaw(dtid_, TransferTypeMessageBroadcast);
         }
         return res;
     }
@@ -255,6 +273,34 @@ public:
         }
         return 0;
     }
+
+    /**
+     * Statistics of the delay between the publication of a sync message and its TX timestamp on the specified
+     * interface, i.e. the time the message spent in the TX queues and in arbitration. The delay itself is
+     * compensated by the protocol, but its jitter reveals the errors of the timestamping - with hardware TX
+     * timestamps it's defined mostly by the bus load, whereas with timestamps taken in software (e.g. in the TX
+     * interrupt handler) it also includes the variable latency of the driver.
+     * Returns empty statistics if the master is not initialized or the interface index is invalid.
+     */
+    TimeSyncJitterStats getTxDelayStats(uint8_t iface_index) const
+    {
+        if (initialized_ && (iface_index < MaxCanIfaces))
+        {
+            return iface_masters_[iface_index]->getTxDelayStats();
+        }
+        return TimeSyncJitterStats();
+    }
+
+    void resetTxDelayStats()
+    {
+        for (uint8_t i = 0; i < MaxCanIfaces; i++)
+        {
+            if (iface_masters_[i].isConstructed())
+            {
+                iface_masters_[i]->resetTxDelayStats();
+            }
+        }
+    }
 };
 
 }
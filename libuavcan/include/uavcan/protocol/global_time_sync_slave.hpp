@@ -8,6 +8,7 @@
 #include <uavcan/node/subscriber.hpp>
 #include <uavcan/util/method_binder.hpp>
 #include <uavcan/protocol/GlobalTimeSync.hpp>
+#include <uavcan/protocol/time_sync_stats.hpp>
 #include <uavcan/debug.hpp>
 #include <cassert>
 
@@ -27,6 +28,97 @@ namespace uavcan
  */
 class UAVCAN_EXPORT GlobalTimeSyncSlave : Noncopyable
 {
+public:
+    /**
+     * Number of consecutive outliers after which the filter is reinitialized, assuming that the master's
+     * clock has jumped, see @ref setOutlierThreshold().
+     */
+    enum { MaxConsecutiveOutliers = 3 };
+
+private:
+    /**
+     * Alpha-beta filter (steady state Kalman filter) of the master clock against the local monotonic clock.
+     * Samples are pairs of the RX timestamp of a sync message and the TX timestamp reported by the master.
+     * The gains are those of the least squares fit for the first samples, so the filter converges quickly.
+     */
+    class MasterClockFilter
+    {
+        /*
+         * The filter tracks the offset with the time constant of about 8 samples.
+         * Beta is chosen for critical damping: alpha^2 / (2 - alpha).
+         */
+        static float getSteadyStateAlpha() { return 0.25F; }
+        static float getSteadyStateBeta() { return 0.0357F; }
+        enum { NumWarmUpSamples = 8 };      ///< Least squares gains at this point are close to steady state
+
+        MonotonicTime ref_mono_;
+        UtcTime ref_master_;
+        float rate_error_;                  ///< Master clock rate relative to the local monotonic clock, minus one
+        uint8_t num_samples_;
+
+    public:
+        MasterClockFilter() { reset(); }
+
+        void reset()
+        {
+            ref_mono_ = MonotonicTime();
+            ref_master_ = UtcTime();
+            rate_error_ = 0.0F;
+            num_samples_ = 0;
+        }
+
+        bool isInitialized() const { return num_samples_ > 0; }
+        bool isWarmedUp() const { return num_samples_ >= NumWarmUpSamples; }
+
+        UtcTime predict(MonotonicTime mono) const
+        {
+            const int64_t dt_usec = (mono - ref_mono_).toUSec();
+            return ref_master_ + UtcDuration::fromUSec(dt_usec + int64_t(float(dt_usec) * rate_error_));
+        }
+
+        /**
+         * Returns the innovation, i.e. the error of the prediction; zero for the first sample.
+         */
+        UtcDuration computeInnovation(MonotonicTime mono, UtcTime master) const
+        {
+            return isInitialized() ? (master - predict(mono)) : UtcDuration();
+        }
+
+        void update(MonotonicTime mono, UtcTime master)
+        {
+            if (!isInitialized())
+            {
+                ref_mono_ = mono;
+                ref_master_ = master;
+                num_samples_ = 1;
+                return;
+            }
+
+            const int64_t dt_usec = (mono - ref_mono_).toUSec();
+            const UtcTime predicted = predict(mono);
+            const float innovation = float((master - predicted).toUSec());
+
+            float alpha = getSteadyStateAlpha();
+            float beta = getSteadyStateBeta();
+            if (num_samples_ < NumWarmUpSamples)
+            {
+                const float n = float(num_samples_ + 1U);
+                alpha = max(alpha, 2.0F * (2.0F * n - 1.0F) / (n * (n + 1.0F)));
+                beta = max(beta, 6.0F / (n * (n + 1.0F)));
+                num_samples_++;
+            }
+
+            ref_master_ = predicted + UtcDuration::fromUSec(int64_t(alpha * innovation));
+            if (dt_usec > 0)
+            {
+                rate_error_ += beta * innovation / float(dt_usec);
+            }
+            ref_mono_ = mono;
+        }
+
+        float getRateErrorPPM() const { return rate_error_ * 1e6F; }
+    };
+
     typedef MethodBinder<GlobalTimeSyncSlave*,
                          void (GlobalTimeSyncSlave::*)(const ReceivedDataStructure<protocol::GlobalTimeSync>&)>
         GlobalTimeSyncCallback;
@@ -41,13 +133,30 @@ class UAVCAN_EXPORT GlobalTimeSyncSlave : Noncopyable
     TransferID prev_tid_;
     uint8_t prev_iface_index_;
     bool suppressed_;
+    TimeSyncJitterStats adjustment_stats_;
+    MasterClockFilter filter_;
+    UtcDuration outlier_threshold_;
+    uint32_t num_outliers_;
+    uint8_t num_consecutive_outliers_;
 
     ISystemClock& getSystemClock() const { return sub_.getNode().getSystemClock(); }
 
     void adjustFromMsg(const ReceivedDataStructure<protocol::GlobalTimeSync>& msg)
     {
         UAVCAN_ASSERT(msg.previous_transmission_timestamp_usec > 0);
-        const UtcDuration adjustment = UtcTime::fromUSec(msg.previous_transmission_timestamp_usec) - prev_ts_utc_;
+        const UtcTime master_ts = UtcTime::fromUSec(msg.previous_transmission_timestamp_usec);
+
+        if (isOutlier(master_ts))
+        {
+            UAVCAN_TRACE("GlobalTimeSyncSlave", "Outlier rejected: usec=%lli snid=%i",
+                         static_cast<long long>(filter_.computeInnovation(prev_ts_mono_, master_ts).toUSec()),
+                         int(msg.getSrcNodeID().get()));
+            state_ = Update;
+            return;
+        }
+        filter_.update(prev_ts_mono_, master_ts);
+
+        const UtcDuration adjustment = master_ts - prev_ts_utc_;
 
         UAVCAN_TRACE("GlobalTimeSyncSlave", "Adjustment: usec=%lli snid=%i iface=%i suppress=%i",
                      static_cast<long long>(adjustment.toUSec()),
@@ -57,15 +166,48 @@ class UAVCAN_EXPORT GlobalTimeSyncSlave : Noncopyable
         {
             getSystemClock().adjustUtc(adjustment);
         }
+        adjustment_stats_.addSample(adjustment.toUSec());
         last_adjustment_ts_ = msg.getMonotonicTimestamp();
         state_ = Update;
     }
 
+    /**
+     * Updates the outlier counters; if there are too many outliers in a row, the filter is reset and the sample
+     * is accepted.
+     */
+    bool isOutlier(UtcTime master_ts)
+    {
+        if (!outlier_threshold_.isPositive() || !filter_.isWarmedUp() ||
+            (filter_.computeInnovation(prev_ts_mono_, master_ts).getAbs() <= outlier_threshold_))
+        {
+            num_consecutive_outliers_ = 0;
+            return false;
+        }
+
+        if (num_consecutive_outliers_ >= MaxConsecutiveOutliers)
+        {
+            UAVCAN_TRACE("GlobalTimeSyncSlave", "Too many outliers, resetting the filter");
+            filter_.reset();
+            num_consecutive_outliers_ = 0;
+            return false;
+        }
+        num_outliers_++;
+        num_consecutive_outliers_++;
+        return true;
+    }
+
     void updateFromMsg(const ReceivedDataStructure<protocol::GlobalTimeSync>& msg)
     {
         UAVCAN_TRACE("GlobalTimeSyncSlave", "Update: snid=%i iface=%i",
                      int(msg.getSrcNodeID().get()), int(msg.getIfaceIndex()));
 
+        if ((msg.getSrcNodeID() != master_nid_) || (msg.getIfaceIndex() != prev_iface_index_))
+        {
+            adjustment_stats_.reset();      // The statistics of different masters are not comparable
+            filter_.reset();
+            num_consecutive_outliers_ = 0;
+        }
+
         prev_ts_utc_      = msg.getUtcTimestamp();
         prev_ts_mono_     = msg.getMonotonicTimestamp();
         master_nid_       = msg.getSrcNodeID();
@@ -139,6 +281,8 @@ public:
         , state_(Update)
         , prev_iface_index_(0xFF)
         , suppressed_(false)
+        , num_outliers_(0)
+        , num_consecutive_outliers_(0)
     { }
 
     /**
@@ -191,6 +335,51 @@ public:
      * Last time when the local clock adjustment was performed.
      */
     MonotonicTime getLastAdjustmentTime() const { return last_adjustment_ts_; }
+
+    /**
+     * Statistics of the clock adjustments since the slave has locked on the current master; they are collected
+     * in the suppressed mode as well. Once the clock is synchronized, every adjustment is the residual error of
+     * the local clock, so the jitter of the adjustments is a measure of the synchronization accuracy. Note that
+     * the first adjustment after locking on a master includes the initial clock offset.
+     */
+    const TimeSyncJitterStats& getAdjustmentStats() const { return adjustment_stats_; }
+    void resetAdjustmentStats() { adjustment_stats_.reset(); }
+
+    /**
+     * Enables the outlier rejection: a sync message whose timestamp deviates from the filtered estimate of the
+     * master clock by more than the threshold will not be used, e.g. because its TX timestamp was delayed by the
+     * master's driver. The threshold should be a few times greater than the timestamping jitter (see
+     * @ref GlobalTimeSyncMaster::getTxDelayStats()). If the master's clock jumps, the filter will be reinitialized
+     * after @ref MaxConsecutiveOutliers rejected messages.
+     * A zero threshold disables the outlier rejection; it is disabled by default.
+     */
+    void setOutlierThreshold(UtcDuration threshold) { outlier_threshold_ = threshold; }
+    UtcDuration getOutlierThreshold() const { return outlier_threshold_; }
+
+    /**
+     * Number of sync messages rejected as outliers.
+     */
+    uint32_t getNumRejectedOutliers() const { return num_outliers_; }
+
+    /**
+     * Returns the filtered estimate of the master clock at the specified local monotonic time, or zero if there's
+     * no estimate yet. Unlike the local UTC clock, which is stepped upon every adjustment, the estimate is smooth,
+     * so it is suitable for timestamping of sensor data. The call is cheap: it merely extrapolates the offset and
+     * the rate of the master clock, which are updated with every sync message.
+     * The estimate is reset when the slave switches to a different master.
+     */
+    UtcTime getEstimatedMasterUtc(MonotonicTime mono) const
+    {
+        return filter_.isInitialized() ? filter_.predict(mono) : UtcTime();
+    }
+
+    UtcTime getEstimatedMasterUtc() const { return getEstimatedMasterUtc(getSystemClock().getMonotonic()); }
+
+    /**
+     * Estimated rate error of the master clock against the local monotonic clock, in PPM.
+     * Positive if the master clock runs faster.
+     */
+    float getEstimatedMasterRateErrorPPM() const { return filter_.getRateErrorPPM(); }
 };
 
 }
@@ -0,0 +1,252 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_PROTOCOL_INDEXED_PARAM_MANAGER_HPP_INCLUDED
+#define UAVCAN_PROTOCOL_INDEXED_PARAM_MANAGER_HPP_INCLUDED
+
+#include <uavcan/build_config.hpp>
+#include <uavcan/protocol/param_server.hpp>
+#include <uavcan/util/templates.hpp>
+#include <cstring>
+
+namespace uavcan
+{
+/**
+ * Optional base class for param managers that keep the parameters in an indexed container
+ * (e.g. an array of descriptors), which is the usual case.
+ *
+ * The application implements the index-based access methods, and this class implements the name-based methods of
+ * @ref IParamManager on top of them. Names are resolved through a table of parameter indices sorted by name, so
+ * that every lookup takes O(log N) calls of getParamNameByIndex() instead of O(N) string comparisons, and a full
+ * enumeration of the parameters via @ref ParamServer takes O(N log N) instead of O(N^2). The most recently resolved
+ * name is cached, because @ref ParamServer resolves the same name several times per request.
+ *
+ * The table is built upon the first lookup, which takes O(N log N) calls of getParamNameByIndex().
+ * The application must call @ref invalidateIndex() whenever the set of parameters or their names change.
+ * Parameter names must be unique.
+ *
+ * @tparam MaxParams    Maximum number of parameters; the excess parameters cannot be resolved by name.
+ *                      Costs two bytes of RAM per parameter.
+ */
+template <unsigned MaxParams>
+class UAVCAN_EXPORT IndexedParamManager : public IParamManager
+{
+public:
+    /**
+     * All fields of one parameter, see @ref readParams().
+     */
+    struct ParamEntry
+    {
+        Name name;
+        Value value;
+        Value default_value;
+        NumericValue max_value;
+        NumericValue min_value;
+    };
+
+private:
+    mutable Index sorted_indices_[MaxParams];
+    mutable Index num_indexed_params_;
+    mutable bool index_valid_;
+    mutable bool cache_valid_;
+    mutable Index cached_index_;
+    mutable Name cached_name_;
+
+    static int compareNames(const Name& a, const Name& b)
+    {
+        return std::strcmp(a.c_str(), b.c_str());
+    }
+
+    void buildIndex() const
+    {
+        num_indexed_params_ = 0;
+        const Index num_params = Index(min(unsigned(getNumParams()), MaxParams));
+
+        Name name;
+        Name other_name;
+        for (Index index = 0; index < num_params; index++)
+        {
+            name.clear();
+            getParamNameByIndex(index, name);
+
+            // Binary insertion
+            unsigned lo = 0;
+            unsigned hi = num_indexed_params_;
+            while (lo < hi)
+            {
+                const unsigned mid = (lo + hi) / 2U;
+                other_name.clear();
+                getParamNameByIndex(sorted_indices_[mid], other_name);
+                if (compareNames(other_name, name) < 0)
+                {
+                    lo = mid + 1U;
+                }
+                else
+                {
+                    hi = mid;
+                }
+            }
+
+            for (unsigned i = num_indexed_params_; i > lo; i--)
+            {
+                sorted_indices_[i] = sorted_indices_[i - 1U];
+            }
+            sorted_indices_[lo] = index;
+            num_indexed_params_++;
+        }
+
+        index_valid_ = true;
+        UAVCAN_TRACE("IndexedParamManager", "Index built, %u params", unsigned(num_indexed_params_));
+    }
+
+public:
+    IndexedParamManager()
+        : num_indexed_params_(0)
+        , index_valid_(false)
+        , cache_valid_(false)
+        , cached_index_(0)
+    { }
+
+    /**
+     * Number of parameters; the valid indices are [0, getNumParams()).
+     */
+    virtual Index getNumParams() const = 0;
+
+    /**
+     * Index-based counterparts of the name-based methods of @ref IParamManager.
+     * The index is always valid. readParamDefaultMaxMinByIndex() is optional.
+     * @{
+     */
+    virtual void assignParamValueByIndex(Index index, const Value& value) = 0;
+
+    virtual void readParamValueByIndex(Index index, Value& out_value) const = 0;
+
+    virtual void readParamDefaultMaxMinByIndex(Index index, Value& out_default,
+                                               NumericValue& out_max, NumericValue& out_min) const
+    {
+        (void)index;
+        (void)out_default;
+        (void)out_max;
+        (void)out_min;
+    }
+    /**
+     * @}
+     */
+
+    /**
+     * Finds the index of the parameter by its name.
+     * Returns false if there's no such parameter; the output argument will not be modified in that case.
+     */
+    bool findParamIndex(const Name& name, Index& out_index) const
+    {
+        if (!index_valid_)
+        {
+            buildIndex();
+        }
+
+        if (cache_valid_ && (cached_name_ == name))
+        {
+            out_index = cached_index_;
+            return true;
+        }
+
+        unsigned lo = 0;
+        unsigned hi = num_indexed_params_;
+        Name other_name;
+        while (lo < hi)
+        {
+            const unsigned mid = (lo + hi) / 2U;
+            other_name.clear();
+            getParamNameByIndex(sorted_indices_[mid], other_name);
+            const int cmp = compareNames(other_name, name);
+            if (cmp == 0)
+            {
+                cached_name_ = name;
+                cached_index_ = sorted_indices_[mid];
+                cache_valid_ = true;
+                out_index = cached_index_;
+                return true;
+            }
+            if (cmp < 0)
+            {
+                lo = mid + 1U;
+            }
+            else
+            {
+                hi = mid;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Forces the name table to be rebuilt upon the next lookup.
+     */
+    void invalidateIndex()
+    {
+        index_valid_ = false;
+        cache_valid_ = false;
+    }
+
+    /**
+     * Reads all fields of several consecutive parameters at once, without name lookups.
+     * This is the preferred way to dump the whole configuration locally, e.g. into a file.
+     * Returns the number of entries read, which is less than max_entries if the end of the list was reached.
+     */
+    unsigned readParams(Index first_index, ParamEntry* out_entries, unsigned max_entries) const
+    {
+        if (out_entries == NULL)
+        {
+            return 0;
+        }
+        const Index num_params = getNumParams();
+        unsigned num_read = 0;
+        while ((num_read < max_entries) && ((unsigned(first_index) + num_read) < num_params))
+        {
+            const Index index = Index(first_index + num_read);
+            ParamEntry& entry = out_entries[num_read];
+            entry = ParamEntry();
+            getParamNameByIndex(index, entry.name);
+            readParamValueByIndex(index, entry.value);
+            readParamDefaultMaxMinByIndex(index, entry.default_value, entry.max_value, entry.min_value);
+            num_read++;
+        }
+        return num_read;
+    }
+
+    /**
+     * Methods of @ref IParamManager, implemented via the index-based methods.
+     */
+    virtual void assignParamValue(const Name& name, const Value& value)
+    {
+        Index index = 0;
+        if (findParamIndex(name, index))
+        {
+            assignParamValueByIndex(index, value);
+        }
+    }
+
+    virtual void readParamValue(const Name& name, Value& out_value) const
+    {
+        Index index = 0;
+        if (findParamIndex(name, index))
+        {
+            readParamValueByIndex(index, out_value);
+        }
+    }
+
+    virtual void readParamDefaultMaxMin(const Name& name, Value& out_default,
+                                        NumericValue& out_max, NumericValue& out_min) const
+    {
+        Index index = 0;
+        if (findParamIndex(name, index))
+        {
+            readParamDefaultMaxMinByIndex(index, out_default, out_max, out_min);
+        }
+    }
+};
+
+}
+
+#endif // UAVCAN_PROTOCOL_INDEXED_PARAM_MANAGER_HPP_INCLUDED
@@ -10,6 +10,7 @@
 #include <uavcan/protocol/debug/LogMessage.hpp>
 #include <uavcan/marshal/char_array_formatter.hpp>
 #include <uavcan/node/publisher.hpp>
+#include <uavcan/node/timer.hpp>
 #include <cstdlib>
 
 #if !defined(UAVCAN_CPP_VERSION) || !defined(UAVCAN_CPP11)
@@ -54,8 +55,12 @@ public:
  *  - Sink into the application via @ref ILogSink.
  *
  * For each sink an individual severity threshold filter can be configured.
+ *
+ * By default, every message is delivered into the sinks immediately, which involves a transfer transmission.
+ * In the deferred mode, the messages are stored in a fixed queue instead, and delivered later from the timer
+ * callback, i.e. when the application spins the node; please refer to @ref setDeferredMode() for details.
  */
-class UAVCAN_EXPORT Logger
+class UAVCAN_EXPORT Logger : private TimerBase
 {
 public:
     typedef ILogSink::LogLevel LogLevel;
@@ -74,15 +79,95 @@ private:
     LogLevel level_;
     ILogSink* external_sink_;
 
+#if UAVCAN_LOGGER_DEFERRED_QUEUE_LENGTH > 0
+    enum { DeferredQueueLength = UAVCAN_LOGGER_DEFERRED_QUEUE_LENGTH };
+
+    struct DeferredMessage
+    {
+        protocol::debug::LogMessage message;
+        uint16_t num_repetitions;           ///< Number of identical messages that were coalesced with this one
+    };
+
+    DeferredMessage deferred_queue_[DeferredQueueLength];
+    uint32_t num_dropped_messages_;
+    uint32_t num_coalesced_messages_;
+    uint32_t num_unreported_dropped_messages_;
+    uint8_t deferred_queue_head_;           ///< Index of the oldest message
+    uint8_t deferred_queue_size_;
+    bool deferred_;
+
+    int enqueue(const protocol::debug::LogMessage& message)
+    {
+        if (deferred_queue_size_ > 0)
+        {
+            DeferredMessage& last =
+                deferred_queue_[(deferred_queue_head_ + deferred_queue_size_ - 1U) % unsigned(DeferredQueueLength)];
+            if ((last.num_repetitions < 0xFFFFU) && (last.message == message))
+            {
+                last.num_repetitions++;
+                num_coalesced_messages_++;
+                return 0;
+            }
+        }
+
+        if (deferred_queue_size_ >= DeferredQueueLength)
+        {
+            num_dropped_messages_++;
+            num_unreported_dropped_messages_++;
+            return -ErrMemory;
+        }
+
+        DeferredMessage& slot =
+            deferred_queue_[(deferred_queue_head_ + deferred_queue_size_) % unsigned(DeferredQueueLength)];
+        slot.message = message;
+        slot.num_repetitions = 0;
+        deferred_queue_size_++;
+
+        if (!TimerBase::isRunning())
+        {
+            startOneShotWithDelay(MonotonicDuration());
+        }
+        return 0;
+    }
+#endif
+
+    virtual void handleTimerEvent(const TimerEvent&)
+    {
+        flush();
+    }
+
     LogLevel getExternalSinkLevel() const
     {
         return (external_sink_ == NULL) ? getLogLevelAboveAll() : external_sink_->getLogLevel();
     }
 
+    int deliver(const protocol::debug::LogMessage& message)
+    {
+        int retval = 0;
+        if (message.level.value >= getExternalSinkLevel())
+        {
+            external_sink_->log(message);
+        }
+        if (message.level.value >= level_)
+        {
+            retval = logmsg_pub_.broadcast(message);
+        }
+        return retval;
+    }
+
 public:
     explicit Logger(INode& node)
-        : logmsg_pub_(node)
+        : TimerBase(node)
+        , logmsg_pub_(node)
         , external_sink_(NULL)
+#if UAVCAN_LOGGER_DEFERRED_QUEUE_LENGTH > 0
+        , num_dropped_messages_(0)
+        , num_coalesced_messages_(0)
+        , num_unreported_dropped_messages_(0)
+        , deferred_queue_head_(0)
+        , deferred_queue_size_(0)
+        , deferred_(false)
+#endif
     {
         level_ = protocol::debug::LogLevel::ERROR;
         setTxTimeout(MonotonicDuration::fromMSec(DefaultTxTimeoutMs));
@@ -113,22 +198,106 @@ public:
      * The message will be reported into the external log sink if the external sink is
      * installed and the severity level of the message is >= severity level of the external sink.
      *
+     * In the deferred mode the message is only queued; the returned value will be -ErrMemory if the queue is full.
+     *
      * Returns negative error code.
      */
     int log(const protocol::debug::LogMessage& message)
     {
-        int retval = 0;
-        if (message.level.value >= getExternalSinkLevel())
+#if UAVCAN_LOGGER_DEFERRED_QUEUE_LENGTH > 0
+        if (deferred_)
         {
-            external_sink_->log(message);
+            if ((message.level.value >= level_) || (message.level.value >= getExternalSinkLevel()))
+            {
+                return enqueue(message);
+            }
+            return 0;
         }
-        if (message.level.value >= level_)
+#endif
+        return deliver(message);
+    }
+
+    /**
+     * Deferred mode makes logging calls cheap and predictable: instead of being delivered into the sinks, a message
+     * is copied into a fixed queue of UAVCAN_LOGGER_DEFERRED_QUEUE_LENGTH messages, and the queue is flushed from
+     * the timer callback once the application spins the node. Formatting still happens in the logging call,
+     * because the arguments (e.g. strings) may not outlive it.
+     *
+     * A message that is identical to the last queued one is not queued again; instead, the latter will be delivered
+     * with the suffix " [xN]", where N is the total number of occurrences. If the queue is full, new messages are
+     * dropped; the number of dropped messages will be reported with a WARNING message once the queue is flushed.
+     * Delivery errors in the deferred mode are ignored.
+     *
+     * Disabling the deferred mode flushes the queue.
+     * Returns negative error code; fails if the deferred mode is disabled in the build configuration.
+     */
+    int setDeferredMode(bool enabled)
+    {
+#if UAVCAN_LOGGER_DEFERRED_QUEUE_LENGTH > 0
+        if (!enabled)
         {
-            retval = logmsg_pub_.broadcast(message);
+            flush();
         }
-        return retval;
+        deferred_ = enabled;
+        return 0;
+#else
+        return enabled ? -ErrInvalidConfiguration : 0;
+#endif
+    }
+
+    /**
+     * Delivers all deferred messages into the sinks immediately.
+     * Does nothing if the deferred mode is not enabled.
+     */
+    void flush()
+    {
+#if UAVCAN_LOGGER_DEFERRED_QUEUE_LENGTH > 0
+        TimerBase::stop();
+
+        while (deferred_queue_size_ > 0)
+        {
+            // The message is removed from the queue first in case the external sink decides to log something
+            DeferredMessage entry = deferred_queue_[deferred_queue_head_];
+            deferred_queue_head_ = uint8_t((deferred_queue_head_ + 1U) % unsigned(DeferredQueueLength));
+            deferred_queue_size_--;
+
+            if (entry.num_repetitions > 0)
+            {
+                entry.message.text.appendFormatted(" [x%u]", unsigned(entry.num_repetitions + 1U));
+            }
+            const int res = deliver(entry.message);
+            if (res < 0)
+            {
+                UAVCAN_TRACE("Logger", "Deferred message delivery failure: %i", res);
+            }
+        }
+
+        if (num_unreported_dropped_messages_ > 0)
+        {
+            protocol::debug::LogMessage msg;
+            msg.level.value = protocol::debug::LogLevel::WARNING;
+            msg.source = "Logger";
+            msg.text.appendFormatted("%u messages dropped", unsigned(num_unreported_dropped_messages_));
+            num_unreported_dropped_messages_ = 0;
+            (void)deliver(msg);
+        }
+#endif
     }
 
+#if UAVCAN_LOGGER_DEFERRED_QUEUE_LENGTH > 0
+    bool isDeferredModeEnabled() const { return deferred_; }
+
+    /**
+     * Deferred mode statistics.
+     * The dropped and coalesced message counters are never reset.
+     */
+    unsigned getNumDeferredMessages() const { return deferred_queue_size_; }
+    uint32_t getNumDroppedMessages() const { return num_dropped_messages_; }
+    uint32_t getNumCoalescedMessages() const { return num_coalesced_messages_; }
+#else
+    bool isDeferredModeEnabled() const { return false; }
+#endif
+
     /**
      * Severity filter for UAVCAN broadcasting.
      * Log message will be broadcasted via the UAVCAN network only if its severity is >= getLevel().
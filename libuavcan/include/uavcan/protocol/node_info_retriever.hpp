@@ -58,6 +58,33 @@ public:
     virtual ~INodeInfoListener() { }
 };
 
+/**
+ * Node info can be persisted across restarts of the local node via this interface, so that after a warm boot
+ * the nodes that did not restart meanwhile are not queried again. Refer to @ref NodeInfoRetriever::setNodeInfoCache().
+ */
+class UAVCAN_EXPORT INodeInfoCache
+{
+public:
+    /**
+     * Called when the node appears online, before it is queried.
+     * The record is used only if the uptime reported by the node now is not less than the uptime stored in the
+     * record, i.e. the node did not restart. Since a node that has restarted may have gained more uptime than it had
+     * when the record was stored, implementations should reject records that are older than the local downtime
+     * allows to verify, e.g. by storing the wall clock time along with the record.
+     * @param node_id           Node ID of the node
+     * @param out_node_info     The stored record
+     * @return                  True if the record exists
+     */
+    virtual bool load(NodeID node_id, protocol::GetNodeInfo::Response& out_node_info) = 0;
+
+    /**
+     * Called every time node info is retrieved from the node.
+     */
+    virtual void store(NodeID node_id, const protocol::GetNodeInfo::Response& node_info) = 0;
+
+    virtual ~INodeInfoCache() { }
+};
+
 /**
  * This class automatically retrieves a response to GetNodeInfo once a node appears online or restarts.
  * It does a number of attempts in case if there's a communication failure before assuming that the node does not
@@ -82,7 +109,13 @@ public:
  * Keep the above equations in mind when changing the default request interval.
  *
  * Obviously, if all calls are completing in under (request interval), the number of concurrent requests will never
- * exceed one. This is actually the most likely scenario.
+ * exceed the number of requests per interval. This is actually the most likely scenario.
+ *
+ * The number of requests per interval adapts to the network conditions: it is increased by one after a number
+ * of successful calls equal to the current value, up to @ref getMaxRequestsPerInterval(), and it is halved on every
+ * request timeout and every time the local node fails to transmit CAN frames. Since it never drops below one,
+ * the above estimations still hold in the worst case, while a large number of nodes that respond in time can be
+ * discovered several times faster.
  *
  * Note that all nodes are queried in a round-robin fashion, regardless of their uptime, number of requests made, etc.
  *
@@ -106,12 +139,14 @@ private:
         uint8_t num_attempts_made;
         bool request_needed;                    ///< Always false for unknown nodes
         bool updated_since_last_attempt;        ///< Always false for unknown nodes
+        bool cache_checked;                     ///< Node info cache has been checked since the request was needed
 
         Entry()
             : uptime_sec(0)
             , num_attempts_made(0)
             , request_needed(false)
             , updated_since_last_attempt(false)
+            , cache_checked(false)
         {
 #if UAVCAN_DEBUG
             StaticAssert<sizeof(Entry) <= 8>::check();
@@ -158,6 +193,7 @@ private:
 
     enum { DefaultNumRequestAttempts = 16 };
     enum { DefaultTimerIntervalMSec = 40 };  ///< Read explanation in the class documentation
+    enum { DefaultMaxRequestsPerInterval = 4 };
 
     /*
      * State
@@ -168,12 +204,20 @@ private:
 
     ServiceClient<protocol::GetNodeInfo, GetNodeInfoResponseCallback> get_node_info_client_;
 
+    INodeInfoCache* cache_;
+
     MonotonicDuration request_interval_;
 
+    uint64_t last_tx_error_count_;
+
     mutable uint8_t last_picked_node_;
 
     uint8_t num_attempts_;
 
+    uint8_t max_requests_per_interval_;
+    uint8_t requests_per_interval_;
+    uint8_t num_successes_at_current_rate_;
+
     /*
      * Methods
      */
@@ -228,13 +272,55 @@ private:
         return NodeID();        // No node could be found
     }
 
+    uint64_t getTxErrorCount() const
+    {
+        const CanIOManager& can_io = get_node_info_client_.getNode().getDispatcher().getCanIOManager();
+        uint64_t cnt = 0;
+        for (uint8_t i = 0; i < can_io.getNumIfaces(); i++)
+        {
+            cnt += can_io.getIfacePerfCounters(i).errors;   // Includes the frames rejected by the TX queue
+        }
+        return cnt;
+    }
+
+    void reduceRequestRate()
+    {
+        requests_per_interval_ = max(uint8_t(requests_per_interval_ / 2U), uint8_t(1));
+        num_successes_at_current_rate_ = 0;
+        UAVCAN_TRACE("NodeInfoRetriever", "Requests per interval reduced to %u", unsigned(requests_per_interval_));
+    }
+
+    void increaseRequestRate()
+    {
+        num_successes_at_current_rate_++;
+        if ((num_successes_at_current_rate_ >= requests_per_interval_) &&
+            (requests_per_interval_ < max_requests_per_interval_))
+        {
+            requests_per_interval_++;
+            num_successes_at_current_rate_ = 0;
+            UAVCAN_TRACE("NodeInfoRetriever", "Requests per interval increased to %u",
+                         unsigned(requests_per_interval_));
+        }
+    }
+
     virtual void handleTimerEvent(const TimerEvent&)
     {
+        const uint64_t tx_error_count = getTxErrorCount();
+        if (tx_error_count != last_tx_error_count_)
+        {
+            last_tx_error_count_ = tx_error_count;
+            reduceRequestRate();
+        }
+
         bool at_least_one_request_needed = false;
-        const NodeID next = pickNextNodeToQuery(at_least_one_request_needed);
 
-        if (next.isUnicast())
+        for (uint8_t i = 0; i < requests_per_interval_; i++)
         {
+            const NodeID next = pickNextNodeToQuery(at_least_one_request_needed);
+            if (!next.isUnicast())
+            {
+                break;
+            }
             UAVCAN_ASSERT(at_least_one_request_needed);
             getEntry(next).updated_since_last_attempt = false;
             const int res = get_node_info_client_.call(next, protocol::GetNodeInfo::Request());
@@ -243,13 +329,26 @@ private:
                 get_node_info_client_.getNode().registerInternalFailure("NodeInfoRetriever GetNodeInfo call");
             }
         }
-        else
+
+        if (!at_least_one_request_needed)
         {
-            if (!at_least_one_request_needed)
-            {
-                TimerBase::stop();
-                UAVCAN_TRACE("NodeInfoRetriever", "Timer stopped");
-            }
+            TimerBase::stop();
+            UAVCAN_TRACE("NodeInfoRetriever", "Timer stopped");
+        }
+    }
+
+    /**
+     * Delivers the node info from the cache if the node could not have restarted since it was stored.
+     */
+    void restoreFromCache(NodeID node_id, uint32_t uptime_sec)
+    {
+        UAVCAN_ASSERT(cache_ != NULL);
+        protocol::GetNodeInfo::Response node_info;
+        if (cache_->load(node_id, node_info) && (uptime_sec >= node_info.status.uptime_sec))
+        {
+            UAVCAN_TRACE("NodeInfoRetriever", "Node info for %d restored from cache", int(node_id.get()));
+            getEntry(node_id).request_needed = false;
+            listeners_.forEach(NodeInfoRetrievedHandlerCaller(node_id, node_info));
         }
     }
 
@@ -266,6 +365,7 @@ private:
 
             entry.request_needed = !offline_now;
             entry.num_attempts_made = 0;
+            entry.cache_checked = false;
 
             UAVCAN_TRACE("NodeInfoRetriever", "Offline status change: node ID %d, request needed: %d",
                          int(event.node_id.get()), int(entry.request_needed));
@@ -288,12 +388,19 @@ private:
         {
             entry.request_needed = true;
             entry.num_attempts_made = 0;
+            entry.cache_checked = false;
 
             startTimerIfNotRunning();
         }
         entry.uptime_sec = msg.uptime_sec;
         entry.updated_since_last_attempt = true;
 
+        if (entry.request_needed && !entry.cache_checked && (cache_ != NULL))
+        {
+            entry.cache_checked = true;
+            restoreFromCache(msg.getSrcNodeID(), msg.uptime_sec);
+        }
+
         listeners_.forEach(GenericHandlerCaller<const ReceivedDataStructure<protocol::NodeStatus>&>(
             &INodeInfoListener::handleNodeStatusMessage, msg));
     }
@@ -310,11 +417,18 @@ private:
              */
             entry.uptime_sec = result.getResponse().status.uptime_sec;
             entry.request_needed = false;
+            increaseRequestRate();
+            if (cache_ != NULL)
+            {
+                cache_->store(result.getCallID().server_node_id, result.getResponse());
+            }
             listeners_.forEach(NodeInfoRetrievedHandlerCaller(result.getCallID().server_node_id,
                                                               result.getResponse()));
         }
         else
         {
+            reduceRequestRate();
+
             if (num_attempts_ != UnlimitedRequestAttempts)
             {
                 entry.num_attempts_made++;
@@ -334,9 +448,14 @@ public:
         , TimerBase(node)
         , listeners_(node.getAllocator())
         , get_node_info_client_(node)
+        , cache_(NULL)
         , request_interval_(MonotonicDuration::fromMSec(DefaultTimerIntervalMSec))
+        , last_tx_error_count_(0)
         , last_picked_node_(1)
         , num_attempts_(DefaultNumRequestAttempts)
+        , max_requests_per_interval_(DefaultMaxRequestsPerInterval)
+        , requests_per_interval_(1)
+        , num_successes_at_current_rate_(0)
     { }
 
     /**
@@ -446,6 +565,39 @@ public:
         }
     }
 
+    /**
+     * Upper limit for the adaptive number of requests per interval; refer to the class documentation.
+     * Setting it to one disables the adaptation. The value cannot be less than one.
+     */
+    uint8_t getMaxRequestsPerInterval() const { return max_requests_per_interval_; }
+    void setMaxRequestsPerInterval(const uint8_t num)
+    {
+        max_requests_per_interval_ = max(num, uint8_t(1));
+        requests_per_interval_ = min(requests_per_interval_, max_requests_per_interval_);
+    }
+
+    /**
+     * Current number of requests per interval, as defined by the adaptation logic.
+     */
+    uint8_t getRequestsPerInterval() const { return requests_per_interval_; }
+
+    /**
+     * Node info cache allows to avoid re-querying the nodes that did not restart while the local node was down.
+     * The cache object must outlive the retriever, or it must be removed by passing a null pointer.
+     * There is no cache by default.
+     */
+    INodeInfoCache* getNodeInfoCache() const { return cache_; }
+    void setNodeInfoCache(INodeInfoCache* cache) { cache_ = cache; }
+
+    /**
+     * Whether the node info of the node is yet to be retrieved, i.e. the node has appeared or restarted, and the
+     * retriever has not given up on it yet.
+     */
+    bool isNodeInfoRequestNeeded(NodeID node_id) const
+    {
+        return node_id.isUnicast() && getEntry(node_id).request_needed;
+    }
+
     /**
      * These methods are needed mostly for testing.
      */
@@ -6,6 +6,7 @@
 #define UAVCAN_PROTOCOL_NODE_STATUS_MONITOR_HPP_INCLUDED
 
 #include <uavcan/debug.hpp>
+#include <uavcan/util/bitset.hpp>
 #include <uavcan/util/method_binder.hpp>
 #include <uavcan/node/subscriber.hpp>
 #include <uavcan/node/timer.hpp>
@@ -67,7 +68,7 @@ public:
     };
 
 private:
-    enum { TimerPeriodMs100 = 2 };
+    enum { OfflineTimeoutMs100 = protocol::NodeStatus::OFFLINE_TIMEOUT_MS / 100 };
 
     typedef MethodBinder<NodeStatusMonitor*,
                          void (NodeStatusMonitor::*)(const ReceivedDataStructure<protocol::NodeStatus>&)>
@@ -81,15 +82,26 @@ private:
 
     struct Entry
     {
+        uint32_t generation;            ///< Value of generation_ when the status has changed last time
         NodeStatus status;
-        int8_t time_since_last_update_ms100;
+        uint8_t last_update_ms100;      ///< Monotonic time of the last update, modulo 25.6 seconds
         Entry() :
-            time_since_last_update_ms100(-1)
+            generation(0),
+            last_update_ms100(0)
         { }
     };
 
     mutable Entry entries_[NodeID::Max];  // [1, NodeID::Max]
 
+    /*
+     * Bit N stands for the node ID N+1. Online nodes are the known ones that are not in the offline mode; only
+     * these can time out, so the timer runs only when there is at least one of them.
+     */
+    BitSet<NodeID::Max> known_nodes_;
+    BitSet<NodeID::Max> online_nodes_;
+
+    uint32_t generation_;
+
     Entry& getEntry(NodeID node_id) const
     {
         if (node_id.get() < 1 || node_id.get() > NodeID::Max)
@@ -99,16 +111,33 @@ private:
         return entries_[node_id.get() - 1];
     }
 
+    static uint8_t getTimeMs100(MonotonicTime ts) { return uint8_t(ts.toMSec() / 100); }
+
+    /**
+     * Returns the number of 100 ms periods until the node times out; zero if it has timed out already.
+     */
+    static unsigned getTimeToOfflineMs100(const Entry& entry, uint8_t now_ms100)
+    {
+        const unsigned age = uint8_t(now_ms100 - entry.last_update_ms100);
+        return (age > unsigned(OfflineTimeoutMs100)) ? 0U : (unsigned(OfflineTimeoutMs100) + 1U - age);
+    }
+
     void changeNodeStatus(const NodeID node_id, const Entry new_entry_value)
     {
         Entry& entry = getEntry(node_id);
+        const std::size_t index = std::size_t(node_id.get() - 1U);
+        const bool was_known = known_nodes_.test(index);
+
+        const uint32_t generation = ((entry.status != new_entry_value.status) || !was_known) ?
+                                    ++generation_ : entry.generation;
+
         if (entry.status != new_entry_value.status)
         {
             NodeStatusChangeEvent event;
             event.node_id    = node_id;
             event.old_status = entry.status;
             event.status     = new_entry_value.status;
-            event.was_known  = entry.time_since_last_update_ms100 >= 0;
+            event.was_known  = was_known;
 
             UAVCAN_TRACE("NodeStatusMonitor", "Node %i [%s] status change: [%s] --> [%s]", int(node_id.get()),
                          (event.was_known ? "known" : "new"),
@@ -117,42 +146,73 @@ private:
             handleNodeStatusChange(event);
         }
         entry = new_entry_value;
+        entry.generation = generation;
+
+        known_nodes_.set(index);
+        online_nodes_.set(index, entry.status.mode != protocol::NodeStatus::MODE_OFFLINE);
     }
 
     void handleNodeStatus(const ReceivedDataStructure<protocol::NodeStatus>& msg)
     {
+        const MonotonicTime ts = sub_.getNode().getMonotonicTime();
+
         Entry new_entry;
-        new_entry.time_since_last_update_ms100 = 0;
+        new_entry.last_update_ms100 = getTimeMs100(ts);
         new_entry.status.health   = msg.health   & ((1 << protocol::NodeStatus::FieldTypes::health::BitLen) - 1);
         new_entry.status.mode     = msg.mode     & ((1 << protocol::NodeStatus::FieldTypes::mode::BitLen) - 1);
         new_entry.status.sub_mode = msg.sub_mode & ((1 << protocol::NodeStatus::FieldTypes::sub_mode::BitLen) - 1);
 
         changeNodeStatus(msg.getSrcNodeID(), new_entry);
 
+        /*
+         * The deadline of a node that has just been updated cannot be earlier than the one that is already scheduled
+         */
+        if (!timer_.isRunning() && online_nodes_.any())
+        {
+            timer_.startOneShotWithDeadline(ts +
+                                            MonotonicDuration::fromMSec((OfflineTimeoutMs100 + 1) * 100));
+        }
+
         handleNodeStatusMessage(msg);
     }
 
-    void handleTimerEvent(const TimerEvent&)
+    void handleTimerEvent(const TimerEvent& event)
     {
-        const int OfflineTimeoutMs100 = protocol::NodeStatus::OFFLINE_TIMEOUT_MS / 100;
+        const uint8_t now_ms100 = getTimeMs100(event.real_time);
+
+        /*
+         * If the timer was delayed for so long that the timestamps have wrapped around, there is no way to tell
+         * which nodes are still fresh; all of them are considered offline then.
+         */
+        const bool timestamps_wrapped =
+            (event.real_time - event.scheduled_time).toMSec() >= ((256 - OfflineTimeoutMs100 - 1) * 100);
+
+        unsigned min_time_to_offline_ms100 = 0;
 
         for (uint8_t i = 1; i <= NodeID::Max; i++)
         {
+            if (!online_nodes_.test(i - 1U))
+            {
+                continue;
+            }
             Entry& entry = getEntry(i);
-            if (entry.time_since_last_update_ms100 >= 0 &&
-                entry.status.mode != protocol::NodeStatus::MODE_OFFLINE)
+            const unsigned time_to_offline_ms100 = timestamps_wrapped ? 0U : getTimeToOfflineMs100(entry, now_ms100);
+            if (time_to_offline_ms100 == 0)
             {
-                entry.time_since_last_update_ms100 =
-                    int8_t(entry.time_since_last_update_ms100 + int8_t(TimerPeriodMs100));
-
-                if (entry.time_since_last_update_ms100 > OfflineTimeoutMs100)
-                {
-                    Entry new_entry_value = entry;
-                    new_entry_value.time_since_last_update_ms100 = OfflineTimeoutMs100;
-                    new_entry_value.status.mode = protocol::NodeStatus::MODE_OFFLINE;
-                    changeNodeStatus(i, new_entry_value);
-                }
+                Entry new_entry_value = entry;
+                new_entry_value.status.mode = protocol::NodeStatus::MODE_OFFLINE;
+                changeNodeStatus(i, new_entry_value);
             }
+            else if ((min_time_to_offline_ms100 == 0) || (time_to_offline_ms100 < min_time_to_offline_ms100))
+            {
+                min_time_to_offline_ms100 = time_to_offline_ms100;
+            }
+        }
+
+        if (min_time_to_offline_ms100 > 0 && !timer_.isRunning())    // The callbacks could have restarted it
+        {
+            timer_.startOneShotWithDeadline(event.real_time +
+                                            MonotonicDuration::fromMSec(min_time_to_offline_ms100 * 100));
         }
     }
 
@@ -181,7 +241,10 @@ public:
     explicit NodeStatusMonitor(INode& node)
         : sub_(node)
         , timer_(node)
-    { }
+        , generation_(0)
+    {
+        StaticAssert<(OfflineTimeoutMs100 < 127)>::check();
+    }
 
     virtual ~NodeStatusMonitor() { }
 
@@ -196,7 +259,6 @@ public:
         if (res >= 0)
         {
             timer_.setCallback(TimerCallback(this, &NodeStatusMonitor::handleTimerEvent));
-            timer_.startPeriodic(MonotonicDuration::fromMSec(TimerPeriodMs100 * 100));
         }
         return res;
     }
@@ -210,6 +272,8 @@ public:
         {
             Entry& entry = getEntry(node_id);
             entry = Entry();
+            known_nodes_.set(node_id.get() - 1U, false);
+            online_nodes_.set(node_id.get() - 1U, false);
         }
         else
         {
@@ -226,6 +290,8 @@ public:
         {
             entries_[i] = Entry();
         }
+        known_nodes_.reset();
+        online_nodes_.reset();
     }
 
     /**
@@ -241,10 +307,9 @@ public:
             return NodeStatus();
         }
 
-        const Entry& entry = getEntry(node_id);
-        if (entry.time_since_last_update_ms100 >= 0)
+        if (known_nodes_.test(node_id.get() - 1U))
         {
-            return entry.status;
+            return getEntry(node_id).status;
         }
         else
         {
@@ -263,7 +328,7 @@ public:
             UAVCAN_ASSERT(0);
             return false;
         }
-        return getEntry(node_id).time_since_last_update_ms100 >= 0;
+        return known_nodes_.test(node_id.get() - 1U);
     }
 
     /**
@@ -281,7 +346,7 @@ public:
             const NodeID nid(i);
             UAVCAN_ASSERT(nid.isUnicast());
             const Entry& entry = getEntry(nid);
-            if (entry.time_since_last_update_ms100 >= 0)
+            if (known_nodes_.test(i - 1U))
             {
                 if (entry.status.health > worst_health || !nid_with_worst_health.isValid())
                 {
@@ -306,12 +371,41 @@ public:
         {
             const NodeID nid(i);
             UAVCAN_ASSERT(nid.isUnicast());
+            if (known_nodes_.test(i - 1U))
+            {
+                op(nid, getEntry(nid).status);
+            }
+        }
+    }
+
+    /**
+     * The generation counter is incremented every time a node status changes, including the cases when a new node
+     * appears or a node goes offline. Use it with @ref forEachNodeChangedSince().
+     */
+    uint32_t getGeneration() const { return generation_; }
+
+    /**
+     * Calls the operator for every known node whose status has changed after the specified generation.
+     * This allows to track the network without polling every node; the returned value should be passed to the
+     * next call. Pass zero to visit all known nodes.
+     * Forgotten nodes are not reported.
+     * Operator signature:
+     *   void (NodeID, NodeStatus)
+     * @return          Current generation.
+     */
+    template <typename Operator>
+    uint32_t forEachNodeChangedSince(uint32_t generation, Operator op) const
+    {
+        for (uint8_t i = 1; i <= NodeID::Max; i++)
+        {
+            const NodeID nid(i);
             const Entry& entry = getEntry(nid);
-            if (entry.time_since_last_update_ms100 >= 0)
+            if (known_nodes_.test(i - 1U) && (entry.generation > generation))
             {
                 op(nid, entry.status);
             }
         }
+        return generation_;
     }
 };
 
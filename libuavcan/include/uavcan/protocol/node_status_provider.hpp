@@ -29,23 +29,46 @@ class UAVCAN_EXPORT NodeStatusProvider : private TimerBase
 {
     typedef MethodBinder<NodeStatusProvider*,
                          void (NodeStatusProvider::*)(const protocol::GetNodeInfo::Request&,
-                                                      protocol::GetNodeInfo::Response&)> GetNodeInfoCallback;
+                                                      ServiceResponseDataStructure<protocol::GetNodeInfo::Response>&)>
+        GetNodeInfoCallback;
+
+    typedef ServiceServer<protocol::GetNodeInfo, GetNodeInfoCallback> GetNodeInfoServer;
 
     const MonotonicTime creation_timestamp_;
 
     Publisher<protocol::NodeStatus> node_status_pub_;
-    ServiceServer<protocol::GetNodeInfo, GetNodeInfoCallback> gni_srv_;
+    GetNodeInfoServer gni_srv_;
 
     protocol::GetNodeInfo::Response node_info_;
 
+#if !UAVCAN_TINY
+    /*
+     * Requests often come from several nodes at once, e.g. when the node appears on the bus,
+     * so the response is encoded only once until node info changes.
+     */
+    GetNodeInfoServer::EncodedResponse encoded_node_info_;
+    bool encoded_node_info_valid_;
+#endif
+#if UAVCAN_DUTY_CYCLE_STATS
+    bool duty_cycle_reporting_;
+#endif
+
     INode& getNode() { return node_status_pub_.getNode(); }
 
     bool isNodeInfoInitialized() const;
 
+    void invalidateEncodedNodeInfo()
+    {
+#if !UAVCAN_TINY
+        encoded_node_info_valid_ = false;
+#endif
+    }
+
     int publish();
 
     virtual void handleTimerEvent(const TimerEvent&);
-    void handleGetNodeInfoRequest(const protocol::GetNodeInfo::Request&, protocol::GetNodeInfo::Response& rsp);
+    void handleGetNodeInfoRequest(const protocol::GetNodeInfo::Request&,
+                                  ServiceResponseDataStructure<protocol::GetNodeInfo::Response>& rsp);
 
 public:
     typedef typename StorageType<typename protocol::NodeStatus::FieldTypes::vendor_specific_status_code>::Type
@@ -58,6 +81,13 @@ public:
         , creation_timestamp_(node.getMonotonicTime())
         , node_status_pub_(node)
         , gni_srv_(node)
+#if !UAVCAN_TINY
+        , encoded_node_info_(TransferCRC())
+        , encoded_node_info_valid_(false)
+#endif
+#if UAVCAN_DUTY_CYCLE_STATS
+        , duty_cycle_reporting_(false)
+#endif
     {
         UAVCAN_ASSERT(!creation_timestamp_.isZero());
 
@@ -116,6 +146,16 @@ public:
         return node_info_.status.vendor_specific_status_code;
     }
 
+#if UAVCAN_DUTY_CYCLE_STATS
+    /**
+     * If enabled, every publication sets the vendor-specific status code to the total duty cycle of the library
+     * in the last measurement window, in permille, so that the overloaded nodes can be spotted by any monitor
+     * on the bus; see @ref DutyCycleCounter. Disabled by default.
+     */
+    void setDutyCycleReporting(bool enabled) { duty_cycle_reporting_ = enabled; }
+    bool isDutyCycleReportingEnabled() const { return duty_cycle_reporting_; }
+#endif
+
     /**
      * Local node name control.
      * Can be set only once before the provider is started.
@@ -0,0 +1,389 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_PROTOCOL_PARAM_RETRIEVER_HPP_INCLUDED
+#define UAVCAN_PROTOCOL_PARAM_RETRIEVER_HPP_INCLUDED
+
+#include <uavcan/build_config.hpp>
+#include <uavcan/debug.hpp>
+#include <uavcan/node/service_client.hpp>
+#include <uavcan/util/method_binder.hpp>
+#include <uavcan/protocol/param/GetSet.hpp>
+
+namespace uavcan
+{
+/**
+ * Application-specific parameter retrieval handler, see @ref ParamRetriever.
+ */
+class UAVCAN_EXPORT IParamRetrieverListener
+{
+public:
+    typedef typename StorageType<typename protocol::param::GetSet::Request::FieldTypes::index>::Type Index;
+
+    /**
+     * Called for every retrieved parameter before it is reported via @ref handleParamRetrieved().
+     * If this method returns true, the parameter is considered unchanged and will not be reported.
+     * This allows to fetch only the changes since the previous retrieval: the application stores the hashes
+     * reported via @ref handleParamRetrieved() and compares them here.
+     * Default implementation always returns false, so all parameters are reported.
+     */
+    virtual bool isParamUnchanged(NodeID node_id, Index index, uint32_t hash)
+    {
+        (void)node_id;
+        (void)index;
+        (void)hash;
+        return false;
+    }
+
+    /**
+     * Called for every new or changed parameter. The parameters may be reported out of order.
+     * @param hash      Hash of the name and the value of the parameter, see @ref ParamRetriever::computeParamHash().
+     */
+    virtual void handleParamRetrieved(NodeID node_id, Index index, const protocol::param::GetSet::Response& param,
+                                      uint32_t hash) = 0;
+
+    /**
+     * Called once the retrieval is finished.
+     * @param num_params    Number of parameters retrieved, including the unchanged ones.
+     * @param num_changed   Number of parameters that were reported via @ref handleParamRetrieved().
+     * @param complete      True if all parameters were retrieved; false if the remote node stopped responding.
+     */
+    virtual void handleParamRetrievalFinished(NodeID node_id, unsigned num_params, unsigned num_changed,
+                                              bool complete) = 0;
+
+    virtual ~IParamRetrieverListener() { }
+};
+
+/**
+ * This class reads all parameters of a remote node via the standard service uavcan.protocol.param.GetSet.
+ *
+ * Instead of waiting for every response before sending the next request, the retriever keeps several requests
+ * in flight, so the retrieval time is defined by the bus throughput rather than by the round trip time.
+ * The remote node doesn't need to support anything beyond the standard @ref ParamServer.
+ * A request that has timed out is repeated a few times before the retrieval is considered failed.
+ *
+ * Every retrieved parameter is hashed, and the application can suppress reporting of unchanged parameters,
+ * see @ref IParamRetrieverListener::isParamUnchanged().
+ *
+ * One instance of this class can retrieve parameters from one node at a time.
+ */
+class UAVCAN_EXPORT ParamRetriever : Noncopyable
+{
+public:
+    typedef IParamRetrieverListener::Index Index;
+
+    enum { MaxConcurrentRequests = 8 };
+    enum { DefaultConcurrentRequests = 4 };
+    enum { DefaultNumRequestAttempts = 3 };
+
+private:
+    typedef MethodBinder<ParamRetriever*,
+                         void (ParamRetriever::*)(const ServiceCallResult<protocol::param::GetSet>&)>
+            GetSetResponseCallback;
+
+    enum { IndexRange = 1U << protocol::param::GetSet::Request::FieldTypes::index::BitLen };
+
+    struct PendingRequest
+    {
+        ServiceCallID call_id;
+        Index index;
+        uint8_t num_attempts_made;
+
+        PendingRequest()
+            : index(0)
+            , num_attempts_made(0)
+        { }
+    };
+
+    ServiceClient<protocol::param::GetSet, GetSetResponseCallback> get_set_client_;
+    IParamRetrieverListener* listener_;
+    PendingRequest pending_requests_[MaxConcurrentRequests];
+    NodeID node_id_;
+    unsigned next_index_;
+    unsigned end_index_;                ///< All parameters at this index and above are known to not exist
+    unsigned num_params_;
+    unsigned num_changed_;
+    uint8_t max_concurrent_requests_;
+    uint8_t num_request_attempts_;
+
+    static void hashBytes(uint32_t& inout_hash, const void* data, unsigned size)
+    {
+        const uint8_t* const bytes = static_cast<const uint8_t*>(data);
+        for (unsigned i = 0; i < size; i++)
+        {
+            inout_hash = (inout_hash ^ bytes[i]) * 16777619U;      // FNV-1a
+        }
+    }
+
+    PendingRequest* findPendingRequest(ServiceCallID call_id)
+    {
+        for (unsigned i = 0; i < max_concurrent_requests_; i++)
+        {
+            if (pending_requests_[i].call_id == call_id)
+            {
+                return &pending_requests_[i];
+            }
+        }
+        return NULL;
+    }
+
+    int sendRequest(PendingRequest& slot)
+    {
+        protocol::param::GetSet::Request request;
+        request.index = slot.index;
+        const int res = get_set_client_.call(node_id_, request, slot.call_id);
+        if (res < 0)
+        {
+            slot.call_id = ServiceCallID();
+        }
+        else
+        {
+            slot.num_attempts_made++;
+        }
+        return res;
+    }
+
+    int sendNewRequests()
+    {
+        while (next_index_ < end_index_)
+        {
+            PendingRequest* const slot = findPendingRequest(ServiceCallID());
+            if (slot == NULL)
+            {
+                break;
+            }
+            slot->index = Index(next_index_);
+            slot->num_attempts_made = 0;
+            const int res = sendRequest(*slot);
+            if (res < 0)
+            {
+                return res;
+            }
+            next_index_++;
+        }
+        return 0;
+    }
+
+    bool hasPendingRequests() const
+    {
+        for (unsigned i = 0; i < max_concurrent_requests_; i++)
+        {
+            if (pending_requests_[i].call_id.isValid())
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void finish(bool complete)
+    {
+        const NodeID node_id = node_id_;
+        cancel();
+
+        UAVCAN_TRACE("ParamRetriever", "Node %d: %u params, %u changed, complete: %d",
+                     int(node_id.get()), num_params_, num_changed_, int(complete));
+        listener_->handleParamRetrievalFinished(node_id, num_params_, num_changed_, complete);
+    }
+
+    void handleGetSetResponse(const ServiceCallResult<protocol::param::GetSet>& result)
+    {
+        PendingRequest* const slot = findPendingRequest(result.getCallID());
+        if ((slot == NULL) || !isInProgress())
+        {
+            return;
+        }
+
+        if (!result.isSuccessful())
+        {
+            UAVCAN_TRACE("ParamRetriever", "Node %d: request for index %u failed",
+                         int(node_id_.get()), unsigned(slot->index));
+            if ((slot->num_attempts_made >= num_request_attempts_) || (sendRequest(*slot) < 0))
+            {
+                finish(false);
+            }
+            return;
+        }
+
+        const Index index = slot->index;
+        slot->call_id = ServiceCallID();
+
+        const protocol::param::GetSet::Response& param = result.getResponse();
+        if (param.name.empty())
+        {
+            end_index_ = min(end_index_, unsigned(index));      // The remote node has fewer parameters
+        }
+        else if (index < end_index_)
+        {
+            num_params_++;
+            const uint32_t hash = computeParamHash(param);
+            if (!listener_->isParamUnchanged(node_id_, index, hash))
+            {
+                num_changed_++;
+                listener_->handleParamRetrieved(node_id_, index, param, hash);
+            }
+        }
+        else
+        {
+            ;   // The node has changed its parameter list during retrieval; ignoring
+        }
+
+        if (!isInProgress())
+        {
+            return;     // The listener has cancelled the retrieval
+        }
+
+        if (sendNewRequests() < 0)
+        {
+            finish(false);
+        }
+        else if (!hasPendingRequests())
+        {
+            finish(true);
+        }
+        else
+        {
+            ;
+        }
+    }
+
+public:
+    explicit ParamRetriever(INode& node)
+        : get_set_client_(node)
+        , listener_(NULL)
+        , next_index_(0)
+        , end_index_(0)
+        , num_params_(0)
+        , num_changed_(0)
+        , max_concurrent_requests_(DefaultConcurrentRequests)
+        , num_request_attempts_(DefaultNumRequestAttempts)
+    { }
+
+    /**
+     * Starts the retrieval of all parameters from the specified node.
+     * The listener will be notified when the retrieval is finished, unless it is cancelled.
+     * Returns negative error code; fails if there's a retrieval in progress already.
+     */
+    int start(NodeID node_id, IParamRetrieverListener* listener,
+              const TransferPriority priority = TransferPriority::OneHigherThanLowest)
+    {
+        if (!node_id.isUnicast() || (listener == NULL))
+        {
+            return -ErrInvalidParam;
+        }
+        if (isInProgress())
+        {
+            return -ErrLogic;
+        }
+
+        int res = get_set_client_.init(priority);
+        if (res < 0)
+        {
+            return res;
+        }
+        get_set_client_.setCallback(GetSetResponseCallback(this, &ParamRetriever::handleGetSetResponse));
+
+        listener_ = listener;
+        node_id_ = node_id;
+        next_index_ = 0;
+        end_index_ = IndexRange;
+        num_params_ = 0;
+        num_changed_ = 0;
+
+        res = sendNewRequests();
+        if (res < 0)
+        {
+            cancel();
+        }
+        return res;
+    }
+
+    /**
+     * Stops the retrieval; the listener will not be notified.
+     */
+    void cancel()
+    {
+        get_set_client_.cancelAllCalls();
+        for (unsigned i = 0; i < MaxConcurrentRequests; i++)
+        {
+            pending_requests_[i] = PendingRequest();
+        }
+        node_id_ = NodeID();
+    }
+
+    bool isInProgress() const { return node_id_.isUnicast(); }
+
+    /**
+     * Node ID of the node the parameters are being retrieved from. Invalid if there's no retrieval in progress.
+     */
+    NodeID getNodeID() const { return node_id_; }
+
+    /**
+     * Hash of the name and the value of the parameter; default, min and max values are not accounted.
+     */
+    static uint32_t computeParamHash(const protocol::param::GetSet::Response& param)
+    {
+        typedef protocol::param::Value Value;
+
+        uint32_t hash = 2166136261U;
+        hashBytes(hash, param.name.c_str(), param.name.size());
+
+        const uint8_t tag = uint8_t(param.value.getTag());
+        hashBytes(hash, &tag, 1);
+
+        if (param.value.is(Value::Tag::integer_value))
+        {
+            const int64_t x = param.value.integer_value;
+            hashBytes(hash, &x, sizeof(x));
+        }
+        else if (param.value.is(Value::Tag::real_value))
+        {
+            const float x = param.value.real_value;
+            hashBytes(hash, &x, sizeof(x));
+        }
+        else if (param.value.is(Value::Tag::boolean_value))
+        {
+            const uint8_t x = param.value.boolean_value ? 1U : 0U;
+            hashBytes(hash, &x, 1);
+        }
+        else if (param.value.is(Value::Tag::string_value))
+        {
+            hashBytes(hash, param.value.string_value.c_str(), param.value.string_value.size());
+        }
+        else
+        {
+            ;   // Empty value
+        }
+        return hash;
+    }
+
+    /**
+     * Number of requests that are kept in flight, in the range [1, MaxConcurrentRequests].
+     * It cannot be changed while a retrieval is in progress.
+     */
+    uint8_t getMaxConcurrentRequests() const { return max_concurrent_requests_; }
+    void setMaxConcurrentRequests(uint8_t num)
+    {
+        if (!isInProgress())
+        {
+            max_concurrent_requests_ = max(uint8_t(1), min(num, uint8_t(MaxConcurrentRequests)));
+        }
+    }
+
+    /**
+     * Number of attempts to request one parameter before the retrieval is considered failed. At least one.
+     */
+    uint8_t getNumRequestAttempts() const { return num_request_attempts_; }
+    void setNumRequestAttempts(uint8_t num) { num_request_attempts_ = max(uint8_t(1), num); }
+
+    /**
+     * Request timeout, see @ref ServiceClient.
+     */
+    MonotonicDuration getRequestTimeout() const { return get_set_client_.getRequestTimeout(); }
+    void setRequestTimeout(MonotonicDuration timeout) { get_set_client_.setRequestTimeout(timeout); }
+};
+
+}
+
+#endif // UAVCAN_PROTOCOL_PARAM_RETRIEVER_HPP_INCLUDED
@@ -0,0 +1,437 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_PROTOCOL_PERSISTENT_PARAM_MANAGER_HPP_INCLUDED
+#define UAVCAN_PROTOCOL_PERSISTENT_PARAM_MANAGER_HPP_INCLUDED
+
+#include <uavcan/build_config.hpp>
+#include <uavcan/protocol/indexed_param_manager.hpp>
+#include <uavcan/node/timer.hpp>
+#include <uavcan/util/bitset.hpp>
+#include <uavcan/util/method_binder.hpp>
+
+namespace uavcan
+{
+/**
+ * Raw non-volatile storage for @ref ParamLog, e.g. two sectors of the on-chip flash.
+ * The storage consists of two banks of the same size. Erased bytes read as 0xFF; every byte is written at most once
+ * between erasures, and writes of a bank always progress from lower to higher offsets. The backend must accept
+ * writes of arbitrary length and alignment.
+ */
+class UAVCAN_EXPORT IParamStorageBackend
+{
+public:
+    enum { NumBanks = 2 };
+
+    virtual ~IParamStorageBackend() { }
+
+    /**
+     * Size of one bank in bytes.
+     */
+    virtual unsigned getBankSize() const = 0;
+
+    /**
+     * These methods return negative error code.
+     * @{
+     */
+    virtual int read(uint8_t bank, unsigned offset, uint8_t* data, unsigned len) = 0;
+    virtual int write(uint8_t bank, unsigned offset, const uint8_t* data, unsigned len) = 0;
+    virtual int erase(uint8_t bank) = 0;
+    /**
+     * @}
+     */
+};
+
+/**
+ * Log-structured parameter storage: every saved value is appended to the active bank as a record, so that saving
+ * a few changed parameters writes only their records. When the active bank is full, the current values of all
+ * parameters are written into the other bank (compaction), which becomes active once its header is written;
+ * hence a power loss at any moment leaves one of the two banks valid.
+ *
+ * Bank layout: header (magic, sequence number, CRC), then records until the first erased byte.
+ * Record layout: name length, value length, name, value encoded as DSDL uavcan.protocol.param.Value, CRC.
+ * The records are replayed in order upon load, so the last record of a parameter wins. Damaged records
+ * terminate the log and force a compaction upon the next append.
+ * All CRCs are CRC-16-CCITT, same as the transfer CRC.
+ */
+class UAVCAN_EXPORT ParamLog : Noncopyable
+{
+public:
+    typedef IParamManager::Name Name;
+    typedef IParamManager::Value Value;
+
+    /**
+     * Receives the records during @ref open().
+     */
+    class IVisitor
+    {
+    public:
+        virtual void handleRecord(const Name& name, const Value& value) = 0;
+        virtual ~IVisitor() { }
+    };
+
+    enum { HeaderSize = 10 };
+    enum { MaxValueSize = BitLenToByteLen<Value::MaxBitLen>::Result };
+    enum { MaxRecordSize = 2 + Name::MaxSize + MaxValueSize + 2 };
+
+private:
+    enum { Magic = 0x474C5055 };    // "UPLG"
+
+    IParamStorageBackend& backend_;
+    uint32_t sequence_;             ///< Of the active bank
+    unsigned write_pos_;            ///< Of the active bank, or of the new bank during compaction
+    uint8_t active_bank_;
+    bool has_active_bank_;
+    bool compacting_;
+    uint8_t buffer_[MaxRecordSize];
+
+    uint8_t getInactiveBank() const { return uint8_t((active_bank_ + 1U) % IParamStorageBackend::NumBanks); }
+
+    int readHeader(uint8_t bank, uint32_t& out_sequence);
+    int writeHeader(uint8_t bank, uint32_t sequence);
+    int scan(uint8_t bank, IVisitor* visitor, unsigned& out_end);
+    int writeRecord(uint8_t bank, unsigned& inout_pos, const Name& name, const Value& value);
+
+public:
+    explicit ParamLog(IParamStorageBackend& backend)
+        : backend_(backend)
+        , sequence_(0)
+        , write_pos_(0)
+        , active_bank_(0)
+        , has_active_bank_(false)
+        , compacting_(false)
+    { }
+
+    /**
+     * Finds the active bank and replays its records in order.
+     * An empty storage is not an error; the first append will fail with -ErrMemory, requesting a compaction.
+     * Returns negative error code.
+     */
+    int open(IVisitor* visitor);
+
+    /**
+     * Appends a record to the active bank.
+     * Returns -ErrMemory if there's no space left, which means that a compaction is needed;
+     * other negative error codes are backend errors.
+     */
+    int append(const Name& name, const Value& value);
+
+    /**
+     * Compaction: erases the inactive bank, which then receives the records of all parameters,
+     * and becomes active when committed. The active bank is intact until then, so the compaction can be aborted.
+     * Append is not allowed during compaction. These methods return negative error code.
+     * @{
+     */
+    int beginCompaction();
+    int appendToCompaction(const Name& name, const Value& value);
+    int commitCompaction();
+    void abortCompaction();
+    bool isCompacting() const { return compacting_; }
+    /**
+     * @}
+     */
+
+    /**
+     * Erases both banks.
+     * Returns negative error code.
+     */
+    int erase();
+
+    /**
+     * Bytes taken in the active bank, including the header; zero if there's no active bank.
+     */
+    unsigned getUsedSize() const { return (has_active_bank_ && !compacting_) ? write_pos_ : 0; }
+    bool hasActiveBank() const { return has_active_bank_; }
+    uint8_t getActiveBank() const { return active_bank_; }
+    uint32_t getSequence() const { return sequence_; }
+};
+
+/**
+ * Param manager that stores the parameters in a @ref ParamLog, so that a save writes only the parameters
+ * that have been changed since the last save. The application implements the index-based access methods
+ * of @ref IndexedParamManager, and calls @ref loadParams() once at startup.
+ *
+ * The parameters assigned via @ref ParamServer are marked dirty automatically if their value has actually changed;
+ * the ones modified by the application directly must be marked with @ref markParamDirty().
+ *
+ * By default, @ref saveAllParams() writes the dirty parameters before returning. In the asynchronous mode,
+ * it returns immediately and the records are written one by one from the timer events, one record per step
+ * interval, so that the node keeps processing the traffic in between; note that a compaction starts
+ * with erasure of a bank, which may take long depending on the storage. The response to the save request
+ * then only indicates whether the save has been accepted; see @ref getLastSaveResult().
+ *
+ * @tparam MaxParams    Same as for @ref IndexedParamManager. The dirty flags take one bit per parameter.
+ */
+template <unsigned MaxParams>
+class UAVCAN_EXPORT PersistentParamManager : public IndexedParamManager<MaxParams>
+{
+    typedef IndexedParamManager<MaxParams> Base;
+    typedef PersistentParamManager<MaxParams> SelfType;
+    typedef MethodBinder<SelfType*, void (SelfType::*)(const TimerEvent&)> TimerCallback;
+
+public:
+    typedef typename Base::Name Name;
+    typedef typename Base::Index Index;
+    typedef typename Base::Value Value;
+
+private:
+    class Loader : public ParamLog::IVisitor
+    {
+        SelfType& owner_;
+
+    public:
+        unsigned num_unknown;
+
+        explicit Loader(SelfType& owner)
+            : owner_(owner)
+            , num_unknown(0)
+        { }
+
+        virtual void handleRecord(const Name& name, const Value& value)
+        {
+            Index index = 0;
+            if (owner_.findParamIndex(name, index))
+            {
+                owner_.assignParamValueByIndex(index, value);
+            }
+            else
+            {
+                num_unknown++;      // Removed from the firmware; it will be dropped by the next compaction
+            }
+        }
+    };
+
+    ParamLog log_;
+    TimerEventForwarder<TimerCallback> timer_;
+    BitSet<MaxParams> dirty_;
+    MonotonicDuration step_interval_;
+    int last_save_result_;
+    Index compaction_index_;
+    bool async_;
+    bool save_pending_;
+
+    Index getNumStoredParams() const { return Index(min(unsigned(this->getNumParams()), MaxParams)); }
+
+    int writeParam(Index index, bool compaction)
+    {
+        Name name;
+        Value value;
+        this->getParamNameByIndex(index, name);
+        this->readParamValueByIndex(index, value);
+        dirty_.set(index, false);   // Changes made from now on will be written later
+        return compaction ? log_.appendToCompaction(name, value) : log_.append(name, value);
+    }
+
+    /**
+     * Writes one record.
+     * Returns positive if there's more to do, zero if done, negative error code.
+     */
+    int step()
+    {
+        const Index num_params = getNumStoredParams();
+
+        if (log_.isCompacting())
+        {
+            if (compaction_index_ < num_params)
+            {
+                const int res = writeParam(compaction_index_, true);
+                if (res < 0)
+                {
+                    UAVCAN_TRACE("PersistentParamManager", "Compaction failed: %i", res);
+                    log_.abortCompaction();
+                    markAllParamsDirty();
+                    return res;
+                }
+                compaction_index_++;
+                return 1;
+            }
+            const int res = log_.commitCompaction();
+            if (res < 0)
+            {
+                markAllParamsDirty();
+                return res;
+            }
+            UAVCAN_TRACE("PersistentParamManager", "Compacted, %u bytes", log_.getUsedSize());
+            return dirty_.any() ? 1 : 0;    // Modified during the compaction
+        }
+
+        for (Index index = 0; index < num_params; index++)
+        {
+            if (dirty_.test(index))
+            {
+                const int res = writeParam(index, false);
+                if (res == -ErrMemory)
+                {
+                    dirty_.set(index);
+                    compaction_index_ = 0;
+                    const int compaction_res = log_.beginCompaction();
+                    return (compaction_res < 0) ? compaction_res : 1;
+                }
+                if (res < 0)
+                {
+                    dirty_.set(index);
+                    return res;
+                }
+                return 1;
+            }
+        }
+        return 0;
+    }
+
+    void finishSave(int result)
+    {
+        save_pending_ = false;
+        last_save_result_ = result;
+    }
+
+    void handleTimerEvent(const TimerEvent&)
+    {
+        if (!save_pending_)
+        {
+            return;
+        }
+        const int res = step();
+        if (res > 0)
+        {
+            timer_.startOneShotWithDelay(step_interval_);
+        }
+        else
+        {
+            finishSave(res);
+        }
+    }
+
+public:
+    PersistentParamManager(IParamStorageBackend& backend, INode& node)
+        : log_(backend)
+        , timer_(node)
+        , step_interval_(MonotonicDuration::fromMSec(1))
+        , last_save_result_(0)
+        , compaction_index_(0)
+        , async_(false)
+        , save_pending_(false)
+    {
+        timer_.setCallback(TimerCallback(this, &SelfType::handleTimerEvent));
+    }
+
+    /**
+     * Shall be called once at startup; assigns the saved values to the parameters.
+     * The unknown parameters are ignored. Returns negative error code.
+     */
+    int loadParams()
+    {
+        Loader loader(*this);
+        const int res = log_.open(&loader);
+        dirty_.reset();
+        if (loader.num_unknown > 0)
+        {
+            UAVCAN_TRACE("PersistentParamManager", "%u unknown records", loader.num_unknown);
+        }
+        return res;
+    }
+
+    /**
+     * Dirty parameters will be written upon the next save.
+     */
+    void markParamDirty(Index index)
+    {
+        if (index < MaxParams)
+        {
+            dirty_.set(index);
+        }
+    }
+    void markAllParamsDirty()
+    {
+        for (Index i = 0; i < getNumStoredParams(); i++)
+        {
+            dirty_.set(i);
+        }
+    }
+    bool isParamDirty(Index index) const { return (index < MaxParams) && dirty_.test(index); }
+    unsigned getNumDirtyParams() const { return unsigned(dirty_.count()); }
+
+    /**
+     * See the class documentation. The step interval can be zero, then every timer event of the scheduler
+     * writes one record. Disabled by default. Affects only the saves that are requested afterwards.
+     */
+    void setAsyncSave(bool async) { async_ = async; }
+    bool isAsyncSave() const { return async_; }
+    void setSaveStepInterval(MonotonicDuration interval) { step_interval_ = max(interval, MonotonicDuration()); }
+    MonotonicDuration getSaveStepInterval() const { return step_interval_; }
+
+    /**
+     * Whether an asynchronous save is in progress.
+     */
+    bool isSavePending() const { return save_pending_; }
+
+    /**
+     * Result of the last completed save; negative error code.
+     */
+    int getLastSaveResult() const { return last_save_result_; }
+
+    /**
+     * Access to the underlying log, e.g. to inspect the storage usage.
+     */
+    const ParamLog& getLog() const { return log_; }
+
+    /**
+     * Methods of @ref IParamManager.
+     */
+    virtual void assignParamValue(const Name& name, const Value& value)
+    {
+        Index index = 0;
+        if (!this->findParamIndex(name, index))
+        {
+            return;
+        }
+        Value old_value;
+        this->readParamValueByIndex(index, old_value);
+        this->assignParamValueByIndex(index, value);
+        Value new_value;
+        this->readParamValueByIndex(index, new_value);
+        if (!(old_value == new_value))
+        {
+            markParamDirty(index);
+        }
+    }
+
+    virtual int saveAllParams()
+    {
+        if (async_)
+        {
+            if (!save_pending_)
+            {
+                save_pending_ = true;
+                timer_.startOneShotWithDelay(MonotonicDuration());
+            }
+            return 0;
+        }
+
+        save_pending_ = true;   // Prevents the timer from interfering if the mode was switched during a save
+        int res = 0;
+        do
+        {
+            res = step();
+        }
+        while (res > 0);
+        finishSave(res);
+        return res;
+    }
+
+    virtual int eraseAllParams()
+    {
+        timer_.stop();
+        if (log_.isCompacting())
+        {
+            log_.abortCompaction();
+        }
+        save_pending_ = false;
+        markAllParamsDirty();       // The storage no longer has any of the current values
+        return log_.erase();
+    }
+};
+
+}
+
+#endif // UAVCAN_PROTOCOL_PERSISTENT_PARAM_MANAGER_HPP_INCLUDED
@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_PROTOCOL_TIME_SYNC_STATS_HPP_INCLUDED
+#define UAVCAN_PROTOCOL_TIME_SYNC_STATS_HPP_INCLUDED
+
+#include <uavcan/build_config.hpp>
+#include <uavcan/std.hpp>
+#include <uavcan/util/templates.hpp>
+
+namespace uavcan
+{
+/**
+ * Statistics of a series of time intervals, used by the time synchronization classes to assess the quality of
+ * the timestamps, see @ref GlobalTimeSyncMaster and @ref GlobalTimeSyncSlave.
+ *
+ * The jitter is estimated as the smoothed absolute difference between consecutive samples, as defined by RFC 3550:
+ *      J += (|D| - J) / 16
+ * Therefore a constant offset doesn't contribute to the jitter, only its variation does.
+ */
+class UAVCAN_EXPORT TimeSyncJitterStats
+{
+    int64_t last_usec_;
+    int64_t min_usec_;
+    int64_t max_usec_;
+    uint64_t jitter_usec_x16_;      ///< Scaled by 16 to preserve precision, as recommended by RFC 3550
+    uint32_t num_samples_;
+
+public:
+    TimeSyncJitterStats() { reset(); }
+
+    void addSample(int64_t usec)
+    {
+        if (num_samples_ > 0)
+        {
+            const int64_t diff = usec - last_usec_;
+            const uint64_t abs_diff = uint64_t((diff < 0) ? -diff : diff);
+            jitter_usec_x16_ = jitter_usec_x16_ - (jitter_usec_x16_ + 8U) / 16U + abs_diff;
+            min_usec_ = min(min_usec_, usec);
+            max_usec_ = max(max_usec_, usec);
+        }
+        else
+        {
+            min_usec_ = max_usec_ = usec;
+        }
+        last_usec_ = usec;
+        num_samples_++;
+    }
+
+    void reset()
+    {
+        last_usec_ = 0;
+        min_usec_ = 0;
+        max_usec_ = 0;
+        jitter_usec_x16_ = 0;
+        num_samples_ = 0;
+    }
+
+    /**
+     * All values are zero if there were no samples since the last reset.
+     */
+    uint32_t getNumSamples() const { return num_samples_; }
+    int64_t getLastUSec() const { return last_usec_; }
+    int64_t getMinUSec() const { return min_usec_; }
+    int64_t getMaxUSec() const { return max_usec_; }
+    uint64_t getJitterUSec() const { return jitter_usec_x16_ / 16U; }
+};
+
+}
+
+#endif // UAVCAN_PROTOCOL_TIME_SYNC_STATS_HPP_INCLUDED
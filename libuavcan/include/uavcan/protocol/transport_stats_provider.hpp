@@ -15,6 +15,10 @@ namespace uavcan
 /**
  * This class provides statistics about the transport layer performance on the local node.
  * The user's application does not deal with this class directly because it's instantiated by the node class.
+ *
+ * The response of uavcan.protocol.GetTransportStats has a fixed layout, so the per data type counters
+ * (UAVCAN_DATA_TYPE_PERF_STATS) are not reported here; they can be accessed locally via
+ * @ref INode::getDataTypePerfCounters(), and remotely via @ref TransportStatsPublisher.
  */
 class UAVCAN_EXPORT TransportStatsProvider : Noncopyable
 {
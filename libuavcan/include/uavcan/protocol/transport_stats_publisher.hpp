@@ -0,0 +1,288 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_PROTOCOL_TRANSPORT_STATS_PUBLISHER_HPP_INCLUDED
+#define UAVCAN_PROTOCOL_TRANSPORT_STATS_PUBLISHER_HPP_INCLUDED
+
+#include <cstdlib>
+#include <uavcan/build_config.hpp>
+#include <uavcan/debug.hpp>
+#include <uavcan/node/publisher.hpp>
+#include <uavcan/node/timer.hpp>
+#include <uavcan/protocol/debug/KeyValue.hpp>
+
+namespace uavcan
+{
+/**
+ * This class periodically broadcasts the transport layer statistics of the local node, so that the network monitors
+ * don't need to poll every node via uavcan.protocol.GetTransportStats.
+ *
+ * Every counter is published as a separate uavcan.protocol.debug.KeyValue message, where the value is the
+ * increment of the counter since its previous publication. Counters that did not change are not published,
+ * so the bus load depends on the activity of the node rather than on the publication rate. Since the counters are
+ * assumed to be zero at start, the sum of all received increments equals the value of the counter, unless some
+ * messages were lost. Keys are as follows:
+ *
+ *      tr.tx, tr.rx, tr.err        - transfer counters, see @ref TransferPerfCounter
+ *      canN.tx, canN.rx, canN.err  - frame counters of the CAN interface N, see @ref CanIfacePerfCounters
+ *      latS.B                      - bucket B of the latency histogram S, see @ref LatencyStage and
+ *                                    @ref LatencyHistogram; only if UAVCAN_LATENCY_STATS is enabled
+ *      cycS.B, cycS.max            - bucket B and the maximum of the execution time histogram S, see
+ *                                    @ref ExecutionStage and @ref ExecutionTimeHistogram; the sum of the increments
+ *                                    of the maximum is valid until the histogram is reset by the application;
+ *                                    only if UAVCAN_EXECUTION_TIME_STATS is enabled
+ *      mD.DC, sD.DC                - counter C of the message or service data type ID D in the direction D
+ *                                    (rx or tx), where C is "f" for frames, "b" for bytes, "t" for transfers,
+ *                                    and "e" for errors, e.g. "m341.rxf"; see @ref DataTypePerfCounters;
+ *                                    only if UAVCAN_DATA_TYPE_PERF_STATS is enabled
+ *
+ * Increments are published as floats, so they are exact up to 2^24.
+ *
+ * The number of messages per interval is limited; the counters that could not be published during the current
+ * interval are published during the next one, in a round-robin fashion. The interval is randomized by +/-1/8 to
+ * avoid synchronization between the nodes; this class uses std::rand(), so the RNG should be seeded properly.
+ */
+class UAVCAN_EXPORT TransportStatsPublisher : private TimerBase
+{
+public:
+    enum { DefaultMaxMessagesPerInterval = 8 };
+
+private:
+    enum { NumTransferCounters = 3 };
+    enum { NumIfaceCounters = 3 };
+#if UAVCAN_LATENCY_STATS
+    enum { NumLatencyCounters = NumLatencyStages * LatencyHistogram::NumBuckets };
+#else
+    enum { NumLatencyCounters = 0 };
+#endif
+#if UAVCAN_EXECUTION_TIME_STATS
+    enum { NumCountersPerExecutionStage = ExecutionTimeHistogram::NumBuckets + 1 };
+    enum { NumExecutionTimeCounters = NumExecutionStages * NumCountersPerExecutionStage };
+#else
+    enum { NumExecutionTimeCounters = 0 };
+#endif
+#if UAVCAN_DATA_TYPE_PERF_STATS
+    enum { NumCountersPerDataType = 8 };
+    enum { NumDataTypeCounters = DataTypePerfCounters::Capacity * NumCountersPerDataType };
+#else
+    enum { NumDataTypeCounters = 0 };
+#endif
+    enum
+    {
+        NumCounters = NumTransferCounters + MaxCanIfaces * NumIfaceCounters + NumLatencyCounters +
+                      NumExecutionTimeCounters + NumDataTypeCounters
+    };
+
+    Publisher<protocol::debug::KeyValue> pub_;
+    MonotonicDuration interval_;
+    uint32_t reported_values_[NumCounters];     ///< Modulo 2^32, that's enough to compute the increments
+    uint16_t next_counter_;
+    uint8_t max_messages_per_interval_;
+
+    /**
+     * Returns false if the counter does not exist, e.g. because there is no such interface.
+     */
+    bool readCounter(unsigned index, uint32_t& out_value, protocol::debug::KeyValue::FieldTypes::key& out_key) const
+    {
+        const Dispatcher& dispatcher = pub_.getNode().getDispatcher();
+
+        if (index < NumTransferCounters)
+        {
+            const TransferPerfCounter& perf = dispatcher.getTransferPerfCounter();
+            static const char* const Keys[NumTransferCounters] = { "tr.tx", "tr.rx", "tr.err" };
+            const uint64_t values[NumTransferCounters] =
+            {
+                perf.getTxTransferCount(), perf.getRxTransferCount(), perf.getErrorCount()
+            };
+            out_value = uint32_t(values[index]);
+            out_key = Keys[index];
+            return true;
+        }
+        index -= NumTransferCounters;
+
+        if (index < (MaxCanIfaces * NumIfaceCounters))
+        {
+            const uint8_t iface_index = uint8_t(index / NumIfaceCounters);
+            const CanIOManager& canio = dispatcher.getCanIOManager();
+            if (iface_index >= canio.getNumIfaces())
+            {
+                return false;
+            }
+            const CanIfacePerfCounters perf = canio.getIfacePerfCounters(iface_index);
+            static const char* const Formats[NumIfaceCounters] = { "can%u.tx", "can%u.rx", "can%u.err" };
+            const uint64_t values[NumIfaceCounters] = { perf.frames_tx, perf.frames_rx, perf.errors };
+            out_value = uint32_t(values[index % NumIfaceCounters]);
+            out_key.clear();
+            out_key.appendFormatted(Formats[index % NumIfaceCounters], unsigned(iface_index));
+            return true;
+        }
+        index -= MaxCanIfaces * NumIfaceCounters;
+
+#if UAVCAN_LATENCY_STATS
+        if (index < NumLatencyCounters)
+        {
+            const unsigned stage = index / LatencyHistogram::NumBuckets;
+            const unsigned bucket = index % LatencyHistogram::NumBuckets;
+            out_value = dispatcher.getTransferPerfCounter().getLatencyHistogram(LatencyStage(stage))
+                                                           .getBucketCount(bucket);
+            out_key.clear();
+            out_key.appendFormatted("lat%u.", stage);
+            out_key.appendFormatted("%u", bucket);
+            return true;
+        }
+        index -= NumLatencyCounters;
+#endif
+
+#if UAVCAN_EXECUTION_TIME_STATS
+        if (index < NumExecutionTimeCounters)
+        {
+            const unsigned stage = index / NumCountersPerExecutionStage;
+            const unsigned counter = index % NumCountersPerExecutionStage;
+            const ExecutionTimeHistogram& hist =
+                dispatcher.getTransferPerfCounter().getExecutionTimeHistogram(ExecutionStage(stage));
+            out_key.clear();
+            out_key.appendFormatted("cyc%u.", stage);
+            if (counter < ExecutionTimeHistogram::NumBuckets)
+            {
+                out_value = hist.getBucketCount(counter);
+                out_key.appendFormatted("%u", counter);
+            }
+            else
+            {
+                out_value = hist.getMaxCycles();
+                out_key += "max";
+            }
+            return true;
+        }
+        index -= NumExecutionTimeCounters;
+#endif
+
+#if UAVCAN_DATA_TYPE_PERF_STATS
+        if (index < NumDataTypeCounters)
+        {
+            // Unused slots are skipped; a slot is never reassigned, so the reported values remain consistent
+            const DataTypePerfCounters::Entry& entry =
+                dispatcher.getTransferPerfCounter().getDataTypePerfCounters().getEntry(index / NumCountersPerDataType);
+            if (!entry.isUsed())
+            {
+                return false;
+            }
+            const unsigned counter = index % NumCountersPerDataType;
+            const DataTypePerfCounters::Counters& c = (counter < 4) ? entry.rx : entry.tx;
+            const uint32_t values[4] = { c.frames, c.bytes, c.transfers, c.errors };
+            static const char CounterChars[4] = { 'f', 'b', 't', 'e' };
+            out_value = values[counter % 4];
+            out_key.clear();
+            out_key.appendFormatted((entry.getDataTypeKind() == DataTypeKindMessage) ? "m%u." : "s%u.",
+                                    unsigned(entry.getDataTypeID().get()));
+            out_key += (counter < 4) ? "rx" : "tx";
+            out_key.push_back(uint8_t(CounterChars[counter % 4]));
+            return true;
+        }
+#endif
+        UAVCAN_ASSERT(0);
+        return false;
+    }
+
+    void scheduleNextPublication(MonotonicTime since)
+    {
+        const int64_t interval_usec = interval_.toUSec();
+        const int64_t jitter_range_usec = interval_usec / 4;
+        const int64_t jitter_usec = (jitter_range_usec > 0) ?
+                                    ((int64_t(std::rand()) % (jitter_range_usec + 1)) - jitter_range_usec / 2) : 0;
+        startOneShotWithDeadline(since + MonotonicDuration::fromUSec(interval_usec + jitter_usec));
+    }
+
+    virtual void handleTimerEvent(const TimerEvent& event)
+    {
+        unsigned num_published = 0;
+
+        for (unsigned i = 0; (i < NumCounters) && (num_published < max_messages_per_interval_); i++)
+        {
+            const unsigned index = next_counter_;
+            next_counter_ = uint16_t((next_counter_ + 1U) % unsigned(NumCounters));
+
+            protocol::debug::KeyValue msg;
+            uint32_t value = 0;
+            if (!readCounter(index, value, msg.key))
+            {
+                continue;
+            }
+
+            const uint32_t increment = value - reported_values_[index];
+            if (increment == 0)
+            {
+                continue;
+            }
+
+            msg.value = float(increment);
+            const int res = pub_.broadcast(msg);
+            if (res < 0)
+            {
+                UAVCAN_TRACE("TransportStatsPublisher", "Publication failure: %i", res);
+                next_counter_ = uint16_t(index);        // Will be repeated next time
+                break;
+            }
+            reported_values_[index] = value;
+            num_published++;
+        }
+
+        scheduleNextPublication(event.real_time);
+    }
+
+public:
+    explicit TransportStatsPublisher(INode& node)
+        : TimerBase(node)
+        , pub_(node)
+        , interval_(getDefaultInterval())
+        , next_counter_(0)
+        , max_messages_per_interval_(DefaultMaxMessagesPerInterval)
+    {
+        fill(reported_values_, reported_values_ + NumCounters, uint32_t(0));
+    }
+
+    static MonotonicDuration getDefaultInterval() { return MonotonicDuration::fromMSec(5000); }
+
+    /**
+     * Starts the periodic publications; the first one takes place after one interval.
+     * If the publisher is already running, the interval will be restarted.
+     * @param interval      Average publication interval.
+     * @param priority      Transfer priority. The lowest one is used by default.
+     * Returns negative error code.
+     */
+    int start(MonotonicDuration interval = getDefaultInterval(),
+              const TransferPriority priority = TransferPriority::Lowest)
+    {
+        if (!interval.isPositive())
+        {
+            return -ErrInvalidParam;
+        }
+
+        const int res = pub_.init(priority);
+        if (res < 0)
+        {
+            return res;
+        }
+        pub_.setTxTimeout(interval);
+
+        interval_ = interval;
+        scheduleNextPublication(pub_.getNode().getMonotonicTime());
+        return 0;
+    }
+
+    using TimerBase::stop;
+    using TimerBase::isRunning;
+
+    MonotonicDuration getInterval() const { return interval_; }
+
+    /**
+     * Maximum number of KeyValue messages published per interval. The value cannot be less than one.
+     */
+    uint8_t getMaxMessagesPerInterval() const { return max_messages_per_interval_; }
+    void setMaxMessagesPerInterval(uint8_t num) { max_messages_per_interval_ = max(num, uint8_t(1)); }
+};
+
+}
+
+#endif // UAVCAN_PROTOCOL_TRANSPORT_STATS_PUBLISHER_HPP_INCLUDED
@@ -20,6 +20,18 @@ public:
 
     virtual int read(unsigned offset, uint8_t* data, unsigned len) const = 0;
     virtual int write(unsigned offset, const uint8_t* data, unsigned len) = 0;
+
+    /**
+     * If the buffered data is stored in one contiguous span, returns a pointer to it and the number of valid
+     * bytes (the same as returned by read() from zero offset); otherwise returns null.
+     * This allows the readers to access the data directly instead of calling read() for every piece of it.
+     * The pointer is invalidated by any write(). The default implementation returns null.
+     */
+    virtual const uint8_t* getContiguousData(unsigned& out_len) const
+    {
+        out_len = 0;
+        return NULL;
+    }
 };
 
 }
@@ -26,16 +26,27 @@ namespace uavcan
  * Subsequently obtained configurations are then loaded into the CAN driver by calling the applyConfiguration() method.
  * If the cumulative number of configurations obtained by computeConfiguration() and addFilterConfig() is higher than
  * the number of available HW filters, configurations will be merged automatically in the most efficient way.
+ * If the driver can pack several configurations into one HW filter (@ref ICanIface::getNumFiltersRequired()),
+ * the configurations are merged only until they fit.
  *
  * Note that if the application adds additional server or subscriber objects after the filters have been configured,
- * the configuration procedure will have to be performed again.
+ * the configuration procedure will have to be performed again, unless the automatic reconfiguration mode is enabled
+ * via enableAutoReconfiguration(). In this mode the object keeps the filters in sync with the dispatcher's list of
+ * message listeners: a new subscription either reuses a filter that already accepts it, or takes a spare filter, or
+ * gets merged into the filter where the merge adds the fewest falsely accepted CAN IDs; this costs O(N) per
+ * subscription instead of the O(N^2) full recomputation. Removal of a subscription whose filter was merged with
+ * others triggers the full recomputation, because merged filters cannot be split.
+ *
+ * Whenever filters have to be merged, the pair whose merge adds the fewest CAN IDs that are not accepted by
+ * either of the original filters is merged first. The resulting loss of selectivity can be assessed with
+ * getEstimatedLeakRate().
  *
  * The maximum number of CAN acceptance filters is predefined in uavcan/build_config.hpp through a constant
  * @ref MaxCanAcceptanceFilters. The algorithm doesn't allow to have higher number of HW filters configurations than
  * defined by MaxCanAcceptanceFilters. You can change this value according to the number specified in your CAN driver
  * datasheet.
  */
-class CanAcceptanceFilterConfigurator
+class CanAcceptanceFilterConfigurator : private IListenerRegistrationObserver
 {
 public:
     /**
@@ -71,10 +82,40 @@ private:
 
     typedef uavcan::Multiset<CanFilterConfig> MultisetConfigContainer;
 
-    static CanFilterConfig mergeFilters(CanFilterConfig& a_, CanFilterConfig& b_);
+    static CanFilterConfig mergeFilters(const CanFilterConfig& a_, const CanFilterConfig& b_);
     static uint8_t countBits(uint32_t n_);
     uint16_t getNumFilters() const;
 
+    /**
+     * Whether the current configurations, plus the extra one if not null, fit the hardware filters of all
+     * interfaces; see @ref ICanIface::getNumFiltersRequired().
+     */
+    bool fitsHardwareFilters(const CanFilterConfig* extra) const;
+
+    static CanFilterConfig makeMessageFilter(DataTypeID dtid);
+
+    /**
+     * Number of distinct CAN IDs (including the flag bits) that pass the filter.
+     */
+    static uint64_t getNumAcceptedIDs(const CanFilterConfig& cfg);
+
+    /**
+     * Number of CAN IDs that will be accepted by the merged filter but not by either of the source filters,
+     * assuming that the source filters do not overlap. Negative if they do overlap.
+     */
+    static int64_t getMergeCost(const CanFilterConfig& a, const CanFilterConfig& b);
+
+    static bool isCoveredBy(const CanFilterConfig& cfg, const CanFilterConfig& by);
+
+    bool hasOtherMessageListeners(const TransferListener& listener) const;
+
+    int addMessageFilter(const CanFilterConfig& cfg);
+    int removeMessageFilter(const CanFilterConfig& cfg);
+    int reconfigure();
+
+    virtual void handleListenerRegistered(const TransferListener& listener);
+    virtual void handleListenerUnregistered(const TransferListener& listener);
+
     /**
      * Fills the multiset_configs_ to proceed it with mergeConfigurations()
      */
@@ -88,7 +129,10 @@ private:
 
     INode& node_;               //< Node reference is needed for access to ICanDriver and Dispatcher
     MultisetConfigContainer multiset_configs_;
+    uint64_t num_wanted_ids_;   //< Number of CAN IDs accepted by the configurations before merging
     uint16_t filters_number_;
+    AnonymousMessages mode_;    //< Used for automatic reconfiguration
+    NodeID node_id_;            //< The node ID the service filter was computed for
 
 public:
     /**
@@ -101,9 +145,13 @@ public:
     explicit CanAcceptanceFilterConfigurator(INode& node, uint16_t filters_number = 0)
         : node_(node)
         , multiset_configs_(node.getAllocator())
+        , num_wanted_ids_(0)
         , filters_number_(filters_number)
+        , mode_(AcceptAnonymousMessages)
     { }
 
+    virtual ~CanAcceptanceFilterConfigurator() { disableAutoReconfiguration(); }
+
     /**
      * This method invokes loadInputConfiguration() and mergeConfigurations() consequently
      * in order to comute optimal filter configurations for the current hardware.
@@ -131,6 +179,33 @@ public:
      */
     int applyConfiguration();
 
+    /**
+     * Computes and applies the configuration, then keeps it updated as the message subscriptions are added or
+     * removed; see the class documentation for details. The object must not be destroyed while this mode is
+     * active, unless it is disabled first (the destructor does that automatically).
+     * Only one object per node can operate in this mode.
+     * Note that the configurations added via addFilterConfig() will be lost if a full recomputation is required.
+     *
+     * @param mode  Refer to computeConfiguration() for explanation.
+     * @return 0 = success, negative for error; the mode will not be enabled in case of error.
+     */
+    int enableAutoReconfiguration(AnonymousMessages mode = AcceptAnonymousMessages);
+
+    /**
+     * Stops tracking the subscriptions. The currently applied filters will be left as is.
+     */
+    void disableAutoReconfiguration();
+
+    bool isAutoReconfigurationEnabled() const;
+
+    /**
+     * Returns the estimated fraction of irrelevant frames accepted by the current configuration, assuming
+     * that the bus traffic is evenly distributed over the CAN ID space: 0 means that the filters accept only
+     * the frames the node is interested in, values close to 1 mean that the filters are barely effective.
+     * Overlapping filters are not taken into account, so this is an approximation.
+     */
+    float getEstimatedLeakRate() const;
+
     /**
      * Returns the configuration computed with mergeConfigurations() or added by addFilterConfig().
      * If mergeConfigurations() or addFilterConfig() have not been called yet, an empty configuration will be returned.
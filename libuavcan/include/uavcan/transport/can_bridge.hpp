@@ -0,0 +1,256 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_TRANSPORT_CAN_BRIDGE_HPP_INCLUDED
+#define UAVCAN_TRANSPORT_CAN_BRIDGE_HPP_INCLUDED
+
+#include <uavcan/std.hpp>
+#include <uavcan/build_config.hpp>
+#include <uavcan/error.hpp>
+#include <uavcan/time.hpp>
+#include <uavcan/driver/can.hpp>
+#include <uavcan/driver/system_clock.hpp>
+#include <uavcan/transport/transfer.hpp>
+#include <uavcan/util/templates.hpp>
+
+namespace uavcan
+{
+/**
+ * Forwarding rule of @ref CanBridge.
+ * A frame matches the route if its transfer type, data type ID and priority are all within the route's ranges.
+ * Default constructed route matches everything in both directions.
+ */
+struct UAVCAN_EXPORT CanBridgeRoute
+{
+    enum Direction
+    {
+        DirectionAToB = 1,
+        DirectionBToA = 2,
+        DirectionBoth = 3
+    };
+
+    uint8_t directions;             ///< Bit mask of Direction
+    uint8_t transfer_types;         ///< Bit mask of (1 << TransferType)
+    uint16_t data_type_id_min;
+    uint16_t data_type_id_max;
+    uint8_t priority_min;           ///< Numeric values; lower value means higher priority
+    uint8_t priority_max;
+
+    CanBridgeRoute()
+        : directions(DirectionBoth)
+        , transfer_types((1U << NumTransferTypes) - 1U)
+        , data_type_id_min(0)
+        , data_type_id_max(0xFFFFU)
+        , priority_min(TransferPriority::NumericallyMin)
+        , priority_max(TransferPriority::NumericallyMax)
+    { }
+
+    bool isValid() const
+    {
+        return (directions != 0) && ((directions & ~unsigned(DirectionBoth)) == 0) &&
+               (transfer_types != 0) && ((transfer_types >> NumTransferTypes) == 0) &&
+               (data_type_id_min <= data_type_id_max) &&
+               (priority_min <= priority_max) && (priority_max <= TransferPriority::NumericallyMax);
+    }
+};
+
+/**
+ * Forwards raw CAN frames between two ifaces of a driver, e.g. to connect two physical buses of a vehicle.
+ * The frames are not parsed beyond the CAN ID, and they bypass the dispatcher completely; the bridge is not a node.
+ *
+ * The routes are compiled into per-direction interval tables, so the lookup cost is logarithmic in the number
+ * of routes. Frames that don't match any route are dropped.
+ *
+ * Forwarded frames wait in a priority queue per destination, so they leave the bridge in CAN arbitration order;
+ * frames with equal CAN ID, i.e. the frames of one transfer, keep their order. A frame is dropped if it can't be
+ * sent within the forwarding timeout.
+ *
+ * Loops are prevented as follows: loopback frames are never forwarded, and a frame received on a bus is not
+ * forwarded if the bridge itself has sent an identical frame to that bus within the loop guard window.
+ * The latter stops the traffic from circulating when several bridges connect the same pair of buses;
+ * since the transfer ID is part of the frame, legitimate traffic repeats identical frames much less often than that.
+ * The window must be longer than the forwarding timeout of the other bridges.
+ */
+class UAVCAN_EXPORT CanBridge : Noncopyable
+{
+public:
+    enum Side
+    {
+        SideA,
+        SideB,
+        NumSides
+    };
+
+    static const unsigned MaxRoutes = CanBridgeMaxRoutes;
+    static const unsigned QueueCapacity = CanBridgeQueueCapacity;
+    static const unsigned LoopGuardSize = CanBridgeLoopGuardSize;
+
+    static MonotonicDuration getDefaultForwardingTimeout() { return MonotonicDuration::fromMSec(10); }
+    static MonotonicDuration getDefaultLoopGuardWindow() { return MonotonicDuration::fromMSec(20); }
+
+private:
+    struct QueueEntry
+    {
+        CanFrame frame;
+        MonotonicTime deadline;
+        uint32_t seq;
+    };
+
+    /**
+     * Binary heap; the sequence number keeps the frames with equal CAN ID in FIFO order.
+     */
+    class TxQueue
+    {
+        QueueEntry heap_[QueueCapacity];
+        unsigned size_;
+        uint32_t next_seq_;
+
+        static bool isHigher(const QueueEntry& a, const QueueEntry& b);
+
+    public:
+        TxQueue()
+            : size_(0)
+            , next_seq_(0)
+        { }
+
+        bool push(const CanFrame& frame, MonotonicTime deadline);
+        void pop();
+
+        const QueueEntry& top() const
+        {
+            UAVCAN_ASSERT(size_ > 0);
+            return heap_[0];
+        }
+
+        bool isEmpty() const { return size_ == 0; }
+        unsigned getSize() const { return size_; }
+    };
+
+    /**
+     * Direct-mapped cache of frame signatures.
+     */
+    class LoopGuard
+    {
+        struct Entry
+        {
+            MonotonicTime ts;
+            uint32_t signature;
+        };
+
+        Entry entries_[LoopGuardSize];
+
+    public:
+        static uint32_t computeSignature(const CanFrame& frame);
+
+        void add(uint32_t signature, MonotonicTime ts);
+        bool contains(uint32_t signature, MonotonicTime ts, MonotonicDuration window) const;
+    };
+
+    struct RouteInterval
+    {
+        uint16_t first_data_type_id;
+        uint32_t priority_mask;
+    };
+
+    /**
+     * Covers the whole data type ID range; every interval extends up to the next one.
+     */
+    struct RouteTable
+    {
+        RouteInterval intervals[MaxRoutes * 2 + 1];
+        uint8_t num_intervals;
+
+        bool match(uint16_t data_type_id, uint8_t priority) const;
+    };
+
+    ICanDriver& driver_;
+    ISystemClock& sysclock_;
+    uint8_t iface_indices_[NumSides];
+
+    CanBridgeRoute routes_[MaxRoutes];
+    uint8_t num_routes_;
+    RouteTable tables_[NumSides][NumTransferTypes];     ///< Indexed by source side
+    TxQueue queues_[NumSides];                          ///< Indexed by destination side
+    LoopGuard loop_guards_[NumSides];                   ///< Frames sent to each side
+
+    MonotonicDuration forwarding_timeout_;
+    MonotonicDuration loop_guard_window_;
+
+    uint64_t num_forwarded_[NumSides];                  ///< Indexed by destination side
+    uint64_t num_filtered_;
+    uint64_t num_loops_prevented_;
+    uint64_t num_queue_overflows_;
+    uint64_t num_tx_timeouts_;
+    uint64_t num_tx_errors_;
+
+    void compileRoutes();
+    void compileRouteTable(Side source, TransferType transfer_type);
+
+    void handleRxFrame(Side source, const CanFrame& frame, MonotonicTime ts_mono, CanIOFlags flags);
+    void receive(Side source);
+    void transmit(Side destination, MonotonicTime ts_mono);
+
+    int handleIO(MonotonicTime blocking_deadline);
+
+public:
+    /**
+     * The bridge owns the two ifaces; nothing else should read from them.
+     */
+    CanBridge(ICanDriver& driver, ISystemClock& sysclock, uint8_t iface_index_a = 0, uint8_t iface_index_b = 1);
+
+    /**
+     * Adds a forwarding route and recompiles the lookup tables.
+     * @return Negative error code: invalid route, or there are @ref MaxRoutes routes already.
+     */
+    int addRoute(const CanBridgeRoute& route);
+
+    void removeAllRoutes();
+
+    unsigned getNumRoutes() const { return num_routes_; }
+    const CanBridgeRoute& getRoute(unsigned index) const;
+
+    /**
+     * Whether a frame received from the specified side would be forwarded to the other side.
+     */
+    bool isRouted(Side source, const CanFrame& frame) const;
+
+    /**
+     * Maximum time a frame can wait in the bridge; counted from its reception timestamp.
+     */
+    MonotonicDuration getForwardingTimeout() const { return forwarding_timeout_; }
+    void setForwardingTimeout(MonotonicDuration x) { forwarding_timeout_ = x; }
+
+    /**
+     * See the class documentation. Zero disables the loop guard.
+     */
+    MonotonicDuration getLoopGuardWindow() const { return loop_guard_window_; }
+    void setLoopGuardWindow(MonotonicDuration x) { loop_guard_window_ = x; }
+
+    /**
+     * Forwards the frames until the deadline.
+     * @return Negative on driver error.
+     */
+    int spin(MonotonicTime deadline);
+
+    /**
+     * Processes only the frames that are ready now, never blocks.
+     * @return Negative on driver error.
+     */
+    int spinOnce();
+
+    uint8_t getIfaceIndex(Side side) const { return iface_indices_[side]; }
+
+    unsigned getQueueSize(Side destination) const { return queues_[destination].getSize(); }
+
+    uint64_t getNumForwardedFrames(Side destination) const { return num_forwarded_[destination]; }
+    uint64_t getNumFilteredFrames() const { return num_filtered_; }
+    uint64_t getNumLoopsPrevented() const { return num_loops_prevented_; }
+    uint64_t getNumQueueOverflows() const { return num_queue_overflows_; }
+    uint64_t getNumTxTimeouts() const { return num_tx_timeouts_; }
+    uint64_t getNumTxErrors() const { return num_tx_errors_; }
+};
+
+}
+
+#endif // UAVCAN_TRANSPORT_CAN_BRIDGE_HPP_INCLUDED
@@ -17,45 +17,170 @@
 #include <uavcan/driver/can.hpp>
 #include <uavcan/driver/system_clock.hpp>
 #include <uavcan/time.hpp>
+#include <uavcan/transport/perf_counter.hpp>
+#include <uavcan/transport/token_bucket.hpp>
+#include <uavcan/transport/transfer.hpp>
 
 namespace uavcan
 {
-
-struct UAVCAN_EXPORT CanRxFrame : public CanFrame
+/**
+ * Wraps the system clock to let a sequence of operations share one reading of the monotonic time.
+ * While a @ref Scope is open, the monotonic time is read from the underlying clock on the first request
+ * after the scope was opened or @ref invalidate() was called, and the cached value is returned afterwards.
+ * The owner is expected to invalidate the value after every call that can block, e.g. the driver's select().
+ * Outside of scopes, every request goes to the underlying clock. The UTC time is never cached.
+ */
+class UAVCAN_EXPORT CachedSystemClock : public ISystemClock, Noncopyable
 {
-    MonotonicTime ts_mono;
-    UtcTime ts_utc;
-    uint8_t iface_index;
+    ISystemClock& clock_;
+    mutable MonotonicTime cached_;
+    mutable bool valid_;
+    uint8_t scope_depth_;
+
+public:
+    class Scope : Noncopyable
+    {
+        CachedSystemClock& owner_;
+
+    public:
+        explicit Scope(CachedSystemClock& owner)
+            : owner_(owner)
+        {
+            if (owner_.scope_depth_ == 0)
+            {
+                owner_.valid_ = false;
+            }
+            owner_.scope_depth_++;
+        }
+
+        ~Scope()
+        {
+            UAVCAN_ASSERT(owner_.scope_depth_ > 0);
+            owner_.scope_depth_--;
+        }
+    };
 
-    CanRxFrame()
-        : iface_index(0)
+    explicit CachedSystemClock(ISystemClock& clock)
+        : clock_(clock)
+        , valid_(false)
+        , scope_depth_(0)
     { }
 
-#if UAVCAN_TOSTRING
-    std::string toString(StringRepresentation mode = StrTight) const;
-#endif
-};
+    virtual MonotonicTime getMonotonic() const
+    {
+        if (scope_depth_ == 0)
+        {
+            return clock_.getMonotonic();
+        }
+        if (!valid_)
+        {
+            cached_ = clock_.getMonotonic();
+            valid_ = true;
+        }
+        return cached_;
+    }
+
+    virtual UtcTime getUtc() const { return clock_.getUtc(); }
+    virtual void adjustUtc(UtcDuration adjustment) { clock_.adjustUtc(adjustment); }
+
+    /**
+     * The next request will read the underlying clock again.
+     */
+    void invalidate() { valid_ = false; }
 
+    bool isCaching() const { return scope_depth_ > 0; }
 
+    ISystemClock& getUnderlyingClock() const { return clock_; }
+};
+
+/**
+ * Prioritized TX queue.
+ *
+ * Two implementations are available, selectable per queue:
+ *  - ModeLinkedList (default) - sorted linked list; push is O(N), pop is O(1).
+ *    Entries can be iterated in priority order via Entry::getNextListNode(). The list is doubly linked if the
+ *    back link fits the memory pool block, see Entry; then the removal of an arbitrary entry is O(1) as well.
+ *  - ModeTreap - two randomized search trees (one per QoS level); push, pop and QoS-based replacement
+ *    are O(log N) on average, at the cost of two extra pointers per entry. This mode is preferable when
+ *    the queue is expected to hold many frames (e.g. during firmware updates).
+ * In both modes frames are ordered by CAN arbitration priority, and frames of equal priority are kept in FIFO order.
+ *
+ * A single-frame transfer pushed with @ref CanIOFlagReplacePending replaces the queued single-frame transfer that
+ * was pushed with the same flag and has the same CAN ID disregarding the priority bits, i.e. the same data type,
+ * transfer type, and source and destination nodes (last value wins). This keeps the queue from being filled with
+ * stale data of periodic publishers while the bus is congested. The lookup is linear.
+ *
+ * Each entry carries a mask of interfaces it is still pending on, which allows one queue to be shared by
+ * several interfaces: an entry is stored once, handed out to every interface in its mask, and destroyed
+ * when the last interface has released it. See @ref CanIOManager.
+ *
+ * If UAVCAN_TX_QUEUE_AGING is enabled, the frames that have been waiting for too long can be promoted ahead of
+ * the rest of the queue, see @ref setAgingPercent().
+ */
 class UAVCAN_EXPORT CanTxQueue : Noncopyable
 {
 public:
     enum Qos { Volatile, Persistent };
 
-    struct Entry : public LinkedListNode<Entry>  // Not required to be packed - fits the block in any case
+    enum Mode { ModeLinkedList, ModeTreap };
+
+    enum { AllIfacesMask = 0xFF };
+
+    /**
+     * Contents of @ref Entry; the list node type is a parameter, so that the size of the entry can be evaluated
+     * for either kind of the list.
+     */
+    template <typename ListNode>
+    struct EntryFields : public ListNode    // Not required to be packed - fits the block in any case
     {
         MonotonicTime deadline;
         CanFrame frame;
+#if UAVCAN_TX_QUEUE_AGING
+        uint8_t qos : 1;
+        uint8_t promoted : 1;           ///< Moved ahead of the other entries, see setAgingPercent()
+#else
         uint8_t qos;
+#endif
+        uint8_t iface_mask;             ///< Interfaces the frame is still pending on; occupies padding
         CanIOFlags flags;
+        uint32_t seq;                   ///< Insertion order, used to keep FIFO order among equal priority frames
+#if UAVCAN_LATENCY_STATS || UAVCAN_TX_QUEUE_AGING
+        MonotonicTime enqueued_at;
+#endif
 
-        Entry(const CanFrame& arg_frame, MonotonicTime arg_deadline, Qos arg_qos, CanIOFlags arg_flags)
+        EntryFields(const CanFrame& arg_frame, MonotonicTime arg_deadline, Qos arg_qos, CanIOFlags arg_flags,
+                    uint8_t arg_iface_mask)
             : deadline(arg_deadline)
             , frame(arg_frame)
-            , qos(uint8_t(arg_qos))
+            , qos((arg_qos == Persistent) ? 1U : 0U)
+#if UAVCAN_TX_QUEUE_AGING
+            , promoted(0U)
+#endif
+            , iface_mask(arg_iface_mask)
             , flags(arg_flags)
+            , seq(0)
+        { }
+    };
+
+    struct Entry;
+
+    /**
+     * The entries are doubly linked only if the tree entries, which add two more pointers, still fit the pool block.
+     */
+    enum
+    {
+        DoublyLinkedEntries = (sizeof(EntryFields<LinkedListNode<Entry> >) + 3U * sizeof(void*)) <= MemPoolBlockSize
+    };
+
+    typedef Select<DoublyLinkedEntries, DoublyLinkedListNode<Entry>, LinkedListNode<Entry> >::Result EntryListNode;
+
+    struct Entry : public EntryFields<EntryListNode>
+    {
+        Entry(const CanFrame& arg_frame, MonotonicTime arg_deadline, Qos arg_qos, CanIOFlags arg_flags,
+              uint8_t arg_iface_mask = AllIfacesMask)
+            : EntryFields<EntryListNode>(arg_frame, arg_deadline, arg_qos, arg_flags, arg_iface_mask)
         {
-            UAVCAN_ASSERT((qos == Volatile) || (qos == Persistent));
+            UAVCAN_ASSERT((this->qos == Volatile) || (this->qos == Persistent));
             IsDynamicallyAllocatable<Entry>::check();
         }
 
@@ -73,6 +198,24 @@ public:
 #endif
     };
 
+#if UAVCAN_TX_QUEUE_AGING
+    /**
+     * See @ref setAgingPercent().
+     */
+    struct AgingStats
+    {
+        uint32_t num_promoted;                  ///< Frames promoted because they have been waiting for too long
+        uint32_t num_expired_after_promotion;   ///< Promoted frames that have expired anyway
+        uint16_t max_num_promoted;              ///< Peak number of promoted frames in the queue at the same time
+
+        AgingStats()
+            : num_promoted(0)
+            , num_expired_after_promotion(0)
+            , max_num_promoted(0)
+        { }
+    };
+#endif
+
 private:
     class PriorityInsertionComparator
     {
@@ -82,38 +225,246 @@ private:
         bool operator()(const Entry* entry)
         {
             UAVCAN_ASSERT(entry);
+#if UAVCAN_TX_QUEUE_AGING
+            if (entry->promoted)
+            {
+                return false;           // The promoted entries stay ahead of the new ones
+            }
+#endif
             return frm_.priorityHigherThan(entry->frame);
         }
     };
 
+    struct TreeEntry : public Entry
+    {
+        TreeEntry* left;
+        TreeEntry* right;
+
+        TreeEntry(const CanFrame& arg_frame, MonotonicTime arg_deadline, Qos arg_qos, CanIOFlags arg_flags,
+                  uint8_t arg_iface_mask)
+            : Entry(arg_frame, arg_deadline, arg_qos, arg_flags, arg_iface_mask)
+            , left(NULL)
+            , right(NULL)
+        {
+            IsDynamicallyAllocatable<TreeEntry>::check();
+        }
+
+        /// Heap priority of the treap node; pseudo-random, derived from the insertion order
+        uint32_t getTreapPriority() const;
+
+        /// Defines the strict order of the tree: by frame priority, then by insertion order;
+        /// the promoted entries go first, in the order of promotion
+        bool isBefore(const TreeEntry& rhs) const;
+    };
+
     LinkedListRoot<Entry> queue_;
+    TreeEntry* tree_roots_[2];          ///< Indexed by QoS
     LimitedPoolAllocator allocator_;
     ISystemClock& sysclock_;
+    MonotonicTime earliest_deadline_;   ///< Lower bound of deadlines of all queued entries
     uint32_t rejected_frames_cnt_;
+    uint32_t replaced_frames_cnt_;
+    uint32_t next_seq_;
+    uint16_t num_pending_[MaxCanIfaces];    ///< Number of entries pending on each iface
+    uint8_t mode_;
+    uint8_t reserve_priority_;              ///< Lowest transfer priority allowed to use the reserved quota
+#if UAVCAN_EVENT_TRACE
+    EventTrace* event_trace_;
+#endif
+#if UAVCAN_TX_QUEUE_AGING
+    MonotonicTime earliest_promotion_;      ///< Lower bound of promotion times of the entries that are not promoted
+    uint16_t num_promoted_;
+    uint8_t aging_percent_;
+    AgingStats aging_stats_;
+#endif
+
+    void registerRejectedFrame(const CanFrame& frame, TraceDropReason reason, MonotonicTime ts);
+    void registerExpiredEntry(const Entry& entry, MonotonicTime ts);
+    void registerPending(const Entry& entry, int increment);
+    void registerNewEntry(Entry& entry, MonotonicTime timestamp);
+    void destroyEntry(Entry*& entry);
+
+    static void treeRotateLeft(TreeEntry*& root);
+    static void treeRotateRight(TreeEntry*& root);
+    static void treeInsert(TreeEntry*& root, TreeEntry* node);
+    static TreeEntry* treeMerge(TreeEntry* a, TreeEntry* b);
+    static bool treeRemove(TreeEntry*& root, TreeEntry* node);
+    static TreeEntry* treeFirst(TreeEntry* root, uint8_t iface_mask);
+    static TreeEntry* treeLast(TreeEntry* root);
+    void treePurgeExpired(TreeEntry*& root, MonotonicTime timestamp, MonotonicTime& out_earliest_deadline);
+    void treeDestroy(TreeEntry*& root);
+    TreeEntry* treeTop(uint8_t iface_mask) const;
+    const Entry* top(uint8_t iface_mask) const;
+    const Entry* topPriority(uint8_t iface_mask) const;
+
+#if UAVCAN_TX_QUEUE_AGING
+    MonotonicTime getPromotionTime(const Entry& entry) const;
+    void registerPromotion(Entry& entry);
+    static bool treeTopPriority(const TreeEntry* root, uint8_t iface_mask, const Entry*& inout_best);
+    void treeCollectAged(TreeEntry* root, MonotonicTime timestamp, TreeEntry** out_aged, unsigned& inout_num_aged,
+                         unsigned capacity, MonotonicTime& out_earliest_promotion);
+    void promoteAged(MonotonicTime timestamp);
+#endif
+
+    Entry* findLowestQos();
 
-    void registerRejectedFrame();
+    static bool isReplaceable(const CanFrame& frame);
+    static bool isReplaceableBy(const Entry& entry, const CanFrame& frame);
+    static TreeEntry* treeFindReplaceable(TreeEntry* root, const CanFrame& frame);
+    Entry* findReplaceable(const CanFrame& frame);
 
 public:
-    CanTxQueue(IPoolAllocator& allocator, ISystemClock& sysclock, std::size_t allocator_quota)
-        : allocator_(allocator, allocator_quota)
+    CanTxQueue(IPoolAllocator& allocator, ISystemClock& sysclock, std::size_t allocator_quota,
+               Mode mode = ModeLinkedList)
+        : allocator_(allocator, allocator_quota, PoolUsageTagTxQueue)
         , sysclock_(sysclock)
         , rejected_frames_cnt_(0)
-    { }
+        , replaced_frames_cnt_(0)
+        , next_seq_(0)
+        , mode_(uint8_t(mode))
+        , reserve_priority_(TransferPriority::NumericallyMin)
+#if UAVCAN_EVENT_TRACE
+        , event_trace_(NULL)
+#endif
+#if UAVCAN_TX_QUEUE_AGING
+        , earliest_promotion_(MonotonicTime::getMax())
+        , num_promoted_(0)
+        , aging_percent_(0)
+#endif
+    {
+        tree_roots_[Volatile] = NULL;
+        tree_roots_[Persistent] = NULL;
+        fill(num_pending_, num_pending_ + MaxCanIfaces, uint16_t(0));
+    }
 
     ~CanTxQueue();
 
-    void push(const CanFrame& frame, MonotonicTime tx_deadline, Qos qos, CanIOFlags flags);
+    /**
+     * The mode can be changed only while the queue is empty.
+     * Returns negative error code if the queue is not empty.
+     */
+    int setMode(Mode mode);
+    Mode getMode() const { return Mode(mode_); }
+
+#if UAVCAN_EVENT_TRACE
+    /**
+     * The trace receives @ref TraceEventTxQueueDrop and @ref TraceEventOutOfMemory. Null pointer disables tracing.
+     */
+    void setEventTrace(EventTrace* trace) { event_trace_ = trace; }
+#endif
+
+#if UAVCAN_TX_QUEUE_AGING
+    /**
+     * Enables the priority aging: once a frame has spent the specified percentage of its TX timeout (the time
+     * between the push and the TX deadline) in the queue, it is promoted ahead of all entries that have not been
+     * promoted, in the order of promotion. The CAN ID is not changed, so the promotion has no effect on the bus
+     * arbitration; it only bounds the time a low priority frame can be held back in this queue by the newer
+     * higher priority frames, to the specified fraction of its timeout.
+     * The frames are promoted by @ref peek() and @ref purgeExpired(). Zero disables the aging, which is the
+     * default; the frames that are promoted already stay ahead. Returns negative error code if the value
+     * exceeds 100.
+     */
+    int setAgingPercent(uint8_t percent);
+    uint8_t getAgingPercent() const { return aging_percent_; }
+
+    uint16_t getNumPromotedFrames() const { return num_promoted_; }
+    const AgingStats& getAgingStats() const { return aging_stats_; }
+#endif
+
+    /**
+     * Makes the queue take its memory quota from the shared one, see @ref SharedPoolQuota.
+     * Frames of the specified transfer priority or higher may use the reserved part of the shared quota.
+     * Null pointer restores the fixed quota.
+     */
+    void setSharedQuota(SharedPoolQuota* quota, uint16_t guaranteed_blocks, TransferPriority reserve_priority)
+    {
+        reserve_priority_ = reserve_priority.get();
+        allocator_.setSharedQuota(quota, guaranteed_blocks);
+    }
+
+    /**
+     * The frame will be pending on every interface in iface_mask; the mask is ignored unless the queue
+     * is shared between interfaces.
+     */
+    void push(const CanFrame& frame, MonotonicTime tx_deadline, Qos qos, CanIOFlags flags,
+              uint8_t iface_mask = AllIfacesMask);
+
+    /**
+     * Same as @ref push() for several frames with the same CAN ID, e.g. the frames of one transfer, which will be
+     * transmitted in the given order. In the linked list mode, the insertion point is searched only once.
+     */
+    void pushBatch(const CanFrame* frames, unsigned num_frames, MonotonicTime tx_deadline, Qos qos, CanIOFlags flags,
+                   uint8_t iface_mask = AllIfacesMask);
+
+    /**
+     * Removes all expired entries.
+     * The queue keeps track of the earliest deadline among queued entries, so this call costs nothing
+     * unless some of the entries are actually expired, in which case all entries are checked once.
+     */
+    void purgeExpired(MonotonicTime timestamp);
 
     Entry* peek();               // Modifier
     void remove(Entry*& entry);
+
+    /**
+     * The highest priority pending frame. With the priority aging, this is not necessarily the frame returned by
+     * @ref peek(), since the promoted frames are transmitted first.
+     */
     const CanFrame* getTopPriorityPendingFrame() const;
 
+    /**
+     * Shared queue access: same as above, but only entries that are pending on the specified iface are considered.
+     * The ordering is the same; the treap mode may however need to skip over entries that have already been
+     * released by this iface, which makes the lookup O(N) in the worst case.
+     */
+    Entry* peek(uint8_t iface_index);
+    const CanFrame* getTopPriorityPendingFrame(uint8_t iface_index) const;
+
+    /**
+     * Marks the entry as no longer pending on the specified iface.
+     * The entry is removed once it is not pending on any iface; the pointer is nulled out in this case.
+     */
+    void release(Entry*& entry, uint8_t iface_index);
+
+    /**
+     * Returns the mask of ifaces that have at least one entry pending. Complexity is O(1).
+     */
+    uint8_t getPendingIfaceMask() const;
+
     /// The 'or equal' condition is necessary to avoid frame reordering.
     bool topPriorityHigherOrEqual(const CanFrame& rhs_frame) const;
 
     uint32_t getRejectedFrameCount() const { return rejected_frames_cnt_; }
 
-    bool isEmpty() const { return queue_.isEmpty(); }
+    /**
+     * Number of entries pending on the specified iface. Unless the queue is shared, every entry is pending on
+     * every iface, so this is the total number of entries.
+     */
+    uint16_t getNumPendingFrames(uint8_t iface_index) const
+    {
+        return (iface_index < MaxCanIfaces) ? num_pending_[iface_index] : uint16_t(0);
+    }
+
+    /**
+     * Remaining memory quota of the queue; one entry occupies one block.
+     */
+    uint16_t getNumFreeBlocks() const { return allocator_.getNumFreeBlocks(); }
+
+    /**
+     * Number of queued frames that were superseded by newer frames, see @ref CanIOFlagReplacePending.
+     */
+    uint32_t getReplacedFrameCount() const { return replaced_frames_cnt_; }
+
+    /**
+     * Lower bound of deadlines of all queued entries; the queued entries can't expire earlier than that.
+     * Returns the maximum time value if the queue is empty.
+     */
+    MonotonicTime getEarliestDeadline() const { return isEmpty() ? MonotonicTime::getMax() : earliest_deadline_; }
+
+    bool isEmpty() const
+    {
+        return queue_.isEmpty() && (tree_roots_[Volatile] == NULL) && (tree_roots_[Persistent] == NULL);
+    }
 };
 
 
@@ -122,40 +473,152 @@ struct UAVCAN_EXPORT CanIfacePerfCounters
     uint64_t frames_tx;
     uint64_t frames_rx;
     uint64_t errors;
+    uint64_t frames_deferred;   ///< Frames queued because of the TX rate limit, see CanIOManager::setIfaceTxRateLimit()
 
     CanIfacePerfCounters()
         : frames_tx(0)
         , frames_rx(0)
         , errors(0)
+        , frames_deferred(0)
     { }
 };
 
 
+/**
+ * Backpressure information for producers that need to pace themselves, see @ref CanIOManager::getIfaceTxQueueStatus().
+ */
+struct UAVCAN_EXPORT CanIfaceTxQueueStatus
+{
+    uint16_t num_pending_frames;            ///< Frames waiting in the TX queues for this iface
+    uint16_t num_free_blocks;               ///< Free TX queue quota; beyond that, frames will be rejected
+    MonotonicDuration estimated_drain_time; ///< Time to transmit the pending frames; infinite if the rate is unknown
+
+    CanIfaceTxQueueStatus()
+        : num_pending_frames(0)
+        , num_free_blocks(0)
+    { }
+};
+
+
+/**
+ * Frames that could not be transmitted immediately are queued:
+ *  - into the interface's own TX queue, if the frame is still pending on one interface only;
+ *  - into the shared TX queue otherwise, where it occupies one memory block regardless of the number of interfaces.
+ * Each interface transmits the highest priority frame among its own queue and the shared entries pending on it.
+ * If UAVCAN_SHARED_TX_QUEUE is disabled, there is no shared queue, and such frames are copied into the own queue
+ * of every interface they are pending on.
+ *
+ * Optionally, the TX rate of each interface can be limited with a token bucket, see @ref setIfaceTxRateLimit().
+ * Frames that exceed the budget are not dropped but deferred: they wait in the TX queues until the bucket is
+ * refilled, and the blocking calls wake up when that happens.
+ *
+ * By default, every transfer is sent over all interfaces of its mask, which provides redundancy. Non-redundant
+ * multi-bus setups can spread the load instead, see @ref setTxIfacePolicy(); also, interfaces that appear dead can
+ * be excluded from transmission, see @ref setDeadIfaceTimeout(). Interfaces are selected per transfer by
+ * @ref TransferSender via @ref selectTxIfaces(), so the frames of one transfer are never split between them.
+ */
 class UAVCAN_EXPORT CanIOManager : Noncopyable
 {
+public:
+    enum TxIfacePolicy
+    {
+        TxIfacePolicyRedundant,         ///< Every transfer is sent over all interfaces of its mask
+        TxIfacePolicyLeastLoaded        ///< Every transfer is sent over one interface with the shortest TX queue
+    };
+
+private:
     struct IfaceFrameCounters
     {
         uint64_t frames_tx;
         uint64_t frames_rx;
+        uint64_t frames_deferred;
+        uint64_t frames_discarded;      ///< Dropped from the TX queues because the iface was found dead
 
         IfaceFrameCounters()
             : frames_tx(0)
             , frames_rx(0)
+            , frames_deferred(0)
+            , frames_discarded(0)
         { }
     };
 
     ICanDriver& driver_;
-    ISystemClock& sysclock_;
+    CachedSystemClock sysclock_;            ///< Shared with the queues; must outlive them
 
+    SharedPoolQuota tx_quota_;              ///< Must outlive the queues
     LazyConstructor<CanTxQueue> tx_queues_[MaxCanIfaces];
+#if UAVCAN_SHARED_TX_QUEUE
+    LazyConstructor<CanTxQueue> shared_tx_queue_;
+#endif
+    /**
+     * Average interval between transmissions from the TX queue while it stays non-empty, i.e. the drain rate.
+     */
+    struct IfaceDrainRateEstimator
+    {
+        MonotonicTime last_tx_ts;           ///< Zero unless the queue was non-empty after the last transmission
+        uint32_t avg_interval_usec;         ///< Zero if unknown
+
+        IfaceDrainRateEstimator()
+            : avg_interval_usec(0)
+        { }
+    };
+
+    /**
+     * The interface shows a sign of life when it transmits or receives a frame.
+     */
+    struct IfaceHealth
+    {
+        MonotonicTime last_alive_ts;
+        MonotonicTime last_probe_ts;        ///< When a transfer was last sent to the dead iface
+        uint64_t errors_when_alive;         ///< Error count of the driver at the last sign of life
+        bool dead;
+
+        IfaceHealth()
+            : errors_when_alive(0)
+            , dead(false)
+        { }
+    };
+
     IfaceFrameCounters counters_[MaxCanIfaces];
+    TokenBucket tx_shapers_[MaxCanIfaces];
+    IfaceDrainRateEstimator drain_rates_[MaxCanIfaces];
+    IfaceHealth health_[MaxCanIfaces];
+    MonotonicDuration dead_iface_timeout_;
 
+    uint16_t mem_blocks_per_queue_;         ///< Fixed quota
     const uint8_t num_ifaces_;
+    uint8_t tx_iface_policy_;
+    bool rx_priority_order_enabled_;
+#if UAVCAN_LATENCY_STATS || UAVCAN_EXECUTION_TIME_STATS || UAVCAN_EVENT_TRACE || UAVCAN_DUTY_CYCLE_STATS
+    TransferPerfCounter* perf_;
+#endif
+
+    enum { NumSharedTxQueues = UAVCAN_SHARED_TX_QUEUE ? 1 : 0 };
+
+    unsigned getNumTxQueues() const { return num_ifaces_ + unsigned(NumSharedTxQueues); }
+    uint16_t getNumPendingFrames(uint8_t iface_index) const;   ///< In all TX queues
+    const CanFrame* getTopPriorityPendingFrame(uint8_t iface_index) const;
+    bool topPriorityHigherOrEqual(uint8_t iface_index, const CanFrame& rhs_frame) const;
+    void enqueue(const CanFrame& frame, MonotonicTime tx_deadline, uint8_t iface_mask, CanTxQueue::Qos qos,
+                 CanIOFlags flags);
+    void enqueueBatch(const CanFrame* frames, unsigned num_frames, MonotonicTime tx_deadline, uint8_t iface_mask,
+                      CanTxQueue::Qos qos, CanIOFlags flags);
 
     int sendToIface(uint8_t iface_index, const CanFrame& frame, MonotonicTime tx_deadline, CanIOFlags flags);
     int sendFromTxQueue(uint8_t iface_index);
+    int sendBatchFromTxQueue(uint8_t iface_index);
+    void sampleDrainRate(uint8_t iface_index);
     int callSelect(CanSelectMasks& inout_masks, const CanFrame* (& pending_tx)[MaxCanIfaces],
                    MonotonicTime blocking_deadline);
+    uint8_t makeShapedIfaceMask(const CanFrame* (& pending_tx)[MaxCanIfaces], MonotonicTime& inout_deadline);
+    void markIfaceAlive(uint8_t iface_index, MonotonicTime ts);
+    bool looksDead(uint8_t iface_index, MonotonicTime ts) const;
+    void discardPendingFrames(uint8_t iface_index);
+    void updateIfaceHealth(MonotonicTime ts);
+    uint8_t selectTxIfacesImpl(uint8_t iface_mask);
+    int receiveFromIface(uint8_t iface_index, CanRxFrame* out_frames, CanIOFlags* out_flags, unsigned max_frames);
+    int receiveInPriorityOrder(uint8_t& inout_read_mask, CanRxFrame* out_frames, CanIOFlags* out_flags,
+                               unsigned max_frames);
 
 public:
     CanIOManager(ICanDriver& driver, IPoolAllocator& allocator, ISystemClock& sysclock,
@@ -163,13 +626,129 @@ public:
 
     uint8_t getNumIfaces() const { return num_ifaces_; }
 
+#if UAVCAN_LATENCY_STATS || UAVCAN_EXECUTION_TIME_STATS || UAVCAN_EVENT_TRACE || UAVCAN_DUTY_CYCLE_STATS
+    /**
+     * The counter receives the samples of @ref LatencyStageTxTransportToDriver and @ref ExecutionStageTxSend,
+     * the TX events of the trace, and the RX and TX time of the duty cycle. Null pointer disables sampling.
+     */
+    void setTransferPerfCounter(TransferPerfCounter* perf);
+#endif
+
     CanIfacePerfCounters getIfacePerfCounters(uint8_t iface_index) const;
 
+    /**
+     * Limits the average TX rate of the interface to the specified number of bytes of CAN frame data per second,
+     * allowing bursts of up to burst_bytes. Zero rate removes the limit, which is the default.
+     * The burst must fit at least one frame of the maximum length. Returns negative error code on failure.
+     */
+    int setIfaceTxRateLimit(uint8_t iface_index, uint32_t bytes_per_sec, uint32_t burst_bytes);
+
+    /**
+     * Occupancy of the TX queues of the interface; both the per-iface and the shared queue (if enabled) are taken
+     * into account, and the quota is the smaller of the two. The drain time is estimated from the recent rate of
+     * transmissions from the queues. Cheap enough to be called before every publication.
+     */
+    CanIfaceTxQueueStatus getIfaceTxQueueStatus(uint8_t iface_index) const;
+
+    /**
+     * See @ref TxIfacePolicy. In the least loaded mode, ties are resolved in favor of the interface that has
+     * transmitted fewer frames, so that the load is spread even if the queues are normally empty.
+     */
+    TxIfacePolicy getTxIfacePolicy() const { return TxIfacePolicy(tx_iface_policy_); }
+    void setTxIfacePolicy(TxIfacePolicy policy) { tx_iface_policy_ = uint8_t(policy); }
+
+    /**
+     * An interface is considered dead if it has not transmitted or received anything for longer than this timeout,
+     * while either its driver error count has grown (e.g. bus-off, no ACK) or it had frames to transmit
+     * (TX timeouts). Once an interface is found dead, the frames pending on it are discarded to free the pool,
+     * and new transfers are not queued on it, unless all interfaces of the transfer are dead.
+     * The dead interface is probed with one transfer per timeout; it comes back to life once it transmits or
+     * receives a frame. The check is performed in @ref cleanup() and when the interfaces are selected.
+     * Zero disables the health monitoring, which is the default.
+     */
+    MonotonicDuration getDeadIfaceTimeout() const { return dead_iface_timeout_; }
+    void setDeadIfaceTimeout(MonotonicDuration timeout);
+
+    /**
+     * Always false if the health monitoring is disabled, see @ref setDeadIfaceTimeout().
+     */
+    bool isIfaceDead(uint8_t iface_index) const;
+
+    /**
+     * Applies the TX interface policy and the health monitoring to the interface mask of a transfer.
+     * Returns the mask the transfer should be sent with; never zero unless the input mask is.
+     */
+    uint8_t selectTxIfaces(uint8_t iface_mask)
+    {
+        if ((tx_iface_policy_ == TxIfacePolicyRedundant) && dead_iface_timeout_.isZero())
+        {
+            return iface_mask;
+        }
+        return selectTxIfacesImpl(iface_mask);
+    }
+
+    /**
+     * By default, the readable interfaces are drained one after another in the order of their indexes, so under
+     * backlog the low priority frames of one interface are processed before the high priority frames of the next.
+     * In the priority order mode, the head frames of the readable interfaces are looked up with
+     * @ref ICanIface::peekRxFrameId() and the frames are taken one at a time in the order of CAN arbitration.
+     * The interfaces whose drivers don't support the lookup are drained afterwards as usual.
+     * This costs an extra driver call per frame. Disabled by default.
+     */
+    void setRxPriorityOrderEnabled(bool enabled) { rx_priority_order_enabled_ = enabled; }
+    bool isRxPriorityOrderEnabled() const { return rx_priority_order_enabled_; }
+
     const ICanDriver& getCanDriver() const { return driver_; }
     ICanDriver& getCanDriver()             { return driver_; }
 
     uint8_t makePendingTxMask() const;
 
+    /**
+     * Selects the TX queue implementation for all interfaces; see @ref CanTxQueue.
+     * This can be done only while all TX queues are empty, e.g. before the node is started.
+     * Returns negative error code on failure.
+     */
+    int setTxQueueMode(CanTxQueue::Mode mode);
+
+#if UAVCAN_TX_QUEUE_AGING
+    /**
+     * Configures the priority aging of all TX queues, see @ref CanTxQueue::setAgingPercent().
+     * A promoted frame also takes precedence over the frames of the other queue of its interface, i.e. the
+     * shared or the own one, if the shared queue is enabled. Returns negative error code on failure.
+     */
+    int setTxQueueAgingPercent(uint8_t percent);
+
+    /**
+     * Aging statistics of all TX queues combined; the peak number of promoted frames is the largest one
+     * among the queues.
+     */
+    CanTxQueue::AgingStats getTxQueueAgingStats() const;
+#endif
+
+    /**
+     * By default, every TX queue (one per interface plus the shared one, if enabled) has a fixed quota of memory
+     * blocks, see the constructor. The adaptive quota turns the sum of these quotas into a common budget: every
+     * queue is guaranteed min_blocks_per_queue blocks, and may borrow the blocks of the budget that are not used by
+     * the other queues. The last reserved_blocks of the budget can be borrowed only for the frames of reserve_priority
+     * or higher, so that a bulk transfer on one interface (e.g. a firmware update) leaves room for urgent traffic
+     * on the others. The guaranteed blocks and the reserve must fit the budget.
+     * Returns negative error code on failure.
+     */
+    int setAdaptiveTxQuota(uint16_t min_blocks_per_queue, uint16_t reserved_blocks, TransferPriority reserve_priority);
+    void disableAdaptiveTxQuota();
+    bool isAdaptiveTxQuotaEnabled() const { return tx_quota_.getMaxBlocks() > 0; }
+
+    /**
+     * Removes expired frames from the TX queues, so that they don't hold memory blocks until the next
+     * transmission attempt. It is cheap to call this often; see @ref CanTxQueue::purgeExpired().
+     */
+    void cleanup(MonotonicTime ts);
+
+    /**
+     * Earliest time when any of the queued frames may expire, see @ref CanTxQueue::getEarliestDeadline().
+     */
+    MonotonicTime getEarliestTxDeadline() const;
+
     /**
      * Returns:
      *  0 - rejected/timedout/enqueued
@@ -178,7 +757,25 @@ public:
      */
     int send(const CanFrame& frame, MonotonicTime tx_deadline, MonotonicTime blocking_deadline,
              uint8_t iface_mask, CanTxQueue::Qos qos, CanIOFlags flags);
+
+    /**
+     * Same as @ref send() for several frames with the same CAN ID that must be transmitted in the given order,
+     * e.g. the frames of one multi-frame transfer; equivalent to calling send() for each frame in turn, but cheaper.
+     * One select() call is made per round rather than per frame: each round transmits on every writable iface
+     * as many frames as the driver accepts (see @ref ICanIface::getNumFreeTxSlots()), and the rounds continue while
+     * they make progress or until the blocking deadline. The frames that are left are enqueued all at once.
+     * Returns the same as send().
+     */
+    int sendBatch(const CanFrame* frames, unsigned num_frames, MonotonicTime tx_deadline,
+                  MonotonicTime blocking_deadline, uint8_t iface_mask, CanTxQueue::Qos qos, CanIOFlags flags);
     int receive(CanRxFrame& out_frame, MonotonicTime blocking_deadline, CanIOFlags& out_flags);
+
+    /**
+     * Same as @ref receive(), but reads up to max_frames frames per one select() call.
+     * Returns the number of frames received, or negative error code.
+     */
+    int receiveBatch(CanRxFrame* out_frames, CanIOFlags* out_flags, unsigned max_frames,
+                     MonotonicTime blocking_deadline);
 };
 
 }
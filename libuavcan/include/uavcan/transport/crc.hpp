@@ -27,19 +27,56 @@ namespace uavcan
  */
 class UAVCAN_EXPORT TransferCRC
 {
+public:
+    /**
+     * External implementation of CRC-16-CCITT, e.g. a hardware CRC unit or a SIMD kernel.
+     * It must return the CRC value @p crc updated with @p len bytes; @p len may be zero.
+     */
+    typedef uint16_t (*BlockProcessor)(uint16_t crc, const uint8_t* bytes, unsigned len);
+
+private:
 #if !UAVCAN_TINY
     static const uint16_t Table[256];
+# if UAVCAN_CRC_SLICE_BY_4
+    static const uint16_t SliceTables[3][256];
+# endif
 #endif
 
+    static BlockProcessor block_processor_;
+
     uint16_t value_;
 
 public:
     enum { NumBytes = 2 };
 
-    TransferCRC()
+    UAVCAN_CONSTEXPR TransferCRC()
         : value_(0xFFFFU)
     { }
 
+    /**
+     * Continues the computation from a known intermediate value, e.g. one obtained at compile time.
+     */
+    UAVCAN_CONSTEXPR explicit TransferCRC(uint16_t value)
+        : value_(value)
+    { }
+
+    /**
+     * Bitwise implementation that can be evaluated at compile time, see @ref DataTypeSignature::toTransferCRC().
+     * Adds the @p num_bytes least significant bytes of @p x to @p crc, least significant byte first.
+     */
+    static UAVCAN_CONSTEXPR uint16_t addBitwise(uint16_t crc, uint64_t x, unsigned num_bytes)
+    {
+        return (num_bytes == 0) ? crc :
+               addBitwise(shiftBitwise(uint16_t(crc ^ uint16_t((x & 0xFFU) << 8)), 8), x >> 8, num_bytes - 1U);
+    }
+
+    static UAVCAN_CONSTEXPR uint16_t shiftBitwise(uint16_t crc, unsigned num_bits)
+    {
+        return (num_bits == 0) ? crc :
+               shiftBitwise((crc & 0x8000U) ? uint16_t(uint16_t(crc << 1) ^ 0x1021U) : uint16_t(crc << 1),
+                            num_bits - 1U);
+    }
+
 #if UAVCAN_TINY
     void add(uint8_t byte)
     {
@@ -63,16 +100,22 @@ public:
     }
 #endif
 
-    void add(const uint8_t* bytes, unsigned len)
-    {
-        UAVCAN_ASSERT(bytes);
-        while (len--)
-        {
-            add(*bytes++);
-        }
-    }
+    /**
+     * Uses the block processor if one is installed, otherwise the software implementation.
+     */
+    void add(const uint8_t* bytes, unsigned len);
+
+    UAVCAN_CONSTEXPR uint16_t get() const { return value_; }
 
-    uint16_t get() const { return value_; }
+    /**
+     * Installs an external implementation that will be used by add(const uint8_t*, unsigned) instead of the
+     * software one. This is intended for platform drivers, e.g. to route the computation through the hardware
+     * CRC unit. The processor is shared by all instances, so it should be installed once during initialization,
+     * before the node is started. If the processor is not reentrant (like most hardware CRC units), it must not
+     * be used concurrently from multiple threads. Null pointer restores the software implementation.
+     */
+    static void setBlockProcessor(BlockProcessor processor) { block_processor_ = processor; }
+    static BlockProcessor getBlockProcessor() { return block_processor_; }
 };
 
 }
@@ -10,6 +10,7 @@
 #include <uavcan/std.hpp>
 #include <uavcan/build_config.hpp>
 #include <uavcan/transport/perf_counter.hpp>
+#include <uavcan/transport/redundant_frame_filter.hpp>
 #include <uavcan/transport/transfer_listener.hpp>
 #include <uavcan/transport/outgoing_transfer_registry.hpp>
 #include <uavcan/transport/can_io.hpp>
@@ -21,28 +22,69 @@ namespace uavcan
 class UAVCAN_EXPORT Dispatcher;
 
 #if !UAVCAN_TINY
+class UAVCAN_EXPORT LocalTransferBus;
+class UAVCAN_EXPORT WildcardTransferListener;
+
 /**
  * Inherit this class to receive notifications about all TX CAN frames that were transmitted with the loopback flag.
+ *
+ * The listener can be limited to one data type, in which case the other loopback frames are not delivered to it;
+ * if no listener is interested in a loopback frame, the dispatcher doesn't parse it at all. Listeners that only
+ * need the timestamps can take the CAN frame as is, in @ref handleLoopbackCanFrame(), which saves parsing and
+ * copying of the payload altogether.
  */
 class UAVCAN_EXPORT LoopbackFrameListenerBase : public LinkedListNode<LoopbackFrameListenerBase>, Noncopyable
 {
     Dispatcher& dispatcher_;
+    DataTypeID filter_data_type_id_;
+    TransferType filter_transfer_type_;
+    bool filtered_;
+    bool raw_;
 
 protected:
     explicit LoopbackFrameListenerBase(Dispatcher& dispatcher)
         : dispatcher_(dispatcher)
+        , filter_transfer_type_(TransferTypeMessageBroadcast)
+        , filtered_(false)
+        , raw_(false)
     { }
 
     virtual ~LoopbackFrameListenerBase() { stopListening(); }
 
+    /**
+     * All loopback frames will be delivered to @ref handleLoopbackFrame().
+     */
     void startListening();
+
+    /**
+     * Only the loopback frames of the specified data type and transfer type will be delivered to
+     * @ref handleLoopbackFrame().
+     */
+    void startListening(DataTypeID data_type_id, TransferType transfer_type);
+
+    /**
+     * Same as above, but the frames will be delivered unparsed to @ref handleLoopbackCanFrame().
+     */
+    void startListeningRaw(DataTypeID data_type_id, TransferType transfer_type);
+
     void stopListening();
     bool isListening() const;
 
     Dispatcher& getDispatcher() { return dispatcher_; }
 
 public:
-    virtual void handleLoopbackFrame(const RxFrame& frame) = 0;
+    bool acceptsFrame(TransferType transfer_type, DataTypeID data_type_id) const
+    {
+        return !filtered_ || ((filter_data_type_id_ == data_type_id) && (filter_transfer_type_ == transfer_type));
+    }
+
+    bool isRaw() const { return raw_; }
+
+    /**
+     * One of these is invoked, depending on how the listener was started.
+     */
+    virtual void handleLoopbackFrame(const RxFrame&) { UAVCAN_ASSERT(0); }
+    virtual void handleLoopbackCanFrame(const CanRxFrame&) { UAVCAN_ASSERT(0); }
 };
 
 
@@ -56,7 +98,10 @@ public:
     bool doesExist(const LoopbackFrameListenerBase* listener) const;
     unsigned getNumListeners() const { return listeners_.getLength(); }
 
-    void invokeListeners(RxFrame& frame);
+    /**
+     * The frame is parsed at most once, and only if there is a parsing listener that accepts it.
+     */
+    void invokeListeners(const CanRxFrame& can_frame);
 };
 
 /**
@@ -74,11 +119,49 @@ public:
 };
 #endif
 
+/**
+ * Implement this interface to receive notifications when transfer listeners are registered in the dispatcher or
+ * unregistered from it. The notifications are delivered after the registry has been updated.
+ */
+class UAVCAN_EXPORT IListenerRegistrationObserver
+{
+public:
+    virtual ~IListenerRegistrationObserver() { }
+
+    virtual void handleListenerRegistered(const TransferListener& listener) = 0;
+    virtual void handleListenerUnregistered(const TransferListener& listener) = 0;
+};
+
+/**
+ * Lookup table of the transfer listeners by data type, with the set of data types fixed at compile time;
+ * see @ref StaticListenerTable. Installed into the dispatcher with @ref Dispatcher::installStaticListenerTable().
+ */
+class UAVCAN_EXPORT IStaticListenerTable
+{
+public:
+    virtual ~IStaticListenerTable() { }
+
+    /**
+     * Returns the slot for the listeners of the specified transfer type and data type ID, or NULL if the
+     * table doesn't have one. The dispatcher keeps the first listener of the data type in the slot.
+     */
+    virtual TransferListener** findSlot(TransferType transfer_type, DataTypeID dtid) = 0;
+
+    /**
+     * Sets all slots to NULL.
+     */
+    virtual void clear() = 0;
+};
+
 /**
  * This class performs low-level CAN frame routing.
  */
-class UAVCAN_EXPORT Dispatcher : Noncopyable
+class UAVCAN_EXPORT Dispatcher : Noncopyable, private IRxMemoryReclaimer
 {
+#if !UAVCAN_TINY
+    friend class LocalTransferBus;
+#endif
+
     CanIOManager canio_;
     ISystemClock& sysclock_;
     OutgoingTransferRegistry outgoing_transfer_reg_;
@@ -86,7 +169,16 @@ class UAVCAN_EXPORT Dispatcher : Noncopyable
 
     class ListenerRegistry
     {
+        /**
+         * Each index slot points to the first listener in the list whose data type ID falls into this slot,
+         * or NULL if there are no such listeners. Since the list is sorted, the listeners that share the same
+         * data type ID are adjacent, so the lookup is constant time unless two registered data type IDs collide.
+         * The index is rebuilt on every change of the list, which is rare compared to frame reception.
+         */
+        enum { IndexSize = (DispatcherListenerIndexSize > 0) ? DispatcherListenerIndexSize : 1 };
+
         LinkedListRoot<TransferListener> list_;
+        TransferListener* index_[IndexSize];
 
         class DataTypeIDInsertionComparator
         {
@@ -100,17 +192,43 @@ class UAVCAN_EXPORT Dispatcher : Noncopyable
             }
         };
 
+        static unsigned getIndexSlot(DataTypeID dtid) { return dtid.get() & (unsigned(IndexSize) - 1U); }
+
+        void rebuildIndex();
+
     public:
         enum Mode { UniqueListener, ManyListeners };
 
+        ListenerRegistry() { rebuildIndex(); }
+
         bool add(TransferListener* listener, Mode mode);
         void remove(TransferListener* listener);
         bool exists(DataTypeID dtid) const;
         void cleanup(MonotonicTime ts);
-        void handleFrame(const RxFrame& frame);
+
+        /**
+         * Returns the listener that holds a receiver active earlier than inout_ts, or NULL; see
+         * @ref TransferListener::findLeastRecentlyActiveReceiver().
+         */
+        TransferListener* findLeastRecentlyActiveReceiver(const TransferListener& requester,
+                                                          const TransferBufferManagerKey& protected_key,
+                                                          TransferBufferManagerKey& inout_key,
+                                                          MonotonicTime& inout_ts) const;
+
+        /**
+         * Returns the first listener for the specified data type ID, or NULL if there are no such listeners.
+         */
+        TransferListener* findFirst(DataTypeID dtid) const;
+
+        /**
+         * Delivers the frame to the listener returned by findFirst() and its siblings of the same data type ID.
+         */
+        static void handleFrame(const RxFrame& frame, TransferListener* first);
 
         unsigned getNumEntries() const { return list_.getLength(); }
 
+        TransferListener* getFirst() const { return list_.get(); }
+
         const LinkedListRoot<TransferListener>& getList() const { return list_; }
     };
 
@@ -121,10 +239,36 @@ class UAVCAN_EXPORT Dispatcher : Noncopyable
 #if !UAVCAN_TINY
     LoopbackFrameListenerRegistry loopback_listeners_;
     IRxFrameListener* rx_listener_;
+    RedundantFrameFilter* redundant_frame_filter_;
+    LocalTransferBus* local_bus_;
+    LinkedListRoot<WildcardTransferListener> wildcard_listeners_;
 #endif
 
+    enum { NumListenerRegistries = 3 };
+
+    /**
+     * Position of the incremental cleanup: the next listener to clean up, in the registry of the specified index.
+     * The index equals NumListenerRegistries if there is no pass in progress.
+     */
+    TransferListener* cleanup_next_listener_;
+    uint8_t cleanup_registry_index_;
+
+    IListenerRegistrationObserver* registration_observer_;
+    IStaticListenerTable* static_listener_table_;
+    ReassemblyTable* reassembly_table_;
+    unsigned num_unlisted_listeners_;       ///< Registered listeners that have no slot in the static table
+
+    uint32_t num_wakeups_;
+    uint32_t num_evicted_receivers_;
+    unsigned max_frames_per_spin_;
+
     NodeID self_node_id_;
     bool self_node_id_is_set_;
+    bool spin_break_requested_;
+    bool receiver_eviction_enabled_;
+
+    ListenerRegistry* selectListenerRegistry(TransferType transfer_type);
+    ListenerRegistry* selectListenerRegistryByIndex(unsigned index);
 
     void handleFrame(const CanRxFrame& can_frame);
 
@@ -132,6 +276,41 @@ class UAVCAN_EXPORT Dispatcher : Noncopyable
 
     void notifyRxFrameListener(const CanRxFrame& can_frame, CanIOFlags flags);
 
+#if !UAVCAN_TINY
+    /**
+     * Passes a transfer delivered by the local transfer bus to the message listeners of the data type.
+     */
+    void handleLocalTransfer(IncomingTransfer& transfer, DataTypeID dtid);
+
+    bool hasMatchingWildcardListener(TransferType transfer_type, DataTypeID dtid, bool addressed_to_this_node) const;
+    void handleWildcardFrame(const RxFrame& frame, bool addressed_to_this_node);
+    void cleanupWildcardListeners(MonotonicTime ts);
+#endif
+
+    bool registerListener(ListenerRegistry& registry, TransferListener* listener, TransferType transfer_type,
+                          ListenerRegistry::Mode mode);
+    void unregisterListener(ListenerRegistry& registry, TransferListener* listener, TransferType transfer_type);
+
+    /**
+     * Updates the static listener table after a listener of the data type has been added (delta = 1) or
+     * removed (delta = -1).
+     */
+    void updateStaticListenerSlot(const ListenerRegistry& registry, TransferType transfer_type, DataTypeID dtid,
+                                  int delta);
+    TransferListener* findFirstListener(TransferType transfer_type, DataTypeID dtid);
+
+    virtual bool reclaimRxMemory(const TransferListener& requester, const TransferBufferManagerKey& protected_key);
+
+    /**
+     * Returns the number of processed frames, not counting loopback frames.
+     */
+    int handleReceivedFrames(const CanRxFrame* frames, const CanIOFlags* flags, int num_frames);
+
+    /**
+     * Returns zero if the frame budget of the spin call is exhausted.
+     */
+    unsigned computeRxBatchSize(unsigned num_frames_received) const;
+
 public:
     Dispatcher(ICanDriver& driver, IPoolAllocator& allocator, ISystemClock& sysclock)
         : canio_(driver, allocator, sysclock)
@@ -139,29 +318,110 @@ public:
         , outgoing_transfer_reg_(allocator)
 #if !UAVCAN_TINY
         , rx_listener_(NULL)
+        , redundant_frame_filter_(NULL)
+        , local_bus_(NULL)
 #endif
+        , cleanup_next_listener_(NULL)
+        , cleanup_registry_index_(NumListenerRegistries)
+        , registration_observer_(NULL)
+        , static_listener_table_(NULL)
+        , reassembly_table_(NULL)
+        , num_unlisted_listeners_(0)
+        , num_wakeups_(0)
+        , num_evicted_receivers_(0)
+        , max_frames_per_spin_(0)
         , self_node_id_(NodeID::Broadcast)  // Default
         , self_node_id_is_set_(false)
-    { }
+        , spin_break_requested_(false)
+        , receiver_eviction_enabled_(true)
+    {
+#if UAVCAN_LATENCY_STATS
+        perf_.setSystemClock(&sysclock_);
+#endif
+#if UAVCAN_EVENT_TRACE
+        perf_.getEventTrace().setSystemClock(&sysclock_);
+#endif
+#if UAVCAN_DUTY_CYCLE_STATS
+        perf_.getDutyCycleCounter().setSystemClock(&sysclock_);
+#endif
+#if UAVCAN_LATENCY_STATS || UAVCAN_EXECUTION_TIME_STATS || UAVCAN_EVENT_TRACE || UAVCAN_DUTY_CYCLE_STATS
+        canio_.setTransferPerfCounter(&perf_);
+#endif
+    }
 
+#if !UAVCAN_TINY
     /**
-     * This version returns strictly when the deadline is reached.
+     * Disconnects from the local transfer bus, if connected.
+     */
+    ~Dispatcher();
+#endif
+
+    /**
+     * This version returns strictly when the deadline is reached, or once the frame budget is exhausted,
+     * see @ref setMaxFramesPerSpin().
      */
     int spin(MonotonicTime deadline);
 
     /**
-     * This version does not return until all available frames are processed.
+     * This version does not return until all available frames are processed, or up to the frame budget.
      */
     int spinOnce();
 
+    /**
+     * This version blocks until at least one frame is received or the deadline is reached, processes the
+     * received frames and returns. Unlike @ref spin(), it never waits for more frames once some were received.
+     */
+    int spinUntilIo(MonotonicTime deadline);
+
+    /**
+     * Makes the ongoing @ref spin() call return as soon as the current batch of frames is processed, without
+     * waiting for the deadline. The scheduler uses this to run the deferred callbacks with low latency.
+     */
+    void breakSpin() { spin_break_requested_ = true; }
+
+    /**
+     * Number of times a blocking spin call returned from the driver, either because of IO or because of
+     * the deadline. Divided by the elapsed time, this gives the wakeup rate of the node.
+     */
+    uint32_t getNumWakeups() const { return num_wakeups_; }
+
+    /**
+     * Limits the number of frames, including loopback frames, read by one call of @ref spin(), @ref spinOnce(),
+     * or @ref spinUntilIo(), so that a flood of incoming frames can't delay the deadline handlers of the scheduler
+     * by more than the time needed to process this many frames. The remaining frames stay in the driver until
+     * the next call. Zero means no limit, which is the default.
+     */
+    void setMaxFramesPerSpin(unsigned max_frames) { max_frames_per_spin_ = max_frames; }
+    unsigned getMaxFramesPerSpin() const { return max_frames_per_spin_; }
+
     /**
      * Refer to CanIOManager::send() for the parameter description
      */
     int send(const Frame& frame, MonotonicTime tx_deadline, MonotonicTime blocking_deadline, CanTxQueue::Qos qos,
              CanIOFlags flags, uint8_t iface_mask);
 
+    /**
+     * Same as @ref send() for several compiled frames of one transfer, see CanIOManager::sendBatch().
+     * The frames must have been made by this node; the transfer type and the data type ID are used for statistics.
+     */
+    int sendBatch(const CanFrame* can_frames, unsigned num_frames, TransferType transfer_type, DataTypeID dtid,
+                  MonotonicTime tx_deadline, MonotonicTime blocking_deadline, CanTxQueue::Qos qos,
+                  CanIOFlags flags, uint8_t iface_mask);
+
+    /**
+     * Removes the timed out state of all listeners, the outgoing transfer registry, and the CAN IO manager at once.
+     */
     void cleanup(MonotonicTime ts);
 
+    /**
+     * Same as @ref cleanup(), but the listeners are processed at most max_listeners at a time, continuing where
+     * the previous call has left off, so that the cost of a pass over many listeners can be spread over time.
+     * The CAN IO manager and the outgoing transfer registry are cleaned up at the beginning of every pass.
+     * The listeners registered during a pass may be skipped until the next one.
+     * @return True if the pass has been completed with this call; the next call starts a new one.
+     */
+    bool cleanupIncrementally(MonotonicTime ts, unsigned max_listeners);
+
     bool registerMessageListener(TransferListener* listener);
     bool registerServiceRequestListener(TransferListener* listener);
     bool registerServiceResponseListener(TransferListener* listener);
@@ -170,6 +430,20 @@ public:
     void unregisterServiceRequestListener(TransferListener* listener);
     void unregisterServiceResponseListener(TransferListener* listener);
 
+    /**
+     * When the memory pool is exhausted and a listener can't allocate a receiver or a buffer for a new transfer,
+     * the receiver that was active least recently among all listeners is evicted together with its buffer, and
+     * the allocation is retried. This lets the new flows displace the stale ones (e.g. of the nodes that went
+     * offline) before cleanup() removes them by the timeout. Enabled by default.
+     */
+    void setReceiverEvictionEnabled(bool enabled) { receiver_eviction_enabled_ = enabled; }
+    bool isReceiverEvictionEnabled() const { return receiver_eviction_enabled_; }
+
+    /**
+     * Number of receivers evicted because of memory pressure, see @ref setReceiverEvictionEnabled().
+     */
+    uint32_t getNumEvictedReceivers() const { return num_evicted_receivers_; }
+
     bool hasSubscriber(DataTypeID dtid) const;
     bool hasPublisher(DataTypeID dtid) const;
     bool hasServer(DataTypeID dtid) const;
@@ -182,7 +456,8 @@ public:
      * These methods can be used to retreive lists of messages, service requests and service responses the
      * dispatcher is currently listening to.
      * Note that the list of service response listeners is very volatile, because a response listener will be
-     * removed from this list as soon as the corresponding service call is complete.
+     * removed from this list as soon as the corresponding service call is complete, unless the service client
+     * is configured to keep it (see ServiceClient<>::setPersistentResponseListener()).
      * @{
      */
     const LinkedListRoot<TransferListener>& getListOfMessageListeners() const
@@ -213,8 +488,86 @@ public:
         UAVCAN_ASSERT(listener != NULL);
         rx_listener_ = listener;
     }
+
+    /**
+     * With the redundant frame filter installed, the redundant copies of the received frames are dropped right after
+     * the listener lookup, before they are parsed and passed to the transfer receivers; see @ref RedundantFrameFilter
+     * for the implications. The filter is owned by the application and is reset when installed; it has no effect with
+     * only one iface. Only one filter can be installed at a time; it must be removed before it is destroyed.
+     */
+    void installRedundantFrameFilter(RedundantFrameFilter* filter)
+    {
+        redundant_frame_filter_ = filter;
+        if (filter != NULL)
+        {
+            filter->reset();
+        }
+    }
+    void removeRedundantFrameFilter() { installRedundantFrameFilter(NULL); }
+    RedundantFrameFilter* getRedundantFrameFilter() const { return redundant_frame_filter_; }
+
+    /**
+     * The dispatcher is connected to the bus with @ref LocalTransferBus::addDispatcher(); NULL if not connected.
+     */
+    LocalTransferBus* getLocalTransferBus() const { return local_bus_; }
+
+    /**
+     * Passes an outgoing broadcast message of this node to the local transfer bus, if the dispatcher is connected
+     * to one; the bus decides whether the data type is delivered locally. Normally this is done by the
+     * transfer sender.
+     */
+    void deliverLocalTransfer(DataTypeID dtid, TransferPriority priority, TransferID tid,
+                              const uint8_t* payload, unsigned payload_len);
+
+    /**
+     * Normally these are used by @ref WildcardTransferListener itself, see WildcardTransferListener::startListening().
+     * The wildcard listeners receive the frames after the regular transfer listeners.
+     */
+    void registerWildcardListener(WildcardTransferListener* listener);
+    void unregisterWildcardListener(WildcardTransferListener* listener);
+    bool hasWildcardListener(const WildcardTransferListener* listener) const;
+    unsigned getNumWildcardListeners() const;
 #endif
 
+    /**
+     * With the static listener table installed, the listeners of the data types listed in the table are found
+     * via the table, and the frames of the other data types are dropped without looking them up in the registry
+     * unless some of the registered listeners are not listed. This makes routing cost independent of the number
+     * of listeners. The listeners are registered and unregistered as usual; the table can be installed at any time.
+     * Only one table can be installed at a time, and a table can't be shared between dispatchers.
+     */
+    void installStaticListenerTable(IStaticListenerTable* table);
+    void removeStaticListenerTable();
+    IStaticListenerTable* getStaticListenerTable() const { return static_listener_table_; }
+
+    /**
+     * With the reassembly table installed, the transfer receivers of all listeners, except those found by the node
+     * ID index of @ref TransferListenerWithNodeIndex, are stored in the table, and the reassembly buffers are
+     * allocated from its quota; see @ref ReassemblyTable. The expired receivers are removed by one sweep over the
+     * table at the beginning of every cleanup pass. The table can be installed and removed at any time, which
+     * releases the receivers of all registered listeners, so the transfers in progress are lost. Only one table can
+     * be installed at a time; it must be removed before the dispatcher or the table is destroyed.
+     */
+    void installReassemblyTable(ReassemblyTable* table);
+    void removeReassemblyTable() { installReassemblyTable(NULL); }
+    ReassemblyTable* getReassemblyTable() const { return reassembly_table_; }
+
+    /**
+     * Number of registered listeners whose data types are not listed in the static listener table.
+     */
+    unsigned getNumUnlistedListeners() const { return num_unlisted_listeners_; }
+
+    /**
+     * Only one observer can be installed at a time; installing a new one replaces the previous one.
+     */
+    IListenerRegistrationObserver* getListenerRegistrationObserver() const { return registration_observer_; }
+    void removeListenerRegistrationObserver() { registration_observer_ = NULL; }
+    void installListenerRegistrationObserver(IListenerRegistrationObserver* observer)
+    {
+        UAVCAN_ASSERT(observer != NULL);
+        registration_observer_ = observer;
+    }
+
     /**
      * Node ID can be set only once.
      * Non-unicast Node ID puts the node into passive mode.
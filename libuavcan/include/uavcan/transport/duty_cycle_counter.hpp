@@ -0,0 +1,184 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_TRANSPORT_DUTY_CYCLE_COUNTER_HPP_INCLUDED
+#define UAVCAN_TRANSPORT_DUTY_CYCLE_COUNTER_HPP_INCLUDED
+
+#include <uavcan/std.hpp>
+#include <uavcan/build_config.hpp>
+#include <uavcan/time.hpp>
+#include <uavcan/util/templates.hpp>
+#include <uavcan/driver/system_clock.hpp>
+
+namespace uavcan
+{
+/**
+ * Categories of the processing time accounted by @ref DutyCycleCounter, see UAVCAN_DUTY_CYCLE_STATS.
+ */
+enum DutyCycleCategory
+{
+    DutyCycleCategoryRx,                ///< Frames read from the driver and processed, up to the transfer listeners
+    DutyCycleCategoryTx,                ///< Frames pushed to the TX queue or driver, the blocking wait excluded
+    DutyCycleCategoryDeadlineHandlers,  ///< Expired deadline handlers looked up and called, and the periodic cleanup
+    DutyCycleCategoryCallbacks,         ///< Application callbacks of subscribers, servers, clients, timers, etc.
+    NumDutyCycleCategories,
+    DutyCycleCategoryNone = NumDutyCycleCategories  ///< Blocked in select() or outside of the library
+};
+
+#if !UAVCAN_TINY
+/**
+ * Measures how much time the library spends in every @ref DutyCycleCategory per measurement window, so that
+ * the load of the node can be monitored; e.g. 250 permille of RX means that a quarter of the time is spent
+ * processing the received frames.
+ *
+ * The accounting is exclusive: entering a category suspends the current one until the nested one is left,
+ * so that e.g. the time of a subscriber callback is charged to the callbacks rather than to RX, and the time of
+ * a frame sent from that callback is charged to TX. The time spent with no category entered, i.e. blocked
+ * in select() or outside of the library, is not charged. The clock is read once per transition.
+ *
+ * A window is closed upon the first transition after its duration has elapsed, so the windows may be somewhat
+ * longer than configured; the results of the last closed window stay available until the next one is closed.
+ *
+ * The counter is not thread safe; the library enters the categories from the thread that calls @ref Node::spin().
+ */
+class UAVCAN_EXPORT DutyCycleCounter : Noncopyable
+{
+    const ISystemClock* sysclock_;
+    MonotonicTime window_started_at_;
+    MonotonicTime checkpoint_;           ///< Of the last transition
+    MonotonicDuration window_;
+    uint32_t busy_usec_[NumDutyCycleCategories];            ///< Of the current window
+    uint32_t last_window_busy_usec_[NumDutyCycleCategories];
+    uint32_t last_window_usec_;
+    uint8_t current_;                   ///< @ref DutyCycleCategory
+
+    uint32_t toPermille(uint64_t busy_usec) const
+    {
+        return (last_window_usec_ == 0) ? 0U : uint32_t(min(busy_usec * 1000U / last_window_usec_, uint64_t(1000)));
+    }
+
+    void account(MonotonicTime ts)
+    {
+        if (checkpoint_.isZero())
+        {
+            window_started_at_ = ts;    // First transition after a reset; nothing to account yet
+        }
+        else if ((current_ < NumDutyCycleCategories) && (ts > checkpoint_))
+        {
+            const uint64_t busy_usec = uint64_t(busy_usec_[current_]) + uint64_t((ts - checkpoint_).toUSec());
+            busy_usec_[current_] = uint32_t(min(busy_usec, uint64_t(NumericTraits<uint32_t>::max())));
+        }
+        checkpoint_ = ts;
+
+        const MonotonicDuration elapsed = ts - window_started_at_;
+        if (elapsed >= window_)
+        {
+            copy(busy_usec_, busy_usec_ + NumDutyCycleCategories, last_window_busy_usec_);
+            fill(busy_usec_, busy_usec_ + NumDutyCycleCategories, uint32_t(0));
+            last_window_usec_ = uint32_t(min(elapsed.toUSec(), int64_t(NumericTraits<uint32_t>::max())));
+            window_started_at_ = ts;
+        }
+    }
+
+public:
+    static MonotonicDuration getDefaultWindow() { return MonotonicDuration::fromMSec(1000); }
+    static MonotonicDuration getMinWindow() { return MonotonicDuration::fromMSec(10); }
+    static MonotonicDuration getMaxWindow() { return MonotonicDuration::fromMSec(60000); }
+
+    DutyCycleCounter()
+        : sysclock_(NULL)
+        , window_(getDefaultWindow())
+        , current_(DutyCycleCategoryNone)
+    {
+        reset();
+    }
+
+    /**
+     * Nothing is measured until the clock is installed.
+     */
+    void setSystemClock(const ISystemClock* sysclock) { sysclock_ = sysclock; }
+
+    /**
+     * Switches to the specified category, which can be @ref DutyCycleCategoryNone.
+     * Returns the previous category, that has to be passed to @ref leave(); see @ref DutyCycleScope.
+     */
+    uint8_t enter(DutyCycleCategory category)
+    {
+        const uint8_t previous = current_;
+        if ((sysclock_ != NULL) && (uint8_t(category) != current_))
+        {
+            account(sysclock_->getMonotonic());
+        }
+        current_ = uint8_t(category);
+        return previous;
+    }
+
+    void leave(uint8_t previous)
+    {
+        if ((sysclock_ != NULL) && (previous != current_))
+        {
+            account(sysclock_->getMonotonic());
+        }
+        current_ = previous;
+    }
+
+    /**
+     * Duration of the measurement window; the value is bounded by @ref getMinWindow() and @ref getMaxWindow().
+     * Takes effect from the next window.
+     */
+    MonotonicDuration getWindow() const { return window_; }
+    void setWindow(MonotonicDuration window) { window_ = max(getMinWindow(), min(window, getMaxWindow())); }
+
+    /**
+     * Clears the results and starts a new window upon the next transition; the window duration is not affected.
+     */
+    void reset()
+    {
+        fill(busy_usec_, busy_usec_ + NumDutyCycleCategories, uint32_t(0));
+        fill(last_window_busy_usec_, last_window_busy_usec_ + NumDutyCycleCategories, uint32_t(0));
+        last_window_usec_ = 0;
+        checkpoint_ = MonotonicTime();
+        window_started_at_ = MonotonicTime();
+    }
+
+    /**
+     * Results of the last closed window; zero if no window has been closed since the last reset.
+     * @{
+     */
+    MonotonicDuration getLastWindowDuration() const { return MonotonicDuration::fromUSec(last_window_usec_); }
+
+    MonotonicDuration getBusyTime(DutyCycleCategory category) const
+    {
+        return MonotonicDuration::fromUSec((category < NumDutyCycleCategories) ?
+                                           last_window_busy_usec_[category] : 0U);
+    }
+
+    /**
+     * Fraction of the window in permille, from 0 to 1000.
+     */
+    unsigned getDutyCyclePermille(DutyCycleCategory category) const
+    {
+        return (category < NumDutyCycleCategories) ? unsigned(toPermille(last_window_busy_usec_[category])) : 0U;
+    }
+
+    unsigned getTotalDutyCyclePermille() const
+    {
+        uint64_t busy_usec = 0;
+        for (unsigned i = 0; i < NumDutyCycleCategories; i++)
+        {
+            busy_usec += last_window_busy_usec_[i];
+        }
+        return unsigned(toPermille(busy_usec));
+    }
+    /**
+     * @}
+     */
+
+    DutyCycleCategory getCurrentCategory() const { return DutyCycleCategory(current_); }
+};
+#endif
+
+}
+
+#endif // UAVCAN_TRANSPORT_DUTY_CYCLE_COUNTER_HPP_INCLUDED
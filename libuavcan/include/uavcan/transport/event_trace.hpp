@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_TRANSPORT_EVENT_TRACE_HPP_INCLUDED
+#define UAVCAN_TRANSPORT_EVENT_TRACE_HPP_INCLUDED
+
+#include <uavcan/std.hpp>
+#include <uavcan/build_config.hpp>
+#include <uavcan/time.hpp>
+#include <uavcan/util/templates.hpp>
+#include <uavcan/driver/system_clock.hpp>
+
+namespace uavcan
+{
+/**
+ * Events recorded by @ref EventTrace. The meaning of the arguments of @ref TraceRecord depends on the event:
+ *
+ *      Event                       arg32                   arg16                   arg8
+ *      TraceEventFrameRx           CAN ID with flags       DLC                     iface index
+ *      TraceEventFrameTx           CAN ID with flags       DLC                     iface index
+ *      TraceEventTransferComplete  transfer ID             data type ID            source node ID
+ *      TraceEventCrcError          transfer ID             data type ID            source node ID
+ *      TraceEventOutOfMemory       CAN ID, or zero         data type ID, or zero   @ref PoolUsageTag
+ *      TraceEventTxQueueDrop       CAN ID with flags       DLC                     @ref TraceDropReason
+ *      TraceEventTimerFire         lateness, usec          -                       -
+ *
+ * The values of the enumeration are a part of the binary format of the trace, so they must never change.
+ */
+enum TraceEvent
+{
+    TraceEventFrameRx,                  ///< Frame taken from the driver by the dispatcher, loopback excluded
+    TraceEventFrameTx,                  ///< Frame accepted by the driver
+    TraceEventTransferComplete,         ///< Transfer reassembled and passed to the listener
+    TraceEventCrcError,                 ///< Multi-frame transfer dropped because of CRC mismatch
+    TraceEventOutOfMemory,              ///< Allocation failed; the frame or transfer was lost
+    TraceEventTxQueueDrop,              ///< Frame removed from the TX queue without being sent
+    TraceEventTimerFire,                ///< Timer handler called; lateness is the time since the scheduled moment
+    NumTraceEvents
+};
+
+enum TraceDropReason
+{
+    TraceDropExpired,                   ///< TX deadline reached
+    TraceDropNoMemory                   ///< No space in the queue, a frame of lower QoS was discarded or rejected
+};
+
+/**
+ * One record of the trace. The timestamp is the lower 32 bits of the monotonic time in microseconds, so it wraps
+ * around every 71 minutes; intervals between the records of one dump are computed modulo 2^32.
+ */
+struct UAVCAN_EXPORT TraceRecord
+{
+    uint32_t timestamp_usec;
+    uint32_t arg32;
+    uint16_t arg16;
+    uint8_t event;                      ///< @ref TraceEvent
+    uint8_t arg8;
+
+    TraceRecord()
+        : timestamp_usec(0)
+        , arg32(0)
+        , arg16(0)
+        , event(0)
+        , arg8(0)
+    { }
+};
+
+/**
+ * Fixed-size ring of binary trace records, see UAVCAN_EVENT_TRACE. It's meant to stay enabled in production builds
+ * in order to diagnose rare problems, such as latency spikes, after the fact: the application (or a debugger)
+ * fetches the last records when something suspicious happens.
+ *
+ * The events can be enabled and disabled at run time via a bit mask, where the bit N corresponds to the event N;
+ * disabled events cost one test of the mask. All events are enabled by default. The frame events are by far the
+ * most frequent ones on a busy bus, so they may need to be disabled to make the ring cover a longer time span.
+ *
+ * The trace is not thread safe; the library records the events from the thread that calls @ref Node::spin().
+ */
+class UAVCAN_EXPORT EventTrace : Noncopyable
+{
+public:
+    enum { Capacity = EventTraceCapacity };
+
+    static const uint32_t AllEventsMask = (1U << NumTraceEvents) - 1U;
+
+private:
+    TraceRecord records_[Capacity];
+    const ISystemClock* sysclock_;
+    uint32_t num_recorded_;             ///< Total since the last reset, see getNumLostRecords()
+    uint32_t enabled_mask_;
+
+public:
+    EventTrace()
+        : sysclock_(NULL)
+        , num_recorded_(0)
+        , enabled_mask_(AllEventsMask)
+    { }
+
+    /**
+     * Used to timestamp the events whose timestamps are not provided by the caller.
+     */
+    void setSystemClock(const ISystemClock* sysclock) { sysclock_ = sysclock; }
+
+    bool isEnabled(TraceEvent event) const { return (enabled_mask_ & (1U << unsigned(event))) != 0; }
+
+    uint32_t getEnabledMask() const { return enabled_mask_; }
+    void setEnabledMask(uint32_t mask) { enabled_mask_ = mask & AllEventsMask; }
+
+    /**
+     * Zero timestamp means that the time of the event is not known; then the system clock is read.
+     */
+    void record(TraceEvent event, MonotonicTime ts, uint32_t arg32 = 0, uint16_t arg16 = 0, uint8_t arg8 = 0)
+    {
+        if (!isEnabled(event))
+        {
+            return;
+        }
+        if (ts.isZero() && (sysclock_ != NULL))
+        {
+            ts = sysclock_->getMonotonic();
+        }
+        TraceRecord& r = records_[num_recorded_ & (unsigned(Capacity) - 1U)];
+        r.timestamp_usec = uint32_t(ts.toUSec());
+        r.arg32 = arg32;
+        r.arg16 = arg16;
+        r.event = uint8_t(event);
+        r.arg8 = arg8;
+        num_recorded_++;
+        if (num_recorded_ == 0)
+        {
+            num_recorded_ = Capacity;   // Wrapped around; the ring is full and the write position is the same
+        }
+    }
+
+    /**
+     * Number of records available, up to the capacity.
+     */
+    unsigned getNumRecords() const { return unsigned(min(num_recorded_, uint32_t(Capacity))); }
+
+    /**
+     * Number of records that have been overwritten since the last reset; it restarts from zero after 2^32 records.
+     */
+    uint32_t getNumLostRecords() const { return num_recorded_ - uint32_t(getNumRecords()); }
+
+    /**
+     * Records are indexed in chronological order, from zero (the oldest one) to @ref getNumRecords() - 1.
+     * Out of range index returns the newest record.
+     */
+    const TraceRecord& getRecord(unsigned index) const
+    {
+        const unsigned num_records = getNumRecords();
+        if (num_records == 0)
+        {
+            return records_[0];
+        }
+        if (index >= num_records)
+        {
+            index = num_records - 1U;
+        }
+        return records_[(num_recorded_ - num_records + index) & (unsigned(Capacity) - 1U)];
+    }
+
+    /**
+     * Removes all records; the mask is not affected.
+     */
+    void reset() { num_recorded_ = 0; }
+};
+
+}
+
+#endif // UAVCAN_TRANSPORT_EVENT_TRACE_HPP_INCLUDED
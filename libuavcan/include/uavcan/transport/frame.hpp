@@ -16,7 +16,7 @@ namespace uavcan
 
 class UAVCAN_EXPORT Frame
 {
-    enum { PayloadCapacity = 7 };       // Will be redefined when CAN FD is available
+    enum { PayloadCapacity = CanFrame::MaxDataLen - 1 };        // One byte is reserved for the tail
 
     uint8_t payload_[PayloadCapacity];
     TransferPriority transfer_priority_;
@@ -67,6 +67,24 @@ public:
      * Max payload length depends on the transfer type and frame index.
      */
     uint8_t getPayloadCapacity() const { return PayloadCapacity; }
+
+    /**
+     * Returns true if a transfer with this payload length can be sent in one frame.
+     * With CAN FD, not every frame length is representable, so this is not the same as comparing against
+     * the payload capacity; see @ref CanFrame::dataLengthToDlc().
+     */
+    bool canFitIntoSingleFrame(unsigned payload_len) const
+    {
+        return (payload_len <= PayloadCapacity) &&
+               (CanFrame::roundDownDataLength(payload_len + 1U) == (payload_len + 1U));
+    }
+
+    /**
+     * Copies as much of the data as possible into the frame.
+     * With CAN FD the amount is chosen so that the resulting CAN frame length is representable,
+     * therefore it may be less than the payload capacity even if len is larger.
+     * @return Number of bytes written.
+     */
     uint8_t setPayload(const uint8_t* data, unsigned len);
 
     unsigned getPayloadLen() const { return payload_len_; }
@@ -90,6 +108,42 @@ public:
     bool parse(const CanFrame& can_frame);
     bool compile(CanFrame& can_frame) const;
 
+    /**
+     * Same as above, but the CAN ID template is supplied by the caller, and the frame is not validated, so it must
+     * be known to be valid, e.g. because the sender has validated the first frame of the transfer.
+     * Only the destination node ID, the tail byte and, for anonymous frames, the discriminator are added.
+     * @param can_id_template   Must be equal to @ref makeCanIDTemplate() for this frame.
+     */
+    void compile(CanFrame& can_frame, uint32_t can_id_template) const;
+
+    /**
+     * The part of the CAN ID that doesn't depend on the destination node ID and the payload, including the
+     * extended frame flag. It stays the same for every frame of every transfer of a sender as long as the
+     * priority and the local node ID are not changed, so the sender can compute it once.
+     */
+    static uint32_t makeCanIDTemplate(TransferPriority priority, TransferType transfer_type,
+                                      DataTypeID data_type_id, NodeID src_node_id);
+
+    uint32_t makeCanIDTemplate() const
+    {
+        return makeCanIDTemplate(transfer_priority_, transfer_type_, data_type_id_, src_node_id_);
+    }
+
+    /**
+     * Decodes only the addressing fields from the CAN ID, skipping the payload and the validity checks.
+     * This is much cheaper than parse(), so it can be used to reject irrelevant frames early.
+     * A frame that passed this check still has to be parsed with parse() before use.
+     * @return False if the CAN frame cannot be a UAVCAN frame.
+     */
+    static bool parseAddressing(const CanFrame& can_frame, TransferType& out_transfer_type,
+                                DataTypeID& out_data_type_id, NodeID& out_dst_node_id);
+
+    /**
+     * Checks the tail byte only, see @ref parseAddressing().
+     * @return True if the CAN frame is both the start and the end of a transfer.
+     */
+    static bool isSingleFrameTransfer(const CanFrame& can_frame);
+
     bool isValid() const;
 
     bool operator!=(const Frame& rhs) const { return !operator==(rhs); }
@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_TRANSPORT_LOCAL_TRANSFER_BUS_HPP_INCLUDED
+#define UAVCAN_TRANSPORT_LOCAL_TRANSFER_BUS_HPP_INCLUDED
+
+#include <uavcan/std.hpp>
+#include <uavcan/build_config.hpp>
+#include <uavcan/error.hpp>
+#include <uavcan/data_type.hpp>
+#include <uavcan/transport/transfer.hpp>
+#include <uavcan/util/templates.hpp>
+
+#if UAVCAN_TINY
+# error "This functionality is not available in tiny mode"
+#endif
+
+namespace uavcan
+{
+
+class UAVCAN_EXPORT Dispatcher;
+
+/**
+ * Delivers broadcast messages between the nodes that live in the same process, e.g. the main @ref Node and its
+ * @ref SubNode instances, or the nodes of a simulation, without splitting them into frames and reassembling them
+ * again. The serialized payload is passed directly to the subscribers of the other dispatchers connected to the bus,
+ * right from the publishing call; the frames still go to the CAN bus for the remote subscribers as usual.
+ *
+ * Only the data types enabled with @ref enableDataType() are delivered locally. The connected dispatchers drop the
+ * frames of these data types that come from the CAN bus if their source node ID is one of the dispatchers' node IDs,
+ * because these transfers have been delivered already, e.g. by a driver that loops the frames back between the
+ * sockets of the process.
+ *
+ * Anonymous messages, unicast messages and services are not delivered locally. The subscribers' callbacks are
+ * invoked from the publisher's context, therefore all connected dispatchers must be used from the same thread.
+ */
+class UAVCAN_EXPORT LocalTransferBus : Noncopyable
+{
+public:
+    static const unsigned MaxDispatchers = LocalTransferBusMaxDispatchers;
+    static const unsigned MaxDataTypes = LocalTransferBusMaxDataTypes;
+
+private:
+    Dispatcher* dispatchers_[MaxDispatchers];
+    DataTypeID data_types_[MaxDataTypes];
+    uint8_t num_dispatchers_;
+    uint8_t num_data_types_;
+    uint32_t num_local_transfers_;
+    uint32_t num_suppressed_frames_;
+
+    int findDataType(DataTypeID dtid) const;
+
+public:
+    LocalTransferBus()
+        : num_dispatchers_(0)
+        , num_data_types_(0)
+        , num_local_transfers_(0)
+        , num_suppressed_frames_(0)
+    { }
+
+    /**
+     * Disconnects all dispatchers.
+     */
+    ~LocalTransferBus();
+
+    /**
+     * A dispatcher can be connected to one bus at a time.
+     * @return 0 on success (also if the dispatcher is already connected), negative error code otherwise.
+     */
+    int addDispatcher(Dispatcher& dispatcher);
+    void removeDispatcher(Dispatcher& dispatcher);
+    unsigned getNumDispatchers() const { return num_dispatchers_; }
+
+    /**
+     * Local delivery is configured per message data type; it is disabled for all data types by default.
+     * @return 0 on success (also if the data type is already enabled), negative error code otherwise.
+     */
+    int enableDataType(DataTypeID dtid);
+    void disableDataType(DataTypeID dtid);
+    bool isDataTypeEnabled(DataTypeID dtid) const { return findDataType(dtid) >= 0; }
+    unsigned getNumEnabledDataTypes() const { return num_data_types_; }
+
+    /**
+     * Number of transfers passed to the connected dispatchers, counted once per receiving dispatcher.
+     */
+    uint32_t getNumLocalTransfers() const { return num_local_transfers_; }
+
+    /**
+     * Number of CAN frames dropped by the connected dispatchers, because their transfers were delivered locally.
+     */
+    uint32_t getNumSuppressedFrames() const { return num_suppressed_frames_; }
+
+    /**
+     * Internal, used by the dispatcher.
+     * Passes the message to the listeners of all connected dispatchers except the origin.
+     */
+    void deliver(const Dispatcher& origin, DataTypeID dtid, TransferPriority priority, TransferID tid,
+                 const uint8_t* payload, unsigned payload_len);
+
+    /**
+     * Internal, used by the dispatcher.
+     * Returns true if the frame of this data type from this source node must be dropped; counts the drops.
+     */
+    bool suppressFrame(DataTypeID dtid, NodeID src_node_id);
+};
+
+}
+
+#endif // UAVCAN_TRANSPORT_LOCAL_TRANSFER_BUS_HPP_INCLUDED
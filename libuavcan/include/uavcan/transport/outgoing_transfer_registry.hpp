@@ -9,6 +9,7 @@
 #include <uavcan/std.hpp>
 #include <uavcan/build_config.hpp>
 #include <uavcan/util/map.hpp>
+#include <uavcan/util/hash_map.hpp>
 #include <uavcan/debug.hpp>
 #include <uavcan/transport/transfer.hpp>
 #include <uavcan/time.hpp>
@@ -51,6 +52,11 @@ public:
             (destination_node_id_ == rhs.destination_node_id_);
     }
 
+    unsigned getHash() const
+    {
+        return (unsigned(data_type_id_.get()) * 131U + destination_node_id_.get()) * 3U + transfer_type_;
+    }
+
 #if UAVCAN_TOSTRING
     std::string toString() const;
 #endif
@@ -60,6 +66,10 @@ public:
  * Outgoing transfer registry keeps track of Transfer ID values for all currently existing local transfer senders.
  * If a local transfer sender was inactive for a sufficiently long time, the outgoing transfer registry will
  * remove the respective Transfer ID tracking object.
+ *
+ * The entries are looked up via a hash map, unless OutgoingTransferRegistryNumBuckets is zero.
+ * The registry keeps the lower bound of the entry deadlines, so that cleanup() doesn't have to visit the
+ * entries until at least one of them may have expired.
  */
 class UAVCAN_EXPORT OutgoingTransferRegistry : Noncopyable
 {
@@ -72,10 +82,12 @@ class UAVCAN_EXPORT OutgoingTransferRegistry : Noncopyable
     class DeadlineExpiredPredicate
     {
         const MonotonicTime ts_;
+        MonotonicTime* const earliest_remaining_deadline_;
 
     public:
-        explicit DeadlineExpiredPredicate(MonotonicTime ts)
+        DeadlineExpiredPredicate(MonotonicTime ts, MonotonicTime& earliest_remaining_deadline)
             : ts_(ts)
+            , earliest_remaining_deadline_(&earliest_remaining_deadline)
         { }
 
         bool operator()(const OutgoingTransferRegistryKey& key, const Value& value) const
@@ -88,6 +100,10 @@ class UAVCAN_EXPORT OutgoingTransferRegistry : Noncopyable
                 UAVCAN_TRACE("OutgoingTransferRegistry", "Expired %s tid=%i",
                              key.toString().c_str(), int(value.tid.get()));
             }
+            else if (earliest_remaining_deadline_->isZero() || (value.deadline < *earliest_remaining_deadline_))
+            {
+                *earliest_remaining_deadline_ = value.deadline;
+            }
             return expired;
         }
     };
@@ -109,17 +125,50 @@ class UAVCAN_EXPORT OutgoingTransferRegistry : Noncopyable
         }
     };
 
-    Map<OutgoingTransferRegistryKey, Value> map_;
+    typedef Select<(OutgoingTransferRegistryNumBuckets > 0),
+                   HashMap<OutgoingTransferRegistryKey, Value,
+                           ((OutgoingTransferRegistryNumBuckets > 0) ? OutgoingTransferRegistryNumBuckets : 1)>,
+                   Map<OutgoingTransferRegistryKey, Value> >::Result Container;
+
+    Container map_;
+    MonotonicTime earliest_deadline_;   ///< Not greater than the deadline of any entry; zero if there are none
+    uint32_t epoch_;                    ///< Incremented whenever the entries may have been moved or removed
+
+    Value* accessOrCreateValue(const OutgoingTransferRegistryKey& key);
 
 public:
     static const MonotonicDuration MinEntryLifetime;
 
+    /**
+     * Remembers the location of a registry entry, so that repeated accesses with the same key don't need to
+     * look it up. The cache is invalidated automatically when the registry removes any entries.
+     */
+    class EntryCache
+    {
+        friend class OutgoingTransferRegistry;
+        Value* value_;
+        uint32_t epoch_;
+
+    public:
+        EntryCache()
+            : value_(NULL)
+            , epoch_(0)
+        { }
+    };
+
     explicit OutgoingTransferRegistry(IPoolAllocator& allocator)
-        : map_(allocator)
+        : map_(allocator, PoolUsageTagOutgoingTransferRegistry)
+        , epoch_(0)
     { }
 
     TransferID* accessOrCreate(const OutgoingTransferRegistryKey& key, MonotonicTime new_deadline);
 
+    /**
+     * Same as above, but tries the cached entry first. The caller must always use the same key with the same cache.
+     */
+    TransferID* accessOrCreate(const OutgoingTransferRegistryKey& key, MonotonicTime new_deadline,
+                               EntryCache& cache);
+
     bool exists(DataTypeID dtid, TransferType tt) const;
 
     void cleanup(MonotonicTime ts);
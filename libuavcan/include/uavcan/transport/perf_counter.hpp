@@ -7,9 +7,324 @@
 
 #include <uavcan/std.hpp>
 #include <uavcan/build_config.hpp>
+#include <uavcan/time.hpp>
+#include <uavcan/data_type.hpp>
+#include <uavcan/util/templates.hpp>
+#include <uavcan/driver/system_clock.hpp>
+#include <uavcan/driver/cycle_counter.hpp>
+#include <uavcan/transport/event_trace.hpp>
+#include <uavcan/transport/duty_cycle_counter.hpp>
 
 namespace uavcan
 {
+/**
+ * Stages of the TX and RX pipelines covered by the latency histograms, see UAVCAN_LATENCY_STATS.
+ * The RX stages are measured from the timestamp assigned by the driver, so their accuracy depends on the driver.
+ */
+enum LatencyStage
+{
+    LatencyStageRxDriverToDispatcher,   ///< Frame received by the driver --> frame taken by the dispatcher
+    LatencyStageRxDriverToTransfer,     ///< First frame received by the driver --> transfer reassembled
+    LatencyStageRxDriverToCallback,     ///< First frame received by the driver --> decoded transfer passed to the app
+    LatencyStageTxPublishToTransport,   ///< Transfer publication requested --> encoded transfer passed to the transport
+    LatencyStageTxTransportToDriver,    ///< Frame passed to the CAN IO manager --> frame accepted by the driver
+    NumLatencyStages
+};
+
+/**
+ * Stages covered by the execution time histograms, see UAVCAN_EXECUTION_TIME_STATS.
+ * The stages that run the application callbacks include their execution time as well.
+ */
+enum ExecutionStage
+{
+    ExecutionStageRxLookup,             ///< Received frame pre-filtered and its first listener looked up
+    ExecutionStageRxFrame,              ///< Received frame processed, including the transfer reassembly and callbacks
+    ExecutionStageTxSend,               ///< Frame pushed to the TX queue or driver, including the blocking wait
+    ExecutionStageSchedulerPoll,        ///< Expired deadline handlers (timers, timeouts) looked up and called
+    NumExecutionStages
+};
+
+#if !UAVCAN_TINY
+/**
+ * Histogram of latencies with logarithmic buckets: the bucket N holds the samples within [2^N, 2^(N+1)) microseconds,
+ * except that the first bucket also holds zero and the last bucket holds everything above its lower bound.
+ * Counters are 32-bit and may wrap around on long-running systems; use @ref reset() if that matters.
+ */
+class UAVCAN_EXPORT LatencyHistogram
+{
+public:
+    enum { NumBuckets = 16 };
+
+private:
+    uint32_t buckets_[NumBuckets];
+    uint32_t num_samples_;
+    uint32_t max_usec_;
+    uint64_t sum_usec_;
+
+public:
+    LatencyHistogram() { reset(); }
+
+    void reset()
+    {
+        fill(buckets_, buckets_ + NumBuckets, uint32_t(0));
+        num_samples_ = 0;
+        max_usec_ = 0;
+        sum_usec_ = 0;
+    }
+
+    /**
+     * Negative latencies may appear if the driver's timestamps are slightly off; they are counted as zero.
+     */
+    void add(MonotonicDuration latency)
+    {
+        const uint32_t usec = latency.isNegative() ? 0U :
+                              uint32_t(min(latency.toUSec(), int64_t(NumericTraits<uint32_t>::max())));
+        buckets_[getBucketIndex(usec)]++;
+        num_samples_++;
+        max_usec_ = max(max_usec_, usec);
+        sum_usec_ += usec;
+    }
+
+    static unsigned getBucketIndex(uint32_t usec)
+    {
+        unsigned index = 0;
+        while ((usec > 1U) && (index < (NumBuckets - 1U)))
+        {
+            usec >>= 1;
+            index++;
+        }
+        return index;
+    }
+
+    static uint32_t getBucketLowerBoundUSec(unsigned index) { return (index == 0) ? 0U : (uint32_t(1) << index); }
+
+    uint32_t getBucketCount(unsigned index) const { return (index < NumBuckets) ? buckets_[index] : 0U; }
+    uint32_t getNumSamples() const { return num_samples_; }
+    uint32_t getMaxUSec() const { return max_usec_; }
+    uint32_t getMeanUSec() const { return (num_samples_ > 0) ? uint32_t(sum_usec_ / num_samples_) : 0U; }
+};
+
+/**
+ * Histogram of execution times in cycles of @ref ICycleCounter with logarithmic buckets, same as
+ * @ref LatencyHistogram: the bucket N holds the samples within [2^N, 2^(N+1)) cycles, except that the first bucket
+ * also holds zero and the last bucket holds everything above its lower bound. The maximum is what matters for
+ * the worst case execution time analysis; the buckets show how often it is approached.
+ */
+class UAVCAN_EXPORT ExecutionTimeHistogram
+{
+public:
+    enum { NumBuckets = 24 };
+
+private:
+    uint32_t buckets_[NumBuckets];
+    uint32_t num_samples_;
+    uint32_t max_cycles_;
+    uint64_t sum_cycles_;
+
+public:
+    ExecutionTimeHistogram() { reset(); }
+
+    void reset()
+    {
+        fill(buckets_, buckets_ + NumBuckets, uint32_t(0));
+        num_samples_ = 0;
+        max_cycles_ = 0;
+        sum_cycles_ = 0;
+    }
+
+    void add(uint32_t cycles)
+    {
+        buckets_[getBucketIndex(cycles)]++;
+        num_samples_++;
+        max_cycles_ = max(max_cycles_, cycles);
+        sum_cycles_ += cycles;
+    }
+
+    static unsigned getBucketIndex(uint32_t cycles)
+    {
+        unsigned index = 0;
+        while ((cycles > 1U) && (index < (NumBuckets - 1U)))
+        {
+            cycles >>= 1;
+            index++;
+        }
+        return index;
+    }
+
+    static uint32_t getBucketLowerBound(unsigned index) { return (index == 0) ? 0U : (uint32_t(1) << index); }
+
+    uint32_t getBucketCount(unsigned index) const { return (index < NumBuckets) ? buckets_[index] : 0U; }
+    uint32_t getNumSamples() const { return num_samples_; }
+    uint32_t getMaxCycles() const { return max_cycles_; }
+    uint32_t getMeanCycles() const { return (num_samples_ > 0) ? uint32_t(sum_cycles_ / num_samples_) : 0U; }
+};
+#endif
+
+#if UAVCAN_DATA_TYPE_PERF_STATS
+/**
+ * Traffic counters of the individual data types, see UAVCAN_DATA_TYPE_PERF_STATS.
+ * Every data type is assigned a slot of a small open-addressing hash table when it's seen for the first time, and
+ * keeps it forever, so the slot index of a data type never changes. When the table is full, the traffic of the new
+ * data types is accumulated in the overflow entry.
+ *
+ * Only the traffic that reaches the local node is counted: the received frames that were accepted by a listener,
+ * and the frames that were sent. Counters are 32-bit and may wrap around on long-running systems.
+ */
+class UAVCAN_EXPORT DataTypePerfCounters
+{
+public:
+    enum { Capacity = DataTypePerfStatsCapacity };
+
+    struct Counters
+    {
+        uint32_t frames;
+        uint32_t bytes;         ///< CAN frame payload, including the tail bytes
+        uint32_t transfers;
+        uint32_t errors;
+
+        Counters()
+            : frames(0)
+            , bytes(0)
+            , transfers(0)
+            , errors(0)
+        { }
+    };
+
+    class Entry
+    {
+        friend class DataTypePerfCounters;
+
+        uint16_t data_type_id_;
+        uint8_t data_type_kind_;
+        bool used_;
+
+    public:
+        Counters rx;
+        Counters tx;
+
+        Entry()
+            : data_type_id_(0)
+            , data_type_kind_(0)
+            , used_(false)
+        { }
+
+        bool isUsed() const { return used_; }
+
+        /**
+         * Invalid for unused entries and for the overflow entry.
+         */
+        DataTypeID getDataTypeID() const { return used_ ? DataTypeID(data_type_id_) : DataTypeID(); }
+        DataTypeKind getDataTypeKind() const { return DataTypeKind(data_type_kind_); }
+    };
+
+private:
+    Entry entries_[Capacity];
+    Entry overflow_;
+    uint16_t num_used_;
+
+    static unsigned computeSlot(DataTypeKind kind, DataTypeID dtid)
+    {
+        // Service IDs are small, so the kind is mixed into the high bits to keep them apart from the message IDs
+        return (dtid.get() ^ (unsigned(kind) * 0x9E37U)) & (unsigned(Capacity) - 1U);
+    }
+
+    Entry& access(DataTypeKind kind, DataTypeID dtid)
+    {
+        unsigned slot = computeSlot(kind, dtid);
+        for (unsigned i = 0; i < unsigned(Capacity); i++)
+        {
+            Entry& e = entries_[slot];
+            if (!e.used_)
+            {
+                e.data_type_id_ = dtid.get();
+                e.data_type_kind_ = uint8_t(kind);
+                e.used_ = true;
+                num_used_++;
+                return e;
+            }
+            if ((e.data_type_id_ == dtid.get()) && (e.data_type_kind_ == uint8_t(kind)))
+            {
+                return e;
+            }
+            slot = (slot + 1U) & (unsigned(Capacity) - 1U);
+        }
+        return overflow_;
+    }
+
+public:
+    DataTypePerfCounters() : num_used_(0) { }
+
+    void addRxFrame(DataTypeKind kind, DataTypeID dtid, unsigned bytes)
+    {
+        Counters& c = access(kind, dtid).rx;
+        c.frames++;
+        c.bytes += bytes;
+    }
+    void addTxFrame(DataTypeKind kind, DataTypeID dtid, unsigned bytes)
+    {
+        Counters& c = access(kind, dtid).tx;
+        c.frames++;
+        c.bytes += bytes;
+    }
+
+    void addRxTransfer(DataTypeKind kind, DataTypeID dtid) { access(kind, dtid).rx.transfers++; }
+    void addTxTransfer(DataTypeKind kind, DataTypeID dtid) { access(kind, dtid).tx.transfers++; }
+
+    void addRxErrors(DataTypeKind kind, DataTypeID dtid, unsigned errors) { access(kind, dtid).rx.errors += errors; }
+    void addTxErrors(DataTypeKind kind, DataTypeID dtid, unsigned errors) { access(kind, dtid).tx.errors += errors; }
+
+    /**
+     * Returns NULL if the data type has not been seen yet, or if it didn't fit the table.
+     */
+    const Entry* find(DataTypeKind kind, DataTypeID dtid) const
+    {
+        unsigned slot = computeSlot(kind, dtid);
+        for (unsigned i = 0; i < unsigned(Capacity); i++)
+        {
+            const Entry& e = entries_[slot];
+            if (!e.used_)
+            {
+                break;
+            }
+            if ((e.data_type_id_ == dtid.get()) && (e.data_type_kind_ == uint8_t(kind)))
+            {
+                return &e;
+            }
+            slot = (slot + 1U) & (unsigned(Capacity) - 1U);
+        }
+        return NULL;
+    }
+
+    /**
+     * Slots are indexed from zero to Capacity - 1; unused slots are returned too, see @ref Entry::isUsed().
+     */
+    const Entry& getEntry(unsigned slot) const { return entries_[(slot < unsigned(Capacity)) ? slot : 0U]; }
+
+    unsigned getNumUsedEntries() const { return num_used_; }
+
+    /**
+     * Traffic of the data types that didn't fit the table.
+     */
+    const Entry& getOverflowEntry() const { return overflow_; }
+
+    /**
+     * Calls the operator for every used entry, in no particular order.
+     * Operator signature:
+     *   void (const Entry&)
+     */
+    template <typename Operator>
+    void forEach(Operator op) const
+    {
+        for (unsigned i = 0; i < unsigned(Capacity); i++)
+        {
+            if (entries_[i].used_)
+            {
+                op(entries_[i]);
+            }
+        }
+    }
+};
+#endif
 
 #if UAVCAN_TINY
 
@@ -20,9 +335,21 @@ public:
     void addRxTransfer() { }
     void addError() { }
     void addErrors(unsigned) { }
+    void addFilteredFrame() { }
+    void sampleLatency(LatencyStage, MonotonicTime) { }
+    uint32_t readCycleCounter() const { return 0; }
+    void sampleExecutionTime(ExecutionStage, uint32_t) { }
+    void traceEvent(TraceEvent, MonotonicTime, uint32_t = 0, uint16_t = 0, uint8_t = 0) { }
+    void addRxFrame(DataTypeKind, DataTypeID, unsigned) { }
+    void addTxFrame(DataTypeKind, DataTypeID, unsigned) { }
+    void addRxTransfer(DataTypeKind, DataTypeID) { }
+    void addTxTransfer(DataTypeKind, DataTypeID) { }
+    void addRxErrors(DataTypeKind, DataTypeID, unsigned) { }
+    void addTxError(DataTypeKind, DataTypeID) { }
     uint64_t getTxTransferCount() const { return 0; }
     uint64_t getRxTransferCount() const { return 0; }
     uint64_t getErrorCount() const { return 0; }
+    uint64_t getFilteredFrameCount() const { return 0; }
 };
 
 #else
@@ -32,12 +359,37 @@ class UAVCAN_EXPORT TransferPerfCounter
     uint64_t transfers_tx_;
     uint64_t transfers_rx_;
     uint64_t errors_;
+    uint64_t frames_filtered_;
+#if UAVCAN_LATENCY_STATS
+    LatencyHistogram latency_[NumLatencyStages];
+    const ISystemClock* sysclock_;
+#endif
+#if UAVCAN_EXECUTION_TIME_STATS
+    ExecutionTimeHistogram execution_time_[NumExecutionStages];
+    const ICycleCounter* cycle_counter_;
+#endif
+#if UAVCAN_EVENT_TRACE
+    EventTrace event_trace_;
+#endif
+#if UAVCAN_DATA_TYPE_PERF_STATS
+    DataTypePerfCounters data_types_;
+#endif
+#if UAVCAN_DUTY_CYCLE_STATS
+    DutyCycleCounter duty_cycle_;
+#endif
 
 public:
     TransferPerfCounter()
         : transfers_tx_(0)
         , transfers_rx_(0)
         , errors_(0)
+        , frames_filtered_(0)
+#if UAVCAN_LATENCY_STATS
+        , sysclock_(NULL)
+#endif
+#if UAVCAN_EXECUTION_TIME_STATS
+        , cycle_counter_(NULL)
+#endif
     { }
 
     void addTxTransfer() { transfers_tx_++; }
@@ -50,13 +402,213 @@ public:
         errors_ += errors;
     }
 
+    /**
+     * Same as above, but the events are also attributed to the data type, see UAVCAN_DATA_TYPE_PERF_STATS.
+     * The frame counters are maintained only per data type. The TX errors are counted one by one because
+     * every failed send attempt aborts the transfer.
+     * @{
+     */
+#if UAVCAN_DATA_TYPE_PERF_STATS
+    void addRxFrame(DataTypeKind kind, DataTypeID dtid, unsigned bytes) { data_types_.addRxFrame(kind, dtid, bytes); }
+    void addTxFrame(DataTypeKind kind, DataTypeID dtid, unsigned bytes) { data_types_.addTxFrame(kind, dtid, bytes); }
+
+    void addRxTransfer(DataTypeKind kind, DataTypeID dtid)
+    {
+        transfers_rx_++;
+        data_types_.addRxTransfer(kind, dtid);
+    }
+    void addTxTransfer(DataTypeKind kind, DataTypeID dtid)
+    {
+        transfers_tx_++;
+        data_types_.addTxTransfer(kind, dtid);
+    }
+
+    void addRxErrors(DataTypeKind kind, DataTypeID dtid, unsigned errors)
+    {
+        errors_ += errors;
+        if (errors > 0)
+        {
+            data_types_.addRxErrors(kind, dtid, errors);
+        }
+    }
+    void addTxError(DataTypeKind kind, DataTypeID dtid)
+    {
+        errors_++;
+        data_types_.addTxErrors(kind, dtid, 1);
+    }
+
+    const DataTypePerfCounters& getDataTypePerfCounters() const { return data_types_; }
+#else
+    void addRxFrame(DataTypeKind, DataTypeID, unsigned) { }
+    void addTxFrame(DataTypeKind, DataTypeID, unsigned) { }
+    void addRxTransfer(DataTypeKind, DataTypeID) { addRxTransfer(); }
+    void addTxTransfer(DataTypeKind, DataTypeID) { addTxTransfer(); }
+    void addRxErrors(DataTypeKind, DataTypeID, unsigned errors) { addErrors(errors); }
+    void addTxError(DataTypeKind, DataTypeID) { addError(); }
+#endif
+    /**
+     * @}
+     */
+
+    /**
+     * Frames that were dropped by the dispatcher before parsing, because they were addressed to another node
+     * or because there were no listeners for their data type.
+     */
+    void addFilteredFrame() { frames_filtered_++; }
+
+    /**
+     * Adds the time elapsed since the specified moment to the histogram of the specified stage.
+     * Zero timestamps are ignored, because they indicate that the driver does not support timestamping.
+     * Does nothing unless UAVCAN_LATENCY_STATS is enabled.
+     */
+#if UAVCAN_LATENCY_STATS
+    void sampleLatency(LatencyStage stage, MonotonicTime since)
+    {
+        if ((sysclock_ != NULL) && !since.isZero() && (stage < NumLatencyStages))
+        {
+            latency_[stage].add(sysclock_->getMonotonic() - since);
+        }
+    }
+
+    void setSystemClock(const ISystemClock* sysclock) { sysclock_ = sysclock; }
+
+    const LatencyHistogram& getLatencyHistogram(LatencyStage stage) const
+    {
+        return latency_[(stage < NumLatencyStages) ? stage : 0];
+    }
+    LatencyHistogram& getLatencyHistogram(LatencyStage stage)
+    {
+        return latency_[(stage < NumLatencyStages) ? stage : 0];
+    }
+#else
+    void sampleLatency(LatencyStage, MonotonicTime) { }
+#endif
+
+    /**
+     * The execution time of a stage is the difference between the cycle counter readings taken at the end and at
+     * the beginning of the stage, see @ref ExecutionTimeScope. If there is no cycle counter, the readings return
+     * zero and nothing is sampled. Does nothing unless UAVCAN_EXECUTION_TIME_STATS is enabled.
+     */
+#if UAVCAN_EXECUTION_TIME_STATS
+    uint32_t readCycleCounter() const { return (cycle_counter_ != NULL) ? cycle_counter_->getCycleCount() : 0U; }
+
+    void sampleExecutionTime(ExecutionStage stage, uint32_t started_at)
+    {
+        if ((cycle_counter_ != NULL) && (stage < NumExecutionStages))
+        {
+            execution_time_[stage].add(cycle_counter_->getCycleCount() - started_at);
+        }
+    }
+
+    void setCycleCounter(const ICycleCounter* cycle_counter) { cycle_counter_ = cycle_counter; }
+    const ICycleCounter* getCycleCounter() const { return cycle_counter_; }
+
+    const ExecutionTimeHistogram& getExecutionTimeHistogram(ExecutionStage stage) const
+    {
+        return execution_time_[(stage < NumExecutionStages) ? stage : 0];
+    }
+    ExecutionTimeHistogram& getExecutionTimeHistogram(ExecutionStage stage)
+    {
+        return execution_time_[(stage < NumExecutionStages) ? stage : 0];
+    }
+#else
+    uint32_t readCycleCounter() const { return 0; }
+    void sampleExecutionTime(ExecutionStage, uint32_t) { }
+#endif
+
+    /**
+     * Records the event into the trace, see @ref EventTrace::record().
+     * Does nothing unless UAVCAN_EVENT_TRACE is enabled.
+     */
+#if UAVCAN_EVENT_TRACE
+    void traceEvent(TraceEvent event, MonotonicTime ts, uint32_t arg32 = 0, uint16_t arg16 = 0, uint8_t arg8 = 0)
+    {
+        event_trace_.record(event, ts, arg32, arg16, arg8);
+    }
+
+    const EventTrace& getEventTrace() const { return event_trace_; }
+    EventTrace& getEventTrace() { return event_trace_; }
+#else
+    void traceEvent(TraceEvent, MonotonicTime, uint32_t = 0, uint16_t = 0, uint8_t = 0) { }
+#endif
+
+    /**
+     * See @ref DutyCycleScope. Available only if UAVCAN_DUTY_CYCLE_STATS is enabled.
+     */
+#if UAVCAN_DUTY_CYCLE_STATS
+    const DutyCycleCounter& getDutyCycleCounter() const { return duty_cycle_; }
+    DutyCycleCounter& getDutyCycleCounter() { return duty_cycle_; }
+#endif
+
     uint64_t getTxTransferCount() const { return transfers_tx_; }
     uint64_t getRxTransferCount() const { return transfers_rx_; }
     uint64_t getErrorCount() const { return errors_; }
+    uint64_t getFilteredFrameCount() const { return frames_filtered_; }
 };
 
 #endif
 
+/**
+ * Samples the execution time of the enclosing scope, see @ref TransferPerfCounter::sampleExecutionTime().
+ * Null pointer disables sampling. Compiles to nothing unless UAVCAN_EXECUTION_TIME_STATS is enabled.
+ */
+class UAVCAN_EXPORT ExecutionTimeScope : Noncopyable
+{
+#if UAVCAN_EXECUTION_TIME_STATS
+    TransferPerfCounter* const perf_;
+    const ExecutionStage stage_;
+    const uint32_t started_at_;
+
+public:
+    ExecutionTimeScope(TransferPerfCounter* perf, ExecutionStage stage)
+        : perf_(perf)
+        , stage_(stage)
+        , started_at_((perf == NULL) ? 0U : perf->readCycleCounter())
+    { }
+
+    ~ExecutionTimeScope()
+    {
+        if (perf_ != NULL)
+        {
+            perf_->sampleExecutionTime(stage_, started_at_);
+        }
+    }
+#else
+public:
+    ExecutionTimeScope(TransferPerfCounter*, ExecutionStage) { }
+#endif
+};
+
+/**
+ * Charges the time of the enclosing scope to the specified category of @ref DutyCycleCounter, except the time
+ * of the nested scopes. Null pointer disables accounting. Compiles to nothing unless UAVCAN_DUTY_CYCLE_STATS
+ * is enabled.
+ */
+class UAVCAN_EXPORT DutyCycleScope : Noncopyable
+{
+#if UAVCAN_DUTY_CYCLE_STATS
+    DutyCycleCounter* const counter_;
+    const uint8_t previous_;
+
+public:
+    DutyCycleScope(TransferPerfCounter* perf, DutyCycleCategory category)
+        : counter_((perf == NULL) ? NULL : &perf->getDutyCycleCounter())
+        , previous_((counter_ == NULL) ? uint8_t(DutyCycleCategoryNone) : counter_->enter(category))
+    { }
+
+    ~DutyCycleScope()
+    {
+        if (counter_ != NULL)
+        {
+            counter_->leave(previous_);
+        }
+    }
+#else
+public:
+    DutyCycleScope(TransferPerfCounter*, DutyCycleCategory) { }
+#endif
+};
+
 }
 
 #endif // UAVCAN_TRANSPORT_PERF_COUNTER_HPP_INCLUDED
@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_TRANSPORT_REASSEMBLY_TABLE_HPP_INCLUDED
+#define UAVCAN_TRANSPORT_REASSEMBLY_TABLE_HPP_INCLUDED
+
+#include <cstdlib>
+#include <uavcan/std.hpp>
+#include <uavcan/build_config.hpp>
+#include <uavcan/dynamic_memory.hpp>
+#include <uavcan/util/hash_map.hpp>
+#include <uavcan/transport/transfer_buffer.hpp>
+#include <uavcan/transport/transfer_receiver.hpp>
+
+namespace uavcan
+{
+
+class TransferListener;
+
+/**
+ * Internal for ReassemblyTable
+ */
+class UAVCAN_EXPORT ReassemblyTableKey
+{
+    TransferListener* listener_;
+    TransferBufferManagerKey key_;
+
+public:
+    ReassemblyTableKey()
+        : listener_(NULL)
+    { }
+
+    ReassemblyTableKey(TransferListener& listener, const TransferBufferManagerKey& key)
+        : listener_(&listener)
+        , key_(key)
+    {
+        UAVCAN_ASSERT(!key.isEmpty());
+    }
+
+    bool operator==(const ReassemblyTableKey& rhs) const
+    {
+        return (listener_ == rhs.listener_) && (key_ == rhs.key_);
+    }
+
+    /**
+     * The listeners are allocated with at least the pointer alignment, so the low bits of the address are dropped.
+     */
+    unsigned getHash() const
+    {
+        const std::size_t listener_hash = reinterpret_cast<std::size_t>(listener_) / sizeof(void*);
+        return static_cast<unsigned>(listener_hash * 31U) + key_.getHash();
+    }
+
+    TransferListener* getListener() const { return listener_; }
+    const TransferBufferManagerKey& getBufferKey() const { return key_; }
+};
+
+/**
+ * Node-wide storage of the transfer receivers of all listeners, to be installed into the dispatcher with
+ * @ref Dispatcher::installReassemblyTable(). By default, every listener keeps the receivers of its sources in its
+ * own container; with the table installed, the receivers of all listeners are kept in one hash table keyed on
+ * the listener, the source node ID, and the transfer type, which gives:
+ *  - One lookup structure for all the RX traffic, whose cost depends on the number of buckets only, rather than
+ *    one container per listener.
+ *  - One cleanup sweep per pass instead of one per listener, regardless of how many listeners are idle.
+ *  - One memory quota for the receivers and the reassembly buffers of all listeners, see @ref setMaxBlocks(), so
+ *    a flood of new sources or transfers can't take the pool memory that belongs to the rest of the node.
+ *
+ * The receivers of @ref TransferListenerWithNodeIndex that are found by the node ID index remain in the index;
+ * their buffers are accounted in the quota. Each entry takes one memory pool block.
+ *
+ * Usage example:
+ *   static uavcan::ReassemblyTable table(node.getAllocator(), 200);
+ *   node.getDispatcher().installReassemblyTable(&table);
+ */
+class UAVCAN_EXPORT ReassemblyTable : Noncopyable
+{
+    SharedPoolQuota quota_;
+    LimitedPoolAllocator receiver_allocator_;
+    LimitedPoolAllocator buffer_allocator_;
+    HashMap<ReassemblyTableKey, TransferReceiver, ReassemblyTableNumBuckets> receivers_;
+
+    class TimedOutReceiverPredicate
+    {
+        const MonotonicTime ts_;
+
+    public:
+        explicit TimedOutReceiverPredicate(MonotonicTime arg_ts) : ts_(arg_ts) { }
+
+        bool operator()(const ReassemblyTableKey& key, const TransferReceiver& value) const;
+    };
+
+    class ListenerPredicate
+    {
+        const TransferListener& listener_;
+
+    public:
+        explicit ListenerPredicate(const TransferListener& arg_listener) : listener_(arg_listener) { }
+
+        bool operator()(const ReassemblyTableKey& key, const TransferReceiver& value) const;
+    };
+
+    class LeastRecentlyActiveReceiverFinder
+    {
+        const TransferListener& requester_;
+        const TransferBufferManagerKey& protected_key_;
+        ReassemblyTableKey& inout_key_;
+        MonotonicTime& inout_ts_;
+
+    public:
+        LeastRecentlyActiveReceiverFinder(const TransferListener& requester,
+                                          const TransferBufferManagerKey& protected_key,
+                                          ReassemblyTableKey& inout_key, MonotonicTime& inout_ts)
+            : requester_(requester)
+            , protected_key_(protected_key)
+            , inout_key_(inout_key)
+            , inout_ts_(inout_ts)
+        { }
+
+        bool operator()(const ReassemblyTableKey& key, const TransferReceiver& value) const;
+    };
+
+    static void releaseReceiverState(const ReassemblyTableKey& key, const TransferReceiver& receiver);
+
+public:
+    /**
+     * @param max_blocks    Number of memory pool blocks the receivers and the reassembly buffers may take; it can be
+     *                      changed later with @ref setMaxBlocks().
+     */
+    ReassemblyTable(IPoolAllocator& allocator, uint16_t max_blocks)
+        : receiver_allocator_(allocator, max_blocks, PoolUsageTagTransferReceivers)
+        , buffer_allocator_(allocator, max_blocks, PoolUsageTagTransferBuffers)
+        , receivers_(receiver_allocator_, PoolUsageTagTransferReceivers)
+    {
+        quota_.setLimits(max_blocks, 0);
+        receiver_allocator_.setSharedQuota(&quota_, 0);
+        buffer_allocator_.setSharedQuota(&quota_, 0);
+    }
+
+    /**
+     * The table must be removed from the dispatcher before destruction.
+     */
+    ~ReassemblyTable() { UAVCAN_ASSERT(receivers_.isEmpty()); }
+
+    TransferReceiver* access(TransferListener& listener, const TransferBufferManagerKey& key)
+    {
+        return receivers_.access(ReassemblyTableKey(listener, key));
+    }
+
+    TransferReceiver* insert(TransferListener& listener, const TransferBufferManagerKey& key,
+                             const TransferReceiver& receiver)
+    {
+        return receivers_.insert(ReassemblyTableKey(listener, key), receiver);
+    }
+
+    /**
+     * Destroys the receiver without releasing its state; this is up to the caller.
+     */
+    void remove(TransferListener& listener, const TransferBufferManagerKey& key)
+    {
+        receivers_.remove(ReassemblyTableKey(listener, key));
+    }
+
+    /**
+     * Destroys all receivers of the listener, releasing their state; this is done when the listener is detached.
+     */
+    void removeListener(const TransferListener& listener);
+
+    /**
+     * Destroys the expired receivers of all listeners, see @ref TransferReceiver::isExpired().
+     */
+    void cleanup(MonotonicTime ts);
+
+    /**
+     * Same as @ref TransferListener::findLeastRecentlyActiveReceiver(), but for all listeners at once; the receiver
+     * of the requester with the protected key is not considered. Returns the owner of the receiver found, or NULL.
+     */
+    TransferListener* findLeastRecentlyActiveReceiver(const TransferListener& requester,
+                                                      const TransferBufferManagerKey& protected_key,
+                                                      TransferBufferManagerKey& inout_key,
+                                                      MonotonicTime& inout_ts) const;
+
+    /**
+     * The listeners allocate their reassembly buffers from this allocator while the table is installed.
+     */
+    IPoolAllocator& getBufferAllocator() { return buffer_allocator_; }
+
+    /**
+     * Does not affect the blocks that are already allocated, so the number of used blocks may exceed the new limit
+     * until they are released.
+     */
+    void setMaxBlocks(uint16_t max_blocks) { quota_.setLimits(max_blocks, 0); }
+    uint16_t getMaxBlocks() const { return quota_.getMaxBlocks(); }
+
+    uint16_t getNumUsedBlocks() const
+    {
+        return static_cast<uint16_t>(receiver_allocator_.getNumUsedBlocks() + buffer_allocator_.getNumUsedBlocks());
+    }
+
+    unsigned getNumReceivers() const { return receivers_.getSize(); }
+};
+
+}
+
+#endif // UAVCAN_TRANSPORT_REASSEMBLY_TABLE_HPP_INCLUDED
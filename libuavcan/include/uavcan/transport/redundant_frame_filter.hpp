@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_TRANSPORT_REDUNDANT_FRAME_FILTER_HPP_INCLUDED
+#define UAVCAN_TRANSPORT_REDUNDANT_FRAME_FILTER_HPP_INCLUDED
+
+#include <uavcan/std.hpp>
+#include <uavcan/build_config.hpp>
+#include <uavcan/time.hpp>
+#include <uavcan/driver/can.hpp>
+#include <uavcan/transport/transfer_receiver.hpp>
+#include <uavcan/util/templates.hpp>
+
+namespace uavcan
+{
+/**
+ * Drops the redundant copies of the received frames before they reach the transfer layer.
+ *
+ * With redundant ifaces, every frame normally arrives once per iface. The filter assigns every frame stream,
+ * i.e. every CAN ID without the priority bits, to the iface it has been seen on first, and drops the frames of
+ * the stream that come from the other ifaces as long as the assigned iface keeps delivering them. The stream is
+ * reassigned to another iface once nothing has been received from the assigned iface for the failover timeout.
+ * The cost is one lookup in a small set-associative table per frame.
+ *
+ * The filter can't drop only the copies of the frames that have been seen already, because the transfer receivers
+ * accept the frames from one iface at a time; if the copies arrive in a different order on different ifaces,
+ * the copy passed to the receiver may be from the wrong iface, and the copy from the right one would be dropped.
+ * Instead, the filter makes the receivers see every stream on one iface only; the default failover timeout equals
+ * the transfer ID timeout of @ref TransferReceiver, which guarantees that the receivers accept the frames from
+ * the new iface immediately. Shorter timeouts make the failover faster, but then the receivers may reject the frames
+ * of the streams whose transfer interval is longer than the timeout until they switch the iface themselves.
+ *
+ * If all ways of a table set are occupied by the active streams, the frames of a new stream are passed unfiltered.
+ */
+class UAVCAN_EXPORT RedundantFrameFilter : Noncopyable
+{
+public:
+    static const unsigned Size = RedundantFrameFilterSize;
+    static const unsigned Associativity = 4;
+
+    static MonotonicDuration getDefaultFailoverTimeout()
+    {
+        return MonotonicDuration::fromMSec(TransferReceiver::DefaultTidTimeoutMSec);
+    }
+
+private:
+    enum { NumSets = (Size >= Associativity) ? (Size / Associativity) : 1 };
+
+    struct Entry
+    {
+        MonotonicTime ts;           ///< Last frame from the assigned iface; zero if the entry is free
+        uint32_t stream_id;
+        uint8_t iface_index;
+
+        Entry()
+            : stream_id(0)
+            , iface_index(0)
+        { }
+    };
+
+    Entry entries_[NumSets][Associativity];
+    MonotonicDuration failover_timeout_;
+    uint32_t num_duplicates_[MaxCanIfaces];
+    uint32_t num_untracked_frames_;
+
+    static uint32_t computeStreamID(const CanFrame& frame);
+    static unsigned computeSet(uint32_t stream_id);
+
+public:
+    RedundantFrameFilter()
+        : failover_timeout_(getDefaultFailoverTimeout())
+        , num_untracked_frames_(0)
+    {
+        fill(num_duplicates_, num_duplicates_ + MaxCanIfaces, uint32_t(0));
+    }
+
+    /**
+     * Returns false if the frame should be dropped because it belongs to a stream assigned to another iface.
+     * The frame must not be a loopback frame.
+     */
+    bool accept(const CanRxFrame& frame);
+
+    /**
+     * Forgets all streams; the counters are not affected.
+     */
+    void reset();
+
+    MonotonicDuration getFailoverTimeout() const { return failover_timeout_; }
+    void setFailoverTimeout(MonotonicDuration x) { failover_timeout_ = x; }
+
+    /**
+     * Number of frames dropped because they were received from the specified iface while their stream was
+     * assigned to another one.
+     */
+    uint32_t getNumDuplicates(uint8_t iface_index) const
+    {
+        return (iface_index < MaxCanIfaces) ? num_duplicates_[iface_index] : 0;
+    }
+
+    /**
+     * Number of frames that were not filtered because the table was full.
+     */
+    uint32_t getNumUntrackedFrames() const { return num_untracked_frames_; }
+};
+
+}
+
+#endif // UAVCAN_TRANSPORT_REDUNDANT_FRAME_FILTER_HPP_INCLUDED
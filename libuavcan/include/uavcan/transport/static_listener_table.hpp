@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_TRANSPORT_STATIC_LISTENER_TABLE_HPP_INCLUDED
+#define UAVCAN_TRANSPORT_STATIC_LISTENER_TABLE_HPP_INCLUDED
+
+#include <uavcan/std.hpp>
+#include <uavcan/build_config.hpp>
+#include <uavcan/data_type.hpp>
+#include <uavcan/transport/transfer.hpp>
+#include <uavcan/transport/dispatcher.hpp>
+
+namespace uavcan
+{
+/**
+ * Terminator of the list of data types of @ref StaticListenerTable.
+ */
+struct UAVCAN_EXPORT StaticListenerTableEnd
+{
+    enum { Size = 0 };
+
+    static int findIndex(DataTypeKind kind, DataTypeID dtid)
+    {
+        (void)kind;
+        (void)dtid;
+        return -1;
+    }
+};
+
+/**
+ * Entry of the list of data types of @ref StaticListenerTable; the entries are chained via the last template
+ * argument. The data type is identified by its default data type ID.
+ */
+template <typename DataType, typename Next = StaticListenerTableEnd>
+struct UAVCAN_EXPORT StaticListenerTableEntry
+{
+    enum { Index = Next::Size };
+    enum { Size = 1 + unsigned(Next::Size) };
+
+    /**
+     * The comparisons are against compile time constants and are inlined all the way down the list.
+     */
+    static int findIndex(DataTypeKind kind, DataTypeID dtid)
+    {
+        return ((kind == DataTypeKind(DataType::DataTypeKind)) && (dtid.get() == unsigned(DataType::DefaultDataTypeID)))
+               ? int(Index) : Next::findIndex(kind, dtid);
+    }
+};
+
+/**
+ * Routes the incoming frames to the transfer listeners via a list of data types that is fixed at compile time,
+ * which is cheaper than the dynamic lookup when the listener index is disabled (e.g. on small MCUs, see
+ * DispatcherListenerIndexSize). Every data type has one slot per transfer type, which costs two pointers of RAM.
+ * The data types that are not listed can still be received, but then the frames of all unlisted data types are
+ * looked up dynamically as well; see @ref Dispatcher::installStaticListenerTable().
+ *
+ * Usage example:
+ *   typedef uavcan::StaticListenerTableEntry<uavcan::protocol::NodeStatus,
+ *           uavcan::StaticListenerTableEntry<uavcan::protocol::GetNodeInfo> > DataTypes;
+ *   static uavcan::StaticListenerTable<DataTypes> table;
+ *   node.getDispatcher().installStaticListenerTable(&table);
+ */
+template <typename DataTypes>
+class UAVCAN_EXPORT StaticListenerTable : public IStaticListenerTable,
+                                          Noncopyable
+{
+    enum { NumSlotsPerDataType = 2 };   // Messages and service requests use the first slot, responses the second
+
+    TransferListener* slots_[DataTypes::Size][NumSlotsPerDataType];
+
+public:
+    StaticListenerTable()
+    {
+        StaticAssert<(DataTypes::Size > 0)>::check();
+        clear();
+    }
+
+    virtual TransferListener** findSlot(TransferType transfer_type, DataTypeID dtid)
+    {
+        const int index = DataTypes::findIndex(getDataTypeKindForTransferType(transfer_type), dtid);
+        if (index < 0)
+        {
+            return NULL;
+        }
+        return &slots_[index][(transfer_type == TransferTypeServiceResponse) ? 1 : 0];
+    }
+
+    virtual void clear()
+    {
+        for (unsigned i = 0; i < unsigned(DataTypes::Size); i++)
+        {
+            for (unsigned k = 0; k < unsigned(NumSlotsPerDataType); k++)
+            {
+                slots_[i][k] = NULL;
+            }
+        }
+    }
+};
+
+}
+
+#endif // UAVCAN_TRANSPORT_STATIC_LISTENER_TABLE_HPP_INCLUDED
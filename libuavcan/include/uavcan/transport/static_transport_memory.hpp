@@ -0,0 +1,265 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_TRANSPORT_STATIC_TRANSPORT_MEMORY_HPP_INCLUDED
+#define UAVCAN_TRANSPORT_STATIC_TRANSPORT_MEMORY_HPP_INCLUDED
+
+#include <uavcan/std.hpp>
+#include <uavcan/build_config.hpp>
+#include <uavcan/dynamic_memory.hpp>
+#include <uavcan/transport/transfer.hpp>
+#include <uavcan/transport/transfer_buffer.hpp>
+
+namespace uavcan
+{
+/**
+ * Terminator of the compile time tables of subscriptions and publications.
+ */
+struct UAVCAN_EXPORT StaticTransportTableEnd
+{
+    enum { NumReceivers = 0 };
+    enum { NumBufferBlocks = 0 };
+    enum { NumTransferIDs = 0 };
+};
+
+/**
+ * Entry of the compile time table of subscriptions, see @ref StaticTransportAllocator.
+ * One entry describes one transfer listener (subscriber, service server, or the response listener of a
+ * service client) that receives transfers of up to MaxTransferSize bytes from up to NumSources nodes at once.
+ * The entries are chained via the last template argument.
+ */
+template <unsigned NumSources, unsigned MaxTransferSize, typename Next = StaticTransportTableEnd>
+struct UAVCAN_EXPORT StaticSubscription
+{
+    enum
+    {
+        NumBufferBlocksPerSource = (MaxTransferSize > GuaranteedPayloadLenPerFrame) ?    // Single frame otherwise
+                                   unsigned(TransferBufferManagerEntry::NumBlocksForSize<MaxTransferSize>::Result) : 0U
+    };
+    enum { NumReceivers = NumSources + unsigned(Next::NumReceivers) };
+    enum { NumBufferBlocks = NumSources * unsigned(NumBufferBlocksPerSource) + unsigned(Next::NumBufferBlocks) };
+    enum { NumTransferIDs = Next::NumTransferIDs };
+};
+
+/**
+ * Entry of the compile time table of publications, see @ref StaticTransportAllocator.
+ * One entry describes one publisher or service client that sends transfers to up to NumDestinations nodes;
+ * a message publisher has one destination, the broadcast address.
+ */
+template <unsigned NumDestinations, typename Next = StaticTransportTableEnd>
+struct UAVCAN_EXPORT StaticPublication
+{
+    enum { NumReceivers = Next::NumReceivers };
+    enum { NumBufferBlocks = Next::NumBufferBlocks };
+    enum { NumTransferIDs = NumDestinations + unsigned(Next::NumTransferIDs) };
+};
+
+/**
+ * Pool of @ref StaticTransportAllocator for a subsystem that has no blocks.
+ */
+class UAVCAN_EXPORT EmptyPoolAllocator : public IPoolAllocator
+{
+public:
+    virtual void* allocate(std::size_t size)
+    {
+        (void)size;
+        return NULL;
+    }
+
+    virtual void deallocate(const void* ptr)
+    {
+        (void)ptr;
+        UAVCAN_ASSERT(ptr == NULL);
+    }
+
+    virtual uint16_t getBlockCapacity() const { return 0; }
+
+    uint16_t getNumUsedBlocks() const { return 0; }
+    uint16_t getPeakNumUsedBlocks() const { return 0; }
+};
+
+/**
+ * Pool type of @ref StaticTransportAllocator for the given number of blocks.
+ */
+template <unsigned NumBlocks>
+struct UAVCAN_EXPORT StaticTransportPool
+{
+    typedef PoolAllocator<std::size_t(NumBlocks) * MemPoolBlockSize, MemPoolBlockSize> Type;
+};
+
+template <>
+struct UAVCAN_EXPORT StaticTransportPool<0>
+{
+    typedef EmptyPoolAllocator Type;
+};
+
+/**
+ * Allocator with the memory of every transport subsystem laid out at compile time.
+ *
+ * For applications where all subscriptions and publications are known in advance, this allocator replaces the
+ * shared pool with one static pool per subsystem listed in @ref PoolUsageTag, sized from the tables of
+ * subscriptions and publications: one block per remote source of every listener, the reassembly blocks of the
+ * multi-frame transfers, one Transfer ID entry per publication destination, and NumTxQueueFrames TX queue entries.
+ * The library containers pick their pool via @ref getPartition(), so no subsystem can take the memory of another,
+ * and every allocation takes constant time. Once a pool is exhausted, the allocations of its subsystem fail
+ * deterministically (e.g. the transfers from an unexpected source are ignored) instead of borrowing memory.
+ *
+ * Everything else, i.e. the pending service calls, the node index of @ref TransferListenerWithNodeIndex,
+ * and the application, allocates from the pool of NumOtherBlocks blocks.
+ *
+ * Usage example:
+ *   typedef uavcan::StaticSubscription<4, uavcan::BitLenToByteLen<Foo::MaxBitLen>::Result,
+ *           uavcan::StaticSubscription<1, uavcan::BitLenToByteLen<Bar::MaxBitLen>::Result> > Subscriptions;
+ *   typedef uavcan::StaticPublication<1, uavcan::StaticPublication<1> > Publications;
+ *   static uavcan::StaticTransportAllocator<Subscriptions, Publications, 32, 8> allocator;
+ *   uavcan::Node<> node(can_driver, system_clock, allocator);
+ */
+template <typename Subscriptions, typename Publications, unsigned NumTxQueueFrames, unsigned NumOtherBlocks = 0>
+class UAVCAN_EXPORT StaticTransportAllocator : public IPoolAllocator,
+                                               Noncopyable
+{
+public:
+    enum { NumReceiverBlocks = unsigned(Subscriptions::NumReceivers) + unsigned(Publications::NumReceivers) };
+    enum { NumBufferBlocks = unsigned(Subscriptions::NumBufferBlocks) + unsigned(Publications::NumBufferBlocks) };
+    enum
+    {
+        NumTransferIDBlocks = unsigned(Subscriptions::NumTransferIDs) + unsigned(Publications::NumTransferIDs)
+    };
+
+private:
+    typename StaticTransportPool<NumReceiverBlocks>::Type receivers_;
+    typename StaticTransportPool<NumBufferBlocks>::Type buffers_;
+    typename StaticTransportPool<NumTransferIDBlocks>::Type transfer_ids_;
+    typename StaticTransportPool<NumTxQueueFrames>::Type tx_queue_;
+    typename StaticTransportPool<NumOtherBlocks>::Type other_;
+
+    template <typename P>
+    static bool contains(const P& pool, const void* ptr)
+    {
+        const uint8_t* const p = static_cast<const uint8_t*>(ptr);
+        const uint8_t* const begin = reinterpret_cast<const uint8_t*>(&pool);
+        return (p >= begin) && (p < (begin + sizeof(pool)));
+    }
+
+public:
+    StaticTransportAllocator()
+    {
+        StaticAssert<((NumReceiverBlocks + NumBufferBlocks + NumTransferIDBlocks + NumTxQueueFrames +
+                       NumOtherBlocks) <= 0xFFFFU)>::check();
+    }
+
+    /**
+     * Allocates from the pool of the other blocks.
+     */
+    virtual void* allocate(std::size_t size) { return other_.allocate(size); }
+
+    /**
+     * The pool is determined by the address, so any block can be deallocated via this allocator as well.
+     */
+    virtual void deallocate(const void* ptr)
+    {
+        if (ptr == NULL)
+        {
+            return;
+        }
+        if (contains(receivers_, ptr))         { receivers_.deallocate(ptr); }
+        else if (contains(buffers_, ptr))      { buffers_.deallocate(ptr); }
+        else if (contains(transfer_ids_, ptr)) { transfer_ids_.deallocate(ptr); }
+        else if (contains(tx_queue_, ptr))     { tx_queue_.deallocate(ptr); }
+        else                                   { other_.deallocate(ptr); }
+    }
+
+    virtual uint16_t getBlockCapacity() const
+    {
+        return uint16_t(NumReceiverBlocks + NumBufferBlocks + NumTransferIDBlocks + NumTxQueueFrames +
+                        NumOtherBlocks);
+    }
+
+    virtual IPoolAllocator& getPartition(PoolUsageTag tag)
+    {
+        switch (tag)
+        {
+        case PoolUsageTagTransferReceivers:         { return receivers_; }
+        case PoolUsageTagTransferBuffers:           { return buffers_; }
+        case PoolUsageTagOutgoingTransferRegistry:  { return transfer_ids_; }
+        case PoolUsageTagTxQueue:                   { return tx_queue_; }
+        // These have no dedicated pool, so they are allocated from the pool of the other blocks via this allocator
+        case PoolUsageTagOther:
+        case PoolUsageTagServiceCalls:              { return *this; }
+        case NumPoolUsageTags:
+        default:
+        {
+            UAVCAN_ASSERT(0);
+            return *this;
+        }
+        }
+    }
+
+    /**
+     * Number of blocks of the subsystem's pool; zero for the subsystems that don't have one.
+     */
+    uint16_t getNumBlocks(PoolUsageTag tag) const
+    {
+        switch (tag)
+        {
+        case PoolUsageTagTransferReceivers:         { return uint16_t(NumReceiverBlocks); }
+        case PoolUsageTagTransferBuffers:           { return uint16_t(NumBufferBlocks); }
+        case PoolUsageTagOutgoingTransferRegistry:  { return uint16_t(NumTransferIDBlocks); }
+        case PoolUsageTagTxQueue:                   { return uint16_t(NumTxQueueFrames); }
+        case PoolUsageTagOther:                     { return uint16_t(NumOtherBlocks); }
+        case PoolUsageTagServiceCalls:              { return 0; }   // Counted in PoolUsageTagOther
+        case NumPoolUsageTags:
+        default:
+        {
+            UAVCAN_ASSERT(0);
+            return 0;
+        }
+        }
+    }
+
+    uint16_t getNumUsedBlocks(PoolUsageTag tag) const
+    {
+        switch (tag)
+        {
+        case PoolUsageTagTransferReceivers:         { return receivers_.getNumUsedBlocks(); }
+        case PoolUsageTagTransferBuffers:           { return buffers_.getNumUsedBlocks(); }
+        case PoolUsageTagOutgoingTransferRegistry:  { return transfer_ids_.getNumUsedBlocks(); }
+        case PoolUsageTagTxQueue:                   { return tx_queue_.getNumUsedBlocks(); }
+        case PoolUsageTagOther:                     { return other_.getNumUsedBlocks(); }
+        case PoolUsageTagServiceCalls:              { return 0; }   // Counted in PoolUsageTagOther
+        case NumPoolUsageTags:
+        default:
+        {
+            UAVCAN_ASSERT(0);
+            return 0;
+        }
+        }
+    }
+
+    /**
+     * Comparing the peak usage with @ref getNumBlocks() after a test run shows whether the tables are adequate.
+     */
+    uint16_t getPeakNumUsedBlocks(PoolUsageTag tag) const
+    {
+        switch (tag)
+        {
+        case PoolUsageTagTransferReceivers:         { return receivers_.getPeakNumUsedBlocks(); }
+        case PoolUsageTagTransferBuffers:           { return buffers_.getPeakNumUsedBlocks(); }
+        case PoolUsageTagOutgoingTransferRegistry:  { return transfer_ids_.getPeakNumUsedBlocks(); }
+        case PoolUsageTagTxQueue:                   { return tx_queue_.getPeakNumUsedBlocks(); }
+        case PoolUsageTagOther:                     { return other_.getPeakNumUsedBlocks(); }
+        case PoolUsageTagServiceCalls:              { return 0; }   // Counted in PoolUsageTagOther
+        case NumPoolUsageTags:
+        default:
+        {
+            UAVCAN_ASSERT(0);
+            return 0;
+        }
+        }
+    }
+};
+
+}
+
+#endif // UAVCAN_TRANSPORT_STATIC_TRANSPORT_MEMORY_HPP_INCLUDED
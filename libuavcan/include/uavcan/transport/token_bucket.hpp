@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_TRANSPORT_TOKEN_BUCKET_HPP_INCLUDED
+#define UAVCAN_TRANSPORT_TOKEN_BUCKET_HPP_INCLUDED
+
+#include <uavcan/std.hpp>
+#include <uavcan/build_config.hpp>
+#include <uavcan/time.hpp>
+
+namespace uavcan
+{
+/**
+ * Token bucket for traffic shaping.
+ * The bucket holds up to @ref getBurst() tokens and is refilled at @ref getRate() tokens per second;
+ * one token stands for one byte. The bucket is full after configuration.
+ * Zero rate disables the limit, which is the default; a disabled bucket accepts everything.
+ */
+class UAVCAN_EXPORT TokenBucket
+{
+    enum { MicrotokensPerToken = 1000000 };
+
+    MonotonicTime last_update_;
+    uint64_t level_;                ///< Microtokens, so that the refill is exact with microsecond time resolution
+    uint32_t rate_;
+    uint32_t burst_;
+
+    uint64_t getCapacity() const { return uint64_t(burst_) * MicrotokensPerToken; }
+
+    void refill(MonotonicTime ts);
+
+public:
+    TokenBucket()
+        : level_(0)
+        , rate_(0)
+        , burst_(0)
+    { }
+
+    /**
+     * @param rate      Tokens per second; zero disables the limit.
+     * @param burst     Capacity of the bucket; amounts larger than that will never be accepted.
+     */
+    void configure(uint32_t rate, uint32_t burst);
+
+    bool isEnabled() const { return rate_ > 0; }
+
+    uint32_t getRate() const { return rate_; }
+    uint32_t getBurst() const { return burst_; }
+
+    /**
+     * Whether the bucket has at least the specified amount of tokens at the specified time.
+     */
+    bool canConsume(uint32_t amount, MonotonicTime ts);
+
+    /**
+     * Takes the specified amount of tokens from the bucket, if there are enough of them.
+     * Returns false if the amount exceeds the budget; the bucket is not modified in this case.
+     */
+    bool tryConsume(uint32_t amount, MonotonicTime ts);
+
+    /**
+     * Earliest time when the specified amount can be consumed, assuming nothing else is consumed until then.
+     * Returns the maximum time value if the amount exceeds the burst size.
+     */
+    MonotonicTime getAvailabilityTime(uint32_t amount) const;
+};
+
+}
+
+#endif // UAVCAN_TRANSPORT_TOKEN_BUCKET_HPP_INCLUDED
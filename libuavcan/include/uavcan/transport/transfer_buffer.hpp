@@ -35,6 +35,12 @@ public:
     virtual int read(unsigned offset, uint8_t* data, unsigned len) const;
     virtual int write(unsigned offset, const uint8_t* data, unsigned len);
 
+    virtual const uint8_t* getContiguousData(unsigned& out_len) const
+    {
+        out_len = max_write_pos_;
+        return data_;
+    }
+
     void reset();
 
     uint16_t getSize() const { return size_; }
@@ -86,6 +92,11 @@ public:
 
     bool isEmpty() const { return !node_id_.isValid(); }
 
+    /**
+     * Node ID is unique for the given transfer type, so it makes a perfect hash.
+     */
+    unsigned getHash() const { return node_id_.get(); }
+
     NodeID getNodeID() const { return node_id_; }
     TransferType getTransferType() const { return TransferType(transfer_type_); }
 
@@ -98,6 +109,10 @@ public:
  * Resizable gather/scatter storage.
  * reset() call releases all memory blocks.
  * Supports unordered write operations - from higher to lower offsets
+ *
+ * If the allocator is able to provide a single contiguous span of max_size bytes (e.g. a size-classed allocator),
+ * the data will be stored there, so that read() and write() become plain copies and the raw data can be accessed
+ * directly via getContiguousData(). Otherwise the data is stored in a chain of pool blocks.
  */
 class UAVCAN_EXPORT TransferBufferManagerEntry : public ITransferBuffer
                                                , public LinkedListNode<TransferBufferManagerEntry>
@@ -118,13 +133,31 @@ class UAVCAN_EXPORT TransferBufferManagerEntry : public ITransferBuffer
 
     IPoolAllocator& allocator_;
     LinkedListRoot<Block> blocks_;    // Blocks are ordered from lower to higher buffer offset
+    uint8_t* contiguous_data_;        // If not null, blocks_ is not used
+    Block* cursor_block_;             // Last written block, allows to append data without walking the whole chain
+    uint16_t cursor_block_offset_;    // Buffer offset of the first byte of cursor_block_
     uint16_t max_write_pos_;
     const uint16_t max_size_;
     TransferBufferManagerKey key_;
 
+    void tryAllocateContiguous();
+
 public:
+    /**
+     * Number of pool blocks needed to buffer a transfer of the specified size with the block chain,
+     * including the block of the entry itself.
+     */
+    template <unsigned Size>
+    struct NumBlocksForSize
+    {
+        enum { Result = 1 + (Size + unsigned(Block::Size) - 1U) / unsigned(Block::Size) };
+    };
+
     TransferBufferManagerEntry(IPoolAllocator& allocator, uint16_t max_size) :
         allocator_(allocator),
+        contiguous_data_(NULL),
+        cursor_block_(NULL),
+        cursor_block_offset_(0),
         max_write_pos_(0),
         max_size_(max_size)
     {
@@ -143,55 +176,180 @@ public:
 
     void reset(const TransferBufferManagerKey& key = TransferBufferManagerKey());
 
+    /**
+     * The allocator this entry and its blocks were allocated from.
+     */
+    IPoolAllocator& getAllocator() const { return allocator_; }
+
+    /**
+     * Returns a pointer to the buffered data if it is stored in one contiguous span; otherwise returns null.
+     * The number of valid bytes is the same as returned by read() from zero offset, i.e. getMaxWritePos().
+     */
+    const uint8_t* getContiguousData() const { return contiguous_data_; }
+
+    virtual const uint8_t* getContiguousData(unsigned& out_len) const
+    {
+        out_len = (contiguous_data_ == NULL) ? 0U : max_write_pos_;
+        return contiguous_data_;
+    }
+
+    uint16_t getMaxWritePos() const { return max_write_pos_; }
+
     const TransferBufferManagerKey& getKey() const { return key_; }
     bool isEmpty() const { return key_.isEmpty(); }
 };
 
+class TransferListener;
+
+/**
+ * Releases reception memory when the pool is exhausted; this is implemented by the dispatcher,
+ * which evicts the least recently active transfer receiver of all listeners.
+ */
+class UAVCAN_EXPORT IRxMemoryReclaimer
+{
+public:
+    virtual ~IRxMemoryReclaimer() { }
+
+    /**
+     * The receiver (and the buffer) of the requesting listener with the specified key must not be evicted,
+     * because it is being used. Returns true if some memory has been released, so the allocation can be retried.
+     */
+    virtual bool reclaimRxMemory(const TransferListener& requester, const TransferBufferManagerKey& protected_key) = 0;
+};
+
 /**
  * Buffer manager implementation.
  */
 class TransferBufferManager : public Noncopyable
 {
     LinkedListRoot<TransferBufferManagerEntry> buffers_;
+#if UAVCAN_POOL_USAGE_TRACKING
+    TaggedPoolAllocator allocator_;
+#else
     IPoolAllocator& allocator_;
+#endif
+    IRxMemoryReclaimer* reclaimer_;
+    const TransferListener* owner_;
+    IPoolAllocator* allocator_override_;
     const uint16_t max_buf_size_;
 
+    IPoolAllocator& getAllocator()
+    {
+        return (allocator_override_ != NULL) ? *allocator_override_ : static_cast<IPoolAllocator&>(allocator_);
+    }
+
     TransferBufferManagerEntry* findFirst(const TransferBufferManagerKey& key);
 
 public:
     TransferBufferManager(uint16_t max_buf_size, IPoolAllocator& allocator) :
-        allocator_(allocator),
+#if UAVCAN_POOL_USAGE_TRACKING
+        allocator_(allocator, PoolUsageTagTransferBuffers),
+#else
+        allocator_(allocator.getPartition(PoolUsageTagTransferBuffers)),
+#endif
+        reclaimer_(NULL),
+        owner_(NULL),
+        allocator_override_(NULL),
         max_buf_size_(max_buf_size)
     { }
 
     ~TransferBufferManager();
 
-    ITransferBuffer* access(const TransferBufferManagerKey& key);
-    ITransferBuffer* create(const TransferBufferManagerKey& key);
+    /**
+     * If a new buffer can't be allocated, the reclaimer is asked to release some memory on behalf of the owner,
+     * and the allocation is retried once. Null pointer disables this, which is the default.
+     */
+    void setMemoryReclaimer(IRxMemoryReclaimer* reclaimer, const TransferListener* owner)
+    {
+        reclaimer_ = reclaimer;
+        owner_ = owner;
+    }
+    IRxMemoryReclaimer* getMemoryReclaimer() const { return reclaimer_; }
+
+    /**
+     * New buffers are allocated from the specified allocator instead of the one passed to the constructor; null
+     * pointer restores the latter. The existing buffers are released to the allocator they were allocated from.
+     * See @ref ReassemblyTable.
+     */
+    void setAllocatorOverride(IPoolAllocator* allocator) { allocator_override_ = allocator; }
+
+    uint16_t getMaxBufferSize() const { return max_buf_size_; }
+
+    TransferBufferManagerEntry* access(const TransferBufferManagerKey& key);
+    TransferBufferManagerEntry* create(const TransferBufferManagerKey& key);
     void remove(const TransferBufferManagerKey& key);
     bool isEmpty() const;
 
     unsigned getNumBuffers() const;
 };
 
+/**
+ * Takes the payload of a transfer in place of a buffer, for the listeners that process the payload as it arrives
+ * instead of storing it; see @ref StreamingTransferListener.
+ * The payload is written at increasing offsets; discard() is called when the transfer is abandoned, and also
+ * whenever the receiver drops the buffer while there's nothing to drop, so it must be harmless then.
+ */
+class UAVCAN_EXPORT ITransferStream : public ITransferBuffer
+{
+public:
+    virtual void discard() = 0;
+};
+
 /**
  * Convinience class.
  */
 class UAVCAN_EXPORT TransferBufferAccessor
 {
-    TransferBufferManager& bufmgr_;
+    TransferBufferManager* const bufmgr_;
+    ITransferStream* const stream_;
     const TransferBufferManagerKey key_;
 
 public:
     TransferBufferAccessor(TransferBufferManager& bufmgr, TransferBufferManagerKey key) :
-        bufmgr_(bufmgr),
+        bufmgr_(&bufmgr),
+        stream_(NULL),
         key_(key)
     {
         UAVCAN_ASSERT(!key.isEmpty());
     }
-    ITransferBuffer* access() { return bufmgr_.access(key_); }
-    ITransferBuffer* create() { return bufmgr_.create(key_); }
-    void remove() { bufmgr_.remove(key_); }
+
+    /**
+     * The payload will be written into the stream, which is always available; nothing will be buffered.
+     */
+    explicit TransferBufferAccessor(ITransferStream& stream) :
+        bufmgr_(NULL),
+        stream_(&stream)
+    { }
+
+    ITransferBuffer* access()
+    {
+        if (stream_ != NULL)
+        {
+            return stream_;
+        }
+        return bufmgr_->access(key_);
+    }
+
+    ITransferBuffer* create()
+    {
+        if (stream_ != NULL)
+        {
+            return stream_;
+        }
+        return bufmgr_->create(key_);
+    }
+
+    void remove()
+    {
+        if (stream_ != NULL)
+        {
+            stream_->discard();
+        }
+        else
+        {
+            bufmgr_->remove(key_);
+        }
+    }
 };
 
 }
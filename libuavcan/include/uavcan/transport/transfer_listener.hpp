@@ -9,9 +9,10 @@
 #include <uavcan/error.hpp>
 #include <uavcan/std.hpp>
 #include <uavcan/transport/transfer_receiver.hpp>
+#include <uavcan/transport/reassembly_table.hpp>
 #include <uavcan/transport/perf_counter.hpp>
 #include <uavcan/util/linked_list.hpp>
-#include <uavcan/util/map.hpp>
+#include <uavcan/util/hash_map.hpp>
 #include <uavcan/debug.hpp>
 #include <uavcan/transport/crc.hpp>
 #include <uavcan/data_type.hpp>
@@ -77,6 +78,7 @@ class UAVCAN_EXPORT SingleFrameIncomingTransfer : public IncomingTransfer
 public:
     explicit SingleFrameIncomingTransfer(const RxFrame& frm);
     virtual int read(unsigned offset, uint8_t* data, unsigned len) const;
+    virtual const uint8_t* getContiguousData(unsigned& out_len) const;
     virtual bool isAnonymousTransfer() const;
 };
 
@@ -90,41 +92,163 @@ public:
     MultiFrameIncomingTransfer(MonotonicTime ts_mono, UtcTime ts_utc, const RxFrame& last_frame,
                                TransferBufferAccessor& tba);
     virtual int read(unsigned offset, uint8_t* data, unsigned len) const;
+    virtual const uint8_t* getContiguousData(unsigned& out_len) const;
     virtual void release() { buf_acc_.remove(); }
 };
 
+/**
+ * Internal; the payload of a transfer delivered by @ref LocalTransferBus, which has never been split into frames.
+ * The payload is owned by the sender.
+ */
+class UAVCAN_EXPORT LocalIncomingTransfer : public IncomingTransfer
+{
+    const uint8_t* const payload_;
+    const uint16_t payload_len_;
+public:
+    LocalIncomingTransfer(MonotonicTime ts_mono, UtcTime ts_utc, TransferPriority transfer_priority,
+                          TransferID transfer_id, NodeID src_node_id, const uint8_t* payload, unsigned payload_len);
+    virtual int read(unsigned offset, uint8_t* data, unsigned len) const;
+    virtual const uint8_t* getContiguousData(unsigned& out_len) const;
+};
+
+/**
+ * One piece of a transfer received by @ref StreamingTransferListener: the payload of one frame, placed at the
+ * specified offset in the transfer payload. The timestamps are those of the transfer, i.e. of its first frame.
+ * read() and getContiguousData() address the chunk, not the whole transfer.
+ */
+class UAVCAN_EXPORT IncomingTransferChunk : public IncomingTransfer
+{
+    const uint8_t* const data_;
+    const uint8_t len_;
+    const uint16_t offset_;
+    const bool anonymous_;
+
+public:
+    IncomingTransferChunk(MonotonicTime ts_mono, UtcTime ts_utc, const RxFrame& frame,
+                          unsigned offset, const uint8_t* data, unsigned len);
+
+    /**
+     * Makes a chunk of a transfer whose payload is available at once, e.g. of a single frame transfer.
+     */
+    IncomingTransferChunk(const IncomingTransfer& transfer, const uint8_t* data, unsigned len, unsigned offset = 0);
+
+    virtual int read(unsigned offset, uint8_t* data, unsigned len) const;
+    virtual const uint8_t* getContiguousData(unsigned& out_len) const;
+    virtual bool isAnonymousTransfer() const { return anonymous_; }
+
+    unsigned getOffset() const { return offset_; }
+    unsigned getLength() const { return len_; }
+};
+
 /**
  * Internal, refer to the transport dispatcher class.
  */
 class UAVCAN_EXPORT TransferListener : public LinkedListNode<TransferListener>, Noncopyable
 {
+    friend class ReassemblyTable;
+
     const DataTypeDescriptor& data_type_;
     TransferBufferManager bufmgr_;
-    Map<TransferBufferManagerKey, TransferReceiver> receivers_;
+    HashMap<TransferBufferManagerKey, TransferReceiver, TransferListenerNumReceiverBuckets> receivers_;
+    ReassemblyTable* reassembly_table_;     ///< If set, the receivers are stored there instead of receivers_
     TransferPerfCounter& perf_;
     const TransferCRC crc_base_;                      ///< Pre-initialized with data type hash, thus constant
+    TransferDecimation decimation_;
+    uint32_t num_skipped_transfers_;
     bool allow_anonymous_transfers_;
 
     class TimedOutReceiverPredicate
     {
         const MonotonicTime ts_;
-        TransferBufferManager& parent_bufmgr_;
+        TransferListener& owner_;
 
     public:
-        TimedOutReceiverPredicate(MonotonicTime arg_ts, TransferBufferManager& arg_bufmgr)
+        TimedOutReceiverPredicate(MonotonicTime arg_ts, TransferListener& arg_owner)
             : ts_(arg_ts)
-            , parent_bufmgr_(arg_bufmgr)
+            , owner_(arg_owner)
         { }
 
         bool operator()(const TransferBufferManagerKey& key, const TransferReceiver& value) const;
     };
 
-    bool checkPayloadCrc(const uint16_t compare_with, const ITransferBuffer& tbb) const;
+    class ReleasingPredicate
+    {
+        TransferListener& owner_;
+
+    public:
+        explicit ReleasingPredicate(TransferListener& arg_owner) : owner_(arg_owner) { }
+
+        bool operator()(const TransferBufferManagerKey& key, const TransferReceiver& value) const
+        {
+            owner_.releaseReceiverState(key, value);
+            return true;
+        }
+    };
+
+    class LeastRecentlyActiveReceiverFinder
+    {
+        const TransferBufferManagerKey& excluded_key_;
+        TransferBufferManagerKey& inout_key_;
+        MonotonicTime& inout_ts_;
+
+    public:
+        LeastRecentlyActiveReceiverFinder(const TransferBufferManagerKey& excluded_key,
+                                          TransferBufferManagerKey& inout_key, MonotonicTime& inout_ts)
+            : excluded_key_(excluded_key)
+            , inout_key_(inout_key)
+            , inout_ts_(inout_ts)
+        { }
+
+        bool operator()(const TransferBufferManagerKey& key, const TransferReceiver& value) const;
+    };
+
+    TransferReceiver* insertReceiver(const TransferBufferManagerKey& key, const TransferReceiver& receiver);
 
 protected:
+    /**
+     * Returns the receiver for the source of the frame, creating it if this is the first frame of a transfer;
+     * null if there's none or if it can't be created. The frame must be from a unicast source.
+     */
+    TransferReceiver* findOrCreateReceiver(const RxFrame& frame);
+
+    /**
+     * Feeds the frame to the receiver and updates the counters; the caller handles the result.
+     */
+    TransferReceiver::ResultCode receiveFrame(TransferReceiver& receiver, const RxFrame& frame,
+                                              TransferBufferAccessor& tba);
+
     void handleReception(TransferReceiver& receiver, const RxFrame& frame, TransferBufferAccessor& tba);
     void handleAnonymousTransferReception(const RxFrame& frame);
 
+    /**
+     * Invoked when the receiver is about to be destroyed by the cleanup or evicted, in order to release the
+     * state of the transfer it has been receiving. The default implementation removes the buffer.
+     */
+    virtual void releaseReceiverState(const TransferBufferManagerKey& key, const TransferReceiver& receiver);
+
+    TransferBufferManager& getBufferManager() { return bufmgr_; }
+    TransferPerfCounter& getPerfCounter() { return perf_; }
+
+    /**
+     * Records a transfer event, or the failure to allocate the receiver for the source of the frame.
+     * See @ref EventTrace.
+     */
+    void traceTransferEvent(TraceEvent event, const RxFrame& frame)
+    {
+        perf_.traceEvent(event, frame.getMonotonicTimestamp(), frame.getTransferID().get(),
+                         frame.getDataTypeID().get(), frame.getSrcNodeID().get());
+    }
+    void traceReceiverAllocationFailure(const RxFrame& frame)
+    {
+        perf_.traceEvent(TraceEventOutOfMemory, frame.getMonotonicTimestamp(), 0, frame.getDataTypeID().get(),
+                         uint8_t(PoolUsageTagTransferReceivers));
+    }
+
+    /**
+     * Asks the memory reclaimer, if any, to release some memory; the receiver with the specified key remains.
+     */
+    bool reclaimRxMemory(const TransferBufferManagerKey& key);
+
     virtual void handleIncomingTransfer(IncomingTransfer& transfer) = 0;
 
 public:
@@ -132,9 +256,11 @@ public:
                      uint16_t max_buffer_size, IPoolAllocator& allocator)
         : data_type_(data_type)
         , bufmgr_(max_buffer_size, allocator)
-        , receivers_(allocator)
+        , receivers_(allocator, PoolUsageTagTransferReceivers)
+        , reassembly_table_(NULL)
         , perf_(perf)
         , crc_base_(data_type.getSignature().toTransferCRC())
+        , num_skipped_transfers_(0)
         , allow_anonymous_transfers_(false)
     { }
 
@@ -148,9 +274,264 @@ public:
      */
     void allowAnonymousTransfers() { allow_anonymous_transfers_ = true; }
 
-    void cleanup(MonotonicTime ts);
+    /**
+     * Delivers only a subset of the transfers from every source node, e.g. for consumers that need a lower rate
+     * than the publishers provide. Skipped transfers are rejected on their first frame, before the buffer is
+     * allocated; their remaining frames only advance the receiver state, so the cost is negligible.
+     * Anonymous transfers are not affected.
+     *
+     * @param factor        Deliver every Nth transfer; 1 means no decimation by count.
+     * @param min_interval  Deliver at most one transfer per this interval (up to 65 seconds); zero means no limit.
+     *                      The interval is measured between the RX timestamps of the first frames.
+     */
+    void setDecimation(uint8_t factor, MonotonicDuration min_interval = MonotonicDuration());
+
+    /**
+     * In the on-change mode, a transfer whose payload is the same as of the last delivered transfer from the
+     * same source node is skipped; this is detected by the transfer CRC, which for single frame transfers is
+     * computed over the payload. This is useful for the status topics that repeat identical payloads.
+     * Can be combined with @ref setDecimation(); skipped transfers are counted the same way.
+     *
+     * @param heartbeat     An unchanged payload is still delivered once per this interval (up to 65 seconds);
+     *                      zero means never.
+     */
+    void setOnChangeMode(bool enabled, MonotonicDuration heartbeat = MonotonicDuration());
+
+    const TransferDecimation& getDecimation() const { return decimation_; }
+
+    /**
+     * Number of transfers that were skipped by the decimation.
+     */
+    uint32_t getNumSkippedTransfers() const { return num_skipped_transfers_; }
+
+    virtual void cleanup(MonotonicTime ts);
+
+    virtual void handleFrame(const RxFrame& frame);
+
+    /**
+     * Takes a broadcast message delivered by @ref LocalTransferBus, bypassing the transfer receivers.
+     * Transfers that are longer than the maximum buffer size are dropped, like the ones received from the bus;
+     * the decimation and the on-change mode don't apply.
+     */
+    virtual void handleLocalTransfer(IncomingTransfer& transfer);
+
+    /**
+     * When the pool is exhausted, the reclaimer is asked to evict some receivers in order to make room for the
+     * new ones; normally this is the dispatcher, which installs itself upon registration of the listener.
+     */
+    void setMemoryReclaimer(IRxMemoryReclaimer* reclaimer) { bufmgr_.setMemoryReclaimer(reclaimer, this); }
+
+    /**
+     * With the table set, the receivers are stored in the table, and the buffers are allocated from its quota;
+     * null pointer restores the own receiver container. The receivers of the previous storage are released,
+     * i.e. the transfers in progress are lost. Normally this is done by the dispatcher upon registration, see
+     * @ref Dispatcher::installReassemblyTable().
+     */
+    void setReassemblyTable(ReassemblyTable* table);
+    ReassemblyTable* getReassemblyTable() const { return reassembly_table_; }
+
+    /**
+     * If this listener has a receiver that was active earlier than inout_ts, not counting the receiver with
+     * the excluded key (may be empty), stores its key and activity timestamp and returns true.
+     */
+    virtual bool findLeastRecentlyActiveReceiver(const TransferBufferManagerKey& excluded_key,
+                                                 TransferBufferManagerKey& inout_key, MonotonicTime& inout_ts) const;
+
+    /**
+     * Destroys the receiver and its buffer; the state of the transfers from this source is lost.
+     */
+    virtual void evictReceiver(const TransferBufferManagerKey& key);
+};
+
+/**
+ * This transfer listener finds receivers of broadcast messages by direct indexing with the source node ID,
+ * instead of searching the receiver container of the base class. It is intended for message types that are
+ * published at a high rate by many nodes, where the per-frame bookkeeping must be as cheap as possible.
+ *
+ * The index table is allocated from the memory pool lazily, in blocks that cover adjacent node ID ranges,
+ * so the memory is spent only on the parts of the node ID space that are actually in use.
+ * All other transfer types are handled by the base class as usual.
+ *
+ * This class can be passed to GenericSubscriber as the transfer listener type.
+ */
+class UAVCAN_EXPORT TransferListenerWithNodeIndex : public TransferListener
+{
+    struct SlotBlock
+    {
+        enum { NumSlots = MemPoolBlockSize / sizeof(TransferReceiver*) };
+        TransferReceiver* slots[NumSlots];
+
+        SlotBlock()
+        {
+            StaticAssert<(static_cast<unsigned>(NumSlots) > 0)>::check();
+            IsDynamicallyAllocatable<SlotBlock>::check();
+            fill_n(slots, unsigned(NumSlots), static_cast<TransferReceiver*>(NULL));
+        }
+
+        bool isEmpty() const;
+    };
+
+    enum { NumSlotBlocks = (NodeID::Max + SlotBlock::NumSlots) / SlotBlock::NumSlots };
+
+#if UAVCAN_POOL_USAGE_TRACKING
+    TaggedPoolAllocator allocator_;
+#else
+    IPoolAllocator& allocator_;
+#endif
+    SlotBlock* slot_blocks_[NumSlotBlocks];
+
+    TransferReceiver** accessSlot(NodeID node_id, bool create);
+
+    void destroyReceiver(TransferReceiver*& receiver, NodeID node_id);
+
+public:
+    TransferListenerWithNodeIndex(TransferPerfCounter& perf, const DataTypeDescriptor& data_type,
+                                  uint16_t max_buffer_size, IPoolAllocator& allocator)
+        : TransferListener(perf, data_type, max_buffer_size, allocator)
+#if UAVCAN_POOL_USAGE_TRACKING
+        , allocator_(allocator, PoolUsageTagTransferReceivers)
+#else
+        , allocator_(allocator.getPartition(PoolUsageTagTransferReceivers))
+#endif
+    {
+        IsDynamicallyAllocatable<TransferReceiver>::check();
+        fill_n(slot_blocks_, unsigned(NumSlotBlocks), static_cast<SlotBlock*>(NULL));
+    }
+
+    virtual ~TransferListenerWithNodeIndex();
+
+    virtual void cleanup(MonotonicTime ts);
 
     virtual void handleFrame(const RxFrame& frame);
+
+    virtual bool findLeastRecentlyActiveReceiver(const TransferBufferManagerKey& excluded_key,
+                                                 TransferBufferManagerKey& inout_key, MonotonicTime& inout_ts) const;
+
+    virtual void evictReceiver(const TransferBufferManagerKey& key);
+};
+
+/**
+ * This transfer listener hands the payload of multi-frame transfers to the subclass frame by frame, as the frames
+ * arrive, instead of buffering the whole transfer; the transfer CRC is verified when the last frame is received.
+ * Thus, the memory needed is that of the receivers only, regardless of the transfer length, and the payload can be
+ * processed (e.g. written into a file) while the rest of the transfer is still on the bus.
+ *
+ * For every transfer, handleTransferChunk() is called for each frame with a non-empty payload, at increasing
+ * offsets, starting from zero. After the first chunk of a transfer, either handleTransferCompletion() or
+ * handleTransferAbort() is called exactly once, unless the listener is destroyed first. A transfer is aborted if its
+ * CRC doesn't match, if it's interrupted by a newer transfer or times out, if the receiver is evicted,
+ * or if handleTransferChunk() returns false. Single frame transfers are reported as one chunk and a completion.
+ * The callbacks must not unregister or destroy the listener.
+ *
+ * This class should be derived by callers.
+ */
+class UAVCAN_EXPORT StreamingTransferListener : public TransferListener
+{
+    class ChunkForwarder : public ITransferStream
+    {
+        StreamingTransferListener& owner_;
+        const TransferReceiver& receiver_;
+        const RxFrame& frame_;
+        bool open_;
+
+    public:
+        ChunkForwarder(StreamingTransferListener& owner, const TransferReceiver& receiver, const RxFrame& frame)
+            : owner_(owner)
+            , receiver_(receiver)
+            , frame_(frame)
+            , open_(receiver.isMidTransfer())
+        { }
+
+        virtual int read(unsigned, uint8_t*, unsigned) const { return -ErrLogic; }     // Nothing is stored
+        virtual int write(unsigned offset, const uint8_t* data, unsigned len);
+        virtual void discard();
+    };
+
+    const uint16_t max_transfer_size_;
+
+    virtual void handleIncomingTransfer(IncomingTransfer& transfer);
+
+protected:
+    /**
+     * Returning false aborts the transfer.
+     */
+    virtual bool handleTransferChunk(const IncomingTransferChunk& chunk) = 0;
+
+    virtual void handleTransferCompletion(NodeID src_node_id, TransferType transfer_type) = 0;
+
+    virtual void handleTransferAbort(NodeID src_node_id, TransferType transfer_type) = 0;
+
+    virtual void releaseReceiverState(const TransferBufferManagerKey& key, const TransferReceiver& receiver);
+
+public:
+    /**
+     * @param max_transfer_size     Transfers with longer payload are aborted.
+     */
+    StreamingTransferListener(TransferPerfCounter& perf, const DataTypeDescriptor& data_type,
+                              uint16_t max_transfer_size, IPoolAllocator& allocator)
+        : TransferListener(perf, data_type, 0, allocator)
+        , max_transfer_size_(max_transfer_size)
+    { }
+
+    virtual void handleFrame(const RxFrame& frame);
+
+    virtual void handleLocalTransfer(IncomingTransfer& transfer);
+
+    uint16_t getMaxTransferSize() const { return max_transfer_size_; }
+};
+
+/**
+ * Memory of @ref TransferListenerWithReservedSlots; this is a base class in order to be constructed before the
+ * listener that uses it.
+ */
+template <uint16_t NumBlocks>
+class UAVCAN_EXPORT TransferListenerReservedMemory : Noncopyable
+{
+protected:
+    ReservedPoolAllocator<NumBlocks> reserved_allocator_;
+
+    explicit TransferListenerReservedMemory(IPoolAllocator& fallback)
+        : reserved_allocator_(fallback)
+    { }
+
+public:
+    const ReservedPoolAllocator<NumBlocks>& getReservedAllocator() const { return reserved_allocator_; }
+};
+
+/**
+ * This transfer listener receives the transfers from up to NumSlots source nodes at once without touching the shared
+ * memory pool: the receiver states and the reassembly buffers of up to MaxTransferSize bytes are allocated from
+ * the memory reserved inside the listener object. The allocation of the reserved memory takes constant time and
+ * never fails, which makes the reception latency deterministic for the critical data types. Further sources, if any,
+ * are served from the shared pool as usual.
+ *
+ * The reservation is sized for the receivers and the block chain buffers of the base listener; the index blocks of
+ * @ref TransferListenerWithNodeIndex, if used as the base, come from the shared pool.
+ *
+ * This class can be passed to @ref Subscriber and @ref ServiceServer as the transfer listener type, e.g.:
+ *   typedef uavcan::TransferListenerWithReservedSlots<2, uavcan::BitLenToByteLen<Foo::MaxBitLen>::Result> Listener;
+ *   uavcan::Subscriber<Foo, Callback, Listener> sub(node);
+ */
+template <unsigned NumSlots, unsigned MaxTransferSize, typename BaseListener = TransferListener>
+class UAVCAN_EXPORT TransferListenerWithReservedSlots
+    : public TransferListenerReservedMemory<uint16_t(NumSlots *
+                                                     (1U + TransferBufferManagerEntry::NumBlocksForSize<
+                                                        MaxTransferSize>::Result))>
+    , public BaseListener
+{
+    typedef TransferListenerReservedMemory<uint16_t(NumSlots *
+                                                    (1U + TransferBufferManagerEntry::NumBlocksForSize<
+                                                       MaxTransferSize>::Result))> MemoryType;
+
+public:
+    TransferListenerWithReservedSlots(TransferPerfCounter& perf, const DataTypeDescriptor& data_type,
+                                      uint16_t max_buffer_size, IPoolAllocator& allocator)
+        : MemoryType(allocator)
+        , BaseListener(perf, data_type, max_buffer_size, MemoryType::reserved_allocator_)
+    {
+        StaticAssert<(NumSlots > 0)>::check();
+        UAVCAN_ASSERT(max_buffer_size <= MaxTransferSize);
+    }
 };
 
 /**
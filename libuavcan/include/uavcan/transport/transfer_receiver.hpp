@@ -9,20 +9,49 @@
 #include <uavcan/build_config.hpp>
 #include <uavcan/transport/frame.hpp>
 #include <uavcan/transport/transfer_buffer.hpp>
+#include <uavcan/transport/crc.hpp>
 
 namespace uavcan
 {
+/**
+ * Receiver-side decimation settings, see @ref TransferListener::setDecimation() and
+ * @ref TransferListener::setOnChangeMode().
+ */
+struct UAVCAN_EXPORT TransferDecimation
+{
+    uint8_t factor;                 ///< Accept every Nth transfer; 0 or 1 - no decimation by count
+    uint16_t min_interval_msec;     ///< Accept at most one transfer per this interval; 0 - no limit
+    uint16_t heartbeat_msec;        ///< Accept an unchanged payload once per this interval; 0 - never
+    bool on_change;                 ///< Skip transfers whose payload is the same as of the last accepted one
+
+    TransferDecimation()
+        : factor(1)
+        , min_interval_msec(0)
+        , heartbeat_msec(0)
+        , on_change(false)
+    { }
+
+    bool isEnabled() const { return (factor > 1) || (min_interval_msec > 0) || on_change; }
+};
 
 class UAVCAN_EXPORT TransferReceiver
 {
 public:
-    enum ResultCode { ResultNotComplete, ResultComplete, ResultSingleFrame };
+    /**
+     * ResultSkipped is returned on the last frame of a transfer that was rejected by the decimation;
+     * such transfers are tracked only to keep the receiver in sync, their payload is not stored.
+     * Transfers that were rejected because the payload didn't change are reported the same way.
+     */
+    enum ResultCode { ResultNotComplete, ResultComplete, ResultSingleFrame, ResultSkipped };
 
     static const uint16_t MinTransferIntervalMSec     = 1;
     static const uint16_t MaxTransferIntervalMSec     = 0xFFFF;
     static const uint16_t DefaultTransferIntervalMSec = 1000;
     static const uint16_t DefaultTidTimeoutMSec       = 1000;
 
+    static const uint16_t MinReleaseTimeoutMSec       = 100;
+    static const uint8_t ReleaseTimeoutIntervals      = 4;
+
     static MonotonicDuration getDefaultTransferInterval()
     {
         return MonotonicDuration::fromMSec(DefaultTransferIntervalMSec);
@@ -36,11 +65,23 @@ private:
     enum { ErrorCntMask = 31 };
     enum { IfaceIndexMask = MaxCanIfaces };
 
-    MonotonicTime prev_transfer_ts_;
-    MonotonicTime this_transfer_ts_;
-    UtcTime first_frame_ts_;
+    /// Age of the previous transfer larger than this is not tracked; it only matters for the interval estimation
+    static const uint32_t MaxPrevTransferAgeUSec = 0xFFFFFFFEU;
+    static const uint32_t PrevTransferAgeUnknown = 0xFFFFFFFFU;
+
+    /*
+     * The timestamps are stored as 32-bit halves rather than as 64-bit values, because the latter would make the
+     * alignment of the whole object 8 bytes, wasting the pool memory on padding. The timestamp of the previous
+     * transfer is stored relative to the current one, which is the only absolute monotonic timestamp here.
+     */
+    uint32_t this_transfer_ts_lo_;
+    uint32_t this_transfer_ts_hi_;
+    uint32_t first_frame_ts_lo_;
+    uint32_t first_frame_ts_hi_;
+    uint32_t prev_transfer_age_usec_;   ///< this_transfer_ts - prev_transfer_ts, or PrevTransferAgeUnknown
     uint16_t transfer_interval_msec_;
     uint16_t this_transfer_crc_;
+    TransferCRC computed_crc_;      ///< Updated as the payload is written, so the buffer doesn't need to be re-read
 
     uint16_t buffer_write_pos_;
 
@@ -51,9 +92,26 @@ private:
     uint8_t iface_index_        : 2;
     mutable uint8_t error_cnt_  : 5;
 
+    // Decimation state; these fields fit into the padding at the end of the object.
+    uint16_t accepted_ts_msec_;     ///< Low 16 bits of the timestamp of the last accepted transfer, in milliseconds
+    uint16_t accepted_crc_;         ///< Payload CRC of the last accepted transfer, for the on-change mode
+    uint8_t num_skipped_;           ///< Number of transfers skipped since the last accepted one
+    uint8_t skipping_           : 1;
+    uint8_t accepted_once_      : 1;
+
     bool isInitialized() const { return iface_index_ != IfaceIndexNotSet; }
 
-    bool isMidTransfer() const { return buffer_write_pos_ > 0; }
+    MonotonicTime getThisTransferTimestamp() const
+    {
+        return MonotonicTime::fromUSec((uint64_t(this_transfer_ts_hi_) << 32) | this_transfer_ts_lo_);
+    }
+    void setThisTransferTimestamp(MonotonicTime ts);
+
+    void setFirstFrameTimestamp(UtcTime ts)
+    {
+        first_frame_ts_lo_ = uint32_t(ts.toUSec() & 0xFFFFFFFFU);
+        first_frame_ts_hi_ = uint32_t(ts.toUSec() >> 32);
+    }
 
     MonotonicDuration getIfaceSwitchDelay() const;
     MonotonicDuration getTidTimeout() const;
@@ -64,30 +122,88 @@ private:
     void prepareForNextTransfer();
 
     bool validate(const RxFrame& frame) const;
-    bool writePayload(const RxFrame& frame, ITransferBuffer& buf);
-    ResultCode receive(const RxFrame& frame, TransferBufferAccessor& tba);
+    bool acceptTransfer(const TransferDecimation& decimation, MonotonicTime ts);
+    bool commitTransfer(const TransferDecimation& decimation, uint16_t payload_crc, bool valid);
+    bool writePayload(const RxFrame& frame, ITransferBuffer& buf, const TransferCRC& crc_base);
+    ResultCode receive(const RxFrame& frame, TransferBufferAccessor& tba, const TransferCRC& crc_base,
+                       const TransferDecimation& decimation);
 
 public:
     TransferReceiver() :
+        this_transfer_ts_lo_(0),
+        this_transfer_ts_hi_(0),
+        first_frame_ts_lo_(0),
+        first_frame_ts_hi_(0),
+        prev_transfer_age_usec_(PrevTransferAgeUnknown),
         transfer_interval_msec_(DefaultTransferIntervalMSec),
         this_transfer_crc_(0),
         buffer_write_pos_(0),
         next_toggle_(false),
         iface_index_(IfaceIndexNotSet),
-        error_cnt_(0)
+        error_cnt_(0),
+        accepted_ts_msec_(0),
+        accepted_crc_(0),
+        num_skipped_(0),
+        skipping_(false),
+        accepted_once_(false)
     { }
 
     bool isTimedOut(MonotonicTime current_ts) const;
 
-    ResultCode addFrame(const RxFrame& frame, TransferBufferAccessor& tba);
+    /**
+     * Whether some payload of a multi-frame transfer has been received, but not the last frame.
+     */
+    bool isMidTransfer() const { return buffer_write_pos_ > 0; }
+
+    /**
+     * Whether the flow has been silent long enough for the receiver to be released by the cleanup.
+     * The timeout is derived from the measured transfer interval, see @ref getReleaseTimeout(), so the memory of
+     * the departed nodes is reclaimed soon after they've stopped transmitting. A receiver that is in the middle of
+     * a multi-frame transfer is released only upon the transfer ID timeout.
+     * A released flow starts over with the next transfer, as if it was new; the only state that is lost is
+     * the transfer ID, which doesn't matter after several intervals of silence, and the decimation state.
+     */
+    bool isExpired(MonotonicTime current_ts) const;
+
+    /**
+     * @ref ReleaseTimeoutIntervals transfer intervals, limited to the range from @ref MinReleaseTimeoutMSec to
+     * the transfer ID timeout. Until the interval is measured, this equals the transfer ID timeout.
+     */
+    MonotonicDuration getReleaseTimeout() const;
+
+    /**
+     * @param crc_base      Initial value of the transfer CRC, i.e. the CRC pre-initialized with the data type
+     *                      signature.
+     * @param decimation    The decision is made on the first frame of every transfer, before the buffer is
+     *                      allocated; the interval is measured with the timestamps of the first frames.
+     */
+    ResultCode addFrame(const RxFrame& frame, TransferBufferAccessor& tba, const TransferCRC& crc_base = TransferCRC(),
+                        const TransferDecimation& decimation = TransferDecimation());
 
     uint8_t yieldErrorCount();
 
-    MonotonicTime getLastTransferTimestampMonotonic() const { return prev_transfer_ts_; }
-    UtcTime getLastTransferTimestampUtc() const { return first_frame_ts_; }
+    MonotonicTime getLastTransferTimestampMonotonic() const;
 
+    /**
+     * Timestamp of the first frame of the latest transfer, complete or not; zero if there were none.
+     */
+    MonotonicTime getLastActivityTimestamp() const { return getThisTransferTimestamp(); }
+    UtcTime getLastTransferTimestampUtc() const
+    {
+        return UtcTime::fromUSec((uint64_t(first_frame_ts_hi_) << 32) | first_frame_ts_lo_);
+    }
+
+    /**
+     * The CRC value that was received with the last multi-frame transfer.
+     */
     uint16_t getLastTransferCrc() const { return this_transfer_crc_; }
 
+    /**
+     * The CRC value that was computed from the payload of the last multi-frame transfer.
+     * The transfer is valid if it matches getLastTransferCrc().
+     */
+    uint16_t getLastTransferComputedCrc() const { return computed_crc_.get(); }
+
     MonotonicDuration getInterval() const { return MonotonicDuration::fromMSec(transfer_interval_msec_); }
 };
 
@@ -12,10 +12,72 @@
 #include <uavcan/data_type.hpp>
 #include <uavcan/transport/crc.hpp>
 #include <uavcan/transport/transfer.hpp>
+#include <uavcan/transport/transfer_buffer.hpp>
 #include <uavcan/transport/dispatcher.hpp>
 
 namespace uavcan
 {
+/**
+ * Static buffer for the payload of an outgoing transfer.
+ *
+ * Two bytes of headroom are reserved in front of the payload, where the sender places the transfer CRC, so that
+ * the first frame of a multi-frame transfer can be filled right from the buffer without an intermediate copy.
+ *
+ * The CRC is updated while the payload is being written, so the sender doesn't need another pass over it.
+ * Every write() covers the bytes preceding its offset, since the bit stream never rewrites them; the CRC is not
+ * computed at all until the payload outgrows one CAN frame, so single frame transfers don't pay for it.
+ */
+class UAVCAN_EXPORT OutgoingTransferBufferImpl : public StaticTransferBufferImpl
+{
+    TransferCRC crc_base_;
+    TransferCRC crc_;
+    uint16_t crc_pos_;      ///< Number of payload bytes that were added to crc_
+
+    void updateCrc(unsigned end);
+
+public:
+    enum { HeadroomSize = 2 };
+
+    /**
+     * @param buf           Buffer of size buf_size + HeadroomSize
+     * @param buf_size      Max payload size
+     * @param crc_base      Initial CRC value of the data type, see @ref DataTypeSignature::toTransferCRC()
+     */
+    OutgoingTransferBufferImpl(uint8_t* buf, uint16_t buf_size, const TransferCRC& crc_base)
+        : StaticTransferBufferImpl(buf + HeadroomSize, buf_size)
+        , crc_base_(crc_base)
+        , crc_(crc_base)
+        , crc_pos_(0)
+    { }
+
+    virtual int write(unsigned offset, const uint8_t* data, unsigned len);
+
+    /**
+     * Discards the payload, so that the buffer can be reused for another transfer, possibly of a different type.
+     */
+    void reset(const TransferCRC& crc_base);
+
+    /**
+     * Transfer CRC of the data that has been written so far.
+     */
+    TransferCRC getTransferCRC();
+
+    /**
+     * Pointer to the headroom, which is immediately followed by the payload.
+     */
+    uint8_t* getHeadroomPtr() { return getRawPtr() - HeadroomSize; }
+};
+
+template <uint16_t Size>
+class UAVCAN_EXPORT OutgoingTransferBuffer : public OutgoingTransferBufferImpl
+{
+    uint8_t buffer_[Size + HeadroomSize];
+public:
+    explicit OutgoingTransferBuffer(const TransferCRC& crc_base)
+        : OutgoingTransferBufferImpl(buffer_, Size, crc_base)
+    { }
+};
+
 
 class UAVCAN_EXPORT TransferSender
 {
@@ -29,9 +91,23 @@ class UAVCAN_EXPORT TransferSender
     DataTypeID data_type_id_;
     CanIOFlags flags_;
     uint8_t iface_mask_;
+    mutable uint8_t last_iface_mask_;   ///< Selected by CanIOManager for the last transfer
     bool allow_anonymous_transfers_;
+    mutable OutgoingTransferRegistry::EntryCache broadcast_tid_cache_;  ///< The broadcast key never changes
+    mutable uint32_t can_id_template_;      ///< See Frame::makeCanIDTemplate()
+    mutable uint16_t can_id_template_key_;  ///< Priority, transfer type and source node ID of the template
+
+    enum { InvalidCanIDTemplateKey = 0xFFFF };
+
+    void registerError(TransferType transfer_type) const;
+
+    uint32_t getCanIDTemplate(TransferType transfer_type, NodeID src_node_id) const;
 
-    void registerError() const;
+    TransferID* accessTransferID(MonotonicTime tx_deadline, TransferType transfer_type, NodeID dst_node_id) const;
+
+    int sendImpl(const uint8_t* payload, unsigned payload_len, OutgoingTransferBufferImpl* buffer,
+                 MonotonicTime tx_deadline, MonotonicTime blocking_deadline, TransferType transfer_type,
+                 NodeID dst_node_id, TransferID tid) const;
 
 public:
     enum { AllIfacesMask = 0xFF };
@@ -49,7 +125,10 @@ public:
         , qos_(CanTxQueue::Qos())
         , flags_(CanIOFlags(0))
         , iface_mask_(AllIfacesMask)
+        , last_iface_mask_(AllIfacesMask)
         , allow_anonymous_transfers_(false)
+        , can_id_template_(0)
+        , can_id_template_key_(InvalidCanIDTemplateKey)
     {
         init(data_type, qos);
     }
@@ -61,13 +140,23 @@ public:
         , qos_(CanTxQueue::Qos())
         , flags_(CanIOFlags(0))
         , iface_mask_(AllIfacesMask)
+        , last_iface_mask_(AllIfacesMask)
         , allow_anonymous_transfers_(false)
+        , can_id_template_(0)
+        , can_id_template_key_(InvalidCanIDTemplateKey)
     { }
 
     void init(const DataTypeDescriptor& dtid, CanTxQueue::Qos qos);
 
     bool isInitialized() const { return data_type_id_ != DataTypeID(); }
 
+    DataTypeID getDataTypeID() const { return data_type_id_; }
+
+    /**
+     * Initial transfer CRC value of the data type; it is needed to construct @ref OutgoingTransferBuffer.
+     */
+    const TransferCRC& getCrcBase() const { return crc_base_; }
+
     CanIOFlags getCanIOFlags() const { return flags_; }
     void setCanIOFlags(CanIOFlags flags) { flags_ = flags; }
 
@@ -78,6 +167,12 @@ public:
         iface_mask_ = iface_mask;
     }
 
+    /**
+     * Interfaces the last transfer was sent to; this is a subset of the iface mask,
+     * see @ref CanIOManager::selectTxIfaces().
+     */
+    uint8_t getLastIfaceMask() const { return last_iface_mask_; }
+
     TransferPriority getPriority() const { return priority_; }
     void setPriority(TransferPriority prio) { priority_ = prio; }
 
@@ -90,6 +185,14 @@ public:
      */
     void allowAnonymousTransfers() { allow_anonymous_transfers_ = true; }
 
+    /**
+     * Takes the next Transfer ID from the OutgoingTransferRegistry, exactly like the send() overloads with
+     * automatic Transfer ID do. This allows to learn the Transfer ID before the transfer is sent with it.
+     * Returns negative error code on failure.
+     */
+    int takeTransferID(MonotonicTime tx_deadline, TransferType transfer_type, NodeID dst_node_id,
+                       TransferID& out_tid) const;
+
     /**
      * Send with explicit Transfer ID.
      * Should be used only for service responses, where response TID should match request TID.
@@ -108,6 +211,18 @@ public:
      */
     int send(const uint8_t* payload, unsigned payload_len, MonotonicTime tx_deadline,
              MonotonicTime blocking_deadline, TransferType transfer_type, NodeID dst_node_id) const;
+
+    /**
+     * Same as above, but the payload is taken from the buffer, which allows to avoid extra copying and
+     * CRC computation for multi-frame transfers. The buffer must be constructed with @ref getCrcBase().
+     * Note that the headroom of the buffer will be modified.
+     */
+    int send(OutgoingTransferBufferImpl& buffer, MonotonicTime tx_deadline,
+             MonotonicTime blocking_deadline, TransferType transfer_type, NodeID dst_node_id,
+             TransferID tid) const;
+
+    int send(OutgoingTransferBufferImpl& buffer, MonotonicTime tx_deadline,
+             MonotonicTime blocking_deadline, TransferType transfer_type, NodeID dst_node_id) const;
 };
 
 }
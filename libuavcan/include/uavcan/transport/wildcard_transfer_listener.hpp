@@ -0,0 +1,299 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_TRANSPORT_WILDCARD_TRANSFER_LISTENER_HPP_INCLUDED
+#define UAVCAN_TRANSPORT_WILDCARD_TRANSFER_LISTENER_HPP_INCLUDED
+
+#include <uavcan/std.hpp>
+#include <uavcan/build_config.hpp>
+#include <uavcan/data_type.hpp>
+#include <uavcan/transport/dispatcher.hpp>
+#include <uavcan/transport/transfer_listener.hpp>
+#include <uavcan/util/hash_map.hpp>
+#include <uavcan/util/linked_list.hpp>
+
+#if UAVCAN_TINY
+# error "This functionality is not available in tiny mode"
+#endif
+
+namespace uavcan
+{
+/**
+ * Selects the transfers received by @ref WildcardTransferListener. A transfer is accepted if its transfer type is
+ * in the mask, and its data type ID is within the range and matches the masked value.
+ * The default configuration accepts all transfers addressed to the local node, except anonymous ones.
+ */
+struct UAVCAN_EXPORT WildcardTransferFilter
+{
+    uint16_t data_type_id_min;      ///< Inclusive
+    uint16_t data_type_id_max;      ///< Inclusive
+    uint16_t data_type_id_mask;     ///< Accept the data type ID if (ID & mask) == value
+    uint16_t data_type_id_value;
+    uint8_t transfer_type_mask;     ///< Bit (1 << TransferType) is set for every accepted transfer type
+    bool promiscuous;               ///< Also accept the service transfers addressed to other nodes
+    bool anonymous;                 ///< Also accept anonymous messages
+
+    WildcardTransferFilter()
+        : data_type_id_min(0)
+        , data_type_id_max(0xFFFF)
+        , data_type_id_mask(0)
+        , data_type_id_value(0)
+        , transfer_type_mask((1U << NumTransferTypes) - 1U)
+        , promiscuous(false)
+        , anonymous(false)
+    { }
+
+    static uint8_t makeTransferTypeMask(TransferType transfer_type) { return uint8_t(1U << transfer_type); }
+
+    bool match(TransferType transfer_type, DataTypeID dtid) const
+    {
+        return ((transfer_type_mask & makeTransferTypeMask(transfer_type)) != 0) &&
+               (dtid.get() >= data_type_id_min) && (dtid.get() <= data_type_id_max) &&
+               ((dtid.get() & data_type_id_mask) == data_type_id_value);
+    }
+};
+
+/**
+ * This listener receives the transfers of many data types at once, e.g. for loggers, bus monitors and bridges,
+ * which would otherwise need a subscriber (and a transfer listener) per data type, or reassemble the transfers from
+ * the raw frames themselves. The transfers are selected with @ref WildcardTransferFilter. The reassembly state is
+ * shared by all data types: the receivers are created on demand per flow (data type, transfer type, source and
+ * destination node), stored in one container, and released by the dispatcher's cleanup like those of the regular
+ * listeners. The dispatcher doesn't evict these receivers when the memory pool is exhausted, though.
+ *
+ * The data type signatures, which are needed to verify the multi-frame transfers, are looked up in
+ * @ref GlobalDataTypeRegistry; when the registry is frozen, the results are cached. Single frame transfers of the
+ * data types that are not registered are delivered with a null descriptor; multi-frame transfers of such data types
+ * can't be verified, so they are dropped and counted, see @ref getNumUnknownDataTypeTransfers().
+ *
+ * The frames are delivered to this listener independently of the regular transfer listeners, the decimation
+ * and the acceptance filters configured by @ref CanAcceptanceFilterConfigurator, which are not aware of this
+ * listener; the configurator may need to be disabled for a full bus capture. Loopback frames are not delivered.
+ * The messages delivered by @ref LocalTransferBus are passed through as well.
+ *
+ * This class should be derived by callers.
+ */
+class UAVCAN_EXPORT WildcardTransferListener : public LinkedListNode<WildcardTransferListener>, Noncopyable
+{
+    class Key
+    {
+        uint16_t dtid_;
+        NodeID src_node_id_;
+        NodeID dst_node_id_;
+        uint8_t transfer_type_;
+
+    public:
+        Key()
+            : dtid_(0)
+            , transfer_type_(0)
+        { }
+
+        explicit Key(const RxFrame& frame)
+            : dtid_(frame.getDataTypeID().get())
+            , src_node_id_(frame.getSrcNodeID())
+            , dst_node_id_(frame.getDstNodeID())
+            , transfer_type_(uint8_t(frame.getTransferType()))
+        { }
+
+        bool operator==(const Key& rhs) const
+        {
+            return (dtid_ == rhs.dtid_) && (src_node_id_ == rhs.src_node_id_) &&
+                   (dst_node_id_ == rhs.dst_node_id_) && (transfer_type_ == rhs.transfer_type_);
+        }
+
+        unsigned getHash() const { return unsigned(src_node_id_.get()) ^ (unsigned(dtid_) << 1); }
+    };
+
+    /**
+     * The receiver doesn't own the buffer, same as in @ref TransferListener; the buffer is allocated
+     * with the first frame of a multi-frame transfer and destroyed when the transfer is delivered or abandoned.
+     */
+    struct Receiver
+    {
+        TransferReceiver receiver;
+        TransferBufferManagerEntry* buffer;
+
+        Receiver() : buffer(NULL) { }
+    };
+
+    class BufferAdapter : public ITransferStream
+    {
+        WildcardTransferListener& owner_;
+        TransferBufferManagerEntry*& buffer_;
+
+    public:
+        BufferAdapter(WildcardTransferListener& owner, TransferBufferManagerEntry*& buffer)
+            : owner_(owner)
+            , buffer_(buffer)
+        { }
+
+        virtual int read(unsigned offset, uint8_t* data, unsigned len) const;
+        virtual int write(unsigned offset, const uint8_t* data, unsigned len);
+        virtual const uint8_t* getContiguousData(unsigned& out_len) const;
+        virtual void discard();
+    };
+
+    class ExpiredReceiverPredicate
+    {
+        const MonotonicTime ts_;
+        WildcardTransferListener& owner_;
+
+    public:
+        ExpiredReceiverPredicate(MonotonicTime ts, WildcardTransferListener& owner)
+            : ts_(ts)
+            , owner_(owner)
+        { }
+
+        bool operator()(const Key&, const Receiver& value) const;
+    };
+
+    class ReleasingPredicate
+    {
+        WildcardTransferListener& owner_;
+
+    public:
+        explicit ReleasingPredicate(WildcardTransferListener& owner) : owner_(owner) { }
+
+        bool operator()(const Key&, const Receiver& value) const
+        {
+            TransferBufferManagerEntry* buffer = value.buffer;
+            owner_.destroyBuffer(buffer);
+            return true;
+        }
+    };
+
+    struct DataTypeCacheEntry
+    {
+        const DataTypeDescriptor* descriptor;
+        uint16_t dtid;
+        uint8_t kind;
+        bool valid;
+
+        DataTypeCacheEntry()
+            : descriptor(NULL)
+            , dtid(0)
+            , kind(0)
+            , valid(false)
+        { }
+    };
+
+    enum { DataTypeCacheSize = 16 };
+
+    Dispatcher& dispatcher_;
+    HashMap<Key, Receiver, TransferListenerNumReceiverBuckets> receivers_;
+#if UAVCAN_POOL_USAGE_TRACKING
+    TaggedPoolAllocator buffer_allocator_;
+#else
+    IPoolAllocator& buffer_allocator_;
+#endif
+    WildcardTransferFilter filter_;
+    DataTypeCacheEntry data_type_cache_[DataTypeCacheSize];
+    uint32_t num_transfers_;
+    uint32_t num_unknown_data_type_transfers_;
+    uint32_t num_errors_;
+    const uint16_t max_buffer_size_;
+
+    void destroyBuffer(TransferBufferManagerEntry*& buffer);
+
+    const DataTypeDescriptor* findDataType(DataTypeKind kind, DataTypeID dtid);
+
+    void deliver(IncomingTransfer& transfer, DataTypeID dtid, NodeID dst_node_id, const DataTypeDescriptor* data_type)
+    {
+        num_transfers_++;
+        handleIncomingTransfer(transfer, dtid, dst_node_id, data_type);
+    }
+
+protected:
+    /**
+     * @param max_buffer_size   Longer multi-frame transfers are dropped.
+     */
+    WildcardTransferListener(Dispatcher& dispatcher, uint16_t max_buffer_size, IPoolAllocator& allocator)
+        : dispatcher_(dispatcher)
+        , receivers_(allocator, PoolUsageTagTransferReceivers)
+#if UAVCAN_POOL_USAGE_TRACKING
+        , buffer_allocator_(allocator, PoolUsageTagTransferBuffers)
+#else
+        , buffer_allocator_(allocator.getPartition(PoolUsageTagTransferBuffers))
+#endif
+        , num_transfers_(0)
+        , num_unknown_data_type_transfers_(0)
+        , num_errors_(0)
+        , max_buffer_size_(max_buffer_size)
+    { }
+
+    virtual ~WildcardTransferListener();
+
+    /**
+     * @param dtid          Data type ID of the transfer; the transfer type is available from the transfer object.
+     * @param dst_node_id   Broadcast for messages.
+     * @param data_type     Null if the data type is not registered in @ref GlobalDataTypeRegistry.
+     */
+    virtual void handleIncomingTransfer(IncomingTransfer& transfer, DataTypeID dtid, NodeID dst_node_id,
+                                        const DataTypeDescriptor* data_type) = 0;
+
+public:
+    /**
+     * The filter can be changed at any time; the receivers of the flows that don't match anymore are
+     * released by the cleanup once they expire.
+     */
+    void setFilter(const WildcardTransferFilter& filter) { filter_ = filter; }
+    const WildcardTransferFilter& getFilter() const { return filter_; }
+
+    /**
+     * Registers the listener in the dispatcher; has no effect if it's registered already.
+     */
+    void startListening();
+    void stopListening();
+    bool isListening() const;
+
+    /**
+     * Clears the cache of data type descriptors; needed only if the data type registry has been reset.
+     */
+    void resetDataTypeCache();
+
+    /**
+     * Internal, used by the dispatcher.
+     * Whether a frame with these parameters would be accepted by the filter.
+     */
+    bool acceptsFrame(TransferType transfer_type, DataTypeID dtid, bool addressed_to_this_node) const
+    {
+        return (addressed_to_this_node || (filter_.promiscuous && (transfer_type != TransferTypeMessageBroadcast)))
+               && filter_.match(transfer_type, dtid);
+    }
+
+    /**
+     * Internal, used by the dispatcher.
+     */
+    void handleFrame(const RxFrame& frame);
+
+    /**
+     * Internal, used by the dispatcher; accepts a message delivered by @ref LocalTransferBus.
+     */
+    void handleLocalTransfer(IncomingTransfer& transfer, DataTypeID dtid);
+
+    /**
+     * Internal, used by the dispatcher.
+     */
+    void cleanup(MonotonicTime ts);
+
+    unsigned getNumReceivers() const { return receivers_.getSize(); }
+
+    uint32_t getNumTransfers() const { return num_transfers_; }
+
+    /**
+     * Number of multi-frame transfers dropped because their data types are not registered.
+     */
+    uint32_t getNumUnknownDataTypeTransfers() const { return num_unknown_data_type_transfers_; }
+
+    /**
+     * Number of transfers dropped because of a CRC mismatch, lack of memory or excessive length.
+     */
+    uint32_t getNumErrors() const { return num_errors_; }
+
+    uint16_t getMaxBufferSize() const { return max_buffer_size_; }
+};
+
+}
+
+#endif // UAVCAN_TRANSPORT_WILDCARD_TRANSFER_LISTENER_HPP_INCLUDED
@@ -15,8 +15,15 @@
 #include <uavcan/node/timer.hpp>
 #include <uavcan/node/publisher.hpp>
 #include <uavcan/node/subscriber.hpp>
+#include <uavcan/node/raw_subscriber.hpp>
+#include <uavcan/node/view_subscriber.hpp>
 #include <uavcan/node/service_server.hpp>
 #include <uavcan/node/service_client.hpp>
+#include <uavcan/node/multi_service_client.hpp>
+#include <uavcan/node/retrying_service_client.hpp>
+#include <uavcan/node/service_rtt_estimator.hpp>
+#include <uavcan/node/service_request_stream.hpp>
+#include <uavcan/node/tx_completion_monitor.hpp>
 #include <uavcan/node/global_data_type_registry.hpp>
 
 // Util
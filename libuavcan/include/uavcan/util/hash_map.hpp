@@ -0,0 +1,322 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_UTIL_HASH_MAP_HPP_INCLUDED
+#define UAVCAN_UTIL_HASH_MAP_HPP_INCLUDED
+
+#include <cassert>
+#include <cstdlib>
+#include <uavcan/util/linked_list.hpp>
+#include <uavcan/build_config.hpp>
+#include <uavcan/dynamic_memory.hpp>
+#include <uavcan/util/templates.hpp>
+#include <uavcan/util/placement_new.hpp>
+
+namespace uavcan
+{
+/**
+ * Hashed KV container with the same interface as Map<>.
+ *
+ * Each KV pair is allocated in the node's memory pool as a separate block, and blocks are chained into
+ * one of NumBuckets singly-linked lists, selected by the key hash. Unlike Map<>, the complexity of
+ * access(), insert() and remove() is O(N / NumBuckets), at the cost of NumBuckets pointers of static memory.
+ *
+ * This container is a good replacement for Map<> when the value takes a sizable part of the memory pool block,
+ * so Map<> would not be able to pack several KV pairs into one block anyway.
+ *
+ * Type requirements:
+ *  Both key and value must be copyable, assignable and default constructible.
+ *  Key must implement a comparison operator.
+ *  Key must implement a method "unsigned getHash() const".
+ *  Key's default constructor must initialize the object into invalid state.
+ *  Size of Key + Value + padding + pointer must not exceed MemPoolBlockSize.
+ */
+template <typename Key, typename Value, unsigned NumBuckets>
+class UAVCAN_EXPORT HashMap : Noncopyable
+{
+public:
+    struct KVPair
+    {
+        Value value;    // Key and value are swapped because this may allow to reduce padding (depending on types)
+        Key key;
+
+        KVPair() :
+            value(),
+            key()
+        { }
+
+        KVPair(const Key& arg_key, const Value& arg_value) :
+            value(arg_value),
+            key(arg_key)
+        { }
+
+        bool match(const Key& rhs) const { return rhs == key; }
+    };
+
+private:
+    struct KVNode : LinkedListNode<KVNode>
+    {
+        KVPair kv;
+
+        explicit KVNode(const KVPair& arg_kv)
+            : kv(arg_kv)
+        {
+            IsDynamicallyAllocatable<KVNode>::check();
+        }
+
+        static KVNode* instantiate(IPoolAllocator& allocator, const KVPair& kv)
+        {
+            void* const praw = allocator.allocate(sizeof(KVNode));
+            if (praw == NULL)
+            {
+                return NULL;
+            }
+            return new (praw) KVNode(kv);
+        }
+
+        static void destroy(KVNode*& obj, IPoolAllocator& allocator)
+        {
+            if (obj != NULL)
+            {
+                obj->~KVNode();
+                allocator.deallocate(obj);
+                obj = NULL;
+            }
+        }
+    };
+
+    LinkedListRoot<KVNode> buckets_[NumBuckets];
+#if UAVCAN_POOL_USAGE_TRACKING
+    TaggedPoolAllocator allocator_;
+#else
+    IPoolAllocator& allocator_;
+#endif
+
+    static unsigned getBucketIndex(const Key& key) { return key.getHash() % NumBuckets; }
+
+    KVNode* findNode(const Key& key) const;
+
+    struct YesPredicate
+    {
+        bool operator()(const Key&, const Value&) const { return true; }
+    };
+
+public:
+    HashMap(IPoolAllocator& allocator, PoolUsageTag tag = PoolUsageTagOther) :
+#if UAVCAN_POOL_USAGE_TRACKING
+        allocator_(allocator, tag)
+#else
+        allocator_(allocator.getPartition(tag))
+#endif
+    {
+        StaticAssert<(NumBuckets > 0)>::check();
+        UAVCAN_ASSERT(Key() == Key());
+    }
+
+    ~HashMap()
+    {
+        clear();
+    }
+
+    /**
+     * Returns null pointer if there's no such entry.
+     */
+    Value* access(const Key& key);
+
+    /**
+     * If entry with the same key already exists, it will be replaced
+     */
+    Value* insert(const Key& key, const Value& value);
+
+    /**
+     * Does nothing if there's no such entry.
+     */
+    void remove(const Key& key);
+
+    /**
+     * Removes entries where the predicate returns true.
+     * Predicate prototype:
+     *  bool (Key& key, Value& value)
+     */
+    template <typename Predicate>
+    void removeAllWhere(Predicate predicate);
+
+    /**
+     * Returns first entry where the predicate returns true.
+     * Predicate prototype:
+     *  bool (const Key& key, const Value& value)
+     */
+    template <typename Predicate>
+    const Key* find(Predicate predicate) const;
+
+    /**
+     * Removes all items.
+     */
+    void clear();
+
+    /**
+     * Returns a key-value pair located at the specified position from the beginning.
+     * Note that any insertion or deletion may greatly disturb internal ordering, so use with care.
+     * If index is greater than or equal the number of pairs, null pointer will be returned.
+     */
+    KVPair* getByIndex(unsigned index);
+    const KVPair* getByIndex(unsigned index) const;
+
+    /**
+     * Complexity is O(NumBuckets).
+     */
+    bool isEmpty() const { return find(YesPredicate()) == NULL; }
+
+    /**
+     * Complexity is O(N).
+     */
+    unsigned getSize() const;
+};
+
+// ----------------------------------------------------------------------------
+
+/*
+ * HashMap<>
+ */
+template <typename Key, typename Value, unsigned NumBuckets>
+typename HashMap<Key, Value, NumBuckets>::KVNode* HashMap<Key, Value, NumBuckets>::findNode(const Key& key) const
+{
+    KVNode* p = buckets_[getBucketIndex(key)].get();
+    while (p)
+    {
+        if (p->kv.match(key))
+        {
+            return p;
+        }
+        p = p->getNextListNode();
+    }
+    return NULL;
+}
+
+template <typename Key, typename Value, unsigned NumBuckets>
+Value* HashMap<Key, Value, NumBuckets>::access(const Key& key)
+{
+    UAVCAN_ASSERT(!(key == Key()));
+    KVNode* const node = findNode(key);
+    return node ? &node->kv.value : NULL;
+}
+
+template <typename Key, typename Value, unsigned NumBuckets>
+Value* HashMap<Key, Value, NumBuckets>::insert(const Key& key, const Value& value)
+{
+    UAVCAN_ASSERT(!(key == Key()));
+
+    KVNode* const existing = findNode(key);
+    if (existing)
+    {
+        existing->kv.value = value;
+        return &existing->kv.value;
+    }
+
+    KVNode* const node = KVNode::instantiate(allocator_, KVPair(key, value));
+    if (node == NULL)
+    {
+        return NULL;
+    }
+    buckets_[getBucketIndex(key)].insert(node);
+    return &node->kv.value;
+}
+
+template <typename Key, typename Value, unsigned NumBuckets>
+void HashMap<Key, Value, NumBuckets>::remove(const Key& key)
+{
+    UAVCAN_ASSERT(!(key == Key()));
+    KVNode* node = findNode(key);
+    if (node)
+    {
+        buckets_[getBucketIndex(key)].remove(node);
+        KVNode::destroy(node, allocator_);
+    }
+}
+
+template <typename Key, typename Value, unsigned NumBuckets>
+template <typename Predicate>
+void HashMap<Key, Value, NumBuckets>::removeAllWhere(Predicate predicate)
+{
+    for (unsigned i = 0; i < NumBuckets; i++)
+    {
+        KVNode* p = buckets_[i].get();
+        while (p != NULL)
+        {
+            KVNode* next = p->getNextListNode();
+            if (predicate(p->kv.key, p->kv.value))
+            {
+                buckets_[i].remove(p);
+                KVNode::destroy(p, allocator_);
+            }
+            p = next;
+        }
+    }
+}
+
+template <typename Key, typename Value, unsigned NumBuckets>
+template <typename Predicate>
+const Key* HashMap<Key, Value, NumBuckets>::find(Predicate predicate) const
+{
+    for (unsigned i = 0; i < NumBuckets; i++)
+    {
+        const KVNode* p = buckets_[i].get();
+        while (p != NULL)
+        {
+            if (predicate(p->kv.key, p->kv.value))
+            {
+                return &p->kv.key;
+            }
+            p = p->getNextListNode();
+        }
+    }
+    return NULL;
+}
+
+template <typename Key, typename Value, unsigned NumBuckets>
+void HashMap<Key, Value, NumBuckets>::clear()
+{
+    removeAllWhere(YesPredicate());
+}
+
+template <typename Key, typename Value, unsigned NumBuckets>
+typename HashMap<Key, Value, NumBuckets>::KVPair* HashMap<Key, Value, NumBuckets>::getByIndex(unsigned index)
+{
+    for (unsigned i = 0; i < NumBuckets; i++)
+    {
+        KVNode* p = buckets_[i].get();
+        while (p != NULL)
+        {
+            if (index == 0)
+            {
+                return &p->kv;
+            }
+            index--;
+            p = p->getNextListNode();
+        }
+    }
+    return NULL;
+}
+
+template <typename Key, typename Value, unsigned NumBuckets>
+const typename HashMap<Key, Value, NumBuckets>::KVPair*
+HashMap<Key, Value, NumBuckets>::getByIndex(unsigned index) const
+{
+    return const_cast<HashMap<Key, Value, NumBuckets>*>(this)->getByIndex(index);
+}
+
+template <typename Key, typename Value, unsigned NumBuckets>
+unsigned HashMap<Key, Value, NumBuckets>::getSize() const
+{
+    unsigned num = 0;
+    for (unsigned i = 0; i < NumBuckets; i++)
+    {
+        num += buckets_[i].getLength();
+    }
+    return num;
+}
+
+}
+
+#endif // UAVCAN_UTIL_HASH_MAP_HPP_INCLUDED
@@ -1,5 +1,5 @@
 /*
- * Singly-linked list.
+ * Intrusive linked list.
  * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
  */
 
@@ -12,6 +12,8 @@
 
 namespace uavcan
 {
+template <typename T> class UAVCAN_EXPORT LinkedListRoot;
+
 /**
  * Classes that are supposed to be linked-listed should derive this.
  */
@@ -36,6 +38,42 @@ public:
     }
 };
 
+/**
+ * Classes can derive this instead of @ref LinkedListNode to make their lists doubly linked.
+ * This costs one pointer per node, but makes @ref LinkedListRoot::remove() and @ref LinkedListRoot::contains()
+ * O(1), which is worth it for the lists whose nodes are removed frequently. The list API is the same, the choice
+ * is made by the node type at compile time.
+ *
+ * The back link is maintained by @ref LinkedListRoot; therefore, the forward link must not be modified directly.
+ * A node can be removed in O(1) only from the list it belongs to; removing a node that belongs to another list
+ * unlinks it from that list, unless it is the first node there, in which case nothing happens.
+ */
+template <typename T>
+class UAVCAN_EXPORT DoublyLinkedListNode
+{
+    template <typename> friend class LinkedListRoot;
+
+    T* next_;
+    T* prev_;           ///< NULL if this is the first node or if the node is not linked
+
+protected:
+    DoublyLinkedListNode()
+        : next_(NULL)
+        , prev_(NULL)
+    { }
+
+    ~DoublyLinkedListNode() { }
+
+public:
+    T* getNextListNode() const { return next_; }
+    T* getPrevListNode() const { return prev_; }
+
+    void setNextListNode(T* node)
+    {
+        next_ = node;
+    }
+};
+
 /**
  * Linked list root.
  */
@@ -44,6 +82,23 @@ class UAVCAN_EXPORT LinkedListRoot
 {
     T* root_;
 
+    /*
+     * These overloads are resolved by the base class of T, so the back links exist only for doubly linked nodes.
+     */
+    static bool hasBackLinks(const LinkedListNode<T>*) { return false; }
+    static bool hasBackLinks(const DoublyLinkedListNode<T>*) { return true; }
+
+    static T* getPrev(const LinkedListNode<T>*) { return NULL; }
+    static T* getPrev(const DoublyLinkedListNode<T>* node) { return node->prev_; }
+
+    static void setPrev(LinkedListNode<T>*, T*) { }
+    static void setPrev(DoublyLinkedListNode<T>* node, T* prev) { node->prev_ = prev; }
+
+    /**
+     * Links the node after the specified one, or to the beginning of the list if it is NULL.
+     */
+    void linkAfter(T* prev, T* node);
+
 public:
     LinkedListRoot()
         : root_(NULL)
@@ -64,6 +119,19 @@ public:
      */
     void insert(T* node);
 
+    /**
+     * Same as @ref insert(), but the caller guarantees that the node is not present in the list.
+     * Complexity: O(1)
+     */
+    void insertNew(T* node);
+
+    /**
+     * Inserts the node immediately after the node prev, or to the beginning of the list if prev is NULL.
+     * The caller guarantees that the node is not present in the list, and that prev is.
+     * Complexity: O(1)
+     */
+    void insertNewAfter(T* prev, T* node);
+
     /**
      * Inserts the node immediately before the node X where predicate(X) returns true.
      * If the node is already present in the list, it can be relocated to a new position.
@@ -74,9 +142,16 @@ public:
 
     /**
      * Removes only the first occurence of the node.
-     * Complexity: O(N)
+     * Complexity: O(N), or O(1) if the nodes are doubly linked.
      */
     void remove(const T* node);
+
+    /**
+     * Checks whether the node belongs to this list.
+     * Complexity: O(N), or O(1) if the nodes are doubly linked; in the latter case, the node must belong either
+     * to this list or to no list at all, because a node in the middle of another list is reported as present.
+     */
+    bool contains(const T* node) const;
 };
 
 // ----------------------------------------------------------------------------
@@ -106,8 +181,29 @@ void LinkedListRoot<T>::insert(T* node)
         return;
     }
     remove(node);  // Making sure there will be no loops
-    node->setNextListNode(root_);
-    root_ = node;
+    linkAfter(NULL, node);
+}
+
+template <typename T>
+void LinkedListRoot<T>::insertNew(T* node)
+{
+    if (node == NULL)
+    {
+        UAVCAN_ASSERT(0);
+        return;
+    }
+    linkAfter(NULL, node);
+}
+
+template <typename T>
+void LinkedListRoot<T>::insertNewAfter(T* prev, T* node)
+{
+    if (node == NULL)
+    {
+        UAVCAN_ASSERT(0);
+        return;
+    }
+    linkAfter(prev, node);
 }
 
 template <typename T>
@@ -124,8 +220,7 @@ void LinkedListRoot<T>::insertBefore(T* node, Predicate predicate)
 
     if (root_ == NULL || predicate(root_))
     {
-        node->setNextListNode(root_);
-        root_ = node;
+        linkAfter(NULL, node);
     }
     else
     {
@@ -138,8 +233,27 @@ void LinkedListRoot<T>::insertBefore(T* node, Predicate predicate)
             }
             p = p->getNextListNode();
         }
-        node->setNextListNode(p->getNextListNode());
-        p->setNextListNode(node);
+        linkAfter(p, node);
+    }
+}
+
+template <typename T>
+void LinkedListRoot<T>::linkAfter(T* prev, T* node)
+{
+    T* const next = (prev == NULL) ? root_ : prev->getNextListNode();
+    node->setNextListNode(next);
+    setPrev(node, prev);
+    if (next != NULL)
+    {
+        setPrev(next, node);
+    }
+    if (prev == NULL)
+    {
+        root_ = node;
+    }
+    else
+    {
+        prev->setNextListNode(node);
     }
 }
 
@@ -151,7 +265,30 @@ void LinkedListRoot<T>::remove(const T* node)
         return;
     }
 
-    if (root_ == node)
+    if (hasBackLinks(node))
+    {
+        if (!contains(node))
+        {
+            return;
+        }
+        T* const mutable_node = const_cast<T*>(node);     // Only the links are modified
+        T* const prev = getPrev(node);
+        T* const next = node->getNextListNode();
+        if (prev == NULL)
+        {
+            root_ = next;
+        }
+        else
+        {
+            prev->setNextListNode(next);
+        }
+        if (next != NULL)
+        {
+            setPrev(next, prev);
+        }
+        setPrev(mutable_node, NULL);
+    }
+    else if (root_ == node)
     {
         root_ = root_->getNextListNode();
     }
@@ -170,6 +307,25 @@ void LinkedListRoot<T>::remove(const T* node)
     }
 }
 
+template <typename T>
+bool LinkedListRoot<T>::contains(const T* node) const
+{
+    if (node == NULL)
+    {
+        return false;
+    }
+    if (hasBackLinks(node))
+    {
+        return (root_ == node) || (getPrev(node) != NULL);
+    }
+    const T* p = root_;
+    while ((p != NULL) && (p != node))
+    {
+        p = p->getNextListNode();
+    }
+    return p != NULL;
+}
+
 }
 
 #endif // UAVCAN_UTIL_LINKED_LIST_HPP_INCLUDED
@@ -0,0 +1,219 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_UTIL_LZSS_HPP_INCLUDED
+#define UAVCAN_UTIL_LZSS_HPP_INCLUDED
+
+#include <cassert>
+#include <uavcan/std.hpp>
+#include <uavcan/build_config.hpp>
+#include <uavcan/error.hpp>
+#include <uavcan/util/templates.hpp>
+
+namespace uavcan
+{
+/**
+ * LZSS stream format, used for compressed firmware images (see @ref CompressedFileServerBackend).
+ * The format is designed to be decompressed in a single pass with a small RAM footprint, so that it can be
+ * used in bootloaders; the decompressor needs only the window, which is 256 to 4096 bytes, and no heap.
+ *
+ * Header, 8 bytes:
+ *      'L' 'Z' 'S'             Magic
+ *      uint8 window_log2       Base-2 logarithm of the window size, from 8 to 12
+ *      uint32 size             Uncompressed size, little endian
+ *
+ * Then groups of up to 8 items, every group is prefixed with a flag byte; its bit N is the type of the item N,
+ * starting from the LSB: 1 - literal, 1 byte; 0 - back reference, 2 bytes:
+ *      byte 0:     bits 0..7 of (distance - 1)
+ *      byte 1:     bits 0..3 - (length - 3), bits 4..7 - bits 8..11 of (distance - 1)
+ * where distance (1 to the window size) is counted back from the current position, and length is 3 to 18.
+ * The stream ends once the uncompressed size is reached; the unused bits of the last flag byte are zero.
+ *
+ * @{
+ */
+static const unsigned LzssHeaderSize = 8;
+static const unsigned LzssMinWindowLog2 = 8;
+static const unsigned LzssMaxWindowLog2 = 12;
+static const unsigned LzssMaxWindowSize = 1U << LzssMaxWindowLog2;
+static const unsigned LzssMinMatchLength = 3;
+static const unsigned LzssMaxMatchLength = 18;
+/**
+ * @}
+ */
+
+/**
+ * Output of @ref LzssCompressor and @ref LzssDecompressor.
+ */
+class UAVCAN_EXPORT ILzssOutput
+{
+public:
+    /**
+     * Returns negative error code; the operation will be aborted.
+     */
+    virtual int write(const uint8_t* data, unsigned size) = 0;
+
+    virtual ~ILzssOutput() { }
+};
+
+/**
+ * Streaming compressor; the input can be fed in chunks of any size.
+ * Matches are looked up via hash chains, so the compression is fast enough for large images, but the object takes
+ * about 40 KB; this is intended for servers rather than for embedded nodes.
+ */
+class UAVCAN_EXPORT LzssCompressor : Noncopyable
+{
+    enum { BufferSize = 2 * LzssMaxWindowSize };
+    enum { HashSize = 4096 };
+    enum { MaxChainLength = 64 };
+    enum { MaxGroupSize = 1 + 8 * 2 };
+
+    uint8_t buffer_[BufferSize];
+    uint32_t head_[HashSize];               ///< Last position with this hash plus one, zero if none
+    uint32_t prev_[LzssMaxWindowSize];      ///< Previous position with the same hash plus one
+    uint8_t group_[MaxGroupSize];
+    ILzssOutput* output_;
+    uint32_t size_;                         ///< Uncompressed size
+    uint32_t base_;                         ///< Stream position of buffer_[0]
+    uint32_t pos_;                          ///< Stream position of the next byte to encode
+    uint32_t end_;                          ///< Stream position after the last byte received
+    uint32_t compressed_size_;
+    uint16_t window_size_;
+    uint8_t group_size_;
+    uint8_t group_items_;
+
+    static unsigned computeHash(const uint8_t* p)
+    {
+        return ((unsigned(p[0]) << 8) ^ (unsigned(p[1]) << 4) ^ unsigned(p[2])) & (unsigned(HashSize) - 1U);
+    }
+
+    const uint8_t* at(uint32_t pos) const { return buffer_ + (pos - base_); }
+
+    void insertHash(uint32_t pos);
+    unsigned findMatch(uint32_t& out_distance) const;
+    int writeOutput(const uint8_t* data, unsigned size);
+    int flushGroup();
+    int addItem(bool literal, uint32_t distance, unsigned length);
+    int encode();
+
+public:
+    LzssCompressor();
+
+    /**
+     * Starts a new stream and writes its header. The previous stream, if any, is abandoned.
+     * @param size          Uncompressed size, i.e. the number of bytes that will be fed.
+     * @param output        Compressed data will be written here.
+     * @param window_log2   Smaller windows reduce the RAM footprint of the decompressor at the cost of the
+     *                      compression ratio.
+     * Returns negative error code.
+     */
+    int begin(uint32_t size, ILzssOutput& output, uint8_t window_log2 = LzssMaxWindowLog2);
+
+    /**
+     * Compresses the next chunk of the input; the output is flushed once the last byte is fed.
+     * Feeding more than the size declared in @ref begin() is an error.
+     * Returns negative error code.
+     */
+    int feed(const uint8_t* data, unsigned size);
+
+    bool isFinished() const { return (output_ != NULL) && (pos_ == size_) && (group_items_ == 0); }
+
+    /**
+     * Number of bytes written to the output so far, including the header.
+     */
+    uint32_t getCompressedSize() const { return compressed_size_; }
+};
+
+/**
+ * Streaming decompressor that does not depend on the window size; use @ref LzssDecompressor instead.
+ */
+class UAVCAN_EXPORT LzssDecompressorBase : Noncopyable
+{
+    enum State
+    {
+        StateHeader,
+        StateFlags,
+        StateItem,
+        StateMatch,
+        StateFinished,
+        StateError
+    };
+
+    uint8_t* const window_;
+    ILzssOutput* output_;
+    uint32_t size_;
+    uint32_t num_produced_;
+    uint16_t window_mask_;
+    uint16_t write_index_;
+    uint16_t flushed_index_;
+    uint8_t header_[LzssHeaderSize];
+    uint8_t max_window_log2_;
+    uint8_t stream_window_log2_;
+    uint8_t state_;
+    uint8_t header_size_;
+    uint8_t flags_;
+    uint8_t num_items_left_;
+    uint8_t match_byte_;
+
+    int flush(unsigned end);
+    int put(uint8_t byte);
+    int handleHeader();
+    int handleMatch(uint8_t second_byte);
+    int handleByte(uint8_t byte);
+
+protected:
+    LzssDecompressorBase(uint8_t* window, uint8_t window_log2)
+        : window_(window)
+        , max_window_log2_(window_log2)
+    {
+        reset();
+    }
+
+public:
+    /**
+     * Prepares the decompressor for a new stream.
+     */
+    void reset();
+
+    /**
+     * Decompresses the next chunk of the stream, which can be of any size; the output is written before the method
+     * returns. The bytes after the end of the stream are ignored, which allows the stream to be padded.
+     * Returns negative error code; the stream cannot be continued after an error:
+     *  - @ref ErrNotSupported if the stream needs a larger window than this decompressor has;
+     *  - @ref ErrInvalidMarshalData if the stream is malformed;
+     *  - the error returned by the output.
+     */
+    int feed(const uint8_t* data, unsigned size, ILzssOutput& output);
+
+    bool isFinished() const { return state_ == StateFinished; }
+
+    /**
+     * Uncompressed size declared in the header; zero until the header is received.
+     */
+    uint32_t getUncompressedSize() const { return size_; }
+
+    uint32_t getNumBytesProduced() const { return num_produced_; }
+};
+
+/**
+ * Streaming decompressor, e.g. for a bootloader that feeds the chunks received via uavcan.protocol.file.Read in
+ * order and writes the output to the flash.
+ * @tparam WindowLog2   Largest window log2 of the streams that can be decompressed; the object contains the window.
+ */
+template <unsigned WindowLog2 = LzssMaxWindowLog2>
+class UAVCAN_EXPORT LzssDecompressor : public LzssDecompressorBase
+{
+    uint8_t window_storage_[1U << WindowLog2];
+
+public:
+    LzssDecompressor()
+        : LzssDecompressorBase(window_storage_, uint8_t(WindowLog2))
+    {
+        StaticAssert<(WindowLog2 >= LzssMinWindowLog2)>::check();
+        StaticAssert<(WindowLog2 <= LzssMaxWindowLog2)>::check();
+    }
+};
+
+}
+
+#endif // UAVCAN_UTIL_LZSS_HPP_INCLUDED
@@ -97,7 +97,11 @@ private:
     };
 
     LinkedListRoot<KVGroup> list_;
+#if UAVCAN_POOL_USAGE_TRACKING
+    TaggedPoolAllocator allocator_;
+#else
     IPoolAllocator& allocator_;
+#endif
 
     KVPair* findKey(const Key& key);
 
@@ -109,8 +113,17 @@ private:
     };
 
 public:
-    Map(IPoolAllocator& allocator) :
-        allocator_(allocator)
+    /**
+     * Number of KV pairs that share one memory pool block.
+     */
+    enum { NumKVPairsPerBlock = KVGroup::NumKV };
+
+    Map(IPoolAllocator& allocator, PoolUsageTag tag = PoolUsageTagOther) :
+#if UAVCAN_POOL_USAGE_TRACKING
+        allocator_(allocator, tag)
+#else
+        allocator_(allocator.getPartition(tag))
+#endif
     {
         UAVCAN_ASSERT(Key() == Key());
     }
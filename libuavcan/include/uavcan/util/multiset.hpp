@@ -119,7 +119,11 @@ private:
      * Data
      */
     LinkedListRoot<Chunk> list_;
+#if UAVCAN_POOL_USAGE_TRACKING
+    TaggedPoolAllocator allocator_;
+#else
     IPoolAllocator& allocator_;
+#endif
 
     /*
      * Methods
@@ -188,9 +192,14 @@ private:
     };
 
 public:
-    Multiset(IPoolAllocator& allocator)
-        : allocator_(allocator)
-    { }
+    Multiset(IPoolAllocator& allocator, PoolUsageTag tag = PoolUsageTagOther)
+#if UAVCAN_POOL_USAGE_TRACKING
+        : allocator_(allocator, tag)
+#else
+        : allocator_(allocator.getPartition(tag))
+#endif
+    {
+    }
 
     ~Multiset()
     {
@@ -4,6 +4,7 @@
  */
 
 #include <uavcan/driver/can.hpp>
+#include <uavcan/error.hpp>
 #include <cassert>
 
 namespace uavcan
@@ -14,8 +15,40 @@ const uint32_t CanFrame::MaskExtID;
 const uint32_t CanFrame::FlagEFF;
 const uint32_t CanFrame::FlagRTR;
 const uint32_t CanFrame::FlagERR;
+const uint8_t CanFrame::MaxClassicDataLen;
 const uint8_t CanFrame::MaxDataLen;
 
+static const uint8_t CanFDDlcToDataLength[16] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 20, 24, 32, 48, 64 };
+
+uint8_t CanFrame::dlcToDataLength(uint8_t dlc)
+{
+    return (dlc < 16) ? CanFDDlcToDataLength[dlc] : CanFDDlcToDataLength[15];
+}
+
+uint8_t CanFrame::dataLengthToDlc(uint8_t data_len)
+{
+    uint8_t dlc = 0;
+    while ((dlc < 15) && (CanFDDlcToDataLength[dlc] < data_len))
+    {
+        dlc++;
+    }
+    return dlc;
+}
+
+uint8_t CanFrame::roundDownDataLength(unsigned data_len)
+{
+    if (data_len >= MaxDataLen)
+    {
+        return MaxDataLen;
+    }
+    uint8_t dlc = dataLengthToDlc(uint8_t(data_len));      // Rounds up
+    if (dlcToDataLength(dlc) > data_len)
+    {
+        dlc--;
+    }
+    return dlcToDataLength(dlc);
+}
+
 bool CanFrame::priorityHigherThan(const CanFrame& rhs) const
 {
     const uint32_t clean_id     = id     & MaskExtID;
@@ -63,7 +96,7 @@ std::string CanFrame::toString(StringRepresentation mode) const
 
     static const unsigned AsciiColumnOffset = 36U;
 
-    char buf[50];
+    char buf[18 + MaxDataLen * 4];
     char* wpos = buf;
     char* const epos = buf + sizeof(buf);
     fill(buf, buf + sizeof(buf), '\0');
@@ -115,4 +148,68 @@ std::string CanFrame::toString(StringRepresentation mode) const
 }
 #endif
 
+/*
+ * CanRxFrame
+ */
+#if UAVCAN_TOSTRING
+std::string CanRxFrame::toString(StringRepresentation mode) const
+{
+    std::string out = CanFrame::toString(mode);
+    out.reserve(128);
+    out += " ts_m="   + ts_mono.toString();
+    out += " ts_utc=" + ts_utc.toString();
+    out += " iface=";
+    out += char('0' + iface_index);
+    return out;
+}
+#endif
+
+/*
+ * ICanIface
+ */
+int16_t ICanIface::receiveBatch(CanRxFrame* out_frames, CanIOFlags* out_flags, uint16_t max_frames)
+{
+    if ((out_frames == NULL) || (out_flags == NULL))
+    {
+        UAVCAN_ASSERT(0);
+        return -ErrInvalidParam;
+    }
+
+    uint16_t num_received = 0;
+    while (num_received < max_frames)
+    {
+        CanRxFrame& frame = out_frames[num_received];
+        out_flags[num_received] = 0;
+        const int16_t res = receive(frame, frame.ts_mono, frame.ts_utc, out_flags[num_received]);
+        if (res < 0)
+        {
+            // Frames that were already received must not be lost, the error will be reported on the next call
+            return (num_received > 0) ? int16_t(num_received) : res;
+        }
+        if (res == 0)
+        {
+            break;
+        }
+        num_received++;
+    }
+    return int16_t(num_received);
+}
+
+int16_t ICanIface::peekRxFrameId(uint32_t& out_can_id)
+{
+    (void)out_can_id;
+    return -ErrNotSupported;
+}
+
+uint16_t ICanIface::getNumFiltersRequired(const CanFilterConfig* filter_configs, uint16_t num_configs) const
+{
+    (void)filter_configs;
+    return num_configs;
+}
+
+uint16_t ICanIface::getNumFreeTxSlots() const
+{
+    return 0;
+}
+
 }
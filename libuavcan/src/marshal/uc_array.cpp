@@ -0,0 +1,12 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <uavcan/marshal/array.hpp>
+
+namespace uavcan
+{
+
+IPoolAllocator* PooledArrayAllocator::allocator_ = NULL;
+
+}
@@ -11,34 +11,73 @@ namespace uavcan
 
 const unsigned BitStream::MaxBytesPerRW;
 const unsigned BitStream::MaxBitsPerRW;
+const unsigned BitStream::AccumulatorBytes;
+
+uint64_t BitStream::loadAccumulator(const uint8_t* bytes, unsigned bytelen)
+{
+    UAVCAN_ASSERT(bytelen <= AccumulatorBytes);
+    uint64_t acc = 0;
+    for (unsigned i = 0; i < bytelen; i++)
+    {
+        acc |= uint64_t(bytes[i]) << (56U - i * 8U);
+    }
+    return acc;
+}
+
+void BitStream::storeAccumulator(uint64_t acc, uint8_t* bytes, unsigned bytelen)
+{
+    UAVCAN_ASSERT(bytelen <= AccumulatorBytes);
+    for (unsigned i = 0; i < bytelen; i++)
+    {
+        bytes[i] = uint8_t(acc >> (56U - i * 8U));
+    }
+}
 
 int BitStream::write(const uint8_t* bytes, const unsigned bitlen)
 {
+    contiguous_data_ = NULL;   // The view is not valid anymore once the buffer is modified
+
     // Temporary buffer is needed to merge new bits with cached unaligned bits from the last write() (see byte_cache_)
     uint8_t tmp[MaxBytesPerRW + 1];
 
     // Tmp space must be large enough to accomodate new bits AND unaligned bits from the last write()
-    const unsigned bytelen = bitlenToBytelen(bitlen + (bit_offset_ % 8));
-    UAVCAN_ASSERT(MaxBytesPerRW >= bytelen);
-    tmp[0] = tmp[bytelen - 1] = 0;
-
-    fill(tmp, tmp + bytelen, uint8_t(0));
-    copyBitArrayAlignedToUnaligned(bytes, bitlen, tmp, bit_offset_ % 8);
+    const unsigned bit_shift = bit_offset_ % 8;
+    const unsigned bytelen = bitlenToBytelen(bitlen + bit_shift);
 
     const unsigned new_bit_offset = bit_offset_ + bitlen;
+    const uint8_t* out = tmp;
 
-    // Bitcopy algorithm resets skipped bits in the first byte. Restore them back.
-    tmp[0] |= byte_cache_;
+    if ((bit_shift == 0) && (bitlen % 8 == 0))
+    {
+        // Byte aligned field - the source bytes can be written as is, this is the most common case
+        out = bytes;
+    }
+    else if ((bitlen + bit_shift) <= (AccumulatorBytes * 8))
+    {
+        // Here bitlen < 64, so the mask is well defined
+        uint64_t acc = loadAccumulator(bytes, bitlenToBytelen(bitlen)) & ~(~uint64_t(0) >> bitlen);
+        acc = (acc >> bit_shift) | (uint64_t(byte_cache_) << 56U);
+        storeAccumulator(acc, tmp, bytelen);
+    }
+    else
+    {
+        UAVCAN_ASSERT(MaxBytesPerRW >= bytelen);
+        fill(tmp, tmp + bytelen, uint8_t(0));
+        copyBitArrayAlignedToUnaligned(bytes, bitlen, tmp, bit_shift);
+
+        // Bitcopy algorithm resets skipped bits in the first byte. Restore them back.
+        tmp[0] |= byte_cache_;
+    }
 
     // (new_bit_offset % 8 == 0) means that this write was perfectly aligned.
-    byte_cache_ = uint8_t((new_bit_offset % 8) ? tmp[bytelen - 1] : 0);
+    byte_cache_ = uint8_t((new_bit_offset % 8) ? out[bytelen - 1] : 0);
 
     /*
      * Dump the data into the destination buffer.
      * Note that if this write was unaligned, last written byte in the buffer will be rewritten with updated value
      * within the next write() operation.
      */
-    const int write_res = buf_.write(bit_offset_ / 8, tmp, bytelen);
+    const int write_res = buf_.write(bit_offset_ / 8, out, bytelen);
     if (write_res < 0)
     {
         return write_res;
@@ -54,23 +93,60 @@ int BitStream::write(const uint8_t* bytes, const unsigned bitlen)
 
 int BitStream::read(uint8_t* bytes, const unsigned bitlen)
 {
-    uint8_t tmp[MaxBytesPerRW + 1];
+    const unsigned bit_shift = bit_offset_ % 8;
+    const unsigned bytelen = bitlenToBytelen(bitlen + bit_shift);
+
+    const bool aligned = (bit_shift == 0) && (bitlen % 8 == 0);
+    UAVCAN_ASSERT(aligned || (MaxBytesPerRW >= bytelen));
 
-    const unsigned bytelen = bitlenToBytelen(bitlen + (bit_offset_ % 8));
-    UAVCAN_ASSERT(MaxBytesPerRW >= bytelen);
+    uint8_t tmp[MaxBytesPerRW + 1];
+    const uint8_t* in = tmp;
 
-    const int read_res = buf_.read(bit_offset_ / 8, tmp, bytelen);
-    if (read_res < 0)
+    if (contiguous_data_ != NULL)
     {
-        return read_res;
+        // The data can be accessed in place, without virtual calls and intermediate copying
+        if ((bit_offset_ / 8 + bytelen) > contiguous_len_)
+        {
+            return ResultOutOfBuffer;
+        }
+        in = contiguous_data_ + bit_offset_ / 8;
+        if (aligned)
+        {
+            (void)copy(in, in + bytelen, bytes);
+            bit_offset_ += bitlen;
+            return ResultOk;
+        }
     }
-    if (static_cast<unsigned>(read_res) < bytelen)
+    else
     {
-        return ResultOutOfBuffer;
+        // Byte aligned field can be read directly into the destination
+        const int read_res = buf_.read(bit_offset_ / 8, aligned ? bytes : tmp, bytelen);
+        if (read_res < 0)
+        {
+            return read_res;
+        }
+        if (static_cast<unsigned>(read_res) < bytelen)
+        {
+            return ResultOutOfBuffer;
+        }
+        if (aligned)
+        {
+            bit_offset_ += bitlen;
+            return ResultOk;
+        }
     }
 
-    fill(bytes, bytes + bitlenToBytelen(bitlen), uint8_t(0));
-    copyBitArrayUnalignedToAligned(tmp, bit_offset_ % 8, bitlen, bytes);
+    if ((bitlen + bit_shift) <= (AccumulatorBytes * 8))
+    {
+        // Here bitlen < 64, so the mask is well defined
+        const uint64_t acc = (loadAccumulator(in, bytelen) << bit_shift) & ~(~uint64_t(0) >> bitlen);
+        storeAccumulator(acc, bytes, bitlenToBytelen(bitlen));
+    }
+    else
+    {
+        fill(bytes, bytes + bitlenToBytelen(bitlen), uint8_t(0));
+        copyBitArrayUnalignedToAligned(in, bit_shift, bitlen, bytes);
+    }
     bit_offset_ += bitlen;
     return ResultOk;
 }
@@ -0,0 +1,667 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <uavcan/marshal/char_array_formatter.hpp>
+#include <uavcan/util/templates.hpp>
+
+namespace uavcan
+{
+namespace
+{
+
+const unsigned MaxSignificantDigits = 17;           ///< This is enough to represent any double exactly
+const double FixedNotationLimit = 1e17;             ///< The integer part must fit 64 bits with all digits
+
+/**
+ * Exact decimal expansion of a non-negative finite value, produced digit by digit starting from the most
+ * significant one: first the digits of the integer part, then the digits of the fraction. A binary floating point
+ * value is an integer multiple of a power of two, so the expansion is finite; it is computed with big integers,
+ * which allows printf() compatible rounding.
+ */
+class DecimalExpansion
+{
+    enum { NumLimbs = 40 };         ///< 2^1024 occupies 32 limbs, the fraction of 2^-1074 occupies 34 limbs
+    enum { ChunkDigits = 9 };
+
+    static const uint32_t ChunkBase = 1000000000U;
+
+    /**
+     * The numerator of the fraction occupies the bottom limbs, its denominator is 2^frac_bits_.
+     * The integer part is stored in base 10^9 at the top limbs, the most significant chunk at the lowest index.
+     */
+    uint32_t limbs_[NumLimbs];
+    unsigned num_frac_limbs_;
+    unsigned frac_bits_;
+    unsigned num_chunks_;           ///< Chunks of the integer part that are left, excluding the current one
+    unsigned num_integer_digits_;
+    uint32_t chunk_;                ///< Remaining digits of the current chunk
+    uint32_t chunk_divisor_;        ///< Weight of the next digit of the current chunk; zero if none are left
+
+    void storeChunk(uint32_t chunk)
+    {
+        UAVCAN_ASSERT(num_chunks_ < NumLimbs);
+        limbs_[NumLimbs - 1U - num_chunks_] = chunk;
+        num_chunks_++;
+    }
+
+    void trimFraction()
+    {
+        while ((num_frac_limbs_ > 0) && (limbs_[num_frac_limbs_ - 1U] == 0))
+        {
+            num_frac_limbs_--;
+        }
+    }
+
+public:
+    explicit DecimalExpansion(double value);
+
+    /**
+     * Number of digits of the integer part; zero if the value is below one.
+     */
+    unsigned getNumIntegerDigits() const { return num_integer_digits_; }
+
+    /**
+     * Zeros are returned once the expansion is over.
+     */
+    unsigned getNextDigit();
+
+    /**
+     * Whether all of the remaining digits are zeros.
+     */
+    bool isExhausted() const;
+};
+
+DecimalExpansion::DecimalExpansion(double value)
+    : num_frac_limbs_(0)
+    , frac_bits_(0)
+    , num_chunks_(0)
+    , num_integer_digits_(0)
+    , chunk_(0)
+    , chunk_divisor_(0)
+{
+    UAVCAN_ASSERT(value >= 0.0);
+    fill(limbs_, limbs_ + NumLimbs, uint32_t(0));
+    if (!(value > 0.0))
+    {
+        return;
+    }
+
+    /*
+     * value = mantissa * 2^exponent; scaling by powers of two is exact, so the bit layout of the type doesn't matter
+     */
+    int exponent = 0;
+    while (value >= 18446744073709551616.0)         // 2^64
+    {
+        value /= 4294967296.0;
+        exponent += 32;
+    }
+    while (value < 2147483648.0)                    // 2^31
+    {
+        value *= 4294967296.0;
+        exponent -= 32;
+    }
+    while (value < 9223372036854775808.0)           // 2^63
+    {
+        value *= 2.0;
+        exponent--;
+    }
+    unsigned long long mantissa = static_cast<unsigned long long>(value);
+    while ((mantissa & 1U) == 0)
+    {
+        mantissa >>= 1;
+        exponent++;
+    }
+
+    unsigned long long integer_part = 0;
+    if (exponent >= 0)
+    {
+        // The integer part is a big integer, it is converted to base 10^9 by repeated division
+        const unsigned shift = unsigned(exponent);
+        unsigned num_limbs = shift / 32U + 3U;
+        UAVCAN_ASSERT(num_limbs <= NumLimbs);
+        const unsigned long long low = mantissa << (shift % 32U);
+        limbs_[shift / 32U] = uint32_t(low);
+        limbs_[shift / 32U + 1U] = uint32_t(low >> 32);
+        limbs_[shift / 32U + 2U] = (shift % 32U == 0) ? 0U : uint32_t(mantissa >> (64U - shift % 32U));
+        while ((num_limbs > 0) && (limbs_[num_limbs - 1U] == 0))
+        {
+            num_limbs--;
+        }
+        while (num_limbs > 2)
+        {
+            uint64_t remainder = 0;
+            for (unsigned i = num_limbs; i-- > 0;)
+            {
+                const uint64_t x = (remainder << 32) | limbs_[i];
+                limbs_[i] = uint32_t(x / ChunkBase);
+                remainder = x % ChunkBase;
+            }
+            while ((num_limbs > 0) && (limbs_[num_limbs - 1U] == 0))
+            {
+                num_limbs--;
+            }
+            UAVCAN_ASSERT(num_limbs < (NumLimbs - 1U - num_chunks_));       // The chunks must not overlap the value
+            storeChunk(uint32_t(remainder));
+        }
+        integer_part = (static_cast<unsigned long long>(limbs_[1]) << 32) | limbs_[0];
+        limbs_[0] = 0;
+        limbs_[1] = 0;
+    }
+    else
+    {
+        frac_bits_ = unsigned(-exponent);
+        UAVCAN_ASSERT(((frac_bits_ + 4U) / 32U + 1U) < (NumLimbs - 3U));  // The fraction can be multiplied by 10
+        const unsigned long long fraction =
+            (frac_bits_ < 64U) ? (mantissa & ((static_cast<unsigned long long>(1) << frac_bits_) - 1U)) : mantissa;
+        integer_part = (frac_bits_ < 64U) ? (mantissa >> frac_bits_) : 0U;
+        limbs_[0] = uint32_t(fraction);
+        limbs_[1] = uint32_t(fraction >> 32);
+        num_frac_limbs_ = 2;
+        trimFraction();
+    }
+
+    // At most three chunks are left, the lowest of the big integer ones have already been stored
+    while (integer_part > 0)
+    {
+        storeChunk(uint32_t(integer_part % ChunkBase));
+        integer_part /= ChunkBase;
+    }
+
+    if (num_chunks_ > 0)
+    {
+        num_chunks_--;
+        chunk_ = limbs_[NumLimbs - 1U - num_chunks_];
+        chunk_divisor_ = 1;
+        num_integer_digits_ = num_chunks_ * unsigned(ChunkDigits) + 1U;
+        while ((chunk_ / chunk_divisor_) >= 10U)
+        {
+            chunk_divisor_ *= 10U;
+            num_integer_digits_++;
+        }
+    }
+}
+
+unsigned DecimalExpansion::getNextDigit()
+{
+    if ((chunk_divisor_ == 0) && (num_chunks_ > 0))
+    {
+        num_chunks_--;
+        chunk_ = limbs_[NumLimbs - 1U - num_chunks_];
+        chunk_divisor_ = ChunkBase / 10U;
+    }
+    if (chunk_divisor_ > 0)
+    {
+        const unsigned digit = unsigned(chunk_ / chunk_divisor_);
+        chunk_ %= chunk_divisor_;
+        chunk_divisor_ /= 10U;
+        return digit;
+    }
+
+    if (num_frac_limbs_ == 0)
+    {
+        return 0;
+    }
+    // Multiplying the fraction by 10; the next digit is its integer part, i.e. the bits above frac_bits_
+    uint32_t carry = 0;
+    for (unsigned i = 0; i < num_frac_limbs_; i++)
+    {
+        const uint64_t x = uint64_t(limbs_[i]) * 10U + carry;
+        limbs_[i] = uint32_t(x);
+        carry = uint32_t(x >> 32);
+    }
+    if (carry > 0)
+    {
+        limbs_[num_frac_limbs_++] = carry;
+    }
+    const unsigned index = frac_bits_ / 32U;
+    const unsigned shift = frac_bits_ % 32U;
+    uint64_t window = (index < num_frac_limbs_) ? limbs_[index] : 0U;
+    if ((index + 1U) < num_frac_limbs_)
+    {
+        window |= uint64_t(limbs_[index + 1U]) << 32;
+    }
+    if (index < num_frac_limbs_)
+    {
+        limbs_[index] &= (uint32_t(1) << shift) - 1U;
+        num_frac_limbs_ = index + 1U;
+    }
+    trimFraction();
+    const unsigned digit = unsigned(window >> shift);
+    UAVCAN_ASSERT(digit < 10U);
+    return digit;
+}
+
+bool DecimalExpansion::isExhausted() const
+{
+    if ((chunk_ > 0) || (num_frac_limbs_ > 0))
+    {
+        return false;
+    }
+    for (unsigned i = 0; i < num_chunks_; i++)
+    {
+        if (limbs_[NumLimbs - 1U - i] > 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Like printf(), rounds the digits to nearest, ties to even; the discarded digits are taken from the expansion.
+ * Returns true if the digits were all nines, in which case they are all zeros now and the value is a power of 10.
+ */
+bool roundDigits(char* digits, unsigned num_digits, DecimalExpansion& expansion)
+{
+    const unsigned next_digit = expansion.getNextDigit();
+    const bool last_digit_odd = (num_digits > 0) && (((digits[num_digits - 1U] - '0') & 1) != 0);
+    if ((next_digit < 5U) || ((next_digit == 5U) && !last_digit_odd && expansion.isExhausted()))
+    {
+        return false;
+    }
+    for (unsigned i = num_digits; i-- > 0;)
+    {
+        if (digits[i] != '9')
+        {
+            digits[i]++;
+            return false;
+        }
+        digits[i] = '0';
+    }
+    return true;
+}
+
+/**
+ * Writes the digits in reverse order; returns the number of digits, which is at least one.
+ * 32-bit division is much cheaper than 64-bit on the targets that lack the hardware support for the latter.
+ */
+unsigned writeDigitsReversed(unsigned long long value, unsigned base, bool uppercase, char* out)
+{
+    const char* const digits = uppercase ? "0123456789ABCDEF" : "0123456789abcdef";
+    unsigned n = 0;
+    while (value > 0xFFFFFFFFU)
+    {
+        out[n++] = digits[value % base];
+        value /= base;
+    }
+    uint32_t value32 = uint32_t(value);
+    do
+    {
+        out[n++] = digits[value32 % base];
+        value32 /= base;
+    }
+    while (value32 > 0);
+    return n;
+}
+
+/**
+ * Writes exactly num_digits decimal digits, with leading zeros if necessary.
+ */
+unsigned writeDecimalDigits(unsigned long long value, unsigned num_digits, char* out)
+{
+    char reversed[24];
+    unsigned n = writeDigitsReversed(value, 10, false, reversed);
+    while (n < num_digits)
+    {
+        reversed[n++] = '0';
+    }
+    for (unsigned i = 0; i < n; i++)
+    {
+        out[i] = reversed[n - i - 1];
+    }
+    return n;
+}
+
+/**
+ * Writes the requested number of significant digits of a non-negative finite value, and returns the decimal
+ * exponent of the first digit.
+ */
+int getSignificantDigits(double value, unsigned num_digits, char* out_digits)
+{
+    UAVCAN_ASSERT((num_digits > 0) && (num_digits <= MaxSignificantDigits));
+    fill(out_digits, out_digits + num_digits, '0');
+    if (!(value > 0.0))
+    {
+        return 0;
+    }
+
+    DecimalExpansion expansion(value);
+    int exponent = int(expansion.getNumIntegerDigits()) - 1;
+    unsigned digit = expansion.getNextDigit();
+    while (digit == 0)                  // Leading zeros of the fraction
+    {
+        digit = expansion.getNextDigit();
+        exponent--;
+    }
+    out_digits[0] = char('0' + digit);
+    for (unsigned i = 1; i < num_digits; i++)
+    {
+        out_digits[i] = char('0' + expansion.getNextDigit());
+    }
+    if (roundDigits(out_digits, num_digits, expansion))
+    {
+        out_digits[0] = '1';            // Rounded up to the next power of 10, e.g. 9.9999999 --> 10.0000
+        exponent++;
+    }
+    return exponent;
+}
+
+/**
+ * The g conversion removes the trailing zeros of the fractional part, along with the decimal point if
+ * nothing is left.
+ */
+unsigned removeTrailingZeros(char* body, unsigned len)
+{
+    bool has_point = false;
+    for (unsigned i = 0; i < len; i++)
+    {
+        has_point = has_point || (body[i] == '.');
+    }
+    if (!has_point)
+    {
+        return len;
+    }
+    while ((len > 0) && (body[len - 1] == '0'))
+    {
+        len--;
+    }
+    if ((len > 0) && (body[len - 1] == '.'))
+    {
+        len--;
+    }
+    return len;
+}
+
+}
+
+const char* CharFormatSpec::parse(const char* s)
+{
+    UAVCAN_ASSERT(s != NULL);
+    for (;; s++)
+    {
+        if (*s == '-')      { left_align = true; }
+        else if (*s == '0') { zero_pad = true; }
+        else if (*s == '+') { force_sign = true; }
+        else if (*s == ' ') { space_sign = true; }
+        else if (*s == '#') { alternate_form = true; }
+        else                { break; }
+    }
+
+    unsigned w = 0;
+    while ((*s >= '0') && (*s <= '9'))
+    {
+        w = min(w * 10U + unsigned(*s++ - '0'), unsigned(MaxFieldWidth));
+    }
+    width = uint8_t(w);
+
+    if (*s == '.')
+    {
+        s++;
+        has_precision = true;
+        unsigned p = 0;
+        while ((*s >= '0') && (*s <= '9'))
+        {
+            p = min(p * 10U + unsigned(*s++ - '0'), 255U);
+        }
+        precision = uint8_t(p);
+    }
+
+    while ((*s == 'h') || (*s == 'l') || (*s == 'L') || (*s == 'j') || (*s == 'z') || (*s == 't') || (*s == 'q'))
+    {
+        s++;
+    }
+
+    conversion = *s;
+    return (*s == '\0') ? s : (s + 1);
+}
+
+unsigned CharFormatSpec::assemble(const char* prefix, const char* body, unsigned body_len, bool zero_pad_allowed,
+                                  char* out) const
+{
+    unsigned prefix_len = 0;
+    while (prefix[prefix_len] != '\0')
+    {
+        prefix_len++;
+    }
+    const unsigned len = prefix_len + body_len;
+    UAVCAN_ASSERT(len <= MaxOutputLength);
+    const unsigned padding = (width > len) ? (width - len) : 0U;
+
+    unsigned n = 0;
+    if (!left_align && !(zero_pad && zero_pad_allowed))
+    {
+        fill(out, out + padding, ' ');
+        n += padding;
+    }
+    copy(prefix, prefix + prefix_len, out + n);
+    n += prefix_len;
+    if (!left_align && zero_pad && zero_pad_allowed)
+    {
+        fill(out + n, out + n + padding, '0');
+        n += padding;
+    }
+    copy(body, body + body_len, out + n);
+    n += body_len;
+    if (left_align)
+    {
+        fill(out + n, out + n + padding, ' ');
+        n += padding;
+    }
+    return n;
+}
+
+unsigned CharFormatSpec::formatUnsigned(unsigned long long value, char* out) const
+{
+    const unsigned base = ((conversion == 'x') || (conversion == 'X')) ? 16U : ((conversion == 'o') ? 8U : 10U);
+
+    char reversed[24];
+    unsigned num_digits = writeDigitsReversed(value, base, conversion == 'X', reversed);
+    if (has_precision && (precision == 0) && (value == 0))
+    {
+        num_digits = 0;                                 // Like printf(), zero with zero precision is empty
+    }
+
+    const unsigned min_digits = has_precision ? min(unsigned(precision), unsigned(MaxFieldWidth)) : 1U;
+    char body[MaxFieldWidth];
+    unsigned body_len = 0;
+    while ((body_len + num_digits) < min_digits)
+    {
+        body[body_len++] = '0';
+    }
+    const bool leading_zero = (body_len > 0) || ((num_digits > 0) && (reversed[num_digits - 1] == '0'));
+    if ((base == 8) && alternate_form && !leading_zero)
+    {
+        body[body_len++] = '0';
+    }
+    for (unsigned i = 0; i < num_digits; i++)
+    {
+        body[body_len++] = reversed[num_digits - i - 1];
+    }
+
+    const char* prefix = "";
+    if ((base == 16) && alternate_form && (value != 0))
+    {
+        prefix = (conversion == 'X') ? "0X" : "0x";
+    }
+    return assemble(prefix, body, body_len, !has_precision, out);
+}
+
+unsigned CharFormatSpec::formatSigned(long long value, unsigned type_size, char* out) const
+{
+    if ((conversion == 'x') || (conversion == 'X') || (conversion == 'o') || (conversion == 'u'))
+    {
+        unsigned long long bits = static_cast<unsigned long long>(value);
+        if (type_size < sizeof(bits))
+        {
+            bits &= (static_cast<unsigned long long>(1) << (type_size * 8U)) - 1U;  // Two's complement of the type
+        }
+        return formatUnsigned(bits, out);
+    }
+
+    const bool negative = value < 0;
+    const unsigned long long magnitude =
+        negative ? (~static_cast<unsigned long long>(value) + 1U) : static_cast<unsigned long long>(value);
+
+    char body[MaxOutputLength];
+    CharFormatSpec unsigned_spec(*this);
+    unsigned_spec.width = 0;
+    unsigned_spec.conversion = 'u';
+    const unsigned body_len = unsigned_spec.formatUnsigned(magnitude, body);
+
+    const char* const prefix = negative ? "-" : (force_sign ? "+" : (space_sign ? " " : ""));
+    return assemble(prefix, body, body_len, !has_precision, out);
+}
+
+unsigned CharFormatSpec::formatFloat(double value, char* out) const
+{
+    const bool uppercase = (conversion == 'F') || (conversion == 'E') || (conversion == 'G');
+    const bool negative = value < 0.0;
+    const char* const prefix = negative ? "-" : (force_sign ? "+" : (space_sign ? " " : ""));
+
+    if (isNaN(value))
+    {
+        return assemble("", uppercase ? "NAN" : "nan", 3, false, out);
+    }
+    if (isInfinity(value))
+    {
+        return assemble(prefix, uppercase ? "INF" : "inf", 3, false, out);
+    }
+
+    const double magnitude = negative ? -value : value;
+    const bool general = !((conversion == 'f') || (conversion == 'F') || (conversion == 'e') || (conversion == 'E'));
+
+    char body[MaxOutputLength];
+    unsigned body_len = 0;
+
+    if (((conversion == 'f') || (conversion == 'F')) && (magnitude < FixedNotationLimit))
+    {
+        const unsigned prec = has_precision ? min(unsigned(precision), MaxSignificantDigits) : 6U;
+        DecimalExpansion expansion(magnitude);
+
+        // The integer part has at most 17 digits, one more may appear after rounding
+        char digits[MaxSignificantDigits * 2U + 1U];
+        unsigned num_integer_digits = max(expansion.getNumIntegerDigits(), 1U);
+        unsigned num_digits = 0;
+        if (expansion.getNumIntegerDigits() == 0)
+        {
+            digits[num_digits++] = '0';
+        }
+        while (num_digits < (num_integer_digits + prec))
+        {
+            digits[num_digits++] = char('0' + expansion.getNextDigit());
+        }
+        // Without the fractional part, the last integer digit decides how the ties are rounded
+        if (roundDigits(digits, num_digits, expansion))
+        {
+            digits[num_digits++] = '0';
+            digits[0] = '1';
+            num_integer_digits++;
+        }
+
+        copy(digits, digits + num_integer_digits, body);
+        body_len = num_integer_digits;
+        if ((prec > 0) || alternate_form)
+        {
+            body[body_len++] = '.';
+        }
+        copy(digits + num_integer_digits, digits + num_digits, body + body_len);
+        body_len += num_digits - num_integer_digits;
+        return assemble(prefix, body, body_len, true, out);
+    }
+
+    /*
+     * Exponential notation and the g conversion are produced from the same significant digits
+     */
+    unsigned num_digits = has_precision ? unsigned(precision) : 6U;
+    if (general)
+    {
+        num_digits = max(num_digits, 1U);
+    }
+    else
+    {
+        num_digits++;                                   // The digit before the decimal point
+    }
+    num_digits = min(num_digits, MaxSignificantDigits);
+
+    char digits[MaxSignificantDigits];
+    const int exponent = getSignificantDigits(magnitude, num_digits, digits);
+
+    const bool fixed_notation = general && (exponent >= -4) && (exponent < int(num_digits));
+    if (fixed_notation)
+    {
+        if (exponent >= 0)
+        {
+            const unsigned num_integer_digits = unsigned(exponent) + 1U;
+            copy(digits, digits + num_integer_digits, body);
+            body_len = num_integer_digits;
+            if ((num_digits > num_integer_digits) || alternate_form)
+            {
+                body[body_len++] = '.';
+            }
+            copy(digits + num_integer_digits, digits + num_digits, body + body_len);
+            body_len += num_digits - num_integer_digits;
+        }
+        else
+        {
+            body[body_len++] = '0';
+            body[body_len++] = '.';
+            for (int i = -1; i > exponent; i--)
+            {
+                body[body_len++] = '0';
+            }
+            copy(digits, digits + num_digits, body + body_len);
+            body_len += num_digits;
+        }
+    }
+    else
+    {
+        body[body_len++] = digits[0];
+        if ((num_digits > 1) || alternate_form)
+        {
+            body[body_len++] = '.';
+        }
+        copy(digits + 1, digits + num_digits, body + body_len);
+        body_len += num_digits - 1U;
+    }
+
+    if (general && !alternate_form)
+    {
+        body_len = removeTrailingZeros(body, body_len);
+    }
+
+    if (!fixed_notation)
+    {
+        body[body_len++] = uppercase ? 'E' : 'e';
+        body[body_len++] = (exponent < 0) ? '-' : '+';
+        const unsigned abs_exponent = unsigned((exponent < 0) ? -exponent : exponent);
+        body_len += writeDecimalDigits(abs_exponent, 2, body + body_len);
+    }
+
+    return assemble(prefix, body, body_len, true, out);
+}
+
+unsigned CharFormatSpec::formatPointer(const void* value, char* out) const
+{
+    char reversed[24];
+    const unsigned num_digits = writeDigitsReversed(reinterpret_cast<unsigned long long>(value), 16, false, reversed);
+    char body[24];
+    for (unsigned i = 0; i < num_digits; i++)
+    {
+        body[i] = reversed[num_digits - i - 1];
+    }
+    return assemble("0x", body, num_digits, false, out);
+}
+
+unsigned CharFormatSpec::getStringLength(const char* s) const
+{
+    const unsigned max_len = has_precision ? unsigned(precision) : NumericTraits<unsigned>::max();
+    unsigned len = 0;
+    while ((len < max_len) && (s[len] != '\0'))
+    {
+        len++;
+    }
+    return len;
+}
+
+}
@@ -5,12 +5,95 @@
 #include <uavcan/marshal/float_spec.hpp>
 #include <uavcan/build_config.hpp>
 #include <cmath>
+#include <cstring>
+
+#define UAVCAN_FLOAT16_HARDWARE (UAVCAN_USE_HARDWARE_FLOAT16_CONVERSION && !UAVCAN_USE_EXTERNAL_FLOAT16_CONVERSION)
+
+#if UAVCAN_FLOAT16_HARDWARE && defined(__F16C__)
+# define UAVCAN_FLOAT16_F16C 1
+# include <immintrin.h>
+#else
+# define UAVCAN_FLOAT16_F16C 0
+#endif
+
+#if UAVCAN_FLOAT16_HARDWARE && !UAVCAN_FLOAT16_F16C && defined(__aarch64__) && defined(__ARM_NEON)
+# define UAVCAN_FLOAT16_NEON 1
+# include <arm_neon.h>
+#else
+# define UAVCAN_FLOAT16_NEON 0
+#endif
+
+// ARMv7 FPU with the half-precision extension, e.g. Cortex-M4F/M7
+#if UAVCAN_FLOAT16_HARDWARE && !UAVCAN_FLOAT16_F16C && !UAVCAN_FLOAT16_NEON && \
+    defined(__ARM_FP) && (__ARM_FP & 2) && defined(__ARM_FP16_FORMAT_IEEE)
+# define UAVCAN_FLOAT16_FPU 1
+#else
+# define UAVCAN_FLOAT16_FPU 0
+#endif
 
 namespace uavcan
 {
+#if UAVCAN_FLOAT16_F16C || UAVCAN_FLOAT16_NEON || UAVCAN_FLOAT16_FPU
+namespace
+{
+/*
+ * The library encodes all NaNs as 0x7FFF (keeping the sign), whereas the hardware keeps the payload
+ */
+const uint16_t HalfNaNBits = 0x7FFFU;
+
+#if UAVCAN_FLOAT16_F16C
+
+inline uint16_t hardwareFloatToHalf(float value)
+{
+    const uint16_t out = uint16_t(_cvtss_sh(value, _MM_FROUND_TO_NEAREST_INT));
+    return isNaN(value) ? uint16_t(out | HalfNaNBits) : out;
+}
+
+inline float hardwareHalfToFloat(uint16_t value)
+{
+    return _cvtsh_ss(value);
+}
+
+#elif UAVCAN_FLOAT16_NEON || UAVCAN_FLOAT16_FPU
+
+inline uint16_t hardwareFloatToHalf(float value)
+{
+    const __fp16 half = static_cast<__fp16>(value);
+    uint16_t out = 0;
+    (void)std::memcpy(&out, &half, sizeof(out));
+    return isNaN(value) ? uint16_t(out | HalfNaNBits) : out;
+}
+
+inline float hardwareHalfToFloat(uint16_t value)
+{
+    __fp16 half;
+    (void)std::memcpy(&half, &value, sizeof(half));
+    return static_cast<float>(half);
+}
+
+#endif
+}
+#endif
 
 #if !UAVCAN_USE_EXTERNAL_FLOAT16_CONVERSION
 
+#if UAVCAN_FLOAT16_F16C || UAVCAN_FLOAT16_NEON || UAVCAN_FLOAT16_FPU
+
+/*
+ * IEEE754Converter
+ */
+uint16_t IEEE754Converter::nativeIeeeToHalf(float value)
+{
+    return hardwareFloatToHalf(value);
+}
+
+float IEEE754Converter::halfToNativeIeee(uint16_t value)
+{
+    return hardwareHalfToFloat(value);
+}
+
+#else
+
 union Fp32
 {
     uint32_t u;
@@ -23,14 +106,14 @@ union Fp32
 uint16_t IEEE754Converter::nativeIeeeToHalf(float value)
 {
     /*
-     * https://gist.github.com/rygorous/2156668
+     * https://gist.github.com/rygorous/2156668 (float_to_half_fast3_rtne)
      * Public domain, by Fabian "ryg" Giesen
+     * Rounds exact ties to even, like the hardware conversion instructions.
      */
     const Fp32 f32infty = { 255U << 23 };
-    const Fp32 f16infty = { 31U << 23 };
-    const Fp32 magic = { 15U << 23 };
+    const Fp32 f16max = { (127U + 16U) << 23 };
+    const Fp32 denorm_magic = { ((127U - 15U) + (23U - 10U) + 1U) << 23 };
     const uint32_t sign_mask = 0x80000000U;
-    const uint32_t round_mask = ~0xFFFU;
 
     Fp32 in;
     uint16_t out;
@@ -40,20 +123,23 @@ uint16_t IEEE754Converter::nativeIeeeToHalf(float value)
     uint32_t sign = in.u & sign_mask;
     in.u ^= sign;
 
-    if (in.u >= f32infty.u) /* Inf or NaN (all exponent bits set) */
+    if (in.u >= f16max.u) /* Result is Inf or NaN (all exponent bits set) */
     {
         /* NaN->sNaN and Inf->Inf */
         out = (in.u > f32infty.u) ? 0x7FFFU : 0x7C00U;
     }
-    else /* (De)normalized number or zero */
+    else if (in.u < (113U << 23)) /* Denormalized result or zero */
+    {
+        /* The FPU aligns the mantissa and rounds it to nearest even */
+        in.f += denorm_magic.f;
+        out = uint16_t(in.u - denorm_magic.u);
+    }
+    else /* Normalized result */
     {
-        in.u &= round_mask;
-        in.f *= magic.f;
-        in.u -= round_mask;
-        if (in.u > f16infty.u)
-        {
-            in.u = f16infty.u; /* Clamp to signed infinity if overflowed */
-        }
+        const uint32_t mant_odd = (in.u >> 13) & 1U; /* Resulting mantissa is odd */
+
+        in.u -= (127U - 15U) << 23;     /* Exponent adjust */
+        in.u += 0xFFFU + mant_odd;      /* Round to nearest even */
 
         out = uint16_t(in.u >> 13); /* Take the bits! */
     }
@@ -84,6 +170,58 @@ float IEEE754Converter::halfToNativeIeee(uint16_t value)
     return out.f;
 }
 
+#endif
+
 #endif // !UAVCAN_USE_EXTERNAL_FLOAT16_CONVERSION
 
+void IEEE754Converter::convertToHalf(const float* src, uint16_t* dst, unsigned count)
+{
+#if UAVCAN_FLOAT16_F16C
+    const __m128i nan_bits = _mm_set1_epi16(short(HalfNaNBits));
+    for (; count >= 8; count -= 8, src += 8, dst += 8)
+    {
+        const __m256 in = _mm256_loadu_ps(src);
+        const __m256i nan_mask = _mm256_castps_si256(_mm256_cmp_ps(in, in, _CMP_UNORD_Q));
+        const __m128i nan_mask16 = _mm_packs_epi32(_mm256_castsi256_si128(nan_mask),
+                                                   _mm256_extractf128_si256(nan_mask, 1));
+        const __m128i out = _mm_or_si128(_mm256_cvtps_ph(in, _MM_FROUND_TO_NEAREST_INT),
+                                         _mm_and_si128(nan_mask16, nan_bits));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), out);
+    }
+#elif UAVCAN_FLOAT16_NEON
+    const uint16x4_t nan_bits = vdup_n_u16(HalfNaNBits);
+    for (; count >= 4; count -= 4, src += 4, dst += 4)
+    {
+        const float32x4_t in = vld1q_f32(src);
+        const uint16x4_t nan_mask16 = vmvn_u16(vmovn_u32(vceqq_f32(in, in)));
+        const uint16x4_t out = vorr_u16(vreinterpret_u16_f16(vcvt_f16_f32(in)), vand_u16(nan_mask16, nan_bits));
+        vst1_u16(dst, out);
+    }
+#endif
+    // The remainder, or everything if there are no vector instructions
+    for (; count > 0; count--)
+    {
+        *dst++ = nativeIeeeToHalf(*src++);
+    }
+}
+
+void IEEE754Converter::convertFromHalf(const uint16_t* src, float* dst, unsigned count)
+{
+#if UAVCAN_FLOAT16_F16C
+    for (; count >= 8; count -= 8, src += 8, dst += 8)
+    {
+        _mm256_storeu_ps(dst, _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src))));
+    }
+#elif UAVCAN_FLOAT16_NEON
+    for (; count >= 4; count -= 4, src += 4, dst += 4)
+    {
+        vst1q_f32(dst, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(src))));
+    }
+#endif
+    for (; count > 0; count--)
+    {
+        *dst++ = halfToNativeIeee(*src++);
+    }
+}
+
 }
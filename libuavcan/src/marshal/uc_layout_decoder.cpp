@@ -0,0 +1,515 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <uavcan/build_config.hpp>
+
+#if !UAVCAN_TINY
+
+#include <uavcan/marshal/layout_decoder.hpp>
+#include <uavcan/marshal/scalar_codec.hpp>
+#include <uavcan/marshal/float_spec.hpp>
+#include <cstring>
+
+namespace uavcan
+{
+/*
+ * DataTypeLayoutDatabase
+ */
+const unsigned DataTypeLayoutDatabase::HeaderSize;
+const unsigned DataTypeLayoutDatabase::IndexEntrySize;
+const uint8_t DataTypeLayoutDatabase::FormatVersion;
+
+int DataTypeLayoutDatabase::parseRecord(unsigned index, DataTypeLayout& out_layout) const
+{
+    const uint8_t* const entry = data_ + HeaderSize + index * IndexEntrySize;
+    const unsigned kind = entry[2];
+    if ((kind != unsigned(DataTypeKindService)) && (kind != unsigned(DataTypeKindMessage)))
+    {
+        return -ErrInvalidParam;
+    }
+
+    unsigned pos = unsigned(readU16(entry + 4)) | (unsigned(readU16(entry + 6)) << 16);
+    if ((pos > size_) || ((size_ - pos) < 9U))
+    {
+        return -ErrInvalidParam;
+    }
+
+    uint64_t signature = 0;
+    for (unsigned i = 0; i < 8; i++)
+    {
+        signature |= uint64_t(data_[pos + i]) << (i * 8U);
+    }
+    pos += 8;
+
+    const unsigned name_len = data_[pos++];
+    if (((size_ - pos) < (name_len + 1U)) || (data_[pos + name_len] != '\0'))
+    {
+        return -ErrInvalidParam;
+    }
+    out_layout.full_name_ = reinterpret_cast<const char*>(data_ + pos);
+    pos += name_len + 1U;
+
+    out_layout.code_[1] = NULL;
+    out_layout.code_len_[1] = 0;
+    const unsigned num_codes = (kind == unsigned(DataTypeKindService)) ? 2U : 1U;
+    for (unsigned i = 0; i < num_codes; i++)
+    {
+        if ((size_ - pos) < 2U)
+        {
+            return -ErrInvalidParam;
+        }
+        const uint16_t code_len = readU16(data_ + pos);
+        pos += 2;
+        if ((size_ - pos) < code_len)
+        {
+            return -ErrInvalidParam;
+        }
+        out_layout.code_[i] = data_ + pos;
+        out_layout.code_len_[i] = code_len;
+        pos += code_len;
+    }
+
+    out_layout.signature_ = DataTypeSignature(signature);
+    out_layout.default_dtid_ = readU16(entry);
+    out_layout.kind_ = DataTypeKind(kind);
+    return 0;
+}
+
+int DataTypeLayoutDatabase::init(const uint8_t* data, unsigned size)
+{
+    data_ = NULL;
+    size_ = 0;
+    num_types_ = 0;
+
+    if ((data == NULL) || (size < HeaderSize) || (std::memcmp(data, "ULDB", 4) != 0) || (data[4] != FormatVersion))
+    {
+        return -ErrInvalidParam;
+    }
+    const unsigned num_types = readU16(data + 6);
+    if (size < (HeaderSize + num_types * IndexEntrySize))
+    {
+        return -ErrInvalidParam;
+    }
+
+    data_ = data;
+    size_ = size;
+    num_types_ = num_types;
+
+    /*
+     * All records and the order of the index are validated here, so the lookups don't need to check anything
+     */
+    unsigned prev_key = 0;
+    for (unsigned i = 0; i < num_types; i++)
+    {
+        DataTypeLayout layout;
+        const int res = parseRecord(i, layout);
+        const unsigned key = (unsigned(layout.getKind()) << 16) | layout.default_dtid_;
+        if ((res < 0) || (key < prev_key))
+        {
+            data_ = NULL;
+            size_ = 0;
+            num_types_ = 0;
+            return -ErrInvalidParam;
+        }
+        prev_key = key;
+    }
+    return 0;
+}
+
+bool DataTypeLayoutDatabase::getLayout(unsigned index, DataTypeLayout& out_layout) const
+{
+    return (index < num_types_) && (parseRecord(index, out_layout) >= 0);
+}
+
+bool DataTypeLayoutDatabase::find(DataTypeKind kind, DataTypeID dtid, DataTypeLayout& out_layout) const
+{
+    if (dtid.get() == DataTypeLayout::NoDefaultDataTypeID)
+    {
+        return false;
+    }
+    const unsigned key = (unsigned(kind) << 16) | dtid.get();
+
+    unsigned low = 0;
+    unsigned high = num_types_;
+    while (low < high)
+    {
+        const unsigned mid = low + (high - low) / 2U;
+        const uint8_t* const entry = data_ + HeaderSize + mid * IndexEntrySize;
+        const unsigned mid_key = (unsigned(entry[2]) << 16) | readU16(entry);
+        if (mid_key < key)
+        {
+            low = mid + 1U;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    if (low < num_types_)
+    {
+        const uint8_t* const entry = data_ + HeaderSize + low * IndexEntrySize;
+        if (((unsigned(entry[2]) << 16) | readU16(entry)) == key)
+        {
+            return getLayout(low, out_layout);
+        }
+    }
+    return false;
+}
+
+bool DataTypeLayoutDatabase::find(const char* full_name, DataTypeLayout& out_layout) const
+{
+    if (full_name == NULL)
+    {
+        return false;
+    }
+    for (unsigned i = 0; i < num_types_; i++)
+    {
+        if (getLayout(i, out_layout) && (std::strcmp(out_layout.getFullName(), full_name) == 0))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * LayoutDecoder
+ */
+bool LayoutDecoder::readCode(const uint8_t*& pc, unsigned num_bytes, unsigned& out_value) const
+{
+    if (unsigned(code_end_ - pc) < num_bytes)
+    {
+        return false;
+    }
+    out_value = 0;
+    for (unsigned i = 0; i < num_bytes; i++)
+    {
+        out_value |= unsigned(*pc++) << (i * 8U);
+    }
+    return true;
+}
+
+bool LayoutDecoder::readBits(unsigned bitlen, uint64_t& out_value)
+{
+    if ((payload_bitlen_ - bit_offset_) < bitlen)
+    {
+        return false;
+    }
+    out_value = ScalarCodec::unpackBits(payload_, bit_offset_, bitlen);
+    bit_offset_ += bitlen;
+    return true;
+}
+
+int LayoutDecoder::skipToFieldValue(const uint8_t*& pc, const char*& out_name) const
+{
+    unsigned name_len = 0;
+    if (!readCode(pc, 1, name_len) || (unsigned(code_end_ - pc) < (name_len + 1U)) || (pc[name_len] != '\0'))
+    {
+        return -ErrInvalidParam;
+    }
+    out_name = reinterpret_cast<const char*>(pc);
+    pc += name_len + 1U;
+    return 0;
+}
+
+int LayoutDecoder::skipValue(const uint8_t*& pc, unsigned depth) const
+{
+    unsigned opcode = 0;
+    unsigned operand = 0;
+    if ((depth > unsigned(MaxNestingDepth)) || !readCode(pc, 1, opcode))
+    {
+        return -ErrInvalidParam;
+    }
+    switch (opcode)
+    {
+    case LayoutOpStruct:
+    case LayoutOpUnion:
+    {
+        unsigned num_fields = 0;
+        if (!readCode(pc, 1, num_fields) || ((opcode == LayoutOpUnion) && !readCode(pc, 1, operand)))
+        {
+            return -ErrInvalidParam;
+        }
+        for (unsigned i = 0; i < num_fields; i++)
+        {
+            const char* name = NULL;
+            int res = skipToFieldValue(pc, name);
+            if (res >= 0)
+            {
+                res = skipValue(pc, depth + 1U);
+            }
+            if (res < 0)
+            {
+                return res;
+            }
+        }
+        return 0;
+    }
+    case LayoutOpUnsigned:
+    case LayoutOpSigned:
+    case LayoutOpFloat:
+    case LayoutOpVoid:
+    {
+        return readCode(pc, 1, operand) ? 0 : -ErrInvalidParam;
+    }
+    case LayoutOpBool:
+    {
+        return 0;
+    }
+    case LayoutOpStaticArray:
+    {
+        return readCode(pc, 2, operand) ? skipValue(pc, depth + 1U) : -ErrInvalidParam;
+    }
+    case LayoutOpDynamicArray:
+    {
+        return readCode(pc, 4, operand) ? skipValue(pc, depth + 1U) : -ErrInvalidParam;
+    }
+    default:
+    {
+        return -ErrInvalidParam;
+    }
+    }
+}
+
+int LayoutDecoder::decodeValue(const uint8_t*& pc, const char* name, TailArrayOptimizationMode tao_mode,
+                               unsigned depth)
+{
+    unsigned opcode = 0;
+    if ((depth > unsigned(MaxNestingDepth)) || !readCode(pc, 1, opcode))
+    {
+        return -ErrInvalidParam;
+    }
+    switch (opcode)
+    {
+    case LayoutOpStruct:
+    {
+        return decodeStruct(pc, name, tao_mode, depth, false);
+    }
+    case LayoutOpUnion:
+    {
+        return decodeStruct(pc, name, tao_mode, depth, true);
+    }
+    case LayoutOpStaticArray:
+    {
+        return decodeArray(pc, name, tao_mode, depth, false);
+    }
+    case LayoutOpDynamicArray:
+    {
+        return decodeArray(pc, name, tao_mode, depth, true);
+    }
+    case LayoutOpBool:
+    {
+        uint64_t value = 0;
+        if (!readBits(1, value))
+        {
+            return -ErrInvalidMarshalData;
+        }
+        visitor_.onBool(name, value != 0);
+        return 0;
+    }
+    case LayoutOpUnsigned:
+    case LayoutOpSigned:
+    case LayoutOpFloat:
+    case LayoutOpVoid:
+    {
+        break;
+    }
+    default:
+    {
+        return -ErrInvalidParam;
+    }
+    }
+
+    /*
+     * Scalars
+     */
+    unsigned bitlen = 0;
+    if (!readCode(pc, 1, bitlen) || (bitlen == 0) || (bitlen > 64) ||
+        ((opcode == LayoutOpFloat) && (bitlen != 16) && (bitlen != 32) && (bitlen != 64)))
+    {
+        return -ErrInvalidParam;
+    }
+    uint64_t value = 0;
+    if (!readBits(bitlen, value))
+    {
+        return -ErrInvalidMarshalData;
+    }
+
+    if (opcode == LayoutOpUnsigned)
+    {
+        visitor_.onUnsigned(name, value);
+    }
+    else if (opcode == LayoutOpSigned)
+    {
+        if ((bitlen < 64) && ((value & (uint64_t(1) << (bitlen - 1U))) != 0))   // Negative, extending the sign
+        {
+            value |= ~((uint64_t(1) << bitlen) - 1U);
+        }
+        visitor_.onSigned(name, int64_t(value));
+    }
+    else if (opcode == LayoutOpFloat)
+    {
+        double native = 0.0;
+        if (bitlen == 16)
+        {
+            native = double(IEEE754Converter::toNative<16>(uint16_t(value)));
+        }
+        else if (bitlen == 32)
+        {
+            native = double(IEEE754Converter::toNative<32>(uint32_t(value)));
+        }
+        else
+        {
+            native = double(IEEE754Converter::toNative<64>(value));
+        }
+        visitor_.onFloat(name, native, bitlen);
+    }
+    else
+    {
+        ;   // Void fields are just skipped
+    }
+    return 0;
+}
+
+int LayoutDecoder::decodeStruct(const uint8_t*& pc, const char* name, TailArrayOptimizationMode tao_mode,
+                                unsigned depth, bool is_union)
+{
+    unsigned num_fields = 0;
+    unsigned tag_bitlen = 0;
+    if (!readCode(pc, 1, num_fields) ||
+        (is_union && (!readCode(pc, 1, tag_bitlen) || (num_fields == 0) || (tag_bitlen > 8))))
+    {
+        return -ErrInvalidParam;
+    }
+
+    visitor_.onBeginStruct(name, is_union);
+
+    /*
+     * Union tag is encoded without the tail array optimization, the selected field inherits the mode
+     */
+    uint64_t tag = 0;
+    if (is_union)
+    {
+        if (!readBits(tag_bitlen, tag) || (tag >= num_fields))
+        {
+            return -ErrInvalidMarshalData;
+        }
+    }
+
+    for (unsigned i = 0; i < num_fields; i++)
+    {
+        const char* field_name = NULL;
+        int res = skipToFieldValue(pc, field_name);
+        if (res < 0)
+        {
+            return res;
+        }
+        if (is_union)
+        {
+            res = (i == tag) ? decodeValue(pc, field_name, tao_mode, depth + 1U) : skipValue(pc, depth + 1U);
+        }
+        else
+        {
+            // Only the last field of a structure may use the tail array optimization
+            res = decodeValue(pc, field_name, ((i + 1U) == num_fields) ? tao_mode : TailArrayOptDisabled,
+                              depth + 1U);
+        }
+        if (res < 0)
+        {
+            return res;
+        }
+    }
+
+    visitor_.onEndStruct();
+    return 0;
+}
+
+int LayoutDecoder::decodeArray(const uint8_t*& pc, const char* name, TailArrayOptimizationMode tao_mode,
+                               unsigned depth, bool is_dynamic)
+{
+    unsigned size = 0;
+    unsigned length_bitlen = 0;
+    unsigned flags = 0;
+    if (!readCode(pc, 2, size) ||
+        (is_dynamic && (!readCode(pc, 1, length_bitlen) || !readCode(pc, 1, flags) || (length_bitlen > 16))))
+    {
+        return -ErrInvalidParam;
+    }
+
+    // The element is decoded repeatedly from the same bytecode, so its end is found beforehand
+    const uint8_t* const element_pc = pc;
+    const int skip_res = skipValue(pc, depth + 1U);
+    if (skip_res < 0)
+    {
+        return skip_res;
+    }
+
+    visitor_.onBeginArray(name);
+
+    unsigned count = 0;
+    if (is_dynamic && ((flags & LayoutArrayFlagTailOptimizable) != 0) && (tao_mode == TailArrayOptEnabled))
+    {
+        /*
+         * No length prefix - the elements take the rest of the payload, which is padded to a whole number of
+         * bytes; since the elements are at least 8 bits long, the padding can't be mistaken for an element
+         */
+        while ((payload_bitlen_ - bit_offset_) >= 8U)
+        {
+            if (count == size)
+            {
+                return -ErrInvalidMarshalData;
+            }
+            const uint8_t* element_pc_copy = element_pc;
+            const int res = decodeValue(element_pc_copy, "", TailArrayOptDisabled, depth + 1U);
+            if (res < 0)
+            {
+                return res;
+            }
+            count++;
+        }
+    }
+    else
+    {
+        if (is_dynamic)
+        {
+            uint64_t length = 0;
+            if (!readBits(length_bitlen, length) || (length > size))
+            {
+                return -ErrInvalidMarshalData;
+            }
+            size = unsigned(length);
+        }
+        // Same as in the generated code: the last element inherits the mode
+        for (; count < size; count++)
+        {
+            const uint8_t* element_pc_copy = element_pc;
+            const int res = decodeValue(element_pc_copy, "",
+                                        ((count + 1U) == size) ? tao_mode : TailArrayOptDisabled, depth + 1U);
+            if (res < 0)
+            {
+                return res;
+            }
+        }
+    }
+
+    visitor_.onEndArray(count);
+    return 0;
+}
+
+int LayoutDecoder::decode(const DataTypeLayout& layout, TransferType transfer_type,
+                          const uint8_t* payload, unsigned payload_len, ILayoutVisitor& visitor)
+{
+    const uint8_t* pc = layout.getCode(transfer_type);
+    if ((pc == NULL) || ((payload == NULL) && (payload_len > 0)))
+    {
+        return -ErrInvalidParam;
+    }
+    LayoutDecoder decoder(pc + layout.getCodeLength(transfer_type), payload, payload_len, visitor);
+    const int res = decoder.decodeValue(pc, "", TailArrayOptEnabled, 0);
+    return (res < 0) ? res : 0;
+}
+
+}
+
+#endif // !UAVCAN_TINY
@@ -7,6 +7,8 @@
 namespace uavcan
 {
 
+const unsigned ScalarCodec::MaxBlockChunkBits;
+
 void ScalarCodec::swapByteOrder(uint8_t* const bytes, const unsigned len)
 {
     UAVCAN_ASSERT(bytes);
@@ -43,4 +45,48 @@ int ScalarCodec::decodeBytesImpl(uint8_t* const bytes, const unsigned bitlen)
     return read_res;
 }
 
+int ScalarCodec::encodeBlock(const uint8_t* bytes, unsigned bitlen)
+{
+    UAVCAN_ASSERT(bytes);
+    if ((bitlen > 0) && (bitlen % 8 == 0) && stream_.isByteAligned())
+    {
+        return stream_.write(bytes, bitlen);        // Plain copy in one go
+    }
+    while (bitlen > 0)
+    {
+        // One byte is reserved for the bit offset of the stream, so that every chunk except the last one is still
+        // a whole number of bytes and the pointer can be advanced bytewise
+        const unsigned chunk = min(bitlen, MaxBlockChunkBits);
+        const int res = stream_.write(bytes, chunk);
+        if (res <= 0)
+        {
+            return res;
+        }
+        bytes += chunk / 8;
+        bitlen -= chunk;
+    }
+    return BitStream::ResultOk;
+}
+
+int ScalarCodec::decodeBlock(uint8_t* bytes, unsigned bitlen)
+{
+    UAVCAN_ASSERT(bytes);
+    if ((bitlen > 0) && (bitlen % 8 == 0) && stream_.isByteAligned())
+    {
+        return stream_.read(bytes, bitlen);
+    }
+    while (bitlen > 0)
+    {
+        const unsigned chunk = min(bitlen, MaxBlockChunkBits);
+        const int res = stream_.read(bytes, chunk);
+        if (res <= 0)
+        {
+            return res;
+        }
+        bytes += chunk / 8;
+        bitlen -= chunk;
+    }
+    return BitStream::ResultOk;
+}
+
 }
@@ -0,0 +1,204 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <uavcan/node/bus_load_monitor.hpp>
+#include <uavcan/debug.hpp>
+
+#if !UAVCAN_TINY
+
+namespace uavcan
+{
+
+BusCongestionLevel BusLoadMonitor::computeLevel(uint16_t load_permille, uint32_t num_tx_errors) const
+{
+    int level = estimate_.level;
+
+    // Going up immediately, possibly by several levels
+    while ((level + 1 < NumBusCongestionLevels) && (load_permille >= thresholds_[level]))
+    {
+        level++;
+    }
+
+    // Going down only when the load is below the threshold of the current level minus the hysteresis
+    while ((level > BusCongestionLevelNormal) &&
+           (int(load_permille) + int(hysteresis_) < int(thresholds_[level - 1])))
+    {
+        level--;
+    }
+
+    if ((num_tx_errors > 0) && (level < BusCongestionLevelHigh))
+    {
+        level = BusCongestionLevelHigh;
+    }
+    return BusCongestionLevel(level);
+}
+
+void BusLoadMonitor::handleRxFrame(const CanRxFrame& frame, CanIOFlags flags)
+{
+    if (frame.iface_index < MaxCanIfaces)
+    {
+        IfaceState& iface = ifaces_[frame.iface_index];
+        iface.num_bits += getFrameBitLength(frame.dlc);
+        if (flags & CanIOFlagLoopback)
+        {
+            iface.num_loopback_frames++;
+        }
+    }
+    if (next_listener_ != NULL)
+    {
+        next_listener_->handleRxFrame(frame, flags);
+    }
+}
+
+void BusLoadMonitor::handleTimerEvent(const TimerEvent& event)
+{
+    const uint64_t dt_usec = uint64_t((event.real_time - prev_update_).toUSec());
+    prev_update_ = event.real_time;
+    if (dt_usec == 0)
+    {
+        return;
+    }
+    const uint64_t capacity_bits = (uint64_t(bitrate_) * dt_usec) / 1000000U;
+
+    const CanIOManager& canio = node_.getDispatcher().getCanIOManager();
+    const unsigned max_frame_bits = getFrameBitLength(CanFrame::MaxDataLen);
+
+    BusLoadEstimate estimate = estimate_;
+    estimate.timestamp = event.real_time;
+    estimate.max_load_permille = 0;
+    estimate.num_tx_errors = 0;
+
+    for (uint8_t i = 0; i < canio.getNumIfaces(); i++)
+    {
+        IfaceState& iface = ifaces_[i];
+        const CanIfacePerfCounters cnt = canio.getIfacePerfCounters(i);
+
+        // The loopback frames have been counted by the listener already
+        const uint64_t frames_tx = cnt.frames_tx - iface.prev_frames_tx;
+        const uint64_t frames_tx_unseen = (frames_tx > iface.num_loopback_frames) ?
+                                          (frames_tx - iface.num_loopback_frames) : 0U;
+        const uint64_t bits = iface.num_bits + frames_tx_unseen * max_frame_bits;
+
+        const uint64_t sample = (capacity_bits > 0) ? min((bits * 1000U) / capacity_bits, uint64_t(0xFFFFU)) :
+                                                      uint64_t(0xFFFFU);
+
+        // Exponential moving average with the weight of the new sample of 1/4
+        const uint16_t load = uint16_t((uint64_t(estimate.iface_load_permille[i]) * 3U + sample + 2U) / 4U);
+        estimate.iface_load_permille[i] = load;
+        estimate.max_load_permille = max(estimate.max_load_permille, load);
+        estimate.num_tx_errors += uint32_t(cnt.errors - iface.prev_errors);
+
+        iface.num_bits = 0;
+        iface.num_loopback_frames = 0;
+        iface.prev_frames_tx = cnt.frames_tx;
+        iface.prev_errors = cnt.errors;
+    }
+
+    estimate.level = computeLevel(estimate.max_load_permille, estimate.num_tx_errors);
+    const bool level_changed = estimate.level != estimate_.level;
+    estimate_ = estimate;
+
+    if (level_changed)
+    {
+        UAVCAN_TRACE("BusLoadMonitor", "Congestion level %i, load %u permille, %u TX errors",
+                     int(estimate_.level), unsigned(estimate_.max_load_permille), unsigned(estimate_.num_tx_errors));
+        IBusCongestionListener* p = listeners_.get();
+        while (p != NULL)
+        {
+            IBusCongestionListener* const next = p->getNextListNode();
+            p->handleBusCongestionLevelChange(estimate_);     // p may be removed
+            p = next;
+        }
+    }
+}
+
+int BusLoadMonitor::start(uint32_t bitrate, MonotonicDuration update_interval)
+{
+    if (bitrate == 0 || !update_interval.isPositive())
+    {
+        return -ErrInvalidParam;
+    }
+    stop();
+
+    Dispatcher& dispatcher = node_.getDispatcher();
+    const CanIOManager& canio = dispatcher.getCanIOManager();
+    for (uint8_t i = 0; i < canio.getNumIfaces(); i++)
+    {
+        const CanIfacePerfCounters cnt = canio.getIfacePerfCounters(i);
+        ifaces_[i] = IfaceState();
+        ifaces_[i].prev_frames_tx = cnt.frames_tx;
+        ifaces_[i].prev_errors = cnt.errors;
+    }
+
+    bitrate_ = bitrate;
+    estimate_ = BusLoadEstimate();
+    prev_update_ = node_.getMonotonicTime();
+
+    next_listener_ = dispatcher.getRxFrameListener();
+    dispatcher.installRxFrameListener(this);
+    TimerBase::startPeriodic(update_interval);
+    started_ = true;
+    return 0;
+}
+
+void BusLoadMonitor::stop()
+{
+    if (!started_)
+    {
+        return;
+    }
+    TimerBase::stop();
+
+    Dispatcher& dispatcher = node_.getDispatcher();
+    if (dispatcher.getRxFrameListener() == this)
+    {
+        if (next_listener_ != NULL)
+        {
+            dispatcher.installRxFrameListener(next_listener_);
+        }
+        else
+        {
+            dispatcher.removeRxFrameListener();
+        }
+    }
+    next_listener_ = NULL;
+    started_ = false;
+}
+
+int BusLoadMonitor::setThresholds(uint16_t elevated_permille, uint16_t high_permille, uint16_t critical_permille)
+{
+    if (elevated_permille == 0 || elevated_permille > high_permille || high_permille > critical_permille)
+    {
+        return -ErrInvalidParam;
+    }
+    thresholds_[0] = elevated_permille;
+    thresholds_[1] = high_permille;
+    thresholds_[2] = critical_permille;
+    return 0;
+}
+
+void BusLoadMonitor::addCongestionListener(IBusCongestionListener* listener)
+{
+    if (listener == NULL)
+    {
+        UAVCAN_ASSERT(0);
+        return;
+    }
+    listeners_.remove(listener);
+    IBusCongestionListener* last = listeners_.get();
+    while (last != NULL && last->getNextListNode() != NULL)
+    {
+        last = last->getNextListNode();
+    }
+    listeners_.insertNewAfter(last, listener);
+}
+
+void BusLoadMonitor::removeCongestionListener(IBusCongestionListener* listener)
+{
+    listeners_.remove(listener);
+}
+
+}
+
+#endif
@@ -3,6 +3,7 @@
  */
 
 #include <uavcan/node/generic_publisher.hpp>
+#include <uavcan/node/tx_completion_monitor.hpp>
 
 namespace uavcan
 {
@@ -38,19 +39,86 @@ MonotonicTime GenericPublisherBase::getTxDeadline() const
     return node_.getMonotonicTime() + tx_timeout_;
 }
 
-int GenericPublisherBase::genericPublish(const StaticTransferBufferImpl& buffer, TransferType transfer_type,
-                                         NodeID dst_node_id, TransferID* tid, MonotonicTime blocking_deadline)
+int GenericPublisherBase::genericPublish(OutgoingTransferBufferImpl& buffer, TransferType transfer_type,
+                                         NodeID dst_node_id, TransferID* tid, MonotonicTime blocking_deadline,
+                                         MonotonicTime published_at)
 {
+    if (!shaper_.tryConsume(buffer.getMaxWritePos(), published_at))
+    {
+        UAVCAN_TRACE("GenericPublisher", "Rate limited, %u bytes", unsigned(buffer.getMaxWritePos()));
+        if (rate_limited_cnt_ < NumericTraits<uint32_t>::max())
+        {
+            rate_limited_cnt_++;
+        }
+        return -ErrRateLimited;
+    }
+    const MonotonicTime tx_deadline = published_at + tx_timeout_;
+    node_.getDispatcher().getTransferPerfCounter().sampleLatency(LatencyStageTxPublishToTransport, published_at);
+#if !UAVCAN_TINY
+    if ((tx_completion_monitor_ != NULL) && !node_.isPassiveMode())
+    {
+        if (!tx_completion_monitor_->hasFreeSlots())
+        {
+            UAVCAN_TRACE("GenericPublisher", "TX completion monitor is full");
+            return -ErrMemory;
+        }
+
+        TxCompletionEvent event;
+        event.data_type_id = sender_.getDataTypeID();
+        event.transfer_type = transfer_type;
+        event.dst_node_id = dst_node_id;
+        event.published_at = published_at;
+        event.tx_deadline = tx_deadline;
+        if (tid)
+        {
+            event.transfer_id = *tid;
+        }
+        else
+        {
+            const int tid_res = sender_.takeTransferID(tx_deadline, transfer_type, dst_node_id, event.transfer_id);
+            if (tid_res < 0)
+            {
+                return tid_res;
+            }
+        }
+
+        const int res = sender_.send(buffer, tx_deadline, blocking_deadline, transfer_type, dst_node_id,
+                                     event.transfer_id);
+        if (res >= 0)
+        {
+            const uint8_t all_ifaces = uint8_t((1U << node_.getDispatcher().getCanIOManager().getNumIfaces()) - 1U);
+            (void)tx_completion_monitor_->track(event, uint8_t(sender_.getLastIfaceMask() & all_ifaces));
+        }
+        return res;
+    }
+#endif
     if (tid)
     {
-        return sender_.send(buffer.getRawPtr(), buffer.getMaxWritePos(), getTxDeadline(),
-                            blocking_deadline, transfer_type, dst_node_id, *tid);
+        return sender_.send(buffer, tx_deadline, blocking_deadline, transfer_type, dst_node_id, *tid);
     }
     else
     {
-        return sender_.send(buffer.getRawPtr(), buffer.getMaxWritePos(), getTxDeadline(),
-                            blocking_deadline, transfer_type, dst_node_id);
+        return sender_.send(buffer, tx_deadline, blocking_deadline, transfer_type, dst_node_id);
+    }
+}
+
+CanIfaceTxQueueStatus GenericPublisherBase::getTxQueueStatus() const
+{
+    const CanIOManager& canio = node_.getDispatcher().getCanIOManager();
+    CanIfaceTxQueueStatus worst;
+    worst.num_free_blocks = 0xFFFFU;
+    for (uint8_t i = 0; i < canio.getNumIfaces(); i++)
+    {
+        if ((sender_.getIfaceMask() & (1U << i)) == 0)
+        {
+            continue;
+        }
+        const CanIfaceTxQueueStatus status = canio.getIfaceTxQueueStatus(i);
+        worst.num_pending_frames = max(worst.num_pending_frames, status.num_pending_frames);
+        worst.num_free_blocks = min(worst.num_free_blocks, status.num_free_blocks);
+        worst.estimated_drain_time = max(worst.estimated_drain_time, status.estimated_drain_time);
     }
+    return worst;
 }
 
 void GenericPublisherBase::setTxTimeout(MonotonicDuration tx_timeout)
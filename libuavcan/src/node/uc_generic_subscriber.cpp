@@ -6,6 +6,204 @@
 
 namespace uavcan
 {
+#if !UAVCAN_TINY
+/*
+ * DeferredTransferQueue::Transfer
+ */
+class DeferredTransferQueue::Transfer : public IncomingTransfer
+{
+    Item& item_;
+    IPoolAllocator& allocator_;
+
+public:
+    Transfer(Item& item, IPoolAllocator& allocator)
+        : IncomingTransfer(item.ts_mono, item.ts_utc, item.priority, TransferType(item.transfer_type),
+                           item.transfer_id, item.src_node_id, item.iface_index)
+        , item_(item)
+        , allocator_(allocator)
+    { }
+
+    virtual int read(unsigned offset, uint8_t* data, unsigned len) const
+    {
+        if (item_.payload == NULL)
+        {
+            return -ErrLogic;
+        }
+        return item_.payload->read(offset, data, len);
+    }
+
+    virtual const uint8_t* getContiguousData(unsigned& out_len) const
+    {
+        if (item_.payload == NULL)
+        {
+            out_len = 0;
+            return NULL;
+        }
+        return item_.payload->getContiguousData(out_len);
+    }
+
+    virtual void release() { TransferBufferManagerEntry::destroy(item_.payload, allocator_); }
+
+    virtual bool isAnonymousTransfer() const { return item_.anonymous; }
+};
+
+/*
+ * DeferredTransferQueue
+ */
+DeferredTransferQueue::Item* DeferredTransferQueue::pop()
+{
+    Item* const item = head_;
+    if (item != NULL)
+    {
+        head_ = item->next;
+        if (head_ == NULL)
+        {
+            tail_ = NULL;
+        }
+        UAVCAN_ASSERT(len_ > 0);
+        len_--;
+    }
+    return item;
+}
+
+void DeferredTransferQueue::destroy(Item* item)
+{
+    if (item != NULL)
+    {
+        TransferBufferManagerEntry::destroy(item->payload, allocator_);
+        item->~Item();
+        allocator_.deallocate(item);
+    }
+}
+
+void DeferredTransferQueue::handleDeferredCallback()
+{
+    Item* const item = pop();
+    if (head_ != NULL)
+    {
+        schedule();             // One transfer per invocation, so that the other handlers get their turn
+    }
+    if (item != NULL)
+    {
+        Transfer transfer(*item, allocator_);
+        handleDeferredTransfer(transfer);
+        destroy(item);
+    }
+}
+
+int DeferredTransferQueue::push(IncomingTransfer& transfer, uint16_t max_size)
+{
+    if (capacity_ == 0)
+    {
+        UAVCAN_ASSERT(0);
+        return -ErrLogic;
+    }
+    if (len_ >= capacity_)
+    {
+        UAVCAN_TRACE("DeferredTransferQueue", "Overflow, dropping the oldest transfer");
+        destroy(pop());
+        drop_cnt_++;
+    }
+
+    void* const praw = allocator_.allocate(sizeof(Item));
+    if (praw == NULL)
+    {
+        drop_cnt_++;
+        return -ErrMemory;
+    }
+    Item* const item = new (praw) Item();
+    item->payload = TransferBufferManagerEntry::instantiate(allocator_, max_size);
+    if (item->payload == NULL)
+    {
+        destroy(item);
+        drop_cnt_++;
+        return -ErrMemory;
+    }
+
+    /*
+     * Copying the payload
+     */
+    unsigned contiguous_len = 0;
+    const uint8_t* const contiguous_data = transfer.getContiguousData(contiguous_len);
+    int res = 0;
+    if (contiguous_data != NULL)
+    {
+        res = (contiguous_len > 0) ? item->payload->write(0, contiguous_data, contiguous_len) : 0;
+        res = (res == int(contiguous_len)) ? 0 : -ErrMemory;
+    }
+    else
+    {
+        uint8_t chunk[16];
+        unsigned offset = 0;
+        while (true)
+        {
+            res = transfer.read(offset, chunk, sizeof(chunk));
+            if (res <= 0)
+            {
+                break;
+            }
+            if (item->payload->write(offset, chunk, unsigned(res)) != res)
+            {
+                res = -ErrMemory;
+                break;
+            }
+            offset += unsigned(res);
+        }
+    }
+    if (res < 0)
+    {
+        destroy(item);
+        drop_cnt_++;
+        return res;
+    }
+
+    item->ts_mono = transfer.getMonotonicTimestamp();
+    item->ts_utc = transfer.getUtcTimestamp();
+    item->priority = transfer.getPriority();
+    item->transfer_id = transfer.getTransferID();
+    item->src_node_id = transfer.getSrcNodeID();
+    item->transfer_type = uint8_t(transfer.getTransferType());
+    item->iface_index = transfer.getIfaceIndex();
+    item->anonymous = transfer.isAnonymousTransfer();
+
+    if (tail_ == NULL)
+    {
+        head_ = item;
+    }
+    else
+    {
+        tail_->next = item;
+    }
+    tail_ = item;
+    len_++;
+
+    schedule();
+    return 0;
+}
+
+void DeferredTransferQueue::clear()
+{
+    while (head_ != NULL)
+    {
+        destroy(pop());
+    }
+    cancel();
+}
+
+void DeferredTransferQueue::setCapacity(uint16_t capacity)
+{
+    capacity_ = capacity;
+    while (len_ > capacity_)
+    {
+        destroy(pop());
+        drop_cnt_++;
+    }
+    if (len_ == 0)
+    {
+        cancel();
+    }
+}
+#endif
 
 int GenericSubscriberBase::genericStart(TransferListener* listener,
                                         bool (Dispatcher::*registration_method)(TransferListener*))
@@ -24,6 +222,17 @@ int GenericSubscriberBase::genericStart(TransferListener* listener,
     return 0;
 }
 
+const DataTypeDescriptor* GenericSubscriberBase::findDataTypeDescriptor(DataTypeKind kind, const char* full_name)
+{
+    GlobalDataTypeRegistry::instance().freeze();
+    const DataTypeDescriptor* const descr = GlobalDataTypeRegistry::instance().find(kind, full_name);
+    if (descr == NULL)
+    {
+        UAVCAN_TRACE("GenericSubscriber", "Type [%s] is not registered", full_name);
+    }
+    return descr;
+}
+
 void GenericSubscriberBase::stop(TransferListener* listener)
 {
     if (listener != NULL)
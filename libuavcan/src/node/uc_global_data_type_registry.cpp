@@ -7,9 +7,188 @@
 #include <cassert>
 #include <cstdlib>
 
+#if UAVCAN_STATIC_DATA_TYPE_REGISTRY
+/*
+ * Defined by the linker around the section; weak, so that the application links even if it has no such types.
+ */
+extern "C"
+{
+extern const uavcan::DataTypeDescriptor* const __start_uavcan_data_types[] __attribute__((weak));
+extern const uavcan::DataTypeDescriptor* const __stop_uavcan_data_types[] __attribute__((weak));
+}
+#endif
+
 namespace uavcan
 {
 
+uint32_t GlobalDataTypeRegistry::computeNameHash(const char* name)
+{
+    uint32_t hash = 2166136261U;                                    // FNV-1a
+    for (unsigned i = 0; (name != NULL) && (i < DataTypeDescriptor::MaxFullNameLen) && (name[i] != '\0'); i++)
+    {
+        hash = (hash ^ uint8_t(name[i])) * 16777619U;
+    }
+    return hash;
+}
+
+#if UAVCAN_DATA_TYPE_REGISTRY_INDEX_CAPACITY > 0
+
+void GlobalDataTypeRegistry::buildIndex()
+{
+    indexed_ = false;
+
+    const unsigned num_entries = getNumMessageTypes() + getNumServiceTypes();
+    if (num_entries > IndexCapacity)
+    {
+        UAVCAN_TRACE("GlobalDataTypeRegistry", "Too many types to index: %u; lookups will be slow", num_entries);
+        return;
+    }
+
+    fill(index_by_name_, index_by_name_ + IndexTableSize, uint16_t(0));
+    fill(index_by_id_, index_by_id_ + IndexTableSize, uint16_t(0));
+
+    unsigned num_indexed = 0;
+#if UAVCAN_STATIC_DATA_TYPE_REGISTRY
+    for (const DataTypeDescriptor* const* p = getStaticBegin(); p != getStaticEnd(); ++p)
+    {
+        addToIndex(**p, num_indexed);
+        num_indexed++;
+    }
+#endif
+    const List* const lists[] = { &msgs_, &srvs_ };
+    for (unsigned i = 0; i < (sizeof(lists) / sizeof(lists[0])); i++)
+    {
+        for (const Entry* p = lists[i]->get(); p != NULL; p = p->getNextListNode())
+        {
+            addToIndex(p->descriptor, num_indexed);
+            num_indexed++;
+        }
+    }
+    UAVCAN_ASSERT(num_indexed == num_entries);
+    indexed_ = true;
+}
+
+void GlobalDataTypeRegistry::addToIndex(const DataTypeDescriptor& descriptor, unsigned position)
+{
+    UAVCAN_ASSERT(position < IndexCapacity);
+    const unsigned mask = IndexTableSize - 1U;
+
+    index_descriptors_[position] = &descriptor;
+    index_name_hashes_[position] = computeNameHash(descriptor.getFullName());
+
+    // Linear probing; the tables can't overflow because they are larger than the descriptor array
+    unsigned slot = index_name_hashes_[position] & mask;
+    while (index_by_name_[slot] != 0)
+    {
+        slot = (slot + 1U) & mask;
+    }
+    index_by_name_[slot] = uint16_t(position + 1U);
+
+    slot = computeIdHash(descriptor.getKind(), descriptor.getID()) & mask;
+    while (index_by_id_[slot] != 0)
+    {
+        slot = (slot + 1U) & mask;
+    }
+    index_by_id_[slot] = uint16_t(position + 1U);
+}
+
+const DataTypeDescriptor* GlobalDataTypeRegistry::findIndexed(DataTypeKind kind, const char* name) const
+{
+    const uint32_t hash = computeNameHash(name);
+    const unsigned mask = IndexTableSize - 1U;
+    for (unsigned slot = hash & mask; index_by_name_[slot] != 0; slot = (slot + 1U) & mask)
+    {
+        const unsigned position = index_by_name_[slot] - 1U;
+        if ((index_name_hashes_[position] == hash) && index_descriptors_[position]->match(kind, name))
+        {
+            return index_descriptors_[position];
+        }
+    }
+    return NULL;
+}
+
+const DataTypeDescriptor* GlobalDataTypeRegistry::findIndexed(DataTypeKind kind, DataTypeID dtid) const
+{
+    const unsigned mask = IndexTableSize - 1U;
+    for (unsigned slot = computeIdHash(kind, dtid) & mask; index_by_id_[slot] != 0; slot = (slot + 1U) & mask)
+    {
+        const DataTypeDescriptor* const p = index_descriptors_[index_by_id_[slot] - 1U];
+        if (p->match(kind, dtid))
+        {
+            return p;
+        }
+    }
+    return NULL;
+}
+
+#endif
+
+#if UAVCAN_STATIC_DATA_TYPE_REGISTRY
+
+const DataTypeDescriptor* const* GlobalDataTypeRegistry::getStaticBegin()
+{
+    return &__start_uavcan_data_types[0];
+}
+
+const DataTypeDescriptor* const* GlobalDataTypeRegistry::getStaticEnd()
+{
+    return &__stop_uavcan_data_types[0];
+}
+
+unsigned GlobalDataTypeRegistry::countStatic(DataTypeKind kind)
+{
+    unsigned count = 0;
+    for (const DataTypeDescriptor* const* p = getStaticBegin(); p != getStaticEnd(); ++p)
+    {
+        if ((*p)->getKind() == kind)
+        {
+            count++;
+        }
+    }
+    return count;
+}
+
+const DataTypeDescriptor* GlobalDataTypeRegistry::findStatic(DataTypeKind kind, const char* name)
+{
+    for (const DataTypeDescriptor* const* p = getStaticBegin(); p != getStaticEnd(); ++p)
+    {
+        if ((*p)->match(kind, name))
+        {
+            return *p;
+        }
+    }
+    return NULL;
+}
+
+const DataTypeDescriptor* GlobalDataTypeRegistry::findStatic(DataTypeKind kind, DataTypeID dtid)
+{
+    for (const DataTypeDescriptor* const* p = getStaticBegin(); p != getStaticEnd(); ++p)
+    {
+        if ((*p)->match(kind, dtid))
+        {
+            return *p;
+        }
+    }
+    return NULL;
+}
+
+void GlobalDataTypeRegistry::checkStatic()
+{
+    for (const DataTypeDescriptor* const* p = getStaticBegin(); p != getStaticEnd(); ++p)
+    {
+        // The table is deduplicated by the linker, so the first match must be the descriptor itself
+        if (!(*p)->isValid() ||
+            (findStatic((*p)->getKind(), (*p)->getID()) != *p) ||
+            (findStatic((*p)->getKind(), (*p)->getFullName()) != *p))
+        {
+            UAVCAN_TRACE("GlobalDataTypeRegistry", "Invalid or colliding static type %s", (*p)->getFullName());
+            handleFatalError("Type reg failed");
+        }
+    }
+}
+
+#endif
+
 GlobalDataTypeRegistry::List* GlobalDataTypeRegistry::selectList(DataTypeKind kind) const
 {
     if (kind == DataTypeKindMessage)
@@ -77,6 +256,13 @@ GlobalDataTypeRegistry::RegistrationResult GlobalDataTypeRegistry::registImpl(En
         return RegistrationResultInvalidParams;
     }
 
+#if UAVCAN_STATIC_DATA_TYPE_REGISTRY
+    if ((findStatic(dtd->descriptor.getKind(), dtd->descriptor.getID()) != NULL) ||
+        (findStatic(dtd->descriptor.getKind(), dtd->descriptor.getFullName()) != NULL))
+    {
+        return RegistrationResultCollision;
+    }
+#endif
     {   // Collision check
         Entry* p = list->get();
         while (p)
@@ -136,8 +322,14 @@ void GlobalDataTypeRegistry::freeze()
     if (!frozen_)
     {
         frozen_ = true;
-        UAVCAN_TRACE("GlobalDataTypeRegistry", "Frozen; num msgs: %u, num srvs: %u",
-                     getNumMessageTypes(), getNumServiceTypes());
+#if UAVCAN_STATIC_DATA_TYPE_REGISTRY
+        checkStatic();
+#endif
+#if UAVCAN_DATA_TYPE_REGISTRY_INDEX_CAPACITY > 0
+        buildIndex();
+#endif
+        UAVCAN_TRACE("GlobalDataTypeRegistry", "Frozen; num msgs: %u, num srvs: %u, indexed: %i",
+                     getNumMessageTypes(), getNumServiceTypes(), int(isIndexed()));
     }
 }
 
@@ -164,6 +356,21 @@ const DataTypeDescriptor* GlobalDataTypeRegistry::find(DataTypeKind kind, const
         UAVCAN_ASSERT(0);
         return NULL;
     }
+#if UAVCAN_DATA_TYPE_REGISTRY_INDEX_CAPACITY > 0
+    if (indexed_)
+    {
+        return findIndexed(kind, name);
+    }
+#endif
+#if UAVCAN_STATIC_DATA_TYPE_REGISTRY
+    {
+        const DataTypeDescriptor* const desc = findStatic(kind, name);
+        if (desc != NULL)
+        {
+            return desc;
+        }
+    }
+#endif
     Entry* p = list->get();
     while (p)
     {
@@ -184,6 +391,21 @@ const DataTypeDescriptor* GlobalDataTypeRegistry::find(DataTypeKind kind, DataTy
         UAVCAN_ASSERT(0);
         return NULL;
     }
+#if UAVCAN_DATA_TYPE_REGISTRY_INDEX_CAPACITY > 0
+    if (indexed_)
+    {
+        return findIndexed(kind, dtid);
+    }
+#endif
+#if UAVCAN_STATIC_DATA_TYPE_REGISTRY
+    {
+        const DataTypeDescriptor* const desc = findStatic(kind, dtid);
+        if (desc != NULL)
+        {
+            return desc;
+        }
+    }
+#endif
     Entry* p = list->get();
     while (p)
     {
@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <uavcan/node/retrying_service_client.hpp>
+
+namespace uavcan
+{
+
+uint32_t RetryBackoff::getRandom()
+{
+    // Xorshift32
+    uint32_t x = rng_state_;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    rng_state_ = x;
+    return x;
+}
+
+void RetryBackoff::configure(MonotonicDuration initial_delay, MonotonicDuration max_delay, uint8_t jitter_percent)
+{
+    initial_delay_ = max(initial_delay, MonotonicDuration());
+    max_delay_ = max(max_delay, initial_delay_);
+    jitter_percent_ = min(jitter_percent, uint8_t(100));
+}
+
+MonotonicDuration RetryBackoff::getNextDelay()
+{
+    MonotonicDuration delay = initial_delay_;
+    for (unsigned i = 0; (i < num_attempts_) && (delay < max_delay_); i++)
+    {
+        delay += delay;
+    }
+    delay = min(delay, max_delay_);
+
+    if (num_attempts_ < 0xFF)
+    {
+        num_attempts_++;
+    }
+
+    const uint64_t jitter_range = uint64_t(delay.toUSec()) * jitter_percent_ / 100U;
+    if (jitter_range > 0)
+    {
+        const uint64_t jitter = getRandom() % (jitter_range + 1U);
+        delay -= MonotonicDuration::fromUSec(int64_t(jitter));
+    }
+    return delay;
+}
+
+}
@@ -34,9 +34,233 @@ bool DeadlineHandler::isRunning() const
     return scheduler_.getDeadlineScheduler().doesExist(this);
 }
 
+/*
+ * DeferredCallbackHandler
+ */
+void DeferredCallbackHandler::schedule()
+{
+    scheduler_.getDeferredCallbackScheduler().add(this);
+    scheduler_.getDispatcher().breakSpin();
+}
+
+void DeferredCallbackHandler::cancel()
+{
+    scheduler_.getDeferredCallbackScheduler().remove(this);
+}
+
+bool DeferredCallbackHandler::isScheduled() const
+{
+    return scheduler_.getDeferredCallbackScheduler().doesExist(this);
+}
+
+void DeferredCallbackHandler::setPriority(DeferredCallbackPriority priority)
+{
+    if (priority_ != uint8_t(priority))
+    {
+        const bool scheduled = isScheduled();
+        cancel();
+        priority_ = uint8_t(priority);
+        if (scheduled)
+        {
+            schedule();
+        }
+    }
+}
+
 /*
  * MonotonicDeadlineScheduler
  */
+#if UAVCAN_DEADLINE_SCHEDULER_TIMER_WHEEL
+
+void DeadlineScheduler::place(DeadlineHandler* mdh)
+{
+    uint64_t tick = max(mdh->getDeadline().toUSec() >> TickShift, current_tick_);   // Overdue go to the current slot
+    const uint64_t MaxTicksAhead = (uint64_t(1) << (SlotBits * NumLevels)) - 1U;
+    if ((tick - current_tick_) > MaxTicksAhead)
+    {
+        tick = current_tick_ + MaxTicksAhead;       // Will be re-cascaded until it comes into range
+    }
+
+    unsigned level = 0;
+    while ((level < (NumLevels - 1U)) && ((tick - current_tick_) >= (uint64_t(1) << (SlotBits * (level + 1U)))))
+    {
+        level++;
+    }
+    const unsigned index = unsigned(tick >> (SlotBits * level)) & (NumSlots - 1U);
+
+    slots_[level * NumSlots + index].insertNew(mdh);
+    occupied_slots_[level] |= uint32_t(1) << index;
+    mdh->wheel_slot_ = uint8_t(level * NumSlots + index);
+}
+
+unsigned DeadlineScheduler::cascade(unsigned level)
+{
+    const unsigned index = unsigned(current_tick_ >> (SlotBits * level)) & (NumSlots - 1U);
+    LinkedListRoot<DeadlineHandler>& slot = slots_[level * NumSlots + index];
+    occupied_slots_[level] &= ~(uint32_t(1) << index);
+
+    DeadlineHandler* p = slot.get();
+    slot = LinkedListRoot<DeadlineHandler>();
+    while (p != NULL)
+    {
+        DeadlineHandler* const next = p->getNextListNode();
+        place(p);
+        p = next;
+    }
+    return index;
+}
+
+void DeadlineScheduler::advance(uint64_t target_tick)
+{
+    if (num_handlers_ == 0)
+    {
+        current_tick_ = max(current_tick_, target_tick);
+        return;
+    }
+    while (current_tick_ < target_tick)
+    {
+        const unsigned index = unsigned(current_tick_) & (NumSlots - 1U);
+        if (occupied_slots_[0] & (uint32_t(1) << index))
+        {
+            return;                                 // Everything in this slot is due, must be processed first
+        }
+
+        // Skipping empty level 0 slots up to the next occupied one or the end of the revolution
+        unsigned step = 1;
+        while (((index + step) < NumSlots) && !(occupied_slots_[0] & (uint32_t(1) << (index + step))))
+        {
+            step++;
+        }
+        current_tick_ = min(current_tick_ + step, target_tick);
+
+        if ((current_tick_ & (NumSlots - 1U)) == 0)
+        {
+            for (unsigned level = 1; (level < NumLevels) && (cascade(level) == 0); level++)
+            { }
+        }
+    }
+}
+
+DeadlineHandler* DeadlineScheduler::findEarliestInSlot(const LinkedListRoot<DeadlineHandler>& slot)
+{
+    DeadlineHandler* earliest = slot.get();
+    for (DeadlineHandler* p = earliest; p != NULL; p = p->getNextListNode())
+    {
+        if (p->getDeadline() < earliest->getDeadline())
+        {
+            earliest = p;
+        }
+    }
+    return earliest;
+}
+
+DeadlineHandler* DeadlineScheduler::findDueHandler(MonotonicTime ts)
+{
+    advance(ts.toUSec() >> TickShift);
+    DeadlineHandler* const mdh = findEarliestInSlot(slots_[unsigned(current_tick_) & (NumSlots - 1U)]);
+    return ((mdh != NULL) && (mdh->getDeadline() <= ts)) ? mdh : NULL;
+}
+
+void DeadlineScheduler::add(DeadlineHandler* mdh)
+{
+    UAVCAN_ASSERT(mdh);
+    UAVCAN_ASSERT(mdh->wheel_slot_ == NoSlot);
+    remove(mdh);
+    place(mdh);
+    num_handlers_++;
+}
+
+void DeadlineScheduler::remove(DeadlineHandler* mdh)
+{
+    UAVCAN_ASSERT(mdh);
+    if (mdh->wheel_slot_ == NoSlot)
+    {
+        return;
+    }
+    const unsigned slot_index = mdh->wheel_slot_;
+    UAVCAN_ASSERT(slot_index < (NumLevels * NumSlots));
+    slots_[slot_index].remove(mdh);
+    if (slots_[slot_index].isEmpty())
+    {
+        occupied_slots_[slot_index / NumSlots] &= ~(uint32_t(1) << (slot_index % NumSlots));
+    }
+    mdh->wheel_slot_ = NoSlot;
+    UAVCAN_ASSERT(num_handlers_ > 0);
+    num_handlers_--;
+}
+
+bool DeadlineScheduler::doesExist(const DeadlineHandler* mdh) const
+{
+    UAVCAN_ASSERT(mdh);
+    if (mdh->wheel_slot_ == NoSlot)
+    {
+        return false;
+    }
+    UAVCAN_ASSERT(mdh->wheel_slot_ < (NumLevels * NumSlots));
+    return slots_[mdh->wheel_slot_].contains(mdh);
+}
+
+MonotonicTime DeadlineScheduler::pollAndGetMonotonicTime(ISystemClock& sysclock)
+{
+    while (true)
+    {
+        const MonotonicTime ts = sysclock.getMonotonic();
+        DeadlineHandler* const mdh = findDueHandler(ts);
+        if (mdh == NULL)
+        {
+            return ts;
+        }
+        remove(mdh);
+        mdh->handleDeadline(ts);   // This handler can be re-registered immediately
+    }
+    UAVCAN_ASSERT(0);
+    return MonotonicTime();
+}
+
+MonotonicTime DeadlineScheduler::getEarliestDeadline() const
+{
+    MonotonicTime earliest = MonotonicTime::getMax();
+    if (num_handlers_ == 0)
+    {
+        return earliest;
+    }
+
+    // Level 0 slots are visited in tick order starting from the current one; the first occupied one is exact
+    for (unsigned i = 0; i < NumSlots; i++)
+    {
+        const unsigned index = (unsigned(current_tick_) + i) & (NumSlots - 1U);
+        if (occupied_slots_[0] & (uint32_t(1) << index))
+        {
+            earliest = findEarliestInSlot(slots_[index])->getDeadline();
+            break;
+        }
+    }
+
+    // Each upper level slot holds one group of ticks, so the first occupied one contains the earliest deadline
+    // of the level, unless it holds a parked deadline that is out of range - then its beginning is the lower bound
+    for (unsigned level = 1; level < NumLevels; level++)
+    {
+        const unsigned shift = SlotBits * level + TickShift;
+        const uint64_t current_group = current_tick_ >> (SlotBits * level);
+        for (unsigned i = 1; i <= NumSlots; i++)
+        {
+            const uint64_t group = current_group + i;
+            const unsigned index = unsigned(group) & (NumSlots - 1U);
+            if (occupied_slots_[level] & (uint32_t(1) << index))
+            {
+                const MonotonicTime slot_earliest = findEarliestInSlot(slots_[level * NumSlots + index])->getDeadline();
+                const MonotonicTime group_end = MonotonicTime::fromUSec((group + 1U) << shift);
+                earliest = min(earliest, (slot_earliest < group_end) ? slot_earliest :
+                                                                       MonotonicTime::fromUSec(group << shift));
+                break;
+            }
+        }
+    }
+    return earliest;
+}
+
+#else // UAVCAN_DEADLINE_SCHEDULER_TIMER_WHEEL
+
 struct MonotonicDeadlineHandlerInsertionComparator
 {
     const MonotonicTime ts;
@@ -62,26 +286,18 @@ void DeadlineScheduler::remove(DeadlineHandler* mdh)
 bool DeadlineScheduler::doesExist(const DeadlineHandler* mdh) const
 {
     UAVCAN_ASSERT(mdh);
-    const DeadlineHandler* p = handlers_.get();
 #if UAVCAN_DEBUG
     MonotonicTime prev_deadline;
-#endif
-    while (p)
+    for (const DeadlineHandler* p = handlers_.get(); p != NULL; p = p->getNextListNode())
     {
-#if UAVCAN_DEBUG
         if (prev_deadline > p->getDeadline())  // Self check
         {
             std::abort();
         }
         prev_deadline = p->getDeadline();
-#endif
-        if (p == mdh)
-        {
-            return true;
-        }
-        p = p->getNextListNode();
     }
-    return false;
+#endif
+    return handlers_.contains(mdh);
 }
 
 MonotonicTime DeadlineScheduler::pollAndGetMonotonicTime(ISystemClock& sysclock)
@@ -123,13 +339,71 @@ MonotonicTime DeadlineScheduler::getEarliestDeadline() const
     return MonotonicTime::getMax();
 }
 
+#endif // UAVCAN_DEADLINE_SCHEDULER_TIMER_WHEEL
+
+/*
+ * DeferredCallbackScheduler
+ */
+struct DeferredCallbackHandlerInsertionComparator
+{
+    const DeferredCallbackPriority priority;
+    explicit DeferredCallbackHandlerInsertionComparator(DeferredCallbackPriority arg_priority)
+        : priority(arg_priority)
+    { }
+    bool operator()(const DeferredCallbackHandler* h) const
+    {
+        return h->getPriority() > priority;
+    }
+};
+
+void DeferredCallbackScheduler::add(DeferredCallbackHandler* dch)
+{
+    UAVCAN_ASSERT(dch);
+    if (!handlers_.contains(dch))
+    {
+        handlers_.insertBefore(dch, DeferredCallbackHandlerInsertionComparator(dch->getPriority()));
+    }
+}
+
+void DeferredCallbackScheduler::remove(DeferredCallbackHandler* dch)
+{
+    UAVCAN_ASSERT(dch);
+    handlers_.remove(dch);
+}
+
+bool DeferredCallbackScheduler::doesExist(const DeferredCallbackHandler* dch) const
+{
+    UAVCAN_ASSERT(dch);
+    return handlers_.contains(dch);
+}
+
+unsigned DeferredCallbackScheduler::run()
+{
+    unsigned num_invocations = 0;
+    while (true)
+    {
+        DeferredCallbackHandler* const dch = handlers_.get();
+        if (dch == NULL)
+        {
+            break;
+        }
+        handlers_.remove(dch);          // Removed before the call, the handler may schedule itself again
+        dch->handleDeferredCallback();
+        num_invocations++;
+    }
+    return num_invocations;
+}
+
 /*
  * Scheduler
  */
-MonotonicTime Scheduler::computeDispatcherSpinDeadline(MonotonicTime spin_deadline) const
+MonotonicTime Scheduler::computeDispatcherSpinDeadline(MonotonicTime spin_deadline, MonotonicTime ts) const
 {
+    if (!deferred_callback_scheduler_.isEmpty())
+    {
+        return MonotonicTime();         // Pending deferred callbacks must not wait for IO
+    }
     const MonotonicTime earliest = min(deadline_scheduler_.getEarliestDeadline(), spin_deadline);
-    const MonotonicTime ts = getMonotonicTime();
     if (earliest > ts)
     {
         if (earliest - ts > deadline_resolution_)
@@ -140,18 +414,56 @@ MonotonicTime Scheduler::computeDispatcherSpinDeadline(MonotonicTime spin_deadli
     return earliest;
 }
 
+MonotonicTime Scheduler::computeTicklessWakeupTime(MonotonicTime spin_deadline) const
+{
+    if (!deferred_callback_scheduler_.isEmpty())
+    {
+        return MonotonicTime();
+    }
+    // Both the cleanup and the queued frames are due strictly after their deadlines
+    const MonotonicDuration eps = MonotonicDuration::fromUSec(1);
+    const MonotonicTime earliest = min(deadline_scheduler_.getEarliestDeadline(), spin_deadline);
+    const MonotonicTime cleanup = cleanup_pass_ts_ + cleanup_period_;      // Intermediate steps are not waited for
+    const MonotonicTime tx_deadline = dispatcher_.getCanIOManager().getEarliestTxDeadline();
+    return min(earliest, min(cleanup, tx_deadline) + eps);
+}
+
+void Scheduler::runDeferredCallbacks()
+{
+    const DutyCycleScope duty_cycle_scope(&dispatcher_.getTransferPerfCounter(), DutyCycleCategoryCallbacks);
+    (void)deferred_callback_scheduler_.run();
+}
+
 void Scheduler::pollCleanup(MonotonicTime mono_ts, uint32_t num_frames_processed_with_last_spin)
 {
     // cleanup will be performed less frequently if the stack handles more frames per second
-    const MonotonicTime deadline = prev_cleanup_ts_ + cleanup_period_ * (num_frames_processed_with_last_spin + 1);
-    if (mono_ts > deadline)
+    const uint32_t multiplier = num_frames_processed_with_last_spin + 1;
+    const MonotonicDuration step_period = MonotonicDuration::fromUSec(cleanup_period_.toUSec() / CleanupStepsPerPeriod);
+    if (mono_ts > prev_cleanup_ts_ + step_period * multiplier)
     {
-        //UAVCAN_TRACE("Scheduler", "Cleanup with %u processed frames", num_frames_processed_with_last_spin);
+        // An overdue pass is completed at once, otherwise it's split into steps of a similar size
+        const bool overdue = mono_ts > cleanup_pass_ts_ + cleanup_period_ * multiplier;
+        const unsigned num_listeners = dispatcher_.getNumMessageListeners() +
+                                       dispatcher_.getNumServiceRequestListeners() +
+                                       dispatcher_.getNumServiceResponseListeners();
+        const unsigned max_listeners = overdue ? num_listeners + 1U : (num_listeners / CleanupStepsPerPeriod + 1U);
+
+        const DutyCycleScope duty_cycle_scope(&dispatcher_.getTransferPerfCounter(), DutyCycleCategoryDeadlineHandlers);
         prev_cleanup_ts_ = mono_ts;
-        dispatcher_.cleanup(mono_ts);
+        if (dispatcher_.cleanupIncrementally(mono_ts, max_listeners))
+        {
+            cleanup_pass_ts_ = mono_ts;
+        }
     }
 }
 
+MonotonicTime Scheduler::pollDeadlineHandlers()
+{
+    const ExecutionTimeScope execution_time_scope(&dispatcher_.getTransferPerfCounter(), ExecutionStageSchedulerPoll);
+    const DutyCycleScope duty_cycle_scope(&dispatcher_.getTransferPerfCounter(), DutyCycleCategoryDeadlineHandlers);
+    return deadline_scheduler_.pollAndGetMonotonicTime(getSystemClock());
+}
+
 int Scheduler::spin(MonotonicTime deadline)
 {
     if (inside_spin_)  // Preventing recursive calls
@@ -162,17 +474,34 @@ int Scheduler::spin(MonotonicTime deadline)
     InsideSpinSetter iss(*this);
     UAVCAN_ASSERT(inside_spin_);
 
+    const bool tickless = spin_mode_ == SpinModeTickless;
+
+    // The time is read once per iteration, after the deadline handlers; being a bit late is harmless here
+    MonotonicTime ts = tickless ? MonotonicTime() : getMonotonicTime();
     int retval = 0;
     while (true)
     {
-        const MonotonicTime dl = computeDispatcherSpinDeadline(deadline);
-        retval = dispatcher_.spin(dl);
+        if (tickless)
+        {
+            retval = dispatcher_.spinUntilIo(computeTicklessWakeupTime(deadline));
+        }
+        else
+        {
+            retval = dispatcher_.spin(computeDispatcherSpinDeadline(deadline, ts));
+        }
         if (retval < 0)
         {
             break;
         }
+        runDeferredCallbacks();
 
-        const MonotonicTime ts = deadline_scheduler_.pollAndGetMonotonicTime(getSystemClock());
+        ts = pollDeadlineHandlers();
+        runDeferredCallbacks();                         // The deadline handlers may have scheduled more
+        if (tickless)
+        {
+            const DutyCycleScope duty_cycle_scope(&dispatcher_.getTransferPerfCounter(), DutyCycleCategoryTx);
+            dispatcher_.getCanIOManager().cleanup(ts);      // Cheap unless some of the frames have expired
+        }
         pollCleanup(ts, unsigned(retval));
         if (ts >= deadline)
         {
@@ -198,8 +527,10 @@ int Scheduler::spinOnce()
     {
         return retval;
     }
+    runDeferredCallbacks();
 
-    const MonotonicTime ts = deadline_scheduler_.pollAndGetMonotonicTime(getSystemClock());
+    const MonotonicTime ts = pollDeadlineHandlers();
+    runDeferredCallbacks();
     pollCleanup(ts, unsigned(retval));
 
     return retval;
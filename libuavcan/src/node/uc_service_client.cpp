@@ -7,22 +7,187 @@
 namespace uavcan
 {
 /*
- * ServiceClientBase::CallState
+ * ServiceCallRegistry
  */
-void ServiceClientBase::CallState::handleDeadline(MonotonicTime)
+ServiceCallRegistry::ServiceCallRegistry(IPoolAllocator& allocator)
+#if UAVCAN_POOL_USAGE_TRACKING
+    : allocator_(allocator, PoolUsageTagServiceCalls)
+#else
+    : allocator_(allocator.getPartition(PoolUsageTagServiceCalls))
+#endif
+    , head_(NULL)
+    , tail_(NULL)
+    , size_(0)
 {
-    UAVCAN_TRACE("ServiceClient::CallState", "Timeout from nid=%d, tid=%d, dtname=%s",
-                 int(id_.server_node_id.get()), int(id_.transfer_id.get()),
-                 (owner_.data_type_descriptor_ == NULL) ? "???" : owner_.data_type_descriptor_->getFullName());
-    /*
-     * What we're doing here is relaying execution from this call stack to a different one.
-     * We need it because call registry cannot release memory from this callback, because this will destroy the
-     * object method of which we're executing now.
-     */
-    UAVCAN_ASSERT(timed_out_ == false);
-    timed_out_ = true;
-    owner_.generateDeadlineImmediately();
-    UAVCAN_TRACE("ServiceClient::CallState", "Relaying execution to the owner's handler via timer callback");
+    fill_n(buckets_, unsigned(NumBuckets), static_cast<Entry*>(NULL));
+}
+
+ServiceCallRegistry::Entry* ServiceCallRegistry::findOldest(ServiceCallID id, Entry** out_prev_in_bucket) const
+{
+    // New entries are added to the front of the bucket, hence the last match is the oldest one
+    Entry* found = NULL;
+    Entry* found_prev = NULL;
+    Entry* prev = NULL;
+    for (Entry* p = buckets_[getBucketIndex(id)]; p != NULL; p = p->next_in_bucket)
+    {
+        if (p->id == id)
+        {
+            found = p;
+            found_prev = prev;
+        }
+        prev = p;
+    }
+    if (out_prev_in_bucket != NULL)
+    {
+        *out_prev_in_bucket = found_prev;
+    }
+    return found;
+}
+
+void ServiceCallRegistry::destroy(Entry* entry, Entry* prev_in_bucket)
+{
+    UAVCAN_ASSERT(entry != NULL);
+    UAVCAN_ASSERT(size_ > 0);
+
+    Entry*& bucket_link = (prev_in_bucket == NULL) ? buckets_[getBucketIndex(entry->id)] :
+                                                     prev_in_bucket->next_in_bucket;
+    UAVCAN_ASSERT(bucket_link == entry);
+    bucket_link = entry->next_in_bucket;
+
+    if (entry->prev_by_deadline == NULL)
+    {
+        UAVCAN_ASSERT(head_ == entry);
+        head_ = entry->next_by_deadline;
+    }
+    else
+    {
+        entry->prev_by_deadline->next_by_deadline = entry->next_by_deadline;
+    }
+    if (entry->next_by_deadline == NULL)
+    {
+        UAVCAN_ASSERT(tail_ == entry);
+        tail_ = entry->prev_by_deadline;
+    }
+    else
+    {
+        entry->next_by_deadline->prev_by_deadline = entry->prev_by_deadline;
+    }
+
+    entry->~Entry();
+    allocator_.deallocate(entry);
+    size_--;
+}
+
+int ServiceCallRegistry::add(ServiceCallID id, MonotonicTime deadline, MonotonicTime started_at)
+{
+    UAVCAN_ASSERT(id.isValid());
+    void* const praw = allocator_.allocate(sizeof(Entry));
+    if (praw == NULL)
+    {
+        return -ErrMemory;
+    }
+    Entry* const entry = new (praw) Entry(id, deadline, started_at);
+
+    Entry*& bucket = buckets_[getBucketIndex(id)];
+    entry->next_in_bucket = bucket;
+    bucket = entry;
+
+    // Searching from the tail because new calls usually have the latest deadline
+    Entry* prev = tail_;
+    while ((prev != NULL) && (deadline < prev->deadline))
+    {
+        prev = prev->prev_by_deadline;
+    }
+    entry->prev_by_deadline = prev;
+    entry->next_by_deadline = (prev == NULL) ? head_ : prev->next_by_deadline;
+    if (prev == NULL)
+    {
+        head_ = entry;
+    }
+    else
+    {
+        prev->next_by_deadline = entry;
+    }
+    if (entry->next_by_deadline == NULL)
+    {
+        tail_ = entry;
+    }
+    else
+    {
+        entry->next_by_deadline->prev_by_deadline = entry;
+    }
+
+    size_++;
+    return 0;
+}
+
+bool ServiceCallRegistry::remove(ServiceCallID id, MonotonicTime* out_started_at)
+{
+    Entry* prev_in_bucket = NULL;
+    Entry* const entry = findOldest(id, &prev_in_bucket);
+    if (entry == NULL)
+    {
+        return false;
+    }
+    if (out_started_at != NULL)
+    {
+        *out_started_at = entry->started_at;
+    }
+    destroy(entry, prev_in_bucket);
+    return true;
+}
+
+bool ServiceCallRegistry::containsServer(NodeID server_node_id) const
+{
+    for (const Entry* p = head_; p != NULL; p = p->next_by_deadline)
+    {
+        if (p->id.server_node_id == server_node_id)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+ServiceCallID ServiceCallRegistry::removeFirstExpired(MonotonicTime ts)
+{
+    if ((head_ == NULL) || (head_->deadline > ts))
+    {
+        return ServiceCallID();
+    }
+    const ServiceCallID id = head_->id;
+
+    // The expired entry is not necessarily the oldest one in the bucket, so the bucket link is searched explicitly
+    Entry* prev_in_bucket = NULL;
+    for (Entry* p = buckets_[getBucketIndex(id)]; p != head_; p = p->next_in_bucket)
+    {
+        UAVCAN_ASSERT(p != NULL);
+        prev_in_bucket = p;
+    }
+    destroy(head_, prev_in_bucket);
+    return id;
+}
+
+void ServiceCallRegistry::clear()
+{
+    while (head_ != NULL)
+    {
+        (void)removeFirstExpired(head_->deadline);
+    }
+    UAVCAN_ASSERT(size_ == 0);
+}
+
+ServiceCallID ServiceCallRegistry::getByIndex(unsigned index) const
+{
+    for (const Entry* p = head_; p != NULL; p = p->next_by_deadline)
+    {
+        if (index == 0)
+        {
+            return p->id;
+        }
+        index--;
+    }
+    return ServiceCallID();
 }
 
 /*
@@ -78,4 +243,67 @@ int ServiceClientBase::prepareToCall(INode& node,
     return 0;
 }
 
+MonotonicDuration ServiceClientBase::getRequestTimeoutForServer(NodeID server_node_id) const
+{
+#if !UAVCAN_TINY
+    if (rtt_estimator_ != NULL)
+    {
+        MonotonicDuration timeout = rtt_estimator_->getRequestTimeout(server_node_id, request_timeout_);
+        timeout = max(timeout, getMinRequestTimeout());
+        return min(timeout, getMaxRequestTimeout());
+    }
+#else
+    (void)server_node_id;
+#endif
+    return request_timeout_;
+}
+
+bool ServiceClientBase::completeCall(ServiceCallID call_id, MonotonicTime response_ts)
+{
+    MonotonicTime started_at;
+    if (!call_registry_.remove(call_id, &started_at))
+    {
+        return false;
+    }
+    updateDeadline();
+#if !UAVCAN_TINY
+    if ((rtt_estimator_ != NULL) && !response_ts.isZero() && (response_ts >= started_at))
+    {
+        rtt_estimator_->addSample(call_id.server_node_id, response_ts - started_at);
+    }
+#else
+    (void)response_ts;
+#endif
+    return true;
+}
+
+void ServiceClientBase::handleCallTimeout(ServiceCallID call_id)
+{
+#if !UAVCAN_TINY
+    if (rtt_estimator_ != NULL)
+    {
+        rtt_estimator_->addTimeout(call_id.server_node_id);
+    }
+#else
+    (void)call_id;
+#endif
+}
+
+void ServiceClientBase::updateDeadline()
+{
+    if (call_registry_.isEmpty())
+    {
+        DeadlineHandler::stop();
+    }
+    else if (!DeadlineHandler::isRunning() ||
+             (DeadlineHandler::getDeadline() != call_registry_.getEarliestDeadline()))
+    {
+        DeadlineHandler::startWithDeadline(call_registry_.getEarliestDeadline());
+    }
+    else
+    {
+        ;   // Already armed for the earliest call
+    }
+}
+
 }
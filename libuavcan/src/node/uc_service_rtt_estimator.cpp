@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <uavcan/node/service_rtt_estimator.hpp>
+
+#if !UAVCAN_TINY
+
+namespace uavcan
+{
+
+const ServiceRttEstimatorBase::Entry* ServiceRttEstimatorBase::find(NodeID server_node_id) const
+{
+    if (!server_node_id.isValid())
+    {
+        return NULL;                    // Unused entries must not match
+    }
+    for (unsigned i = 0; i < capacity_; i++)
+    {
+        if (entries_[i].server_node_id == server_node_id)
+        {
+            return &entries_[i];
+        }
+    }
+    return NULL;
+}
+
+ServiceRttEstimatorBase::Entry* ServiceRttEstimatorBase::findOrCreate(NodeID server_node_id)
+{
+    UAVCAN_ASSERT(server_node_id.isValid());
+    Entry* const existing = const_cast<Entry*>(find(server_node_id));
+    if (existing != NULL)
+    {
+        return existing;
+    }
+
+    // Unused entries are taken first, then the least recently updated one
+    Entry* oldest = NULL;
+    for (unsigned i = 0; i < capacity_; i++)
+    {
+        Entry& e = entries_[i];
+        if (!e.server_node_id.isValid())
+        {
+            oldest = &e;
+            break;
+        }
+        if ((oldest == NULL) ||
+            (uint32_t(update_counter_ - e.last_update) > uint32_t(update_counter_ - oldest->last_update)))
+        {
+            oldest = &e;
+        }
+    }
+    UAVCAN_ASSERT(oldest != NULL);
+    *oldest = Entry();
+    oldest->server_node_id = server_node_id;
+    return oldest;
+}
+
+void ServiceRttEstimatorBase::addSample(NodeID server_node_id, MonotonicDuration rtt)
+{
+    if (!server_node_id.isValid())
+    {
+        return;
+    }
+    Entry* const e = findOrCreate(server_node_id);
+    e->last_update = ++update_counter_;
+    e->backoff_shift = 0;
+
+    // Bounded so that the arithmetic below can't overflow
+    const uint32_t MaxRttUSec = 0x0FFFFFFFU;
+    const uint32_t r = uint32_t(min(max(rtt.toUSec(), int64_t(1)), int64_t(MaxRttUSec)));
+
+    if (e->srtt_usec == 0)
+    {
+        e->srtt_usec = r;
+        e->rttvar_usec = r / 2U;
+    }
+    else
+    {
+        const uint32_t err = (e->srtt_usec > r) ? (e->srtt_usec - r) : (r - e->srtt_usec);
+        e->rttvar_usec = (e->rttvar_usec * 3U + err) / 4U;
+        e->srtt_usec = max((e->srtt_usec * 7U + r) / 8U, 1U);
+    }
+}
+
+void ServiceRttEstimatorBase::addTimeout(NodeID server_node_id)
+{
+    if (!server_node_id.isValid())
+    {
+        return;
+    }
+    Entry* const e = findOrCreate(server_node_id);
+    e->last_update = ++update_counter_;
+    if (e->backoff_shift < MaxBackoffShift)
+    {
+        e->backoff_shift++;
+    }
+}
+
+MonotonicDuration ServiceRttEstimatorBase::getRequestTimeout(NodeID server_node_id,
+                                                             MonotonicDuration default_timeout) const
+{
+    const Entry* const e = find(server_node_id);
+    if (e == NULL)
+    {
+        return default_timeout;
+    }
+    const int64_t base_usec = (e->srtt_usec == 0) ? default_timeout.toUSec() :
+                              (int64_t(e->srtt_usec) + int64_t(e->rttvar_usec) * 4);
+    return MonotonicDuration::fromUSec(base_usec * (int64_t(1) << e->backoff_shift));
+}
+
+MonotonicDuration ServiceRttEstimatorBase::getSmoothedRtt(NodeID server_node_id) const
+{
+    const Entry* const e = find(server_node_id);
+    return MonotonicDuration::fromUSec((e == NULL) ? 0 : int64_t(e->srtt_usec));
+}
+
+MonotonicDuration ServiceRttEstimatorBase::getRttVariation(NodeID server_node_id) const
+{
+    const Entry* const e = find(server_node_id);
+    return MonotonicDuration::fromUSec((e == NULL) ? 0 : int64_t(e->rttvar_usec));
+}
+
+void ServiceRttEstimatorBase::reset()
+{
+    for (unsigned i = 0; i < capacity_; i++)
+    {
+        entries_[i] = Entry();
+    }
+    update_counter_ = 0;
+}
+
+}
+
+#endif // !UAVCAN_TINY
@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <uavcan/node/service_server.hpp>
+
+namespace uavcan
+{
+
+void ServiceServerBase::updateDeadline()
+{
+    if (deferred_requests_.isEmpty())
+    {
+        DeadlineHandler::stop();
+    }
+    else if (!DeadlineHandler::isRunning() ||
+             (DeadlineHandler::getDeadline() != deferred_requests_.getEarliestDeadline()))
+    {
+        DeadlineHandler::startWithDeadline(deferred_requests_.getEarliestDeadline());
+    }
+    else
+    {
+        ;   // Already armed for the earliest request
+    }
+}
+
+void ServiceServerBase::handleDeadline(MonotonicTime current)
+{
+    while (true)
+    {
+        const ServiceCallID call_id = deferred_requests_.removeFirstExpired(current);
+        if (!call_id.isValid())
+        {
+            break;
+        }
+        UAVCAN_TRACE("ServiceServer", "Deferred response timeout, nid=%d tid=%d",
+                     int(call_id.server_node_id.get()), int(call_id.transfer_id.get()));
+        deferred_response_timeout_count_++;
+    }
+    updateDeadline();
+}
+
+int ServiceServerBase::addDeferredRequest(ServiceCallID call_id, MonotonicTime request_ts)
+{
+    const int res = deferred_requests_.add(call_id, request_ts + deferred_response_timeout_);
+    if (res >= 0)
+    {
+        updateDeadline();
+    }
+    return res;
+}
+
+bool ServiceServerBase::removeDeferredRequest(ServiceCallID call_id)
+{
+    const bool removed = deferred_requests_.remove(call_id);
+    if (removed)
+    {
+        updateDeadline();
+    }
+    return removed;
+}
+
+void ServiceServerBase::removeAllDeferredRequests()
+{
+    deferred_requests_.clear();
+    updateDeadline();
+}
+
+}
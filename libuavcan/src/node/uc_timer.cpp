@@ -16,15 +16,60 @@ void TimerBase::handleDeadline(MonotonicTime current)
 
     const MonotonicTime scheduled_time = getDeadline();
 
+#if UAVCAN_EVENT_TRACE
+    const uint32_t lateness_usec = uint32_t(min(max((current - scheduled_time).toUSec(), int64_t(0)),
+                                                int64_t(NumericTraits<uint32_t>::max())));
+    getScheduler().getDispatcher().getTransferPerfCounter().traceEvent(TraceEventTimerFire, current, lateness_usec);
+#endif
+
     if (period_ < MonotonicDuration::getInfinite())
     {
         startWithDeadline(scheduled_time + period_);
     }
 
+#if UAVCAN_DUTY_CYCLE_STATS
+    const DutyCycleScope duty_cycle_scope(&getScheduler().getDispatcher().getTransferPerfCounter(),
+                                          DutyCycleCategoryCallbacks);
+#endif
     // Application can re-register the timer with different params, it's OK
     handleTimerEvent(TimerEvent(scheduled_time, current));
 }
 
+void TimerBase::stop()
+{
+    DeadlineHandler::stop();
+#if !UAVCAN_TINY
+    if (group_ != NULL)
+    {
+        group_->remove(*this);
+        group_ = NULL;
+        period_ = MonotonicDuration::getInfinite();
+    }
+#endif
+}
+
+bool TimerBase::isRunning() const
+{
+#if !UAVCAN_TINY
+    if (group_ != NULL)
+    {
+        return true;
+    }
+#endif
+    return DeadlineHandler::isRunning();
+}
+
+MonotonicTime TimerBase::getDeadline() const
+{
+#if !UAVCAN_TINY
+    if (group_ != NULL)
+    {
+        return group_->getDeadline();
+    }
+#endif
+    return DeadlineHandler::getDeadline();
+}
+
 void TimerBase::startOneShotWithDeadline(MonotonicTime deadline)
 {
     stop();
@@ -47,4 +92,73 @@ void TimerBase::startPeriodic(MonotonicDuration period)
     DeadlineHandler::startWithDelay(period);
 }
 
+#if !UAVCAN_TINY
+void TimerBase::startPeriodic(TimerGroup& group)
+{
+    stop();
+    period_ = group.getPeriod();
+    group_ = &group;
+    group.add(*this);
+}
+
+/*
+ * TimerGroup
+ */
+TimerGroup::~TimerGroup()
+{
+    while (!members_.isEmpty())
+    {
+        members_.get()->stop();
+    }
+}
+
+void TimerGroup::add(TimerBase& timer)
+{
+    UAVCAN_ASSERT(timer.group_ == this);
+    if (members_.isEmpty())
+    {
+        DeadlineHandler::startWithDelay(period_);
+    }
+    members_.insertNew(&timer);
+}
+
+void TimerGroup::remove(TimerBase& timer)
+{
+    if (next_member_ == &timer)
+    {
+        next_member_ = timer.getNextListNode();
+    }
+    members_.remove(&timer);
+    if (members_.isEmpty())
+    {
+        DeadlineHandler::stop();
+    }
+}
+
+void TimerGroup::handleDeadline(MonotonicTime current)
+{
+    UAVCAN_ASSERT(!isRunning());
+
+    const MonotonicTime scheduled_time = getDeadline();
+
+#if UAVCAN_EVENT_TRACE
+    const uint32_t lateness_usec = uint32_t(min(max((current - scheduled_time).toUSec(), int64_t(0)),
+                                                int64_t(NumericTraits<uint32_t>::max())));
+    getScheduler().getDispatcher().getTransferPerfCounter().traceEvent(TraceEventTimerFire, current, lateness_usec);
+#endif
+
+    startWithDeadline(scheduled_time + period_);
+
+    // The members added by the callbacks are inserted at the head of the list, so they are not invoked this time
+    TimerBase* member = members_.get();
+    while (member != NULL)
+    {
+        next_member_ = member->getNextListNode();
+        member->handleTimerEvent(TimerEvent(scheduled_time, current));
+        member = next_member_;
+    }
+    next_member_ = NULL;
+}
+#endif
+
 }
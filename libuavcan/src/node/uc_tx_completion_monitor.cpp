@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <uavcan/node/tx_completion_monitor.hpp>
+#include <uavcan/debug.hpp>
+
+#if !UAVCAN_TINY
+
+namespace uavcan
+{
+
+void TxCompletionMonitorBase::restartTimer()
+{
+    MonotonicTime earliest = MonotonicTime::getMax();
+    for (unsigned i = 0; i < capacity_; i++)
+    {
+        if (entries_[i].pending_iface_mask != 0)
+        {
+            earliest = min(earliest, entries_[i].event.tx_deadline);
+        }
+    }
+    if (earliest == MonotonicTime::getMax())
+    {
+        TimerBase::stop();
+    }
+    else
+    {
+        TimerBase::startOneShotWithDeadline(earliest + grace_period_);
+    }
+}
+
+void TxCompletionMonitorBase::complete(Entry& entry, TxCompletionEvent::Status status)
+{
+    UAVCAN_ASSERT(num_pending_ > 0);
+
+    TxCompletionEvent event = entry.event;
+    event.status = status;
+    entry.pending_iface_mask = 0;
+    num_pending_--;
+
+    if (num_pending_ == 0)
+    {
+        stopListening();
+    }
+    restartTimer();
+
+    UAVCAN_TRACE("TxCompletionMonitor", "dtid=%d tt=%d tid=%d %s", int(event.data_type_id.get()),
+                 int(event.transfer_type), int(event.transfer_id.get()),
+                 (status == TxCompletionEvent::StatusTransmitted) ? "transmitted" : "expired");
+
+    handleTxCompletion(event);      // Must be the last, the callback may publish again
+}
+
+void TxCompletionMonitorBase::handleLoopbackFrame(const RxFrame& frame)
+{
+    if (!frame.isEndOfTransfer() || (frame.getIfaceIndex() >= MaxCanIfaces))
+    {
+        return;
+    }
+    const uint8_t iface_bit = uint8_t(1U << frame.getIfaceIndex());
+
+    for (unsigned i = 0; i < capacity_; i++)
+    {
+        Entry& entry = entries_[i];
+        if ((entry.pending_iface_mask & iface_bit) &&
+            (entry.event.transfer_id == frame.getTransferID()) &&
+            (entry.event.data_type_id == frame.getDataTypeID()) &&
+            (entry.event.transfer_type == frame.getTransferType()) &&
+            (entry.event.dst_node_id == frame.getDstNodeID()))
+        {
+            entry.pending_iface_mask = uint8_t(entry.pending_iface_mask & ~iface_bit);
+            entry.event.iface_mask = uint8_t(entry.event.iface_mask | iface_bit);
+            entry.event.tx_mono = frame.getMonotonicTimestamp();
+            entry.event.tx_utc = frame.getUtcTimestamp();
+            if (entry.pending_iface_mask == 0)
+            {
+                complete(entry, TxCompletionEvent::StatusTransmitted);
+            }
+            return;
+        }
+    }
+}
+
+void TxCompletionMonitorBase::handleTimerEvent(const TimerEvent& event)
+{
+    for (unsigned i = 0; i < capacity_; i++)
+    {
+        Entry& entry = entries_[i];
+        if ((entry.pending_iface_mask != 0) && ((entry.event.tx_deadline + grace_period_) <= event.real_time))
+        {
+            complete(entry, TxCompletionEvent::StatusExpired);
+        }
+    }
+}
+
+int TxCompletionMonitorBase::track(const TxCompletionEvent& event, uint8_t iface_mask)
+{
+    if (iface_mask == 0)
+    {
+        return -ErrInvalidParam;
+    }
+    for (unsigned i = 0; i < capacity_; i++)
+    {
+        Entry& entry = entries_[i];
+        if (entry.pending_iface_mask == 0)
+        {
+            entry.event = event;
+            entry.event.status = TxCompletionEvent::StatusExpired;
+            entry.event.iface_mask = 0;
+            entry.event.tx_mono = MonotonicTime();
+            entry.event.tx_utc = UtcTime();
+            entry.pending_iface_mask = iface_mask;
+            num_pending_++;
+
+            if (!isListening())
+            {
+                startListening();
+            }
+            if (!TimerBase::isRunning() || ((event.tx_deadline + grace_period_) < TimerBase::getDeadline()))
+            {
+                TimerBase::startOneShotWithDeadline(event.tx_deadline + grace_period_);
+            }
+            return 0;
+        }
+    }
+    UAVCAN_TRACE("TxCompletionMonitor", "No free slots");
+    return -ErrMemory;
+}
+
+void TxCompletionMonitorBase::expireAll()
+{
+    for (unsigned i = 0; i < capacity_; i++)
+    {
+        if (entries_[i].pending_iface_mask != 0)
+        {
+            complete(entries_[i], TxCompletionEvent::StatusExpired);
+        }
+    }
+}
+
+}
+
+#endif // !UAVCAN_TINY
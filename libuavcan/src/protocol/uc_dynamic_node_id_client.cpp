@@ -15,9 +15,23 @@ void DynamicNodeIDClient::terminate()
     dnida_sub_.stop();
 }
 
+uint8_t DynamicNodeIDClient::getMaxUniqueIDBytesPerRequest() const
+{
+    if (!can_fd_requests_enabled_)
+    {
+        return protocol::dynamic_node_id::Allocation::MAX_LENGTH_OF_UNIQUE_ID_IN_REQUEST;
+    }
+    // Anonymous transfers are single-frame; one byte for the node ID and the flag, and one for the tail byte
+    const unsigned overhead = 2;
+    return static_cast<uint8_t>(CanFrame::roundDownDataLength(sizeof(unique_id_) + overhead) - overhead);
+}
+
 MonotonicDuration DynamicNodeIDClient::getRandomDuration(uint32_t lower_bound_msec, uint32_t upper_bound_msec)
 {
-    UAVCAN_ASSERT(upper_bound_msec > lower_bound_msec);
+    if (upper_bound_msec <= lower_bound_msec)
+    {
+        return MonotonicDuration::fromMSec(lower_bound_msec);
+    }
     // coverity[dont_call]
     return MonotonicDuration::fromMSec(lower_bound_msec +
                                        static_cast<uint32_t>(std::rand()) % (upper_bound_msec - lower_bound_msec));
@@ -32,7 +46,7 @@ void DynamicNodeIDClient::restartTimer(const Mode mode)
         getRandomDuration(protocol::dynamic_node_id::Allocation::MIN_REQUEST_PERIOD_MS,
                           protocol::dynamic_node_id::Allocation::MAX_REQUEST_PERIOD_MS) :
         getRandomDuration(protocol::dynamic_node_id::Allocation::MIN_FOLLOWUP_DELAY_MS,
-                          protocol::dynamic_node_id::Allocation::MAX_FOLLOWUP_DELAY_MS);
+                          static_cast<uint32_t>(max_followup_delay_.toMSec()));
 
     startOneShotWithDelay(delay);
 
@@ -60,7 +74,7 @@ void DynamicNodeIDClient::handleTimerEvent(const TimerEvent&)
     tx.first_part_of_unique_id = (size_of_received_unique_id_ == 0);
 
     const uint8_t size_of_unique_id_in_request =
-        min(protocol::dynamic_node_id::Allocation::MAX_LENGTH_OF_UNIQUE_ID_IN_REQUEST,
+        min(getMaxUniqueIDBytesPerRequest(),
             static_cast<uint8_t>(tx.unique_id.capacity() - size_of_received_unique_id_));
 
     tx.unique_id.resize(size_of_unique_id_in_request);
@@ -202,9 +216,27 @@ int DynamicNodeIDClient::start(const UniqueID& unique_id,
     }
     dnida_sub_.allowAnonymousTransfers();
 
-    restartTimer(ModeWaitingForTimeSlot);
+    size_of_received_unique_id_ = 0;
+    if (immediate_first_request_)
+    {
+        UAVCAN_TRACE("DynamicNodeIDClient", "Immediate first request");
+        startOneShotWithDelay(MonotonicDuration());
+    }
+    else
+    {
+        restartTimer(ModeWaitingForTimeSlot);
+    }
 
     return 0;
 }
 
+void DynamicNodeIDClient::setMaxFollowupDelay(MonotonicDuration delay)
+{
+    const MonotonicDuration min_delay =
+        MonotonicDuration::fromMSec(protocol::dynamic_node_id::Allocation::MIN_FOLLOWUP_DELAY_MS);
+    const MonotonicDuration max_delay =
+        MonotonicDuration::fromMSec(protocol::dynamic_node_id::Allocation::MAX_FOLLOWUP_DELAY_MS);
+    max_followup_delay_ = max(min_delay, min(delay, max_delay));
+}
+
 }
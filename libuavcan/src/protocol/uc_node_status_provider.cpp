@@ -19,7 +19,24 @@ int NodeStatusProvider::publish()
 {
     const MonotonicDuration uptime = getNode().getMonotonicTime() - creation_timestamp_;
     UAVCAN_ASSERT(uptime.isPositive());
-    node_info_.status.uptime_sec = uint32_t(uptime.toMSec() / 1000);
+    const uint32_t uptime_sec = uint32_t(uptime.toMSec() / 1000);
+    if (node_info_.status.uptime_sec != uptime_sec)
+    {
+        node_info_.status.uptime_sec = uptime_sec;
+        invalidateEncodedNodeInfo();
+    }
+
+#if UAVCAN_DUTY_CYCLE_STATS
+    if (duty_cycle_reporting_)
+    {
+        const VendorSpecificStatusCode code =
+            VendorSpecificStatusCode(getNode().getDutyCycleCounter().getTotalDutyCyclePermille());
+        if (node_info_.status.vendor_specific_status_code != code)
+        {
+            setVendorSpecificStatusCode(code);
+        }
+    }
+#endif
 
     UAVCAN_ASSERT(node_info_.status.health <= protocol::NodeStatus::FieldTypes::health::max());
 
@@ -43,11 +60,22 @@ void NodeStatusProvider::handleTimerEvent(const TimerEvent&)
 }
 
 void NodeStatusProvider::handleGetNodeInfoRequest(const protocol::GetNodeInfo::Request&,
-                                                  protocol::GetNodeInfo::Response& rsp)
+                                                  ServiceResponseDataStructure<protocol::GetNodeInfo::Response>& rsp)
 {
     UAVCAN_TRACE("NodeStatusProvider", "Got GetNodeInfo request");
     UAVCAN_ASSERT(isNodeInfoInitialized());
-    rsp = node_info_;
+#if !UAVCAN_TINY
+    if (!encoded_node_info_valid_)
+    {
+        encoded_node_info_valid_ = gni_srv_.encodeResponse(node_info_, encoded_node_info_) >= 0;
+    }
+    if (encoded_node_info_valid_)
+    {
+        rsp.setEncodedResponse(encoded_node_info_);
+        return;
+    }
+#endif
+    static_cast<protocol::GetNodeInfo::Response&>(rsp) = node_info_;
 }
 
 int NodeStatusProvider::startAndPublish(const TransferPriority priority)
@@ -112,16 +140,19 @@ uavcan::MonotonicDuration NodeStatusProvider::getStatusPublicationPeriod() const
 void NodeStatusProvider::setHealth(uint8_t code)
 {
     node_info_.status.health = code;
+    invalidateEncodedNodeInfo();
 }
 
 void NodeStatusProvider::setMode(uint8_t code)
 {
     node_info_.status.mode = code;
+    invalidateEncodedNodeInfo();
 }
 
 void NodeStatusProvider::setVendorSpecificStatusCode(VendorSpecificStatusCode code)
 {
     node_info_.status.vendor_specific_status_code = code;
+    invalidateEncodedNodeInfo();
 }
 
 void NodeStatusProvider::setName(const NodeName& name)
@@ -129,6 +160,7 @@ void NodeStatusProvider::setName(const NodeName& name)
     if (node_info_.name.empty())
     {
         node_info_.name = name;
+        invalidateEncodedNodeInfo();
     }
 }
 
@@ -137,6 +169,7 @@ void NodeStatusProvider::setSoftwareVersion(const protocol::SoftwareVersion& ver
     if (node_info_.software_version == protocol::SoftwareVersion())
     {
         node_info_.software_version = version;
+        invalidateEncodedNodeInfo();
     }
 }
 
@@ -145,6 +178,7 @@ void NodeStatusProvider::setHardwareVersion(const protocol::HardwareVersion& ver
     if (node_info_.hardware_version == protocol::HardwareVersion())
     {
         node_info_.hardware_version = version;
+        invalidateEncodedNodeInfo();
     }
 }
 
@@ -0,0 +1,297 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <uavcan/protocol/persistent_param_manager.hpp>
+#include <uavcan/transport/crc.hpp>
+#include <uavcan/transport/transfer_buffer.hpp>
+#include <uavcan/marshal/bit_stream.hpp>
+#include <uavcan/marshal/scalar_codec.hpp>
+#include <uavcan/debug.hpp>
+
+namespace uavcan
+{
+namespace
+{
+
+void writeU16(uint8_t* p, uint16_t value)
+{
+    p[0] = uint8_t(value & 0xFFU);
+    p[1] = uint8_t(value >> 8);
+}
+
+uint16_t readU16(const uint8_t* p)
+{
+    return uint16_t(p[0] | (p[1] << 8));
+}
+
+void writeU32(uint8_t* p, uint32_t value)
+{
+    writeU16(p, uint16_t(value & 0xFFFFU));
+    writeU16(p + 2, uint16_t(value >> 16));
+}
+
+uint32_t readU32(const uint8_t* p)
+{
+    return uint32_t(readU16(p)) | (uint32_t(readU16(p + 2)) << 16);
+}
+
+uint16_t computeCrc(const uint8_t* data, unsigned len)
+{
+    TransferCRC crc;
+    crc.add(data, len);
+    return crc.get();
+}
+
+}
+
+int ParamLog::readHeader(uint8_t bank, uint32_t& out_sequence)
+{
+    uint8_t header[HeaderSize];
+    const int res = backend_.read(bank, 0, header, HeaderSize);
+    if (res < 0)
+    {
+        return res;
+    }
+    if ((readU32(header) != uint32_t(Magic)) || (readU16(header + 8) != computeCrc(header, 8)))
+    {
+        return -ErrFailure;
+    }
+    out_sequence = readU32(header + 4);
+    return 0;
+}
+
+int ParamLog::writeHeader(uint8_t bank, uint32_t sequence)
+{
+    uint8_t header[HeaderSize];
+    writeU32(header, uint32_t(Magic));
+    writeU32(header + 4, sequence);
+    writeU16(header + 8, computeCrc(header, 8));
+    return backend_.write(bank, 0, header, HeaderSize);
+}
+
+int ParamLog::scan(uint8_t bank, IVisitor* visitor, unsigned& out_end)
+{
+    const unsigned bank_size = backend_.getBankSize();
+    unsigned pos = HeaderSize;
+    while ((pos + 2U) <= bank_size)
+    {
+        int res = backend_.read(bank, pos, buffer_, 2);
+        if (res < 0)
+        {
+            return res;
+        }
+        if ((buffer_[0] == 0xFF) && (buffer_[1] == 0xFF))
+        {
+            out_end = pos;              // Erased - end of the log
+            return 0;
+        }
+
+        const unsigned name_len = buffer_[0];
+        const unsigned value_len = buffer_[1];
+        const unsigned record_len = 2U + name_len + value_len + 2U;
+        if ((name_len == 0) || (name_len > Name::MaxSize) || (value_len > unsigned(MaxValueSize)) ||
+            ((pos + record_len) > bank_size))
+        {
+            break;
+        }
+
+        res = backend_.read(bank, pos + 2U, buffer_ + 2, record_len - 2U);
+        if (res < 0)
+        {
+            return res;
+        }
+        if (readU16(buffer_ + record_len - 2U) != computeCrc(buffer_, record_len - 2U))
+        {
+            break;
+        }
+
+        if (visitor != NULL)
+        {
+            Name name;
+            for (unsigned i = 0; i < name_len; i++)
+            {
+                name.push_back(buffer_[2 + i]);
+            }
+
+            StaticTransferBufferImpl value_buf(buffer_ + 2 + name_len, uint16_t(value_len));
+            value_buf.setMaxWritePos(uint16_t(value_len));
+            BitStream bitstream(value_buf);
+            ScalarCodec codec(bitstream);
+            Value value;
+            if (Value::decode(value, codec) >= 0)
+            {
+                visitor->handleRecord(name, value);
+            }
+        }
+        pos += record_len;
+    }
+
+    // Damaged or torn record; nothing can be appended after it
+    UAVCAN_TRACE("ParamLog", "Bank %u is damaged at %u", unsigned(bank), pos);
+    out_end = bank_size;
+    return 0;
+}
+
+int ParamLog::writeRecord(uint8_t bank, unsigned& inout_pos, const Name& name, const Value& value)
+{
+    const unsigned name_len = name.size();
+    if ((name_len == 0) || (name_len > Name::MaxSize))
+    {
+        return -ErrInvalidParam;
+    }
+
+    StaticTransferBufferImpl value_buf(buffer_ + 2 + name_len, uint16_t(MaxValueSize));
+    BitStream bitstream(value_buf);
+    ScalarCodec codec(bitstream);
+    if (Value::encode(value, codec) <= 0)
+    {
+        return -ErrInvalidMarshalData;
+    }
+    const unsigned value_len = value_buf.getMaxWritePos();
+
+    const unsigned record_len = 2U + name_len + value_len + 2U;
+    if ((inout_pos + record_len) > backend_.getBankSize())
+    {
+        return -ErrMemory;
+    }
+
+    buffer_[0] = uint8_t(name_len);
+    buffer_[1] = uint8_t(value_len);
+    for (uint8_t i = 0; i < name_len; i++)
+    {
+        buffer_[2 + i] = name[i];
+    }
+    writeU16(buffer_ + record_len - 2U, computeCrc(buffer_, record_len - 2U));
+
+    const int res = backend_.write(bank, inout_pos, buffer_, record_len);
+    if (res < 0)
+    {
+        inout_pos = backend_.getBankSize();     // The state of the bank is unknown
+        return res;
+    }
+    inout_pos += record_len;
+    return 0;
+}
+
+int ParamLog::open(IVisitor* visitor)
+{
+    compacting_ = false;
+    has_active_bank_ = false;
+    sequence_ = 0;
+
+    for (uint8_t bank = 0; bank < IParamStorageBackend::NumBanks; bank++)
+    {
+        uint32_t seq = 0;
+        if ((readHeader(bank, seq) >= 0) &&
+            (!has_active_bank_ || (int32_t(seq - sequence_) > 0)))     // Overflow-safe comparison
+        {
+            active_bank_ = bank;
+            sequence_ = seq;
+            has_active_bank_ = true;
+        }
+    }
+
+    if (!has_active_bank_)
+    {
+        UAVCAN_TRACE("ParamLog", "No valid bank");
+        write_pos_ = 0;
+        return 0;
+    }
+
+    const int res = scan(active_bank_, visitor, write_pos_);
+    if (res < 0)
+    {
+        has_active_bank_ = false;
+        return res;
+    }
+    UAVCAN_TRACE("ParamLog", "Bank %u seq %u, %u bytes", unsigned(active_bank_), unsigned(sequence_), write_pos_);
+    return 0;
+}
+
+int ParamLog::append(const Name& name, const Value& value)
+{
+    if (compacting_)
+    {
+        return -ErrLogic;
+    }
+    if (!has_active_bank_)
+    {
+        return -ErrMemory;
+    }
+    return writeRecord(active_bank_, write_pos_, name, value);
+}
+
+int ParamLog::beginCompaction()
+{
+    const uint8_t bank = has_active_bank_ ? getInactiveBank() : active_bank_;
+    const int res = backend_.erase(bank);
+    if (res < 0)
+    {
+        return res;
+    }
+    if (has_active_bank_)
+    {
+        active_bank_ = bank;        // The old bank is still valid until the new header is written
+    }
+    compacting_ = true;
+    write_pos_ = HeaderSize;
+    return 0;
+}
+
+int ParamLog::appendToCompaction(const Name& name, const Value& value)
+{
+    if (!compacting_)
+    {
+        return -ErrLogic;
+    }
+    return writeRecord(active_bank_, write_pos_, name, value);
+}
+
+int ParamLog::commitCompaction()
+{
+    if (!compacting_)
+    {
+        return -ErrLogic;
+    }
+    const uint32_t new_sequence = sequence_ + 1U;
+    const int res = writeHeader(active_bank_, new_sequence);
+    if (res < 0)
+    {
+        abortCompaction();
+        return res;
+    }
+    sequence_ = new_sequence;
+    has_active_bank_ = true;
+    compacting_ = false;
+    return 0;
+}
+
+void ParamLog::abortCompaction()
+{
+    if (compacting_)
+    {
+        compacting_ = false;
+        UAVCAN_TRACE("ParamLog", "Compaction aborted");
+        (void)open(NULL);           // Back to the previous bank, if any
+    }
+}
+
+int ParamLog::erase()
+{
+    compacting_ = false;
+    has_active_bank_ = false;
+    sequence_ = 0;
+    write_pos_ = 0;
+    for (uint8_t bank = 0; bank < IParamStorageBackend::NumBanks; bank++)
+    {
+        const int res = backend_.erase(bank);
+        if (res < 0)
+        {
+            return res;
+        }
+    }
+    return 0;
+}
+
+}
@@ -17,6 +17,9 @@ const unsigned CanAcceptanceFilterConfigurator::DefaultAnonMsgID;
 int16_t CanAcceptanceFilterConfigurator::loadInputConfiguration(AnonymousMessages load_mode)
 {
     multiset_configs_.clear();
+    num_wanted_ids_ = 0;
+    mode_ = load_mode;
+    node_id_ = node_.getNodeID();
 
     if (load_mode == AcceptAnonymousMessages)
     {
@@ -27,6 +30,7 @@ int16_t CanAcceptanceFilterConfigurator::loadInputConfiguration(AnonymousMessage
         {
             return -ErrMemory;
         }
+        num_wanted_ids_ += getNumAcceptedIDs(anon_frame_cfg);
     }
 
     CanFilterConfig service_cfg;
@@ -37,17 +41,23 @@ int16_t CanAcceptanceFilterConfigurator::loadInputConfiguration(AnonymousMessage
     {
         return -ErrMemory;
     }
+    num_wanted_ids_ += getNumAcceptedIDs(service_cfg);
 
     const TransferListener* p = node_.getDispatcher().getListOfMessageListeners().get();
+    const TransferListener* prev = NULL;
     while (p != NULL)
     {
-        CanFilterConfig cfg;
-        cfg.id = (static_cast<uint32_t>(p->getDataTypeDescriptor().getID().get()) << 8) | CanFrame::FlagEFF;
-        cfg.mask = DefaultFilterMsgMask | CanFrame::FlagEFF | CanFrame::FlagRTR | CanFrame::FlagERR;
+        const CanFilterConfig cfg = makeMessageFilter(p->getDataTypeDescriptor().getID());
         if (multiset_configs_.emplace(cfg) == NULL)
         {
             return -ErrMemory;
         }
+        // The list is sorted by data type ID, so the listeners of the same data type are adjacent
+        if ((prev == NULL) || (prev->getDataTypeDescriptor().getID() != p->getDataTypeDescriptor().getID()))
+        {
+            num_wanted_ids_ += getNumAcceptedIDs(cfg);
+        }
+        prev = p;
         p = p->getNextListNode();
     }
 
@@ -69,23 +79,22 @@ int16_t CanAcceptanceFilterConfigurator::mergeConfigurations()
     }
     UAVCAN_ASSERT(multiset_configs_.getSize() != 0);
 
-    while (acceptance_filters_number < multiset_configs_.getSize())
+    while ((multiset_configs_.getSize() > 1) && !fitsHardwareFilters(NULL))
     {
-        uint16_t i_rank = 0, j_rank = 0;
-        uint8_t best_rank = 0;
+        uint16_t i_rank = 0, j_rank = 1;
+        int64_t best_cost = getMergeCost(*multiset_configs_.getByIndex(0), *multiset_configs_.getByIndex(1));
 
         const uint16_t multiset_array_size = static_cast<uint16_t>(multiset_configs_.getSize());
 
         for (uint16_t i_ind = 0; i_ind < multiset_array_size - 1; i_ind++)
         {
-            for (uint16_t j_ind = static_cast<uint8_t>(i_ind + 1); j_ind < multiset_array_size; j_ind++)
+            for (uint16_t j_ind = static_cast<uint16_t>(i_ind + 1); j_ind < multiset_array_size; j_ind++)
             {
-                CanFilterConfig temp_config = mergeFilters(*multiset_configs_.getByIndex(i_ind),
-                                                           *multiset_configs_.getByIndex(j_ind));
-                uint8_t rank = countBits(temp_config.mask);
-                if (rank > best_rank)
+                const int64_t cost = getMergeCost(*multiset_configs_.getByIndex(i_ind),
+                                                  *multiset_configs_.getByIndex(j_ind));
+                if (cost < best_cost)
                 {
-                    best_rank = rank;
+                    best_cost = cost;
                     i_rank = i_ind;
                     j_rank = j_ind;
                 }
@@ -97,7 +106,7 @@ int16_t CanAcceptanceFilterConfigurator::mergeConfigurations()
         multiset_configs_.removeFirst(*multiset_configs_.getByIndex(i_rank));
     }
 
-    UAVCAN_ASSERT(acceptance_filters_number >= multiset_configs_.getSize());
+    UAVCAN_ASSERT(fitsHardwareFilters(NULL));
 
     return 0;
 }
@@ -114,7 +123,7 @@ int CanAcceptanceFilterConfigurator::applyConfiguration(void)
         return -ErrDriver;
     }
 
-    if (filter_array_size > acceptance_filters_number)
+    if (!fitsHardwareFilters(NULL))
     {
         UAVCAN_TRACE("CanAcceptanceFilter", "Too many filter configurations. Executing computeConfiguration()");
         mergeConfigurations();
@@ -224,17 +233,233 @@ uint16_t CanAcceptanceFilterConfigurator::getNumFilters() const
     }
 }
 
+bool CanAcceptanceFilterConfigurator::fitsHardwareFilters(const CanFilterConfig* extra) const
+{
+    const unsigned num_configs = multiset_configs_.getSize() + ((extra != NULL) ? 1U : 0U);
+    if (num_configs <= getNumFilters())
+    {
+        return true;            // One configuration per filter
+    }
+    if ((filters_number_ != 0) || (num_configs > MaxCanAcceptanceFilters))
+    {
+        return false;           // The number of filters is set by the application, or the configs can't be applied
+    }
+
+    CanFilterConfig configs[MaxCanAcceptanceFilters];
+    for (unsigned i = 0; i < multiset_configs_.getSize(); i++)
+    {
+        configs[i] = *multiset_configs_.getByIndex(i);
+    }
+    if (extra != NULL)
+    {
+        configs[num_configs - 1] = *extra;
+    }
+
+    ICanDriver& can_driver = node_.getDispatcher().getCanIOManager().getCanDriver();
+    for (uint8_t i = 0; i < node_.getDispatcher().getCanIOManager().getNumIfaces(); i++)
+    {
+        const ICanIface* const iface = can_driver.getIface(i);
+        if ((iface == NULL) ||
+            (iface->getNumFiltersRequired(configs, static_cast<uint16_t>(num_configs)) > iface->getNumFilters()))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
 int CanAcceptanceFilterConfigurator::addFilterConfig(const CanFilterConfig& config)
 {
     if (multiset_configs_.emplace<const CanFilterConfig&>(config) == NULL)
     {
         return -ErrMemory;
     }
+    num_wanted_ids_ += getNumAcceptedIDs(config);
+
+    return 0;
+}
+
+int CanAcceptanceFilterConfigurator::enableAutoReconfiguration(AnonymousMessages mode)
+{
+    const int compute_res = computeConfiguration(mode);
+    if (compute_res < 0)
+    {
+        return compute_res;
+    }
+
+    const int apply_res = applyConfiguration();
+    if (apply_res < 0)
+    {
+        return apply_res;
+    }
 
+    node_.getDispatcher().installListenerRegistrationObserver(this);
     return 0;
 }
 
-CanFilterConfig CanAcceptanceFilterConfigurator::mergeFilters(CanFilterConfig& a_, CanFilterConfig& b_)
+void CanAcceptanceFilterConfigurator::disableAutoReconfiguration()
+{
+    if (isAutoReconfigurationEnabled())
+    {
+        node_.getDispatcher().removeListenerRegistrationObserver();
+    }
+}
+
+bool CanAcceptanceFilterConfigurator::isAutoReconfigurationEnabled() const
+{
+    return node_.getDispatcher().getListenerRegistrationObserver() == this;
+}
+
+float CanAcceptanceFilterConfigurator::getEstimatedLeakRate() const
+{
+    uint64_t num_accepted_ids = 0;
+    for (unsigned i = 0; i < multiset_configs_.getSize(); i++)
+    {
+        num_accepted_ids += getNumAcceptedIDs(*multiset_configs_.getByIndex(i));
+    }
+
+    if (num_accepted_ids <= num_wanted_ids_)
+    {
+        return 0.0F;
+    }
+    return static_cast<float>(num_accepted_ids - num_wanted_ids_) / static_cast<float>(num_accepted_ids);
+}
+
+int CanAcceptanceFilterConfigurator::addMessageFilter(const CanFilterConfig& cfg)
+{
+    num_wanted_ids_ += getNumAcceptedIDs(cfg);
+
+    CanFilterConfig* best = NULL;
+    int64_t best_cost = 0;
+    for (unsigned i = 0; i < multiset_configs_.getSize(); i++)
+    {
+        CanFilterConfig* const existing = multiset_configs_.getByIndex(i);
+        if (isCoveredBy(cfg, *existing))
+        {
+            return 0;           // Nothing to do, this subscription is already accepted
+        }
+        const int64_t cost = getMergeCost(cfg, *existing);
+        if ((best == NULL) || (cost < best_cost))
+        {
+            best = existing;
+            best_cost = cost;
+        }
+    }
+
+    if ((best == NULL) || fitsHardwareFilters(&cfg))
+    {
+        if (multiset_configs_.emplace(cfg) == NULL)
+        {
+            return -ErrMemory;
+        }
+    }
+    else
+    {
+        *best = mergeFilters(cfg, *best);
+    }
+
+    return applyConfiguration();
+}
+
+int CanAcceptanceFilterConfigurator::removeMessageFilter(const CanFilterConfig& cfg)
+{
+    num_wanted_ids_ -= min(num_wanted_ids_, getNumAcceptedIDs(cfg));
+
+    for (unsigned i = 0; i < multiset_configs_.getSize(); i++)
+    {
+        if (*multiset_configs_.getByIndex(i) == cfg)
+        {
+            multiset_configs_.removeFirst(cfg);
+            return applyConfiguration();
+        }
+    }
+
+    return reconfigure();       // The filter was merged with others and can't be extracted
+}
+
+int CanAcceptanceFilterConfigurator::reconfigure()
+{
+    UAVCAN_TRACE("CanAcceptanceFilter", "Full reconfiguration");
+    const int compute_res = computeConfiguration(mode_);
+    if (compute_res < 0)
+    {
+        return compute_res;
+    }
+    return applyConfiguration();
+}
+
+bool CanAcceptanceFilterConfigurator::hasOtherMessageListeners(const TransferListener& listener) const
+{
+    const TransferListener* p = node_.getDispatcher().getListOfMessageListeners().get();
+    while (p != NULL)
+    {
+        if ((p != &listener) && (p->getDataTypeDescriptor().getID() == listener.getDataTypeDescriptor().getID()))
+        {
+            return true;
+        }
+        p = p->getNextListNode();
+    }
+    return false;
+}
+
+void CanAcceptanceFilterConfigurator::handleListenerRegistered(const TransferListener& listener)
+{
+    if ((listener.getDataTypeDescriptor().getKind() != DataTypeKindMessage) || hasOtherMessageListeners(listener))
+    {
+        return;
+    }
+
+    const int res = (node_id_ == node_.getNodeID()) ?
+                    addMessageFilter(makeMessageFilter(listener.getDataTypeDescriptor().getID())) : reconfigure();
+    if (res < 0)
+    {
+        UAVCAN_TRACE("CanAcceptanceFilter", "Failed to add filter for dtid %u: %i",
+                     unsigned(listener.getDataTypeDescriptor().getID().get()), res);
+    }
+}
+
+void CanAcceptanceFilterConfigurator::handleListenerUnregistered(const TransferListener& listener)
+{
+    if ((listener.getDataTypeDescriptor().getKind() != DataTypeKindMessage) || hasOtherMessageListeners(listener))
+    {
+        return;
+    }
+
+    const int res = (node_id_ == node_.getNodeID()) ?
+                    removeMessageFilter(makeMessageFilter(listener.getDataTypeDescriptor().getID())) : reconfigure();
+    if (res < 0)
+    {
+        UAVCAN_TRACE("CanAcceptanceFilter", "Failed to remove filter for dtid %u: %i",
+                     unsigned(listener.getDataTypeDescriptor().getID().get()), res);
+    }
+}
+
+CanFilterConfig CanAcceptanceFilterConfigurator::makeMessageFilter(DataTypeID dtid)
+{
+    CanFilterConfig cfg;
+    cfg.id = (static_cast<uint32_t>(dtid.get()) << 8) | CanFrame::FlagEFF;
+    cfg.mask = DefaultFilterMsgMask | CanFrame::FlagEFF | CanFrame::FlagRTR | CanFrame::FlagERR;
+    return cfg;
+}
+
+uint64_t CanAcceptanceFilterConfigurator::getNumAcceptedIDs(const CanFilterConfig& cfg)
+{
+    return uint64_t(1) << (32U - countBits(cfg.mask));
+}
+
+int64_t CanAcceptanceFilterConfigurator::getMergeCost(const CanFilterConfig& a, const CanFilterConfig& b)
+{
+    return static_cast<int64_t>(getNumAcceptedIDs(mergeFilters(a, b))) -
+           static_cast<int64_t>(getNumAcceptedIDs(a)) - static_cast<int64_t>(getNumAcceptedIDs(b));
+}
+
+bool CanAcceptanceFilterConfigurator::isCoveredBy(const CanFilterConfig& cfg, const CanFilterConfig& by)
+{
+    // Every bit checked by the covering filter must be checked by the covered one as well, and the values must match
+    return ((by.mask & ~cfg.mask) == 0) && (((cfg.id ^ by.id) & by.mask) == 0);
+}
+
+CanFilterConfig CanAcceptanceFilterConfigurator::mergeFilters(const CanFilterConfig& a_, const CanFilterConfig& b_)
 {
     CanFilterConfig temp_arr;
     temp_arr.mask = a_.mask & b_.mask & ~(a_.id ^ b_.id);
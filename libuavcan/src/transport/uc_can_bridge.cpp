@@ -0,0 +1,420 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <uavcan/transport/can_bridge.hpp>
+#include <uavcan/transport/frame.hpp>
+#include <uavcan/debug.hpp>
+
+namespace uavcan
+{
+/*
+ * CanBridge::TxQueue
+ */
+bool CanBridge::TxQueue::isHigher(const QueueEntry& a, const QueueEntry& b)
+{
+    if (a.frame.id == b.frame.id)
+    {
+        return int32_t(a.seq - b.seq) < 0;
+    }
+    return a.frame.priorityHigherThan(b.frame);
+}
+
+bool CanBridge::TxQueue::push(const CanFrame& frame, MonotonicTime deadline)
+{
+    if (size_ >= QueueCapacity)
+    {
+        return false;
+    }
+    QueueEntry entry;
+    entry.frame = frame;
+    entry.deadline = deadline;
+    entry.seq = next_seq_++;
+
+    unsigned pos = size_++;
+    while (pos > 0)
+    {
+        const unsigned parent = (pos - 1U) / 2U;
+        if (!isHigher(entry, heap_[parent]))
+        {
+            break;
+        }
+        heap_[pos] = heap_[parent];
+        pos = parent;
+    }
+    heap_[pos] = entry;
+    return true;
+}
+
+void CanBridge::TxQueue::pop()
+{
+    UAVCAN_ASSERT(size_ > 0);
+    if (size_ == 0)
+    {
+        return;
+    }
+    const QueueEntry last = heap_[--size_];
+    unsigned pos = 0;
+    while (true)
+    {
+        unsigned child = pos * 2U + 1U;
+        if (child >= size_)
+        {
+            break;
+        }
+        if (((child + 1U) < size_) && isHigher(heap_[child + 1U], heap_[child]))
+        {
+            child++;
+        }
+        if (!isHigher(heap_[child], last))
+        {
+            break;
+        }
+        heap_[pos] = heap_[child];
+        pos = child;
+    }
+    heap_[pos] = last;
+}
+
+/*
+ * CanBridge::LoopGuard
+ */
+uint32_t CanBridge::LoopGuard::computeSignature(const CanFrame& frame)
+{
+    // FNV-1a over the CAN ID, DLC and payload
+    uint32_t hash = 2166136261U;
+    for (unsigned i = 0; i < 4; i++)
+    {
+        hash = (hash ^ ((frame.id >> (i * 8U)) & 0xFFU)) * 16777619U;
+    }
+    hash = (hash ^ frame.dlc) * 16777619U;
+    for (unsigned i = 0; i < frame.dlc; i++)
+    {
+        hash = (hash ^ frame.data[i]) * 16777619U;
+    }
+    return hash;
+}
+
+void CanBridge::LoopGuard::add(uint32_t signature, MonotonicTime ts)
+{
+    Entry& e = entries_[signature & (LoopGuardSize - 1U)];
+    e.ts = ts;
+    e.signature = signature;
+}
+
+bool CanBridge::LoopGuard::contains(uint32_t signature, MonotonicTime ts, MonotonicDuration window) const
+{
+    const Entry& e = entries_[signature & (LoopGuardSize - 1U)];
+    return !e.ts.isZero() && (e.signature == signature) && ((ts - e.ts) <= window);
+}
+
+/*
+ * CanBridge::RouteTable
+ */
+bool CanBridge::RouteTable::match(uint16_t data_type_id, uint8_t priority) const
+{
+    UAVCAN_ASSERT(num_intervals > 0);
+    // Last interval that starts at or below the data type ID
+    unsigned lo = 0;
+    unsigned hi = num_intervals;
+    while ((hi - lo) > 1U)
+    {
+        const unsigned mid = (lo + hi) / 2U;
+        if (intervals[mid].first_data_type_id <= data_type_id)
+        {
+            lo = mid;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return (intervals[lo].priority_mask & (uint32_t(1U) << priority)) != 0;
+}
+
+/*
+ * CanBridge
+ */
+CanBridge::CanBridge(ICanDriver& driver, ISystemClock& sysclock, uint8_t iface_index_a, uint8_t iface_index_b)
+    : driver_(driver)
+    , sysclock_(sysclock)
+    , num_routes_(0)
+    , forwarding_timeout_(getDefaultForwardingTimeout())
+    , loop_guard_window_(getDefaultLoopGuardWindow())
+    , num_filtered_(0)
+    , num_loops_prevented_(0)
+    , num_queue_overflows_(0)
+    , num_tx_timeouts_(0)
+    , num_tx_errors_(0)
+{
+    UAVCAN_ASSERT((iface_index_a != iface_index_b) && (iface_index_a < MaxCanIfaces) &&
+                  (iface_index_b < MaxCanIfaces));
+    iface_indices_[SideA] = iface_index_a;
+    iface_indices_[SideB] = iface_index_b;
+    num_forwarded_[SideA] = 0;
+    num_forwarded_[SideB] = 0;
+    compileRoutes();
+}
+
+void CanBridge::compileRouteTable(Side source, TransferType transfer_type)
+{
+    const uint8_t direction_mask = uint8_t((source == SideA) ? CanBridgeRoute::DirectionAToB :
+                                                               CanBridgeRoute::DirectionBToA);
+    const uint8_t transfer_type_mask = uint8_t(1U << transfer_type);
+
+    // Interval boundaries, sorted and unique; zero is always there
+    uint32_t bounds[MaxRoutes * 2 + 1];
+    unsigned num_bounds = 0;
+    bounds[num_bounds++] = 0;
+    for (unsigned i = 0; i < num_routes_; i++)
+    {
+        const CanBridgeRoute& r = routes_[i];
+        if (((r.directions & direction_mask) == 0) || ((r.transfer_types & transfer_type_mask) == 0))
+        {
+            continue;
+        }
+        const uint32_t candidates[2] = { r.data_type_id_min, uint32_t(r.data_type_id_max) + 1U };
+        for (unsigned c = 0; c < 2; c++)
+        {
+            if (candidates[c] > 0xFFFFU)
+            {
+                continue;
+            }
+            unsigned pos = 0;
+            while ((pos < num_bounds) && (bounds[pos] < candidates[c]))
+            {
+                pos++;
+            }
+            if ((pos < num_bounds) && (bounds[pos] == candidates[c]))
+            {
+                continue;
+            }
+            for (unsigned k = num_bounds; k > pos; k--)
+            {
+                bounds[k] = bounds[k - 1U];
+            }
+            bounds[pos] = candidates[c];
+            num_bounds++;
+        }
+    }
+
+    // The priority mask of every interval, merging the neighbors with equal masks
+    RouteTable& table = tables_[source][transfer_type];
+    table.num_intervals = 0;
+    for (unsigned b = 0; b < num_bounds; b++)
+    {
+        uint32_t mask = 0;
+        for (unsigned i = 0; i < num_routes_; i++)
+        {
+            const CanBridgeRoute& r = routes_[i];
+            if ((r.directions & direction_mask) && (r.transfer_types & transfer_type_mask) &&
+                (r.data_type_id_min <= bounds[b]) && (bounds[b] <= r.data_type_id_max))
+            {
+                const uint32_t upper = (r.priority_max >= 31U) ? 0xFFFFFFFFU :
+                                       ((uint32_t(2U) << r.priority_max) - 1U);
+                mask |= upper & ~((uint32_t(1U) << r.priority_min) - 1U);
+            }
+        }
+        if ((table.num_intervals > 0) && (table.intervals[table.num_intervals - 1U].priority_mask == mask))
+        {
+            continue;
+        }
+        table.intervals[table.num_intervals].first_data_type_id = uint16_t(bounds[b]);
+        table.intervals[table.num_intervals].priority_mask = mask;
+        table.num_intervals++;
+    }
+    UAVCAN_ASSERT(table.num_intervals > 0);
+}
+
+void CanBridge::compileRoutes()
+{
+    for (unsigned side = 0; side < NumSides; side++)
+    {
+        for (unsigned tt = 0; tt < NumTransferTypes; tt++)
+        {
+            compileRouteTable(Side(side), TransferType(tt));
+        }
+    }
+}
+
+int CanBridge::addRoute(const CanBridgeRoute& route)
+{
+    if (!route.isValid())
+    {
+        return -ErrInvalidParam;
+    }
+    if (num_routes_ >= MaxRoutes)
+    {
+        return -ErrMemory;
+    }
+    routes_[num_routes_++] = route;
+    compileRoutes();
+    return 0;
+}
+
+void CanBridge::removeAllRoutes()
+{
+    num_routes_ = 0;
+    compileRoutes();
+}
+
+const CanBridgeRoute& CanBridge::getRoute(unsigned index) const
+{
+    UAVCAN_ASSERT(index < num_routes_);
+    return routes_[(index < num_routes_) ? index : 0];
+}
+
+bool CanBridge::isRouted(Side source, const CanFrame& frame) const
+{
+    TransferType transfer_type = TransferTypeMessageBroadcast;
+    DataTypeID data_type_id;
+    NodeID dst_node_id;
+    if (!Frame::parseAddressing(frame, transfer_type, data_type_id, dst_node_id))
+    {
+        return false;
+    }
+    const uint8_t priority = uint8_t((frame.id >> 24) & TransferPriority::NumericallyMax);
+    return tables_[source][transfer_type].match(data_type_id.get(), priority);
+}
+
+void CanBridge::handleRxFrame(Side source, const CanFrame& frame, MonotonicTime ts_mono, CanIOFlags flags)
+{
+    if (flags & CanIOFlagLoopback)
+    {
+        return;                                 // Never forwarding our own frames
+    }
+    if (!isRouted(source, frame))
+    {
+        num_filtered_++;
+        return;
+    }
+    if (loop_guard_window_.isPositive() &&
+        loop_guards_[source].contains(LoopGuard::computeSignature(frame), ts_mono, loop_guard_window_))
+    {
+        UAVCAN_TRACE("CanBridge", "Loop prevented: %s", frame.toString().c_str());
+        num_loops_prevented_++;
+        return;
+    }
+    const Side destination = (source == SideA) ? SideB : SideA;
+    if (!queues_[destination].push(frame, ts_mono + forwarding_timeout_))
+    {
+        num_queue_overflows_++;
+    }
+}
+
+void CanBridge::receive(Side source)
+{
+    ICanIface* const iface = driver_.getIface(iface_indices_[source]);
+    if (iface == NULL)
+    {
+        return;
+    }
+    CanRxFrame frames[DispatcherRxBatchSize];
+    CanIOFlags flags[DispatcherRxBatchSize];
+    const int16_t res = iface->receiveBatch(frames, flags, uint16_t(DispatcherRxBatchSize));
+    if (res < 0)
+    {
+        UAVCAN_TRACE("CanBridge", "RX failed on iface %d: %d", int(iface_indices_[source]), int(res));
+        return;
+    }
+    const MonotonicTime now = sysclock_.getMonotonic();
+    for (int16_t i = 0; i < res; i++)
+    {
+        const MonotonicTime ts_mono = frames[i].ts_mono.isZero() ? now : frames[i].ts_mono;
+        handleRxFrame(source, frames[i], ts_mono, flags[i]);
+    }
+}
+
+void CanBridge::transmit(Side destination, MonotonicTime ts_mono)
+{
+    ICanIface* const iface = driver_.getIface(iface_indices_[destination]);
+    TxQueue& queue = queues_[destination];
+    while ((iface != NULL) && !queue.isEmpty())
+    {
+        const QueueEntry& entry = queue.top();
+        if (entry.deadline < ts_mono)
+        {
+            num_tx_timeouts_++;
+            queue.pop();
+            continue;
+        }
+        const int16_t res = iface->send(entry.frame, entry.deadline, 0);
+        if (res == 0)
+        {
+            break;                              // Iface is full, the frame stays in the queue
+        }
+        if (res < 0)
+        {
+            num_tx_errors_++;
+            queue.pop();
+            break;
+        }
+        if (loop_guard_window_.isPositive())
+        {
+            loop_guards_[destination].add(LoopGuard::computeSignature(entry.frame), ts_mono);
+        }
+        num_forwarded_[destination]++;
+        queue.pop();
+    }
+}
+
+int CanBridge::handleIO(MonotonicTime blocking_deadline)
+{
+    CanSelectMasks masks;
+    const CanFrame* pending_tx[MaxCanIfaces] = { };
+    for (unsigned side = 0; side < NumSides; side++)
+    {
+        const uint8_t iface_mask = uint8_t(1U << iface_indices_[side]);
+        masks.read = uint8_t(masks.read | iface_mask);
+        if (!queues_[side].isEmpty())
+        {
+            masks.write = uint8_t(masks.write | iface_mask);
+            pending_tx[iface_indices_[side]] = &queues_[side].top().frame;
+        }
+    }
+
+    const int res = driver_.select(masks, pending_tx, blocking_deadline);
+    if (res < 0)
+    {
+        return -ErrDriver;
+    }
+
+    for (unsigned side = 0; side < NumSides; side++)
+    {
+        if (masks.read & (1U << iface_indices_[side]))
+        {
+            receive(Side(side));
+        }
+    }
+
+    const MonotonicTime now = sysclock_.getMonotonic();
+    for (unsigned side = 0; side < NumSides; side++)
+    {
+        if (masks.write & (1U << iface_indices_[side]))
+        {
+            transmit(Side(side), now);
+        }
+    }
+    return 0;
+}
+
+int CanBridge::spin(MonotonicTime deadline)
+{
+    do
+    {
+        const int res = handleIO(deadline);
+        if (res < 0)
+        {
+            return res;
+        }
+    }
+    while (sysclock_.getMonotonic() < deadline);
+    return 0;
+}
+
+int CanBridge::spinOnce()
+{
+    return handleIO(MonotonicTime());
+}
+
+}
@@ -9,22 +9,6 @@
 
 namespace uavcan
 {
-/*
- * CanRxFrame
- */
-#if UAVCAN_TOSTRING
-std::string CanRxFrame::toString(StringRepresentation mode) const
-{
-    std::string out = CanFrame::toString(mode);
-    out.reserve(128);
-    out += " ts_m="   + ts_mono.toString();
-    out += " ts_utc=" + ts_utc.toString();
-    out += " iface=";
-    out += char('0' + iface_index);
-    return out;
-}
-#endif
-
 /*
  * CanTxQueue::Entry
  */
@@ -83,6 +67,44 @@ std::string CanTxQueue::Entry::toString() const
 }
 #endif
 
+/*
+ * CanTxQueue::TreeEntry
+ */
+uint32_t CanTxQueue::TreeEntry::getTreapPriority() const
+{
+    // Integer hash function by Chris Wellons (lowbias32), good enough to keep the treap balanced
+    uint32_t x = seq;
+    x ^= x >> 16;
+    x *= 0x7FEB352DU;
+    x ^= x >> 15;
+    x *= 0x846CA68BU;
+    x ^= x >> 16;
+    return x;
+}
+
+bool CanTxQueue::TreeEntry::isBefore(const TreeEntry& rhs) const
+{
+#if UAVCAN_TX_QUEUE_AGING
+    if (promoted != rhs.promoted)
+    {
+        return promoted != 0;
+    }
+    if (promoted)
+    {
+        return int32_t(seq - rhs.seq) < 0;      // The sequence number is reassigned on promotion
+    }
+#endif
+    if (frame.priorityHigherThan(rhs.frame))
+    {
+        return true;
+    }
+    if (rhs.frame.priorityHigherThan(frame))
+    {
+        return false;
+    }
+    return int32_t(seq - rhs.seq) < 0;    // Overflow-safe as long as the queue holds less than 2^31 entries
+}
+
 /*
  * CanTxQueue
  */
@@ -95,229 +117,1448 @@ CanTxQueue::~CanTxQueue()
         remove(p);
         p = next;
     }
+    treeDestroy(tree_roots_[Volatile]);
+    treeDestroy(tree_roots_[Persistent]);
 }
 
-void CanTxQueue::registerRejectedFrame()
+void CanTxQueue::registerRejectedFrame(const CanFrame& frame, TraceDropReason reason, MonotonicTime ts)
 {
     if (rejected_frames_cnt_ < NumericTraits<uint32_t>::max())
     {
         rejected_frames_cnt_++;
     }
+#if UAVCAN_EVENT_TRACE
+    if (event_trace_ != NULL)
+    {
+        event_trace_->record(TraceEventTxQueueDrop, ts, frame.id, frame.dlc, uint8_t(reason));
+    }
+#else
+    (void)frame;
+    (void)reason;
+    (void)ts;
+#endif
 }
 
-void CanTxQueue::push(const CanFrame& frame, MonotonicTime tx_deadline, Qos qos, CanIOFlags flags)
+void CanTxQueue::registerExpiredEntry(const Entry& entry, MonotonicTime ts)
 {
-    const MonotonicTime timestamp = sysclock_.getMonotonic();
-
-    if (timestamp >= tx_deadline)
+    UAVCAN_TRACE("CanTxQueue", "Expired %s", entry.toString().c_str());
+#if UAVCAN_TX_QUEUE_AGING
+    if (entry.promoted && (aging_stats_.num_expired_after_promotion < NumericTraits<uint32_t>::max()))
     {
-        UAVCAN_TRACE("CanTxQueue", "Push rejected: already expired");
-        registerRejectedFrame();
-        return;
+        aging_stats_.num_expired_after_promotion++;
     }
+#endif
+    registerRejectedFrame(entry.frame, TraceDropExpired, ts);
+}
 
-    void* praw = allocator_.allocate(sizeof(Entry));
-    if (praw == NULL)
+void CanTxQueue::registerPending(const Entry& entry, int increment)
+{
+    for (uint8_t i = 0; i < MaxCanIfaces; i++)
     {
-        UAVCAN_TRACE("CanTxQueue", "Push OOM #1, cleanup");
-        // No memory left in the pool, so we try to remove expired frames
-        Entry* p = queue_.get();
-        while (p)
+        if (entry.iface_mask & (1 << i))
         {
-            Entry* const next = p->getNextListNode();
-            if (p->isExpired(timestamp))
-            {
-                UAVCAN_TRACE("CanTxQueue", "Push: Expired %s", p->toString().c_str());
-                registerRejectedFrame();
-                remove(p);
-            }
-            p = next;
+            UAVCAN_ASSERT((increment > 0) || (num_pending_[i] > 0));
+            num_pending_[i] = uint16_t(num_pending_[i] + increment);
         }
-        praw = allocator_.allocate(sizeof(Entry));         // Try again
     }
+}
 
-    if (praw == NULL)
+void CanTxQueue::registerNewEntry(Entry& entry, MonotonicTime timestamp)
+{
+    if (isEmpty() || (entry.deadline < earliest_deadline_))
     {
-        UAVCAN_TRACE("CanTxQueue", "Push OOM #2, QoS arbitration");
-        registerRejectedFrame();
+        earliest_deadline_ = entry.deadline;
+    }
+    entry.seq = next_seq_++;
+#if UAVCAN_LATENCY_STATS || UAVCAN_TX_QUEUE_AGING
+    entry.enqueued_at = timestamp;
+#else
+    (void)timestamp;
+#endif
+#if UAVCAN_TX_QUEUE_AGING
+    if (aging_percent_ > 0)
+    {
+        earliest_promotion_ = min(earliest_promotion_, getPromotionTime(entry));
+    }
+#endif
+    registerPending(entry, 1);
+}
 
-        // Find a frame with lowest QoS
-        Entry* p = queue_.get();
-        if (p == NULL)
+void CanTxQueue::destroyEntry(Entry*& entry)
+{
+#if UAVCAN_TX_QUEUE_AGING
+    if (entry->promoted)
+    {
+        UAVCAN_ASSERT(num_promoted_ > 0);
+        num_promoted_--;
+    }
+#endif
+    registerPending(*entry, -1);
+    Entry::destroy(entry, allocator_);
+}
+
+void CanTxQueue::treeRotateLeft(TreeEntry*& root)
+{
+    TreeEntry* const pivot = root->right;
+    root->right = pivot->left;
+    pivot->left = root;
+    root = pivot;
+}
+
+void CanTxQueue::treeRotateRight(TreeEntry*& root)
+{
+    TreeEntry* const pivot = root->left;
+    root->left = pivot->right;
+    pivot->right = root;
+    root = pivot;
+}
+
+void CanTxQueue::treeInsert(TreeEntry*& root, TreeEntry* node)
+{
+    if (root == NULL)
+    {
+        root = node;
+    }
+    else if (node->isBefore(*root))
+    {
+        treeInsert(root->left, node);
+        if (root->left->getTreapPriority() > root->getTreapPriority())
         {
-            UAVCAN_TRACE("CanTxQueue", "Push rejected: Nothing to replace");
-            return;
+            treeRotateRight(root);
         }
-        Entry* lowestqos = p;
-        while (p)
+    }
+    else
+    {
+        treeInsert(root->right, node);
+        if (root->right->getTreapPriority() > root->getTreapPriority())
         {
-            if (lowestqos->qosHigherThan(*p))
-            {
-                lowestqos = p;
-            }
-            p = p->getNextListNode();
+            treeRotateLeft(root);
         }
-        // Note that frame with *equal* QoS will be replaced too.
-        if (lowestqos->qosHigherThan(frame, qos))           // Frame that we want to transmit has lowest QoS
+    }
+}
+
+CanTxQueue::TreeEntry* CanTxQueue::treeMerge(TreeEntry* a, TreeEntry* b)
+{
+    // All entries of a are ordered before all entries of b
+    if (a == NULL)
+    {
+        return b;
+    }
+    if (b == NULL)
+    {
+        return a;
+    }
+    if (a->getTreapPriority() > b->getTreapPriority())
+    {
+        a->right = treeMerge(a->right, b);
+        return a;
+    }
+    b->left = treeMerge(a, b->left);
+    return b;
+}
+
+bool CanTxQueue::treeRemove(TreeEntry*& root, TreeEntry* node)
+{
+    if (root == NULL)
+    {
+        return false;
+    }
+    if (root == node)
+    {
+        root = treeMerge(node->left, node->right);
+        node->left = NULL;
+        node->right = NULL;
+        return true;
+    }
+    return node->isBefore(*root) ? treeRemove(root->left, node) : treeRemove(root->right, node);
+}
+
+CanTxQueue::TreeEntry* CanTxQueue::treeFirst(TreeEntry* root, uint8_t iface_mask)
+{
+    if (iface_mask == AllIfacesMask)
+    {
+        while ((root != NULL) && (root->left != NULL))
         {
-            UAVCAN_TRACE("CanTxQueue", "Push rejected: low QoS");
-            return;                                         // What a loser.
+            root = root->left;
         }
-        UAVCAN_TRACE("CanTxQueue", "Push: Replacing %s", lowestqos->toString().c_str());
-        remove(lowestqos);
-        praw = allocator_.allocate(sizeof(Entry));        // Try again
+        return root;
     }
+    // In-order search for the first entry pending on the specified ifaces
+    if (root == NULL)
+    {
+        return NULL;
+    }
+    TreeEntry* const left = treeFirst(root->left, iface_mask);
+    if (left != NULL)
+    {
+        return left;
+    }
+    if (root->iface_mask & iface_mask)
+    {
+        return root;
+    }
+    return treeFirst(root->right, iface_mask);
+}
 
-    if (praw == NULL)
+CanTxQueue::TreeEntry* CanTxQueue::treeLast(TreeEntry* root)
+{
+    while ((root != NULL) && (root->right != NULL))
     {
-        return;                                            // Seems that there is no memory at all.
+        root = root->right;
     }
-    Entry* entry = new (praw) Entry(frame, tx_deadline, qos, flags);
-    UAVCAN_ASSERT(entry);
-    queue_.insertBefore(entry, PriorityInsertionComparator(frame));
+    return root;
 }
 
-CanTxQueue::Entry* CanTxQueue::peek()
+void CanTxQueue::treePurgeExpired(TreeEntry*& root, MonotonicTime timestamp, MonotonicTime& out_earliest_deadline)
 {
-    const MonotonicTime timestamp = sysclock_.getMonotonic();
-    Entry* p = queue_.get();
-    while (p)
+    if (root == NULL)
     {
-        if (p->isExpired(timestamp))
+        return;
+    }
+    treePurgeExpired(root->left, timestamp, out_earliest_deadline);
+    treePurgeExpired(root->right, timestamp, out_earliest_deadline);
+    if (root->isExpired(timestamp))
+    {
+        registerExpiredEntry(*root, timestamp);
+        Entry* entry = root;
+        root = treeMerge(root->left, root->right);
+        destroyEntry(entry);
+    }
+    else if (out_earliest_deadline.isZero() || (root->deadline < out_earliest_deadline))
+    {
+        out_earliest_deadline = root->deadline;
+    }
+}
+
+void CanTxQueue::treeDestroy(TreeEntry*& root)
+{
+    if (root == NULL)
+    {
+        return;
+    }
+    treeDestroy(root->left);
+    treeDestroy(root->right);
+    Entry* entry = root;
+    destroyEntry(entry);
+    root = NULL;
+}
+
+CanTxQueue::TreeEntry* CanTxQueue::treeTop(uint8_t iface_mask) const
+{
+    TreeEntry* const vol = treeFirst(tree_roots_[Volatile], iface_mask);
+    TreeEntry* const per = treeFirst(tree_roots_[Persistent], iface_mask);
+    if (vol == NULL)
+    {
+        return per;
+    }
+    if (per == NULL)
+    {
+        return vol;
+    }
+    return per->isBefore(*vol) ? per : vol;
+}
+
+const CanTxQueue::Entry* CanTxQueue::top(uint8_t iface_mask) const
+{
+    if (mode_ == ModeTreap)
+    {
+        return treeTop(iface_mask);
+    }
+    const Entry* p = queue_.get();
+    while ((p != NULL) && !(p->iface_mask & iface_mask))
+    {
+        p = p->getNextListNode();
+    }
+    return p;
+}
+
+const CanTxQueue::Entry* CanTxQueue::topPriority(uint8_t iface_mask) const
+{
+#if UAVCAN_TX_QUEUE_AGING
+    if (num_promoted_ > 0)
+    {
+        // The promoted entries go first, followed by the highest priority entry that is not promoted
+        const Entry* best = NULL;
+        if (mode_ == ModeTreap)
         {
-            UAVCAN_TRACE("CanTxQueue", "Peek: Expired %s", p->toString().c_str());
-            Entry* const next = p->getNextListNode();
-            registerRejectedFrame();
-            remove(p);
-            p = next;
+            (void)treeTopPriority(tree_roots_[Volatile], iface_mask, best);
+            (void)treeTopPriority(tree_roots_[Persistent], iface_mask, best);
+            return best;
         }
-        else
+        const Entry* p = queue_.get();
+        while (p != NULL)
         {
-            return p;
+            if (p->iface_mask & iface_mask)
+            {
+                if ((best == NULL) || p->frame.priorityHigherThan(best->frame))
+                {
+                    best = p;
+                }
+                if (!p->promoted)
+                {
+                    break;
+                }
+            }
+            p = p->getNextListNode();
         }
+        return best;
     }
-    return NULL;
+#endif
+    return top(iface_mask);
 }
 
-void CanTxQueue::remove(Entry*& entry)
+#if UAVCAN_TX_QUEUE_AGING
+MonotonicTime CanTxQueue::getPromotionTime(const Entry& entry) const
 {
-    if (entry == NULL)
+    const int64_t timeout_usec = (entry.deadline - entry.enqueued_at).toUSec();
+    return entry.enqueued_at + MonotonicDuration::fromUSec((timeout_usec * aging_percent_) / 100);
+}
+
+void CanTxQueue::registerPromotion(Entry& entry)
+{
+    UAVCAN_TRACE("CanTxQueue", "Promoted %s", entry.toString().c_str());
+    entry.promoted = 1U;
+    entry.seq = next_seq_++;
+    num_promoted_++;
+    if (aging_stats_.num_promoted < NumericTraits<uint32_t>::max())
     {
-        UAVCAN_ASSERT(0);
-        return;
+        aging_stats_.num_promoted++;
     }
-    queue_.remove(entry);
-    Entry::destroy(entry, allocator_);
+    aging_stats_.max_num_promoted = max(aging_stats_.max_num_promoted, num_promoted_);
 }
 
-const CanFrame* CanTxQueue::getTopPriorityPendingFrame() const
+bool CanTxQueue::treeTopPriority(const TreeEntry* root, uint8_t iface_mask, const Entry*& inout_best)
 {
-    return (queue_.get() == NULL) ? NULL : &queue_.get()->frame;
+    // In-order traversal over the promoted entries, up to the first matching entry that is not promoted
+    if (root == NULL)
+    {
+        return false;
+    }
+    if (treeTopPriority(root->left, iface_mask, inout_best))
+    {
+        return true;
+    }
+    if (root->iface_mask & iface_mask)
+    {
+        if ((inout_best == NULL) || root->frame.priorityHigherThan(inout_best->frame))
+        {
+            inout_best = root;
+        }
+        if (!root->promoted)
+        {
+            return true;
+        }
+    }
+    return treeTopPriority(root->right, iface_mask, inout_best);
 }
 
-bool CanTxQueue::topPriorityHigherOrEqual(const CanFrame& rhs_frame) const
+void CanTxQueue::treeCollectAged(TreeEntry* root, MonotonicTime timestamp, TreeEntry** out_aged,
+                                 unsigned& inout_num_aged, unsigned capacity, MonotonicTime& out_earliest_promotion)
 {
-    const Entry* entry = queue_.get();
-    if (entry == NULL)
+    if (root == NULL)
     {
-        return false;
+        return;
     }
-    return !rhs_frame.priorityHigherThan(entry->frame);
+    treeCollectAged(root->left, timestamp, out_aged, inout_num_aged, capacity, out_earliest_promotion);
+    if (!root->promoted)
+    {
+        const MonotonicTime promotion_time = getPromotionTime(*root);
+        if ((promotion_time <= timestamp) && (inout_num_aged < capacity))
+        {
+            out_aged[inout_num_aged++] = root;
+        }
+        else
+        {
+            out_earliest_promotion = min(out_earliest_promotion, promotion_time);
+        }
+    }
+    treeCollectAged(root->right, timestamp, out_aged, inout_num_aged, capacity, out_earliest_promotion);
 }
 
-/*
- * CanIOManager
- */
-int CanIOManager::sendToIface(uint8_t iface_index, const CanFrame& frame, MonotonicTime tx_deadline, CanIOFlags flags)
+void CanTxQueue::promoteAged(MonotonicTime timestamp)
 {
-    UAVCAN_ASSERT(iface_index < MaxCanIfaces);
-    ICanIface* const iface = driver_.getIface(iface_index);
-    if (iface == NULL)
+    if ((aging_percent_ == 0) || isEmpty() || (timestamp < earliest_promotion_))
     {
-        UAVCAN_ASSERT(0);   // Nonexistent interface
-        return -ErrLogic;
+        return;                                     // Nothing can be promoted yet
     }
-    const int res = iface->send(frame, tx_deadline, flags);
-    if (res != 1)
+
+    MonotonicTime earliest_promotion = MonotonicTime::getMax();
+
+    if (mode_ == ModeTreap)
     {
-        UAVCAN_TRACE("CanIOManager", "Send failed: code %i, iface %i, frame %s",
-                     res, iface_index, frame.toString().c_str());
+        // The tree can't be modified while it is traversed, so the aged entries are promoted in batches.
+        // The traversal is in order, so the frames of one transfer keep their relative order.
+        enum { BatchSize = 8 };
+        TreeEntry* aged[BatchSize];
+        unsigned num_aged = BatchSize;
+        while (num_aged == BatchSize)
+        {
+            num_aged = 0;
+            earliest_promotion = MonotonicTime::getMax();
+            for (int qos = Volatile; qos <= Persistent; qos++)
+            {
+                treeCollectAged(tree_roots_[qos], timestamp, aged, num_aged, BatchSize, earliest_promotion);
+            }
+            for (unsigned i = 0; i < num_aged; i++)
+            {
+                TreeEntry*& root = tree_roots_[aged[i]->qos];
+                const bool removed = treeRemove(root, aged[i]);
+                UAVCAN_ASSERT(removed);
+                (void)removed;
+                registerPromotion(*aged[i]);
+                treeInsert(root, aged[i]);
+            }
+        }
     }
-    if (res > 0)
+    else
     {
-        counters_[iface_index].frames_tx += unsigned(res);
+        Entry* last_promoted = NULL;
+        Entry* p = queue_.get();
+        while ((p != NULL) && p->promoted)
+        {
+            last_promoted = p;
+            p = p->getNextListNode();
+        }
+        while (p != NULL)
+        {
+            Entry* const next = p->getNextListNode();
+            if (!p->promoted)
+            {
+                const MonotonicTime promotion_time = getPromotionTime(*p);
+                if (promotion_time <= timestamp)
+                {
+                    queue_.remove(p);
+                    queue_.insertNewAfter(last_promoted, p);
+                    last_promoted = p;
+                    registerPromotion(*p);
+                }
+                else
+                {
+                    earliest_promotion = min(earliest_promotion, promotion_time);
+                }
+            }
+            p = next;
+        }
     }
-    return res;
+
+    earliest_promotion_ = earliest_promotion;
 }
 
-int CanIOManager::sendFromTxQueue(uint8_t iface_index)
+int CanTxQueue::setAgingPercent(uint8_t percent)
 {
-    UAVCAN_ASSERT(iface_index < MaxCanIfaces);
-    CanTxQueue::Entry* entry = tx_queues_[iface_index]->peek();
-    if (entry == NULL)
+    if (percent > 100)
     {
-        return 0;
+        return -ErrInvalidParam;
     }
-    const int res = sendToIface(iface_index, entry->frame, entry->deadline, entry->flags);
-    if (res > 0)
+    aging_percent_ = percent;
+    earliest_promotion_ = MonotonicTime();          // The promotion times of all entries will be reevaluated
+    return 0;
+}
+#endif
+
+void CanTxQueue::purgeExpired(MonotonicTime timestamp)
+{
+#if UAVCAN_TX_QUEUE_AGING
+    promoteAged(timestamp);
+#endif
+    if (isEmpty() || (timestamp <= earliest_deadline_))
+    {
+        return;                                     // Nothing can be expired yet
+    }
+
+    MonotonicTime earliest_deadline;
+
+    if (mode_ == ModeTreap)
+    {
+        treePurgeExpired(tree_roots_[Volatile], timestamp, earliest_deadline);
+        treePurgeExpired(tree_roots_[Persistent], timestamp, earliest_deadline);
+    }
+    else
+    {
+        Entry* p = queue_.get();
+        while (p)
+        {
+            Entry* const next = p->getNextListNode();
+            if (p->isExpired(timestamp))
+            {
+                registerExpiredEntry(*p, timestamp);
+                remove(p);
+            }
+            else if (earliest_deadline.isZero() || (p->deadline < earliest_deadline))
+            {
+                earliest_deadline = p->deadline;
+            }
+            p = next;
+        }
+    }
+
+    earliest_deadline_ = earliest_deadline;
+}
+
+CanTxQueue::Entry* CanTxQueue::findLowestQos()
+{
+    if (mode_ == ModeTreap)
+    {
+        // Volatile frames always lose to persistent ones; within a QoS level the last entry has the lowest priority
+        TreeEntry* const vol = treeLast(tree_roots_[Volatile]);
+        return (vol != NULL) ? vol : treeLast(tree_roots_[Persistent]);
+    }
+
+    Entry* p = queue_.get();
+    Entry* lowestqos = p;
+    while (p)
+    {
+        if (lowestqos->qosHigherThan(*p))
+        {
+            lowestqos = p;
+        }
+        p = p->getNextListNode();
+    }
+    return lowestqos;
+}
+
+bool CanTxQueue::isReplaceable(const CanFrame& frame)
+{
+    if (!frame.isExtended() || frame.isRemoteTransmissionRequest() || frame.isErrorFrame() || (frame.dlc == 0))
+    {
+        return false;
+    }
+    const uint8_t tail = frame.data[frame.dlc - 1U];
+    return (tail & 0xC0U) == 0xC0U;                 // Start and end of transfer
+}
+
+bool CanTxQueue::isReplaceableBy(const Entry& entry, const CanFrame& frame)
+{
+    static const uint32_t IDMaskWithoutPriority = CanFrame::MaskExtID & ~(uint32_t(0x1FU) << 24);
+
+    return (entry.flags & CanIOFlagReplacePending) &&
+           (((entry.frame.id ^ frame.id) & (IDMaskWithoutPriority | CanFrame::FlagEFF)) == 0) &&
+           isReplaceable(entry.frame);
+}
+
+CanTxQueue::TreeEntry* CanTxQueue::treeFindReplaceable(TreeEntry* root, const CanFrame& frame)
+{
+    if (root == NULL)
+    {
+        return NULL;
+    }
+    if (isReplaceableBy(*root, frame))
+    {
+        return root;
+    }
+    TreeEntry* const left = treeFindReplaceable(root->left, frame);
+    return (left != NULL) ? left : treeFindReplaceable(root->right, frame);
+}
+
+CanTxQueue::Entry* CanTxQueue::findReplaceable(const CanFrame& frame)
+{
+    if (mode_ == ModeTreap)
+    {
+        TreeEntry* const vol = treeFindReplaceable(tree_roots_[Volatile], frame);
+        return (vol != NULL) ? vol : treeFindReplaceable(tree_roots_[Persistent], frame);
+    }
+
+    Entry* p = queue_.get();
+    while ((p != NULL) && !isReplaceableBy(*p, frame))
+    {
+        p = p->getNextListNode();
+    }
+    return p;
+}
+
+int CanTxQueue::setMode(Mode mode)
+{
+    if (!isEmpty())
+    {
+        return -ErrLogic;
+    }
+    if ((mode != ModeLinkedList) && (mode != ModeTreap))
+    {
+        return -ErrInvalidParam;
+    }
+    mode_ = uint8_t(mode);
+    return 0;
+}
+
+void CanTxQueue::push(const CanFrame& frame, MonotonicTime tx_deadline, Qos qos, CanIOFlags flags,
+                      uint8_t iface_mask)
+{
+    const MonotonicTime timestamp = sysclock_.getMonotonic();
+
+    if (timestamp >= tx_deadline)
+    {
+        UAVCAN_TRACE("CanTxQueue", "Push rejected: already expired");
+        registerRejectedFrame(frame, TraceDropExpired, timestamp);
+        return;
+    }
+
+    if ((flags & CanIOFlagReplacePending) && isReplaceable(frame))
+    {
+        Entry* stale = findReplaceable(frame);
+        if (stale != NULL)
+        {
+            UAVCAN_TRACE("CanTxQueue", "Push: Superseding %s", stale->toString().c_str());
+            if (replaced_frames_cnt_ < NumericTraits<uint32_t>::max())
+            {
+                replaced_frames_cnt_++;
+            }
+            remove(stale);
+        }
+    }
+
+    const std::size_t entry_size = (mode_ == ModeTreap) ? sizeof(TreeEntry) : sizeof(Entry);
+    const bool high_priority = frame.isExtended() && (((frame.id >> 24) & 0x1FU) <= reserve_priority_);
+
+    void* praw = allocator_.allocate(entry_size, high_priority);
+    if (praw == NULL)
+    {
+        UAVCAN_TRACE("CanTxQueue", "Push OOM #1, cleanup");
+        // No memory left in the pool, so we try to remove expired frames
+        purgeExpired(timestamp);
+        praw = allocator_.allocate(entry_size, high_priority);     // Try again
+    }
+
+    if (praw == NULL)
+    {
+        UAVCAN_TRACE("CanTxQueue", "Push OOM #2, QoS arbitration");
+#if UAVCAN_EVENT_TRACE
+        if (event_trace_ != NULL)
+        {
+            event_trace_->record(TraceEventOutOfMemory, timestamp, frame.id, 0, uint8_t(PoolUsageTagTxQueue));
+        }
+#endif
+
+        // Find a frame with lowest QoS
+        Entry* lowestqos = findLowestQos();
+        if (lowestqos == NULL)
+        {
+            UAVCAN_TRACE("CanTxQueue", "Push rejected: Nothing to replace");
+            registerRejectedFrame(frame, TraceDropNoMemory, timestamp);
+            return;
+        }
+        // Note that frame with *equal* QoS will be replaced too.
+        if (lowestqos->qosHigherThan(frame, qos))           // Frame that we want to transmit has lowest QoS
+        {
+            UAVCAN_TRACE("CanTxQueue", "Push rejected: low QoS");
+            registerRejectedFrame(frame, TraceDropNoMemory, timestamp);
+            return;                                         // What a loser.
+        }
+        UAVCAN_TRACE("CanTxQueue", "Push: Replacing %s", lowestqos->toString().c_str());
+        registerRejectedFrame(lowestqos->frame, TraceDropNoMemory, timestamp);
+        remove(lowestqos);
+        praw = allocator_.allocate(entry_size, high_priority);     // Try again
+    }
+
+    if (praw == NULL)
+    {
+        return;                                            // Seems that there is no memory at all.
+    }
+
+    if (mode_ == ModeTreap)
+    {
+        TreeEntry* entry = new (praw) TreeEntry(frame, tx_deadline, qos, flags, iface_mask);
+        UAVCAN_ASSERT(entry);
+        registerNewEntry(*entry, timestamp);
+        treeInsert(tree_roots_[qos], entry);
+    }
+    else
+    {
+        Entry* entry = new (praw) Entry(frame, tx_deadline, qos, flags, iface_mask);
+        UAVCAN_ASSERT(entry);
+        registerNewEntry(*entry, timestamp);
+        queue_.insertBefore(entry, PriorityInsertionComparator(frame));
+    }
+}
+
+void CanTxQueue::pushBatch(const CanFrame* frames, unsigned num_frames, MonotonicTime tx_deadline, Qos qos,
+                           CanIOFlags flags, uint8_t iface_mask)
+{
+    UAVCAN_ASSERT(frames != NULL);
+    unsigned i = 0;
+
+    // The treap insertion is logarithmic anyway; replacement of the pending frames needs the regular path
+    const bool contiguous = (mode_ == ModeLinkedList) && ((flags & CanIOFlagReplacePending) == 0);
+    if (contiguous && (num_frames > 1))
+    {
+        const MonotonicTime timestamp = sysclock_.getMonotonic();
+        if (timestamp >= tx_deadline)
+        {
+            UAVCAN_TRACE("CanTxQueue", "Push batch rejected: already expired");
+            for (; i < num_frames; i++)
+            {
+                registerRejectedFrame(frames[i], TraceDropExpired, timestamp);
+            }
+            return;
+        }
+
+        Entry* prev = NULL;
+        for (; i < num_frames; i++)
+        {
+            UAVCAN_ASSERT(frames[i].id == frames[0].id);
+            const bool high_priority = frames[i].isExtended() &&
+                                       (((frames[i].id >> 24) & 0x1FU) <= reserve_priority_);
+            void* const praw = allocator_.allocate(sizeof(Entry), high_priority);
+            if (praw == NULL)
+            {
+                break;          // The rest is pushed one by one, with the regular out of memory handling
+            }
+            Entry* entry = new (praw) Entry(frames[i], tx_deadline, qos, flags, iface_mask);
+            UAVCAN_ASSERT(entry);
+            registerNewEntry(*entry, timestamp);
+            if (prev == NULL)
+            {
+                queue_.insertBefore(entry, PriorityInsertionComparator(frames[i]));
+            }
+            else
+            {
+                queue_.insertNewAfter(prev, entry);     // Same priority, so it goes right after the previous one
+            }
+            prev = entry;
+        }
+    }
+
+    for (; i < num_frames; i++)
+    {
+        push(frames[i], tx_deadline, qos, flags, iface_mask);
+    }
+}
+
+CanTxQueue::Entry* CanTxQueue::peek()
+{
+    const MonotonicTime timestamp = sysclock_.getMonotonic();
+#if UAVCAN_TX_QUEUE_AGING
+    promoteAged(timestamp);
+#endif
+
+    if (mode_ == ModeTreap)
+    {
+        while (true)
+        {
+            Entry* p = treeTop(AllIfacesMask);
+            if ((p == NULL) || !p->isExpired(timestamp))
+            {
+                return p;
+            }
+            registerExpiredEntry(*p, timestamp);
+            remove(p);
+        }
+    }
+
+    Entry* p = queue_.get();
+    while (p)
+    {
+        if (p->isExpired(timestamp))
+        {
+            Entry* const next = p->getNextListNode();
+            registerExpiredEntry(*p, timestamp);
+            remove(p);
+            p = next;
+        }
+        else
+        {
+            return p;
+        }
+    }
+    return NULL;
+}
+
+void CanTxQueue::remove(Entry*& entry)
+{
+    if (entry == NULL)
+    {
+        UAVCAN_ASSERT(0);
+        return;
+    }
+    if (mode_ == ModeTreap)
+    {
+        TreeEntry* const tree_entry = static_cast<TreeEntry*>(entry);
+        const bool removed = treeRemove(tree_roots_[(entry->qos == Persistent) ? Persistent : Volatile], tree_entry);
+        UAVCAN_ASSERT(removed);
+        (void)removed;
+    }
+    else
+    {
+        queue_.remove(entry);
+    }
+    destroyEntry(entry);
+}
+
+const CanFrame* CanTxQueue::getTopPriorityPendingFrame() const
+{
+    const Entry* const entry = topPriority(AllIfacesMask);
+    return (entry == NULL) ? NULL : &entry->frame;
+}
+
+CanTxQueue::Entry* CanTxQueue::peek(uint8_t iface_index)
+{
+    UAVCAN_ASSERT(iface_index < MaxCanIfaces);
+    const uint8_t iface_mask = uint8_t(1U << iface_index);
+    if (num_pending_[iface_index] == 0)
+    {
+        return NULL;
+    }
+
+    const MonotonicTime timestamp = sysclock_.getMonotonic();
+#if UAVCAN_TX_QUEUE_AGING
+    promoteAged(timestamp);
+#endif
+    while (true)
+    {
+        Entry* p = const_cast<Entry*>(top(iface_mask));
+        if ((p == NULL) || !p->isExpired(timestamp))
+        {
+            return p;
+        }
+        registerExpiredEntry(*p, timestamp);
+        remove(p);
+    }
+}
+
+const CanFrame* CanTxQueue::getTopPriorityPendingFrame(uint8_t iface_index) const
+{
+    UAVCAN_ASSERT(iface_index < MaxCanIfaces);
+    if (num_pending_[iface_index] == 0)
+    {
+        return NULL;
+    }
+    const Entry* const entry = topPriority(uint8_t(1U << iface_index));
+    return (entry == NULL) ? NULL : &entry->frame;
+}
+
+void CanTxQueue::release(Entry*& entry, uint8_t iface_index)
+{
+    if ((entry == NULL) || (iface_index >= MaxCanIfaces))
+    {
+        UAVCAN_ASSERT(0);
+        return;
+    }
+    const uint8_t iface_mask = uint8_t(1U << iface_index);
+    UAVCAN_ASSERT(entry->iface_mask & iface_mask);
+    if (entry->iface_mask & iface_mask)
+    {
+        entry->iface_mask = uint8_t(entry->iface_mask & ~iface_mask);
+        num_pending_[iface_index]--;
+    }
+    if ((entry->iface_mask & ((1U << MaxCanIfaces) - 1U)) == 0)
+    {
+        remove(entry);                              // Released by the last iface
+    }
+}
+
+uint8_t CanTxQueue::getPendingIfaceMask() const
+{
+    uint8_t mask = 0;
+    for (uint8_t i = 0; i < MaxCanIfaces; i++)
+    {
+        if (num_pending_[i] > 0)
+        {
+            mask = uint8_t(mask | (1U << i));
+        }
+    }
+    return mask;
+}
+
+bool CanTxQueue::topPriorityHigherOrEqual(const CanFrame& rhs_frame) const
+{
+    const Entry* const entry = topPriority(AllIfacesMask);
+    if (entry == NULL)
+    {
+        return false;
+    }
+    return !rhs_frame.priorityHigherThan(entry->frame);
+}
+
+/*
+ * CanIOManager
+ */
+uint16_t CanIOManager::getNumPendingFrames(uint8_t iface_index) const
+{
+#if UAVCAN_SHARED_TX_QUEUE
+    return uint16_t(tx_queues_[iface_index]->getNumPendingFrames(iface_index) +
+                    shared_tx_queue_->getNumPendingFrames(iface_index));
+#else
+    return tx_queues_[iface_index]->getNumPendingFrames(iface_index);
+#endif
+}
+
+const CanFrame* CanIOManager::getTopPriorityPendingFrame(uint8_t iface_index) const
+{
+    const CanFrame* const own = tx_queues_[iface_index]->getTopPriorityPendingFrame();
+#if UAVCAN_SHARED_TX_QUEUE
+    const CanFrame* const shared = shared_tx_queue_->getTopPriorityPendingFrame(iface_index);
+    if (own == NULL)
+    {
+        return shared;
+    }
+    // Own queue wins ties, same as in sendFromTxQueue()
+    return ((shared != NULL) && shared->priorityHigherThan(*own)) ? shared : own;
+#else
+    return own;
+#endif
+}
+
+bool CanIOManager::topPriorityHigherOrEqual(uint8_t iface_index, const CanFrame& rhs_frame) const
+{
+    const CanFrame* const top = getTopPriorityPendingFrame(iface_index);
+    return (top != NULL) && !rhs_frame.priorityHigherThan(*top);
+}
+
+void CanIOManager::enqueue(const CanFrame& frame, MonotonicTime tx_deadline, uint8_t iface_mask,
+                           CanTxQueue::Qos qos, CanIOFlags flags)
+{
+    UAVCAN_ASSERT(iface_mask != 0);
+#if UAVCAN_SHARED_TX_QUEUE
+    if ((iface_mask & (iface_mask - 1U)) != 0)
+    {
+        shared_tx_queue_->push(frame, tx_deadline, qos, flags, iface_mask);
+        return;
+    }
+#endif
+    for (uint8_t i = 0; i < getNumIfaces(); i++)
+    {
+        if (iface_mask & (1 << i))
+        {
+            tx_queues_[i]->push(frame, tx_deadline, qos, flags);
+        }
+    }
+}
+
+void CanIOManager::enqueueBatch(const CanFrame* frames, unsigned num_frames, MonotonicTime tx_deadline,
+                                uint8_t iface_mask, CanTxQueue::Qos qos, CanIOFlags flags)
+{
+    UAVCAN_ASSERT(iface_mask != 0);
+#if UAVCAN_SHARED_TX_QUEUE
+    if ((iface_mask & (iface_mask - 1U)) != 0)
+    {
+        shared_tx_queue_->pushBatch(frames, num_frames, tx_deadline, qos, flags, iface_mask);
+        return;
+    }
+#endif
+    for (uint8_t i = 0; i < getNumIfaces(); i++)
+    {
+        if (iface_mask & (1 << i))
+        {
+            tx_queues_[i]->pushBatch(frames, num_frames, tx_deadline, qos, flags);
+        }
+    }
+}
+
+int CanIOManager::sendToIface(uint8_t iface_index, const CanFrame& frame, MonotonicTime tx_deadline, CanIOFlags flags)
+{
+    UAVCAN_ASSERT(iface_index < MaxCanIfaces);
+    ICanIface* const iface = driver_.getIface(iface_index);
+    if (iface == NULL)
+    {
+        UAVCAN_ASSERT(0);   // Nonexistent interface
+        return -ErrLogic;
+    }
+    TokenBucket& shaper = tx_shapers_[iface_index];
+    const MonotonicTime ts = shaper.isEnabled() ? sysclock_.getMonotonic() : MonotonicTime();
+    if (!shaper.canConsume(frame.dlc, ts))
+    {
+        return 0;                                   // Normally prevented by makeShapedIfaceMask()
+    }
+    const int res = iface->send(frame, tx_deadline, CanIOFlags(flags & ~CanIOFlagReplacePending));
+    if (res != 1)
+    {
+        UAVCAN_TRACE("CanIOManager", "Send failed: code %i, iface %i, frame %s",
+                     res, iface_index, frame.toString().c_str());
+    }
+    if (res > 0)
+    {
+        counters_[iface_index].frames_tx += unsigned(res);
+        (void)shaper.tryConsume(frame.dlc, ts);
+#if UAVCAN_EVENT_TRACE
+        if (perf_ != NULL)
+        {
+            perf_->traceEvent(TraceEventFrameTx, ts, frame.id, frame.dlc, iface_index);
+        }
+#endif
+        if (!dead_iface_timeout_.isZero())
+        {
+            markIfaceAlive(iface_index, ts.isZero() ? sysclock_.getMonotonic() : ts);
+        }
+    }
+    return res;
+}
+
+void CanIOManager::markIfaceAlive(uint8_t iface_index, MonotonicTime ts)
+{
+    UAVCAN_ASSERT(iface_index < MaxCanIfaces);
+    const ICanIface* const iface = driver_.getIface(iface_index);
+    if (iface != NULL)
+    {
+        IfaceHealth& health = health_[iface_index];
+        if (health.dead)
+        {
+            UAVCAN_TRACE("CanIOManager", "Iface %i is alive again", int(iface_index));
+        }
+        health.last_alive_ts = ts;
+        health.errors_when_alive = iface->getErrorCount();
+        health.dead = false;
+    }
+}
+
+bool CanIOManager::looksDead(uint8_t iface_index, MonotonicTime ts) const
+{
+    UAVCAN_ASSERT(iface_index < num_ifaces_);
+    const ICanIface* const iface = driver_.getIface(iface_index);
+    if (iface == NULL)
+    {
+        UAVCAN_ASSERT(0);
+        return false;
+    }
+    const IfaceHealth& health = health_[iface_index];
+    if ((ts - health.last_alive_ts) <= dead_iface_timeout_)
+    {
+        return false;
+    }
+    const bool tx_stalled = getNumPendingFrames(iface_index) > 0;
+    return tx_stalled || (iface->getErrorCount() > health.errors_when_alive);
+}
+
+void CanIOManager::discardPendingFrames(uint8_t iface_index)
+{
+    uint64_t num_discarded = 0;
+    CanTxQueue::Entry* entry = NULL;
+    while ((entry = tx_queues_[iface_index]->peek()) != NULL)
+    {
+        tx_queues_[iface_index]->remove(entry);
+        num_discarded++;
+    }
+#if UAVCAN_SHARED_TX_QUEUE
+    while ((entry = shared_tx_queue_->peek(iface_index)) != NULL)
+    {
+        shared_tx_queue_->release(entry, iface_index);      // Other ifaces will still transmit it
+        num_discarded++;
+    }
+#endif
+    counters_[iface_index].frames_discarded += num_discarded;
+    UAVCAN_TRACE("CanIOManager", "Iface %i is dead, %u frames discarded", int(iface_index), unsigned(num_discarded));
+}
+
+void CanIOManager::updateIfaceHealth(MonotonicTime ts)
+{
+    for (uint8_t i = 0; i < num_ifaces_; i++)
+    {
+        IfaceHealth& health = health_[i];
+        if (!health.dead && looksDead(i, ts))
+        {
+            health.dead = true;
+            health.last_probe_ts = ts;
+            discardPendingFrames(i);
+        }
+    }
+}
+
+uint8_t CanIOManager::selectTxIfacesImpl(uint8_t iface_mask)
+{
+    iface_mask = uint8_t(iface_mask & ((1U << num_ifaces_) - 1U));
+
+    uint8_t alive_mask = iface_mask;
+    uint8_t probe_mask = 0;
+    if (!dead_iface_timeout_.isZero())
+    {
+        const MonotonicTime ts = sysclock_.getMonotonic();
+        updateIfaceHealth(ts);
+        for (uint8_t i = 0; i < num_ifaces_; i++)
+        {
+            IfaceHealth& health = health_[i];
+            if ((iface_mask & (1U << i)) && health.dead)
+            {
+                alive_mask = uint8_t(alive_mask & ~(1U << i));
+                if ((ts - health.last_probe_ts) >= dead_iface_timeout_)
+                {
+                    health.last_probe_ts = ts;
+                    probe_mask = uint8_t(probe_mask | (1U << i));
+                }
+            }
+        }
+    }
+    if (alive_mask == 0)
+    {
+        return iface_mask;              // There's nothing to lose then
+    }
+
+    if (tx_iface_policy_ == TxIfacePolicyRedundant)
+    {
+        return uint8_t(alive_mask | probe_mask);
+    }
+
+    int best = -1;
+    unsigned best_num_pending = 0;
+    for (uint8_t i = 0; i < num_ifaces_; i++)
+    {
+        if ((alive_mask & (1U << i)) == 0)
+        {
+            continue;
+        }
+        const unsigned num_pending = getNumPendingFrames(i);
+        if ((best < 0) ||
+            (num_pending < best_num_pending) ||
+            ((num_pending == best_num_pending) && (counters_[i].frames_tx < counters_[best].frames_tx)))
+        {
+            best = i;
+            best_num_pending = num_pending;
+        }
+    }
+    // The probe is sent in addition to the selected iface, so that the transfer is not lost if the probe fails
+    return (best < 0) ? uint8_t(0) : uint8_t((1U << best) | probe_mask);
+}
+
+void CanIOManager::setDeadIfaceTimeout(MonotonicDuration timeout)
+{
+    if (dead_iface_timeout_.isZero() && !timeout.isZero())
+    {
+        const MonotonicTime ts = sysclock_.getMonotonic();
+        for (uint8_t i = 0; i < num_ifaces_; i++)
+        {
+            markIfaceAlive(i, ts);      // Give every interface a chance to prove it's alive
+        }
+    }
+    dead_iface_timeout_ = max(timeout, MonotonicDuration());
+}
+
+bool CanIOManager::isIfaceDead(uint8_t iface_index) const
+{
+    if (dead_iface_timeout_.isZero() || (iface_index >= num_ifaces_))
+    {
+        return false;
+    }
+    return health_[iface_index].dead || looksDead(iface_index, sysclock_.getMonotonic());
+}
+
+int CanIOManager::sendFromTxQueue(uint8_t iface_index)
+{
+    UAVCAN_ASSERT(iface_index < MaxCanIfaces);
+    CanTxQueue::Entry* entry = tx_queues_[iface_index]->peek();
+#if UAVCAN_SHARED_TX_QUEUE
+    CanTxQueue::Entry* const shared_entry = shared_tx_queue_->peek(iface_index);
+    bool from_shared = (shared_entry != NULL) &&
+                       ((entry == NULL) || shared_entry->frame.priorityHigherThan(entry->frame));
+# if UAVCAN_TX_QUEUE_AGING
+    if ((shared_entry != NULL) && (entry != NULL) && (shared_entry->promoted != entry->promoted))
+    {
+        from_shared = shared_entry->promoted != 0;  // The promoted entry goes first regardless of the priority
+    }
+# endif
+    if (from_shared)
+    {
+        entry = shared_entry;
+    }
+#endif
+    if (entry == NULL)
+    {
+        return 0;
+    }
+    const int res = sendToIface(iface_index, entry->frame, entry->deadline, entry->flags);
+    if (res > 0)
+    {
+#if UAVCAN_LATENCY_STATS
+        if (perf_ != NULL)
+        {
+            perf_->sampleLatency(LatencyStageTxTransportToDriver, entry->enqueued_at);
+        }
+#endif
+#if UAVCAN_SHARED_TX_QUEUE
+        if (from_shared)
+        {
+            shared_tx_queue_->release(entry, iface_index);
+        }
+        else
+#endif
+        {
+            tx_queues_[iface_index]->remove(entry);
+        }
+        sampleDrainRate(iface_index);
+    }
+    return res;
+}
+
+int CanIOManager::sendBatchFromTxQueue(uint8_t iface_index)
+{
+    UAVCAN_ASSERT(iface_index < MaxCanIfaces);
+    const ICanIface* const iface = driver_.getIface(iface_index);
+    unsigned num_free_slots = (iface == NULL) ? 0U : iface->getNumFreeTxSlots();
+    int num_sent = 0;
+    while (num_free_slots > 0)
+    {
+        const int res = sendFromTxQueue(iface_index);
+        if (res <= 0)
+        {
+            break;
+        }
+        num_sent += res;
+        num_free_slots--;
+    }
+    return num_sent;
+}
+
+void CanIOManager::sampleDrainRate(uint8_t iface_index)
+{
+    IfaceDrainRateEstimator& est = drain_rates_[iface_index];
+    const MonotonicTime ts = sysclock_.getMonotonic();
+    if (!est.last_tx_ts.isZero())
+    {
+        // Exponential moving average with the weight of 1/8; the interval is never zero, since zero means unknown
+        const int64_t interval = max<int64_t>(min<int64_t>((ts - est.last_tx_ts).toUSec(), 0xFFFFFFFF), 1);
+        const int64_t avg = (est.avg_interval_usec == 0) ? interval :
+                            (int64_t(est.avg_interval_usec) + (interval - int64_t(est.avg_interval_usec)) / 8);
+        est.avg_interval_usec = uint32_t(max<int64_t>(avg, 1));
+    }
+    // The idle time between bursts must not be accounted for
+    const bool backlogged = getNumPendingFrames(iface_index) > 0;
+    est.last_tx_ts = backlogged ? ts : MonotonicTime();
+}
+
+int CanIOManager::callSelect(CanSelectMasks& inout_masks, const CanFrame* (& pending_tx)[MaxCanIfaces],
+                             MonotonicTime blocking_deadline)
+{
+    const CanSelectMasks in_masks = inout_masks;
+
+#if UAVCAN_DUTY_CYCLE_STATS
+    const DutyCycleScope duty_cycle_scope(perf_, DutyCycleCategoryNone);     // Blocked, not busy
+#endif
+    const int res = driver_.select(inout_masks, pending_tx, blocking_deadline);
+    sysclock_.invalidate();                 // Time has passed while blocked
+    if (res < 0)
+    {
+        return -ErrDriver;
+    }
+
+    inout_masks.read  &= in_masks.read;  // Driver is not required to clean the masks
+    inout_masks.write &= in_masks.write;
+    return res;
+}
+
+uint8_t CanIOManager::makeShapedIfaceMask(const CanFrame* (& pending_tx)[MaxCanIfaces], MonotonicTime& inout_deadline)
+{
+    uint8_t mask = 0;
+    MonotonicTime ts;
+    for (uint8_t i = 0; i < getNumIfaces(); i++)
+    {
+        TokenBucket& shaper = tx_shapers_[i];
+        if ((pending_tx[i] == NULL) || !shaper.isEnabled())
+        {
+            continue;
+        }
+        if (ts.isZero())
+        {
+            ts = sysclock_.getMonotonic();
+        }
+        if (!shaper.canConsume(pending_tx[i]->dlc, ts))
+        {
+            // Not writeable until the bucket is refilled, so the caller should wake up at that moment
+            mask = uint8_t(mask | (1U << i));
+            inout_deadline = min(inout_deadline, shaper.getAvailabilityTime(pending_tx[i]->dlc));
+        }
+    }
+    return mask;
+}
+
+CanIOManager::CanIOManager(ICanDriver& driver, IPoolAllocator& allocator, ISystemClock& sysclock,
+                           std::size_t mem_blocks_per_iface)
+    : driver_(driver)
+    , sysclock_(sysclock)
+    , mem_blocks_per_queue_(0)
+    , num_ifaces_(driver.getNumIfaces())
+    , tx_iface_policy_(TxIfacePolicyRedundant)
+    , rx_priority_order_enabled_(false)
+#if UAVCAN_LATENCY_STATS || UAVCAN_EXECUTION_TIME_STATS || UAVCAN_EVENT_TRACE || UAVCAN_DUTY_CYCLE_STATS
+    , perf_(NULL)
+#endif
+{
+    if (num_ifaces_ < 1 || num_ifaces_ > MaxCanIfaces)
+    {
+        handleFatalError("Num ifaces");
+    }
+
+    if (mem_blocks_per_iface == 0)
+    {
+        mem_blocks_per_iface = allocator.getBlockCapacity() / (num_ifaces_ + 1U) + 1U;
+    }
+    UAVCAN_TRACE("CanIOManager", "Memory blocks per iface: %u, total: %u",
+                 unsigned(mem_blocks_per_iface), unsigned(allocator.getBlockCapacity()));
+    mem_blocks_per_queue_ = uint16_t(min<std::size_t>(mem_blocks_per_iface, 0xFFFFU));
+
+    for (int i = 0; i < num_ifaces_; i++)
+    {
+        tx_queues_[i].construct<IPoolAllocator&, ISystemClock&, std::size_t>
+        (allocator, sysclock_, mem_blocks_per_iface);
+    }
+#if UAVCAN_SHARED_TX_QUEUE
+    // One shared entry replaces up to num_ifaces_ per-iface entries, so the same quota is adequate
+    shared_tx_queue_.construct<IPoolAllocator&, ISystemClock&, std::size_t>
+    (allocator, sysclock_, mem_blocks_per_iface);
+#endif
+}
+
+#if UAVCAN_LATENCY_STATS || UAVCAN_EXECUTION_TIME_STATS || UAVCAN_EVENT_TRACE || UAVCAN_DUTY_CYCLE_STATS
+void CanIOManager::setTransferPerfCounter(TransferPerfCounter* perf)
+{
+    perf_ = perf;
+# if UAVCAN_EVENT_TRACE
+    EventTrace* const trace = (perf == NULL) ? NULL : &perf->getEventTrace();
+    for (uint8_t i = 0; i < num_ifaces_; i++)
+    {
+        tx_queues_[i]->setEventTrace(trace);
+    }
+#  if UAVCAN_SHARED_TX_QUEUE
+    shared_tx_queue_->setEventTrace(trace);
+#  endif
+# endif
+}
+#endif
+
+uint8_t CanIOManager::makePendingTxMask() const
+{
+#if UAVCAN_SHARED_TX_QUEUE
+    uint8_t write_mask = uint8_t(shared_tx_queue_->getPendingIfaceMask() & ((1U << getNumIfaces()) - 1U));
+#else
+    uint8_t write_mask = 0;
+#endif
+    for (uint8_t i = 0; i < getNumIfaces(); i++)
+    {
+        if (!tx_queues_[i]->isEmpty())
+        {
+            write_mask = uint8_t(write_mask | (1 << i));
+        }
+    }
+    return write_mask;
+}
+
+int CanIOManager::setTxQueueMode(CanTxQueue::Mode mode)
+{
+#if UAVCAN_SHARED_TX_QUEUE
+    if (!shared_tx_queue_->isEmpty())
+    {
+        return -ErrLogic;
+    }
+#endif
+    for (uint8_t i = 0; i < getNumIfaces(); i++)
+    {
+        if (!tx_queues_[i]->isEmpty())
+        {
+            return -ErrLogic;
+        }
+    }
+    for (uint8_t i = 0; i < getNumIfaces(); i++)
+    {
+        const int res = tx_queues_[i]->setMode(mode);
+        if (res < 0)
+        {
+            return res;
+        }
+    }
+#if UAVCAN_SHARED_TX_QUEUE
+    return shared_tx_queue_->setMode(mode);
+#else
+    return 0;
+#endif
+}
+
+#if UAVCAN_TX_QUEUE_AGING
+int CanIOManager::setTxQueueAgingPercent(uint8_t percent)
+{
+    for (uint8_t i = 0; i < getNumIfaces(); i++)
+    {
+        const int res = tx_queues_[i]->setAgingPercent(percent);
+        if (res < 0)
+        {
+            return res;
+        }
+    }
+# if UAVCAN_SHARED_TX_QUEUE
+    return shared_tx_queue_->setAgingPercent(percent);
+# else
+    return 0;
+# endif
+}
+
+CanTxQueue::AgingStats CanIOManager::getTxQueueAgingStats() const
+{
+# if UAVCAN_SHARED_TX_QUEUE
+    CanTxQueue::AgingStats total = shared_tx_queue_->getAgingStats();
+# else
+    CanTxQueue::AgingStats total;
+# endif
+    for (uint8_t i = 0; i < getNumIfaces(); i++)
     {
-        tx_queues_[iface_index]->remove(entry);
+        const CanTxQueue::AgingStats& stats = tx_queues_[i]->getAgingStats();
+        total.num_promoted += stats.num_promoted;
+        total.num_expired_after_promotion += stats.num_expired_after_promotion;
+        total.max_num_promoted = max(total.max_num_promoted, stats.max_num_promoted);
     }
-    return res;
+    return total;
 }
+#endif
 
-int CanIOManager::callSelect(CanSelectMasks& inout_masks, const CanFrame* (& pending_tx)[MaxCanIfaces],
-                             MonotonicTime blocking_deadline)
+int CanIOManager::setAdaptiveTxQuota(uint16_t min_blocks_per_queue, uint16_t reserved_blocks,
+                                     TransferPriority reserve_priority)
 {
-    const CanSelectMasks in_masks = inout_masks;
+    const unsigned num_queues = getNumTxQueues();
+    const unsigned budget = min(unsigned(mem_blocks_per_queue_) * num_queues, 0xFFFFU);
+    if ((min_blocks_per_queue == 0) || !reserve_priority.isValid() ||
+        ((unsigned(min_blocks_per_queue) * num_queues + reserved_blocks) > budget))
+    {
+        return -ErrInvalidParam;
+    }
 
-    const int res = driver_.select(inout_masks, pending_tx, blocking_deadline);
-    if (res < 0)
+    disableAdaptiveTxQuota();
+    tx_quota_.setLimits(uint16_t(budget), reserved_blocks);
+    for (uint8_t i = 0; i < num_ifaces_; i++)
     {
-        return -ErrDriver;
+        tx_queues_[i]->setSharedQuota(&tx_quota_, min_blocks_per_queue, reserve_priority);
     }
+#if UAVCAN_SHARED_TX_QUEUE
+    shared_tx_queue_->setSharedQuota(&tx_quota_, min_blocks_per_queue, reserve_priority);
+#endif
 
-    inout_masks.read  &= in_masks.read;  // Driver is not required to clean the masks
-    inout_masks.write &= in_masks.write;
-    return res;
+    UAVCAN_TRACE("CanIOManager", "Adaptive TX quota: budget %u, min %u, reserved %u",
+                 budget, unsigned(min_blocks_per_queue), unsigned(reserved_blocks));
+    return 0;
 }
 
-CanIOManager::CanIOManager(ICanDriver& driver, IPoolAllocator& allocator, ISystemClock& sysclock,
-                           std::size_t mem_blocks_per_iface)
-    : driver_(driver)
-    , sysclock_(sysclock)
-    , num_ifaces_(driver.getNumIfaces())
+void CanIOManager::disableAdaptiveTxQuota()
 {
-    if (num_ifaces_ < 1 || num_ifaces_ > MaxCanIfaces)
+    for (uint8_t i = 0; i < num_ifaces_; i++)
     {
-        handleFatalError("Num ifaces");
+        tx_queues_[i]->setSharedQuota(NULL, 0, TransferPriority::NumericallyMin);
     }
+#if UAVCAN_SHARED_TX_QUEUE
+    shared_tx_queue_->setSharedQuota(NULL, 0, TransferPriority::NumericallyMin);
+#endif
+    UAVCAN_ASSERT(tx_quota_.getNumCommittedBlocks() == 0);
+    tx_quota_.setLimits(0, 0);
+}
 
-    if (mem_blocks_per_iface == 0)
+void CanIOManager::cleanup(MonotonicTime ts)
+{
+    for (uint8_t i = 0; i < getNumIfaces(); i++)
     {
-        mem_blocks_per_iface = allocator.getBlockCapacity() / (num_ifaces_ + 1U) + 1U;
+        tx_queues_[i]->purgeExpired(ts);
     }
-    UAVCAN_TRACE("CanIOManager", "Memory blocks per iface: %u, total: %u",
-                 unsigned(mem_blocks_per_iface), unsigned(allocator.getBlockCapacity()));
-
-    for (int i = 0; i < num_ifaces_; i++)
+#if UAVCAN_SHARED_TX_QUEUE
+    shared_tx_queue_->purgeExpired(ts);
+#endif
+    if (!dead_iface_timeout_.isZero())
     {
-        tx_queues_[i].construct<IPoolAllocator&, ISystemClock&, std::size_t>
-        (allocator, sysclock, mem_blocks_per_iface);
+        updateIfaceHealth(ts);
     }
 }
 
-uint8_t CanIOManager::makePendingTxMask() const
+MonotonicTime CanIOManager::getEarliestTxDeadline() const
 {
-    uint8_t write_mask = 0;
+#if UAVCAN_SHARED_TX_QUEUE
+    MonotonicTime earliest = shared_tx_queue_->getEarliestDeadline();
+#else
+    MonotonicTime earliest = MonotonicTime::getMax();
+#endif
     for (uint8_t i = 0; i < getNumIfaces(); i++)
     {
-        if (!tx_queues_[i]->isEmpty())
-        {
-            write_mask = uint8_t(write_mask | (1 << i));
-        }
+        earliest = min(earliest, tx_queues_[i]->getEarliestDeadline());
     }
-    return write_mask;
+    return earliest;
 }
 
 CanIfacePerfCounters CanIOManager::getIfacePerfCounters(uint8_t iface_index) const
@@ -329,15 +1570,69 @@ CanIfacePerfCounters CanIOManager::getIfacePerfCounters(uint8_t iface_index) con
         return CanIfacePerfCounters();
     }
     CanIfacePerfCounters cnt;
-    cnt.errors = iface->getErrorCount() + tx_queues_[iface_index]->getRejectedFrameCount();
+    cnt.errors = iface->getErrorCount() + tx_queues_[iface_index]->getRejectedFrameCount() +
+                 counters_[iface_index].frames_discarded;
+#if UAVCAN_SHARED_TX_QUEUE
+    // Frames rejected from the shared queue are accounted for every iface, as if they were queued separately
+    cnt.errors += shared_tx_queue_->getRejectedFrameCount();
+#endif
     cnt.frames_rx = counters_[iface_index].frames_rx;
     cnt.frames_tx = counters_[iface_index].frames_tx;
+    cnt.frames_deferred = counters_[iface_index].frames_deferred;
     return cnt;
 }
 
+CanIfaceTxQueueStatus CanIOManager::getIfaceTxQueueStatus(uint8_t iface_index) const
+{
+    CanIfaceTxQueueStatus status;
+    if (iface_index >= getNumIfaces())
+    {
+        UAVCAN_ASSERT(0);
+        return status;
+    }
+    status.num_pending_frames = getNumPendingFrames(iface_index);
+#if UAVCAN_SHARED_TX_QUEUE
+    status.num_free_blocks = min(tx_queues_[iface_index]->getNumFreeBlocks(), shared_tx_queue_->getNumFreeBlocks());
+#else
+    status.num_free_blocks = tx_queues_[iface_index]->getNumFreeBlocks();
+#endif
+
+    const uint32_t avg_interval_usec = drain_rates_[iface_index].avg_interval_usec;
+    if (status.num_pending_frames == 0)
+    {
+        status.estimated_drain_time = MonotonicDuration();
+    }
+    else if (avg_interval_usec == 0)
+    {
+        status.estimated_drain_time = MonotonicDuration::getInfinite();
+    }
+    else
+    {
+        status.estimated_drain_time =
+            MonotonicDuration::fromUSec(int64_t(status.num_pending_frames) * int64_t(avg_interval_usec));
+    }
+    return status;
+}
+
+int CanIOManager::setIfaceTxRateLimit(uint8_t iface_index, uint32_t bytes_per_sec, uint32_t burst_bytes)
+{
+    if ((iface_index >= getNumIfaces()) || ((bytes_per_sec > 0) && (burst_bytes < CanFrame::MaxDataLen)))
+    {
+        return -ErrInvalidParam;
+    }
+    tx_shapers_[iface_index].configure(bytes_per_sec, burst_bytes);
+    return 0;
+}
+
 int CanIOManager::send(const CanFrame& frame, MonotonicTime tx_deadline, MonotonicTime blocking_deadline,
                        uint8_t iface_mask, CanTxQueue::Qos qos, CanIOFlags flags)
 {
+#if UAVCAN_EXECUTION_TIME_STATS
+    const ExecutionTimeScope execution_time_scope(perf_, ExecutionStageTxSend);
+#endif
+#if UAVCAN_DUTY_CYCLE_STATS
+    const DutyCycleScope duty_cycle_scope(perf_, DutyCycleCategoryTx);
+#endif
     const uint8_t num_ifaces = getNumIfaces();
     const uint8_t all_ifaces_mask = uint8_t((1U << num_ifaces) - 1);
     iface_mask &= all_ifaces_mask;
@@ -347,6 +1642,20 @@ int CanIOManager::send(const CanFrame& frame, MonotonicTime tx_deadline, Monoton
         blocking_deadline = tx_deadline;
     }
 
+    // All the code below, including the TX queues, shares one clock reading per select() call
+    CachedSystemClock::Scope clock_scope(sysclock_);
+
+    const MonotonicTime started_at = sysclock_.getMonotonic();
+    if (started_at >= tx_deadline)
+    {
+        // Not worth a driver call; the queues will reject the frame and account for it
+        if (iface_mask != 0)
+        {
+            enqueue(frame, tx_deadline, iface_mask, qos, flags);
+        }
+        return 0;
+    }
+
     int retval = 0;
 
     while (true)        // Somebody please refactor this.
@@ -358,24 +1667,28 @@ int CanIOManager::send(const CanFrame& frame, MonotonicTime tx_deadline, Monoton
 
         CanSelectMasks masks;
         masks.write = iface_mask | makePendingTxMask();
+        uint8_t shaped_mask = 0;
         {
             // Building the list of next pending frames per iface.
             // The driver will give them a scrutinizing look before deciding whether he wants to accept them.
             const CanFrame* pending_tx[MaxCanIfaces] = {};
-            for (int i = 0; i < num_ifaces; i++)
+            for (uint8_t i = 0; i < num_ifaces; i++)
             {
-                CanTxQueue& q = *tx_queues_[i];
                 if (iface_mask & (1 << i))      // I hate myself so much right now.
                 {
-                    pending_tx[i] = q.topPriorityHigherOrEqual(frame) ? q.getTopPriorityPendingFrame() : &frame;
+                    pending_tx[i] = topPriorityHigherOrEqual(i, frame) ? getTopPriorityPendingFrame(i) : &frame;
                 }
                 else
                 {
-                    pending_tx[i] = q.getTopPriorityPendingFrame();
+                    pending_tx[i] = getTopPriorityPendingFrame(i);
                 }
             }
 
-            const int select_res = callSelect(masks, pending_tx, blocking_deadline);
+            MonotonicTime select_deadline = blocking_deadline;
+            shaped_mask = makeShapedIfaceMask(pending_tx, select_deadline);
+            masks.write = uint8_t(masks.write & ~shaped_mask);
+
+            const int select_res = callSelect(masks, pending_tx, select_deadline);
             if (select_res < 0)
             {
                 return -ErrDriver;
@@ -391,7 +1704,7 @@ int CanIOManager::send(const CanFrame& frame, MonotonicTime tx_deadline, Monoton
                 int res = 0;
                 if (iface_mask & (1 << i))
                 {
-                    if (tx_queues_[i]->topPriorityHigherOrEqual(frame))
+                    if (topPriorityHigherOrEqual(i, frame))
                     {
                         res = sendFromTxQueue(i);                 // May return 0 if nothing to transmit (e.g. expired)
                     }
@@ -401,6 +1714,12 @@ int CanIOManager::send(const CanFrame& frame, MonotonicTime tx_deadline, Monoton
                         if (res > 0)
                         {
                             iface_mask &= uint8_t(~(1 << i));     // Mark transmitted
+#if UAVCAN_LATENCY_STATS
+                            if (perf_ != NULL)
+                            {
+                                perf_->sampleLatency(LatencyStageTxTransportToDriver, started_at);
+                            }
+#endif
                         }
                     }
                 }
@@ -411,6 +1730,11 @@ int CanIOManager::send(const CanFrame& frame, MonotonicTime tx_deadline, Monoton
                 if (res > 0)
                 {
                     retval++;
+                    // The driver may take more frames at once; that doesn't apply until the new frame is sent
+                    if ((iface_mask & (1 << i)) == 0)
+                    {
+                        retval += sendBatchFromTxQueue(i);
+                    }
                 }
             }
         }
@@ -424,22 +1748,302 @@ int CanIOManager::send(const CanFrame& frame, MonotonicTime tx_deadline, Monoton
                 UAVCAN_TRACE("CanIOManager", "Send: Premature timeout in select(), will try again");
                 continue;
             }
+            if (iface_mask != 0)
+            {
+                for (uint8_t i = 0; i < num_ifaces; i++)
+                {
+                    if (iface_mask & shaped_mask & (1 << i))
+                    {
+                        counters_[i].frames_deferred++;
+                    }
+                }
+                enqueue(frame, tx_deadline, iface_mask, qos, flags);
+            }
+            break;
+        }
+    }
+    return retval;
+}
+
+int CanIOManager::sendBatch(const CanFrame* frames, unsigned num_frames, MonotonicTime tx_deadline,
+                            MonotonicTime blocking_deadline, uint8_t iface_mask, CanTxQueue::Qos qos,
+                            CanIOFlags flags)
+{
+    UAVCAN_ASSERT(frames != NULL);
+    if (num_frames <= 1)
+    {
+        return (num_frames == 0) ? 0 : send(frames[0], tx_deadline, blocking_deadline, iface_mask, qos, flags);
+    }
+
+#if UAVCAN_EXECUTION_TIME_STATS
+    const ExecutionTimeScope execution_time_scope(perf_, ExecutionStageTxSend);
+#endif
+#if UAVCAN_DUTY_CYCLE_STATS
+    const DutyCycleScope duty_cycle_scope(perf_, DutyCycleCategoryTx);
+#endif
+    const uint8_t num_ifaces = getNumIfaces();
+    const uint8_t all_ifaces_mask = uint8_t((1U << num_ifaces) - 1);
+    iface_mask &= all_ifaces_mask;              // Ifaces that still have frames of the batch to transmit
+
+    if (blocking_deadline > tx_deadline)
+    {
+        blocking_deadline = tx_deadline;
+    }
+
+    CachedSystemClock::Scope clock_scope(sysclock_);
+
+    const MonotonicTime started_at = sysclock_.getMonotonic();
+    if (started_at >= tx_deadline)
+    {
+        if (iface_mask != 0)
+        {
+            enqueueBatch(frames, num_frames, tx_deadline, iface_mask, qos, flags);
+        }
+        return 0;
+    }
+
+    unsigned next_frame[MaxCanIfaces] = {};     // Index of the first frame not transmitted yet, per iface
+    uint8_t shaped_mask = 0;
+    int retval = 0;
+
+    while (iface_mask != 0)
+    {
+        CanSelectMasks masks;
+        masks.write = iface_mask | makePendingTxMask();
+        {
+            const CanFrame* pending_tx[MaxCanIfaces] = {};
             for (uint8_t i = 0; i < num_ifaces; i++)
             {
-                if (iface_mask & (1 << i))
+                const CanFrame* const next = (iface_mask & (1 << i)) ? &frames[next_frame[i]] : NULL;
+                pending_tx[i] = ((next == NULL) || topPriorityHigherOrEqual(i, *next)) ?
+                                getTopPriorityPendingFrame(i) : next;
+            }
+
+            MonotonicTime select_deadline = blocking_deadline;
+            shaped_mask = makeShapedIfaceMask(pending_tx, select_deadline);
+            masks.write = uint8_t(masks.write & ~shaped_mask);
+
+            const int select_res = callSelect(masks, pending_tx, select_deadline);
+            if (select_res < 0)
+            {
+                return -ErrDriver;
+            }
+            UAVCAN_ASSERT(masks.read == 0);
+        }
+
+        // Transmission; the frames of the batch share the CAN ID, so the queued frames are compared only once
+        bool progress = false;
+        for (uint8_t i = 0; i < num_ifaces; i++)
+        {
+            if ((masks.write & (1 << i)) == 0)
+            {
+                continue;
+            }
+            int res = 0;
+            if (iface_mask & (1 << i))
+            {
+                if (topPriorityHigherOrEqual(i, frames[next_frame[i]]))
+                {
+                    res = sendFromTxQueue(i);
+                }
+                if (res <= 0)
+                {
+                    res = sendToIface(i, frames[next_frame[i]], tx_deadline, flags);
+                    if (res > 0)
+                    {
+                        next_frame[i]++;
+                        // The driver may take more frames at once
+                        const ICanIface* const iface = driver_.getIface(i);
+                        unsigned num_free_slots = (iface == NULL) ? 0U : iface->getNumFreeTxSlots();
+                        while ((num_free_slots > 0) && (next_frame[i] < num_frames))
+                        {
+                            const int batch_res = sendToIface(i, frames[next_frame[i]], tx_deadline, flags);
+                            if (batch_res <= 0)
+                            {
+                                break;
+                            }
+                            res += batch_res;
+                            next_frame[i]++;
+                            num_free_slots--;
+                        }
+                        if (next_frame[i] >= num_frames)
+                        {
+                            iface_mask &= uint8_t(~(1 << i));     // Mark transmitted
+                        }
+#if UAVCAN_LATENCY_STATS
+                        if (perf_ != NULL)
+                        {
+                            perf_->sampleLatency(LatencyStageTxTransportToDriver, started_at);
+                        }
+#endif
+                    }
+                }
+                progress = progress || (res > 0);
+            }
+            else
+            {
+                res = sendFromTxQueue(i);
+            }
+            if (res > 0)
+            {
+                retval += res;
+                if ((iface_mask & (1 << i)) == 0)
                 {
-                    tx_queues_[i]->push(frame, tx_deadline, qos, flags);
+                    retval += sendBatchFromTxQueue(i);
                 }
             }
+        }
+
+        // Every frame is given its own chance to be transmitted, as if it were sent separately
+        const bool timed_out = sysclock_.getMonotonic() >= blocking_deadline;
+        if (masks.write == 0 || timed_out)
+        {
+            if (!timed_out || progress)
+            {
+                continue;
+            }
             break;
         }
     }
+
+    // The rest is enqueued; the frames that are left on more ifaces come later in the batch
+    unsigned first = num_frames;
+    for (uint8_t i = 0; i < num_ifaces; i++)
+    {
+        if (iface_mask & (1 << i))
+        {
+            first = min(first, next_frame[i]);
+            if (shaped_mask & (1 << i))
+            {
+                counters_[i].frames_deferred += num_frames - next_frame[i];
+            }
+        }
+    }
+    while (first < num_frames)
+    {
+        uint8_t mask = 0;
+        unsigned last = num_frames;
+        for (uint8_t i = 0; i < num_ifaces; i++)
+        {
+            if (iface_mask & (1 << i))
+            {
+                if (next_frame[i] <= first)
+                {
+                    mask = uint8_t(mask | (1 << i));
+                }
+                else
+                {
+                    last = min(last, next_frame[i]);
+                }
+            }
+        }
+        UAVCAN_ASSERT((mask != 0) && (last > first));
+        enqueueBatch(&frames[first], last - first, tx_deadline, mask, qos, flags);
+        first = last;
+    }
     return retval;
 }
 
+int CanIOManager::receiveFromIface(uint8_t iface_index, CanRxFrame* out_frames, CanIOFlags* out_flags,
+                                   unsigned max_frames)
+{
+    ICanIface* const iface = driver_.getIface(iface_index);
+    if (iface == NULL)
+    {
+        UAVCAN_ASSERT(0);   // Nonexistent interface
+        return 0;
+    }
+
+    const uint16_t capacity = uint16_t(min(max_frames, 0xFFFFU));
+    const int res = iface->receiveBatch(out_frames, out_flags, capacity);
+    if (res <= 0)
+    {
+        return res;
+    }
+    UAVCAN_ASSERT(unsigned(res) <= capacity);
+
+    for (unsigned k = 0; k < unsigned(res); k++)
+    {
+        out_frames[k].iface_index = iface_index;
+        if (!(out_flags[k] & CanIOFlagLoopback))
+        {
+            counters_[iface_index].frames_rx += 1;
+        }
+    }
+    if (!dead_iface_timeout_.isZero())
+    {
+        markIfaceAlive(iface_index, out_frames[unsigned(res) - 1U].ts_mono);
+    }
+    return res;
+}
+
+int CanIOManager::receiveInPriorityOrder(uint8_t& inout_read_mask, CanRxFrame* out_frames, CanIOFlags* out_flags,
+                                         unsigned max_frames)
+{
+    CanFrame heads[MaxCanIfaces];
+    uint8_t peeked_mask = 0;
+    for (uint8_t i = 0; i < getNumIfaces(); i++)
+    {
+        if (inout_read_mask & (1 << i))
+        {
+            ICanIface* const iface = driver_.getIface(i);
+            const int16_t res = (iface == NULL) ? int16_t(-ErrNotSupported) : iface->peekRxFrameId(heads[i].id);
+            if (res >= 0)
+            {
+                // The interface is served here or has nothing to read; either way it's excluded from draining
+                inout_read_mask = uint8_t(inout_read_mask & ~(1 << i));
+                peeked_mask = uint8_t(peeked_mask | ((res > 0) ? (1 << i) : 0));
+            }
+        }
+    }
+
+    unsigned num_received = 0;
+    while ((peeked_mask != 0) && (num_received < max_frames))
+    {
+        uint8_t best = MaxCanIfaces;
+        for (uint8_t i = 0; i < getNumIfaces(); i++)
+        {
+            if ((peeked_mask & (1 << i)) && ((best == MaxCanIfaces) || heads[i].priorityHigherThan(heads[best])))
+            {
+                best = i;
+            }
+        }
+        UAVCAN_ASSERT(best < MaxCanIfaces);
+
+        const int res = receiveFromIface(best, out_frames + num_received, out_flags + num_received, 1);
+        if (res < 0)
+        {
+            return (num_received > 0) ? int(num_received) : res;    // Error will be reported on the next call
+        }
+        num_received += unsigned(res);
+
+        if ((res == 0) || (driver_.getIface(best)->peekRxFrameId(heads[best].id) <= 0))
+        {
+            peeked_mask = uint8_t(peeked_mask & ~(1 << best));
+        }
+    }
+    return int(num_received);
+}
+
 int CanIOManager::receive(CanRxFrame& out_frame, MonotonicTime blocking_deadline, CanIOFlags& out_flags)
 {
+    return receiveBatch(&out_frame, &out_flags, 1, blocking_deadline);
+}
+
+int CanIOManager::receiveBatch(CanRxFrame* out_frames, CanIOFlags* out_flags, unsigned max_frames,
+                               MonotonicTime blocking_deadline)
+{
+    if ((out_frames == NULL) || (out_flags == NULL) || (max_frames == 0))
+    {
+        UAVCAN_ASSERT(0);
+        return -ErrInvalidParam;
+    }
+
     const uint8_t num_ifaces = getNumIfaces();
+    CachedSystemClock::Scope clock_scope(sysclock_);     // See send()
+#if UAVCAN_DUTY_CYCLE_STATS
+    const DutyCycleScope duty_cycle_scope(perf_, DutyCycleCategoryRx);
+#endif
 
     while (true)
     {
@@ -448,55 +2052,76 @@ int CanIOManager::receive(CanRxFrame& out_frame, MonotonicTime blocking_deadline
         masks.read = uint8_t((1 << num_ifaces) - 1);
         {
             const CanFrame* pending_tx[MaxCanIfaces] = {};
-            for (int i = 0; i < num_ifaces; i++)      // Dear compiler, kindly unroll this. Thanks.
+            for (uint8_t i = 0; i < num_ifaces; i++)  // Dear compiler, kindly unroll this. Thanks.
             {
-                pending_tx[i] = tx_queues_[i]->getTopPriorityPendingFrame();
+                pending_tx[i] = getTopPriorityPendingFrame(i);
             }
 
-            const int select_res = callSelect(masks, pending_tx, blocking_deadline);
+            MonotonicTime select_deadline = blocking_deadline;
+            masks.write = uint8_t(masks.write & ~makeShapedIfaceMask(pending_tx, select_deadline));
+
+            const int select_res = callSelect(masks, pending_tx, select_deadline);
             if (select_res < 0)
             {
                 return -ErrDriver;
             }
         }
 
-        // Write - if buffers are not empty, one frame will be sent for each iface per one receive() call
+        // Write - if buffers are not empty, at least one frame will be sent for each iface per one receive() call
         for (uint8_t i = 0; i < num_ifaces; i++)
         {
             if (masks.write & (1 << i))
             {
-                (void)sendFromTxQueue(i);  // It may fail, we don't care. Requested operation was receive, not send.
+#if UAVCAN_DUTY_CYCLE_STATS
+                const DutyCycleScope tx_duty_cycle_scope(perf_, DutyCycleCategoryTx);
+#endif
+                // It may fail, we don't care. Requested operation was receive, not send.
+                if (sendFromTxQueue(i) > 0)
+                {
+                    (void)sendBatchFromTxQueue(i);
+                }
             }
         }
 
-        // Read
-        for (uint8_t i = 0; i < num_ifaces; i++)
+        // Read - draining all readable ifaces until the output buffer is full
+        unsigned num_received = 0;
+        if (rx_priority_order_enabled_)
+        {
+            const int res = receiveInPriorityOrder(masks.read, out_frames, out_flags, max_frames);
+            if (res < 0)
+            {
+                return -ErrDriver;
+            }
+            num_received = unsigned(res);
+        }
+        for (uint8_t i = 0; (i < num_ifaces) && (num_received < max_frames); i++)
         {
             if (masks.read & (1 << i))
             {
-                ICanIface* const iface = driver_.getIface(i);
-                if (iface == NULL)
-                {
-                    UAVCAN_ASSERT(0);   // Nonexistent interface
-                    continue;
-                }
-
-                const int res = iface->receive(out_frame, out_frame.ts_mono, out_frame.ts_utc, out_flags);
+                const int res = receiveFromIface(i, out_frames + num_received, out_flags + num_received,
+                                                 max_frames - num_received);
                 if (res == 0)
                 {
                     UAVCAN_ASSERT(0);   // select() reported that iface has pending RX frames, but receive() returned none
                     continue;
                 }
-                out_frame.iface_index = i;
-
-                if ((res > 0) && !(out_flags & CanIOFlagLoopback))
+                if (res < 0)
                 {
-                    counters_[i].frames_rx += 1;
+                    if (num_received > 0)
+                    {
+                        break;          // Error will be reported on the next call
+                    }
+                    return -ErrDriver;
                 }
-                return (res < 0) ? -ErrDriver : res;
+                num_received += unsigned(res);
             }
         }
 
+        if (num_received > 0)
+        {
+            return int(num_received);
+        }
+
         // Timeout checked in the last order - this way we can operate with expired deadline:
         if (sysclock_.getMonotonic() >= blocking_deadline)
         {
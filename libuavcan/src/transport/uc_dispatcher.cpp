@@ -4,6 +4,10 @@
 
 #include <uavcan/transport/dispatcher.hpp>
 #include <uavcan/debug.hpp>
+#if !UAVCAN_TINY
+# include <uavcan/transport/local_transfer_bus.hpp>
+# include <uavcan/transport/wildcard_transfer_listener.hpp>
+#endif
 #include <cassert>
 
 namespace uavcan
@@ -14,9 +18,26 @@ namespace uavcan
  */
 void LoopbackFrameListenerBase::startListening()
 {
+    filtered_ = false;
+    raw_ = false;
+    dispatcher_.getLoopbackFrameListenerRegistry().add(this);
+}
+
+void LoopbackFrameListenerBase::startListening(DataTypeID data_type_id, TransferType transfer_type)
+{
+    filter_data_type_id_ = data_type_id;
+    filter_transfer_type_ = transfer_type;
+    filtered_ = true;
+    raw_ = false;
     dispatcher_.getLoopbackFrameListenerRegistry().add(this);
 }
 
+void LoopbackFrameListenerBase::startListeningRaw(DataTypeID data_type_id, TransferType transfer_type)
+{
+    startListening(data_type_id, transfer_type);
+    raw_ = true;
+}
+
 void LoopbackFrameListenerBase::stopListening()
 {
     dispatcher_.getLoopbackFrameListenerRegistry().remove(this);
@@ -57,13 +78,51 @@ bool LoopbackFrameListenerRegistry::doesExist(const LoopbackFrameListenerBase* l
     return false;
 }
 
-void LoopbackFrameListenerRegistry::invokeListeners(RxFrame& frame)
+void LoopbackFrameListenerRegistry::invokeListeners(const CanRxFrame& can_frame)
 {
+    if (listeners_.isEmpty())
+    {
+        return;
+    }
+
+    TransferType transfer_type = TransferTypeMessageBroadcast;
+    DataTypeID data_type_id;
+    NodeID dst_node_id;
+    if (!Frame::parseAddressing(can_frame, transfer_type, data_type_id, dst_node_id))
+    {
+        UAVCAN_TRACE("Dispatcher", "Invalid loopback CAN frame: %s", can_frame.toString().c_str());
+        UAVCAN_ASSERT(0);  // No way!
+        return;
+    }
+
+    RxFrame frame;
+    bool parsed = false;
+
     LoopbackFrameListenerBase* p = listeners_.get();
     while (p)
     {
         LoopbackFrameListenerBase* const next = p->getNextListNode();
-        p->handleLoopbackFrame(frame);     // p may be modified
+        if (p->acceptsFrame(transfer_type, data_type_id))
+        {
+            if (p->isRaw())
+            {
+                p->handleLoopbackCanFrame(can_frame);   // p may be modified
+            }
+            else
+            {
+                if (!parsed)
+                {
+                    if (!frame.parse(can_frame))
+                    {
+                        UAVCAN_TRACE("Dispatcher", "Invalid loopback CAN frame: %s", can_frame.toString().c_str());
+                        UAVCAN_ASSERT(0);
+                        return;
+                    }
+                    parsed = true;
+                }
+                p->handleLoopbackFrame(frame);          // p may be modified
+            }
+        }
         p = next;
     }
 }
@@ -72,42 +131,71 @@ void LoopbackFrameListenerRegistry::invokeListeners(RxFrame& frame)
 /*
  * Dispatcher::ListenerRegister
  */
-bool Dispatcher::ListenerRegistry::add(TransferListener* listener, Mode mode)
+void Dispatcher::ListenerRegistry::rebuildIndex()
 {
-    if (mode == UniqueListener)
+    fill_n(index_, unsigned(IndexSize), static_cast<TransferListener*>(NULL));
+    if (DispatcherListenerIndexSize > 0)
     {
+        // The list is sorted, so the first listener that hits a slot has the highest data type ID in that slot
         TransferListener* p = list_.get();
         while (p)
         {
-            if (p->getDataTypeDescriptor().getID() == listener->getDataTypeDescriptor().getID())
+            const unsigned slot = getIndexSlot(p->getDataTypeDescriptor().getID());
+            if (index_[slot] == NULL)
             {
-                return false;
+                index_[slot] = p;
             }
             p = p->getNextListNode();
         }
     }
+}
+
+TransferListener* Dispatcher::ListenerRegistry::findFirst(DataTypeID dtid) const
+{
+    TransferListener* p = (DispatcherListenerIndexSize > 0) ? index_[getIndexSlot(dtid)] : list_.get();
+    while (p)
+    {
+        if (p->getDataTypeDescriptor().getID() == dtid)
+        {
+            return p;
+        }
+        else if (p->getDataTypeDescriptor().getID() < dtid)     // Listeners are ordered by data type id!
+        {
+            break;
+        }
+        else
+        {
+            ;  // Either a collision in the index, or the index is disabled
+        }
+        p = p->getNextListNode();
+    }
+    return NULL;
+}
+
+bool Dispatcher::ListenerRegistry::add(TransferListener* listener, Mode mode)
+{
+    if (mode == UniqueListener)
+    {
+        if (findFirst(listener->getDataTypeDescriptor().getID()) != NULL)
+        {
+            return false;
+        }
+    }
     // Objective is to arrange entries by Data Type ID in ascending order from root.
     list_.insertBefore(listener, DataTypeIDInsertionComparator(listener->getDataTypeDescriptor().getID()));
+    rebuildIndex();
     return true;
 }
 
 void Dispatcher::ListenerRegistry::remove(TransferListener* listener)
 {
     list_.remove(listener);
+    rebuildIndex();
 }
 
 bool Dispatcher::ListenerRegistry::exists(DataTypeID dtid) const
 {
-    TransferListener* p = list_.get();
-    while (p)
-    {
-        if (p->getDataTypeDescriptor().getID() == dtid)
-        {
-            return true;
-        }
-        p = p->getNextListNode();
-    }
-    return false;
+    return findFirst(dtid) != NULL;
 }
 
 void Dispatcher::ListenerRegistry::cleanup(MonotonicTime ts)
@@ -121,24 +209,37 @@ void Dispatcher::ListenerRegistry::cleanup(MonotonicTime ts)
     }
 }
 
-void Dispatcher::ListenerRegistry::handleFrame(const RxFrame& frame)
+TransferListener*
+Dispatcher::ListenerRegistry::findLeastRecentlyActiveReceiver(const TransferListener& requester,
+                                                              const TransferBufferManagerKey& protected_key,
+                                                              TransferBufferManagerKey& inout_key,
+                                                              MonotonicTime& inout_ts) const
 {
+    TransferListener* result = NULL;
     TransferListener* p = list_.get();
     while (p)
     {
-        TransferListener* const next = p->getNextListNode();
-        if (p->getDataTypeDescriptor().getID() == frame.getDataTypeID())
+        const TransferBufferManagerKey excluded_key = (p == &requester) ? protected_key : TransferBufferManagerKey();
+        if (p->findLeastRecentlyActiveReceiver(excluded_key, inout_key, inout_ts))
         {
-            p->handleFrame(frame); // p may be modified
+            result = p;
         }
-        else if (p->getDataTypeDescriptor().getID() < frame.getDataTypeID())  // Listeners are ordered by data type id!
-        {
-            break;
-        }
-        else
+        p = p->getNextListNode();
+    }
+    return result;
+}
+
+void Dispatcher::ListenerRegistry::handleFrame(const RxFrame& frame, TransferListener* first)
+{
+    TransferListener* p = first;
+    while (p)
+    {
+        TransferListener* const next = p->getNextListNode();
+        if (p->getDataTypeDescriptor().getID() != frame.getDataTypeID())
         {
-            ;  // Nothing to do with this one
+            break;      // Listeners with the same data type ID are adjacent
         }
+        p->handleFrame(frame); // p may be modified
         p = next;
     }
 }
@@ -146,45 +247,132 @@ void Dispatcher::ListenerRegistry::handleFrame(const RxFrame& frame)
 /*
  * Dispatcher
  */
+Dispatcher::ListenerRegistry* Dispatcher::selectListenerRegistry(TransferType transfer_type)
+{
+    switch (transfer_type)
+    {
+    case TransferTypeMessageBroadcast:
+    {
+        return &lmsg_;
+    }
+    case TransferTypeServiceRequest:
+    {
+        return &lsrv_req_;
+    }
+    case TransferTypeServiceResponse:
+    {
+        return &lsrv_resp_;
+    }
+    default:
+    {
+        UAVCAN_ASSERT(0);
+        return NULL;
+    }
+    }
+}
+
+Dispatcher::ListenerRegistry* Dispatcher::selectListenerRegistryByIndex(unsigned index)
+{
+    UAVCAN_ASSERT(index < NumListenerRegistries);
+    ListenerRegistry* const registries[NumListenerRegistries] = { &lmsg_, &lsrv_req_, &lsrv_resp_ };
+    return registries[index];
+}
+
+TransferListener* Dispatcher::findFirstListener(TransferType transfer_type, DataTypeID dtid)
+{
+    if (static_listener_table_ != NULL)
+    {
+        TransferListener* const* const slot = static_listener_table_->findSlot(transfer_type, dtid);
+        if (slot != NULL)
+        {
+            return *slot;
+        }
+        if (num_unlisted_listeners_ == 0)
+        {
+            return NULL;
+        }
+    }
+    ListenerRegistry* const registry = selectListenerRegistry(transfer_type);
+    return (registry == NULL) ? NULL : registry->findFirst(dtid);
+}
+
 void Dispatcher::handleFrame(const CanRxFrame& can_frame)
 {
-    RxFrame frame;
-    if (!frame.parse(can_frame))
+    const ExecutionTimeScope execution_time_scope(&perf_, ExecutionStageRxFrame);
+    const DutyCycleScope duty_cycle_scope(&perf_, DutyCycleCategoryRx);
+    const uint32_t lookup_started_at = perf_.readCycleCounter();
+    perf_.traceEvent(TraceEventFrameRx, can_frame.ts_mono, can_frame.id, can_frame.dlc, can_frame.iface_index);
+
+    /*
+     * Pre-filtering - only the CAN ID is decoded at this point, which is much cheaper than full parsing.
+     * Most frames on a busy bus are either addressed to other nodes or carry data types we're not interested in.
+     */
+    TransferType transfer_type = TransferType(NumTransferTypes);
+    DataTypeID data_type_id;
+    NodeID dst_node_id;
+    if (!Frame::parseAddressing(can_frame, transfer_type, data_type_id, dst_node_id))
     {
         // This is not counted as a transport error
         UAVCAN_TRACE("Dispatcher", "Invalid CAN frame received: %s", can_frame.toString().c_str());
         return;
     }
 
-    if ((frame.getDstNodeID() != NodeID::Broadcast) &&
-        (frame.getDstNodeID() != getNodeID()))
+    const bool addressed_to_this_node = (dst_node_id == NodeID::Broadcast) || (dst_node_id == getNodeID());
+#if UAVCAN_TINY
+    const bool wildcard_match = false;
+#else
+    const bool wildcard_match = !wildcard_listeners_.isEmpty() &&
+                                hasMatchingWildcardListener(transfer_type, data_type_id, addressed_to_this_node);
+#endif
+    if (!addressed_to_this_node && !wildcard_match)
     {
+        perf_.addFilteredFrame();
         return;
     }
 
-    switch (frame.getTransferType())
-    {
-    case TransferTypeMessageBroadcast:
+    TransferListener* const first_listener =
+        addressed_to_this_node ? findFirstListener(transfer_type, data_type_id) : NULL;
+    perf_.sampleExecutionTime(ExecutionStageRxLookup, lookup_started_at);
+    if ((first_listener == NULL) && !wildcard_match)
     {
-        lmsg_.handleFrame(frame);
-        break;
+        perf_.addFilteredFrame();
+        return;
     }
-    case TransferTypeServiceRequest:
+
+#if !UAVCAN_TINY
+    if ((redundant_frame_filter_ != NULL) && (canio_.getNumIfaces() > 1) && !redundant_frame_filter_->accept(can_frame))
     {
-        lsrv_req_.handleFrame(frame);
-        break;
+        return;     // Counted by the filter
     }
-    case TransferTypeServiceResponse:
+#endif
+
+    /*
+     * Full parsing
+     */
+    RxFrame frame;
+    if (!frame.parse(can_frame))
     {
-        lsrv_resp_.handleFrame(frame);
-        break;
+        // This is not counted as a transport error
+        UAVCAN_TRACE("Dispatcher", "Invalid CAN frame received: %s", can_frame.toString().c_str());
+        return;
     }
-    default:
+    UAVCAN_ASSERT(frame.getDataTypeID() == data_type_id);
+#if !UAVCAN_TINY
+    if ((local_bus_ != NULL) && (transfer_type == TransferTypeMessageBroadcast) &&
+        local_bus_->suppressFrame(data_type_id, frame.getSrcNodeID()))
     {
-        UAVCAN_ASSERT(0);
-        break;
+        return;     // Delivered by the local transfer bus already; counted by the bus
     }
+#endif
+    perf_.addRxFrame(getDataTypeKindForTransferType(transfer_type), data_type_id, can_frame.dlc);
+
+    ListenerRegistry::handleFrame(frame, first_listener);
+#if !UAVCAN_TINY
+    if (wildcard_match)
+    {
+        handleWildcardFrame(frame, addressed_to_this_node);
     }
+#endif
 }
 
 #if UAVCAN_TINY
@@ -196,17 +384,71 @@ void Dispatcher::notifyRxFrameListener(const CanRxFrame&, CanIOFlags)
 {
 }
 #else
-void Dispatcher::handleLoopbackFrame(const CanRxFrame& can_frame)
+void Dispatcher::handleLocalTransfer(IncomingTransfer& transfer, DataTypeID dtid)
 {
-    RxFrame frame;
-    if (!frame.parse(can_frame))
+    TransferListener* p = findFirstListener(TransferTypeMessageBroadcast, dtid);
+    while (p)
     {
-        UAVCAN_TRACE("Dispatcher", "Invalid loopback CAN frame: %s", can_frame.toString().c_str());
-        UAVCAN_ASSERT(0);  // No way!
-        return;
+        TransferListener* const next = p->getNextListNode();
+        if (p->getDataTypeDescriptor().getID() != dtid)
+        {
+            break;      // Listeners with the same data type ID are adjacent
+        }
+        p->handleLocalTransfer(transfer); // p may be modified
+        p = next;
+    }
+
+    WildcardTransferListener* w = wildcard_listeners_.get();
+    while (w)
+    {
+        WildcardTransferListener* const next = w->getNextListNode();
+        if (w->acceptsFrame(TransferTypeMessageBroadcast, dtid, true))
+        {
+            w->handleLocalTransfer(transfer, dtid);
+        }
+        w = next;
     }
-    UAVCAN_ASSERT(frame.getSrcNodeID() == getNodeID());
-    loopback_listeners_.invokeListeners(frame);
+}
+
+bool Dispatcher::hasMatchingWildcardListener(TransferType transfer_type, DataTypeID dtid,
+                                             bool addressed_to_this_node) const
+{
+    for (const WildcardTransferListener* p = wildcard_listeners_.get(); p != NULL; p = p->getNextListNode())
+    {
+        if (p->acceptsFrame(transfer_type, dtid, addressed_to_this_node))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Dispatcher::handleWildcardFrame(const RxFrame& frame, bool addressed_to_this_node)
+{
+    WildcardTransferListener* p = wildcard_listeners_.get();
+    while (p)
+    {
+        WildcardTransferListener* const next = p->getNextListNode();
+        if (p->acceptsFrame(frame.getTransferType(), frame.getDataTypeID(), addressed_to_this_node))
+        {
+            p->handleFrame(frame);
+        }
+        p = next;
+    }
+}
+
+void Dispatcher::cleanupWildcardListeners(MonotonicTime ts)
+{
+    for (WildcardTransferListener* p = wildcard_listeners_.get(); p != NULL; p = p->getNextListNode())
+    {
+        p->cleanup(ts);
+    }
+}
+
+void Dispatcher::handleLoopbackFrame(const CanRxFrame& can_frame)
+{
+    UAVCAN_ASSERT((can_frame.id & 0x7FU) == getNodeID().get());     // Source node ID
+    loopback_listeners_.invokeListeners(can_frame);
 }
 
 void Dispatcher::notifyRxFrameListener(const CanRxFrame& can_frame, CanIOFlags flags)
@@ -218,62 +460,94 @@ void Dispatcher::notifyRxFrameListener(const CanRxFrame& can_frame, CanIOFlags f
 }
 #endif
 
+int Dispatcher::handleReceivedFrames(const CanRxFrame* frames, const CanIOFlags* flags, int num_frames)
+{
+    int num_frames_processed = 0;
+    for (int i = 0; i < num_frames; i++)
+    {
+        if (flags[i] & CanIOFlagLoopback)
+        {
+            handleLoopbackFrame(frames[i]);
+        }
+        else
+        {
+            num_frames_processed++;
+            perf_.sampleLatency(LatencyStageRxDriverToDispatcher, frames[i].ts_mono);
+            handleFrame(frames[i]);
+        }
+        notifyRxFrameListener(frames[i], flags[i]);
+    }
+    return num_frames_processed;
+}
+
+unsigned Dispatcher::computeRxBatchSize(unsigned num_frames_received) const
+{
+    if (max_frames_per_spin_ == 0)
+    {
+        return DispatcherRxBatchSize;
+    }
+    return (num_frames_received < max_frames_per_spin_) ?
+           min(DispatcherRxBatchSize, max_frames_per_spin_ - num_frames_received) : 0U;
+}
+
 int Dispatcher::spin(MonotonicTime deadline)
 {
     int num_frames_processed = 0;
+    unsigned num_frames_received = 0;
+    CanRxFrame frames[DispatcherRxBatchSize];
+    CanIOFlags flags[DispatcherRxBatchSize];
+    spin_break_requested_ = false;
+    int res = 0;
     do
     {
-        CanIOFlags flags = 0;
-        CanRxFrame frame;
-        const int res = canio_.receive(frame, deadline, flags);
+        res = canio_.receiveBatch(frames, flags, computeRxBatchSize(num_frames_received), deadline);
         if (res < 0)
         {
             return res;
         }
-        if (res > 0)
-        {
-            if (flags & CanIOFlagLoopback)
-            {
-                handleLoopbackFrame(frame);
-            }
-            else
-            {
-                num_frames_processed++;
-                handleFrame(frame);
-            }
-            notifyRxFrameListener(frame, flags);
-        }
+        num_wakeups_++;
+        num_frames_received += unsigned(res);
+        num_frames_processed += handleReceivedFrames(frames, flags, res);
     }
-    while (sysclock_.getMonotonic() < deadline);
+    // Zero means that the deadline has been reached already, so there's no need to read the clock again
+    while (!spin_break_requested_ && (res > 0) && (computeRxBatchSize(num_frames_received) > 0) &&
+           (sysclock_.getMonotonic() < deadline));
 
     return num_frames_processed;
 }
 
+int Dispatcher::spinUntilIo(MonotonicTime deadline)
+{
+    CanRxFrame frames[DispatcherRxBatchSize];
+    CanIOFlags flags[DispatcherRxBatchSize];
+
+    const int res = canio_.receiveBatch(frames, flags, computeRxBatchSize(0), deadline);
+    if (res < 0)
+    {
+        return res;
+    }
+    num_wakeups_++;
+    return handleReceivedFrames(frames, flags, res);
+}
+
 int Dispatcher::spinOnce()
 {
     int num_frames_processed = 0;
+    unsigned num_frames_received = 0;
+    CanRxFrame frames[DispatcherRxBatchSize];
+    CanIOFlags flags[DispatcherRxBatchSize];
 
-    while (true)
+    while (computeRxBatchSize(num_frames_received) > 0)
     {
-        CanIOFlags flags = 0;
-        CanRxFrame frame;
-        const int res = canio_.receive(frame, MonotonicTime(), flags);
+        const int res = canio_.receiveBatch(frames, flags, computeRxBatchSize(num_frames_received), MonotonicTime());
         if (res < 0)
         {
             return res;
         }
         else if (res > 0)
         {
-            if (flags & CanIOFlagLoopback)
-            {
-                handleLoopbackFrame(frame);
-            }
-            else
-            {
-                num_frames_processed++;
-                handleFrame(frame);
-            }
-            notifyRxFrameListener(frame, flags);
+            num_frames_received += unsigned(res);
+            num_frames_processed += handleReceivedFrames(frames, flags, res);
         }
         else
         {
@@ -300,60 +574,304 @@ int Dispatcher::send(const Frame& frame, MonotonicTime tx_deadline, MonotonicTim
         UAVCAN_ASSERT(0);
         return -ErrLogic;
     }
-    return canio_.send(can_frame, tx_deadline, blocking_deadline, iface_mask, qos, flags);
+    const int res = canio_.send(can_frame, tx_deadline, blocking_deadline, iface_mask, qos, flags);
+    if (res > 0)
+    {
+        perf_.addTxFrame(getDataTypeKindForTransferType(frame.getTransferType()), frame.getDataTypeID(),
+                         can_frame.dlc);
+    }
+    return res;
 }
 
+int Dispatcher::sendBatch(const CanFrame* can_frames, unsigned num_frames, TransferType transfer_type,
+                          DataTypeID dtid, MonotonicTime tx_deadline, MonotonicTime blocking_deadline,
+                          CanTxQueue::Qos qos, CanIOFlags flags, uint8_t iface_mask)
+{
+    const int res = canio_.sendBatch(can_frames, num_frames, tx_deadline, blocking_deadline, iface_mask, qos, flags);
+    if (res > 0)
+    {
+        for (unsigned i = 0; i < num_frames; i++)
+        {
+            perf_.addTxFrame(getDataTypeKindForTransferType(transfer_type), dtid, can_frames[i].dlc);
+        }
+    }
+    return res;
+}
+
+#if !UAVCAN_TINY
+Dispatcher::~Dispatcher()
+{
+    if (local_bus_ != NULL)
+    {
+        local_bus_->removeDispatcher(*this);
+    }
+}
+
+void Dispatcher::deliverLocalTransfer(DataTypeID dtid, TransferPriority priority, TransferID tid,
+                                      const uint8_t* payload, unsigned payload_len)
+{
+    if (local_bus_ != NULL)
+    {
+        local_bus_->deliver(*this, dtid, priority, tid, payload, payload_len);
+    }
+}
+
+void Dispatcher::registerWildcardListener(WildcardTransferListener* listener)
+{
+    UAVCAN_ASSERT(listener);
+    if (!wildcard_listeners_.contains(listener))
+    {
+        wildcard_listeners_.insert(listener);
+    }
+}
+
+void Dispatcher::unregisterWildcardListener(WildcardTransferListener* listener)
+{
+    UAVCAN_ASSERT(listener);
+    wildcard_listeners_.remove(listener);
+}
+
+bool Dispatcher::hasWildcardListener(const WildcardTransferListener* listener) const
+{
+    return wildcard_listeners_.contains(listener);
+}
+
+unsigned Dispatcher::getNumWildcardListeners() const
+{
+    return wildcard_listeners_.getLength();
+}
+#endif
+
 void Dispatcher::cleanup(MonotonicTime ts)
 {
+    canio_.cleanup(ts);
     outgoing_transfer_reg_.cleanup(ts);
+    if (reassembly_table_ != NULL)
+    {
+        reassembly_table_->cleanup(ts);
+    }
     lmsg_.cleanup(ts);
     lsrv_req_.cleanup(ts);
     lsrv_resp_.cleanup(ts);
+#if !UAVCAN_TINY
+    cleanupWildcardListeners(ts);
+#endif
 }
 
-bool Dispatcher::registerMessageListener(TransferListener* listener)
+bool Dispatcher::cleanupIncrementally(MonotonicTime ts, unsigned max_listeners)
 {
-    if (listener->getDataTypeDescriptor().getKind() != DataTypeKindMessage)
+    if (cleanup_registry_index_ >= NumListenerRegistries)
     {
-        UAVCAN_ASSERT(0);
-        return false;
+        canio_.cleanup(ts);
+        outgoing_transfer_reg_.cleanup(ts);
+        if (reassembly_table_ != NULL)
+        {
+            reassembly_table_->cleanup(ts);
+        }
+#if !UAVCAN_TINY
+        cleanupWildcardListeners(ts);
+#endif
+        cleanup_registry_index_ = 0;
+        cleanup_next_listener_ = selectListenerRegistryByIndex(0)->getFirst();
+    }
+
+    unsigned num_processed = 0;
+    while (true)
+    {
+        while (cleanup_next_listener_ == NULL)
+        {
+            cleanup_registry_index_++;
+            if (cleanup_registry_index_ >= NumListenerRegistries)
+            {
+                return true;
+            }
+            cleanup_next_listener_ = selectListenerRegistryByIndex(cleanup_registry_index_)->getFirst();
+        }
+        if (num_processed >= max_listeners)
+        {
+            return false;
+        }
+        TransferListener* const p = cleanup_next_listener_;
+        cleanup_next_listener_ = p->getNextListNode();      // Updated by unregisterListener() if removed meanwhile
+        p->cleanup(ts);
+        num_processed++;
     }
-    return lmsg_.add(listener, ListenerRegistry::ManyListeners);       // Multiple subscribers are OK
 }
 
-bool Dispatcher::registerServiceRequestListener(TransferListener* listener)
+bool Dispatcher::reclaimRxMemory(const TransferListener& requester, const TransferBufferManagerKey& protected_key)
 {
-    if (listener->getDataTypeDescriptor().getKind() != DataTypeKindService)
+    if (!receiver_eviction_enabled_)
     {
-        UAVCAN_ASSERT(0);
         return false;
     }
-    return lsrv_req_.add(listener, ListenerRegistry::UniqueListener);  // Only one server per data type
+    TransferBufferManagerKey key;
+    MonotonicTime ts = MonotonicTime::getMax();
+    TransferListener* listener = NULL;
+    ListenerRegistry* const registries[] = { &lmsg_, &lsrv_req_, &lsrv_resp_ };
+    for (unsigned i = 0; i < sizeof(registries) / sizeof(registries[0]); i++)
+    {
+        TransferListener* const candidate =
+            registries[i]->findLeastRecentlyActiveReceiver(requester, protected_key, key, ts);
+        if (candidate != NULL)
+        {
+            listener = candidate;
+        }
+    }
+    if (reassembly_table_ != NULL)
+    {
+        TransferListener* const candidate =
+            reassembly_table_->findLeastRecentlyActiveReceiver(requester, protected_key, key, ts);
+        if (candidate != NULL)
+        {
+            listener = candidate;
+        }
+    }
+    if (listener == NULL)
+    {
+        UAVCAN_TRACE("Dispatcher", "Nothing to evict");
+        return false;
+    }
+    listener->evictReceiver(key);
+    num_evicted_receivers_++;
+    return true;
 }
 
-bool Dispatcher::registerServiceResponseListener(TransferListener* listener)
+void Dispatcher::updateStaticListenerSlot(const ListenerRegistry& registry, TransferType transfer_type,
+                                          DataTypeID dtid, int delta)
+{
+    if (static_listener_table_ == NULL)
+    {
+        return;
+    }
+    TransferListener** const slot = static_listener_table_->findSlot(transfer_type, dtid);
+    if (slot != NULL)
+    {
+        *slot = registry.findFirst(dtid);
+    }
+    else
+    {
+        UAVCAN_ASSERT((delta > 0) || (num_unlisted_listeners_ > 0));
+        num_unlisted_listeners_ = (delta > 0) ? (num_unlisted_listeners_ + 1U) : (num_unlisted_listeners_ - 1U);
+    }
+}
+
+void Dispatcher::installStaticListenerTable(IStaticListenerTable* table)
+{
+    UAVCAN_ASSERT(table != NULL);
+    static_listener_table_ = table;
+    num_unlisted_listeners_ = 0;
+    table->clear();
+
+    const TransferType transfer_types[NumListenerRegistries] =
+    {
+        TransferTypeMessageBroadcast, TransferTypeServiceRequest, TransferTypeServiceResponse
+    };
+    for (unsigned i = 0; i < NumListenerRegistries; i++)
+    {
+        const ListenerRegistry& registry = *selectListenerRegistryByIndex(i);
+        UAVCAN_ASSERT(&registry == selectListenerRegistry(transfer_types[i]));
+        for (TransferListener* p = registry.getFirst(); p != NULL; p = p->getNextListNode())
+        {
+            updateStaticListenerSlot(registry, transfer_types[i], p->getDataTypeDescriptor().getID(), 1);
+        }
+    }
+}
+
+void Dispatcher::removeStaticListenerTable()
+{
+    static_listener_table_ = NULL;
+    num_unlisted_listeners_ = 0;
+}
+
+void Dispatcher::installReassemblyTable(ReassemblyTable* table)
+{
+    reassembly_table_ = table;
+    for (unsigned i = 0; i < NumListenerRegistries; i++)
+    {
+        for (TransferListener* p = selectListenerRegistryByIndex(i)->getFirst(); p != NULL; p = p->getNextListNode())
+        {
+            p->setReassemblyTable(table);
+        }
+    }
+}
+
+bool Dispatcher::registerListener(ListenerRegistry& registry, TransferListener* listener, TransferType transfer_type,
+                                  ListenerRegistry::Mode mode)
 {
-    if (listener->getDataTypeDescriptor().getKind() != DataTypeKindService)
+    if (listener->getDataTypeDescriptor().getKind() != getDataTypeKindForTransferType(transfer_type))
     {
         UAVCAN_ASSERT(0);
         return false;
     }
-    return lsrv_resp_.add(listener, ListenerRegistry::ManyListeners);  // Multiple callers may call same srv
+    if (!registry.add(listener, mode))
+    {
+        return false;
+    }
+    updateStaticListenerSlot(registry, transfer_type, listener->getDataTypeDescriptor().getID(), 1);
+    listener->setMemoryReclaimer(this);
+    listener->setReassemblyTable(reassembly_table_);
+    if (registration_observer_ != NULL)
+    {
+        registration_observer_->handleListenerRegistered(*listener);
+    }
+    return true;
+}
+
+void Dispatcher::unregisterListener(ListenerRegistry& registry, TransferListener* listener,
+                                    TransferType transfer_type)
+{
+    if (cleanup_next_listener_ == listener)
+    {
+        cleanup_next_listener_ = listener->getNextListNode();
+    }
+    const bool registered = registry.getList().contains(listener);
+    registry.remove(listener);
+    if (registered)
+    {
+        updateStaticListenerSlot(registry, transfer_type, listener->getDataTypeDescriptor().getID(), -1);
+    }
+    listener->setMemoryReclaimer(NULL);
+    if (registered)
+    {
+        listener->setReassemblyTable(NULL);
+    }
+    if (registration_observer_ != NULL)
+    {
+        registration_observer_->handleListenerUnregistered(*listener);
+    }
+}
+
+bool Dispatcher::registerMessageListener(TransferListener* listener)
+{
+    // Multiple subscribers are OK
+    return registerListener(lmsg_, listener, TransferTypeMessageBroadcast, ListenerRegistry::ManyListeners);
+}
+
+bool Dispatcher::registerServiceRequestListener(TransferListener* listener)
+{
+    // Only one server per data type
+    return registerListener(lsrv_req_, listener, TransferTypeServiceRequest, ListenerRegistry::UniqueListener);
+}
+
+bool Dispatcher::registerServiceResponseListener(TransferListener* listener)
+{
+    // Multiple callers may call same srv
+    return registerListener(lsrv_resp_, listener, TransferTypeServiceResponse, ListenerRegistry::ManyListeners);
 }
 
 void Dispatcher::unregisterMessageListener(TransferListener* listener)
 {
-    lmsg_.remove(listener);
+    unregisterListener(lmsg_, listener, TransferTypeMessageBroadcast);
 }
 
 void Dispatcher::unregisterServiceRequestListener(TransferListener* listener)
 {
-    lsrv_req_.remove(listener);
+    unregisterListener(lsrv_req_, listener, TransferTypeServiceRequest);
 }
 
 void Dispatcher::unregisterServiceResponseListener(TransferListener* listener)
 {
-    lsrv_resp_.remove(listener);
+    unregisterListener(lsrv_resp_, listener, TransferTypeServiceResponse);
 }
 
 bool Dispatcher::hasSubscriber(DataTypeID dtid) const
@@ -17,6 +17,7 @@ uint8_t Frame::setPayload(const uint8_t* data, unsigned len)
 {
     const uint8_t maxlen = getPayloadCapacity();
     len = min(unsigned(maxlen), len);
+    len = unsigned(CanFrame::roundDownDataLength(len + 1U) - 1U);      // No padding is needed this way
     (void)copy(data, data + len, payload_);
     payload_len_ = uint_fast8_t(len);
     return static_cast<uint8_t>(len);
@@ -31,6 +32,97 @@ inline static uint32_t bitunpack(uint32_t val)
     return (val >> OFFSET) & ((1UL << WIDTH) - 1);
 }
 
+bool Frame::parseAddressing(const CanFrame& can_frame, TransferType& out_transfer_type,
+                            DataTypeID& out_data_type_id, NodeID& out_dst_node_id)
+{
+    if (can_frame.isErrorFrame() || can_frame.isRemoteTransmissionRequest() || !can_frame.isExtended())
+    {
+        return false;
+    }
+
+    const uint32_t id = can_frame.id & CanFrame::MaskExtID;
+
+    const bool service_not_message = bitunpack<7, 1>(id) != 0U;
+    if (service_not_message)
+    {
+        const bool request_not_response = bitunpack<15, 1>(id) != 0U;
+        out_transfer_type = request_not_response ? TransferTypeServiceRequest : TransferTypeServiceResponse;
+
+        out_dst_node_id = static_cast<uint8_t>(bitunpack<8, 7>(id));
+        out_data_type_id = static_cast<uint16_t>(bitunpack<16, 8>(id));
+    }
+    else
+    {
+        out_transfer_type = TransferTypeMessageBroadcast;
+        out_dst_node_id = NodeID::Broadcast;
+
+        out_data_type_id = static_cast<uint16_t>(bitunpack<8, 16>(id));
+
+        if (NodeID(static_cast<uint8_t>(bitunpack<0, 7>(id))).isBroadcast())
+        {
+            // Removing the discriminator
+            out_data_type_id = static_cast<uint16_t>(out_data_type_id.get() & 3U);
+        }
+    }
+
+    return true;
+}
+
+namespace
+{
+/*
+ * Lookup tables of the frame parser.
+ * The tail byte table is indexed by the three upper bits of the tail byte: start of transfer, end of transfer,
+ * toggle; the CAN ID tables are indexed by the service-not-message bit, see Frame::parse().
+ */
+enum
+{
+    TailSot         = 1,
+    TailEot         = 2,
+    TailToggle      = 4,
+    TailInvalid     = 8,        ///< The toggle bit must be cleared in the first frame of a transfer
+    TailSingleFrame = 16        ///< Only single frame transfers can be anonymous
+};
+
+const uint8_t TailTable[8] =
+{
+    0,
+    TailToggle,
+    TailEot,
+    TailEot | TailToggle,
+    TailSot,
+    TailSot | TailToggle | TailInvalid,
+    TailSot | TailEot | TailSingleFrame,
+    TailSot | TailEot | TailToggle | TailInvalid
+};
+
+/// Indexed by the service-not-message bit and the request-not-response bit, which is a part of DTID for messages
+const TransferType TransferTypeTable[2][2] =
+{
+    { TransferTypeMessageBroadcast, TransferTypeMessageBroadcast },
+    { TransferTypeServiceResponse, TransferTypeServiceRequest }
+};
+
+const uint8_t DataTypeIDOffsetTable[2] = { 8, 16 };
+const uint8_t DstNodeIDMaskTable[2]    = { 0, 0x7F };
+
+/// Indexed by the service-not-message bit and the anonymous flag; the latter keeps only the lower bits of DTID
+const uint16_t DataTypeIDMaskTable[2][2] =
+{
+    { 0xFFFF, 3 },
+    { 0xFF, 0xFF }
+};
+}
+
+bool Frame::isSingleFrameTransfer(const CanFrame& can_frame)
+{
+    if ((can_frame.dlc < 1) || (can_frame.dlc > sizeof(can_frame.data)))
+    {
+        return false;
+    }
+    return (TailTable[can_frame.data[can_frame.dlc - 1U] >> 5] & TailSingleFrame) != 0;
+}
+
 bool Frame::parse(const CanFrame& can_frame)
 {
     if (can_frame.isErrorFrame() || can_frame.isRemoteTransmissionRequest() || !can_frame.isExtended())
@@ -53,34 +145,21 @@ bool Frame::parse(const CanFrame& can_frame)
 
     /*
      * CAN ID parsing
+     * All fields are decoded with lookup tables indexed by the service-not-message bit, without branches.
      */
     const uint32_t id = can_frame.id & CanFrame::MaskExtID;
 
-    transfer_priority_ = static_cast<uint8_t>(bitunpack<24, 5>(id));
-    src_node_id_ = static_cast<uint8_t>(bitunpack<0, 7>(id));
+    const unsigned service = bitunpack<7, 1>(id);
+    const unsigned src = bitunpack<0, 7>(id);
+    const unsigned dst = bitunpack<8, 7>(id) & DstNodeIDMaskTable[service];
+    const bool anonymous = src == 0;
 
-    const bool service_not_message = bitunpack<7, 1>(id) != 0U;
-    if (service_not_message)
-    {
-        const bool request_not_response = bitunpack<15, 1>(id) != 0U;
-        transfer_type_ = request_not_response ? TransferTypeServiceRequest : TransferTypeServiceResponse;
-
-        dst_node_id_ = static_cast<uint8_t>(bitunpack<8, 7>(id));
-        data_type_id_ = static_cast<uint16_t>(bitunpack<16, 8>(id));
-    }
-    else
-    {
-        transfer_type_ = TransferTypeMessageBroadcast;
-        dst_node_id_ = NodeID::Broadcast;
-
-        data_type_id_ = static_cast<uint16_t>(bitunpack<8, 16>(id));
-
-        if (src_node_id_.isBroadcast())
-        {
-            // Removing the discriminator
-            data_type_id_ = static_cast<uint16_t>(data_type_id_.get() & 3U);
-        }
-    }
+    transfer_priority_ = static_cast<uint8_t>(bitunpack<24, 5>(id));
+    src_node_id_ = static_cast<uint8_t>(src);
+    dst_node_id_ = static_cast<uint8_t>(dst);
+    data_type_id_ = static_cast<uint16_t>((id >> DataTypeIDOffsetTable[service]) &
+                                          DataTypeIDMaskTable[service][anonymous ? 1 : 0]);
+    transfer_type_ = TransferTypeTable[service][bitunpack<15, 1>(id)];
 
     /*
      * CAN payload parsing
@@ -89,14 +168,26 @@ bool Frame::parse(const CanFrame& can_frame)
     (void)copy(can_frame.data, can_frame.data + payload_len_, payload_);
 
     const uint8_t tail = can_frame.data[can_frame.dlc - 1U];
+    const unsigned tail_flags = TailTable[tail >> 5];
 
-    start_of_transfer_ = (tail & (1U << 7)) != 0;
-    end_of_transfer_   = (tail & (1U << 6)) != 0;
-    toggle_            = (tail & (1U << 5)) != 0;
+    start_of_transfer_ = (tail_flags & TailSot) != 0;
+    end_of_transfer_   = (tail_flags & TailEot) != 0;
+    toggle_            = (tail_flags & TailToggle) != 0;
 
     transfer_id_ = tail & TransferID::Max;
 
-    return isValid();
+    /*
+     * Combined validity check; equivalent to isValid(), which is branchy, for any frame that got this far.
+     * The priority, the data type ID and the payload length are always valid here, because they are decoded
+     * from bit fields of the right width. Service frames must be addressed to another node, and the messages
+     * can be anonymous if they are single frame transfers.
+     */
+    const bool addressing_valid = (service != 0) ? ((dst != 0) && !anonymous && (src != dst)) :
+                                                   (!anonymous || ((tail_flags & TailSingleFrame) != 0));
+    const bool valid = addressing_valid && ((tail_flags & TailInvalid) == 0);
+
+    UAVCAN_ASSERT(valid == isValid());
+    return valid;
 }
 
 template <int OFFSET, int WIDTH>
@@ -109,6 +200,30 @@ inline static uint32_t bitpack(uint32_t field)
     return uint32_t((field & ((1UL << WIDTH) - 1)) << OFFSET);
 }
 
+uint32_t Frame::makeCanIDTemplate(TransferPriority priority, TransferType transfer_type, DataTypeID data_type_id,
+                                  NodeID src_node_id)
+{
+    uint32_t id = CanFrame::FlagEFF |
+        bitpack<0, 7>(src_node_id.get()) |
+        bitpack<24, 5>(priority.get());
+
+    if (transfer_type == TransferTypeMessageBroadcast)
+    {
+        id |=
+            bitpack<7, 1>(0U) |
+            bitpack<8, 16>(data_type_id.get());
+    }
+    else
+    {
+        const bool request_not_response = transfer_type == TransferTypeServiceRequest;
+        id |=
+            bitpack<7, 1>(1U) |
+            bitpack<15, 1>(request_not_response ? 1U : 0U) |
+            bitpack<16, 8>(data_type_id.get());
+    }
+    return id;
+}
+
 bool Frame::compile(CanFrame& out_can_frame) const
 {
     if (!isValid())
@@ -116,46 +231,31 @@ bool Frame::compile(CanFrame& out_can_frame) const
         UAVCAN_ASSERT(0);        // This is an application error, so we need to maximize it.
         return false;
     }
+    compile(out_can_frame, makeCanIDTemplate());
+    return true;
+}
+
+void Frame::compile(CanFrame& out_can_frame, uint32_t can_id_template) const
+{
+    UAVCAN_ASSERT(isValid());
+    UAVCAN_ASSERT(can_id_template == makeCanIDTemplate());
 
     /*
      * CAN ID field
      */
-    out_can_frame.id = CanFrame::FlagEFF |
-        bitpack<0, 7>(src_node_id_.get()) |
-        bitpack<24, 5>(transfer_priority_.get());
-
-    if (transfer_type_ == TransferTypeMessageBroadcast)
+    out_can_frame.id = can_id_template;
+    if (transfer_type_ != TransferTypeMessageBroadcast)
     {
-        out_can_frame.id |=
-            bitpack<7, 1>(0U) |
-            bitpack<8, 16>(data_type_id_.get());
-    }
-    else
-    {
-        const bool request_not_response = transfer_type_ == TransferTypeServiceRequest;
-        out_can_frame.id |=
-            bitpack<7, 1>(1U) |
-            bitpack<8, 7>(dst_node_id_.get()) |
-            bitpack<15, 1>(request_not_response ? 1U : 0U) |
-            bitpack<16, 8>(data_type_id_.get());
+        out_can_frame.id |= bitpack<8, 7>(dst_node_id_.get());
     }
 
     /*
      * Payload
      */
-    uint8_t tail = transfer_id_.get();
-    if (start_of_transfer_)
-    {
-        tail |= (1U << 7);
-    }
-    if (end_of_transfer_)
-    {
-        tail |= (1U << 6);
-    }
-    if (toggle_)
-    {
-        tail |= (1U << 5);
-    }
+    const uint8_t tail = uint8_t(transfer_id_.get() |
+                                 (start_of_transfer_ ? (1U << 7) : 0U) |
+                                 (end_of_transfer_ ? (1U << 6) : 0U) |
+                                 (toggle_ ? (1U << 5) : 0U));
 
     UAVCAN_ASSERT(payload_len_ < sizeof(static_cast<CanFrame*>(NULL)->data));
 
@@ -174,8 +274,6 @@ bool Frame::compile(CanFrame& out_can_frame) const
         crc.add(out_can_frame.data, out_can_frame.dlc);
         out_can_frame.id |= bitpack<10, 14>(crc.get() & ((1U << 14) - 1U));
     }
-
-    return true;
 }
 
 bool Frame::isValid() const
@@ -276,7 +374,7 @@ bool Frame::operator==(const Frame& rhs) const
 #if UAVCAN_TOSTRING
 std::string Frame::toString() const
 {
-    static const int BUFLEN = 100;
+    static const int BUFLEN = 100 + (PayloadCapacity - 7) * 3;
     char buf[BUFLEN];
     int ofs = snprintf(buf, BUFLEN, "prio=%d dtid=%d tt=%d snid=%d dnid=%d sot=%d eot=%d togl=%d tid=%d payload=[",
                        int(transfer_priority_.get()), int(data_type_id_.get()), int(transfer_type_),
@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <uavcan/build_config.hpp>
+
+#if !UAVCAN_TINY
+
+#include <uavcan/transport/local_transfer_bus.hpp>
+#include <uavcan/transport/dispatcher.hpp>
+#include <uavcan/debug.hpp>
+
+namespace uavcan
+{
+
+const unsigned LocalTransferBus::MaxDispatchers;
+const unsigned LocalTransferBus::MaxDataTypes;
+
+int LocalTransferBus::findDataType(DataTypeID dtid) const
+{
+    for (unsigned i = 0; i < num_data_types_; i++)
+    {
+        if (data_types_[i] == dtid)
+        {
+            return int(i);
+        }
+    }
+    return -1;
+}
+
+LocalTransferBus::~LocalTransferBus()
+{
+    while (num_dispatchers_ > 0)
+    {
+        removeDispatcher(*dispatchers_[num_dispatchers_ - 1]);
+    }
+}
+
+int LocalTransferBus::addDispatcher(Dispatcher& dispatcher)
+{
+    if (dispatcher.local_bus_ == this)
+    {
+        return 0;
+    }
+    if (dispatcher.local_bus_ != NULL)
+    {
+        return -ErrInvalidParam;
+    }
+    if (num_dispatchers_ >= MaxDispatchers)
+    {
+        return -ErrMemory;
+    }
+    dispatchers_[num_dispatchers_++] = &dispatcher;
+    dispatcher.local_bus_ = this;
+    return 0;
+}
+
+void LocalTransferBus::removeDispatcher(Dispatcher& dispatcher)
+{
+    for (unsigned i = 0; i < num_dispatchers_; i++)
+    {
+        if (dispatchers_[i] == &dispatcher)
+        {
+            dispatchers_[i] = dispatchers_[--num_dispatchers_];
+            dispatcher.local_bus_ = NULL;
+            return;
+        }
+    }
+}
+
+int LocalTransferBus::enableDataType(DataTypeID dtid)
+{
+    if (!dtid.isValidForDataTypeKind(DataTypeKindMessage))
+    {
+        return -ErrInvalidParam;
+    }
+    if (isDataTypeEnabled(dtid))
+    {
+        return 0;
+    }
+    if (num_data_types_ >= MaxDataTypes)
+    {
+        return -ErrMemory;
+    }
+    data_types_[num_data_types_++] = dtid;
+    return 0;
+}
+
+void LocalTransferBus::disableDataType(DataTypeID dtid)
+{
+    const int index = findDataType(dtid);
+    if (index >= 0)
+    {
+        data_types_[index] = data_types_[--num_data_types_];
+    }
+}
+
+void LocalTransferBus::deliver(const Dispatcher& origin, DataTypeID dtid, TransferPriority priority,
+                               TransferID tid, const uint8_t* payload, unsigned payload_len)
+{
+    UAVCAN_ASSERT(origin.local_bus_ == this);
+    if ((num_dispatchers_ < 2) || !isDataTypeEnabled(dtid) || !origin.getNodeID().isUnicast())
+    {
+        return;
+    }
+
+    const ISystemClock& clock = origin.getSystemClock();
+    LocalIncomingTransfer transfer(clock.getMonotonic(), clock.getUtc(), priority, tid, origin.getNodeID(),
+                                   payload, payload_len);
+
+    // The listeners may publish in turn, but they can't add or remove dispatchers
+    for (unsigned i = 0; i < num_dispatchers_; i++)
+    {
+        if (dispatchers_[i] != &origin)
+        {
+            dispatchers_[i]->handleLocalTransfer(transfer, dtid);
+            num_local_transfers_++;
+        }
+    }
+}
+
+bool LocalTransferBus::suppressFrame(DataTypeID dtid, NodeID src_node_id)
+{
+    if (!src_node_id.isUnicast() || !isDataTypeEnabled(dtid))
+    {
+        return false;
+    }
+    for (unsigned i = 0; i < num_dispatchers_; i++)
+    {
+        if (dispatchers_[i]->getNodeID() == src_node_id)
+        {
+            num_suppressed_frames_++;
+            return true;
+        }
+    }
+    return false;
+}
+
+}
+
+#endif // !UAVCAN_TINY
@@ -24,10 +24,8 @@ std::string OutgoingTransferRegistryKey::toString() const
  */
 const MonotonicDuration OutgoingTransferRegistry::MinEntryLifetime = MonotonicDuration::fromMSec(2000);
 
-TransferID* OutgoingTransferRegistry::accessOrCreate(const OutgoingTransferRegistryKey& key,
-                                                     MonotonicTime new_deadline)
+OutgoingTransferRegistry::Value* OutgoingTransferRegistry::accessOrCreateValue(const OutgoingTransferRegistryKey& key)
 {
-    UAVCAN_ASSERT(!new_deadline.isZero());
     Value* p = map_.access(key);
     if (p == NULL)
     {
@@ -38,7 +36,37 @@ TransferID* OutgoingTransferRegistry::accessOrCreate(const OutgoingTransferRegis
         }
         UAVCAN_TRACE("OutgoingTransferRegistry", "Created %s", key.toString().c_str());
     }
+    return p;
+}
+
+TransferID* OutgoingTransferRegistry::accessOrCreate(const OutgoingTransferRegistryKey& key,
+                                                     MonotonicTime new_deadline)
+{
+    EntryCache cache;
+    return accessOrCreate(key, new_deadline, cache);
+}
+
+TransferID* OutgoingTransferRegistry::accessOrCreate(const OutgoingTransferRegistryKey& key,
+                                                     MonotonicTime new_deadline, EntryCache& cache)
+{
+    UAVCAN_ASSERT(!new_deadline.isZero());
+    Value* p = (cache.epoch_ == epoch_) ? cache.value_ : NULL;
+    if (p == NULL)
+    {
+        p = accessOrCreateValue(key);
+        if (p == NULL)
+        {
+            return NULL;
+        }
+        cache.value_ = p;
+        cache.epoch_ = epoch_;
+    }
+    UAVCAN_ASSERT(p == map_.access(key));
     p->deadline = new_deadline;
+    if (earliest_deadline_.isZero() || (new_deadline < earliest_deadline_))
+    {
+        earliest_deadline_ = new_deadline;
+    }
     return &p->tid;
 }
 
@@ -49,7 +77,14 @@ bool OutgoingTransferRegistry::exists(DataTypeID dtid, TransferType tt) const
 
 void OutgoingTransferRegistry::cleanup(MonotonicTime ts)
 {
-    map_.removeAllWhere(DeadlineExpiredPredicate(ts));
+    if (earliest_deadline_.isZero() || (ts < earliest_deadline_))
+    {
+        return;         // Nothing could have expired yet
+    }
+    MonotonicTime earliest_remaining_deadline;
+    map_.removeAllWhere(DeadlineExpiredPredicate(ts, earliest_remaining_deadline));
+    earliest_deadline_ = earliest_remaining_deadline;
+    epoch_++;           // Invalidating the cached entries, since some of them could have been removed or moved
 }
 
 }
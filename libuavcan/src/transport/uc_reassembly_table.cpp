@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <uavcan/transport/reassembly_table.hpp>
+#include <uavcan/transport/transfer_listener.hpp>
+#include <uavcan/debug.hpp>
+
+namespace uavcan
+{
+/*
+ * ReassemblyTable predicates
+ */
+bool ReassemblyTable::TimedOutReceiverPredicate::operator()(const ReassemblyTableKey& key,
+                                                            const TransferReceiver& value) const
+{
+    if (value.isExpired(ts_))
+    {
+        UAVCAN_TRACE("ReassemblyTable", "Timed out receiver: %s", key.getBufferKey().toString().c_str());
+        releaseReceiverState(key, value);
+        return true;
+    }
+    return false;
+}
+
+bool ReassemblyTable::ListenerPredicate::operator()(const ReassemblyTableKey& key,
+                                                    const TransferReceiver& value) const
+{
+    if (key.getListener() == &listener_)
+    {
+        releaseReceiverState(key, value);
+        return true;
+    }
+    return false;
+}
+
+bool ReassemblyTable::LeastRecentlyActiveReceiverFinder::operator()(const ReassemblyTableKey& key,
+                                                                    const TransferReceiver& value) const
+{
+    const bool excluded = (key.getListener() == &requester_) && (key.getBufferKey() == protected_key_);
+    if (!excluded && (value.getLastActivityTimestamp() < inout_ts_))
+    {
+        inout_key_ = key;
+        inout_ts_ = value.getLastActivityTimestamp();
+    }
+    return false;       // Visit all entries
+}
+
+/*
+ * ReassemblyTable
+ */
+void ReassemblyTable::releaseReceiverState(const ReassemblyTableKey& key, const TransferReceiver& receiver)
+{
+    UAVCAN_ASSERT(key.getListener() != NULL);
+    key.getListener()->releaseReceiverState(key.getBufferKey(), receiver);
+}
+
+void ReassemblyTable::removeListener(const TransferListener& listener)
+{
+    receivers_.removeAllWhere(ListenerPredicate(listener));
+}
+
+void ReassemblyTable::cleanup(MonotonicTime ts)
+{
+    receivers_.removeAllWhere(TimedOutReceiverPredicate(ts));
+}
+
+TransferListener* ReassemblyTable::findLeastRecentlyActiveReceiver(const TransferListener& requester,
+                                                                   const TransferBufferManagerKey& protected_key,
+                                                                   TransferBufferManagerKey& inout_key,
+                                                                   MonotonicTime& inout_ts) const
+{
+    ReassemblyTableKey key;
+    (void)receivers_.find(LeastRecentlyActiveReceiverFinder(requester, protected_key, key, inout_ts));
+    if (key.getListener() != NULL)
+    {
+        inout_key = key.getBufferKey();
+    }
+    return key.getListener();
+}
+
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <uavcan/transport/redundant_frame_filter.hpp>
+#include <uavcan/debug.hpp>
+
+namespace uavcan
+{
+
+const unsigned RedundantFrameFilter::Size;
+const unsigned RedundantFrameFilter::Associativity;
+
+uint32_t RedundantFrameFilter::computeStreamID(const CanFrame& frame)
+{
+    return frame.id & CanFrame::MaskExtID & 0xFFFFFFU;     // The priority field is the highest 5 bits of the ID
+}
+
+unsigned RedundantFrameFilter::computeSet(uint32_t stream_id)
+{
+    const uint32_t hash = (stream_id ^ (stream_id >> 15)) * 2654435761U;
+    return unsigned(hash >> 16) & (unsigned(NumSets) - 1U);
+}
+
+bool RedundantFrameFilter::accept(const CanRxFrame& frame)
+{
+    UAVCAN_ASSERT(frame.iface_index < MaxCanIfaces);
+    if (frame.ts_mono.isZero())
+    {
+        return true;            // Will be rejected by the transfer receiver anyway
+    }
+
+    const uint32_t stream_id = computeStreamID(frame);
+    Entry* const set = entries_[computeSet(stream_id)];
+    Entry* victim = NULL;
+
+    for (unsigned i = 0; i < Associativity; i++)
+    {
+        Entry& e = set[i];
+        const bool active = !e.ts.isZero() && ((frame.ts_mono - e.ts) <= failover_timeout_);
+
+        if (!e.ts.isZero() && (e.stream_id == stream_id))
+        {
+            if (e.iface_index == frame.iface_index)
+            {
+                e.ts = max(e.ts, frame.ts_mono);
+                return true;
+            }
+            if (active)
+            {
+                if (frame.iface_index < MaxCanIfaces)
+                {
+                    num_duplicates_[frame.iface_index]++;
+                }
+                return false;
+            }
+            UAVCAN_TRACE("RedundantFrameFilter", "Stream %08x failover iface %d --> %d",
+                         unsigned(stream_id), int(e.iface_index), int(frame.iface_index));
+            e.iface_index = frame.iface_index;
+            e.ts = frame.ts_mono;
+            return true;
+        }
+
+        if (!active && ((victim == NULL) || (e.ts < victim->ts)))
+        {
+            victim = &e;
+        }
+    }
+
+    if (victim == NULL)
+    {
+        num_untracked_frames_++;
+        return true;
+    }
+    victim->ts = frame.ts_mono;
+    victim->stream_id = stream_id;
+    victim->iface_index = frame.iface_index;
+    return true;
+}
+
+void RedundantFrameFilter::reset()
+{
+    for (unsigned i = 0; i < NumSets; i++)
+    {
+        for (unsigned k = 0; k < Associativity; k++)
+        {
+            entries_[i][k] = Entry();
+        }
+    }
+}
+
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <uavcan/transport/token_bucket.hpp>
+
+namespace uavcan
+{
+
+void TokenBucket::refill(MonotonicTime ts)
+{
+    if (last_update_.isZero() || (ts <= last_update_))
+    {
+        last_update_ = max(last_update_, ts);
+        return;
+    }
+    const uint64_t elapsed_usec = ts.toUSec() - last_update_.toUSec();
+    last_update_ = ts;
+
+    const uint64_t deficit = getCapacity() - level_;
+    if (elapsed_usec >= (deficit / rate_ + 1U))                 // Also prevents the multiplication from overflowing
+    {
+        level_ = getCapacity();
+    }
+    else
+    {
+        level_ = min(level_ + elapsed_usec * rate_, getCapacity());
+    }
+}
+
+void TokenBucket::configure(uint32_t rate, uint32_t burst)
+{
+    rate_ = rate;
+    burst_ = burst;
+    level_ = getCapacity();
+    last_update_ = MonotonicTime();
+}
+
+bool TokenBucket::canConsume(uint32_t amount, MonotonicTime ts)
+{
+    if (!isEnabled())
+    {
+        return true;
+    }
+    refill(ts);
+    return level_ >= uint64_t(amount) * MicrotokensPerToken;
+}
+
+bool TokenBucket::tryConsume(uint32_t amount, MonotonicTime ts)
+{
+    if (!canConsume(amount, ts))
+    {
+        return false;
+    }
+    if (isEnabled())
+    {
+        level_ -= uint64_t(amount) * MicrotokensPerToken;
+    }
+    return true;
+}
+
+MonotonicTime TokenBucket::getAvailabilityTime(uint32_t amount) const
+{
+    const uint64_t required = uint64_t(amount) * MicrotokensPerToken;
+    if (!isEnabled() || (required <= level_))
+    {
+        return last_update_;
+    }
+    if (amount > burst_)
+    {
+        return MonotonicTime::getMax();
+    }
+    const uint64_t wait_usec = (required - level_ + rate_ - 1U) / rate_;
+    return last_update_ + MonotonicDuration::fromUSec(int64_t(wait_usec));
+}
+
+}
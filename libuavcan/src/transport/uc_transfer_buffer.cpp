@@ -148,6 +148,21 @@ void TransferBufferManagerEntry::destroy(TransferBufferManagerEntry*& obj, IPool
     }
 }
 
+void TransferBufferManagerEntry::tryAllocateContiguous()
+{
+    UAVCAN_ASSERT(contiguous_data_ == NULL);
+    UAVCAN_ASSERT(blocks_.isEmpty());
+    /*
+     * There's no point in allocating a span if the data fits one block anyway.
+     * Regular pool allocators will refuse to allocate more than one block, in which case we fall back to the
+     * block chain.
+     */
+    if (max_size_ > Block::Size)
+    {
+        contiguous_data_ = static_cast<uint8_t*>(allocator_.allocate(max_size_));
+    }
+}
+
 int TransferBufferManagerEntry::read(unsigned offset, uint8_t* data, unsigned len) const
 {
     if (!data)
@@ -165,6 +180,12 @@ int TransferBufferManagerEntry::read(unsigned offset, uint8_t* data, unsigned le
     }
     UAVCAN_ASSERT((offset + len) <= max_write_pos_);
 
+    if (contiguous_data_ != NULL)
+    {
+        (void)copy(contiguous_data_ + offset, contiguous_data_ + offset + len, data);
+        return int(len);
+    }
+
     // This shall be optimized.
     unsigned total_offset = 0;
     unsigned left_to_read = len;
@@ -202,16 +223,39 @@ int TransferBufferManagerEntry::write(unsigned offset, const uint8_t* data, unsi
     }
     UAVCAN_ASSERT((offset + len) <= max_size_);
 
+    if ((contiguous_data_ == NULL) && blocks_.isEmpty())
+    {
+        tryAllocateContiguous();
+    }
+    if (contiguous_data_ != NULL)
+    {
+        (void)copy(data, data + len, contiguous_data_ + offset);
+        max_write_pos_ = max(uint16_t(offset + len), uint16_t(max_write_pos_));
+        return int(len);
+    }
+
     unsigned total_offset = 0;
     unsigned left_to_write = len;
     const uint8_t* inptr = data;
     Block* p = blocks_.get();
     Block* last_written_block = NULL;
 
+    /*
+     * Blocks are never removed from the chain until reset, so the cursor stays valid.
+     * Transfer reception always writes at increasing offsets, so this makes sequential appends O(1).
+     */
+    if ((cursor_block_ != NULL) && (offset >= cursor_block_offset_))
+    {
+        p = cursor_block_;
+        total_offset = cursor_block_offset_;
+    }
+
     // First we need to write the part that is already allocated
     while (p)
     {
         last_written_block = p;
+        cursor_block_ = p;
+        cursor_block_offset_ = uint16_t(total_offset);
         p->write(inptr, offset, total_offset, left_to_write);
         if (left_to_write == 0)
         {
@@ -244,6 +288,8 @@ int TransferBufferManagerEntry::write(unsigned offset, const uint8_t* data, unsi
             blocks_.insert(new_block);
         }
         last_written_block = new_block;
+        cursor_block_ = new_block;
+        cursor_block_offset_ = uint16_t(total_offset);
 
         // Writing the data
         new_block->write(inptr, offset, total_offset, left_to_write);
@@ -259,6 +305,13 @@ void TransferBufferManagerEntry::reset(const TransferBufferManagerKey& key)
 {
     key_ = key;
     max_write_pos_ = 0;
+    cursor_block_ = NULL;
+    cursor_block_offset_ = 0;
+    if (contiguous_data_ != NULL)
+    {
+        allocator_.deallocate(contiguous_data_);
+        contiguous_data_ = NULL;
+    }
     Block* p = blocks_.get();
     while (p)
     {
@@ -294,12 +347,12 @@ TransferBufferManager::~TransferBufferManager()
     {
         TransferBufferManagerEntry* const next = dyn->getNextListNode();
         buffers_.remove(dyn);
-        TransferBufferManagerEntry::destroy(dyn, allocator_);
+        TransferBufferManagerEntry::destroy(dyn, dyn->getAllocator());
         dyn = next;
     }
 }
 
-ITransferBuffer* TransferBufferManager::access(const TransferBufferManagerKey& key)
+TransferBufferManagerEntry* TransferBufferManager::access(const TransferBufferManagerKey& key)
 {
     if (key.isEmpty())
     {
@@ -309,7 +362,7 @@ ITransferBuffer* TransferBufferManager::access(const TransferBufferManagerKey& k
     return findFirst(key);
 }
 
-ITransferBuffer* TransferBufferManager::create(const TransferBufferManagerKey& key)
+TransferBufferManagerEntry* TransferBufferManager::create(const TransferBufferManagerKey& key)
 {
     if (key.isEmpty())
     {
@@ -318,7 +371,11 @@ ITransferBuffer* TransferBufferManager::create(const TransferBufferManagerKey& k
     }
     remove(key);
 
-    TransferBufferManagerEntry* tbme = TransferBufferManagerEntry::instantiate(allocator_, max_buf_size_);
+    TransferBufferManagerEntry* tbme = TransferBufferManagerEntry::instantiate(getAllocator(), max_buf_size_);
+    if ((tbme == NULL) && (reclaimer_ != NULL) && (owner_ != NULL) && reclaimer_->reclaimRxMemory(*owner_, key))
+    {
+        tbme = TransferBufferManagerEntry::instantiate(getAllocator(), max_buf_size_);
+    }
     if (tbme == NULL)
     {
         return NULL;     // Epic fail.
@@ -345,7 +402,7 @@ void TransferBufferManager::remove(const TransferBufferManagerKey& key)
     {
         UAVCAN_TRACE("TransferBufferManager", "Buffer deleted, %s", key.toString().c_str());
         buffers_.remove(dyn);
-        TransferBufferManagerEntry::destroy(dyn, allocator_);
+        TransferBufferManagerEntry::destroy(dyn, dyn->getAllocator());
     }
 }
 
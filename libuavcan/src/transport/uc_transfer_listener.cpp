@@ -50,6 +50,12 @@ int SingleFrameIncomingTransfer::read(unsigned offset, uint8_t* data, unsigned l
     return int(len);
 }
 
+const uint8_t* SingleFrameIncomingTransfer::getContiguousData(unsigned& out_len) const
+{
+    out_len = payload_len_;
+    return payload_;
+}
+
 bool SingleFrameIncomingTransfer::isAnonymousTransfer() const
 {
     return (getTransferType() == TransferTypeMessageBroadcast) && getSrcNodeID().isBroadcast();
@@ -79,13 +85,112 @@ int MultiFrameIncomingTransfer::read(unsigned offset, uint8_t* data, unsigned le
     return tbb->read(offset, data, len);
 }
 
+const uint8_t* MultiFrameIncomingTransfer::getContiguousData(unsigned& out_len) const
+{
+    const ITransferBuffer* const tbb = const_cast<TransferBufferAccessor&>(buf_acc_).access();
+    if (tbb == NULL)
+    {
+        out_len = 0;
+        return NULL;
+    }
+    return tbb->getContiguousData(out_len);
+}
+
+/*
+ * LocalIncomingTransfer
+ */
+LocalIncomingTransfer::LocalIncomingTransfer(MonotonicTime ts_mono, UtcTime ts_utc, TransferPriority transfer_priority,
+                                             TransferID transfer_id, NodeID src_node_id, const uint8_t* payload,
+                                             unsigned payload_len)
+    : IncomingTransfer(ts_mono, ts_utc, transfer_priority, TransferTypeMessageBroadcast, transfer_id, src_node_id, 0)
+    , payload_(payload)
+    , payload_len_(uint16_t(payload_len))
+{
+    UAVCAN_ASSERT((payload != NULL) || (payload_len == 0));
+    UAVCAN_ASSERT(payload_len <= 0xFFFF);
+}
+
+int LocalIncomingTransfer::read(unsigned offset, uint8_t* data, unsigned len) const
+{
+    if (data == NULL)
+    {
+        UAVCAN_ASSERT(0);
+        return -ErrInvalidParam;
+    }
+    if (offset >= payload_len_)
+    {
+        return 0;
+    }
+    len = min(len, payload_len_ - offset);
+    (void)copy(payload_ + offset, payload_ + offset + len, data);
+    return int(len);
+}
+
+const uint8_t* LocalIncomingTransfer::getContiguousData(unsigned& out_len) const
+{
+    out_len = payload_len_;
+    return payload_;
+}
+
+/*
+ * IncomingTransferChunk
+ */
+IncomingTransferChunk::IncomingTransferChunk(MonotonicTime ts_mono, UtcTime ts_utc, const RxFrame& frame,
+                                             unsigned offset, const uint8_t* data, unsigned len)
+    : IncomingTransfer(ts_mono, ts_utc, frame.getPriority(), frame.getTransferType(), frame.getTransferID(),
+                       frame.getSrcNodeID(), frame.getIfaceIndex())
+    , data_(data)
+    , len_(uint8_t(len))
+    , offset_(uint16_t(offset))
+    , anonymous_(false)
+{
+    UAVCAN_ASSERT(len <= 0xFF);
+    UAVCAN_ASSERT(offset <= 0xFFFF);
+}
+
+IncomingTransferChunk::IncomingTransferChunk(const IncomingTransfer& transfer, const uint8_t* data, unsigned len,
+                                             unsigned offset)
+    : IncomingTransfer(transfer.getMonotonicTimestamp(), transfer.getUtcTimestamp(), transfer.getPriority(),
+                       transfer.getTransferType(), transfer.getTransferID(), transfer.getSrcNodeID(),
+                       transfer.getIfaceIndex())
+    , data_(data)
+    , len_(uint8_t(len))
+    , offset_(uint16_t(offset))
+    , anonymous_(transfer.isAnonymousTransfer())
+{
+    UAVCAN_ASSERT(len <= 0xFF);
+    UAVCAN_ASSERT(offset <= 0xFFFF);
+}
+
+int IncomingTransferChunk::read(unsigned offset, uint8_t* data, unsigned len) const
+{
+    if (data == NULL)
+    {
+        UAVCAN_ASSERT(0);
+        return -ErrInvalidParam;
+    }
+    if (offset >= len_)
+    {
+        return 0;
+    }
+    len = min(len, len_ - offset);
+    (void)copy(data_ + offset, data_ + offset + len, data);
+    return int(len);
+}
+
+const uint8_t* IncomingTransferChunk::getContiguousData(unsigned& out_len) const
+{
+    out_len = len_;
+    return data_;
+}
+
 /*
  * TransferListener::TimedOutReceiverPredicate
  */
 bool TransferListener::TimedOutReceiverPredicate::operator()(const TransferBufferManagerKey& key,
                                                              const TransferReceiver& value) const
 {
-    if (value.isTimedOut(ts_))
+    if (value.isExpired(ts_))
     {
         UAVCAN_TRACE("TransferListener", "Timed out receiver: %s", key.toString().c_str());
         /*
@@ -94,81 +199,138 @@ bool TransferListener::TimedOutReceiverPredicate::operator()(const TransferBuffe
          * destroy the buffers manually.
          * Maybe it is not good that the predicate has side effects, but I ran out of better ideas.
          */
-        parent_bufmgr_.remove(key);
+        owner_.releaseReceiverState(key, value);
         return true;
     }
     return false;
 }
 
+/*
+ * TransferListener::LeastRecentlyActiveReceiverFinder
+ */
+bool TransferListener::LeastRecentlyActiveReceiverFinder::operator()(const TransferBufferManagerKey& key,
+                                                                     const TransferReceiver& value) const
+{
+    if (!(key == excluded_key_) && (value.getLastActivityTimestamp() < inout_ts_))
+    {
+        inout_key_ = key;
+        inout_ts_ = value.getLastActivityTimestamp();
+    }
+    return false;       // Visit all entries
+}
+
 /*
  * TransferListener
  */
-bool TransferListener::checkPayloadCrc(const uint16_t compare_with, const ITransferBuffer& tbb) const
+TransferReceiver* TransferListener::insertReceiver(const TransferBufferManagerKey& key,
+                                                  const TransferReceiver& receiver)
+{
+    return (reassembly_table_ != NULL) ? reassembly_table_->insert(*this, key, receiver)
+                                       : receivers_.insert(key, receiver);
+}
+
+TransferReceiver* TransferListener::findOrCreateReceiver(const RxFrame& frame)
 {
-    TransferCRC crc = crc_base_;
-    unsigned offset = 0;
-    while (true)
+    UAVCAN_ASSERT(frame.getSrcNodeID().isUnicast());
+    const TransferBufferManagerKey key(frame.getSrcNodeID(), frame.getTransferType());
+
+    TransferReceiver* recv =
+        (reassembly_table_ != NULL) ? reassembly_table_->access(*this, key) : receivers_.access(key);
+    if (recv == NULL)
     {
-        uint8_t buf[16];
-        const int res = tbb.read(offset, buf, sizeof(buf));
-        if (res < 0)
+        if (!frame.isStartOfTransfer())
         {
-            UAVCAN_TRACE("TransferListener", "Failed to check CRC: Buffer read failure %i", res);
-            return false;
+            return NULL;
         }
-        if (res == 0)
+
+        TransferReceiver new_recv;
+        recv = insertReceiver(key, new_recv);
+        if ((recv == NULL) && reclaimRxMemory(key))
         {
-            break;
+            recv = insertReceiver(key, new_recv);
+        }
+        if (recv == NULL)
+        {
+            UAVCAN_TRACE("TransferListener", "Receiver registration failed; frame %s", frame.toString().c_str());
+            traceReceiverAllocationFailure(frame);
         }
-        offset += unsigned(res);
-        crc.add(buf, unsigned(res));
-    }
-    if (crc.get() != compare_with)
-    {
-        UAVCAN_TRACE("TransferListener", "CRC mismatch, expected=0x%04x, got=0x%04x",
-                     int(compare_with), int(crc.get()));
-        return false;
     }
-    return true;
+    return recv;
 }
 
-void TransferListener::handleReception(TransferReceiver& receiver, const RxFrame& frame,
-                                           TransferBufferAccessor& tba)
+TransferReceiver::ResultCode TransferListener::receiveFrame(TransferReceiver& receiver, const RxFrame& frame,
+                                                            TransferBufferAccessor& tba)
 {
-    switch (receiver.addFrame(frame, tba))
+    const TransferReceiver::ResultCode result = receiver.addFrame(frame, tba, crc_base_, decimation_);
+    switch (result)
     {
     case TransferReceiver::ResultNotComplete:
     {
-        perf_.addErrors(receiver.yieldErrorCount());
+        perf_.addRxErrors(data_type_.getKind(), data_type_.getID(), receiver.yieldErrorCount());
         break;
     }
     case TransferReceiver::ResultSingleFrame:
+    case TransferReceiver::ResultComplete:
     {
-        perf_.addRxTransfer();
+        perf_.addRxTransfer(data_type_.getKind(), data_type_.getID());
+        break;
+    }
+    case TransferReceiver::ResultSkipped:
+    {
+        num_skipped_transfers_++;
+        break;
+    }
+    default:
+    {
+        UAVCAN_ASSERT(0);
+        break;
+    }
+    }
+    return result;
+}
+
+void TransferListener::handleReception(TransferReceiver& receiver, const RxFrame& frame,
+                                           TransferBufferAccessor& tba)
+{
+    switch (receiveFrame(receiver, frame, tba))
+    {
+    case TransferReceiver::ResultSingleFrame:
+    {
+        perf_.sampleLatency(LatencyStageRxDriverToTransfer, frame.getMonotonicTimestamp());
+        traceTransferEvent(TraceEventTransferComplete, frame);
         SingleFrameIncomingTransfer it(frame);
         handleIncomingTransfer(it);
         break;
     }
     case TransferReceiver::ResultComplete:
     {
-        perf_.addRxTransfer();
         const ITransferBuffer* tbb = tba.access();
         if (tbb == NULL)
         {
             UAVCAN_TRACE("TransferListener", "Buffer access failure, last frame: %s", frame.toString().c_str());
             break;
         }
-        if (!checkPayloadCrc(receiver.getLastTransferCrc(), *tbb))
+        if (receiver.getLastTransferComputedCrc() != receiver.getLastTransferCrc())
         {
-            UAVCAN_TRACE("TransferListener", "CRC error, last frame: %s", frame.toString().c_str());
+            UAVCAN_TRACE("TransferListener", "CRC mismatch, expected=0x%04x, got=0x%04x, last frame: %s",
+                         int(receiver.getLastTransferCrc()), int(receiver.getLastTransferComputedCrc()),
+                         frame.toString().c_str());
+            traceTransferEvent(TraceEventCrcError, frame);
             break;
         }
+        perf_.sampleLatency(LatencyStageRxDriverToTransfer, receiver.getLastTransferTimestampMonotonic());
+        traceTransferEvent(TraceEventTransferComplete, frame);
         MultiFrameIncomingTransfer it(receiver.getLastTransferTimestampMonotonic(),
                                       receiver.getLastTransferTimestampUtc(), frame, tba);
         handleIncomingTransfer(it);
         it.release();
         break;
     }
+    case TransferReceiver::ResultNotComplete:
+    case TransferReceiver::ResultSkipped:
+    {
+        break;
+    }
     default:
     {
         UAVCAN_ASSERT(0);
@@ -177,11 +339,31 @@ void TransferListener::handleReception(TransferReceiver& receiver, const RxFrame
     }
 }
 
+void TransferListener::setDecimation(uint8_t factor, MonotonicDuration min_interval)
+{
+    decimation_.factor = max(factor, uint8_t(1));
+    const int64_t interval_msec = min(max(min_interval.toMSec(), int64_t(0)), int64_t(0xFFFF));
+    decimation_.min_interval_msec = static_cast<uint16_t>(interval_msec);
+    UAVCAN_TRACE("TransferListener", "Decimation: factor %u, min interval %u ms",
+                 unsigned(decimation_.factor), unsigned(decimation_.min_interval_msec));
+}
+
+void TransferListener::setOnChangeMode(bool enabled, MonotonicDuration heartbeat)
+{
+    decimation_.on_change = enabled;
+    const int64_t heartbeat_msec = min(max(heartbeat.toMSec(), int64_t(0)), int64_t(0xFFFF));
+    decimation_.heartbeat_msec = static_cast<uint16_t>(heartbeat_msec);
+    UAVCAN_TRACE("TransferListener", "On-change mode: %d, heartbeat %u ms",
+                 int(enabled), unsigned(decimation_.heartbeat_msec));
+}
+
 void TransferListener::handleAnonymousTransferReception(const RxFrame& frame)
 {
     if (allow_anonymous_transfers_)
     {
-        perf_.addRxTransfer();
+        perf_.addRxTransfer(data_type_.getKind(), data_type_.getID());
+        perf_.sampleLatency(LatencyStageRxDriverToTransfer, frame.getMonotonicTimestamp());
+        traceTransferEvent(TraceEventTransferComplete, frame);
         SingleFrameIncomingTransfer it(frame);
         handleIncomingTransfer(it);
     }
@@ -190,38 +372,91 @@ void TransferListener::handleAnonymousTransferReception(const RxFrame& frame)
 TransferListener::~TransferListener()
 {
     // Map must be cleared before bufmgr is destroyed
+    if (reassembly_table_ != NULL)
+    {
+        reassembly_table_->removeListener(*this);
+    }
     receivers_.clear();
 }
 
+void TransferListener::setReassemblyTable(ReassemblyTable* table)
+{
+    if (table == reassembly_table_)
+    {
+        return;
+    }
+    if (reassembly_table_ != NULL)
+    {
+        reassembly_table_->removeListener(*this);
+    }
+    else
+    {
+        receivers_.removeAllWhere(ReleasingPredicate(*this));
+    }
+    reassembly_table_ = table;
+    bufmgr_.setAllocatorOverride((table != NULL) ? &table->getBufferAllocator() : NULL);
+}
+
 void TransferListener::cleanup(MonotonicTime ts)
 {
-    receivers_.removeAllWhere(TimedOutReceiverPredicate(ts, bufmgr_));
-    UAVCAN_ASSERT(receivers_.isEmpty() ? bufmgr_.isEmpty() : 1);
+    // With the reassembly table, the receivers are cleaned up by the table, see Dispatcher::cleanup()
+    receivers_.removeAllWhere(TimedOutReceiverPredicate(ts, *this));
+    UAVCAN_ASSERT((receivers_.isEmpty() && (reassembly_table_ == NULL)) ? bufmgr_.isEmpty() : 1);
+}
+
+bool TransferListener::reclaimRxMemory(const TransferBufferManagerKey& key)
+{
+    IRxMemoryReclaimer* const reclaimer = bufmgr_.getMemoryReclaimer();
+    return (reclaimer != NULL) && reclaimer->reclaimRxMemory(*this, key);
+}
+
+bool TransferListener::findLeastRecentlyActiveReceiver(const TransferBufferManagerKey& excluded_key,
+                                                       TransferBufferManagerKey& inout_key,
+                                                       MonotonicTime& inout_ts) const
+{
+    const MonotonicTime initial_ts = inout_ts;
+    (void)receivers_.find(LeastRecentlyActiveReceiverFinder(excluded_key, inout_key, inout_ts));
+    return inout_ts != initial_ts;
+}
+
+void TransferListener::releaseReceiverState(const TransferBufferManagerKey& key, const TransferReceiver&)
+{
+    bufmgr_.remove(key);
+}
+
+void TransferListener::evictReceiver(const TransferBufferManagerKey& key)
+{
+    UAVCAN_TRACE("TransferListener", "Evicting receiver: %s", key.toString().c_str());
+    const TransferReceiver* const receiver =
+        (reassembly_table_ != NULL) ? reassembly_table_->access(*this, key) : receivers_.access(key);
+    if (receiver != NULL)
+    {
+        releaseReceiverState(key, *receiver);
+        if (reassembly_table_ != NULL)
+        {
+            reassembly_table_->remove(*this, key);
+        }
+        else
+        {
+            receivers_.remove(key);
+        }
+    }
+    else
+    {
+        bufmgr_.remove(key);
+    }
 }
 
 void TransferListener::handleFrame(const RxFrame& frame)
 {
     if (frame.getSrcNodeID().isUnicast())       // Normal transfer
     {
-        const TransferBufferManagerKey key(frame.getSrcNodeID(), frame.getTransferType());
-
-        TransferReceiver* recv = receivers_.access(key);
+        TransferReceiver* const recv = findOrCreateReceiver(frame);
         if (recv == NULL)
         {
-            if (!frame.isStartOfTransfer())
-            {
-                return;
-            }
-
-            TransferReceiver new_recv;
-            recv = receivers_.insert(key, new_recv);
-            if (recv == NULL)
-            {
-                UAVCAN_TRACE("TransferListener", "Receiver registration failed; frame %s", frame.toString().c_str());
-                return;
-            }
+            return;
         }
-        TransferBufferAccessor tba(bufmgr_, key);
+        TransferBufferAccessor tba(bufmgr_, TransferBufferManagerKey(frame.getSrcNodeID(), frame.getTransferType()));
         handleReception(*recv, frame, tba);
     }
     else if (frame.getSrcNodeID().isBroadcast() &&
@@ -237,6 +472,340 @@ void TransferListener::handleFrame(const RxFrame& frame)
     }
 }
 
+void TransferListener::handleLocalTransfer(IncomingTransfer& transfer)
+{
+    unsigned len = 0;
+    (void)transfer.getContiguousData(len);
+    // Single frame transfers don't need a buffer
+    if ((len > unsigned(CanFrame::MaxDataLen - 1)) && (len > bufmgr_.getMaxBufferSize()))
+    {
+        UAVCAN_TRACE("TransferListener", "Local transfer is too long: %u", len);
+        return;
+    }
+    perf_.addRxTransfer(data_type_.getKind(), data_type_.getID());
+    handleIncomingTransfer(transfer);
+}
+
+/*
+ * TransferListenerWithNodeIndex
+ */
+bool TransferListenerWithNodeIndex::SlotBlock::isEmpty() const
+{
+    for (unsigned i = 0; i < static_cast<unsigned>(NumSlots); i++)
+    {
+        if (slots[i] != NULL)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+TransferReceiver** TransferListenerWithNodeIndex::accessSlot(NodeID node_id, bool create)
+{
+    UAVCAN_ASSERT(node_id.isUnicast());
+    const unsigned block_index = node_id.get() / unsigned(SlotBlock::NumSlots);
+    UAVCAN_ASSERT(block_index < unsigned(NumSlotBlocks));
+
+    if (slot_blocks_[block_index] == NULL)
+    {
+        if (!create)
+        {
+            return NULL;
+        }
+        void* praw = allocator_.allocate(sizeof(SlotBlock));
+        if ((praw == NULL) && reclaimRxMemory(TransferBufferManagerKey(node_id, TransferTypeMessageBroadcast)))
+        {
+            praw = allocator_.allocate(sizeof(SlotBlock));
+        }
+        if (praw == NULL)
+        {
+            return NULL;
+        }
+        slot_blocks_[block_index] = new (praw) SlotBlock();
+    }
+
+    return &slot_blocks_[block_index]->slots[node_id.get() % unsigned(SlotBlock::NumSlots)];
+}
+
+void TransferListenerWithNodeIndex::destroyReceiver(TransferReceiver*& receiver, NodeID node_id)
+{
+    if (receiver != NULL)
+    {
+        // Receivers do not own their buffers, so the buffer must be removed explicitly
+        releaseReceiverState(TransferBufferManagerKey(node_id, TransferTypeMessageBroadcast), *receiver);
+        receiver->~TransferReceiver();
+        allocator_.deallocate(receiver);
+        receiver = NULL;
+    }
+}
+
+TransferListenerWithNodeIndex::~TransferListenerWithNodeIndex()
+{
+    for (unsigned block_index = 0; block_index < unsigned(NumSlotBlocks); block_index++)
+    {
+        SlotBlock* const block = slot_blocks_[block_index];
+        if (block != NULL)
+        {
+            for (unsigned i = 0; i < unsigned(SlotBlock::NumSlots); i++)
+            {
+                destroyReceiver(block->slots[i], NodeID(uint8_t(block_index * unsigned(SlotBlock::NumSlots) + i)));
+            }
+            block->~SlotBlock();
+            allocator_.deallocate(block);
+            slot_blocks_[block_index] = NULL;
+        }
+    }
+}
+
+void TransferListenerWithNodeIndex::cleanup(MonotonicTime ts)
+{
+    for (unsigned block_index = 0; block_index < unsigned(NumSlotBlocks); block_index++)
+    {
+        SlotBlock* const block = slot_blocks_[block_index];
+        if (block == NULL)
+        {
+            continue;
+        }
+        for (unsigned i = 0; i < unsigned(SlotBlock::NumSlots); i++)
+        {
+            if ((block->slots[i] != NULL) && block->slots[i]->isExpired(ts))
+            {
+                const NodeID node_id(uint8_t(block_index * unsigned(SlotBlock::NumSlots) + i));
+                UAVCAN_TRACE("TransferListenerWithNodeIndex", "Timed out receiver: nid=%i", int(node_id.get()));
+                destroyReceiver(block->slots[i], node_id);
+            }
+        }
+        if (block->isEmpty())
+        {
+            block->~SlotBlock();
+            allocator_.deallocate(block);
+            slot_blocks_[block_index] = NULL;
+        }
+    }
+
+    TransferListener::cleanup(ts);
+}
+
+bool TransferListenerWithNodeIndex::findLeastRecentlyActiveReceiver(const TransferBufferManagerKey& excluded_key,
+                                                                    TransferBufferManagerKey& inout_key,
+                                                                    MonotonicTime& inout_ts) const
+{
+    bool found = false;
+    for (unsigned block_index = 0; block_index < unsigned(NumSlotBlocks); block_index++)
+    {
+        const SlotBlock* const block = slot_blocks_[block_index];
+        if (block == NULL)
+        {
+            continue;
+        }
+        for (unsigned i = 0; i < unsigned(SlotBlock::NumSlots); i++)
+        {
+            const TransferReceiver* const receiver = block->slots[i];
+            if ((receiver == NULL) || !(receiver->getLastActivityTimestamp() < inout_ts))
+            {
+                continue;
+            }
+            const TransferBufferManagerKey key(NodeID(uint8_t(block_index * unsigned(SlotBlock::NumSlots) + i)),
+                                               TransferTypeMessageBroadcast);
+            if (!(key == excluded_key))
+            {
+                inout_key = key;
+                inout_ts = receiver->getLastActivityTimestamp();
+                found = true;
+            }
+        }
+    }
+    return TransferListener::findLeastRecentlyActiveReceiver(excluded_key, inout_key, inout_ts) || found;
+}
+
+void TransferListenerWithNodeIndex::evictReceiver(const TransferBufferManagerKey& key)
+{
+    if (key.getTransferType() != TransferTypeMessageBroadcast)
+    {
+        TransferListener::evictReceiver(key);
+        return;
+    }
+    // The slot block is kept, because the caller may hold a pointer into it; cleanup() will take care of it
+    TransferReceiver** const slot = accessSlot(key.getNodeID(), false);
+    if (slot != NULL)
+    {
+        UAVCAN_TRACE("TransferListenerWithNodeIndex", "Evicting receiver: nid=%i", int(key.getNodeID().get()));
+        destroyReceiver(*slot, key.getNodeID());
+    }
+}
+
+void TransferListenerWithNodeIndex::handleFrame(const RxFrame& frame)
+{
+    if ((frame.getTransferType() != TransferTypeMessageBroadcast) || !frame.getSrcNodeID().isUnicast())
+    {
+        TransferListener::handleFrame(frame);   // Services and anonymous transfers are handled as usual
+        return;
+    }
+
+    TransferReceiver** const slot = accessSlot(frame.getSrcNodeID(), frame.isStartOfTransfer());
+    if (slot == NULL)
+    {
+        if (frame.isStartOfTransfer())
+        {
+            traceReceiverAllocationFailure(frame);
+        }
+        return;
+    }
+
+    if (*slot == NULL)
+    {
+        if (!frame.isStartOfTransfer())
+        {
+            return;
+        }
+        const TransferBufferManagerKey key(frame.getSrcNodeID(), TransferTypeMessageBroadcast);
+        void* praw = allocator_.allocate(sizeof(TransferReceiver));
+        if ((praw == NULL) && reclaimRxMemory(key))
+        {
+            praw = allocator_.allocate(sizeof(TransferReceiver));
+        }
+        if (praw == NULL)
+        {
+            UAVCAN_TRACE("TransferListenerWithNodeIndex", "Receiver allocation failed; frame %s",
+                         frame.toString().c_str());
+            traceReceiverAllocationFailure(frame);
+            return;
+        }
+        *slot = new (praw) TransferReceiver();
+    }
+
+    TransferBufferAccessor tba(getBufferManager(),
+                               TransferBufferManagerKey(frame.getSrcNodeID(), TransferTypeMessageBroadcast));
+    handleReception(**slot, frame, tba);
+}
+
+/*
+ * StreamingTransferListener::ChunkForwarder
+ */
+int StreamingTransferListener::ChunkForwarder::write(unsigned offset, const uint8_t* data, unsigned len)
+{
+    if ((offset + len) > owner_.max_transfer_size_)
+    {
+        UAVCAN_TRACE("StreamingTransferListener", "Transfer is too long; frame %s", frame_.toString().c_str());
+        return -ErrMemory;
+    }
+    if (len == 0)
+    {
+        return 0;
+    }
+    open_ = true;
+    const IncomingTransferChunk chunk(receiver_.getLastActivityTimestamp(), receiver_.getLastTransferTimestampUtc(),
+                                      frame_, offset, data, len);
+    return owner_.handleTransferChunk(chunk) ? int(len) : -ErrFailure;
+}
+
+void StreamingTransferListener::ChunkForwarder::discard()
+{
+    if (open_)
+    {
+        open_ = false;
+        owner_.handleTransferAbort(frame_.getSrcNodeID(), frame_.getTransferType());
+    }
+}
+
+/*
+ * StreamingTransferListener
+ */
+void StreamingTransferListener::handleIncomingTransfer(IncomingTransfer& transfer)
+{
+    // Only single frame transfers and local transfers get here; the latter may need more than one chunk
+    unsigned len = 0;
+    const uint8_t* const data = transfer.getContiguousData(len);
+    UAVCAN_ASSERT(data != NULL);
+    if ((data == NULL) || (len > max_transfer_size_))
+    {
+        return;
+    }
+    for (unsigned offset = 0; offset < len; offset += 0xFFU)
+    {
+        const IncomingTransferChunk chunk(transfer, data + offset, min(len - offset, 0xFFU), offset);
+        if (!handleTransferChunk(chunk))
+        {
+            handleTransferAbort(transfer.getSrcNodeID(), transfer.getTransferType());
+            return;
+        }
+    }
+    handleTransferCompletion(transfer.getSrcNodeID(), transfer.getTransferType());
+}
+
+void StreamingTransferListener::handleLocalTransfer(IncomingTransfer& transfer)
+{
+    // The buffer size of the base class is zero; the transfer size is limited by handleIncomingTransfer()
+    getPerfCounter().addRxTransfer(getDataTypeDescriptor().getKind(), getDataTypeDescriptor().getID());
+    handleIncomingTransfer(transfer);
+}
+
+void StreamingTransferListener::releaseReceiverState(const TransferBufferManagerKey& key,
+                                                     const TransferReceiver& receiver)
+{
+    if (receiver.isMidTransfer())
+    {
+        handleTransferAbort(key.getNodeID(), key.getTransferType());
+    }
+    TransferListener::releaseReceiverState(key, receiver);
+}
+
+void StreamingTransferListener::handleFrame(const RxFrame& frame)
+{
+    if (!frame.getSrcNodeID().isUnicast())
+    {
+        TransferListener::handleFrame(frame);       // Anonymous transfers end up in handleIncomingTransfer()
+        return;
+    }
+
+    TransferReceiver* const receiver = findOrCreateReceiver(frame);
+    if (receiver == NULL)
+    {
+        return;
+    }
+
+    ChunkForwarder forwarder(*this, *receiver, frame);
+    TransferBufferAccessor tba(forwarder);
+    switch (receiveFrame(*receiver, frame, tba))
+    {
+    case TransferReceiver::ResultSingleFrame:
+    {
+        getPerfCounter().sampleLatency(LatencyStageRxDriverToTransfer, frame.getMonotonicTimestamp());
+        traceTransferEvent(TraceEventTransferComplete, frame);
+        SingleFrameIncomingTransfer it(frame);
+        handleIncomingTransfer(it);
+        break;
+    }
+    case TransferReceiver::ResultComplete:
+    {
+        if (receiver->getLastTransferComputedCrc() != receiver->getLastTransferCrc())
+        {
+            UAVCAN_TRACE("StreamingTransferListener", "CRC mismatch, expected=0x%04x, got=0x%04x, last frame: %s",
+                         int(receiver->getLastTransferCrc()), int(receiver->getLastTransferComputedCrc()),
+                         frame.toString().c_str());
+            traceTransferEvent(TraceEventCrcError, frame);
+            forwarder.discard();
+            break;
+        }
+        getPerfCounter().sampleLatency(LatencyStageRxDriverToTransfer, receiver->getLastTransferTimestampMonotonic());
+        traceTransferEvent(TraceEventTransferComplete, frame);
+        handleTransferCompletion(frame.getSrcNodeID(), frame.getTransferType());
+        break;
+    }
+    case TransferReceiver::ResultNotComplete:
+    case TransferReceiver::ResultSkipped:
+    {
+        break;
+    }
+    default:
+    {
+        UAVCAN_ASSERT(0);
+        break;
+    }
+    }
+}
+
 /*
  * TransferListenerWithFilter
  */
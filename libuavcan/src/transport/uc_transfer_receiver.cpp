@@ -15,6 +15,34 @@ const uint16_t TransferReceiver::MinTransferIntervalMSec;
 const uint16_t TransferReceiver::MaxTransferIntervalMSec;
 const uint16_t TransferReceiver::DefaultTransferIntervalMSec;
 const uint16_t TransferReceiver::DefaultTidTimeoutMSec;
+const uint16_t TransferReceiver::MinReleaseTimeoutMSec;
+const uint8_t TransferReceiver::ReleaseTimeoutIntervals;
+const uint32_t TransferReceiver::MaxPrevTransferAgeUSec;
+const uint32_t TransferReceiver::PrevTransferAgeUnknown;
+
+void TransferReceiver::setThisTransferTimestamp(MonotonicTime ts)
+{
+    const MonotonicTime old_ts = getThisTransferTimestamp();
+    UAVCAN_ASSERT(ts >= old_ts);
+
+    if (prev_transfer_age_usec_ != PrevTransferAgeUnknown)
+    {
+        const uint64_t age = uint64_t(prev_transfer_age_usec_) + uint64_t((ts - old_ts).toUSec());
+        prev_transfer_age_usec_ = uint32_t(min(age, uint64_t(MaxPrevTransferAgeUSec)));
+    }
+
+    this_transfer_ts_lo_ = uint32_t(ts.toUSec() & 0xFFFFFFFFU);
+    this_transfer_ts_hi_ = uint32_t(ts.toUSec() >> 32);
+}
+
+MonotonicTime TransferReceiver::getLastTransferTimestampMonotonic() const
+{
+    if (prev_transfer_age_usec_ == PrevTransferAgeUnknown)
+    {
+        return MonotonicTime();
+    }
+    return getThisTransferTimestamp() - MonotonicDuration::fromUSec(prev_transfer_age_usec_);
+}
 
 MonotonicDuration TransferReceiver::getIfaceSwitchDelay() const
 {
@@ -26,6 +54,14 @@ MonotonicDuration TransferReceiver::getTidTimeout() const
     return MonotonicDuration::fromMSec(DefaultTidTimeoutMSec);
 }
 
+MonotonicDuration TransferReceiver::getReleaseTimeout() const
+{
+    uint32_t timeout_msec = uint32_t(transfer_interval_msec_) * ReleaseTimeoutIntervals;
+    timeout_msec = min(timeout_msec, uint32_t(DefaultTidTimeoutMSec));
+    timeout_msec = max(timeout_msec, uint32_t(MinReleaseTimeoutMSec));
+    return MonotonicDuration::fromMSec(timeout_msec);
+}
+
 void TransferReceiver::registerError() const
 {
     error_cnt_ = static_cast<uint8_t>(error_cnt_ + 1) & ErrorCntMask;
@@ -33,14 +69,14 @@ void TransferReceiver::registerError() const
 
 void TransferReceiver::updateTransferTimings()
 {
-    UAVCAN_ASSERT(!this_transfer_ts_.isZero());
+    UAVCAN_ASSERT(!getThisTransferTimestamp().isZero());
 
-    const MonotonicTime prev_prev_ts = prev_transfer_ts_;
-    prev_transfer_ts_ = this_transfer_ts_;
+    const uint32_t interval_usec = prev_transfer_age_usec_;
+    prev_transfer_age_usec_ = 0;        // The previous transfer is this one now
 
-    if ((!prev_prev_ts.isZero()) && (!prev_transfer_ts_.isZero()) && (prev_transfer_ts_ >= prev_prev_ts))
+    if (interval_usec != PrevTransferAgeUnknown)
     {
-        uint64_t interval_msec = uint64_t((prev_transfer_ts_ - prev_prev_ts).toMSec());
+        uint64_t interval_msec = interval_usec / 1000U;
         interval_msec = min(interval_msec, uint64_t(MaxTransferIntervalMSec));
         interval_msec = max(interval_msec, uint64_t(MinTransferIntervalMSec));
         transfer_interval_msec_ = static_cast<uint16_t>((uint64_t(transfer_interval_msec_) * 7U + interval_msec) / 8U);
@@ -93,7 +129,57 @@ bool TransferReceiver::validate(const RxFrame& frame) const
     return true;
 }
 
-bool TransferReceiver::writePayload(const RxFrame& frame, ITransferBuffer& buf)
+bool TransferReceiver::acceptTransfer(const TransferDecimation& decimation, MonotonicTime ts)
+{
+    // Wraps around every 65 seconds, which is much longer than the TID timeout
+    const uint16_t ts_msec = static_cast<uint16_t>(ts.toMSec());
+
+    bool accept = !accepted_once_ || ((unsigned(num_skipped_) + 1U) >= unsigned(decimation.factor));
+    if (accept && accepted_once_ && (decimation.min_interval_msec > 0))
+    {
+        // Some jitter must be tolerated, otherwise the resulting rate would be noticeably lower than requested
+        const unsigned tolerance = min(unsigned(transfer_interval_msec_) / 2U,
+                                       unsigned(decimation.min_interval_msec) / 8U);
+        const unsigned elapsed = static_cast<uint16_t>(ts_msec - accepted_ts_msec_);
+        accept = (elapsed + tolerance) >= decimation.min_interval_msec;
+    }
+
+    if (!accept && (num_skipped_ < 0xFF))
+    {
+        num_skipped_++;
+    }
+    return accept;
+}
+
+bool TransferReceiver::commitTransfer(const TransferDecimation& decimation, uint16_t payload_crc, bool valid)
+{
+    const uint16_t ts_msec = static_cast<uint16_t>(getThisTransferTimestamp().toMSec());
+
+    if (decimation.on_change && accepted_once_ && valid && (payload_crc == accepted_crc_))
+    {
+        const unsigned elapsed = static_cast<uint16_t>(ts_msec - accepted_ts_msec_);
+        if ((decimation.heartbeat_msec == 0) || (elapsed < decimation.heartbeat_msec))
+        {
+            if (num_skipped_ < 0xFF)
+            {
+                num_skipped_++;
+            }
+            return false;
+        }
+    }
+
+    // Invalid transfers will be dropped by the caller; their payload can't be used as a reference
+    if (valid || !decimation.on_change)
+    {
+        num_skipped_ = 0;
+        accepted_ts_msec_ = ts_msec;
+        accepted_crc_ = payload_crc;
+        accepted_once_ = true;
+    }
+    return true;
+}
+
+bool TransferReceiver::writePayload(const RxFrame& frame, ITransferBuffer& buf, const TransferCRC& crc_base)
 {
     const uint8_t* const payload = frame.getPayloadPtr();
     const unsigned payload_len = frame.getPayloadLen();
@@ -113,6 +199,8 @@ bool TransferReceiver::writePayload(const RxFrame& frame, ITransferBuffer& buf)
         if (success)
         {
             buffer_write_pos_ = static_cast<uint16_t>(buffer_write_pos_ + effective_payload_len);
+            computed_crc_ = crc_base;
+            computed_crc_.add(payload + TransferCRC::NumBytes, effective_payload_len);
         }
         return success;
     }
@@ -123,18 +211,36 @@ bool TransferReceiver::writePayload(const RxFrame& frame, ITransferBuffer& buf)
         if (success)
         {
             buffer_write_pos_ = static_cast<uint16_t>(buffer_write_pos_ + payload_len);
+            computed_crc_.add(payload, payload_len);
         }
         return success;
     }
 }
 
-TransferReceiver::ResultCode TransferReceiver::receive(const RxFrame& frame, TransferBufferAccessor& tba)
+TransferReceiver::ResultCode TransferReceiver::receive(const RxFrame& frame, TransferBufferAccessor& tba,
+                                                      const TransferCRC& crc_base,
+                                                      const TransferDecimation& decimation)
 {
     // Transfer timestamps are derived from the first frame
     if (frame.isStartOfTransfer())
     {
-        this_transfer_ts_ = frame.getMonotonicTimestamp();
-        first_frame_ts_   = frame.getUtcTimestamp();
+        setThisTransferTimestamp(frame.getMonotonicTimestamp());
+        setFirstFrameTimestamp(frame.getUtcTimestamp());
+        skipping_ = decimation.isEnabled() && !acceptTransfer(decimation, frame.getMonotonicTimestamp());
+    }
+
+    // Skipped transfers go through the state machine as usual, but nothing is stored
+    if (skipping_)
+    {
+        if (frame.isEndOfTransfer())
+        {
+            updateTransferTimings();
+            prepareForNextTransfer();
+            skipping_ = false;
+            return ResultSkipped;
+        }
+        next_toggle_ = !next_toggle_;
+        return ResultNotComplete;
     }
 
     if (frame.isStartOfTransfer() && frame.isEndOfTransfer())
@@ -143,6 +249,20 @@ TransferReceiver::ResultCode TransferReceiver::receive(const RxFrame& frame, Tra
         updateTransferTimings();
         prepareForNextTransfer();
         this_transfer_crc_ = 0;         // SFT has no CRC
+        if (decimation.isEnabled())
+        {
+            uint16_t payload_crc = 0;
+            if (decimation.on_change)   // The payload is tiny, so it's cheap
+            {
+                TransferCRC crc = crc_base;
+                crc.add(frame.getPayloadPtr(), frame.getPayloadLen());
+                payload_crc = crc.get();
+            }
+            if (!commitTransfer(decimation, payload_crc, true))
+            {
+                return ResultSkipped;
+            }
+        }
         return ResultSingleFrame;
     }
 
@@ -159,7 +279,7 @@ TransferReceiver::ResultCode TransferReceiver::receive(const RxFrame& frame, Tra
         registerError();
         return ResultNotComplete;
     }
-    if (!writePayload(frame, *buf))
+    if (!writePayload(frame, *buf, crc_base))
     {
         UAVCAN_TRACE("TransferReceiver", "Payload write failed, %s", frame.toString().c_str());
         tba.remove();
@@ -173,6 +293,12 @@ TransferReceiver::ResultCode TransferReceiver::receive(const RxFrame& frame, Tra
     {
         updateTransferTimings();
         prepareForNextTransfer();
+        if (decimation.isEnabled() &&
+            !commitTransfer(decimation, computed_crc_.get(), computed_crc_.get() == this_transfer_crc_))
+        {
+            tba.remove();
+            return ResultSkipped;
+        }
         return ResultComplete;
     }
     return ResultNotComplete;
@@ -180,14 +306,26 @@ TransferReceiver::ResultCode TransferReceiver::receive(const RxFrame& frame, Tra
 
 bool TransferReceiver::isTimedOut(MonotonicTime current_ts) const
 {
-    return (current_ts - this_transfer_ts_) > getTidTimeout();
+    return (current_ts - getThisTransferTimestamp()) > getTidTimeout();
 }
 
-TransferReceiver::ResultCode TransferReceiver::addFrame(const RxFrame& frame, TransferBufferAccessor& tba)
+bool TransferReceiver::isExpired(MonotonicTime current_ts) const
 {
+    if (isMidTransfer())
+    {
+        return isTimedOut(current_ts);
+    }
+    return (current_ts - getThisTransferTimestamp()) > getReleaseTimeout();
+}
+
+TransferReceiver::ResultCode TransferReceiver::addFrame(const RxFrame& frame, TransferBufferAccessor& tba,
+                                                       const TransferCRC& crc_base,
+                                                       const TransferDecimation& decimation)
+{
+    const MonotonicTime this_transfer_ts = getThisTransferTimestamp();  // Not older than the previous transfer
+
     if ((frame.getMonotonicTimestamp().isZero()) ||
-        (frame.getMonotonicTimestamp() < prev_transfer_ts_) ||
-        (frame.getMonotonicTimestamp() < this_transfer_ts_))
+        (frame.getMonotonicTimestamp() < this_transfer_ts))
     {
         UAVCAN_TRACE("TransferReceiver", "Invalid frame, %s", frame.toString().c_str());
         return ResultNotComplete;
@@ -199,7 +337,7 @@ TransferReceiver::ResultCode TransferReceiver::addFrame(const RxFrame& frame, Tr
     const bool first_frame = frame.isStartOfTransfer();
     const bool non_wrapped_tid = tid_.computeForwardDistance(frame.getTransferID()) < TransferID::Half;
     const bool not_previous_tid = frame.getTransferID().computeForwardDistance(tid_) > 1;
-    const bool iface_switch_allowed = (frame.getMonotonicTimestamp() - this_transfer_ts_) > getIfaceSwitchDelay();
+    const bool iface_switch_allowed = (frame.getMonotonicTimestamp() - this_transfer_ts) > getIfaceSwitchDelay();
 
     // FSM, the hard way
     const bool need_restart =
@@ -224,6 +362,7 @@ TransferReceiver::ResultCode TransferReceiver::addFrame(const RxFrame& frame, Tr
         next_toggle_ = false;
         buffer_write_pos_ = 0;
         this_transfer_crc_ = 0;
+        skipping_ = false;
         if (!first_frame)
         {
             tid_.increment();
@@ -235,7 +374,7 @@ TransferReceiver::ResultCode TransferReceiver::addFrame(const RxFrame& frame, Tr
     {
         return ResultNotComplete;
     }
-    return receive(frame, tba);
+    return receive(frame, tba, crc_base, decimation);
 }
 
 uint8_t TransferReceiver::yieldErrorCount()
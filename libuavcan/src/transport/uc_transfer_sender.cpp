@@ -9,10 +9,57 @@
 
 namespace uavcan
 {
+/*
+ * OutgoingTransferBufferImpl
+ */
+void OutgoingTransferBufferImpl::updateCrc(unsigned end)
+{
+    UAVCAN_ASSERT(end <= getMaxWritePos());
+    if (end > crc_pos_)
+    {
+        crc_.add(getRawPtr() + crc_pos_, end - crc_pos_);
+        crc_pos_ = uint16_t(end);
+    }
+}
 
-void TransferSender::registerError() const
+int OutgoingTransferBufferImpl::write(unsigned offset, const uint8_t* data, unsigned len)
+{
+    if (offset < crc_pos_)
+    {
+        crc_ = crc_base_;       // Already processed data is being rewritten, it will be processed again
+        crc_pos_ = 0;
+    }
+    else if (offset > unsigned(CanFrame::MaxDataLen))
+    {
+        updateCrc(min(offset, unsigned(getMaxWritePos())));
+    }
+    else
+    {
+        ;   // Payload may fit one frame, no need to compute the CRC yet
+    }
+    return StaticTransferBufferImpl::write(offset, data, len);
+}
+
+void OutgoingTransferBufferImpl::reset(const TransferCRC& crc_base)
+{
+    StaticTransferBufferImpl::reset();
+    crc_base_ = crc_base;
+    crc_ = crc_base;
+    crc_pos_ = 0;
+}
+
+TransferCRC OutgoingTransferBufferImpl::getTransferCRC()
+{
+    updateCrc(getMaxWritePos());
+    return crc_;
+}
+
+/*
+ * TransferSender
+ */
+void TransferSender::registerError(TransferType transfer_type) const
 {
-    dispatcher_.getTransferPerfCounter().addError();
+    dispatcher_.getTransferPerfCounter().addTxError(getDataTypeKindForTransferType(transfer_type), data_type_id_);
 }
 
 void TransferSender::init(const DataTypeDescriptor& dtid, CanTxQueue::Qos qos)
@@ -22,11 +69,28 @@ void TransferSender::init(const DataTypeDescriptor& dtid, CanTxQueue::Qos qos)
     qos_          = qos;
     data_type_id_ = dtid.getID();
     crc_base_     = dtid.getSignature().toTransferCRC();
+    can_id_template_key_ = InvalidCanIDTemplateKey;
 }
 
-int TransferSender::send(const uint8_t* payload, unsigned payload_len, MonotonicTime tx_deadline,
-                         MonotonicTime blocking_deadline, TransferType transfer_type, NodeID dst_node_id,
-                         TransferID tid) const
+uint32_t TransferSender::getCanIDTemplate(TransferType transfer_type, NodeID src_node_id) const
+{
+    /*
+     * The priority and the node ID may change at any time, so they are checked on every transfer; this is much
+     * cheaper than packing the CAN ID, which was done for every frame before.
+     */
+    const uint16_t key = uint16_t((unsigned(priority_.get()) << 9) | (unsigned(transfer_type) << 7) |
+                                  src_node_id.get());
+    if (key != can_id_template_key_)
+    {
+        can_id_template_ = Frame::makeCanIDTemplate(priority_, transfer_type, data_type_id_, src_node_id);
+        can_id_template_key_ = key;
+    }
+    return can_id_template_;
+}
+
+int TransferSender::sendImpl(const uint8_t* payload, unsigned payload_len, OutgoingTransferBufferImpl* buffer,
+                             MonotonicTime tx_deadline, MonotonicTime blocking_deadline, TransferType transfer_type,
+                             NodeID dst_node_id, TransferID tid) const
 {
     Frame frame(data_type_id_, transfer_type, dispatcher_.getNodeID(), dst_node_id, tid);
 
@@ -43,76 +107,143 @@ int TransferSender::send(const uint8_t* payload, unsigned payload_len, Monotonic
     {
         const bool allow = allow_anonymous_transfers_ &&
                            (transfer_type == TransferTypeMessageBroadcast) &&
-                           (int(payload_len) <= frame.getPayloadCapacity());
+                           frame.canFitIntoSingleFrame(payload_len);
         if (!allow)
         {
             return -ErrPassiveMode;
         }
     }
 
-    dispatcher_.getTransferPerfCounter().addTxTransfer();
+    dispatcher_.getTransferPerfCounter().addTxTransfer(getDataTypeKindForTransferType(transfer_type), data_type_id_);
+
+#if !UAVCAN_TINY
+    // The subscribers in the same process get the transfer first; the bus decides whether the type is delivered
+    if ((transfer_type == TransferTypeMessageBroadcast) && dst_node_id.isBroadcast())
+    {
+        dispatcher_.deliverLocalTransfer(data_type_id_, priority_, tid, payload, payload_len);
+    }
+#endif
+
+    // All frames of the transfer are sent over the same interfaces
+    const uint8_t iface_mask = dispatcher_.getCanIOManager().selectTxIfaces(iface_mask_);
+    last_iface_mask_ = iface_mask;
+
+    // Only the first frame is validated below; the following frames differ in the payload and the tail byte only
+    const uint32_t can_id_template = getCanIDTemplate(transfer_type, frame.getSrcNodeID());
 
     /*
      * Sending frames
      */
-    if (frame.getPayloadCapacity() >= payload_len)           // Single Frame Transfer
+    if (frame.canFitIntoSingleFrame(payload_len))            // Single Frame Transfer
     {
         const int res = frame.setPayload(payload, payload_len);
         if (res != int(payload_len))
         {
             UAVCAN_ASSERT(0);
             UAVCAN_TRACE("TransferSender", "Frame payload write failure, %i", res);
-            registerError();
+            registerError(transfer_type);
             return (res < 0) ? res : -ErrLogic;
         }
 
         frame.setEndOfTransfer(true);
         UAVCAN_ASSERT(frame.isStartOfTransfer() && frame.isEndOfTransfer() && !frame.getToggle());
 
+        if (!frame.isValid())
+        {
+            UAVCAN_TRACE("TransferSender", "Frame is malformed: %s", frame.toString().c_str());
+            UAVCAN_ASSERT(0);
+            registerError(transfer_type);
+            return -ErrLogic;
+        }
+        CanFrame can_frame;
+        frame.compile(can_frame, can_id_template);
+
         const CanIOFlags flags = frame.getSrcNodeID().isUnicast() ? flags_ : (flags_ | CanIOFlagAbortOnError);
 
-        return dispatcher_.send(frame, tx_deadline, blocking_deadline, qos_, flags, iface_mask_);
+        return dispatcher_.sendBatch(&can_frame, 1, transfer_type, data_type_id_, tx_deadline, blocking_deadline,
+                                     qos_, flags, iface_mask);
     }
     else                                                   // Multi Frame Transfer
     {
         UAVCAN_ASSERT(!dispatcher_.isPassiveMode());
         UAVCAN_ASSERT(frame.getSrcNodeID().isUnicast());
 
+        /*
+         * With CAN FD, a payload that can't be sent in one frame because its length is not representable may still
+         * fit the first frame along with the CRC; at least one byte is left for the second frame in this case.
+         */
         int offset = 0;
         {
-            TransferCRC crc = crc_base_;
-            crc.add(payload, payload_len);
+            int write_res = 0;
+            if (buffer != NULL)
+            {
+                // The payload is already preceded by the space for CRC, so the frame can be filled right from it
+                const TransferCRC crc = buffer->getTransferCRC();
+                uint8_t* const head = buffer->getHeadroomPtr();
+
+                head[0] = uint8_t(crc.get() & 0xFFU);      // Transfer CRC, little endian
+                head[1] = uint8_t((crc.get() >> 8) & 0xFF);
+                write_res = frame.setPayload(head, payload_len + 1);
+            }
+            else
+            {
+                TransferCRC crc = crc_base_;
+                crc.add(payload, payload_len);
 
-            static const int BUFLEN = sizeof(static_cast<CanFrame*>(0)->data);
-            uint8_t buf[BUFLEN];
+                static const int BUFLEN = sizeof(static_cast<CanFrame*>(0)->data);
+                uint8_t buf[BUFLEN];
 
-            buf[0] = uint8_t(crc.get() & 0xFFU);       // Transfer CRC, little endian
-            buf[1] = uint8_t((crc.get() >> 8) & 0xFF);
-            (void)copy(payload, payload + BUFLEN - 2, buf + 2);
+                buf[0] = uint8_t(crc.get() & 0xFFU);       // Transfer CRC, little endian
+                buf[1] = uint8_t((crc.get() >> 8) & 0xFF);
+                const unsigned len = min(payload_len - 1U, unsigned(BUFLEN - 2));
+                (void)copy(payload, payload + len, buf + 2);
 
-            const int write_res = frame.setPayload(buf, BUFLEN);
+                write_res = frame.setPayload(buf, len + 2);
+            }
             if (write_res < 2)
             {
                 UAVCAN_TRACE("TransferSender", "Frame payload write failure, %i", write_res);
-                registerError();
+                registerError(transfer_type);
                 return write_res;
             }
             offset = write_res - 2;
             UAVCAN_ASSERT(int(payload_len) > offset);
         }
 
+        /*
+         * The frames are handed over to the dispatcher in batches, which costs one select() call and one queue
+         * insertion per batch rather than per frame; the batch size is limited to keep the stack usage bounded.
+         */
+        static const unsigned MaxFramesPerBatch = 8;
+        CanFrame batch[MaxFramesPerBatch];
+        unsigned batch_len = 0;
         int num_sent = 0;
 
         while (true)
         {
-            const int send_res = dispatcher_.send(frame, tx_deadline, blocking_deadline, qos_, flags_, iface_mask_);
-            if (send_res < 0)
+            if (frame.isStartOfTransfer() && !frame.isValid())
+            {
+                UAVCAN_TRACE("TransferSender", "Frame is malformed: %s", frame.toString().c_str());
+                UAVCAN_ASSERT(0);
+                registerError(transfer_type);
+                return -ErrLogic;
+            }
+            frame.compile(batch[batch_len], can_id_template);
+            batch_len++;
+
+            if (frame.isEndOfTransfer() || (batch_len >= MaxFramesPerBatch))
             {
-                registerError();
-                return send_res;
+                const int send_res = dispatcher_.sendBatch(batch, batch_len, transfer_type, data_type_id_,
+                                                           tx_deadline, blocking_deadline, qos_, flags_, iface_mask);
+                if (send_res < 0)
+                {
+                    registerError(transfer_type);
+                    return send_res;
+                }
+                num_sent += int(batch_len);
+                batch_len = 0;
             }
 
-            num_sent++;
             if (frame.isEndOfTransfer())
             {
                 return num_sent;  // Number of frames transmitted
@@ -126,7 +257,7 @@ int TransferSender::send(const uint8_t* payload, unsigned payload_len, Monotonic
             if (write_res < 0)
             {
                 UAVCAN_TRACE("TransferSender", "Frame payload write failure, %i", write_res);
-                registerError();
+                registerError(transfer_type);
                 return write_res;
             }
 
@@ -143,8 +274,8 @@ int TransferSender::send(const uint8_t* payload, unsigned payload_len, Monotonic
     return -ErrLogic; // Return path analysis is apparently broken. There should be no warning, this 'return' is unreachable.
 }
 
-int TransferSender::send(const uint8_t* payload, unsigned payload_len, MonotonicTime tx_deadline,
-                         MonotonicTime blocking_deadline, TransferType transfer_type, NodeID dst_node_id) const
+TransferID* TransferSender::accessTransferID(MonotonicTime tx_deadline, TransferType transfer_type,
+                                             NodeID dst_node_id) const
 {
     /*
      * TODO: TID is not needed for anonymous transfers, this part of the code can be skipped?
@@ -155,19 +286,76 @@ int TransferSender::send(const uint8_t* payload, unsigned payload_len, Monotonic
     const MonotonicTime otr_deadline = tx_deadline + max(max_transfer_interval_ * 2,
                                                          OutgoingTransferRegistry::MinEntryLifetime);
 
-    TransferID* const tid = dispatcher_.getOutgoingTransferRegistry().accessOrCreate(otr_key, otr_deadline);
+    OutgoingTransferRegistry& otr = dispatcher_.getOutgoingTransferRegistry();
+    TransferID* const tid = (transfer_type == TransferTypeMessageBroadcast) ?
+                            otr.accessOrCreate(otr_key, otr_deadline, broadcast_tid_cache_) :
+                            otr.accessOrCreate(otr_key, otr_deadline);
     if (tid == NULL)
     {
         UAVCAN_TRACE("TransferSender", "OTR access failure, dtid=%d tt=%i",
                      int(data_type_id_.get()), int(transfer_type));
+    }
+    return tid;
+}
+
+int TransferSender::takeTransferID(MonotonicTime tx_deadline, TransferType transfer_type, NodeID dst_node_id,
+                                   TransferID& out_tid) const
+{
+    TransferID* const tid = accessTransferID(tx_deadline, transfer_type, dst_node_id);
+    if (tid == NULL)
+    {
+        return -ErrMemory;
+    }
+    out_tid = *tid;
+    tid->increment();
+    return 0;
+}
+
+int TransferSender::send(const uint8_t* payload, unsigned payload_len, MonotonicTime tx_deadline,
+                         MonotonicTime blocking_deadline, TransferType transfer_type, NodeID dst_node_id,
+                         TransferID tid) const
+{
+    return sendImpl(payload, payload_len, NULL, tx_deadline, blocking_deadline, transfer_type, dst_node_id, tid);
+}
+
+int TransferSender::send(const uint8_t* payload, unsigned payload_len, MonotonicTime tx_deadline,
+                         MonotonicTime blocking_deadline, TransferType transfer_type, NodeID dst_node_id) const
+{
+    TransferID* const tid = accessTransferID(tx_deadline, transfer_type, dst_node_id);
+    if (tid == NULL)
+    {
+        return -ErrMemory;
+    }
+
+    const TransferID this_tid = tid->get();
+    tid->increment();
+
+    return sendImpl(payload, payload_len, NULL, tx_deadline, blocking_deadline, transfer_type,
+                    dst_node_id, this_tid);
+}
+
+int TransferSender::send(OutgoingTransferBufferImpl& buffer, MonotonicTime tx_deadline,
+                         MonotonicTime blocking_deadline, TransferType transfer_type, NodeID dst_node_id,
+                         TransferID tid) const
+{
+    return sendImpl(buffer.getRawPtr(), buffer.getMaxWritePos(), &buffer, tx_deadline, blocking_deadline,
+                    transfer_type, dst_node_id, tid);
+}
+
+int TransferSender::send(OutgoingTransferBufferImpl& buffer, MonotonicTime tx_deadline,
+                         MonotonicTime blocking_deadline, TransferType transfer_type, NodeID dst_node_id) const
+{
+    TransferID* const tid = accessTransferID(tx_deadline, transfer_type, dst_node_id);
+    if (tid == NULL)
+    {
         return -ErrMemory;
     }
 
     const TransferID this_tid = tid->get();
     tid->increment();
 
-    return send(payload, payload_len, tx_deadline, blocking_deadline, transfer_type,
-                dst_node_id, this_tid);
+    return sendImpl(buffer.getRawPtr(), buffer.getMaxWritePos(), &buffer, tx_deadline, blocking_deadline,
+                    transfer_type, dst_node_id, this_tid);
 }
 
 }
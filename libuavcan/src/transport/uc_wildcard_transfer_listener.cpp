@@ -0,0 +1,237 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <uavcan/build_config.hpp>
+
+#if !UAVCAN_TINY
+
+#include <uavcan/transport/wildcard_transfer_listener.hpp>
+#include <uavcan/node/global_data_type_registry.hpp>
+#include <uavcan/debug.hpp>
+
+namespace uavcan
+{
+/*
+ * WildcardTransferListener::BufferAdapter
+ */
+int WildcardTransferListener::BufferAdapter::read(unsigned offset, uint8_t* data, unsigned len) const
+{
+    return (buffer_ == NULL) ? 0 : buffer_->read(offset, data, len);
+}
+
+int WildcardTransferListener::BufferAdapter::write(unsigned offset, const uint8_t* data, unsigned len)
+{
+    if (buffer_ == NULL)
+    {
+        buffer_ = TransferBufferManagerEntry::instantiate(owner_.buffer_allocator_, owner_.max_buffer_size_);
+        if (buffer_ == NULL)
+        {
+            owner_.num_errors_++;
+            return -ErrMemory;
+        }
+    }
+    const int res = buffer_->write(offset, data, len);
+    if (res != int(len))
+    {
+        owner_.num_errors_++;       // The transfer will be abandoned by the receiver
+    }
+    return res;
+}
+
+const uint8_t* WildcardTransferListener::BufferAdapter::getContiguousData(unsigned& out_len) const
+{
+    if (buffer_ == NULL)
+    {
+        out_len = 0;
+        return NULL;
+    }
+    return buffer_->getContiguousData(out_len);
+}
+
+void WildcardTransferListener::BufferAdapter::discard()
+{
+    owner_.destroyBuffer(buffer_);
+}
+
+/*
+ * WildcardTransferListener::ExpiredReceiverPredicate
+ */
+bool WildcardTransferListener::ExpiredReceiverPredicate::operator()(const Key& key, const Receiver& value) const
+{
+    return value.receiver.isExpired(ts_) && ReleasingPredicate(owner_)(key, value);
+}
+
+/*
+ * WildcardTransferListener
+ */
+WildcardTransferListener::~WildcardTransferListener()
+{
+    stopListening();
+    // Map must be cleared before the buffers are lost
+    receivers_.removeAllWhere(ReleasingPredicate(*this));
+}
+
+void WildcardTransferListener::destroyBuffer(TransferBufferManagerEntry*& buffer)
+{
+    if (buffer != NULL)
+    {
+        TransferBufferManagerEntry::destroy(buffer, buffer->getAllocator());
+    }
+}
+
+const DataTypeDescriptor* WildcardTransferListener::findDataType(DataTypeKind kind, DataTypeID dtid)
+{
+    const GlobalDataTypeRegistry& registry = GlobalDataTypeRegistry::instance();
+    if (!registry.isFrozen())
+    {
+        return registry.find(kind, dtid);       // The registry may change, so there's nothing to cache
+    }
+
+    DataTypeCacheEntry& entry =
+        data_type_cache_[(unsigned(dtid.get()) ^ (unsigned(kind) << 3)) & (unsigned(DataTypeCacheSize) - 1U)];
+    if (!entry.valid || (entry.dtid != dtid.get()) || (entry.kind != uint8_t(kind)))
+    {
+        entry.descriptor = registry.find(kind, dtid);     // Negative results are cached too
+        entry.dtid = dtid.get();
+        entry.kind = uint8_t(kind);
+        entry.valid = true;
+    }
+    return entry.descriptor;
+}
+
+void WildcardTransferListener::startListening()
+{
+    dispatcher_.registerWildcardListener(this);
+}
+
+void WildcardTransferListener::stopListening()
+{
+    dispatcher_.unregisterWildcardListener(this);
+}
+
+bool WildcardTransferListener::isListening() const
+{
+    return dispatcher_.hasWildcardListener(this);
+}
+
+void WildcardTransferListener::resetDataTypeCache()
+{
+    fill_n(data_type_cache_, unsigned(DataTypeCacheSize), DataTypeCacheEntry());
+}
+
+void WildcardTransferListener::handleFrame(const RxFrame& frame)
+{
+    const DataTypeKind kind = getDataTypeKindForTransferType(frame.getTransferType());
+
+    if (!frame.getSrcNodeID().isUnicast())
+    {
+        if (filter_.anonymous &&
+            frame.getSrcNodeID().isBroadcast() &&
+            frame.isStartOfTransfer() &&
+            frame.isEndOfTransfer() &&
+            frame.getDstNodeID().isBroadcast())
+        {
+            SingleFrameIncomingTransfer it(frame);
+            deliver(it, frame.getDataTypeID(), frame.getDstNodeID(), findDataType(kind, frame.getDataTypeID()));
+        }
+        return;
+    }
+
+    const Key key(frame);
+    Receiver* recv = receivers_.access(key);
+    if (recv == NULL)
+    {
+        if (!frame.isStartOfTransfer())
+        {
+            return;
+        }
+        recv = receivers_.insert(key, Receiver());
+        if (recv == NULL)
+        {
+            UAVCAN_TRACE("WildcardTransferListener", "Receiver registration failed; frame %s",
+                         frame.toString().c_str());
+            num_errors_++;
+            return;
+        }
+    }
+
+    const DataTypeDescriptor* const data_type = findDataType(kind, frame.getDataTypeID());
+    const TransferCRC crc_base = (data_type != NULL) ? data_type->getSignature().toTransferCRC() : TransferCRC();
+
+    BufferAdapter buffer(*this, recv->buffer);
+    TransferBufferAccessor tba(buffer);
+
+    switch (recv->receiver.addFrame(frame, tba, crc_base))
+    {
+    case TransferReceiver::ResultSingleFrame:
+    {
+        SingleFrameIncomingTransfer it(frame);
+        deliver(it, frame.getDataTypeID(), frame.getDstNodeID(), data_type);
+        break;
+    }
+    case TransferReceiver::ResultComplete:
+    {
+        if (data_type == NULL)
+        {
+            UAVCAN_TRACE("WildcardTransferListener", "Unknown data type, last frame: %s", frame.toString().c_str());
+            num_unknown_data_type_transfers_++;
+            tba.remove();
+            break;
+        }
+        if (recv->receiver.getLastTransferComputedCrc() != recv->receiver.getLastTransferCrc())
+        {
+            UAVCAN_TRACE("WildcardTransferListener", "CRC mismatch, last frame: %s", frame.toString().c_str());
+            num_errors_++;
+            tba.remove();
+            break;
+        }
+        MultiFrameIncomingTransfer it(recv->receiver.getLastTransferTimestampMonotonic(),
+                                      recv->receiver.getLastTransferTimestampUtc(), frame, tba);
+        deliver(it, frame.getDataTypeID(), frame.getDstNodeID(), data_type);
+        it.release();
+        break;
+    }
+    case TransferReceiver::ResultNotComplete:
+    case TransferReceiver::ResultSkipped:
+    {
+        break;
+    }
+    default:
+    {
+        UAVCAN_ASSERT(0);
+        break;
+    }
+    }
+}
+
+void WildcardTransferListener::handleLocalTransfer(IncomingTransfer& transfer, DataTypeID dtid)
+{
+    const DataTypeDescriptor* const data_type = findDataType(DataTypeKindMessage, dtid);
+
+    unsigned len = 0;
+    (void)transfer.getContiguousData(len);
+    if (len > unsigned(CanFrame::MaxDataLen - 1))       // Would be a multi-frame transfer on the bus
+    {
+        if (data_type == NULL)
+        {
+            num_unknown_data_type_transfers_++;
+            return;
+        }
+        if (len > max_buffer_size_)
+        {
+            num_errors_++;
+            return;
+        }
+    }
+    deliver(transfer, dtid, NodeID::Broadcast, data_type);
+}
+
+void WildcardTransferListener::cleanup(MonotonicTime ts)
+{
+    receivers_.removeAllWhere(ExpiredReceiverPredicate(ts, *this));
+}
+
+}
+
+#endif // !UAVCAN_TINY
@@ -45,12 +45,7 @@ DataTypeSignatureCRC DataTypeSignatureCRC::extend(uint64_t crc)
 
 void DataTypeSignatureCRC::add(uint8_t byte)
 {
-    static const uint64_t Poly = 0x42F0E1EBA9EA3693;
-    crc_ ^= uint64_t(byte) << 56;
-    for (int i = 0; i < 8; i++)
-    {
-        crc_ = (crc_ & (uint64_t(1) << 63)) ? (crc_ << 1) ^ Poly : crc_ << 1;
-    }
+    crc_ = addBitwise(crc_, byte, 1);
 }
 
 void DataTypeSignatureCRC::add(const uint8_t* bytes, unsigned len)
@@ -62,36 +57,6 @@ void DataTypeSignatureCRC::add(const uint8_t* bytes, unsigned len)
     }
 }
 
-/*
- * DataTypeSignature
- */
-void DataTypeSignature::mixin64(uint64_t x)
-{
-    DataTypeSignatureCRC crc = DataTypeSignatureCRC::extend(value_);
-    for (int i = 0; i < 64; i += 8)   // LSB first
-    {
-        crc.add((x >> i) & 0xFF);
-    }
-    value_ = crc.get();
-}
-
-void DataTypeSignature::extend(DataTypeSignature dts)
-{
-    const uint64_t y = value_;
-    mixin64(dts.get());
-    mixin64(y);
-}
-
-TransferCRC DataTypeSignature::toTransferCRC() const
-{
-    TransferCRC tcrc;
-    for (int i = 0; i < 64; i += 8)    // LSB first
-    {
-        tcrc.add((value_ >> i) & 0xFF);
-    }
-    return tcrc;
-}
-
 /*
  * DataTypeDescriptor
  */
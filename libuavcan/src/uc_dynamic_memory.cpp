@@ -3,18 +3,172 @@
  */
 
 #include <uavcan/dynamic_memory.hpp>
+#include <uavcan/error.hpp>
 
 namespace uavcan
 {
+#if UAVCAN_POOL_USAGE_TRACKING
+/*
+ * PoolUsageTracker
+ */
+void PoolUsageTracker::registerAllocation(PoolUsageTag tag)
+{
+    if (tag >= NumPoolUsageTags)
+    {
+        UAVCAN_ASSERT(0);
+        return;
+    }
+    uint16_t& used = state_.num_used_blocks[tag];
+    if (used < 0xFFFFU)
+    {
+        used++;
+    }
+    if (used > state_.peak_num_used_blocks[tag])
+    {
+        state_.peak_num_used_blocks[tag] = used;
+    }
+}
+
+void PoolUsageTracker::registerDeallocation(PoolUsageTag tag)
+{
+    if (tag >= NumPoolUsageTags)
+    {
+        UAVCAN_ASSERT(0);
+        return;
+    }
+    UAVCAN_ASSERT(state_.num_used_blocks[tag] > 0);
+    if (state_.num_used_blocks[tag] > 0)
+    {
+        state_.num_used_blocks[tag]--;
+    }
+}
+
+void PoolUsageTracker::resetPeaks()
+{
+    for (unsigned i = 0; i < NumPoolUsageTags; i++)
+    {
+        state_.peak_num_used_blocks[i] = state_.num_used_blocks[i];
+    }
+}
+
+void PoolUsageTracker::reset()
+{
+    fill_n(state_.num_used_blocks, unsigned(NumPoolUsageTags), uint16_t(0));
+    fill_n(state_.peak_num_used_blocks, unsigned(NumPoolUsageTags), uint16_t(0));
+}
+
+/*
+ * TaggedPoolAllocator
+ */
+void* TaggedPoolAllocator::allocate(std::size_t size)
+{
+    void* const pmem = allocator_.allocate(size);
+    if ((pmem != NULL) && (tracker_ != NULL))
+    {
+        tracker_->registerAllocation(tag_);
+    }
+    return pmem;
+}
+
+void TaggedPoolAllocator::deallocate(const void* ptr)
+{
+    if ((ptr != NULL) && (tracker_ != NULL))
+    {
+        tracker_->registerDeallocation(tag_);
+    }
+    allocator_.deallocate(ptr);
+}
+#endif
+
+/*
+ * IPoolAllocator
+ */
+unsigned IPoolAllocator::allocateBatch(std::size_t size, void** out_ptrs, unsigned num_blocks)
+{
+    if (out_ptrs == NULL)
+    {
+        return 0;
+    }
+    unsigned num_allocated = 0;
+    while (num_allocated < num_blocks)
+    {
+        void* const ptr = allocate(size);
+        if (ptr == NULL)
+        {
+            break;
+        }
+        out_ptrs[num_allocated++] = ptr;
+    }
+    return num_allocated;
+}
+
+void IPoolAllocator::deallocateBatch(void* const* ptrs, unsigned num_blocks)
+{
+    if (ptrs == NULL)
+    {
+        return;
+    }
+    for (unsigned i = 0; i < num_blocks; i++)
+    {
+        deallocate(ptrs[i]);
+    }
+}
+
 /*
  * LimitedPoolAllocator
  */
+void LimitedPoolAllocator::setSharedQuota(SharedPoolQuota* quota, uint16_t guaranteed_blocks)
+{
+    if (shared_quota_ != NULL)
+    {
+        shared_quota_->giveBack(getNumCommittedBlocks());
+    }
+    shared_quota_ = quota;
+    guaranteed_blocks_ = (quota != NULL) ? guaranteed_blocks : uint16_t(0);
+    if (shared_quota_ != NULL)
+    {
+        shared_quota_->commit(getNumCommittedBlocks());
+    }
+}
+
 void* LimitedPoolAllocator::allocate(std::size_t size)
 {
+    return allocate(size, false);
+}
+
+void* LimitedPoolAllocator::allocate(std::size_t size, bool high_priority)
+{
+    if (shared_quota_ != NULL)
+    {
+        const bool borrowing = used_blocks_ >= guaranteed_blocks_;
+        if (borrowing && !shared_quota_->borrow(high_priority))
+        {
+            return NULL;
+        }
+        void* const ptr = allocator_.allocate(size);
+        if (ptr != NULL)
+        {
+            used_blocks_++;
+        }
+        else if (borrowing)
+        {
+            shared_quota_->giveBack();
+        }
+        else
+        {
+            ;   // The guaranteed block stays committed
+        }
+        return ptr;
+    }
+
     if (used_blocks_ < max_blocks_)
     {
-        used_blocks_++;
-        return allocator_.allocate(size);
+        void* const ptr = allocator_.allocate(size);
+        if (ptr != NULL)
+        {
+            used_blocks_++;     // Failed allocations must not eat up the quota
+        }
+        return ptr;
     }
     else
     {
@@ -29,13 +183,147 @@ void LimitedPoolAllocator::deallocate(const void* ptr)
     UAVCAN_ASSERT(used_blocks_ > 0);
     if (used_blocks_ > 0)
     {
+        if ((shared_quota_ != NULL) && (used_blocks_ > guaranteed_blocks_))
+        {
+            shared_quota_->giveBack();
+        }
         used_blocks_--;
     }
 }
 
 uint16_t LimitedPoolAllocator::getBlockCapacity() const
 {
+    if (shared_quota_ != NULL)
+    {
+        const unsigned quota = unsigned(getNumCommittedBlocks()) + shared_quota_->getNumBorrowableBlocks(false);
+        return static_cast<uint16_t>(min(min(quota, 0xFFFFU), unsigned(allocator_.getBlockCapacity())));
+    }
     return min(max_blocks_, allocator_.getBlockCapacity());
 }
 
+/*
+ * PartitionedPoolAllocator
+ */
+void PartitionedPoolAllocator::Partition::setReservation(uint16_t num_blocks)
+{
+    quota_->giveBack(getNumCommittedBlocks());
+    reserved_blocks_ = num_blocks;
+    quota_->commit(getNumCommittedBlocks());
+}
+
+void* PartitionedPoolAllocator::Partition::allocate(std::size_t size)
+{
+    UAVCAN_ASSERT((allocator_ != NULL) && (quota_ != NULL));
+    const bool borrowing = used_blocks_ >= reserved_blocks_;
+    if (borrowing && !quota_->borrow(true))
+    {
+        return NULL;
+    }
+    void* const ptr = allocator_->allocate(size);
+    if (ptr != NULL)
+    {
+        used_blocks_++;
+    }
+    else if (borrowing)
+    {
+        quota_->giveBack();
+    }
+    else
+    {
+        ;   // The reserved block stays committed
+    }
+    return ptr;
+}
+
+void PartitionedPoolAllocator::Partition::deallocate(const void* ptr)
+{
+    allocator_->deallocate(ptr);
+
+    UAVCAN_ASSERT(used_blocks_ > 0);
+    if (used_blocks_ > 0)
+    {
+        if (used_blocks_ > reserved_blocks_)
+        {
+            quota_->giveBack();
+        }
+        used_blocks_--;
+    }
+}
+
+uint16_t PartitionedPoolAllocator::Partition::getBlockCapacity() const
+{
+    const unsigned quota = unsigned(getNumCommittedBlocks()) + quota_->getNumBorrowableBlocks(true);
+    return static_cast<uint16_t>(min(min(quota, 0xFFFFU), unsigned(allocator_->getBlockCapacity())));
+}
+
+PartitionedPoolAllocator::PartitionedPoolAllocator(IPoolAllocator& allocator)
+    : allocator_(allocator)
+{
+    quota_.setLimits(allocator.getBlockCapacity(), 0);
+    for (unsigned i = 0; i < NumPoolUsageTags; i++)
+    {
+        partitions_[i].init(allocator, quota_);
+    }
+}
+
+int PartitionedPoolAllocator::setReservation(PoolUsageTag tag, uint16_t num_blocks)
+{
+    if (tag >= NumPoolUsageTags)
+    {
+        return -ErrInvalidParam;
+    }
+    unsigned total = num_blocks;
+    for (unsigned i = 0; i < NumPoolUsageTags; i++)
+    {
+        total += (i == unsigned(tag)) ? 0U : partitions_[i].getReservation();
+    }
+    if (total > quota_.getMaxBlocks())
+    {
+        return -ErrInvalidParam;
+    }
+    partitions_[tag].setReservation(num_blocks);
+    return 0;
+}
+
+uint16_t PartitionedPoolAllocator::getReservation(PoolUsageTag tag) const
+{
+    return (tag < NumPoolUsageTags) ? partitions_[tag].getReservation() : uint16_t(0);
+}
+
+uint16_t PartitionedPoolAllocator::getNumUsedBlocks(PoolUsageTag tag) const
+{
+    return (tag < NumPoolUsageTags) ? partitions_[tag].getNumUsedBlocks() : uint16_t(0);
+}
+
+uint16_t PartitionedPoolAllocator::getNumFreeBlocks(PoolUsageTag tag) const
+{
+    if (tag >= NumPoolUsageTags)
+    {
+        return 0;
+    }
+    const uint16_t capacity = partitions_[tag].getBlockCapacity();
+    const uint16_t used = partitions_[tag].getNumUsedBlocks();
+    return (capacity > used) ? static_cast<uint16_t>(capacity - used) : uint16_t(0);
+}
+
+void* PartitionedPoolAllocator::allocate(std::size_t size)
+{
+    return partitions_[PoolUsageTagOther].allocate(size);
+}
+
+void PartitionedPoolAllocator::deallocate(const void* ptr)
+{
+    partitions_[PoolUsageTagOther].deallocate(ptr);
+}
+
+IPoolAllocator& PartitionedPoolAllocator::getPartition(PoolUsageTag tag)
+{
+    if (tag < NumPoolUsageTags)
+    {
+        return partitions_[tag];
+    }
+    UAVCAN_ASSERT(0);
+    return partitions_[PoolUsageTagOther];
+}
+
 }
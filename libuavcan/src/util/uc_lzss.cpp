@@ -0,0 +1,426 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <uavcan/util/lzss.hpp>
+#include <uavcan/debug.hpp>
+
+namespace uavcan
+{
+namespace
+{
+
+const uint8_t LzssMagic[3] = { 'L', 'Z', 'S' };
+
+}
+
+/*
+ * LzssCompressor
+ */
+LzssCompressor::LzssCompressor()
+    : output_(NULL)
+    , size_(0)
+    , base_(0)
+    , pos_(0)
+    , end_(0)
+    , compressed_size_(0)
+    , window_size_(0)
+    , group_size_(0)
+    , group_items_(0)
+{
+    fill(buffer_, buffer_ + BufferSize, uint8_t(0));
+    fill(head_, head_ + HashSize, uint32_t(0));
+    fill(prev_, prev_ + LzssMaxWindowSize, uint32_t(0));
+    fill(group_, group_ + MaxGroupSize, uint8_t(0));
+}
+
+void LzssCompressor::insertHash(uint32_t pos)
+{
+    if ((pos + LzssMinMatchLength) > end_)
+    {
+        return;                         // Not enough bytes to compute the hash; this happens only at the end
+    }
+    const unsigned hash = computeHash(at(pos));
+    prev_[pos & (LzssMaxWindowSize - 1U)] = head_[hash];
+    head_[hash] = pos + 1U;
+}
+
+unsigned LzssCompressor::findMatch(uint32_t& out_distance) const
+{
+    const unsigned max_length = unsigned(min(end_ - pos_, uint32_t(LzssMaxMatchLength)));
+    if (max_length < LzssMinMatchLength)
+    {
+        return 0;
+    }
+
+    const uint8_t* const current = at(pos_);
+    unsigned best_length = 0;
+    uint32_t candidate = head_[computeHash(current)];
+
+    for (unsigned chain = 0; (candidate != 0) && (chain < MaxChainLength); chain++)
+    {
+        const uint32_t candidate_pos = candidate - 1U;
+        const uint32_t distance = pos_ - candidate_pos;
+        if ((candidate_pos >= pos_) || (distance > window_size_))
+        {
+            break;
+        }
+
+        const uint8_t* const p = at(candidate_pos);
+        unsigned length = 0;
+        while ((length < max_length) && (p[length] == current[length]))
+        {
+            length++;
+        }
+        if (length > best_length)
+        {
+            best_length = length;
+            out_distance = distance;
+            if (length == max_length)
+            {
+                break;
+            }
+        }
+
+        const uint32_t next = prev_[candidate_pos & (LzssMaxWindowSize - 1U)];
+        if (next >= candidate)
+        {
+            break;                      // The slot has been reused by a newer position, the chain ends here
+        }
+        candidate = next;
+    }
+
+    return (best_length >= LzssMinMatchLength) ? best_length : 0;
+}
+
+int LzssCompressor::writeOutput(const uint8_t* data, unsigned size)
+{
+    const int res = output_->write(data, size);
+    if (res < 0)
+    {
+        output_ = NULL;                 // The stream is broken
+        return res;
+    }
+    compressed_size_ += size;
+    return 0;
+}
+
+int LzssCompressor::flushGroup()
+{
+    if (group_items_ == 0)
+    {
+        return 0;
+    }
+    const int res = writeOutput(group_, group_size_);
+    group_[0] = 0;
+    group_size_ = 1;
+    group_items_ = 0;
+    return res;
+}
+
+int LzssCompressor::addItem(bool literal, uint32_t distance, unsigned length)
+{
+    if (literal)
+    {
+        group_[0] = uint8_t(group_[0] | (1U << group_items_));
+        group_[group_size_++] = *at(pos_);
+    }
+    else
+    {
+        const uint32_t code = distance - 1U;
+        group_[group_size_++] = uint8_t(code & 0xFFU);
+        group_[group_size_++] = uint8_t(((code >> 8) << 4) | (length - LzssMinMatchLength));
+    }
+    group_items_++;
+    return (group_items_ == 8) ? flushGroup() : 0;
+}
+
+int LzssCompressor::encode()
+{
+    /*
+     * The match lookup needs the lookahead of the maximum match length, plus the bytes that are needed to hash
+     * the positions covered by the match; the remainder is encoded once the last byte is received.
+     */
+    const uint32_t min_lookahead = LzssMaxMatchLength + LzssMinMatchLength - 1U;
+
+    while ((pos_ < end_) && (((end_ - pos_) >= min_lookahead) || (end_ == size_)))
+    {
+        uint32_t distance = 0;
+        const unsigned length = findMatch(distance);
+
+        const int res = addItem(length == 0, distance, length);
+        if (res < 0)
+        {
+            return res;
+        }
+
+        const uint32_t next_pos = pos_ + ((length == 0) ? 1U : length);
+        while (pos_ < next_pos)
+        {
+            insertHash(pos_);
+            pos_++;
+        }
+    }
+
+    return (pos_ == size_) ? flushGroup() : 0;
+}
+
+int LzssCompressor::begin(uint32_t size, ILzssOutput& output, uint8_t window_log2)
+{
+    if ((window_log2 < LzssMinWindowLog2) || (window_log2 > LzssMaxWindowLog2))
+    {
+        return -ErrInvalidParam;
+    }
+
+    output_ = &output;
+    size_ = size;
+    base_ = 0;
+    pos_ = 0;
+    end_ = 0;
+    compressed_size_ = 0;
+    window_size_ = uint16_t(1U << window_log2);
+    group_[0] = 0;
+    group_size_ = 1;
+    group_items_ = 0;
+    fill(head_, head_ + HashSize, uint32_t(0));
+
+    uint8_t header[LzssHeaderSize];
+    copy(LzssMagic, LzssMagic + 3, header);
+    header[3] = window_log2;
+    for (unsigned i = 0; i < 4; i++)
+    {
+        header[4 + i] = uint8_t((size >> (i * 8U)) & 0xFFU);
+    }
+    const int res = writeOutput(header, LzssHeaderSize);
+    if (res < 0)
+    {
+        return res;
+    }
+
+    return encode();                    // An empty stream is finished right away
+}
+
+int LzssCompressor::feed(const uint8_t* data, unsigned size)
+{
+    if (output_ == NULL)
+    {
+        return -ErrNotInited;
+    }
+    if ((data == NULL) && (size > 0))
+    {
+        return -ErrInvalidParam;
+    }
+    if (size > (size_ - end_))
+    {
+        return -ErrInvalidParam;
+    }
+
+    while (size > 0)
+    {
+        if ((end_ - base_) == BufferSize)
+        {
+            // Only the window before the current position is needed for the back references
+            const uint32_t new_base = pos_ - LzssMaxWindowSize;
+            UAVCAN_ASSERT((pos_ >= LzssMaxWindowSize) && (new_base > base_));
+            copy(buffer_ + (new_base - base_), buffer_ + BufferSize, buffer_);
+            base_ = new_base;
+        }
+
+        const unsigned chunk = min(size, unsigned(BufferSize - (end_ - base_)));
+        copy(data, data + chunk, buffer_ + (end_ - base_));
+        end_ += chunk;
+        data += chunk;
+        size -= chunk;
+
+        const int res = encode();
+        if (res < 0)
+        {
+            return res;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * LzssDecompressorBase
+ */
+void LzssDecompressorBase::reset()
+{
+    output_ = NULL;
+    size_ = 0;
+    num_produced_ = 0;
+    window_mask_ = uint16_t((1U << max_window_log2_) - 1U);
+    write_index_ = 0;
+    flushed_index_ = 0;
+    fill(header_, header_ + LzssHeaderSize, uint8_t(0));
+    stream_window_log2_ = 0;
+    state_ = StateHeader;
+    header_size_ = 0;
+    flags_ = 0;
+    num_items_left_ = 0;
+    match_byte_ = 0;
+}
+
+int LzssDecompressorBase::flush(unsigned end)
+{
+    UAVCAN_ASSERT(end >= flushed_index_);
+    int res = 0;
+    if (end > flushed_index_)
+    {
+        res = output_->write(window_ + flushed_index_, end - flushed_index_);
+    }
+    flushed_index_ = write_index_;
+    return res;
+}
+
+int LzssDecompressorBase::put(uint8_t byte)
+{
+    window_[write_index_] = byte;
+    write_index_ = uint16_t((write_index_ + 1U) & window_mask_);
+    num_produced_++;
+    // The end of the window is reached, so the rest of the window must be flushed before it is reused
+    return (write_index_ == 0) ? flush(unsigned(window_mask_) + 1U) : 0;
+}
+
+int LzssDecompressorBase::handleHeader()
+{
+    if (!equal(header_, header_ + 3, LzssMagic))
+    {
+        return -ErrInvalidMarshalData;
+    }
+    stream_window_log2_ = header_[3];
+    if ((stream_window_log2_ < LzssMinWindowLog2) || (stream_window_log2_ > LzssMaxWindowLog2))
+    {
+        return -ErrInvalidMarshalData;
+    }
+    if (stream_window_log2_ > max_window_log2_)
+    {
+        UAVCAN_TRACE("LzssDecompressor", "Window log2 %u is not supported, max %u",
+                     unsigned(stream_window_log2_), unsigned(max_window_log2_));
+        return -ErrNotSupported;
+    }
+    size_ = 0;
+    for (unsigned i = 0; i < 4; i++)
+    {
+        size_ |= uint32_t(header_[4 + i]) << (i * 8U);
+    }
+    state_ = (size_ == 0) ? StateFinished : StateFlags;
+    return 0;
+}
+
+int LzssDecompressorBase::handleMatch(uint8_t second_byte)
+{
+    const uint32_t distance = ((uint32_t(second_byte >> 4) << 8) | match_byte_) + 1U;
+    const unsigned length = unsigned(second_byte & 0x0FU) + LzssMinMatchLength;
+
+    if ((distance > num_produced_) || (distance > (1U << stream_window_log2_)) ||
+        (length > (size_ - num_produced_)))
+    {
+        return -ErrInvalidMarshalData;
+    }
+
+    for (unsigned i = 0; i < length; i++)
+    {
+        const int res = put(window_[(write_index_ - distance) & window_mask_]);
+        if (res < 0)
+        {
+            return res;
+        }
+    }
+    return 0;
+}
+
+int LzssDecompressorBase::handleByte(uint8_t byte)
+{
+    int res = 0;
+    switch (state_)
+    {
+    case StateHeader:
+    {
+        header_[header_size_++] = byte;
+        if (header_size_ == LzssHeaderSize)
+        {
+            res = handleHeader();
+        }
+        return res;
+    }
+    case StateFlags:
+    {
+        flags_ = byte;
+        num_items_left_ = 8;
+        state_ = StateItem;
+        return 0;
+    }
+    case StateItem:
+    {
+        const bool literal = (flags_ & 1U) != 0;
+        flags_ = uint8_t(flags_ >> 1);
+        num_items_left_--;
+        if (!literal)
+        {
+            match_byte_ = byte;
+            state_ = StateMatch;
+            return 0;
+        }
+        res = put(byte);
+        break;
+    }
+    case StateMatch:
+    {
+        res = handleMatch(byte);
+        break;
+    }
+    case StateFinished:
+    case StateError:
+    default:
+    {
+        UAVCAN_ASSERT(0);
+        return -ErrLogic;
+    }
+    }
+
+    if (res >= 0)
+    {
+        if (num_produced_ == size_)
+        {
+            state_ = StateFinished;
+        }
+        else
+        {
+            state_ = (num_items_left_ == 0) ? StateFlags : StateItem;
+        }
+    }
+    return res;
+}
+
+int LzssDecompressorBase::feed(const uint8_t* data, unsigned size, ILzssOutput& output)
+{
+    if (state_ == StateError)
+    {
+        return -ErrLogic;
+    }
+    if ((data == NULL) && (size > 0))
+    {
+        return -ErrInvalidParam;
+    }
+
+    output_ = &output;
+    int res = 0;
+    for (unsigned i = 0; (i < size) && (state_ != StateFinished) && (res >= 0); i++)
+    {
+        res = handleByte(data[i]);
+    }
+    if (res >= 0)
+    {
+        res = flush(write_index_);
+    }
+    if (res < 0)
+    {
+        state_ = StateError;
+    }
+    output_ = NULL;
+    return res;
+}
+
+}
@@ -97,6 +97,32 @@ TEST(DataTypeSignature, Correctness)
 }
 
 
+
+TEST(DataTypeSignature, CompileTime)
+{
+    using uavcan::DataTypeSignature;
+
+#if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
+    // The values are checked against the runtime computation below
+    static_assert(DataTypeSignature(0x123456789abcdef0).extended(DataTypeSignature(0xfedcba9876543210)).get() ==
+                  0x47FA9202D37B3A45ULL, "Signature extension must be computable at compile time");
+    static_assert(DataTypeSignature(0x47FA9202D37B3A45ULL).toTransferCRC().get() == 0x4585,
+                  "Transfer CRC seed must be computable at compile time");
+#endif
+
+    DataTypeSignature signature(0x123456789abcdef0);
+    signature.extend(DataTypeSignature(0xfedcba9876543210));
+    ASSERT_EQ(0x47FA9202D37B3A45ULL, signature.get());
+
+    uavcan::TransferCRC crc;
+    for (int i = 0; i < 64; i += 8)    // LSB first
+    {
+        crc.add(uint8_t((signature.get() >> i) & 0xFF));
+    }
+    ASSERT_EQ(crc.get(), signature.toTransferCRC().get());
+    ASSERT_EQ(0x4585, crc.get());
+}
+
 TEST(DataTypeDescriptor, ToString)
 {
     uavcan::DataTypeDescriptor desc;
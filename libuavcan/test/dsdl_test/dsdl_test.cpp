@@ -58,6 +58,10 @@ TEST(Dsdl, Signature)
     ASSERT_EQ(uavcan::DataTypeKindService, root_ns_a::EmptyService::DataTypeKind);
 
     ASSERT_EQ(0x99604d7066e0d713, root_ns_a::NestedMessage::getDataTypeSignature().get());  // Computed manually
+#if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
+    static_assert(root_ns_a::NestedMessage::getDataTypeSignature().get() == 0x99604d7066e0d713ULL,
+                  "Signatures of the generated types must be compile-time constants");
+#endif
     ASSERT_STREQ("root_ns_a.NestedMessage", root_ns_a::NestedMessage::getDataTypeFullName());
     ASSERT_EQ(uavcan::DataTypeKindMessage, root_ns_a::NestedMessage::DataTypeKind);
 }
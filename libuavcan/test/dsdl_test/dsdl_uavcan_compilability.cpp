@@ -5,6 +5,7 @@
 #include <gtest/gtest.h>
 
 #include <uavcan/helpers/ostream.hpp>
+#include <uavcan/helpers/exporters.hpp>
 #include <uavcan/transport/transfer_buffer.hpp>
 
 #include <uavcan/Timestamp.hpp>
@@ -95,6 +96,28 @@ TEST(Dsdl, Streaming)
                              "    bools: [0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0]"));
 }
 
+TEST(Dsdl, JsonExport)
+{
+    char buffer[1000];
+    ASSERT_LT(0, uavcan::exportJson(uavcan::protocol::GetNodeInfo::Response(), buffer, sizeof(buffer)));
+    EXPECT_STREQ("{\"status\":{\"uptime_sec\":0,\"health\":0,\"mode\":0,\"sub_mode\":0,"
+                 "\"vendor_specific_status_code\":0},"
+                 "\"software_version\":{\"major\":0,\"minor\":0,\"optional_field_flags\":0,\"vcs_commit\":0,"
+                 "\"image_crc\":0},"
+                 "\"hardware_version\":{\"major\":0,\"minor\":0,"
+                 "\"unique_id\":[0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0],\"certificate_of_authenticity\":\"\"},"
+                 "\"name\":\"\"}", buffer);
+
+    root_ns_a::UnionTest union_test;
+    ASSERT_LT(0, uavcan::exportJson(union_test, buffer, sizeof(buffer)));
+    EXPECT_STREQ("{\"z\":{}}", buffer);
+    union_test.to<root_ns_a::UnionTest::Tag::c>() = 1234;
+    ASSERT_LT(0, uavcan::exportJson(union_test, buffer, sizeof(buffer)));
+    EXPECT_STREQ("{\"c\":1234}", buffer);
+
+    ASSERT_EQ(-uavcan::ErrMemory, uavcan::exportJson(uavcan::protocol::GetNodeInfo::Response(), buffer, 10));
+}
+
 
 template <typename T>
 static bool encodeDecodeValidate(const T& obj, const std::string& reference_bit_string)
@@ -2,8 +2,11 @@
  * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
  */
 
+#include <vector>
 #include <gtest/gtest.h>
 #include <uavcan/dynamic_memory.hpp>
+#include <uavcan/error.hpp>
+#include <uavcan/util/map.hpp>
 
 TEST(DynamicMemory, Basic)
 {
@@ -71,4 +74,421 @@ TEST(DynamicMemory, LimitedPoolAllocator)
     EXPECT_FALSE(ptr6);
 
     EXPECT_EQ(2, pool32.getPeakNumUsedBlocks());
+    EXPECT_EQ(2, lim.getNumUsedBlocks());
+    EXPECT_EQ(0, lim.getNumFreeBlocks());
+
+    // Failed allocations in the underlying allocator don't consume the quota
+    uavcan::LimitedPoolAllocator lim_large(pool32, 10);
+    EXPECT_EQ(4, lim_large.getNumFreeBlocks());     // Limited by the pool capacity, two blocks are taken already
+    EXPECT_TRUE(lim_large.allocate(1));
+    EXPECT_TRUE(lim_large.allocate(1));
+    EXPECT_FALSE(lim_large.allocate(1));            // The pool is exhausted, the quota is not
+    EXPECT_EQ(2, lim_large.getNumUsedBlocks());
+    EXPECT_EQ(2, lim_large.getNumFreeBlocks());
+}
+
+TEST(DynamicMemory, SharedPoolQuota)
+{
+    uavcan::PoolAllocator<32 * 16, 32> pool32;
+    uavcan::SharedPoolQuota quota;
+    quota.setLimits(8, 2);
+
+    uavcan::LimitedPoolAllocator a(pool32, 1);
+    uavcan::LimitedPoolAllocator b(pool32, 1);
+    a.setSharedQuota(&quota, 2);
+    b.setSharedQuota(&quota, 2);
+    EXPECT_EQ(4, quota.getNumCommittedBlocks());
+    EXPECT_EQ(2, quota.getNumBorrowableBlocks(false));
+    EXPECT_EQ(4, quota.getNumBorrowableBlocks(true));
+    EXPECT_EQ(4, a.getBlockCapacity());                 // 2 guaranteed + 2 borrowable
+
+    // The first allocator takes all the blocks it can
+    std::vector<void*> ptrs;
+    while (void* const p = a.allocate(1))
+    {
+        ptrs.push_back(p);
+    }
+    EXPECT_EQ(4, ptrs.size());
+    EXPECT_EQ(6, quota.getNumCommittedBlocks());
+
+    // The guaranteed blocks of the other one are still there, the reserve is available for high priority only
+    EXPECT_EQ(2, b.getNumFreeBlocks());
+    void* const b1 = b.allocate(1);
+    void* const b2 = b.allocate(1);
+    EXPECT_TRUE(b1);
+    EXPECT_TRUE(b2);
+    EXPECT_FALSE(b.allocate(1));
+    void* const b3 = b.allocate(1, true);
+    EXPECT_TRUE(b3);
+    void* const a5 = a.allocate(1, true);
+    EXPECT_TRUE(a5);
+    EXPECT_FALSE(a.allocate(1, true));                  // The budget is exhausted
+    EXPECT_EQ(8, quota.getNumCommittedBlocks());
+    EXPECT_EQ(0, a.getNumFreeBlocks());
+
+    // Released blocks go back to the budget
+    b.deallocate(b3);
+    b.deallocate(b2);
+    EXPECT_EQ(7, quota.getNumCommittedBlocks());        // The guaranteed block stays committed
+    a.deallocate(a5);
+    EXPECT_EQ(6, quota.getNumCommittedBlocks());
+    EXPECT_FALSE(a.allocate(1));                        // The rest is reserved
+    EXPECT_TRUE(b.allocate(1));                         // Guaranteed
+
+    // Detaching restores the fixed limit
+    b.setSharedQuota(NULL, 0);
+    EXPECT_EQ(4, quota.getNumCommittedBlocks());
+    EXPECT_EQ(0, b.getNumFreeBlocks());
+    a.setSharedQuota(NULL, 0);
+    EXPECT_EQ(0, quota.getNumCommittedBlocks());
+}
+
+TEST(DynamicMemory, PartitionedPoolAllocator)
+{
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 8, uavcan::MemPoolBlockSize> pool;
+    uavcan::PartitionedPoolAllocator part(pool);
+
+    EXPECT_EQ(8, part.getBlockCapacity());
+    EXPECT_EQ(8, part.getNumFreeBlocks(uavcan::PoolUsageTagTxQueue));
+    EXPECT_EQ(&pool, &pool.getPartition(uavcan::PoolUsageTagTxQueue));     // Not partitioned
+
+    EXPECT_EQ(-uavcan::ErrInvalidParam, part.setReservation(uavcan::NumPoolUsageTags, 1));
+    EXPECT_EQ(0, part.setReservation(uavcan::PoolUsageTagTxQueue, 3));
+    EXPECT_EQ(0, part.setReservation(uavcan::PoolUsageTagServiceCalls, 2));
+    EXPECT_EQ(-uavcan::ErrInvalidParam, part.setReservation(uavcan::PoolUsageTagTransferBuffers, 4));
+    EXPECT_EQ(3, part.getReservation(uavcan::PoolUsageTagTxQueue));
+    EXPECT_EQ(6, part.getNumFreeBlocks(uavcan::PoolUsageTagTxQueue));      // 3 reserved + 3 not reserved
+    EXPECT_EQ(3, part.getNumFreeBlocks(uavcan::PoolUsageTagTransferBuffers));
+
+    // A burst in one subsystem takes everything that is not reserved
+    uavcan::IPoolAllocator& rx = part.getPartition(uavcan::PoolUsageTagTransferBuffers);
+    std::vector<void*> rx_blocks;
+    while (void* const p = rx.allocate(1))
+    {
+        rx_blocks.push_back(p);
+    }
+    EXPECT_EQ(3, rx_blocks.size());
+    EXPECT_EQ(3, part.getNumUsedBlocks(uavcan::PoolUsageTagTransferBuffers));
+    EXPECT_FALSE(part.allocate(1));                     // Other, nothing reserved
+
+    // The reservations are still available
+    uavcan::IPoolAllocator& tx = part.getPartition(uavcan::PoolUsageTagTxQueue);
+    void* const tx1 = tx.allocate(1);
+    void* const tx2 = tx.allocate(1);
+    void* const tx3 = tx.allocate(1);
+    EXPECT_TRUE(tx1);
+    EXPECT_TRUE(tx2);
+    EXPECT_TRUE(tx3);
+    EXPECT_FALSE(tx.allocate(1));
+    EXPECT_EQ(0, part.getNumFreeBlocks(uavcan::PoolUsageTagTxQueue));
+    EXPECT_EQ(2, part.getNumFreeBlocks(uavcan::PoolUsageTagServiceCalls));
+
+    // Unreserved blocks go back to everyone
+    rx.deallocate(rx_blocks.back());
+    rx_blocks.pop_back();
+    EXPECT_EQ(1, part.getNumFreeBlocks(uavcan::PoolUsageTagTxQueue));
+    void* const other = part.allocate(1);
+    EXPECT_TRUE(other);
+    EXPECT_EQ(0, part.getNumFreeBlocks(uavcan::PoolUsageTagTransferBuffers));
+    part.deallocate(other);
+
+    tx.deallocate(tx1);
+    tx.deallocate(tx2);
+    tx.deallocate(tx3);
+    while (!rx_blocks.empty())
+    {
+        rx.deallocate(rx_blocks.back());
+        rx_blocks.pop_back();
+    }
+    EXPECT_EQ(0, pool.getNumUsedBlocks());
+    EXPECT_EQ(3, part.getNumFreeBlocks(uavcan::PoolUsageTagTransferBuffers));
+
+    // The library containers use their partitions
+    {
+        uavcan::Map<int, int> rx_map(part, uavcan::PoolUsageTagTransferBuffers);
+        for (int i = 1; i <= 64; i++)
+        {
+            (void)rx_map.insert(i, i);
+        }
+        EXPECT_EQ(3, part.getNumUsedBlocks(uavcan::PoolUsageTagTransferBuffers));
+        EXPECT_EQ(3, part.getNumFreeBlocks(uavcan::PoolUsageTagTxQueue));
+    }
+    EXPECT_EQ(0, part.getNumUsedBlocks(uavcan::PoolUsageTagTransferBuffers));
+}
+
+TEST(DynamicMemory, ReservedPoolAllocator)
+{
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 2, uavcan::MemPoolBlockSize> shared;
+    uavcan::ReservedPoolAllocator<2> pool(shared);
+
+    EXPECT_EQ(4, pool.getBlockCapacity());
+    EXPECT_EQ(2, pool.getNumReservedBlocks());
+
+    // Own blocks first
+    const void* ptr1 = pool.allocate(1);
+    const void* ptr2 = pool.allocate(uavcan::MemPoolBlockSize);
+    ASSERT_TRUE(ptr1);
+    ASSERT_TRUE(ptr2);
+    EXPECT_EQ(2, pool.getNumUsedReservedBlocks());
+    EXPECT_EQ(0, shared.getNumUsedBlocks());
+    EXPECT_EQ(0, pool.getNumFallbackAllocations());
+
+    // Then the fallback
+    const void* ptr3 = pool.allocate(1);
+    ASSERT_TRUE(ptr3);
+    EXPECT_EQ(1, shared.getNumUsedBlocks());
+    EXPECT_EQ(1, pool.getNumFallbackAllocations());
+
+    // Deallocation returns the blocks where they came from
+    pool.deallocate(ptr1);
+    EXPECT_EQ(1, pool.getNumUsedReservedBlocks());
+    pool.deallocate(ptr3);
+    EXPECT_EQ(0, shared.getNumUsedBlocks());
+    pool.deallocate(ptr2);
+    pool.deallocate(NULL);
+    EXPECT_EQ(0, pool.getNumUsedReservedBlocks());
+
+    // Contiguous allocations are never served by the fallback
+    EXPECT_FALSE(pool.allocate(uavcan::MemPoolBlockSize * 2));
+    EXPECT_EQ(0, shared.getNumUsedBlocks());
+    EXPECT_EQ(1, pool.getNumFallbackAllocations());
+}
+
+TEST(DynamicMemory, MultiPoolAllocator)
+{
+    typedef uavcan::MultiPoolAllocator<4, 2, 2, 0, 1> Allocator;
+    Allocator pool;
+
+    EXPECT_EQ(9, pool.getBlockCapacity());
+    EXPECT_EQ(4 * 16 + 2 * 32 + 2 * 64 + 256, Allocator::PoolSize);
+    EXPECT_EQ(16, Allocator::getBlockSize(0));
+    EXPECT_EQ(256, Allocator::getBlockSize(4));
+    EXPECT_EQ(0, Allocator::getNumBlocks(3));
+    EXPECT_EQ(0, pool.getNumUsedBlocks());
+
+    // Smallest fitting size class is used
+    const void* ptr16 = pool.allocate(10);
+    const void* ptr32 = pool.allocate(17);
+    const void* ptr64 = pool.allocate(64);
+    ASSERT_TRUE(ptr16);
+    ASSERT_TRUE(ptr32);
+    ASSERT_TRUE(ptr64);
+    EXPECT_EQ(1, pool.getNumUsedBlocks(0));
+    EXPECT_EQ(1, pool.getNumUsedBlocks(1));
+    EXPECT_EQ(1, pool.getNumUsedBlocks(2));
+    EXPECT_EQ(3, pool.getNumUsedBlocks());
+
+    // Size class 128 is disabled, so the next larger one is used
+    const void* ptr128 = pool.allocate(100);
+    ASSERT_TRUE(ptr128);
+    EXPECT_EQ(1, pool.getNumUsedBlocks(4));
+    EXPECT_FALSE(pool.allocate(100));
+    EXPECT_FALSE(pool.allocate(257));
+
+    // When a size class is exhausted, larger classes are used
+    const void* ptrs[5];
+    for (int i = 0; i < 5; i++)
+    {
+        ptrs[i] = pool.allocate(16);
+        ASSERT_TRUE(ptrs[i]);
+    }
+    EXPECT_EQ(4, pool.getNumUsedBlocks(0));
+    EXPECT_EQ(2, pool.getNumUsedBlocks(1));
+    EXPECT_EQ(2, pool.getNumUsedBlocks(2));
+    EXPECT_EQ(9, pool.getNumUsedBlocks());
+    EXPECT_FALSE(pool.allocate(1));
+
+    // Deallocation returns blocks to their own size classes
+    pool.deallocate(ptr64);
+    EXPECT_EQ(1, pool.getNumUsedBlocks(2));
+    pool.deallocate(ptr128);
+    EXPECT_EQ(0, pool.getNumUsedBlocks(4));
+    pool.deallocate(ptr16);
+    pool.deallocate(ptr32);
+    for (int i = 0; i < 5; i++)
+    {
+        pool.deallocate(ptrs[i]);
+    }
+    pool.deallocate(NULL);
+    EXPECT_EQ(0, pool.getNumUsedBlocks());
+
+    // Peak usage is tracked per size class
+    EXPECT_EQ(4, pool.getPeakNumUsedBlocks(0));
+    EXPECT_EQ(2, pool.getPeakNumUsedBlocks(1));
+    EXPECT_EQ(2, pool.getPeakNumUsedBlocks(2));
+    EXPECT_EQ(0, pool.getPeakNumUsedBlocks(3));
+    EXPECT_EQ(1, pool.getPeakNumUsedBlocks(4));
+
+    // Blocks can be reused
+    const void* ptr = pool.allocate(200);
+    ASSERT_TRUE(ptr);
+    EXPECT_EQ(1, pool.getNumUsedBlocks(4));
+    pool.deallocate(ptr);
 }
+
+TEST(DynamicMemory, PoolAllocatorBatch)
+{
+    uavcan::PoolAllocator<128, 32> pool32;
+    void* ptrs[8];
+
+    EXPECT_EQ(0, pool32.allocateBatch(33, ptrs, 2));               // Too large
+    EXPECT_EQ(3, pool32.allocateBatch(32, ptrs, 3));
+    EXPECT_EQ(3, pool32.getNumUsedBlocks());
+    EXPECT_EQ(1, pool32.allocateBatch(1, ptrs + 3, 5));             // Only one block left
+    EXPECT_EQ(0, pool32.getNumFreeBlocks());
+    EXPECT_EQ(4, pool32.getPeakNumUsedBlocks());
+
+    pool32.deallocateBatch(ptrs, 4);
+    EXPECT_EQ(0, pool32.getNumUsedBlocks());
+    EXPECT_EQ(4, pool32.getPeakNumUsedBlocks());
+
+    // Default implementation via the interface
+    uavcan::LimitedPoolAllocator lim(pool32, 2);
+    EXPECT_EQ(2, lim.allocateBatch(1, ptrs, 4));
+    EXPECT_EQ(2, pool32.getNumUsedBlocks());
+    lim.deallocateBatch(ptrs, 2);
+    EXPECT_EQ(0, pool32.getNumUsedBlocks());
+}
+
+TEST(DynamicMemory, PoolAllocatorMagazine)
+{
+    uavcan::PoolAllocator<32 * 16, 32> shared;
+    typedef uavcan::PoolAllocatorMagazine<4, 32> Magazine;
+
+    {
+        Magazine mag_a(shared);
+        Magazine mag_b(shared);
+
+        EXPECT_EQ(16, mag_a.getBlockCapacity());
+        EXPECT_FALSE(mag_a.allocate(33));
+
+        // First allocation refills the magazine with half of its capacity
+        const void* a1 = mag_a.allocate(10);
+        ASSERT_TRUE(a1);
+        EXPECT_EQ(1, mag_a.getNumUsedBlocks());
+        EXPECT_EQ(1, mag_a.getNumCachedBlocks());
+        EXPECT_EQ(2, shared.getNumUsedBlocks());
+
+        const void* a2 = mag_a.allocate(32);
+        ASSERT_TRUE(a2);
+        EXPECT_EQ(0, mag_a.getNumCachedBlocks());
+        EXPECT_EQ(2, shared.getNumUsedBlocks());
+
+        // Freed blocks are cached, not returned to the shared pool
+        mag_a.deallocate(a1);
+        EXPECT_EQ(1, mag_a.getNumUsedBlocks());
+        EXPECT_EQ(1, mag_a.getNumCachedBlocks());
+        EXPECT_EQ(2, shared.getNumUsedBlocks());
+        EXPECT_EQ(a1, mag_a.allocate(1));                            // Reused immediately
+
+        // Another magazine works independently
+        void* b[7];
+        for (int i = 0; i < 7; i++)
+        {
+            b[i] = mag_b.allocate(32);
+            ASSERT_TRUE(b[i]);
+        }
+        EXPECT_EQ(7, mag_b.getNumUsedBlocks());
+        EXPECT_EQ(7, mag_b.getPeakNumUsedBlocks());
+        EXPECT_EQ(10, shared.getNumUsedBlocks());
+
+        // When the magazine is full, half of it is flushed back to the shared pool
+        for (int i = 0; i < 7; i++)
+        {
+            mag_b.deallocate(b[i]);
+        }
+        EXPECT_EQ(0, mag_b.getNumUsedBlocks());
+        EXPECT_EQ(7, mag_b.getPeakNumUsedBlocks());
+        EXPECT_GE(4, mag_b.getNumCachedBlocks());
+        EXPECT_EQ(2 + mag_b.getNumCachedBlocks(), shared.getNumUsedBlocks());
+
+        mag_b.flush();
+        EXPECT_EQ(0, mag_b.getNumCachedBlocks());
+        EXPECT_EQ(2, shared.getNumUsedBlocks());
+
+        // Exhausting the shared pool
+        std::vector<void*> all;
+        while (void* p = mag_b.allocate(32))
+        {
+            all.push_back(p);
+        }
+        EXPECT_EQ(14, all.size());
+        EXPECT_EQ(0, shared.getNumFreeBlocks());
+        EXPECT_FALSE(mag_a.allocate(32));
+        for (unsigned i = 0; i < all.size(); i++)
+        {
+            mag_b.deallocate(all[i]);
+        }
+
+        mag_a.deallocate(a1);
+        mag_a.deallocate(a2);
+    }
+
+    // Destructors return everything
+    EXPECT_EQ(0, shared.getNumUsedBlocks());
+    EXPECT_EQ(16, shared.getPeakNumUsedBlocks());
+}
+
+#if UAVCAN_POOL_USAGE_TRACKING
+
+TEST(DynamicMemory, PoolUsageTracking)
+{
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 8, uavcan::MemPoolBlockSize> pool;
+    uavcan::PoolUsageTracker* const tracker = pool.getUsageTracker();
+    ASSERT_TRUE(tracker);
+
+    // Untagged allocations are not counted
+    void* const untagged = pool.allocate(1);
+    ASSERT_TRUE(untagged);
+    EXPECT_EQ(0, tracker->getNumUsedBlocks(uavcan::PoolUsageTagOther));
+
+    uavcan::LimitedPoolAllocator tx_queue(pool, 4, uavcan::PoolUsageTagTxQueue);
+    void* a = tx_queue.allocate(1);
+    void* b = tx_queue.allocate(1);
+    ASSERT_TRUE(a);
+    ASSERT_TRUE(b);
+    EXPECT_EQ(2, tracker->getNumUsedBlocks(uavcan::PoolUsageTagTxQueue));
+    EXPECT_EQ(2, tracker->getPeakNumUsedBlocks(uavcan::PoolUsageTagTxQueue));
+
+    {
+        uavcan::Map<int, int> map(pool, uavcan::PoolUsageTagOutgoingTransferRegistry);
+        ASSERT_TRUE(map.insert(1, 2));
+        EXPECT_EQ(1, tracker->getNumUsedBlocks(uavcan::PoolUsageTagOutgoingTransferRegistry));
+
+        // Nested tagged allocators are not counted twice
+        uavcan::Map<int, int> nested(tx_queue, uavcan::PoolUsageTagServiceCalls);
+        ASSERT_TRUE(nested.insert(3, 4));
+        EXPECT_EQ(3, tracker->getNumUsedBlocks(uavcan::PoolUsageTagTxQueue));
+        EXPECT_EQ(0, tracker->getNumUsedBlocks(uavcan::PoolUsageTagServiceCalls));
+    }
+    EXPECT_EQ(0, tracker->getNumUsedBlocks(uavcan::PoolUsageTagOutgoingTransferRegistry));
+    EXPECT_EQ(1, tracker->getPeakNumUsedBlocks(uavcan::PoolUsageTagOutgoingTransferRegistry));
+    EXPECT_EQ(2, tracker->getNumUsedBlocks(uavcan::PoolUsageTagTxQueue));
+    EXPECT_EQ(3, tracker->getPeakNumUsedBlocks(uavcan::PoolUsageTagTxQueue));
+
+    tx_queue.deallocate(a);
+    const uavcan::PoolUsageTracker::Snapshot snapshot = tracker->getSnapshot();
+    EXPECT_EQ(1, snapshot.num_used_blocks[uavcan::PoolUsageTagTxQueue]);
+    EXPECT_EQ(3, snapshot.peak_num_used_blocks[uavcan::PoolUsageTagTxQueue]);
+    EXPECT_EQ(0, snapshot.num_used_blocks[uavcan::PoolUsageTagTransferBuffers]);
+
+    tracker->resetPeaks();
+    EXPECT_EQ(1, tracker->getPeakNumUsedBlocks(uavcan::PoolUsageTagTxQueue));
+    EXPECT_EQ(0, tracker->getPeakNumUsedBlocks(uavcan::PoolUsageTagOutgoingTransferRegistry));
+
+    tx_queue.deallocate(b);
+    pool.deallocate(untagged);
+    EXPECT_EQ(0, tracker->getNumUsedBlocks(uavcan::PoolUsageTagTxQueue));
+    EXPECT_EQ(0, pool.getNumUsedBlocks());
+
+    // Allocators that don't support tracking still work
+    uavcan::LimitedPoolAllocator limited(tx_queue, 2);
+    uavcan::TaggedPoolAllocator tagged(limited, uavcan::PoolUsageTagOther);
+    EXPECT_FALSE(tagged.getUsageTracker());
+    void* c = tagged.allocate(1);
+    ASSERT_TRUE(c);
+    tagged.deallocate(c);
+    EXPECT_EQ(0, tracker->getNumUsedBlocks(uavcan::PoolUsageTagOther));
+}
+
+#endif
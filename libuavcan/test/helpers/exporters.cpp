@@ -0,0 +1,237 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <gtest/gtest.h>
+#include <uavcan/helpers/exporters.hpp>
+#include <uavcan/marshal/types.hpp>
+
+
+namespace
+{
+
+typedef uavcan::IntegerSpec<1, uavcan::SignednessUnsigned, uavcan::CastModeSaturate> Bool;
+typedef uavcan::IntegerSpec<8, uavcan::SignednessUnsigned, uavcan::CastModeSaturate> UInt8;
+typedef uavcan::IntegerSpec<12, uavcan::SignednessSigned, uavcan::CastModeSaturate> Int12;
+typedef uavcan::IntegerSpec<64, uavcan::SignednessUnsigned, uavcan::CastModeTruncate> UInt64;
+typedef uavcan::FloatSpec<16, uavcan::CastModeSaturate> Float16;
+typedef uavcan::FloatSpec<32, uavcan::CastModeSaturate> Float32;
+typedef uavcan::FloatSpec<64, uavcan::CastModeSaturate> Float64;
+
+typedef uavcan::Array<UInt8, uavcan::ArrayModeDynamic, 20> String;
+typedef uavcan::Array<Float32, uavcan::ArrayModeStatic, 3> Vector3;
+
+/*
+ * Same as the code generated for the DSDL definition:
+ *      int12 x
+ *      bool flag
+ *      void3
+ *      uint8[<=20] name
+ */
+struct Sample
+{
+    typedef const Sample& ParameterType;
+
+    struct FieldTypes
+    {
+        typedef Int12 x;
+        typedef Bool flag;
+        typedef String name;
+    };
+
+    uavcan::StorageType<Int12>::Type x;
+    bool flag;
+    String name;
+
+    Sample() : x(0), flag(false) { }
+};
+
+template <typename T>
+std::string streamJson(const typename uavcan::StorageType<T>::Type& value)
+{
+    char buffer[200];
+    uavcan::BufferOStream s(buffer, sizeof(buffer));
+    uavcan::JsonStreamer<T>::stream(s, value);
+    EXPECT_FALSE(s.isTruncated());
+    return std::string(buffer);
+}
+
+}
+
+namespace uavcan
+{
+
+template <>
+class JsonStreamer<Sample>
+{
+public:
+    template <typename Stream>
+    static void stream(Stream& s, Sample::ParameterType obj)
+    {
+        (void)obj;
+        s << '{';
+        s << "\"x\":";
+        JsonStreamer<Sample::FieldTypes::x>::stream(s, obj.x);
+        s << ",\"flag\":";
+        JsonStreamer<Sample::FieldTypes::flag>::stream(s, obj.flag);
+        s << ",\"name\":";
+        JsonStreamer<Sample::FieldTypes::name>::stream(s, obj.name);
+        s << '}';
+    }
+};
+
+}
+
+
+TEST(Exporters, BufferOStream)
+{
+    char buffer[12];
+    uavcan::BufferOStream s(buffer, sizeof(buffer));
+    ASSERT_STREQ("", buffer);
+
+    s << "a" << 'b' << -1 << 34U << static_cast<short>(-5) << 0.5;
+    EXPECT_STREQ("ab-134-50.5", buffer);
+    EXPECT_EQ(11, s.getLength());
+    EXPECT_FALSE(s.isTruncated());
+
+    s << "xyz";                                         // Doesn't fit
+    EXPECT_STREQ("ab-134-50.5", buffer);
+    EXPECT_TRUE(s.isTruncated());
+
+    s.reset();
+    EXPECT_STREQ("", buffer);
+    EXPECT_FALSE(s.isTruncated());
+    s << static_cast<uavcan::uint64_t>(12345678901ULL) << 'z';
+    EXPECT_STREQ("12345678901", buffer);
+    EXPECT_TRUE(s.isTruncated());
+
+    uavcan::BufferOStream null_stream(NULL, 100);
+    null_stream << "abc";
+    EXPECT_EQ(0, null_stream.getLength());
+    EXPECT_TRUE(null_stream.isTruncated());
+}
+
+
+TEST(Exporters, JsonScalars)
+{
+    EXPECT_EQ("true", streamJson<Bool>(true));
+    EXPECT_EQ("false", streamJson<Bool>(false));
+    EXPECT_EQ("200", streamJson<UInt8>(200));            // Not a character
+    EXPECT_EQ("-2048", streamJson<Int12>(-2048));
+    EXPECT_EQ("18446744073709551615", streamJson<UInt64>(0xFFFFFFFFFFFFFFFFULL));
+
+    EXPECT_EQ("-2.5", streamJson<Float16>(-2.5F));
+    EXPECT_EQ("0.100000001", streamJson<Float32>(0.1F));               // 9 significant digits
+    EXPECT_EQ("0.10000000000000001", streamJson<Float64>(0.1));        // Same as printf("%.17g")
+    EXPECT_EQ(17, streamJson<Float64>(1.0 / 3.0).size() - 2);           // 17 significant digits
+    EXPECT_DOUBLE_EQ(1.0 / 3.0, std::strtod(streamJson<Float64>(1.0 / 3.0).c_str(), NULL));
+    EXPECT_EQ("1e+20", streamJson<Float64>(1e20));
+    EXPECT_EQ("null", streamJson<Float32>(std::numeric_limits<float>::infinity()));
+    EXPECT_EQ("null", streamJson<Float64>(-std::numeric_limits<double>::infinity()));
+    EXPECT_EQ("null", streamJson<Float64>(std::numeric_limits<double>::quiet_NaN()));
+}
+
+
+TEST(Exporters, JsonArrays)
+{
+    String str;
+    EXPECT_EQ("\"\"", streamJson<String>(str));
+    str = "a\"b\\c\n\t";
+    str.push_back(1);
+    str.push_back(0xFF);
+    EXPECT_EQ("\"a\\\"b\\\\c\\n\\t\\u0001\\u00ff\"", streamJson<String>(str));
+
+    Vector3 vec;
+    vec[0] = 1.0F;
+    vec[1] = -0.25F;
+    vec[2] = 1e30F;
+    EXPECT_EQ("[1,-0.25,1.00000002e+30]", streamJson<Vector3>(vec));
+
+    typedef uavcan::Array<Bool, uavcan::ArrayModeDynamic, 4> BoolArray;
+    BoolArray bools;
+    EXPECT_EQ("[]", streamJson<BoolArray>(bools));
+    bools.push_back(true);
+    bools.push_back(false);
+    EXPECT_EQ("[true,false]", streamJson<BoolArray>(bools));
+
+    typedef uavcan::Array<String, uavcan::ArrayModeDynamic, 3> StringArray;
+    StringArray strings;
+    strings.push_back(String());
+    strings.push_back("x");
+    EXPECT_EQ("[\"\",\"x\"]", streamJson<StringArray>(strings));
+}
+
+
+TEST(Exporters, ExportJson)
+{
+    Sample sample;
+    sample.x = -7;
+    sample.flag = true;
+    sample.name = "node";
+
+    char buffer[100];
+    const char* const expected = "{\"x\":-7,\"flag\":true,\"name\":\"node\"}";
+    ASSERT_EQ(int(std::strlen(expected)), uavcan::exportJson(sample, buffer, sizeof(buffer)));
+    EXPECT_STREQ(expected, buffer);
+
+    // Exactly fits
+    ASSERT_EQ(int(std::strlen(expected)), uavcan::exportJson(sample, buffer, unsigned(std::strlen(expected) + 1)));
+    EXPECT_STREQ(expected, buffer);
+
+    // Truncated
+    ASSERT_EQ(-uavcan::ErrMemory, uavcan::exportJson(sample, buffer, 10));
+    EXPECT_STREQ("{\"x\":-7,\"", buffer);
+}
+
+
+TEST(Exporters, ExportYaml)
+{
+    Vector3 vec;
+    vec[0] = 1.0F;
+    vec[1] = -0.25F;
+    vec[2] = 3.0F;
+
+    char buffer[100];
+    ASSERT_EQ(13, uavcan::exportYaml(vec, buffer, sizeof(buffer)));
+    EXPECT_STREQ("[1, -0.25, 3]", buffer);
+
+    String str = "abc";
+    ASSERT_EQ(5, uavcan::exportYaml(str, buffer, sizeof(buffer)));
+    EXPECT_STREQ("\"abc\"", buffer);
+
+    ASSERT_EQ(-uavcan::ErrMemory, uavcan::exportYaml(str, buffer, 3));
+    EXPECT_STREQ("\"a", buffer);
+}
+
+
+TEST(Exporters, ExportBinary)
+{
+    uavcan::uint8_t buffer[100];
+
+    // Tail array optimization - no length prefix
+    String str = "hello";
+    ASSERT_EQ(5, uavcan::exportBinary(str, buffer, sizeof(buffer)));
+    EXPECT_EQ(0, std::memcmp(buffer, "hello", 5));
+
+    Vector3 vec;
+    vec[0] = 1.0F;
+    vec[1] = -0.25F;
+    vec[2] = 1e30F;
+    ASSERT_EQ(12, uavcan::exportBinary(vec, buffer, sizeof(buffer)));
+
+    Vector3 restored;
+    uavcan::StaticTransferBufferImpl transfer_buffer(buffer, 12);
+    transfer_buffer.setMaxWritePos(12);
+    uavcan::BitStream bitstream(transfer_buffer);
+    uavcan::ScalarCodec codec(bitstream);
+    ASSERT_EQ(1, Vector3::decode(restored, codec, uavcan::TailArrayOptEnabled));
+    EXPECT_TRUE(restored.isClose(vec));
+
+    // Doesn't fit
+    ASSERT_EQ(-uavcan::ErrMemory, uavcan::exportBinary(vec, buffer, 11));
+    ASSERT_EQ(-uavcan::ErrInvalidParam, uavcan::exportBinary(vec, NULL, 100));
+}
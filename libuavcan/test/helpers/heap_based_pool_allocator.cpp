@@ -5,6 +5,10 @@
 #include <gtest/gtest.h>
 #include <uavcan/helpers/heap_based_pool_allocator.hpp>
 #include <malloc.h>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+#include <vector>
 
 
 TEST(HeapBasedPoolAllocator, Basic)
@@ -100,6 +104,169 @@ TEST(HeapBasedPoolAllocator, Limits)
     ASSERT_EQ(0, al.getNumAllocatedBlocks());
 }
 
+
+TEST(HeapBasedPoolAllocator, Chunks)
+{
+    typedef uavcan::HeapBasedPoolAllocator<uavcan::MemPoolBlockSize, char, 8> Allocator;
+    Allocator al(20, 20);
+
+    ASSERT_EQ(0, al.getNumChunks());
+
+    void* blocks[20];
+    for (unsigned i = 0; i < 20; i++)
+    {
+        blocks[i] = al.allocate(10);
+        ASSERT_TRUE(blocks[i]);
+        std::memset(blocks[i], int(i), uavcan::MemPoolBlockSize);
+    }
+    ASSERT_FALSE(al.allocate(10));
+
+    // 8 + 8 + 4, the last chunk is limited by the hard limit
+    ASSERT_EQ(3, al.getNumChunks());
+    ASSERT_EQ(20, al.getNumReservedBlocks());
+    ASSERT_EQ(20, al.getNumAllocatedBlocks());
+
+    // The blocks of a chunk are served in order, the chunks are aligned at the cache line boundary
+    for (unsigned i = 0; i < 20; i += 8)
+    {
+        ASSERT_EQ(0, reinterpret_cast<std::size_t>(blocks[i]) % uavcan::CacheLineSize);
+    }
+    const std::ptrdiff_t stride = static_cast<uint8_t*>(blocks[1]) - static_cast<uint8_t*>(blocks[0]);
+    ASSERT_LE(std::ptrdiff_t(uavcan::MemPoolBlockSize), stride);
+    for (unsigned i = 1; i < 8; i++)
+    {
+        ASSERT_EQ(static_cast<uint8_t*>(blocks[0]) + stride * std::ptrdiff_t(i), blocks[i]);
+    }
+    for (unsigned i = 0; i < 20; i++)
+    {
+        ASSERT_EQ(uint8_t(i), static_cast<uint8_t*>(blocks[i])[uavcan::MemPoolBlockSize - 1]);
+    }
+
+    // The second chunk is held by one block, the other two chunks are released
+    for (unsigned i = 0; i < 20; i++)
+    {
+        if (i != 9)
+        {
+            al.deallocate(blocks[i]);
+        }
+    }
+    ASSERT_EQ(20, al.getNumReservedBlocks());
+    ASSERT_EQ(1, al.getNumAllocatedBlocks());
+
+    al.shrink();
+    ASSERT_EQ(1, al.getNumChunks());
+    ASSERT_EQ(8, al.getNumReservedBlocks());
+    ASSERT_EQ(1, al.getNumAllocatedBlocks());
+
+    // The reserve is sorted by address; the remaining blocks of the second chunk are reused first
+    for (unsigned i = 8; i < 16; i++)
+    {
+        if (i != 9)
+        {
+            ASSERT_EQ(blocks[i], al.allocate(10));
+        }
+    }
+    ASSERT_EQ(1, al.getNumChunks());
+    ASSERT_EQ(8, al.getNumAllocatedBlocks());
+
+    for (unsigned i = 8; i < 16; i++)
+    {
+        al.deallocate(blocks[i]);
+    }
+    ASSERT_EQ(0, al.getNumAllocatedBlocks());
+
+    al.shrink();
+    ASSERT_EQ(0, al.getNumChunks());
+    ASSERT_EQ(0, al.getNumReservedBlocks());
+}
+
+
+TEST(HeapBasedPoolAllocator, ChunkHysteresis)
+{
+    uavcan::HeapBasedPoolAllocator<uavcan::MemPoolBlockSize, char, 4> al(100);
+
+    std::vector<void*> blocks;
+    for (unsigned i = 0; i < 16; i++)
+    {
+        blocks.push_back(al.allocate(1));
+    }
+    ASSERT_EQ(4, al.getNumChunks());
+
+    for (unsigned i = 0; i < blocks.size(); i++)
+    {
+        al.deallocate(blocks[i]);
+    }
+
+    al.shrink(2);
+    ASSERT_EQ(2, al.getNumChunks());
+    ASSERT_EQ(8, al.getNumReservedBlocks());
+
+    al.shrink(2);
+    ASSERT_EQ(2, al.getNumChunks());
+
+    // Spare chunks are counted among the entirely free chunks only
+    void* const a = al.allocate(1);
+    al.shrink(1);
+    ASSERT_EQ(2, al.getNumChunks());
+    ASSERT_EQ(8, al.getNumReservedBlocks());
+    al.shrink();
+    ASSERT_EQ(1, al.getNumChunks());
+    ASSERT_EQ(4, al.getNumReservedBlocks());
+
+    al.deallocate(a);
+    al.shrink();
+    ASSERT_EQ(0, al.getNumChunks());
+    ASSERT_EQ(0, al.getNumReservedBlocks());
+}
+
+
+TEST(HeapBasedPoolAllocator, ChunksRandomized)
+{
+    uavcan::HeapBasedPoolAllocator<uavcan::MemPoolBlockSize, char, 7> al(500, 500);
+
+    std::vector<std::pair<uint8_t*, uint8_t> > blocks;   // Every block is filled with its own tag
+    std::srand(42);
+
+    for (unsigned iter = 0; iter < 20000; iter++)
+    {
+        const int action = std::rand() % 100;
+        if ((action < 50) && (blocks.size() < 500))
+        {
+            uint8_t* const p = static_cast<uint8_t*>(al.allocate(uavcan::MemPoolBlockSize));
+            ASSERT_TRUE(p);
+            const uint8_t tag = uint8_t(iter);
+            std::memset(p, tag, uavcan::MemPoolBlockSize);
+            blocks.push_back(std::make_pair(p, tag));
+        }
+        else if ((action < 98) && !blocks.empty())
+        {
+            const std::size_t index = std::size_t(std::rand()) % blocks.size();
+            for (unsigned k = 0; k < uavcan::MemPoolBlockSize; k++)
+            {
+                ASSERT_EQ(blocks[index].second, blocks[index].first[k]);
+            }
+            al.deallocate(blocks[index].first);
+            blocks.erase(blocks.begin() + long(index));
+        }
+        else
+        {
+            al.shrink(uint16_t(std::rand() % 3));
+        }
+
+        ASSERT_EQ(blocks.size(), al.getNumAllocatedBlocks());
+        ASSERT_LE(al.getNumAllocatedBlocks(), al.getNumReservedBlocks());
+    }
+
+    for (unsigned i = 0; i < blocks.size(); i++)
+    {
+        al.deallocate(blocks[i].first);
+    }
+
+    al.shrink();
+    ASSERT_EQ(0, al.getNumChunks());
+    ASSERT_EQ(0, al.getNumReservedBlocks());
+}
+
 #if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
 
 #include <thread>
@@ -176,4 +343,63 @@ TEST(HeapBasedPoolAllocator, Concurrency)
     malloc_stats();
 }
 
+
+TEST(HeapBasedPoolAllocator, ConcurrencyChunks)
+{
+    uavcan::HeapBasedPoolAllocator<uavcan::MemPoolBlockSize, RaiiSynchronizer, 16> al(1000);
+
+    volatile bool terminate = false;
+
+    /*
+     * The last thread keeps shrinking the pool while the others are using it
+     */
+    std::thread threads[4];
+
+    for (unsigned i = 0; i < 3; i++)
+    {
+        threads[i] = std::thread([&al, &terminate, i]()
+        {
+            std::vector<void*> blocks;
+            while (!terminate)
+            {
+                for (unsigned k = 0; k < (i + 1) * 10; k++)
+                {
+                    blocks.push_back(al.allocate(1));
+                }
+                for (auto x : blocks)
+                {
+                    al.deallocate(x);
+                }
+                blocks.clear();
+            }
+        });
+    }
+
+    threads[3] = std::thread([&al, &terminate]()
+    {
+        while (!terminate)
+        {
+            al.shrink();
+            al.shrink(1);
+        }
+    });
+
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+
+    terminate = true;
+
+    for (auto& x : threads)
+    {
+        x.join();
+    }
+
+    ASSERT_EQ(0, al.getNumAllocatedBlocks());
+    std::cout << "Reserved:  " << al.getNumReservedBlocks() << std::endl;
+    std::cout << "Chunks:    " << al.getNumChunks() << std::endl;
+
+    al.shrink();
+    ASSERT_EQ(0, al.getNumReservedBlocks());
+    ASSERT_EQ(0, al.getNumChunks());
+}
+
 #endif
@@ -6,6 +6,9 @@
 # pragma GCC diagnostic ignored "-Wfloat-equal"
 #endif
 
+#include <cmath>
+#include <cstdlib>
+#include <limits>
 #include <gtest/gtest.h>
 #include <uavcan/marshal/types.hpp>
 #include <uavcan/transport/transfer_buffer.hpp>
@@ -659,6 +662,195 @@ TEST(Array, StaticEncodeDecodeErrors)
 }
 
 
+template <typename Spec>
+static float encodeDecodeElement(float value)
+{
+    uavcan::StaticTransferBuffer<2> buf;
+    uavcan::BitStream bs_wr(buf);
+    uavcan::ScalarCodec sc_wr(bs_wr);
+    EXPECT_EQ(1, Spec::encode(value, sc_wr, uavcan::TailArrayOptDisabled));
+    uavcan::BitStream bs_rd(buf);
+    uavcan::ScalarCodec sc_rd(bs_rd);
+    float out = 0;
+    EXPECT_EQ(1, Spec::decode(out, sc_rd, uavcan::TailArrayOptDisabled));
+    return out;
+}
+
+#define ASSERT_FLOAT16_EQ(expected, actual) \
+    ASSERT_EQ(bool(std::isnan(expected)), bool(std::isnan(actual))); \
+    if (!std::isnan(expected)) { ASSERT_FLOAT_EQ(expected, actual); }
+
+TEST(Array, Float16Bulk)
+{
+    typedef FloatSpec<16, CastModeSaturate> F16S;
+    typedef FloatSpec<16, CastModeTruncate> F16T;
+
+    // Special values, exact ties, and a remainder that doesn't fill a whole vector
+    static const float Values[] =
+    {
+        0.0F, -0.0F, 1.0F, -2.0F, 65504.0F, 65519.0F, 1e6F, -1e6F,
+        std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity(),
+        std::numeric_limits<float>::quiet_NaN(), -std::numeric_limits<float>::quiet_NaN(),
+        2.98023224e-8F, 1e-10F, 6.1035156e-5F, 3.14159265F, 1.00048828F, -1.00146484F, 1234.5F
+    };
+    static const unsigned NumValues = sizeof(Values) / sizeof(Values[0]);
+
+    // Bulk conversion matches the element-wise one
+    uavcan::uint16_t halfs[NumValues];
+    uavcan::IEEE754Converter::convertToHalf(Values, halfs, NumValues);
+    for (unsigned i = 0; i < NumValues; i++)
+    {
+        ASSERT_EQ(uavcan::IEEE754Converter::toIeee<16>(Values[i]), halfs[i]);
+    }
+    float floats[NumValues];
+    uavcan::IEEE754Converter::convertFromHalf(halfs, floats, NumValues);
+    for (unsigned i = 0; i < NumValues; i++)
+    {
+        ASSERT_FLOAT16_EQ(uavcan::IEEE754Converter::toNative<16>(halfs[i]), floats[i]);
+    }
+
+    // 36 elements - a covariance matrix
+    Array<F16S, ArrayModeStatic, 36> a;
+    for (uint8_t i = 0; i < a.size(); i++)
+    {
+        a[i] = Values[i % NumValues] * float(i + 1);
+    }
+    Array<F16T, ArrayModeDynamic, 40> b;
+    for (unsigned i = 0; i < 2 * NumValues; i++)
+    {
+        b.push_back(Values[(i * 7) % NumValues]);
+    }
+
+    // Same wire representation as the element-wise encoding
+    uavcan::StaticTransferBuffer<200> buf_bulk;
+    uavcan::BitStream bs_bulk(buf_bulk);
+    uavcan::ScalarCodec sc_bulk(bs_bulk);
+    ASSERT_EQ(1, (Array<F16S, ArrayModeStatic, 36>::encode(a, sc_bulk, uavcan::TailArrayOptDisabled)));
+    ASSERT_EQ(1, (Array<F16T, ArrayModeDynamic, 40>::encode(b, sc_bulk, uavcan::TailArrayOptDisabled)));
+
+    uavcan::StaticTransferBuffer<200> buf_ref;
+    uavcan::BitStream bs_ref(buf_ref);
+    uavcan::ScalarCodec sc_ref(bs_ref);
+    for (uint8_t i = 0; i < a.size(); i++)
+    {
+        ASSERT_EQ(1, F16S::encode(a[i], sc_ref, uavcan::TailArrayOptDisabled));
+    }
+    ASSERT_EQ(1, sc_ref.encode<6>(uavcan::uint8_t(b.size())));
+    for (uint8_t i = 0; i < b.size(); i++)
+    {
+        ASSERT_EQ(1, F16T::encode(b[i], sc_ref, uavcan::TailArrayOptDisabled));
+    }
+    ASSERT_EQ(bs_ref.toString(), bs_bulk.toString());
+
+    // Decoding
+    Array<F16S, ArrayModeStatic, 36> a2;
+    Array<F16T, ArrayModeDynamic, 40> b2;
+    uavcan::BitStream bs_rd(buf_bulk);
+    uavcan::ScalarCodec sc_rd(bs_rd);
+    ASSERT_EQ(1, (Array<F16S, ArrayModeStatic, 36>::decode(a2, sc_rd, uavcan::TailArrayOptDisabled)));
+    ASSERT_EQ(1, (Array<F16T, ArrayModeDynamic, 40>::decode(b2, sc_rd, uavcan::TailArrayOptDisabled)));
+    ASSERT_EQ(b.size(), b2.size());
+    for (uint8_t i = 0; i < a.size(); i++)
+    {
+        ASSERT_FLOAT16_EQ(encodeDecodeElement<F16S>(a[i]), a2[i]);
+    }
+    for (uint8_t i = 0; i < b.size(); i++)
+    {
+        ASSERT_FLOAT16_EQ(encodeDecodeElement<F16T>(b[i]), b2[i]);
+    }
+
+    // Not enough space - the elements that fit are still processed
+    uavcan::StaticTransferBuffer<35 * 2> buf_short;
+    uavcan::BitStream bs_short(buf_short);
+    uavcan::ScalarCodec sc_short(bs_short);
+    ASSERT_EQ(0, (Array<F16S, ArrayModeStatic, 36>::encode(a, sc_short, uavcan::TailArrayOptDisabled)));
+    uavcan::BitStream bs_short_rd(buf_short);
+    uavcan::ScalarCodec sc_short_rd(bs_short_rd);
+    ASSERT_EQ(0, (Array<F16S, ArrayModeStatic, 36>::decode(a2, sc_short_rd, uavcan::TailArrayOptDisabled)));
+    ASSERT_FLOAT16_EQ(encodeDecodeElement<F16S>(a[34]), a2[34]);
+}
+
+TEST(Array, ByteAlignedIntegerBulk)
+{
+    typedef IntegerSpec<8, SignednessUnsigned, CastModeSaturate> U8;
+    typedef IntegerSpec<16, SignednessSigned, CastModeTruncate> I16;
+    typedef IntegerSpec<64, SignednessUnsigned, CastModeSaturate> U64;
+    typedef Array<U8, ArrayModeDynamic, 200> U8Array;
+    typedef Array<I16, ArrayModeStatic, 11> I16Array;
+    typedef Array<U64, ArrayModeStatic, 3> U64Array;
+
+    U8Array a;
+    for (unsigned i = 0; i < a.capacity(); i++)
+    {
+        a.push_back(uavcan::uint8_t(i * 37U + 11U));
+    }
+    I16Array b;
+    for (uint8_t i = 0; i < b.size(); i++)
+    {
+        b[i] = uavcan::int16_t(int(i * 6007U) - 30000);
+    }
+    U64Array c;
+    for (uint8_t i = 0; i < c.size(); i++)
+    {
+        c[i] = 0x0123456789ABCDEFULL * (i + 3);
+    }
+
+    // Aligned and unaligned positions; the wire representation must match the element-wise encoding
+    for (unsigned prefix_len = 0; prefix_len < 8; prefix_len++)
+    {
+        uavcan::StaticTransferBuffer<260> buf_bulk;
+        uavcan::BitStream bs_bulk(buf_bulk);
+        uavcan::ScalarCodec sc_bulk(bs_bulk);
+        ASSERT_EQ(1, sc_bulk.encodeBlock(reinterpret_cast<const uavcan::uint8_t*>("\xA5"), prefix_len));
+        ASSERT_EQ(1, U8Array::encode(a, sc_bulk, uavcan::TailArrayOptDisabled));
+        ASSERT_EQ(1, I16Array::encode(b, sc_bulk, uavcan::TailArrayOptDisabled));
+        ASSERT_EQ(1, U64Array::encode(c, sc_bulk, uavcan::TailArrayOptDisabled));
+
+        uavcan::StaticTransferBuffer<260> buf_ref;
+        uavcan::BitStream bs_ref(buf_ref);
+        uavcan::ScalarCodec sc_ref(bs_ref);
+        ASSERT_EQ(1, sc_ref.encodeBlock(reinterpret_cast<const uavcan::uint8_t*>("\xA5"), prefix_len));
+        ASSERT_EQ(1, sc_ref.encode<8>(a.size()));
+        for (uint8_t i = 0; i < a.size(); i++)
+        {
+            ASSERT_EQ(1, sc_ref.encode<8>(a[i]));
+        }
+        for (uint8_t i = 0; i < b.size(); i++)
+        {
+            ASSERT_EQ(1, sc_ref.encode<16>(b[i]));
+        }
+        for (uint8_t i = 0; i < c.size(); i++)
+        {
+            ASSERT_EQ(1, sc_ref.encode<64>(c[i]));
+        }
+        ASSERT_EQ(bs_ref.toString(), bs_bulk.toString());
+
+        U8Array a2;
+        I16Array b2;
+        U64Array c2;
+        uavcan::BitStream bs_rd(buf_bulk);
+        uavcan::ScalarCodec sc_rd(bs_rd);
+        uavcan::uint8_t prefix = 0;
+        ASSERT_EQ(1, sc_rd.decodeBlock(&prefix, prefix_len));
+        ASSERT_EQ(1, U8Array::decode(a2, sc_rd, uavcan::TailArrayOptDisabled));
+        ASSERT_EQ(1, I16Array::decode(b2, sc_rd, uavcan::TailArrayOptDisabled));
+        ASSERT_EQ(1, U64Array::decode(c2, sc_rd, uavcan::TailArrayOptDisabled));
+        ASSERT_TRUE(a == a2);
+        ASSERT_TRUE(b == b2);
+        ASSERT_TRUE(c == c2);
+    }
+
+    // Not enough space
+    uavcan::StaticTransferBuffer<100> buf_short;
+    uavcan::BitStream bs_short(buf_short);
+    uavcan::ScalarCodec sc_short(bs_short);
+    ASSERT_EQ(0, U8Array::encode(a, sc_short, uavcan::TailArrayOptDisabled));
+    uavcan::BitStream bs_short_rd(buf_short);
+    uavcan::ScalarCodec sc_short_rd(bs_short_rd);
+    U8Array a2;
+    ASSERT_EQ(0, U8Array::decode(a2, sc_short_rd, uavcan::TailArrayOptDisabled));
+}
+
 TEST(Array, Copyability)
 {
     typedef Array<IntegerSpec<1, SignednessUnsigned, CastModeSaturate>, ArrayModeDynamic, 5>   OneBitArray;
@@ -1190,6 +1382,109 @@ TEST(Array, SquareMatrixPackingIntegers)
     }
 }
 
+template <unsigned NumElements>
+static uavcan::SquareMatrixPacking::PackingMode detectPackingModeStepByStep(const float* matrix)
+{
+    const uavcan::SquareMatrixAnalyzer<const float*, NumElements> analyzer(matrix);
+    if (analyzer.areAllElementsNan())
+    {
+        return uavcan::SquareMatrixPacking::PackingModeEmpty;
+    }
+    if (analyzer.isScalar())
+    {
+        return uavcan::SquareMatrixPacking::PackingModeScalar;
+    }
+    if (analyzer.isDiagonal())
+    {
+        return uavcan::SquareMatrixPacking::PackingModeDiagonal;
+    }
+    if (analyzer.isSymmetric())
+    {
+        return uavcan::SquareMatrixPacking::PackingModeSymmetric;
+    }
+    return uavcan::SquareMatrixPacking::PackingModeFull;
+}
+
+TEST(Array, SquareMatrixPackingModes)
+{
+    typedef uavcan::SquareMatrixPacking P;
+    Array<FloatSpec<32, CastModeSaturate>, ArrayModeDynamic, 36> m6x6f;
+
+    // Detected mode is reported, so that it can be reused
+    float covariance[36] = { 0 };
+    for (unsigned i = 0; i < 6; i++)
+    {
+        covariance[i * 7] = float(i + 1);
+    }
+    ASSERT_EQ(P::PackingModeDiagonal, m6x6f.packSquareMatrix(covariance));
+    ASSERT_EQ(6, m6x6f.size());
+
+    std::vector<float> nans(36, std::numeric_limits<float>::quiet_NaN());
+    ASSERT_EQ(P::PackingModeEmpty, m6x6f.packSquareMatrix(nans));
+    ASSERT_EQ(0, m6x6f.size());
+
+    // Explicit mode - no analysis, the elements that are not represented are dropped
+    covariance[1] = 0.5F;
+    m6x6f.packSquareMatrix(covariance, P::PackingModeDiagonal);
+    ASSERT_EQ(6, m6x6f.size());
+    for (uint8_t i = 0; i < 6; i++)
+    {
+        ASSERT_FLOAT_EQ(float(i + 1), m6x6f[i]);
+    }
+    m6x6f.packSquareMatrix(covariance, P::PackingModeScalar);
+    ASSERT_EQ(1, m6x6f.size());
+    ASSERT_FLOAT_EQ(1, m6x6f[0]);
+    m6x6f.packSquareMatrix(covariance, P::PackingModeSymmetric);
+    ASSERT_EQ(21, m6x6f.size());
+    ASSERT_FLOAT_EQ(0.5F, m6x6f[1]);
+    m6x6f.packSquareMatrix(std::vector<float>(covariance, covariance + 36), P::PackingModeFull);
+    ASSERT_EQ(36, m6x6f.size());
+    m6x6f.packSquareMatrix(covariance, P::PackingModeEmpty);
+    ASSERT_EQ(0, m6x6f.size());
+    ASSERT_EQ(P::PackingModeFull, m6x6f.packSquareMatrix(covariance));
+
+    // Single pass detection agrees with the step by step one
+    std::srand(42);
+    for (unsigned iteration = 0; iteration < 10000; iteration++)
+    {
+        float matrix[81];
+        const float diagonal_value = float(std::rand() % 3);
+        for (unsigned row = 0; row < 9; row++)
+        {
+            for (unsigned col = 0; col <= row; col++)
+            {
+                // Mostly zeroes and repeated values, so that every mode is hit
+                const int choice = std::rand() % 16;
+                float value = (row == col) ? diagonal_value : 0.0F;
+                if (choice == 0)
+                {
+                    value = std::numeric_limits<float>::quiet_NaN();
+                }
+                else if (choice == 1)
+                {
+                    value = float(std::rand() % 3);
+                }
+                matrix[row * 9 + col] = value;
+                matrix[col * 9 + row] = value;
+                if ((row != col) && (std::rand() % 64 == 0))
+                {
+                    matrix[col * 9 + row] = value + 1.0F;
+                }
+            }
+        }
+        if (std::rand() % 8 == 0)
+        {
+            std::fill(matrix, matrix + 81, std::numeric_limits<float>::quiet_NaN());
+        }
+        const uavcan::SquareMatrixAnalyzer<const float*, 81> a9(matrix);
+        ASSERT_EQ(detectPackingModeStepByStep<81>(matrix), a9.detectOptimalPackingMode());
+        const uavcan::SquareMatrixAnalyzer<const float*, 36> a6(matrix);
+        ASSERT_EQ(detectPackingModeStepByStep<36>(matrix), a6.detectOptimalPackingMode());
+        const uavcan::SquareMatrixAnalyzer<const float*, 9> a3(matrix);
+        ASSERT_EQ(detectPackingModeStepByStep<9>(matrix), a3.detectOptimalPackingMode());
+    }
+}
+
 #if UAVCAN_EXCEPTIONS
 TEST(Array, SquareMatrixPackingErrors)
 {
@@ -1416,3 +1711,129 @@ TEST(Array, CaseConversion)
     str.convertToUpperCaseASCII();
     ASSERT_STREQ("HELLO WORLD!", str.c_str());
 }
+
+TEST(Array, Pooled)
+{
+    typedef Array<IntegerSpec<8, SignednessUnsigned, CastModeSaturate>, uavcan::ArrayModeDynamicPooled, 200> String;
+    typedef Array<IntegerSpec<8, SignednessUnsigned, CastModeSaturate>, ArrayModeDynamic, 200> InlineString;
+    typedef Array<String, uavcan::ArrayModeDynamicPooled, 4> Strings;
+    typedef Array<IntegerSpec<1, SignednessUnsigned, CastModeSaturate>, uavcan::ArrayModeDynamicPooled, 9> Bits;
+
+    ASSERT_GT(sizeof(InlineString), sizeof(String) * 4);
+
+    /*
+     * No allocator - nothing can be stored
+     */
+    ASSERT_FALSE(uavcan::PooledArrayAllocator::getAllocator());
+    {
+        String str;
+        str = "abc";
+        ASSERT_EQ(0, str.size());
+        ASSERT_STREQ("", str.c_str());
+        ASSERT_FALSE(str.reserve(1));
+        ASSERT_TRUE(str.begin() == str.end());
+    }
+
+    uavcan::MultiPoolAllocator<0, 8, 8, 4, 2> pool;
+    uavcan::PooledArrayAllocator::setAllocator(&pool);
+    {
+        /*
+         * The storage grows with the array
+         */
+        String str;
+        ASSERT_EQ(0, str.getNumAllocated());
+        ASSERT_EQ(200, str.capacity());
+        ASSERT_EQ(0, pool.getNumUsedBlocks());
+
+        str = "Hello";
+        ASSERT_STREQ("Hello", str.c_str());
+        ASSERT_EQ(8, str.getNumAllocated());
+        ASSERT_EQ(1, pool.getNumUsedBlocks());
+
+        str += " World! The storage is reallocated as the string grows";
+        ASSERT_STREQ("Hello World! The storage is reallocated as the string grows", str.c_str());
+        ASSERT_EQ(64, str.getNumAllocated());
+        ASSERT_EQ(1, pool.getNumUsedBlocks());
+
+        str.clear();
+        ASSERT_EQ(64, str.getNumAllocated());       // Kept until destruction
+
+        str.appendFormatted("%d", 42);
+        ASSERT_STREQ("42", str.c_str());
+        ASSERT_EQ(200, str.getNumAllocated());
+
+        /*
+         * Copying, comparison with the inline arrays
+         */
+        const String str2 = str;
+        ASSERT_TRUE(str2 == str);
+        ASSERT_EQ(2, pool.getNumUsedBlocks());
+
+        InlineString inl;
+        inl = "42";
+        ASSERT_TRUE(str == inl);
+        ASSERT_TRUE(inl == str);
+
+        Strings strings;
+        strings.push_back(str);
+        strings.push_back(str2);
+        strings[1] += "?";
+        ASSERT_STREQ("42", strings[0].c_str());
+        ASSERT_STREQ("42?", strings[1].c_str());
+
+        Strings strings2;
+        strings2 = strings;
+        ASSERT_TRUE(strings2 == strings);
+
+        Bits bits;
+        bits.push_back(true);
+        ASSERT_TRUE(bits[0]);
+    }
+    ASSERT_EQ(0, pool.getNumUsedBlocks());
+
+    /*
+     * Encoding and decoding, same data layout as with the inline arrays
+     */
+    {
+        typedef CustomType2<Array<String, uavcan::ArrayModeDynamicPooled, 4> > A;
+        typedef CustomType2<Array<InlineString, ArrayModeDynamic, 4> > B;
+        A a;
+        a.b.resize(2);
+        a.b[0] = "123";
+        a.b[1] = "456789";
+
+        uavcan::StaticTransferBuffer<32> buf;
+        uavcan::BitStream bs_wr(buf);
+        uavcan::ScalarCodec sc_wr(bs_wr);
+        ASSERT_EQ(1, A::encode(a, sc_wr, uavcan::TailArrayOptEnabled));
+
+        {
+            uavcan::BitStream bs_rd(buf);
+            uavcan::ScalarCodec sc_rd(bs_rd);
+            B b;
+            ASSERT_EQ(1, B::decode(b, sc_rd, uavcan::TailArrayOptEnabled));
+            ASSERT_STREQ("123", b.b[0].c_str());
+            ASSERT_STREQ("456789", b.b[1].c_str());
+        }
+        {
+            uavcan::BitStream bs_rd(buf);
+            uavcan::ScalarCodec sc_rd(bs_rd);
+            A a2;
+            ASSERT_EQ(1, A::decode(a2, sc_rd, uavcan::TailArrayOptEnabled));
+            ASSERT_TRUE(a2 == a);
+        }
+
+        // Out of memory
+        uavcan::PooledArrayAllocator::setAllocator(NULL);
+        {
+            uavcan::BitStream bs_rd(buf);
+            uavcan::ScalarCodec sc_rd(bs_rd);
+            A a2;
+            ASSERT_EQ(-uavcan::ErrMemory, A::decode(a2, sc_rd, uavcan::TailArrayOptEnabled));
+        }
+        uavcan::PooledArrayAllocator::setAllocator(&pool);
+    }
+    ASSERT_EQ(0, pool.getNumUsedBlocks());
+
+    uavcan::PooledArrayAllocator::setAllocator(NULL);
+}
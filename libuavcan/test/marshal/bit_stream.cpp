@@ -2,6 +2,9 @@
  * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
  */
 
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
 #include <gtest/gtest.h>
 #include <uavcan/marshal/bit_stream.hpp>
 #include <uavcan/transport/transfer_buffer.hpp>
@@ -192,3 +195,136 @@ TEST(BitStream, BitByBit)
     ASSERT_EQ(0, bs_wr.read(dummy_data_rd, 1));
     ASSERT_EQ(0xFF, dummy_data_rd[0]);
 }
+
+
+TEST(BitStream, RandomFieldsAgainstBitarrayCopy)
+{
+    /*
+     * Fields of random lengths, including byte aligned ones and the ones that don't fit the accumulator,
+     * are compared against the plain bit-by-bit reference.
+     */
+    static const unsigned BufSize = 512;
+    uavcan::StaticTransferBuffer<BufSize> buf;
+    uint8_t reference[BufSize] = { 0 };
+
+    std::srand(42);
+
+    std::vector<std::vector<uint8_t> > fields;
+    std::vector<unsigned> lengths;
+
+    uavcan::BitStream bs_wr(buf);
+    unsigned bit_offset = 0;
+    while (true)
+    {
+        const unsigned bitlen = (std::rand() % 3 == 0) ?
+                                (8U * (1U + unsigned(std::rand()) % 8U)) :
+                                (1U + unsigned(std::rand()) % (uavcan::BitStream::MaxBitsPerRW - 8U));
+        if ((bit_offset + bitlen) > (BufSize * 8))
+        {
+            break;
+        }
+
+        std::vector<uint8_t> data((bitlen + 7) / 8);
+        for (unsigned i = 0; i < data.size(); i++)
+        {
+            data[i] = uint8_t(std::rand());
+        }
+
+        ASSERT_EQ(1, bs_wr.write(&data[0], bitlen));
+        uavcan::bitarrayCopy(&data[0], 0, bitlen, reference + bit_offset / 8, bit_offset % 8);
+
+        fields.push_back(data);
+        lengths.push_back(bitlen);
+        bit_offset += bitlen;
+    }
+
+    uint8_t written[BufSize] = { 0 };
+    ASSERT_EQ(int((bit_offset + 7) / 8), buf.read(0, written, BufSize));
+    ASSERT_TRUE(std::equal(reference, reference + (bit_offset + 7) / 8, written));
+
+    uavcan::BitStream bs_rd(buf);
+    for (unsigned i = 0; i < fields.size(); i++)
+    {
+        uint8_t data[uavcan::BitStream::MaxBitsPerRW / 8];
+        ASSERT_EQ(1, bs_rd.read(data, lengths[i]));
+
+        // Unused bits of the last byte must be zeroed
+        std::vector<uint8_t> expected = fields[i];
+        if ((lengths[i] % 8) != 0)
+        {
+            expected.back() = uint8_t(expected.back() & uint8_t(0xFF00U >> (lengths[i] % 8)));
+        }
+        ASSERT_TRUE(std::equal(expected.begin(), expected.end(), data)) << "field " << i;
+    }
+}
+
+
+namespace
+{
+/**
+ * Hides the contiguous storage of the underlying buffer, so that every BitStream read goes through read()
+ */
+class ChainedTransferBufferEmulator : public uavcan::ITransferBuffer
+{
+    uavcan::ITransferBuffer& target_;
+
+public:
+    mutable unsigned num_reads;
+
+    explicit ChainedTransferBufferEmulator(uavcan::ITransferBuffer& target)
+        : target_(target)
+        , num_reads(0)
+    { }
+
+    virtual int read(unsigned offset, uint8_t* data, unsigned len) const
+    {
+        num_reads++;
+        return target_.read(offset, data, len);
+    }
+
+    virtual int write(unsigned offset, const uint8_t* data, unsigned len)
+    {
+        return target_.write(offset, data, len);
+    }
+};
+}
+
+TEST(BitStream, ContiguousDataAgainstRead)
+{
+    static const unsigned BufSize = 100;
+    uavcan::StaticTransferBuffer<BufSize> buf;
+    ChainedTransferBufferEmulator chained(buf);
+
+    std::srand(42);
+    for (unsigned i = 0; i < BufSize; i++)
+    {
+        const uint8_t byte = uint8_t(std::rand());
+        ASSERT_EQ(1, buf.write(i, &byte, 1));
+    }
+
+    unsigned len = 0;
+    ASSERT_TRUE(buf.getContiguousData(len));
+    ASSERT_EQ(BufSize, len);
+    ASSERT_FALSE(chained.getContiguousData(len));
+
+    uavcan::BitStream bs_direct(buf);
+    uavcan::BitStream bs_chained(chained);
+    while (true)
+    {
+        const unsigned bitlen = (std::rand() % 3 == 0) ?
+                                (8U * (1U + unsigned(std::rand()) % 8U)) :
+                                (1U + unsigned(std::rand()) % (uavcan::BitStream::MaxBitsPerRW - 8U));
+        uint8_t data_direct[uavcan::BitStream::MaxBitsPerRW / 8] = { 0 };
+        uint8_t data_chained[uavcan::BitStream::MaxBitsPerRW / 8] = { 0 };
+
+        const int res = bs_chained.read(data_chained, bitlen);
+        ASSERT_EQ(res, bs_direct.read(data_direct, bitlen));
+        if (res == 0)
+        {
+            break;      // Out of buffer space - both streams must detect it at the same point
+        }
+        ASSERT_EQ(1, res);
+        ASSERT_TRUE(std::equal(data_direct, data_direct + sizeof(data_direct), data_chained));
+    }
+    ASSERT_LT(0, chained.num_reads);
+}
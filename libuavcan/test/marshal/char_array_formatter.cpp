@@ -4,6 +4,10 @@
 
 #include <gtest/gtest.h>
 #include <uavcan/marshal/char_array_formatter.hpp>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
 
 using uavcan::Array;
 using uavcan::ArrayModeDynamic;
@@ -77,4 +81,100 @@ TEST(CharArrayFormatter, Hardcore)
     ASSERT_STREQ("%%Test% 1 %* %% %*", f.getArray().c_str());
 }
 
+TEST(CharArrayFormatter, Specifications)
+{
+    typedef Array<IntegerSpec<8, SignednessUnsigned, CastModeSaturate>, ArrayModeDynamic, 100> A8;
+    A8 a;
+    CharArrayFormatter<A8> f(a);
+
+    /*
+     * The results must match the C library
+     */
+    const char* const IntFormats[] = { "%d", "%5i", "%-5d|", "%05d", "%+d", "% d", "%.3d", "%8.3d", "%x", "%#X",
+                                       "%08x", "%o", "%#o", "%u", "%.0d" };
+    const int IntValues[] = { 0, 1, -1, 42, -42, 123456789, -2147483647 - 1, 0x7FFFFFFF };
+
+    for (unsigned i = 0; i < sizeof(IntFormats) / sizeof(IntFormats[0]); i++)
+    {
+        for (unsigned k = 0; k < sizeof(IntValues) / sizeof(IntValues[0]); k++)
+        {
+            a.clear();
+            f.write(IntFormats[i], IntValues[k]);
+            char reference[100];
+            (void)std::snprintf(reference, sizeof(reference), IntFormats[i], IntValues[k]);
+            ASSERT_STREQ(reference, a.c_str()) << IntFormats[i] << " " << IntValues[k];
+        }
+    }
+
+    const char* const FloatFormats[] = { "%g", "%f", "%e", "%.3f", "%.0f", "%#.0f", "%10.2f", "%-10.2f|", "%+.2e",
+                                         "%012.4f", "%.10g", "%G", "%.3E", "%.1g", "%#g", "% f", "%.15g", "%.2f",
+                                         "%.5g", "%.4e", "%.17g", "%.16e", "%.17f" };
+    const double FloatValues[] = { 0.0, 1.0, -1.0, 0.5, 1.5, 2.5, 0.1, -12.3456, 3.14159265358979, 1e-9, 123456.0,
+                                   1234567.0, 9.9999999, 0.0001, 0.00001234, 1e16, 6.02214076e23, -1.6e-19,
+                                   1.7976931348623157e308, 4.9e-324, 99.995, 1.595, 344.745, 165.535, 0.125,
+                                   2.675, 1e23, 9.5, 0.95, 123456789012345678.0, 2.2250738585072014e-308 };
+
+    for (unsigned i = 0; i < sizeof(FloatFormats) / sizeof(FloatFormats[0]); i++)
+    {
+        for (unsigned k = 0; k < sizeof(FloatValues) / sizeof(FloatValues[0]); k++)
+        {
+            const bool fixed_point = std::strchr(FloatFormats[i], 'f') != NULL;
+            if (fixed_point && (std::fabs(FloatValues[k]) >= 1e17))
+            {
+                continue;       // Fixed point notation of the huge values is not supported
+            }
+            char reference[100];
+            (void)std::snprintf(reference, sizeof(reference), FloatFormats[i], FloatValues[k]);
+            a.clear();
+            f.write(FloatFormats[i], FloatValues[k]);
+            ASSERT_STREQ(reference, a.c_str()) << FloatFormats[i] << " " << FloatValues[k];
+        }
+    }
+
+    /*
+     * The rounding is based on the exact binary value, e.g. 1.595 is stored as 1.59499999999999997513...
+     */
+    a.clear();
+    f.write("%.2f %.5g %.4e %.2f %.0f %.0f", 1.595, 344.745, 165.535, 0.125, 0.5, 1.5);
+    ASSERT_STREQ("1.59 344.75 1.6553e+02 0.12 0 2", a.c_str());
+
+    /*
+     * Special values
+     */
+    a.clear();
+    f.write("%f %5.1f %E", std::numeric_limits<double>::quiet_NaN(), -std::numeric_limits<double>::infinity(),
+            std::numeric_limits<float>::infinity());
+    ASSERT_STREQ("nan  -inf INF", a.c_str());
+
+    /*
+     * Strings, characters, pointers, types that don't match the conversion
+     */
+    a.clear();
+    f.write("[%5s] [%-5s] [%.2s] [%s]", "ab", "ab", "abcdef", static_cast<const char*>(NULL));
+    ASSERT_STREQ("[   ab] [ab   ] [ab] [(null)]", a.c_str());
+
+    a.clear();
+    f.write("%c%c %s %d %p", 'a', 98, 12, 1.5, reinterpret_cast<const void*>(0x1234));
+    ASSERT_STREQ("ab 12 1.5 0x1234", a.c_str());
+
+    a.clear();
+    f.write("%ld %llu %hhi", 5L, 6ULL, 7);
+    ASSERT_STREQ("5 6 7", a.c_str());
+
+    a.clear();
+    f.write("%x %u %i", static_cast<short>(-1), static_cast<signed char>(-2), static_cast<unsigned char>(200));
+    ASSERT_STREQ("ffff 254 200", a.c_str());
+
+    /*
+     * Truncation, malformed specifications
+     */
+    a.clear();
+    f.write("%99d", 1);
+    ASSERT_EQ(40, a.size());
+
+    a.clear();
+    f.write("abc%", 1);
+    ASSERT_STREQ("abc1", a.c_str());
+}
+
 #endif
@@ -3,6 +3,7 @@
  */
 
 #include <gtest/gtest.h>
+#include <cmath>
 #include <limits>
 #include <uavcan/marshal/types.hpp>
 #include <uavcan/transport/transfer_buffer.hpp>
@@ -182,3 +183,56 @@ TEST(FloatSpec, Float16Representation)
 
     ASSERT_EQ(Reference, bs_wr.toString());
 }
+
+TEST(FloatSpec, Float16TiesToEven)
+{
+    using uavcan::IEEE754Converter;
+
+    /*
+     * Exact ties must be rounded to even regardless of UAVCAN_USE_HARDWARE_FLOAT16_CONVERSION
+     */
+    static const float Values[] =
+    {
+        1.0F + std::ldexp(1.0F, -11),                   // Normal, rounds down to even
+        1.0F + 3.0F * std::ldexp(1.0F, -11),            // Normal, rounds up to even
+        2047.5F,                                        // Rounds up to the next exponent
+        65519.0F,                                       // Below the overflow threshold, rounds to max
+        65520.0F,                                       // Overflow threshold, rounds to inf
+        std::ldexp(1.0F, -25),                          // Half of the smallest denormal, rounds to zero
+        3.0F * std::ldexp(1.0F, -25),                   // Denormal, rounds up to even
+        std::ldexp(1.0F, -14) - std::ldexp(1.0F, -25)   // Largest denormal tie, rounds to the smallest normal
+    };
+    static const uint16_t Reference[] =
+    {
+        0x3C00,
+        0x3C02,
+        0x6800,
+        0x7BFF,
+        0x7C00,
+        0x0000,
+        0x0002,
+        0x0400
+    };
+    static const unsigned NumValues = unsigned(sizeof(Values) / sizeof(Values[0]));
+
+    float negated[NumValues];
+    for (unsigned i = 0; i < NumValues; i++)
+    {
+        ASSERT_EQ(Reference[i], IEEE754Converter::toIeee<16>(Values[i])) << i;
+        ASSERT_EQ(unsigned(Reference[i] | 0x8000U), IEEE754Converter::toIeee<16>(-Values[i])) << i;
+        negated[i] = -Values[i];
+    }
+
+    // The bulk conversion must agree as well
+    uint16_t halfs[NumValues];
+    IEEE754Converter::convertToHalf(Values, halfs, NumValues);
+    for (unsigned i = 0; i < NumValues; i++)
+    {
+        ASSERT_EQ(Reference[i], halfs[i]) << i;
+    }
+    IEEE754Converter::convertToHalf(negated, halfs, NumValues);
+    for (unsigned i = 0; i < NumValues; i++)
+    {
+        ASSERT_EQ(unsigned(Reference[i] | 0x8000U), halfs[i]) << i;
+    }
+}
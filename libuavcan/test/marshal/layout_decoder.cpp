@@ -0,0 +1,604 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <sstream>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include <uavcan/marshal/layout_decoder.hpp>
+#include <uavcan/marshal/types.hpp>
+#include <uavcan/transport/transfer_buffer.hpp>
+
+
+namespace
+{
+/*
+ * Bytecode builder, produces the same output as the DSDL compiler
+ */
+typedef std::vector<uavcan::uint8_t> Bytes;
+
+Bytes& operator<<(Bytes& bytes, const Bytes& other)
+{
+    bytes.insert(bytes.end(), other.begin(), other.end());
+    return bytes;
+}
+
+Bytes& operator<<(Bytes& bytes, unsigned byte)
+{
+    bytes.push_back(uavcan::uint8_t(byte));
+    return bytes;
+}
+
+Bytes u16(unsigned value)
+{
+    Bytes b;
+    return b << (value & 0xFFU) << (value >> 8);
+}
+
+unsigned bitLength(unsigned value)
+{
+    unsigned bitlen = 0;
+    for (; value > 0; value >>= 1)
+    {
+        bitlen++;
+    }
+    return bitlen;
+}
+
+Bytes scalar(uavcan::LayoutOpcode opcode, unsigned bitlen)
+{
+    Bytes b;
+    return b << unsigned(opcode) << bitlen;
+}
+
+Bytes boolean()
+{
+    Bytes b;
+    return b << unsigned(uavcan::LayoutOpBool);
+}
+
+Bytes staticArray(unsigned size, const Bytes& element)
+{
+    Bytes b;
+    return b << unsigned(uavcan::LayoutOpStaticArray) << u16(size) << element;
+}
+
+Bytes dynamicArray(unsigned max_size, bool tail_optimizable, const Bytes& element)
+{
+    Bytes b;
+    return b << unsigned(uavcan::LayoutOpDynamicArray) << u16(max_size) << bitLength(max_size)
+             << (tail_optimizable ? unsigned(uavcan::LayoutArrayFlagTailOptimizable) : 0U) << element;
+}
+
+class Struct
+{
+    Bytes fields_;
+    unsigned num_fields_;
+
+public:
+    Struct() : num_fields_(0) { }
+
+    Struct& field(const std::string& name, const Bytes& value)
+    {
+        fields_ << unsigned(name.length());
+        fields_.insert(fields_.end(), name.begin(), name.end());
+        fields_ << 0U << value;
+        num_fields_++;
+        return *this;
+    }
+
+    Bytes build(bool is_union = false) const
+    {
+        Bytes b;
+        if (is_union)
+        {
+            b << unsigned(uavcan::LayoutOpUnion) << num_fields_ << bitLength(num_fields_);
+        }
+        else
+        {
+            b << unsigned(uavcan::LayoutOpStruct) << num_fields_;
+        }
+        return b << fields_;
+    }
+};
+
+class Database
+{
+    Bytes index_;
+    Bytes records_;
+    unsigned num_types_;
+
+public:
+    Database() : num_types_(0) { }
+
+    void add(uavcan::DataTypeKind kind, unsigned dtid, uavcan::uint64_t signature, const std::string& name,
+             const Bytes& code, const Bytes& response_code = Bytes())
+    {
+        index_ << u16(dtid) << unsigned(kind) << 0U << u16(unsigned(records_.size())) << u16(0);
+        for (unsigned i = 0; i < 8; i++)
+        {
+            records_ << unsigned((signature >> (i * 8)) & 0xFFU);
+        }
+        records_ << unsigned(name.length());
+        records_.insert(records_.end(), name.begin(), name.end());
+        records_ << 0U << u16(unsigned(code.size())) << code;
+        if (kind == uavcan::DataTypeKindService)
+        {
+            records_ << u16(unsigned(response_code.size())) << response_code;
+        }
+        num_types_++;
+    }
+
+    Bytes build() const
+    {
+        Bytes b;
+        b << 'U' << 'L' << 'D' << 'B' << unsigned(uavcan::DataTypeLayoutDatabase::FormatVersion) << 0U
+          << u16(num_types_);
+        // Record offsets are relative to the start of the database
+        Bytes index = index_;
+        const unsigned records_offset = 8U + unsigned(index_.size());
+        for (unsigned i = 0; i < num_types_; i++)
+        {
+            uavcan::uint8_t* const offset = &index[i * 8U + 4U];
+            const unsigned value = unsigned(offset[0] | (offset[1] << 8)) + records_offset;
+            offset[0] = uavcan::uint8_t(value & 0xFFU);
+            offset[1] = uavcan::uint8_t(value >> 8);
+        }
+        return b << index << records_;
+    }
+};
+
+/*
+ * Layouts of the test data types
+ */
+Bytes layoutB()
+{
+    return Struct()
+        .field("vector", staticArray(2, scalar(uavcan::LayoutOpFloat, 64)))
+        .field("bools", staticArray(16, boolean()))
+        .build();
+}
+
+Bytes layoutA()
+{
+    return Struct()
+        .field("scalar", scalar(uavcan::LayoutOpFloat, 32))
+        .field("vector", staticArray(2, layoutB()))
+        .build();
+}
+
+Bytes layoutDeep()
+{
+    return Struct()
+        .field("c", boolean())
+        .field("str", dynamicArray(19, true, scalar(uavcan::LayoutOpUnsigned, 8)))
+        .field("a", dynamicArray(1, true, layoutA()))
+        .field("b", staticArray(2, layoutB()))
+        .build();
+}
+
+Bytes layoutUnionTest()
+{
+    return Struct()
+        .field("z", Struct().build())
+        .field("a", scalar(uavcan::LayoutOpUnsigned, 5))
+        .field("b", scalar(uavcan::LayoutOpUnsigned, 5))
+        .field("c", scalar(uavcan::LayoutOpUnsigned, 13))
+        .field("d", dynamicArray(9, false, boolean()))
+        .field("e", Struct()
+                    .field("", scalar(uavcan::LayoutOpVoid, 2))
+                    .field("array", staticArray(4, scalar(uavcan::LayoutOpUnsigned, 2)))
+                    .field("", scalar(uavcan::LayoutOpVoid, 3))
+                    .build())
+        .build(true);
+}
+
+Bytes layoutShadeOfBlue()
+{
+    const Bytes nested = Struct()
+        .field("field", scalar(uavcan::LayoutOpSigned, 2))
+        .field("empty", Struct().build())
+        .build();
+    return Struct()
+        .field("array_f16", dynamicArray(31, true, scalar(uavcan::LayoutOpFloat, 16)))
+        .field("nested_message", staticArray(3, nested))
+        .build();
+}
+
+Bytes layoutMavlinkMessage()
+{
+    return Struct()
+        .field("seq", scalar(uavcan::LayoutOpUnsigned, 8))
+        .field("sysid", scalar(uavcan::LayoutOpUnsigned, 8))
+        .field("compid", scalar(uavcan::LayoutOpUnsigned, 8))
+        .field("msgid", scalar(uavcan::LayoutOpUnsigned, 8))
+        .field("payload", dynamicArray(255, true, scalar(uavcan::LayoutOpUnsigned, 8)))
+        .build();
+}
+
+Bytes layoutStringService(const std::string& field_name)
+{
+    return Struct().field(field_name, dynamicArray(64, true, scalar(uavcan::LayoutOpUnsigned, 8))).build();
+}
+
+Bytes makeDatabase()
+{
+    Database db;
+    db.add(uavcan::DataTypeKindService, 99, 0x1111, "root_ns_a.StringService",
+           layoutStringService("string_request"), layoutStringService("string_response"));
+    db.add(uavcan::DataTypeKindService, 0xFFFF, 0x2222, "root_ns_b.ServiceWithEmptyRequest", Struct().build(),
+           Struct().field("covariance", dynamicArray(9, true, scalar(uavcan::LayoutOpFloat, 16))).build());
+    db.add(uavcan::DataTypeKindMessage, 20000, 0x123456789ABCDEF0ULL, "root_ns_a.MavlinkMessage",
+           layoutMavlinkMessage());
+    db.add(uavcan::DataTypeKindMessage, 0xFFFF, 0x3333, "root_ns_a.Deep", layoutDeep());
+    db.add(uavcan::DataTypeKindMessage, 0xFFFF, 0x4444, "root_ns_a.UnionTest", layoutUnionTest());
+    db.add(uavcan::DataTypeKindMessage, 0xFFFF, 0x5555, "root_ns_b.SuperIntelligentShadeOfBlue",
+           layoutShadeOfBlue());
+    return db.build();
+}
+
+/*
+ * Prints the values in a compact JSON-like form
+ */
+class PrintingVisitor : public uavcan::ILayoutVisitor
+{
+    std::ostringstream os_;
+    bool first_;
+
+    std::ostream& item(const char* name)
+    {
+        if (!first_)
+        {
+            os_ << ",";
+        }
+        first_ = false;
+        if (name[0] != '\0')
+        {
+            os_ << name << ":";
+        }
+        return os_;
+    }
+
+    virtual void onBeginStruct(const char* name, bool is_union)
+    {
+        item(name) << (is_union ? "<" : "{");
+        first_ = true;
+    }
+    virtual void onEndStruct() { os_ << "}"; first_ = false; }
+
+    virtual void onBeginArray(const char* name)
+    {
+        item(name) << "[";
+        first_ = true;
+    }
+    virtual void onEndArray(unsigned size)
+    {
+        os_ << "]";
+        first_ = false;
+        sizes.push_back(size);
+    }
+
+    virtual void onUnsigned(const char* name, uavcan::uint64_t value) { item(name) << value; }
+    virtual void onSigned(const char* name, uavcan::int64_t value) { item(name) << value; }
+    virtual void onFloat(const char* name, double value, unsigned) { item(name) << value; }
+    virtual void onBool(const char* name, bool value) { item(name) << (value ? "1" : "0"); }
+
+public:
+    std::vector<unsigned> sizes;
+
+    PrintingVisitor() : first_(true) { }
+
+    std::string str() const { return os_.str(); }
+};
+
+/*
+ * Serializes the fields one by one, the same way as the generated code does
+ */
+typedef uavcan::IntegerSpec<1, uavcan::SignednessUnsigned, uavcan::CastModeSaturate> Bool;
+typedef uavcan::IntegerSpec<8, uavcan::SignednessUnsigned, uavcan::CastModeSaturate> UInt8;
+typedef uavcan::FloatSpec<16, uavcan::CastModeSaturate> Float16;
+typedef uavcan::FloatSpec<32, uavcan::CastModeSaturate> Float32;
+typedef uavcan::FloatSpec<64, uavcan::CastModeSaturate> Float64;
+
+class Writer
+{
+    uavcan::StaticTransferBuffer<1000> buf_;
+    uavcan::BitStream bs_;
+    uavcan::ScalarCodec sc_;
+
+public:
+    Writer()
+        : bs_(buf_)
+        , sc_(bs_)
+    { }
+
+    template <typename Type>
+    Writer& add(const typename uavcan::StorageType<Type>::Type& value,
+                uavcan::TailArrayOptimizationMode tao_mode = uavcan::TailArrayOptDisabled)
+    {
+        EXPECT_EQ(1, Type::encode(value, sc_, tao_mode));
+        return *this;
+    }
+
+    Writer& addB(double vector1, unsigned bool_index)
+    {
+        uavcan::Array<Float64, uavcan::ArrayModeStatic, 2> vector;
+        vector[1] = vector1;
+        uavcan::Array<Bool, uavcan::ArrayModeStatic, 16> bools;
+        if (bool_index < 16)
+        {
+            bools[uavcan::uint8_t(bool_index)] = true;
+        }
+        return add<uavcan::Array<Float64, uavcan::ArrayModeStatic, 2> >(vector)
+              .add<uavcan::Array<Bool, uavcan::ArrayModeStatic, 16> >(bools);
+    }
+
+    Bytes bytes() const { return Bytes(buf_.getRawPtr(), buf_.getRawPtr() + buf_.getMaxWritePos()); }
+};
+
+std::string decode(const uavcan::DataTypeLayoutDatabase& db, const char* name, uavcan::TransferType transfer_type,
+                   const Bytes& payload, int expected_result = 0)
+{
+    uavcan::DataTypeLayout layout;
+    EXPECT_TRUE(db.find(name, layout));
+    PrintingVisitor visitor;
+    EXPECT_EQ(expected_result, uavcan::LayoutDecoder::decode(layout, transfer_type, payload.empty() ? NULL :
+                                                             &payload[0], unsigned(payload.size()), visitor));
+    return visitor.str();
+}
+
+const std::string BZero = "{vector:[0,0],bools:[0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0]}";
+
+}
+
+
+TEST(LayoutDecoder, Database)
+{
+    const Bytes data = makeDatabase();
+
+    uavcan::DataTypeLayoutDatabase db;
+    EXPECT_FALSE(db.isInitialized());
+    uavcan::DataTypeLayout layout;
+    EXPECT_FALSE(db.find(uavcan::DataTypeKindMessage, 20000, layout));
+    EXPECT_FALSE(db.find("root_ns_a.Deep", layout));
+
+    ASSERT_EQ(0, db.init(&data[0], unsigned(data.size())));
+    ASSERT_TRUE(db.isInitialized());
+    EXPECT_EQ(6, db.getNumTypes());
+
+    /*
+     * Lookups
+     */
+    ASSERT_TRUE(db.find(uavcan::DataTypeKindMessage, 20000, layout));
+    EXPECT_STREQ("root_ns_a.MavlinkMessage", layout.getFullName());
+    EXPECT_EQ(0x123456789ABCDEF0ULL, layout.getSignature().get());
+    EXPECT_EQ(uavcan::DataTypeKindMessage, layout.getKind());
+    EXPECT_TRUE(layout.hasDefaultDataTypeID());
+    EXPECT_EQ(20000, layout.getDefaultDataTypeID().get());
+
+    ASSERT_TRUE(db.find(uavcan::DataTypeKindService, 99, layout));
+    EXPECT_STREQ("root_ns_a.StringService", layout.getFullName());
+    EXPECT_EQ(uavcan::DataTypeKindService, layout.getKind());
+    EXPECT_NE(layout.getCode(uavcan::TransferTypeServiceRequest), layout.getCode(uavcan::TransferTypeServiceResponse));
+
+    EXPECT_FALSE(db.find(uavcan::DataTypeKindMessage, 99, layout));
+    EXPECT_FALSE(db.find(uavcan::DataTypeKindService, 20000, layout));
+    EXPECT_FALSE(db.find(uavcan::DataTypeKindMessage, 0xFFFF, layout));     // Means no default data type ID
+
+    ASSERT_TRUE(db.find("root_ns_b.SuperIntelligentShadeOfBlue", layout));
+    EXPECT_FALSE(layout.hasDefaultDataTypeID());
+    EXPECT_EQ(uavcan::DataTypeKindMessage, layout.getKind());
+    EXPECT_FALSE(db.find("root_ns_b.Nonexistent", layout));
+
+    for (unsigned i = 0; i < db.getNumTypes(); i++)
+    {
+        ASSERT_TRUE(db.getLayout(i, layout));
+    }
+    EXPECT_FALSE(db.getLayout(db.getNumTypes(), layout));
+
+    /*
+     * Malformed databases are rejected
+     */
+    Bytes broken = data;
+    broken[0] = 'X';
+    EXPECT_EQ(-uavcan::ErrInvalidParam, db.init(&broken[0], unsigned(broken.size())));
+    EXPECT_FALSE(db.isInitialized());
+
+    broken = data;
+    broken[4] = 2;                                      // Unsupported version
+    EXPECT_EQ(-uavcan::ErrInvalidParam, db.init(&broken[0], unsigned(broken.size())));
+
+    EXPECT_EQ(-uavcan::ErrInvalidParam, db.init(&data[0], unsigned(data.size() - 1)));  // Truncated
+    EXPECT_EQ(-uavcan::ErrInvalidParam, db.init(&data[0], 7));
+    EXPECT_EQ(-uavcan::ErrInvalidParam, db.init(NULL, 0));
+
+    broken = data;
+    std::swap(broken[8], broken[16]);                   // Index is not sorted anymore
+    std::swap(broken[9], broken[17]);
+    EXPECT_EQ(-uavcan::ErrInvalidParam, db.init(&broken[0], unsigned(broken.size())));
+
+    Database empty;
+    const Bytes empty_data = empty.build();
+    ASSERT_EQ(0, db.init(&empty_data[0], unsigned(empty_data.size())));
+    EXPECT_EQ(0, db.getNumTypes());
+    EXPECT_FALSE(db.find(uavcan::DataTypeKindMessage, 20000, layout));
+}
+
+
+TEST(LayoutDecoder, Decoding)
+{
+    const Bytes data = makeDatabase();
+    uavcan::DataTypeLayoutDatabase db;
+    ASSERT_EQ(0, db.init(&data[0], unsigned(data.size())));
+
+    /*
+     * Nested structures, static and dynamic arrays
+     */
+    uavcan::Array<UInt8, uavcan::ArrayModeDynamic, 19> str;
+    str.push_back('h');
+    str.push_back('i');
+    const Bytes deep = Writer()
+        .add<Bool>(1)                                               // c
+        .add<uavcan::Array<UInt8, uavcan::ArrayModeDynamic, 19> >(str)
+        .add<uavcan::IntegerSpec<1, uavcan::SignednessUnsigned, uavcan::CastModeSaturate> >(1)  // a.size()
+        .add<Float32>(1.5F).addB(0, 16).addB(-0.25, 3)              // a[0]
+        .addB(0, 16).addB(1e10, 15)                                 // b
+        .bytes();
+
+    EXPECT_EQ("{c:1,str:[104,105],a:[{scalar:1.5,vector:[" + BZero +
+              ",{vector:[0,-0.25],bools:[0,0,0,1,0,0,0,0,0,0,0,0,0,0,0,0]}]}],b:[" + BZero +
+              ",{vector:[0,1e+10],bools:[0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,1]}]}",
+              decode(db, "root_ns_a.Deep", uavcan::TransferTypeMessageBroadcast, deep));
+
+    /*
+     * Tail array optimization: float16 array of a service response; the request is empty
+     */
+    uavcan::Array<Float16, uavcan::ArrayModeDynamic, 9> covariance;
+    covariance.push_back(-2);
+    covariance.push_back(65504);
+    const Bytes covariance_payload =
+        Writer().add<uavcan::Array<Float16, uavcan::ArrayModeDynamic, 9> >(covariance, uavcan::TailArrayOptEnabled)
+                .bytes();
+    EXPECT_EQ(4, covariance_payload.size());                        // No length prefix
+    EXPECT_EQ("{covariance:[-2,65504]}", decode(db, "root_ns_b.ServiceWithEmptyRequest",
+                                                uavcan::TransferTypeServiceResponse, covariance_payload));
+    EXPECT_EQ("{}", decode(db, "root_ns_b.ServiceWithEmptyRequest", uavcan::TransferTypeServiceRequest, Bytes()));
+
+    typedef uavcan::Array<UInt8, uavcan::ArrayModeDynamic, 255> MavlinkPayload;
+    MavlinkPayload mavlink;
+    EXPECT_EQ("{seq:1,sysid:2,compid:3,msgid:4,payload:[]}",
+              decode(db, "root_ns_a.MavlinkMessage", uavcan::TransferTypeMessageBroadcast,
+                     Writer().add<UInt8>(1).add<UInt8>(2).add<UInt8>(3).add<UInt8>(4)
+                             .add<MavlinkPayload>(mavlink, uavcan::TailArrayOptEnabled).bytes()));
+    for (unsigned i = 0; i < 255; i++)
+    {
+        mavlink.push_back(uavcan::uint8_t(i));
+    }
+    Bytes mavlink_payload = Writer().add<UInt8>(1).add<UInt8>(2).add<UInt8>(3).add<UInt8>(4)
+                                    .add<MavlinkPayload>(mavlink, uavcan::TailArrayOptEnabled).bytes();
+    ASSERT_EQ(259, mavlink_payload.size());
+    {
+        uavcan::DataTypeLayout layout;
+        ASSERT_TRUE(db.find(uavcan::DataTypeKindMessage, 20000, layout));
+        PrintingVisitor visitor;
+        ASSERT_EQ(0, uavcan::LayoutDecoder::decode(layout, uavcan::TransferTypeMessageBroadcast,
+                                                   &mavlink_payload[0], unsigned(mavlink_payload.size()), visitor));
+        ASSERT_EQ(1, visitor.sizes.size());
+        EXPECT_EQ(255, visitor.sizes[0]);
+    }
+    mavlink_payload.push_back(0);                                   // Longer than the max size of the array
+    decode(db, "root_ns_a.MavlinkMessage", uavcan::TransferTypeMessageBroadcast, mavlink_payload,
+           -uavcan::ErrInvalidMarshalData);
+
+    uavcan::Array<UInt8, uavcan::ArrayModeDynamic, 64> string_request;
+    string_request = "hello";
+    EXPECT_EQ("{string_request:[104,101,108,108,111]}",
+              decode(db, "root_ns_a.StringService", uavcan::TransferTypeServiceRequest,
+                     Writer().add<uavcan::Array<UInt8, uavcan::ArrayModeDynamic, 64> >(string_request,
+                                                                                     uavcan::TailArrayOptEnabled)
+                             .bytes()));
+
+    /*
+     * The length prefix of a dynamic array that is not the last field, signed integers, empty structures
+     */
+    typedef uavcan::IntegerSpec<2, uavcan::SignednessSigned, uavcan::CastModeSaturate> Int2;
+    uavcan::Array<Float16, uavcan::ArrayModeDynamic, 31> array_f16;
+    array_f16.push_back(0.5F);
+    EXPECT_EQ("{array_f16:[0.5],nested_message:[{field:-2,empty:{}},{field:1,empty:{}},{field:-1,empty:{}}]}",
+              decode(db, "root_ns_b.SuperIntelligentShadeOfBlue", uavcan::TransferTypeMessageBroadcast,
+                     Writer().add<uavcan::Array<Float16, uavcan::ArrayModeDynamic, 31> >(array_f16)
+                             .add<Int2>(-2).add<Int2>(1).add<Int2>(-1).bytes()));
+
+    /*
+     * Unions; only the selected field is reported, void fields are skipped
+     */
+    typedef uavcan::IntegerSpec<3, uavcan::SignednessUnsigned, uavcan::CastModeSaturate> Tag;
+    typedef uavcan::IntegerSpec<2, uavcan::SignednessUnsigned, uavcan::CastModeSaturate> UInt2;
+    EXPECT_EQ("<z:{}}", decode(db, "root_ns_a.UnionTest", uavcan::TransferTypeMessageBroadcast,
+                               Writer().add<Tag>(0).bytes()));
+
+    EXPECT_EQ("<c:4321}", decode(db, "root_ns_a.UnionTest", uavcan::TransferTypeMessageBroadcast,
+                                 Writer().add<Tag>(3)
+                                         .add<uavcan::IntegerSpec<13, uavcan::SignednessUnsigned,
+                                                                  uavcan::CastModeSaturate> >(4321).bytes()));
+
+    uavcan::Array<Bool, uavcan::ArrayModeDynamic, 9> bools;
+    bools.push_back(true);
+    bools.push_back(false);
+    bools.push_back(true);
+    EXPECT_EQ("<d:[1,0,1]}", decode(db, "root_ns_a.UnionTest", uavcan::TransferTypeMessageBroadcast,
+                                    Writer().add<Tag>(4)    // Bit arrays are never tail optimized
+                                            .add<uavcan::Array<Bool, uavcan::ArrayModeDynamic, 9> >(bools,
+                                                                                  uavcan::TailArrayOptEnabled)
+                                            .bytes()));
+
+    uavcan::Array<UInt2, uavcan::ArrayModeStatic, 4> array;
+    array[0] = 3;
+    array[3] = 2;
+    EXPECT_EQ("<e:{array:[3,0,0,2]}}",
+              decode(db, "root_ns_a.UnionTest", uavcan::TransferTypeMessageBroadcast,
+                     Writer().add<Tag>(5).add<UInt2>(3)                 // Void fields are not checked
+                             .add<uavcan::Array<UInt2, uavcan::ArrayModeStatic, 4> >(array).add<Tag>(0).bytes()));
+
+    Bytes invalid_tag(2, 0);
+    invalid_tag[0] = 0xE0;                                          // Tag 7, there are only 6 fields
+    decode(db, "root_ns_a.UnionTest", uavcan::TransferTypeMessageBroadcast, invalid_tag,
+           -uavcan::ErrInvalidMarshalData);
+
+    /*
+     * Truncated payload
+     */
+    Bytes deep_truncated = deep;
+    deep_truncated.resize(deep_truncated.size() - 1);
+    decode(db, "root_ns_a.Deep", uavcan::TransferTypeMessageBroadcast, deep_truncated,
+           -uavcan::ErrInvalidMarshalData);
+}
+
+
+TEST(LayoutDecoder, MalformedCode)
+{
+    const uavcan::uint8_t payload[8] = { 0 };
+
+    Bytes unknown_opcode;
+    unknown_opcode << 42U << 8U;
+
+    const Bytes codes[] =
+    {
+        Struct().field("x", scalar(uavcan::LayoutOpFloat, 24)).build(),     // Invalid float
+        Struct().field("x", scalar(uavcan::LayoutOpUnsigned, 65)).build(),  // Too long
+        Struct().field("x", unknown_opcode).build(),                        // Unknown opcode
+        Bytes(1, uavcan::LayoutOpStruct)                                    // Truncated
+    };
+
+    for (unsigned i = 0; i < sizeof(codes) / sizeof(codes[0]); i++)
+    {
+        Database db_builder;
+        db_builder.add(uavcan::DataTypeKindMessage, 1, 0, "malformed", codes[i]);
+        const Bytes data = db_builder.build();
+        uavcan::DataTypeLayoutDatabase db;
+        ASSERT_EQ(0, db.init(&data[0], unsigned(data.size())));     // The bytecode itself is not validated
+        uavcan::DataTypeLayout layout;
+        ASSERT_TRUE(db.find(uavcan::DataTypeKindMessage, 1, layout));
+        PrintingVisitor visitor;
+        EXPECT_EQ(-uavcan::ErrInvalidParam, uavcan::LayoutDecoder::decode(layout, uavcan::TransferTypeMessageBroadcast,
+                                                                          payload, sizeof(payload), visitor));
+    }
+
+    // Nesting depth is limited
+    Bytes deep = boolean();
+    for (unsigned i = 0; i <= unsigned(uavcan::LayoutDecoder::MaxNestingDepth); i++)
+    {
+        deep = Struct().field("x", deep).build();
+    }
+    Database db_builder;
+    db_builder.add(uavcan::DataTypeKindMessage, 1, 0, "deep", deep);
+    const Bytes data = db_builder.build();
+    uavcan::DataTypeLayoutDatabase db;
+    ASSERT_EQ(0, db.init(&data[0], unsigned(data.size())));
+    uavcan::DataTypeLayout layout;
+    ASSERT_TRUE(db.find(uavcan::DataTypeKindMessage, 1, layout));
+    PrintingVisitor visitor;
+    EXPECT_EQ(-uavcan::ErrInvalidParam, uavcan::LayoutDecoder::decode(layout, uavcan::TransferTypeMessageBroadcast,
+                                                                      payload, sizeof(payload), visitor));
+}
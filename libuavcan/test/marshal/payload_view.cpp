@@ -0,0 +1,196 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <vector>
+#include <gtest/gtest.h>
+#include <uavcan/marshal/payload_view.hpp>
+#include <uavcan/marshal/types.hpp>
+#include <uavcan/transport/transfer_buffer.hpp>
+
+
+namespace
+{
+
+typedef uavcan::IntegerSpec<1, uavcan::SignednessUnsigned, uavcan::CastModeSaturate> Bool;
+typedef uavcan::IntegerSpec<8, uavcan::SignednessUnsigned, uavcan::CastModeSaturate> UInt8;
+typedef uavcan::IntegerSpec<12, uavcan::SignednessSigned, uavcan::CastModeSaturate> Int12;
+typedef uavcan::FloatSpec<16, uavcan::CastModeSaturate> Float16;
+
+/*
+ * Same as the view generated for the DSDL definition:
+ *      int12 x
+ *      float16 y
+ */
+struct Point
+{
+    enum { MinBitLen = 28 };
+    enum { MaxBitLen = 28 };
+
+    class View : public uavcan::PayloadView
+    {
+    public:
+        View(const uavcan::PayloadView& parent, unsigned bit_offset, uavcan::TailArrayOptimizationMode tao_mode)
+            : uavcan::PayloadView(parent, bit_offset, tao_mode)
+        { }
+
+        uavcan::int16_t x() const { return Int12::fromRawBits(readRawBits(0, Int12::BitLen)); }
+        float y() const { return Float16::fromRawBits(readRawBits(12, Float16::BitLen)); }
+    };
+};
+
+typedef uavcan::Array<Bool, uavcan::ArrayModeDynamic, 10> BoolArray;
+typedef uavcan::Array<UInt8, uavcan::ArrayModeDynamic, 5> ShortArray;
+typedef uavcan::Array<UInt8, uavcan::ArrayModeDynamic, 200> LongArray;
+typedef uavcan::Array<Point, uavcan::ArrayModeStatic, 3> PointArray;
+
+class Writer
+{
+    uavcan::StaticTransferBuffer<1000> buf_;
+    uavcan::BitStream bs_;
+    uavcan::ScalarCodec sc_;
+
+public:
+    Writer()
+        : bs_(buf_)
+        , sc_(bs_)
+    { }
+
+    template <typename Type>
+    Writer& add(const typename uavcan::StorageType<Type>::Type& value,
+                uavcan::TailArrayOptimizationMode tao_mode = uavcan::TailArrayOptDisabled)
+    {
+        EXPECT_EQ(1, Type::encode(value, sc_, tao_mode));
+        return *this;
+    }
+
+    Writer& addPoint(int x, float y)
+    {
+        return add<Int12>(uavcan::int16_t(x)).add<Float16>(y);
+    }
+
+    std::vector<uavcan::uint8_t> bytes() const
+    {
+        return std::vector<uavcan::uint8_t>(buf_.getRawPtr(), buf_.getRawPtr() + buf_.getMaxWritePos());
+    }
+};
+
+}
+
+
+TEST(PayloadView, Scalars)
+{
+    const std::vector<uavcan::uint8_t> payload = Writer().add<Bool>(true).add<Int12>(-1234).add<Float16>(-2.5F)
+                                                         .add<UInt8>(0xA5).bytes();
+    ASSERT_EQ(5, payload.size());
+
+    const uavcan::PayloadView view(&payload[0], unsigned(payload.size()));
+    EXPECT_EQ(40, view.getPayloadBitLen());
+    EXPECT_EQ(0, view.getBitOffset());
+    EXPECT_EQ(uavcan::TailArrayOptEnabled, view.getTailArrayOptMode());
+
+    EXPECT_TRUE(Bool::fromRawBits(view.readRawBits(0, 1)));
+    EXPECT_EQ(-1234, Int12::fromRawBits(view.readRawBits(1, 12)));
+    EXPECT_FLOAT_EQ(-2.5F, Float16::fromRawBits(view.readRawBits(13, 16)));
+    EXPECT_EQ(0xA5, view.readRawBits(29, 8));
+
+    // Out of the payload bounds - zero
+    EXPECT_EQ(0, view.readRawBits(29, 12));
+    EXPECT_EQ(0, view.readRawBits(1000, 8));
+    EXPECT_EQ(11, view.getRemainingBitLen(29));
+    EXPECT_EQ(0, view.getRemainingBitLen(1000));
+
+    // Nested views
+    const uavcan::PayloadView nested(view, 13, uavcan::TailArrayOptDisabled);
+    EXPECT_EQ(13, nested.getBitOffset());
+    EXPECT_EQ(uavcan::TailArrayOptDisabled, nested.getTailArrayOptMode());
+    EXPECT_FLOAT_EQ(-2.5F, Float16::fromRawBits(nested.readRawBits(0, 16)));
+    EXPECT_EQ(0xA5, uavcan::PayloadView(nested, 16, uavcan::TailArrayOptDisabled).readRawBits(0, 8));
+
+    // Empty view
+    const uavcan::PayloadView empty;
+    EXPECT_EQ(0, empty.readRawBits(0, 8));
+    EXPECT_EQ(0, empty.getRemainingBitLen(0));
+}
+
+TEST(PayloadView, Arrays)
+{
+    BoolArray bools;
+    bools.push_back(false);
+    bools.push_back(true);
+    bools.push_back(true);
+
+    ShortArray short_array;
+    short_array.push_back(42);
+
+    LongArray long_array;
+    for (unsigned i = 0; i < 150; i++)
+    {
+        long_array.push_back(uavcan::uint8_t(i));
+    }
+
+    /*
+     * Same as the following DSDL definition, serialized with TAO:
+     *      bool[<=10] bools
+     *      uint8[<=5] short_array
+     *      Point[3] points
+     *      uint8[<=200] long_array
+     */
+    const std::vector<uavcan::uint8_t> payload = Writer().add<BoolArray>(bools).add<ShortArray>(short_array)
+                                                         .addPoint(1, 1.5F).addPoint(-2, 2.5F).addPoint(3, -3.5F)
+                                                         .add<LongArray>(long_array, uavcan::TailArrayOptEnabled)
+                                                         .bytes();
+    const uavcan::PayloadView view(&payload[0], unsigned(payload.size()));
+
+    // Bit arrays are never tail optimized
+    const uavcan::PayloadArrayView<Bool> bool_view =
+        view.makeDynamicArrayView<BoolArray>(0, view.getTailArrayOptMode());
+    ASSERT_EQ(3, bool_view.size());
+    EXPECT_FALSE(bool_view.empty());
+    EXPECT_FALSE(bool_view[0]);
+    EXPECT_TRUE(bool_view[1]);
+    EXPECT_TRUE(bool_view[2]);
+    EXPECT_FALSE(bool_view[3]);                                 // Out of range
+    EXPECT_EQ(7, view.getDynamicArrayEnd<BoolArray>(0));
+
+    const unsigned short_array_offset = view.getDynamicArrayEnd<BoolArray>(0);
+    const uavcan::PayloadArrayView<UInt8> short_view =
+        view.makeDynamicArrayView<ShortArray>(short_array_offset, uavcan::TailArrayOptDisabled);
+    ASSERT_EQ(1, short_view.size());
+    EXPECT_EQ(42, short_view[0]);
+    EXPECT_EQ(7 + 3 + 8, view.getDynamicArrayEnd<ShortArray>(short_array_offset));
+
+    const unsigned points_offset = view.getDynamicArrayEnd<ShortArray>(short_array_offset);
+    const uavcan::PayloadArrayView<Point> points_view = view.makeStaticArrayView<PointArray>(points_offset);
+    ASSERT_EQ(3, points_view.size());
+    EXPECT_EQ(1, points_view[0].x());
+    EXPECT_FLOAT_EQ(1.5F, points_view[0].y());
+    EXPECT_EQ(-2, points_view[1].x());
+    EXPECT_FLOAT_EQ(2.5F, points_view[1].y());
+    EXPECT_EQ(3, points_view[2].x());
+    EXPECT_FLOAT_EQ(-3.5F, points_view[2].y());
+    EXPECT_EQ(0, points_view[3].x());                           // Out of range
+    EXPECT_EQ(0, points_view[3].y());
+
+    // Tail array - the length is inferred from the payload length
+    const unsigned long_array_offset = points_offset + unsigned(PointArray::MaxSize * Point::MaxBitLen);
+    const uavcan::PayloadArrayView<UInt8> long_view =
+        view.makeDynamicArrayView<LongArray>(long_array_offset, view.getTailArrayOptMode());
+    ASSERT_EQ(150, long_view.size());
+    for (unsigned i = 0; i < long_view.size(); i++)
+    {
+        ASSERT_EQ(i, long_view[i]);
+    }
+
+    // Truncated payload - the last element is missing
+    const uavcan::PayloadView truncated(&payload[0], unsigned(payload.size() - 1));
+    EXPECT_EQ(149, truncated.makeDynamicArrayView<LongArray>(long_array_offset, uavcan::TailArrayOptEnabled).size());
+
+    // Malformed length prefix - the size is limited by the maximum size of the array
+    std::vector<uavcan::uint8_t> malformed = Writer().add<uavcan::IntegerSpec<3, uavcan::SignednessUnsigned,
+                                                                              uavcan::CastModeSaturate> >(7).bytes();
+    const uavcan::PayloadView malformed_view(&malformed[0], unsigned(malformed.size()));
+    EXPECT_EQ(5, malformed_view.makeDynamicArrayView<ShortArray>(0, uavcan::TailArrayOptDisabled).size());
+    EXPECT_EQ(3 + 5 * 8, malformed_view.getDynamicArrayEnd<ShortArray>(0));
+    EXPECT_EQ(0, malformed_view.makeDynamicArrayView<ShortArray>(0, uavcan::TailArrayOptDisabled)[4]);
+}
@@ -4,7 +4,9 @@
 
 #include <gtest/gtest.h>
 #include <limits>
+#include <algorithm>
 #include <uavcan/marshal/scalar_codec.hpp>
+#include <uavcan/marshal/integer_spec.hpp>
 #include <uavcan/transport/transfer_buffer.hpp>
 
 
@@ -96,3 +98,76 @@ TEST(ScalarCodec, RepresentationCorrectness)
     static const std::string REFERENCE = "11011010 11101111 01111100 00000000";
     ASSERT_EQ(REFERENCE, bs_wr.toString());
 }
+
+
+TEST(ScalarCodec, PackedBlock)
+{
+    typedef uavcan::IntegerSpec<12, uavcan::SignednessUnsigned, uavcan::CastModeTruncate> U12;
+    typedef uavcan::IntegerSpec<3, uavcan::SignednessSigned, uavcan::CastModeSaturate> I3;
+    typedef uavcan::IntegerSpec<4, uavcan::SignednessSigned, uavcan::CastModeSaturate> I4;
+    typedef uavcan::IntegerSpec<2, uavcan::SignednessSigned, uavcan::CastModeSaturate> I2;
+    typedef uavcan::IntegerSpec<4, uavcan::SignednessUnsigned, uavcan::CastModeTruncate> U4;
+    typedef uavcan::IntegerSpec<64, uavcan::SignednessSigned, uavcan::CastModeTruncate> I64;
+
+    /*
+     * Same fields as in RepresentationCorrectness, packed at constant offsets
+     */
+    uavcan::uint8_t block[4] = { 0 };
+    uavcan::ScalarCodec::packBits(block, 0, 12, U12::toRawBits(0xbeda));   // --> 0xeda
+    uavcan::ScalarCodec::packBits(block, 12, 3, I3::toRawBits(-1));
+    uavcan::ScalarCodec::packBits(block, 15, 4, I4::toRawBits(-5));
+    uavcan::ScalarCodec::packBits(block, 19, 2, I2::toRawBits(-100));     // Saturated --> -2
+    uavcan::ScalarCodec::packBits(block, 21, 4, U4::toRawBits(0x88));     // --> 8
+
+    {
+        uavcan::StaticTransferBuffer<4> buf;
+        uavcan::BitStream bs_wr(buf);
+        uavcan::ScalarCodec sc_wr(bs_wr);
+        ASSERT_EQ(1, sc_wr.encodeBlock(block, 25));
+        ASSERT_EQ("11011010 11101111 01110100 00000000", bs_wr.toString());
+
+        uavcan::BitStream bs_rd(buf);
+        uavcan::ScalarCodec sc_rd(bs_rd);
+        uavcan::uint8_t block_rd[4] = { 0 };
+        ASSERT_EQ(1, sc_rd.decodeBlock(block_rd, 25));
+        ASSERT_EQ(0xeda, U12::fromRawBits(uavcan::ScalarCodec::unpackBits(block_rd, 0, 12)));
+        ASSERT_EQ(-1, I3::fromRawBits(uavcan::ScalarCodec::unpackBits(block_rd, 12, 3)));
+        ASSERT_EQ(-5, I4::fromRawBits(uavcan::ScalarCodec::unpackBits(block_rd, 15, 4)));
+        ASSERT_EQ(-2, I2::fromRawBits(uavcan::ScalarCodec::unpackBits(block_rd, 19, 2)));
+        ASSERT_EQ(8, U4::fromRawBits(uavcan::ScalarCodec::unpackBits(block_rd, 21, 4)));
+    }
+
+    /*
+     * Long unaligned block must be split into several stream writes, the result must match per-field encoding
+     */
+    uavcan::uint8_t long_block[40] = { 0 };
+    uavcan::StaticTransferBuffer<41> buf_ref;
+    uavcan::BitStream bs_ref(buf_ref);
+    uavcan::ScalarCodec sc_ref(bs_ref);
+    ASSERT_EQ(1, sc_ref.encode<3>(uavcan::uint8_t(5)));
+    for (unsigned i = 0; i < 5; i++)
+    {
+        const uavcan::int64_t value = uavcan::int64_t(0x0123456789ABCDEFULL * (i + 1)) - 1000;
+        uavcan::ScalarCodec::packBits(long_block, i * 64, 64, I64::toRawBits(value));
+        ASSERT_EQ(1, sc_ref.encode<64>(value));
+        ASSERT_EQ(value, I64::fromRawBits(uavcan::ScalarCodec::unpackBits(long_block, i * 64, 64)));
+    }
+
+    uavcan::StaticTransferBuffer<41> buf;
+    uavcan::BitStream bs_wr(buf);
+    uavcan::ScalarCodec sc_wr(bs_wr);
+    const uavcan::uint8_t prefix = 0xA0;  // 101
+    ASSERT_EQ(1, sc_wr.encodeBlock(&prefix, 3));
+    ASSERT_EQ(1, sc_wr.encodeBlock(long_block, 320));
+    ASSERT_EQ(bs_ref.toString(), bs_wr.toString());
+    ASSERT_EQ(0, sc_wr.encodeBlock(long_block, 320));                    // Out of buffer space
+
+    uavcan::BitStream bs_rd(buf);
+    uavcan::ScalarCodec sc_rd(bs_rd);
+    uavcan::uint8_t long_block_rd[40] = { 0 };
+    ASSERT_EQ(1, sc_rd.decodeBlock(long_block_rd, 3));
+    ASSERT_EQ(0xA0, long_block_rd[0]);
+    ASSERT_EQ(1, sc_rd.decodeBlock(long_block_rd, 320));
+    ASSERT_TRUE(std::equal(long_block, long_block + 40, long_block_rd));
+    ASSERT_EQ(0, sc_rd.decodeBlock(long_block_rd, 8));                    // Out of buffer space
+}
@@ -0,0 +1,236 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <vector>
+#include <gtest/gtest.h>
+#include <uavcan/node/bus_load_monitor.hpp>
+#include "../clock.hpp"
+#include "../transport/can/can.hpp"
+#include "test_node.hpp"
+
+#if !UAVCAN_TINY
+
+struct CongestionCollector : public uavcan::IBusCongestionListener
+{
+    std::vector<uavcan::BusLoadEstimate> estimates;
+
+    virtual void handleBusCongestionLevelChange(const uavcan::BusLoadEstimate& estimate)
+    {
+        estimates.push_back(estimate);
+    }
+};
+
+struct RxFrameCounter : public uavcan::IRxFrameListener
+{
+    unsigned count;
+
+    RxFrameCounter() : count(0) { }
+
+    virtual void handleRxFrame(const uavcan::CanRxFrame&, uavcan::CanIOFlags) { count++; }
+};
+
+struct PeriodicTimer : public uavcan::TimerBase
+{
+    explicit PeriodicTimer(uavcan::INode& node) : uavcan::TimerBase(node) { }
+
+    virtual void handleTimerEvent(const uavcan::TimerEvent&) { }
+};
+
+static uavcan::CanFrame makeFrame(uavcan::uint8_t tid)
+{
+    uavcan::Frame frame(20, uavcan::TransferTypeMessageBroadcast, 2, uavcan::NodeID::Broadcast, tid);
+    const uavcan::uint8_t payload[7] = { 1, 2, 3, 4, 5, 6, 7 };
+    frame.setPayload(payload, sizeof(payload));
+    frame.setStartOfTransfer(true);
+    frame.setEndOfTransfer(true);
+    uavcan::CanFrame can_frame;
+    EXPECT_TRUE(frame.compile(can_frame));
+    return can_frame;
+}
+
+/**
+ * Feeds the frames into the first iface and spins for one update interval of the monitor.
+ */
+static void runInterval(TestNode& node, CanDriverMock& can_driver, unsigned num_frames)
+{
+    for (unsigned i = 0; i < num_frames; i++)
+    {
+        can_driver.ifaces.at(0).pushRx(makeFrame(uavcan::uint8_t(i & uavcan::TransferID::Max)));
+    }
+    ASSERT_LE(0, node.spin(uavcan::MonotonicDuration::fromMSec(100)));
+}
+
+TEST(BusLoadMonitor, FrameBitLength)
+{
+    EXPECT_EQ(80, uavcan::BusLoadMonitor::getFrameBitLength(0));
+    EXPECT_EQ(160, uavcan::BusLoadMonitor::getFrameBitLength(8));
+    EXPECT_EQ(160, uavcan::BusLoadMonitor::getFrameBitLength(15));
+}
+
+TEST(BusLoadMonitor, Basic)
+{
+    SystemClockMock clock(1000000);
+    CanDriverMock can_driver(2, clock);
+    TestNode node(can_driver, clock, 1);
+
+    RxFrameCounter previous_listener;
+    node.getDispatcher().installRxFrameListener(&previous_listener);
+
+    CongestionCollector collector;
+    uavcan::BusLoadMonitor monitor(node);
+    monitor.addCongestionListener(&collector);
+    ASSERT_EQ(1, monitor.getNumCongestionListeners());
+
+    ASSERT_EQ(-uavcan::ErrInvalidParam, monitor.start(0));
+    ASSERT_EQ(-uavcan::ErrInvalidParam, monitor.setThresholds(500, 400, 900));
+    ASSERT_FALSE(monitor.isStarted());
+
+    // 10000 bits per interval; 50 frames of 160 bits are 80% of that
+    ASSERT_EQ(0, monitor.start(100000, uavcan::MonotonicDuration::fromMSec(100)));
+    ASSERT_TRUE(monitor.isStarted());
+    ASSERT_EQ(&monitor, node.getDispatcher().getRxFrameListener());
+    ASSERT_EQ(uavcan::BusCongestionLevelNormal, monitor.getCongestionLevel());
+
+    // The filtered load approaches 800 permille, crossing the elevated and the high thresholds
+    uavcan::uint16_t prev_load = 0;
+    for (int i = 0; i < 20; i++)
+    {
+        runInterval(node, can_driver, 50);
+        EXPECT_LE(prev_load, monitor.getEstimate().max_load_permille);
+        prev_load = monitor.getEstimate().max_load_permille;
+    }
+    EXPECT_EQ(1000, previous_listener.count);       // All frames are forwarded
+    EXPECT_LE(780, prev_load);
+    EXPECT_GE(820, prev_load);
+    EXPECT_EQ(prev_load, monitor.getEstimate().iface_load_permille[0]);
+    EXPECT_EQ(0, monitor.getEstimate().iface_load_permille[1]);
+    EXPECT_EQ(uavcan::BusCongestionLevelHigh, monitor.getCongestionLevel());
+
+    ASSERT_EQ(2, collector.estimates.size());
+    EXPECT_EQ(uavcan::BusCongestionLevelElevated, collector.estimates[0].level);
+    EXPECT_LE(500, collector.estimates[0].max_load_permille);
+    EXPECT_EQ(uavcan::BusCongestionLevelHigh, collector.estimates[1].level);
+    EXPECT_LE(700, collector.estimates[1].max_load_permille);
+
+    // The level doesn't go down until the load drops below the threshold minus the hysteresis
+    collector.estimates.clear();
+    while (monitor.getEstimate().max_load_permille >= 650)
+    {
+        ASSERT_EQ(uavcan::BusCongestionLevelHigh, monitor.getCongestionLevel());
+        runInterval(node, can_driver, 20);
+    }
+    ASSERT_LE(1, collector.estimates.size());
+    EXPECT_GT(650, collector.estimates[0].max_load_permille);
+
+    // Idle bus
+    for (int i = 0; i < 20; i++)
+    {
+        runInterval(node, can_driver, 0);
+    }
+    EXPECT_EQ(uavcan::BusCongestionLevelNormal, monitor.getCongestionLevel());
+    EXPECT_GT(10, monitor.getEstimate().max_load_permille);
+
+    // TX errors raise the level regardless of the load
+    collector.estimates.clear();
+    can_driver.ifaces.at(1).num_errors += 3;
+    runInterval(node, can_driver, 0);
+    EXPECT_EQ(uavcan::BusCongestionLevelHigh, monitor.getCongestionLevel());
+    EXPECT_EQ(3, monitor.getEstimate().num_tx_errors);
+    runInterval(node, can_driver, 0);
+    EXPECT_EQ(uavcan::BusCongestionLevelNormal, monitor.getCongestionLevel());
+    ASSERT_EQ(2, collector.estimates.size());
+
+    // Stopping restores the previous listener
+    monitor.stop();
+    ASSERT_FALSE(monitor.isStarted());
+    ASSERT_EQ(&previous_listener, node.getDispatcher().getRxFrameListener());
+
+    monitor.removeCongestionListener(&collector);
+    ASSERT_EQ(0, monitor.getNumCongestionListeners());
+    node.getDispatcher().removeRxFrameListener();
+}
+
+TEST(BusLoadMonitor, TxAccounting)
+{
+    SystemClockMock clock(1000000);
+    CanDriverMock can_driver(1, clock);
+    TestNode node(can_driver, clock, 1);
+
+    uavcan::BusLoadMonitor monitor(node);
+    ASSERT_EQ(0, monitor.start(100000, uavcan::MonotonicDuration::fromMSec(100)));
+    ASSERT_EQ(&monitor, node.getDispatcher().getRxFrameListener());
+
+    uavcan::Frame frame(123, uavcan::TransferTypeMessageBroadcast, node.getNodeID(), uavcan::NodeID::Broadcast, 0);
+    const uavcan::uint8_t payload[] = { 42 };
+    frame.setPayload(payload, sizeof(payload));
+    frame.setStartOfTransfer(true);
+    frame.setEndOfTransfer(true);
+
+    // 20 looped back frames of 2 bytes are 20 * 100 bits; 10 other frames are accounted for as 10 * 160 bits
+    const uavcan::MonotonicTime deadline = clock.getMonotonic() + uavcan::MonotonicDuration::fromMSec(50);
+    for (int i = 0; i < 30; i++)
+    {
+        ASSERT_LE(0, node.getDispatcher().send(frame, deadline, uavcan::MonotonicTime(), uavcan::CanTxQueue::Volatile,
+                                               (i < 20) ? uavcan::CanIOFlagLoopback : uavcan::CanIOFlags(0), 1));
+    }
+    ASSERT_LE(0, node.spin(uavcan::MonotonicDuration::fromMSec(100)));
+
+    // EWMA of the sample (2000 + 1600) / 10000
+    EXPECT_EQ((360 + 2) / 4, monitor.getEstimate().max_load_permille);
+    EXPECT_EQ(0, monitor.getEstimate().num_tx_errors);
+
+    monitor.stop();
+    ASSERT_EQ(NULL, node.getDispatcher().getRxFrameListener());
+}
+
+TEST(BusLoadMonitor, PublicationRateController)
+{
+    SystemClockMock clock(1000000);
+    CanDriverMock can_driver(1, clock);
+    TestNode node(can_driver, clock, 1);
+
+    PeriodicTimer running(node);
+    PeriodicTimer stopped(node);
+    running.startPeriodic(uavcan::MonotonicDuration::fromMSec(10));
+
+    uavcan::PublicationRateController<2> controller;
+    ASSERT_EQ(-uavcan::ErrInvalidParam, controller.add(running, uavcan::MonotonicDuration()));
+    ASSERT_EQ(0, controller.add(running, uavcan::MonotonicDuration::fromMSec(10)));
+    ASSERT_EQ(-uavcan::ErrLogic, controller.add(running, uavcan::MonotonicDuration::fromMSec(10)));
+    ASSERT_EQ(0, controller.add(stopped, uavcan::MonotonicDuration::fromMSec(20)));
+
+    PeriodicTimer extra(node);
+    ASSERT_EQ(-uavcan::ErrMemory, controller.add(extra, uavcan::MonotonicDuration::fromMSec(20)));
+
+    controller.setPeriodMultiplier(uavcan::BusCongestionLevelCritical, 10);
+    controller.setPeriodMultiplier(uavcan::BusCongestionLevelHigh, 0);     // Ignored
+    EXPECT_EQ(4, controller.getPeriodMultiplier(uavcan::BusCongestionLevelHigh));
+
+    uavcan::IBusCongestionListener& listener = controller;
+    uavcan::BusLoadEstimate estimate;
+
+    estimate.level = uavcan::BusCongestionLevelHigh;
+    listener.handleBusCongestionLevelChange(estimate);
+    EXPECT_EQ(uavcan::BusCongestionLevelHigh, controller.getCongestionLevel());
+    EXPECT_EQ(uavcan::MonotonicDuration::fromMSec(40), running.getPeriod());
+    EXPECT_FALSE(stopped.isRunning());
+
+    estimate.level = uavcan::BusCongestionLevelCritical;
+    listener.handleBusCongestionLevelChange(estimate);
+    EXPECT_EQ(uavcan::MonotonicDuration::fromMSec(100), running.getPeriod());
+
+    estimate.level = uavcan::BusCongestionLevelNormal;
+    listener.handleBusCongestionLevelChange(estimate);
+    EXPECT_EQ(uavcan::MonotonicDuration::fromMSec(10), running.getPeriod());
+
+    // Removal restores the nominal period
+    estimate.level = uavcan::BusCongestionLevelElevated;
+    listener.handleBusCongestionLevelChange(estimate);
+    EXPECT_EQ(uavcan::MonotonicDuration::fromMSec(20), running.getPeriod());
+    controller.remove(running);
+    EXPECT_EQ(uavcan::MonotonicDuration::fromMSec(10), running.getPeriod());
+    ASSERT_EQ(0, controller.add(extra, uavcan::MonotonicDuration::fromMSec(20)));
+}
+
+#endif
@@ -2,6 +2,7 @@
  * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
  */
 
+#include <cstdio>
 #include <gtest/gtest.h>
 #include <uavcan/node/global_data_type_registry.hpp>
 
@@ -166,3 +167,88 @@ TEST(GlobalDataTypeRegistry, Reset)
     GlobalDataTypeRegistry::instance().reset();
     ASSERT_FALSE(GlobalDataTypeRegistry::instance().isFrozen());
 }
+
+
+namespace
+{
+
+template <int N>
+struct NumberedDataType
+{
+    // Every name is used by a message and by a service
+    enum { DataTypeKind = (N % 2 == 0) ? uavcan::DataTypeKindMessage : uavcan::DataTypeKindService };
+    static uavcan::DataTypeSignature getDataTypeSignature() { return uavcan::DataTypeSignature(N); }
+    static const char* getDataTypeFullName()
+    {
+        static char name[32];
+        (void)std::snprintf(name, sizeof(name), "numbered.Type%d", N / 2);
+        return name;
+    }
+};
+
+template <int N>
+void registerNumberedDataTypes()
+{
+    registerNumberedDataTypes<N - 1>();
+    ASSERT_EQ(uavcan::GlobalDataTypeRegistry::RegistrationResultOk,
+              uavcan::GlobalDataTypeRegistry::instance().registerDataType<NumberedDataType<N> >(N / 2 + 100));
+}
+
+template <>
+void registerNumberedDataTypes<-1>() { }
+
+}
+
+TEST(GlobalDataTypeRegistry, IndexedLookup)
+{
+    using uavcan::GlobalDataTypeRegistry;
+    using uavcan::DataTypeDescriptor;
+
+    GlobalDataTypeRegistry& gdtr = GlobalDataTypeRegistry::instance();
+    gdtr.reset();
+
+    const int NumTypes = 150;
+    registerNumberedDataTypes<NumTypes - 1>();
+    ASSERT_EQ(NumTypes / 2, gdtr.getNumMessageTypes());
+    ASSERT_EQ(NumTypes / 2, gdtr.getNumServiceTypes());
+
+    // Results before freezing are served by the lists
+    ASSERT_FALSE(gdtr.isIndexed());
+    const DataTypeDescriptor* by_name[NumTypes] = { NULL };
+    const DataTypeDescriptor* by_id[NumTypes] = { NULL };
+    for (int i = 0; i < NumTypes; i++)
+    {
+        char name[32];
+        (void)std::snprintf(name, sizeof(name), "numbered.Type%d", i / 2);
+        const uavcan::DataTypeKind kind = (i % 2 == 0) ? uavcan::DataTypeKindMessage : uavcan::DataTypeKindService;
+        by_name[i] = gdtr.find(kind, name);
+        by_id[i] = gdtr.find(kind, uavcan::DataTypeID(uint16_t(i / 2 + 100)));
+        ASSERT_TRUE(by_name[i]);
+        ASSERT_EQ(by_name[i], by_id[i]);
+        ASSERT_EQ(uint64_t(i), by_name[i]->getSignature().get());
+    }
+
+    gdtr.freeze();
+    ASSERT_EQ(UAVCAN_DATA_TYPE_REGISTRY_INDEX_CAPACITY >= NumTypes, gdtr.isIndexed());
+
+    for (int i = 0; i < NumTypes; i++)
+    {
+        char name[32];
+        (void)std::snprintf(name, sizeof(name), "numbered.Type%d", i / 2);
+        const uavcan::DataTypeKind kind = (i % 2 == 0) ? uavcan::DataTypeKindMessage : uavcan::DataTypeKindService;
+        ASSERT_EQ(by_name[i], gdtr.find(kind, name));
+        ASSERT_EQ(by_id[i], gdtr.find(kind, uavcan::DataTypeID(uint16_t(i / 2 + 100))));
+        if (kind == uavcan::DataTypeKindMessage)
+        {
+            ASSERT_EQ(by_name[i], gdtr.find(name));     // Messages first
+        }
+    }
+
+    ASSERT_FALSE(gdtr.find("numbered.Type"));
+    ASSERT_FALSE(gdtr.find("numbered.Type1000"));
+    ASSERT_FALSE(gdtr.find(uavcan::DataTypeKindMessage, uavcan::DataTypeID(99)));
+    ASSERT_FALSE(gdtr.find(uavcan::DataTypeKindService, uavcan::DataTypeID(100 + NumTypes / 2)));
+
+    gdtr.reset();
+    ASSERT_FALSE(gdtr.isIndexed());
+}
@@ -88,3 +88,58 @@ TEST(Node, Basic)
     ASSERT_TRUE(log_sub.collector.msg.get());
     std::cout << *log_sub.collector.msg << std::endl;
 }
+
+
+TEST(Node, FastStart)
+{
+    registerTypes();
+    InterlinkedTestNodesWithSysClock nodes;
+
+    uavcan::protocol::SoftwareVersion swver;
+    swver.major = 1;
+
+    uavcan::Node<1024> node1(nodes.can_a, nodes.clock_a);
+    node1.setName("com.example");
+    node1.setNodeID(1);
+    node1.setSoftwareVersion(swver);
+
+    uavcan::Node<1024> node2(nodes.can_b, nodes.clock_b);
+    node2.setName("foobar");
+    node2.setNodeID(2);
+
+    uavcan::NodeStatusMonitor node_status_monitor(node2);
+    ASSERT_LE(0, node_status_monitor.start());
+    ASSERT_LE(0, node2.start());
+    ASSERT_FALSE(node2.areOptionalServicesDeferred());
+
+    /*
+     * Only NodeStatus goes out, the rest is started by the first spin
+     */
+    ASSERT_LE(0, node1.startFast());
+    ASSERT_TRUE(node1.isStarted());
+    ASSERT_TRUE(node1.areOptionalServicesDeferred());
+    ASSERT_EQ(0, node1.startFast());                    // Already started
+    ASSERT_EQ(0, node1.start());
+    ASSERT_TRUE(node1.areOptionalServicesDeferred());
+
+    ASSERT_LE(0, node2.spin(uavcan::MonotonicDuration::fromMSec(10)));
+    ASSERT_EQ(1, node_status_monitor.findNodeWithWorstHealth().get());
+    ASSERT_TRUE(node1.areOptionalServicesDeferred());
+
+    ASSERT_LE(0, node1.spinOnce());
+    ASSERT_FALSE(node1.areOptionalServicesDeferred());
+
+    /*
+     * The optional services are functional now
+     */
+    ServiceClientWithCollector<uavcan::protocol::GetTransportStats> tsp_cln(node2);
+    ASSERT_LE(0, tsp_cln.call(1, uavcan::protocol::GetTransportStats::Request()));
+    for (int i = 0; (i < 10) && !tsp_cln.collector.result.get(); i++)
+    {
+        ASSERT_LE(0, node2.spin(uavcan::MonotonicDuration::fromMSec(5)));
+        ASSERT_LE(0, node1.spin(uavcan::MonotonicDuration::fromMSec(5)));
+        ASSERT_LE(0, node2.spin(uavcan::MonotonicDuration::fromMSec(5)));
+    }
+    ASSERT_TRUE(tsp_cln.collector.result.get());
+    ASSERT_TRUE(tsp_cln.collector.result->isSuccessful());
+}
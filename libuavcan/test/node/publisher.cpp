@@ -2,6 +2,7 @@
  * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
  */
 
+#include <algorithm>
 #include <gtest/gtest.h>
 #include <uavcan/node/publisher.hpp>
 #include <root_ns_a/MavlinkMessage.hpp>
@@ -95,3 +96,80 @@ TEST(Publisher, Basic)
     ASSERT_TRUE(uavcan::GlobalDataTypeRegistry::instance().isFrozen());
     ASSERT_TRUE(publisher.getTransferSender().isInitialized());
 }
+
+
+static void expectBroadcastFrame(CanDriverMock& can_driver, const TestNode& node, const uint8_t (&payload)[7],
+                                 uint8_t tid, uint64_t tx_timeout_usec)
+{
+    uavcan::Frame expected_frame(root_ns_a::MavlinkMessage::DefaultDataTypeID, uavcan::TransferTypeMessageBroadcast,
+                                 node.getNodeID(), uavcan::NodeID::Broadcast, tid);
+    expected_frame.setPayload(payload, 7);
+    expected_frame.setStartOfTransfer(true);
+    expected_frame.setEndOfTransfer(true);
+
+    uavcan::CanFrame expected_can_frame;
+    ASSERT_TRUE(expected_frame.compile(expected_can_frame));
+
+    ASSERT_TRUE(can_driver.ifaces[0].matchAndPopTx(expected_can_frame, tx_timeout_usec + 100));
+    ASSERT_TRUE(can_driver.ifaces[1].matchAndPopTx(expected_can_frame, tx_timeout_usec + 100));
+    ASSERT_TRUE(can_driver.ifaces[0].tx.empty());
+    ASSERT_TRUE(can_driver.ifaces[1].tx.empty());
+}
+
+TEST(Publisher, ScratchBuffer)
+{
+    SystemClockMock clock_mock(100);
+    CanDriverMock can_driver(2, clock_mock);
+    TestNode node(can_driver, clock_mock, 1);
+
+    // Manual type registration - we can't rely on the GDTR state
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<root_ns_a::MavlinkMessage> _registrator;
+
+    uavcan::Publisher<root_ns_a::MavlinkMessage> publisher(node);
+    ASSERT_FALSE(publisher.getScratchBuffer());
+
+    // Too small for this data type
+    uavcan::OutgoingTransferBuffer<16> small_buffer((uavcan::TransferCRC()));
+    ASSERT_EQ(-uavcan::ErrInvalidParam, publisher.setScratchBuffer(&small_buffer));
+    ASSERT_FALSE(publisher.getScratchBuffer());
+
+    uavcan::OutgoingTransferBuffer<260> buffer((uavcan::TransferCRC()));
+    ASSERT_EQ(0, publisher.setScratchBuffer(&buffer));
+    ASSERT_EQ(&buffer, publisher.getScratchBuffer());
+
+    root_ns_a::MavlinkMessage msg;
+    msg.seq = 0x42;
+    msg.sysid = 0x72;
+    msg.compid = 0x08;
+    msg.msgid = 0xa5;
+    msg.payload = "Msg";
+
+    const uint8_t expected_transfer_payload[] = {0x42, 0x72, 0x08, 0xa5, 'M', 's', 'g'};
+    const uint64_t tx_timeout_usec = uint64_t(publisher.getDefaultTxTimeout().toUSec());
+
+    /*
+     * The frames are the same as with the stack buffer; the buffer is reused
+     */
+    for (uint8_t tid = 0; tid < 2; tid++)
+    {
+        ASSERT_LT(0, publisher.broadcast(msg));
+        expectBroadcastFrame(can_driver, node, expected_transfer_payload, tid, tx_timeout_usec);
+
+        ASSERT_EQ(7, buffer.getMaxWritePos());
+        ASSERT_TRUE(std::equal(expected_transfer_payload, expected_transfer_payload + 7, buffer.getRawPtr()));
+    }
+
+    /*
+     * Back to the stack buffer - the scratch buffer is left intact
+     */
+    ASSERT_EQ(0, publisher.setScratchBuffer(NULL));
+    ASSERT_FALSE(publisher.getScratchBuffer());
+
+    msg.seq = 0x43;
+    const uint8_t next_transfer_payload[] = {0x43, 0x72, 0x08, 0xa5, 'M', 's', 'g'};
+    ASSERT_LT(0, publisher.broadcast(msg));
+    expectBroadcastFrame(can_driver, node, next_transfer_payload, 2, tx_timeout_usec);
+
+    ASSERT_TRUE(std::equal(expected_transfer_payload, expected_transfer_payload + 7, buffer.getRawPtr()));
+}
@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include <uavcan/node/raw_subscriber.hpp>
+#include <uavcan/util/method_binder.hpp>
+#include <root_ns_a/MavlinkMessage.hpp>
+#include "../clock.hpp"
+#include "../transport/can/can.hpp"
+#include "test_node.hpp"
+
+
+struct RawTransferListener
+{
+    struct Record
+    {
+        std::string payload;
+        std::string contiguous_payload;
+        uavcan::NodeID src_node_id;
+        uavcan::TransferID transfer_id;
+        uavcan::MonotonicTime ts_monotonic;
+        uavcan::uint8_t iface_index;
+    };
+
+    std::vector<Record> records;
+
+    void receive(uavcan::IncomingTransfer& transfer)
+    {
+        Record rec;
+        uint8_t buf[256];
+        const int res = transfer.read(0, buf, sizeof(buf));
+        if (res > 0)
+        {
+            rec.payload.assign(reinterpret_cast<const char*>(buf), unsigned(res));
+        }
+        unsigned len = 0;
+        const uint8_t* const data = transfer.getContiguousData(len);
+        if (data != NULL)
+        {
+            rec.contiguous_payload.assign(reinterpret_cast<const char*>(data), len);
+        }
+        rec.src_node_id = transfer.getSrcNodeID();
+        rec.transfer_id = transfer.getTransferID();
+        rec.ts_monotonic = transfer.getMonotonicTimestamp();
+        rec.iface_index = transfer.getIfaceIndex();
+        records.push_back(rec);
+    }
+
+    typedef uavcan::MethodBinder<RawTransferListener*, void (RawTransferListener::*)(uavcan::IncomingTransfer&)>
+        Binder;
+
+    Binder bind() { return Binder(this, &RawTransferListener::receive); }
+};
+
+
+TEST(RawSubscriber, Basic)
+{
+    // Manual type registration - we can't rely on the GDTR state
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<root_ns_a::MavlinkMessage> _registrator;
+
+    SystemClockDriver clock_driver;
+    CanDriverMock can_driver(2, clock_driver);
+    TestNode node(can_driver, clock_driver, 1);
+
+    uavcan::RawSubscriber<root_ns_a::MavlinkMessage, RawTransferListener::Binder> sub(node);
+
+    // Null binder - will fail
+    ASSERT_EQ(-uavcan::ErrInvalidParam, sub.start(RawTransferListener::Binder(NULL, NULL)));
+
+    RawTransferListener listener;
+
+    const uint8_t transfer_payload[] = {0x42, 0x72, 0x08, 0xa5, 'M', 's', 'g'};
+    const std::string expected_payload(reinterpret_cast<const char*>(transfer_payload), sizeof(transfer_payload));
+
+    std::vector<uavcan::RxFrame> rx_frames;
+    for (uint8_t i = 0; i < 3; i++)
+    {
+        uavcan::Frame frame(root_ns_a::MavlinkMessage::DefaultDataTypeID, uavcan::TransferTypeMessageBroadcast,
+                            uavcan::NodeID(uint8_t(i + 100)), uavcan::NodeID::Broadcast, i);
+        frame.setStartOfTransfer(true);
+        frame.setEndOfTransfer(true);
+        frame.setPayload(transfer_payload, sizeof(transfer_payload));
+        rx_frames.push_back(uavcan::RxFrame(frame, clock_driver.getMonotonic(), clock_driver.getUtc(), 1));
+    }
+
+    ASSERT_EQ(0, sub.start(listener.bind()));
+    ASSERT_EQ(1, node.getDispatcher().getNumMessageListeners());
+
+    for (unsigned i = 0; i < rx_frames.size(); i++)
+    {
+        can_driver.ifaces[1].pushRx(rx_frames[i]);
+    }
+
+    ASSERT_LE(0, node.spin(clock_driver.getMonotonic() + durMono(10000)));
+
+    ASSERT_EQ(rx_frames.size(), listener.records.size());
+    for (unsigned i = 0; i < rx_frames.size(); i++)
+    {
+        const RawTransferListener::Record& rec = listener.records.at(i);
+        ASSERT_EQ(expected_payload, rec.payload);
+        ASSERT_EQ(expected_payload, rec.contiguous_payload);    // Single frame transfers are contiguous
+        ASSERT_EQ(rx_frames[i].getSrcNodeID(), rec.src_node_id);
+        ASSERT_EQ(rx_frames[i].getTransferID(), rec.transfer_id);
+        ASSERT_EQ(rx_frames[i].getMonotonicTimestamp(), rec.ts_monotonic);
+        ASSERT_EQ(1, rec.iface_index);
+    }
+
+    sub.stop();
+    ASSERT_EQ(0, node.getDispatcher().getNumMessageListeners());
+}
@@ -0,0 +1,305 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <vector>
+#include <gtest/gtest.h>
+#include <uavcan/node/retrying_service_client.hpp>
+#include <uavcan/node/service_rtt_estimator.hpp>
+#include <uavcan/node/service_server.hpp>
+#include <uavcan/util/method_binder.hpp>
+#include <root_ns_a/StringService.hpp>
+#include "test_node.hpp"
+
+
+namespace
+{
+
+struct ResultCollector
+{
+    std::vector<bool> results;              ///< Success or failure, in the order of arrival
+    root_ns_a::StringService::Response last_response;
+
+    void handle(const uavcan::ServiceCallResult<root_ns_a::StringService>& result)
+    {
+        results.push_back(result.isSuccessful());
+        last_response = result.getResponse();
+    }
+
+    typedef uavcan::MethodBinder<ResultCollector*,
+        void (ResultCollector::*)(const uavcan::ServiceCallResult<root_ns_a::StringService>&)> Binder;
+
+    Binder bind() { return Binder(this, &ResultCollector::handle); }
+};
+
+/**
+ * Ignores the specified number of requests, then responds.
+ */
+struct FlakyServer
+{
+    unsigned num_to_ignore;
+    unsigned num_requests;
+
+    FlakyServer() : num_to_ignore(0), num_requests(0) { }
+
+    void handle(const uavcan::ReceivedDataStructure<root_ns_a::StringService::Request>& req,
+                uavcan::ServiceResponseDataStructure<root_ns_a::StringService::Response>& rsp)
+    {
+        num_requests++;
+        rsp.string_response = req.string_request;
+        rsp.setResponseEnabled(num_requests > num_to_ignore);
+    }
+
+    typedef uavcan::MethodBinder<FlakyServer*,
+        void (FlakyServer::*)(const uavcan::ReceivedDataStructure<root_ns_a::StringService::Request>&,
+                              uavcan::ServiceResponseDataStructure<root_ns_a::StringService::Response>&)> Binder;
+
+    Binder bind() { return Binder(this, &FlakyServer::handle); }
+};
+
+}
+
+using uavcan::MonotonicDuration;
+
+
+TEST(ServiceRttEstimator, Basic)
+{
+    uavcan::ServiceRttEstimator<2> est;
+    ASSERT_EQ(2, est.getCapacity());
+
+    const MonotonicDuration default_timeout = MonotonicDuration::fromMSec(500);
+
+    // Unknown server
+    ASSERT_EQ(default_timeout, est.getRequestTimeout(10, default_timeout));
+    ASSERT_TRUE(est.getSmoothedRtt(10).isZero());
+    ASSERT_EQ(default_timeout, est.getRequestTimeout(uavcan::NodeID(), default_timeout));
+
+    // First sample
+    est.addSample(10, MonotonicDuration::fromUSec(100000));
+    ASSERT_EQ(100000, est.getSmoothedRtt(10).toUSec());
+    ASSERT_EQ(50000, est.getRttVariation(10).toUSec());
+    ASSERT_EQ(300000, est.getRequestTimeout(10, default_timeout).toUSec());
+
+    // Smoothing
+    est.addSample(10, MonotonicDuration::fromUSec(200000));
+    ASSERT_EQ(112500, est.getSmoothedRtt(10).toUSec());
+    ASSERT_EQ(62500, est.getRttVariation(10).toUSec());
+    ASSERT_EQ(362500, est.getRequestTimeout(10, default_timeout).toUSec());
+
+    // Backoff until the next sample
+    est.addTimeout(10);
+    ASSERT_EQ(725000, est.getRequestTimeout(10, default_timeout).toUSec());
+    est.addTimeout(10);
+    ASSERT_EQ(1450000, est.getRequestTimeout(10, default_timeout).toUSec());
+    est.addSample(10, MonotonicDuration::fromUSec(112500));
+    ASSERT_EQ(112500, est.getSmoothedRtt(10).toUSec());
+    ASSERT_EQ(46875, est.getRttVariation(10).toUSec());
+    ASSERT_EQ(300000, est.getRequestTimeout(10, default_timeout).toUSec());
+
+    // Backoff is limited
+    for (int i = 0; i < 100; i++)
+    {
+        est.addTimeout(10);
+    }
+    ASSERT_EQ(300000 << est.MaxBackoffShift, est.getRequestTimeout(10, default_timeout).toUSec());
+
+    // Server that has never responded - the default timeout is backed off
+    est.addTimeout(20);
+    ASSERT_TRUE(est.getSmoothedRtt(20).isZero());
+    ASSERT_EQ(default_timeout * 2, est.getRequestTimeout(20, default_timeout));
+
+    // No free entries - the least recently updated one is reused
+    est.addSample(30, MonotonicDuration::fromUSec(1000));
+    ASSERT_TRUE(est.getSmoothedRtt(10).isZero());
+    ASSERT_EQ(default_timeout, est.getRequestTimeout(10, default_timeout));
+    ASSERT_EQ(default_timeout * 2, est.getRequestTimeout(20, default_timeout));
+    ASSERT_EQ(1000, est.getSmoothedRtt(30).toUSec());
+
+    est.reset();
+    ASSERT_TRUE(est.getSmoothedRtt(30).isZero());
+    ASSERT_EQ(default_timeout, est.getRequestTimeout(20, default_timeout));
+}
+
+
+TEST(RetryBackoff, Basic)
+{
+    uavcan::RetryBackoff backoff;
+    ASSERT_EQ(uavcan::RetryBackoff::getDefaultInitialDelay(), backoff.getInitialDelay());
+    ASSERT_EQ(uavcan::RetryBackoff::getDefaultMaxDelay(), backoff.getMaxDelay());
+
+    // No jitter
+    backoff.configure(MonotonicDuration::fromMSec(100), MonotonicDuration::fromMSec(500), 0);
+    ASSERT_EQ(0, backoff.getNumAttempts());
+    ASSERT_EQ(100, backoff.getNextDelay().toMSec());
+    ASSERT_EQ(200, backoff.getNextDelay().toMSec());
+    ASSERT_EQ(400, backoff.getNextDelay().toMSec());
+    ASSERT_EQ(500, backoff.getNextDelay().toMSec());
+    ASSERT_EQ(500, backoff.getNextDelay().toMSec());
+    ASSERT_EQ(5, backoff.getNumAttempts());
+
+    backoff.reset();
+    ASSERT_EQ(0, backoff.getNumAttempts());
+    ASSERT_EQ(100, backoff.getNextDelay().toMSec());
+
+    // Jitter - the delays are spread within the range
+    backoff.configure(MonotonicDuration::fromMSec(100), MonotonicDuration::fromMSec(100), 50);
+    backoff.seed(12345);
+    int64_t min_usec = 100000;
+    int64_t max_usec = 0;
+    for (int i = 0; i < 1000; i++)
+    {
+        const int64_t usec = backoff.getNextDelay().toUSec();
+        ASSERT_LE(50000, usec);
+        ASSERT_GE(100000, usec);
+        min_usec = std::min(min_usec, usec);
+        max_usec = std::max(max_usec, usec);
+    }
+    ASSERT_GT(55000, min_usec);
+    ASSERT_LT(95000, max_usec);
+
+    // Different seeds give different sequences
+    uavcan::RetryBackoff other;
+    other.configure(MonotonicDuration::fromMSec(100), MonotonicDuration::fromMSec(100), 50);
+    other.seed(54321);
+    backoff.seed(12345);
+    bool differ = false;
+    for (int i = 0; i < 10; i++)
+    {
+        differ = differ || (backoff.getNextDelay() != other.getNextDelay());
+    }
+    ASSERT_TRUE(differ);
+
+    // Invalid configuration is corrected
+    backoff.configure(MonotonicDuration::fromMSec(100), MonotonicDuration::fromMSec(10), 200);
+    ASSERT_EQ(100, backoff.getMaxDelay().toMSec());
+    ASSERT_EQ(100, backoff.getJitterPercent());
+}
+
+
+TEST(ServiceClient, RttEstimator)
+{
+    InterlinkedTestNodesWithSysClock nodes;
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<root_ns_a::StringService> _registrator;
+
+    FlakyServer server_logic;
+    uavcan::ServiceServer<root_ns_a::StringService, FlakyServer::Binder> server(nodes.a);
+    ASSERT_EQ(0, server.start(server_logic.bind()));
+
+    ResultCollector collector;
+    uavcan::ServiceClient<root_ns_a::StringService, ResultCollector::Binder> client(nodes.b, collector.bind());
+    client.setRequestTimeout(MonotonicDuration::fromMSec(1000));
+
+    uavcan::ServiceRttEstimator<4> est;
+    ASSERT_FALSE(client.getRttEstimator());
+    client.setRttEstimator(&est);
+    ASSERT_EQ(&est, client.getRttEstimator());
+
+    root_ns_a::StringService::Request request;
+    request.string_request = "Ping";
+
+    // The response is sampled
+    ASSERT_LE(0, client.call(1, request));
+    nodes.spinBoth(MonotonicDuration::fromMSec(20));
+    ASSERT_EQ(1, collector.results.size());
+    ASSERT_TRUE(collector.results[0]);
+    ASSERT_LT(0, est.getSmoothedRtt(1).toUSec());
+    ASSERT_GT(10000, est.getSmoothedRtt(1).toUSec());
+
+    // The next call times out much sooner than the fixed request timeout would allow
+    server_logic.num_to_ignore = 100;
+    ASSERT_LE(0, client.call(1, request));
+    nodes.spinBoth(MonotonicDuration::fromMSec(200));
+    ASSERT_EQ(2, collector.results.size());
+    ASSERT_FALSE(collector.results[1]);
+
+    // The timeout has been reported, but the adaptive timeout is still bounded
+    const MonotonicDuration timeout = est.getRequestTimeout(1, client.getRequestTimeout());
+    ASSERT_GT(MonotonicDuration::fromMSec(200), timeout);
+
+    // Servers that have never responded get the fixed timeout
+    ASSERT_EQ(client.getRequestTimeout(), est.getRequestTimeout(2, client.getRequestTimeout()));
+
+    client.setRttEstimator(NULL);
+    ASSERT_FALSE(client.getRttEstimator());
+}
+
+
+TEST(RetryingServiceClient, Basic)
+{
+    InterlinkedTestNodesWithSysClock nodes;
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<root_ns_a::StringService> _registrator;
+
+    FlakyServer server_logic;
+    uavcan::ServiceServer<root_ns_a::StringService, FlakyServer::Binder> server(nodes.a);
+    ASSERT_EQ(0, server.start(server_logic.bind()));
+
+    ResultCollector collector;
+    typedef uavcan::RetryingServiceClient<root_ns_a::StringService, ResultCollector::Binder> ClientType;
+    ClientType client(nodes.b);
+
+    root_ns_a::StringService::Request request;
+    request.string_request = "Ping";
+
+    // No callback
+    ASSERT_EQ(-uavcan::ErrInvalidConfiguration, client.call(1, request));
+    ASSERT_FALSE(client.isPending());
+
+    client.setCallback(collector.bind());
+    ASSERT_EQ(0, client.init());
+    ASSERT_EQ(unsigned(ClientType::DefaultMaxAttempts), client.getMaxAttempts());
+    client.getServiceClient().setRequestTimeout(MonotonicDuration::fromMSec(50));
+    client.getBackoff().configure(MonotonicDuration::fromMSec(10), MonotonicDuration::fromMSec(20), 50);
+
+    /*
+     * Two attempts are ignored, the third one succeeds
+     */
+    server_logic.num_to_ignore = 2;
+    ASSERT_LE(0, client.call(1, request));
+    ASSERT_TRUE(client.isPending());
+
+    nodes.spinBoth(MonotonicDuration::fromMSec(300));
+    ASSERT_FALSE(client.isPending());
+    ASSERT_EQ(1, collector.results.size());
+    ASSERT_TRUE(collector.results[0]);
+    ASSERT_EQ("Ping", collector.last_response.string_response);
+    ASSERT_EQ(3, server_logic.num_requests);
+    ASSERT_EQ(2, client.getNumRetries());
+
+    /*
+     * All attempts are ignored - one failure is reported
+     */
+    server_logic.num_requests = 0;
+    server_logic.num_to_ignore = 100;
+    client.setMaxAttempts(2);
+    ASSERT_LE(0, client.call(1, request));
+
+    nodes.spinBoth(MonotonicDuration::fromMSec(300));
+    ASSERT_FALSE(client.isPending());
+    ASSERT_EQ(2, collector.results.size());
+    ASSERT_FALSE(collector.results[1]);
+    ASSERT_EQ(2, server_logic.num_requests);
+    ASSERT_EQ(1, client.getNumRetries());
+
+    /*
+     * Cancellation - no callback
+     */
+    server_logic.num_requests = 0;
+    ASSERT_LE(0, client.call(1, request));
+    nodes.spinBoth(MonotonicDuration::fromMSec(60));                // First attempt timed out, retry scheduled
+    ASSERT_TRUE(client.isPending());
+    client.cancel();
+    ASSERT_FALSE(client.isPending());
+    ASSERT_FALSE(client.getServiceClient().hasPendingCalls());
+
+    nodes.spinBoth(MonotonicDuration::fromMSec(200));
+    ASSERT_EQ(2, collector.results.size());
+    ASSERT_GE(2, server_logic.num_requests);
+
+    // At least one attempt
+    client.setMaxAttempts(0);
+    ASSERT_EQ(1, client.getMaxAttempts());
+}
@@ -2,8 +2,11 @@
  * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
  */
 
+#include <cstdlib>
+#include <algorithm>
 #include <gtest/gtest.h>
 #include <uavcan/node/timer.hpp>
+#include <uavcan/node/generic_subscriber.hpp>
 #include <uavcan/util/method_binder.hpp>
 #include "../clock.hpp"
 #include "../transport/can/can.hpp"
@@ -90,6 +93,500 @@ TEST(Scheduler, Timers)
     ASSERT_EQ(0, node.spin(durMono(1000)));                                    // Spin some more without timers
 }
 
+namespace
+{
+
+struct RecordingDeadlineHandler : public uavcan::DeadlineHandler
+{
+    uavcan::MonotonicTime fired_at;
+    unsigned num_fired;
+
+    explicit RecordingDeadlineHandler(uavcan::Scheduler& scheduler)
+        : uavcan::DeadlineHandler(scheduler)
+        , num_fired(0)
+    { }
+
+    virtual void handleDeadline(uavcan::MonotonicTime current)
+    {
+        fired_at = current;
+        num_fired++;
+    }
+};
+
+}
+
+TEST(Scheduler, DeadlineOrdering)
+{
+    SystemClockMock clock_mock(1000000);
+    CanDriverMock can_driver(1, clock_mock);
+    TestNode node(can_driver, clock_mock, 1);
+    uavcan::DeadlineScheduler& ds = node.getScheduler().getDeadlineScheduler();
+
+    static const unsigned NumHandlers = 300;
+    std::vector<RecordingDeadlineHandler*> handlers;
+    for (unsigned i = 0; i < NumHandlers; i++)
+    {
+        handlers.push_back(new RecordingDeadlineHandler(node.getScheduler()));
+    }
+
+    // Deadlines from overdue to much further than an hour ahead, some of them re-armed or stopped
+    std::srand(42);
+    for (unsigned i = 0; i < NumHandlers; i++)
+    {
+        const uint64_t ranges[] = { 1, 1000, 40000, 2000000, 60000000, 4000000000ULL };
+        const uint64_t range = ranges[i % (sizeof(ranges) / sizeof(ranges[0]))];
+        const uint64_t delay = uint64_t(std::rand()) % range;
+        handlers[i]->startWithDeadline(clock_mock.getMonotonic() + durMono(int64_t(delay)) - durMono(500));
+        if ((i % 7) == 0)
+        {
+            handlers[i]->startWithDelay(durMono(int64_t(delay / 2 + 1)));    // Re-armed
+        }
+    }
+    for (unsigned i = 0; i < NumHandlers; i += 11)
+    {
+        handlers[i]->stop();
+    }
+    unsigned num_running = 0;
+    for (unsigned i = 0; i < NumHandlers; i++)
+    {
+        ASSERT_EQ((i % 11) != 0, handlers[i]->isRunning());
+        num_running += handlers[i]->isRunning() ? 1U : 0U;
+    }
+    ASSERT_EQ(num_running, ds.getNumHandlers());
+
+    // Polling at irregular intervals; each handler must fire at the first poll after its deadline
+    std::vector<uavcan::MonotonicTime> deadlines(NumHandlers);
+    std::vector<bool> running(NumHandlers);
+    for (unsigned i = 0; i < NumHandlers; i++)
+    {
+        deadlines[i] = handlers[i]->getDeadline();
+        running[i] = handlers[i]->isRunning();
+    }
+    uavcan::MonotonicTime prev_poll = clock_mock.getMonotonic();
+    while (ds.getNumHandlers() > 0)
+    {
+        uavcan::MonotonicTime earliest = uavcan::MonotonicTime::getMax();
+        for (unsigned i = 0; i < NumHandlers; i++)
+        {
+            if (handlers[i]->isRunning())
+            {
+                earliest = std::min(earliest, handlers[i]->getDeadline());
+            }
+        }
+        ASSERT_GE(earliest, ds.getEarliestDeadline());   // Never later than the earliest deadline
+        if (prev_poll.toUSec() > 1000000)
+        {
+            ASSERT_LT(prev_poll, ds.getEarliestDeadline());  // Nothing is overdue after a poll
+        }
+
+        const uint64_t step = (std::rand() % 3 == 0) ? uint64_t(std::rand() % 3000) : uint64_t(std::rand() % 300000);
+        clock_mock.monotonic = std::max(clock_mock.monotonic + 1,
+                                        std::min(clock_mock.monotonic + step, ds.getEarliestDeadline().toUSec()));
+        const uavcan::MonotonicTime ts = ds.pollAndGetMonotonicTime(clock_mock);
+        for (unsigned i = 0; i < NumHandlers; i++)
+        {
+            if (running[i] && (deadlines[i] <= ts))
+            {
+                ASSERT_EQ(1, handlers[i]->num_fired) << i;
+                ASSERT_EQ(ts, handlers[i]->fired_at) << i;
+                if (prev_poll.toUSec() > 1000000)
+                {
+                    ASSERT_LT(prev_poll, deadlines[i]) << i;
+                }
+                running[i] = false;
+            }
+        }
+        prev_poll = ts;
+    }
+    for (unsigned i = 0; i < NumHandlers; i++)
+    {
+        ASSERT_FALSE(running[i]);
+        ASSERT_EQ(((i % 11) != 0) ? 1U : 0U, handlers[i]->num_fired);
+        handlers[i]->startWithDelay(durMono(int64_t(i)));
+        delete handlers[i];                                 // Stops the handler
+    }
+    ASSERT_EQ(0, ds.getNumHandlers());
+    ASSERT_EQ(uavcan::MonotonicTime::getMax(), ds.getEarliestDeadline());
+}
+
+TEST(Scheduler, Tickless)
+{
+    SystemClockMock clock_mock(100);
+    CanDriverMock can_driver(2, clock_mock);
+    TestNode node(can_driver, clock_mock, 1);
+
+    TimerCallCounter tcc;
+    uavcan::TimerEventForwarder<TimerCallCounter::Binder> a(node, tcc.bindA());
+    a.startPeriodic(durMono(50000));
+
+    // Fixed resolution - the driver is polled every 5 ms
+    ASSERT_EQ(uavcan::Scheduler::SpinModeFixedResolution, node.getScheduler().getSpinMode());
+    uint32_t wakeups = node.getDispatcher().getNumWakeups();
+    ASSERT_EQ(0, node.spin(durMono(1000000)));
+    ASSERT_EQ(20, tcc.events_a.size());
+    ASSERT_LE(200, node.getDispatcher().getNumWakeups() - wakeups);
+
+    // Tickless - woken up only by the timer and the periodic cleanup
+    node.getScheduler().setSpinMode(uavcan::Scheduler::SpinModeTickless);
+    tcc.events_a.clear();
+    wakeups = node.getDispatcher().getNumWakeups();
+    ASSERT_EQ(0, node.spin(durMono(1000000)));
+    ASSERT_EQ(20, tcc.events_a.size());
+    ASSERT_GE(20 + 2, node.getDispatcher().getNumWakeups() - wakeups);
+    for (unsigned i = 0; i < tcc.events_a.size(); i++)
+    {
+        ASSERT_EQ(tcc.events_a[i].scheduled_time, tcc.events_a[i].real_time);
+    }
+
+    // Queued frame expiration is a wakeup reason as well
+    can_driver.ifaces.at(0).writeable = false;
+    can_driver.ifaces.at(1).writeable = false;
+    a.stop();
+    const uavcan::MonotonicTime tx_deadline = clock_mock.getMonotonic() + durMono(1000);
+    ASSERT_EQ(0, node.getDispatcher().getCanIOManager().send(makeCanFrame(1, "a", EXT), tx_deadline,
+                                                             uavcan::MonotonicTime(), 3,
+                                                             uavcan::CanTxQueue::Volatile, 0));
+    ASSERT_EQ(tx_deadline, node.getDispatcher().getCanIOManager().getEarliestTxDeadline());
+    ASSERT_EQ(0, node.spin(tx_deadline + durMono(10000)));
+    ASSERT_EQ(uavcan::MonotonicTime::getMax(), node.getDispatcher().getCanIOManager().getEarliestTxDeadline());
+    ASSERT_EQ(1, node.getDispatcher().getCanIOManager().getIfacePerfCounters(0).errors);
+}
+
+TEST(Scheduler, NextWakeupTime)
+{
+    SystemClockMock clock_mock(100);
+    CanDriverMock can_driver(2, clock_mock);
+    TestNode node(can_driver, clock_mock, 1);
+    uavcan::Scheduler& sch = node.getScheduler();
+    sch.setCleanupPeriod(durMono(1000000));
+
+    // Nothing but the cleanup
+    const uavcan::MonotonicTime cleanup = clock_mock.getMonotonic() + durMono(1000000) + durMono(1);
+    ASSERT_EQ(cleanup, sch.getNextWakeupTime());
+
+    // Timers
+    TimerCallCounter tcc;
+    uavcan::TimerEventForwarder<TimerCallCounter::Binder> a(node, tcc.bindA());
+    a.startOneShotWithDelay(durMono(50000));
+    const uavcan::MonotonicTime timer_deadline = clock_mock.getMonotonic() + durMono(50000);
+    ASSERT_EQ(timer_deadline, sch.getNextWakeupTime());
+
+    // External event loop - nothing happens until the reported time
+    clock_mock.advance(49999);
+    ASSERT_LE(0, node.spinOnce());
+    ASSERT_EQ(0, tcc.events_a.size());
+    ASSERT_EQ(timer_deadline, sch.getNextWakeupTime());
+
+    clock_mock.advance(1);
+    ASSERT_LE(0, node.spinOnce());
+    ASSERT_EQ(1, tcc.events_a.size());
+    ASSERT_EQ(cleanup, sch.getNextWakeupTime());
+
+    // Queued TX frames
+    can_driver.ifaces.at(0).writeable = false;
+    can_driver.ifaces.at(1).writeable = false;
+    const uavcan::MonotonicTime tx_deadline = clock_mock.getMonotonic() + durMono(1000);
+    ASSERT_EQ(0, node.getDispatcher().getCanIOManager().send(makeCanFrame(1, "a", EXT), tx_deadline,
+                                                             uavcan::MonotonicTime(), 3,
+                                                             uavcan::CanTxQueue::Volatile, 0));
+    ASSERT_EQ(tx_deadline + durMono(1), sch.getNextWakeupTime());
+}
+
+struct DeferredCallbackRecorder : public uavcan::DeferredCallbackHandler
+{
+    std::vector<int>& log;
+    const int id;
+    int num_reschedules;
+
+    DeferredCallbackRecorder(uavcan::Scheduler& sch, uavcan::DeferredCallbackPriority prio,
+                             std::vector<int>& arg_log, int arg_id, int arg_num_reschedules = 0)
+        : uavcan::DeferredCallbackHandler(sch, prio)
+        , log(arg_log)
+        , id(arg_id)
+        , num_reschedules(arg_num_reschedules)
+    { }
+
+    void handleDeferredCallback()
+    {
+        log.push_back(id);
+        if (num_reschedules-- > 0)
+        {
+            schedule();
+        }
+    }
+};
+
+TEST(Scheduler, DeferredCallbacks)
+{
+    SystemClockMock clock_mock(100);
+    CanDriverMock can_driver(2, clock_mock);
+    TestNode node(can_driver, clock_mock, 1);
+    uavcan::Scheduler& sch = node.getScheduler();
+
+    std::vector<int> log;
+    DeferredCallbackRecorder low(sch, uavcan::DeferredCallbackPriorityLow, log, 1, 1);
+    DeferredCallbackRecorder normal_a(sch, uavcan::DeferredCallbackPriorityNormal, log, 2, 1);
+    DeferredCallbackRecorder critical(sch, uavcan::DeferredCallbackPriorityCritical, log, 3);
+    DeferredCallbackRecorder normal_b(sch, uavcan::DeferredCallbackPriorityNormal, log, 4);
+
+    low.schedule();
+    normal_a.schedule();
+    critical.schedule();
+    normal_b.schedule();
+    normal_b.schedule();        // No effect
+    ASSERT_EQ(4, sch.getDeferredCallbackScheduler().getNumHandlers());
+    ASSERT_TRUE(normal_b.isScheduled());
+
+    // Pending callbacks don't wait for anything
+    ASSERT_EQ(uavcan::MonotonicTime(), sch.getNextWakeupTime());
+
+    ASSERT_LE(0, node.spinOnce());
+    const int expected[] = { 3, 2, 4, 2, 1, 1 };
+    ASSERT_EQ(std::vector<int>(expected, expected + 6), log);
+    ASSERT_TRUE(sch.getDeferredCallbackScheduler().isEmpty());
+    ASSERT_FALSE(low.isScheduled());
+
+    // Priority change and cancellation
+    log.clear();
+    low.schedule();
+    critical.schedule();
+    normal_b.schedule();
+    low.setPriority(uavcan::DeferredCallbackPriorityCritical);
+    critical.cancel();
+    ASSERT_LE(0, node.spin(durMono(1000)));
+    const int expected2[] = { 1, 4 };
+    ASSERT_EQ(std::vector<int>(expected2, expected2 + 2), log);
+
+    // Nothing is left behind when the handler is destroyed
+    {
+        DeferredCallbackRecorder tmp(sch, uavcan::DeferredCallbackPriorityLow, log, 5);
+        tmp.schedule();
+        ASSERT_EQ(1, sch.getDeferredCallbackScheduler().getNumHandlers());
+    }
+    ASSERT_TRUE(sch.getDeferredCallbackScheduler().isEmpty());
+}
+
+#if !UAVCAN_TINY
+
+struct DeferredTransferRecorder : public uavcan::DeferredTransferQueue
+{
+    std::vector<std::string> payloads;
+    std::vector<uavcan::TransferID> tids;
+    std::vector<uavcan::MonotonicTime> timestamps;
+
+    DeferredTransferRecorder(uavcan::INode& node)
+        : uavcan::DeferredTransferQueue(node.getScheduler(), node.getAllocator())
+    { }
+
+    void handleDeferredTransfer(uavcan::IncomingTransfer& transfer)
+    {
+        uint8_t buf[256];
+        const int res = transfer.read(0, buf, sizeof(buf));
+        payloads.push_back((res > 0) ? std::string(reinterpret_cast<const char*>(buf), unsigned(res)) : "");
+        tids.push_back(transfer.getTransferID());
+        timestamps.push_back(transfer.getMonotonicTimestamp());
+        transfer.release();
+        ASSERT_GT(0, transfer.read(0, buf, sizeof(buf)));
+    }
+};
+
+struct StringIncomingTransfer : public uavcan::IncomingTransfer
+{
+    const std::string payload;
+
+    StringIncomingTransfer(uint64_t ts_mono_usec, uint8_t tid, const std::string& arg_payload)
+        : uavcan::IncomingTransfer(tsMono(ts_mono_usec), uavcan::UtcTime(), uavcan::TransferPriority::Default,
+                                   uavcan::TransferTypeMessageBroadcast, uavcan::TransferID(tid),
+                                   uavcan::NodeID(42), 0)
+        , payload(arg_payload)
+    { }
+
+    int read(unsigned offset, uint8_t* data, unsigned len) const      // Read in small pieces
+    {
+        if (offset >= payload.size())
+        {
+            return 0;
+        }
+        len = std::min(std::min(len, 5U), unsigned(payload.size() - offset));
+        std::copy(payload.begin() + long(offset), payload.begin() + long(offset + len), data);
+        return int(len);
+    }
+};
+
+TEST(Scheduler, DeferredTransferQueue)
+{
+    SystemClockMock clock_mock(100);
+    CanDriverMock can_driver(2, clock_mock);
+    TestNode node(can_driver, clock_mock, 1);
+
+    DeferredTransferRecorder queue(node);
+    queue.setCapacity(2);
+
+    const std::string long_payload(100, 'x');
+    StringIncomingTransfer a(1000, 1, "first");
+    StringIncomingTransfer b(2000, 2, long_payload);
+    StringIncomingTransfer c(3000, 3, "");
+
+    ASSERT_EQ(0, queue.push(a, 128));
+    ASSERT_EQ(0, queue.push(b, 128));
+    ASSERT_EQ(0, queue.push(c, 128));     // The oldest one is dropped
+    ASSERT_EQ(2, queue.getLength());
+    ASSERT_EQ(1, queue.getDropCount());
+    ASSERT_TRUE(queue.isScheduled());
+    ASSERT_TRUE(queue.payloads.empty());
+
+    ASSERT_LE(0, node.spinOnce());
+    ASSERT_EQ(2, queue.payloads.size());
+    ASSERT_EQ(long_payload, queue.payloads[0]);
+    ASSERT_EQ("", queue.payloads[1]);
+    ASSERT_EQ(uavcan::TransferID(2), queue.tids[0]);
+    ASSERT_EQ(tsMono(3000), queue.timestamps[1]);
+    ASSERT_EQ(0, queue.getLength());
+    ASSERT_FALSE(queue.isScheduled());
+    ASSERT_EQ(0, node.pool.getNumAllocatedBlocks());
+
+    // Shrinking and clearing release the memory
+    ASSERT_EQ(0, queue.push(a, 128));
+    ASSERT_EQ(0, queue.push(b, 128));
+    ASSERT_LT(0, node.pool.getNumAllocatedBlocks());
+    queue.setCapacity(1);
+    ASSERT_EQ(1, queue.getLength());
+    ASSERT_EQ(2, queue.getDropCount());
+    queue.clear();
+    ASSERT_FALSE(queue.isScheduled());
+    ASSERT_EQ(0, node.pool.getNumAllocatedBlocks());
+    ASSERT_LE(0, node.spinOnce());
+    ASSERT_EQ(2, queue.payloads.size());
+}
+
+namespace
+{
+
+struct GroupMemberTimer : public uavcan::TimerBase
+{
+    std::vector<uavcan::TimerEvent> events;
+    uavcan::TimerBase* to_stop;
+
+    explicit GroupMemberTimer(uavcan::INode& node)
+        : uavcan::TimerBase(node)
+        , to_stop(NULL)
+    { }
+
+    virtual void handleTimerEvent(const uavcan::TimerEvent& event)
+    {
+        events.push_back(event);
+        if (to_stop != NULL)
+        {
+            to_stop->stop();
+        }
+    }
+};
+
+}
+
+TEST(Scheduler, TimerGroup)
+{
+    SystemClockMock clock_mock(100);
+    CanDriverMock can_driver(2, clock_mock);
+    TestNode node(can_driver, clock_mock, 1);
+    node.getScheduler().setSpinMode(uavcan::Scheduler::SpinModeTickless);
+    const uavcan::DeadlineScheduler& ds = node.getScheduler().getDeadlineScheduler();
+
+    GroupMemberTimer a(node);
+    GroupMemberTimer b(node);
+    GroupMemberTimer c(node);
+
+    {
+        uavcan::TimerGroup group(node, durMono(10000));
+        ASSERT_FALSE(group.isRunning());
+        ASSERT_EQ(0, ds.getNumHandlers());
+
+        /*
+         * All members take one scheduler entry and fire together
+         */
+        const uavcan::MonotonicTime start_ts = clock_mock.getMonotonic();
+        a.startPeriodic(group);
+        b.startPeriodic(group);
+        c.startPeriodic(group);
+
+        ASSERT_EQ(1, ds.getNumHandlers());
+        ASSERT_EQ(3, group.getNumMembers());
+        ASSERT_TRUE(group.isRunning());
+        ASSERT_TRUE(a.isRunning());
+        ASSERT_TRUE(a.getGroup() == &group);
+        ASSERT_EQ(10000, a.getPeriod().toUSec());
+        ASSERT_EQ(start_ts + durMono(10000), a.getDeadline());
+        ASSERT_EQ(group.getDeadline(), c.getDeadline());
+
+        ASSERT_EQ(0, node.spin(durMono(100000)));
+        ASSERT_EQ(10, a.events.size());
+        ASSERT_EQ(10, b.events.size());
+        ASSERT_EQ(10, c.events.size());
+        for (unsigned i = 0; i < a.events.size(); i++)
+        {
+            // No drift - the events are exactly one period apart from the start
+            ASSERT_EQ(start_ts + durMono(10000 * int64_t(i + 1)), a.events[i].scheduled_time);
+            ASSERT_EQ(a.events[i].scheduled_time, b.events[i].scheduled_time);
+            ASSERT_EQ(a.events[i].scheduled_time, c.events[i].scheduled_time);
+        }
+
+        /*
+         * Stopping a member that is yet to be dispatched - the members added last are dispatched first
+         */
+        a.events.clear();
+        b.events.clear();
+        c.events.clear();
+        c.to_stop = &b;
+        ASSERT_EQ(0, node.spin(durMono(10000)));
+        ASSERT_EQ(1, a.events.size());
+        ASSERT_EQ(0, b.events.size());
+        ASSERT_EQ(1, c.events.size());
+        ASSERT_FALSE(b.isRunning());
+        ASSERT_TRUE(b.getGroup() == NULL);
+        ASSERT_EQ(uavcan::MonotonicDuration::getInfinite(), b.getPeriod());
+        ASSERT_EQ(2, group.getNumMembers());
+        ASSERT_EQ(1, ds.getNumHandlers());
+
+        // Stopping itself
+        c.to_stop = &c;
+        ASSERT_EQ(0, node.spin(durMono(10000)));
+        ASSERT_EQ(2, a.events.size());
+        ASSERT_EQ(2, c.events.size());
+        ASSERT_FALSE(c.isRunning());
+        ASSERT_EQ(1, group.getNumMembers());
+
+        /*
+         * Restarting in a different mode removes the timer from the group; the group stops when empty
+         */
+        a.startPeriodic(durMono(10000));
+        ASSERT_TRUE(a.getGroup() == NULL);
+        ASSERT_TRUE(a.isRunning());
+        ASSERT_FALSE(group.isRunning());
+        ASSERT_EQ(1, ds.getNumHandlers());
+        a.stop();
+        ASSERT_EQ(0, ds.getNumHandlers());
+
+        /*
+         * Destroyed members leave the group
+         */
+        {
+            GroupMemberTimer tmp(node);
+            tmp.startPeriodic(group);
+            b.startPeriodic(group);
+            ASSERT_EQ(2, group.getNumMembers());
+        }
+        ASSERT_EQ(1, group.getNumMembers());
+        ASSERT_EQ(1, ds.getNumHandlers());
+    }
+
+    // Destroyed group stops its members
+    ASSERT_FALSE(b.isRunning());
+    ASSERT_TRUE(b.getGroup() == NULL);
+    ASSERT_EQ(0, ds.getNumHandlers());
+}
+
+#endif
+
 #if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
 
 TEST(Scheduler, TimerCpp11)
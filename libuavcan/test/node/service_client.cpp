@@ -4,6 +4,7 @@
 
 #include <gtest/gtest.h>
 #include <uavcan/node/service_client.hpp>
+#include <uavcan/node/multi_service_client.hpp>
 #include <uavcan/node/service_server.hpp>
 #include <uavcan/util/method_binder.hpp>
 #include <uavcan/protocol/RestartNode.hpp>
@@ -354,6 +355,78 @@ TEST(ServiceClient, ConcurrentCalls)
 }
 
 
+TEST(ServiceClient, PersistentResponseListener)
+{
+    InterlinkedTestNodesWithSysClock nodes;
+
+    // Type registration
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<root_ns_a::StringService> _registrator;
+
+    // Server
+    uavcan::ServiceServer<root_ns_a::StringService> server(nodes.a);
+    ASSERT_EQ(0, server.start(stringServiceServerCallback));
+
+    // Caller
+    typedef uavcan::ServiceCallResult<root_ns_a::StringService> ResultType;
+    typedef uavcan::ServiceClient<root_ns_a::StringService,
+                                  typename ServiceCallResultHandler<root_ns_a::StringService>::Binder > ClientType;
+    ServiceCallResultHandler<root_ns_a::StringService> handler;
+
+    {
+        ClientType client(nodes.b);
+        client.setCallback(handler.bind());
+
+        ASSERT_FALSE(client.isResponseListenerPersistent());
+        client.setPersistentResponseListener(true);
+        ASSERT_TRUE(client.isResponseListenerPersistent());
+
+        ASSERT_EQ(0, nodes.b.getDispatcher().getNumServiceResponseListeners()); // Registered with the first call
+
+        root_ns_a::StringService::Request request;
+        request.string_request = "Hello";
+
+        for (int i = 0; i < 3; i++)
+        {
+            ASSERT_LT(0, client.call(1, request));
+            ASSERT_EQ(1, nodes.b.getDispatcher().getNumServiceResponseListeners());
+
+            nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(20));
+
+            root_ns_a::StringService::Response expected_response;
+            expected_response.string_response = "Request string: Hello";
+            ASSERT_TRUE(handler.match(ResultType::Success, 1, expected_response));
+            ASSERT_FALSE(client.hasPendingCalls());
+
+            ASSERT_EQ(1, nodes.b.getDispatcher().getNumServiceResponseListeners()); // Still listening
+        }
+
+        // Timeouts and cancellations don't unregister the listener either
+        client.setRequestTimeout(uavcan::MonotonicDuration::fromMSec(100));
+        ASSERT_LT(0, client.call(99, request));
+        nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(150));
+        ASSERT_TRUE(handler.match(ResultType::ErrorTimeout, 99, root_ns_a::StringService::Response()));
+        ASSERT_EQ(1, nodes.b.getDispatcher().getNumServiceResponseListeners());
+
+        ASSERT_LT(0, client.call(99, request));
+        client.cancelAllCalls();
+        ASSERT_EQ(1, nodes.b.getDispatcher().getNumServiceResponseListeners());
+
+        // Leaving the persistent mode while idle unregisters the listener immediately
+        client.setPersistentResponseListener(false);
+        ASSERT_EQ(0, nodes.b.getDispatcher().getNumServiceResponseListeners());
+
+        // The destructor unregisters the listener even in the persistent mode
+        ASSERT_LT(0, client.call(1, request));
+        client.setPersistentResponseListener(true);
+        nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(20));
+        ASSERT_EQ(1, nodes.b.getDispatcher().getNumServiceResponseListeners());
+    }
+
+    ASSERT_EQ(0, nodes.b.getDispatcher().getNumServiceResponseListeners());     // Unregistered by the destructor
+}
+
+
 TEST(ServiceClient, Empty)
 {
     InterlinkedTestNodesWithSysClock nodes;
@@ -439,6 +512,142 @@ TEST(ServiceClient, Priority)
 }
 
 
+TEST(ServiceClient, MultipleServers)
+{
+    TestNetwork<4> nodes;
+
+    // Type registration
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<root_ns_a::StringService> _registrator;
+
+    // Servers on the nodes 1, 2, 3
+    uavcan::ServiceServer<root_ns_a::StringService> server1(nodes[0]);
+    uavcan::ServiceServer<root_ns_a::StringService> server2(nodes[1]);
+    uavcan::ServiceServer<root_ns_a::StringService> server3(nodes[2]);
+    ASSERT_EQ(0, server1.start(stringServiceServerCallback));
+    ASSERT_EQ(0, server2.start(stringServiceServerCallback));
+    ASSERT_EQ(0, server3.start(stringServiceServerCallback));
+
+    // Caller on the node 4
+    typedef uavcan::ServiceCallResult<root_ns_a::StringService> ResultType;
+    typedef uavcan::ServiceClient<root_ns_a::StringService,
+                                  typename ServiceCallResultHandler<root_ns_a::StringService>::Binder > ClientType;
+    ServiceCallResultHandler<root_ns_a::StringService> handler;
+    ClientType client(nodes[3]);
+    client.setRequestTimeout(uavcan::MonotonicDuration::fromMSec(100));
+
+    root_ns_a::StringService::Request request;
+    request.string_request = "Long request that does not fit one frame";
+
+    const uavcan::NodeID servers[] = { 1, 2, 3, 99, 4, uavcan::NodeID() };
+    uavcan::ServiceCallID call_ids[6];
+
+    // No callback
+    ASSERT_EQ(-uavcan::ErrInvalidConfiguration, client.callMultiple(servers, 6, request, call_ids));
+    client.setCallback(handler.bind());
+
+    // Calling itself or invalid node ID fails, the rest is fine
+    ASSERT_EQ(4, client.callMultiple(servers, 6, request, call_ids));
+    ASSERT_EQ(4, client.getNumPendingCalls());
+    for (unsigned i = 0; i < 4; i++)
+    {
+        ASSERT_TRUE(call_ids[i].isValid());
+        ASSERT_EQ(servers[i], call_ids[i].server_node_id);
+    }
+    ASSERT_FALSE(call_ids[4].isValid());
+    ASSERT_FALSE(call_ids[5].isValid());
+
+    // The transfer IDs are allocated per server
+    ASSERT_EQ(4, client.callMultiple(servers, 4, request));
+    ASSERT_EQ(8, client.getNumPendingCalls());
+    ASSERT_TRUE(client.hasPendingCallToServer(99));
+
+    nodes.spinAll(uavcan::MonotonicDuration::fromMSec(50));
+    ASSERT_EQ(2, client.getNumPendingCalls());          // Node 99 doesn't exist
+    ASSERT_EQ(6, handler.responses.size());
+    while (!handler.responses.empty())
+    {
+        ASSERT_STREQ("Request string: Long request that does not fit one frame",
+                     handler.responses.front().string_response.c_str());
+        handler.responses.pop();
+    }
+
+    nodes.spinAll(uavcan::MonotonicDuration::fromMSec(200));
+    ASSERT_FALSE(client.hasPendingCalls());
+    ASSERT_TRUE(handler.match(ResultType::ErrorTimeout, 99, root_ns_a::StringService::Response()));
+
+    // Nothing to call
+    ASSERT_EQ(0, client.callMultiple(servers, 0, request));
+    ASSERT_EQ(-uavcan::ErrInvalidParam, client.callMultiple(servers + 4, 2, request));
+    ASSERT_EQ(-uavcan::ErrInvalidParam, client.callMultiple(NULL, 1, request));
+    ASSERT_FALSE(client.hasPendingCalls());
+}
+
+
+TEST(MultiServiceClient, Basic)
+{
+    TestNetwork<3> nodes;
+
+    // Type registration
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<root_ns_a::StringService> _registrator;
+
+    uavcan::ServiceServer<root_ns_a::StringService> server1(nodes[0]);
+    uavcan::ServiceServer<root_ns_a::StringService> server2(nodes[1]);
+    ASSERT_EQ(0, server1.start(stringServiceServerCallback));
+    ASSERT_EQ(0, server2.start(rejectingStringServiceServerCallback));     // Never responds
+
+    typedef uavcan::MultiServiceClient<root_ns_a::StringService, 4> ClientType;
+    ClientType client(nodes[2]);
+    ASSERT_EQ(0, client.init());
+    client.getServiceClient().setRequestTimeout(uavcan::MonotonicDuration::fromMSec(100));
+
+    ASSERT_TRUE(client.isFinished());
+    ASSERT_EQ(0, client.getNumResults());
+
+    root_ns_a::StringService::Request request;
+    request.string_request = "Hi";
+
+    const uavcan::NodeID servers[] = { 1, 2, 3, 4, 5 };
+    ASSERT_EQ(-uavcan::ErrInvalidParam, client.call(servers, 5, request));     // Too many
+
+    ASSERT_EQ(3, client.call(servers, 4, request));                             // Calling itself fails
+    ASSERT_FALSE(client.isFinished());
+    ASSERT_EQ(4, client.getNumResults());
+    ASSERT_EQ(ClientType::Result::ErrorNotSent, client.getResult(2).status);
+    ASSERT_TRUE(client.getResult(2).isFinished());
+
+    nodes.spinAll(uavcan::MonotonicDuration::fromMSec(50));
+    ASSERT_FALSE(client.isFinished());
+    ASSERT_EQ(1, client.getNumSuccessful());
+    ASSERT_TRUE(client.getResult(0).isSuccessful());
+    ASSERT_EQ(uavcan::NodeID(1), client.getResult(0).server_node_id);
+    ASSERT_STREQ("Request string: Hi", client.getResult(0).response.string_response.c_str());
+    ASSERT_EQ(ClientType::Result::Pending, client.getResult(1).status);
+    ASSERT_TRUE(client.findResponse(1) != NULL);
+    ASSERT_TRUE(client.findResponse(2) == NULL);
+
+    nodes.spinAll(uavcan::MonotonicDuration::fromMSec(200));
+    ASSERT_TRUE(client.isFinished());
+    ASSERT_EQ(1, client.getNumSuccessful());
+    ASSERT_EQ(ClientType::Result::ErrorTimeout, client.getResult(1).status);
+    ASSERT_EQ(ClientType::Result::ErrorTimeout, client.getResult(3).status);
+
+    // The next group call discards the results; the pending calls of the cancelled one are not reported
+    ASSERT_EQ(1, client.call(servers + 1, 1, request));
+    ASSERT_EQ(1, client.getNumResults());
+    ASSERT_EQ(1, client.call(servers, 1, request));
+    ASSERT_EQ(1, client.getNumResults());
+    nodes.spinAll(uavcan::MonotonicDuration::fromMSec(50));
+    ASSERT_TRUE(client.isFinished());
+    ASSERT_EQ(uavcan::NodeID(1), client.getResult(0).server_node_id);
+    ASSERT_TRUE(client.getResult(0).isSuccessful());
+
+    client.cancel();
+    ASSERT_EQ(0, client.getNumResults());
+}
+
+
 TEST(ServiceClient, Sizes)
 {
     using namespace uavcan;
@@ -452,3 +661,97 @@ TEST(ServiceClient, Sizes)
     std::cout << "GetDataTypeInfo client: " <<
         sizeof(ServiceClient<protocol::GetDataTypeInfo>) << std::endl;
 }
+
+
+TEST(ServiceCallRegistry, Basic)
+{
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 4, uavcan::MemPoolBlockSize> pool;
+    uavcan::ServiceCallRegistry reg(pool);
+
+    using uavcan::ServiceCallID;
+    using uavcan::MonotonicTime;
+
+    ASSERT_TRUE(reg.isEmpty());
+    ASSERT_TRUE(reg.getEarliestDeadline().isZero());
+    ASSERT_FALSE(reg.removeFirstExpired(MonotonicTime::fromUSec(1000000)).isValid());
+    ASSERT_FALSE(reg.remove(ServiceCallID(1, 0)));
+
+    // The deadline of the third call is earlier than that of the second one
+    ASSERT_EQ(0, reg.add(ServiceCallID(1, 0), MonotonicTime::fromUSec(1000)));
+    ASSERT_EQ(0, reg.add(ServiceCallID(2, 0), MonotonicTime::fromUSec(3000)));
+    ASSERT_EQ(0, reg.add(ServiceCallID(3, 5), MonotonicTime::fromUSec(2000)));
+    ASSERT_EQ(0, reg.add(ServiceCallID(1, 0), MonotonicTime::fromUSec(4000)));     // Non-unique call ID
+    ASSERT_EQ(-uavcan::ErrMemory, reg.add(ServiceCallID(4, 0), MonotonicTime::fromUSec(5000)));
+
+    ASSERT_EQ(4, reg.getSize());
+    ASSERT_EQ(4, pool.getNumUsedBlocks());
+    ASSERT_EQ(1000, reg.getEarliestDeadline().toUSec());
+
+    ASSERT_TRUE(ServiceCallID(1, 0) == reg.getByIndex(0));
+    ASSERT_TRUE(ServiceCallID(3, 5) == reg.getByIndex(1));
+    ASSERT_TRUE(ServiceCallID(2, 0) == reg.getByIndex(2));
+    ASSERT_TRUE(ServiceCallID(1, 0) == reg.getByIndex(3));
+    ASSERT_FALSE(reg.getByIndex(4).isValid());
+
+    ASSERT_TRUE(reg.contains(ServiceCallID(3, 5)));
+    ASSERT_FALSE(reg.contains(ServiceCallID(3, 6)));
+    ASSERT_TRUE(reg.containsServer(2));
+    ASSERT_FALSE(reg.containsServer(4));
+
+    // The oldest one of the duplicates is removed first
+    ASSERT_TRUE(reg.remove(ServiceCallID(1, 0)));
+    ASSERT_EQ(2000, reg.getEarliestDeadline().toUSec());
+    ASSERT_TRUE(reg.contains(ServiceCallID(1, 0)));
+    ASSERT_TRUE(ServiceCallID(1, 0) == reg.getByIndex(2));
+
+    // Expiration
+    ASSERT_FALSE(reg.removeFirstExpired(MonotonicTime::fromUSec(1999)).isValid());
+    ASSERT_TRUE(ServiceCallID(3, 5) == reg.removeFirstExpired(MonotonicTime::fromUSec(3000)));
+    ASSERT_TRUE(ServiceCallID(2, 0) == reg.removeFirstExpired(MonotonicTime::fromUSec(3000)));
+    ASSERT_FALSE(reg.removeFirstExpired(MonotonicTime::fromUSec(3000)).isValid());
+    ASSERT_EQ(1, reg.getSize());
+    ASSERT_FALSE(reg.containsServer(2));
+
+    reg.clear();
+    ASSERT_TRUE(reg.isEmpty());
+    ASSERT_EQ(0, pool.getNumUsedBlocks());
+}
+
+TEST(ServiceCallRegistry, ManyCalls)
+{
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 1024, uavcan::MemPoolBlockSize> pool;
+    uavcan::ServiceCallRegistry reg(pool);
+
+    for (unsigned node_id = 1; node_id <= 100; node_id++)
+    {
+        for (unsigned tid = 0; tid < 10; tid++)
+        {
+            const uavcan::ServiceCallID id = uavcan::ServiceCallID(uavcan::uint8_t(node_id), uavcan::uint8_t(tid));
+            ASSERT_EQ(0, reg.add(id, uavcan::MonotonicTime::fromUSec(node_id * 100 + tid)));
+        }
+    }
+    ASSERT_EQ(1000, reg.getSize());
+
+    // Responses from every other node
+    for (unsigned node_id = 2; node_id <= 100; node_id += 2)
+    {
+        for (unsigned tid = 0; tid < 10; tid++)
+        {
+            ASSERT_TRUE(reg.remove(uavcan::ServiceCallID(uavcan::uint8_t(node_id), uavcan::uint8_t(tid))));
+        }
+    }
+    ASSERT_EQ(500, reg.getSize());
+
+    // The remaining ones time out in their order
+    uavcan::uint64_t last_deadline = 0;
+    while (!reg.isEmpty())
+    {
+        const uavcan::uint64_t deadline = uavcan::uint64_t(reg.getEarliestDeadline().toUSec());
+        ASSERT_LE(last_deadline, deadline);
+        last_deadline = deadline;
+        const uavcan::ServiceCallID id = reg.removeFirstExpired(reg.getEarliestDeadline());
+        ASSERT_TRUE(id.isValid());
+        ASSERT_EQ(1, id.server_node_id.get() % 2);
+    }
+    ASSERT_EQ(0, pool.getNumUsedBlocks());
+}
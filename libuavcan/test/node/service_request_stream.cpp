@@ -0,0 +1,226 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <gtest/gtest.h>
+#include <uavcan/node/service_request_stream.hpp>
+#include <uavcan/node/service_server.hpp>
+#include <uavcan/util/method_binder.hpp>
+#include <root_ns_a/StringService.hpp>
+#include <set>
+#include <string>
+#include <vector>
+#include "test_node.hpp"
+
+
+/**
+ * Echoes the requests; the first request with a string from the drop set is not responded to.
+ */
+struct DroppingStringServer
+{
+    std::set<std::string> to_drop;
+    unsigned num_requests;
+
+    DroppingStringServer() : num_requests(0) { }
+
+    void handleRequest(const uavcan::ReceivedDataStructure<root_ns_a::StringService::Request>& request,
+                       uavcan::ServiceResponseDataStructure<root_ns_a::StringService::Response>& response)
+    {
+        num_requests++;
+        response.string_response = request.string_request;
+        if (to_drop.erase(request.string_request.c_str()) > 0)
+        {
+            response.setResponseEnabled(false);
+        }
+    }
+
+    typedef uavcan::MethodBinder<DroppingStringServer*,
+        void (DroppingStringServer::*)(const uavcan::ReceivedDataStructure<root_ns_a::StringService::Request>&,
+               uavcan::ServiceResponseDataStructure<root_ns_a::StringService::Response>&)> Binder;
+
+    Binder bind() { return Binder(this, &DroppingStringServer::handleRequest); }
+};
+
+
+struct StreamHandler : public uavcan::IServiceRequestStreamHandler<root_ns_a::StringService>
+{
+    uint32_t num_requests;
+    std::vector<uint32_t> response_indices;
+    std::vector<std::string> responses;
+    std::vector<uint32_t> failures;
+    unsigned num_completions;
+
+    explicit StreamHandler(uint32_t arg_num_requests)
+        : num_requests(arg_num_requests)
+        , num_completions(0)
+    { }
+
+    virtual bool produceRequest(uint32_t index, RequestType& out_request)
+    {
+        if (index >= num_requests)
+        {
+            return false;
+        }
+        out_request.string_request = std::to_string(index).c_str();
+        return true;
+    }
+
+    virtual void handleResponse(uint32_t index, const ResponseType& response)
+    {
+        response_indices.push_back(index);
+        responses.push_back(response.string_response.c_str());
+    }
+
+    virtual void handleFailure(uint32_t index) { failures.push_back(index); }
+
+    virtual void handleCompletion() { num_completions++; }
+
+    bool checkResponsesInOrder() const
+    {
+        for (uint32_t i = 0; i < response_indices.size(); i++)
+        {
+            if ((response_indices[i] != i) || (responses[i] != std::to_string(i)))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+
+TEST(ServiceRequestStream, Basic)
+{
+    InterlinkedTestNodesWithSysClock nodes;
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<root_ns_a::StringService> _registrator;
+
+    DroppingStringServer server_impl;
+    uavcan::ServiceServer<root_ns_a::StringService, DroppingStringServer::Binder> server(nodes.a);
+    ASSERT_LE(0, server.start(server_impl.bind()));
+
+    StreamHandler handler(20);
+    uavcan::ServiceRequestStream<root_ns_a::StringService, 4> stream(nodes.b, handler);
+
+    ASSERT_FALSE(stream.isRunning());
+    ASSERT_EQ(4, stream.getWindowSize());
+    ASSERT_EQ(-uavcan::ErrInvalidParam, stream.start(uavcan::NodeID()));
+
+    ASSERT_EQ(0, stream.start(1));
+    ASSERT_TRUE(stream.isRunning());
+    ASSERT_EQ(uavcan::NodeID(1), stream.getServerNodeID());
+    ASSERT_EQ(4, stream.getNumPendingCalls());          // The window is full
+
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(100));
+
+    ASSERT_FALSE(stream.isRunning());
+    ASSERT_EQ(0, stream.getNumPendingCalls());
+    ASSERT_EQ(20, stream.getNumDeliveredResponses());
+    ASSERT_EQ(20, handler.response_indices.size());
+    ASSERT_TRUE(handler.checkResponsesInOrder());
+    ASSERT_TRUE(handler.failures.empty());
+    ASSERT_EQ(1, handler.num_completions);
+    ASSERT_EQ(0, stream.getNumTimeouts());
+    ASSERT_EQ(4, stream.getWindowSize());
+    ASSERT_EQ(20, server_impl.num_requests);
+
+    // Restart
+    handler.response_indices.clear();
+    handler.responses.clear();
+    ASSERT_EQ(0, stream.start(1));
+    ASSERT_TRUE(stream.isRunning());
+    stream.stop();
+    ASSERT_FALSE(stream.isRunning());
+    ASSERT_EQ(0, stream.getNumPendingCalls());
+
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(100));
+
+    ASSERT_TRUE(handler.response_indices.empty());      // Stopped before any responses arrived
+    ASSERT_EQ(1, handler.num_completions);
+
+    // No requests at all - completes immediately
+    handler.num_requests = 0;
+    ASSERT_EQ(0, stream.start(1));
+    ASSERT_FALSE(stream.isRunning());
+    ASSERT_EQ(2, handler.num_completions);
+}
+
+
+TEST(ServiceRequestStream, Reordering)
+{
+    InterlinkedTestNodesWithSysClock nodes;
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<root_ns_a::StringService> _registrator;
+
+    DroppingStringServer server_impl;
+    server_impl.to_drop.insert("3");
+    server_impl.to_drop.insert("5");
+    uavcan::ServiceServer<root_ns_a::StringService, DroppingStringServer::Binder> server(nodes.a);
+    ASSERT_LE(0, server.start(server_impl.bind()));
+
+    StreamHandler handler(30);
+    uavcan::ServiceRequestStream<root_ns_a::StringService> stream(nodes.b, handler);
+    stream.setRequestTimeout(uavcan::MonotonicDuration::fromMSec(100));
+
+    ASSERT_EQ(8, stream.getWindowSize());
+    ASSERT_EQ(0, stream.start(1));
+
+    /*
+     * The window stalls on the dropped requests, so only the responses to the requests 0..2 can be delivered
+     * before the requests 3 and 5 time out.
+     */
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(50));
+
+    ASSERT_TRUE(stream.isRunning());
+    ASSERT_EQ(3, handler.response_indices.size());
+    ASSERT_EQ(2, stream.getNumPendingCalls());
+
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(200));
+
+    ASSERT_FALSE(stream.isRunning());
+    ASSERT_EQ(30, handler.response_indices.size());
+    ASSERT_TRUE(handler.checkResponsesInOrder());
+    ASSERT_TRUE(handler.failures.empty());
+    ASSERT_EQ(1, handler.num_completions);
+    ASSERT_EQ(2, stream.getNumTimeouts());
+    ASSERT_EQ(32, server_impl.num_requests);
+    ASSERT_GT(8, stream.getWindowSize());               // Reduced once, then partially recovered
+    ASSERT_LE(4, stream.getWindowSize());
+}
+
+
+TEST(ServiceRequestStream, Failure)
+{
+    InterlinkedTestNodesWithSysClock nodes;
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<root_ns_a::StringService> _registrator;
+
+    StreamHandler handler(30);
+    uavcan::ServiceRequestStream<root_ns_a::StringService> stream(nodes.b, handler);
+    stream.setRequestTimeout(uavcan::MonotonicDuration::fromMSec(50));
+    stream.setMaxRequestAttempts(0);
+    ASSERT_EQ(1, stream.getMaxRequestAttempts());
+    stream.setMaxRequestAttempts(2);
+
+    ASSERT_EQ(0, stream.start(99));                     // Nobody there
+    ASSERT_EQ(8, stream.getNumPendingCalls());
+
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(80));
+
+    ASSERT_TRUE(stream.isRunning());                    // All requests are being repeated
+    ASSERT_EQ(8, stream.getNumPendingCalls());
+    ASSERT_EQ(8, stream.getNumTimeouts());
+    ASSERT_EQ(4, stream.getWindowSize());               // Reduced only once per window
+
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(50));
+
+    ASSERT_FALSE(stream.isRunning());
+    ASSERT_EQ(0, stream.getNumPendingCalls());
+    ASSERT_TRUE(handler.response_indices.empty());
+    ASSERT_EQ(1, handler.failures.size());
+    ASSERT_EQ(0, handler.failures[0]);
+    ASSERT_EQ(0, handler.num_completions);
+}
@@ -2,6 +2,8 @@
  * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
  */
 
+#include <string>
+#include <vector>
 #include <gtest/gtest.h>
 #include <uavcan/node/service_server.hpp>
 #include <uavcan/util/method_binder.hpp>
@@ -52,6 +54,47 @@ struct EmptyServerImpl
 };
 
 
+struct DeferringServerImpl
+{
+    std::vector<uavcan::ServiceResponseHandle> handles;
+
+    void handleRequest(const uavcan::ReceivedDataStructure<root_ns_a::EmptyService::Request>&,
+                       uavcan::ServiceResponseDataStructure<root_ns_a::EmptyService::Response>& response)
+    {
+        handles.push_back(response.defer());
+    }
+
+    typedef uavcan::MethodBinder<DeferringServerImpl*,
+        void (DeferringServerImpl::*)(const uavcan::ReceivedDataStructure<root_ns_a::EmptyService::Request>&,
+                                      uavcan::ServiceResponseDataStructure<root_ns_a::EmptyService::Response>&)>
+        Binder;
+
+    Binder bind() { return Binder(this, &DeferringServerImpl::handleRequest); }
+};
+
+
+struct EncodedResponseServerImpl
+{
+    uavcan::OutgoingTransferBufferImpl* encoded;
+
+    EncodedResponseServerImpl() : encoded(NULL) { }
+
+    void handleRequest(const uavcan::ReceivedDataStructure<root_ns_a::StringService::Request>&,
+                       uavcan::ServiceResponseDataStructure<root_ns_a::StringService::Response>& response)
+    {
+        response.string_response = "ignored";
+        response.setEncodedResponse(*encoded);
+    }
+
+    typedef uavcan::MethodBinder<EncodedResponseServerImpl*,
+        void (EncodedResponseServerImpl::*)(const uavcan::ReceivedDataStructure<root_ns_a::StringService::Request>&,
+                                            uavcan::ServiceResponseDataStructure<root_ns_a::StringService::Response>&)>
+        Binder;
+
+    Binder bind() { return Binder(this, &EncodedResponseServerImpl::handleRequest); }
+};
+
+
 TEST(ServiceServer, Basic)
 {
     // Manual type registration - we can't rely on the GDTR state
@@ -154,3 +197,204 @@ TEST(ServiceServer, Empty)
     ASSERT_GE(0, server.start(impl.bind()));
     ASSERT_EQ(1, node.getDispatcher().getNumServiceRequestListeners());
 }
+
+
+TEST(ServiceServer, DeferredResponse)
+{
+    // Manual type registration - we can't rely on the GDTR state
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<root_ns_a::EmptyService> _registrator;
+
+    SystemClockDriver clock_driver;
+    CanDriverMock can_driver(1, clock_driver);
+    TestNode node(can_driver, clock_driver, 1);
+
+    DeferringServerImpl impl;
+
+    uavcan::ServiceServer<root_ns_a::EmptyService, DeferringServerImpl::Binder> server(node);
+    server.setDeferredResponseTimeout(uavcan::MonotonicDuration::fromMSec(50));
+    ASSERT_EQ(0, server.start(impl.bind()));
+
+    for (uint8_t i = 0; i < 3; i++)
+    {
+        uavcan::Frame frame(root_ns_a::EmptyService::DefaultDataTypeID, uavcan::TransferTypeServiceRequest,
+                            uavcan::NodeID(uint8_t(i + 0x10)), 1, i);
+        frame.setStartOfTransfer(true);
+        frame.setEndOfTransfer(true);
+        frame.setPriority(uint8_t(i + 10));
+        can_driver.ifaces[0].pushRx(uavcan::RxFrame(frame, clock_driver.getMonotonic(), clock_driver.getUtc(), 0));
+    }
+
+    ASSERT_LE(0, node.spin(uavcan::MonotonicDuration::fromMSec(10)));
+
+    /*
+     * Nothing is sent until the application responds
+     */
+    ASSERT_EQ(3, impl.handles.size());
+    ASSERT_TRUE(can_driver.ifaces[0].tx.empty());
+    ASSERT_EQ(3, server.getNumPendingDeferredResponses());
+
+    root_ns_a::EmptyService::Response response;
+
+    ASSERT_EQ(1, server.respond(impl.handles.at(1), response));
+    ASSERT_EQ(-uavcan::ErrInvalidParam, server.respond(impl.handles.at(1), response));  // Already responded
+    ASSERT_EQ(2, server.getNumPendingDeferredResponses());
+
+    uavcan::Frame fr;
+    ASSERT_TRUE(fr.parse(can_driver.ifaces[0].popTxFrame()));
+    ASSERT_EQ(uavcan::TransferTypeServiceResponse, fr.getTransferType());
+    ASSERT_EQ(0x11, fr.getDstNodeID().get());
+    ASSERT_EQ(1, fr.getTransferID().get());
+    ASSERT_EQ(11, fr.getPriority().get());                 // Same as the request
+    ASSERT_TRUE(can_driver.ifaces[0].tx.empty());
+
+    ASSERT_TRUE(server.cancelDeferredResponse(impl.handles.at(2)));
+    ASSERT_FALSE(server.cancelDeferredResponse(impl.handles.at(2)));
+
+    /*
+     * The remaining request expires
+     */
+    ASSERT_LE(0, node.spin(uavcan::MonotonicDuration::fromMSec(100)));
+    ASSERT_EQ(0, server.getNumPendingDeferredResponses());
+    ASSERT_EQ(1, server.getDeferredResponseTimeoutCount());
+    ASSERT_EQ(-uavcan::ErrInvalidParam, server.respond(impl.handles.at(0), response));
+    ASSERT_TRUE(can_driver.ifaces[0].tx.empty());
+
+    ASSERT_EQ(0, server.getRequestFailureCount());
+    ASSERT_EQ(0, server.getResponseFailureCount());
+}
+
+
+TEST(ServiceServer, ResponsePriority)
+{
+    // Manual type registration - we can't rely on the GDTR state
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<root_ns_a::EmptyService> _registrator;
+
+    SystemClockDriver clock_driver;
+    CanDriverMock can_driver(1, clock_driver);
+    TestNode node(can_driver, clock_driver, 1);
+
+    EmptyServerImpl impl;
+
+    uavcan::ServiceServer<root_ns_a::EmptyService, EmptyServerImpl::Binder> server(node);
+    ASSERT_EQ(0, server.start(impl.bind()));
+
+    ASSERT_EQ(7, server.getResponsePriority(7).get());    // Inherited by default
+    server.setResponsePriority(20);
+    ASSERT_EQ(20, server.getResponsePriority(7).get());
+    server.setMinResponsePriority(10);
+    ASSERT_EQ(7, server.getResponsePriority(7).get());
+    ASSERT_EQ(10, server.getResponsePriority(25).get());
+    server.inheritResponsePriority();
+    ASSERT_EQ(25, server.getResponsePriority(25).get());
+
+    const uint8_t request_priorities[] = { 3, 30 };
+    const uint8_t expected_priorities[3][2] = {
+        { 3, 30 },      // Inherited
+        { 16, 16 },     // Fixed
+        { 3, 16 }       // Inherited, not lower than 16
+    };
+
+    for (uint8_t mode = 0; mode < 3; mode++)
+    {
+        if (mode == 1)
+        {
+            server.setResponsePriority(16);
+        }
+        if (mode == 2)
+        {
+            server.setMinResponsePriority(16);
+        }
+
+        for (uint8_t i = 0; i < 2; i++)
+        {
+            uavcan::Frame frame(root_ns_a::EmptyService::DefaultDataTypeID, uavcan::TransferTypeServiceRequest,
+                                uavcan::NodeID(uint8_t(i + 0x10)), 1, uint8_t(mode * 2 + i));
+            frame.setStartOfTransfer(true);
+            frame.setEndOfTransfer(true);
+            frame.setPriority(request_priorities[i]);
+            can_driver.ifaces[0].pushRx(uavcan::RxFrame(frame, clock_driver.getMonotonic(),
+                                                        clock_driver.getUtc(), 0));
+        }
+
+        ASSERT_LE(0, node.spin(uavcan::MonotonicDuration::fromMSec(10)));
+
+        ASSERT_EQ(2, can_driver.ifaces[0].tx.size());
+        for (uint8_t i = 0; i < 2; i++)
+        {
+            uavcan::Frame fr;
+            ASSERT_TRUE(fr.parse(can_driver.ifaces[0].popTxFrame()));
+            ASSERT_EQ(uavcan::TransferTypeServiceResponse, fr.getTransferType());
+            ASSERT_EQ(i + 0x10, fr.getDstNodeID().get());
+            ASSERT_EQ(expected_priorities[mode][i], fr.getPriority().get());
+        }
+    }
+
+    ASSERT_EQ(0, server.getResponseFailureCount());
+}
+
+
+TEST(ServiceServer, EncodedResponse)
+{
+    // Manual type registration - we can't rely on the GDTR state
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<root_ns_a::StringService> _registrator;
+
+    SystemClockDriver clock_driver;
+    CanDriverMock can_driver(1, clock_driver);
+    TestNode node(can_driver, clock_driver, 1);
+
+    typedef uavcan::ServiceServer<root_ns_a::StringService, EncodedResponseServerImpl::Binder> Server;
+    Server server(node);
+
+    root_ns_a::StringService::Response response;
+    response.string_response = "cached response";       // Multi frame
+
+    Server::EncodedResponse encoded((uavcan::TransferCRC()));
+    ASSERT_LT(0, server.encodeResponse(response, encoded));
+
+    EncodedResponseServerImpl impl;
+    impl.encoded = &encoded;
+    ASSERT_EQ(0, server.start(impl.bind()));
+
+    for (uint8_t i = 0; i < 2; i++)
+    {
+        uavcan::Frame frame(root_ns_a::StringService::DefaultDataTypeID, uavcan::TransferTypeServiceRequest,
+                            uavcan::NodeID(uint8_t(i + 0x10)), 1, uint8_t(i + 5));
+        const uint8_t req[] = {'r', 'e', 'q'};
+        frame.setPayload(req, sizeof(req));
+        frame.setStartOfTransfer(true);
+        frame.setEndOfTransfer(true);
+        can_driver.ifaces[0].pushRx(uavcan::RxFrame(frame, clock_driver.getMonotonic(), clock_driver.getUtc(), 0));
+    }
+
+    ASSERT_LE(0, node.spin(uavcan::MonotonicDuration::fromMSec(10)));
+
+    /*
+     * Both clients get the same pre-encoded response, including the CRC
+     */
+    ASSERT_EQ(6, can_driver.ifaces[0].tx.size());
+    std::string payloads[2];
+    for (uint8_t i = 0; i < 2; i++)
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            uavcan::Frame fr;
+            ASSERT_TRUE(fr.parse(can_driver.ifaces[0].popTxFrame()));
+            ASSERT_EQ(uavcan::TransferTypeServiceResponse, fr.getTransferType());
+            ASSERT_EQ(i + 0x10, fr.getDstNodeID().get());
+            ASSERT_EQ(i + 5, fr.getTransferID().get());
+            payloads[i] += std::string(reinterpret_cast<const char*>(fr.getPayloadPtr()), fr.getPayloadLen());
+        }
+    }
+    ASSERT_EQ(payloads[0], payloads[1]);
+    ASSERT_EQ("cached response", payloads[0].substr(2));
+
+    uavcan::TransferCRC crc = root_ns_a::StringService::getDataTypeSignature().toTransferCRC();
+    crc.add(reinterpret_cast<const uint8_t*>("cached response"), 15);
+    ASSERT_EQ(crc.get() & 0xFF, uint8_t(payloads[0].at(0)));
+    ASSERT_EQ(crc.get() >> 8, uint8_t(payloads[0].at(1)));
+
+    ASSERT_EQ(0, server.getResponseFailureCount());
+}
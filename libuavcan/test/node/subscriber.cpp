@@ -280,3 +280,81 @@ TEST(Subscriber, SingleFrameTransfer)
         ASSERT_TRUE(listener.simple.at(i) == root_ns_a::EmptyMessage());
     }
 }
+
+
+struct DecodeSlotChecker
+{
+    const void* slot_begin;
+    const void* slot_end;
+    unsigned num_in_slot;
+    unsigned num_on_stack;
+
+    DecodeSlotChecker(const void* arg_slot, std::size_t slot_size)
+        : slot_begin(arg_slot)
+        , slot_end(static_cast<const char*>(arg_slot) + slot_size)
+        , num_in_slot(0)
+        , num_on_stack(0)
+    { }
+
+    void receive(const uavcan::ReceivedDataStructure<root_ns_a::EmptyMessage>& msg)
+    {
+        const void* const ptr = &msg;
+        if ((ptr >= slot_begin) && (ptr < slot_end))
+        {
+            num_in_slot++;
+        }
+        else
+        {
+            num_on_stack++;
+        }
+        ASSERT_EQ(100, msg.getSrcNodeID().get());
+    }
+
+    typedef uavcan::MethodBinder<DecodeSlotChecker*,
+        void (DecodeSlotChecker::*)(const uavcan::ReceivedDataStructure<root_ns_a::EmptyMessage>&)> Binder;
+};
+
+
+TEST(Subscriber, DecodeSlot)
+{
+    // Manual type registration - we can't rely on the GDTR state
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<root_ns_a::EmptyMessage> _registrator;
+
+    SystemClockDriver clock_driver;
+    CanDriverMock can_driver(2, clock_driver);
+    TestNode node(can_driver, clock_driver, 1);
+
+    typedef uavcan::Subscriber<root_ns_a::EmptyMessage, DecodeSlotChecker::Binder> Sub;
+
+    static Sub::DecodeSlot slot;
+    DecodeSlotChecker checker(&slot, sizeof(slot));
+
+    Sub sub(node);
+    ASSERT_FALSE(sub.getDecodeSlot());
+    sub.setDecodeSlot(&slot);
+    ASSERT_TRUE(sub.getDecodeSlot() == &slot);
+    ASSERT_LE(0, sub.start(DecodeSlotChecker::Binder(&checker, &DecodeSlotChecker::receive)));
+
+    uint8_t transfer_id = 0;
+    for (int round = 0; round < 2; round++)
+    {
+        for (uint8_t i = 0; i < 3; i++)
+        {
+            uavcan::Frame frame(root_ns_a::EmptyMessage::DefaultDataTypeID, uavcan::TransferTypeMessageBroadcast,
+                                uavcan::NodeID(100), uavcan::NodeID::Broadcast, transfer_id++);
+            frame.setStartOfTransfer(true);
+            frame.setEndOfTransfer(true);
+            uavcan::RxFrame rx_frame(frame, clock_driver.getMonotonic(), clock_driver.getUtc(), 0);
+            can_driver.ifaces[0].pushRx(rx_frame);
+        }
+        ASSERT_LE(0, node.spin(clock_driver.getMonotonic() + durMono(10000)));
+
+        // Back to the stack
+        sub.setDecodeSlot(NULL);
+    }
+
+    ASSERT_EQ(0, sub.getFailureCount());
+    ASSERT_EQ(3, checker.num_in_slot);
+    ASSERT_EQ(3, checker.num_on_stack);
+}
@@ -120,7 +120,10 @@ struct PairableCanDriver : public uavcan::ICanDriver, public uavcan::ICanIface
         out_flags = 0;
         if (loopback_queue.empty())
         {
-            assert(read_queue.size());
+            if (read_queue.empty())
+            {
+                return 0;       // The default receiveBatch() reads until the queue is empty
+            }
             out_frame = read_queue.front();
             read_queue.pop();
         }
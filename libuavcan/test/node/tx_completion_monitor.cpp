@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <vector>
+#include <gtest/gtest.h>
+#include <uavcan/node/tx_completion_monitor.hpp>
+#include <uavcan/util/method_binder.hpp>
+#include "../clock.hpp"
+#include "../transport/can/can.hpp"
+#include "test_node.hpp"
+
+#if !UAVCAN_TINY
+
+struct TxCompletionCollector
+{
+    std::vector<uavcan::TxCompletionEvent> events;
+
+    void handle(const uavcan::TxCompletionEvent& ev) { events.push_back(ev); }
+
+    typedef uavcan::MethodBinder<TxCompletionCollector*,
+                                 void (TxCompletionCollector::*)(const uavcan::TxCompletionEvent&)> Binder;
+
+    Binder bind() { return Binder(this, &TxCompletionCollector::handle); }
+};
+
+static uavcan::TxCompletionEvent makeTrackedTransfer(uavcan::uint16_t dtid, uavcan::uint8_t tid,
+                                                     uavcan::MonotonicTime published_at,
+                                                     uavcan::MonotonicTime tx_deadline)
+{
+    uavcan::TxCompletionEvent event;
+    event.data_type_id = dtid;
+    event.transfer_type = uavcan::TransferTypeMessageBroadcast;
+    event.dst_node_id = uavcan::NodeID::Broadcast;
+    event.transfer_id = tid;
+    event.published_at = published_at;
+    event.tx_deadline = tx_deadline;
+    return event;
+}
+
+static int sendFrame(TestNode& node, uavcan::uint16_t dtid, uavcan::uint8_t tid, uavcan::CanIOFlags flags,
+                     uavcan::uint8_t iface_mask)
+{
+    uavcan::Frame frame(dtid, uavcan::TransferTypeMessageBroadcast, node.getNodeID(), uavcan::NodeID::Broadcast, tid);
+    const uavcan::uint8_t payload[] = { 42 };
+    frame.setPayload(payload, sizeof(payload));
+    frame.setStartOfTransfer(true);
+    frame.setEndOfTransfer(true);
+    const uavcan::MonotonicTime deadline = node.getMonotonicTime() + durMono(100000);
+    return node.getDispatcher().send(frame, deadline, uavcan::MonotonicTime(), uavcan::CanTxQueue::Volatile,
+                                     flags, iface_mask);
+}
+
+TEST(TxCompletionMonitor, Basic)
+{
+    SystemClockMock clock(1000000);
+    CanDriverMock can_driver(2, clock);
+    TestNode node(can_driver, clock, 1);
+
+    TxCompletionCollector collector;
+    uavcan::TxCompletionMonitor<2, TxCompletionCollector::Binder> monitor(node, collector.bind());
+    ASSERT_EQ(2, monitor.getCapacity());
+    ASSERT_TRUE(monitor.hasFreeSlots());
+
+    const uavcan::LoopbackFrameListenerRegistry& listeners = node.getDispatcher().getLoopbackFrameListenerRegistry();
+    ASSERT_EQ(0, listeners.getNumListeners());
+
+    const uavcan::MonotonicTime start = clock.getMonotonic();
+    const uavcan::MonotonicTime deadline = start + durMono(100000);
+
+    ASSERT_EQ(-uavcan::ErrInvalidParam, monitor.track(makeTrackedTransfer(123, 5, start, deadline), 0));
+    ASSERT_EQ(0, monitor.track(makeTrackedTransfer(123, 5, start, deadline), 3));
+    ASSERT_EQ(0, monitor.track(makeTrackedTransfer(123, 6, start, deadline), 1));
+    ASSERT_EQ(-uavcan::ErrMemory, monitor.track(makeTrackedTransfer(123, 7, start, deadline), 1));
+    ASSERT_FALSE(monitor.hasFreeSlots());
+    ASSERT_EQ(2, monitor.getNumPendingTransfers());
+    ASSERT_EQ(1, listeners.getNumListeners());
+
+    // Unrelated frames are ignored
+    clock.advance(1000);
+    ASSERT_LE(0, sendFrame(node, 124, 5, uavcan::CanIOFlagLoopback, 3));
+    ASSERT_LE(0, sendFrame(node, 123, 4, uavcan::CanIOFlagLoopback, 3));
+    ASSERT_LE(0, node.spin(durMono(1000)));
+    ASSERT_TRUE(collector.events.empty());
+
+    // Transmitted on one iface only, one more to go
+    ASSERT_LE(0, sendFrame(node, 123, 5, uavcan::CanIOFlagLoopback, 1));
+    ASSERT_LE(0, node.spin(durMono(1000)));
+    ASSERT_TRUE(collector.events.empty());
+
+    clock.advance(1000);
+    const uavcan::MonotonicTime tx_time = clock.getMonotonic();
+    ASSERT_LE(0, sendFrame(node, 123, 5, uavcan::CanIOFlagLoopback, 2));
+    ASSERT_LE(0, node.spin(durMono(1000)));
+    ASSERT_EQ(1, collector.events.size());
+    EXPECT_EQ(uavcan::TxCompletionEvent::StatusTransmitted, collector.events[0].status);
+    EXPECT_EQ(5, collector.events[0].transfer_id.get());
+    EXPECT_EQ(123, collector.events[0].data_type_id.get());
+    EXPECT_EQ(3, collector.events[0].iface_mask);
+    EXPECT_EQ(tx_time, collector.events[0].tx_mono);
+    EXPECT_EQ(tx_time - start, collector.events[0].getLatency());
+    ASSERT_EQ(1, monitor.getNumPendingTransfers());
+    ASSERT_TRUE(monitor.hasFreeSlots());
+
+    // The other one is never transmitted, so it expires after the grace period
+    ASSERT_LE(0, node.spin(deadline - clock.getMonotonic()));
+    ASSERT_EQ(1, collector.events.size());
+    ASSERT_LE(0, node.spin(monitor.getGracePeriod() + durMono(1000)));
+    ASSERT_EQ(2, collector.events.size());
+    EXPECT_EQ(uavcan::TxCompletionEvent::StatusExpired, collector.events[1].status);
+    EXPECT_EQ(6, collector.events[1].transfer_id.get());
+    EXPECT_EQ(0, collector.events[1].iface_mask);
+    EXPECT_TRUE(collector.events[1].tx_mono.isZero());
+    EXPECT_EQ(uavcan::MonotonicDuration::getInfinite(), collector.events[1].getLatency());
+
+    // Idle monitor doesn't listen to loopback frames
+    ASSERT_EQ(0, monitor.getNumPendingTransfers());
+    ASSERT_EQ(0, listeners.getNumListeners());
+    ASSERT_EQ(0, node.getScheduler().getDeadlineScheduler().getNumHandlers());
+
+    // Explicit expiration
+    ASSERT_EQ(0, monitor.track(makeTrackedTransfer(123, 8, start, clock.getMonotonic() + durMono(100000)), 1));
+    monitor.expireAll();
+    ASSERT_EQ(3, collector.events.size());
+    EXPECT_EQ(uavcan::TxCompletionEvent::StatusExpired, collector.events[2].status);
+    EXPECT_EQ(8, collector.events[2].transfer_id.get());
+    ASSERT_EQ(0, listeners.getNumListeners());
+}
+
+#endif
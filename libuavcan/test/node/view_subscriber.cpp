@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include <uavcan/node/view_subscriber.hpp>
+#include <uavcan/util/method_binder.hpp>
+#include <root_ns_a/MavlinkMessage.hpp>
+#include "../clock.hpp"
+#include "../transport/can/can.hpp"
+#include "test_node.hpp"
+
+
+struct MavlinkViewListener
+{
+    struct Record
+    {
+        unsigned seq;
+        unsigned msgid;
+        std::string payload;
+        uavcan::NodeID src_node_id;
+    };
+
+    std::vector<Record> records;
+
+    void receive(const root_ns_a::MavlinkMessage::View& view, uavcan::IncomingTransfer& transfer)
+    {
+        Record rec;
+        rec.seq = view.seq();
+        rec.msgid = view.msgid();
+        const uavcan::PayloadArrayView<root_ns_a::MavlinkMessage::FieldTypes::payload::RawValueType> payload =
+            view.payload();
+        for (unsigned i = 0; i < payload.size(); i++)
+        {
+            rec.payload.push_back(char(payload[i]));
+        }
+        rec.src_node_id = transfer.getSrcNodeID();
+        records.push_back(rec);
+    }
+
+    typedef uavcan::MethodBinder<MavlinkViewListener*,
+                                 void (MavlinkViewListener::*)(const root_ns_a::MavlinkMessage::View&,
+                                                               uavcan::IncomingTransfer&)> Binder;
+
+    Binder bind() { return Binder(this, &MavlinkViewListener::receive); }
+};
+
+
+TEST(ViewSubscriber, Basic)
+{
+    // Manual type registration - we can't rely on the GDTR state
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<root_ns_a::MavlinkMessage> _registrator;
+
+    SystemClockDriver clock_driver;
+    CanDriverMock can_driver(2, clock_driver);
+    TestNode node(can_driver, clock_driver, 1);
+
+    uavcan::ViewSubscriber<root_ns_a::MavlinkMessage, MavlinkViewListener::Binder> sub(node);
+
+    // Null binder - will fail
+    ASSERT_EQ(-uavcan::ErrInvalidParam, sub.start(MavlinkViewListener::Binder(NULL, NULL)));
+
+    MavlinkViewListener listener;
+
+    // seq, sysid, compid, msgid, then the payload array without the length prefix (tail array optimization)
+    const uint8_t transfer_payload[] = {0x42, 0x72, 0x08, 0xa5, 'M', 's', 'g'};
+
+    std::vector<uavcan::RxFrame> rx_frames;
+    for (uint8_t i = 0; i < 3; i++)
+    {
+        uavcan::Frame frame(root_ns_a::MavlinkMessage::DefaultDataTypeID, uavcan::TransferTypeMessageBroadcast,
+                            uavcan::NodeID(uint8_t(i + 100)), uavcan::NodeID::Broadcast, i);
+        frame.setStartOfTransfer(true);
+        frame.setEndOfTransfer(true);
+        frame.setPayload(transfer_payload, unsigned(sizeof(transfer_payload) - i));
+        rx_frames.push_back(uavcan::RxFrame(frame, clock_driver.getMonotonic(), clock_driver.getUtc(), 1));
+    }
+
+    ASSERT_EQ(0, sub.start(listener.bind()));
+    ASSERT_EQ(1, node.getDispatcher().getNumMessageListeners());
+
+    for (unsigned i = 0; i < rx_frames.size(); i++)
+    {
+        can_driver.ifaces[1].pushRx(rx_frames[i]);
+    }
+
+    ASSERT_LE(0, node.spin(clock_driver.getMonotonic() + durMono(10000)));
+
+    ASSERT_EQ(rx_frames.size(), listener.records.size());
+    for (unsigned i = 0; i < rx_frames.size(); i++)
+    {
+        const MavlinkViewListener::Record& rec = listener.records.at(i);
+        EXPECT_EQ(0x42, rec.seq);
+        EXPECT_EQ(0xa5, rec.msgid);
+        EXPECT_EQ(std::string("Msg").substr(0, 3 - i), rec.payload);
+        EXPECT_EQ(rx_frames[i].getSrcNodeID(), rec.src_node_id);
+    }
+
+    sub.stop();
+    ASSERT_EQ(0, node.getDispatcher().getNumMessageListeners());
+}
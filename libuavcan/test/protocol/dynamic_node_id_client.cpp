@@ -13,6 +13,7 @@ TEST(DynamicNodeIDClient, Basic)
     InterlinkedTestNodesWithSysClock nodes(uavcan::NodeID(10), uavcan::NodeID::Broadcast);
 
     uavcan::DynamicNodeIDClient dnidac(nodes.b);
+    dnidac.setCanFDRequestsEnabled(false);          // Three-stage exchange is tested here
 
     uavcan::GlobalDataTypeRegistry::instance().reset();
     uavcan::DefaultDataTypeRegistrator<uavcan::protocol::dynamic_node_id::Allocation> _reg1;
@@ -159,6 +160,97 @@ TEST(DynamicNodeIDClient, Basic)
 }
 
 
+TEST(DynamicNodeIDClient, FastHandshake)
+{
+    using uavcan::protocol::dynamic_node_id::Allocation;
+
+    InterlinkedTestNodesWithSysClock nodes(uavcan::NodeID(10), uavcan::NodeID::Broadcast);
+
+    uavcan::DynamicNodeIDClient dnidac(nodes.b);
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<Allocation> _reg1;
+    (void)_reg1;
+
+    /*
+     * Configuration
+     */
+    ASSERT_EQ(uavcan::MonotonicDuration::fromMSec(Allocation::MAX_FOLLOWUP_DELAY_MS), dnidac.getMaxFollowupDelay());
+    dnidac.setMaxFollowupDelay(uavcan::MonotonicDuration::fromMSec(10000));
+    ASSERT_EQ(uavcan::MonotonicDuration::fromMSec(Allocation::MAX_FOLLOWUP_DELAY_MS), dnidac.getMaxFollowupDelay());
+    dnidac.setMaxFollowupDelay(uavcan::MonotonicDuration());
+    ASSERT_EQ(uavcan::MonotonicDuration(), dnidac.getMaxFollowupDelay());
+
+    ASSERT_FALSE(dnidac.isImmediateFirstRequestEnabled());
+    dnidac.setImmediateFirstRequest(true);
+    ASSERT_TRUE(dnidac.isImmediateFirstRequestEnabled());
+
+    ASSERT_EQ(bool(UAVCAN_CAN_FD), dnidac.areCanFDRequestsEnabled());
+    const uint8_t BytesPerRequest = UAVCAN_CAN_FD ? 14 : Allocation::MAX_LENGTH_OF_UNIQUE_ID_IN_REQUEST;
+
+    SubscriberWithCollector<Allocation> dynid_sub(nodes.a);
+    ASSERT_LE(0, dynid_sub.start());
+    dynid_sub.subscriber.allowAnonymousTransfers();
+
+    uavcan::Publisher<Allocation> dynid_pub(nodes.a);
+    ASSERT_LE(0, dynid_pub.init());
+
+    uavcan::protocol::HardwareVersion::FieldTypes::unique_id unique_id;
+    for (uavcan::uint8_t i = 0; i < unique_id.size(); i++)
+    {
+        unique_id[i] = uavcan::uint8_t(i + 1U);
+    }
+    ASSERT_LE(0, dnidac.start(unique_id));
+
+    /*
+     * The first request is published at once instead of waiting for a time slot
+     */
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(20));
+    ASSERT_TRUE(dynid_sub.collector.msg.get());
+    ASSERT_TRUE(dynid_sub.collector.msg->first_part_of_unique_id);
+    ASSERT_EQ(BytesPerRequest, dynid_sub.collector.msg->unique_id.size());
+
+    /*
+     * The follow-up requests are published without delay
+     */
+    uint8_t offset = 0;
+    while (true)
+    {
+        offset = uavcan::uint8_t(offset + dynid_sub.collector.msg->unique_id.size());
+        dynid_sub.collector.msg.reset();
+        if (offset == unique_id.size())
+        {
+            break;
+        }
+
+        Allocation msg;
+        msg.unique_id.resize(offset);
+        uavcan::copy(unique_id.begin(), unique_id.begin() + offset, msg.unique_id.begin());
+        ASSERT_LE(0, dynid_pub.broadcast(msg));
+
+        nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(20));
+        ASSERT_TRUE(dynid_sub.collector.msg.get());
+        ASSERT_FALSE(dynid_sub.collector.msg->first_part_of_unique_id);
+        ASSERT_TRUE(uavcan::equal(dynid_sub.collector.msg->unique_id.begin(),
+                                  dynid_sub.collector.msg->unique_id.end(),
+                                  unique_id.begin() + offset));
+    }
+
+    /*
+     * Allocation; the whole exchange took a few tens of milliseconds
+     */
+    Allocation msg;
+    msg.unique_id.resize(16);
+    msg.node_id = 72;
+    uavcan::copy(unique_id.begin(), unique_id.end(), msg.unique_id.begin());
+    ASSERT_LE(0, dynid_pub.broadcast(msg));
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(20));
+
+    ASSERT_TRUE(dnidac.isAllocationComplete());
+    ASSERT_EQ(uavcan::NodeID(72), dnidac.getAllocatedNodeID());
+}
+
+
 TEST(DynamicNodeIDClient, NonPassiveMode)
 {
     InterlinkedTestNodesWithSysClock nodes;
@@ -115,3 +115,203 @@ TEST(dynamic_node_id_server_AllocationRequestManager, Basic)
 
     ASSERT_EQ(PreferredNodeID, client.getAllocatedNodeID());
 }
+
+
+TEST(dynamic_node_id_server_AllocationRequestManager, FastHandshake)
+{
+    using namespace uavcan::protocol::dynamic_node_id;
+    using namespace uavcan::dynamic_node_id_server;
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<Allocation> _reg1;
+
+    InterlinkedTestNodesWithSysClock nodes(uavcan::NodeID(10), uavcan::NodeID::Broadcast);
+
+    uavcan::DynamicNodeIDClient client(nodes.b);
+    client.setMaxFollowupDelay(uavcan::MonotonicDuration());
+    client.setImmediateFirstRequest(true);
+
+    EventTracer tracer;
+    AllocationRequestHandler handler;
+    handler.can_followup = true;
+
+    AllocationRequestManager manager(nodes.a, tracer, handler);
+    ASSERT_LE(0, manager.init(uavcan::TransferPriority::OneHigherThanLowest));
+
+    uavcan::protocol::HardwareVersion::FieldTypes::unique_id unique_id;
+    for (uavcan::uint8_t i = 0; i < unique_id.size(); i++)
+    {
+        unique_id[i] = uavcan::uint8_t(0xA0U | i);
+    }
+    const uavcan::NodeID PreferredNodeID = 42;
+    ASSERT_LE(0, client.start(unique_id, PreferredNodeID));
+
+    /*
+     * Without the randomized delays the exchange is completed almost at once, rather than in about a second
+     */
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(50));
+    ASSERT_TRUE(handler.matchAndPopLastRequest(unique_id, PreferredNodeID));
+    ASSERT_EQ(UAVCAN_CAN_FD ? 1 : 2, tracer.countEvents(TraceAllocationFollowupResponse));
+
+    ASSERT_LE(0, manager.broadcastAllocationResponse(unique_id, PreferredNodeID));
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10));
+    ASSERT_TRUE(client.isAllocationComplete());
+}
+
+
+static void publishAllocationRequest(uavcan::Publisher<uavcan::protocol::dynamic_node_id::Allocation>& pub,
+                                     const UniqueID& unique_id, uavcan::uint8_t offset, uavcan::uint8_t size)
+{
+    uavcan::protocol::dynamic_node_id::Allocation msg;
+    msg.first_part_of_unique_id = (offset == 0);
+    for (uavcan::uint8_t i = 0; i < size; i++)
+    {
+        msg.unique_id.push_back(unique_id[offset + i]);
+    }
+    ASSERT_LE(0, pub.broadcast(msg));
+}
+
+
+static void publishAllocationRequest(uavcan::Publisher<uavcan::protocol::dynamic_node_id::Allocation>& pub,
+                                     const UniqueID& unique_id, uavcan::uint8_t stage)
+{
+    uavcan::protocol::dynamic_node_id::Allocation msg;
+    msg.first_part_of_unique_id = (stage == 1);
+    const uavcan::uint8_t offset = uavcan::uint8_t((stage - 1U) * 6U);
+    const uavcan::uint8_t size = uavcan::uint8_t((stage < 3) ? 6U : 4U);
+    for (uavcan::uint8_t i = 0; i < size; i++)
+    {
+        msg.unique_id.push_back(unique_id[offset + i]);
+    }
+    ASSERT_LE(0, pub.broadcast(msg));
+}
+
+
+TEST(dynamic_node_id_server_AllocationRequestManager, QueuedFirstStageRequests)
+{
+    using namespace uavcan::protocol::dynamic_node_id;
+    using namespace uavcan::dynamic_node_id_server;
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<Allocation> _reg1;
+
+    // Node A is Allocator, Node B emulates several allocatees
+    InterlinkedTestNodesWithSysClock nodes(uavcan::NodeID(10), uavcan::NodeID::Broadcast);
+
+    uavcan::Publisher<Allocation> pub(nodes.b);
+    ASSERT_LE(0, pub.init());
+    pub.allowAnonymousTransfers();
+
+    SubscriberWithCollector<Allocation> sub(nodes.b);
+    ASSERT_LE(0, sub.start());
+
+    EventTracer tracer;
+    AllocationRequestHandler handler;
+    handler.can_followup = true;
+
+    AllocationRequestManager manager(nodes.a, tracer, handler);
+    ASSERT_LE(0, manager.init(uavcan::TransferPriority::OneHigherThanLowest));
+
+    UniqueID unique_id_a;
+    UniqueID unique_id_b;
+    for (uavcan::uint8_t i = 0; i < unique_id_a.size(); i++)
+    {
+        unique_id_a[i] = i;
+        unique_id_b[i] = uavcan::uint8_t(0xF0U | i);
+    }
+
+    /*
+     * The first stage of B arrives while the exchange with A is in progress, so it is queued
+     */
+    publishAllocationRequest(pub, unique_id_a, 1);
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10));
+    ASSERT_TRUE(sub.collector.msg.get());
+    ASSERT_EQ(6, sub.collector.msg->unique_id.size());
+    ASSERT_EQ(5, sub.collector.msg->unique_id[5]);
+
+    publishAllocationRequest(pub, unique_id_b, 1);
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10));
+    ASSERT_EQ(1, tracer.countEvents(TraceAllocationRequestQueued));
+
+    publishAllocationRequest(pub, unique_id_a, 2);
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10));
+    ASSERT_EQ(12, sub.collector.msg->unique_id.size());
+
+    /*
+     * Once A is complete, the follow-up response for B is published right away
+     */
+    sub.collector.msg.reset();
+    publishAllocationRequest(pub, unique_id_a, 3);
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10));
+    ASSERT_TRUE(handler.matchAndPopLastRequest(unique_id_a, uavcan::NodeID::Broadcast));
+
+    ASSERT_TRUE(sub.collector.msg.get());
+    ASSERT_EQ(6, sub.collector.msg->unique_id.size());
+    ASSERT_EQ(0xF5, sub.collector.msg->unique_id[5]);
+
+    publishAllocationRequest(pub, unique_id_b, 2);
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10));
+    publishAllocationRequest(pub, unique_id_b, 3);
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10));
+    ASSERT_TRUE(handler.matchAndPopLastRequest(unique_id_b, uavcan::NodeID::Broadcast));
+}
+
+
+TEST(dynamic_node_id_server_AllocationRequestManager, StagesOfAnySize)
+{
+    using namespace uavcan::protocol::dynamic_node_id;
+    using namespace uavcan::dynamic_node_id_server;
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<Allocation> _reg1;
+
+    InterlinkedTestNodesWithSysClock nodes(uavcan::NodeID(10), uavcan::NodeID::Broadcast);
+
+    uavcan::Publisher<Allocation> pub(nodes.b);
+    ASSERT_LE(0, pub.init());
+    pub.allowAnonymousTransfers();
+
+    SubscriberWithCollector<Allocation> sub(nodes.b);
+    ASSERT_LE(0, sub.start());
+
+    EventTracer tracer;
+    AllocationRequestHandler handler;
+    handler.can_followup = true;
+
+    AllocationRequestManager manager(nodes.a, tracer, handler);
+    ASSERT_LE(0, manager.init(uavcan::TransferPriority::OneHigherThanLowest));
+
+    UniqueID unique_id;
+    for (uavcan::uint8_t i = 0; i < unique_id.size(); i++)
+    {
+        unique_id[i] = uavcan::uint8_t(0x30U | i);
+    }
+
+    /*
+     * Every stage continues where the follow-up response ended, whatever its size
+     */
+    publishAllocationRequest(pub, unique_id, 0, 4);
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10));
+    ASSERT_TRUE(sub.collector.msg.get());
+    ASSERT_EQ(4, sub.collector.msg->unique_id.size());
+
+    publishAllocationRequest(pub, unique_id, 4, 1);
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10));
+    ASSERT_EQ(5, sub.collector.msg->unique_id.size());
+
+    publishAllocationRequest(pub, unique_id, 5, 6);
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10));
+    ASSERT_EQ(11, sub.collector.msg->unique_id.size());
+
+    /*
+     * A stage that doesn't fit the rest of the unique ID is rejected without breaking the exchange
+     */
+    ASSERT_EQ(0, tracer.countEvents(TraceAllocationBadRequest));
+    publishAllocationRequest(pub, unique_id, 5, 6);
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10));
+    ASSERT_EQ(1, tracer.countEvents(TraceAllocationBadRequest));
+
+    publishAllocationRequest(pub, unique_id, 11, 5);
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10));
+    ASSERT_TRUE(handler.matchAndPopLastRequest(unique_id, uavcan::NodeID::Broadcast));
+}
@@ -69,6 +69,99 @@ TEST(dynamic_node_id_server_centralized_Server, Basic)
 }
 
 
+/**
+ * Many nodes requesting allocation at the same time, e.g. at power-on.
+ * Reports the time it took to allocate all of them.
+ */
+TEST(dynamic_node_id_server_centralized_Server, AllocationStorm)
+{
+    using namespace uavcan::dynamic_node_id_server;
+    using namespace uavcan::protocol::dynamic_node_id;
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<Allocation> _reg1;
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::GetNodeInfo> _reg2;
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::NodeStatus> _reg3;
+
+    static const unsigned NumClients = 8;
+
+    typedef TestNetwork<1>::NodeEnvironment NodeEnvironment;
+    std::auto_ptr<NodeEnvironment> server_env(new NodeEnvironment(uavcan::NodeID(10)));
+    std::auto_ptr<NodeEnvironment> client_envs[NumClients];
+    for (unsigned i = 0; i < NumClients; i++)
+    {
+        client_envs[i].reset(new NodeEnvironment(uavcan::NodeID::Broadcast));
+        server_env->can_driver.linkTogether(&client_envs[i]->can_driver);
+        for (unsigned k = 0; k < i; k++)
+        {
+            client_envs[i]->can_driver.linkTogether(&client_envs[k]->can_driver);
+        }
+    }
+
+    /*
+     * Server
+     */
+    EventTracer tracer;
+    MemoryStorageBackend storage;
+    CentralizedServer server(server_env->node, storage, tracer);
+
+    UniqueID own_unique_id;
+    own_unique_id[0] = 0xAA;
+    ASSERT_LE(0, server.init(own_unique_id));
+
+    /*
+     * Clients
+     */
+    std::auto_ptr<uavcan::DynamicNodeIDClient> clients[NumClients];
+    for (unsigned i = 0; i < NumClients; i++)
+    {
+        uavcan::protocol::HardwareVersion::FieldTypes::unique_id unique_id;
+        for (uavcan::uint8_t k = 0; k < unique_id.size(); k++)
+        {
+            unique_id[k] = uavcan::uint8_t(k + 1U);
+        }
+        unique_id[0] = uavcan::uint8_t(i);
+        clients[i].reset(new uavcan::DynamicNodeIDClient(client_envs[i]->node));
+        ASSERT_LE(0, clients[i]->start(unique_id));
+    }
+
+    /*
+     * Fire
+     */
+    const uavcan::MonotonicTime started_at = server_env->clock.getMonotonic();
+    uavcan::MonotonicTime completed_at;
+
+    while ((server_env->clock.getMonotonic() - started_at) < uavcan::MonotonicDuration::fromMSec(60000))
+    {
+        ASSERT_LE(0, server_env->node.spin(uavcan::MonotonicDuration::fromMSec(1)));
+        unsigned num_allocated = 0;
+        for (unsigned i = 0; i < NumClients; i++)
+        {
+            ASSERT_LE(0, client_envs[i]->node.spin(uavcan::MonotonicDuration::fromMSec(1)));
+            num_allocated += clients[i]->isAllocationComplete() ? 1U : 0U;
+        }
+        if (num_allocated == NumClients)
+        {
+            completed_at = server_env->clock.getMonotonic();
+            break;
+        }
+    }
+
+    ASSERT_FALSE(completed_at.isZero());
+    std::cout << "Time to allocate " << NumClients << " nodes: " << (completed_at - started_at).toMSec() << " ms, "
+              << tracer.countEvents(TraceAllocationRequestQueued) << " requests queued" << std::endl;
+
+    ASSERT_EQ(NumClients + 1, server.getNumAllocations());
+    for (unsigned i = 0; i < NumClients; i++)
+    {
+        for (unsigned k = 0; k < i; k++)
+        {
+            ASSERT_NE(clients[i]->getAllocatedNodeID(), clients[k]->getAllocatedNodeID());
+        }
+    }
+}
+
+
 TEST(dynamic_node_id_server_centralized, ObjectSizes)
 {
     using namespace uavcan::dynamic_node_id_server;
@@ -147,6 +147,8 @@ TEST(dynamic_node_id_server_Log, Append)
 
     ASSERT_EQ(1, log.getLastIndex());
     ASSERT_TRUE(entry == *log.getEntryAtIndex(1));
+    ASSERT_TRUE(log.isNodeIDInLog(1));
+    ASSERT_FALSE(log.isNodeIDInLog(2));
 
     /*
      * Adding another entry while storage is failing
@@ -163,6 +165,7 @@ TEST(dynamic_node_id_server_Log, Append)
     ASSERT_EQ(7, storage.getNumKeys());  // No new entries, we failed
 
     ASSERT_EQ(1, log.getLastIndex());
+    ASSERT_FALSE(log.isNodeIDInLog(2));
 
     /*
      * Making sure append() fails when the log is full
@@ -181,6 +184,18 @@ TEST(dynamic_node_id_server_Log, Append)
 
     ASSERT_GT(0, log.append(entry));  // Failing because full
 
+    /*
+     * The node ID mask must be restored from the storage
+     */
+    {
+        Log restored_log(storage, tracer);
+        ASSERT_LE(0, restored_log.init());
+        ASSERT_EQ(log.Capacity - 1, restored_log.getLastIndex());
+        ASSERT_TRUE(restored_log.isNodeIDInLog(1));
+        ASSERT_TRUE(restored_log.isNodeIDInLog(64));
+        ASSERT_TRUE(restored_log.isNodeIDInLog(127));
+    }
+
     storage.print();
 }
 
@@ -227,17 +242,144 @@ TEST(dynamic_node_id_server_Log, Remove)
 
     ASSERT_EQ(log.Capacity - 1, log.getLastIndex());
 
+    ASSERT_TRUE(log.isNodeIDInLog(60));
     ASSERT_LE(0, log.removeEntriesWhereIndexGreaterOrEqual(60));
     ASSERT_EQ(59, log.getLastIndex());
     ASSERT_EQ("59", storage.get("log_last_index"));
+    ASSERT_TRUE(log.isNodeIDInLog(59));
+    ASSERT_FALSE(log.isNodeIDInLog(60));
 
     ASSERT_LE(0, log.removeEntriesWhereIndexGreater(30));
     ASSERT_EQ(30, log.getLastIndex());
     ASSERT_EQ("30", storage.get("log_last_index"));
+    ASSERT_TRUE(log.isNodeIDInLog(30));
+    ASSERT_FALSE(log.isNodeIDInLog(31));
 
     ASSERT_LE(0, log.removeEntriesWhereIndexGreaterOrEqual(1));
     ASSERT_EQ(0, log.getLastIndex());
     ASSERT_EQ("0", storage.get("log_last_index"));
+    ASSERT_FALSE(log.isNodeIDInLog(1));
 
     storage.print();
 }
+
+
+TEST(dynamic_node_id_server_Log, BatchedAppend)
+{
+    using namespace uavcan::dynamic_node_id_server::distributed;
+
+    EventTracer tracer;
+    MemoryStorageBackend storage;
+    Log log(storage, tracer);
+
+    ASSERT_LE(0, log.init());
+
+    uavcan::protocol::dynamic_node_id::server::Entry entry;
+    entry.term = 1;
+    entry.node_id = 1;
+    entry.unique_id[0] = 1;
+
+    /*
+     * Every append is written as one batch
+     */
+    ASSERT_EQ(0, storage.getNumCommittedBatches());
+    ASSERT_LE(0, log.append(entry));
+    ASSERT_LE(0, log.append(entry));
+    ASSERT_EQ(2, storage.getNumCommittedBatches());
+    ASSERT_EQ(2, log.getLastIndex());
+
+    /*
+     * Failing commit fails the append
+     */
+    storage.failOnCommitCalls(true);
+    ASSERT_GT(0, log.append(entry));
+    ASSERT_EQ(2, log.getLastIndex());
+    ASSERT_EQ(2, storage.getNumCommittedBatches());
+
+    storage.failOnCommitCalls(false);
+    ASSERT_LE(0, log.append(entry));
+    ASSERT_EQ(3, log.getLastIndex());
+    ASSERT_EQ(3, storage.getNumCommittedBatches());
+}
+
+
+TEST(dynamic_node_id_server_Log, Lookup)
+{
+    using namespace uavcan::dynamic_node_id_server::distributed;
+
+    EventTracer tracer;
+    MemoryStorageBackend storage;
+    Log log(storage, tracer);
+
+    ASSERT_LE(0, log.init());
+
+    /*
+     * Filling the log with pseudo-random unique IDs; every fourth entry reuses the unique ID of the previous one
+     */
+    uavcan::protocol::dynamic_node_id::server::Entry entry;
+    std::srand(42);
+    while (log.getLastIndex() < (log.Capacity - 1))
+    {
+        entry.term = 1;
+        entry.node_id = uint8_t(log.getLastIndex() + 1U);
+        if ((entry.node_id % 4) != 0)
+        {
+            for (uint8_t i = 0; i < entry.unique_id.size(); i++)
+            {
+                entry.unique_id[i] = uint8_t(std::rand());
+            }
+        }
+        ASSERT_LE(0, log.append(entry));
+    }
+
+    /*
+     * Every lookup must yield the same result as a linear search from the end of the log
+     */
+    for (int index = log.getLastIndex(); index > 0; index--)
+    {
+        const uavcan::protocol::dynamic_node_id::server::Entry& e = *log.getEntryAtIndex(Log::Index(index));
+
+        Log::Index expected_index = log.getLastIndex();
+        while (log.getEntryAtIndex(expected_index)->unique_id != e.unique_id)
+        {
+            expected_index--;
+        }
+
+        Log::Index found_index = 0;
+        ASSERT_TRUE(log.findLastEntryWithUniqueID(e.unique_id, found_index));
+        ASSERT_EQ(expected_index, found_index);
+
+        ASSERT_TRUE(log.findLastEntryWithNodeID(e.node_id, found_index));
+        ASSERT_EQ(index, found_index);
+    }
+
+    Log::Index found_index = 123;
+    entry.unique_id[0] = uint8_t(entry.unique_id[0] + 1U);
+    ASSERT_FALSE(log.findLastEntryWithUniqueID(entry.unique_id, found_index));
+    ASSERT_EQ(123, found_index);
+
+    /*
+     * After truncation, the removed entries must not be found; the index must be restored from the storage
+     */
+    ASSERT_LE(0, log.removeEntriesWhereIndexGreater(4));
+
+    const uavcan::protocol::dynamic_node_id::server::Entry last_entry = *log.getEntryAtIndex(4);
+    ASSERT_TRUE(log.findLastEntryWithUniqueID(last_entry.unique_id, found_index));
+    ASSERT_EQ(4, found_index);
+    ASSERT_FALSE(log.findLastEntryWithNodeID(5, found_index));
+
+    Log restored_log(storage, tracer);
+    ASSERT_LE(0, restored_log.init());
+    ASSERT_TRUE(restored_log.findLastEntryWithUniqueID(last_entry.unique_id, found_index));
+    ASSERT_EQ(4, found_index);
+    ASSERT_TRUE(restored_log.findLastEntryWithNodeID(3, found_index));
+    ASSERT_EQ(3, found_index);
+    ASSERT_FALSE(restored_log.findLastEntryWithNodeID(5, found_index));
+
+    /*
+     * Appending a new entry with an existing unique ID makes it the last one
+     */
+    ASSERT_LE(0, log.append(last_entry));
+    ASSERT_TRUE(log.findLastEntryWithUniqueID(last_entry.unique_id, found_index));
+    ASSERT_EQ(5, found_index);
+}
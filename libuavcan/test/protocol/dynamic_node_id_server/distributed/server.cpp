@@ -115,6 +115,157 @@ TEST(dynamic_node_id_server_RaftCore, Basic)
 }
 
 
+TEST(dynamic_node_id_server_RaftCore, Replication)
+{
+    using namespace uavcan::dynamic_node_id_server::distributed;
+    using namespace uavcan::protocol::dynamic_node_id::server;
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<Discovery> _reg1;
+    uavcan::DefaultDataTypeRegistrator<AppendEntries> _reg2;
+    uavcan::DefaultDataTypeRegistrator<RequestVote> _reg3;
+
+    EventTracer tracer_a("a");
+    EventTracer tracer_b("b");
+    MemoryStorageBackend storage_a;
+    MemoryStorageBackend storage_b;
+    CommitHandler commit_handler_a("a");
+    CommitHandler commit_handler_b("b");
+
+    InterlinkedTestNodesWithSysClock nodes;
+
+    std::auto_ptr<RaftCore> raft_a(new RaftCore(nodes.a, storage_a, tracer_a, commit_handler_a));
+    std::auto_ptr<RaftCore> raft_b(new RaftCore(nodes.b, storage_b, tracer_b, commit_handler_b));
+
+    ASSERT_LE(0, raft_a->init(2, uavcan::TransferPriority::OneHigherThanLowest));
+    ASSERT_LE(0, raft_b->init(2, uavcan::TransferPriority::OneHigherThanLowest));
+
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(9000));
+
+    ASSERT_TRUE(raft_a->isLeader() || raft_b->isLeader());
+
+    /*
+     * Many entries are replicated within one update interval of the leader, because calls are pipelined
+     */
+    RaftCore& leader = raft_a->isLeader() ? *raft_a : *raft_b;
+    RaftCore& follower = raft_a->isLeader() ? *raft_b : *raft_a;
+
+    Entry::FieldTypes::unique_id unique_id;
+    for (uavcan::uint8_t i = 1; i <= 20; i++)
+    {
+        uavcan::fill_n(unique_id.begin(), 16, i);
+        leader.appendLog(unique_id, uavcan::NodeID(i));
+    }
+
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(1500));
+
+    ASSERT_EQ(20, leader.getCommitIndex());
+    ASSERT_EQ(20, follower.getCommitIndex());
+    ASSERT_FALSE(follower.isLeader());
+}
+
+
+/**
+ * Returns the index of the only leader, or -1.
+ */
+template <unsigned ClusterSize>
+static int findOnlyLeader(std::auto_ptr<uavcan::dynamic_node_id_server::distributed::RaftCore> (&rafts)[ClusterSize])
+{
+    int leader = -1;
+    for (unsigned i = 0; i < ClusterSize; i++)
+    {
+        if ((rafts[i].get() != NULL) && rafts[i]->isLeader())
+        {
+            if (leader >= 0)
+            {
+                return -1;
+            }
+            leader = int(i);
+        }
+    }
+    return leader;
+}
+
+/**
+ * Kills the leader of the cluster several times and measures the time until the remaining servers elect a new one.
+ * The killed server is brought back with its storage before the next round.
+ */
+template <unsigned ClusterSize>
+static void runFailoverBenchmark()
+{
+    using namespace uavcan::dynamic_node_id_server::distributed;
+    using namespace uavcan::protocol::dynamic_node_id::server;
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<Discovery> _reg1;
+    uavcan::DefaultDataTypeRegistrator<AppendEntries> _reg2;
+    uavcan::DefaultDataTypeRegistrator<RequestVote> _reg3;
+
+    static const unsigned NumRounds = 3;
+
+    EventTracer tracer;
+    MemoryStorageBackend storages[ClusterSize];
+    CommitHandler commit_handler("");
+
+    TestNetwork<ClusterSize> nodes;
+
+    std::auto_ptr<RaftCore> rafts[ClusterSize];
+    for (unsigned i = 0; i < ClusterSize; i++)
+    {
+        rafts[i].reset(new RaftCore(nodes[i], storages[i], tracer, commit_handler));
+        ASSERT_LE(0, rafts[i]->init(ClusterSize, uavcan::TransferPriority::OneHigherThanLowest));
+    }
+
+    const uavcan::MonotonicDuration step = uavcan::MonotonicDuration::fromMSec(10);
+    const uavcan::MonotonicDuration max_failover_time =
+        uavcan::MonotonicDuration::fromMSec(AppendEntries::Request::DEFAULT_MAX_ELECTION_TIMEOUT_MS + 1000);
+
+    nodes.spinAll(uavcan::MonotonicDuration::fromMSec(AppendEntries::Request::DEFAULT_MAX_ELECTION_TIMEOUT_MS * 2));
+    ASSERT_LE(0, findOnlyLeader(rafts));
+
+    uavcan::MonotonicDuration worst_failover_time;
+    for (unsigned round = 0; round < NumRounds; round++)
+    {
+        const int old_leader = findOnlyLeader(rafts);
+        ASSERT_LE(0, old_leader);
+        const Log::Index commit_index = rafts[old_leader]->getCommitIndex();
+
+        rafts[old_leader].reset();
+        const uavcan::MonotonicTime killed_at = nodes[0].getMonotonicTime();
+
+        int new_leader = -1;
+        while ((new_leader < 0) && ((nodes[0].getMonotonicTime() - killed_at) < max_failover_time))
+        {
+            nodes.spinAll(step);
+            new_leader = findOnlyLeader(rafts);
+        }
+        const uavcan::MonotonicDuration failover_time = nodes[0].getMonotonicTime() - killed_at;
+
+        std::cout << "Failover with " << ClusterSize << " servers: " << failover_time.toMSec() << " ms" << std::endl;
+        ASSERT_LE(0, new_leader);
+        ASSERT_NE(old_leader, new_leader);
+        ASSERT_LE(commit_index, rafts[new_leader]->getCommitIndex());
+        worst_failover_time = uavcan::max(worst_failover_time, failover_time);
+
+        // Bringing the old leader back; it must join as a follower
+        rafts[old_leader].reset(new RaftCore(nodes[unsigned(old_leader)], storages[old_leader], tracer,
+                                             commit_handler));
+        ASSERT_LE(0, rafts[old_leader]->init(ClusterSize, uavcan::TransferPriority::OneHigherThanLowest));
+        nodes.spinAll(uavcan::MonotonicDuration::fromMSec(AppendEntries::Request::DEFAULT_MIN_ELECTION_TIMEOUT_MS));
+        ASSERT_EQ(new_leader, findOnlyLeader(rafts));
+    }
+
+    std::cout << "Worst failover with " << ClusterSize << " servers: " << worst_failover_time.toMSec() << " ms, "
+              << "update interval " << rafts[0]->getUpdateInterval().toMSec() << " ms" << std::endl;
+}
+
+TEST(dynamic_node_id_server_RaftCore, FailoverBenchmark)
+{
+    runFailoverBenchmark<3>();
+    runFailoverBenchmark<5>();
+}
+
+
 TEST(dynamic_node_id_server_Server, Basic)
 {
     using namespace uavcan::dynamic_node_id_server;
@@ -13,10 +13,16 @@ class MemoryStorageBackend : public uavcan::dynamic_node_id_server::IStorageBack
     Container container_;
 
     bool fail_;
+    bool fail_commit_;
+    bool in_batch_;
+    unsigned num_committed_batches_;
 
 public:
     MemoryStorageBackend()
         : fail_(false)
+        , fail_commit_(false)
+        , in_batch_(false)
+        , num_committed_batches_(0)
     { }
 
     virtual String get(const String& key) const
@@ -37,7 +43,28 @@ public:
         }
     }
 
+    virtual void beginBatch()
+    {
+        EXPECT_FALSE(in_batch_);        // Batches are never nested
+        in_batch_ = true;
+    }
+
+    virtual int commitBatch()
+    {
+        EXPECT_TRUE(in_batch_);
+        in_batch_ = false;
+        if (fail_commit_)
+        {
+            return -uavcan::ErrFailure;
+        }
+        num_committed_batches_++;
+        return 0;
+    }
+
     void failOnSetCalls(bool really) { fail_ = really; }
+    void failOnCommitCalls(bool really) { fail_commit_ = really; }
+
+    unsigned getNumCommittedBatches() const { return num_committed_batches_; }
 
     void reset() { container_.clear(); }
 
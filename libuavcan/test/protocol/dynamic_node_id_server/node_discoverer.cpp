@@ -274,6 +274,105 @@ TEST(dynamic_node_id_server_NodeDiscoverer, RestartAndMaxAttempts)
 }
 
 
+TEST(dynamic_node_id_server_NodeDiscoverer, ManyNodes)
+{
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::NodeStatus> _reg1;
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::GetNodeInfo> _reg2;
+
+    static const unsigned NumNodes = 12;
+
+    EventTracer tracer;
+    TestNetwork<NumNodes + 1> nodes;
+    NodeDiscoveryHandler handler;
+    handler.can_discover = true;
+
+    NodeDiscoverer disc(nodes[0], tracer, handler);
+    ASSERT_LE(0, disc.init(uavcan::TransferPriority::OneHigherThanLowest));
+    ASSERT_EQ(1, disc.getRequestsPerInterval());
+
+    /*
+     * All nodes appear at once; every other one does not implement GetNodeInfo
+     */
+    std::auto_ptr<GetNodeInfoMockServer> servers[NumNodes];
+    std::auto_ptr<uavcan::Publisher<uavcan::protocol::NodeStatus> > publishers[NumNodes];
+    for (unsigned i = 0; i < NumNodes; i++)
+    {
+        if (i % 2 == 0)
+        {
+            servers[i].reset(new GetNodeInfoMockServer(nodes[i + 1]));
+            servers[i]->response.hardware_version.unique_id[0] = uint8_t(i + 1);
+            ASSERT_LE(0, servers[i]->start());
+        }
+        publishers[i].reset(new uavcan::Publisher<uavcan::protocol::NodeStatus>(nodes[i + 1]));
+        ASSERT_LE(0, publishers[i]->broadcast(uavcan::protocol::NodeStatus()));
+    }
+
+    nodes.spinAll(uavcan::MonotonicDuration::fromMSec(1000));
+
+    // Serial querying would have taken more than two seconds
+    ASSERT_EQ(NumNodes / 2, handler.nodes.size());
+    ASSERT_EQ(NumNodes / 2, disc.getNumUnknownNodes());
+    for (unsigned i = 0; i < NumNodes; i += 2)
+    {
+        ASSERT_TRUE(handler.findNode(servers[i]->response.hardware_version.unique_id));
+        ASSERT_EQ(i + 2, handler.findNode(servers[i]->response.hardware_version.unique_id)->node_id.get());
+    }
+
+    /*
+     * The silent nodes are finalized after the maximum number of attempts; the timeouts reduce the rate
+     */
+    nodes.spinAll(uavcan::MonotonicDuration::fromMSec(6000));
+
+    ASSERT_FALSE(disc.hasUnknownNodes());
+    ASSERT_EQ(NumNodes, handler.nodes.size());
+    ASSERT_EQ(1, disc.getRequestsPerInterval());
+    ASSERT_EQ(NumNodes / 2 * 5, tracer.countEvents(TraceDiscoveryGetNodeInfoFailure));
+    ASSERT_EQ(NumNodes / 2 * 6, tracer.countEvents(TraceDiscoveryGetNodeInfoRequest));
+}
+
+
+TEST(dynamic_node_id_server_NodeDiscoverer, SharedWithNodeInfoRetriever)
+{
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::NodeStatus> _reg1;
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::GetNodeInfo> _reg2;
+
+    EventTracer tracer;
+    InterlinkedTestNodesWithSysClock nodes;
+    NodeDiscoveryHandler handler;
+    handler.can_discover = true;
+
+    uavcan::NodeInfoRetriever retriever(nodes.a);
+    ASSERT_LE(0, retriever.start());
+
+    NodeDiscoverer disc(nodes.a, tracer, handler);
+    ASSERT_LE(0, disc.init(uavcan::TransferPriority::OneHigherThanLowest));
+    ASSERT_LE(0, disc.setNodeInfoRetriever(&retriever));
+    ASSERT_EQ(&retriever, disc.getNodeInfoRetriever());
+    ASSERT_EQ(1, retriever.getNumListeners());
+
+    GetNodeInfoMockServer get_node_info_server(nodes.b);
+    get_node_info_server.response.hardware_version.unique_id[0] = 123;
+    ASSERT_LE(0, get_node_info_server.start());
+
+    uavcan::Publisher<uavcan::protocol::NodeStatus> node_status_pub(nodes.b);
+    ASSERT_LE(0, node_status_pub.broadcast(uavcan::protocol::NodeStatus()));
+
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(500));
+
+    // Discovered without its own requests
+    ASSERT_FALSE(disc.hasUnknownNodes());
+    ASSERT_EQ(0, tracer.countEvents(TraceDiscoveryGetNodeInfoRequest));
+    ASSERT_EQ(1, tracer.countEvents(TraceDiscoveryNodeFinalized));
+    ASSERT_TRUE(handler.findNode(get_node_info_server.response.hardware_version.unique_id));
+    ASSERT_EQ(2, handler.findNode(get_node_info_server.response.hardware_version.unique_id)->node_id.get());
+
+    ASSERT_LE(0, disc.setNodeInfoRetriever(NULL));
+    ASSERT_EQ(0, retriever.getNumListeners());
+}
+
+
 TEST(dynamic_node_id_server_NodeDiscoverer, Sizes)
 {
     using namespace uavcan;
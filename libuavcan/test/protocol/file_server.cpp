@@ -4,6 +4,8 @@
 
 #include <gtest/gtest.h>
 #include <uavcan/protocol/file_server.hpp>
+#include <uavcan/protocol/compressed_file_server_backend.hpp>
+#include <cstdlib>
 #include "helpers.hpp"
 
 
@@ -108,6 +110,31 @@ TEST(BasicFileServer, Basic)
 
         ASSERT_EQ("123456789", read.collector.result->getResponse().data);
         ASSERT_EQ(0, read.collector.result->getResponse().error.value);
+
+        /*
+         * Read statistics
+         */
+        ASSERT_EQ(1, serv.getNumReadClients());
+        ASSERT_EQ(uavcan::NodeID(2), serv.getReadClientByIndex(0));
+        ASSERT_EQ(uavcan::NodeID(), serv.getReadClientByIndex(1));
+        ASSERT_EQ(1, serv.getReadStats(2).num_requests);
+        ASSERT_EQ(9, serv.getReadStats(2).num_bytes);
+        ASSERT_FLOAT_EQ(0.0F, serv.getReadStats(2).getRequestRate());   // Not enough requests yet
+        ASSERT_EQ(0, serv.getReadStats(3).num_requests);
+
+        read_req.offset = 5;
+        ASSERT_LE(0, read.call(1, read_req));
+        nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10));
+        ASSERT_EQ("6789", read.collector.result->getResponse().data);
+
+        ASSERT_EQ(1, serv.getNumReadClients());
+        ASSERT_EQ(2, serv.getReadStats(2).num_requests);
+        ASSERT_EQ(13, serv.getReadStats(2).num_bytes);
+        ASSERT_LT(0.0F, serv.getReadStats(2).getRequestRate());
+
+        serv.resetReadStats();
+        ASSERT_EQ(0, serv.getNumReadClients());
+        ASSERT_EQ(0, serv.getReadStats(2).num_requests);
     }
 }
 
@@ -134,3 +161,239 @@ TEST(FileServer, Basic)
 
     // TODO TEST
 }
+
+
+class CompressibleFileServerBackend : public uavcan::IFileServerBackend
+{
+public:
+    std::string image;
+    unsigned num_reads;
+
+    CompressibleFileServerBackend() : num_reads(0) { }
+
+    virtual int16_t getInfo(const Path& path, uint64_t& out_size, EntryType& out_type)
+    {
+        if (path == "dir")
+        {
+            out_type.flags = EntryType::FLAG_DIRECTORY;
+            return 0;
+        }
+        if (path != "image")
+        {
+            return Error::NOT_FOUND;
+        }
+        out_size = image.length();
+        out_type.flags = EntryType::FLAG_FILE | EntryType::FLAG_READABLE | EntryType::FLAG_WRITEABLE;
+        return 0;
+    }
+
+    virtual int16_t read(const Path& path, const uint64_t offset, uint8_t* out_buffer, uint16_t& inout_size)
+    {
+        num_reads++;
+        if (path != "image")
+        {
+            return Error::NOT_FOUND;
+        }
+        if (offset < image.length())
+        {
+            inout_size = uint16_t(std::min<uint64_t>(inout_size, image.length() - offset));
+            std::memcpy(out_buffer, image.c_str() + offset, inout_size);
+        }
+        else
+        {
+            inout_size = 0;
+        }
+        return 0;
+    }
+
+    virtual int16_t write(const Path& path, const uint64_t offset, const uint8_t* buffer, const uint16_t size)
+    {
+        if (path != "image")
+        {
+            return Error::NOT_FOUND;
+        }
+        image.resize(std::max<std::size_t>(image.length(), std::size_t(offset + size)));
+        image.replace(std::size_t(offset), size, reinterpret_cast<const char*>(buffer), size);
+        return 0;
+    }
+};
+
+struct StringLzssOutput : public uavcan::ILzssOutput
+{
+    std::string data;
+
+    virtual int write(const uint8_t* ptr, unsigned size)
+    {
+        data.append(reinterpret_cast<const char*>(ptr), size);
+        return 0;
+    }
+};
+
+static std::string readAll(uavcan::IFileServerBackend& backend, const char* path)
+{
+    std::string out;
+    uint8_t buffer[uavcan::IFileServerBackend::ReadSize];
+    for (;;)
+    {
+        uint16_t size = uavcan::IFileServerBackend::ReadSize;
+        EXPECT_EQ(0, backend.read(path, out.length(), buffer, size));
+        out.append(reinterpret_cast<const char*>(buffer), size);
+        if (size < uavcan::IFileServerBackend::ReadSize)
+        {
+            break;
+        }
+    }
+    return out;
+}
+
+TEST(CompressedFileServerBackend, Basic)
+{
+    using uavcan::CompressedFileServerBackend;
+    using namespace uavcan::protocol::file;
+
+    CompressibleFileServerBackend source;
+    for (unsigned i = 0; source.image.length() < 20000; i++)
+    {
+        source.image += "firmware chunk #";
+        source.image += char('0' + i % 10);
+        source.image += char('A' + i % 26);
+    }
+
+    static uint8_t cache[16384];
+    CompressedFileServerBackend backend(source, cache, sizeof(cache), 10);
+
+    ASSERT_STREQ(".lzss", CompressedFileServerBackend::getCompressedPathSuffix());
+    ASSERT_TRUE(CompressedFileServerBackend::makeCompressedPath("image") == "image.lzss");
+    ASSERT_TRUE(CompressedFileServerBackend::makeCompressedPath(std::string(199, 'x').c_str()).empty());
+
+    uint64_t size = 0;
+    EntryType type;
+
+    /*
+     * Pass-through
+     */
+    ASSERT_EQ(0, backend.getInfo("image", size, type));
+    ASSERT_EQ(source.image.length(), size);
+    ASSERT_EQ(source.image, readAll(backend, "image"));
+    ASSERT_EQ(Error::NOT_FOUND, backend.getInfo("nonexistent.lzss", size, type));
+    ASSERT_EQ(Error::NOT_FOUND, backend.getInfo("dir.lzss", size, type));
+    ASSERT_EQ(Error::NOT_FOUND, backend.getInfo(".lzss", size, type));
+    ASSERT_TRUE(backend.getCachedPath().empty());
+
+    /*
+     * Compressed
+     */
+    ASSERT_EQ(0, backend.getInfo("image.lzss", size, type));
+    ASSERT_TRUE(backend.getCachedPath() == "image");
+    ASSERT_EQ(backend.getCachedFileSize(), size);
+    ASSERT_EQ(EntryType::FLAG_FILE | EntryType::FLAG_READABLE, type.flags);
+    std::cout << "Compressed " << source.image.length() << " --> " << size << std::endl;
+    ASSERT_GT(source.image.length() / 3, size);
+
+    const unsigned num_reads = source.num_reads;
+    const std::string compressed = readAll(backend, "image.lzss");
+    ASSERT_EQ(size, compressed.length());
+    ASSERT_EQ(num_reads, source.num_reads);                         // Served from the cache
+
+    uavcan::LzssDecompressor<10> decompressor;
+    StringLzssOutput output;
+    ASSERT_EQ(0, decompressor.feed(reinterpret_cast<const uint8_t*>(compressed.c_str()),
+                                   unsigned(compressed.length()), output));
+    ASSERT_TRUE(decompressor.isFinished());
+    ASSERT_EQ(source.image, output.data);
+
+    // Repeated GetInfo does not compress again
+    ASSERT_EQ(0, backend.getInfo("image.lzss", size, type));
+    ASSERT_EQ(num_reads, source.num_reads);
+
+    // The compressed file is read-only
+    const uint8_t data[3] = { 1, 2, 3 };
+    ASSERT_EQ(Error::ACCESS_DENIED, backend.write("image.lzss", 0, data, 3));
+    ASSERT_EQ(Error::ACCESS_DENIED, backend.remove("image.lzss"));
+
+    // Write of the original file invalidates the cache
+    ASSERT_EQ(0, backend.write("image", 0, data, 3));
+    ASSERT_TRUE(backend.getCachedPath().empty());
+    ASSERT_EQ(0, backend.getInfo("image.lzss", size, type));
+    ASSERT_NE(num_reads, source.num_reads);
+    ASSERT_TRUE(backend.getCachedPath() == "image");
+
+    // Size change of the original file is detected by GetInfo
+    source.image.resize(10000);
+    ASSERT_EQ(0, backend.getInfo("image.lzss", size, type));
+    output.data.clear();
+    decompressor.reset();
+    const std::string compressed2 = readAll(backend, "image.lzss");
+    ASSERT_EQ(0, decompressor.feed(reinterpret_cast<const uint8_t*>(compressed2.c_str()),
+                                   unsigned(compressed2.length()), output));
+    ASSERT_EQ(source.image, output.data);
+
+    // Read without GetInfo
+    backend.invalidateCache();
+    ASSERT_EQ(compressed2, readAll(backend, "image.lzss"));
+
+    /*
+     * Image that does not fit the cache
+     */
+    std::srand(42);
+    for (unsigned i = 0; i < 20000; i++)
+    {
+        source.image += char(std::rand());
+    }
+    ASSERT_EQ(Error::FILE_TOO_LARGE, backend.getInfo("image.lzss", size, type));
+    ASSERT_TRUE(backend.getCachedPath().empty());
+    ASSERT_EQ(0, backend.getInfo("image", size, type));             // Fallback to the original image
+}
+
+TEST(CompressedFileServerBackend, FileServer)
+{
+    using namespace uavcan::protocol::file;
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<GetInfo> _reg1;
+    uavcan::DefaultDataTypeRegistrator<Read> _reg2;
+
+    InterlinkedTestNodesWithSysClock nodes;
+
+    CompressibleFileServerBackend source;
+    source.image = std::string(2000, 'a') + std::string(2000, 'b');
+
+    static uint8_t cache[1024];
+    uavcan::CompressedFileServerBackend backend(source, cache, sizeof(cache));
+
+    uavcan::BasicFileServer serv(nodes.a, backend);
+    ASSERT_LE(0, serv.start());
+
+    ServiceClientWithCollector<GetInfo> get_info(nodes.b);
+    GetInfo::Request get_info_req;
+    get_info_req.path.path = uavcan::CompressedFileServerBackend::makeCompressedPath("image");
+    ASSERT_LE(0, get_info.call(1, get_info_req));
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10));
+    ASSERT_TRUE(get_info.collector.result.get());
+    ASSERT_EQ(0, get_info.collector.result->getResponse().error.value);
+    ASSERT_GT(512, get_info.collector.result->getResponse().size);      // Two responses instead of 16
+
+    // The node feeds the chunks to the decompressor as they arrive
+    ServiceClientWithCollector<Read> read(nodes.b);
+    Read::Request read_req;
+    read_req.path = get_info_req.path;
+
+    uavcan::LzssDecompressor<> decompressor;
+    StringLzssOutput output;
+    unsigned num_reads = 0;
+    while (!decompressor.isFinished())
+    {
+        ASSERT_GT(3, num_reads++);
+        ASSERT_LE(0, read.call(1, read_req));
+        nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10));
+        ASSERT_TRUE(read.collector.result.get());
+        ASSERT_EQ(0, read.collector.result->getResponse().error.value);
+
+        const Read::Response::FieldTypes::data& data = read.collector.result->getResponse().data;
+        ASSERT_EQ(0, decompressor.feed(data.begin(), data.size(), output));
+        read_req.offset += data.size();
+    }
+    ASSERT_EQ(2, num_reads);
+    ASSERT_EQ(get_info.collector.result->getResponse().size, read_req.offset);
+    ASSERT_EQ(source.image, output.data);
+}
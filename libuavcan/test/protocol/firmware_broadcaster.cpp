@@ -0,0 +1,198 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <gtest/gtest.h>
+#include <uavcan/protocol/firmware_broadcaster.hpp>
+#include <root_ns_a/FirmwareImageChunk.hpp>
+#include <string>
+#include "helpers.hpp"
+
+
+class ImageFileServerBackend : public uavcan::IFileServerBackend
+{
+public:
+    std::string image;
+
+    virtual int16_t getInfo(const Path& path, uint64_t& out_size, EntryType& out_type)
+    {
+        if (path != "image")
+        {
+            return Error::NOT_FOUND;
+        }
+        out_size = image.length();
+        out_type.flags = EntryType::FLAG_FILE | EntryType::FLAG_READABLE;
+        return 0;
+    }
+
+    virtual int16_t read(const Path& path, const uint64_t offset, uint8_t* out_buffer, uint16_t& inout_size)
+    {
+        if (path != "image")
+        {
+            return Error::NOT_FOUND;
+        }
+        if (offset < image.length())
+        {
+            inout_size = uint16_t(std::min<uint64_t>(inout_size, image.length() - offset));
+            std::memcpy(out_buffer, image.c_str() + offset, inout_size);
+        }
+        else
+        {
+            inout_size = 0;
+        }
+        return 0;
+    }
+};
+
+
+struct ImageWriter : public uavcan::IFirmwareImageWriter
+{
+    std::string image;
+    unsigned num_writes;
+    uint64_t received_size;
+    bool received;
+    bool failed;
+
+    ImageWriter()
+        : num_writes(0)
+        , received_size(0)
+        , received(false)
+        , failed(false)
+    { }
+
+    virtual int write(uint64_t offset, const uint8_t* data, uint16_t size)
+    {
+        num_writes++;
+        if (image.length() < (offset + size))
+        {
+            image.resize(std::size_t(offset + size));
+        }
+        std::memcpy(&image[std::size_t(offset)], data, size);
+        return 0;
+    }
+
+    virtual void handleImageReceived(uint64_t image_size)
+    {
+        received = true;
+        received_size = image_size;
+    }
+
+    virtual void handleImageReceptionFailure() { failed = true; }
+};
+
+
+static std::string makeImage(unsigned size)
+{
+    std::string image;
+    for (unsigned i = 0; i < size; i++)
+    {
+        image.push_back(char(i * 7U + i / 256U));
+    }
+    return image;
+}
+
+
+TEST(FirmwareBroadcaster, Basic)
+{
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<root_ns_a::FirmwareImageChunk> _reg1;
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::file::GetInfo> _reg2;
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::file::Read> _reg3;
+
+    InterlinkedTestNodesWithSysClock nodes;
+
+    ImageFileServerBackend backend;
+    backend.image = makeImage(256 * 5 + 100);
+
+    uavcan::BasicFileServer server(nodes.a, backend);
+    ASSERT_LE(0, server.start());
+
+    uavcan::FirmwareBroadcaster<root_ns_a::FirmwareImageChunk> broadcaster(nodes.a, backend);
+
+    ASSERT_EQ(-uavcan::ErrInvalidParam, broadcaster.start(""));
+    ASSERT_EQ(-uavcan::ErrInvalidParam, broadcaster.start("image", 0));
+    ASSERT_FALSE(broadcaster.isRunning());
+
+    ImageWriter early_writer;
+    uavcan::FirmwareBroadcastListener<root_ns_a::FirmwareImageChunk> early_listener(nodes.b, early_writer);
+    ASSERT_EQ(-uavcan::ErrInvalidParam, early_listener.start(uavcan::NodeID(), "image"));
+    ASSERT_LE(0, early_listener.start(1, "image"));
+
+    ImageWriter late_writer;
+    uavcan::FirmwareBroadcastListener<root_ns_a::FirmwareImageChunk> late_listener(nodes.b, late_writer);
+
+    ImageWriter foreign_writer;             // Listens to a different image
+    uavcan::FirmwareBroadcastListener<root_ns_a::FirmwareImageChunk> foreign_listener(nodes.b, foreign_writer);
+    ASSERT_LE(0, foreign_listener.start(1, "other"));
+
+    ASSERT_LE(0, broadcaster.start("image", 1, uavcan::MonotonicDuration::fromMSec(10)));
+    ASSERT_TRUE(broadcaster.isRunning());
+    ASSERT_EQ(1, broadcaster.getNumPassesLeft());
+
+    /*
+     * The late listener misses the first chunks
+     */
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(25));
+    ASSERT_LE(0, late_listener.start(1, "image"));
+
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(100));
+
+    ASSERT_FALSE(broadcaster.isRunning());
+    ASSERT_EQ(0, broadcaster.getNumPassesLeft());
+    ASSERT_EQ(0, broadcaster.getOffset());
+
+    ASSERT_TRUE(early_writer.received);
+    ASSERT_FALSE(early_writer.failed);
+    ASSERT_EQ(backend.image.length(), early_writer.received_size);
+    ASSERT_EQ(backend.image, early_writer.image);
+    ASSERT_EQ(6, early_writer.num_writes);
+    ASSERT_FALSE(early_listener.isRunning());
+
+    ASSERT_FALSE(late_writer.received);
+    ASSERT_TRUE(late_listener.isRunning());
+    ASSERT_GT(6, late_listener.getNumReceivedChunks());
+
+    /*
+     * The late listener reads the missing chunks from the server once the broadcast times out
+     */
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(1500));
+
+    ASSERT_TRUE(late_writer.received);
+    ASSERT_FALSE(late_writer.failed);
+    ASSERT_EQ(backend.image, late_writer.image);
+    ASSERT_EQ(6, late_writer.num_writes);
+    ASSERT_FALSE(late_listener.isRunning());
+
+    ASSERT_EQ(0, foreign_writer.num_writes);
+    ASSERT_TRUE(foreign_writer.failed);     // The server does not have this file
+    ASSERT_FALSE(foreign_listener.isRunning());
+}
+
+
+TEST(FirmwareBroadcaster, TooLarge)
+{
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<root_ns_a::FirmwareImageChunk> _reg1;
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::file::Read> _reg2;
+
+    InterlinkedTestNodesWithSysClock nodes;
+
+    ImageFileServerBackend backend;
+    backend.image = makeImage(1000);
+
+    uavcan::FirmwareBroadcaster<root_ns_a::FirmwareImageChunk> broadcaster(nodes.a, backend);
+
+    ImageWriter writer;
+    uavcan::FirmwareBroadcastListener<root_ns_a::FirmwareImageChunk, 512> listener(nodes.b, writer);
+    ASSERT_LE(0, listener.start(1, "image"));
+
+    ASSERT_LE(0, broadcaster.start("image", 2, uavcan::MonotonicDuration::fromMSec(10)));
+
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(100));
+
+    ASSERT_FALSE(broadcaster.isRunning());
+    ASSERT_EQ(2, writer.num_writes);
+    ASSERT_FALSE(writer.received);
+    ASSERT_TRUE(writer.failed);
+    ASSERT_FALSE(listener.isRunning());
+}
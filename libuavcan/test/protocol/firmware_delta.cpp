@@ -0,0 +1,250 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <gtest/gtest.h>
+#include <uavcan/protocol/firmware_delta.hpp>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "helpers.hpp"
+
+
+class DeltaImageFileServerBackend : public uavcan::IFileServerBackend
+{
+public:
+    std::string image;
+    unsigned num_reads;
+
+    DeltaImageFileServerBackend() : num_reads(0) { }
+
+    virtual int16_t getInfo(const Path& path, uint64_t& out_size, EntryType& out_type)
+    {
+        if (path != "fw.bin")
+        {
+            return Error::NOT_FOUND;
+        }
+        out_size = image.length();
+        out_type.flags = EntryType::FLAG_FILE | EntryType::FLAG_READABLE;
+        return 0;
+    }
+
+    virtual int16_t read(const Path& path, const uint64_t offset, uint8_t* out_buffer, uint16_t& inout_size)
+    {
+        num_reads++;
+        if (path != "fw.bin")
+        {
+            return Error::NOT_FOUND;
+        }
+        if (offset < image.length())
+        {
+            inout_size = uint16_t(std::min<uint64_t>(inout_size, image.length() - offset));
+            std::memcpy(out_buffer, image.c_str() + offset, inout_size);
+        }
+        else
+        {
+            inout_size = 0;
+        }
+        return 0;
+    }
+};
+
+static uint64_t computeCRC(const std::string& data, std::size_t offset, std::size_t size)
+{
+    uavcan::FirmwareImageCRC crc;
+    crc.add(reinterpret_cast<const uint8_t*>(data.c_str()) + offset, unsigned(size));
+    return crc.get();
+}
+
+/**
+ * Node side: collects the blocks that differ from the current image.
+ */
+struct DeltaCollector : public uavcan::IFirmwareBlockHandler
+{
+    std::string current_image;
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> sizes;
+    unsigned num_blocks;
+
+    DeltaCollector() : num_blocks(0) { }
+
+    virtual int handleFirmwareBlock(uint32_t block_index, uint32_t offset, uint32_t size, uint64_t crc)
+    {
+        EXPECT_EQ(num_blocks, block_index);
+        num_blocks++;
+        if (((offset + size) > current_image.length()) || (computeCRC(current_image, offset, size) != crc))
+        {
+            offsets.push_back(offset);
+            sizes.push_back(size);
+        }
+        return 0;
+    }
+};
+
+TEST(FirmwareDelta, CRC)
+{
+    uavcan::FirmwareImageCRC crc;
+    crc.add(reinterpret_cast<const uint8_t*>("123456789"), 9);
+    ASSERT_EQ(0x62EC59E3F1A4F00AULL, crc.get());
+}
+
+TEST(FirmwareDelta, Manifest)
+{
+    std::srand(42);
+
+    DeltaImageFileServerBackend source;
+    for (unsigned i = 0; i < 10000; i++)
+    {
+        source.image += char(std::rand());
+    }
+
+    static uint8_t cache[1024];
+    uavcan::FirmwareBlockManifestFileServerBackend backend(source, cache, sizeof(cache), 10);
+    ASSERT_EQ(1024, backend.getBlockSize());
+
+    uint64_t size = 0;
+    uavcan::IFileServerBackend::EntryType type;
+    ASSERT_EQ(0, backend.getInfo("fw.bin.blocks", size, type));
+    ASSERT_EQ(8 + 10 * 8 + 8, size);                        // Header, 10 blocks, image CRC
+
+    uint8_t manifest[256];
+    uint16_t manifest_size = sizeof(manifest);
+    ASSERT_EQ(0, backend.read("fw.bin.blocks", 0, manifest, manifest_size));
+    ASSERT_EQ(size, manifest_size);
+    ASSERT_EQ(0, std::memcmp(manifest, "UBM\x0A\x10\x27\x00\x00", 8));
+
+    /*
+     * Parsing, byte by byte
+     */
+    DeltaCollector collector;
+    uavcan::FirmwareBlockManifestParser parser;
+    for (unsigned i = 0; i < manifest_size; i++)
+    {
+        ASSERT_FALSE(parser.isFinished());
+        ASSERT_EQ(0, parser.feed(manifest + i, 1, collector));
+    }
+    ASSERT_TRUE(parser.isFinished());
+    ASSERT_EQ(10000, parser.getImageSize());
+    ASSERT_EQ(1024, parser.getBlockSize());
+    ASSERT_EQ(10, parser.getNumBlocks());
+    ASSERT_EQ(computeCRC(source.image, 0, source.image.length()), parser.getImageCRC());
+    ASSERT_EQ(10, collector.num_blocks);
+    ASSERT_EQ(10, collector.offsets.size());                // The node has no image, everything differs
+    ASSERT_EQ(9216, collector.offsets.back());
+    ASSERT_EQ(784, collector.sizes.back());
+
+    // Trailing data is ignored
+    ASSERT_EQ(0, parser.feed(manifest, 10, collector));
+    ASSERT_EQ(10, collector.num_blocks);
+
+    /*
+     * Errors
+     */
+    parser.reset();
+    uint8_t bad[8] = { 'U', 'B', 'M', 7, 0, 0, 0, 0 };
+    ASSERT_EQ(-uavcan::ErrInvalidMarshalData, parser.feed(bad, 8, collector));
+    ASSERT_EQ(-uavcan::ErrLogic, parser.feed(manifest, 8, collector));
+    parser.reset();
+    bad[3] = 10;
+    bad[0] = 'X';
+    ASSERT_EQ(-uavcan::ErrInvalidMarshalData, parser.feed(bad, 8, collector));
+
+    // Too large for the cache
+    source.image += std::string(200000, 'x');              // 206 blocks
+    ASSERT_EQ(uavcan::IFileServerBackend::Error::FILE_TOO_LARGE, backend.getInfo("fw.bin.blocks", size, type));
+}
+
+/**
+ * The node updates itself from the old image to the new one, downloading only the changed blocks.
+ */
+TEST(FirmwareDelta, Update)
+{
+    using namespace uavcan::protocol::file;
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<GetInfo> _reg1;
+    uavcan::DefaultDataTypeRegistrator<Read> _reg2;
+
+    InterlinkedTestNodesWithSysClock nodes;
+
+    std::srand(42);
+    std::string old_image;
+    for (unsigned i = 0; i < 64 * 512 + 100; i++)
+    {
+        old_image += char(std::rand());
+    }
+
+    DeltaImageFileServerBackend source;
+    source.image = old_image;
+    source.image[1000] = char(source.image[1000] + 1);      // Block 1
+    source.image[20000] = char(source.image[20000] + 1);    // Block 39
+    source.image += "new tail";                             // Block 64
+
+    static uint8_t cache[1024];
+    uavcan::FirmwareBlockManifestFileServerBackend backend(source, cache, sizeof(cache));
+    ASSERT_EQ(512, backend.getBlockSize());
+
+    uavcan::BasicFileServer serv(nodes.a, backend);
+    ASSERT_LE(0, serv.start());
+
+    ServiceClientWithCollector<Read> read(nodes.b);
+    unsigned num_read_requests = 0;
+
+    /*
+     * Manifest
+     */
+    DeltaCollector collector;
+    collector.current_image = old_image;
+    uavcan::FirmwareBlockManifestParser parser;
+
+    Read::Request req;
+    req.path.path = uavcan::DerivedFileServerBackend::makeDerivedPath("fw.bin",
+                                                                      uavcan::getFirmwareBlockManifestPathSuffix());
+    ASSERT_TRUE(req.path.path == "fw.bin.blocks");
+    while (!parser.isFinished())
+    {
+        ASSERT_LE(0, read.call(1, req));
+        nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10));
+        ASSERT_TRUE(read.collector.result.get());
+        ASSERT_EQ(0, read.collector.result->getResponse().error.value);
+        const Read::Response::FieldTypes::data& data = read.collector.result->getResponse().data;
+        ASSERT_FALSE(data.empty());
+        ASSERT_EQ(0, parser.feed(data.begin(), data.size(), collector));
+        req.offset += data.size();
+        num_read_requests++;
+    }
+    ASSERT_EQ(3, num_read_requests);                        // 8 + 65 * 8 + 8 bytes
+
+    ASSERT_EQ(3, collector.offsets.size());
+    ASSERT_EQ(512, collector.offsets[0]);
+    ASSERT_EQ(39 * 512, collector.offsets[1]);
+    ASSERT_EQ(64 * 512, collector.offsets[2]);
+    ASSERT_EQ(108, collector.sizes[2]);
+
+    /*
+     * Changed blocks
+     */
+    std::string new_image = old_image.substr(0, parser.getImageSize());
+    new_image.resize(parser.getImageSize());
+    req.path.path = "fw.bin";
+    for (unsigned i = 0; i < collector.offsets.size(); i++)
+    {
+        for (uint32_t offset = collector.offsets[i]; offset < (collector.offsets[i] + collector.sizes[i]);)
+        {
+            req.offset = offset;
+            ASSERT_LE(0, read.call(1, req));
+            nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10));
+            ASSERT_TRUE(read.collector.result.get());
+            const Read::Response::FieldTypes::data& data = read.collector.result->getResponse().data;
+            ASSERT_FALSE(data.empty());
+            const unsigned size = std::min<unsigned>(data.size(), collector.offsets[i] + collector.sizes[i] - offset);
+            new_image.replace(offset, size, reinterpret_cast<const char*>(data.begin()), size);
+            offset += size;
+            num_read_requests++;
+        }
+    }
+
+    ASSERT_EQ(parser.getImageCRC(), computeCRC(new_image, 0, new_image.length()));
+    ASSERT_EQ(source.image, new_image);
+    ASSERT_EQ(3 + 2 + 2 + 1, num_read_requests);            // Instead of 130 for the whole image
+}
@@ -316,11 +316,8 @@ TEST(FirmwareUpdateTrigger, MultiNode)
      * This also checks correctness of the round-robin selector
      */
     checker.retry_quota = 2;
-    nodes.spinAll(uavcan::MonotonicDuration::fromMSec(4200));   // Two will retry, one drop, one confirm
-
-    ASSERT_TRUE(trigger.isTimerRunning());
-
-    nodes.spinAll(uavcan::MonotonicDuration::fromMSec(1000));
+    // The nodes are queried concurrently, so it takes two request intervals at most
+    nodes.spinAll(uavcan::MonotonicDuration::fromMSec(2500));   // Two will retry, then drop, one confirm
     ASSERT_EQ(0, trigger.getNumPendingNodes());         // All removed now
 
     EXPECT_EQ(4, checker.should_request_cnt);
@@ -334,3 +331,96 @@ TEST(FirmwareUpdateTrigger, MultiNode)
 
     ASSERT_FALSE(trigger.isTimerRunning());
 }
+
+
+TEST(FirmwareUpdateTrigger, Fleet)
+{
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<BeginFirmwareUpdate> _reg1;
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::GetNodeInfo> _reg2;
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::NodeStatus> _reg3;
+
+    static const unsigned NumTargets = 16;
+
+    TestNetwork<NumTargets + 1> nodes;
+
+    FirmwareVersionChecker checker;
+    uavcan::NodeInfoRetriever node_info_retriever(nodes[0]);
+    uavcan::FirmwareUpdateTrigger trigger(nodes[0], checker);
+
+    ASSERT_LE(0, trigger.start(node_info_retriever));
+
+    ASSERT_EQ(8, trigger.getMaxConcurrentRequests());
+    trigger.setMaxConcurrentRequests(4);
+    ASSERT_EQ(4, trigger.getMaxConcurrentRequests());
+    ASSERT_EQ(10, trigger.getRequestSpacing().toMSec());
+
+    BeginFirmwareUpdateServer srv_impl;
+    srv_impl.response_error_code = BeginFirmwareUpdate::Response::ERROR_OK;
+    typedef uavcan::ServiceServer<BeginFirmwareUpdate, BeginFirmwareUpdateServer::Callback> Server;
+    std::vector<Server*> servers;
+    for (unsigned i = 1; i <= NumTargets; i++)
+    {
+        servers.push_back(new Server(nodes[i]));
+        ASSERT_LE(0, servers.back()->start(srv_impl.makeCallback()));
+    }
+
+    /*
+     * All targets become pending at once; the path entry is shared by all of them
+     */
+    checker.expected_node_name_to_update = "Victor";
+    checker.firmware_path = "fw.bin";
+
+    const unsigned blocks_before = nodes[0].pool.getNumAllocatedBlocks();
+
+    uavcan::INodeInfoListener& listener = trigger;
+    for (unsigned i = 1; i <= NumTargets; i++)
+    {
+        uavcan::protocol::GetNodeInfo::Response node_info;
+        node_info.name = "Victor";
+        listener.handleNodeInfoRetrieved(nodes[i].getNodeID(), node_info);
+    }
+
+    ASSERT_TRUE(trigger.isTimerRunning());
+    ASSERT_EQ(NumTargets, trigger.getNumPendingNodes());
+    ASSERT_EQ(blocks_before + 1, nodes[0].pool.getNumAllocatedBlocks());
+
+    /*
+     * All targets are triggered in one pass, much faster than the request interval
+     */
+    nodes.spinAll(uavcan::MonotonicDuration::fromMSec(NumTargets * 10 + 300));
+
+    ASSERT_EQ(0, trigger.getNumPendingNodes());
+    ASSERT_EQ(NumTargets, checker.confirmation_cnt);
+    ASSERT_EQ(0, checker.should_retry_cnt);
+
+    nodes.spinAll(uavcan::MonotonicDuration::fromMSec(100));
+    ASSERT_FALSE(trigger.isTimerRunning());
+
+    /*
+     * The targets don't respond now; nodes that go offline are forgotten, the rest is cleaned up by the destructor
+     */
+    for (unsigned i = 0; i < servers.size(); i++)
+    {
+        delete servers[i];
+    }
+
+    for (unsigned i = 1; i <= NumTargets; i++)
+    {
+        uavcan::protocol::GetNodeInfo::Response node_info;
+        node_info.name = "Victor";
+        listener.handleNodeInfoRetrieved(nodes[i].getNodeID(), node_info);
+    }
+    ASSERT_EQ(NumTargets, trigger.getNumPendingNodes());
+
+    uavcan::NodeStatusMonitor::NodeStatusChangeEvent event;
+    event.node_id = nodes[1].getNodeID();
+    event.status.mode = uavcan::protocol::NodeStatus::MODE_OFFLINE;
+    listener.handleNodeStatusChange(event);
+    ASSERT_EQ(NumTargets - 1, trigger.getNumPendingNodes());
+
+    nodes.spinAll(uavcan::MonotonicDuration::fromMSec(100));
+    ASSERT_EQ(NumTargets - 1, trigger.getNumPendingNodes());
+    ASSERT_TRUE(trigger.isTimerRunning());
+    ASSERT_EQ(0, nodes[0].internal_failure_count);
+}
@@ -84,6 +84,13 @@ TEST(GlobalTimeSyncMaster, Basic)
     ASSERT_TRUE(slave.isActive());
     ASSERT_EQ(nwk.master_low.node.getNodeID(), slave.getMasterNodeID());
 
+    // TX delay statistics - one sample per publication
+    ASSERT_EQ(2, master_low.getTxDelayStats(0).getNumSamples());
+    ASSERT_LE(0, master_low.getTxDelayStats(0).getMinUSec());
+    ASSERT_GT(100000, master_low.getTxDelayStats(0).getMaxUSec());
+    ASSERT_EQ(0, master_low.getTxDelayStats(uavcan::MaxCanIfaces).getNumSamples());
+    ASSERT_EQ(1, slave.getAdjustmentStats().getNumSamples());
+
     /*
      * Moving clocks forward and re-syncing with another master
      */
@@ -108,6 +115,9 @@ TEST(GlobalTimeSyncMaster, Basic)
     ASSERT_TRUE(slave.isActive());
     ASSERT_EQ(nwk.master_high.node.getNodeID(), slave.getMasterNodeID());
 
+    master_low.resetTxDelayStats();
+    ASSERT_EQ(0, master_low.getTxDelayStats(0).getNumSamples());
+
     /*
      * Frequent calls to publish()
      */
@@ -311,4 +311,165 @@ TEST(GlobalTimeSyncSlave, Suppression)
     ASSERT_TRUE(gtss.isActive());
     ASSERT_EQ(8, gtss.getMasterNodeID().get());
     ASSERT_EQ(0, slave_clock.utc);                  // The clock shall not be asjusted
+
+    // The adjustments are accounted even in the suppressed mode
+    ASSERT_EQ(1, gtss.getAdjustmentStats().getNumSamples());
+    gtss.resetAdjustmentStats();
+    ASSERT_EQ(0, gtss.getAdjustmentStats().getNumSamples());
+}
+
+
+TEST(GlobalTimeSyncSlave, JitterStats)
+{
+    uavcan::TimeSyncJitterStats stats;
+    ASSERT_EQ(0, stats.getNumSamples());
+    ASSERT_EQ(0, stats.getJitterUSec());
+
+    // Constant offset doesn't contribute to the jitter
+    for (int i = 0; i < 100; i++)
+    {
+        stats.addSample(1000);
+    }
+    ASSERT_EQ(100, stats.getNumSamples());
+    ASSERT_EQ(1000, stats.getMinUSec());
+    ASSERT_EQ(1000, stats.getMaxUSec());
+    ASSERT_EQ(0, stats.getJitterUSec());
+
+    // Alternating samples - the jitter converges to the difference
+    for (int i = 0; i < 200; i++)
+    {
+        stats.addSample((i % 2 == 0) ? 900 : 1100);
+    }
+    ASSERT_EQ(1100, stats.getLastUSec());
+    ASSERT_EQ(900, stats.getMinUSec());
+    ASSERT_EQ(1100, stats.getMaxUSec());
+    ASSERT_LE(195, stats.getJitterUSec());
+    ASSERT_GE(200, stats.getJitterUSec());
+
+    // Jitter decays once the samples stabilize
+    for (int i = 0; i < 200; i++)
+    {
+        stats.addSample(-50);
+    }
+    ASSERT_EQ(-50, stats.getMinUSec());
+    ASSERT_GT(5, stats.getJitterUSec());
+
+    stats.reset();
+    ASSERT_EQ(0, stats.getNumSamples());
+    ASSERT_EQ(0, stats.getMaxUSec());
+}
+
+
+struct GlobalTimeSyncSlaveFilterTestMaster
+{
+    SystemClockMock& slave_clock;
+    CanIfaceMock& iface;
+    uavcan::uint8_t tid;
+    uavcan::uint64_t prev_tx_usec;
+    uavcan::int64_t offset_usec;
+
+    GlobalTimeSyncSlaveFilterTestMaster(SystemClockMock& arg_slave_clock, CanIfaceMock& arg_iface)
+        : slave_clock(arg_slave_clock)
+        , iface(arg_iface)
+        , tid(0)
+        , prev_tx_usec(0)
+        , offset_usec(1000000000)
+    { }
+
+    /**
+     * The master clock runs 50 PPM faster than the slave's monotonic clock.
+     */
+    uavcan::uint64_t getMasterUSec(uavcan::uint64_t slave_mono_usec) const
+    {
+        return uavcan::uint64_t(uavcan::int64_t(slave_mono_usec + slave_mono_usec / 20000) + offset_usec);
+    }
+
+    /**
+     * Publishes one sync message; the TX timestamp of the previous one can be distorted.
+     */
+    void publish(TestNode& node, uavcan::int64_t prev_tx_error_usec = 0)
+    {
+        const uavcan::uint64_t tx_mono_usec = slave_clock.monotonic;
+        broadcastSyncMsg(iface, uavcan::uint64_t(uavcan::int64_t(prev_tx_usec) + prev_tx_error_usec), 8, tid);
+        tid = uavcan::uint8_t((tid + 1U) % 32U);
+        prev_tx_usec = getMasterUSec(tx_mono_usec);
+        ASSERT_LE(0, node.spin(uavcan::MonotonicDuration::fromMSec(10)));
+        slave_clock.monotonic += 90000;
+    }
+};
+
+
+TEST(GlobalTimeSyncSlave, Filtering)
+{
+    SystemClockMock slave_clock;
+    slave_clock.monotonic = 1000000;
+    slave_clock.preserve_utc = true;
+
+    CanDriverMock slave_can(1, slave_clock);
+    slave_can.ifaces.at(0).enable_utc_timestamping = true;
+
+    TestNode node(slave_can, slave_clock, 64);
+
+    uavcan::GlobalTimeSyncSlave gtss(node);
+    ASSERT_LE(0, gtss.start());
+    gtss.suppress(true);
+
+    ASSERT_TRUE(gtss.getEstimatedMasterUtc().isZero());
+    ASSERT_TRUE(gtss.getOutlierThreshold().isZero());
+
+    GlobalTimeSyncSlaveFilterTestMaster master(slave_clock, slave_can.ifaces.at(0));
+
+    /*
+     * Convergence - every other message produces a sample
+     */
+    for (int i = 0; i < 40; i++)
+    {
+        master.publish(node);
+    }
+    ASSERT_TRUE(gtss.isActive());
+    ASSERT_NEAR(50.0F, gtss.getEstimatedMasterRateErrorPPM(), 1.0F);
+    ASSERT_NEAR(double(master.getMasterUSec(slave_clock.monotonic)),
+                double(gtss.getEstimatedMasterUtc().toUSec()), 5.0);
+
+    // The estimate extrapolates the rate
+    ASSERT_NEAR(double(master.getMasterUSec(slave_clock.monotonic + 1000000)),
+                double(gtss.getEstimatedMasterUtc(uavcan::MonotonicTime::fromUSec(slave_clock.monotonic + 1000000))
+                       .toUSec()), 5.0);
+
+    /*
+     * Outlier rejection; odd messages are used for adjustments
+     */
+    gtss.setOutlierThreshold(uavcan::UtcDuration::fromUSec(200));
+    const uavcan::uint32_t num_adjustments = gtss.getAdjustmentStats().getNumSamples();
+
+    master.publish(node, 3000);         // Update
+    master.publish(node, 3000);         // Delayed TX timestamp, rejected
+    ASSERT_EQ(1, gtss.getNumRejectedOutliers());
+    ASSERT_EQ(num_adjustments, gtss.getAdjustmentStats().getNumSamples());
+    ASSERT_NEAR(double(master.getMasterUSec(slave_clock.monotonic)),
+                double(gtss.getEstimatedMasterUtc().toUSec()), 5.0);
+
+    master.publish(node);
+    master.publish(node);               // Accepted
+    ASSERT_EQ(1, gtss.getNumRejectedOutliers());
+    ASSERT_EQ(num_adjustments + 1, gtss.getAdjustmentStats().getNumSamples());
+
+    /*
+     * The master clock jumps; the filter is reinitialized after a few outliers
+     */
+    master.offset_usec += 1000000;
+    for (int i = 0; i < (uavcan::GlobalTimeSyncSlave::MaxConsecutiveOutliers + 1) * 2; i++)
+    {
+        master.publish(node);
+    }
+    ASSERT_EQ(1 + uavcan::GlobalTimeSyncSlave::MaxConsecutiveOutliers, gtss.getNumRejectedOutliers());
+
+    for (int i = 0; i < 40; i++)
+    {
+        master.publish(node);
+    }
+    ASSERT_EQ(1 + uavcan::GlobalTimeSyncSlave::MaxConsecutiveOutliers, gtss.getNumRejectedOutliers());
+    ASSERT_NEAR(50.0F, gtss.getEstimatedMasterRateErrorPPM(), 1.0F);
+    ASSERT_NEAR(double(master.getMasterUSec(slave_clock.monotonic)),
+                double(gtss.getEstimatedMasterUtc().toUSec()), 5.0);
 }
@@ -117,6 +117,89 @@ TEST(Logger, Basic)
     ASSERT_TRUE(sink.popMatchByLevelAndText(uavcan::protocol::debug::LogLevel::DEBUG,   "foo", "Debug"));
 }
 
+#if UAVCAN_LOGGER_DEFERRED_QUEUE_LENGTH > 0
+
+TEST(Logger, Deferred)
+{
+    InterlinkedTestNodesWithSysClock nodes;
+
+    uavcan::Logger logger(nodes.a);
+    logger.setLevel(uavcan::protocol::debug::LogLevel::DEBUG);
+
+    LogSink sink;
+    sink.level = uavcan::protocol::debug::LogLevel::DEBUG;
+    logger.setExternalSink(&sink);
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::debug::LogMessage> _reg1;
+
+    SubscriberWithCollector<uavcan::protocol::debug::LogMessage> log_sub(nodes.b);
+    ASSERT_LE(0, log_sub.start());
+
+    ASSERT_FALSE(logger.isDeferredModeEnabled());
+    ASSERT_LE(0, logger.setDeferredMode(true));
+    ASSERT_TRUE(logger.isDeferredModeEnabled());
+
+    /*
+     * Nothing is delivered until the node is spun; identical messages are coalesced
+     */
+    ASSERT_LE(0, logger.logInfo("foo", "A"));
+    ASSERT_LE(0, logger.logInfo("foo", "B"));
+    ASSERT_LE(0, logger.logInfo("foo", "B"));
+    ASSERT_LE(0, logger.logInfo("foo", "B"));
+    ASSERT_LE(0, logger.logWarning("foo", "B"));     // Different level, not coalesced
+    ASSERT_TRUE(sink.msgs.empty());
+    ASSERT_EQ(3, logger.getNumDeferredMessages());
+    ASSERT_EQ(2, logger.getNumCoalescedMessages());
+
+    /*
+     * Overflow
+     */
+    while (logger.getNumDeferredMessages() < UAVCAN_LOGGER_DEFERRED_QUEUE_LENGTH)
+    {
+        ASSERT_LE(0, logger.logDebug("bar", (logger.getNumDeferredMessages() % 2 == 0) ? "X" : "Y"));
+    }
+    ASSERT_EQ(0, logger.getNumDroppedMessages());
+    ASSERT_EQ(-uavcan::ErrMemory, logger.logDebug("bar", "Z"));
+    ASSERT_EQ(-uavcan::ErrMemory, logger.logDebug("bar", "Z"));
+    ASSERT_EQ(2, logger.getNumDroppedMessages());
+    ASSERT_TRUE(sink.msgs.empty());
+    ASSERT_FALSE(log_sub.collector.msg.get());
+
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10));
+
+    ASSERT_EQ(0, logger.getNumDeferredMessages());
+    ASSERT_EQ(UAVCAN_LOGGER_DEFERRED_QUEUE_LENGTH + 1U, sink.msgs.size());
+    ASSERT_TRUE(sink.popMatchByLevelAndText(uavcan::protocol::debug::LogLevel::INFO,    "foo", "A"));
+    ASSERT_TRUE(sink.popMatchByLevelAndText(uavcan::protocol::debug::LogLevel::INFO,    "foo", "B [x3]"));
+    ASSERT_TRUE(sink.popMatchByLevelAndText(uavcan::protocol::debug::LogLevel::WARNING, "foo", "B"));
+    for (unsigned i = 3; i < UAVCAN_LOGGER_DEFERRED_QUEUE_LENGTH; i++)
+    {
+        ASSERT_TRUE(sink.popMatchByLevelAndText(uavcan::protocol::debug::LogLevel::DEBUG, "bar",
+                                                (i % 2 == 0) ? "X" : "Y"));
+    }
+    ASSERT_TRUE(sink.popMatchByLevelAndText(uavcan::protocol::debug::LogLevel::WARNING, "Logger",
+                                            "2 messages dropped"));
+
+    ASSERT_TRUE(log_sub.collector.msg.get());
+    ASSERT_EQ(log_sub.collector.msg->source, "Logger");
+    ASSERT_EQ(log_sub.collector.msg->text, "2 messages dropped");
+
+    /*
+     * Leaving the deferred mode flushes the queue
+     */
+    ASSERT_LE(0, logger.logError("foo", "C"));
+    ASSERT_TRUE(sink.msgs.empty());
+    ASSERT_LE(0, logger.setDeferredMode(false));
+    ASSERT_FALSE(logger.isDeferredModeEnabled());
+    ASSERT_TRUE(sink.popMatchByLevelAndText(uavcan::protocol::debug::LogLevel::ERROR, "foo", "C"));
+
+    ASSERT_LE(0, logger.logError("foo", "D"));
+    ASSERT_TRUE(sink.popMatchByLevelAndText(uavcan::protocol::debug::LogLevel::ERROR, "foo", "D"));
+}
+
+#endif
+
 #if !defined(UAVCAN_CPP_VERSION) || !defined(UAVCAN_CPP11)
 # error UAVCAN_CPP_VERSION
 #endif
@@ -7,6 +7,7 @@
 # pragma GCC diagnostic ignored "-Wdeprecated-declarations"
 #endif
 
+#include <map>
 #include <memory>
 #include <gtest/gtest.h>
 #include <uavcan/protocol/node_info_retriever.hpp>
@@ -290,3 +291,112 @@ TEST(NodeInfoRetriever, MaxConcurrentRequests)
     ASSERT_EQ(0, retr.getNumPendingRequests());
     ASSERT_FALSE(retr.isRetrievingInProgress());
 }
+
+
+struct NodeInfoCache : public uavcan::INodeInfoCache
+{
+    std::map<uavcan::uint8_t, uavcan::protocol::GetNodeInfo::Response> records;
+    unsigned num_loads;
+
+    NodeInfoCache() : num_loads(0) { }
+
+    virtual bool load(uavcan::NodeID node_id, uavcan::protocol::GetNodeInfo::Response& out_node_info)
+    {
+        num_loads++;
+        if (records.count(node_id.get()) == 0)
+        {
+            return false;
+        }
+        out_node_info = records[node_id.get()];
+        return true;
+    }
+
+    virtual void store(uavcan::NodeID node_id, const uavcan::protocol::GetNodeInfo::Response& node_info)
+    {
+        records[node_id.get()] = node_info;
+    }
+};
+
+
+TEST(NodeInfoRetriever, Cache)
+{
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::NodeStatus> _reg1;
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::GetNodeInfo> _reg2;
+
+    InterlinkedTestNodesWithSysClock nodes;
+
+    NodeInfoCache cache;
+
+    uavcan::NodeStatusProvider provider(nodes.b);
+    provider.setName("Ivan");
+    ASSERT_LE(0, provider.startAndPublish());
+
+    /*
+     * Cold boot - the info is retrieved from the node and stored
+     */
+    {
+        uavcan::NodeInfoRetriever retr(nodes.a);
+        NodeInfoListener listener;
+        ASSERT_EQ(4, retr.getMaxRequestsPerInterval());            // Default
+        ASSERT_EQ(1, retr.getRequestsPerInterval());
+        ASSERT_FALSE(retr.getNodeInfoCache());
+        retr.setNodeInfoCache(&cache);
+        ASSERT_LE(0, retr.start());
+        retr.addListener(&listener);
+
+        nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(1500));
+        ASSERT_FALSE(retr.isRetrievingInProgress());
+
+        ASSERT_TRUE(listener.last_node_info.get());
+        ASSERT_EQ("Ivan", listener.last_node_info->name);
+        ASSERT_EQ(1, cache.num_loads);                      // Nothing was there
+        ASSERT_EQ(1, cache.records.size());
+        ASSERT_EQ("Ivan", cache.records[2].name);
+        ASSERT_EQ(2, retr.getRequestsPerInterval());        // Increased after one successful call
+
+        retr.setMaxRequestsPerInterval(0);
+        ASSERT_EQ(1, retr.getMaxRequestsPerInterval());
+        ASSERT_EQ(1, retr.getRequestsPerInterval());
+    }
+
+    /*
+     * Warm boot - the remote node did not restart, so the info is restored from the cache
+     */
+    cache.records[2].name = "Cached";
+    {
+        uavcan::NodeInfoRetriever retr(nodes.a);
+        NodeInfoListener listener;
+        retr.setNodeInfoCache(&cache);
+        ASSERT_LE(0, retr.start());
+        retr.addListener(&listener);
+
+        nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(1100));
+
+        ASSERT_FALSE(retr.isRetrievingInProgress());
+        ASSERT_EQ(0, retr.getNumPendingRequests());
+        ASSERT_TRUE(listener.last_node_info.get());
+        ASSERT_EQ("Cached", listener.last_node_info->name);
+        ASSERT_EQ(2, cache.num_loads);
+    }
+
+    /*
+     * The cached record is newer than the reported uptime - the node has restarted, querying it again
+     */
+    cache.records[2].status.uptime_sec = 1000;
+    {
+        uavcan::NodeInfoRetriever retr(nodes.a);
+        NodeInfoListener listener;
+        retr.setNodeInfoCache(&cache);
+        ASSERT_LE(0, retr.start());
+        retr.addListener(&listener);
+
+        nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(1500));
+
+        ASSERT_FALSE(retr.isRetrievingInProgress());
+        ASSERT_TRUE(listener.last_node_info.get());
+        ASSERT_EQ("Ivan", listener.last_node_info->name);
+        ASSERT_EQ(3, cache.num_loads);
+        ASSERT_EQ("Ivan", cache.records[2].name);
+    }
+}
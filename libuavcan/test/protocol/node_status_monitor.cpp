@@ -5,6 +5,7 @@
 #include <gtest/gtest.h>
 #include <uavcan/protocol/node_status_monitor.hpp>
 #include <uavcan/protocol/node_status_provider.hpp>
+#include <vector>
 #include "helpers.hpp"
 
 static void publishNodeStatus(CanDriverMock& can, uavcan::NodeID node_id,
@@ -174,3 +175,101 @@ TEST(NodeStatusMonitor, Basic)
     ASSERT_EQ(NodeStatus::MODE_OFFLINE, nsm.getNodeStatus(uavcan::NodeID(9)).mode);
     ASSERT_EQ(NodeStatus::HEALTH_CRITICAL, nsm.getNodeStatus(uavcan::NodeID(9)).health);
 }
+
+
+struct ChangedNodeCollector
+{
+    std::vector<uavcan::NodeID> nodes;
+
+    void operator()(uavcan::NodeID nid, uavcan::NodeStatusMonitor::NodeStatus) { nodes.push_back(nid); }
+};
+
+
+static std::vector<uavcan::NodeID> collectChangedNodes(const uavcan::NodeStatusMonitor& nsm,
+                                                       uavcan::uint32_t& inout_generation)
+{
+    ChangedNodeCollector collector;
+    inout_generation = nsm.forEachNodeChangedSince<ChangedNodeCollector&>(inout_generation, collector);
+    return collector.nodes;
+}
+
+
+TEST(NodeStatusMonitor, Generations)
+{
+    using uavcan::protocol::NodeStatus;
+    using uavcan::NodeID;
+
+    SystemClockMock clock_mock(100);
+    clock_mock.monotonic_auto_advance = 1000;
+
+    CanDriverMock can(2, clock_mock);
+
+    TestNode node(can, clock_mock, 64);
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::NodeStatus> _reg1;
+
+    uavcan::NodeStatusMonitor nsm(node);
+    ASSERT_LE(0, nsm.start());
+
+    uavcan::uint32_t generation = 0;
+    ASSERT_TRUE(collectChangedNodes(nsm, generation).empty());
+    ASSERT_EQ(0, generation);
+
+    publishNodeStatus(can, 10, NodeStatus::HEALTH_OK, NodeStatus::MODE_OPERATIONAL, 12, 0);
+    publishNodeStatus(can, 20, NodeStatus::HEALTH_OK, NodeStatus::MODE_OPERATIONAL, 12, 0);
+    shortSpin(node);
+
+    std::vector<NodeID> changed = collectChangedNodes(nsm, generation);
+    ASSERT_EQ(2, changed.size());
+    ASSERT_EQ(NodeID(10), changed[0]);
+    ASSERT_EQ(NodeID(20), changed[1]);
+    ASSERT_EQ(2, generation);
+    ASSERT_EQ(2, nsm.getGeneration());
+
+    /*
+     * Same status again - no changes
+     */
+    publishNodeStatus(can, 10, NodeStatus::HEALTH_OK, NodeStatus::MODE_OPERATIONAL, 13, 1);
+    shortSpin(node);
+    ASSERT_TRUE(collectChangedNodes(nsm, generation).empty());
+    ASSERT_EQ(2, generation);
+
+    publishNodeStatus(can, 20, NodeStatus::HEALTH_WARNING, NodeStatus::MODE_OPERATIONAL, 13, 1);
+    shortSpin(node);
+    changed = collectChangedNodes(nsm, generation);
+    ASSERT_EQ(1, changed.size());
+    ASSERT_EQ(NodeID(20), changed[0]);
+    ASSERT_EQ(3, generation);
+
+    /*
+     * Node 10 keeps publishing, node 20 goes offline
+     */
+    for (int i = 0; i < 5; i++)
+    {
+        clock_mock.advance(1000000);
+        publishNodeStatus(can, 10, NodeStatus::HEALTH_OK, NodeStatus::MODE_OPERATIONAL, 14, uavcan::TransferID(2 + i));
+        shortSpin(node);
+    }
+    ASSERT_EQ(NodeStatus::MODE_OPERATIONAL, nsm.getNodeStatus(10).mode);
+    ASSERT_EQ(NodeStatus::MODE_OFFLINE, nsm.getNodeStatus(20).mode);
+
+    changed = collectChangedNodes(nsm, generation);
+    ASSERT_EQ(1, changed.size());
+    ASSERT_EQ(NodeID(20), changed[0]);
+    ASSERT_EQ(4, generation);
+
+    /*
+     * Zero visits all known nodes; forgotten nodes are not reported
+     */
+    nsm.forgetNode(10);
+    generation = 0;
+    changed = collectChangedNodes(nsm, generation);
+    ASSERT_EQ(1, changed.size());
+    ASSERT_EQ(NodeID(20), changed[0]);
+
+    clock_mock.advance(10000000);
+    shortSpin(node);
+    ASSERT_FALSE(nsm.isNodeKnown(10));
+    ASSERT_TRUE(collectChangedNodes(nsm, generation).empty());
+}
@@ -114,3 +114,46 @@ TEST(NodeStatusProvider, Basic)
 
     ASSERT_EQ("superluminal_communication_unit", gni_cln.collector.result->getResponse().name);
 }
+
+
+#if UAVCAN_DUTY_CYCLE_STATS
+
+TEST(NodeStatusProvider, DutyCycleReporting)
+{
+    InterlinkedTestNodesWithClockMock nodes;
+    nodes.clock_a.advance(1000000);
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::NodeStatus> _reg1;
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::GetNodeInfo> _reg2;
+
+    uavcan::NodeStatusProvider nsp(nodes.a);
+    nsp.setName("duty_cycle");
+    nodes.clock_a.advance(1000);
+    ASSERT_LE(0, nsp.startAndPublish());
+    ASSERT_FALSE(nsp.isDutyCycleReportingEnabled());
+
+    // 10 ms window, 4 ms of it busy
+    uavcan::DutyCycleCounter& counter = nodes.a.getDutyCycleCounter();
+    counter.setWindow(uavcan::MonotonicDuration::fromMSec(10));
+    counter.reset();
+    uint8_t prev = counter.enter(uavcan::DutyCycleCategoryCallbacks);
+    nodes.clock_a.advance(4000);
+    counter.leave(prev);
+    nodes.clock_a.advance(6000);
+    prev = counter.enter(uavcan::DutyCycleCategoryCallbacks);
+    counter.leave(prev);
+    ASSERT_EQ(400, counter.getTotalDutyCyclePermille());
+
+    // Disabled - the code is not touched
+    nsp.setVendorSpecificStatusCode(1234);
+    ASSERT_LE(0, nsp.forcePublish());
+    ASSERT_EQ(1234, nsp.getVendorSpecificStatusCode());
+
+    nsp.setDutyCycleReporting(true);
+    ASSERT_TRUE(nsp.isDutyCycleReportingEnabled());
+    ASSERT_LE(0, nsp.forcePublish());
+    ASSERT_EQ(400, nsp.getVendorSpecificStatusCode());
+}
+
+#endif
@@ -0,0 +1,193 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <map>
+#include <vector>
+#include <gtest/gtest.h>
+#include <uavcan/protocol/param_retriever.hpp>
+#include <uavcan/protocol/param_server.hpp>
+#include "helpers.hpp"
+
+
+struct ParamRetrieverTestManager : public uavcan::IParamManager
+{
+    std::vector<std::pair<std::string, int64_t> > params;
+
+    virtual void getParamNameByIndex(Index index, Name& out_name) const
+    {
+        if (index < params.size())
+        {
+            out_name = params[index].first.c_str();
+        }
+    }
+
+    virtual void assignParamValue(const Name&, const Value&) { }
+
+    virtual void readParamValue(const Name& name, Value& out_value) const
+    {
+        for (unsigned i = 0; i < params.size(); i++)
+        {
+            if (params[i].first == name.c_str())
+            {
+                out_value.to<Value::Tag::integer_value>() = params[i].second;
+            }
+        }
+    }
+
+    virtual int saveAllParams() { return 0; }
+    virtual int eraseAllParams() { return 0; }
+};
+
+
+struct ParamRetrieverTestListener : public uavcan::IParamRetrieverListener
+{
+    std::map<Index, uint32_t> hashes;
+    std::map<Index, int64_t> values;
+    bool diff;
+    unsigned num_finished;
+    unsigned num_params;
+    unsigned num_changed;
+    bool complete;
+
+    ParamRetrieverTestListener()
+        : diff(false)
+        , num_finished(0)
+        , num_params(0)
+        , num_changed(0)
+        , complete(false)
+    { }
+
+    virtual bool isParamUnchanged(uavcan::NodeID, Index index, uint32_t hash)
+    {
+        return diff && (hashes.count(index) > 0) && (hashes[index] == hash);
+    }
+
+    virtual void handleParamRetrieved(uavcan::NodeID node_id, Index index,
+                                      const uavcan::protocol::param::GetSet::Response& param, uint32_t hash)
+    {
+        EXPECT_EQ(1, node_id.get());
+        EXPECT_EQ(hash, uavcan::ParamRetriever::computeParamHash(param));
+        hashes[index] = hash;
+        values[index] = param.value.integer_value;
+    }
+
+    virtual void handleParamRetrievalFinished(uavcan::NodeID node_id, unsigned arg_num_params,
+                                              unsigned arg_num_changed, bool arg_complete)
+    {
+        EXPECT_EQ(1, node_id.get());
+        num_finished++;
+        num_params = arg_num_params;
+        num_changed = arg_num_changed;
+        complete = arg_complete;
+    }
+};
+
+
+TEST(ParamRetriever, Basic)
+{
+    InterlinkedTestNodesWithSysClock nodes;
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::param::GetSet> _reg1;
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::param::ExecuteOpcode> _reg2;
+
+    ParamRetrieverTestManager mgr;
+    for (int i = 0; i < 20; i++)
+    {
+        char name[16];
+        std::snprintf(name, sizeof(name), "param_%02d", i);
+        mgr.params.push_back(std::make_pair(std::string(name), int64_t(i * 100)));
+    }
+
+    uavcan::ParamServer server(nodes.a);
+    ASSERT_LE(0, server.start(&mgr));
+
+    uavcan::ParamRetriever retriever(nodes.b);
+    std::cout << "sizeof(uavcan::ParamRetriever): " << sizeof(uavcan::ParamRetriever) << std::endl;
+    ParamRetrieverTestListener listener;
+
+    ASSERT_EQ(uavcan::ParamRetriever::DefaultConcurrentRequests, retriever.getMaxConcurrentRequests());
+    ASSERT_GT(0, retriever.start(uavcan::NodeID(), &listener));
+    ASSERT_GT(0, retriever.start(1, NULL));
+
+    /*
+     * Full retrieval
+     */
+    ASSERT_LE(0, retriever.start(1, &listener));
+    ASSERT_TRUE(retriever.isInProgress());
+    ASSERT_EQ(1, retriever.getNodeID().get());
+    ASSERT_GT(0, retriever.start(1, &listener));            // Already in progress
+
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(100));
+
+    ASSERT_FALSE(retriever.isInProgress());
+    ASSERT_EQ(1, listener.num_finished);
+    ASSERT_TRUE(listener.complete);
+    ASSERT_EQ(20, listener.num_params);
+    ASSERT_EQ(20, listener.num_changed);
+    for (int i = 0; i < 20; i++)
+    {
+        ASSERT_EQ(i * 100, listener.values[uavcan::ParamRetriever::Index(i)]);
+    }
+
+    /*
+     * Only the changes are reported
+     */
+    listener.diff = true;
+    listener.values.clear();
+    mgr.params[7].second = 12345;
+    mgr.params.push_back(std::make_pair(std::string("new_param"), int64_t(-1)));
+
+    retriever.setMaxConcurrentRequests(1);
+    ASSERT_EQ(1, retriever.getMaxConcurrentRequests());
+    ASSERT_LE(0, retriever.start(1, &listener));
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(200));
+
+    ASSERT_EQ(2, listener.num_finished);
+    ASSERT_TRUE(listener.complete);
+    ASSERT_EQ(21, listener.num_params);
+    ASSERT_EQ(2, listener.num_changed);
+    ASSERT_EQ(2, listener.values.size());
+    ASSERT_EQ(12345, listener.values[7]);
+    ASSERT_EQ(-1, listener.values[20]);
+
+    /*
+     * Cancellation
+     */
+    retriever.setMaxConcurrentRequests(100);
+    ASSERT_EQ(uavcan::ParamRetriever::MaxConcurrentRequests, retriever.getMaxConcurrentRequests());
+    ASSERT_LE(0, retriever.start(1, &listener));
+    retriever.cancel();
+    ASSERT_FALSE(retriever.isInProgress());
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(100));
+    ASSERT_EQ(2, listener.num_finished);
+}
+
+
+TEST(ParamRetriever, NoResponse)
+{
+    InterlinkedTestNodesWithSysClock nodes;
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::param::GetSet> _reg1;
+
+    uavcan::ParamRetriever retriever(nodes.b);
+    ParamRetrieverTestListener listener;
+
+    retriever.setRequestTimeout(uavcan::MonotonicDuration::fromMSec(100));
+    retriever.setNumRequestAttempts(2);
+    ASSERT_EQ(2, retriever.getNumRequestAttempts());
+
+    ASSERT_LE(0, retriever.start(1, &listener));      // There's no server on the node 1
+
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(150));
+    ASSERT_TRUE(retriever.isInProgress());             // First attempt has failed, retrying
+    ASSERT_EQ(0, listener.num_finished);
+
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(100));
+    ASSERT_FALSE(retriever.isInProgress());
+    ASSERT_EQ(1, listener.num_finished);
+    ASSERT_FALSE(listener.complete);
+    ASSERT_EQ(0, listener.num_params);
+}
@@ -3,8 +3,11 @@
  */
 
 #include <map>
+#include <vector>
 #include <gtest/gtest.h>
 #include <uavcan/protocol/param_server.hpp>
+#include <uavcan/protocol/indexed_param_manager.hpp>
+#include <uavcan/protocol/persistent_param_manager.hpp>
 #include "helpers.hpp"
 
 struct ParamServerTestManager : public uavcan::IParamManager
@@ -175,3 +178,375 @@ TEST(ParamServer, Basic)
     ASSERT_FLOAT_EQ(424242, get_set_cln.collector.result->getResponse().value.
                             to<uavcan::protocol::param::Value::Tag::real_value>());
 }
+
+
+struct IndexedParamManagerTest : public uavcan::IndexedParamManager<64>
+{
+    std::vector<std::string> names;
+    std::vector<float> values;
+    mutable unsigned num_name_reads;
+
+    IndexedParamManagerTest()
+        : num_name_reads(0)
+    { }
+
+    virtual Index getNumParams() const { return Index(names.size()); }
+
+    virtual void getParamNameByIndex(Index index, Name& out_name) const
+    {
+        num_name_reads++;
+        if (index < names.size())
+        {
+            out_name = names[index].c_str();
+        }
+    }
+
+    virtual void assignParamValueByIndex(Index index, const Value& value)
+    {
+        assert(index < values.size());
+        if (value.is(Value::Tag::real_value))
+        {
+            values[index] = value.real_value;
+        }
+    }
+
+    virtual void readParamValueByIndex(Index index, Value& out_value) const
+    {
+        assert(index < values.size());
+        out_value.to<Value::Tag::real_value>() = values[index];
+    }
+
+    virtual void readParamDefaultMaxMinByIndex(Index index, Value& out_default,
+                                               NumericValue& out_max, NumericValue& out_min) const
+    {
+        assert(index < values.size());
+        out_default.to<Value::Tag::real_value>() = 0.0F;
+        out_max.to<NumericValue::Tag::real_value>() = 1000.0F;
+        out_min.to<NumericValue::Tag::real_value>() = -float(index);
+    }
+
+    virtual int saveAllParams() { return 0; }
+    virtual int eraseAllParams() { return 0; }
+};
+
+
+TEST(ParamServer, IndexedParamManager)
+{
+    IndexedParamManagerTest mgr;
+
+    // Not sorted, some names share a prefix
+    const char* const Names[] = { "zeta", "alpha", "alpha_2", "mu", "beta", "omega", "alpha_10", "kappa" };
+    const unsigned NumParams = sizeof(Names) / sizeof(Names[0]);
+    for (unsigned i = 0; i < NumParams; i++)
+    {
+        mgr.names.push_back(Names[i]);
+        mgr.values.push_back(float(i) * 10.0F);
+    }
+
+    /*
+     * Lookups
+     */
+    for (unsigned i = 0; i < NumParams; i++)
+    {
+        uavcan::IParamManager::Index index = 0xFFFF;
+        ASSERT_TRUE(mgr.findParamIndex(Names[i], index));
+        ASSERT_EQ(i, index);
+    }
+
+    uavcan::IParamManager::Index index = 0xFFFF;
+    ASSERT_FALSE(mgr.findParamIndex("alpha_1", index));
+    ASSERT_FALSE(mgr.findParamIndex("", index));
+    ASSERT_FALSE(mgr.findParamIndex("zzz", index));
+    ASSERT_EQ(0xFFFF, index);
+
+    /*
+     * Name-based access via the IParamManager interface; repeated lookups of the same name are cached
+     */
+    uavcan::IParamManager& base = mgr;
+    uavcan::IParamManager::Value value;
+    value.to<uavcan::IParamManager::Value::Tag::real_value>() = 42.0F;
+    base.assignParamValue("omega", value);
+    ASSERT_FLOAT_EQ(42.0F, mgr.values[5]);
+
+    mgr.num_name_reads = 0;
+    value = uavcan::IParamManager::Value();
+    base.readParamValue("mu", value);
+    ASSERT_FLOAT_EQ(30.0F, value.to<uavcan::IParamManager::Value::Tag::real_value>());
+    ASSERT_GE(4, mgr.num_name_reads);                   // log2(8) + 1
+
+    const unsigned num_name_reads = mgr.num_name_reads;
+    uavcan::IParamManager::Value default_value;
+    uavcan::IParamManager::NumericValue max_value;
+    uavcan::IParamManager::NumericValue min_value;
+    base.readParamDefaultMaxMin("mu", default_value, max_value, min_value);
+    ASSERT_EQ(num_name_reads, mgr.num_name_reads);      // Cached
+    ASSERT_FLOAT_EQ(-3.0F, min_value.to<uavcan::IParamManager::NumericValue::Tag::real_value>());
+
+    /*
+     * Batch read
+     */
+    uavcan::IndexedParamManager<64>::ParamEntry entries[5];
+    ASSERT_EQ(5, mgr.readParams(0, entries, 5));
+    ASSERT_STREQ("zeta", entries[0].name.c_str());
+    ASSERT_STREQ("beta", entries[4].name.c_str());
+    ASSERT_FLOAT_EQ(40.0F, entries[4].value.to<uavcan::IParamManager::Value::Tag::real_value>());
+    ASSERT_FLOAT_EQ(-4.0F, entries[4].min_value.to<uavcan::IParamManager::NumericValue::Tag::real_value>());
+
+    ASSERT_EQ(3, mgr.readParams(5, entries, 5));
+    ASSERT_STREQ("omega", entries[0].name.c_str());
+    ASSERT_STREQ("kappa", entries[2].name.c_str());
+    ASSERT_EQ(0, mgr.readParams(8, entries, 5));
+
+    /*
+     * The index must be rebuilt when the set of parameters changes
+     */
+    mgr.names.push_back("gamma");
+    mgr.values.push_back(90.0F);
+    ASSERT_FALSE(mgr.findParamIndex("gamma", index));
+    mgr.invalidateIndex();
+    ASSERT_TRUE(mgr.findParamIndex("gamma", index));
+    ASSERT_EQ(8, index);
+    ASSERT_TRUE(mgr.findParamIndex("alpha_10", index));
+    ASSERT_EQ(6, index);
+}
+
+
+class ParamStorageBackendMock : public uavcan::IParamStorageBackend
+{
+    std::vector<uint8_t> banks_[NumBanks];
+
+public:
+    bool fail_writes;
+    unsigned num_writes;
+    unsigned num_erasures;
+
+    explicit ParamStorageBackendMock(unsigned bank_size)
+        : fail_writes(false)
+        , num_writes(0)
+        , num_erasures(0)
+    {
+        for (unsigned i = 0; i < NumBanks; i++)
+        {
+            banks_[i].resize(bank_size, 0xFF);
+        }
+    }
+
+    std::vector<uint8_t>& getBank(uint8_t bank) { return banks_[bank]; }
+
+    virtual unsigned getBankSize() const { return unsigned(banks_[0].size()); }
+
+    virtual int read(uint8_t bank, unsigned offset, uint8_t* data, unsigned len)
+    {
+        assert((bank < NumBanks) && ((offset + len) <= getBankSize()));
+        std::copy(banks_[bank].begin() + offset, banks_[bank].begin() + offset + len, data);
+        return 0;
+    }
+
+    virtual int write(uint8_t bank, unsigned offset, const uint8_t* data, unsigned len)
+    {
+        assert((bank < NumBanks) && ((offset + len) <= getBankSize()));
+        if (fail_writes)
+        {
+            return -uavcan::ErrDriver;
+        }
+        for (unsigned i = 0; i < len; i++)
+        {
+            assert(banks_[bank][offset + i] == 0xFF);   // Flash can be written only once between erasures
+            banks_[bank][offset + i] = data[i];
+        }
+        num_writes++;
+        return 0;
+    }
+
+    virtual int erase(uint8_t bank)
+    {
+        assert(bank < NumBanks);
+        std::fill(banks_[bank].begin(), banks_[bank].end(), 0xFF);
+        num_erasures++;
+        return 0;
+    }
+};
+
+
+struct PersistentParamManagerTest : public uavcan::PersistentParamManager<16>
+{
+    std::vector<std::string> names;
+    std::vector<float> values;
+
+    PersistentParamManagerTest(uavcan::IParamStorageBackend& backend, uavcan::INode& node)
+        : uavcan::PersistentParamManager<16>(backend, node)
+    {
+        const char* const Names[] = { "p0", "p1", "p2" };
+        for (unsigned i = 0; i < 3; i++)
+        {
+            names.push_back(Names[i]);
+            values.push_back(0.0F);
+        }
+    }
+
+    virtual Index getNumParams() const { return Index(names.size()); }
+
+    virtual void getParamNameByIndex(Index index, Name& out_name) const
+    {
+        if (index < names.size())
+        {
+            out_name = names[index].c_str();
+        }
+    }
+
+    virtual void assignParamValueByIndex(Index index, const Value& value)
+    {
+        assert(index < values.size());
+        if (value.is(Value::Tag::real_value))
+        {
+            values[index] = value.real_value;
+        }
+    }
+
+    virtual void readParamValueByIndex(Index index, Value& out_value) const
+    {
+        assert(index < values.size());
+        out_value.to<Value::Tag::real_value>() = values[index];
+    }
+
+    virtual void readParamDefaultMaxMinByIndex(Index, Value&, NumericValue&, NumericValue&) const { }
+
+    void set(const char* name, float value)
+    {
+        Value v;
+        v.to<Value::Tag::real_value>() = value;
+        uavcan::IParamManager& base = *this;
+        base.assignParamValue(name, v);
+    }
+};
+
+
+TEST(ParamServer, PersistentParamManager)
+{
+    InterlinkedTestNodesWithSysClock nodes;
+
+    // Header is 10 bytes; every record of these params takes 11 bytes, so the bank fits 4 records
+    ParamStorageBackendMock backend(64);
+
+    PersistentParamManagerTest mgr(backend, nodes.a);
+    ASSERT_EQ(0, mgr.loadParams());
+    ASSERT_FALSE(mgr.getLog().hasActiveBank());
+    ASSERT_EQ(0, mgr.getNumDirtyParams());
+
+    /*
+     * The first save writes all params
+     */
+    mgr.set("p1", 1.0F);
+    mgr.set("unknown", 1.0F);
+    ASSERT_EQ(1, mgr.getNumDirtyParams());
+    ASSERT_TRUE(mgr.isParamDirty(1));
+
+    ASSERT_EQ(0, mgr.saveAllParams());
+    ASSERT_EQ(0, mgr.getNumDirtyParams());
+    ASSERT_TRUE(mgr.getLog().hasActiveBank());
+    ASSERT_EQ(1, mgr.getLog().getSequence());
+    ASSERT_EQ(10 + 3 * 11, mgr.getLog().getUsedSize());
+    const uint8_t first_bank = mgr.getLog().getActiveBank();
+
+    /*
+     * Only the changed params are written
+     */
+    mgr.set("p1", 1.0F);                            // Same value
+    ASSERT_EQ(0, mgr.getNumDirtyParams());
+    const unsigned num_writes = backend.num_writes;
+    ASSERT_EQ(0, mgr.saveAllParams());
+    ASSERT_EQ(num_writes, backend.num_writes);
+
+    mgr.set("p2", 2.0F);
+    ASSERT_EQ(0, mgr.saveAllParams());
+    ASSERT_EQ(num_writes + 1, backend.num_writes);
+    ASSERT_EQ(10 + 4 * 11, mgr.getLog().getUsedSize());
+
+    /*
+     * The bank is full; compaction into the other bank
+     */
+    mgr.set("p0", 3.0F);
+    ASSERT_EQ(0, mgr.saveAllParams());
+    ASSERT_EQ(2, mgr.getLog().getSequence());
+    ASSERT_NE(first_bank, mgr.getLog().getActiveBank());
+    ASSERT_EQ(10 + 3 * 11, mgr.getLog().getUsedSize());
+
+    mgr.set("p2", 4.0F);
+    ASSERT_EQ(0, mgr.saveAllParams());              // Fills the bank
+
+    /*
+     * Reload; the last record of every param wins
+     */
+    {
+        PersistentParamManagerTest mgr2(backend, nodes.a);
+        ASSERT_EQ(0, mgr2.loadParams());
+        ASSERT_FLOAT_EQ(3.0F, mgr2.values[0]);
+        ASSERT_FLOAT_EQ(1.0F, mgr2.values[1]);
+        ASSERT_FLOAT_EQ(4.0F, mgr2.values[2]);
+        ASSERT_EQ(0, mgr2.getNumDirtyParams());
+        ASSERT_EQ(mgr.getLog().getUsedSize(), mgr2.getLog().getUsedSize());
+    }
+
+    /*
+     * Compaction fails; the old bank stays valid and the params stay dirty
+     */
+    mgr.set("p1", 5.0F);
+    backend.fail_writes = true;
+    ASSERT_GT(0, mgr.saveAllParams());
+    ASSERT_GT(0, mgr.getLastSaveResult());
+    ASSERT_EQ(3, mgr.getNumDirtyParams());
+    ASSERT_FALSE(mgr.getLog().isCompacting());
+    ASSERT_EQ(2, mgr.getLog().getSequence());
+    backend.fail_writes = false;
+    {
+        PersistentParamManagerTest mgr2(backend, nodes.a);
+        ASSERT_EQ(0, mgr2.loadParams());
+        ASSERT_FLOAT_EQ(1.0F, mgr2.values[1]);
+        ASSERT_FLOAT_EQ(4.0F, mgr2.values[2]);
+    }
+
+    /*
+     * Damaged record terminates the log; the next save compacts
+     */
+    {
+        std::vector<uint8_t>& bank = backend.getBank(mgr.getLog().getActiveBank());
+        bank[10 + 4 * 11 - 1] ^= 0x01U;             // CRC of the last record
+        PersistentParamManagerTest mgr2(backend, nodes.a);
+        ASSERT_EQ(0, mgr2.loadParams());
+        ASSERT_FLOAT_EQ(2.0F, mgr2.values[2]);      // The older record
+        ASSERT_EQ(64, mgr2.getLog().getUsedSize());
+    }
+
+    /*
+     * Asynchronous save
+     */
+    mgr.setAsyncSave(true);
+    ASSERT_EQ(0, mgr.saveAllParams());
+    ASSERT_TRUE(mgr.isSavePending());
+    ASSERT_EQ(3, mgr.getNumDirtyParams());          // Nothing is written before the node is spinning
+
+    ASSERT_LE(0, nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(50)));
+    ASSERT_FALSE(mgr.isSavePending());
+    ASSERT_EQ(0, mgr.getLastSaveResult());
+    ASSERT_EQ(0, mgr.getNumDirtyParams());
+    ASSERT_EQ(3, mgr.getLog().getSequence());
+    {
+        PersistentParamManagerTest mgr2(backend, nodes.a);
+        ASSERT_EQ(0, mgr2.loadParams());
+        ASSERT_FLOAT_EQ(5.0F, mgr2.values[1]);
+        ASSERT_FLOAT_EQ(4.0F, mgr2.values[2]);
+    }
+
+    /*
+     * Erase
+     */
+    ASSERT_EQ(0, mgr.eraseAllParams());
+    ASSERT_FALSE(mgr.getLog().hasActiveBank());
+    ASSERT_EQ(3, mgr.getNumDirtyParams());
+    {
+        PersistentParamManagerTest mgr2(backend, nodes.a);
+        ASSERT_EQ(0, mgr2.loadParams());
+        ASSERT_FALSE(mgr2.getLog().hasActiveBank());
+        ASSERT_FLOAT_EQ(0.0F, mgr2.values[1]);
+    }
+}
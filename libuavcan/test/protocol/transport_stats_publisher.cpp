@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <gtest/gtest.h>
+#include <map>
+#include <string>
+#include <uavcan/protocol/transport_stats_publisher.hpp>
+#include "helpers.hpp"
+
+
+struct KeyValueAccumulator
+{
+    std::map<std::string, float> sums;
+    unsigned num_messages;
+
+    KeyValueAccumulator() : num_messages(0) { }
+
+    void handle(const uavcan::ReceivedDataStructure<uavcan::protocol::debug::KeyValue>& msg)
+    {
+        sums[msg.key.c_str()] += msg.value;
+        num_messages++;
+    }
+
+    typedef uavcan::MethodBinder<KeyValueAccumulator*,
+        void (KeyValueAccumulator::*)(const uavcan::ReceivedDataStructure<uavcan::protocol::debug::KeyValue>&)>
+        Binder;
+
+    Binder bind() { return Binder(this, &KeyValueAccumulator::handle); }
+};
+
+
+TEST(TransportStatsPublisher, Basic)
+{
+    InterlinkedTestNodesWithSysClock nodes;
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::debug::KeyValue> _reg1;
+
+    KeyValueAccumulator accumulator;
+    uavcan::Subscriber<uavcan::protocol::debug::KeyValue, KeyValueAccumulator::Binder> sub(nodes.b);
+    ASSERT_LE(0, sub.start(accumulator.bind()));
+
+    uavcan::TransportStatsPublisher tsp(nodes.a);
+
+    ASSERT_EQ(-uavcan::ErrInvalidParam, tsp.start(uavcan::MonotonicDuration()));
+    ASSERT_FALSE(tsp.isRunning());
+
+    ASSERT_LE(0, tsp.start(uavcan::MonotonicDuration::fromMSec(100)));
+    ASSERT_TRUE(tsp.isRunning());
+    ASSERT_EQ(100, tsp.getInterval().toMSec());
+
+    /*
+     * Nothing has happened yet - nothing to publish
+     */
+    ASSERT_LE(0, nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(200)));
+    ASSERT_EQ(0, accumulator.num_messages);
+
+    /*
+     * Some traffic; the totals must match the counters
+     */
+    uavcan::protocol::debug::KeyValue kv;
+    kv.key = "foo";
+    uavcan::Publisher<uavcan::protocol::debug::KeyValue> pub(nodes.a);
+    ASSERT_LE(0, pub.broadcast(kv));
+    ASSERT_LE(0, pub.broadcast(kv));
+
+    ASSERT_LE(0, nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(300)));
+
+    ASSERT_EQ(1, accumulator.sums.count("foo"));
+    ASSERT_LE(2, accumulator.sums["tr.tx"]);
+    ASSERT_LE(2, accumulator.sums["can0.tx"]);
+    ASSERT_EQ(0, accumulator.sums.count("can1.tx"));                  // There is only one iface
+    ASSERT_EQ(0, accumulator.sums.count("tr.rx"));                    // Nothing was received by the node A
+
+    /*
+     * Without other traffic, only the increments caused by the publisher itself are reported
+     */
+    const unsigned num_messages = accumulator.num_messages;
+    ASSERT_LE(0, nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(500)));
+    ASSERT_LT(num_messages, accumulator.num_messages);
+    ASSERT_GE(num_messages + 2 * 6, accumulator.num_messages);        // tr.tx and can0.tx, up to 6 intervals
+
+    tsp.stop();
+    ASSERT_FALSE(tsp.isRunning());
+
+    const uavcan::TransferPerfCounter& perf = nodes.a.getDispatcher().getTransferPerfCounter();
+    const uavcan::CanIfacePerfCounters can_perf = nodes.a.getDispatcher().getCanIOManager().getIfacePerfCounters(0);
+
+    // The messages of the last publication are not accounted for yet
+    ASSERT_LT(uint64_t(accumulator.sums["tr.tx"]), perf.getTxTransferCount());
+    ASSERT_GE(uint64_t(accumulator.sums["tr.tx"]) + 2, perf.getTxTransferCount());
+    ASSERT_LT(uint64_t(accumulator.sums["can0.tx"]), can_perf.frames_tx);
+    ASSERT_GE(uint64_t(accumulator.sums["can0.tx"]) + 2, can_perf.frames_tx);
+
+    /*
+     * Limited number of messages per interval
+     */
+    tsp.setMaxMessagesPerInterval(0);
+    ASSERT_EQ(1, tsp.getMaxMessagesPerInterval());
+    ASSERT_LE(0, tsp.start(uavcan::MonotonicDuration::fromMSec(100)));
+
+    const unsigned num_messages_before_limit = accumulator.num_messages;
+    ASSERT_LE(0, nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(330)));
+    ASSERT_LE(num_messages_before_limit + 2, accumulator.num_messages);
+    ASSERT_GE(num_messages_before_limit + 3, accumulator.num_messages);
+}
@@ -6,6 +6,7 @@
 
 #include <cassert>
 #include <queue>
+#include <algorithm>
 #include <vector>
 #include <gtest/gtest.h>
 #include <uavcan/transport/can_io.hpp>
@@ -51,6 +52,9 @@ public:
     bool writeable;
     bool tx_failure;
     bool rx_failure;
+    bool peekable;
+    uavcan::uint16_t num_free_tx_slots;     ///< Reported as is, see ICanIface::getNumFreeTxSlots()
+    uavcan::uint16_t num_configs_per_filter;
     uint64_t num_errors;
     uavcan::ISystemClock& iclock;
     bool enable_utc_timestamping;
@@ -60,6 +64,9 @@ public:
         : writeable(true)
         , tx_failure(false)
         , rx_failure(false)
+        , peekable(false)
+        , num_free_tx_slots(0)
+        , num_configs_per_filter(1)
         , num_errors(0)
         , iclock(iclock)
         , enable_utc_timestamping(false)
@@ -179,11 +186,44 @@ public:
         return 1;
     }
 
+    virtual uavcan::int16_t receiveBatch(uavcan::CanRxFrame* out_frames, uavcan::CanIOFlags* out_flags,
+                                         uavcan::uint16_t max_frames)
+    {
+        // Like a real driver, never attempting to read more than what is available
+        const uavcan::uint16_t available = uavcan::uint16_t(rx.size() + loopback.size());
+        return ICanIface::receiveBatch(out_frames, out_flags, std::min(max_frames, available));
+    }
+
+    virtual uavcan::uint16_t getNumFreeTxSlots() const { return num_free_tx_slots; }
+
+    virtual uavcan::int16_t peekRxFrameId(uavcan::uint32_t& out_can_id)
+    {
+        if (!peekable)
+        {
+            return ICanIface::peekRxFrameId(out_can_id);
+        }
+        if (!loopback.empty())
+        {
+            out_can_id = loopback.front().frame.id;
+            return 1;
+        }
+        if (rx.empty())
+        {
+            return 0;
+        }
+        out_can_id = rx.front().frame.id;
+        return 1;
+    }
+
     // cppcheck-suppress unusedFunction
     // cppcheck-suppress functionConst
     virtual uavcan::int16_t configureFilters(const uavcan::CanFilterConfig*, uavcan::uint16_t) { return 0; }
     // cppcheck-suppress unusedFunction
     virtual uavcan::uint16_t getNumFilters() const { return 4; } // decrease number of HW_filters from 9 to 4
+    virtual uavcan::uint16_t getNumFiltersRequired(const uavcan::CanFilterConfig*, uavcan::uint16_t num_configs) const
+    {
+        return uavcan::uint16_t((num_configs + num_configs_per_filter - 1U) / num_configs_per_filter);
+    }
     virtual uavcan::uint64_t getErrorCount() const { return num_errors; }
 };
 
@@ -78,6 +78,49 @@ TEST(CanFrame, Arbitration)
     ASSERT_TRUE(b.priorityHigherThan(a));
 }
 
+TEST(CanFrame, DataLengthCode)
+{
+    using uavcan::CanFrame;
+
+    // Classic CAN codes map to themselves
+    for (uavcan::uint8_t i = 0; i <= 8; i++)
+    {
+        EXPECT_EQ(i, CanFrame::dlcToDataLength(i));
+        EXPECT_EQ(i, CanFrame::dataLengthToDlc(i));
+        EXPECT_EQ(i, CanFrame::roundDownDataLength(i));
+    }
+
+    // CAN FD codes
+    EXPECT_EQ(12, CanFrame::dlcToDataLength(9));
+    EXPECT_EQ(32, CanFrame::dlcToDataLength(13));
+    EXPECT_EQ(64, CanFrame::dlcToDataLength(15));
+    EXPECT_EQ(64, CanFrame::dlcToDataLength(200));
+
+    EXPECT_EQ(9,  CanFrame::dataLengthToDlc(9));         // Rounded up
+    EXPECT_EQ(9,  CanFrame::dataLengthToDlc(12));
+    EXPECT_EQ(14, CanFrame::dataLengthToDlc(33));
+    EXPECT_EQ(15, CanFrame::dataLengthToDlc(64));
+    EXPECT_EQ(15, CanFrame::dataLengthToDlc(255));
+
+    // Rounding down depends on whether CAN FD is enabled
+    if (CanFrame::MaxDataLen > CanFrame::MaxClassicDataLen)
+    {
+        EXPECT_EQ(8,  CanFrame::roundDownDataLength(9));
+        EXPECT_EQ(12, CanFrame::roundDownDataLength(12));
+        EXPECT_EQ(12, CanFrame::roundDownDataLength(15));
+        EXPECT_EQ(48, CanFrame::roundDownDataLength(63));
+        EXPECT_EQ(64, CanFrame::roundDownDataLength(64));
+        EXPECT_EQ(64, CanFrame::roundDownDataLength(1000));
+    }
+    else
+    {
+        EXPECT_EQ(8, CanFrame::roundDownDataLength(9));
+        EXPECT_EQ(8, CanFrame::roundDownDataLength(64));
+    }
+
+    EXPECT_FALSE(makeCanFrame(0, "12345678", EXT).isCanFD());
+}
+
 TEST(CanFrame, ToString)
 {
     uavcan::CanFrame frame = makeCanFrame(123, "\x01\x02\x03\x04" "1234", EXT);
@@ -111,6 +111,88 @@ TEST(CanIOManager, Reception)
     EXPECT_EQ(0, iomgr.getIfacePerfCounters(1).frames_tx);
 }
 
+TEST(CanIOManager, ReceiveBatch)
+{
+    // Memory
+    uavcan::PoolAllocator<sizeof(uavcan::CanTxQueue::Entry) * 4, sizeof(uavcan::CanTxQueue::Entry)> pool;
+
+    // Platform interface
+    SystemClockMock clockmock;
+    CanDriverMock driver(2, clockmock);
+
+    // IO Manager
+    uavcan::CanIOManager iomgr(driver, pool, clockmock);
+
+    uavcan::CanRxFrame frames[4];
+    uavcan::CanIOFlags flags[4] = {};
+
+    /*
+     * Empty, will time out
+     */
+    EXPECT_EQ(0, iomgr.receiveBatch(frames, flags, 4, tsMono(100)));
+    EXPECT_EQ(100, clockmock.monotonic);
+
+    /*
+     * Both ifaces are drained in one call, limited by the output buffer size
+     */
+    const uavcan::CanFrame a0 = makeCanFrame(1, "a0", EXT);
+    const uavcan::CanFrame a1 = makeCanFrame(99, "a1", EXT);
+    const uavcan::CanFrame a2 = makeCanFrame(803, "a2", STD);
+    const uavcan::CanFrame b0 = makeCanFrame(6341, "b0", EXT);
+    const uavcan::CanFrame b1 = makeCanFrame(196, "b1", STD);
+
+    driver.ifaces.at(0).pushRx(a0);        // Timestamp 100
+    driver.ifaces.at(1).pushRx(b0);
+    clockmock.advance(10);
+    driver.ifaces.at(0).pushRx(a1);        // Timestamp 110
+    driver.ifaces.at(1).pushRx(b1);
+    clockmock.advance(10);
+    driver.ifaces.at(0).pushRx(a2);        // Timestamp 120
+
+    EXPECT_EQ(4, iomgr.receiveBatch(frames, flags, 4, uavcan::MonotonicTime()));
+    EXPECT_TRUE(rxFrameEquals(frames[0], a0, 100, 0));
+    EXPECT_TRUE(rxFrameEquals(frames[1], a1, 110, 0));
+    EXPECT_TRUE(rxFrameEquals(frames[2], a2, 120, 0));
+    EXPECT_TRUE(rxFrameEquals(frames[3], b0, 100, 1));
+    for (int i = 0; i < 4; i++)
+    {
+        EXPECT_EQ(0, flags[i]);
+    }
+
+    EXPECT_EQ(1, iomgr.receiveBatch(frames, flags, 4, uavcan::MonotonicTime()));
+    EXPECT_TRUE(rxFrameEquals(frames[0], b1, 110, 1));
+
+    EXPECT_EQ(0, iomgr.receiveBatch(frames, flags, 4, uavcan::MonotonicTime()));
+
+    /*
+     * Loopback frames are mixed with regular frames and don't affect the counters
+     */
+    EXPECT_EQ(1, iomgr.send(a0, tsMono(1000), uavcan::MonotonicTime(), 1, uavcan::CanTxQueue::Volatile,
+                            uavcan::CanIOFlagLoopback));
+    ASSERT_TRUE(driver.ifaces.at(0).matchAndPopTx(a0, 1000));
+    driver.ifaces.at(0).pushRx(a1);
+
+    EXPECT_EQ(2, iomgr.receiveBatch(frames, flags, 4, uavcan::MonotonicTime()));
+    EXPECT_TRUE(rxFrameEquals(frames[0], a0, 120, 0));
+    EXPECT_EQ(uavcan::CanIOFlagLoopback, flags[0]);
+    EXPECT_TRUE(rxFrameEquals(frames[1], a1, 120, 0));
+    EXPECT_EQ(0, flags[1]);
+
+    /*
+     * Errors
+     */
+    driver.ifaces.at(1).pushRx(b0);
+    driver.ifaces.at(1).rx_failure = true;
+    EXPECT_EQ(-uavcan::ErrDriver, iomgr.receiveBatch(frames, flags, 4, uavcan::MonotonicTime()));
+
+    driver.ifaces.at(0).pushRx(a0);         // Frames received before the error are not lost
+    EXPECT_EQ(1, iomgr.receiveBatch(frames, flags, 4, uavcan::MonotonicTime()));
+    EXPECT_TRUE(rxFrameEquals(frames[0], a0, 120, 0));
+
+    EXPECT_EQ(5, iomgr.getIfacePerfCounters(0).frames_rx);
+    EXPECT_EQ(2, iomgr.getIfacePerfCounters(1).frames_rx);
+}
+
 TEST(CanIOManager, Transmission)
 {
     using uavcan::CanIOManager;
@@ -176,7 +258,11 @@ TEST(CanIOManager, Transmission)
     // Sending to both, both blocked
     driver.ifaces.at(1).writeable = false;
     EXPECT_EQ(0, iomgr.send(frames[1], tsMono(777), tsMono(300), ALL_IFACES_MASK, CanTxQueue::Volatile, flags));
+#if UAVCAN_SHARED_TX_QUEUE
+    EXPECT_EQ(2, pool.getNumUsedBlocks());          // Total 2 frames in TX queues now, frames[1] is stored once
+#else
     EXPECT_EQ(3, pool.getNumUsedBlocks());          // Total 3 frames in TX queue now
+#endif
     EXPECT_TRUE(driver.ifaces.at(0).matchPendingTx(frames[0])); // Still 0
     EXPECT_TRUE(driver.ifaces.at(1).matchPendingTx(frames[1])); // 1!!
 
@@ -186,13 +272,22 @@ TEST(CanIOManager, Transmission)
     EXPECT_EQ(400, clockmock.utc);
     EXPECT_TRUE(driver.ifaces.at(0).tx.empty());
     EXPECT_TRUE(driver.ifaces.at(1).tx.empty());
+#if UAVCAN_SHARED_TX_QUEUE
+    EXPECT_EQ(3, pool.getNumUsedBlocks());
+#else
     EXPECT_EQ(4, pool.getNumUsedBlocks());
+#endif
     EXPECT_TRUE(driver.ifaces.at(0).matchPendingTx(frames[0]));
     EXPECT_TRUE(driver.ifaces.at(1).matchPendingTx(frames[1]));
 
     // At this time TX queues are containing the following data:
+#if UAVCAN_SHARED_TX_QUEUE
+    // iface 0: frames[0] (EXPIRED), frames[2]
+    // shared:  frames[1] (pending on both ifaces)
+#else
     // iface 0: frames[0] (EXPIRED), frames[1], frames[2]
     // iface 1: frames[1]
+#endif
 
     // Sending to #1, both writeable
     driver.ifaces.at(0).writeable = true;
@@ -228,17 +323,27 @@ TEST(CanIOManager, Transmission)
     driver.ifaces.at(0).writeable = false;
     driver.ifaces.at(1).writeable = false;
 
+#if UAVCAN_SHARED_TX_QUEUE
+    // Sending 5 frames to the ifaces; these would not fit the pool if they were stored per iface
+    EXPECT_EQ(0, iomgr.send(frames[2], tsMono(2222), tsMono(1000), ALL_IFACES_MASK, CanTxQueue::Persistent, flags));
+    EXPECT_EQ(0, iomgr.send(frames[0], tsMono(3333), tsMono(1100), 2, CanTxQueue::Persistent, flags));
+#else
     // Sending 5 frames, one will be rejected
     EXPECT_EQ(0, iomgr.send(frames[2], tsMono(2222), tsMono(1000), ALL_IFACES_MASK, CanTxQueue::Persistent, flags));
     EXPECT_EQ(0, iomgr.send(frames[0], tsMono(3333), tsMono(1100), 2, CanTxQueue::Persistent, flags));
     // One frame kicked here:
+#endif
     EXPECT_EQ(0, iomgr.send(frames[1], tsMono(4444), tsMono(1200), ALL_IFACES_MASK, CanTxQueue::Volatile, flags));
 
     EXPECT_TRUE(driver.ifaces.at(0).matchPendingTx(frames[1]));
     EXPECT_TRUE(driver.ifaces.at(1).matchPendingTx(frames[0]));
 
     // State checks
+#if UAVCAN_SHARED_TX_QUEUE
+    EXPECT_EQ(3, pool.getNumUsedBlocks());          // One block per frame
+#else
     EXPECT_EQ(4, pool.getNumUsedBlocks());          // TX queue is full
+#endif
     EXPECT_EQ(1200, clockmock.monotonic);
     EXPECT_EQ(1200, clockmock.utc);
     EXPECT_TRUE(driver.ifaces.at(0).tx.empty());
@@ -264,9 +369,21 @@ TEST(CanIOManager, Transmission)
     EXPECT_EQ(1, iomgr.receive(rx_frame, tsMono(0), flags));
     EXPECT_TRUE(rxFrameEquals(rx_frame, rx_frames[1], 1200, 1));
     EXPECT_TRUE(driver.ifaces.at(0).matchAndPopTx(frames[2], 2222));
+#if UAVCAN_SHARED_TX_QUEUE
+    EXPECT_TRUE(driver.ifaces.at(1).matchAndPopTx(frames[1], 4444));
+    ASSERT_EQ(0, flags);
+    EXPECT_TRUE(driver.ifaces.at(0).matchPendingTx(frames[2]));
+    EXPECT_TRUE(driver.ifaces.at(1).matchPendingTx(frames[1]));
+
+    EXPECT_EQ(0, iomgr.receive(rx_frame, tsMono(0), flags));
+    EXPECT_TRUE(driver.ifaces.at(0).tx.empty());
+    EXPECT_TRUE(driver.ifaces.at(1).matchAndPopTx(frames[2], 2222));
+    EXPECT_TRUE(driver.ifaces.at(0).matchPendingTx(uavcan::CanFrame()));
+#else
     EXPECT_TRUE(driver.ifaces.at(1).matchAndPopTx(frames[2], 2222));  // Iface #1, frame[1] was rejected (VOLATILE)
     ASSERT_EQ(0, flags);
     EXPECT_TRUE(driver.ifaces.at(0).matchPendingTx(frames[2]));
+#endif
     EXPECT_TRUE(driver.ifaces.at(1).matchPendingTx(frames[2]));
 
     // State checks
@@ -276,7 +393,11 @@ TEST(CanIOManager, Transmission)
     EXPECT_TRUE(driver.ifaces.at(0).tx.empty());
     EXPECT_TRUE(driver.ifaces.at(1).tx.empty());
     EXPECT_EQ(1, iomgr.getIfacePerfCounters(0).errors);
+#if UAVCAN_SHARED_TX_QUEUE
+    EXPECT_EQ(0, iomgr.getIfacePerfCounters(1).errors);
+#else
     EXPECT_EQ(1, iomgr.getIfacePerfCounters(1).errors); // This is because of rejected frame[1]
+#endif
 
     /*
      * Error handling
@@ -303,7 +424,11 @@ TEST(CanIOManager, Transmission)
     EXPECT_TRUE(driver.ifaces.at(0).matchPendingTx(frames[0]));
     EXPECT_TRUE(driver.ifaces.at(1).matchPendingTx(frames[0]));
 
+#if UAVCAN_SHARED_TX_QUEUE
+    ASSERT_EQ(1, pool.getNumUsedBlocks());               // Untransmitted frame will be buffered once
+#else
     ASSERT_EQ(2, pool.getNumUsedBlocks());               // Untransmitted frames will be buffered
+#endif
 
     // Failure removed - transmission shall proceed
     driver.ifaces.at(0).tx_failure = false;
@@ -323,7 +448,11 @@ TEST(CanIOManager, Transmission)
     EXPECT_EQ(1, iomgr.getIfacePerfCounters(1).frames_rx);
 
     EXPECT_EQ(6, iomgr.getIfacePerfCounters(0).frames_tx);
+#if UAVCAN_SHARED_TX_QUEUE
+    EXPECT_EQ(9, iomgr.getIfacePerfCounters(1).frames_tx);
+#else
     EXPECT_EQ(8, iomgr.getIfacePerfCounters(1).frames_tx);
+#endif
 }
 
 TEST(CanIOManager, Loopback)
@@ -380,6 +509,828 @@ TEST(CanIOManager, Loopback)
     EXPECT_EQ(0, iomgr.getIfacePerfCounters(1).frames_tx);
 }
 
+TEST(CanIOManager, TxQueueMode)
+{
+    using uavcan::CanIOManager;
+    using uavcan::CanTxQueue;
+
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 8, uavcan::MemPoolBlockSize> pool;
+
+    SystemClockMock clockmock;
+    CanDriverMock driver(2, clockmock);
+
+    CanIOManager iomgr(driver, pool, clockmock, 9999);
+    ASSERT_EQ(0, iomgr.setTxQueueMode(CanTxQueue::ModeTreap));
+
+    const uavcan::CanFrame frame_a = makeCanFrame(10, "a", EXT);
+    const uavcan::CanFrame frame_b = makeCanFrame(20, "b", EXT);
+    const uavcan::CanIOFlags flags = uavcan::CanIOFlags();
+
+    // Iface #0 is blocked, so the frame goes into its TX queue
+    driver.ifaces.at(0).writeable = false;
+    EXPECT_EQ(1, iomgr.send(frame_a, tsMono(1000), tsMono(0), 3, CanTxQueue::Persistent, flags));
+    EXPECT_TRUE(driver.ifaces.at(1).matchAndPopTx(frame_a, 1000));
+    EXPECT_EQ(1, pool.getNumUsedBlocks());
+
+    // Mode can't be changed while there are pending frames
+    EXPECT_EQ(-uavcan::ErrLogic, iomgr.setTxQueueMode(CanTxQueue::ModeLinkedList));
+
+    // Queued frame has higher priority, so it goes first
+    driver.ifaces.at(0).writeable = true;
+    EXPECT_LT(0, iomgr.send(frame_b, tsMono(1000), tsMono(100), 1, CanTxQueue::Persistent, flags));
+    EXPECT_TRUE(driver.ifaces.at(0).matchAndPopTx(frame_a, 1000));
+    EXPECT_TRUE(driver.ifaces.at(0).matchAndPopTx(frame_b, 1000));
+    EXPECT_TRUE(driver.ifaces.at(0).tx.empty());
+    EXPECT_EQ(0, pool.getNumUsedBlocks());
+
+    EXPECT_EQ(0, iomgr.setTxQueueMode(CanTxQueue::ModeLinkedList));
+
+    // Expired frames are purged by cleanup without any transmission attempts
+    driver.ifaces.at(0).writeable = false;
+    EXPECT_EQ(1, iomgr.send(frame_a, tsMono(1000), tsMono(100), 3, CanTxQueue::Persistent, flags));
+    EXPECT_TRUE(driver.ifaces.at(1).matchAndPopTx(frame_a, 1000));
+    EXPECT_EQ(1, pool.getNumUsedBlocks());
+    iomgr.cleanup(tsMono(1000));
+    EXPECT_EQ(1, pool.getNumUsedBlocks());
+    iomgr.cleanup(tsMono(1001));
+    EXPECT_EQ(0, pool.getNumUsedBlocks());
+    EXPECT_EQ(1, iomgr.getIfacePerfCounters(0).errors);
+
+    // Frame that is already expired is not passed to the driver at all
+    driver.ifaces.at(0).writeable = true;
+    clockmock.monotonic = 2000;
+    EXPECT_EQ(0, iomgr.send(frame_b, tsMono(2000), tsMono(2000), 3, CanTxQueue::Persistent, flags));
+    EXPECT_TRUE(driver.ifaces.at(0).tx.empty());
+    EXPECT_TRUE(driver.ifaces.at(1).tx.empty());
+    EXPECT_EQ(2, iomgr.getIfacePerfCounters(0).errors);
+    EXPECT_EQ(1, iomgr.getIfacePerfCounters(1).errors);
+}
+
+#if UAVCAN_SHARED_TX_QUEUE
+
+TEST(CanIOManager, SharedTxQueue)
+{
+    using uavcan::CanIOManager;
+    using uavcan::CanTxQueue;
+
+    static const unsigned NumFrames = 6;
+    const uavcan::CanIOFlags flags = uavcan::CanIOFlags();
+
+    for (int mode = CanTxQueue::ModeLinkedList; mode <= CanTxQueue::ModeTreap; mode++)
+    {
+        uavcan::PoolAllocator<uavcan::MemPoolBlockSize * NumFrames, uavcan::MemPoolBlockSize> pool;
+
+        SystemClockMock clockmock;
+        CanDriverMock driver(3, clockmock);
+
+        CanIOManager iomgr(driver, pool, clockmock, 9999);
+        ASSERT_EQ(0, iomgr.setTxQueueMode(CanTxQueue::Mode(mode)));
+
+        // All ifaces are blocked; each frame takes one block regardless of the number of ifaces
+        for (unsigned i = 0; i < 3; i++)
+        {
+            driver.ifaces.at(i).writeable = false;
+        }
+        for (unsigned i = 0; i < NumFrames; i++)
+        {
+            const uavcan::CanFrame frame = makeCanFrame(100U - i / 2, std::string(1, char('a' + i)), EXT);
+            EXPECT_EQ(0, iomgr.send(frame, tsMono(10000), tsMono(i), 7, CanTxQueue::Persistent, flags));
+        }
+        EXPECT_EQ(NumFrames, pool.getNumUsedBlocks());
+        EXPECT_EQ(7, iomgr.makePendingTxMask());
+
+        // Iface #0 drains its frames first; the entries are still held for the other ifaces
+        uavcan::CanRxFrame rx_frame;
+        uavcan::CanIOFlags rx_flags = 0;
+        driver.ifaces.at(0).writeable = true;
+        for (unsigned i = 0; i < NumFrames; i++)
+        {
+            EXPECT_EQ(0, iomgr.receive(rx_frame, tsMono(0), rx_flags));
+        }
+        EXPECT_EQ(NumFrames, driver.ifaces.at(0).tx.size());
+        EXPECT_EQ(NumFrames, pool.getNumUsedBlocks());
+        EXPECT_EQ(6, iomgr.makePendingTxMask());
+
+        // The rest of the ifaces transmit concurrently; the entries are released by the last iface
+        driver.ifaces.at(1).writeable = true;
+        driver.ifaces.at(2).writeable = true;
+        for (unsigned i = 0; i < NumFrames; i++)
+        {
+            EXPECT_EQ(0, iomgr.receive(rx_frame, tsMono(0), rx_flags));
+        }
+        EXPECT_EQ(0, pool.getNumUsedBlocks());
+        EXPECT_EQ(0, iomgr.makePendingTxMask());
+
+        // Every iface has received the same frames in the same order - by priority, then FIFO
+        for (unsigned i = 0; i < NumFrames; i++)
+        {
+            const unsigned index = (NumFrames - 2) - (i / 2) * 2 + (i % 2);
+            const uavcan::CanFrame expected = makeCanFrame(100U - index / 2, std::string(1, char('a' + index)), EXT);
+            for (unsigned k = 0; k < 3; k++)
+            {
+                EXPECT_TRUE(driver.ifaces.at(k).matchAndPopTx(expected, 10000));
+            }
+        }
+
+        // Expired shared entries are accounted on all ifaces
+        driver.ifaces.at(1).writeable = false;
+        driver.ifaces.at(2).writeable = false;
+        EXPECT_EQ(1, iomgr.send(makeCanFrame(1, "x", EXT), tsMono(20000), tsMono(0), 7, CanTxQueue::Volatile, flags));
+        EXPECT_EQ(1, pool.getNumUsedBlocks());
+        iomgr.cleanup(tsMono(20001));
+        EXPECT_EQ(0, pool.getNumUsedBlocks());
+        for (uavcan::uint8_t k = 0; k < 3; k++)
+        {
+            EXPECT_EQ(1, iomgr.getIfacePerfCounters(k).errors);
+        }
+    }
+}
+
+#endif
+
+TEST(CanIOManager, ReplacePending)
+{
+    using uavcan::CanIOManager;
+    using uavcan::CanTxQueue;
+
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 8, uavcan::MemPoolBlockSize> pool;
+
+    SystemClockMock clockmock;
+    CanDriverMock driver(1, clockmock);
+
+    CanIOManager iomgr(driver, pool, clockmock, 9999);
+
+    const uavcan::CanFrame frame_old = makeCanFrame(123, "a\xC0", EXT);
+    const uavcan::CanFrame frame_new = makeCanFrame(123, "b\xC1", EXT);
+    const uavcan::CanIOFlags flags = uavcan::CanIOFlagReplacePending;
+
+    driver.ifaces.at(0).writeable = false;
+    EXPECT_EQ(0, iomgr.send(frame_old, tsMono(1000), tsMono(0), 1, CanTxQueue::Volatile, flags));
+    EXPECT_EQ(0, iomgr.send(frame_new, tsMono(1000), tsMono(0), 1, CanTxQueue::Volatile, flags));
+    EXPECT_EQ(1, pool.getNumUsedBlocks());
+
+    // Only the most recent frame is transmitted; the flag is not passed to the driver
+    driver.ifaces.at(0).writeable = true;
+    const uavcan::CanFrame frame_other = makeCanFrame(456, "c\xC0", EXT);
+    EXPECT_LT(0, iomgr.send(frame_other, tsMono(1000), tsMono(100), 1, CanTxQueue::Volatile, flags));
+    ASSERT_EQ(2, driver.ifaces.at(0).tx.size());
+    EXPECT_EQ(frame_new, driver.ifaces.at(0).tx.front().frame);
+    EXPECT_EQ(0, driver.ifaces.at(0).tx.front().flags & uavcan::CanIOFlagReplacePending);
+    EXPECT_TRUE(driver.ifaces.at(0).matchAndPopTx(frame_new, 1000));
+    EXPECT_TRUE(driver.ifaces.at(0).matchAndPopTx(frame_other, 1000));
+    EXPECT_EQ(0, pool.getNumUsedBlocks());
+}
+
+TEST(CanIOManager, TxRateLimit)
+{
+    using uavcan::CanIOManager;
+    using uavcan::CanTxQueue;
+
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 8, uavcan::MemPoolBlockSize> pool;
+
+    SystemClockMock clockmock(1000000);
+    CanDriverMock driver(2, clockmock);
+
+    CanIOManager iomgr(driver, pool, clockmock, 9999);
+
+    EXPECT_EQ(-uavcan::ErrInvalidParam, iomgr.setIfaceTxRateLimit(2, 1000, 64));
+    EXPECT_EQ(-uavcan::ErrInvalidParam, iomgr.setIfaceTxRateLimit(0, 1000, 1));   // Can't fit a frame
+    EXPECT_EQ(0, iomgr.setIfaceTxRateLimit(0, 1000, 64));                         // 1 byte per ms
+
+    const uavcan::CanFrame frame = makeCanFrame(123, "1234567\xC0", EXT);
+    const uavcan::CanIOFlags flags = uavcan::CanIOFlags();
+
+    // The burst is spent
+    for (int i = 0; i < 8; i++)
+    {
+        EXPECT_EQ(1, iomgr.send(frame, tsMono(2000000), tsMono(0), 1, CanTxQueue::Volatile, flags));
+    }
+    EXPECT_EQ(8, driver.ifaces.at(0).tx.size());
+
+    // The next frame is deferred rather than rejected
+    EXPECT_EQ(0, iomgr.send(frame, tsMono(2000000), tsMono(0), 1, CanTxQueue::Volatile, flags));
+    EXPECT_EQ(8, driver.ifaces.at(0).tx.size());
+    EXPECT_EQ(1, pool.getNumUsedBlocks());
+    EXPECT_EQ(1, iomgr.getIfacePerfCounters(0).frames_deferred);
+    EXPECT_EQ(0, iomgr.getIfacePerfCounters(0).errors);
+
+    // The other iface is not limited
+    for (int i = 0; i < 20; i++)
+    {
+        EXPECT_EQ(1, iomgr.send(frame, tsMono(2000000), tsMono(0), 2, CanTxQueue::Volatile, flags));
+    }
+    EXPECT_EQ(20, driver.ifaces.at(1).tx.size());
+    EXPECT_EQ(0, iomgr.getIfacePerfCounters(1).frames_deferred);
+
+    // Blocking receive wakes up once the budget allows to transmit the deferred frame, 8 ms later
+    uavcan::CanRxFrame rx_frame;
+    uavcan::CanIOFlags rx_flags = 0;
+    clockmock.monotonic = 1000000;
+    EXPECT_EQ(0, iomgr.receive(rx_frame, tsMono(1005000), rx_flags));
+    EXPECT_EQ(1005000, clockmock.monotonic);
+    EXPECT_EQ(8, driver.ifaces.at(0).tx.size());
+    EXPECT_EQ(0, iomgr.receive(rx_frame, tsMono(1100000), rx_flags));
+    EXPECT_EQ(1100000, clockmock.monotonic);
+    EXPECT_EQ(9, driver.ifaces.at(0).tx.size());
+    EXPECT_EQ(0, pool.getNumUsedBlocks());
+    EXPECT_EQ(9, iomgr.getIfacePerfCounters(0).frames_tx);
+
+    // Removing the limit
+    EXPECT_EQ(0, iomgr.setIfaceTxRateLimit(0, 0, 0));
+    for (int i = 0; i < 20; i++)
+    {
+        EXPECT_EQ(1, iomgr.send(frame, tsMono(2000000), tsMono(0), 1, CanTxQueue::Volatile, flags));
+    }
+    EXPECT_EQ(29, driver.ifaces.at(0).tx.size());
+}
+
+TEST(CanIOManager, TxQueueStatus)
+{
+    using uavcan::CanIOManager;
+    using uavcan::CanTxQueue;
+
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 16, uavcan::MemPoolBlockSize> pool;
+
+    SystemClockMock clockmock(1000000);
+    CanDriverMock driver(2, clockmock);
+
+    CanIOManager iomgr(driver, pool, clockmock, 4);
+
+    const uavcan::CanFrame frame = makeCanFrame(123, "a", EXT);
+    const uavcan::CanIOFlags flags = uavcan::CanIOFlags();
+
+    uavcan::CanIfaceTxQueueStatus status = iomgr.getIfaceTxQueueStatus(0);
+    EXPECT_EQ(0, status.num_pending_frames);
+    EXPECT_EQ(4, status.num_free_blocks);
+    EXPECT_TRUE(status.estimated_drain_time.isZero());
+
+    // The drain rate is not known yet
+    driver.ifaces.at(0).writeable = false;
+    driver.ifaces.at(1).writeable = false;
+    EXPECT_EQ(0, iomgr.send(frame, tsMono(9000000), tsMono(0), 1, CanTxQueue::Volatile, flags));
+    EXPECT_EQ(0, iomgr.send(frame, tsMono(9000000), tsMono(0), 3, CanTxQueue::Volatile, flags));  // Shared queue
+    status = iomgr.getIfaceTxQueueStatus(0);
+    EXPECT_EQ(2, status.num_pending_frames);
+#if UAVCAN_SHARED_TX_QUEUE
+    EXPECT_EQ(3, status.num_free_blocks);
+#else
+    EXPECT_EQ(2, status.num_free_blocks);
+#endif
+    EXPECT_EQ(uavcan::MonotonicDuration::getInfinite(), status.estimated_drain_time);
+    EXPECT_EQ(1, iomgr.getIfaceTxQueueStatus(1).num_pending_frames);
+
+    // Draining at one frame per millisecond
+    EXPECT_EQ(0, iomgr.send(frame, tsMono(9000000), tsMono(0), 1, CanTxQueue::Volatile, flags));
+    EXPECT_EQ(0, iomgr.send(frame, tsMono(9000000), tsMono(0), 1, CanTxQueue::Volatile, flags));
+    EXPECT_EQ(4, iomgr.getIfaceTxQueueStatus(0).num_pending_frames);
+    driver.ifaces.at(0).writeable = true;
+    uavcan::CanRxFrame rx_frame;
+    uavcan::CanIOFlags rx_flags = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        clockmock.advance(1000);
+        EXPECT_EQ(0, iomgr.receive(rx_frame, tsMono(0), rx_flags));
+    }
+    status = iomgr.getIfaceTxQueueStatus(0);
+    EXPECT_EQ(1, status.num_pending_frames);
+    EXPECT_EQ(uavcan::MonotonicDuration::fromMSec(1), status.estimated_drain_time);
+
+    // Idle time between bursts doesn't affect the estimate
+    clockmock.advance(1000);
+    EXPECT_EQ(0, iomgr.receive(rx_frame, tsMono(0), rx_flags));
+    EXPECT_EQ(0, iomgr.getIfaceTxQueueStatus(0).num_pending_frames);
+    clockmock.advance(1000000);
+    driver.ifaces.at(0).writeable = false;
+    EXPECT_EQ(0, iomgr.send(frame, tsMono(9000000), tsMono(0), 1, CanTxQueue::Volatile, flags));
+    EXPECT_EQ(0, iomgr.send(frame, tsMono(9000000), tsMono(0), 1, CanTxQueue::Volatile, flags));
+    driver.ifaces.at(0).writeable = true;
+    clockmock.advance(1000);
+    EXPECT_EQ(0, iomgr.receive(rx_frame, tsMono(0), rx_flags));
+    EXPECT_EQ(uavcan::MonotonicDuration::fromMSec(1), iomgr.getIfaceTxQueueStatus(0).estimated_drain_time);
+}
+
+TEST(CanIOManager, TxIfacePolicy)
+{
+    using uavcan::CanIOManager;
+    using uavcan::CanTxQueue;
+
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 16, uavcan::MemPoolBlockSize> pool;
+
+    SystemClockMock clockmock(1000000);
+    CanDriverMock driver(2, clockmock);
+
+    CanIOManager iomgr(driver, pool, clockmock, 4);
+
+    const uavcan::CanFrame frame = makeCanFrame(123, "a", EXT);
+    const uavcan::CanIOFlags flags = uavcan::CanIOFlags();
+
+    // Redundant by default
+    EXPECT_EQ(CanIOManager::TxIfacePolicyRedundant, iomgr.getTxIfacePolicy());
+    EXPECT_EQ(0xFF, iomgr.selectTxIfaces(0xFF));    // Unchanged
+    EXPECT_EQ(2, iomgr.selectTxIfaces(2));
+
+    iomgr.setTxIfacePolicy(CanIOManager::TxIfacePolicyLeastLoaded);
+    EXPECT_EQ(1, iomgr.selectTxIfaces(0xFF));       // Tie, the lowest index wins
+    EXPECT_EQ(2, iomgr.selectTxIfaces(2));
+
+    // Equal queues - the iface that has transmitted less wins
+    EXPECT_EQ(1, iomgr.send(frame, tsMono(9000000), tsMono(0), 1, CanTxQueue::Volatile, flags));
+    EXPECT_EQ(2, iomgr.selectTxIfaces(3));
+
+    // Shorter queue wins
+    driver.ifaces.at(1).writeable = false;
+    EXPECT_EQ(0, iomgr.send(frame, tsMono(9000000), tsMono(0), 2, CanTxQueue::Volatile, flags));
+    EXPECT_EQ(1, iomgr.selectTxIfaces(3));
+    EXPECT_EQ(2, iomgr.selectTxIfaces(2));
+}
+
+TEST(CanIOManager, DeadIface)
+{
+    using uavcan::CanIOManager;
+    using uavcan::CanTxQueue;
+
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 16, uavcan::MemPoolBlockSize> pool;
+
+    SystemClockMock clockmock(1000000);
+    CanDriverMock driver(2, clockmock);
+
+    CanIOManager iomgr(driver, pool, clockmock, 4);
+
+    const uavcan::CanFrame frame = makeCanFrame(123, "a", EXT);
+    const uavcan::CanIOFlags flags = uavcan::CanIOFlags();
+    uavcan::CanRxFrame rx_frame;
+    uavcan::CanIOFlags rx_flags = 0;
+
+    // Disabled by default
+    driver.ifaces.at(1).num_errors = 5;
+    clockmock.advance(10000000);
+    EXPECT_FALSE(iomgr.isIfaceDead(1));
+    EXPECT_EQ(3, iomgr.selectTxIfaces(3));
+
+    iomgr.setDeadIfaceTimeout(uavcan::MonotonicDuration::fromMSec(100));
+    EXPECT_FALSE(iomgr.isIfaceDead(1));
+
+    // Errors alone are not enough
+    driver.ifaces.at(1).num_errors++;
+    clockmock.advance(50000);
+    EXPECT_FALSE(iomgr.isIfaceDead(1));
+
+    // The timeout has expired
+    clockmock.advance(60000);
+    EXPECT_FALSE(iomgr.isIfaceDead(0));
+    EXPECT_TRUE(iomgr.isIfaceDead(1));
+    EXPECT_EQ(1, iomgr.selectTxIfaces(3));
+    EXPECT_EQ(2, iomgr.selectTxIfaces(2));         // There's no other choice
+
+    // All dead - sending to all of them
+    driver.ifaces.at(0).num_errors++;
+    EXPECT_TRUE(iomgr.isIfaceDead(0));
+    EXPECT_EQ(3, iomgr.selectTxIfaces(3));
+
+    // Reception revives the interface
+    driver.ifaces.at(1).pushRx(frame);
+    EXPECT_EQ(1, iomgr.receive(rx_frame, tsMono(0), rx_flags));
+    EXPECT_FALSE(iomgr.isIfaceDead(1));
+    EXPECT_EQ(2, iomgr.selectTxIfaces(3));
+
+    // So does transmission
+    EXPECT_EQ(1, iomgr.send(frame, tsMono(99000000), tsMono(0), 1, CanTxQueue::Volatile, flags));
+    EXPECT_FALSE(iomgr.isIfaceDead(0));
+    EXPECT_EQ(3, iomgr.selectTxIfaces(3));
+
+    // Least loaded among alive
+    iomgr.setTxIfacePolicy(CanIOManager::TxIfacePolicyLeastLoaded);
+    driver.ifaces.at(0).num_errors++;
+    clockmock.advance(200000);
+    EXPECT_TRUE(iomgr.isIfaceDead(0));
+    EXPECT_FALSE(iomgr.isIfaceDead(1));
+    EXPECT_EQ(2, iomgr.selectTxIfaces(3));
+
+    // Disabling
+    iomgr.setDeadIfaceTimeout(uavcan::MonotonicDuration());
+    EXPECT_FALSE(iomgr.isIfaceDead(0));
+}
+
+TEST(CanIOManager, DeadIfaceTxStall)
+{
+    using uavcan::CanIOManager;
+    using uavcan::CanTxQueue;
+
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 16, uavcan::MemPoolBlockSize> pool;
+
+    SystemClockMock clockmock(1000000);
+    CanDriverMock driver(2, clockmock);
+
+    CanIOManager iomgr(driver, pool, clockmock, 8);
+    iomgr.setDeadIfaceTimeout(uavcan::MonotonicDuration::fromMSec(100));
+
+    const uavcan::CanFrame frame = makeCanFrame(123, "a", EXT);
+    const uavcan::CanIOFlags flags = uavcan::CanIOFlags();
+
+    // The second iface can't transmit; the frames pile up in its queue
+    driver.ifaces.at(1).writeable = false;
+    for (int i = 0; i < 3; i++)
+    {
+        EXPECT_EQ(1, iomgr.send(frame, tsMono(99000000), tsMono(0), 3, CanTxQueue::Volatile, flags));
+    }
+    EXPECT_EQ(3, driver.ifaces.at(0).tx.size());
+    EXPECT_LT(0, pool.getNumUsedBlocks());
+
+    clockmock.advance(50000);
+    iomgr.cleanup(clockmock.getMonotonic());
+    EXPECT_FALSE(iomgr.isIfaceDead(1));
+    EXPECT_LT(0, pool.getNumUsedBlocks());
+
+    // No TX for longer than the timeout - the pending frames are discarded, the pool is freed
+    clockmock.advance(60000);
+    EXPECT_TRUE(iomgr.isIfaceDead(1));
+    EXPECT_FALSE(iomgr.isIfaceDead(0));
+    iomgr.cleanup(clockmock.getMonotonic());
+    EXPECT_EQ(0, pool.getNumUsedBlocks());
+    EXPECT_EQ(3, iomgr.getIfacePerfCounters(1).errors);
+    EXPECT_EQ(0, iomgr.getIfacePerfCounters(0).errors);
+
+    // Not queued on the dead iface anymore
+    EXPECT_EQ(1, iomgr.selectTxIfaces(3));
+    EXPECT_EQ(1, iomgr.send(frame, tsMono(99000000), tsMono(0), iomgr.selectTxIfaces(3), CanTxQueue::Volatile, flags));
+    EXPECT_EQ(0, pool.getNumUsedBlocks());
+
+    // Probed once per timeout
+    clockmock.advance(100000);
+    EXPECT_EQ(3, iomgr.selectTxIfaces(3));
+    EXPECT_EQ(1, iomgr.selectTxIfaces(3));
+    EXPECT_EQ(2, iomgr.selectTxIfaces(2));     // There's no other choice
+    clockmock.advance(50000);
+    EXPECT_EQ(1, iomgr.selectTxIfaces(3));
+
+    // The probe succeeds
+    driver.ifaces.at(1).writeable = true;
+    clockmock.advance(50000);
+    const uint8_t mask = iomgr.selectTxIfaces(3);
+    EXPECT_EQ(3, mask);
+    EXPECT_EQ(2, iomgr.send(frame, tsMono(99000000), tsMono(0), mask, CanTxQueue::Volatile, flags));
+    EXPECT_FALSE(iomgr.isIfaceDead(1));
+    EXPECT_EQ(3, iomgr.selectTxIfaces(3));
+}
+
+#if UAVCAN_SHARED_TX_QUEUE   // The quota computations below assume three queues
+
+TEST(CanIOManager, AdaptiveTxQuota)
+{
+    using uavcan::CanIOManager;
+    using uavcan::CanTxQueue;
+
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 64, uavcan::MemPoolBlockSize> pool;
+
+    SystemClockMock clockmock(1000000);
+    CanDriverMock driver(2, clockmock);
+
+    CanIOManager iomgr(driver, pool, clockmock, 4);     // Three queues, 12 blocks in total
+    EXPECT_FALSE(iomgr.isAdaptiveTxQuotaEnabled());
+
+    const uavcan::CanFrame low = makeCanFrame((20U << 24) | 123U, "a", EXT);
+    const uavcan::CanFrame high = makeCanFrame((2U << 24) | 123U, "b", EXT);
+    const uavcan::CanIOFlags flags = uavcan::CanIOFlags();
+    const uavcan::MonotonicTime deadline = tsMono(99000000);
+
+    driver.ifaces.at(0).writeable = false;
+    driver.ifaces.at(1).writeable = false;
+
+    // Fixed quota
+    for (int i = 0; i < 6; i++)
+    {
+        EXPECT_EQ(0, iomgr.send(low, deadline, tsMono(0), 2, CanTxQueue::Volatile, flags));
+    }
+    EXPECT_EQ(4, iomgr.getIfaceTxQueueStatus(1).num_pending_frames);
+
+    // Invalid configurations
+    EXPECT_EQ(-uavcan::ErrInvalidParam, iomgr.setAdaptiveTxQuota(0, 0, 4));
+    EXPECT_EQ(-uavcan::ErrInvalidParam, iomgr.setAdaptiveTxQuota(4, 1, 4));
+    EXPECT_FALSE(iomgr.isAdaptiveTxQuotaEnabled());
+
+    // 2 blocks guaranteed for every queue, 2 reserved, 4 can be borrowed by anyone
+    EXPECT_EQ(0, iomgr.setAdaptiveTxQuota(2, 2, 4));
+    EXPECT_TRUE(iomgr.isAdaptiveTxQuotaEnabled());
+    EXPECT_EQ(2, iomgr.getIfaceTxQueueStatus(1).num_free_blocks);
+
+    for (int i = 0; i < 3; i++)
+    {
+        EXPECT_EQ(0, iomgr.send(low, deadline, tsMono(0), 2, CanTxQueue::Volatile, flags));
+    }
+    EXPECT_EQ(6, iomgr.getIfaceTxQueueStatus(1).num_pending_frames);
+    EXPECT_EQ(0, iomgr.getIfaceTxQueueStatus(1).num_free_blocks);
+
+    // The other iface still has its guaranteed blocks
+    for (int i = 0; i < 3; i++)
+    {
+        EXPECT_EQ(0, iomgr.send(low, deadline, tsMono(0), 1, CanTxQueue::Volatile, flags));
+    }
+    EXPECT_EQ(2, iomgr.getIfaceTxQueueStatus(0).num_pending_frames);
+
+    // High priority frames use the reserve
+    for (int i = 0; i < 3; i++)
+    {
+        EXPECT_EQ(0, iomgr.send(high, deadline, tsMono(0), 2, CanTxQueue::Volatile, flags));
+    }
+    EXPECT_EQ(8, iomgr.getIfaceTxQueueStatus(1).num_pending_frames);     // The last one has replaced a low one
+    EXPECT_EQ(10, pool.getNumUsedBlocks());                             // The shared queue's blocks are unused
+
+    // The borrowed blocks are returned once the frames are transmitted
+    driver.ifaces.at(1).writeable = true;
+    uavcan::CanRxFrame rx_frame;
+    uavcan::CanIOFlags rx_flags = 0;
+    for (int i = 0; (i < 10) && (iomgr.getIfaceTxQueueStatus(1).num_pending_frames > 0); i++)
+    {
+        EXPECT_EQ(0, iomgr.receive(rx_frame, tsMono(0), rx_flags));
+    }
+    EXPECT_EQ(0, iomgr.getIfaceTxQueueStatus(1).num_pending_frames);
+    EXPECT_EQ(8, driver.ifaces.at(1).tx.size());
+    EXPECT_EQ(2, pool.getNumUsedBlocks());
+    EXPECT_EQ(4, iomgr.getIfaceTxQueueStatus(0).num_free_blocks);      // Could borrow 2 more for low priority
+
+    iomgr.disableAdaptiveTxQuota();
+    EXPECT_FALSE(iomgr.isAdaptiveTxQuotaEnabled());
+    EXPECT_EQ(2, iomgr.getIfaceTxQueueStatus(0).num_free_blocks);
+}
+
+#endif
+
+TEST(CanIOManager, RxPriorityOrder)
+{
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 16, uavcan::MemPoolBlockSize> pool;
+
+    SystemClockMock clockmock;
+    CanDriverMock driver(3, clockmock);
+    driver.ifaces.at(0).peekable = true;
+    driver.ifaces.at(1).peekable = true;    // The third one doesn't support peeking
+
+    uavcan::CanIOManager iomgr(driver, pool, clockmock);
+    EXPECT_FALSE(iomgr.isRxPriorityOrderEnabled());
+    iomgr.setRxPriorityOrderEnabled(true);
+
+    const uavcan::CanFrame low_a  = makeCanFrame(1000, "la", EXT);
+    const uavcan::CanFrame low_b  = makeCanFrame(900, "lb", EXT);
+    const uavcan::CanFrame high_a = makeCanFrame(10, "ha", EXT);
+    const uavcan::CanFrame high_b = makeCanFrame(20, "hb", EXT);
+    const uavcan::CanFrame top    = makeCanFrame(1, "t", EXT);
+
+    driver.ifaces.at(0).pushRx(low_a);
+    driver.ifaces.at(0).pushRx(low_b);
+    driver.ifaces.at(1).pushRx(high_a);
+    driver.ifaces.at(1).pushRx(high_b);
+    driver.ifaces.at(2).pushRx(top);
+
+    uavcan::CanRxFrame frames[8];
+    uavcan::CanIOFlags flags[8];
+
+    /*
+     * Arbitration order for the ifaces that support peeking, the order of the iface queues is preserved
+     */
+    ASSERT_EQ(3, iomgr.receiveBatch(frames, flags, 3, tsMono(0)));
+    EXPECT_TRUE(rxFrameEquals(frames[0], high_a, 0, 1));
+    EXPECT_TRUE(rxFrameEquals(frames[1], high_b, 0, 1));
+    EXPECT_TRUE(rxFrameEquals(frames[2], low_a, 0, 0));     // Not low_b, it's behind low_a in the iface queue
+
+    /*
+     * The rest, then the iface that doesn't support peeking
+     */
+    ASSERT_EQ(2, iomgr.receiveBatch(frames, flags, 8, tsMono(0)));
+    EXPECT_TRUE(rxFrameEquals(frames[0], low_b, 0, 0));
+    EXPECT_TRUE(rxFrameEquals(frames[1], top, 0, 2));
+    EXPECT_EQ(2, iomgr.getIfacePerfCounters(0).frames_rx);
+    EXPECT_EQ(2, iomgr.getIfacePerfCounters(1).frames_rx);
+    EXPECT_EQ(1, iomgr.getIfacePerfCounters(2).frames_rx);
+
+    /*
+     * Mixed with loopback
+     */
+    uavcan::CanIOFlags tx_flags = uavcan::CanIOFlagLoopback;
+    EXPECT_EQ(1, iomgr.send(low_a, tsMono(1000), tsMono(0), 2, uavcan::CanTxQueue::Volatile, tx_flags));
+    driver.ifaces.at(0).pushRx(high_b);
+    ASSERT_EQ(2, iomgr.receiveBatch(frames, flags, 8, tsMono(0)));
+    EXPECT_TRUE(rxFrameEquals(frames[0], high_b, 0, 0));
+    EXPECT_EQ(0, flags[0]);
+    EXPECT_TRUE(rxFrameEquals(frames[1], low_a, 0, 1));
+    EXPECT_EQ(uavcan::CanIOFlagLoopback, flags[1]);
+
+    /*
+     * Driver error on an iface that doesn't support peeking
+     */
+    driver.ifaces.at(1).peekable = false;
+    driver.ifaces.at(1).pushRx(top);
+    driver.ifaces.at(1).rx_failure = true;
+    EXPECT_GT(0, iomgr.receiveBatch(frames, flags, 8, tsMono(0)));
+    driver.ifaces.at(1).rx_failure = false;
+    ASSERT_EQ(1, iomgr.receiveBatch(frames, flags, 8, tsMono(0)));
+    EXPECT_TRUE(rxFrameEquals(frames[0], top, 0, 1));
+}
+
+TEST(CanIOManager, ClockReadsPerIteration)
+{
+    using uavcan::CanIOManager;
+    using uavcan::CanTxQueue;
+
+    struct CountingClock : public uavcan::ISystemClock
+    {
+        const SystemClockMock& clock;
+        mutable unsigned num_reads;
+
+        explicit CountingClock(const SystemClockMock& arg_clock) : clock(arg_clock), num_reads(0) { }
+
+        virtual uavcan::MonotonicTime getMonotonic() const { num_reads++; return clock.getMonotonic(); }
+        virtual uavcan::UtcTime getUtc() const { return clock.getUtc(); }
+        virtual void adjustUtc(uavcan::UtcDuration) { }
+    };
+
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 16, uavcan::MemPoolBlockSize> pool;
+
+    SystemClockMock clockmock(1000000);
+    CanDriverMock driver(2, clockmock);     // The driver has its own clock
+    CountingClock clock(clockmock);
+
+    CanIOManager iomgr(driver, pool, clock);
+
+    const uavcan::CanFrame frame = makeCanFrame(123, "a", EXT);
+    const uavcan::CanIOFlags flags = uavcan::CanIOFlags();
+
+    /*
+     * Send
+     */
+    driver.ifaces.at(0).writeable = false;
+    driver.ifaces.at(1).writeable = false;
+    clock.num_reads = 0;
+    EXPECT_EQ(0, iomgr.send(frame, tsMono(99000000), tsMono(0), 3, CanTxQueue::Volatile, flags));
+    EXPECT_LE(clock.num_reads, 2);
+    EXPECT_EQ(2, iomgr.getIfaceTxQueueStatus(0).num_pending_frames + iomgr.getIfaceTxQueueStatus(1).num_pending_frames);
+
+    /*
+     * Receive, transmitting from the queues at the same time
+     */
+    driver.ifaces.at(0).writeable = true;
+    driver.ifaces.at(1).writeable = true;
+    driver.ifaces.at(1).pushRx(makeCanFrame(456, "b", EXT));
+    uavcan::CanRxFrame rx_frame;
+    uavcan::CanIOFlags rx_flags = uavcan::CanIOFlags();
+    clock.num_reads = 0;
+    EXPECT_EQ(1, iomgr.receive(rx_frame, tsMono(0), rx_flags));
+    EXPECT_LE(clock.num_reads, 1);
+    EXPECT_EQ(1, driver.ifaces.at(0).tx.size());
+    EXPECT_EQ(1, driver.ifaces.at(1).tx.size());
+
+    /*
+     * Outside of the IO calls the time is not cached
+     */
+    iomgr.setDeadIfaceTimeout(uavcan::MonotonicDuration::fromMSec(100));
+    clock.num_reads = 0;
+    (void)iomgr.isIfaceDead(0);
+    (void)iomgr.isIfaceDead(1);
+    EXPECT_EQ(2, clock.num_reads);
+}
+
+TEST(CanIOManager, TxBatch)
+{
+    using uavcan::CanIOManager;
+    using uavcan::CanTxQueue;
+
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 16, uavcan::MemPoolBlockSize> pool;
+
+    SystemClockMock clockmock(1000000);
+    CanDriverMock driver(1, clockmock);
+
+    CanIOManager iomgr(driver, pool, clockmock);
+
+    const uavcan::CanIOFlags flags = uavcan::CanIOFlags();
+    std::vector<uavcan::CanFrame> frames;
+    for (uint32_t i = 0; i < 6; i++)
+    {
+        frames.push_back(makeCanFrame(200 + i, "a", EXT));
+    }
+
+    driver.ifaces.at(0).writeable = false;
+    for (unsigned i = 0; i < frames.size(); i++)
+    {
+        EXPECT_EQ(0, iomgr.send(frames[i], tsMono(99000000), tsMono(0), 1, CanTxQueue::Volatile, flags));
+    }
+    EXPECT_EQ(6, iomgr.getIfaceTxQueueStatus(0).num_pending_frames);
+    driver.ifaces.at(0).writeable = true;
+
+    uavcan::CanRxFrame rx_frame;
+    uavcan::CanIOFlags rx_flags = uavcan::CanIOFlags();
+
+    // The driver has no queue of its own - one frame per select() call
+    EXPECT_EQ(0, iomgr.receive(rx_frame, tsMono(0), rx_flags));
+    EXPECT_EQ(1, driver.ifaces.at(0).tx.size());
+
+    // The driver can take two more frames at once
+    driver.ifaces.at(0).num_free_tx_slots = 2;
+    EXPECT_EQ(0, iomgr.receive(rx_frame, tsMono(0), rx_flags));
+    EXPECT_EQ(4, driver.ifaces.at(0).tx.size());
+    EXPECT_EQ(2, iomgr.getIfaceTxQueueStatus(0).num_pending_frames);
+
+    // The new frame goes first, then the rest of the queue
+    driver.ifaces.at(0).num_free_tx_slots = 10;
+    const uavcan::CanFrame urgent = makeCanFrame(100, "b", EXT);
+    EXPECT_EQ(3, iomgr.send(urgent, tsMono(99000000), tsMono(0), 1, CanTxQueue::Volatile, flags));
+    EXPECT_EQ(0, iomgr.getIfaceTxQueueStatus(0).num_pending_frames);
+    EXPECT_EQ(0, pool.getNumUsedBlocks());
+
+    for (unsigned i = 0; i < 4; i++)
+    {
+        EXPECT_TRUE(driver.ifaces.at(0).matchAndPopTx(frames[i], 99000000));
+    }
+    EXPECT_TRUE(driver.ifaces.at(0).matchAndPopTx(urgent, 99000000));
+    EXPECT_TRUE(driver.ifaces.at(0).matchAndPopTx(frames[4], 99000000));
+    EXPECT_TRUE(driver.ifaces.at(0).matchAndPopTx(frames[5], 99000000));
+    EXPECT_TRUE(driver.ifaces.at(0).tx.empty());
+    EXPECT_EQ(7, iomgr.getIfacePerfCounters(0).frames_tx);
+}
+
+TEST(CanIOManager, SendBatch)
+{
+    using uavcan::CanIOManager;
+    using uavcan::CanTxQueue;
+
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 16, uavcan::MemPoolBlockSize> pool;
+
+    SystemClockMock clockmock(1000000);
+    CanDriverMock driver(2, clockmock);
+
+    CanIOManager iomgr(driver, pool, clockmock);
+
+    const uavcan::CanIOFlags flags = uavcan::CanIOFlags();
+    uavcan::CanFrame frames[5];
+    for (unsigned i = 0; i < 5; i++)
+    {
+        frames[i] = makeCanFrame(200, "", EXT);
+        frames[i].data[0] = uavcan::uint8_t(i);
+        frames[i].dlc = 1;
+    }
+
+    /*
+     * The first iface takes the whole batch at once, the second one can't queue anything.
+     * Either way, every frame is given its chance even though the blocking deadline is already in the past.
+     */
+    driver.ifaces.at(0).num_free_tx_slots = 10;
+    EXPECT_EQ(10, iomgr.sendBatch(frames, 5, tsMono(99000000), tsMono(0), 3, CanTxQueue::Volatile, flags));
+    EXPECT_EQ(0, pool.getNumUsedBlocks());
+    for (unsigned i = 0; i < 5; i++)
+    {
+        EXPECT_TRUE(driver.ifaces.at(0).matchAndPopTx(frames[i], 99000000));
+        EXPECT_TRUE(driver.ifaces.at(1).matchAndPopTx(frames[i], 99000000));
+    }
+
+    /*
+     * The second iface is not writeable - the batch is queued for it in one piece
+     */
+    driver.ifaces.at(0).num_free_tx_slots = 1;
+    driver.ifaces.at(1).writeable = false;
+    EXPECT_EQ(5, iomgr.sendBatch(frames, 5, tsMono(99000000), tsMono(0), 3, CanTxQueue::Volatile, flags));
+    EXPECT_EQ(0, iomgr.getIfaceTxQueueStatus(0).num_pending_frames);
+    EXPECT_EQ(5, iomgr.getIfaceTxQueueStatus(1).num_pending_frames);
+    for (unsigned i = 0; i < 5; i++)
+    {
+        EXPECT_TRUE(driver.ifaces.at(0).matchAndPopTx(frames[i], 99000000));
+    }
+    EXPECT_TRUE(driver.ifaces.at(0).tx.empty());
+
+    /*
+     * Nothing is writeable; the frames of the batch go after the queued frames of the same priority
+     */
+    driver.ifaces.at(0).writeable = false;
+    const uavcan::CanFrame single = makeCanFrame(200, "single", EXT);
+    EXPECT_EQ(0, iomgr.send(single, tsMono(99000000), tsMono(0), 1, CanTxQueue::Volatile, flags));
+    EXPECT_EQ(0, iomgr.sendBatch(frames, 3, tsMono(99000000), tsMono(0), 1, CanTxQueue::Volatile, flags));
+    EXPECT_EQ(4, iomgr.getIfaceTxQueueStatus(0).num_pending_frames);
+
+    driver.ifaces.at(0).writeable = true;
+    driver.ifaces.at(1).writeable = true;
+    driver.ifaces.at(0).num_free_tx_slots = 10;
+    driver.ifaces.at(1).num_free_tx_slots = 10;
+    uavcan::CanRxFrame rx_frame;
+    uavcan::CanIOFlags rx_flags = uavcan::CanIOFlags();
+    EXPECT_EQ(0, iomgr.receive(rx_frame, tsMono(0), rx_flags));
+    EXPECT_EQ(0, pool.getNumUsedBlocks());
+
+    EXPECT_TRUE(driver.ifaces.at(0).matchAndPopTx(single, 99000000));
+    for (unsigned i = 0; i < 5; i++)
+    {
+        if (i < 3)
+        {
+            EXPECT_TRUE(driver.ifaces.at(0).matchAndPopTx(frames[i], 99000000));
+        }
+        EXPECT_TRUE(driver.ifaces.at(1).matchAndPopTx(frames[i], 99000000));
+    }
+    EXPECT_TRUE(driver.ifaces.at(0).tx.empty());
+    EXPECT_TRUE(driver.ifaces.at(1).tx.empty());
+    EXPECT_EQ(14, iomgr.getIfacePerfCounters(0).frames_tx);
+    EXPECT_EQ(10, iomgr.getIfacePerfCounters(1).frames_tx);
+
+    // Expired batch is not transmitted at all
+    EXPECT_EQ(0, iomgr.sendBatch(frames, 5, tsMono(1000), tsMono(0), 3, CanTxQueue::Volatile, flags));
+    EXPECT_TRUE(driver.ifaces.at(0).tx.empty());
+    EXPECT_EQ(0, pool.getNumUsedBlocks());
+}
+
 TEST(CanIOManager, Size)
 {
     std::cout << sizeof(uavcan::CanIOManager) << std::endl;
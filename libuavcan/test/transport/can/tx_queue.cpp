@@ -2,6 +2,7 @@
  * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
  */
 
+#include <cstdlib>
 #include <gtest/gtest.h>
 #include <uavcan/transport/can_io.hpp>
 #include "can.hpp"
@@ -65,9 +66,12 @@ TEST(CanTxQueue, TxQueue)
     using uavcan::CanTxQueue;
     using uavcan::CanFrame;
 
-    ASSERT_GE(40, sizeof(CanTxQueue::Entry)); // should be true for any platforms, though not required
+#if !UAVCAN_LATENCY_STATS && !UAVCAN_TX_QUEUE_AGING
+    // should be true for any platforms, though not required; the back link is added only if it fits the pool block
+    ASSERT_GE(40 + (CanTxQueue::DoublyLinkedEntries ? sizeof(void*) : 0), sizeof(CanTxQueue::Entry));
+#endif
 
-    uavcan::PoolAllocator<40 * 4, 40> pool;
+    uavcan::PoolAllocator<sizeof(CanTxQueue::Entry) * 4, sizeof(CanTxQueue::Entry)> pool;
 
     SystemClockMock clockmock;
 
@@ -214,3 +218,446 @@ TEST(CanTxQueue, TxQueue)
     EXPECT_FALSE(queue.peek());
     EXPECT_FALSE(queue.topPriorityHigherOrEqual(f0));
 }
+
+TEST(CanTxQueue, TreapMode)
+{
+    using uavcan::CanTxQueue;
+    using uavcan::CanFrame;
+
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 4, uavcan::MemPoolBlockSize> pool;
+
+    SystemClockMock clockmock;
+
+    CanTxQueue queue(pool, clockmock, 99999, CanTxQueue::ModeTreap);
+    EXPECT_EQ(CanTxQueue::ModeTreap, queue.getMode());
+    EXPECT_TRUE(queue.isEmpty());
+    EXPECT_FALSE(queue.peek());
+    EXPECT_FALSE(queue.getTopPriorityPendingFrame());
+
+    const uavcan::CanIOFlags flags = 0;
+
+    const CanFrame f0 = makeCanFrame(0, "f0", EXT);
+    const CanFrame f1 = makeCanFrame(10, "f1", EXT);
+    const CanFrame f2 = makeCanFrame(20, "f2", EXT);
+    const CanFrame f3 = makeCanFrame(100, "f3", EXT);
+    const CanFrame f4 = makeCanFrame(10000, "f4", EXT);
+    const CanFrame f5 = makeCanFrame(99999, "f5", EXT);
+    const CanFrame f5a = makeCanFrame(99999, "f5a", EXT);
+    const CanFrame f6 = makeCanFrame(999999, "f6", EXT);
+
+    /*
+     * Priority insertion
+     */
+    queue.push(f4, tsMono(100), CanTxQueue::Persistent, flags);
+    EXPECT_FALSE(queue.isEmpty());
+    EXPECT_EQ(f4, queue.peek()->frame);
+    EXPECT_EQ(-uavcan::ErrLogic, queue.setMode(CanTxQueue::ModeLinkedList));     // Not empty
+    EXPECT_TRUE(queue.topPriorityHigherOrEqual(f5));
+    EXPECT_TRUE(queue.topPriorityHigherOrEqual(f4));
+    EXPECT_FALSE(queue.topPriorityHigherOrEqual(f3));
+
+    queue.push(f3, tsMono(200), CanTxQueue::Persistent, flags);
+    EXPECT_EQ(f3, queue.peek()->frame);
+
+    queue.push(f0, tsMono(300), CanTxQueue::Volatile, flags);
+    EXPECT_EQ(f0, queue.peek()->frame);
+    EXPECT_EQ(f0, *queue.getTopPriorityPendingFrame());
+
+    queue.push(f1, tsMono(400), CanTxQueue::Volatile, flags);
+    EXPECT_EQ(f0, queue.peek()->frame);
+    EXPECT_EQ(4, pool.getNumUsedBlocks());
+
+    // Out of free memory now
+
+    /*
+     * QoS
+     */
+    queue.push(f2, tsMono(100), CanTxQueue::Volatile, flags);     // Non preempting, will be rejected
+    EXPECT_EQ(1, queue.getRejectedFrameCount());
+
+    queue.push(f2, tsMono(500), CanTxQueue::Persistent, flags);   // Will override f1 (f3 and f4 are presistent)
+    EXPECT_EQ(2, queue.getRejectedFrameCount());
+    EXPECT_EQ(f0, queue.peek()->frame);
+
+    queue.push(f5, tsMono(600), CanTxQueue::Persistent, flags);   // Will override f0 (rest are presistent)
+    EXPECT_EQ(f2, queue.peek()->frame);
+
+    queue.push(f5a, tsMono(700), CanTxQueue::Persistent, flags);  // Will override f5 (same frame, same QoS)
+    queue.push(f6, tsMono(700), CanTxQueue::Persistent, flags);   // Will be rejected (lowest QoS)
+    EXPECT_EQ(5, queue.getRejectedFrameCount());
+    EXPECT_EQ(4, pool.getNumUsedBlocks());
+
+    /*
+     * Expiration
+     */
+    clockmock.monotonic = 101;
+    queue.push(f0, tsMono(800), CanTxQueue::Volatile, flags);     // Will replace f4 which is expired now
+    EXPECT_EQ(6, queue.getRejectedFrameCount());
+
+    // Expected order: f0, f2, f3, f5a
+    const CanFrame expected[] = { f0, f2, f3, f5a };
+    for (unsigned i = 0; i < sizeof(expected) / sizeof(expected[0]); i++)
+    {
+        CanTxQueue::Entry* entry = queue.peek();
+        ASSERT_TRUE(entry);
+        EXPECT_EQ(expected[i], entry->frame);
+        queue.remove(entry);
+        EXPECT_FALSE(entry);
+    }
+    EXPECT_TRUE(queue.isEmpty());
+    EXPECT_EQ(0, pool.getNumUsedBlocks());
+
+    /*
+     * FIFO among equal priority frames; expired frames are dropped on peek
+     */
+    queue.push(f5, tsMono(2000), CanTxQueue::Volatile, flags);
+    queue.push(f5a, tsMono(2000), CanTxQueue::Persistent, flags);
+    queue.push(f1, tsMono(1000), CanTxQueue::Volatile, flags);
+    clockmock.monotonic = 1001;
+    EXPECT_EQ(f5, queue.peek()->frame);                               // f1 has expired
+    EXPECT_EQ(7, queue.getRejectedFrameCount());
+    CanTxQueue::Entry* entry = queue.peek();
+    queue.remove(entry);
+    EXPECT_EQ(f5a, queue.peek()->frame);
+
+    // Destruction releases the memory
+    EXPECT_EQ(1, pool.getNumUsedBlocks());
+    queue.~CanTxQueue();
+    EXPECT_EQ(0, pool.getNumUsedBlocks());
+}
+
+TEST(CanTxQueue, TreapModeMatchesLinkedList)
+{
+    using uavcan::CanTxQueue;
+
+    static const unsigned NumFrames = 500;
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * NumFrames * 2, uavcan::MemPoolBlockSize> pool;
+
+    SystemClockMock clockmock;
+
+    CanTxQueue list_queue(pool, clockmock, 99999, CanTxQueue::ModeLinkedList);
+    CanTxQueue treap_queue(pool, clockmock, 99999);
+    ASSERT_EQ(0, treap_queue.setMode(CanTxQueue::ModeTreap));
+
+    std::srand(42);
+    for (unsigned i = 0; i < NumFrames; i++)
+    {
+        // Narrow ID range in order to get plenty of frames with equal priority
+        const uavcan::CanFrame frame = makeCanFrame(uint32_t(std::rand() % 32),
+                                                    std::string(1, char('a' + (i % 26))), EXT);
+        const CanTxQueue::Qos qos = (std::rand() % 2) ? CanTxQueue::Volatile : CanTxQueue::Persistent;
+        list_queue.push(frame, tsMono(1000), qos, 0);
+        treap_queue.push(frame, tsMono(1000), qos, 0);
+
+        // Interleaving pops with pushes
+        if ((std::rand() % 3) == 0)
+        {
+            CanTxQueue::Entry* list_entry = list_queue.peek();
+            CanTxQueue::Entry* treap_entry = treap_queue.peek();
+            ASSERT_TRUE(list_entry);
+            ASSERT_TRUE(treap_entry);
+            ASSERT_EQ(list_entry->frame, treap_entry->frame);
+            list_queue.remove(list_entry);
+            treap_queue.remove(treap_entry);
+        }
+    }
+
+    while (!list_queue.isEmpty())
+    {
+        CanTxQueue::Entry* list_entry = list_queue.peek();
+        CanTxQueue::Entry* treap_entry = treap_queue.peek();
+        ASSERT_TRUE(list_entry);
+        ASSERT_TRUE(treap_entry);
+        ASSERT_EQ(list_entry->frame, treap_entry->frame);
+        list_queue.remove(list_entry);
+        treap_queue.remove(treap_entry);
+    }
+    EXPECT_TRUE(treap_queue.isEmpty());
+    EXPECT_EQ(0, pool.getNumUsedBlocks());
+}
+
+TEST(CanTxQueue, PurgeExpired)
+{
+    using uavcan::CanTxQueue;
+
+    for (int mode = CanTxQueue::ModeLinkedList; mode <= CanTxQueue::ModeTreap; mode++)
+    {
+        uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 8, uavcan::MemPoolBlockSize> pool;
+        SystemClockMock clockmock;
+        CanTxQueue queue(pool, clockmock, 99999, CanTxQueue::Mode(mode));
+
+        queue.purgeExpired(tsMono(1000));                               // Empty queue, nothing to do
+        EXPECT_EQ(0, queue.getRejectedFrameCount());
+
+        queue.push(makeCanFrame(3, "a", EXT), tsMono(300), CanTxQueue::Volatile, 0);
+        queue.push(makeCanFrame(1, "b", EXT), tsMono(100), CanTxQueue::Persistent, 0);
+        queue.push(makeCanFrame(2, "c", EXT), tsMono(200), CanTxQueue::Volatile, 0);
+        queue.push(makeCanFrame(4, "d", EXT), tsMono(100), CanTxQueue::Volatile, 0);
+        EXPECT_EQ(4, pool.getNumUsedBlocks());
+
+        queue.purgeExpired(tsMono(100));                                // Deadline is inclusive
+        EXPECT_EQ(4, pool.getNumUsedBlocks());
+        EXPECT_EQ(0, queue.getRejectedFrameCount());
+
+        queue.purgeExpired(tsMono(101));
+        EXPECT_EQ(2, pool.getNumUsedBlocks());
+        EXPECT_EQ(2, queue.getRejectedFrameCount());
+        EXPECT_EQ(makeCanFrame(2, "c", EXT), *queue.getTopPriorityPendingFrame());
+
+        queue.purgeExpired(tsMono(150));                                // Earliest deadline is 200 now
+        EXPECT_EQ(2, pool.getNumUsedBlocks());
+
+        queue.purgeExpired(tsMono(1000));
+        EXPECT_EQ(0, pool.getNumUsedBlocks());
+        EXPECT_EQ(4, queue.getRejectedFrameCount());
+        EXPECT_TRUE(queue.isEmpty());
+    }
+}
+
+TEST(CanTxQueue, ReplacePending)
+{
+    using uavcan::CanTxQueue;
+    using uavcan::CanFrame;
+
+    const uavcan::CanIOFlags replace = uavcan::CanIOFlagReplacePending;
+
+    // Priority 16 and 8, data type 341, source node 10; the last byte is the tail byte
+    const uavcan::uint32_t id_a    = (16U << 24) | (341U << 8) | 10U;
+    const uavcan::uint32_t id_a_hi = (8U << 24) | (341U << 8) | 10U;
+    const uavcan::uint32_t id_b    = (16U << 24) | (342U << 8) | 10U;
+    const uavcan::uint32_t id_c    = (16U << 24) | (341U << 8) | 11U;
+
+    for (int mode = CanTxQueue::ModeLinkedList; mode <= CanTxQueue::ModeTreap; mode++)
+    {
+        uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 8, uavcan::MemPoolBlockSize> pool;
+        SystemClockMock clockmock;
+        CanTxQueue queue(pool, clockmock, 99999, CanTxQueue::Mode(mode));
+
+        queue.push(makeCanFrame(id_a, "a\xC0", EXT), tsMono(1000), CanTxQueue::Volatile, replace);
+        queue.push(makeCanFrame(id_a, "b\xC1", EXT), tsMono(1000), CanTxQueue::Volatile, replace);
+        EXPECT_EQ(1, pool.getNumUsedBlocks());
+        EXPECT_EQ(1, queue.getReplacedFrameCount());
+        EXPECT_EQ(makeCanFrame(id_a, "b\xC1", EXT), *queue.getTopPriorityPendingFrame());
+
+        // Priority is disregarded; QoS class too
+        queue.push(makeCanFrame(id_a_hi, "c\xC2", EXT), tsMono(1000), CanTxQueue::Persistent, replace);
+        EXPECT_EQ(1, pool.getNumUsedBlocks());
+        EXPECT_EQ(2, queue.getReplacedFrameCount());
+        EXPECT_EQ(makeCanFrame(id_a_hi, "c\xC2", EXT), *queue.getTopPriorityPendingFrame());
+
+        // Different data type, different source, multi-frame transfer - not replaced
+        queue.push(makeCanFrame(id_b, "d\xC0", EXT), tsMono(1000), CanTxQueue::Volatile, replace);
+        queue.push(makeCanFrame(id_c, "e\xC0", EXT), tsMono(1000), CanTxQueue::Volatile, replace);
+        queue.push(makeCanFrame(id_a, "1234567\x83", EXT), tsMono(1000), CanTxQueue::Volatile, replace);
+        EXPECT_EQ(4, pool.getNumUsedBlocks());
+        EXPECT_EQ(2, queue.getReplacedFrameCount());
+
+        // Without the flag the frame neither replaces nor gets replaced
+        queue.push(makeCanFrame(id_a, "f\xC3", EXT), tsMono(1000), CanTxQueue::Volatile, 0);
+        EXPECT_EQ(5, pool.getNumUsedBlocks());
+        EXPECT_EQ(2, queue.getReplacedFrameCount());
+
+        queue.push(makeCanFrame(id_a, "g\xC4", EXT), tsMono(1000), CanTxQueue::Volatile, replace);
+        EXPECT_EQ(5, pool.getNumUsedBlocks());
+        EXPECT_EQ(3, queue.getReplacedFrameCount());
+
+        // Expected contents in the order of priority
+        const CanFrame expected[] =
+        {
+            makeCanFrame(id_a, "1234567\x83", EXT),
+            makeCanFrame(id_a, "f\xC3", EXT),
+            makeCanFrame(id_a, "g\xC4", EXT),
+            makeCanFrame(id_c, "e\xC0", EXT),
+            makeCanFrame(id_b, "d\xC0", EXT)
+        };
+        for (unsigned i = 0; i < sizeof(expected) / sizeof(expected[0]); i++)
+        {
+            CanTxQueue::Entry* entry = queue.peek();
+            ASSERT_TRUE(entry);
+            EXPECT_EQ(expected[i], entry->frame);
+            queue.remove(entry);
+        }
+        EXPECT_TRUE(queue.isEmpty());
+        EXPECT_EQ(0, pool.getNumUsedBlocks());
+    }
+}
+
+TEST(CanTxQueue, PushBatch)
+{
+    using uavcan::CanTxQueue;
+    using uavcan::CanFrame;
+
+    const uavcan::CanIOFlags flags = 0;
+
+    const CanFrame hi = makeCanFrame(100, "hi", EXT);
+    const CanFrame lo = makeCanFrame(300, "lo", EXT);
+    const CanFrame same = makeCanFrame(200, "x", EXT);
+    CanFrame batch[5];
+    for (unsigned i = 0; i < 5; i++)
+    {
+        batch[i] = makeCanFrame(200, "", EXT);
+        batch[i].data[0] = uavcan::uint8_t(i);
+        batch[i].dlc = 1;
+    }
+
+    for (int mode = CanTxQueue::ModeLinkedList; mode <= CanTxQueue::ModeTreap; mode++)
+    {
+        uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 7, uavcan::MemPoolBlockSize> pool;
+        SystemClockMock clockmock(100);
+        CanTxQueue queue(pool, clockmock, 99999, CanTxQueue::Mode(mode));
+
+        queue.push(lo, tsMono(1000), CanTxQueue::Volatile, flags);
+        queue.push(same, tsMono(1000), CanTxQueue::Volatile, flags);
+        queue.push(hi, tsMono(1000), CanTxQueue::Volatile, flags);
+
+        // The batch keeps its order and goes after the frames of the same priority;
+        // the pool runs out on the last frame, which then displaces the lowest priority frame as usual
+        queue.pushBatch(batch, 5, tsMono(1000), CanTxQueue::Volatile, flags);
+        EXPECT_EQ(7, pool.getNumUsedBlocks());
+        EXPECT_EQ(1, queue.getRejectedFrameCount());
+
+        const CanFrame expected[] = { hi, same, batch[0], batch[1], batch[2], batch[3], batch[4] };
+        for (unsigned i = 0; i < sizeof(expected) / sizeof(expected[0]); i++)
+        {
+            CanTxQueue::Entry* entry = queue.peek();
+            ASSERT_TRUE(entry);
+            EXPECT_EQ(expected[i], entry->frame);
+            queue.remove(entry);
+        }
+        EXPECT_TRUE(queue.isEmpty());
+
+        // Expired batch is rejected as a whole
+        queue.pushBatch(batch, 5, tsMono(100), CanTxQueue::Volatile, flags);
+        EXPECT_TRUE(queue.isEmpty());
+        EXPECT_EQ(6, queue.getRejectedFrameCount());
+        EXPECT_EQ(0, pool.getNumUsedBlocks());
+    }
+}
+
+#if UAVCAN_TX_QUEUE_AGING
+TEST(CanTxQueue, Aging)
+{
+    using uavcan::CanTxQueue;
+    using uavcan::CanFrame;
+
+    for (int mode = CanTxQueue::ModeLinkedList; mode <= CanTxQueue::ModeTreap; mode++)
+    {
+        uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 16, uavcan::MemPoolBlockSize> pool;
+        SystemClockMock clockmock(1000);
+        CanTxQueue queue(pool, clockmock, 99999, CanTxQueue::Mode(mode));
+
+        EXPECT_EQ(-uavcan::ErrInvalidParam, queue.setAgingPercent(101));
+        EXPECT_EQ(0, queue.getAgingPercent());
+        ASSERT_EQ(0, queue.setAgingPercent(50));
+
+        const CanFrame low = makeCanFrame(1000, "low", EXT);
+        const CanFrame high1 = makeCanFrame(10, "high1", EXT);
+        const CanFrame high2 = makeCanFrame(20, "high2", EXT);
+
+        queue.push(low, tsMono(2000), CanTxQueue::Volatile, 0);         // Promoted at 1500
+        queue.push(high1, tsMono(11000), CanTxQueue::Volatile, 0);      // Promoted at 6000
+        clockmock.advance(100);
+        queue.push(high2, tsMono(11100), CanTxQueue::Persistent, 0);    // Promoted at 6100
+
+        EXPECT_EQ(high1, queue.peek()->frame);
+        clockmock.advance(399);
+        EXPECT_EQ(high1, queue.peek()->frame);
+        EXPECT_EQ(0, queue.getNumPromotedFrames());
+
+        // The low priority frame goes first now, but the CAN ID doesn't change
+        clockmock.advance(1);
+        EXPECT_EQ(low, queue.peek()->frame);
+        EXPECT_EQ(1, queue.getNumPromotedFrames());
+        EXPECT_EQ(high1, *queue.getTopPriorityPendingFrame());
+        EXPECT_TRUE(queue.topPriorityHigherOrEqual(makeCanFrame(15, "", EXT)));
+        EXPECT_FALSE(queue.topPriorityHigherOrEqual(makeCanFrame(5, "", EXT)));
+
+        // Newer frames don't go ahead of the promoted one, regardless of the priority
+        const CanFrame high0 = makeCanFrame(5, "high0", EXT);
+        queue.push(high0, tsMono(100000), CanTxQueue::Persistent, 0);
+        EXPECT_EQ(low, queue.peek()->frame);
+        EXPECT_EQ(high0, *queue.getTopPriorityPendingFrame());
+
+        CanTxQueue::Entry* entry = queue.peek();
+        queue.remove(entry);
+        EXPECT_EQ(0, queue.getNumPromotedFrames());
+        EXPECT_EQ(high0, queue.peek()->frame);
+
+        // The promoted frames are transmitted in the order of promotion, not in the order of priority
+        const CanFrame low1 = makeCanFrame(3000, "low1", EXT);
+        const CanFrame low2 = makeCanFrame(2000, "low2", EXT);
+        queue.push(low1, tsMono(1600), CanTxQueue::Volatile, 0);        // Promoted at 1550
+        queue.push(low2, tsMono(1700), CanTxQueue::Volatile, 0);        // Promoted at 1600
+        clockmock.advance(50);                                          // 1550
+        EXPECT_EQ(low1, queue.peek()->frame);
+        clockmock.advance(50);                                          // 1600
+        queue.purgeExpired(clockmock.getMonotonic());
+        EXPECT_EQ(2, queue.getNumPromotedFrames());
+        EXPECT_EQ(low1, queue.peek()->frame);
+
+        // A promoted frame that has expired anyway is counted as starved
+        clockmock.advance(1);
+        EXPECT_EQ(low2, queue.peek()->frame);
+        EXPECT_EQ(1, queue.getNumPromotedFrames());
+        EXPECT_EQ(1, queue.getRejectedFrameCount());
+
+        entry = queue.peek();
+        queue.remove(entry);
+        EXPECT_EQ(high0, queue.peek()->frame);
+        entry = queue.peek();
+        queue.remove(entry);
+        EXPECT_EQ(high1, queue.peek()->frame);
+        entry = queue.peek();
+        queue.remove(entry);
+        EXPECT_EQ(high2, queue.peek()->frame);
+        entry = queue.peek();
+        queue.remove(entry);
+        EXPECT_TRUE(queue.isEmpty());
+
+        const CanTxQueue::AgingStats& stats = queue.getAgingStats();
+        EXPECT_EQ(3, stats.num_promoted);
+        EXPECT_EQ(1, stats.num_expired_after_promotion);
+        EXPECT_EQ(2, stats.max_num_promoted);
+        EXPECT_EQ(0, pool.getNumUsedBlocks());
+    }
+}
+
+TEST(CanTxQueue, AgingKeepsTransferOrder)
+{
+    using uavcan::CanTxQueue;
+    using uavcan::CanFrame;
+
+    for (int mode = CanTxQueue::ModeLinkedList; mode <= CanTxQueue::ModeTreap; mode++)
+    {
+        uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 32, uavcan::MemPoolBlockSize> pool;
+        SystemClockMock clockmock(1000);
+        CanTxQueue queue(pool, clockmock, 99999, CanTxQueue::Mode(mode));
+        ASSERT_EQ(0, queue.setAgingPercent(10));
+
+        // More frames of one transfer than the treap promotes at once, interleaved in time with other traffic
+        CanFrame transfer[12];
+        for (unsigned i = 0; i < 12; i++)
+        {
+            transfer[i] = makeCanFrame(5000, "x", EXT);
+            transfer[i].data[0] = uavcan::uint8_t(i);
+        }
+        queue.pushBatch(transfer, 12, tsMono(11000), CanTxQueue::Volatile, 0);
+        for (unsigned i = 0; i < 4; i++)
+        {
+            queue.push(makeCanFrame(10 + i, "", EXT), tsMono(100000), CanTxQueue::Volatile, 0);
+        }
+
+        clockmock.advance(1000);
+        (void)queue.peek();
+        EXPECT_EQ(12, queue.getNumPromotedFrames());
+        for (unsigned i = 0; i < 12; i++)
+        {
+            CanTxQueue::Entry* entry = queue.peek();
+            ASSERT_TRUE(entry != NULL);
+            EXPECT_EQ(i, entry->frame.data[0]);
+            queue.remove(entry);
+        }
+        EXPECT_EQ(makeCanFrame(10, "", EXT), queue.peek()->frame);
+    }
+}
+#endif
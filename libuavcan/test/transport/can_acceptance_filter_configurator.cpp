@@ -8,6 +8,7 @@
 
 #include <uavcan/transport/can_acceptance_filter_configurator.hpp>
 #include "../node/test_node.hpp"
+#include "transfer_test_helpers.hpp"
 #include "uavcan/node/subscriber.hpp"
 #include <uavcan/equipment/camera_gimbal/AngularCommand.hpp>
 #include <uavcan/equipment/air_data/Sideslip.hpp>
@@ -216,4 +217,184 @@ TEST(CanAcceptanceFilter, Basic_test)
     ASSERT_EQ(configure_array_2.getByIndex(3)->id, 2147745792);
     ASSERT_EQ(configure_array_2.getByIndex(3)->mask, 3774868352);
 }
+
+static bool hasFilterConfig(const uavcan::CanAcceptanceFilterConfigurator& configurator,
+                            uavcan::uint32_t id, uavcan::uint32_t mask)
+{
+    const auto& configs = configurator.getConfiguration();
+    for (unsigned i = 0; i < configs.getSize(); i++)
+    {
+        if ((configs.getByIndex(i)->id == id) && (configs.getByIndex(i)->mask == mask))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+TEST(CanAcceptanceFilter, AutoReconfiguration)
+{
+    SystemClockDriver clock_driver;
+    CanDriverMock can_driver(1, clock_driver);
+    TestNode node(can_driver, clock_driver, 24);
+    uavcan::Dispatcher& dispatcher = node.getDispatcher();
+
+    static const uavcan::DataTypeDescriptor TYPES[4] =
+    {
+        makeDataType(uavcan::DataTypeKindMessage, 10),
+        makeDataType(uavcan::DataTypeKindMessage, 11),
+        makeDataType(uavcan::DataTypeKindMessage, 12),
+        makeDataType(uavcan::DataTypeKindMessage, 13)
+    };
+    static const uavcan::DataTypeDescriptor TYPE_100 = makeDataType(uavcan::DataTypeKindMessage, 100);
+
+    static const int MaxBufSize = 64;
+    TestListener sub_10(dispatcher.getTransferPerfCounter(), TYPES[0], MaxBufSize, node.getAllocator());
+    TestListener sub_11(dispatcher.getTransferPerfCounter(), TYPES[1], MaxBufSize, node.getAllocator());
+    TestListener sub_12(dispatcher.getTransferPerfCounter(), TYPES[2], MaxBufSize, node.getAllocator());
+    TestListener sub_13(dispatcher.getTransferPerfCounter(), TYPES[3], MaxBufSize, node.getAllocator());
+    TestListener sub_13_1(dispatcher.getTransferPerfCounter(), TYPES[3], MaxBufSize, node.getAllocator());
+    TestListener sub_100(dispatcher.getTransferPerfCounter(), TYPE_100, MaxBufSize, node.getAllocator());
+
+    const uint32_t MsgMask = 0xFFFF80U | uavcan::CanFrame::FlagEFF | uavcan::CanFrame::FlagRTR |
+                             uavcan::CanFrame::FlagERR;
+    {
+        uavcan::CanAcceptanceFilterConfigurator configurator(node, 4);
+        const auto& configs = configurator.getConfiguration();
+
+        ASSERT_EQ(0, configurator.enableAutoReconfiguration(
+                         uavcan::CanAcceptanceFilterConfigurator::IgnoreAnonymousMessages));
+        ASSERT_TRUE(configurator.isAutoReconfigurationEnabled());
+        ASSERT_EQ(1, configs.getSize());                    // Service requests only
+        ASSERT_FLOAT_EQ(0.0F, configurator.getEstimatedLeakRate());
+
+        // Spare filters are used first
+        ASSERT_TRUE(dispatcher.registerMessageListener(&sub_10));
+        ASSERT_TRUE(dispatcher.registerMessageListener(&sub_11));
+        ASSERT_TRUE(dispatcher.registerMessageListener(&sub_12));
+        ASSERT_EQ(4, configs.getSize());
+        ASSERT_TRUE(hasFilterConfig(configurator, (10U << 8) | uavcan::CanFrame::FlagEFF, MsgMask));
+        ASSERT_FLOAT_EQ(0.0F, configurator.getEstimatedLeakRate());
+
+        // 13 differs from 12 in one bit, so the merge does not let in anything extra
+        ASSERT_TRUE(dispatcher.registerMessageListener(&sub_13));
+        ASSERT_EQ(4, configs.getSize());
+        ASSERT_TRUE(hasFilterConfig(configurator, (12U << 8) | uavcan::CanFrame::FlagEFF, MsgMask & ~(1U << 8)));
+        ASSERT_FLOAT_EQ(0.0F, configurator.getEstimatedLeakRate());
+
+        // Same data type again - no changes
+        ASSERT_TRUE(dispatcher.registerMessageListener(&sub_13_1));
+        ASSERT_EQ(4, configs.getSize());
+
+        // This one can't be merged without leaks
+        ASSERT_TRUE(dispatcher.registerMessageListener(&sub_100));
+        ASSERT_EQ(4, configs.getSize());
+        ASSERT_LT(0.0F, configurator.getEstimatedLeakRate());
+        ASSERT_GT(1.0F, configurator.getEstimatedLeakRate());
+
+        // Removal of a merged filter triggers full recomputation
+        dispatcher.unregisterMessageListener(&sub_100);
+        ASSERT_EQ(4, configs.getSize());
+        ASSERT_FLOAT_EQ(0.0F, configurator.getEstimatedLeakRate());
+
+        dispatcher.unregisterMessageListener(&sub_13_1);
+        ASSERT_EQ(4, configs.getSize());
+        dispatcher.unregisterMessageListener(&sub_13);
+        ASSERT_EQ(4, configs.getSize());
+        ASSERT_TRUE(hasFilterConfig(configurator, (12U << 8) | uavcan::CanFrame::FlagEFF, MsgMask));
+
+        // Exact filters are removed directly
+        dispatcher.unregisterMessageListener(&sub_12);
+        ASSERT_EQ(3, configs.getSize());
+        ASSERT_FALSE(hasFilterConfig(configurator, (12U << 8) | uavcan::CanFrame::FlagEFF, MsgMask));
+        ASSERT_FLOAT_EQ(0.0F, configurator.getEstimatedLeakRate());
+    }
+    ASSERT_FALSE(dispatcher.getListenerRegistrationObserver());     // Removed by the destructor
+
+    dispatcher.unregisterMessageListener(&sub_10);
+    dispatcher.unregisterMessageListener(&sub_11);
+}
+
+TEST(CanAcceptanceFilter, PackedFilters)
+{
+    SystemClockDriver clock_driver;
+    CanDriverMock can_driver(2, clock_driver);
+    TestNode node(can_driver, clock_driver, 24);
+    uavcan::Dispatcher& dispatcher = node.getDispatcher();
+
+    static const unsigned NumTypes = 8;
+    static const int MaxBufSize = 64;
+    std::vector<uavcan::DataTypeDescriptor> types;      // Must outlive the listeners
+    for (unsigned i = 0; i < NumTypes; i++)
+    {
+        types.push_back(makeDataType(uavcan::DataTypeKindMessage, uint16_t(10U << i)));
+    }
+    std::vector<std::unique_ptr<TestListener>> subs;
+    for (unsigned i = 0; i < NumTypes; i++)
+    {
+        subs.emplace_back(new TestListener(dispatcher.getTransferPerfCounter(), types[i], MaxBufSize,
+                                           node.getAllocator()));
+    }
+    for (unsigned i = 0; i < (NumTypes - 1); i++)
+    {
+        ASSERT_TRUE(dispatcher.registerMessageListener(subs[i].get()));
+    }
+
+    // One config per filter - merging is required
+    {
+        uavcan::CanAcceptanceFilterConfigurator configurator(node);
+        ASSERT_EQ(0, configurator.computeConfiguration(
+                         uavcan::CanAcceptanceFilterConfigurator::IgnoreAnonymousMessages));
+        ASSERT_EQ(4, configurator.getConfiguration().getSize());
+        ASSERT_LT(0.0F, configurator.getEstimatedLeakRate());
+    }
+
+    // Two configs per filter on both ifaces - the service filter and all 7 message filters fit as is
+    can_driver.ifaces.at(0).num_configs_per_filter = 2;
+    can_driver.ifaces.at(1).num_configs_per_filter = 2;
+    {
+        uavcan::CanAcceptanceFilterConfigurator configurator(node);
+        ASSERT_EQ(0, configurator.computeConfiguration(
+                         uavcan::CanAcceptanceFilterConfigurator::IgnoreAnonymousMessages));
+        ASSERT_EQ(unsigned(NumTypes), configurator.getConfiguration().getSize());
+        ASSERT_FLOAT_EQ(0.0F, configurator.getEstimatedLeakRate());
+        ASSERT_EQ(0, configurator.applyConfiguration());
+        ASSERT_EQ(unsigned(NumTypes), configurator.getConfiguration().getSize());
+    }
+
+    // The least capable iface defines the limit
+    can_driver.ifaces.at(1).num_configs_per_filter = 1;
+    {
+        uavcan::CanAcceptanceFilterConfigurator configurator(node);
+        ASSERT_EQ(0, configurator.computeConfiguration(
+                         uavcan::CanAcceptanceFilterConfigurator::IgnoreAnonymousMessages));
+        ASSERT_EQ(4, configurator.getConfiguration().getSize());
+    }
+    can_driver.ifaces.at(1).num_configs_per_filter = 2;
+
+    // An explicit number of filters is respected as is
+    {
+        uavcan::CanAcceptanceFilterConfigurator configurator(node, 4);
+        ASSERT_EQ(0, configurator.computeConfiguration(
+                         uavcan::CanAcceptanceFilterConfigurator::IgnoreAnonymousMessages));
+        ASSERT_EQ(4, configurator.getConfiguration().getSize());
+    }
+
+    // Automatic reconfiguration - no spare filters left after the last subscription, the next one gets merged
+    {
+        uavcan::CanAcceptanceFilterConfigurator configurator(node);
+        ASSERT_EQ(0, configurator.enableAutoReconfiguration(
+                         uavcan::CanAcceptanceFilterConfigurator::IgnoreAnonymousMessages));
+        ASSERT_EQ(unsigned(NumTypes), configurator.getConfiguration().getSize());
+
+        ASSERT_TRUE(dispatcher.registerMessageListener(subs[NumTypes - 1].get()));
+        ASSERT_EQ(unsigned(NumTypes), configurator.getConfiguration().getSize());
+        ASSERT_LT(0.0F, configurator.getEstimatedLeakRate());
+    }
+
+    for (unsigned i = 0; i < NumTypes; i++)
+    {
+        dispatcher.unregisterMessageListener(subs[i].get());
+    }
+}
 #endif
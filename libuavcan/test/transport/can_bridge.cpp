@@ -0,0 +1,284 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <gtest/gtest.h>
+#include <uavcan/transport/can_bridge.hpp>
+#include <uavcan/transport/frame.hpp>
+#include "can/can.hpp"
+
+
+static uavcan::CanFrame makeFrame(uavcan::DataTypeID data_type_id, uavcan::TransferType transfer_type,
+                                  uint8_t priority, uint8_t transfer_id = 0)
+{
+    const uavcan::NodeID dst_node_id = (transfer_type == uavcan::TransferTypeMessageBroadcast) ?
+                                       uavcan::NodeID::Broadcast : uavcan::NodeID(20);
+    uavcan::Frame frame(data_type_id, transfer_type, 10, dst_node_id, transfer_id);
+    frame.setPriority(priority);
+    frame.setStartOfTransfer(true);
+    frame.setEndOfTransfer(true);
+    uavcan::CanFrame can_frame;
+    EXPECT_TRUE(frame.compile(can_frame));
+    return can_frame;
+}
+
+TEST(CanBridge, Routing)
+{
+    using uavcan::CanBridge;
+    using uavcan::CanBridgeRoute;
+
+    SystemClockMock clock(1000000);
+    CanDriverMock driver(2, clock);
+    CanBridge bridge(driver, clock);
+
+    const uavcan::TransferType Msg = uavcan::TransferTypeMessageBroadcast;
+    const uavcan::TransferType Req = uavcan::TransferTypeServiceRequest;
+    const uavcan::TransferType Resp = uavcan::TransferTypeServiceResponse;
+
+    // Nothing is forwarded by default
+    ASSERT_EQ(0, bridge.getNumRoutes());
+    EXPECT_FALSE(bridge.isRouted(CanBridge::SideA, makeFrame(100, Msg, 16)));
+    EXPECT_FALSE(bridge.isRouted(CanBridge::SideB, makeFrame(100, Req, 16)));
+
+    // Default route forwards everything
+    ASSERT_EQ(0, bridge.addRoute(CanBridgeRoute()));
+    EXPECT_TRUE(bridge.isRouted(CanBridge::SideA, makeFrame(100, Msg, 16)));
+    EXPECT_TRUE(bridge.isRouted(CanBridge::SideA, makeFrame(65535, Msg, 31)));
+    EXPECT_TRUE(bridge.isRouted(CanBridge::SideB, makeFrame(0, Req, 0)));
+    EXPECT_TRUE(bridge.isRouted(CanBridge::SideB, makeFrame(255, Resp, 0)));
+
+    // Non-UAVCAN frames are never forwarded
+    const uavcan::uint8_t data[1] = { 0 };
+    EXPECT_FALSE(bridge.isRouted(CanBridge::SideA, uavcan::CanFrame(123, data, 1)));
+
+    bridge.removeAllRoutes();
+    ASSERT_EQ(0, bridge.getNumRoutes());
+    EXPECT_FALSE(bridge.isRouted(CanBridge::SideA, makeFrame(100, Msg, 16)));
+
+    // Overlapping routes
+    CanBridgeRoute r1;
+    r1.directions = CanBridgeRoute::DirectionAToB;
+    r1.transfer_types = 1U << Msg;
+    r1.data_type_id_min = 100;
+    r1.data_type_id_max = 200;
+    r1.priority_max = 15;
+    ASSERT_EQ(0, bridge.addRoute(r1));
+
+    CanBridgeRoute r2;
+    r2.directions = CanBridgeRoute::DirectionBToA;
+    r2.transfer_types = (1U << Req) | (1U << Resp);
+    r2.data_type_id_min = 10;
+    r2.data_type_id_max = 10;
+    ASSERT_EQ(0, bridge.addRoute(r2));
+
+    CanBridgeRoute r3;
+    r3.directions = CanBridgeRoute::DirectionAToB;
+    r3.transfer_types = 1U << Msg;
+    r3.data_type_id_min = 150;
+    r3.data_type_id_max = 300;
+    r3.priority_min = 20;
+    ASSERT_EQ(0, bridge.addRoute(r3));
+    ASSERT_EQ(3, bridge.getNumRoutes());
+    ASSERT_EQ(150, bridge.getRoute(2).data_type_id_min);
+
+    EXPECT_FALSE(bridge.isRouted(CanBridge::SideA, makeFrame(99, Msg, 0)));
+    EXPECT_TRUE(bridge.isRouted(CanBridge::SideA, makeFrame(100, Msg, 0)));
+    EXPECT_TRUE(bridge.isRouted(CanBridge::SideA, makeFrame(100, Msg, 15)));
+    EXPECT_FALSE(bridge.isRouted(CanBridge::SideA, makeFrame(100, Msg, 16)));
+    EXPECT_FALSE(bridge.isRouted(CanBridge::SideA, makeFrame(100, Msg, 20)));
+    EXPECT_TRUE(bridge.isRouted(CanBridge::SideA, makeFrame(150, Msg, 10)));
+    EXPECT_FALSE(bridge.isRouted(CanBridge::SideA, makeFrame(150, Msg, 17)));
+    EXPECT_TRUE(bridge.isRouted(CanBridge::SideA, makeFrame(150, Msg, 25)));
+    EXPECT_TRUE(bridge.isRouted(CanBridge::SideA, makeFrame(200, Msg, 0)));
+    EXPECT_FALSE(bridge.isRouted(CanBridge::SideA, makeFrame(201, Msg, 0)));
+    EXPECT_TRUE(bridge.isRouted(CanBridge::SideA, makeFrame(201, Msg, 31)));
+    EXPECT_TRUE(bridge.isRouted(CanBridge::SideA, makeFrame(300, Msg, 20)));
+    EXPECT_FALSE(bridge.isRouted(CanBridge::SideA, makeFrame(301, Msg, 20)));
+    EXPECT_FALSE(bridge.isRouted(CanBridge::SideA, makeFrame(10, Req, 0)));
+
+    EXPECT_FALSE(bridge.isRouted(CanBridge::SideB, makeFrame(150, Msg, 10)));
+    EXPECT_TRUE(bridge.isRouted(CanBridge::SideB, makeFrame(10, Req, 0)));
+    EXPECT_TRUE(bridge.isRouted(CanBridge::SideB, makeFrame(10, Resp, 31)));
+    EXPECT_FALSE(bridge.isRouted(CanBridge::SideB, makeFrame(11, Req, 0)));
+    EXPECT_FALSE(bridge.isRouted(CanBridge::SideB, makeFrame(9, Resp, 0)));
+
+    // Invalid routes
+    CanBridgeRoute bad;
+    bad.priority_min = 5;
+    bad.priority_max = 4;
+    EXPECT_EQ(-uavcan::ErrInvalidParam, bridge.addRoute(bad));
+    bad = CanBridgeRoute();
+    bad.directions = 0;
+    EXPECT_EQ(-uavcan::ErrInvalidParam, bridge.addRoute(bad));
+    bad = CanBridgeRoute();
+    bad.data_type_id_min = 2;
+    bad.data_type_id_max = 1;
+    EXPECT_EQ(-uavcan::ErrInvalidParam, bridge.addRoute(bad));
+
+    // Table size is limited
+    while (bridge.getNumRoutes() < CanBridge::MaxRoutes)
+    {
+        ASSERT_EQ(0, bridge.addRoute(r1));
+    }
+    EXPECT_EQ(-uavcan::ErrMemory, bridge.addRoute(r1));
+    EXPECT_TRUE(bridge.isRouted(CanBridge::SideA, makeFrame(100, Msg, 0)));
+}
+
+TEST(CanBridge, ArbitrationOrder)
+{
+    using uavcan::CanBridge;
+
+    SystemClockMock clock(1000000);
+    CanDriverMock driver(2, clock);
+    CanBridge bridge(driver, clock);
+    ASSERT_EQ(0, bridge.addRoute(uavcan::CanBridgeRoute()));
+
+    const uavcan::CanFrame low = makeFrame(1, uavcan::TransferTypeMessageBroadcast, 20);
+    const uavcan::CanFrame mid1 = makeFrame(2, uavcan::TransferTypeMessageBroadcast, 10, 1);
+    const uavcan::CanFrame mid2 = makeFrame(2, uavcan::TransferTypeMessageBroadcast, 10, 2);
+    const uavcan::CanFrame high = makeFrame(3, uavcan::TransferTypeMessageBroadcast, 0);
+    ASSERT_EQ(mid1.id, mid2.id);
+
+    // Destination is busy, the frames are queued
+    driver.ifaces.at(1).writeable = false;
+    driver.ifaces.at(0).pushRx(low);
+    driver.ifaces.at(0).pushRx(mid1);
+    driver.ifaces.at(0).pushRx(mid2);
+    driver.ifaces.at(0).pushRx(high);
+    ASSERT_LE(0, bridge.spinOnce());
+    ASSERT_EQ(4, bridge.getQueueSize(CanBridge::SideB));
+    ASSERT_EQ(0, bridge.getQueueSize(CanBridge::SideA));
+    ASSERT_LE(0, bridge.spinOnce());
+    ASSERT_TRUE(driver.ifaces.at(1).matchPendingTx(high));
+    ASSERT_TRUE(driver.ifaces.at(1).tx.empty());
+
+    // Arbitration order; the frames of one transfer keep their order
+    driver.ifaces.at(1).writeable = true;
+    ASSERT_LE(0, bridge.spinOnce());
+    ASSERT_EQ(0, bridge.getQueueSize(CanBridge::SideB));
+    const uint64_t deadline = 1000000 + uint64_t(CanBridge::getDefaultForwardingTimeout().toUSec());
+    ASSERT_TRUE(driver.ifaces.at(1).matchAndPopTx(high, deadline));
+    ASSERT_TRUE(driver.ifaces.at(1).matchAndPopTx(mid1, deadline));
+    ASSERT_TRUE(driver.ifaces.at(1).matchAndPopTx(mid2, deadline));
+    ASSERT_TRUE(driver.ifaces.at(1).matchAndPopTx(low, deadline));
+    ASSERT_TRUE(driver.ifaces.at(1).tx.empty());
+    ASSERT_TRUE(driver.ifaces.at(0).tx.empty());
+    EXPECT_EQ(4, bridge.getNumForwardedFrames(CanBridge::SideB));
+    EXPECT_EQ(0, bridge.getNumForwardedFrames(CanBridge::SideA));
+
+    // Expired frames are dropped
+    driver.ifaces.at(1).writeable = false;
+    driver.ifaces.at(0).pushRx(low);
+    ASSERT_LE(0, bridge.spinOnce());
+    clock.advance(uint64_t(CanBridge::getDefaultForwardingTimeout().toUSec()) + 1U);
+    driver.ifaces.at(1).writeable = true;
+    ASSERT_LE(0, bridge.spinOnce());
+    ASSERT_TRUE(driver.ifaces.at(1).tx.empty());
+    EXPECT_EQ(1, bridge.getNumTxTimeouts());
+
+    // Queue overflow
+    driver.ifaces.at(0).writeable = false;
+    for (unsigned i = 0; i <= CanBridge::QueueCapacity; i++)
+    {
+        driver.ifaces.at(1).pushRx(makeFrame(uavcan::DataTypeID(uint16_t(i)), uavcan::TransferTypeMessageBroadcast,
+                                             16));
+        ASSERT_LE(0, bridge.spinOnce());
+    }
+    EXPECT_EQ(unsigned(CanBridge::QueueCapacity), bridge.getQueueSize(CanBridge::SideA));
+    EXPECT_EQ(1, bridge.getNumQueueOverflows());
+
+    // TX errors drop the frame
+    driver.ifaces.at(0).writeable = true;
+    driver.ifaces.at(0).tx_failure = true;
+    ASSERT_LE(0, bridge.spinOnce());
+    EXPECT_EQ(1, bridge.getNumTxErrors());
+    EXPECT_EQ(unsigned(CanBridge::QueueCapacity) - 1U, bridge.getQueueSize(CanBridge::SideA));
+
+    // Driver failure
+    driver.select_failure = true;
+    EXPECT_EQ(-uavcan::ErrDriver, bridge.spinOnce());
+}
+
+TEST(CanBridge, LoopPrevention)
+{
+    using uavcan::CanBridge;
+
+    SystemClockMock clock(1000000);
+    CanDriverMock driver(2, clock);
+    CanBridge bridge(driver, clock);
+    ASSERT_EQ(0, bridge.addRoute(uavcan::CanBridgeRoute()));
+
+    const uavcan::CanFrame frame = makeFrame(123, uavcan::TransferTypeMessageBroadcast, 16);
+
+    driver.ifaces.at(0).pushRx(frame);
+    ASSERT_LE(0, bridge.spinOnce());
+    ASSERT_LE(0, bridge.spinOnce());
+    ASSERT_EQ(frame, driver.ifaces.at(1).popTxFrame());
+
+    // Another bridge has forwarded the same frame to the same bus, it must not be sent back
+    driver.ifaces.at(1).pushRx(frame);
+    ASSERT_LE(0, bridge.spinOnce());
+    EXPECT_EQ(0, bridge.getQueueSize(CanBridge::SideA));
+    EXPECT_EQ(1, bridge.getNumLoopsPrevented());
+
+    // A different frame goes through
+    const uavcan::CanFrame other = makeFrame(123, uavcan::TransferTypeMessageBroadcast, 16, 1);
+    driver.ifaces.at(1).pushRx(other);
+    ASSERT_LE(0, bridge.spinOnce());
+    ASSERT_LE(0, bridge.spinOnce());
+    ASSERT_EQ(other, driver.ifaces.at(0).popTxFrame());
+
+    // Loopback frames are never forwarded
+    driver.ifaces.at(0).loopback.push(CanIfaceMock::FrameWithTime(other, clock.getMonotonic()));
+    ASSERT_LE(0, bridge.spinOnce());
+    EXPECT_EQ(0, bridge.getQueueSize(CanBridge::SideB));
+    EXPECT_EQ(0, bridge.getNumFilteredFrames());
+
+    // Identical frame after the window is legitimate traffic
+    clock.advance(uint64_t(bridge.getLoopGuardWindow().toUSec()) + 1U);
+    driver.ifaces.at(1).pushRx(frame);
+    ASSERT_LE(0, bridge.spinOnce());
+    ASSERT_LE(0, bridge.spinOnce());
+    ASSERT_EQ(frame, driver.ifaces.at(0).popTxFrame());
+    EXPECT_EQ(1, bridge.getNumLoopsPrevented());
+
+    // The guard can be disabled
+    bridge.setLoopGuardWindow(uavcan::MonotonicDuration());
+    driver.ifaces.at(0).pushRx(frame);
+    ASSERT_LE(0, bridge.spinOnce());
+    EXPECT_EQ(1, bridge.getQueueSize(CanBridge::SideB));
+    EXPECT_EQ(1, bridge.getNumLoopsPrevented());
+}
+
+TEST(CanBridge, FullLoad)
+{
+    using uavcan::CanBridge;
+
+    SystemClockMock clock(1000000);
+    CanDriverMock driver(2, clock);
+    CanBridge bridge(driver, clock);
+    ASSERT_EQ(0, bridge.addRoute(uavcan::CanBridgeRoute()));
+
+    // Two fully loaded 1 Mbit/s buses carry about 8 frames per millisecond each, in both directions
+    const unsigned NumFrames = 16000;
+    for (unsigned i = 0; i < NumFrames; i++)
+    {
+        const uint8_t tid = uint8_t(i % 32U);
+        driver.ifaces.at(0).pushRx(makeFrame(uavcan::DataTypeID(uint16_t(i / 32U)),
+                                             uavcan::TransferTypeMessageBroadcast, 16, tid));
+        driver.ifaces.at(1).pushRx(makeFrame(uavcan::DataTypeID(uint16_t(i / 32U)),
+                                             uavcan::TransferTypeMessageBroadcast, 24, tid));
+        if ((i % 8U) == 7U)
+        {
+            clock.advance(1000);
+            ASSERT_LE(0, bridge.spinOnce());
+            ASSERT_LE(0, bridge.spinOnce());
+        }
+    }
+    ASSERT_LE(0, bridge.spinOnce());
+    EXPECT_EQ(NumFrames, bridge.getNumForwardedFrames(CanBridge::SideA));
+    EXPECT_EQ(NumFrames, bridge.getNumForwardedFrames(CanBridge::SideB));
+    EXPECT_EQ(0, bridge.getNumLoopsPrevented());
+    EXPECT_EQ(0, bridge.getNumQueueOverflows());
+    EXPECT_EQ(0, bridge.getNumTxTimeouts());
+}
@@ -2,6 +2,7 @@
  * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
  */
 
+#include <cstdlib>
 #include <gtest/gtest.h>
 #include <uavcan/transport/crc.hpp>
 
@@ -30,3 +31,57 @@ TEST(TransferCRC, Correctness)
     crc.add(reinterpret_cast<const uint8_t*>("456789"), 6);
     ASSERT_EQ(0x29B1, crc.get());
 }
+
+TEST(TransferCRC, BlockConsistency)
+{
+    uint8_t buf[67];
+    for (unsigned i = 0; i < sizeof(buf); i++)
+    {
+        buf[i] = uint8_t(std::rand());
+    }
+
+    // Every length and alignment, so that both the block and the tail processing are covered
+    for (unsigned offset = 0; offset < 4; offset++)
+    {
+        for (unsigned len = 0; len <= (sizeof(buf) - offset); len++)
+        {
+            uavcan::TransferCRC bytewise;
+            for (unsigned i = 0; i < len; i++)
+            {
+                bytewise.add(buf[offset + i]);
+            }
+
+            uavcan::TransferCRC block;
+            block.add(buf + offset, len);
+            ASSERT_EQ(bytewise.get(), block.get()) << "offset " << offset << " len " << len;
+        }
+    }
+}
+
+static unsigned num_block_processor_calls = 0;
+
+static uavcan::uint16_t testBlockProcessor(uavcan::uint16_t crc, const uavcan::uint8_t* bytes, unsigned len)
+{
+    num_block_processor_calls++;
+    return uavcan::uint16_t(crc + len + bytes[0]);
+}
+
+TEST(TransferCRC, BlockProcessor)
+{
+    ASSERT_FALSE(uavcan::TransferCRC::getBlockProcessor());
+    uavcan::TransferCRC::setBlockProcessor(&testBlockProcessor);
+    ASSERT_EQ(&testBlockProcessor, uavcan::TransferCRC::getBlockProcessor());
+
+    uavcan::TransferCRC crc;
+    crc.add(reinterpret_cast<const uint8_t*>("123"), 3);
+    ASSERT_EQ(1, num_block_processor_calls);
+    ASSERT_EQ(0xFFFF + 3 + '1' - 0x10000, crc.get());
+
+    uavcan::TransferCRC::setBlockProcessor(NULL);
+    ASSERT_FALSE(uavcan::TransferCRC::getBlockProcessor());
+
+    crc = uavcan::TransferCRC();
+    crc.add(reinterpret_cast<const uint8_t*>("123456789"), 9);
+    ASSERT_EQ(1, num_block_processor_calls);
+    ASSERT_EQ(0x29B1, crc.get());
+}
@@ -8,6 +8,7 @@
 #include "transfer_test_helpers.hpp"
 #include "can/can.hpp"
 #include <uavcan/transport/dispatcher.hpp>
+#include <uavcan/transport/static_listener_table.hpp>
 
 
 class DispatcherTransferEmulator : public IncomingTransferEmulatorBase
@@ -237,6 +238,7 @@ TEST(Dispatcher, Reception)
     EXPECT_LT(0, dispatcher.getTransferPerfCounter().getErrorCount());   // Repeated transfers
     EXPECT_EQ(0, dispatcher.getTransferPerfCounter().getTxTransferCount());
     EXPECT_EQ(9, dispatcher.getTransferPerfCounter().getRxTransferCount());
+    EXPECT_LT(0, dispatcher.getTransferPerfCounter().getFilteredFrameCount());   // Wrongly addressed
 
     /*
      * RX listener
@@ -246,6 +248,413 @@ TEST(Dispatcher, Reception)
 }
 
 
+TEST(Dispatcher, ListenerIndexCollisions)
+{
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 100, uavcan::MemPoolBlockSize> pool;
+
+    SystemClockMock clockmock(100);
+    CanDriverMock driver(2, clockmock);
+
+    uavcan::Dispatcher dispatcher(driver, pool, clockmock);
+    ASSERT_TRUE(dispatcher.setNodeID(SELF_NODE_ID));
+
+    DispatcherTransferEmulator emulator(driver, SELF_NODE_ID);
+
+    /*
+     * Data type IDs that share the same index slot regardless of the index size
+     */
+    static const uavcan::DataTypeDescriptor TYPES[4] =
+    {
+        makeDataType(uavcan::DataTypeKindMessage, 1),
+        makeDataType(uavcan::DataTypeKindMessage, 1 + 4096),
+        makeDataType(uavcan::DataTypeKindMessage, 1 + 8192),
+        makeDataType(uavcan::DataTypeKindMessage, 2)
+    };
+
+    typedef std::auto_ptr<TestListener> TestListenerPtr;
+    static const int NumSubscribers = 4;
+    TestListenerPtr subscribers[NumSubscribers] =
+    {
+        TestListenerPtr(new TestListener(dispatcher.getTransferPerfCounter(), TYPES[0], 64, pool)),
+        TestListenerPtr(new TestListener(dispatcher.getTransferPerfCounter(), TYPES[1], 64, pool)),
+        TestListenerPtr(new TestListener(dispatcher.getTransferPerfCounter(), TYPES[2], 64, pool)),
+        TestListenerPtr(new TestListener(dispatcher.getTransferPerfCounter(), TYPES[3], 64, pool))
+    };
+
+    for (int i = 0; i < NumSubscribers; i++)
+    {
+        ASSERT_TRUE(dispatcher.registerMessageListener(subscribers[i].get()));
+    }
+    for (int i = 0; i < NumSubscribers; i++)
+    {
+        ASSERT_TRUE(dispatcher.hasSubscriber(TYPES[i].getID()));
+    }
+    ASSERT_FALSE(dispatcher.hasSubscriber(1 + 4096 * 3));
+    ASSERT_FALSE(dispatcher.hasSubscriber(3));
+
+    /*
+     * Removing the listener with the highest ID in the slot
+     */
+    dispatcher.unregisterMessageListener(subscribers[2].get());
+    ASSERT_TRUE(dispatcher.hasSubscriber(TYPES[0].getID()));
+    ASSERT_TRUE(dispatcher.hasSubscriber(TYPES[1].getID()));
+    ASSERT_FALSE(dispatcher.hasSubscriber(TYPES[2].getID()));
+    ASSERT_TRUE(dispatcher.hasSubscriber(TYPES[3].getID()));
+    ASSERT_EQ(3, dispatcher.getNumMessageListeners());
+
+    /*
+     * Reception
+     */
+    const Transfer transfers[4] =
+    {
+        emulator.makeTransfer(0, uavcan::TransferTypeMessageBroadcast, 10, "abc", TYPES[0]),
+        emulator.makeTransfer(1, uavcan::TransferTypeMessageBroadcast, 10, "def", TYPES[1]),
+        emulator.makeTransfer(2, uavcan::TransferTypeMessageBroadcast, 10, "ghi", TYPES[2]),
+        emulator.makeTransfer(3, uavcan::TransferTypeMessageBroadcast, 10, "jkl", TYPES[3])
+    };
+    emulator.send(transfers);
+
+    while (dispatcher.spinOnce() > 0)
+    {
+        clockmock.advance(100);
+    }
+
+    ASSERT_TRUE(subscribers[0]->matchAndPop(transfers[0]));
+    ASSERT_TRUE(subscribers[1]->matchAndPop(transfers[1]));
+    ASSERT_TRUE(subscribers[3]->matchAndPop(transfers[3]));
+    for (int i = 0; i < NumSubscribers; i++)
+    {
+        ASSERT_TRUE(subscribers[i]->isEmpty());
+    }
+
+    // The transfer of the unsubscribed type has been rejected early
+    EXPECT_EQ(1, dispatcher.getTransferPerfCounter().getFilteredFrameCount());
+
+    for (int i = 0; i < NumSubscribers; i++)
+    {
+        dispatcher.unregisterMessageListener(subscribers[i].get());
+    }
+    ASSERT_EQ(0, dispatcher.getNumMessageListeners());
+    ASSERT_FALSE(dispatcher.hasSubscriber(TYPES[0].getID()));
+}
+
+TEST(Dispatcher, ReceiverEviction)
+{
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 4, uavcan::MemPoolBlockSize> pool;
+
+    SystemClockMock clockmock(100);
+    CanDriverMock driver(2, clockmock);
+
+    uavcan::Dispatcher dispatcher(driver, pool, clockmock);
+    ASSERT_TRUE(dispatcher.setNodeID(SELF_NODE_ID));
+    ASSERT_TRUE(dispatcher.isReceiverEvictionEnabled());
+
+    DispatcherTransferEmulator emulator(driver, SELF_NODE_ID);
+
+    static const uavcan::DataTypeDescriptor TYPES[2] =
+    {
+        makeDataType(uavcan::DataTypeKindMessage, 1),
+        makeDataType(uavcan::DataTypeKindMessage, 2)
+    };
+    TestListener sub_a(dispatcher.getTransferPerfCounter(), TYPES[0], 64, pool);
+    TestListener sub_b(dispatcher.getTransferPerfCounter(), TYPES[1], 64, pool);
+    ASSERT_TRUE(dispatcher.registerMessageListener(&sub_a));
+    ASSERT_TRUE(dispatcher.registerMessageListener(&sub_b));
+
+    /*
+     * The first listener takes all of the memory, then the second one evicts its receivers
+     */
+    std::vector<Transfer> transfers;
+    for (uint8_t i = 0; i < 16; i++)
+    {
+        transfers.push_back(emulator.makeTransfer(0, uavcan::TransferTypeMessageBroadcast, uint8_t(i + 1), "abc",
+                                                  TYPES[(i < 8) ? 0 : 1]));
+    }
+    for (unsigned i = 0; i < transfers.size(); i++)
+    {
+        emulator.send(&transfers[i], 1);
+        while (dispatcher.spinOnce() > 0)
+        {
+            clockmock.advance(100);
+        }
+    }
+
+    for (unsigned i = 0; i < transfers.size(); i++)
+    {
+        ASSERT_TRUE(((i < 8) ? sub_a : sub_b).matchAndPop(transfers[i]));
+    }
+    ASSERT_TRUE(sub_a.isEmpty());
+    ASSERT_TRUE(sub_b.isEmpty());
+    ASSERT_LT(0, dispatcher.getNumEvictedReceivers());
+
+    /*
+     * With the eviction disabled, the new sources are not accepted while the memory is exhausted
+     */
+    dispatcher.setReceiverEvictionEnabled(false);
+    const uint32_t num_evicted = dispatcher.getNumEvictedReceivers();
+
+    const Transfer tr = emulator.makeTransfer(0, uavcan::TransferTypeMessageBroadcast, 100, "def", TYPES[0]);
+    emulator.send(&tr, 1);
+    while (dispatcher.spinOnce() > 0)
+    {
+        clockmock.advance(100);
+    }
+    ASSERT_TRUE(sub_a.isEmpty());
+    ASSERT_EQ(num_evicted, dispatcher.getNumEvictedReceivers());
+
+    dispatcher.unregisterMessageListener(&sub_a);
+    dispatcher.unregisterMessageListener(&sub_b);
+}
+
+TEST(Dispatcher, RedundantFrameFilter)
+{
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 16, uavcan::MemPoolBlockSize> pool;
+
+    SystemClockMock clockmock(100);
+    CanDriverMock driver(2, clockmock);
+
+    uavcan::Dispatcher dispatcher(driver, pool, clockmock);
+    ASSERT_TRUE(dispatcher.setNodeID(SELF_NODE_ID));
+    uavcan::RedundantFrameFilter filter;
+    ASSERT_FALSE(dispatcher.getRedundantFrameFilter());
+    dispatcher.installRedundantFrameFilter(&filter);
+    ASSERT_EQ(&filter, dispatcher.getRedundantFrameFilter());
+
+    DispatcherTransferEmulator emulator(driver, SELF_NODE_ID);
+
+    const uavcan::DataTypeDescriptor type = makeDataType(uavcan::DataTypeKindMessage, 1);
+    TestListener sub(dispatcher.getTransferPerfCounter(), type, 256, pool);
+    ASSERT_TRUE(dispatcher.registerMessageListener(&sub));
+
+    /*
+     * Every frame arrives on both ifaces, the lead iface alternates
+     */
+    const Transfer tr = emulator.makeTransfer(0, uavcan::TransferTypeMessageBroadcast, 10,
+                                              "The copies of this transfer arrive in random order", type);
+    const std::vector<uavcan::RxFrame> frames = serializeTransfer(tr);
+    ASSERT_LT(2, frames.size());
+    for (unsigned i = 0; i < frames.size(); i++)
+    {
+        for (uint8_t k = 0; k < 2; k++)
+        {
+            const uint8_t iface_index = uint8_t((i + k + 1) % 2);
+            const uavcan::MonotonicTime ts = frames[i].getMonotonicTimestamp() + uavcan::MonotonicDuration::fromUSec(k);
+            driver.ifaces.at(iface_index).pushRx(uavcan::RxFrame(frames[i], ts, frames[i].getUtcTimestamp(),
+                                                                 iface_index));
+            ASSERT_EQ(1, dispatcher.spinOnce());
+        }
+    }
+    ASSERT_TRUE(sub.matchAndPop(tr));
+    ASSERT_TRUE(sub.isEmpty());
+
+    // The first frame came from the iface 1, so all frames from the iface 0 were dropped
+    EXPECT_EQ(frames.size(), filter.getNumDuplicates(0));
+    EXPECT_EQ(0, filter.getNumDuplicates(1));
+
+    /*
+     * Failover once the iface 1 has been silent for long enough
+     */
+    clockmock.advance(uint64_t(filter.getFailoverTimeout().toUSec()) + 1000);
+    const Transfer tr2 = emulator.makeTransfer(0, uavcan::TransferTypeMessageBroadcast, 10, "abc", type);
+    const std::vector<uavcan::RxFrame> frames2 = serializeTransfer(tr2);
+    ASSERT_EQ(1, frames2.size());
+    const uavcan::MonotonicTime ts2 = clockmock.getMonotonic();
+    driver.ifaces.at(0).pushRx(uavcan::RxFrame(frames2[0], ts2, frames2[0].getUtcTimestamp(), 0));
+    ASSERT_EQ(1, dispatcher.spinOnce());
+
+    const Transfer tr2_received(ts2, tr2.ts_utc, tr2.priority, tr2.transfer_type, tr2.transfer_id,
+                                tr2.src_node_id, tr2.dst_node_id, tr2.payload, tr2.data_type);
+    ASSERT_TRUE(sub.matchAndPop(tr2_received));
+
+    dispatcher.removeRedundantFrameFilter();
+    ASSERT_FALSE(dispatcher.getRedundantFrameFilter());
+    dispatcher.unregisterMessageListener(&sub);
+}
+
+TEST(Dispatcher, IncrementalCleanup)
+{
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 100, uavcan::MemPoolBlockSize> pool;
+
+    SystemClockMock clockmock(100);
+    CanDriverMock driver(2, clockmock);
+
+    uavcan::Dispatcher dispatcher(driver, pool, clockmock);
+    ASSERT_TRUE(dispatcher.setNodeID(SELF_NODE_ID));
+
+    DispatcherTransferEmulator emulator(driver, SELF_NODE_ID);
+
+    static const int NumSubscribers = 3;
+    static const uavcan::DataTypeDescriptor TYPES[NumSubscribers] =
+    {
+        makeDataType(uavcan::DataTypeKindMessage, 1),
+        makeDataType(uavcan::DataTypeKindMessage, 2),
+        makeDataType(uavcan::DataTypeKindMessage, 3)
+    };
+
+    typedef std::auto_ptr<TestListener> TestListenerPtr;
+    TestListenerPtr subscribers[NumSubscribers];
+    for (int i = 0; i < NumSubscribers; i++)
+    {
+        subscribers[i].reset(new TestListener(dispatcher.getTransferPerfCounter(), TYPES[i], 64, pool));
+        ASSERT_TRUE(dispatcher.registerMessageListener(subscribers[i].get()));
+    }
+
+    /*
+     * One listener per call
+     */
+    const Transfer tr = emulator.makeTransfer(0, uavcan::TransferTypeMessageBroadcast, 10, "abc",
+                                              subscribers[0]->getDataTypeDescriptor());
+    emulator.send(&tr, 1);
+    while (dispatcher.spinOnce() > 0)
+    {
+        clockmock.advance(100);
+    }
+    ASSERT_TRUE(subscribers[0]->matchAndPop(tr));
+    const unsigned used_blocks = pool.getNumUsedBlocks();
+    ASSERT_LT(0, used_blocks);
+
+    // The receiver state has expired, the pass releases it
+    const uavcan::MonotonicTime ts = clockmock.getMonotonic() + uavcan::MonotonicDuration::fromMSec(2000);
+    ASSERT_FALSE(dispatcher.cleanupIncrementally(ts, 1));
+    ASSERT_FALSE(dispatcher.cleanupIncrementally(ts, 1));
+    ASSERT_TRUE(dispatcher.cleanupIncrementally(ts, 1));
+    ASSERT_GT(used_blocks, pool.getNumUsedBlocks());
+
+    // All at once
+    ASSERT_TRUE(dispatcher.cleanupIncrementally(ts, NumSubscribers));
+
+    /*
+     * Listeners removed in the middle of a pass
+     */
+    ASSERT_FALSE(dispatcher.cleanupIncrementally(ts, 1));
+    for (int i = 0; i < NumSubscribers; i++)
+    {
+        dispatcher.unregisterMessageListener(subscribers[i].get());
+        subscribers[i].reset();
+    }
+    ASSERT_TRUE(dispatcher.cleanupIncrementally(ts, 1));
+
+    // No listeners at all
+    ASSERT_TRUE(dispatcher.cleanupIncrementally(ts, 1));
+}
+
+struct StaticTableMessage
+{
+    enum { DataTypeKind = uavcan::DataTypeKindMessage };
+    enum { DefaultDataTypeID = 1 };
+};
+
+struct StaticTableService
+{
+    enum { DataTypeKind = uavcan::DataTypeKindService };
+    enum { DefaultDataTypeID = 1 };
+};
+
+TEST(Dispatcher, StaticListenerTable)
+{
+    typedef uavcan::StaticListenerTableEntry<StaticTableMessage,
+            uavcan::StaticListenerTableEntry<StaticTableService> > DataTypes;
+    ASSERT_EQ(2, unsigned(DataTypes::Size));
+    ASSERT_EQ(1, DataTypes::findIndex(uavcan::DataTypeKindMessage, 1));
+    ASSERT_EQ(0, DataTypes::findIndex(uavcan::DataTypeKindService, 1));
+    ASSERT_GT(0, DataTypes::findIndex(uavcan::DataTypeKindMessage, 2));
+
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 100, uavcan::MemPoolBlockSize> pool;
+
+    SystemClockMock clockmock(100);
+    CanDriverMock driver(1, clockmock);
+
+    uavcan::Dispatcher dispatcher(driver, pool, clockmock);
+    ASSERT_TRUE(dispatcher.setNodeID(SELF_NODE_ID));
+
+    DispatcherTransferEmulator emulator(driver, SELF_NODE_ID);
+
+    const uavcan::DataTypeDescriptor msg_listed   = makeDataType(uavcan::DataTypeKindMessage, 1);
+    const uavcan::DataTypeDescriptor msg_unlisted = makeDataType(uavcan::DataTypeKindMessage, 2);
+    const uavcan::DataTypeDescriptor srv_listed   = makeDataType(uavcan::DataTypeKindService, 1);
+
+    uavcan::TransferPerfCounter& perf = dispatcher.getTransferPerfCounter();
+    TestListener sub_a(perf, msg_listed, 64, pool);
+    TestListener sub_b(perf, msg_listed, 64, pool);
+    TestListener sub_unlisted(perf, msg_unlisted, 64, pool);
+    TestListener server(perf, srv_listed, 64, pool);
+    TestListener client(perf, srv_listed, 64, pool);
+
+    // The table can be installed after the listeners are registered
+    ASSERT_TRUE(dispatcher.registerMessageListener(&sub_a));
+    ASSERT_TRUE(dispatcher.registerMessageListener(&sub_unlisted));
+
+    uavcan::StaticListenerTable<DataTypes> table;
+    ASSERT_FALSE(dispatcher.getStaticListenerTable());
+    dispatcher.installStaticListenerTable(&table);
+    ASSERT_EQ(&table, dispatcher.getStaticListenerTable());
+    ASSERT_EQ(1, dispatcher.getNumUnlistedListeners());
+    ASSERT_EQ(&sub_a, *table.findSlot(uavcan::TransferTypeMessageBroadcast, 1));
+
+    ASSERT_TRUE(dispatcher.registerMessageListener(&sub_b));
+    ASSERT_TRUE(dispatcher.registerServiceRequestListener(&server));
+    ASSERT_TRUE(dispatcher.registerServiceResponseListener(&client));
+    ASSERT_EQ(&server, *table.findSlot(uavcan::TransferTypeServiceRequest, 1));
+    ASSERT_EQ(&client, *table.findSlot(uavcan::TransferTypeServiceResponse, 1));
+
+    const Transfer transfers[] =
+    {
+        emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 10, "123", msg_listed),
+        emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 11, "456", msg_unlisted),
+        emulator.makeTransfer(16, uavcan::TransferTypeServiceRequest,   12, "789", srv_listed),
+        emulator.makeTransfer(16, uavcan::TransferTypeServiceResponse,  13, "abc", srv_listed)
+    };
+    emulator.send(transfers);
+    ASSERT_LE(0, dispatcher.spinOnce());
+
+    ASSERT_TRUE(sub_a.matchAndPop(transfers[0]));
+    ASSERT_TRUE(sub_b.matchAndPop(transfers[0]));       // All listeners of the data type are reached
+    ASSERT_TRUE(sub_unlisted.matchAndPop(transfers[1]));
+    ASSERT_TRUE(server.matchAndPop(transfers[2]));
+    ASSERT_TRUE(client.matchAndPop(transfers[3]));
+
+    /*
+     * Unregistration
+     */
+    dispatcher.unregisterMessageListener(&sub_unlisted);
+    dispatcher.unregisterMessageListener(&sub_unlisted);    // Not registered, no effect
+    ASSERT_EQ(0, dispatcher.getNumUnlistedListeners());
+    dispatcher.unregisterMessageListener(&sub_a);
+    dispatcher.unregisterServiceRequestListener(&server);
+    ASSERT_FALSE(*table.findSlot(uavcan::TransferTypeServiceRequest, 1));
+
+    const Transfer transfers2[] =
+    {
+        emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 10, "123", msg_listed),
+        emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 11, "456", msg_unlisted),
+        emulator.makeTransfer(16, uavcan::TransferTypeServiceRequest,   12, "789", srv_listed)
+    };
+    const uint64_t num_filtered = perf.getFilteredFrameCount();
+    emulator.send(transfers2);
+    ASSERT_LE(0, dispatcher.spinOnce());
+    ASSERT_TRUE(sub_b.matchAndPop(transfers2[0]));
+    ASSERT_TRUE(sub_a.isEmpty());
+    ASSERT_TRUE(sub_unlisted.isEmpty());
+    ASSERT_TRUE(server.isEmpty());
+    ASSERT_EQ(num_filtered + 2, perf.getFilteredFrameCount());
+
+    /*
+     * Removal, the registry works as usual
+     */
+    dispatcher.removeStaticListenerTable();
+    ASSERT_FALSE(dispatcher.getStaticListenerTable());
+    ASSERT_TRUE(dispatcher.registerMessageListener(&sub_unlisted));
+    const Transfer tr = emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 11, "456", msg_unlisted);
+    emulator.send(&tr, 1);
+    ASSERT_LE(0, dispatcher.spinOnce());
+    ASSERT_TRUE(sub_unlisted.matchAndPop(tr));
+
+    dispatcher.unregisterMessageListener(&sub_b);
+    dispatcher.unregisterMessageListener(&sub_unlisted);
+    dispatcher.unregisterServiceResponseListener(&client);
+}
+
+
 TEST(Dispatcher, Transmission)
 {
     uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 8, uavcan::MemPoolBlockSize> pool;
@@ -302,6 +711,16 @@ TEST(Dispatcher, Transmission)
     EXPECT_EQ(0, dispatcher.getTransferPerfCounter().getTxTransferCount());
     EXPECT_EQ(0, dispatcher.getTransferPerfCounter().getRxTransferCount());
 
+#if UAVCAN_DATA_TYPE_PERF_STATS
+    // The frame was accepted by both interfaces, but it's counted once
+    const uavcan::DataTypePerfCounters::Entry* const dt_perf =
+        dispatcher.getTransferPerfCounter().getDataTypePerfCounters().find(uavcan::DataTypeKindService, 123);
+    ASSERT_TRUE(dt_perf);
+    EXPECT_EQ(1, dt_perf->tx.frames);
+    EXPECT_EQ(expected_can_frame.dlc, dt_perf->tx.bytes);
+    EXPECT_EQ(0, dt_perf->rx.frames);
+#endif
+
     /*
      * RX listener
      */
@@ -332,6 +751,39 @@ TEST(Dispatcher, Spin)
 }
 
 
+TEST(Dispatcher, MaxFramesPerSpin)
+{
+    NullAllocator poolmgr;
+
+    SystemClockMock clockmock(100);
+    CanDriverMock driver(2, clockmock);
+
+    uavcan::Dispatcher dispatcher(driver, poolmgr, clockmock);
+    ASSERT_TRUE(dispatcher.setNodeID(SELF_NODE_ID));
+    ASSERT_EQ(0, dispatcher.getMaxFramesPerSpin());
+
+    for (int i = 0; i < 20; i++)
+    {
+        driver.ifaces.at(unsigned(i) % 2U).pushRx(makeCanFrame(uint32_t(1000 + i), "a", EXT));
+    }
+    dispatcher.setMaxFramesPerSpin(5);
+
+    ASSERT_LE(0, dispatcher.spinOnce());
+    ASSERT_EQ(15, driver.ifaces.at(0).rx.size() + driver.ifaces.at(1).rx.size());
+
+    ASSERT_LE(0, dispatcher.spin(tsMono(1000000)));
+    ASSERT_EQ(10, driver.ifaces.at(0).rx.size() + driver.ifaces.at(1).rx.size());
+    ASSERT_GT(1000000, clockmock.monotonic);                 // Returned before the deadline
+
+    ASSERT_LE(0, dispatcher.spinUntilIo(tsMono(1000000)));
+    ASSERT_EQ(5, driver.ifaces.at(0).rx.size() + driver.ifaces.at(1).rx.size());
+
+    dispatcher.setMaxFramesPerSpin(0);
+    ASSERT_LE(0, dispatcher.spinOnce());
+    ASSERT_EQ(0, driver.ifaces.at(0).rx.size() + driver.ifaces.at(1).rx.size());
+}
+
+
 struct DispatcherTestLoopbackFrameListener : public uavcan::LoopbackFrameListenerBase
 {
     uavcan::RxFrame last_frame;
@@ -390,3 +842,84 @@ TEST(Dispatcher, Loopback)
     }
     ASSERT_EQ(0, dispatcher.getLoopbackFrameListenerRegistry().getNumListeners());
 }
+
+
+struct DispatcherTestRawLoopbackFrameListener : public uavcan::LoopbackFrameListenerBase
+{
+    uavcan::CanRxFrame last_frame;
+    unsigned count;
+
+    DispatcherTestRawLoopbackFrameListener(uavcan::Dispatcher& dispatcher)
+        : uavcan::LoopbackFrameListenerBase(dispatcher)
+        , count(0)
+    { }
+
+    using uavcan::LoopbackFrameListenerBase::startListeningRaw;
+
+    void handleLoopbackCanFrame(const uavcan::CanRxFrame& frame)
+    {
+        last_frame = frame;
+        count++;
+    }
+};
+
+TEST(Dispatcher, LoopbackFiltering)
+{
+    NullAllocator poolmgr;
+
+    SystemClockMock clockmock(100);
+    CanDriverMock driver(1, clockmock);
+
+    uavcan::Dispatcher dispatcher(driver, poolmgr, clockmock);
+    ASSERT_TRUE(dispatcher.setNodeID(SELF_NODE_ID));
+
+    DispatcherTestLoopbackFrameListener all(dispatcher);
+    DispatcherTestLoopbackFrameListener filtered(dispatcher);
+    DispatcherTestRawLoopbackFrameListener raw(dispatcher);
+    all.startListening();
+    filtered.startListening(123, uavcan::TransferTypeServiceResponse);
+    raw.startListeningRaw(456, uavcan::TransferTypeMessageBroadcast);
+    ASSERT_EQ(3, dispatcher.getLoopbackFrameListenerRegistry().getNumListeners());
+
+    ASSERT_TRUE(filtered.acceptsFrame(uavcan::TransferTypeServiceResponse, 123));
+    ASSERT_FALSE(filtered.acceptsFrame(uavcan::TransferTypeServiceRequest, 123));
+    ASSERT_FALSE(filtered.acceptsFrame(uavcan::TransferTypeServiceResponse, 124));
+    ASSERT_TRUE(all.acceptsFrame(uavcan::TransferTypeServiceRequest, 1));
+    ASSERT_TRUE(raw.isRaw());
+    ASSERT_FALSE(filtered.isRaw());
+
+    uavcan::Frame response(123, uavcan::TransferTypeServiceResponse, SELF_NODE_ID, 2, 0);
+    response.setPayload(reinterpret_cast<const uint8_t*>("123"), 3);
+    response.setStartOfTransfer(true);
+    response.setEndOfTransfer(true);
+
+    uavcan::Frame request(123, uavcan::TransferTypeServiceRequest, SELF_NODE_ID, 2, 1);
+    request.setStartOfTransfer(true);
+    request.setEndOfTransfer(true);
+
+    uavcan::Frame message(456, uavcan::TransferTypeMessageBroadcast, SELF_NODE_ID, uavcan::NodeID::Broadcast, 2);
+    message.setStartOfTransfer(true);
+    message.setEndOfTransfer(true);
+
+    const uavcan::Frame* const frames[] = { &response, &request, &message };
+    for (unsigned i = 0; i < 3; i++)
+    {
+        ASSERT_LE(0, dispatcher.send(*frames[i], tsMono(1000), tsMono(0), uavcan::CanTxQueue::Persistent,
+                                     uavcan::CanIOFlagLoopback, 0xFF));
+    }
+    ASSERT_EQ(0, dispatcher.spin(tsMono(1000)));
+
+    ASSERT_EQ(3, all.count);
+    ASSERT_TRUE(all.last_frame == message);
+
+    ASSERT_EQ(1, filtered.count);
+    ASSERT_TRUE(filtered.last_frame == response);
+
+    // The raw listener gets the frame as it came from the driver
+    ASSERT_EQ(1, raw.count);
+    ASSERT_TRUE(uavcan::Frame::isSingleFrameTransfer(raw.last_frame));
+    uavcan::Frame parsed;
+    ASSERT_TRUE(parsed.parse(raw.last_frame));
+    ASSERT_TRUE(parsed == message);
+    ASSERT_FALSE(raw.last_frame.ts_mono.isZero());
+}
@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <gtest/gtest.h>
+#include <uavcan/transport/event_trace.hpp>
+#include <uavcan/transport/dispatcher.hpp>
+#include "can/can.hpp"
+
+
+TEST(EventTrace, Basic)
+{
+    SystemClockMock clockmock(1000000);
+    uavcan::EventTrace trace;
+
+    ASSERT_EQ(0, trace.getNumRecords());
+    ASSERT_EQ(0, trace.getNumLostRecords());
+    ASSERT_EQ(unsigned(uavcan::EventTrace::AllEventsMask), trace.getEnabledMask());
+
+    // No clock, no timestamp
+    trace.record(uavcan::TraceEventFrameRx, uavcan::MonotonicTime(), 0x1234, 8, 1);
+    ASSERT_EQ(1, trace.getNumRecords());
+    ASSERT_EQ(0, trace.getRecord(0).timestamp_usec);
+    ASSERT_EQ(0x1234, trace.getRecord(0).arg32);
+    ASSERT_EQ(8, trace.getRecord(0).arg16);
+    ASSERT_EQ(1, trace.getRecord(0).arg8);
+    ASSERT_EQ(uavcan::TraceEventFrameRx, trace.getRecord(0).event);
+
+    // The clock is read only if the timestamp is missing
+    trace.setSystemClock(&clockmock);
+    trace.record(uavcan::TraceEventTimerFire, uavcan::MonotonicTime(), 5);
+    trace.record(uavcan::TraceEventTimerFire, uavcan::MonotonicTime::fromUSec(123));
+    ASSERT_EQ(3, trace.getNumRecords());
+    ASSERT_EQ(1000000, trace.getRecord(1).timestamp_usec);
+    ASSERT_EQ(123, trace.getRecord(2).timestamp_usec);
+    ASSERT_EQ(123, trace.getRecord(100).timestamp_usec);       // Out of range - the newest one
+
+    // Disabled events are not recorded
+    trace.setEnabledMask(~(1U << uavcan::TraceEventTimerFire));
+    ASSERT_FALSE(trace.isEnabled(uavcan::TraceEventTimerFire));
+    ASSERT_TRUE(trace.isEnabled(uavcan::TraceEventCrcError));
+    trace.record(uavcan::TraceEventTimerFire, uavcan::MonotonicTime::fromUSec(1));
+    ASSERT_EQ(3, trace.getNumRecords());
+
+    // Overflow - the oldest records are overwritten, the order is retained
+    trace.reset();
+    ASSERT_EQ(0, trace.getNumRecords());
+    const unsigned Total = unsigned(uavcan::EventTrace::Capacity) + 10U;
+    for (unsigned i = 0; i < Total; i++)
+    {
+        trace.record(uavcan::TraceEventFrameTx, uavcan::MonotonicTime::fromUSec(i + 1U), i);
+    }
+    ASSERT_EQ(unsigned(uavcan::EventTrace::Capacity), trace.getNumRecords());
+    ASSERT_EQ(10, trace.getNumLostRecords());
+    for (unsigned i = 0; i < trace.getNumRecords(); i++)
+    {
+        ASSERT_EQ(i + 10U, trace.getRecord(i).arg32);
+    }
+}
+
+#if UAVCAN_EVENT_TRACE
+
+TEST(EventTrace, Transport)
+{
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 16, uavcan::MemPoolBlockSize> pool;
+    SystemClockMock clockmock(1000000);
+    CanDriverMock driver(2, clockmock);
+    uavcan::Dispatcher dispatcher(driver, pool, clockmock);
+    const uavcan::EventTrace& trace = dispatcher.getTransferPerfCounter().getEventTrace();
+
+    // Received frames are recorded even if there are no listeners
+    driver.ifaces.at(1).pushRx(makeCanFrame(123, "a", EXT));
+    ASSERT_LE(0, dispatcher.spinOnce());
+    ASSERT_EQ(1, trace.getNumRecords());
+    ASSERT_EQ(uavcan::TraceEventFrameRx, trace.getRecord(0).event);
+    ASSERT_EQ(123U | uavcan::CanFrame::FlagEFF, trace.getRecord(0).arg32);
+    ASSERT_EQ(1, trace.getRecord(0).arg16);
+    ASSERT_EQ(1, trace.getRecord(0).arg8);
+
+    // Sent on the first iface, queued on the second one, then expired
+    driver.ifaces.at(1).writeable = false;
+    ASSERT_EQ(1, dispatcher.getCanIOManager().send(makeCanFrame(456, "bc", EXT),
+                                                   clockmock.getMonotonic() + uavcan::MonotonicDuration::fromMSec(10),
+                                                   uavcan::MonotonicTime(), 3, uavcan::CanTxQueue::Volatile, 0));
+    ASSERT_EQ(2, trace.getNumRecords());
+    ASSERT_EQ(uavcan::TraceEventFrameTx, trace.getRecord(1).event);
+    ASSERT_EQ(2, trace.getRecord(1).arg16);
+    ASSERT_EQ(0, trace.getRecord(1).arg8);
+
+    clockmock.advance(20000);
+    dispatcher.getCanIOManager().cleanup(clockmock.getMonotonic());
+    ASSERT_EQ(3, trace.getNumRecords());
+    ASSERT_EQ(uavcan::TraceEventTxQueueDrop, trace.getRecord(2).event);
+    ASSERT_EQ(456U | uavcan::CanFrame::FlagEFF, trace.getRecord(2).arg32);
+    ASSERT_EQ(uavcan::TraceDropExpired, trace.getRecord(2).arg8);
+    ASSERT_EQ(1020000, trace.getRecord(2).timestamp_usec);
+}
+
+#endif
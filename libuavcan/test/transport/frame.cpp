@@ -241,6 +241,98 @@ TEST(Frame, AnonymousParseCompile)
 }
 
 
+TEST(Frame, AddressingParsing)
+{
+    using uavcan::Frame;
+    using uavcan::CanFrame;
+
+    uavcan::TransferType tt = uavcan::TransferType(uavcan::NumTransferTypes);
+    uavcan::DataTypeID dtid;
+    uavcan::NodeID dst;
+
+    // Invalid CAN frames
+    ASSERT_FALSE(Frame::parseAddressing(makeCanFrame(123, "\xc0", STD), tt, dtid, dst));
+    ASSERT_FALSE(Frame::parseAddressing(CanFrame(123 | CanFrame::FlagEFF | CanFrame::FlagRTR,
+                                                 (const uint8_t*)"", 0), tt, dtid, dst));
+
+    // Message
+    ASSERT_TRUE(Frame::parseAddressing(makeCanFrame((16 << 24) | (20000 << 8) | 42, "\xc0", EXT), tt, dtid, dst));
+    EXPECT_EQ(uavcan::TransferTypeMessageBroadcast, tt);
+    EXPECT_EQ(20000, dtid.get());
+    EXPECT_TRUE(dst.isBroadcast());
+
+    // Service
+    ASSERT_TRUE(Frame::parseAddressing(makeCanFrame((31 << 24) | (200 << 16) | (0 << 15) | (0x42 << 8) | (1 << 7) | 42,
+                                                    "\xc0", EXT), tt, dtid, dst));
+    EXPECT_EQ(uavcan::TransferTypeServiceResponse, tt);
+    EXPECT_EQ(200, dtid.get());
+    EXPECT_EQ(uavcan::NodeID(0x42), dst);
+
+    // Anonymous - the discriminator must be removed
+    ASSERT_TRUE(Frame::parseAddressing(makeCanFrame((16383 << 10) | (1 << 8), "\xc0", EXT), tt, dtid, dst));
+    EXPECT_EQ(uavcan::TransferTypeMessageBroadcast, tt);
+    EXPECT_EQ(1, dtid.get());
+    EXPECT_TRUE(dst.isBroadcast());
+}
+
+TEST(Frame, CanIDTemplate)
+{
+    using uavcan::Frame;
+    using uavcan::CanFrame;
+
+    const char* const Frames[] =
+    {
+        "hello\xD4",                                      // Message
+        "\x9c",                                           // Service, tail only
+        "hello\xd4"                                       // Anonymous
+    };
+    const uint32_t CanIDs[] =
+    {
+        (16 << 24) | (20000 << 8) | 42,
+        (31 << 24) | (200 << 16) | (1 << 15) | (0x42 << 8) | (1 << 7) | 42,
+        (16383 << 10) | (1 << 8)
+    };
+
+    for (unsigned i = 0; i < (sizeof(Frames) / sizeof(Frames[0])); i++)
+    {
+        Frame frame;
+        ASSERT_TRUE(frame.parse(makeCanFrame(CanIDs[i], Frames[i], EXT)));
+
+        const uint32_t tmpl = Frame::makeCanIDTemplate(frame.getPriority(), frame.getTransferType(),
+                                                       frame.getDataTypeID(), frame.getSrcNodeID());
+        ASSERT_EQ(tmpl, frame.makeCanIDTemplate());
+        ASSERT_TRUE(tmpl & CanFrame::FlagEFF);
+        if (frame.getTransferType() != uavcan::TransferTypeMessageBroadcast)
+        {
+            ASSERT_EQ(0, tmpl & (0x7F << 8));           // Destination node ID is not a part of the template
+        }
+
+        CanFrame with_template;
+        CanFrame regular;
+        frame.compile(with_template, tmpl);
+        ASSERT_TRUE(frame.compile(regular));
+        ASSERT_EQ(regular, with_template);
+        if (frame.getSrcNodeID().isUnicast())           // Anonymous frames have a different discriminator
+        {
+            ASSERT_EQ(makeCanFrame(CanIDs[i], Frames[i], EXT), with_template);
+        }
+    }
+
+    // Same template for the next frames of a transfer
+    Frame frame(123, uavcan::TransferTypeServiceRequest, 1, 2, 3);
+    const uint32_t tmpl = frame.makeCanIDTemplate();
+    CanFrame can_frame;
+    frame.setStartOfTransfer(true);
+    frame.compile(can_frame, tmpl);
+    ASSERT_EQ(0x83, can_frame.data[can_frame.dlc - 1]);
+    frame.setStartOfTransfer(false);
+    frame.flipToggle();
+    frame.setEndOfTransfer(true);
+    frame.compile(can_frame, tmpl);
+    ASSERT_EQ(0x63, can_frame.data[can_frame.dlc - 1]);
+    ASSERT_EQ(tmpl | (2 << 8), can_frame.id);
+}
+
 TEST(Frame, FrameParsing)
 {
     using uavcan::Frame;
@@ -303,6 +395,40 @@ TEST(Frame, FrameParsing)
 }
 
 
+TEST(Frame, ParseValidityExhaustive)
+{
+    using uavcan::Frame;
+    using uavcan::CanFrame;
+
+    /*
+     * The parser has its own validity check, which must agree with isValid() for every combination
+     * of the addressing fields and the tail byte flags.
+     */
+    unsigned num_valid = 0;
+    for (unsigned service = 0; service < 2; service++)
+    {
+        for (unsigned src = 0; src <= uavcan::NodeID::Max; src++)
+        {
+            for (unsigned dst = 0; dst <= uavcan::NodeID::Max; dst++)
+            {
+                for (unsigned flags = 0; flags < 8; flags++)
+                {
+                    const uint32_t can_id = CanFrame::FlagEFF | (7U << 24) | (((src + dst) & 1U) << 15) |
+                                            (dst << 8) | (service << 7) | src;
+                    const uint8_t data[2] = { 0x55, uint8_t((flags << 5) | 17U) };
+                    Frame frame;
+                    const bool res = frame.parse(CanFrame(can_id, data, 2));
+                    ASSERT_EQ(frame.isValid(), res);
+                    num_valid += res ? 1U : 0U;
+                }
+            }
+        }
+    }
+    // Messages: anonymous only single frame, toggle set in the first frame never valid
+    // Services: the node must not be anonymous, the destination must be valid and different
+    ASSERT_EQ((127U * 128U * 6U + 1U * 128U * 1U) + (127U * 126U * 6U), num_valid);
+}
+
 TEST(Frame, RxFrameParse)
 {
     using uavcan::Frame;
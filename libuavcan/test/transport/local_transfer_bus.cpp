@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <string>
+#include <gtest/gtest.h>
+#include <uavcan/transport/local_transfer_bus.hpp>
+#include <uavcan/transport/dispatcher.hpp>
+#include <uavcan/transport/transfer_sender.hpp>
+#include "transfer_test_helpers.hpp"
+#include "can/can.hpp"
+
+
+static int sendOne(uavcan::TransferSender& sender, const std::string& data)
+{
+    return sender.send(reinterpret_cast<const uint8_t*>(data.c_str()), unsigned(data.length()),
+                       tsMono(1000000), tsMono(0), uavcan::TransferTypeMessageBroadcast, uavcan::NodeID::Broadcast);
+}
+
+static void moveTxToRx(CanDriverMock& driver)
+{
+    for (uint8_t i = 0; i < driver.getNumIfaces(); i++)
+    {
+        CanIfaceMock& iface = driver.ifaces.at(i);
+        while (!iface.tx.empty())
+        {
+            iface.rx.push(iface.tx.front());
+            iface.tx.pop();
+        }
+    }
+}
+
+TEST(LocalTransferBus, Basic)
+{
+    using uavcan::TransferTypeMessageBroadcast;
+
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 100, uavcan::MemPoolBlockSize> pool;
+
+    SystemClockMock clockmock(100);
+    CanDriverMock driver(1, clockmock);
+
+    uavcan::Dispatcher dispatcher_a(driver, pool, clockmock);
+    uavcan::Dispatcher dispatcher_b(driver, pool, clockmock);
+    uavcan::Dispatcher dispatcher_remote(driver, pool, clockmock);
+    ASSERT_TRUE(dispatcher_a.setNodeID(10));
+    ASSERT_TRUE(dispatcher_b.setNodeID(11));
+    ASSERT_TRUE(dispatcher_remote.setNodeID(50));
+
+    const uavcan::DataTypeDescriptor type = makeDataType(uavcan::DataTypeKindMessage, 1);
+    const uavcan::DataTypeDescriptor other_type = makeDataType(uavcan::DataTypeKindMessage, 2);
+
+    uavcan::TransferSender sender(dispatcher_a, type, uavcan::CanTxQueue::Volatile);
+    uavcan::TransferSender other_sender(dispatcher_a, other_type, uavcan::CanTxQueue::Volatile);
+    uavcan::TransferSender remote_sender(dispatcher_remote, type, uavcan::CanTxQueue::Volatile);
+    sender.setPriority(20);
+
+    TestListener listener_a(dispatcher_a.getTransferPerfCounter(), type, 512, pool);
+    TestListener listener_b(dispatcher_b.getTransferPerfCounter(), type, 512, pool);
+    TestListener listener_b_short(dispatcher_b.getTransferPerfCounter(), type, 7, pool);
+    TestListener listener_b_other(dispatcher_b.getTransferPerfCounter(), other_type, 512, pool);
+    ASSERT_TRUE(dispatcher_a.registerMessageListener(&listener_a));
+    ASSERT_TRUE(dispatcher_b.registerMessageListener(&listener_b));
+    ASSERT_TRUE(dispatcher_b.registerMessageListener(&listener_b_short));
+    ASSERT_TRUE(dispatcher_b.registerMessageListener(&listener_b_other));
+
+    const std::string long_payload(300, 'x');
+
+    {
+        uavcan::LocalTransferBus bus;
+        ASSERT_EQ(0, bus.addDispatcher(dispatcher_a));
+        ASSERT_EQ(0, bus.addDispatcher(dispatcher_b));
+        ASSERT_EQ(0, bus.addDispatcher(dispatcher_b));              // Already connected
+        EXPECT_EQ(2, bus.getNumDispatchers());
+        EXPECT_EQ(&bus, dispatcher_a.getLocalTransferBus());
+
+        uavcan::LocalTransferBus another_bus;
+        EXPECT_EQ(-uavcan::ErrInvalidParam, another_bus.addDispatcher(dispatcher_a));
+
+        // Disabled by default - nothing is delivered locally
+        ASSERT_LT(0, sendOne(sender, "123"));
+        EXPECT_TRUE(listener_b.isEmpty());
+
+        ASSERT_EQ(0, bus.enableDataType(type.getID()));
+        ASSERT_EQ(0, bus.enableDataType(type.getID()));
+        EXPECT_EQ(1, bus.getNumEnabledDataTypes());
+        EXPECT_TRUE(bus.isDataTypeEnabled(type.getID()));
+        EXPECT_FALSE(bus.isDataTypeEnabled(other_type.getID()));
+
+        /*
+         * Local delivery; the origin doesn't receive its own messages
+         */
+        ASSERT_LT(0, sendOne(sender, "456"));
+        ASSERT_LT(0, sendOne(sender, long_payload));
+        ASSERT_LT(0, sendOne(other_sender, "789"));
+
+        ASSERT_TRUE(listener_b.matchAndPop(Transfer(100, 100, 20, TransferTypeMessageBroadcast, 1, 10, 0, "456",
+                                                    type)));
+        ASSERT_TRUE(listener_b.matchAndPop(Transfer(100, 100, 20, TransferTypeMessageBroadcast, 2, 10, 0,
+                                                    long_payload, type)));
+        EXPECT_TRUE(listener_b.isEmpty());
+        ASSERT_TRUE(listener_b_short.matchAndPop(Transfer(100, 100, 20, TransferTypeMessageBroadcast, 1, 10, 0,
+                                                          "456", type)));
+        EXPECT_TRUE(listener_b_short.isEmpty());                    // Too long for the buffer
+        EXPECT_TRUE(listener_b_other.isEmpty());
+        EXPECT_TRUE(listener_a.isEmpty());
+        EXPECT_EQ(2, bus.getNumLocalTransfers());
+
+        /*
+         * The frames still go to the bus; they are dropped by the connected dispatchers,
+         * except the frames of the data types that are not delivered locally
+         */
+        const unsigned num_frames = unsigned(driver.ifaces.at(0).tx.size());
+        EXPECT_LT(4U, num_frames);
+        moveTxToRx(driver);
+        while (dispatcher_b.spin(tsMono(0)) > 0) { }
+        EXPECT_TRUE(listener_b.isEmpty());
+        EXPECT_TRUE(listener_b_short.isEmpty());
+        EXPECT_EQ(1, listener_b_other.getNumReceivedTransfers());
+        EXPECT_EQ(num_frames - 1U, bus.getNumSuppressedFrames());   // Only "789"; the data type decides
+
+        /*
+         * Frames from the other nodes are received as usual
+         */
+        ASSERT_LT(0, sendOne(remote_sender, "abc"));
+        moveTxToRx(driver);
+        while (dispatcher_b.spin(tsMono(0)) > 0) { }
+        ASSERT_TRUE(listener_b.matchAndPop(Transfer(1000000, 0, uavcan::TransferPriority::Default,
+                                                    TransferTypeMessageBroadcast, 0, 50, 0, "abc", type)));
+        EXPECT_EQ(num_frames - 1U, bus.getNumSuppressedFrames());
+
+        bus.disableDataType(type.getID());
+        EXPECT_FALSE(bus.isDataTypeEnabled(type.getID()));
+        ASSERT_LT(0, sendOne(sender, "def"));
+        EXPECT_TRUE(listener_b.isEmpty());
+        driver.ifaces.at(0).tx = std::queue<CanIfaceMock::FrameWithTime>();
+    }
+
+    // The bus disconnects the dispatchers when destroyed
+    EXPECT_FALSE(dispatcher_a.getLocalTransferBus());
+    EXPECT_FALSE(dispatcher_b.getLocalTransferBus());
+}
+
+TEST(LocalTransferBus, Capacity)
+{
+    uavcan::LocalTransferBus bus;
+    for (unsigned i = 0; i < uavcan::LocalTransferBus::MaxDataTypes; i++)
+    {
+        ASSERT_EQ(0, bus.enableDataType(uavcan::DataTypeID(uavcan::uint16_t(i))));
+    }
+    EXPECT_EQ(-uavcan::ErrMemory, bus.enableDataType(uavcan::DataTypeID(1000)));
+    bus.disableDataType(uavcan::DataTypeID(0));
+    EXPECT_EQ(0, bus.enableDataType(uavcan::DataTypeID(1000)));
+    EXPECT_TRUE(bus.isDataTypeEnabled(uavcan::DataTypeID(1000)));
+    EXPECT_FALSE(bus.isDataTypeEnabled(uavcan::DataTypeID(0)));
+
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 8, uavcan::MemPoolBlockSize> pool;
+    SystemClockMock clockmock;
+    CanDriverMock driver(1, clockmock);
+    {
+        uavcan::Dispatcher dispatcher(driver, pool, clockmock);
+        ASSERT_EQ(0, bus.addDispatcher(dispatcher));
+        EXPECT_EQ(1, bus.getNumDispatchers());
+    }
+    EXPECT_EQ(0, bus.getNumDispatchers());      // Removed by the destructor of the dispatcher
+}
@@ -12,7 +12,9 @@
 TEST(OutgoingTransferRegistry, Basic)
 {
     using uavcan::OutgoingTransferRegistryKey;
-    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 2, uavcan::MemPoolBlockSize> poolmgr;
+    // Room for exactly four entries; the hashed registry stores one entry per block
+    static const unsigned NumBlocks = (uavcan::OutgoingTransferRegistryNumBuckets > 0) ? 4 : 2;
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * NumBlocks, uavcan::MemPoolBlockSize> poolmgr;
     uavcan::OutgoingTransferRegistry otr(poolmgr);
 
     otr.cleanup(tsMono(1000));
@@ -88,3 +90,105 @@ TEST(OutgoingTransferRegistry, Basic)
     otr.cleanup(tsMono(5000001));    // Frees some memory for 4
     ASSERT_EQ(0, otr.accessOrCreate(keys[0], tsMono(1000000))->get());
 }
+
+
+TEST(OutgoingTransferRegistry, ManyPeers)
+{
+    using uavcan::OutgoingTransferRegistryKey;
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 256, uavcan::MemPoolBlockSize> poolmgr;
+    uavcan::OutgoingTransferRegistry otr(poolmgr);
+
+    static const unsigned NumPeers = 100;
+    static const unsigned NumTypes = 2;
+
+    for (unsigned type = 0; type < NumTypes; type++)
+    {
+        for (unsigned peer = 1; peer <= NumPeers; peer++)
+        {
+            const OutgoingTransferRegistryKey key(uavcan::DataTypeID(uavcan::uint16_t(100 + type)),
+                                                  uavcan::TransferTypeServiceRequest,
+                                                  uavcan::NodeID(uavcan::uint8_t(peer)));
+            uavcan::TransferID* const tid = otr.accessOrCreate(key, tsMono(1000000 + peer * 1000));
+            ASSERT_TRUE(tid);
+            for (unsigned i = 0; i < (peer + type) % 8; i++)
+            {
+                tid->increment();
+            }
+        }
+    }
+    const unsigned used_blocks = poolmgr.getNumUsedBlocks();
+
+    // Entries are distinct
+    for (unsigned type = 0; type < NumTypes; type++)
+    {
+        for (unsigned peer = 1; peer <= NumPeers; peer++)
+        {
+            const OutgoingTransferRegistryKey key(uavcan::DataTypeID(uavcan::uint16_t(100 + type)),
+                                                  uavcan::TransferTypeServiceRequest,
+                                                  uavcan::NodeID(uavcan::uint8_t(peer)));
+            ASSERT_EQ((peer + type) % 8, otr.accessOrCreate(key, tsMono(1000000 + peer * 1000))->get());
+        }
+    }
+    ASSERT_EQ(used_blocks, poolmgr.getNumUsedBlocks());
+
+    // Nothing expires before the earliest deadline
+    otr.cleanup(tsMono(1000999));
+    ASSERT_EQ(used_blocks, poolmgr.getNumUsedBlocks());
+
+    // Expiring the first half of the peers
+    otr.cleanup(tsMono(1000000 + NumPeers / 2 * 1000));
+    for (unsigned peer = 1; peer <= NumPeers; peer++)
+    {
+        const OutgoingTransferRegistryKey key(100, uavcan::TransferTypeServiceRequest,
+                                              uavcan::NodeID(uavcan::uint8_t(peer)));
+        const unsigned expected_tid = (peer <= NumPeers / 2) ? 0 : (peer % 8);
+        ASSERT_EQ(expected_tid, otr.accessOrCreate(key, tsMono(1000000 + peer * 1000))->get());
+    }
+
+    // Extending a deadline keeps the entry alive
+    const OutgoingTransferRegistryKey extended(101, uavcan::TransferTypeServiceRequest, NumPeers);
+    otr.accessOrCreate(extended, tsMono(9000000));
+    otr.cleanup(tsMono(2000000));
+    ASSERT_EQ((NumPeers + 1) % 8, otr.accessOrCreate(extended, tsMono(9000000))->get());
+    ASSERT_TRUE(otr.exists(101, uavcan::TransferTypeServiceRequest));
+    ASSERT_FALSE(otr.exists(100, uavcan::TransferTypeServiceRequest));
+
+    otr.cleanup(tsMono(9000000));
+    ASSERT_EQ(0, poolmgr.getNumUsedBlocks());
+}
+
+
+TEST(OutgoingTransferRegistry, EntryCache)
+{
+    using uavcan::OutgoingTransferRegistryKey;
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 8, uavcan::MemPoolBlockSize> poolmgr;
+    uavcan::OutgoingTransferRegistry otr(poolmgr);
+
+    const OutgoingTransferRegistryKey key(123, uavcan::TransferTypeMessageBroadcast, uavcan::NodeID::Broadcast);
+    const OutgoingTransferRegistryKey other(456, uavcan::TransferTypeMessageBroadcast, uavcan::NodeID::Broadcast);
+    uavcan::OutgoingTransferRegistry::EntryCache cache;
+
+    uavcan::TransferID* const tid = otr.accessOrCreate(key, tsMono(1000000), cache);
+    ASSERT_TRUE(tid);
+    tid->increment();
+
+    // Cached and uncached accesses refer to the same entry
+    ASSERT_EQ(tid, otr.accessOrCreate(key, tsMono(2000000), cache));
+    ASSERT_EQ(tid, otr.accessOrCreate(key, tsMono(2000000)));
+    ASSERT_EQ(1, tid->get());
+
+    // The deadline is updated via the cache as well
+    otr.accessOrCreate(other, tsMono(1000000))->increment();
+    otr.cleanup(tsMono(1500000));
+    ASSERT_TRUE(otr.exists(123, uavcan::TransferTypeMessageBroadcast));
+    ASSERT_FALSE(otr.exists(456, uavcan::TransferTypeMessageBroadcast));
+
+    // The cache has been invalidated by the cleanup, the entry is looked up again
+    ASSERT_EQ(1, otr.accessOrCreate(key, tsMono(3000000), cache)->get());
+
+    // Once the entry expires, the cache must not be used anymore
+    otr.cleanup(tsMono(3000000));
+    ASSERT_EQ(0, poolmgr.getNumUsedBlocks());
+    ASSERT_EQ(0, otr.accessOrCreate(key, tsMono(4000000), cache)->get());
+    ASSERT_EQ(otr.accessOrCreate(key, tsMono(4000000)), otr.accessOrCreate(key, tsMono(4000000), cache));
+}
@@ -0,0 +1,429 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <gtest/gtest.h>
+#include <uavcan/transport/perf_counter.hpp>
+#include <uavcan/transport/dispatcher.hpp>
+#include "can/can.hpp"
+
+
+#if !UAVCAN_TINY
+
+TEST(LatencyHistogram, Basic)
+{
+    using uavcan::LatencyHistogram;
+    using uavcan::MonotonicDuration;
+
+    ASSERT_EQ(0, LatencyHistogram::getBucketIndex(0));
+    ASSERT_EQ(0, LatencyHistogram::getBucketIndex(1));
+    ASSERT_EQ(1, LatencyHistogram::getBucketIndex(2));
+    ASSERT_EQ(1, LatencyHistogram::getBucketIndex(3));
+    ASSERT_EQ(2, LatencyHistogram::getBucketIndex(4));
+    ASSERT_EQ(9, LatencyHistogram::getBucketIndex(1000));
+    ASSERT_EQ(14, LatencyHistogram::getBucketIndex(32767));
+    ASSERT_EQ(15, LatencyHistogram::getBucketIndex(32768));
+    ASSERT_EQ(15, LatencyHistogram::getBucketIndex(0xFFFFFFFFU));  // Last bucket is open-ended
+
+    ASSERT_EQ(0, LatencyHistogram::getBucketLowerBoundUSec(0));
+    ASSERT_EQ(2, LatencyHistogram::getBucketLowerBoundUSec(1));
+    ASSERT_EQ(32768, LatencyHistogram::getBucketLowerBoundUSec(15));
+
+    LatencyHistogram hist;
+    ASSERT_EQ(0, hist.getNumSamples());
+    ASSERT_EQ(0, hist.getMeanUSec());
+    ASSERT_EQ(0, hist.getMaxUSec());
+
+    hist.add(MonotonicDuration::fromUSec(-10));        // Counted as zero
+    hist.add(MonotonicDuration::fromUSec(100));
+    hist.add(MonotonicDuration::fromUSec(120));
+    hist.add(MonotonicDuration::fromMSec(100));
+    hist.add(MonotonicDuration::fromUSec(1LL << 40));  // Saturated
+
+    ASSERT_EQ(5, hist.getNumSamples());
+    ASSERT_EQ(1, hist.getBucketCount(0));
+    ASSERT_EQ(2, hist.getBucketCount(6));
+    ASSERT_EQ(2, hist.getBucketCount(15));
+    ASSERT_EQ(0, hist.getBucketCount(16));             // Out of range
+    ASSERT_EQ(0xFFFFFFFFU, hist.getMaxUSec());
+    ASSERT_EQ((0ULL + 100 + 120 + 100000 + 0xFFFFFFFFULL) / 5, hist.getMeanUSec());
+
+    unsigned total = 0;
+    for (unsigned i = 0; i < LatencyHistogram::NumBuckets; i++)
+    {
+        total += hist.getBucketCount(i);
+    }
+    ASSERT_EQ(hist.getNumSamples(), total);
+
+    hist.reset();
+    ASSERT_EQ(0, hist.getNumSamples());
+    ASSERT_EQ(0, hist.getBucketCount(6));
+    ASSERT_EQ(0, hist.getMaxUSec());
+}
+
+#endif
+
+#if UAVCAN_LATENCY_STATS
+
+TEST(TransferPerfCounter, LatencySampling)
+{
+    SystemClockMock clockmock(1000000);
+    uavcan::TransferPerfCounter perf;
+
+    // No clock - no samples
+    perf.sampleLatency(uavcan::LatencyStageRxDriverToTransfer, uavcan::MonotonicTime::fromUSec(999000));
+    ASSERT_EQ(0, perf.getLatencyHistogram(uavcan::LatencyStageRxDriverToTransfer).getNumSamples());
+
+    perf.setSystemClock(&clockmock);
+    perf.sampleLatency(uavcan::LatencyStageRxDriverToTransfer, uavcan::MonotonicTime::fromUSec(999000));
+    perf.sampleLatency(uavcan::LatencyStageRxDriverToTransfer, uavcan::MonotonicTime());  // Not timestamped
+    perf.sampleLatency(uavcan::LatencyStageTxPublishToTransport, uavcan::MonotonicTime::fromUSec(999990));
+
+    const uavcan::LatencyHistogram& rx = perf.getLatencyHistogram(uavcan::LatencyStageRxDriverToTransfer);
+    ASSERT_EQ(1, rx.getNumSamples());
+    ASSERT_EQ(1000, rx.getMaxUSec());
+    ASSERT_EQ(1, rx.getBucketCount(9));
+
+    const uavcan::LatencyHistogram& tx = perf.getLatencyHistogram(uavcan::LatencyStageTxPublishToTransport);
+    ASSERT_EQ(1, tx.getNumSamples());
+    ASSERT_EQ(10, tx.getMaxUSec());
+
+    ASSERT_EQ(0, perf.getLatencyHistogram(uavcan::LatencyStageRxDriverToCallback).getNumSamples());
+}
+
+TEST(TransferPerfCounter, TxTransportToDriver)
+{
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 16, uavcan::MemPoolBlockSize> pool;
+    SystemClockMock clockmock(1000000);
+    CanDriverMock driver(1, clockmock);
+    uavcan::CanIOManager iomgr(driver, pool, clockmock);
+
+    uavcan::TransferPerfCounter perf;
+    perf.setSystemClock(&clockmock);
+    iomgr.setTransferPerfCounter(&perf);
+
+    const uavcan::LatencyHistogram& hist = perf.getLatencyHistogram(uavcan::LatencyStageTxTransportToDriver);
+    const uavcan::MonotonicTime tx_deadline = clockmock.getMonotonic() + uavcan::MonotonicDuration::fromMSec(100);
+
+    // Accepted by the driver right away
+    ASSERT_EQ(1, iomgr.send(makeCanFrame(1, "a", EXT), tx_deadline, uavcan::MonotonicTime(), 1,
+                            uavcan::CanTxQueue::Volatile, 0));
+    ASSERT_EQ(1, hist.getNumSamples());
+    ASSERT_EQ(0, hist.getMaxUSec());
+
+    // Queued, then sent 5 ms later
+    driver.ifaces.at(0).writeable = false;
+    ASSERT_EQ(0, iomgr.send(makeCanFrame(2, "b", EXT), tx_deadline, uavcan::MonotonicTime(), 1,
+                            uavcan::CanTxQueue::Volatile, 0));
+    ASSERT_EQ(1, hist.getNumSamples());
+
+    clockmock.advance(5000);
+    driver.ifaces.at(0).writeable = true;
+    uavcan::CanRxFrame frame;
+    uavcan::CanIOFlags flags = 0;
+    ASSERT_EQ(0, iomgr.receive(frame, clockmock.getMonotonic(), flags));  // Flushes the queue
+    ASSERT_EQ(2, hist.getNumSamples());
+    ASSERT_EQ(5000, hist.getMaxUSec());
+    ASSERT_EQ(1, hist.getBucketCount(12));
+}
+
+#endif
+
+#if UAVCAN_DATA_TYPE_PERF_STATS
+
+TEST(DataTypePerfCounters, Basic)
+{
+    using uavcan::DataTypePerfCounters;
+    using uavcan::DataTypeKindMessage;
+    using uavcan::DataTypeKindService;
+
+    DataTypePerfCounters perf;
+    ASSERT_EQ(0, perf.getNumUsedEntries());
+    ASSERT_FALSE(perf.find(DataTypeKindMessage, 341));
+
+    perf.addRxFrame(DataTypeKindMessage, 341, 8);
+    perf.addRxFrame(DataTypeKindMessage, 341, 3);
+    perf.addRxTransfer(DataTypeKindMessage, 341);
+    perf.addTxFrame(DataTypeKindService, 341, 5);       // Same ID, different kind
+    perf.addTxErrors(DataTypeKindService, 341, 2);
+    ASSERT_EQ(2, perf.getNumUsedEntries());
+
+    const DataTypePerfCounters::Entry* msg = perf.find(DataTypeKindMessage, 341);
+    ASSERT_TRUE(msg);
+    ASSERT_EQ(uavcan::DataTypeID(341), msg->getDataTypeID());
+    ASSERT_EQ(DataTypeKindMessage, msg->getDataTypeKind());
+    ASSERT_EQ(2, msg->rx.frames);
+    ASSERT_EQ(11, msg->rx.bytes);
+    ASSERT_EQ(1, msg->rx.transfers);
+    ASSERT_EQ(0, msg->rx.errors);
+    ASSERT_EQ(0, msg->tx.frames);
+
+    const DataTypePerfCounters::Entry* srv = perf.find(DataTypeKindService, 341);
+    ASSERT_TRUE(srv);
+    ASSERT_NE(msg, srv);
+    ASSERT_EQ(DataTypeKindService, srv->getDataTypeKind());
+    ASSERT_EQ(1, srv->tx.frames);
+    ASSERT_EQ(5, srv->tx.bytes);
+    ASSERT_EQ(2, srv->tx.errors);
+    ASSERT_EQ(0, srv->rx.frames);
+
+    /*
+     * Filling the table; the slots never move
+     */
+    for (unsigned i = 0; i < DataTypePerfCounters::Capacity * 2U; i++)
+    {
+        perf.addRxFrame(DataTypeKindMessage, uavcan::DataTypeID(uint16_t(1000U + i)), 1);
+    }
+    ASSERT_EQ(DataTypePerfCounters::Capacity, perf.getNumUsedEntries());
+    ASSERT_EQ(msg, perf.find(DataTypeKindMessage, 341));
+    ASSERT_EQ(srv, perf.find(DataTypeKindService, 341));
+    ASSERT_EQ(DataTypePerfCounters::Capacity * 2U - (DataTypePerfCounters::Capacity - 2U),
+              perf.getOverflowEntry().rx.frames);
+    ASSERT_FALSE(perf.getOverflowEntry().isUsed());
+
+    unsigned num_visited = 0;
+    uint32_t total_frames = 0;
+    for (unsigned i = 0; i < DataTypePerfCounters::Capacity; i++)
+    {
+        const DataTypePerfCounters::Entry& e = perf.getEntry(i);
+        ASSERT_TRUE(e.isUsed());
+        ASSERT_EQ(&e, perf.find(e.getDataTypeKind(), e.getDataTypeID()));
+        num_visited++;
+        total_frames += e.rx.frames + e.tx.frames;
+    }
+    ASSERT_EQ(DataTypePerfCounters::Capacity, num_visited);
+    ASSERT_EQ(3 + DataTypePerfCounters::Capacity - 2U, total_frames);
+}
+
+TEST(TransferPerfCounter, DataTypes)
+{
+    uavcan::TransferPerfCounter perf;
+
+    perf.addRxTransfer(uavcan::DataTypeKindMessage, 1);
+    perf.addRxErrors(uavcan::DataTypeKindMessage, 1, 0);    // Zero errors don't allocate a slot
+    perf.addRxErrors(uavcan::DataTypeKindMessage, 2, 0);
+    perf.addRxErrors(uavcan::DataTypeKindMessage, 1, 3);
+    perf.addTxTransfer(uavcan::DataTypeKindService, 1);
+    perf.addTxError(uavcan::DataTypeKindService, 1);
+
+    // Aggregate counters are updated as well
+    ASSERT_EQ(1, perf.getRxTransferCount());
+    ASSERT_EQ(1, perf.getTxTransferCount());
+    ASSERT_EQ(4, perf.getErrorCount());
+
+    const uavcan::DataTypePerfCounters& dt = perf.getDataTypePerfCounters();
+    ASSERT_EQ(2, dt.getNumUsedEntries());
+    ASSERT_FALSE(dt.find(uavcan::DataTypeKindMessage, 2));
+    ASSERT_EQ(1, dt.find(uavcan::DataTypeKindMessage, 1)->rx.transfers);
+    ASSERT_EQ(3, dt.find(uavcan::DataTypeKindMessage, 1)->rx.errors);
+    ASSERT_EQ(1, dt.find(uavcan::DataTypeKindService, 1)->tx.transfers);
+    ASSERT_EQ(1, dt.find(uavcan::DataTypeKindService, 1)->tx.errors);
+}
+
+#endif
+
+#if !UAVCAN_TINY
+
+TEST(ExecutionTimeHistogram, Basic)
+{
+    using uavcan::ExecutionTimeHistogram;
+
+    ASSERT_EQ(0, ExecutionTimeHistogram::getBucketIndex(0));
+    ASSERT_EQ(6, ExecutionTimeHistogram::getBucketIndex(100));
+    ASSERT_EQ(23, ExecutionTimeHistogram::getBucketIndex(1U << 23));
+    ASSERT_EQ(23, ExecutionTimeHistogram::getBucketIndex(0xFFFFFFFFU));    // Last bucket is open-ended
+    ASSERT_EQ(64, ExecutionTimeHistogram::getBucketLowerBound(6));
+
+    ExecutionTimeHistogram hist;
+    hist.add(100);
+    hist.add(120);
+    hist.add(10000000);
+
+    ASSERT_EQ(3, hist.getNumSamples());
+    ASSERT_EQ(2, hist.getBucketCount(6));
+    ASSERT_EQ(1, hist.getBucketCount(23));
+    ASSERT_EQ(0, hist.getBucketCount(24));                                 // Out of range
+    ASSERT_EQ(10000000, hist.getMaxCycles());
+    ASSERT_EQ((100 + 120 + 10000000) / 3, hist.getMeanCycles());
+
+    hist.reset();
+    ASSERT_EQ(0, hist.getNumSamples());
+    ASSERT_EQ(0, hist.getMaxCycles());
+}
+
+TEST(DutyCycleCounter, Basic)
+{
+    using uavcan::DutyCycleCounter;
+    using uavcan::MonotonicDuration;
+
+    SystemClockMock clockmock(1000000);
+    DutyCycleCounter counter;
+    counter.setWindow(MonotonicDuration::fromMSec(100));
+    ASSERT_EQ(100, counter.getWindow().toMSec());
+    counter.setWindow(MonotonicDuration::fromMSec(1));
+    ASSERT_EQ(DutyCycleCounter::getMinWindow(), counter.getWindow());
+    counter.setWindow(MonotonicDuration::fromMSec(100));
+
+    // No clock - nothing is measured, but the categories are tracked
+    uint8_t prev = counter.enter(uavcan::DutyCycleCategoryRx);
+    ASSERT_EQ(uavcan::DutyCycleCategoryRx, counter.getCurrentCategory());
+    counter.leave(prev);
+    ASSERT_EQ(uavcan::DutyCycleCategoryNone, counter.getCurrentCategory());
+    ASSERT_EQ(0, counter.getLastWindowDuration().toUSec());
+
+    counter.setSystemClock(&clockmock);
+
+    // The window starts upon the first transition
+    prev = counter.enter(uavcan::DutyCycleCategoryRx);                  // 10 ms RX
+    clockmock.advance(5000);
+    {
+        const uint8_t nested = counter.enter(uavcan::DutyCycleCategoryCallbacks);   // 5 ms callbacks inside RX
+        clockmock.advance(3000);
+        {
+            const uint8_t nested2 = counter.enter(uavcan::DutyCycleCategoryTx);      // 2 ms TX inside callbacks
+            clockmock.advance(2000);
+            counter.leave(nested2);
+        }
+        counter.leave(nested);
+    }
+    clockmock.advance(5000);
+    counter.leave(prev);
+
+    clockmock.advance(20000);                                           // 20 ms idle, not accounted
+    prev = counter.enter(uavcan::DutyCycleCategoryDeadlineHandlers);
+    clockmock.advance(1000);
+    counter.leave(prev);
+    ASSERT_EQ(0, counter.getLastWindowDuration().toUSec());             // Not closed yet
+
+    clockmock.advance(80000);                                           // The window is closed upon a transition
+    prev = counter.enter(uavcan::DutyCycleCategoryTx);
+    ASSERT_EQ(116000, counter.getLastWindowDuration().toUSec());
+    ASSERT_EQ(10000, counter.getBusyTime(uavcan::DutyCycleCategoryRx).toUSec());
+    ASSERT_EQ(3000, counter.getBusyTime(uavcan::DutyCycleCategoryCallbacks).toUSec());
+    ASSERT_EQ(2000, counter.getBusyTime(uavcan::DutyCycleCategoryTx).toUSec());
+    ASSERT_EQ(1000, counter.getBusyTime(uavcan::DutyCycleCategoryDeadlineHandlers).toUSec());
+    ASSERT_EQ(86, counter.getDutyCyclePermille(uavcan::DutyCycleCategoryRx));             // 10 / 116
+    ASSERT_EQ(137, counter.getTotalDutyCyclePermille());                                  // 16 / 116
+    ASSERT_EQ(0, counter.getDutyCyclePermille(uavcan::DutyCycleCategoryNone));
+
+    // Fully loaded window
+    clockmock.advance(150000);
+    counter.leave(prev);
+    ASSERT_EQ(150000, counter.getLastWindowDuration().toUSec());
+    ASSERT_EQ(1000, counter.getTotalDutyCyclePermille());
+    ASSERT_EQ(1000, counter.getDutyCyclePermille(uavcan::DutyCycleCategoryTx));
+    ASSERT_EQ(0, counter.getDutyCyclePermille(uavcan::DutyCycleCategoryRx));
+
+    counter.reset();
+    ASSERT_EQ(0, counter.getLastWindowDuration().toUSec());
+    ASSERT_EQ(0, counter.getTotalDutyCyclePermille());
+    ASSERT_EQ(100, counter.getWindow().toMSec());
+}
+
+#endif
+
+#if UAVCAN_EXECUTION_TIME_STATS
+
+class CycleCounterMock : public uavcan::ICycleCounter
+{
+public:
+    mutable uint32_t cycles;
+    uint32_t cycles_per_reading;
+
+    CycleCounterMock(uint32_t initial, uint32_t per_reading)
+        : cycles(initial)
+        , cycles_per_reading(per_reading)
+    { }
+
+    virtual uint32_t getCycleCount() const
+    {
+        const uint32_t res = cycles;
+        cycles += cycles_per_reading;
+        return res;
+    }
+};
+
+TEST(TransferPerfCounter, ExecutionTimeSampling)
+{
+    uavcan::TransferPerfCounter perf;
+    const uavcan::ExecutionTimeHistogram& hist = perf.getExecutionTimeHistogram(uavcan::ExecutionStageRxFrame);
+
+    // No cycle counter - no samples
+    {
+        uavcan::ExecutionTimeScope scope(&perf, uavcan::ExecutionStageRxFrame);
+    }
+    ASSERT_EQ(0, hist.getNumSamples());
+
+    // The counter wraps around in the middle of the scope
+    CycleCounterMock cycle_counter(0xFFFFFFF0U, 100);
+    perf.setCycleCounter(&cycle_counter);
+    {
+        uavcan::ExecutionTimeScope scope(&perf, uavcan::ExecutionStageRxFrame);
+    }
+    ASSERT_EQ(1, hist.getNumSamples());
+    ASSERT_EQ(100, hist.getMaxCycles());
+
+    // Null pointer disables sampling
+    {
+        uavcan::ExecutionTimeScope scope(NULL, uavcan::ExecutionStageRxFrame);
+    }
+    ASSERT_EQ(1, hist.getNumSamples());
+    ASSERT_EQ(0, perf.getExecutionTimeHistogram(uavcan::ExecutionStageTxSend).getNumSamples());
+}
+
+TEST(TransferPerfCounter, ExecutionTimeStages)
+{
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 16, uavcan::MemPoolBlockSize> pool;
+    SystemClockMock clockmock(1000000);
+    CanDriverMock driver(1, clockmock);
+    uavcan::Dispatcher dispatcher(driver, pool, clockmock);
+
+    CycleCounterMock cycle_counter(0, 10);
+    dispatcher.getTransferPerfCounter().setCycleCounter(&cycle_counter);
+    const uavcan::TransferPerfCounter& perf = dispatcher.getTransferPerfCounter();
+
+    // Every received frame is sampled, even if there are no listeners
+    driver.ifaces.at(0).pushRx(makeCanFrame(1, "a", EXT));
+    ASSERT_LE(0, dispatcher.spinOnce());
+    ASSERT_EQ(1, perf.getExecutionTimeHistogram(uavcan::ExecutionStageRxLookup).getNumSamples());
+    ASSERT_EQ(1, perf.getExecutionTimeHistogram(uavcan::ExecutionStageRxFrame).getNumSamples());
+    ASSERT_LT(perf.getExecutionTimeHistogram(uavcan::ExecutionStageRxLookup).getMaxCycles(),
+              perf.getExecutionTimeHistogram(uavcan::ExecutionStageRxFrame).getMaxCycles());
+
+    ASSERT_EQ(1, dispatcher.getCanIOManager().send(makeCanFrame(1, "b", EXT),
+                                                   clockmock.getMonotonic() + uavcan::MonotonicDuration::fromMSec(10),
+                                                   uavcan::MonotonicTime(), 1, uavcan::CanTxQueue::Volatile, 0));
+    ASSERT_EQ(1, perf.getExecutionTimeHistogram(uavcan::ExecutionStageTxSend).getNumSamples());
+}
+
+#endif
+
+#if UAVCAN_DUTY_CYCLE_STATS
+
+TEST(TransferPerfCounter, DutyCycleStages)
+{
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 16, uavcan::MemPoolBlockSize> pool;
+    SystemClockMock clockmock(1000000);
+    CanDriverMock driver(1, clockmock);
+    uavcan::Dispatcher dispatcher(driver, pool, clockmock);
+
+    uavcan::DutyCycleCounter& counter = dispatcher.getTransferPerfCounter().getDutyCycleCounter();
+    counter.setWindow(uavcan::MonotonicDuration::fromMSec(10));
+    clockmock.monotonic_auto_advance = 100;         // Every clock reading takes 100 usec
+
+    driver.ifaces.at(0).pushRx(makeCanFrame(1, "a", EXT));
+    ASSERT_LE(0, dispatcher.spinOnce());
+    ASSERT_EQ(1, dispatcher.getCanIOManager().send(makeCanFrame(1, "b", EXT),
+                                                   clockmock.getMonotonic() + uavcan::MonotonicDuration::fromMSec(10),
+                                                   uavcan::MonotonicTime(), 1, uavcan::CanTxQueue::Volatile, 0));
+    ASSERT_EQ(uavcan::DutyCycleCategoryNone, counter.getCurrentCategory());
+
+    // Waiting for IO is not accounted
+    ASSERT_LE(0, dispatcher.spin(clockmock.getMonotonic() + uavcan::MonotonicDuration::fromMSec(20)));
+    ASSERT_LE(10000, counter.getLastWindowDuration().toUSec());
+    ASSERT_LT(0, counter.getBusyTime(uavcan::DutyCycleCategoryRx).toUSec());
+    ASSERT_LT(0, counter.getBusyTime(uavcan::DutyCycleCategoryTx).toUSec());
+    ASSERT_GT(500, counter.getTotalDutyCyclePermille());
+}
+
+#endif
@@ -0,0 +1,231 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <vector>
+#include <gtest/gtest.h>
+#include "transfer_test_helpers.hpp"
+#include "can/can.hpp"
+#include <uavcan/transport/dispatcher.hpp>
+#include <uavcan/transport/reassembly_table.hpp>
+
+
+class ReassemblyTableTransferEmulator : public IncomingTransferEmulatorBase
+{
+    CanDriverMock& target_;
+
+public:
+    ReassemblyTableTransferEmulator(CanDriverMock& target, uavcan::NodeID dst_node_id)
+        : IncomingTransferEmulatorBase(dst_node_id)
+        , target_(target)
+    { }
+
+    void sendOneFrame(const uavcan::RxFrame& frame)
+    {
+        CanIfaceMock* const iface = static_cast<CanIfaceMock*>(target_.getIface(frame.getIfaceIndex()));
+        EXPECT_TRUE(iface);
+        if (iface)
+        {
+            iface->pushRx(frame);
+        }
+    }
+};
+
+static const uavcan::NodeID SELF_NODE_ID(64);
+
+static const std::string MFT_PAYLOAD = "The reassembly buffers are allocated from the quota of the table";
+
+
+TEST(ReassemblyTable, Basic)
+{
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 100, uavcan::MemPoolBlockSize> pool;
+
+    SystemClockMock clockmock(100);
+    CanDriverMock driver(2, clockmock);
+
+    uavcan::Dispatcher dispatcher(driver, pool, clockmock);
+    ASSERT_TRUE(dispatcher.setNodeID(SELF_NODE_ID));
+
+    ReassemblyTableTransferEmulator emulator(driver, SELF_NODE_ID);
+
+    static const uavcan::DataTypeDescriptor TYPES[2] =
+    {
+        makeDataType(uavcan::DataTypeKindMessage, 1),
+        makeDataType(uavcan::DataTypeKindMessage, 2)
+    };
+    TestListener sub_a(dispatcher.getTransferPerfCounter(), TYPES[0], 256, pool);
+    TestListener sub_b(dispatcher.getTransferPerfCounter(), TYPES[1], 256, pool);
+    ASSERT_TRUE(dispatcher.registerMessageListener(&sub_a));
+
+    uavcan::ReassemblyTable table(pool, 50);
+    ASSERT_EQ(50, table.getMaxBlocks());
+    dispatcher.installReassemblyTable(&table);
+    ASSERT_TRUE(dispatcher.getReassemblyTable() == &table);
+    ASSERT_TRUE(sub_a.getReassemblyTable() == &table);
+
+    // The listeners registered after the table was installed use it as well
+    ASSERT_TRUE(dispatcher.registerMessageListener(&sub_b));
+    ASSERT_TRUE(sub_b.getReassemblyTable() == &table);
+
+    /*
+     * Multi frame transfers from several sources to both listeners
+     */
+    std::vector<Transfer> transfers;
+    for (uint8_t i = 0; i < 6; i++)
+    {
+        transfers.push_back(emulator.makeTransfer(0, uavcan::TransferTypeMessageBroadcast, uint8_t(i + 1),
+                                                  MFT_PAYLOAD, TYPES[i % 2]));
+    }
+    for (unsigned i = 0; i < transfers.size(); i++)
+    {
+        emulator.send(&transfers[i], 1);
+    }
+    while (dispatcher.spinOnce() > 0)
+    {
+        clockmock.advance(100);
+    }
+    for (unsigned i = 0; i < transfers.size(); i++)
+    {
+        ASSERT_TRUE(((i % 2) == 0 ? sub_a : sub_b).matchAndPop(transfers[i]));
+    }
+    ASSERT_TRUE(sub_a.isEmpty());
+    ASSERT_TRUE(sub_b.isEmpty());
+
+    // One receiver per source and listener; the buffers have been released
+    ASSERT_EQ(6, table.getNumReceivers());
+    ASSERT_LT(0, table.getNumUsedBlocks());
+    ASSERT_GE(table.getMaxBlocks(), table.getNumUsedBlocks());
+
+    /*
+     * The expired receivers are removed by the cleanup
+     */
+    dispatcher.cleanup(clockmock.getMonotonic() + uavcan::MonotonicDuration::fromMSec(100));
+    ASSERT_EQ(6, table.getNumReceivers());
+
+    dispatcher.cleanup(clockmock.getMonotonic() + uavcan::MonotonicDuration::fromMSec(5000));
+    ASSERT_EQ(0, table.getNumReceivers());
+    ASSERT_EQ(0, table.getNumUsedBlocks());
+
+    /*
+     * Unregistering a listener releases its receivers
+     */
+    for (unsigned i = 0; i < transfers.size(); i++)
+    {
+        emulator.send(&transfers[i], 1);
+    }
+    while (dispatcher.spinOnce() > 0)
+    {
+        clockmock.advance(100);
+    }
+    for (unsigned i = 0; i < transfers.size(); i++)
+    {
+        ASSERT_TRUE(((i % 2) == 0 ? sub_a : sub_b).matchAndPop(transfers[i]));
+    }
+    ASSERT_EQ(6, table.getNumReceivers());
+
+    dispatcher.unregisterMessageListener(&sub_a);
+    ASSERT_TRUE(sub_a.getReassemblyTable() == NULL);
+    ASSERT_EQ(3, table.getNumReceivers());
+
+    /*
+     * Removing the table releases the receivers of the remaining listeners
+     */
+    dispatcher.removeReassemblyTable();
+    ASSERT_TRUE(sub_b.getReassemblyTable() == NULL);
+    ASSERT_EQ(0, table.getNumReceivers());
+    ASSERT_EQ(0, table.getNumUsedBlocks());
+
+    // Own receivers are used again
+    for (unsigned i = 0; i < transfers.size(); i++)
+    {
+        emulator.send(&transfers[i], 1);
+    }
+    while (dispatcher.spinOnce() > 0)
+    {
+        clockmock.advance(100);
+    }
+    ASSERT_TRUE(sub_a.isEmpty());
+    for (unsigned i = 1; i < transfers.size(); i += 2)
+    {
+        ASSERT_TRUE(sub_b.matchAndPop(transfers[i]));
+    }
+    ASSERT_EQ(0, table.getNumReceivers());
+
+    dispatcher.unregisterMessageListener(&sub_b);
+}
+
+TEST(ReassemblyTable, Quota)
+{
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 100, uavcan::MemPoolBlockSize> pool;
+
+    SystemClockMock clockmock(100);
+    CanDriverMock driver(2, clockmock);
+
+    uavcan::Dispatcher dispatcher(driver, pool, clockmock);
+    ASSERT_TRUE(dispatcher.setNodeID(SELF_NODE_ID));
+    dispatcher.setReceiverEvictionEnabled(false);
+
+    ReassemblyTableTransferEmulator emulator(driver, SELF_NODE_ID);
+
+    const uavcan::DataTypeDescriptor type = makeDataType(uavcan::DataTypeKindMessage, 1);
+    TestListener sub(dispatcher.getTransferPerfCounter(), type, 256, pool);
+    ASSERT_TRUE(dispatcher.registerMessageListener(&sub));
+
+    /*
+     * The quota is too small for the receivers of all of the sources; the pool is not exhausted, but the new
+     * sources are rejected
+     */
+    static const uint16_t MaxBlocks = 6;
+    uavcan::ReassemblyTable table(pool, MaxBlocks);
+    dispatcher.installReassemblyTable(&table);
+
+    std::vector<Transfer> transfers;
+    for (uint8_t i = 0; i < 20; i++)
+    {
+        transfers.push_back(emulator.makeTransfer(0, uavcan::TransferTypeMessageBroadcast, uint8_t(i + 1),
+                                                  "abc", type));
+    }
+    for (unsigned i = 0; i < transfers.size(); i++)
+    {
+        emulator.send(&transfers[i], 1);
+        while (dispatcher.spinOnce() > 0)
+        {
+            clockmock.advance(100);
+        }
+    }
+
+    unsigned num_received = 0;
+    while (!sub.isEmpty())
+    {
+        ASSERT_TRUE(sub.matchAndPop(transfers[num_received]));
+        num_received++;
+    }
+    ASSERT_EQ(MaxBlocks, num_received);
+    ASSERT_EQ(MaxBlocks, table.getNumUsedBlocks());
+    ASSERT_GT(100 - pool.getNumUsedBlocks(), MaxBlocks);
+
+    /*
+     * With the eviction enabled, the least recently active receivers give way to the new sources
+     */
+    dispatcher.setReceiverEvictionEnabled(true);
+
+    const Transfer tr = emulator.makeTransfer(0, uavcan::TransferTypeMessageBroadcast, 100, "abc", type);
+    emulator.send(&tr, 1);
+    while (dispatcher.spinOnce() > 0)
+    {
+        clockmock.advance(100);
+    }
+    ASSERT_TRUE(sub.matchAndPop(tr));
+    ASSERT_LT(0, dispatcher.getNumEvictedReceivers());
+    ASSERT_GE(MaxBlocks, table.getNumUsedBlocks());
+
+    /*
+     * The limit can be changed at any time
+     */
+    table.setMaxBlocks(MaxBlocks * 4);
+    ASSERT_EQ(MaxBlocks * 4, table.getMaxBlocks());
+
+    dispatcher.removeReassemblyTable();
+    dispatcher.unregisterMessageListener(&sub);
+    ASSERT_EQ(0, table.getNumUsedBlocks());
+}
@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <gtest/gtest.h>
+#include <uavcan/transport/redundant_frame_filter.hpp>
+#include <uavcan/transport/frame.hpp>
+
+
+static uavcan::CanRxFrame makeFrame(uavcan::DataTypeID data_type_id, uint8_t src_node_id, uint8_t transfer_id,
+                                    uint8_t iface_index, uint64_t ts_usec, uint8_t priority = 16)
+{
+    uavcan::Frame frame(data_type_id, uavcan::TransferTypeMessageBroadcast, src_node_id, uavcan::NodeID::Broadcast,
+                        transfer_id);
+    frame.setPriority(priority);
+    frame.setStartOfTransfer(true);
+    frame.setEndOfTransfer(true);
+    uavcan::CanRxFrame can_frame;
+    EXPECT_TRUE(frame.compile(can_frame));
+    can_frame.iface_index = iface_index;
+    can_frame.ts_mono = uavcan::MonotonicTime::fromUSec(ts_usec);
+    return can_frame;
+}
+
+TEST(RedundantFrameFilter, Basic)
+{
+    uavcan::RedundantFrameFilter filter;
+    ASSERT_EQ(uavcan::RedundantFrameFilter::getDefaultFailoverTimeout(), filter.getFailoverTimeout());
+
+    // The first iface owns the stream, the copies from the other ifaces are dropped
+    ASSERT_TRUE(filter.accept(makeFrame(100, 10, 0, 0, 1000)));
+    ASSERT_FALSE(filter.accept(makeFrame(100, 10, 0, 1, 1100)));
+    ASSERT_FALSE(filter.accept(makeFrame(100, 10, 0, 2, 1200)));
+
+    // Even if the other iface is ahead
+    ASSERT_FALSE(filter.accept(makeFrame(100, 10, 1, 1, 2000)));
+    ASSERT_TRUE(filter.accept(makeFrame(100, 10, 1, 0, 2100)));
+
+    // Priority doesn't matter
+    ASSERT_TRUE(filter.accept(makeFrame(100, 10, 2, 0, 3000, 0)));
+    ASSERT_FALSE(filter.accept(makeFrame(100, 10, 2, 1, 3100, 0)));
+
+    // Other streams are independent
+    ASSERT_TRUE(filter.accept(makeFrame(100, 11, 0, 1, 4000)));
+    ASSERT_FALSE(filter.accept(makeFrame(100, 11, 0, 0, 4100)));
+    ASSERT_TRUE(filter.accept(makeFrame(101, 10, 0, 2, 4200)));
+    ASSERT_FALSE(filter.accept(makeFrame(101, 10, 0, 0, 4300)));
+
+    EXPECT_EQ(2, filter.getNumDuplicates(0));
+    EXPECT_EQ(3, filter.getNumDuplicates(1));
+    EXPECT_EQ(1, filter.getNumDuplicates(2));
+    EXPECT_EQ(0, filter.getNumDuplicates(200));
+    EXPECT_EQ(0, filter.getNumUntrackedFrames());
+
+    // After reset, the first iface to deliver a frame owns the stream again
+    filter.reset();
+    ASSERT_TRUE(filter.accept(makeFrame(100, 10, 3, 1, 5000)));
+    ASSERT_FALSE(filter.accept(makeFrame(100, 10, 3, 0, 5100)));
+    EXPECT_EQ(3, filter.getNumDuplicates(0));
+}
+
+TEST(RedundantFrameFilter, Failover)
+{
+    uavcan::RedundantFrameFilter filter;
+    filter.setFailoverTimeout(uavcan::MonotonicDuration::fromMSec(100));
+
+    ASSERT_TRUE(filter.accept(makeFrame(100, 10, 0, 0, 1000000)));
+    ASSERT_FALSE(filter.accept(makeFrame(100, 10, 0, 1, 1050000)));
+    ASSERT_FALSE(filter.accept(makeFrame(100, 10, 1, 1, 1100000)));      // Still within the timeout
+
+    // The owner went silent; the other iface takes over
+    ASSERT_TRUE(filter.accept(makeFrame(100, 10, 2, 1, 1100001)));
+    ASSERT_FALSE(filter.accept(makeFrame(100, 10, 2, 0, 1100500)));
+    ASSERT_TRUE(filter.accept(makeFrame(100, 10, 3, 1, 1150000)));
+
+    // Out of order timestamps from the owner don't move its timestamp back
+    ASSERT_TRUE(filter.accept(makeFrame(100, 10, 3, 1, 1140000)));
+    ASSERT_FALSE(filter.accept(makeFrame(100, 10, 4, 0, 1250000)));
+
+    EXPECT_EQ(2, filter.getNumDuplicates(0));
+    EXPECT_EQ(2, filter.getNumDuplicates(1));
+}
+
+TEST(RedundantFrameFilter, Capacity)
+{
+    uavcan::RedundantFrameFilter filter;
+    const uint64_t Timeout = uint64_t(filter.getFailoverTimeout().toUSec());
+
+    // All streams are active, so some must be left untracked once the table is full
+    const unsigned NumStreams = uavcan::RedundantFrameFilter::Size * 2;
+    for (unsigned i = 0; i < NumStreams; i++)
+    {
+        ASSERT_TRUE(filter.accept(makeFrame(uint16_t(i % 1000), uint8_t(1 + i / 1000), 0, 0, 1000 + i)));
+    }
+    const uint32_t num_untracked = filter.getNumUntrackedFrames();
+    EXPECT_LT(unsigned(uavcan::RedundantFrameFilter::Size) / 2, NumStreams - num_untracked);
+    EXPECT_LT(0, num_untracked);
+
+    // The untracked streams are not filtered, the tracked ones are
+    unsigned num_accepted = 0;
+    for (unsigned i = 0; i < NumStreams; i++)
+    {
+        if (filter.accept(makeFrame(uint16_t(i % 1000), uint8_t(1 + i / 1000), 0, 1, 2000 + NumStreams + i)))
+        {
+            num_accepted++;
+        }
+    }
+    EXPECT_EQ(num_untracked, num_accepted);
+    EXPECT_EQ(num_untracked * 2, filter.getNumUntrackedFrames());
+    EXPECT_EQ(NumStreams - num_accepted, filter.getNumDuplicates(1));
+
+    // Stale entries are reused
+    const uint32_t untracked = filter.getNumUntrackedFrames();
+    for (unsigned i = 0; i < uavcan::RedundantFrameFilter::Size; i++)
+    {
+        ASSERT_TRUE(filter.accept(makeFrame(uint16_t(i), 100, 0, 1, Timeout * 2 + i)));
+    }
+    EXPECT_GE(untracked + uavcan::RedundantFrameFilter::Size / 2, filter.getNumUntrackedFrames());
+}
@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <gtest/gtest.h>
+#include <uavcan/transport/static_transport_memory.hpp>
+#include <uavcan/transport/outgoing_transfer_registry.hpp>
+#include "../clock.hpp"
+#include "transfer_test_helpers.hpp"
+
+
+class StaticTransportListenerEmulator : public IncomingTransferEmulatorBase
+{
+    uavcan::TransferListener& target_;
+    const uavcan::DataTypeDescriptor data_type_;
+
+public:
+    StaticTransportListenerEmulator(uavcan::TransferListener& target, const uavcan::DataTypeDescriptor& type)
+        : IncomingTransferEmulatorBase(127)
+        , target_(target)
+        , data_type_(type)
+    { }
+
+    void sendOneFrame(const uavcan::RxFrame& frame) { target_.handleFrame(frame); }
+
+    Transfer makeTransfer(uint8_t source_node_id, const std::string& payload)
+    {
+        return IncomingTransferEmulatorBase::makeTransfer(16, uavcan::TransferTypeMessageBroadcast, source_node_id,
+                                                          payload, data_type_);
+    }
+};
+
+
+TEST(StaticTransportMemory, Sizing)
+{
+    typedef uavcan::StaticSubscription<2, 100, uavcan::StaticSubscription<3, 7> > Subscriptions;
+    typedef uavcan::StaticPublication<1, uavcan::StaticPublication<4> > Publications;
+    typedef uavcan::StaticTransportAllocator<Subscriptions, Publications, 10, 2> Allocator;
+
+    static const unsigned BlocksPer100 = uavcan::TransferBufferManagerEntry::NumBlocksForSize<100>::Result;
+
+    EXPECT_EQ(5, unsigned(Allocator::NumReceiverBlocks));
+    EXPECT_EQ(2 * BlocksPer100, unsigned(Allocator::NumBufferBlocks));     // Single frame transfers need none
+    EXPECT_EQ(5, unsigned(Allocator::NumTransferIDBlocks));
+
+    Allocator allocator;
+    EXPECT_EQ(5 + 2 * BlocksPer100 + 5 + 10 + 2, allocator.getBlockCapacity());
+    EXPECT_EQ(10, allocator.getNumBlocks(uavcan::PoolUsageTagTxQueue));
+    EXPECT_EQ(2, allocator.getNumBlocks(uavcan::PoolUsageTagOther));
+    EXPECT_EQ(0, allocator.getNumBlocks(uavcan::PoolUsageTagServiceCalls));
+
+    // Every subsystem has its own pool
+    EXPECT_EQ(5, allocator.getPartition(uavcan::PoolUsageTagTransferReceivers).getBlockCapacity());
+    EXPECT_EQ(10, allocator.getPartition(uavcan::PoolUsageTagTxQueue).getBlockCapacity());
+    EXPECT_EQ(&allocator, &allocator.getPartition(uavcan::PoolUsageTagServiceCalls));
+
+    void* const rx = allocator.getPartition(uavcan::PoolUsageTagTransferReceivers).allocate(1);
+    void* const other = allocator.allocate(1);
+    ASSERT_TRUE(rx && other);
+    EXPECT_EQ(1, allocator.getNumUsedBlocks(uavcan::PoolUsageTagTransferReceivers));
+    EXPECT_EQ(1, allocator.getNumUsedBlocks(uavcan::PoolUsageTagOther));
+    EXPECT_EQ(0, allocator.getNumUsedBlocks(uavcan::PoolUsageTagTxQueue));
+
+    // The pool is found by the address
+    allocator.deallocate(rx);
+    allocator.deallocate(other);
+    allocator.deallocate(NULL);
+    EXPECT_EQ(0, allocator.getNumUsedBlocks(uavcan::PoolUsageTagTransferReceivers));
+    EXPECT_EQ(0, allocator.getNumUsedBlocks(uavcan::PoolUsageTagOther));
+    EXPECT_EQ(1, allocator.getPeakNumUsedBlocks(uavcan::PoolUsageTagTransferReceivers));
+
+    // No other blocks at all
+    uavcan::StaticTransportAllocator<Subscriptions, Publications, 10> no_other;
+    EXPECT_FALSE(no_other.allocate(1));
+    EXPECT_EQ(0, no_other.getNumBlocks(uavcan::PoolUsageTagOther));
+}
+
+
+TEST(StaticTransportMemory, Reception)
+{
+    const uavcan::DataTypeDescriptor type(uavcan::DataTypeKindMessage, 123, uavcan::DataTypeSignature(123456789), "A");
+
+    static const unsigned MaxTransferSize = 100;
+    typedef uavcan::StaticTransportAllocator<uavcan::StaticSubscription<2, MaxTransferSize>,
+                                             uavcan::StaticTransportTableEnd, 4> Allocator;
+    Allocator allocator;
+
+    uavcan::TransferPerfCounter perf;
+    TestListenerImpl<uavcan::TransferListener> subscriber(perf, type, MaxTransferSize, allocator);
+    StaticTransportListenerEmulator emulator(subscriber, type);
+
+    const std::string payload(MaxTransferSize, 'x');
+
+    /*
+     * Two sources at once
+     */
+    const Transfer transfers[] =
+    {
+        emulator.makeTransfer(1, payload),
+        emulator.makeTransfer(2, payload)
+    };
+    emulator.send(transfers);
+    ASSERT_TRUE(subscriber.matchAndPop(transfers[0]));
+    ASSERT_TRUE(subscriber.matchAndPop(transfers[1]));
+    ASSERT_TRUE(subscriber.isEmpty());
+    EXPECT_EQ(2, allocator.getNumUsedBlocks(uavcan::PoolUsageTagTransferReceivers));
+    EXPECT_EQ(0, allocator.getNumUsedBlocks(uavcan::PoolUsageTagTransferBuffers));
+    EXPECT_EQ(allocator.getNumBlocks(uavcan::PoolUsageTagTransferBuffers),
+              allocator.getPeakNumUsedBlocks(uavcan::PoolUsageTagTransferBuffers));
+
+    /*
+     * The third source doesn't fit, the others are not affected
+     */
+    const Transfer tr = emulator.makeTransfer(3, "abc");
+    emulator.send(&tr, 1);
+    ASSERT_TRUE(subscriber.isEmpty());
+
+    const Transfer tr2 = emulator.makeTransfer(2, "abc");
+    emulator.send(&tr2, 1);
+    ASSERT_TRUE(subscriber.matchAndPop(tr2));
+
+    // The TX queue memory is not touched
+    EXPECT_EQ(0, allocator.getPeakNumUsedBlocks(uavcan::PoolUsageTagTxQueue));
+}
+
+
+TEST(StaticTransportMemory, OutgoingTransferRegistry)
+{
+    using uavcan::OutgoingTransferRegistryKey;
+
+    if (uavcan::OutgoingTransferRegistryNumBuckets == 0)
+    {
+        return;     // The non-hashed registry stores several entries per block
+    }
+
+    uavcan::StaticTransportAllocator<uavcan::StaticTransportTableEnd, uavcan::StaticPublication<2>, 4> allocator;
+    uavcan::OutgoingTransferRegistry otr(allocator);
+
+    const OutgoingTransferRegistryKey keys[] =
+    {
+        OutgoingTransferRegistryKey(123, uavcan::TransferTypeMessageBroadcast, uavcan::NodeID::Broadcast),
+        OutgoingTransferRegistryKey(321, uavcan::TransferTypeServiceRequest,   42),
+        OutgoingTransferRegistryKey(321, uavcan::TransferTypeServiceRequest,   43)
+    };
+
+    ASSERT_TRUE(otr.accessOrCreate(keys[0], tsMono(1000000)));
+    ASSERT_TRUE(otr.accessOrCreate(keys[1], tsMono(1000000)));
+    ASSERT_FALSE(otr.accessOrCreate(keys[2], tsMono(1000000)));     // Not in the table
+    EXPECT_EQ(2, allocator.getNumUsedBlocks(uavcan::PoolUsageTagOutgoingTransferRegistry));
+
+    otr.cleanup(tsMono(2000000));
+    EXPECT_EQ(0, allocator.getNumUsedBlocks(uavcan::PoolUsageTagOutgoingTransferRegistry));
+}
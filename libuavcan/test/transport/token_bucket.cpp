@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <gtest/gtest.h>
+#include <uavcan/transport/token_bucket.hpp>
+#include "can/can.hpp"
+
+
+TEST(TokenBucket, Disabled)
+{
+    uavcan::TokenBucket bucket;
+    ASSERT_FALSE(bucket.isEnabled());
+    for (int i = 0; i < 100; i++)
+    {
+        ASSERT_TRUE(bucket.tryConsume(0xFFFFFFFFU, tsMono(1000)));
+    }
+    ASSERT_EQ(tsMono(0), bucket.getAvailabilityTime(0xFFFFFFFFU));
+
+    bucket.configure(1000, 100);
+    ASSERT_TRUE(bucket.isEnabled());
+    bucket.configure(0, 100);
+    ASSERT_FALSE(bucket.isEnabled());
+    ASSERT_TRUE(bucket.tryConsume(1000, tsMono(1000)));
+}
+
+TEST(TokenBucket, Basic)
+{
+    uavcan::TokenBucket bucket;
+    bucket.configure(1000, 100);                        // 1 byte per millisecond
+    ASSERT_EQ(1000, bucket.getRate());
+    ASSERT_EQ(100, bucket.getBurst());
+
+    // Full after configuration
+    ASSERT_TRUE(bucket.tryConsume(60, tsMono(1000000)));
+    ASSERT_TRUE(bucket.tryConsume(40, tsMono(1000000)));
+    ASSERT_FALSE(bucket.tryConsume(1, tsMono(1000000)));
+
+    // Refill is exact
+    ASSERT_EQ(tsMono(1050000), bucket.getAvailabilityTime(50));
+    ASSERT_FALSE(bucket.canConsume(50, tsMono(1049999)));
+    ASSERT_TRUE(bucket.canConsume(50, tsMono(1050000)));
+    ASSERT_TRUE(bucket.tryConsume(50, tsMono(1050000)));
+    ASSERT_FALSE(bucket.tryConsume(1, tsMono(1050000)));
+    ASSERT_TRUE(bucket.tryConsume(1, tsMono(1051000)));
+
+    // Failed attempts don't consume anything
+    ASSERT_FALSE(bucket.tryConsume(10, tsMono(1051000)));
+    ASSERT_TRUE(bucket.tryConsume(10, tsMono(1061000)));
+
+    // Capacity is limited by the burst size
+    ASSERT_TRUE(bucket.tryConsume(100, tsMono(100000000)));
+    ASSERT_FALSE(bucket.tryConsume(1, tsMono(100000000)));
+    ASSERT_EQ(uavcan::MonotonicTime::getMax(), bucket.getAvailabilityTime(101));
+    ASSERT_FALSE(bucket.tryConsume(101, tsMono(900000000)));
+
+    // Time going backwards does nothing
+    ASSERT_TRUE(bucket.tryConsume(100, tsMono(900000000)));
+    ASSERT_FALSE(bucket.tryConsume(1, tsMono(1000)));
+}
+
+TEST(TokenBucket, NoOverflow)
+{
+    uavcan::TokenBucket bucket;
+    bucket.configure(0xFFFFFFFFU, 0xFFFFFFFFU);
+    ASSERT_TRUE(bucket.tryConsume(0xFFFFFFFFU, tsMono(1)));
+    ASSERT_FALSE(bucket.tryConsume(0xFFFFFFFFU, tsMono(2)));
+    ASSERT_TRUE(bucket.tryConsume(0xFFFFFFFFU, uavcan::MonotonicTime::getMax()));
+    ASSERT_FALSE(bucket.canConsume(1, uavcan::MonotonicTime::getMax()));
+}
@@ -6,6 +6,7 @@
 #include <gtest/gtest.h>
 #include <memory>
 #include <uavcan/transport/transfer_buffer.hpp>
+#include "../clock.hpp"
 
 static const std::string TEST_DATA =
     "It was like this: I asked myself one day this question - what if Napoleon, for instance, had happened to be in my "
@@ -190,6 +191,93 @@ TEST(TransferBufferManagerEntry, Basic)
     ASSERT_EQ(0, pool.getNumUsedBlocks());
 }
 
+TEST(TransferBufferManagerEntry, Contiguous)
+{
+    using uavcan::TransferBufferManagerEntry;
+
+    static const int MAX_SIZE = TEST_BUFFER_SIZE;
+    static const int LARGE_BLOCK_SIZE = 248;
+    uavcan::PoolAllocator<LARGE_BLOCK_SIZE * 4, LARGE_BLOCK_SIZE> pool;   // Can serve the whole buffer at once
+
+    TransferBufferManagerEntry buf(pool, MAX_SIZE);
+    const uint8_t* const test_data_ptr = reinterpret_cast<const uint8_t*>(TEST_DATA.c_str());
+
+    ASSERT_FALSE(buf.getContiguousData());
+
+    // Sequential writes, like during transfer reception
+    for (unsigned offset = 0; offset < MAX_SIZE; offset += 7)
+    {
+        const unsigned len = std::min(7U, unsigned(MAX_SIZE) - offset);
+        ASSERT_EQ(int(len), buf.write(offset, test_data_ptr + offset, len));
+    }
+    ASSERT_EQ(1, pool.getNumUsedBlocks());                // One span instead of a block chain
+    ASSERT_EQ(MAX_SIZE, buf.getMaxWritePos());
+    ASSERT_TRUE(buf.getContiguousData());
+    ASSERT_TRUE(std::equal(buf.getContiguousData(), buf.getContiguousData() + MAX_SIZE, TEST_DATA.begin()));
+
+    ASSERT_TRUE(matchAgainstTestData(buf, 0));
+    ASSERT_TRUE(matchAgainstTestData(buf, TEST_BUFFER_SIZE / 2, TEST_BUFFER_SIZE / 4));
+
+    // Overflow
+    ASSERT_EQ(0, buf.write(MAX_SIZE, test_data_ptr, 1));
+
+    // Reset releases the span
+    buf.reset();
+    ASSERT_FALSE(buf.getContiguousData());
+    ASSERT_EQ(0, pool.getNumUsedBlocks());
+
+    // Regular pool can't provide a span, so the block chain is used instead
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 8, uavcan::MemPoolBlockSize> small_pool;
+    TransferBufferManagerEntry chained_buf(small_pool, MAX_SIZE);
+    ASSERT_EQ(MAX_SIZE, chained_buf.write(0, test_data_ptr, MAX_SIZE));
+    ASSERT_FALSE(chained_buf.getContiguousData());
+    ASSERT_LT(1, small_pool.getNumUsedBlocks());
+    ASSERT_TRUE(matchAgainstTestData(chained_buf, 0));
+}
+
+TEST(TransferBufferManagerEntry, ReassemblyBenchmark)
+{
+    using uavcan::TransferBufferManagerEntry;
+
+    static const unsigned MAX_SIZE = 1024;
+    static const unsigned NUM_ITERATIONS = 1000;
+    static const unsigned FRAME_PAYLOAD_LEN = 7;
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 32, uavcan::MemPoolBlockSize> pool;
+
+    uint8_t payload[MAX_SIZE];
+    for (unsigned i = 0; i < MAX_SIZE; i++)
+    {
+        payload[i] = uint8_t(i);
+    }
+
+    const SystemClockDriver clock;
+    TransferBufferManagerEntry buf(pool, MAX_SIZE);
+
+    for (unsigned transfer_len = 64; transfer_len <= MAX_SIZE; transfer_len *= 2)
+    {
+        const uavcan::MonotonicTime started_at = clock.getMonotonic();
+
+        for (unsigned iteration = 0; iteration < NUM_ITERATIONS; iteration++)
+        {
+            buf.reset();
+            for (unsigned offset = 0; offset < transfer_len; offset += FRAME_PAYLOAD_LEN)
+            {
+                const unsigned len = std::min(FRAME_PAYLOAD_LEN, transfer_len - offset);
+                ASSERT_EQ(int(len), buf.write(offset, payload + offset, len));
+            }
+        }
+
+        const uavcan::MonotonicDuration elapsed = clock.getMonotonic() - started_at;
+
+        uint8_t readback[MAX_SIZE];
+        ASSERT_EQ(int(transfer_len), buf.read(0, readback, MAX_SIZE));
+        ASSERT_TRUE(std::equal(readback, readback + transfer_len, payload));
+
+        std::cout << "Reassembly of " << transfer_len << " bytes: "
+                  << double(elapsed.toUSec()) * 1000.0 / NUM_ITERATIONS << " ns per transfer" << std::endl;
+    }
+}
+
 
 static const std::string MGR_TEST_DATA[4] =
 {
@@ -2,6 +2,7 @@
  * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
  */
 
+#include <map>
 #include <gtest/gtest.h>
 #include "transfer_test_helpers.hpp"
 #include "../clock.hpp"
@@ -260,9 +261,410 @@ TEST(TransferListener, AnonymousTransfers)
     ASSERT_TRUE(subscriber.isEmpty());
 }
 
+TEST(TransferListener, NodeIndex)
+{
+    const uavcan::DataTypeDescriptor type(uavcan::DataTypeKindMessage, 123, uavcan::DataTypeSignature(123456789), "A");
+
+    static const int NUM_POOL_BLOCKS = 100;
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * NUM_POOL_BLOCKS, uavcan::MemPoolBlockSize> pool;
+    uavcan::TransferPerfCounter perf;
+
+    {
+        TestListenerImpl<uavcan::TransferListenerWithNodeIndex> subscriber(perf, type, 256, pool);
+        ASSERT_EQ(0, pool.getNumUsedBlocks());      // Nothing is allocated until the first frame
+
+        TransferListenerEmulator emulator(subscriber, type);
+        const Transfer transfers[] =
+        {
+            emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 1,   "1234567890abcdef"),  // MFT
+            emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 127, "abc"),
+            emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 2,   "def"),
+            emulator.makeTransfer(16, uavcan::TransferTypeServiceRequest,   3,   "ghi"),   // Not indexed
+            emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 0,   "jkl")    // Anonymous
+        };
+        subscriber.allowAnonymousTransfers();
+
+        emulator.send(transfers);
+
+        ASSERT_TRUE(subscriber.matchAndPop(transfers[1]));
+        ASSERT_TRUE(subscriber.matchAndPop(transfers[2]));
+        ASSERT_TRUE(subscriber.matchAndPop(transfers[3]));
+        ASSERT_TRUE(subscriber.matchAndPop(transfers[4]));
+        ASSERT_TRUE(subscriber.matchAndPop(transfers[0]));
+        ASSERT_TRUE(subscriber.isEmpty());
+        ASSERT_LT(0, pool.getNumUsedBlocks());
+
+        // Repeated transfers are rejected by the receivers
+        emulator.send(transfers);
+        ASSERT_TRUE(subscriber.matchAndPop(transfers[4]));     // Anonymous transfers can't be deduplicated
+        ASSERT_TRUE(subscriber.isEmpty());
+
+        // Cleanup with huge timestamp value will remove everything
+        static_cast<uavcan::TransferListener&>(subscriber).cleanup(tsMono(100000000));
+        ASSERT_EQ(0, pool.getNumUsedBlocks());
+
+        // Now the same transfers will be accepted again
+        emulator.send(transfers);
+        ASSERT_EQ(5, subscriber.getNumReceivedTransfers());
+    }
+    ASSERT_EQ(0, pool.getNumUsedBlocks());
+}
+
+TEST(TransferListener, Decimation)
+{
+    const uavcan::DataTypeDescriptor type(uavcan::DataTypeKindMessage, 123, uavcan::DataTypeSignature(123456789), "A");
+
+    static const int NUM_POOL_BLOCKS = 100;
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * NUM_POOL_BLOCKS, uavcan::MemPoolBlockSize> pool;
+    uavcan::TransferPerfCounter perf;
+    TestListener subscriber(perf, type, 256, pool);
+    subscriber.setDecimation(3);
+    ASSERT_EQ(3, subscriber.getDecimation().factor);
+    ASSERT_EQ(0, subscriber.getDecimation().min_interval_msec);
+
+    TransferListenerEmulator emulator(subscriber, type);
+    const Transfer transfers[] =
+    {
+        emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 1, "1234567890abcdef"),  // MFT
+        emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 1, "abc"),
+        emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 1, "1234567890abcdef"),
+        emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 1, "1234567890abcdef"),
+        emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 1, "def"),
+        emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 1, "ghi")
+    };
+    for (unsigned i = 0; i < sizeof(transfers) / sizeof(transfers[0]); i++)
+    {
+        emulator.send(&transfers[i], 1);
+        if (i == 2)
+        {
+            ASSERT_EQ(1, pool.getNumUsedBlocks());     // Only the receiver, no buffer for the skipped MFT
+        }
+    }
+
+    ASSERT_TRUE(subscriber.matchAndPop(transfers[0]));
+    ASSERT_TRUE(subscriber.matchAndPop(transfers[3]));
+    ASSERT_TRUE(subscriber.isEmpty());
+    ASSERT_EQ(4, subscriber.getNumSkippedTransfers());
+
+    // Disabling
+    subscriber.setDecimation(0);
+    ASSERT_FALSE(subscriber.getDecimation().isEnabled());
+    const Transfer tr = emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 1, "jkl");
+    emulator.send(&tr, 1);
+    ASSERT_TRUE(subscriber.matchAndPop(tr));
+    ASSERT_EQ(4, subscriber.getNumSkippedTransfers());
+}
+
+TEST(TransferListener, OnChange)
+{
+    const uavcan::DataTypeDescriptor type(uavcan::DataTypeKindMessage, 123, uavcan::DataTypeSignature(123456789), "A");
+
+    static const int NUM_POOL_BLOCKS = 100;
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * NUM_POOL_BLOCKS, uavcan::MemPoolBlockSize> pool;
+    uavcan::TransferPerfCounter perf;
+    TestListener subscriber(perf, type, 256, pool);
+    subscriber.setOnChangeMode(true);
+    ASSERT_TRUE(subscriber.getDecimation().isEnabled());
+
+    TransferListenerEmulator emulator(subscriber, type);
+    const Transfer transfers[] =
+    {
+        emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 1, "1234567890abcdef"),  // MFT
+        emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 2, "abc"),
+        emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 1, "1234567890abcdef"),  // Same
+        emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 2, "abc"),               // Same
+        emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 1, "1234567890abcdeF"),
+        emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 2, "abC")
+    };
+    for (unsigned i = 0; i < sizeof(transfers) / sizeof(transfers[0]); i++)
+    {
+        emulator.send(&transfers[i], 1);
+    }
+
+    ASSERT_TRUE(subscriber.matchAndPop(transfers[0]));
+    ASSERT_TRUE(subscriber.matchAndPop(transfers[1]));
+    ASSERT_TRUE(subscriber.matchAndPop(transfers[4]));
+    ASSERT_TRUE(subscriber.matchAndPop(transfers[5]));
+    ASSERT_TRUE(subscriber.isEmpty());
+    ASSERT_EQ(2, subscriber.getNumSkippedTransfers());
+}
+
+struct StreamingListener : public uavcan::StreamingTransferListener
+{
+    std::map<uint8_t, std::string> partial;     // Per source node ID
+    std::vector<std::string> completed;
+    unsigned num_aborts;
+    unsigned num_chunks;
+    bool reject_chunks;
+
+    StreamingListener(uavcan::TransferPerfCounter& perf, const uavcan::DataTypeDescriptor& data_type,
+                      uint16_t max_transfer_size, uavcan::IPoolAllocator& allocator)
+        : uavcan::StreamingTransferListener(perf, data_type, max_transfer_size, allocator)
+        , num_aborts(0)
+        , num_chunks(0)
+        , reject_chunks(false)
+    { }
+
+    virtual bool handleTransferChunk(const uavcan::IncomingTransferChunk& chunk)
+    {
+        std::string& str = partial[chunk.getSrcNodeID().get()];
+        EXPECT_EQ(str.length(), chunk.getOffset());
+        uint8_t buf[8];
+        EXPECT_EQ(int(chunk.getLength()), chunk.read(0, buf, sizeof(buf)));
+        str.append(reinterpret_cast<const char*>(buf), chunk.getLength());
+        num_chunks++;
+        return !reject_chunks;
+    }
+
+    virtual void handleTransferCompletion(uavcan::NodeID src_node_id, uavcan::TransferType)
+    {
+        completed.push_back(partial[src_node_id.get()]);
+        partial.erase(src_node_id.get());
+    }
+
+    virtual void handleTransferAbort(uavcan::NodeID src_node_id, uavcan::TransferType)
+    {
+        num_aborts++;
+        partial.erase(src_node_id.get());
+    }
+};
+
+
+TEST(TransferListener, Streaming)
+{
+    const uavcan::DataTypeDescriptor type(uavcan::DataTypeKindMessage, 123, uavcan::DataTypeSignature(123456789), "A");
+
+    static const int NUM_POOL_BLOCKS = 8;
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * NUM_POOL_BLOCKS, uavcan::MemPoolBlockSize> poolmgr;
+    uavcan::TransferPerfCounter perf;
+    StreamingListener subscriber(perf, type, 1024, poolmgr);
+
+    TransferListenerEmulator emulator(subscriber, type);
+
+    /*
+     * A transfer that wouldn't fit into the pool if it was buffered, and a single frame transfer
+     */
+    std::string long_payload;
+    for (int i = 0; long_payload.length() < 700; i++)
+    {
+        long_payload += "Chunk #" + std::string(1, char('A' + i % 26));
+    }
+    ASSERT_LT(NUM_POOL_BLOCKS * uavcan::MemPoolBlockSize, long_payload.length());
+
+    const Transfer transfers[] =
+    {
+        emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 1, long_payload),
+        emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 2, "abc")
+    };
+    emulator.send(transfers);
+
+    ASSERT_EQ(2, subscriber.completed.size());
+    ASSERT_EQ("abc", subscriber.completed[0]);
+    ASSERT_EQ(long_payload, subscriber.completed[1]);
+    ASSERT_EQ(0, subscriber.num_aborts);
+    ASSERT_TRUE(subscriber.partial.empty());
+    subscriber.completed.clear();
+
+    /*
+     * CRC failure
+     */
+    const Transfer tr_crc = emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 3, "123456789abcdefghik");
+    std::vector<uavcan::RxFrame> ser_crc = serializeTransfer(tr_crc);
+    ASSERT_LT(1, ser_crc.size());
+    const_cast<uint8_t*>(ser_crc[1].getPayloadPtr())[1] = uint8_t(~ser_crc[1].getPayloadPtr()[1]);
+    emulator.send(std::vector<std::vector<uavcan::RxFrame> >(1, ser_crc));
+
+    ASSERT_TRUE(subscriber.completed.empty());
+    ASSERT_EQ(1, subscriber.num_aborts);
+
+    /*
+     * Interrupted transfer is aborted when its receiver times out
+     */
+    const Transfer tr_partial = emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 4, long_payload);
+    const std::vector<uavcan::RxFrame> ser_partial = serializeTransfer(tr_partial);
+    emulator.send(std::vector<std::vector<uavcan::RxFrame> >(1, std::vector<uavcan::RxFrame>(ser_partial.begin(),
+                                                                                           ser_partial.begin() + 3)));
+    ASSERT_EQ(1, subscriber.partial.size());
+    static_cast<uavcan::TransferListener&>(subscriber).cleanup(tsMono(100000000));
+    ASSERT_EQ(2, subscriber.num_aborts);
+    ASSERT_TRUE(subscriber.partial.empty());
+
+    /*
+     * Rejected by the consumer; then too long
+     */
+    subscriber.reject_chunks = true;
+    subscriber.num_chunks = 0;
+    const Transfer tr_rejected = emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 5, long_payload);
+    emulator.send(&tr_rejected, 1);
+    ASSERT_EQ(1, subscriber.num_chunks);            // The rest of the transfer is ignored
+    ASSERT_EQ(3, subscriber.num_aborts);
+    ASSERT_TRUE(subscriber.completed.empty());
+
+    StreamingListener short_subscriber(perf, type, 16, poolmgr);
+    TransferListenerEmulator short_emulator(short_subscriber, type);
+    const Transfer tr_long = short_emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 6,
+                                                         "123456789abcdefghik");
+    short_emulator.send(&tr_long, 1);
+    ASSERT_EQ(2, short_subscriber.num_chunks);
+    ASSERT_EQ(1, short_subscriber.num_aborts);
+    ASSERT_TRUE(short_subscriber.completed.empty());
+}
+
+
+TEST(TransferListener, ReservedSlots)
+{
+    const uavcan::DataTypeDescriptor type(uavcan::DataTypeKindMessage, 123, uavcan::DataTypeSignature(123456789), "A");
+
+    static const unsigned MaxTransferSize = 100;
+    typedef TestListenerImpl<uavcan::TransferListenerWithReservedSlots<2, MaxTransferSize> > ReservedListener;
+
+    // The shared pool is exhausted
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 2, uavcan::MemPoolBlockSize> poolmgr;
+    void* const hog_a = poolmgr.allocate(1);
+    void* const hog_b = poolmgr.allocate(1);
+    ASSERT_TRUE(hog_a && hog_b);
+    ASSERT_EQ(0, poolmgr.getNumFreeBlocks());
+
+    uavcan::TransferPerfCounter perf;
+    ReservedListener subscriber(perf, type, MaxTransferSize, poolmgr);
+    TransferListenerEmulator emulator(subscriber, type);
+
+    const std::string payload(MaxTransferSize, 'x');
+
+    /*
+     * Two sources at once fit into the reserved memory
+     */
+    for (int i = 0; i < 3; i++)
+    {
+        const Transfer transfers[] =
+        {
+            emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 1, payload),
+            emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 2, payload)
+        };
+        emulator.send(transfers);
+        ASSERT_TRUE(subscriber.matchAndPop(transfers[0]));
+        ASSERT_TRUE(subscriber.matchAndPop(transfers[1]));
+        ASSERT_TRUE(subscriber.isEmpty());
+    }
+    ASSERT_EQ(0, subscriber.getReservedAllocator().getNumFallbackAllocations());
+    ASSERT_LT(0, subscriber.getReservedAllocator().getNumUsedReservedBlocks());     // Receivers are kept
+
+    /*
+     * While both slots are busy with the longest transfers, the third source needs the shared pool
+     */
+    std::vector<std::vector<uavcan::RxFrame> > sers;
+    for (uint8_t i = 1; i <= 2; i++)
+    {
+        std::vector<uavcan::RxFrame> ser =
+            serializeTransfer(emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, i, payload));
+        ser.pop_back();
+        sers.push_back(ser);
+    }
+    emulator.send(sers);
+    ASSERT_TRUE(subscriber.isEmpty());
+
+    const Transfer tr = emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 3, "abc");
+    emulator.send(&tr, 1);
+    ASSERT_TRUE(subscriber.isEmpty());
+
+    poolmgr.deallocate(hog_a);
+    emulator.send(&tr, 1);
+    ASSERT_TRUE(subscriber.matchAndPop(tr));
+    ASSERT_EQ(1, subscriber.getReservedAllocator().getNumFallbackAllocations());
+
+    static_cast<uavcan::TransferListener&>(subscriber).cleanup(tsMono(100000000));
+    ASSERT_EQ(0, subscriber.getReservedAllocator().getNumUsedReservedBlocks());
+    ASSERT_EQ(1, poolmgr.getNumFreeBlocks());
+    poolmgr.deallocate(hog_b);
+}
+
+
 TEST(TransferListener, Sizes)
 {
     using namespace uavcan;
 
     std::cout << "sizeof(TransferListener): " << sizeof(TransferListener) << std::endl;
+    std::cout << "sizeof(TransferListenerWithNodeIndex): " << sizeof(TransferListenerWithNodeIndex) << std::endl;
+}
+
+
+struct LeastRecentlyActiveReclaimer : public uavcan::IRxMemoryReclaimer
+{
+    unsigned num_calls;
+    unsigned num_evicted;
+
+    LeastRecentlyActiveReclaimer() : num_calls(0), num_evicted(0) { }
+
+    virtual bool reclaimRxMemory(const uavcan::TransferListener& requester,
+                                 const uavcan::TransferBufferManagerKey& protected_key)
+    {
+        num_calls++;
+        uavcan::TransferListener& listener = const_cast<uavcan::TransferListener&>(requester);
+        uavcan::TransferBufferManagerKey key;
+        uavcan::MonotonicTime ts = uavcan::MonotonicTime::getMax();
+        if (!listener.findLeastRecentlyActiveReceiver(protected_key, key, ts))
+        {
+            return false;
+        }
+        listener.evictReceiver(key);
+        num_evicted++;
+        return true;
+    }
+};
+
+
+TEST(TransferListener, ReceiverEviction)
+{
+    const uavcan::DataTypeDescriptor type(uavcan::DataTypeKindMessage, 123, uavcan::DataTypeSignature(123456789), "A");
+
+    static const int NUM_POOL_BLOCKS = 2;
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * NUM_POOL_BLOCKS, uavcan::MemPoolBlockSize> poolmgr;
+    uavcan::TransferPerfCounter perf;
+    TestListener subscriber(perf, type, 256, poolmgr);
+
+    TransferListenerEmulator emulator(subscriber, type);
+
+    static const uint8_t NumSources = 16;
+    std::vector<Transfer> transfers;
+    for (uint8_t i = 0; i < NumSources; i++)
+    {
+        transfers.push_back(emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, uint8_t(i + 1), "abc"));
+    }
+
+    /*
+     * Without the reclaimer, the receivers of the new sources can't be allocated
+     */
+    for (unsigned i = 0; i < transfers.size(); i++)
+    {
+        emulator.send(&transfers[i], 1);
+    }
+    const unsigned num_received = subscriber.getNumReceivedTransfers();
+    ASSERT_LT(num_received, unsigned(NumSources));
+    ASSERT_LT(0, num_received);
+    for (unsigned i = 0; i < num_received; i++)
+    {
+        ASSERT_TRUE(subscriber.matchAndPop(transfers[i]));      // Only the first sources got their receivers
+    }
+    ASSERT_TRUE(subscriber.isEmpty());
+
+    /*
+     * With the reclaimer, the least recently active receivers give way to the new sources
+     */
+    static_cast<uavcan::TransferListener&>(subscriber).cleanup(tsMono(100000000));
+    LeastRecentlyActiveReclaimer reclaimer;
+    subscriber.setMemoryReclaimer(&reclaimer);
+
+    for (unsigned i = 0; i < transfers.size(); i++)
+    {
+        emulator.send(&transfers[i], 1);
+    }
+    for (unsigned i = 0; i < transfers.size(); i++)
+    {
+        ASSERT_TRUE(subscriber.matchAndPop(transfers[i]));
+    }
+    ASSERT_TRUE(subscriber.isEmpty());
+    ASSERT_LT(0, reclaimer.num_evicted);
+    ASSERT_EQ(reclaimer.num_calls, reclaimer.num_evicted);
+
+    subscriber.setMemoryReclaimer(NULL);
 }
@@ -115,6 +115,7 @@ static bool matchBufferContent(const uavcan::ITransferBuffer* tbb, const std::st
 #define CHECK_NOT_COMPLETE(x) ASSERT_EQ(uavcan::TransferReceiver::ResultNotComplete, (x))
 #define CHECK_COMPLETE(x)     ASSERT_EQ(uavcan::TransferReceiver::ResultComplete, (x))
 #define CHECK_SINGLE_FRAME(x) ASSERT_EQ(uavcan::TransferReceiver::ResultSingleFrame, (x))
+#define CHECK_SKIPPED(x)      ASSERT_EQ(uavcan::TransferReceiver::ResultSkipped, (x))
 
 TEST(TransferReceiver, Basic)
 {
@@ -318,6 +319,37 @@ TEST(TransferReceiver, OutOfOrderFrames)
 }
 
 
+TEST(TransferReceiver, IncrementalCrc)
+{
+    Context<32> context;
+    RxFrameGenerator gen(789);
+    uavcan::TransferReceiver& rcv = context.receiver;
+    uavcan::TransferBufferAccessor bk(context.bufmgr, RxFrameGenerator::DEFAULT_KEY);
+
+    uavcan::TransferCRC crc_base;
+    crc_base.add(reinterpret_cast<const uint8_t*>("signature"), 9);
+
+    uavcan::TransferCRC expected = crc_base;
+    expected.add(reinterpret_cast<const uint8_t*>("34567qwertyuabcd"), 16);
+
+    // Rejected frames must not affect the CRC
+    CHECK_NOT_COMPLETE(rcv.addFrame(gen(1, "1234567", SET100, 7, 100000000), bk, crc_base));
+    CHECK_NOT_COMPLETE(rcv.addFrame(gen(1, "-------", SET000, 7, 100000100), bk, crc_base));  // Out of order
+    CHECK_NOT_COMPLETE(rcv.addFrame(gen(1, "qwertyu", SET001, 7, 100000300), bk, crc_base));
+    CHECK_NOT_COMPLETE(rcv.addFrame(gen(1, "qwertyu", SET001, 7, 100000300), bk, crc_base));  // Repeated
+    CHECK_COMPLETE(    rcv.addFrame(gen(1, "abcd",    SET010, 7, 100000400), bk, crc_base));
+
+    ASSERT_EQ(0x3231, rcv.getLastTransferCrc());
+    ASSERT_EQ(expected.get(), rcv.getLastTransferComputedCrc());
+
+    // Restart in the middle of a transfer - the CRC is computed anew
+    CHECK_NOT_COMPLETE(rcv.addFrame(gen(1, "1234567", SET100, 8, 100000500), bk, crc_base));
+    CHECK_NOT_COMPLETE(rcv.addFrame(gen(1, "1234567", SET100, 9, 100000600), bk, crc_base));
+    CHECK_NOT_COMPLETE(rcv.addFrame(gen(1, "qwertyu", SET001, 9, 100000700), bk, crc_base));
+    CHECK_COMPLETE(    rcv.addFrame(gen(1, "abcd",    SET010, 9, 100000800), bk, crc_base));
+    ASSERT_EQ(expected.get(), rcv.getLastTransferComputedCrc());
+}
+
 TEST(TransferReceiver, IntervalMeasurement)
 {
     Context<32> context;
@@ -347,6 +379,88 @@ TEST(TransferReceiver, IntervalMeasurement)
     ASSERT_EQ(INTERVAL, rcv.getInterval().toUSec());
 }
 
+TEST(TransferReceiver, LargeTimestamps)
+{
+    using uavcan::TransferReceiver;
+    Context<32> context;
+    RxFrameGenerator gen(789);
+    uavcan::TransferReceiver& rcv = context.receiver;
+    uavcan::TransferBufferAccessor bk(context.bufmgr, RxFrameGenerator::DEFAULT_KEY);
+
+    // The timestamps are not stored as 64-bit fields, so there's no padding for the 8-byte alignment
+    ASSERT_GE(36U, sizeof(TransferReceiver));
+
+    const uint64_t ts = 0x123456789ABULL;
+    const uint64_t utc = 0x7654321012345ULL;
+
+    CHECK_NOT_COMPLETE(rcv.addFrame(gen(1, "1234567", SET100, 0, ts, utc), bk));
+    CHECK_COMPLETE(    rcv.addFrame(gen(1, "abcd",    SET011, 0, ts + 10), bk));
+    ASSERT_EQ(ts, rcv.getLastTransferTimestampMonotonic().toUSec());
+    ASSERT_EQ(ts, rcv.getLastActivityTimestamp().toUSec());
+    ASSERT_EQ(utc, rcv.getLastTransferTimestampUtc().toUSec());
+
+    // The previous transfer is still reported while the next one is in progress
+    CHECK_NOT_COMPLETE(rcv.addFrame(gen(1, "1234567", SET100, 1, ts + 500000, utc + 500000), bk));
+    ASSERT_EQ(ts, rcv.getLastTransferTimestampMonotonic().toUSec());
+    ASSERT_EQ(ts + 500000, rcv.getLastActivityTimestamp().toUSec());
+    CHECK_COMPLETE(    rcv.addFrame(gen(1, "abcd",    SET011, 1, ts + 500010), bk));
+    ASSERT_EQ(ts + 500000, rcv.getLastTransferTimestampMonotonic().toUSec());
+    ASSERT_EQ(utc + 500000, rcv.getLastTransferTimestampUtc().toUSec());
+
+    // Silence much longer than the 32-bit range of microseconds; the interval estimate is limited anyway
+    const uint64_t late_ts = ts + 0x500000000ULL;
+    const unsigned interval_before = unsigned(rcv.getInterval().toMSec());
+    CHECK_SINGLE_FRAME(rcv.addFrame(gen(1, "abc", SET110, 2, late_ts), bk));
+    ASSERT_EQ(late_ts, rcv.getLastTransferTimestampMonotonic().toUSec());
+    ASSERT_EQ((interval_before * 7U + TransferReceiver::MaxTransferIntervalMSec) / 8U,
+              unsigned(rcv.getInterval().toMSec()));
+}
+
+TEST(TransferReceiver, Expiration)
+{
+    Context<32> context;
+    RxFrameGenerator gen(789);
+    uavcan::TransferReceiver& rcv = context.receiver;
+    uavcan::TransferBufferAccessor bk(context.bufmgr, RxFrameGenerator::DEFAULT_KEY);
+
+    // Not measured yet - the transfer ID timeout applies
+    ASSERT_EQ(uavcan::MonotonicDuration::fromMSec(uavcan::TransferReceiver::DefaultTidTimeoutMSec),
+              rcv.getReleaseTimeout());
+
+    static const uint64_t INTERVAL = 50000;
+    uavcan::TransferID tid;
+    uint64_t timestamp = 100000000;
+    for (int i = 0; i < 100; i++)
+    {
+        CHECK_SINGLE_FRAME(rcv.addFrame(gen(1, "123", SET110, tid.get(), timestamp), bk));
+        timestamp += INTERVAL;
+        tid.increment();
+    }
+    timestamp -= INTERVAL;
+    ASSERT_EQ(uavcan::MonotonicDuration::fromMSec(200), rcv.getReleaseTimeout());
+
+    ASSERT_FALSE(rcv.isExpired(tsMono(timestamp + 150000)));
+    ASSERT_TRUE(rcv.isExpired(tsMono(timestamp + 250000)));
+    ASSERT_FALSE(rcv.isTimedOut(tsMono(timestamp + 250000)));
+
+    // Mid-transfer receivers are kept until the transfer ID timeout
+    timestamp += INTERVAL;
+    CHECK_NOT_COMPLETE(rcv.addFrame(gen(1, "1234567", SET100, tid.get(), timestamp), bk));
+    ASSERT_FALSE(rcv.isExpired(tsMono(timestamp + 250000)));
+    ASSERT_TRUE(rcv.isExpired(tsMono(timestamp + 1100000)));
+
+    // Very short intervals are limited from below
+    timestamp += 2000000;
+    for (int i = 0; i < 100; i++)
+    {
+        tid.increment();
+        CHECK_SINGLE_FRAME(rcv.addFrame(gen(1, "123", SET110, tid.get(), timestamp), bk));
+        timestamp += 1000;
+    }
+    ASSERT_EQ(uavcan::MonotonicDuration::fromMSec(uavcan::TransferReceiver::MinReleaseTimeoutMSec),
+              rcv.getReleaseTimeout());
+}
+
 
 TEST(TransferReceiver, Restart)
 {
@@ -447,6 +561,150 @@ TEST(TransferReceiver, UtcTransferTimestamping)
 }
 
 
+TEST(TransferReceiver, Decimation)
+{
+    const uavcan::TransferCRC crc;
+
+    /*
+     * Every 3rd single frame transfer
+     */
+    {
+        Context<32> context;
+        RxFrameGenerator gen(789);
+        uavcan::TransferReceiver& rcv = context.receiver;
+        uavcan::TransferBufferAccessor bk(context.bufmgr, RxFrameGenerator::DEFAULT_KEY);
+        uavcan::TransferDecimation dec;
+        dec.factor = 3;
+
+        for (uint8_t i = 0; i < 7; i++)
+        {
+            const uavcan::RxFrame frame = gen(0, "abc", SET110, i, 1000 + i * 5000U);
+            if ((i % 3) == 0)
+            {
+                CHECK_SINGLE_FRAME(rcv.addFrame(frame, bk, crc, dec));
+            }
+            else
+            {
+                CHECK_SKIPPED(rcv.addFrame(frame, bk, crc, dec));
+            }
+        }
+        ASSERT_EQ(0, rcv.yieldErrorCount());
+        ASSERT_EQ(31000, rcv.getLastTransferTimestampMonotonic().toUSec());     // Skipped ones are tracked too
+    }
+
+    /*
+     * Skipped multi frame transfers don't allocate buffers
+     */
+    {
+        Context<32> context;
+        RxFrameGenerator gen(789);
+        uavcan::TransferReceiver& rcv = context.receiver;
+        uavcan::TransferBufferManager& bufmgr = context.bufmgr;
+        uavcan::TransferBufferAccessor bk(context.bufmgr, RxFrameGenerator::DEFAULT_KEY);
+        uavcan::TransferDecimation dec;
+        dec.factor = 2;
+
+        CHECK_NOT_COMPLETE(rcv.addFrame(gen(0, "\x34\x12" "34567", SET100, 0, 1000), bk, crc, dec));
+        CHECK_COMPLETE(    rcv.addFrame(gen(0, "foo",              SET011, 0, 1100), bk, crc, dec));
+        ASSERT_TRUE(matchBufferContent(bufmgr.access(gen.bufmgr_key), "34567foo"));
+        bk.remove();
+
+        CHECK_NOT_COMPLETE(rcv.addFrame(gen(0, "\x34\x12" "34567", SET100, 1, 2000), bk, crc, dec));
+        ASSERT_FALSE(bufmgr.access(gen.bufmgr_key));
+        CHECK_NOT_COMPLETE(rcv.addFrame(gen(0, "bar",              SET001, 1, 2100), bk, crc, dec));
+        CHECK_NOT_COMPLETE(rcv.addFrame(gen(1, "",                 SET010, 1, 2100), bk, crc, dec)); // Wrong iface
+        CHECK_SKIPPED(     rcv.addFrame(gen(0, "",                 SET010, 1, 2200), bk, crc, dec));
+        ASSERT_FALSE(bufmgr.access(gen.bufmgr_key));
+        ASSERT_EQ(0, context.pool.getNumUsedBlocks());
+
+        CHECK_NOT_COMPLETE(rcv.addFrame(gen(0, "\x34\x12" "12345", SET100, 2, 3000), bk, crc, dec));
+        CHECK_COMPLETE(    rcv.addFrame(gen(0, "baz",              SET011, 2, 3100), bk, crc, dec));
+        ASSERT_TRUE(matchBufferContent(bufmgr.access(gen.bufmgr_key), "12345baz"));
+        ASSERT_EQ(0, rcv.yieldErrorCount());
+    }
+
+    /*
+     * At most one transfer per 20 ms out of a 200 Hz stream
+     */
+    {
+        Context<32> context;
+        RxFrameGenerator gen(789);
+        uavcan::TransferReceiver& rcv = context.receiver;
+        uavcan::TransferBufferAccessor bk(context.bufmgr, RxFrameGenerator::DEFAULT_KEY);
+        uavcan::TransferDecimation dec;
+        dec.min_interval_msec = 20;
+
+        unsigned num_accepted = 0;
+        for (unsigned i = 0; i < 1000; i++)
+        {
+            const uavcan::RxFrame frame = gen(0, "", SET110, uint8_t(i % 32), 1000000 + i * 5000U);
+            const uavcan::TransferReceiver::ResultCode res = rcv.addFrame(frame, bk, crc, dec);
+            if (res == uavcan::TransferReceiver::ResultSingleFrame)
+            {
+                num_accepted++;
+            }
+            else
+            {
+                CHECK_SKIPPED(res);
+            }
+        }
+        ASSERT_EQ(250, num_accepted);
+        ASSERT_EQ(0, rcv.yieldErrorCount());
+    }
+}
+
+TEST(TransferReceiver, OnChange)
+{
+    const uavcan::TransferCRC crc(0xFFFF);
+    Context<32> context;
+    RxFrameGenerator gen(789);
+    uavcan::TransferReceiver& rcv = context.receiver;
+    uavcan::TransferBufferManager& bufmgr = context.bufmgr;
+    uavcan::TransferBufferAccessor bk(context.bufmgr, RxFrameGenerator::DEFAULT_KEY);
+    uavcan::TransferDecimation dec;
+    dec.on_change = true;
+    dec.heartbeat_msec = 100;
+
+    /*
+     * Single frame transfers
+     */
+    CHECK_SINGLE_FRAME(rcv.addFrame(gen(0, "abc", SET110, 0, 1000000), bk, crc, dec));
+    CHECK_SKIPPED(     rcv.addFrame(gen(0, "abc", SET110, 1, 1010000), bk, crc, dec));
+    CHECK_SKIPPED(     rcv.addFrame(gen(0, "abc", SET110, 2, 1090000), bk, crc, dec));
+    CHECK_SINGLE_FRAME(rcv.addFrame(gen(0, "abd", SET110, 3, 1095000), bk, crc, dec));
+    CHECK_SKIPPED(     rcv.addFrame(gen(0, "abd", SET110, 4, 1100000), bk, crc, dec));
+    CHECK_SINGLE_FRAME(rcv.addFrame(gen(0, "abd", SET110, 5, 1195000), bk, crc, dec));     // Heartbeat
+    CHECK_SKIPPED(     rcv.addFrame(gen(0, "abd", SET110, 6, 1200000), bk, crc, dec));
+
+    /*
+     * Multi frame transfers; the CRC is computed over the payload that follows the CRC field
+     */
+    uavcan::TransferCRC payload_crc = crc;
+    payload_crc.add(reinterpret_cast<const uint8_t*>("12345foo"), 8);
+    std::string crc_field;
+    crc_field.push_back(char(payload_crc.get() & 0xFF));
+    crc_field.push_back(char(payload_crc.get() >> 8));
+
+    CHECK_NOT_COMPLETE(rcv.addFrame(gen(0, crc_field + "12345", SET100, 7, 1210000), bk, crc, dec));
+    CHECK_COMPLETE(    rcv.addFrame(gen(0, "foo",               SET011, 7, 1211000), bk, crc, dec));
+    ASSERT_TRUE(matchBufferContent(bufmgr.access(gen.bufmgr_key), "12345foo"));
+    bk.remove();
+
+    CHECK_NOT_COMPLETE(rcv.addFrame(gen(0, crc_field + "12345", SET100, 8, 1220000), bk, crc, dec));
+    CHECK_SKIPPED(     rcv.addFrame(gen(0, "foo",               SET011, 8, 1221000), bk, crc, dec));
+    ASSERT_FALSE(bufmgr.access(gen.bufmgr_key));            // Removed
+
+    // Corrupted transfers are passed to the caller, which will drop them, and they don't affect the state
+    CHECK_NOT_COMPLETE(rcv.addFrame(gen(0, "\x01\x01" "12345", SET100, 9, 1230000), bk, crc, dec));
+    CHECK_COMPLETE(    rcv.addFrame(gen(0, "foo",               SET011, 9, 1231000), bk, crc, dec));
+    bk.remove();
+    CHECK_NOT_COMPLETE(rcv.addFrame(gen(0, crc_field + "12345", SET100, 10, 1240000), bk, crc, dec));
+    CHECK_SKIPPED(     rcv.addFrame(gen(0, "foo",               SET011, 10, 1241000), bk, crc, dec));
+
+    ASSERT_EQ(0, context.pool.getNumUsedBlocks());
+    ASSERT_EQ(0, rcv.yieldErrorCount());
+}
+
 TEST(TransferReceiver, HeaderParsing)
 {
     static const std::string SFT_PAYLOAD = "1234567";
@@ -3,10 +3,13 @@
  */
 
 #include <algorithm>
+#include <cstdlib>
+#include <vector>
 #include <gtest/gtest.h>
 #include "transfer_test_helpers.hpp"
 #include "can/can.hpp"
 #include <uavcan/transport/transfer_sender.hpp>
+#include <uavcan/marshal/bit_stream.hpp>
 
 static int sendOne(uavcan::TransferSender& sender, const std::string& data,
                    uint64_t monotonic_tx_deadline, uint64_t monotonic_blocking_deadline,
@@ -225,6 +228,38 @@ TEST(TransferSender, Loopback)
     EXPECT_EQ(0, dispatcher.getTransferPerfCounter().getRxTransferCount());
 }
 
+TEST(TransferSender, LeastLoadedIface)
+{
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 100, uavcan::MemPoolBlockSize> poolmgr;
+
+    SystemClockMock clockmock(100);
+    CanDriverMock driver(2, clockmock);
+
+    uavcan::Dispatcher dispatcher(driver, poolmgr, clockmock);
+    ASSERT_TRUE(dispatcher.setNodeID(64));
+    dispatcher.getCanIOManager().setTxIfacePolicy(uavcan::CanIOManager::TxIfacePolicyLeastLoaded);
+
+    const uavcan::DataTypeDescriptor desc = makeDataType(uavcan::DataTypeKindMessage, 1);
+    uavcan::TransferSender sender(dispatcher, desc, uavcan::CanTxQueue::Volatile);
+
+    // Transfers alternate between ifaces, frames of a transfer are never split
+    const uint8_t payload[] = "1234567890abcdef";
+    for (int i = 0; i < 4; i++)
+    {
+        ASSERT_EQ(3, sender.send(payload, sizeof(payload) - 1, tsMono(1000), tsMono(0),
+                                 uavcan::TransferTypeMessageBroadcast, 0));
+        const int iface = i % 2;
+        ASSERT_EQ(1 << iface, sender.getLastIfaceMask());
+        ASSERT_EQ(3, driver.ifaces.at(unsigned(iface)).tx.size());
+        ASSERT_TRUE(driver.ifaces.at(unsigned(1 - iface)).tx.empty());
+        while (!driver.ifaces.at(unsigned(iface)).tx.empty())
+        {
+            driver.ifaces.at(unsigned(iface)).tx.pop();
+        }
+    }
+    ASSERT_EQ(3, sender.getIfaceMask() & 3);
+}
+
 TEST(TransferSender, PassiveMode)
 {
     uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 100, uavcan::MemPoolBlockSize> poolmgr;
@@ -263,4 +298,102 @@ TEST(TransferSender, PassiveMode)
     EXPECT_EQ(0, dispatcher.getTransferPerfCounter().getErrorCount());
     EXPECT_EQ(1, dispatcher.getTransferPerfCounter().getTxTransferCount());
     EXPECT_EQ(0, dispatcher.getTransferPerfCounter().getRxTransferCount());
+
+    // The cached CAN ID template must follow the node ID once it's assigned
+    driver.ifaces.at(0).tx.pop();
+    ASSERT_TRUE(dispatcher.setNodeID(42));
+    ASSERT_LE(0, sender.send(Payload, sizeof(Payload), tsMono(1000), uavcan::MonotonicTime(),
+                             uavcan::TransferTypeMessageBroadcast, uavcan::NodeID::Broadcast));
+    ASSERT_FALSE(driver.ifaces.at(0).tx.empty());
+    EXPECT_EQ(42, driver.ifaces.at(0).tx.front().frame.id & 0x7F);
+    EXPECT_EQ(123, (driver.ifaces.at(0).tx.front().frame.id >> 8) & 0xFFFF);
+    EXPECT_EQ(0, driver.ifaces.at(0).tx.front().flags);
+}
+
+
+TEST(TransferSender, OutgoingTransferBuffer)
+{
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 100, uavcan::MemPoolBlockSize> poolmgr;
+
+    SystemClockMock clockmock(100);
+    CanDriverMock driver(1, clockmock);
+
+    uavcan::Dispatcher dispatcher(driver, poolmgr, clockmock);
+    ASSERT_TRUE(dispatcher.setNodeID(64));
+
+    static const uavcan::DataTypeDescriptor TYPE = makeDataType(uavcan::DataTypeKindMessage, 1);
+    uavcan::TransferSender sender(dispatcher, TYPE, uavcan::CanTxQueue::Volatile);
+
+    static const unsigned MaxPayloadLen = 200;
+    static const uint64_t TX_DEADLINE = 1000000;
+
+    std::srand(42);
+    for (unsigned payload_len = 0; payload_len <= MaxPayloadLen; payload_len += 1 + payload_len / 8)
+    {
+        uint8_t payload[MaxPayloadLen];
+        for (unsigned i = 0; i < payload_len; i++)
+        {
+            payload[i] = uint8_t(std::rand());
+        }
+
+        /*
+         * The buffer is filled via the bit stream in unaligned pieces, like the serializer does it
+         */
+        uavcan::OutgoingTransferBuffer<MaxPayloadLen> buffer(sender.getCrcBase());
+        uavcan::BitStream bs(buffer);
+        unsigned bit_offset = 0;
+        while (bit_offset < payload_len * 8)
+        {
+            const unsigned bitlen = std::min(1U + unsigned(std::rand()) % 60U, payload_len * 8 - bit_offset);
+            uint8_t piece[8] = { 0 };
+            uavcan::bitarrayCopy(payload + bit_offset / 8, bit_offset % 8, bitlen, piece, 0);
+            ASSERT_EQ(1, bs.write(piece, bitlen));
+            bit_offset += bitlen;
+        }
+        ASSERT_EQ(payload_len, buffer.getMaxWritePos());
+        ASSERT_TRUE(std::equal(payload, payload + payload_len, buffer.getRawPtr()));
+
+        uavcan::TransferCRC crc = TYPE.getSignature().toTransferCRC();
+        crc.add(payload, payload_len);
+        ASSERT_EQ(crc.get(), buffer.getTransferCRC().get());
+
+        /*
+         * Both ways of sending must produce the same frames
+         */
+        const uavcan::TransferID tid = uavcan::TransferID(uint8_t(payload_len % uavcan::TransferID::Max));
+        ASSERT_LT(0, sender.send(payload, payload_len, uavcan::MonotonicTime::fromUSec(TX_DEADLINE),
+                                 uavcan::MonotonicTime(), uavcan::TransferTypeMessageBroadcast, 0, tid));
+        std::vector<uavcan::CanFrame> reference;
+        while (!driver.ifaces.at(0).tx.empty())
+        {
+            reference.push_back(driver.ifaces.at(0).popTxFrame());
+        }
+
+        ASSERT_EQ(int(reference.size()),
+                  sender.send(buffer, uavcan::MonotonicTime::fromUSec(TX_DEADLINE),
+                              uavcan::MonotonicTime(), uavcan::TransferTypeMessageBroadcast, 0, tid));
+        for (unsigned i = 0; i < reference.size(); i++)
+        {
+            ASSERT_EQ(reference[i], driver.ifaces.at(0).popTxFrame()) << payload_len << " " << i;
+        }
+        ASSERT_TRUE(driver.ifaces.at(0).tx.empty());
+
+        /*
+         * The buffer can be sent again
+         */
+        ASSERT_EQ(int(reference.size()),
+                  sender.send(buffer, uavcan::MonotonicTime::fromUSec(TX_DEADLINE),
+                              uavcan::MonotonicTime(), uavcan::TransferTypeMessageBroadcast, 0, tid));
+        for (unsigned i = 0; i < reference.size(); i++)
+        {
+            ASSERT_EQ(reference[i], driver.ifaces.at(0).popTxFrame()) << payload_len << " " << i;
+        }
+
+        /*
+         * Reset makes it empty
+         */
+        buffer.reset(uavcan::TransferCRC(0x1234));
+        ASSERT_EQ(0, buffer.getMaxWritePos());
+        ASSERT_EQ(0x1234, buffer.getTransferCRC().get());
+    }
 }
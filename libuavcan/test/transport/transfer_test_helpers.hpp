@@ -117,15 +117,14 @@ struct Transfer
  * In reality, uavcan::TransferListener should accept only specific transfer types
  * which are dispatched/filtered by uavcan::Dispatcher.
  */
-class TestListener : public uavcan::TransferListener
+template <typename Base>
+class TestListenerImpl : public Base
 {
-    typedef uavcan::TransferListener Base;
-
     std::queue<Transfer> transfers_;
 
 public:
-    TestListener(uavcan::TransferPerfCounter& perf, const uavcan::DataTypeDescriptor& data_type,
-                 uavcan::uint16_t max_buffer_size, uavcan::IPoolAllocator& allocator)
+    TestListenerImpl(uavcan::TransferPerfCounter& perf, const uavcan::DataTypeDescriptor& data_type,
+                     uavcan::uint16_t max_buffer_size, uavcan::IPoolAllocator& allocator)
         : Base(perf, data_type, max_buffer_size, allocator)
     { }
 
@@ -169,6 +168,8 @@ public:
     bool isEmpty() const { return transfers_.empty(); }
 };
 
+typedef TestListenerImpl<uavcan::TransferListener> TestListener;
+
 
 namespace
 {
@@ -0,0 +1,257 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <queue>
+#include <string>
+#include <gtest/gtest.h>
+#include <uavcan/transport/wildcard_transfer_listener.hpp>
+#include <uavcan/node/global_data_type_registry.hpp>
+#include "transfer_test_helpers.hpp"
+#include "can/can.hpp"
+
+
+namespace
+{
+
+struct MessageA
+{
+    enum { DefaultDataTypeID = 20 };
+    enum { DataTypeKind = uavcan::DataTypeKindMessage };
+    static uavcan::DataTypeSignature getDataTypeSignature() { return uavcan::DataTypeSignature(0x1234567890ULL); }
+    static const char* getDataTypeFullName() { return "wildcard.MessageA"; }
+};
+
+struct MessageB
+{
+    enum { DefaultDataTypeID = 21 };
+    enum { DataTypeKind = uavcan::DataTypeKindMessage };
+    static uavcan::DataTypeSignature getDataTypeSignature() { return uavcan::DataTypeSignature(0x9876543210ULL); }
+    static const char* getDataTypeFullName() { return "wildcard.MessageB"; }
+};
+
+struct ServiceS
+{
+    enum { DefaultDataTypeID = 30 };
+    enum { DataTypeKind = uavcan::DataTypeKindService };
+    static uavcan::DataTypeSignature getDataTypeSignature() { return uavcan::DataTypeSignature(0xABCDEF0123ULL); }
+    static const char* getDataTypeFullName() { return "wildcard.ServiceS"; }
+};
+
+class Emulator : public IncomingTransferEmulatorBase
+{
+    CanDriverMock& target_;
+
+public:
+    Emulator(CanDriverMock& target, uavcan::NodeID dst_node_id)
+        : IncomingTransferEmulatorBase(dst_node_id)
+        , target_(target)
+    { }
+
+    void sendOneFrame(const uavcan::RxFrame& frame)
+    {
+        static_cast<CanIfaceMock*>(target_.getIface(frame.getIfaceIndex()))->pushRx(frame);
+    }
+};
+
+class TestWildcardListener : public uavcan::WildcardTransferListener
+{
+    std::queue<Transfer> transfers_;
+
+    virtual void handleIncomingTransfer(uavcan::IncomingTransfer& transfer, uavcan::DataTypeID dtid,
+                                        uavcan::NodeID dst_node_id, const uavcan::DataTypeDescriptor* data_type)
+    {
+        // Unknown data types are reported with the descriptor that the emulator uses for them
+        const uavcan::DataTypeDescriptor descriptor = (data_type != NULL) ? *data_type :
+            makeDataType(uavcan::getDataTypeKindForTransferType(transfer.getTransferType()), dtid.get());
+        Transfer rx(transfer, descriptor);
+        rx.dst_node_id = dst_node_id;
+        transfers_.push(rx);
+        std::cout << "Wildcard listener: " << rx.toString() << " known=" << (data_type != NULL) << std::endl;
+        if (data_type != NULL)
+        {
+            num_known_++;
+        }
+    }
+
+public:
+    unsigned num_known_;
+
+    TestWildcardListener(uavcan::Dispatcher& dispatcher, uavcan::IPoolAllocator& allocator)
+        : uavcan::WildcardTransferListener(dispatcher, 512, allocator)
+        , num_known_(0)
+    { }
+
+    bool matchAndPop(const Transfer& reference)
+    {
+        if (transfers_.empty())
+        {
+            std::cout << "No received transfers" << std::endl;
+            return false;
+        }
+        const Transfer tr = transfers_.front();
+        transfers_.pop();
+        if (!(tr == reference))
+        {
+            std::cout << "Transfer mismatch:\nExpected: " << reference.toString()
+                      << "\nReceived: " << tr.toString() << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool isEmpty() const { return transfers_.empty(); }
+};
+
+void spinAll(uavcan::Dispatcher& dispatcher, SystemClockMock& clockmock)
+{
+    while (dispatcher.spinOnce() > 0)
+    {
+        clockmock.advance(100);
+    }
+}
+
+}
+
+
+TEST(WildcardTransferListener, Basic)
+{
+    using uavcan::TransferTypeMessageBroadcast;
+    using uavcan::TransferTypeServiceRequest;
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<MessageA> _reg_a;
+    uavcan::DefaultDataTypeRegistrator<MessageB> _reg_b;
+    uavcan::DefaultDataTypeRegistrator<ServiceS> _reg_s;
+
+    const uavcan::GlobalDataTypeRegistry& registry = uavcan::GlobalDataTypeRegistry::instance();
+    const uavcan::DataTypeDescriptor type_a = *registry.find(uavcan::DataTypeKindMessage, 20);
+    const uavcan::DataTypeDescriptor type_b = *registry.find(uavcan::DataTypeKindMessage, 21);
+    const uavcan::DataTypeDescriptor type_s = *registry.find(uavcan::DataTypeKindService, 30);
+    const uavcan::DataTypeDescriptor type_unknown = makeDataType(uavcan::DataTypeKindMessage, 22);
+
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 100, uavcan::MemPoolBlockSize> pool;
+
+    SystemClockMock clockmock(100);
+    CanDriverMock driver(2, clockmock);
+    uavcan::Dispatcher dispatcher(driver, pool, clockmock);
+    ASSERT_TRUE(dispatcher.setNodeID(64));
+    Emulator emulator(driver, 64);
+
+    TestListener regular(dispatcher.getTransferPerfCounter(), type_a, 512, pool);
+    ASSERT_TRUE(dispatcher.registerMessageListener(&regular));
+
+    const std::string long_payload(100, 'a');
+    const std::string short_payload = "short";
+
+    {
+        TestWildcardListener listener(dispatcher, pool);
+        EXPECT_FALSE(listener.isListening());
+        listener.startListening();
+        listener.startListening();
+        EXPECT_TRUE(listener.isListening());
+        EXPECT_EQ(1, dispatcher.getNumWildcardListeners());
+
+        /*
+         * Default filter - everything addressed to this node
+         */
+        const Transfer transfers[] =
+        {
+            emulator.makeTransfer(1, TransferTypeMessageBroadcast, 10, long_payload, type_a),
+            emulator.makeTransfer(2, TransferTypeMessageBroadcast, 11, short_payload, type_b),
+            emulator.makeTransfer(3, TransferTypeServiceRequest, 12, long_payload, type_s),
+            emulator.makeTransfer(4, TransferTypeMessageBroadcast, 13, short_payload, type_unknown),
+            emulator.makeTransfer(5, TransferTypeMessageBroadcast, 14, long_payload, type_unknown),
+            emulator.makeTransfer(6, TransferTypeServiceRequest, 15, short_payload, type_s, 100)  // Not to us
+        };
+        emulator.send(transfers);
+        spinAll(dispatcher, clockmock);
+
+        // Concurrent transfers are interleaved frame by frame, so the single frame transfers come first
+        ASSERT_TRUE(listener.matchAndPop(transfers[1]));
+        ASSERT_TRUE(listener.matchAndPop(transfers[3]));
+        ASSERT_TRUE(listener.matchAndPop(transfers[0]));
+        ASSERT_TRUE(listener.matchAndPop(transfers[2]));
+        EXPECT_TRUE(listener.isEmpty());
+        EXPECT_EQ(3, listener.num_known_);
+        EXPECT_EQ(4, listener.getNumTransfers());
+        EXPECT_EQ(1, listener.getNumUnknownDataTypeTransfers());
+        EXPECT_EQ(0, listener.getNumErrors());
+
+        // The regular listener is not affected
+        ASSERT_TRUE(regular.matchAndPop(transfers[0]));
+        EXPECT_TRUE(regular.isEmpty());
+
+        EXPECT_LT(0, listener.getNumReceivers());
+        EXPECT_LT(0, pool.getNumUsedBlocks());
+
+        /*
+         * Promiscuous mode, data type ID range and transfer type mask
+         */
+        uavcan::WildcardTransferFilter filter;
+        filter.promiscuous = true;
+        filter.data_type_id_min = 21;
+        filter.transfer_type_mask = uint8_t(uavcan::WildcardTransferFilter::makeTransferTypeMask(
+            TransferTypeMessageBroadcast) | uavcan::WildcardTransferFilter::makeTransferTypeMask(
+            TransferTypeServiceRequest));
+        listener.setFilter(filter);
+
+        const Transfer transfers2[] =
+        {
+            emulator.makeTransfer(1, TransferTypeMessageBroadcast, 10, long_payload, type_a),   // Out of range
+            emulator.makeTransfer(2, TransferTypeServiceRequest, 15, long_payload, type_s, 100),
+            emulator.makeTransfer(3, uavcan::TransferTypeServiceResponse, 12, short_payload, type_s)  // Masked
+        };
+        emulator.send(transfers2);
+        spinAll(dispatcher, clockmock);
+
+        ASSERT_TRUE(listener.matchAndPop(transfers2[1]));
+        EXPECT_TRUE(listener.isEmpty());
+        ASSERT_TRUE(regular.matchAndPop(transfers2[0]));
+
+        /*
+         * Data type ID mask; the registry is frozen, so the lookups are cached
+         */
+        uavcan::GlobalDataTypeRegistry::instance().freeze();
+        filter = uavcan::WildcardTransferFilter();
+        filter.data_type_id_mask = 1;
+        filter.data_type_id_value = 1;      // Odd data type IDs only
+        listener.setFilter(filter);
+
+        const Transfer transfers3[] =
+        {
+            emulator.makeTransfer(1, TransferTypeMessageBroadcast, 10, long_payload, type_a),
+            emulator.makeTransfer(2, TransferTypeMessageBroadcast, 11, long_payload, type_b),
+            emulator.makeTransfer(3, TransferTypeMessageBroadcast, 12, short_payload, type_b)
+        };
+        emulator.send(transfers3);
+        spinAll(dispatcher, clockmock);
+
+        ASSERT_TRUE(listener.matchAndPop(transfers3[2]));
+        ASSERT_TRUE(listener.matchAndPop(transfers3[1]));
+        EXPECT_TRUE(listener.isEmpty());
+        ASSERT_TRUE(regular.matchAndPop(transfers3[0]));
+
+        /*
+         * Bad CRC
+         */
+        Transfer broken = emulator.makeTransfer(1, TransferTypeMessageBroadcast, 11, long_payload, type_b);
+        broken.data_type = makeDataType(uavcan::DataTypeKindMessage, 21);
+        emulator.send(&broken, 1);
+        spinAll(dispatcher, clockmock);
+        EXPECT_TRUE(listener.isEmpty());
+        EXPECT_EQ(1, listener.getNumErrors());
+
+        /*
+         * The receivers are released by the cleanup of the dispatcher
+         */
+        dispatcher.cleanup(tsMono(100000000));
+        EXPECT_EQ(0, listener.getNumReceivers());
+    }
+
+    // Unregistered upon destruction
+    EXPECT_EQ(0, dispatcher.getNumWildcardListeners());
+    dispatcher.unregisterMessageListener(&regular);
+    dispatcher.cleanup(tsMono(100000000));
+    EXPECT_EQ(0, pool.getNumUsedBlocks());
+}
@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#if __GNUC__
+// We need auto_ptr for compatibility reasons
+# pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+#endif
+
+#include <memory>
+#include <gtest/gtest.h>
+#include <uavcan/util/hash_map.hpp>
+
+
+namespace
+{
+
+struct IntKey
+{
+    int value;
+
+    IntKey() : value(-1) { }
+    IntKey(int arg_value) : value(arg_value) { }  // Implicit
+
+    bool operator==(const IntKey& rhs) const { return value == rhs.value; }
+
+    unsigned getHash() const { return unsigned(value); }
+};
+
+bool oddValuePredicate(const IntKey& key, const long& value)
+{
+    EXPECT_LE(0, key.value);
+    return (value & 1) != 0;
+}
+
+struct ValueFindPredicate
+{
+    const long target;
+    ValueFindPredicate(long target) : target(target) { }
+    bool operator()(const IntKey&, const long& value) const { return value == target; }
+};
+
+}
+
+TEST(HashMap, Basic)
+{
+    static const int POOL_BLOCKS = 8;
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * POOL_BLOCKS, uavcan::MemPoolBlockSize> pool;
+
+    typedef uavcan::HashMap<IntKey, long, 4> MapType;
+    std::auto_ptr<MapType> map(new MapType(pool));
+
+    // Empty
+    ASSERT_FALSE(map->access(1));
+    map->remove(8);
+    ASSERT_EQ(0, pool.getNumUsedBlocks());
+    ASSERT_EQ(0, map->getSize());
+    ASSERT_TRUE(map->isEmpty());
+    ASSERT_FALSE(map->getByIndex(0));
+
+    // Insertion - keys 1, 5, 9 share the same bucket
+    ASSERT_EQ(10, *map->insert(1, 10));
+    ASSERT_EQ(50, *map->insert(5, 50));
+    ASSERT_EQ(90, *map->insert(9, 90));
+    ASSERT_EQ(20, *map->insert(2, 20));
+    ASSERT_EQ(4, map->getSize());
+    ASSERT_EQ(4, pool.getNumUsedBlocks());     // One block per KV pair
+    ASSERT_FALSE(map->isEmpty());
+
+    ASSERT_EQ(10, *map->access(1));
+    ASSERT_EQ(50, *map->access(5));
+    ASSERT_EQ(90, *map->access(9));
+    ASSERT_EQ(20, *map->access(2));
+    ASSERT_FALSE(map->access(13));
+    ASSERT_FALSE(map->access(3));
+
+    // Replacing - no new allocations
+    ASSERT_EQ(11, *map->insert(1, 11));
+    ASSERT_EQ(4, map->getSize());
+    ASSERT_EQ(4, pool.getNumUsedBlocks());
+    ASSERT_EQ(11, *map->access(1));
+
+    // Finding
+    ASSERT_EQ(5, map->find(ValueFindPredicate(50))->value);
+    ASSERT_EQ(2, map->find(ValueFindPredicate(20))->value);
+    ASSERT_FALSE(map->find(ValueFindPredicate(10)));
+
+    // Iteration by index
+    long sum = 0;
+    for (unsigned i = 0; i < map->getSize(); i++)
+    {
+        ASSERT_TRUE(map->getByIndex(i));
+        sum += map->getByIndex(i)->value;
+    }
+    ASSERT_EQ(11 + 50 + 90 + 20, sum);
+    ASSERT_FALSE(map->getByIndex(4));
+
+    // Removing from the middle of a bucket
+    map->remove(5);
+    map->remove(1000);
+    ASSERT_EQ(3, map->getSize());
+    ASSERT_EQ(3, pool.getNumUsedBlocks());
+    ASSERT_EQ(11, *map->access(1));
+    ASSERT_FALSE(map->access(5));
+    ASSERT_EQ(90, *map->access(9));
+
+    // Filling up
+    for (int i = 100; i < 200; i++)
+    {
+        if (map->insert(i, i) == NULL)
+        {
+            break;
+        }
+    }
+    ASSERT_EQ(0, pool.getNumFreeBlocks());
+    ASSERT_EQ(POOL_BLOCKS, map->getSize());
+    ASSERT_FALSE(map->insert(1000, 1000));
+    ASSERT_FALSE(map->access(1000));
+
+    // Removing odd values
+    map->removeAllWhere(oddValuePredicate);
+    for (unsigned i = 0; i < map->getSize(); i++)
+    {
+        ASSERT_FALSE(map->getByIndex(i)->value & 1);
+    }
+    ASSERT_FALSE(map->access(1));
+    ASSERT_EQ(20, *map->access(2));
+
+    // Making sure the memory will be released
+    map.reset();
+    ASSERT_EQ(0, pool.getNumUsedBlocks());
+}
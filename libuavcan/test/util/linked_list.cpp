@@ -139,3 +139,109 @@ TEST(LinkedList, Sorting)
         item = item->getNextListNode();
     }
 }
+
+struct DoublyLinkedListItem : uavcan::DoublyLinkedListNode<DoublyLinkedListItem>
+{
+    int value;
+
+    DoublyLinkedListItem(int value = 0)
+        : value(value)
+    { }
+
+    struct GreaterThanComparator
+    {
+        const int compare_with;
+
+        GreaterThanComparator(int compare_with)
+            : compare_with(compare_with)
+        { }
+
+        bool operator()(const DoublyLinkedListItem* item) const
+        {
+            return item->value > compare_with;
+        }
+    };
+};
+
+static bool checkBackLinks(const uavcan::LinkedListRoot<DoublyLinkedListItem>& root)
+{
+    const DoublyLinkedListItem* prev = NULL;
+    for (const DoublyLinkedListItem* p = root.get(); p != NULL; p = p->getNextListNode())
+    {
+        if ((p->getPrevListNode() != prev) || !root.contains(p))
+        {
+            return false;
+        }
+        prev = p;
+    }
+    return true;
+}
+
+TEST(LinkedList, DoublyLinked)
+{
+    uavcan::LinkedListRoot<DoublyLinkedListItem> root;
+    DoublyLinkedListItem items[] = {0, 1, 2, 3, 4, 5};
+
+    EXPECT_FALSE(root.contains(items + 0));
+    root.remove(items + 0);                         // Not in the list - ignored
+    EXPECT_EQ(0, root.getLength());
+
+    root.insert(items + 0);
+    root.insert(items + 0);                         // Insert twice - second will be ignored
+    EXPECT_EQ(1, root.getLength());
+    EXPECT_TRUE(root.contains(items + 0));
+    EXPECT_TRUE(checkBackLinks(root));
+
+    root.remove(items + 0);
+    root.remove(items + 0);
+    EXPECT_EQ(0, root.getLength());
+    EXPECT_FALSE(root.contains(items + 0));
+    EXPECT_FALSE(items[0].getPrevListNode());
+
+    /*
+     * Sorted insertion, in random order and with duplicates
+     */
+    const int order[] = {2, 3, 0, 2, 4, 1, 1, 5};
+    for (unsigned i = 0; i < sizeof(order) / sizeof(order[0]); i++)
+    {
+        DoublyLinkedListItem& item = items[order[i]];
+        root.insertBefore(&item, DoublyLinkedListItem::GreaterThanComparator(item.value));
+        EXPECT_TRUE(checkBackLinks(root));
+    }
+    EXPECT_EQ(6, root.getLength());
+
+    int expected = 0;
+    for (const DoublyLinkedListItem* p = root.get(); p != NULL; p = p->getNextListNode())
+    {
+        EXPECT_EQ(expected++, p->value);
+    }
+
+    /*
+     * Removal from the middle, from the end, and from the beginning
+     */
+    root.remove(items + 3);
+    EXPECT_TRUE(checkBackLinks(root));
+    root.remove(items + 5);
+    EXPECT_TRUE(checkBackLinks(root));
+    root.remove(items + 0);
+    EXPECT_TRUE(checkBackLinks(root));
+    EXPECT_EQ(3, root.getLength());
+    EXPECT_EQ(1, root.get()->value);
+    EXPECT_FALSE(root.contains(items + 3));
+    EXPECT_FALSE(root.contains(items + 5));
+    EXPECT_FALSE(root.contains(items + 0));
+
+    /*
+     * The first node of another list is not affected
+     */
+    uavcan::LinkedListRoot<DoublyLinkedListItem> other;
+    other.insertNew(items + 0);
+    root.remove(items + 0);
+    EXPECT_EQ(1, other.getLength());
+    EXPECT_TRUE(other.contains(items + 0));
+
+    root.remove(items + 1);
+    root.remove(items + 2);
+    root.remove(items + 4);
+    EXPECT_TRUE(root.isEmpty());
+}
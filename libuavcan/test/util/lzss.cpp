@@ -0,0 +1,247 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <gtest/gtest.h>
+#include <uavcan/util/lzss.hpp>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+
+struct LzssVectorOutput : public uavcan::ILzssOutput
+{
+    std::vector<uint8_t> data;
+    unsigned num_writes;
+    unsigned max_size;
+
+    LzssVectorOutput()
+        : num_writes(0)
+        , max_size(0xFFFFFFFFU)
+    { }
+
+    virtual int write(const uint8_t* ptr, unsigned size)
+    {
+        if ((data.size() + size) > max_size)
+        {
+            return -uavcan::ErrMemory;
+        }
+        data.insert(data.end(), ptr, ptr + size);
+        num_writes++;
+        return 0;
+    }
+};
+
+static std::vector<uint8_t> compress(const std::vector<uint8_t>& input, uint8_t window_log2, unsigned chunk_size)
+{
+    static uavcan::LzssCompressor compressor;       // Too large for the stack
+    LzssVectorOutput output;
+    EXPECT_EQ(0, compressor.begin(uint32_t(input.size()), output, window_log2));
+    for (unsigned offset = 0; offset < input.size(); offset += chunk_size)
+    {
+        const unsigned size = std::min<unsigned>(chunk_size, unsigned(input.size() - offset));
+        EXPECT_EQ(0, compressor.feed(&input[offset], size));
+    }
+    EXPECT_TRUE(compressor.isFinished());
+    EXPECT_EQ(output.data.size(), compressor.getCompressedSize());
+    return output.data;
+}
+
+template <unsigned WindowLog2>
+static std::vector<uint8_t> decompress(const std::vector<uint8_t>& input, unsigned chunk_size)
+{
+    uavcan::LzssDecompressor<WindowLog2> decompressor;
+    LzssVectorOutput output;
+    for (unsigned offset = 0; offset < input.size(); offset += chunk_size)
+    {
+        const unsigned size = std::min<unsigned>(chunk_size, unsigned(input.size() - offset));
+        EXPECT_EQ(0, decompressor.feed(&input[offset], size, output));
+    }
+    EXPECT_TRUE(decompressor.isFinished());
+    EXPECT_EQ(output.data.size(), decompressor.getNumBytesProduced());
+    EXPECT_EQ(output.data.size(), decompressor.getUncompressedSize());
+    return output.data;
+}
+
+/**
+ * Looks like machine code: repeated instruction patterns with varying operands.
+ */
+static std::vector<uint8_t> makeImage(unsigned size)
+{
+    std::vector<uint8_t> image;
+    while (image.size() < size)
+    {
+        const uint8_t pattern[] = { 0x4F, 0xF0, uint8_t(std::rand() % 8), 0x03, 0x13, 0x60, 0x70, 0x47 };
+        const unsigned len = unsigned(std::rand() % 8) + 1;
+        image.insert(image.end(), pattern, pattern + len);
+        if (std::rand() % 4 == 0)
+        {
+            image.push_back(uint8_t(std::rand()));
+        }
+    }
+    image.resize(size);
+    return image;
+}
+
+TEST(Lzss, RoundTrip)
+{
+    std::srand(42);
+
+    const std::vector<uint8_t> image = makeImage(100000);
+
+    const std::vector<uint8_t> compressed = compress(image, uavcan::LzssMaxWindowLog2, 256);
+    std::cout << "LZSS: " << image.size() << " --> " << compressed.size() << std::endl;
+    ASSERT_LT(compressed.size(), image.size() / 2);
+
+    // Header
+    ASSERT_EQ('L', compressed[0]);
+    ASSERT_EQ('Z', compressed[1]);
+    ASSERT_EQ('S', compressed[2]);
+    ASSERT_EQ(12, compressed[3]);
+    ASSERT_EQ(100000U, compressed[4] | (compressed[5] << 8) | (compressed[6] << 16) | (unsigned(compressed[7]) << 24));
+
+    // Chunk sizes do not affect the result
+    ASSERT_TRUE(compressed == compress(image, uavcan::LzssMaxWindowLog2, 1));
+    ASSERT_TRUE(compressed == compress(image, uavcan::LzssMaxWindowLog2, 10007));
+
+    ASSERT_TRUE(image == decompress<12>(compressed, 256));
+    ASSERT_TRUE(image == decompress<12>(compressed, 1));
+    ASSERT_TRUE(image == decompress<12>(compressed, 5000));
+
+    // Smallest window
+    const std::vector<uint8_t> compressed_small = compress(image, uavcan::LzssMinWindowLog2, 256);
+    std::cout << "LZSS with small window: " << image.size() << " --> " << compressed_small.size() << std::endl;
+    ASSERT_LT(compressed_small.size(), image.size());
+    ASSERT_TRUE(image == decompress<8>(compressed_small, 256));
+    ASSERT_TRUE(image == decompress<12>(compressed_small, 256));
+}
+
+TEST(Lzss, EdgeCases)
+{
+    std::srand(42);
+
+    // Empty
+    {
+        const std::vector<uint8_t> empty;
+        const std::vector<uint8_t> compressed = compress(empty, 8, 1);
+        ASSERT_EQ(uavcan::LzssHeaderSize, compressed.size());
+        ASSERT_TRUE(decompress<8>(compressed, 1).empty());
+    }
+
+    // Incompressible data; the overhead is one bit per byte
+    {
+        std::vector<uint8_t> noise;
+        for (unsigned i = 0; i < 10000; i++)
+        {
+            noise.push_back(uint8_t(std::rand()));
+        }
+        const std::vector<uint8_t> compressed = compress(noise, 12, 256);
+        ASSERT_GE(uavcan::LzssHeaderSize + 10000 + 1250 + 1, compressed.size());
+        ASSERT_TRUE(noise == decompress<12>(compressed, 100));
+    }
+
+    // Very long runs, overlapping back references; the ratio is limited by the maximum match length
+    {
+        std::vector<uint8_t> zeros(20000, 0);
+        zeros.push_back(1);
+        const std::vector<uint8_t> compressed = compress(zeros, 8, 256);
+        ASSERT_GT(20000U / 8U, compressed.size());
+        ASSERT_TRUE(zeros == decompress<8>(compressed, 256));
+    }
+
+    // Short inputs
+    for (unsigned size = 1; size < 40; size++)
+    {
+        std::vector<uint8_t> input;
+        for (unsigned i = 0; i < size; i++)
+        {
+            input.push_back(uint8_t("abcabcab"[i % 8]));
+        }
+        ASSERT_TRUE(input == decompress<12>(compress(input, 12, 3), 1));
+    }
+}
+
+TEST(Lzss, Errors)
+{
+    std::srand(42);
+
+    const std::vector<uint8_t> image = makeImage(5000);
+    LzssVectorOutput output;
+
+    // Compressor misuse
+    {
+        uavcan::LzssCompressor* const compressor = new uavcan::LzssCompressor;
+        const uint8_t data[4] = { 1, 2, 3, 4 };
+        ASSERT_EQ(-uavcan::ErrNotInited, compressor->feed(data, 4));
+        ASSERT_EQ(-uavcan::ErrInvalidParam, compressor->begin(4, output, 7));
+        ASSERT_EQ(-uavcan::ErrInvalidParam, compressor->begin(4, output, 13));
+
+        ASSERT_EQ(0, compressor->begin(3, output));
+        ASSERT_EQ(-uavcan::ErrInvalidParam, compressor->feed(data, 4));     // Too much
+        ASSERT_FALSE(compressor->isFinished());
+        ASSERT_EQ(0, compressor->feed(data, 3));
+        ASSERT_TRUE(compressor->isFinished());
+
+        // Output failure
+        LzssVectorOutput small_output;
+        small_output.max_size = 100;
+        ASSERT_EQ(0, compressor->begin(uint32_t(image.size()), small_output));
+        ASSERT_EQ(-uavcan::ErrMemory, compressor->feed(&image[0], unsigned(image.size())));
+        ASSERT_FALSE(compressor->isFinished());
+        ASSERT_EQ(-uavcan::ErrNotInited, compressor->feed(&image[0], 1));
+        delete compressor;
+    }
+
+    const std::vector<uint8_t> compressed = compress(image, 12, 256);
+
+    // Window is too large for the decompressor
+    {
+        uavcan::LzssDecompressor<11> decompressor;
+        ASSERT_EQ(-uavcan::ErrNotSupported, decompressor.feed(&compressed[0], unsigned(compressed.size()), output));
+        ASSERT_FALSE(decompressor.isFinished());
+        ASSERT_EQ(-uavcan::ErrLogic, decompressor.feed(&compressed[0], 1, output));   // Must be reset
+
+        decompressor.reset();
+        const std::vector<uint8_t> compressed_small = compress(image, 11, 256);
+        ASSERT_EQ(0, decompressor.feed(&compressed_small[0], unsigned(compressed_small.size()), output));
+        ASSERT_TRUE(decompressor.isFinished());
+    }
+
+    // Bad magic
+    {
+        std::vector<uint8_t> bad = compressed;
+        bad[1] = 'X';
+        uavcan::LzssDecompressor<> decompressor;
+        ASSERT_EQ(-uavcan::ErrInvalidMarshalData, decompressor.feed(&bad[0], unsigned(bad.size()), output));
+    }
+
+    // Back reference before the beginning of the stream
+    {
+        const uint8_t bad[] = { 'L', 'Z', 'S', 8, 10, 0, 0, 0, 0x01, 'a', 0x01, 0x00 };
+        uavcan::LzssDecompressor<8> decompressor;
+        ASSERT_EQ(-uavcan::ErrInvalidMarshalData, decompressor.feed(bad, sizeof(bad), output));
+    }
+
+    // Back reference longer than the declared size
+    {
+        const uint8_t bad[] = { 'L', 'Z', 'S', 8, 4, 0, 0, 0, 0x01, 'a', 0x00, 0x05 };
+        uavcan::LzssDecompressor<8> decompressor;
+        ASSERT_EQ(-uavcan::ErrInvalidMarshalData, decompressor.feed(bad, sizeof(bad), output));
+    }
+
+    // Padding after the end is ignored
+    {
+        std::vector<uint8_t> padded = compressed;
+        padded.resize(padded.size() + 100, 0xAA);
+        ASSERT_TRUE(image == decompress<12>(padded, 256));
+    }
+
+    // Output failure
+    {
+        LzssVectorOutput small_output;
+        small_output.max_size = 1000;
+        uavcan::LzssDecompressor<> decompressor;
+        ASSERT_EQ(-uavcan::ErrMemory, decompressor.feed(&compressed[0], unsigned(compressed.size()), small_output));
+        ASSERT_FALSE(decompressor.isFinished());
+    }
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <poll.h>
+#include <unistd.h>
+#include <uavcan_linux/uavcan_linux.hpp>
+#include <uavcan/protocol/node_status_monitor.hpp>
+#include "debug.hpp"
+
+/*
+ * This application runs the node from an application-owned poll() loop, which also serves the standard input.
+ * An asio or libuv based application would do the same with its own reactor.
+ */
+static uavcan_linux::NodePtr initNode(const std::vector<std::string>& ifaces, uavcan::NodeID nid,
+                                      const std::string& name)
+{
+    auto node = uavcan_linux::makeNode(ifaces, name.c_str(),
+                                       uavcan::protocol::SoftwareVersion(), uavcan::protocol::HardwareVersion(), nid);
+    node->getLogger().setLevel(uavcan::protocol::debug::LogLevel::DEBUG);
+    node->setModeOperational();
+    return node;
+}
+
+static void runEventLoop(const uavcan_linux::NodePtr& node)
+{
+    auto log_sub = node->makeSubscriber<uavcan::protocol::debug::LogMessage>(
+        [](const uavcan::ReceivedDataStructure<uavcan::protocol::debug::LogMessage>& msg)
+        {
+            std::cout << msg << std::endl;
+        });
+
+    struct NodeStatusMonitor : public uavcan::NodeStatusMonitor
+    {
+        explicit NodeStatusMonitor(uavcan::INode& node) : uavcan::NodeStatusMonitor(node) { }
+
+        void handleNodeStatusChange(const NodeStatusChangeEvent& event) override
+        {
+            std::cout << "Remote node NID " << int(event.node_id.get()) << " changed status: "
+                      << event.old_status.toString() << " --> " << event.status.toString() << std::endl;
+        }
+    };
+    NodeStatusMonitor nsm(*node);
+    ENFORCE(0 == nsm.start());
+
+    std::cout << "Lines typed into stdin will be published as log messages" << std::endl;
+
+    while (true)
+    {
+        /*
+         * The set of descriptors and the deadline must be re-read on every iteration.
+         */
+        std::vector<::pollfd> pollfds = node->getPollFds();
+        auto stdin_pfd = ::pollfd();
+        stdin_pfd.fd = STDIN_FILENO;
+        stdin_pfd.events = POLLIN;
+        pollfds.push_back(stdin_pfd);
+
+        const std::int64_t timeout_usec = node->getTimeUntilNextDeadline().toUSec();
+        const int timeout_ms = int(std::min<std::int64_t>((timeout_usec + 999) / 1000, 1000 * 1000));
+
+        const int poll_res = ::poll(pollfds.data(), pollfds.size(), timeout_ms);
+        ENFORCE(poll_res >= 0);
+
+        if (pollfds.back().revents & POLLIN)
+        {
+            std::string line;
+            if (!std::getline(std::cin, line))
+            {
+                break;
+            }
+            node->logInfo("stdin", "%*", line.c_str());
+        }
+
+        const int res = node->processReady();
+        if (res < 0)
+        {
+            std::cerr << "Processing error: " << res << std::endl;
+        }
+    }
+}
+
+int main(int argc, const char** argv)
+{
+    try
+    {
+        if (argc < 3)
+        {
+            std::cerr << "Usage:\n\t" << argv[0] << " <node-id> <can-iface-name-1> [can-iface-name-N...]" << std::endl;
+            return 1;
+        }
+        const int self_node_id = std::stoi(argv[1]);
+        std::vector<std::string> iface_names(argv + 2, argv + argc);
+        auto node = initNode(iface_names, self_node_id, "org.uavcan.linux_test_event_loop");
+        runEventLoop(node);
+        return 0;
+    }
+    catch (const std::exception& ex)
+    {
+        std::cerr << "Exception: " << ex.what() << std::endl;
+        return 1;
+    }
+}
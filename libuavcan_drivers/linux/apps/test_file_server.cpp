@@ -11,6 +11,7 @@
 #include "debug.hpp"
 // UAVCAN
 #include <uavcan/protocol/file_server.hpp>
+#include <uavcan/protocol/firmware_delta.hpp>
 // UAVCAN Linux drivers
 #include <uavcan_linux/uavcan_linux.hpp>
 // UAVCAN POSIX drivers
@@ -50,7 +51,11 @@ void runForever(const uavcan_linux::NodePtr& node)
 {
     uavcan_posix::BasicFileServerBackend backend(*node);
 
-    uavcan::FileServer server(*node, backend);
+    // Block manifests for delta firmware updates; enough for images of nearly 8 MB with the default block size
+    static uavcan::uint8_t manifest_cache[128 * 1024];
+    uavcan::FirmwareBlockManifestFileServerBackend manifest_backend(backend, manifest_cache, sizeof(manifest_cache));
+
+    uavcan::FileServer server(*node, manifest_backend);
 
     const int server_init_res = server.start();
     if (server_init_res < 0)
@@ -0,0 +1,284 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <algorithm>
+#include <array>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <uavcan_linux/uavcan_linux.hpp>
+#include <uavcan/protocol/debug/KeyValue.hpp>
+#include "debug.hpp"
+
+/*
+ * Latency and throughput benchmark; it implements the same protocol as the benchmark firmware of the STM32 test
+ * project (libuavcan_drivers/stm32/test_stm32f107/src/benchmark.cpp), where the protocol is described, so the host
+ * and the boards can be benchmarked against each other in any combination.
+ */
+namespace
+{
+
+using uavcan::protocol::debug::KeyValue;
+
+constexpr std::uint8_t KeyPing = 'P';
+constexpr std::uint8_t KeyReply = 'R';
+constexpr unsigned ValueModulo = 1U << 24;
+
+constexpr unsigned SingleFrameKeyLen = 2;
+constexpr unsigned MultiFrameKeyLen = KeyValue::FieldTypes::key::MaxSize;
+
+constexpr unsigned NumLatencySamples = 1000;
+constexpr unsigned MaxWindow = 16;
+const auto ThroughputTestDuration = uavcan::MonotonicDuration::fromMSec(3000);
+const auto ReplyTimeout = uavcan::MonotonicDuration::fromMSec(100);
+
+class Benchmark
+{
+    struct PendingPing
+    {
+        uavcan::MonotonicTime sent_at;
+        std::uint32_t seq = 0;
+        bool active = false;
+    };
+
+    uavcan_linux::NodePtr node_;
+    uavcan_linux::PublisherPtr<KeyValue> pub_;
+    uavcan_linux::SubscriberPtr<KeyValue> sub_;
+
+    std::array<PendingPing, MaxWindow> pending_;
+    std::uint32_t next_seq_ = 0;
+    unsigned num_pending_ = 0;
+    unsigned num_completed_ = 0;
+    unsigned num_lost_ = 0;
+    std::vector<std::uint32_t> rtt_samples_;
+
+    void handleKeyValue(const uavcan::ReceivedDataStructure<KeyValue>& msg)
+    {
+        if (msg.key.size() < SingleFrameKeyLen)
+        {
+            return;
+        }
+        if (msg.key[0] == KeyPing)
+        {
+            KeyValue reply = msg;
+            reply.key[0] = KeyReply;
+            (void)pub_->broadcast(reply);
+        }
+        else if ((msg.key[0] == KeyReply) && (msg.key[1] == node_->getNodeID().get()))
+        {
+            const auto seq = std::uint32_t(msg.value);
+            PendingPing& p = pending_[seq % MaxWindow];
+            if (p.active && (p.seq == seq))
+            {
+                p.active = false;
+                num_pending_--;
+                num_completed_++;
+                rtt_samples_.push_back(std::uint32_t((msg.getMonotonicTimestamp() - p.sent_at).toUSec()));
+            }
+        }
+    }
+
+    bool sendPing(unsigned key_len)
+    {
+        PendingPing& p = pending_[next_seq_ % MaxWindow];
+        if (p.active)
+        {
+            return false;
+        }
+
+        KeyValue msg;
+        msg.value = float(next_seq_);
+        msg.key.push_back(KeyPing);
+        msg.key.push_back(node_->getNodeID().get());
+        while (msg.key.size() < key_len)
+        {
+            msg.key.push_back('x');
+        }
+
+        p.sent_at = node_->getMonotonicTime();
+        if (pub_->broadcast(msg) < 0)
+        {
+            return false;
+        }
+        p.seq = next_seq_;
+        p.active = true;
+        num_pending_++;
+        next_seq_ = (next_seq_ + 1U) % ValueModulo;
+        return true;
+    }
+
+    void expirePendingPings(bool all)
+    {
+        const uavcan::MonotonicTime deadline = node_->getMonotonicTime() - ReplyTimeout;
+        for (PendingPing& p : pending_)
+        {
+            if (p.active && (all || (p.sent_at < deadline)))
+            {
+                p.active = false;
+                num_pending_--;
+                num_lost_++;
+            }
+        }
+    }
+
+    void spinUntil(uavcan::MonotonicTime deadline)
+    {
+        while (node_->getMonotonicTime() < deadline)
+        {
+            (void)node_->spinOnce();
+        }
+    }
+
+    void resetCounters()
+    {
+        expirePendingPings(true);
+        num_completed_ = 0;
+        num_lost_ = 0;
+        rtt_samples_.clear();
+    }
+
+    void runLatencyTest(const std::string& name, unsigned key_len)
+    {
+        resetCounters();
+        for (unsigned i = 0; i < NumLatencySamples; i++)
+        {
+            while (!sendPing(key_len))
+            {
+                (void)node_->spinOnce();
+            }
+            const uavcan::MonotonicTime deadline = node_->getMonotonicTime() + ReplyTimeout;
+            while ((num_pending_ > 0) && (node_->getMonotonicTime() < deadline))
+            {
+                (void)node_->spinOnce();
+            }
+            expirePendingPings(true);
+        }
+
+        if (rtt_samples_.empty())
+        {
+            std::cout << name << " RTT: no replies" << std::endl;
+            return;
+        }
+        std::sort(rtt_samples_.begin(), rtt_samples_.end());
+        std::cout << name << " RTT usec:"
+                  << " min=" << rtt_samples_.front()
+                  << " p50=" << rtt_samples_[rtt_samples_.size() / 2]
+                  << " p99=" << rtt_samples_[(rtt_samples_.size() * 99U) / 100U]
+                  << " max=" << rtt_samples_.back()
+                  << " lost=" << num_lost_ << std::endl;
+    }
+
+    void runThroughputTest(const std::string& name, unsigned key_len)
+    {
+        unsigned best_rate = 0;
+        unsigned best_window = 0;
+        for (unsigned window = 1; window <= MaxWindow; window *= 2)
+        {
+            resetCounters();
+            const uavcan::MonotonicTime deadline = node_->getMonotonicTime() + ThroughputTestDuration;
+            while (node_->getMonotonicTime() < deadline)
+            {
+                while ((num_pending_ < window) && sendPing(key_len))
+                {
+                    ;
+                }
+                (void)node_->spinOnce();
+                expirePendingPings(false);
+            }
+            const unsigned completed = num_completed_;
+            spinUntil(node_->getMonotonicTime() + ReplyTimeout);        // Late replies are not lost
+            expirePendingPings(true);
+
+            const auto rate = unsigned((std::uint64_t(completed) * 1000U) / ThroughputTestDuration.toMSec());
+            std::cout << name << " window=" << window << ": " << rate << " transfers/s, lost=" << num_lost_
+                      << std::endl;
+            if ((num_lost_ == 0) && (rate > best_rate))
+            {
+                best_rate = rate;
+                best_window = window;
+            }
+        }
+        std::cout << name << " max sustainable: " << best_rate << " transfers/s (window " << best_window << ")"
+                  << std::endl;
+    }
+
+public:
+    explicit Benchmark(const uavcan_linux::NodePtr& node)
+        : node_(node)
+        , pub_(node->makePublisher<KeyValue>(ReplyTimeout))
+        , sub_(node->makeSubscriber<KeyValue>(
+              [this](const uavcan::ReceivedDataStructure<KeyValue>& msg) { handleKeyValue(msg); }))
+    {
+        rtt_samples_.reserve(NumLatencySamples);
+    }
+
+    void runInitiator()
+    {
+        spinUntil(node_->getMonotonicTime() + uavcan::MonotonicDuration::fromMSec(3000));
+        while (true)
+        {
+            runLatencyTest("Single-frame", SingleFrameKeyLen);
+            runLatencyTest("Multi-frame", MultiFrameKeyLen);
+            runThroughputTest("Single-frame", SingleFrameKeyLen);
+            runThroughputTest("Multi-frame", MultiFrameKeyLen);
+        }
+    }
+
+    void runResponder()
+    {
+        while (true)
+        {
+            const int res = node_->spin(uavcan::MonotonicDuration::fromMSec(1000));
+            if (res < 0)
+            {
+                std::cerr << "Spin failure: " << res << std::endl;
+            }
+        }
+    }
+};
+
+}
+
+int main(int argc, const char** argv)
+{
+    try
+    {
+        if (argc < 4)
+        {
+            std::cerr << "Usage:\n\t" << argv[0] << " <node-id> <initiator|responder> <can-iface-name-1> "
+                      << "[can-iface-name-N...]" << std::endl;
+            return 1;
+        }
+        const int self_node_id = std::stoi(argv[1]);
+        const std::string role = argv[2];
+        if ((role != "initiator") && (role != "responder"))
+        {
+            std::cerr << "Invalid role " << role << std::endl;
+            return 1;
+        }
+
+        auto node = uavcan_linux::makeNode(std::vector<std::string>(argv + 3, argv + argc),
+                                           "org.uavcan.linux_test_latency_benchmark",
+                                           uavcan::protocol::SoftwareVersion(), uavcan::protocol::HardwareVersion(),
+                                           self_node_id);
+        node->setModeOperational();
+
+        Benchmark benchmark(node);
+        std::cout << "Benchmark node " << self_node_id << " started as " << role << std::endl;
+        if (role == "initiator")
+        {
+            benchmark.runInitiator();
+        }
+        else
+        {
+            benchmark.runResponder();
+        }
+        return 0;
+    }
+    catch (const std::exception& ex)
+    {
+        std::cerr << "Exception: " << ex.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <uavcan_linux/uavcan_linux.hpp>
+#include "debug.hpp"
+
+/*
+ * This application floods the batched log sink with messages written into a rotated file,
+ * and prints the throughput and the counters of the sink.
+ */
+int main(int argc, const char** argv)
+{
+    try
+    {
+        if (argc < 2)
+        {
+            std::cerr << "Usage:\n\t" << argv[0] << " <log-file> [num-messages] [rate-limit-per-sec]" << std::endl;
+            return 1;
+        }
+
+        uavcan_linux::BatchedLogSinkParams params;
+        params.path = argv[1];
+        params.queue_capacity = 1024;
+        params.max_file_size = 1024 * 1024;
+        params.num_rotated_files = 2;
+        params.rate_limit_per_sec = (argc > 3) ? unsigned(std::stoul(argv[3])) : 0U;
+        const unsigned num_messages = (argc > 2) ? unsigned(std::stoul(argv[2])) : 100000U;
+
+        uavcan::protocol::debug::LogMessage msg;
+        msg.level.value = uavcan::protocol::debug::LogLevel::INFO;
+        msg.source = "test_log_sink";
+
+        uavcan_linux::BatchedLogSink sink(params);
+
+        const auto started_at = std::chrono::steady_clock::now();
+        for (unsigned i = 0; i < num_messages; i++)
+        {
+            msg.text.clear();
+            msg.text.appendFormatted("Message %u", i);
+            sink.log(msg);
+        }
+        const auto logged_at = std::chrono::steady_clock::now();
+        sink.flush();
+        const auto flushed_at = std::chrono::steady_clock::now();
+
+        const auto usec = [](std::chrono::steady_clock::duration d)
+        {
+            return std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+        };
+
+        const auto stats = sink.getStats();
+        std::cout << "log() total:       " << usec(logged_at - started_at) << " usec\n"
+                  << "flush():           " << usec(flushed_at - logged_at) << " usec\n"
+                  << "written:           " << stats.num_written << "\n"
+                  << "dropped overflow:  " << stats.num_dropped_overflow << "\n"
+                  << "dropped rate lim.: " << stats.num_dropped_rate_limit << "\n"
+                  << "batches:           " << stats.num_batches << "\n"
+                  << "write errors:      " << stats.num_write_errors << "\n"
+                  << "rotations:         " << stats.num_rotations << std::endl;
+
+        ENFORCE(stats.num_write_errors == 0);
+        ENFORCE(stats.num_written + stats.num_dropped_overflow + stats.num_dropped_rate_limit == num_messages);
+        return 0;
+    }
+    catch (const std::exception& ex)
+    {
+        std::cerr << "Exception: " << ex.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cstdlib>
+#include <uavcan_linux/uavcan_linux.hpp>
+#include <uavcan/equipment/esc/RawCommand.hpp>
+#include <uavcan/protocol/GetNodeInfo.hpp>
+#include "debug.hpp"
+
+/*
+ * Measures the serialization and deserialization speed of a few typical data types.
+ * RawCommand consists of unaligned 14-bit fields, whereas GetNodeInfo is mostly made of byte aligned fields.
+ */
+namespace
+{
+
+template <typename T>
+void runBenchmark(const char* name, const T& obj, unsigned num_iterations)
+{
+    uavcan::StaticTransferBuffer<(T::MaxBitLen + 7) / 8> buf;
+
+    auto started_at = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < num_iterations; i++)
+    {
+        buf.reset();
+        uavcan::BitStream bits(buf);
+        uavcan::ScalarCodec codec(bits);
+        ENFORCE(0 < T::encode(obj, codec));
+    }
+    const auto encode_time = std::chrono::steady_clock::now() - started_at;
+
+    T decoded;
+    started_at = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < num_iterations; i++)
+    {
+        uavcan::BitStream bits(buf);
+        uavcan::ScalarCodec codec(bits);
+        ENFORCE(0 < T::decode(decoded, codec));
+    }
+    const auto decode_time = std::chrono::steady_clock::now() - started_at;
+
+    ENFORCE(decoded == obj);
+
+    const auto to_ns_per_op = [num_iterations](std::chrono::steady_clock::duration d)
+    {
+        return double(std::chrono::duration_cast<std::chrono::nanoseconds>(d).count()) / num_iterations;
+    };
+
+    std::cout << std::setw(12) << name
+              << "  bytes: "     << std::setw(4) << buf.getMaxWritePos()
+              << "  encode ns: " << std::setw(8) << std::fixed << std::setprecision(1) << to_ns_per_op(encode_time)
+              << "  decode ns: " << std::setw(8) << to_ns_per_op(decode_time)
+              << std::endl;
+}
+
+}
+
+int main(int argc, const char** argv)
+{
+    try
+    {
+        const unsigned num_iterations = (argc > 1) ? unsigned(std::strtoul(argv[1], nullptr, 10)) : 1000000U;
+
+        uavcan::equipment::esc::RawCommand raw_command;
+        for (int i = 0; i < 8; i++)
+        {
+            raw_command.cmd.push_back(i * 1000 - 4000);
+        }
+        runBenchmark("RawCommand", raw_command, num_iterations);
+
+        uavcan::protocol::GetNodeInfo::Response node_info;
+        node_info.status.uptime_sec = 123456;
+        node_info.status.health = node_info.status.HEALTH_OK;
+        node_info.status.mode = node_info.status.MODE_OPERATIONAL;
+        node_info.software_version.major = 1;
+        node_info.software_version.minor = 2;
+        node_info.software_version.vcs_commit = 0xDEADBEEF;
+        node_info.software_version.image_crc = 0x0123456789ABCDEFULL;
+        node_info.hardware_version.major = 3;
+        for (unsigned i = 0; i < node_info.hardware_version.unique_id.size(); i++)
+        {
+            node_info.hardware_version.unique_id[i] = std::uint8_t(i);
+        }
+        node_info.name = "org.uavcan.test_marshal_performance";
+        runBenchmark("GetNodeInfo", node_info, num_iterations);
+
+        return 0;
+    }
+    catch (const std::exception& ex)
+    {
+        std::cerr << "Exception: " << ex.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <uavcan_linux/uavcan_linux.hpp>
+#include "debug.hpp"
+
+/*
+ * This application runs a node on top of the parallel RX driver, where every iface is served by its own I/O thread,
+ * and prints the per-iface statistics once a second.
+ */
+int main(int argc, const char** argv)
+{
+    try
+    {
+        if (argc < 3)
+        {
+            std::cerr << "Usage:\n\t" << argv[0] << " <node-id> <can-iface-name-1> [can-iface-name-N...]" << std::endl;
+            return 1;
+        }
+        const int self_node_id = std::stoi(argv[1]);
+
+        static const uavcan_linux::SystemClock clock;
+        std::shared_ptr<uavcan_linux::ParallelRxCanDriver> driver(new uavcan_linux::ParallelRxCanDriver(clock));
+        for (int i = 2; i < argc; i++)
+        {
+            ENFORCE(driver->addIface(argv[i]) >= 0);
+        }
+        driver->setLocalNodeID(self_node_id);
+
+        auto node = uavcan_linux::makeNode(driver, "org.uavcan.linux_test_parallel_rx",
+                                           uavcan::protocol::SoftwareVersion(), uavcan::protocol::HardwareVersion(),
+                                           self_node_id);
+        node->setModeOperational();
+
+        while (true)
+        {
+            const int res = node->spin(uavcan::MonotonicDuration::fromMSec(1000));
+            if (res < 0)
+            {
+                node->logError("spin", "Error %*", res);
+            }
+            for (std::uint8_t i = 0; i < driver->getNumIfaces(); i++)
+            {
+                const auto iface = driver->getIface(i);
+                std::cout << "iface " << int(i) << ": rx=" << iface->getNumRxFrames()
+                          << " malformed=" << iface->getNumMalformedFrames()
+                          << " filtered=" << iface->getNumFilteredFrames()
+                          << " overflows=" << iface->getNumRxQueueOverflows()
+                          << " tx_errors=" << iface->getNumTxErrors()
+                          << (driver->isIfaceDown(i) ? " DOWN" : "") << "\n";
+            }
+            std::cout << std::endl;
+        }
+    }
+    catch (const std::exception& ex)
+    {
+        std::cerr << "Exception: " << ex.what() << std::endl;
+        return 1;
+    }
+}
@@ -40,6 +40,44 @@ int main(int argc, const char** argv)
             ENFORCE(0 == std::system(("cat " + event_log_file).c_str()));
         }
 
+        /*
+         * Buffered event tracer test
+         */
+        {
+            using namespace uavcan::dynamic_node_id_server;
+
+            const std::string event_log_file("/tmp/uavcan_posix/dynamic_node_id_server/event_buffered.log");
+            const std::string count_lines("test $(wc -l < " + event_log_file + ") -eq ");
+
+            {
+                uavcan_posix::dynamic_node_id_server::BufferedFileEventTracer<16> tracer;
+                ENFORCE(0 <= tracer.init(event_log_file.c_str(), 10000));   // Long interval - explicit flushes only
+
+                // The events are not written until flushed
+                static_cast<IEventTracer&>(tracer).onEvent(TraceError, 123456);
+                static_cast<IEventTracer&>(tracer).onEvent(TraceError, 789123);
+                ENFORCE(0 == std::system((count_lines + "0").c_str()));
+                ENFORCE(2 == tracer.getNumPendingEvents());
+
+                tracer.flush();
+                ENFORCE(0 == tracer.getNumPendingEvents());
+                ENFORCE(0 == std::system((count_lines + "2").c_str()));
+
+                // Many events - some of them may be dropped, all others must be written
+                for (int i = 0; i < 100; i++)
+                {
+                    static_cast<IEventTracer&>(tracer).onEvent(TraceError, i);
+                }
+                tracer.flush();
+                ENFORCE(tracer.getNumDroppedEvents() <= 100 - 16);
+                ENFORCE(0 == std::system((count_lines + std::to_string(102 - tracer.getNumDroppedEvents())).c_str()));
+
+                // The remaining events are written upon destruction
+                static_cast<IEventTracer&>(tracer).onEvent(TraceError, 42);
+            }
+            ENFORCE(0 == std::system(("tail -n 3 " + event_log_file).c_str()));
+        }
+
         /*
          * Storage backend test
          */
@@ -61,6 +99,18 @@ int main(int argc, const char** argv)
             print_key("foobar");
             print_key("the_answer");
             print_key("nonexistent");
+
+            // The values are cached - an external modification is not visible until the cache is invalidated
+            ENFORCE(0 == std::system("echo 43 > /tmp/uavcan_posix/dynamic_node_id_server/storage/the_answer"));
+            ENFORCE(static_cast<IStorageBackend&>(backend).get("the_answer") == "42");
+            backend.invalidateCache();
+            ENFORCE(static_cast<IStorageBackend&>(backend).get("the_answer") == "43");
+
+            // Missing keys are cached too, and then overwritten by set()
+            ENFORCE(static_cast<IStorageBackend&>(backend).get("nonexistent").empty());
+            static_cast<IStorageBackend&>(backend).set("nonexistent", "123");
+            ENFORCE(static_cast<IStorageBackend&>(backend).get("nonexistent") == "123");
+            ENFORCE(0 == std::system("rm -f /tmp/uavcan_posix/dynamic_node_id_server/storage/nonexistent"));
         }
 
         return 0;
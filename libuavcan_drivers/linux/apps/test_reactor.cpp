@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <uavcan_linux/uavcan_linux.hpp>
+#include "debug.hpp"
+
+/*
+ * This application runs one node per CAN iface on a shared worker pool, like a test stand with many buses would,
+ * and prints the per-node and per-worker statistics.
+ */
+static uavcan_linux::NodePtr initNode(const std::string& iface, uavcan::NodeID nid, const std::string& name)
+{
+    auto node = uavcan_linux::makeNode(std::vector<std::string>{ iface }, name.c_str(),
+                                       uavcan::protocol::SoftwareVersion(), uavcan::protocol::HardwareVersion(), nid);
+    node->setModeOperational();
+    return node;
+}
+
+int main(int argc, const char** argv)
+{
+    try
+    {
+        if (argc < 4)
+        {
+            std::cerr << "Usage:\n\t" << argv[0]
+                      << " <first-node-id> <num-workers> <can-iface-name-1> [can-iface-name-N...]\n"
+                      << "Node IDs are assigned sequentially, one node per iface." << std::endl;
+            return 1;
+        }
+        const int first_node_id = std::stoi(argv[1]);
+
+        uavcan_linux::MultiNodeReactorConfig config;
+        config.num_workers = unsigned(std::stoi(argv[2]));
+        uavcan_linux::MultiNodeReactor reactor(config);
+
+        std::vector<uavcan_linux::NodePtr> nodes;
+        for (int i = 3; i < argc; i++)
+        {
+            const int nid = first_node_id + int(nodes.size());
+            nodes.push_back(initNode(argv[i], nid, "org.uavcan.linux_test_reactor." + std::string(argv[i])));
+            ENFORCE(reactor.addNode(*nodes.back()) == (nodes.size() - 1U));
+        }
+        reactor.start();
+
+        unsigned count = 0;
+        while (true)
+        {
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+            count++;
+            for (unsigned i = 0; i < reactor.getNumNodes(); i++)
+            {
+                const auto stats = reactor.getNodeStats(i);
+                std::cout << "node " << i << ": runs=" << stats.num_runs << " errors=" << stats.num_errors
+                          << " cpu=" << stats.total_run_usec << "us\n";
+                auto& node = nodes[i];
+                reactor.post(i, [&node, count]() { node->logInfo("reactor", "Alive %*", count); });
+            }
+            for (unsigned i = 0; i < config.num_workers; i++)
+            {
+                const auto stats = reactor.getWorkerStats(i);
+                std::cout << "worker " << i << ": runs=" << stats.num_runs << " steals=" << stats.num_steals
+                          << " wakeups=" << stats.num_wakeups << "\n";
+            }
+            std::cout << std::endl;
+        }
+    }
+    catch (const std::exception& ex)
+    {
+        std::cerr << "Exception: " << ex.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <uavcan_linux/uavcan_linux.hpp>
+#include "debug.hpp"
+
+/*
+ * This application runs the node on a real-time thread and prints the scheduling latency statistics.
+ * It has to be started with the required privileges, e.g. as root, unless the priority is zero.
+ */
+static uavcan_linux::NodePtr initNode(const std::vector<std::string>& ifaces, uavcan::NodeID nid,
+                                      const std::string& name)
+{
+    auto node = uavcan_linux::makeNode(ifaces, name.c_str(),
+                                       uavcan::protocol::SoftwareVersion(), uavcan::protocol::HardwareVersion(), nid);
+    node->setModeOperational();
+    return node;
+}
+
+static void printStats(const uavcan_linux::SchedulingLatencyStats& stats)
+{
+    std::cout << "samples=" << stats.num_samples
+              << " min=" << stats.min_usec << "us"
+              << " mean=" << stats.getMeanUSec() << "us"
+              << " max=" << stats.max_usec << "us\n  histogram:";
+    for (unsigned i = 0; i < uavcan_linux::SchedulingLatencyStats::NumHistogramBins; i++)
+    {
+        std::cout << " " << stats.histogram[i];
+    }
+    std::cout << std::endl;
+}
+
+int main(int argc, const char** argv)
+{
+    try
+    {
+        if (argc < 5)
+        {
+            std::cerr << "Usage:\n\t" << argv[0]
+                      << " <node-id> <sched-priority> <cpu> <can-iface-name-1> [can-iface-name-N...]\n"
+                      << "Negative CPU number keeps the default affinity." << std::endl;
+            return 1;
+        }
+        const int self_node_id = std::stoi(argv[1]);
+        std::vector<std::string> iface_names(argv + 4, argv + argc);
+        auto node = initNode(iface_names, self_node_id, "org.uavcan.linux_test_realtime_spin");
+
+        uavcan_linux::RealTimeSpinConfig config;
+        config.sched_priority = std::stoi(argv[2]);
+        const int cpu = std::stoi(argv[3]);
+        if (cpu >= 0)
+        {
+            config.cpu_affinity.push_back(unsigned(cpu));
+        }
+        config.lock_memory = config.sched_priority > 0;
+
+        uavcan_linux::RealTimeSpinThread spinner(*node, config);
+        spinner.start();
+
+        unsigned count = 0;
+        while (true)
+        {
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+            printStats(spinner.getLatencyStats());
+            spinner.post([&node, &count]() { node->logInfo("rtspin", "Alive %*", ++count); });
+        }
+    }
+    catch (const std::exception& ex)
+    {
+        std::cerr << "Exception: " << ex.what() << std::endl;
+        return 1;
+    }
+}
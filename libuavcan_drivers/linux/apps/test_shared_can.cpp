@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <iostream>
+#include <string>
+#include <uavcan_linux/uavcan_linux.hpp>
+#include "debug.hpp"
+
+namespace
+{
+
+const std::string SegmentName = "/uavcan_test_shared_can";
+
+uavcan::CanFrame makeFrame(std::uint32_t id, const std::string& data)
+{
+    return uavcan::CanFrame(id, reinterpret_cast<const std::uint8_t*>(data.c_str()), std::uint8_t(data.length()));
+}
+
+uavcan::MonotonicTime tsMonoOffsetMs(std::int64_t ms)
+{
+    return uavcan_linux::SystemClock().getMonotonic() + uavcan::MonotonicDuration::fromMSec(ms);
+}
+
+bool receiveWithin(uavcan_linux::SharedCanDriver& driver, uavcan::CanFrame& frame, uavcan::CanIOFlags& flags,
+                   std::int64_t timeout_ms)
+{
+    const uavcan::CanFrame* pending_tx[uavcan::MaxCanIfaces] = {};
+    uavcan::CanSelectMasks masks;
+    masks.read = 1;
+    ENFORCE(0 <= driver.select(masks, pending_tx, tsMonoOffsetMs(timeout_ms)));
+    uavcan::MonotonicTime ts_mono;
+    uavcan::UtcTime ts_utc;
+    return 1 == driver.getIface(0)->receive(frame, ts_mono, ts_utc, flags);
+}
+
+void testBroker(const std::string& iface_name)
+{
+    const uavcan_linux::SystemClock clock;
+
+    uavcan_linux::SharedCanBroker broker({ iface_name }, SegmentName);
+    broker.start();
+
+    uavcan_linux::SharedCanDriver client_a(clock, SegmentName);
+    uavcan_linux::SharedCanDriver client_b(clock, SegmentName);
+    ENFORCE(client_a.getNumIfaces() == 1);
+    ENFORCE(client_a.getClientID() != client_b.getClientID());
+
+    // This socket sees the bus the way the other nodes do
+    const int observer_fd = uavcan_linux::SocketCanIface::openSocket(iface_name);
+    ENFORCE(observer_fd >= 0);
+    uavcan_linux::SocketCanIface observer(clock, observer_fd);
+
+    ENFORCE(1 == client_a.getIface(0)->send(makeFrame(123, "a"), tsMonoOffsetMs(100), 0));
+    ENFORCE(1 == client_a.getIface(0)->send(makeFrame(456, "b"), tsMonoOffsetMs(100), uavcan::CanIOFlagLoopback));
+
+    uavcan::CanFrame frame;
+    uavcan::CanIOFlags flags = 0;
+
+    // The other client receives both frames
+    ENFORCE(receiveWithin(client_b, frame, flags, 1000));
+    ENFORCE(frame == makeFrame(123, "a"));
+    ENFORCE(flags == 0);
+    ENFORCE(receiveWithin(client_b, frame, flags, 1000));
+    ENFORCE(frame == makeFrame(456, "b"));
+    ENFORCE(flags == 0);
+
+    // The sender receives only the loopback
+    ENFORCE(receiveWithin(client_a, frame, flags, 1000));
+    ENFORCE(frame == makeFrame(456, "b"));
+    ENFORCE(flags == uavcan::CanIOFlagLoopback);
+    ENFORCE(!receiveWithin(client_a, frame, flags, 10));
+
+    // Frames from the bus reach every client
+    observer.poll(true, false);
+    ENFORCE(1 == observer.send(makeFrame(789, "c"), tsMonoOffsetMs(100), 0));
+    ENFORCE(receiveWithin(client_a, frame, flags, 1000));
+    ENFORCE(frame == makeFrame(789, "c"));
+    ENFORCE(receiveWithin(client_b, frame, flags, 1000));
+    ENFORCE(frame == makeFrame(789, "c"));
+
+    observer.poll(true, false);
+    unsigned num_observed = 0;
+    while (observer.hasReadyRx())
+    {
+        uavcan::MonotonicTime ts_mono;
+        uavcan::UtcTime ts_utc;
+        ENFORCE(1 == observer.receive(frame, ts_mono, ts_utc, flags));
+        num_observed++;
+    }
+    ENFORCE(num_observed == 2);
+
+    ENFORCE(0 == client_a.getIface(0)->getErrorCount());
+    ENFORCE(0 == client_b.getIface(0)->getErrorCount());
+    ENFORCE(broker.getNumTxFrames() == 2);
+    ENFORCE(broker.getNumTxTimeouts() == 0);
+    ENFORCE(broker.getNumTxErrors() == 0);
+
+    broker.stop();
+}
+
+}
+
+int main(int argc, const char** argv)
+{
+    try
+    {
+        if (argc < 2)
+        {
+            std::cerr << "Usage:\n\t" << argv[0] << " <can-iface-name>" << std::endl;
+            return 1;
+        }
+        testBroker(argv[1]);
+        std::cout << "OK" << std::endl;
+        return 0;
+    }
+    catch (const std::exception& ex)
+    {
+        std::cerr << "Exception: " << ex.what() << std::endl;
+        return 1;
+    }
+}
@@ -4,8 +4,12 @@
 
 #include <iostream>
 #include <vector>
+#include <memory>
 #include <cerrno>
 #include <uavcan_linux/uavcan_linux.hpp>
+#if UAVCAN_LINUX_HAVE_IO_URING
+# include <uavcan_linux/socketcan_uring.hpp>
+#endif
 #include "debug.hpp"
 
 static uavcan::CanFrame makeFrame(std::uint32_t id, const std::string& data)
@@ -211,6 +215,7 @@ static void testSocketFilters(const std::string& iface_name)
     ENFORCE(!if2.hasReadyRx());
 }
 
+template <typename Driver>
 static void testDriver(const std::vector<std::string>& iface_names)
 {
     /*
@@ -221,7 +226,7 @@ static void testDriver(const std::vector<std::string>& iface_names)
     clock_impl.adjustUtc(uavcan::UtcDuration::fromMSec(9000000));
     const uavcan_linux::SystemClock& clock = clock_impl;
 
-    uavcan_linux::SocketCanDriver driver(clock);
+    Driver driver(clock);
     for (auto ifn : iface_names)
     {
         std::cout << "Adding iface " << ifn << std::endl;
@@ -313,6 +318,8 @@ static void testDriver(const std::vector<std::string>& iface_names)
             {
             case uavcan_linux::SocketCanError::SocketReadFailure:
             case uavcan_linux::SocketCanError::SocketWriteFailure:
+            case uavcan_linux::SocketCanError::RxQueueOverflow:
+            case uavcan_linux::SocketCanError::SocketRxOverflow:
             {
                 ENFORCE(kv.second == 0);
                 break;
@@ -332,6 +339,78 @@ static void testDriver(const std::vector<std::string>& iface_names)
     }
 }
 
+template <typename Driver>
+static std::unique_ptr<Driver> makeSelectiveLoopbackDriver(const uavcan_linux::SystemClock& clock)
+{
+    return std::unique_ptr<Driver>(new Driver(clock, uavcan_linux::SocketCanIoMode::PerFrame,
+                                              uavcan_linux::SocketCanTimestampMode::Software,
+                                              uavcan_linux::SocketCanLoopbackMode::Selective));
+}
+
+#if UAVCAN_LINUX_HAVE_IO_URING
+template <>
+std::unique_ptr<uavcan_linux::SocketCanUringDriver>
+makeSelectiveLoopbackDriver<uavcan_linux::SocketCanUringDriver>(const uavcan_linux::SystemClock& clock)
+{
+    // No IO mode here, the io_uring driver always works in the External mode
+    return std::unique_ptr<uavcan_linux::SocketCanUringDriver>(
+        new uavcan_linux::SocketCanUringDriver(clock, uavcan_linux::SocketCanTimestampMode::Software,
+                                               uavcan_linux::SocketCanLoopbackMode::Selective));
+}
+#endif
+
+template <typename Driver>
+static void testSelectiveLoopback(const std::string& iface_name)
+{
+    const uavcan_linux::SystemClock clock;
+    const std::unique_ptr<Driver> driver_ptr = makeSelectiveLoopbackDriver<Driver>(clock);
+    Driver& driver = *driver_ptr;
+    ENFORCE(0 == driver.addIface(iface_name));
+
+    uavcan_linux::SocketCanIface& iface = *driver.getIface(0);
+    ENFORCE(iface.getLoopbackMode() == uavcan_linux::SocketCanLoopbackMode::Selective);
+    ENFORCE(iface.getLoopbackFileDescriptor() >= 0);
+
+    // The observer must see all frames on the bus, whereas the driver loops back only one of them
+    const int observer_fd = uavcan_linux::SocketCanIface::openSocket(iface_name);
+    ENFORCE(observer_fd >= 0);
+    uavcan_linux::SocketCanIface observer(clock, observer_fd);
+
+    ENFORCE(1 == iface.send(makeFrame(111, "a"), tsMonoOffsetMs(100), 0));
+    ENFORCE(1 == iface.send(makeFrame(222, "b"), tsMonoOffsetMs(100), uavcan::CanIOFlagLoopback));
+    ENFORCE(1 == iface.send(makeFrame(333, "c"), tsMonoOffsetMs(100), 0));
+
+    const uavcan::CanFrame* pending_tx[uavcan::MaxCanIfaces] = {};
+    for (int i = 0; i < 10; i++)
+    {
+        uavcan::CanSelectMasks masks;
+        masks.read = 1;
+        masks.write = 1;
+        ENFORCE(driver.getNumIfaces() == driver.select(masks, pending_tx, tsMonoOffsetMs(10)));
+        observer.poll(true, false);
+    }
+
+    uavcan::CanFrame frame;
+    uavcan::MonotonicTime ts_mono;
+    uavcan::UtcTime ts_utc;
+    uavcan::CanIOFlags flags = 0;
+    ENFORCE(1 == iface.receive(frame, ts_mono, ts_utc, flags));
+    ENFORCE(frame == makeFrame(222, "b"));
+    ENFORCE(flags == uavcan::CanIOFlagLoopback);
+    ENFORCE((clock.getUtc() - ts_utc).getAbs().toMSec() < 100);
+    ENFORCE(!iface.hasReadyRx());           // No echoes of the other frames, and no duplicates
+    ENFORCE(!iface.hasReadyTx());
+    ENFORCE(0 == iface.getErrorCount());
+
+    unsigned num_observed = 0;
+    while (observer.hasReadyRx())
+    {
+        ENFORCE(1 == observer.receive(frame, ts_mono, ts_utc, flags));
+        num_observed++;
+    }
+    ENFORCE(num_observed == 3);
+}
+
 int main(int argc, const char** argv)
 {
     try
@@ -352,7 +431,17 @@ int main(int argc, const char** argv)
         testSocketRxTx(iface_names[0]);
         testSocketFilters(iface_names[0]);
 
-        testDriver(iface_names);
+        testDriver<uavcan_linux::SocketCanDriver>(iface_names);
+        testDriver<uavcan_linux::SocketCanEpollDriver>(iface_names);
+#if UAVCAN_LINUX_HAVE_IO_URING
+        testDriver<uavcan_linux::SocketCanUringDriver>(iface_names);
+#endif
+
+        testSelectiveLoopback<uavcan_linux::SocketCanDriver>(iface_names[0]);
+        testSelectiveLoopback<uavcan_linux::SocketCanEpollDriver>(iface_names[0]);
+#if UAVCAN_LINUX_HAVE_IO_URING
+        testSelectiveLoopback<uavcan_linux::SocketCanUringDriver>(iface_names[0]);
+#endif
 
         return 0;
     }
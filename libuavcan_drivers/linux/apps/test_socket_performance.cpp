@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <cstdlib>
+#include <ctime>
+#include <poll.h>
+#include <uavcan_linux/uavcan_linux.hpp>
+#include "debug.hpp"
+
+/*
+ * Measures the SocketCAN driver throughput and CPU usage in each IO mode.
+ * Frames are sent from one socket and received by another socket on the same iface (vcan is recommended).
+ */
+namespace
+{
+
+const unsigned MaxFramesInFlight = 32;          ///< Keeps the receiving socket buffer from overflowing
+
+double getProcessCpuTimeSec()
+{
+    auto ts = ::timespec();
+    ENFORCE(0 == ::clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts));
+    return double(ts.tv_sec) + double(ts.tv_nsec) * 1e-9;
+}
+
+const char* ioModeToString(uavcan_linux::SocketCanIoMode mode)
+{
+    switch (mode)
+    {
+    case uavcan_linux::SocketCanIoMode::PerFrame: return "PerFrame";
+    case uavcan_linux::SocketCanIoMode::Batched:  return "Batched";
+    default:                                      return "???";
+    }
+}
+
+void runBenchmark(const std::string& iface_name, uavcan_linux::SocketCanIoMode mode, unsigned num_frames)
+{
+    const int tx_sock = uavcan_linux::SocketCanIface::openSocket(iface_name);
+    const int rx_sock = uavcan_linux::SocketCanIface::openSocket(iface_name);
+    ENFORCE(tx_sock >= 0 && rx_sock >= 0);
+
+    const uavcan_linux::SystemClock clock;
+    uavcan_linux::SocketCanIface tx_iface(clock, tx_sock, MaxFramesInFlight, mode);
+    uavcan_linux::SocketCanIface rx_iface(clock, rx_sock, MaxFramesInFlight, mode);
+
+    uavcan::CanRxFrame rx_frames[MaxFramesInFlight];
+    uavcan::CanIOFlags rx_flags[MaxFramesInFlight];
+
+    unsigned num_sent = 0;
+    unsigned num_received = 0;
+
+    const auto started_at = clock.getMonotonic();
+    const auto deadline = started_at + uavcan::MonotonicDuration::fromMSec(num_frames / 10 + 1000);
+    const double cpu_started_at = getProcessCpuTimeSec();
+
+    while ((num_received < num_frames) && (clock.getMonotonic() < deadline))
+    {
+        while ((num_sent < num_frames) && ((num_sent - num_received) < MaxFramesInFlight))
+        {
+            const std::uint8_t payload[8] = { std::uint8_t(num_sent), std::uint8_t(num_sent >> 8),
+                                              std::uint8_t(num_sent >> 16), std::uint8_t(num_sent >> 24) };
+            const uavcan::CanFrame frame(123 | uavcan::CanFrame::FlagEFF, payload, sizeof(payload));
+            ENFORCE(1 == tx_iface.send(frame, deadline, 0));
+            num_sent++;
+        }
+
+        ::pollfd pollfds[2] = {};
+        pollfds[0].fd = tx_iface.getFileDescriptor();
+        pollfds[0].events = POLLIN | (tx_iface.hasReadyTx() ? POLLOUT : 0);
+        pollfds[1].fd = rx_iface.getFileDescriptor();
+        pollfds[1].events = POLLIN;
+        ENFORCE(::poll(pollfds, 2, 10) >= 0);
+
+        tx_iface.poll(pollfds[0].revents & POLLIN, pollfds[0].revents & POLLOUT);
+        rx_iface.poll(pollfds[1].revents & POLLIN, false);
+
+        while (true)
+        {
+            const int res = rx_iface.receiveBatch(rx_frames, rx_flags, MaxFramesInFlight);
+            ENFORCE(res >= 0);
+            if (res == 0)
+            {
+                break;
+            }
+            num_received += unsigned(res);
+        }
+    }
+
+    const double cpu_time = getProcessCpuTimeSec() - cpu_started_at;
+    const double wall_time = double((clock.getMonotonic() - started_at).toUSec()) * 1e-6;
+
+    std::cout << std::setw(10) << ioModeToString(mode)
+              << "  frames: "    << std::setw(8) << num_received << "/" << num_frames
+              << "  frames/s: "  << std::setw(10) << std::fixed << std::setprecision(0) << (num_received / wall_time)
+              << "  CPU: "       << std::setw(5) << std::setprecision(1) << (cpu_time / wall_time * 100.0) << "%"
+              << "  errors: "    << (tx_iface.getErrorCount() + rx_iface.getErrorCount())
+              << std::endl;
+}
+
+}
+
+int main(int argc, const char** argv)
+{
+    try
+    {
+        if (argc < 2)
+        {
+            std::cerr << "Usage:\n\t" << argv[0] << " <can-iface-name> [num-frames]" << std::endl;
+            return 1;
+        }
+
+        const std::string iface_name = argv[1];
+        const unsigned num_frames = (argc > 2) ? unsigned(std::strtoul(argv[2], nullptr, 10)) : 100000U;
+
+        runBenchmark(iface_name, uavcan_linux::SocketCanIoMode::PerFrame, num_frames);
+        runBenchmark(iface_name, uavcan_linux::SocketCanIoMode::Batched, num_frames);
+
+        return 0;
+    }
+    catch (const std::exception& ex)
+    {
+        std::cerr << "Exception: " << ex.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <iostream>
+#include <string>
+#include <uavcan_linux/uavcan_linux.hpp>
+#include "debug.hpp"
+
+namespace
+{
+
+uavcan::CanFrame makeFrame(std::uint32_t id, const std::string& data)
+{
+    return uavcan::CanFrame(id, reinterpret_cast<const std::uint8_t*>(data.c_str()), std::uint8_t(data.length()));
+}
+
+uavcan::MonotonicTime tsMonoOffsetMs(std::int64_t ms)
+{
+    return uavcan_linux::SystemClock().getMonotonic() + uavcan::MonotonicDuration::fromMSec(ms);
+}
+
+bool receiveWithin(uavcan_linux::UdpCanDriver& driver, std::uint8_t iface_index, uavcan::CanFrame& frame,
+                   uavcan::CanIOFlags& flags, uavcan::MonotonicTime& ts_mono, std::int64_t timeout_ms)
+{
+    const uavcan::MonotonicTime deadline = tsMonoOffsetMs(timeout_ms);
+    while (true)
+    {
+        const uavcan::CanFrame* pending_tx[uavcan::MaxCanIfaces] = {};
+        uavcan::CanSelectMasks masks;
+        masks.read = std::uint8_t(1U << iface_index);
+        ENFORCE(0 <= driver.select(masks, pending_tx, deadline));
+        uavcan::UtcTime ts_utc;
+        if (1 == driver.getIface(iface_index)->receive(frame, ts_mono, ts_utc, flags))
+        {
+            return true;
+        }
+        if (uavcan_linux::SystemClock().getMonotonic() >= deadline)
+        {
+            return false;
+        }
+    }
+}
+
+void testTunnel()
+{
+    const uavcan_linux::SystemClock clock;
+
+    uavcan_linux::UdpCanParams server_params;
+    server_params.local_address = "127.0.0.1";
+    server_params.num_ifaces = 2;
+    server_params.flush_latency = uavcan::MonotonicDuration::fromMSec(10);
+    uavcan_linux::UdpCanDriver server(clock, server_params);      // Learns the peer address
+
+    uavcan_linux::UdpCanParams client_params = server_params;
+    client_params.remote_address = "127.0.0.1";
+    client_params.remote_port = server.getLocalPort();
+    uavcan_linux::UdpCanDriver client(clock, client_params);
+
+    // Nowhere to send yet
+    ENFORCE(1 == server.getIface(0)->send(makeFrame(1, "lost"), tsMonoOffsetMs(100), 0));
+    server.flushNow();
+    ENFORCE(server.getNumTxErrors() == 1);
+
+    // Many frames are batched into few datagrams, the iface index is preserved
+    const unsigned NumFrames = 300;
+    for (unsigned i = 0; i < NumFrames; i++)
+    {
+        const uavcan::CanIOFlags flags = (i == 0) ? uavcan::CanIOFlagLoopback : 0;
+        ENFORCE(1 == client.getIface(std::uint8_t(i % 2))->send(makeFrame(i, std::to_string(i)),
+                                                                tsMonoOffsetMs(1000), flags));
+    }
+    ENFORCE(client.getFlushDeadline().isZero() == false);
+
+    // The loopback frame is returned once its datagram is sent; the remainder is sent on flush latency expiration
+    uavcan::CanFrame frame;
+    uavcan::CanIOFlags flags = 0;
+    uavcan::MonotonicTime ts_mono;
+    ENFORCE(receiveWithin(client, 0, frame, flags, ts_mono, 1000));
+    ENFORCE(frame == makeFrame(0, "0"));
+    ENFORCE(flags == uavcan::CanIOFlagLoopback);
+    ENFORCE(!receiveWithin(client, 0, frame, flags, ts_mono, 50));
+    ENFORCE(client.getFlushDeadline().isZero());
+
+    for (unsigned i = 0; i < NumFrames; i++)
+    {
+        const std::uint8_t iface_index = std::uint8_t(i % 2);
+        ENFORCE(receiveWithin(server, iface_index, frame, flags, ts_mono, 1000));
+        ENFORCE(frame == makeFrame(i, std::to_string(i)));
+        ENFORCE(flags == 0);
+        ENFORCE(ts_mono <= clock.getMonotonic());
+    }
+    ENFORCE(client.getNumTxDatagrams() < (NumFrames / 10));
+    ENFORCE(client.getNumTxDatagrams() == server.getNumRxDatagrams());
+
+    // Filters are applied by the receiving side
+    uavcan::CanFilterConfig filter;
+    filter.id = 123;
+    filter.mask = uavcan::CanFrame::MaskStdID;
+    ENFORCE(0 == client.getIface(1)->configureFilters(&filter, 1));
+
+    // The server replies to the learned address; an expired frame is not sent
+    ENFORCE(1 == server.getIface(1)->send(makeFrame(456, "drop"), tsMonoOffsetMs(100), 0));
+    ENFORCE(1 == server.getIface(1)->send(makeFrame(123, "reply"), tsMonoOffsetMs(100), 0));
+    ENFORCE(1 == server.getIface(1)->send(makeFrame(124, "late"), tsMonoOffsetMs(-1), 0));
+    server.flushNow();
+    ENFORCE(receiveWithin(client, 1, frame, flags, ts_mono, 1000));
+    ENFORCE(frame == makeFrame(123, "reply"));
+    ENFORCE(!receiveWithin(client, 1, frame, flags, ts_mono, 50));
+    ENFORCE(server.getNumTxTimeouts() == 1);
+
+    ENFORCE(client.getNumLostDatagrams() == 0);
+    ENFORCE(server.getNumLostDatagrams() == 0);
+    ENFORCE(client.getErrorCount() == 0);
+    ENFORCE(server.getErrorCount() == 2);
+}
+
+}
+
+int main()
+{
+    try
+    {
+        testTunnel();
+        std::cout << "OK" << std::endl;
+        return 0;
+    }
+    catch (const std::exception& ex)
+    {
+        std::cerr << "Exception: " << ex.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <uavcan_linux/uavcan_linux.hpp>
+#include <uavcan/protocol/node_status_monitor.hpp>
+#include "debug.hpp"
+
+namespace
+{
+
+constexpr unsigned NodeMemoryPoolSize = 16384;
+
+typedef uavcan::Node<NodeMemoryPoolSize> Node;
+
+/**
+ * One simulated node with its own clock and driver.
+ */
+struct SimulatedNode
+{
+    uavcan_linux::VirtualSystemClock clock;
+    uavcan_linux::VirtualCanDriver driver;
+    Node node;
+    uavcan::NodeStatusMonitor monitor;
+
+    SimulatedNode(uavcan_linux::VirtualCanBus& bus, uavcan::NodeID nid)
+        : clock(bus)
+        , driver(bus, clock)
+        , node(driver, clock)
+        , monitor(node)
+    {
+        node.setNodeID(nid);
+        node.setName(("org.uavcan.linux_test_virtual_can_" + std::to_string(nid.get())).c_str());
+    }
+
+    void start()
+    {
+        ENFORCE(0 <= node.start());
+        ENFORCE(0 <= monitor.start());
+        node.setModeOperational();
+    }
+};
+
+void runSimulation(unsigned num_nodes, unsigned duration_sec)
+{
+    uavcan_linux::VirtualCanBusParams params;
+    params.latency = uavcan::MonotonicDuration::fromUSec(5);
+    params.frame_loss_probability = 0.001;
+    uavcan_linux::VirtualCanBus bus(params);
+
+    std::vector<std::unique_ptr<SimulatedNode>> nodes;
+    for (unsigned i = 0; i < num_nodes; i++)
+    {
+        nodes.emplace_back(new SimulatedNode(bus, uavcan::NodeID(std::uint8_t(i + 1))));
+    }
+
+    // The nodes can't be started at the instant of their creation because their uptime would be zero
+    bus.advance(uavcan::MonotonicDuration::fromMSec(1));
+    for (auto& n : nodes)
+    {
+        n->start();
+    }
+
+    std::cout << "Simulating " << num_nodes << " nodes for " << duration_sec << " sec" << std::endl;
+
+    const auto step = uavcan::MonotonicDuration::fromUSec(100);
+    const auto end_time = bus.getTime() + uavcan::MonotonicDuration::fromMSec(duration_sec * 1000);
+    const auto started_at = std::chrono::steady_clock::now();
+
+    while (bus.getTime() < end_time)
+    {
+        for (auto& n : nodes)
+        {
+            const int res = n->node.spinOnce();
+            if (res < 0)
+            {
+                std::cerr << "Spin failure: " << res << std::endl;
+            }
+        }
+        bus.advance(step);
+    }
+
+    const double real_time_sec =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - started_at).count();
+
+    std::cout << "Real time: " << real_time_sec << " sec, "
+              << "speedup: " << (duration_sec / real_time_sec) << "x\n"
+              << "Frames transmitted: " << bus.getNumTransmittedFrames() << "\n"
+              << "Frames lost: " << bus.getNumLostFrames() << "\n"
+              << "Bus load: " << (100.0 * double(bus.getBusyTime().toUSec()) / (duration_sec * 1e6)) << "%"
+              << std::endl;
+
+    for (auto& n : nodes)
+    {
+        for (auto& other : nodes)
+        {
+            if (&n != &other)
+            {
+                ENFORCE(n->monitor.isNodeKnown(other->node.getNodeID()));
+            }
+        }
+        ENFORCE(0 == n->driver.getIface(0)->getErrorCount());
+    }
+    std::cout << "All nodes have discovered each other" << std::endl;
+}
+
+}
+
+int main(int argc, const char** argv)
+{
+    try
+    {
+        const unsigned num_nodes = (argc > 1) ? unsigned(std::atoi(argv[1])) : 50;
+        const unsigned duration_sec = (argc > 2) ? unsigned(std::atoi(argv[2])) : 10;
+        ENFORCE((num_nodes > 0) && (num_nodes <= uavcan::NodeID::MaxRecommendedForRegularNodes));
+        ENFORCE(duration_sec > 0);
+        runSimulation(num_nodes, duration_sec);
+        return 0;
+    }
+    catch (const std::exception& ex)
+    {
+        std::cerr << "Exception: " << ex.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,204 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <uavcan_linux/uavcan_linux.hpp>
+#include <uavcan/protocol/node_status_monitor.hpp>
+#include "debug.hpp"
+
+namespace
+{
+
+std::atomic<bool> g_stop_requested(false);
+
+void handleSignal(int)
+{
+    g_stop_requested = true;
+}
+
+/**
+ * Captures all frames on the interfaces until interrupted by SIGINT or SIGTERM.
+ */
+void record(const std::string& path, const std::vector<std::string>& ifaces)
+{
+    auto node = uavcan_linux::makeNode(ifaces, "org.uavcan.linux_bus_log",
+                                       uavcan::protocol::SoftwareVersion(), uavcan::protocol::HardwareVersion());
+    uavcan_linux::BusLogWriter writer(path);
+    node->getDispatcher().installRxFrameListener(&writer);
+
+    (void)std::signal(SIGINT, handleSignal);
+    (void)std::signal(SIGTERM, handleSignal);
+    std::cerr << "Recording into " << path << ", press Ctrl+C to stop" << std::endl;
+
+    while (!g_stop_requested)
+    {
+        const int res = node->spin(uavcan::MonotonicDuration::fromMSec(100));
+        if (res < 0)
+        {
+            std::cerr << "Spin error: " << res << std::endl;
+        }
+    }
+
+    node->getDispatcher().removeRxFrameListener();
+    writer.close();
+    std::cerr << "Recorded " << writer.getNumRecords() << " frames, " << writer.getSizeInBytes() << " bytes"
+              << std::endl;
+}
+
+/**
+ * Feeds the log into a passive node, i.e. through the complete receive pipeline of the library.
+ */
+void replay(const std::string& path, double speed)
+{
+    constexpr unsigned NodeMemoryPoolSize = 16384;
+
+    uavcan_linux::BusLogReader reader(path);
+    uavcan_linux::BusLogPlayer player(reader, speed);
+    uavcan::Node<NodeMemoryPoolSize> node(player, player);
+    node.setName("org.uavcan.linux_bus_log");
+
+    uavcan::NodeStatusMonitor monitor(node);
+    ENFORCE(0 <= node.start());
+    ENFORCE(0 <= monitor.start());
+
+    std::cerr << "Replaying " << reader.getNumRecords() << " frames from " << reader.getNumIfaces()
+              << " ifaces, log duration " << (reader.getLastTimestamp() - reader.getFirstTimestamp()).toString()
+              << " sec, speed " << (player.isMaxSpeed() ? std::string("max") : std::to_string(speed)) << std::endl;
+
+    const auto started_at = std::chrono::steady_clock::now();
+    while (!player.isFinished())
+    {
+        const int res = node.spin(uavcan::MonotonicDuration::fromMSec(100));
+        if (res < 0)
+        {
+            std::cerr << "Spin error: " << res << std::endl;
+        }
+    }
+    const double elapsed_sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - started_at).count();
+
+    const auto& perf = node.getDispatcher().getTransferPerfCounter();
+    std::printf("Frames replayed:    %llu\n", static_cast<unsigned long long>(player.getNumReplayedFrames()));
+    std::printf("Transfers received: %llu\n", static_cast<unsigned long long>(perf.getRxTransferCount()));
+    std::printf("Errors:             %llu\n", static_cast<unsigned long long>(perf.getErrorCount()));
+    std::printf("Real time elapsed:  %.3f sec, %.0f frames/sec\n", elapsed_sec,
+                (elapsed_sec > 0) ? (double(player.getNumReplayedFrames()) / elapsed_sec) : 0.0);
+    std::printf("Nodes seen:");
+    monitor.forEachNode([](uavcan::NodeID nid, uavcan::NodeStatusMonitor::NodeStatus)
+        {
+            std::printf(" %d", int(nid.get()));
+        });
+    std::printf("\n");
+}
+
+void dump(const std::string& path)
+{
+    uavcan_linux::BusLogReader reader(path);
+    uavcan::CanRxFrame frame;
+    uavcan::CanIOFlags flags = 0;
+    while (reader.next(frame, flags))
+    {
+        std::printf("%s%s\n", frame.toString(uavcan::CanFrame::StrAligned).c_str(),
+                    (flags & uavcan::CanIOFlagLoopback) ? " loopback" : "");
+    }
+}
+
+/**
+ * Reassembles the transfers offline using multiple threads and prints them in the order of completion.
+ * If a layout database is given, the payloads of the data types found there are also printed as JSON.
+ */
+void decode(const std::string& path, unsigned num_threads, const std::string& layouts_path)
+{
+    uavcan_linux::BusLogReader reader(path);
+    uavcan_linux::OfflineTransferDecoder decoder(num_threads);
+    std::unique_ptr<uavcan_linux::LayoutDatabaseFile> layouts;
+    if (!layouts_path.empty())
+    {
+        layouts.reset(new uavcan_linux::LayoutDatabaseFile(layouts_path));
+        std::cerr << "Loaded " << layouts->getDatabase().getNumTypes() << " data type layouts" << std::endl;
+    }
+
+    const auto started_at = std::chrono::steady_clock::now();
+    decoder.decode(reader, [&layouts](const uavcan_linux::OfflineTransfer& tr)
+        {
+            static const char* const TransferTypeNames[] = { "RSP", "REQ", "MSG" };
+            const uavcan::DataTypeDescriptor* const desc = uavcan::GlobalDataTypeRegistry::instance().find(
+                uavcan::getDataTypeKindForTransferType(tr.transfer_type), tr.data_type_id);
+            std::printf("%s %s %3d -> %3d %-40s tid %2d len %-4u%s\n",
+                        tr.ts_mono.toString().c_str(), TransferTypeNames[tr.transfer_type],
+                        int(tr.src_node_id.get()), int(tr.dst_node_id.get()),
+                        (desc != nullptr) ? desc->getFullName() : std::to_string(tr.data_type_id.get()).c_str(),
+                        int(tr.transfer_id.get()), unsigned(tr.payload.size()),
+                        tr.crc_verified ? "" : " CRC not verified");
+            if (!layouts)
+            {
+                return;
+            }
+            // The registry knows the actual data type IDs, which may differ from the default ones
+            const uavcan::DataTypeLayoutDatabase& db = layouts->getDatabase();
+            uavcan::DataTypeLayout layout;
+            const bool found = (desc != nullptr) ? db.find(desc->getFullName(), layout) :
+                db.find(uavcan::getDataTypeKindForTransferType(tr.transfer_type), tr.data_type_id, layout);
+            if (found)
+            {
+                std::string json;
+                const int res = uavcan_linux::JsonLayoutWriter::decode(layout, tr.transfer_type, tr.payload, json);
+                std::printf("    %s %s\n", layout.getFullName(),
+                            (res < 0) ? ("decoding error " + std::to_string(res)).c_str() : json.c_str());
+            }
+        });
+    const double elapsed_sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - started_at).count();
+
+    std::cerr << "Decoded " << decoder.getNumTransfers() << " transfers from " << decoder.getNumFrames()
+              << " frames using " << decoder.getNumThreads() << " threads in " << elapsed_sec << " sec, "
+              << decoder.getNumErrors() << " errors" << std::endl;
+}
+
+}
+
+int main(int argc, const char** argv)
+{
+    try
+    {
+        const std::string command = (argc > 1) ? argv[1] : "";
+        if ((command == "record") && (argc >= 4))
+        {
+            record(argv[2], std::vector<std::string>(argv + 3, argv + argc));
+        }
+        else if ((command == "replay") && (argc >= 3))
+        {
+            const std::string speed = (argc > 3) ? argv[3] : "1";
+            replay(argv[2], (speed == "max") ? 0.0 : std::stod(speed));
+        }
+        else if ((command == "decode") && (argc >= 3) && (argc <= 5))
+        {
+            decode(argv[2], (argc > 3) ? unsigned(std::stoul(argv[3])) : 0U, (argc > 4) ? argv[4] : "");
+        }
+        else if ((command == "dump") && (argc == 3))
+        {
+            dump(argv[2]);
+        }
+        else
+        {
+            std::cerr << "Usage:\n"
+                      << "\t" << argv[0] << " record <file> <can-iface-name-1> [can-iface-name-N...]\n"
+                      << "\t" << argv[0] << " replay <file> [<speed-factor>|max]\n"
+                      << "\t" << argv[0] << " decode <file> [<num-threads> [<layout-database>]]\n"
+                      << "\t" << argv[0] << " dump <file>" << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+    catch (const std::exception& ex)
+    {
+        std::cerr << "Exception: " << ex.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <uavcan_linux/uavcan_linux.hpp>
+
+namespace
+{
+
+std::atomic<bool> g_stop_requested(false);
+
+void handleSignal(int)
+{
+    g_stop_requested = true;
+}
+
+}
+
+int main(int argc, const char** argv)
+{
+    try
+    {
+        if (argc < 2)
+        {
+            std::cerr << "Usage:\n\t" << argv[0] << " <can-iface-name-1> [can-iface-name-N...]\n"
+                      << "The segment name can be set via the UAVCAN_CAN_SEGMENT environment variable; default is "
+                      << uavcan_linux::SharedCanSegment::getDefaultName() << std::endl;
+            return 1;
+        }
+
+        const char* const segment_env = std::getenv("UAVCAN_CAN_SEGMENT");
+        const std::string segment_name = (segment_env != nullptr) ? segment_env :
+                                         uavcan_linux::SharedCanSegment::getDefaultName();
+
+        uavcan_linux::SharedCanBroker broker(std::vector<std::string>(argv + 1, argv + argc), segment_name);
+        broker.start();
+
+        (void)std::signal(SIGINT, handleSignal);
+        (void)std::signal(SIGTERM, handleSignal);
+        std::cerr << "Serving " << (argc - 1) << " iface(s) via " << segment_name << ", press Ctrl+C to stop"
+                  << std::endl;
+
+        while (!g_stop_requested)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+        broker.stop();
+
+        std::cerr << "RX " << broker.getNumRxFrames() << ", TX " << broker.getNumTxFrames()
+                  << ", TX timeouts " << broker.getNumTxTimeouts() << ", TX errors " << broker.getNumTxErrors()
+                  << std::endl;
+        return 0;
+    }
+    catch (const std::exception& ex)
+    {
+        std::cerr << "Exception: " << ex.what() << std::endl;
+        return 1;
+    }
+}
@@ -47,8 +47,10 @@ uavcan_linux::NodePtr initNode(const std::vector<std::string>& ifaces, uavcan::N
 }
 
 
-class EventTracer : public uavcan_posix::dynamic_node_id_server::FileEventTracer
+class EventTracer : public uavcan_posix::dynamic_node_id_server::BufferedFileEventTracer<>
 {
+    typedef uavcan_posix::dynamic_node_id_server::BufferedFileEventTracer<> Base;
+
 public:
     struct RecentEvent
     {
@@ -130,7 +132,7 @@ private:
 
     void onEvent(uavcan::dynamic_node_id_server::TraceCode code, std::int64_t argument) override
     {
-        uavcan_posix::dynamic_node_id_server::FileEventTracer::onEvent(code, argument);
+        Base::onEvent(code, argument);
 
         had_events_ = true;
 
@@ -152,7 +154,7 @@ public:
         : num_last_events_(num_last_events_to_keep)
     { }
 
-    using uavcan_posix::dynamic_node_id_server::FileEventTracer::init;
+    using Base::init;
 
     const RecentEvent& getEventByIndex(unsigned index) const { return last_events_.at(index); }
 
@@ -2,9 +2,13 @@
  * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
  */
 
+#include <algorithm>
+#include <array>
 #include <cstdio>
 #include <bitset>
+#include <string>
 #include <unordered_map>
+#include <vector>
 #include <uavcan_linux/uavcan_linux.hpp>
 #include <uavcan/protocol/node_status_monitor.hpp>
 #include "debug.hpp"
@@ -21,25 +25,75 @@ enum class CLIColor : unsigned
     Default = 39
 };
 
-class CLIColorizer
+/**
+ * Wraps the text into the escape sequences that set and restore the color.
+ */
+static std::string colorize(CLIColor color, const std::string& text)
+{
+    return "\033[" + std::to_string(static_cast<unsigned>(color)) + "m" + text +
+           "\033[" + std::to_string(static_cast<unsigned>(CLIColor::Default)) + "m";
+}
+
+template <typename... Args>
+static std::string format(const char* fmt, Args... args)
+{
+    char buf[256];
+    (void)std::snprintf(buf, sizeof(buf), fmt, args...);
+    return std::string(buf);
+}
+
+/**
+ * Renders the screen line by line, and rewrites only the lines that have changed since the previous frame.
+ * This keeps the terminal output small and avoids flicker, since the screen is never cleared once drawn.
+ */
+class DifferentialRenderer
 {
-    const CLIColor color_;
+    std::vector<std::string> prev_lines_;
+    std::vector<std::string> lines_;
+    bool first_frame_ = true;
+
 public:
-    explicit CLIColorizer(CLIColor c) : color_(c)
-    {
-        std::printf("\033[%um", static_cast<unsigned>(color_));
-    }
+    void addLine(const std::string& line) { lines_.push_back(line); }
 
-    ~CLIColorizer()
+    void flush()
     {
-        std::printf("\033[%um", static_cast<unsigned>(CLIColor::Default));
+        std::string out;
+        if (first_frame_)
+        {
+            out += "\x1b[2J";       // Clear the whole screen
+            first_frame_ = false;
+        }
+        for (unsigned i = 0; i < lines_.size(); i++)
+        {
+            if ((i >= prev_lines_.size()) || (prev_lines_[i] != lines_[i]))
+            {
+                // Move the cursor to the beginning of the line, print it, then clear the rest of the line
+                out += "\x1b[" + std::to_string(i + 1) + ";1H" + lines_[i] + "\x1b[K";
+            }
+        }
+        if (lines_.size() < prev_lines_.size())
+        {
+            out += "\x1b[" + std::to_string(lines_.size() + 1) + ";1H\x1b[J";   // Clear the leftovers below
+        }
+        if (!out.empty())
+        {
+            (void)std::fwrite(out.data(), 1, out.size(), stdout);
+            (void)std::fflush(stdout);
+        }
+        prev_lines_.swap(lines_);
+        lines_.clear();
     }
 };
 
 class Monitor : public uavcan::NodeStatusMonitor
 {
+    static constexpr unsigned MaxDataTypeLines = 20;
+
+    uavcan_linux::NodePtr node_;
+    uavcan_linux::BusStatistics stats_;
+    DifferentialRenderer renderer_;
     uavcan_linux::TimerPtr timer_;
-    std::unordered_map<int, uavcan::protocol::NodeStatus> status_registry_;
+    std::array<uavcan::protocol::NodeStatus, uavcan::NodeID::Max + 1> status_registry_;
 
     void handleNodeStatusMessage(const uavcan::ReceivedDataStructure<uavcan::protocol::NodeStatus>& msg) override
     {
@@ -85,7 +139,12 @@ class Monitor : public uavcan::NodeStatusMonitor
         }
     }
 
-    void printStatusLine(const uavcan::NodeID nid, const uavcan::NodeStatusMonitor::NodeStatus& status)
+    static std::string rateToString(double rate)
+    {
+        return (rate < 1e4) ? format("%.0f", rate) : format("%.1fk", rate * 1e-3);
+    }
+
+    std::string renderStatusLine(const uavcan::NodeID nid, const uavcan::NodeStatusMonitor::NodeStatus& status) const
     {
         const auto health_and_color = healthToColoredString(status.health);
         const auto mode_and_color   = modeToColoredString(status.mode);
@@ -93,45 +152,120 @@ class Monitor : public uavcan::NodeStatusMonitor
         const int nid_int = nid.get();
         const unsigned long uptime = status_registry_[nid_int].uptime_sec;
         const unsigned vendor_code = status_registry_[nid_int].vendor_specific_status_code;
+        const auto& rates = stats_.getNodeRates(nid);
 
-        std::printf(" %-3d |", nid_int);
+        return format(" %-3d |", nid_int) +
+               colorize(mode_and_color.first, format(" %-15s ", mode_and_color.second.c_str())) + "|" +
+               colorize(health_and_color.first, format(" %-8s ", health_and_color.second.c_str())) +
+               format("| %-10lu | %-8s | %-8s | %04x  %s'%s  %u", uptime,
+                      rateToString(rates.frames_per_sec).c_str(), rateToString(rates.bytes_per_sec).c_str(),
+                      vendor_code,
+                      std::bitset<8>((vendor_code >> 8) & 0xFF).to_string().c_str(),
+                      std::bitset<8>(vendor_code).to_string().c_str(),
+                      vendor_code);
+    }
+
+    void renderBusLoad()
+    {
+        renderer_.addLine(format(" Iface | Frames/s | Bytes/s  | Load @ %u kbit/s",
+                                 unsigned(stats_.getBitrate() / 1000U)));
+        renderer_.addLine("-------+----------+----------+-------------------------------------------");
+        for (unsigned i = 0; i < stats_.getNumIfaces(); i++)
         {
-            CLIColorizer clz(mode_and_color.first);
-            std::printf(" %-15s ", mode_and_color.second.c_str());
+            const auto& rates = stats_.getIfaceRates(i);
+            const double load = stats_.getIfaceUtilization(i);
+            const unsigned bar_len = unsigned(load * 30 + 0.5);
+            const CLIColor color = (load < 0.5) ? CLIColor::Green : ((load < 0.8) ? CLIColor::Yellow : CLIColor::Red);
+            renderer_.addLine(format(" %-5u | %-8s | %-8s | ", i, rateToString(rates.frames_per_sec).c_str(),
+                                     rateToString(rates.bytes_per_sec).c_str()) +
+                              colorize(color, format("%5.1f%% ", load * 100.0) + std::string(bar_len, '#')));
         }
-        std::printf("|");
+        const auto& invalid = stats_.getInvalidFrameRates();
+        if (stats_.getInvalidFrameCounters().frames > 0)
         {
-            CLIColorizer clz(health_and_color.first);
-            std::printf(" %-8s ", health_and_color.second.c_str());
+            renderer_.addLine(format(" Non-UAVCAN frames: %s/s, %llu total",
+                                     rateToString(invalid.frames_per_sec).c_str(),
+                                     static_cast<unsigned long long>(stats_.getInvalidFrameCounters().frames)));
         }
-        std::printf("| %-10lu | %04x  %s'%s  %u\n", uptime, vendor_code,
-                    std::bitset<8>((vendor_code >> 8) & 0xFF).to_string().c_str(),
-                    std::bitset<8>(vendor_code).to_string().c_str(),
-                    vendor_code);
     }
 
-    void redraw(const uavcan::TimerEvent&)
+    void renderDataTypes()
     {
-        std::printf("\x1b[1J");   // Clear screen from the current cursor position to the beginning
-        std::printf("\x1b[H");    // Move cursor to the coordinates 1,1
-        std::printf(" NID | Mode            | Health   | Uptime [s] | Vendor-specific status code\n");
-        std::printf("-----+-----------------+----------+------------+-hex---bin----------------dec--\n");
+        typedef uavcan_linux::BusStatistics::DataTypeKey Key;
+        std::vector<std::pair<double, Key>> sorted;
+        std::unordered_map<Key, uavcan_linux::BusStatistics::Rates> rates;
+        stats_.forEachDataType([&](Key key, const uavcan_linux::BusStatistics::Counters&,
+                                   const uavcan_linux::BusStatistics::Rates& r)
+            {
+                sorted.emplace_back(r.frames_per_sec, key);
+                rates[key] = r;
+            });
+        std::sort(sorted.begin(), sorted.end(), [](const std::pair<double, Key>& a, const std::pair<double, Key>& b)
+            {
+                return (a.first != b.first) ? (a.first > b.first) : (a.second < b.second);
+            });
+
+        static const char* const TransferTypeNames[] = { "RSP", "REQ", "MSG" };
+        renderer_.addLine(" DTID  | Kind | Frames/s | Bytes/s  | Data type");
+        renderer_.addLine("-------+------+----------+----------+-------------------------------------------");
+        for (unsigned i = 0; (i < sorted.size()) && (i < MaxDataTypeLines); i++)
+        {
+            const Key key = sorted[i].second;
+            const auto transfer_type = uavcan_linux::BusStatistics::getTransferType(key);
+            const auto dtid = uavcan_linux::BusStatistics::getDataTypeID(key);
+            const uavcan::DataTypeDescriptor* const desc = uavcan::GlobalDataTypeRegistry::instance().find(
+                uavcan::getDataTypeKindForTransferType(transfer_type), dtid);
+            renderer_.addLine(format(" %-5u | %-4s | %-8s | %-8s | %s", unsigned(dtid.get()),
+                                     TransferTypeNames[transfer_type],
+                                     rateToString(rates[key].frames_per_sec).c_str(),
+                                     rateToString(rates[key].bytes_per_sec).c_str(),
+                                     (desc != nullptr) ? desc->getFullName() : "?"));
+        }
+        if (sorted.size() > MaxDataTypeLines)
+        {
+            renderer_.addLine(format(" ... %u more", unsigned(sorted.size() - MaxDataTypeLines)));
+        }
+    }
+
+    void redraw(const uavcan::TimerEvent& event)
+    {
+        stats_.sample(event.real_time);
+
+        renderBusLoad();
+        renderer_.addLine("");
 
+        renderer_.addLine(" NID | Mode            | Health   | Uptime [s] | Frames/s | Bytes/s  "
+                          "| Vendor-specific status code");
+        renderer_.addLine("-----+-----------------+----------+------------+----------+----------"
+                          "+-hex---bin----------------dec--");
         for (unsigned i = 1; i <= uavcan::NodeID::Max; i++)
         {
             if (isNodeKnown(i))
             {
-                printStatusLine(i, getNodeStatus(i));
+                renderer_.addLine(renderStatusLine(i, getNodeStatus(i)));
             }
         }
+        renderer_.addLine("");
+
+        renderDataTypes();
+        renderer_.flush();
     }
 
 public:
-    explicit Monitor(uavcan_linux::NodePtr node)
+    Monitor(uavcan_linux::NodePtr node, std::uint32_t bitrate)
         : uavcan::NodeStatusMonitor(*node)
+        , node_(node)
+        , stats_(bitrate)
         , timer_(node->makeTimer(uavcan::MonotonicDuration::fromMSec(500),
                                  std::bind(&Monitor::redraw, this, std::placeholders::_1)))
-    { }
+    {
+        node_->getDispatcher().installRxFrameListener(&stats_);
+    }
+
+    ~Monitor()
+    {
+        node_->getDispatcher().removeRxFrameListener();
+    }
 };
 
 
@@ -143,9 +277,9 @@ static uavcan_linux::NodePtr initNodeInPassiveMode(const std::vector<std::string
     return node;
 }
 
-static void runForever(const uavcan_linux::NodePtr& node)
+static void runForever(const uavcan_linux::NodePtr& node, std::uint32_t bitrate)
 {
-    Monitor mon(node);
+    Monitor mon(node, bitrate);
     ENFORCE(0 == mon.start());
     while (true)
     {
@@ -161,18 +295,29 @@ int main(int argc, const char** argv)
 {
     try
     {
-        if (argc < 2)
-        {
-            std::cerr << "Usage:\n\t" << argv[0] << " <can-iface-name-1> [can-iface-name-N...]" << std::endl;
-            return 1;
-        }
+        const std::string BitrateOption = "--bitrate=";
+        std::uint32_t bitrate = 1000000;
         std::vector<std::string> iface_names;
         for (int i = 1; i < argc; i++)
         {
-            iface_names.emplace_back(argv[i]);
+            const std::string arg = argv[i];
+            if (arg.compare(0, BitrateOption.size(), BitrateOption) == 0)
+            {
+                bitrate = std::uint32_t(std::stoul(arg.substr(BitrateOption.size())));
+            }
+            else
+            {
+                iface_names.push_back(arg);
+            }
+        }
+        if (iface_names.empty() || (bitrate == 0))
+        {
+            std::cerr << "Usage:\n\t" << argv[0] << " [--bitrate=<bit/s>] <can-iface-name-1> [can-iface-name-N...]\n"
+                      << "The bit rate is used to estimate the bus load, default is 1000000" << std::endl;
+            return 1;
         }
         uavcan_linux::NodePtr node = initNodeInPassiveMode(iface_names, "org.uavcan.linux_app.node_status_monitor");
-        runForever(node);
+        runForever(node, bitrate);
         return 0;
     }
     catch (const std::exception& ex)
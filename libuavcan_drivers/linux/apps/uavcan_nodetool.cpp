@@ -7,8 +7,10 @@
 #include <thread>
 #include <mutex>
 #include <map>
+#include <queue>
 #include <algorithm>
 #include <iterator>
+#include <sstream>
 #include <uavcan_linux/uavcan_linux.hpp>
 #include <uavcan/protocol/node_status_monitor.hpp>
 #include "debug.hpp"
@@ -224,8 +226,228 @@ const std::map<std::string,
     }
 };
 
+/*
+ * Batch mode.
+ * The same request is sent to many nodes concurrently, keeping at most <window> calls in flight; the results are
+ * printed once all calls are finished, ordered by node ID, followed by a summary.
+ */
+unsigned batch_window = 16;
+
+/**
+ * Accepts comma separated node IDs and ranges, e.g. "1,5,10-20", or "all" for all nodes that are online.
+ */
+std::vector<uavcan::NodeID> parseNodeIDList(const std::string& str, const uavcan::NodeStatusMonitor& monitor)
+{
+    std::vector<uavcan::NodeID> out;
+    if (str == "all")
+    {
+        monitor.forEachNode([&out](uavcan::NodeID nid, uavcan::NodeStatusMonitor::NodeStatus status)
+                            {
+                                if (status.mode != uavcan::protocol::NodeStatus::MODE_OFFLINE)
+                                {
+                                    out.push_back(nid);
+                                }
+                            });
+        return out;
+    }
+
+    std::istringstream iss(str);
+    std::string item;
+    while (std::getline(iss, item, ','))
+    {
+        const auto dash = item.find('-');
+        const int first = std::stoi(item.substr(0, dash));
+        const int last = (dash == std::string::npos) ? first : std::stoi(item.substr(dash + 1));
+        if ((first < 1) || (last > uavcan::NodeID::Max) || (first > last))
+        {
+            throw std::invalid_argument("Invalid node ID range: " + item);
+        }
+        for (int i = first; i <= last; i++)
+        {
+            out.push_back(uavcan::NodeID(std::uint8_t(i)));
+        }
+    }
+    std::sort(out.begin(), out.end(), [](uavcan::NodeID a, uavcan::NodeID b) { return a.get() < b.get(); });
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+    return out;
+}
+
+template <typename DataType>
+void callBatch(const uavcan_linux::NodePtr& node, const std::vector<uavcan::NodeID>& node_ids,
+               const typename DataType::Request& request)
+{
+    std::map<std::uint8_t, std::string> results;
+    unsigned num_responded = 0;
+
+    auto client = node->makeServiceClient<DataType>([&](const uavcan::ServiceCallResult<DataType>& result)
+        {
+            std::ostringstream os;
+            if (result.isSuccessful())
+            {
+                os << result.getResponse();
+                num_responded++;
+            }
+            else
+            {
+                os << "<NO RESPONSE>";
+            }
+            results[result.getCallID().server_node_id.get()] = os.str();
+        });
+
+    const auto started_at = node->getMonotonicTime();
+    auto next = node_ids.begin();
+    while ((next != node_ids.end()) || (client->getNumPendingCalls() > 0))
+    {
+        while ((next != node_ids.end()) && (client->getNumPendingCalls() < batch_window))
+        {
+            const int res = client->call(*next, request);
+            if (res < 0)
+            {
+                results[next->get()] = "<CALL FAILED: " + std::to_string(res) + ">";
+            }
+            ++next;
+        }
+        ENFORCE(node->spin(uavcan::MonotonicDuration::fromMSec(1)) >= 0);
+    }
+    const auto elapsed = node->getMonotonicTime() - started_at;
+
+    for (auto& x : results)
+    {
+        std::cout << "# Node " << int(x.first) << "\n" << x.second << "\n" << std::string(80, '-') << "\n";
+    }
+    std::cout << "Responded " << num_responded << " of " << node_ids.size() << " nodes in "
+              << std::fixed << std::setprecision(3) << (double(elapsed.toUSec()) * 1e-6) << " sec" << std::endl;
+}
+
+/*
+ * Batch command table.
+ * The structure is the same as above, except that the entry point accepts a list of node IDs.
+ */
+const std::map<std::string,
+               std::pair<std::string,
+                         std::function<void(const uavcan_linux::NodePtr&, const std::vector<uavcan::NodeID>&,
+                                            const std::vector<std::string>&)>
+                        >
+              > batch_commands =
+{
+    {
+        "param",
+        {
+            "<param_name> - reads parameter <param_name>\n"
+            "<param_name> <param_value> - assigns parameter <param_name> to value <param_value>",
+            [](const uavcan_linux::NodePtr& node, const std::vector<uavcan::NodeID>& node_ids,
+               const std::vector<std::string>& args)
+            {
+                uavcan::protocol::param::GetSet::Request request;
+                request.name = args.at(0).c_str();
+                if (args.size() > 1)
+                {
+                    request.value.to<uavcan::protocol::param::Value::Tag::real_value>() = std::stof(args.at(1));
+                }
+                callBatch<uavcan::protocol::param::GetSet>(node, node_ids, request);
+            }
+        }
+    },
+    {
+        "param_save",
+        {
+            "Calls uavcan.protocol.param.ExecuteOpcode with OPCODE_SAVE",
+            [](const uavcan_linux::NodePtr& node, const std::vector<uavcan::NodeID>& node_ids,
+               const std::vector<std::string>&)
+            {
+                uavcan::protocol::param::ExecuteOpcode::Request request;
+                request.opcode = request.OPCODE_SAVE;
+                callBatch<uavcan::protocol::param::ExecuteOpcode>(node, node_ids, request);
+            }
+        }
+    },
+    {
+        "param_erase",
+        {
+            "Calls uavcan.protocol.param.ExecuteOpcode with OPCODE_ERASE",
+            [](const uavcan_linux::NodePtr& node, const std::vector<uavcan::NodeID>& node_ids,
+               const std::vector<std::string>&)
+            {
+                uavcan::protocol::param::ExecuteOpcode::Request request;
+                request.opcode = request.OPCODE_ERASE;
+                callBatch<uavcan::protocol::param::ExecuteOpcode>(node, node_ids, request);
+            }
+        }
+    },
+    {
+        "restart",
+        {
+            "Restarts the nodes using uavcan.protocol.RestartNode",
+            [](const uavcan_linux::NodePtr& node, const std::vector<uavcan::NodeID>& node_ids,
+               const std::vector<std::string>&)
+            {
+                uavcan::protocol::RestartNode::Request request;
+                request.magic_number = request.MAGIC_NUMBER;
+                callBatch<uavcan::protocol::RestartNode>(node, node_ids, request);
+            }
+        }
+    },
+    {
+        "info",
+        {
+            "Calls uavcan.protocol.GetNodeInfo",
+            [](const uavcan_linux::NodePtr& node, const std::vector<uavcan::NodeID>& node_ids,
+               const std::vector<std::string>&)
+            {
+                callBatch<uavcan::protocol::GetNodeInfo>(node, node_ids, uavcan::protocol::GetNodeInfo::Request());
+            }
+        }
+    },
+    {
+        "transport_stats",
+        {
+            "Calls uavcan.protocol.GetTransportStats",
+            [](const uavcan_linux::NodePtr& node, const std::vector<uavcan::NodeID>& node_ids,
+               const std::vector<std::string>&)
+            {
+                callBatch<uavcan::protocol::GetTransportStats>(node, node_ids,
+                                                               uavcan::protocol::GetTransportStats::Request());
+            }
+        }
+    }
+};
+
+/**
+ * Handles "batch <command> <node-ids> [args...]" and "batch_window <N>".
+ * @return False if the words are not a batch command.
+ */
+bool runBatchCommand(const uavcan_linux::NodePtr& node, const uavcan::NodeStatusMonitor& monitor,
+                     const std::vector<std::string>& words)
+{
+    if ((words.size() >= 2) && (words.at(0) == "batch_window"))
+    {
+        const int window = std::stoi(words.at(1));
+        if (window < 1)
+        {
+            throw std::invalid_argument("Batch window must be positive");
+        }
+        batch_window = unsigned(window);
+        return true;
+    }
+    if ((words.size() >= 3) && (words.at(0) == "batch"))
+    {
+        auto it = batch_commands.find(words.at(1));
+        if (it == std::end(batch_commands))
+        {
+            return false;
+        }
+        const auto node_ids = parseNodeIDList(words.at(2), monitor);
+        it->second.second(node, node_ids, std::vector<std::string>(words.begin() + 3, words.end()));
+        return true;
+    }
+    return false;
+}
+
 void runForever(const uavcan_linux::NodePtr& node)
 {
+    uavcan::NodeStatusMonitor monitor(*node);       // Needed to resolve "all" in the batch mode
+    ENFORCE(0 <= monitor.start());
+
     StdinLineReader stdin_reader;
     std::cout << "> " << std::flush;
     while (true)
@@ -240,7 +462,11 @@ void runForever(const uavcan_linux::NodePtr& node)
 
         try
         {
-            if (words.size() >= 2)
+            if (runBatchCommand(node, monitor, words))
+            {
+                command_is_known = true;
+            }
+            else if (words.size() >= 2)
             {
                 const auto cmd = words.at(0);
                 const uavcan::NodeID node_id(std::stoi(words.at(1)));
@@ -269,6 +495,17 @@ void runForever(const uavcan_linux::NodePtr& node)
                 {
                     std::cout << cmd.first << "\n" << cmd.second.first << "\n\n";
                 }
+                std::cout << "Batch mode:\n\n"
+                          << "batch <command> <remote node ids> [args...]\n"
+                          << "Runs the command on many nodes concurrently; the node IDs are comma separated IDs or "
+                          << "ranges, e.g. 1,5,10-20, or 'all' for all online nodes\n\n"
+                          << "batch_window <N>\n"
+                          << "Sets the maximum number of concurrent calls in the batch mode, currently "
+                          << batch_window << "\n\n";
+                for (auto& cmd : batch_commands)
+                {
+                    std::cout << "batch " << cmd.first << "\n" << cmd.second.first << "\n\n";
+                }
             }
         }
         std::cout << "> " << std::flush;
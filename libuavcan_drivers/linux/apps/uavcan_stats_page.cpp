@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <iostream>
+#include <string>
+#include <uavcan_linux/uavcan_linux.hpp>
+
+namespace
+{
+
+void printMetric(const std::string& name, std::uint64_t value, const std::string& labels = "")
+{
+    std::cout << "uavcan_" << name;
+    if (!labels.empty())
+    {
+        std::cout << "{" << labels << "}";
+    }
+    std::cout << " " << value << "\n";
+}
+
+}
+
+/**
+ * Prints the contents of the stats page exported by uavcan_linux::Node::exportStatsPage() in the Prometheus text
+ * format, e.g. for the textfile collector of node_exporter.
+ */
+int main(int argc, const char** argv)
+{
+    try
+    {
+        if (argc < 2)
+        {
+            std::cerr << "Usage:\n\t" << argv[0] << " <page-name>" << std::endl;
+            return 1;
+        }
+
+        const auto page = uavcan_linux::StatsPage::open(argv[1]);
+        uavcan_linux::StatsPageData data;
+        if (!page->read(data))
+        {
+            std::cerr << "The page is being updated continuously" << std::endl;
+            return 1;
+        }
+
+        printMetric("update_ts_mono_usec", data.ts_mono_usec);
+        printMetric("node_id", data.node_id);
+        printMetric("transfers_tx_total", data.transfers_tx);
+        printMetric("transfers_rx_total", data.transfers_rx);
+        printMetric("transfer_errors_total", data.transfer_errors);
+        printMetric("frames_filtered_total", data.frames_filtered);
+
+        printMetric("pool_capacity_blocks", data.pool_capacity_blocks);
+        printMetric("pool_used_blocks", data.pool_used_blocks);
+        printMetric("pool_peak_used_blocks", data.pool_peak_used_blocks);
+        for (unsigned i = 0; i < uavcan::NumPoolUsageTags; i++)
+        {
+            const std::string labels = "tag=\"" + std::to_string(i) + "\"";
+            printMetric("pool_tag_used_blocks", data.pool_used_blocks_per_tag[i], labels);
+            printMetric("pool_tag_peak_used_blocks", data.pool_peak_used_blocks_per_tag[i], labels);
+        }
+
+        for (unsigned i = 0; (i < data.num_ifaces) && (i < uavcan_linux::StatsPageData::MaxIfaces); i++)
+        {
+            const uavcan_linux::StatsPageIface& iface = data.ifaces[i];
+            const std::string labels = "iface=\"" + std::to_string(i) + "\"";
+            printMetric("iface_frames_tx_total", iface.frames_tx, labels);
+            printMetric("iface_frames_rx_total", iface.frames_rx, labels);
+            printMetric("iface_errors_total", iface.errors, labels);
+            printMetric("iface_frames_deferred_total", iface.frames_deferred, labels);
+            printMetric("iface_tx_queue_pending_frames", iface.tx_queue_num_pending_frames, labels);
+            printMetric("iface_tx_queue_free_blocks", iface.tx_queue_num_free_blocks, labels);
+        }
+        std::cout << std::flush;
+        return 0;
+    }
+    catch (const std::exception& ex)
+    {
+        std::cerr << "Exception: " << ex.what() << std::endl;
+        return 1;
+    }
+}
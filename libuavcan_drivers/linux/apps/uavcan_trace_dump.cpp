@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <uavcan_linux/uavcan_linux.hpp>
+
+/**
+ * Decodes the event trace dumps written by uavcan_linux::saveEventTrace(), or extracted from an embedded node
+ * in the same format. If event names are given, only the records of these events are printed; the intervals are
+ * still computed between the adjacent records of the dump.
+ */
+int main(int argc, const char** argv)
+{
+    try
+    {
+        if (argc < 2)
+        {
+            std::cerr << "Usage:\n"
+                      << "\t" << argv[0] << " <file> [event-name-1 event-name-N...]\n"
+                      << "Events: ";
+            for (unsigned i = 0; i < uavcan::NumTraceEvents; i++)
+            {
+                std::cerr << uavcan_linux::getTraceEventName(std::uint8_t(i)) << " ";
+            }
+            std::cerr << std::endl;
+            return 1;
+        }
+
+        const uavcan_linux::EventTraceDump dump = uavcan_linux::loadEventTrace(argv[1]);
+        const std::vector<std::string> events(argv + 2, argv + argc);
+        if (events.empty())
+        {
+            uavcan_linux::printEventTrace(dump, std::cout);
+            return 0;
+        }
+
+        std::cout << dump.records.size() << " records, " << dump.num_lost_records << " lost" << std::endl;
+        for (std::size_t i = 0; i < dump.records.size(); i++)
+        {
+            const std::string name = uavcan_linux::getTraceEventName(dump.records[i].event);
+            if (std::find(events.begin(), events.end(), name) != events.end())
+            {
+                std::cout << uavcan_linux::formatTraceRecord(dump.records[i], (i > 0) ? &dump.records[i - 1] : nullptr)
+                          << std::endl;
+            }
+        }
+        return 0;
+    }
+    catch (const std::exception& ex)
+    {
+        std::cerr << "Exception: " << ex.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <poll.h>
+#include <uavcan_linux/uavcan_linux.hpp>
+
+namespace
+{
+
+std::atomic<bool> g_stop_requested(false);
+
+void handleSignal(int)
+{
+    g_stop_requested = true;
+}
+
+const uavcan::MonotonicDuration TxTimeout = uavcan::MonotonicDuration::fromMSec(100);
+const uavcan::MonotonicDuration MaxPollTimeout = uavcan::MonotonicDuration::fromMSec(100);
+
+/**
+ * Forwards everything received by one driver to the same iface of the other driver.
+ */
+template <typename Source, typename Forwarder>
+void forward(Source& source, const Forwarder& forwarder)
+{
+    const uavcan::CanFrame* pending_tx[uavcan::MaxCanIfaces] = {};
+    uavcan::CanSelectMasks masks;
+    masks.read = std::uint8_t((1U << source.getNumIfaces()) - 1U);
+    if (source.select(masks, pending_tx, uavcan::MonotonicTime()) < 0)
+    {
+        throw uavcan_linux::Exception("select() failed");
+    }
+    for (std::uint8_t i = 0; i < source.getNumIfaces(); i++)
+    {
+        uavcan::CanFrame frame;
+        uavcan::MonotonicTime ts_mono;
+        uavcan::UtcTime ts_utc;
+        uavcan::CanIOFlags flags = 0;
+        while (source.getIface(i)->receive(frame, ts_mono, ts_utc, flags) > 0)
+        {
+            forwarder(i, frame, ts_mono);
+        }
+    }
+}
+
+void run(const uavcan_linux::UdpCanParams& params, const std::vector<std::string>& iface_names)
+{
+    const uavcan_linux::SystemClock clock;
+
+    uavcan_linux::SocketCanDriver can(clock);
+    for (auto& name : iface_names)
+    {
+        if (can.addIface(name) < 0)
+        {
+            throw uavcan_linux::Exception("Failed to add iface " + name);
+        }
+    }
+    uavcan_linux::UdpCanDriver udp(clock, params);
+
+    std::cerr << "Bridging " << iface_names.size() << " iface(s) via UDP port " << udp.getLocalPort()
+              << ", press Ctrl+C to stop" << std::endl;
+
+    while (!g_stop_requested)
+    {
+        std::vector<::pollfd> fds = can.getPollFds();
+        const std::vector<::pollfd> udp_fds = udp.getPollFds();
+        fds.insert(fds.end(), udp_fds.begin(), udp_fds.end());
+
+        uavcan::MonotonicDuration timeout = MaxPollTimeout;
+        if (!udp.getFlushDeadline().isZero())
+        {
+            timeout = std::min(timeout, udp.getFlushDeadline() - clock.getMonotonic());
+        }
+        const std::int64_t timeout_msec = std::max<std::int64_t>((timeout.toUSec() + 999) / 1000, 0);
+        if ((::poll(fds.data(), fds.size(), int(timeout_msec)) < 0) && (errno != EINTR))
+        {
+            throw uavcan_linux::Exception("poll() failed");
+        }
+
+        // The bus timestamps are passed through, so the remote side sees the original timing
+        forward(can, [&](std::uint8_t iface_index, const uavcan::CanFrame& frame, uavcan::MonotonicTime ts_mono)
+        {
+            (void)udp.getIface(iface_index)->sendWithTimestamp(frame, ts_mono, clock.getMonotonic() + TxTimeout, 0);
+        });
+        forward(udp, [&](std::uint8_t iface_index, const uavcan::CanFrame& frame, uavcan::MonotonicTime)
+        {
+            (void)can.getIface(iface_index)->send(frame, clock.getMonotonic() + TxTimeout, 0);
+        });
+    }
+
+    std::cerr << "UDP TX " << udp.getNumTxDatagrams() << ", RX " << udp.getNumRxDatagrams()
+              << ", lost " << udp.getNumLostDatagrams() << ", malformed " << udp.getNumMalformedDatagrams()
+              << ", TX errors " << udp.getNumTxErrors() << ", TX timeouts " << udp.getNumTxTimeouts() << std::endl;
+}
+
+}
+
+int main(int argc, const char** argv)
+{
+    try
+    {
+        if (argc < 5)
+        {
+            std::cerr << "Usage:\n\t" << argv[0]
+                      << " <local-port> <remote-address|-> <remote-port> <can-iface-name-1> [can-iface-name-N...]\n"
+                      << "Pass - as the remote address to reply to the peer the datagrams come from.\n"
+                      << "The flush latency in microseconds can be set via the UAVCAN_UDP_FLUSH_USEC "
+                      << "environment variable." << std::endl;
+            return 1;
+        }
+
+        uavcan_linux::UdpCanParams params;
+        params.local_port = std::uint16_t(std::stoul(argv[1]));
+        if (std::string(argv[2]) != "-")
+        {
+            params.remote_address = argv[2];
+            params.remote_port = std::uint16_t(std::stoul(argv[3]));
+        }
+        params.num_ifaces = unsigned(argc - 4);
+
+        const char* const flush_env = std::getenv("UAVCAN_UDP_FLUSH_USEC");
+        if (flush_env != nullptr)
+        {
+            params.flush_latency = uavcan::MonotonicDuration::fromUSec(std::stoll(flush_env));
+        }
+
+        (void)std::signal(SIGINT, handleSignal);
+        (void)std::signal(SIGTERM, handleSignal);
+
+        run(params, std::vector<std::string>(argv + 4, argv + argc));
+        return 0;
+    }
+    catch (const std::exception& ex)
+    {
+        std::cerr << "Exception: " << ex.what() << std::endl;
+        return 1;
+    }
+}
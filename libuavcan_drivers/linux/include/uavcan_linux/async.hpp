@@ -0,0 +1,388 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <map>
+#include <memory>
+
+#include <uavcan/error.hpp>
+#include <uavcan/node/abstract_node.hpp>
+#include <uavcan/node/service_client.hpp>
+#include <uavcan/node/subscriber.hpp>
+
+/**
+ * Set to 1 if the compiler supports C++20 coroutines; then the futures and streams defined here can be co_await-ed.
+ * Can be overridden to 0 explicitly. Note that libuavcan has to be told UAVCAN_CPP_VERSION=UAVCAN_CPP11 explicitly
+ * when compiled in C++20 mode.
+ */
+#ifndef UAVCAN_LINUX_COROUTINES
+# if defined(__cpp_impl_coroutine) && (__cpp_impl_coroutine >= 201902L)
+#  define UAVCAN_LINUX_COROUTINES 1
+# else
+#  define UAVCAN_LINUX_COROUTINES 0
+# endif
+#endif
+
+#if UAVCAN_LINUX_COROUTINES
+# include <coroutine>
+#endif
+
+namespace uavcan_linux
+{
+/**
+ * Spins the node until the predicate returns true, or until the timeout expires.
+ * This is how the futures below are driven when the calling code is not a coroutine: start any number of
+ * calls, then wait for all of them at once.
+ * Returns negative error code; -ErrFailure on timeout.
+ */
+template <typename Predicate>
+int spinUntil(uavcan::INode& node, Predicate predicate,
+              uavcan::MonotonicDuration timeout = uavcan::MonotonicDuration::getInfinite())
+{
+    const auto SpinDuration = uavcan::MonotonicDuration::fromMSec(2);
+    const uavcan::MonotonicTime deadline = (timeout == uavcan::MonotonicDuration::getInfinite()) ?
+        uavcan::MonotonicTime::getMax() : (node.getMonotonicTime() + timeout);
+    while (!predicate())
+    {
+        if (node.getMonotonicTime() >= deadline)
+        {
+            return -uavcan::ErrFailure;
+        }
+        const int res = node.spin(SpinDuration);
+        if (res < 0)
+        {
+            return res;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Result of an asynchronous service call, see @ref AsyncServiceClient.
+ * Copies share the same state. The result becomes available while the node is spinning.
+ *
+ * If coroutines are available, the future can be co_await-ed from a coroutine (e.g. @ref Task); the awaiting
+ * coroutine is resumed from the node's spin() after the call completes, and receives the future itself.
+ * It must not call spin() of the same node.
+ */
+template <typename DataType>
+class ServiceCallFuture
+{
+    template <typename> friend class AsyncServiceClient;
+
+    struct State
+    {
+        bool ready = false;
+        int error = 0;                                  ///< Zero if the request was sent successfully
+        bool successful = false;
+        uavcan::NodeID server_node_id;
+        typename DataType::Response response;
+        std::function<void ()> continuation;
+
+        void complete()
+        {
+            ready = true;
+            if (continuation)
+            {
+                auto cont = std::move(continuation);
+                continuation = nullptr;
+                cont();
+            }
+        }
+    };
+
+    std::shared_ptr<State> state_;
+
+    explicit ServiceCallFuture(const std::shared_ptr<State>& state) : state_(state) { }
+
+public:
+    bool isReady() const { return state_->ready; }
+
+    /**
+     * True if the response was received. False if the call is still pending, timed out, or couldn't be started.
+     */
+    bool isSuccessful() const { return state_->successful; }
+
+    /**
+     * Negative error code if the request couldn't be sent; zero otherwise.
+     */
+    int getError() const { return state_->error; }
+
+    uavcan::NodeID getServerNodeID() const { return state_->server_node_id; }
+
+    /**
+     * Default constructed response unless the call was successful.
+     */
+    const typename DataType::Response& getResponse() const { return state_->response; }
+
+#if UAVCAN_LINUX_COROUTINES
+    bool await_ready() const noexcept { return state_->ready; }
+    void await_suspend(std::coroutine_handle<> handle) { state_->continuation = [handle]() { handle.resume(); }; }
+    ServiceCallFuture await_resume() const { return *this; }
+#endif
+};
+
+/**
+ * Service client that returns a future for every call instead of invoking a callback, see @ref ServiceCallFuture.
+ * Any number of calls can be pending at once, only limited by the memory pool of the node.
+ * The client must outlive the calls; destroying it cancels them, and their futures never become ready.
+ */
+template <typename DataType>
+class AsyncServiceClient : public uavcan::ServiceClient<DataType>
+{
+    typedef uavcan::ServiceClient<DataType> Super;
+    typedef typename ServiceCallFuture<DataType>::State State;
+
+    // Call IDs are not necessarily unique, in which case the oldest call is served first, same as in the library
+    std::map<std::uint16_t, std::deque<std::shared_ptr<State>>> pending_;
+
+    static std::uint16_t makeKey(const uavcan::ServiceCallID& call_id)
+    {
+        return std::uint16_t((call_id.server_node_id.get() << 8) | call_id.transfer_id.get());
+    }
+
+    void callback(const uavcan::ServiceCallResult<DataType>& result)
+    {
+        const auto entry = pending_.find(makeKey(result.getCallID()));
+        if (entry == pending_.end())
+        {
+            return;
+        }
+        const std::shared_ptr<State> state = entry->second.front();
+        entry->second.pop_front();
+        if (entry->second.empty())
+        {
+            (void)pending_.erase(entry);
+        }
+
+        state->successful = result.isSuccessful();
+        if (state->successful)
+        {
+            state->response = result.getResponse();
+        }
+        state->complete();          // May resume a coroutine, which may start new calls
+    }
+
+public:
+    explicit AsyncServiceClient(uavcan::INode& node)
+        : Super(node)
+    {
+        Super::setCallback(std::bind(&AsyncServiceClient::callback, this, std::placeholders::_1));
+    }
+
+    /**
+     * Starts a call using the current request timeout. Never fails; if the request couldn't be sent,
+     * the returned future is ready immediately and reports the error via @ref ServiceCallFuture::getError().
+     */
+    ServiceCallFuture<DataType> call(uavcan::NodeID server_node_id, const typename DataType::Request& request)
+    {
+        std::shared_ptr<State> state(new State);
+        state->server_node_id = server_node_id;
+
+        uavcan::ServiceCallID call_id;
+        const int res = Super::call(server_node_id, request, call_id);
+        if (res < 0)
+        {
+            state->error = res;
+            state->ready = true;
+        }
+        else
+        {
+            pending_[makeKey(call_id)].push_back(state);
+        }
+        return ServiceCallFuture<DataType>(state);
+    }
+};
+
+/**
+ * Subscriber that accumulates the received messages in a bounded queue instead of invoking a callback.
+ * When the queue is full, the oldest messages are dropped.
+ *
+ * If coroutines are available, @ref next() can be co_await-ed to receive the messages one by one in a loop.
+ */
+template <typename DataType>
+class SubscriptionStream
+{
+public:
+    struct Message
+    {
+        DataType payload;
+        uavcan::NodeID src_node_id;
+        uavcan::MonotonicTime ts_monotonic;
+        uavcan::UtcTime ts_utc;
+    };
+
+private:
+    typedef uavcan::Subscriber<DataType> Sub;
+
+    const std::size_t capacity_;
+    std::deque<Message> queue_;
+    std::function<void ()> continuation_;
+    std::uint64_t num_dropped_ = 0;
+    Sub sub_;
+
+    void callback(const uavcan::ReceivedDataStructure<DataType>& msg)
+    {
+        if (queue_.size() >= capacity_)
+        {
+            queue_.pop_front();
+            num_dropped_++;
+        }
+        queue_.push_back(Message{ msg, msg.getSrcNodeID(), msg.getMonotonicTimestamp(), msg.getUtcTimestamp() });
+        if (continuation_)
+        {
+            auto cont = std::move(continuation_);
+            continuation_ = nullptr;
+            cont();
+        }
+    }
+
+public:
+    explicit SubscriptionStream(uavcan::INode& node, std::size_t capacity = 100)
+        : capacity_((capacity > 0) ? capacity : 1)
+        , sub_(node)
+    { }
+
+    /**
+     * Returns negative error code.
+     */
+    int start()
+    {
+        return sub_.start(std::bind(&SubscriptionStream::callback, this, std::placeholders::_1));
+    }
+
+    bool isEmpty() const { return queue_.empty(); }
+    std::size_t getSize() const { return queue_.size(); }
+
+    /**
+     * Number of messages that were dropped because the queue was full.
+     */
+    std::uint64_t getNumDropped() const { return num_dropped_; }
+
+    /**
+     * Returns false if the queue is empty.
+     */
+    bool tryPop(Message& out_message)
+    {
+        if (queue_.empty())
+        {
+            return false;
+        }
+        out_message = std::move(queue_.front());
+        queue_.pop_front();
+        return true;
+    }
+
+    Sub& getSubscriber() { return sub_; }
+
+#if UAVCAN_LINUX_COROUTINES
+    class NextAwaiter
+    {
+        SubscriptionStream& owner_;
+
+    public:
+        explicit NextAwaiter(SubscriptionStream& owner) : owner_(owner) { }
+
+        bool await_ready() const noexcept { return !owner_.queue_.empty(); }
+        void await_suspend(std::coroutine_handle<> handle)
+        {
+            owner_.continuation_ = [handle]() { handle.resume(); };
+        }
+        Message await_resume()
+        {
+            Message msg;
+            (void)owner_.tryPop(msg);
+            return msg;
+        }
+    };
+
+    /**
+     * Awaits the next message. Only one coroutine can await a stream at a time.
+     */
+    NextAwaiter next() { return NextAwaiter(*this); }
+#endif
+};
+
+#if UAVCAN_LINUX_COROUTINES
+/**
+ * Minimal eagerly started coroutine type that allows to co_await the futures and streams defined above.
+ * The coroutine runs until its first suspension point when created, and is then resumed by the node's spin().
+ * Copies share the same state; the coroutine frame is destroyed automatically when the coroutine finishes.
+ *
+ *     uavcan_linux::Task query(uavcan_linux::AsyncServiceClient<uavcan::protocol::GetNodeInfo>& client,
+ *                              uavcan::NodeID nid)
+ *     {
+ *         auto result = co_await client.call(nid, uavcan::protocol::GetNodeInfo::Request());
+ *         ...
+ *     }
+ *
+ *     std::vector<uavcan_linux::Task> tasks;
+ *     for (int nid = 1; nid <= 127; nid++)
+ *     {
+ *         tasks.push_back(query(client, nid));
+ *     }
+ *     uavcan_linux::spinUntil(*node, [&]() { return uavcan_linux::Task::areAllDone(tasks); });
+ */
+class Task
+{
+    struct State
+    {
+        bool done = false;
+        std::exception_ptr exception;
+    };
+
+    std::shared_ptr<State> state_;
+
+    explicit Task(const std::shared_ptr<State>& state) : state_(state) { }
+
+public:
+    struct promise_type
+    {
+        std::shared_ptr<State> state = std::make_shared<State>();
+
+        Task get_return_object() { return Task(state); }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() { state->done = true; }
+        void unhandled_exception()
+        {
+            state->exception = std::current_exception();
+            state->done = true;
+        }
+    };
+
+    bool isDone() const { return state_->done; }
+
+    /**
+     * Rethrows the exception that terminated the coroutine, if any.
+     */
+    void rethrowIfFailed() const
+    {
+        if (state_->exception)
+        {
+            std::rethrow_exception(state_->exception);
+        }
+    }
+
+    template <typename Container>
+    static bool areAllDone(const Container& tasks)
+    {
+        for (const Task& t : tasks)
+        {
+            if (!t.isDone())
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+#endif
+
+}
@@ -0,0 +1,566 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <uavcan/driver/can.hpp>
+#include <uavcan/driver/system_clock.hpp>
+#include <uavcan/transport/dispatcher.hpp>
+#include <uavcan_linux/exception.hpp>
+
+namespace uavcan_linux
+{
+/**
+ * Layout of the bus log file. All fields are in the host byte order.
+ *
+ * The file begins with @ref BusLogFileHeader, which is followed by the records. Every record consists of
+ * @ref BusLogRecordHeader and the data bytes of the frame, without padding. A record with zero monotonic timestamp
+ * marks the end of the log; this is what a log that was not closed properly ends with, since the file is
+ * preallocated with zeros.
+ */
+struct BusLogFileHeader
+{
+    static constexpr std::uint32_t CurrentVersion = 1;
+
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t record_header_size;
+};
+
+struct BusLogRecordHeader
+{
+    static constexpr std::uint8_t FlagLoopback = 1;
+
+    std::uint64_t ts_mono_usec;
+    std::uint64_t ts_utc_usec;
+    std::uint32_t can_id;                       ///< CanFrame::id, including the flags
+    std::uint8_t iface_index;
+    std::uint8_t flags;
+    std::uint8_t data_len;
+    std::uint8_t reserved;
+};
+
+static_assert(sizeof(BusLogFileHeader) == 16, "Unexpected file header layout");
+static_assert(sizeof(BusLogRecordHeader) == 24, "Unexpected record header layout");
+
+static constexpr char BusLogMagic[8] = { 'U', 'A', 'V', 'C', 'A', 'N', 'B', 'L' };
+
+/**
+ * Records all frames received by a node into a memory-mapped file.
+ * Install it via @ref uavcan::Dispatcher::installRxFrameListener(); every frame costs one copy into the mapping
+ * and no system calls, except when the file has to be grown, which happens in large chunks.
+ *
+ * The file is truncated to its actual length when the writer is destroyed or closed.
+ */
+class BusLogWriter : public uavcan::IRxFrameListener
+{
+    enum { DefaultChunkSize = 16 * 1024 * 1024 };
+
+    const std::size_t chunk_size_;
+    int fd_ = -1;
+    std::uint8_t* map_ = nullptr;
+    std::size_t map_size_ = 0;
+    std::size_t offset_ = 0;
+    std::uint64_t num_records_ = 0;
+
+    void unmap()
+    {
+        if (map_ != nullptr)
+        {
+            (void)::munmap(map_, map_size_);
+            map_ = nullptr;
+        }
+    }
+
+    void grow(std::size_t min_size)
+    {
+        std::size_t new_size = map_size_;
+        while (new_size < min_size)
+        {
+            new_size += chunk_size_;
+        }
+        unmap();
+        if (::ftruncate(fd_, off_t(new_size)) < 0)
+        {
+            throw Exception("Failed to grow the bus log file");
+        }
+        void* const map = ::mmap(nullptr, new_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+        if (map == MAP_FAILED)
+        {
+            throw Exception("Failed to map the bus log file");
+        }
+        map_ = static_cast<std::uint8_t*>(map);
+        map_size_ = new_size;
+    }
+
+public:
+    /**
+     * Creates the file, or truncates it if it exists.
+     * @throws uavcan_linux::Exception.
+     */
+    explicit BusLogWriter(const std::string& path, std::size_t chunk_size = DefaultChunkSize)
+        : chunk_size_((chunk_size > 0) ? chunk_size : std::size_t(DefaultChunkSize))
+    {
+        fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd_ < 0)
+        {
+            throw Exception("Failed to create the bus log file " + path);
+        }
+        grow(sizeof(BusLogFileHeader));
+
+        BusLogFileHeader hdr;
+        std::memcpy(hdr.magic, BusLogMagic, sizeof(hdr.magic));
+        hdr.version = BusLogFileHeader::CurrentVersion;
+        hdr.record_header_size = sizeof(BusLogRecordHeader);
+        std::memcpy(map_, &hdr, sizeof(hdr));
+        offset_ = sizeof(hdr);
+    }
+
+    ~BusLogWriter()
+    {
+        try
+        {
+            close();
+        }
+        catch (...)
+        {
+            // Nothing can be done here
+        }
+    }
+
+    BusLogWriter(const BusLogWriter&) = delete;
+    BusLogWriter& operator=(const BusLogWriter&) = delete;
+
+    /**
+     * Appends one record. Frames with zero monotonic timestamp can't be logged and are ignored.
+     * @throws uavcan_linux::Exception.
+     */
+    void write(const uavcan::CanRxFrame& frame, uavcan::CanIOFlags flags)
+    {
+        if ((fd_ < 0) || frame.ts_mono.isZero())
+        {
+            return;
+        }
+        const std::size_t record_size = sizeof(BusLogRecordHeader) + frame.dlc;
+        // One spare record header at the end, so that the log is always terminated with zeros
+        if ((offset_ + record_size + sizeof(BusLogRecordHeader)) > map_size_)
+        {
+            grow(offset_ + record_size + sizeof(BusLogRecordHeader));
+        }
+
+        BusLogRecordHeader rec;
+        rec.ts_mono_usec = frame.ts_mono.toUSec();
+        rec.ts_utc_usec = frame.ts_utc.toUSec();
+        rec.can_id = frame.id;
+        rec.iface_index = frame.iface_index;
+        rec.flags = std::uint8_t((flags & uavcan::CanIOFlagLoopback) ? BusLogRecordHeader::FlagLoopback : 0U);
+        rec.data_len = frame.dlc;
+        rec.reserved = 0;
+
+        std::memcpy(map_ + offset_, &rec, sizeof(rec));
+        std::memcpy(map_ + offset_ + sizeof(rec), frame.data, frame.dlc);
+        offset_ += record_size;
+        num_records_++;
+    }
+
+    void handleRxFrame(const uavcan::CanRxFrame& frame, uavcan::CanIOFlags flags) override
+    {
+        write(frame, flags);
+    }
+
+    /**
+     * Unmaps the file and truncates it to the actual length of the log. Subsequent writes are ignored.
+     * @throws uavcan_linux::Exception.
+     */
+    void close()
+    {
+        if (fd_ < 0)
+        {
+            return;
+        }
+        unmap();
+        const int trunc_res = ::ftruncate(fd_, off_t(offset_));
+        (void)::close(fd_);
+        fd_ = -1;
+        if (trunc_res < 0)
+        {
+            throw Exception("Failed to truncate the bus log file");
+        }
+    }
+
+    std::uint64_t getNumRecords() const { return num_records_; }
+    std::uint64_t getSizeInBytes() const { return offset_; }
+};
+
+/**
+ * Reads a bus log file that was created by @ref BusLogWriter. The file is memory-mapped.
+ * The records are validated once when the file is opened; a truncated log is read up to its last complete record.
+ */
+class BusLogReader
+{
+    const std::uint8_t* map_ = nullptr;
+    std::size_t map_size_ = 0;
+    std::size_t end_offset_ = sizeof(BusLogFileHeader);
+    std::size_t offset_ = sizeof(BusLogFileHeader);
+    std::uint64_t num_records_ = 0;
+    std::uint8_t num_ifaces_ = 0;
+    uavcan::MonotonicTime first_ts_mono_;
+    uavcan::MonotonicTime last_ts_mono_;
+    uavcan::UtcDuration utc_offset_;
+
+    bool readAt(std::size_t offset, BusLogRecordHeader& out_rec) const
+    {
+        if ((offset + sizeof(BusLogRecordHeader)) > map_size_)
+        {
+            return false;
+        }
+        std::memcpy(&out_rec, map_ + offset, sizeof(out_rec));
+        return (out_rec.ts_mono_usec != 0) &&
+               (out_rec.data_len <= uavcan::CanFrame::MaxDataLen) &&
+               (out_rec.iface_index < uavcan::MaxCanIfaces) &&
+               ((offset + sizeof(BusLogRecordHeader) + out_rec.data_len) <= map_size_);
+    }
+
+    void scan()
+    {
+        bool utc_known = false;
+        BusLogRecordHeader rec;
+        while (readAt(end_offset_, rec))
+        {
+            if (num_records_ == 0)
+            {
+                first_ts_mono_ = uavcan::MonotonicTime::fromUSec(rec.ts_mono_usec);
+            }
+            last_ts_mono_ = uavcan::MonotonicTime::fromUSec(rec.ts_mono_usec);
+            if (!utc_known && (rec.ts_utc_usec != 0))
+            {
+                utc_offset_ = uavcan::UtcDuration::fromUSec(std::int64_t(rec.ts_utc_usec - rec.ts_mono_usec));
+                utc_known = true;
+            }
+            if (rec.iface_index >= num_ifaces_)
+            {
+                num_ifaces_ = std::uint8_t(rec.iface_index + 1U);
+            }
+            num_records_++;
+            end_offset_ += sizeof(BusLogRecordHeader) + rec.data_len;
+        }
+    }
+
+public:
+    /**
+     * @throws uavcan_linux::Exception.
+     */
+    explicit BusLogReader(const std::string& path)
+    {
+        const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            throw Exception("Failed to open the bus log file " + path);
+        }
+        struct ::stat st;
+        if ((::fstat(fd, &st) < 0) || (std::size_t(st.st_size) < sizeof(BusLogFileHeader)))
+        {
+            (void)::close(fd);
+            throw Exception("Invalid bus log file " + path, EINVAL);
+        }
+        map_size_ = std::size_t(st.st_size);
+        void* const map = ::mmap(nullptr, map_size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        (void)::close(fd);                  // The mapping stays valid
+        if (map == MAP_FAILED)
+        {
+            throw Exception("Failed to map the bus log file " + path);
+        }
+        map_ = static_cast<const std::uint8_t*>(map);
+        (void)::madvise(const_cast<std::uint8_t*>(map_), map_size_, MADV_SEQUENTIAL);
+
+        BusLogFileHeader hdr;
+        std::memcpy(&hdr, map_, sizeof(hdr));
+        if ((std::memcmp(hdr.magic, BusLogMagic, sizeof(hdr.magic)) != 0) ||
+            (hdr.version != BusLogFileHeader::CurrentVersion) ||
+            (hdr.record_header_size != sizeof(BusLogRecordHeader)))
+        {
+            (void)::munmap(const_cast<std::uint8_t*>(map_), map_size_);
+            throw Exception("Unsupported bus log file " + path, EINVAL);
+        }
+        scan();
+    }
+
+    ~BusLogReader()
+    {
+        (void)::munmap(const_cast<std::uint8_t*>(map_), map_size_);
+    }
+
+    BusLogReader(const BusLogReader&) = delete;
+    BusLogReader& operator=(const BusLogReader&) = delete;
+
+    /**
+     * Reads the next record. Returns false at the end of the log.
+     * The interface index of the frame is restored as well.
+     */
+    bool next(uavcan::CanRxFrame& out_frame, uavcan::CanIOFlags& out_flags)
+    {
+        BusLogRecordHeader rec;
+        if ((offset_ >= end_offset_) || !readAt(offset_, rec))
+        {
+            return false;
+        }
+        out_frame = uavcan::CanRxFrame();
+        out_frame.id = rec.can_id;
+        out_frame.dlc = rec.data_len;
+        std::memcpy(out_frame.data, map_ + offset_ + sizeof(rec), rec.data_len);
+        out_frame.ts_mono = uavcan::MonotonicTime::fromUSec(rec.ts_mono_usec);
+        out_frame.ts_utc = uavcan::UtcTime::fromUSec(rec.ts_utc_usec);
+        out_frame.iface_index = rec.iface_index;
+        out_flags = (rec.flags & BusLogRecordHeader::FlagLoopback) ? uavcan::CanIOFlagLoopback : 0;
+        offset_ += sizeof(rec) + rec.data_len;
+        return true;
+    }
+
+    void rewind() { offset_ = sizeof(BusLogFileHeader); }
+
+    std::uint64_t getNumRecords() const { return num_records_; }
+
+    /**
+     * Number of interfaces the frames were received from, i.e. the highest interface index plus one.
+     */
+    std::uint8_t getNumIfaces() const { return num_ifaces_; }
+
+    uavcan::MonotonicTime getFirstTimestamp() const { return first_ts_mono_; }
+    uavcan::MonotonicTime getLastTimestamp() const { return last_ts_mono_; }
+
+    /**
+     * Difference between the UTC and the monotonic timestamps of the first record that has UTC timestamp.
+     */
+    uavcan::UtcDuration getUtcOffset() const { return utc_offset_; }
+};
+
+/**
+ * Replays a bus log into a node, which must be constructed with the player as its CAN driver and its clock.
+ * This way the complete receive pipeline of the library can be exercised offline.
+ *
+ * The clock of the node follows the timestamps of the log: either in real time multiplied by the speed factor,
+ * or, if the speed factor is zero, as fast as possible, in which case the clock jumps forward to the next frame
+ * or to the blocking deadline of the node, whichever comes first. The frames are delivered with their original
+ * timestamps. Loopback frames are skipped; frames transmitted by the node are discarded.
+ *
+ *     uavcan_linux::BusLogReader reader("bus.log");
+ *     uavcan_linux::BusLogPlayer player(reader, 0);         // Max speed
+ *     uavcan::Node<16384> node(player, player);
+ *     ...
+ *     while (!player.isFinished())
+ *     {
+ *         (void)node.spin(uavcan::MonotonicDuration::fromMSec(100));
+ *     }
+ */
+class BusLogPlayer : public uavcan::ICanDriver
+                   , public uavcan::ISystemClock
+{
+    class Iface : public uavcan::ICanIface
+    {
+        BusLogPlayer& owner_;
+        const std::uint8_t index_;
+
+    public:
+        Iface(BusLogPlayer& owner, std::uint8_t index)
+            : owner_(owner)
+            , index_(index)
+        { }
+
+        std::int16_t send(const uavcan::CanFrame&, uavcan::MonotonicTime, uavcan::CanIOFlags) override
+        {
+            owner_.num_discarded_tx_frames_++;
+            return 1;
+        }
+
+        std::int16_t receive(uavcan::CanFrame& out_frame, uavcan::MonotonicTime& out_ts_monotonic,
+                             uavcan::UtcTime& out_ts_utc, uavcan::CanIOFlags& out_flags) override
+        {
+            if (!owner_.isPendingFrameDue(index_))
+            {
+                return 0;
+            }
+            out_frame = owner_.pending_frame_;
+            out_ts_monotonic = owner_.pending_frame_.ts_mono;
+            out_ts_utc = owner_.pending_frame_.ts_utc;
+            out_flags = 0;
+            owner_.num_replayed_frames_++;
+            owner_.fetchNextFrame();
+            return 1;
+        }
+
+        std::int16_t configureFilters(const uavcan::CanFilterConfig*, std::uint16_t) override { return 0; }
+        std::uint16_t getNumFilters() const override { return 0; }
+        std::uint64_t getErrorCount() const override { return 0; }
+    };
+
+    BusLogReader& reader_;
+    const double speed_;
+    std::vector<std::unique_ptr<Iface>> ifaces_;
+
+    uavcan::CanRxFrame pending_frame_;
+    bool has_pending_frame_ = false;
+    std::uint64_t num_replayed_frames_ = 0;
+    std::uint64_t num_discarded_tx_frames_ = 0;
+
+    // Max speed mode: the current time. Otherwise: the log time that corresponds to the real time origin.
+    std::uint64_t time_usec_ = 0;
+    std::chrono::steady_clock::time_point real_time_origin_;
+
+    void fetchNextFrame()
+    {
+        uavcan::CanIOFlags flags = 0;
+        do
+        {
+            has_pending_frame_ = reader_.next(pending_frame_, flags);
+        }
+        while (has_pending_frame_ && (flags & uavcan::CanIOFlagLoopback));
+    }
+
+    bool isPendingFrameDue(std::uint8_t iface_index) const
+    {
+        return has_pending_frame_ && (pending_frame_.iface_index == iface_index) &&
+               (pending_frame_.ts_mono <= getMonotonic());
+    }
+
+    /**
+     * Moves the clock forward (max speed mode) or sleeps (real time mode) until the specified log time.
+     */
+    void waitUntil(uavcan::MonotonicTime time)
+    {
+        if (isMaxSpeed())
+        {
+            time_usec_ = std::max(time_usec_, time.toUSec());
+        }
+        else
+        {
+            const auto real_offset = std::chrono::microseconds(
+                std::int64_t(double(std::int64_t(time.toUSec() - time_usec_)) / speed_));
+            std::this_thread::sleep_until(real_time_origin_ + real_offset);
+        }
+    }
+
+public:
+    /**
+     * @param speed     Speed factor: 1 for real time, 2 for twice as fast, etc; zero for max speed.
+     * @throws uavcan_linux::Exception.
+     */
+    BusLogPlayer(BusLogReader& reader, double speed)
+        : reader_(reader)
+        , speed_((speed > 0) ? speed : 0)
+    {
+        if (reader_.getNumRecords() == 0)
+        {
+            throw Exception("Bus log is empty", EINVAL);
+        }
+        for (std::uint8_t i = 0; i < reader_.getNumIfaces(); i++)
+        {
+            ifaces_.emplace_back(new Iface(*this, i));
+        }
+        rewind();
+    }
+
+    /**
+     * Restarts the replay from the beginning of the log. The clock is reset to the first timestamp.
+     */
+    void rewind()
+    {
+        reader_.rewind();
+        fetchNextFrame();
+        time_usec_ = reader_.getFirstTimestamp().toUSec();
+        real_time_origin_ = std::chrono::steady_clock::now();
+    }
+
+    bool isMaxSpeed() const { return speed_ <= 0; }
+
+    /**
+     * True when all frames have been delivered to the node.
+     */
+    bool isFinished() const { return !has_pending_frame_; }
+
+    std::uint64_t getNumReplayedFrames() const { return num_replayed_frames_; }
+    std::uint64_t getNumDiscardedTxFrames() const { return num_discarded_tx_frames_; }
+
+    uavcan::ICanIface* getIface(std::uint8_t iface_index) override
+    {
+        return (iface_index < ifaces_.size()) ? ifaces_[iface_index].get() : nullptr;
+    }
+
+    std::uint8_t getNumIfaces() const override { return std::uint8_t(ifaces_.size()); }
+
+    std::int16_t select(uavcan::CanSelectMasks& inout_masks,
+                        const uavcan::CanFrame* (&)[uavcan::MaxCanIfaces],
+                        const uavcan::MonotonicTime blocking_deadline) override
+    {
+        const uavcan::CanSelectMasks requested = inout_masks;
+        while (true)
+        {
+            inout_masks = uavcan::CanSelectMasks();
+            inout_masks.write = requested.write;                // TX is always possible
+            if (has_pending_frame_ && isPendingFrameDue(pending_frame_.iface_index))
+            {
+                inout_masks.read = std::uint8_t(requested.read & (1U << pending_frame_.iface_index));
+            }
+            if ((inout_masks.read != 0) || (inout_masks.write != 0))
+            {
+                break;
+            }
+
+            const uavcan::MonotonicTime now = getMonotonic();
+            if (now >= blocking_deadline)
+            {
+                break;
+            }
+            const bool next_frame_first = has_pending_frame_ && (pending_frame_.ts_mono > now) &&
+                                          (pending_frame_.ts_mono < blocking_deadline);
+            waitUntil(next_frame_first ? pending_frame_.ts_mono : blocking_deadline);
+        }
+
+        unsigned num_ready = 0;
+        for (unsigned i = 0; i < ifaces_.size(); i++)
+        {
+            const std::uint8_t mask = std::uint8_t(1U << i);
+            if ((inout_masks.read & mask) || (inout_masks.write & mask))
+            {
+                num_ready++;
+            }
+        }
+        return std::int16_t(num_ready);
+    }
+
+    uavcan::MonotonicTime getMonotonic() const override
+    {
+        if (isMaxSpeed())
+        {
+            return uavcan::MonotonicTime::fromUSec(time_usec_);
+        }
+        const auto real_elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - real_time_origin_);
+        return uavcan::MonotonicTime::fromUSec(time_usec_ + std::uint64_t(double(real_elapsed.count()) * speed_));
+    }
+
+    uavcan::UtcTime getUtc() const override
+    {
+        return uavcan::UtcTime::fromUSec(getMonotonic().toUSec()) + reader_.getUtcOffset();
+    }
+
+    /**
+     * The UTC time follows the log, it can't be adjusted.
+     */
+    void adjustUtc(uavcan::UtcDuration) override { }
+};
+
+}
@@ -0,0 +1,289 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include <uavcan/driver/can.hpp>
+#include <uavcan/transport/dispatcher.hpp>
+#include <uavcan/transport/frame.hpp>
+
+namespace uavcan_linux
+{
+/**
+ * Computes the exact number of bits the frame occupies on the bus, including the stuff bits, the end of frame
+ * and the interframe space. The stuffed part of the frame (SOF through CRC) is reconstructed bit by bit, the
+ * CRC-15 included, so the result reflects the actual contents of the frame rather than the worst case.
+ *
+ * CAN FD frames are estimated with the worst case classic stuffing rule instead, ignoring the bit rate switch,
+ * since the FD stuffing and CRC rules are different; the result is therefore an upper bound for them.
+ */
+inline unsigned computeCanFrameLengthBits(const uavcan::CanFrame& frame)
+{
+    // CRC delimiter, ACK slot, ACK delimiter, EOF, intermission
+    constexpr unsigned TrailerBits = 1U + 1U + 1U + 7U + 3U;
+
+    const unsigned data_len = frame.isRemoteTransmissionRequest() ? 0U : frame.dlc;
+
+    if (frame.isCanFD())
+    {
+        const unsigned stuffable_bits = (frame.isExtended() ? 54U : 34U) + 8U * data_len;
+        return stuffable_bits + (stuffable_bits - 1U) / 4U + TrailerBits;
+    }
+
+    class BitStream
+    {
+        std::uint16_t crc_ = 0;
+        unsigned num_bits_ = 0;
+        unsigned run_length_ = 0;
+        bool last_bit_ = false;
+
+        void emit(bool bit)
+        {
+            if ((num_bits_ > 0) && (bit == last_bit_))
+            {
+                run_length_++;
+            }
+            else
+            {
+                run_length_ = 1;
+                last_bit_ = bit;
+            }
+            num_bits_++;
+            if (run_length_ == 5)
+            {
+                // The stuff bit becomes the first bit of the next run
+                last_bit_ = !last_bit_;
+                run_length_ = 1;
+                num_bits_++;
+            }
+        }
+
+    public:
+        void pushWithCrc(std::uint32_t value, unsigned width)
+        {
+            while (width --> 0)
+            {
+                const bool bit = ((value >> width) & 1U) != 0;
+                const bool crc_msb = ((crc_ >> 14) & 1U) != 0;
+                crc_ = std::uint16_t((crc_ << 1) & 0x7FFFU);
+                if (bit != crc_msb)
+                {
+                    crc_ ^= 0x4599U;
+                }
+                emit(bit);
+            }
+        }
+
+        void pushCrc()
+        {
+            const std::uint16_t crc = crc_;
+            for (unsigned i = 15; i --> 0;)
+            {
+                emit(((crc >> i) & 1U) != 0);
+            }
+        }
+
+        unsigned getNumBits() const { return num_bits_; }
+    };
+
+    BitStream bs;
+    const std::uint32_t rtr = frame.isRemoteTransmissionRequest() ? 1U : 0U;
+    bs.pushWithCrc(0, 1);                                                       // SOF
+    if (frame.isExtended())
+    {
+        const std::uint32_t id = frame.id & uavcan::CanFrame::MaskExtID;
+        bs.pushWithCrc(id >> 18, 11);
+        bs.pushWithCrc(3, 2);                                                   // SRR, IDE
+        bs.pushWithCrc(id & 0x3FFFFU, 18);
+        bs.pushWithCrc(rtr << 2, 3);                                            // RTR, r1, r0
+    }
+    else
+    {
+        bs.pushWithCrc(frame.id & uavcan::CanFrame::MaskStdID, 11);
+        bs.pushWithCrc(rtr << 2, 3);                                            // RTR, IDE, r0
+    }
+    bs.pushWithCrc(frame.dlc, 4);
+    for (unsigned i = 0; i < data_len; i++)
+    {
+        bs.pushWithCrc(frame.data[i], 8);
+    }
+    bs.pushCrc();
+
+    return bs.getNumBits() + TrailerBits;
+}
+
+/**
+ * Counts the received frames, bytes, and bus time per interface, per source node, and per data type.
+ * Install it into the dispatcher with installRxFrameListener(). Loopback frames are ignored.
+ *
+ * The counters are cumulative; the rates are computed by @ref sample(), which should be called periodically,
+ * e.g. from the same timer that renders the statistics. All rates refer to the interval between the last two
+ * calls of @ref sample().
+ */
+class BusStatistics : public uavcan::IRxFrameListener
+{
+public:
+    struct Counters
+    {
+        std::uint64_t frames = 0;
+        std::uint64_t bytes = 0;        ///< Payload of the CAN frames, including the tail bytes
+        std::uint64_t bits = 0;         ///< Bus time, see @ref computeCanFrameLengthBits()
+
+        void add(const uavcan::CanFrame& frame, unsigned length_bits)
+        {
+            frames++;
+            bytes += frame.dlc;
+            bits += length_bits;
+        }
+    };
+
+    struct Rates
+    {
+        double frames_per_sec = 0;
+        double bytes_per_sec = 0;
+        double bits_per_sec = 0;
+    };
+
+    /**
+     * Key of a data type: the data type ID and the transfer type, as returned by @ref makeDataTypeKey().
+     */
+    typedef std::uint32_t DataTypeKey;
+
+    static DataTypeKey makeDataTypeKey(uavcan::TransferType transfer_type, uavcan::DataTypeID dtid)
+    {
+        return (DataTypeKey(transfer_type) << 16) | dtid.get();
+    }
+    static uavcan::TransferType getTransferType(DataTypeKey key) { return uavcan::TransferType(key >> 16); }
+    static uavcan::DataTypeID getDataTypeID(DataTypeKey key) { return std::uint16_t(key & 0xFFFFU); }
+
+private:
+    struct Entry
+    {
+        Counters total;
+        Counters last_sample;
+        Rates rates;
+
+        void sample(double interval_sec)
+        {
+            if (interval_sec > 0)
+            {
+                rates.frames_per_sec = double(total.frames - last_sample.frames) / interval_sec;
+                rates.bytes_per_sec  = double(total.bytes  - last_sample.bytes)  / interval_sec;
+                rates.bits_per_sec   = double(total.bits   - last_sample.bits)   / interval_sec;
+            }
+            last_sample = total;
+        }
+    };
+
+    const std::uint32_t bitrate_;
+    std::vector<Entry> ifaces_;
+    Entry nodes_[uavcan::NodeID::Max + 1];          ///< Index zero is used for anonymous frames
+    std::unordered_map<DataTypeKey, Entry> data_types_;
+    Entry invalid_;                                 ///< Frames that cannot be UAVCAN frames
+    uavcan::MonotonicTime last_sample_ts_;
+
+    void handleRxFrame(const uavcan::CanRxFrame& frame, uavcan::CanIOFlags flags) override
+    {
+        if (flags & uavcan::CanIOFlagLoopback)
+        {
+            return;
+        }
+
+        const unsigned length_bits = computeCanFrameLengthBits(frame);
+
+        if (frame.iface_index >= ifaces_.size())
+        {
+            ifaces_.resize(frame.iface_index + 1U);
+        }
+        ifaces_[frame.iface_index].total.add(frame, length_bits);
+
+        uavcan::TransferType transfer_type = uavcan::TransferTypeMessageBroadcast;
+        uavcan::DataTypeID dtid;
+        uavcan::NodeID dst_node_id;
+        if ((frame.dlc > 0) && uavcan::Frame::parseAddressing(frame, transfer_type, dtid, dst_node_id))
+        {
+            nodes_[frame.id & uavcan::NodeID::Max].total.add(frame, length_bits);
+            data_types_[makeDataTypeKey(transfer_type, dtid)].total.add(frame, length_bits);
+        }
+        else
+        {
+            invalid_.total.add(frame, length_bits);
+        }
+    }
+
+public:
+    /**
+     * @param bitrate   Bus bit rate, used to compute the utilization; the interfaces are assumed to share it.
+     */
+    explicit BusStatistics(std::uint32_t bitrate = 1000000)
+        : bitrate_(bitrate)
+    { }
+
+    /**
+     * Updates the rates. The first call only sets the reference point.
+     */
+    void sample(uavcan::MonotonicTime ts)
+    {
+        const double interval_sec = last_sample_ts_.isZero() ? 0.0 : (ts - last_sample_ts_).toUSec() * 1e-6;
+        last_sample_ts_ = ts;
+
+        for (auto& x : ifaces_)
+        {
+            x.sample(interval_sec);
+        }
+        for (auto& x : nodes_)
+        {
+            x.sample(interval_sec);
+        }
+        for (auto& x : data_types_)
+        {
+            x.second.sample(interval_sec);
+        }
+        invalid_.sample(interval_sec);
+    }
+
+    std::uint32_t getBitrate() const { return bitrate_; }
+
+    unsigned getNumIfaces() const { return unsigned(ifaces_.size()); }
+    const Counters& getIfaceCounters(unsigned iface_index) const { return ifaces_.at(iface_index).total; }
+    const Rates& getIfaceRates(unsigned iface_index) const { return ifaces_.at(iface_index).rates; }
+
+    /**
+     * Bus utilization in the range [0, 1] over the last sampling interval.
+     */
+    double getIfaceUtilization(unsigned iface_index) const
+    {
+        return std::min(1.0, getIfaceRates(iface_index).bits_per_sec / double(bitrate_));
+    }
+
+    /**
+     * Use the broadcast node ID (zero) to access the anonymous frames.
+     */
+    const Counters& getNodeCounters(uavcan::NodeID nid) const { return nodes_[nid.get()].total; }
+    const Rates& getNodeRates(uavcan::NodeID nid) const { return nodes_[nid.get()].rates; }
+
+    const Counters& getInvalidFrameCounters() const { return invalid_.total; }
+    const Rates& getInvalidFrameRates() const { return invalid_.rates; }
+
+    /**
+     * Calls the operator for every data type that was seen on the bus, in no particular order.
+     * Operator signature:
+     *   void (DataTypeKey, const Counters&, const Rates&)
+     */
+    template <typename Operator>
+    void forEachDataType(Operator op) const
+    {
+        for (const auto& x : data_types_)
+        {
+            op(x.first, x.second.total, x.second.rates);
+        }
+    }
+};
+
+}
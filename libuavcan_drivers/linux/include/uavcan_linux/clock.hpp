@@ -5,14 +5,22 @@
 #pragma once
 
 #include <cassert>
+#include <cmath>
 #include <ctime>
 #include <cstdint>
+#include <algorithm>
 
 #include <unistd.h>
 #include <sys/time.h>
+#include <sys/timex.h>
 #include <sys/types.h>
+#if defined(__x86_64__) || defined(__i386__)
+# include <x86intrin.h>
+#endif
 
 #include <uavcan/driver/system_clock.hpp>
+#include <uavcan/driver/cycle_counter.hpp>
+#include <uavcan/protocol/time_sync_stats.hpp>
 #include <uavcan_linux/exception.hpp>
 
 namespace uavcan_linux
@@ -26,6 +34,28 @@ enum class ClockAdjustmentMode
     PerDriverPrivate ///< Adjust the clock only for the current driver instance
 };
 
+/**
+ * Parameters of the clock discipline loop, see @ref SystemClock::setDisciplineParams().
+ */
+struct ClockDisciplineParams
+{
+    /**
+     * Natural frequency of the loop, in Hz. The clock follows the reference with the time constant of roughly
+     * 1 / (2 * pi * bandwidth_hz) seconds; lower values filter out more timestamping noise, higher values track
+     * the reference more closely. It must be much lower than the rate of adjustments, i.e. the time sync rate.
+     * Zero disables the discipline: every adjustment is applied as is.
+     */
+    double bandwidth_hz;
+    double damping;                     ///< 0.707 yields the fastest response without overshoot
+    double max_frequency_correction_ppm;
+
+    ClockDisciplineParams()
+        : bandwidth_hz(0.0)
+        , damping(0.707)
+        , max_frequency_correction_ppm(500.0)   // Limit of adjtimex()
+    { }
+};
+
 /**
  * Linux system clock driver.
  * Requires librt.
@@ -38,8 +68,31 @@ class SystemClock : public uavcan::ISystemClock
     std::uint64_t step_adj_cnt_;
     std::uint64_t gradual_adj_cnt_;
 
+    ClockDisciplineParams discipline_params_;
+    uavcan::TimeSyncJitterStats offset_stats_;
+    uavcan::MonotonicTime prev_discipline_mono_;
+    double drift_ppm_;                      ///< Integral term of the loop
+    double freq_correction_ppm_;            ///< Total frequency correction currently applied
+    long base_system_freq_;                 ///< System-wide frequency offset before the discipline was engaged
+    bool base_system_freq_known_;
+
     static constexpr std::int64_t Int1e6   = 1000000;
     static constexpr std::uint64_t UInt1e6 = 1000000;
+    static constexpr double Pi = 3.14159265358979323846;
+    static constexpr double AdjtimexFreqScale = 65536.0;           ///< adjtimex() frequency units per PPM
+
+    /**
+     * Phase correction accumulated by the private frequency correction since the last discipline update.
+     */
+    uavcan::UtcDuration getPrivateFrequencyCorrection(uavcan::MonotonicTime mono) const
+    {
+        if (prev_discipline_mono_.isZero() || (freq_correction_ppm_ == 0.0))
+        {
+            return uavcan::UtcDuration();
+        }
+        const double elapsed_usec = double((mono - prev_discipline_mono_).toUSec());
+        return uavcan::UtcDuration::fromUSec(std::llround(elapsed_usec * freq_correction_ppm_ * 1e-6));
+    }
 
     bool performStepAdjustment(const uavcan::UtcDuration adjustment)
     {
@@ -65,6 +118,70 @@ class SystemClock : public uavcan::ISystemClock
         return adjtime(&tv, nullptr) == 0;
     }
 
+    bool applySystemFrequencyCorrection(double ppm)
+    {
+        if (!base_system_freq_known_)
+        {
+            auto tx = ::timex();
+            if (::adjtimex(&tx) < 0)
+            {
+                return false;
+            }
+            base_system_freq_ = tx.freq;
+            base_system_freq_known_ = true;
+        }
+        auto tx = ::timex();
+        tx.modes = ADJ_FREQUENCY;
+        tx.freq = base_system_freq_ + long(std::lround(ppm * AdjtimexFreqScale));
+        return ::adjtimex(&tx) >= 0;
+    }
+
+    /**
+     * PI controller; the phase error is corrected by adjusting the clock frequency, so that the clock never jumps.
+     * Proportional and integral gains are derived from the bandwidth as for a second order loop.
+     */
+    bool performDisciplinedAdjustment(const uavcan::UtcDuration adjustment)
+    {
+        const uavcan::MonotonicTime mono = getMonotonic();
+        const double dt = prev_discipline_mono_.isZero() ? 0.0 :
+                          double((mono - prev_discipline_mono_).toUSec()) * 1e-6;
+
+        const bool private_mode = adj_mode_ == ClockAdjustmentMode::PerDriverPrivate;
+        if (private_mode)
+        {
+            private_adj_ += getPrivateFrequencyCorrection(mono);   // Freezing the correction accumulated so far
+        }
+        prev_discipline_mono_ = mono;
+
+        if (adjustment.getAbs() >= gradual_adj_limit_)
+        {
+            freq_correction_ppm_ = drift_ppm_;      // The drift estimate remains valid after the step
+            if (private_mode)
+            {
+                step_adj_cnt_++;
+                private_adj_ += adjustment;
+            }
+            else if (!performStepAdjustment(adjustment))
+            {
+                return false;
+            }
+        }
+        else
+        {
+            const double error_usec = double(adjustment.toUSec());    // Error of 1 usec per second is 1 PPM
+            const double wn = 2.0 * Pi * discipline_params_.bandwidth_hz;
+            const double kp = 2.0 * discipline_params_.damping * wn;
+            const double ki = wn * wn;
+            const double limit = discipline_params_.max_frequency_correction_ppm;
+
+            drift_ppm_ = std::max(-limit, std::min(limit, drift_ppm_ + ki * error_usec * dt));
+            freq_correction_ppm_ = std::max(-limit, std::min(limit, drift_ppm_ + kp * error_usec));
+            gradual_adj_cnt_++;
+        }
+
+        return private_mode || applySystemFrequencyCorrection(freq_correction_ppm_);
+    }
+
 public:
     /**
      * By default, the clock adjustment mode will be selected automatically - global if root, private otherwise.
@@ -74,6 +191,10 @@ public:
         , adj_mode_(adj_mode)
         , step_adj_cnt_(0)
         , gradual_adj_cnt_(0)
+        , drift_ppm_(0.0)
+        , freq_correction_ppm_(0.0)
+        , base_system_freq_(0)
+        , base_system_freq_known_(false)
     { }
 
     /**
@@ -104,7 +225,7 @@ public:
         uavcan::UtcTime utc = uavcan::UtcTime::fromUSec(std::uint64_t(tv.tv_sec) * UInt1e6 + tv.tv_usec);
         if (adj_mode_ == ClockAdjustmentMode::PerDriverPrivate)
         {
-            utc += private_adj_;
+            utc += getPrivateAdjustment();
         }
         return utc;
     }
@@ -119,11 +240,27 @@ public:
      *  - Step adjustment using settimeofday(), if the phase error is above gradual adjustment limit.
      * The gradual adjustment limit can be configured at any time via the setter method.
      *
+     * If the clock discipline is enabled (see @ref setDisciplineParams()), the adjustments are fed into a PI
+     * controller that steers the frequency of the clock instead - adjtimex() in the system wide mode, or a private
+     * rate correction otherwise. This eliminates the sawtooth produced by periodic phase corrections and
+     * compensates the drift of the local oscillator. Phase errors above the gradual adjustment limit are still
+     * corrected with a step.
+     *
      * @throws uavcan_linux::Exception.
      */
     void adjustUtc(const uavcan::UtcDuration adjustment) override
     {
-        if (adj_mode_ == ClockAdjustmentMode::PerDriverPrivate)
+        offset_stats_.addSample(adjustment.toUSec());
+
+        if (discipline_params_.bandwidth_hz > 0.0)
+        {
+            assert(!gradual_adj_limit_.isNegative());
+            if (!performDisciplinedAdjustment(adjustment))
+            {
+                throw Exception("Clock adjustment failed");
+            }
+        }
+        else if (adj_mode_ == ClockAdjustmentMode::PerDriverPrivate)
         {
             private_adj_ += adjustment;
         }
@@ -165,11 +302,43 @@ public:
 
     ClockAdjustmentMode getAdjustmentMode() const { return adj_mode_; }
 
+    /**
+     * Enables, disables or reconfigures the clock discipline. It is disabled by default.
+     * The loop state is reset, and the frequency of the clock is restored.
+     */
+    void setDisciplineParams(const ClockDisciplineParams& params)
+    {
+        if (adj_mode_ == ClockAdjustmentMode::PerDriverPrivate)
+        {
+            private_adj_ = getPrivateAdjustment();
+        }
+        else if (base_system_freq_known_)
+        {
+            (void)applySystemFrequencyCorrection(0.0);
+        }
+        discipline_params_ = params;
+        discipline_params_.bandwidth_hz = std::max(0.0, params.bandwidth_hz);
+        discipline_params_.max_frequency_correction_ppm = std::max(0.0, params.max_frequency_correction_ppm);
+        prev_discipline_mono_ = uavcan::MonotonicTime();
+        drift_ppm_ = 0.0;
+        freq_correction_ppm_ = 0.0;
+    }
+
+    ClockDisciplineParams getDisciplineParams() const { return discipline_params_; }
+
     /**
      * This is only applicable if the selected clock adjustment mode is private.
      * In system wide mode this method will always return zero duration.
+     * With the clock discipline enabled, the value changes gradually as the frequency correction accumulates.
      */
-    uavcan::UtcDuration getPrivateAdjustment() const { return private_adj_; }
+    uavcan::UtcDuration getPrivateAdjustment() const
+    {
+        if (adj_mode_ != ClockAdjustmentMode::PerDriverPrivate)
+        {
+            return private_adj_;
+        }
+        return private_adj_ + getPrivateFrequencyCorrection(getMonotonic());
+    }
 
     /**
      * Statistics that allows to evaluate clock sync preformance.
@@ -181,6 +350,21 @@ public:
         return getStepAdjustmentCount() + getGradualAdjustmentCount();
     }
 
+    /**
+     * Statistics of the requested adjustments, i.e. of the phase error against the reference clock.
+     * Once the clock discipline has converged, the jitter of the offsets represents the synchronization accuracy.
+     */
+    const uavcan::TimeSyncJitterStats& getOffsetStats() const { return offset_stats_; }
+    void resetOffsetStats() { offset_stats_.reset(); }
+
+    /**
+     * Estimated frequency error of the local clock against the reference, and the frequency correction currently
+     * applied, which also includes the proportional term. Positive if the local clock is slow. Both are zero if the
+     * clock discipline is disabled.
+     */
+    double getDriftEstimatePPM() const { return drift_ppm_; }
+    double getFrequencyCorrectionPPM() const { return freq_correction_ppm_; }
+
     /**
      * This static method decides what is the optimal clock sync adjustment mode for the current configuration.
      * It selects system wide mode if the application is running as root; otherwise it prefers
@@ -192,5 +376,27 @@ public:
         return godmode ? ClockAdjustmentMode::SystemWide : ClockAdjustmentMode::PerDriverPrivate;
     }
 };
+/**
+ * Cycle counter for the execution time statistics, see uavcan::ICycleCounter.
+ * Uses the time stamp counter on x86, which runs at a constant rate on all modern CPUs, or the raw monotonic
+ * clock in nanoseconds elsewhere.
+ */
+class CycleCounter : public uavcan::ICycleCounter
+{
+public:
+    std::uint32_t getCycleCount() const override
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        return std::uint32_t(__rdtsc());
+#else
+        timespec ts;
+        if (clock_gettime(CLOCK_MONOTONIC_RAW, &ts) != 0)
+        {
+            return 0;
+        }
+        return std::uint32_t(std::uint64_t(ts.tv_sec) * 1000000000ULL + std::uint64_t(ts.tv_nsec));
+#endif
+    }
+};
 
 }
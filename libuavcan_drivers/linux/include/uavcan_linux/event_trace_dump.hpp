@@ -0,0 +1,214 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <uavcan/transport/event_trace.hpp>
+#include <uavcan/transport/perf_counter.hpp>
+#include <uavcan_linux/exception.hpp>
+
+namespace uavcan_linux
+{
+/**
+ * Layout of the event trace dump file. All fields are in the host byte order.
+ *
+ * The file begins with @ref EventTraceFileHeader, which is followed by the records of uavcan::TraceRecord as they
+ * are laid out in memory, oldest first. The same layout can be produced on an embedded target by writing out
+ * uavcan::EventTrace::getRecord() one by one, e.g. from a debugger script, as long as the byte order is the same.
+ */
+struct EventTraceFileHeader
+{
+    static constexpr std::uint32_t CurrentVersion = 1;
+
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t num_lost_records;         ///< Records that were overwritten before the dump was taken
+};
+
+static_assert(sizeof(EventTraceFileHeader) == 16, "Unexpected file header layout");
+static_assert(sizeof(uavcan::TraceRecord) == 12, "Unexpected trace record layout");
+
+static constexpr char EventTraceMagic[8] = { 'U', 'A', 'V', 'C', 'A', 'N', 'E', 'T' };
+
+/**
+ * Contents of a dump: the records, oldest first, and the number of records lost before them.
+ */
+struct EventTraceDump
+{
+    std::vector<uavcan::TraceRecord> records;
+    std::uint32_t num_lost_records = 0;
+};
+
+inline const char* getTraceEventName(std::uint8_t event)
+{
+    static const char* const Names[uavcan::NumTraceEvents] =
+    {
+        "FrameRx", "FrameTx", "TransferComplete", "CrcError", "OutOfMemory", "TxQueueDrop", "TimerFire"
+    };
+    return (event < uavcan::NumTraceEvents) ? Names[event] : "?";
+}
+
+/**
+ * Human-readable representation of the record, with the arguments decoded:
+ *   1234.567890 +0.000125 TransferComplete dtid=341 src=42 tid=7
+ * The interval is computed from the previous record, if any.
+ */
+inline std::string formatTraceRecord(const uavcan::TraceRecord& rec, const uavcan::TraceRecord* prev = nullptr)
+{
+    char buf[128];
+    const std::uint32_t interval_usec = (prev == nullptr) ? 0U : (rec.timestamp_usec - prev->timestamp_usec);
+    const int len = std::snprintf(buf, sizeof(buf), "%u.%06u +%u.%06u %-16s ",
+                                  unsigned(rec.timestamp_usec / 1000000U), unsigned(rec.timestamp_usec % 1000000U),
+                                  unsigned(interval_usec / 1000000U), unsigned(interval_usec % 1000000U),
+                                  getTraceEventName(rec.event));
+    const std::size_t offset = (len > 0) ? std::size_t(len) : 0U;
+    char* const args = buf + offset;
+    const std::size_t args_size = sizeof(buf) - offset;
+
+    switch (rec.event)
+    {
+    case uavcan::TraceEventFrameRx:
+    case uavcan::TraceEventFrameTx:
+    {
+        std::snprintf(args, args_size, "id=%08x dlc=%u iface=%u",
+                      unsigned(rec.arg32), unsigned(rec.arg16), unsigned(rec.arg8));
+        break;
+    }
+    case uavcan::TraceEventTransferComplete:
+    case uavcan::TraceEventCrcError:
+    {
+        std::snprintf(args, args_size, "dtid=%u src=%u tid=%u",
+                      unsigned(rec.arg16), unsigned(rec.arg8), unsigned(rec.arg32));
+        break;
+    }
+    case uavcan::TraceEventOutOfMemory:
+    {
+        std::snprintf(args, args_size, "id=%08x dtid=%u tag=%u",
+                      unsigned(rec.arg32), unsigned(rec.arg16), unsigned(rec.arg8));
+        break;
+    }
+    case uavcan::TraceEventTxQueueDrop:
+    {
+        std::snprintf(args, args_size, "id=%08x dlc=%u reason=%s", unsigned(rec.arg32), unsigned(rec.arg16),
+                      (rec.arg8 == uavcan::TraceDropExpired) ? "expired" : "no_memory");
+        break;
+    }
+    case uavcan::TraceEventTimerFire:
+    {
+        std::snprintf(args, args_size, "lateness=%uus", unsigned(rec.arg32));
+        break;
+    }
+    default:
+    {
+        std::snprintf(args, args_size, "%08x %04x %02x", unsigned(rec.arg32), unsigned(rec.arg16),
+                      unsigned(rec.arg8));
+        break;
+    }
+    }
+    return std::string(buf);
+}
+
+/**
+ * Prints one record per line.
+ */
+inline void printEventTrace(const EventTraceDump& dump, std::ostream& os)
+{
+    os << dump.records.size() << " records, " << dump.num_lost_records << " lost" << std::endl;
+    for (std::size_t i = 0; i < dump.records.size(); i++)
+    {
+        os << formatTraceRecord(dump.records[i], (i > 0) ? &dump.records[i - 1] : nullptr) << std::endl;
+    }
+}
+
+/**
+ * @throws uavcan_linux::Exception.
+ */
+inline EventTraceDump loadEventTrace(const std::string& path)
+{
+    std::FILE* const file = std::fopen(path.c_str(), "rb");
+    if (file == nullptr)
+    {
+        throw Exception("Failed to open the event trace file " + path);
+    }
+
+    EventTraceFileHeader header;
+    if ((std::fread(&header, sizeof(header), 1, file) != 1) ||
+        (std::memcmp(header.magic, EventTraceMagic, sizeof(EventTraceMagic)) != 0))
+    {
+        (void)std::fclose(file);
+        throw Exception("Invalid event trace file " + path, EINVAL);
+    }
+    if (header.version != EventTraceFileHeader::CurrentVersion)
+    {
+        (void)std::fclose(file);
+        throw Exception("Unsupported event trace file " + path, EINVAL);
+    }
+
+    EventTraceDump dump;
+    dump.num_lost_records = header.num_lost_records;
+    uavcan::TraceRecord rec;
+    while (std::fread(&rec, sizeof(rec), 1, file) == 1)
+    {
+        dump.records.push_back(rec);
+    }
+    (void)std::fclose(file);
+    return dump;
+}
+
+#if UAVCAN_EVENT_TRACE
+
+inline EventTraceDump makeEventTraceDump(const uavcan::EventTrace& trace)
+{
+    EventTraceDump dump;
+    dump.num_lost_records = trace.getNumLostRecords();
+    for (unsigned i = 0; i < trace.getNumRecords(); i++)
+    {
+        dump.records.push_back(trace.getRecord(i));
+    }
+    return dump;
+}
+
+/**
+ * Writes the current contents of the trace into a file that can be decoded with @ref loadEventTrace(), e.g.
+ * by the uavcan_trace_dump tool. The trace itself is not modified.
+ * @throws uavcan_linux::Exception.
+ */
+inline void saveEventTrace(const uavcan::EventTrace& trace, const std::string& path)
+{
+    const EventTraceDump dump = makeEventTraceDump(trace);
+
+    std::FILE* const file = std::fopen(path.c_str(), "wb");
+    if (file == nullptr)
+    {
+        throw Exception("Failed to create the event trace file " + path);
+    }
+
+    EventTraceFileHeader header;
+    std::memcpy(header.magic, EventTraceMagic, sizeof(EventTraceMagic));
+    header.version = EventTraceFileHeader::CurrentVersion;
+    header.num_lost_records = dump.num_lost_records;
+
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+    if (ok && !dump.records.empty())
+    {
+        ok = std::fwrite(dump.records.data(), sizeof(uavcan::TraceRecord), dump.records.size(), file) ==
+             dump.records.size();
+    }
+    ok = (std::fclose(file) == 0) && ok;
+    if (!ok)
+    {
+        throw Exception("Failed to write the event trace file " + path);
+    }
+}
+
+#endif
+
+}
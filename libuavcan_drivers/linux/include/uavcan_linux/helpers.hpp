@@ -12,12 +12,16 @@
 #include <sstream>
 #include <uavcan/uavcan.hpp>
 #include <uavcan/node/sub_node.hpp>
+#include <uavcan/transport/can_acceptance_filter_configurator.hpp>
+#include <uavcan_linux/stats_page.hpp>
 
 namespace uavcan_linux
 {
 /**
  * Default log sink will dump everything into stderr.
  * It is installed by default.
+ * It makes system calls for every message; nodes that receive a lot of log messages should use
+ * @ref BatchedLogSink instead.
  */
 class DefaultLogSink : public uavcan::ILogSink
 {
@@ -32,6 +36,7 @@ class DefaultLogSink : public uavcan::ILogSink
 /**
  * Wrapper over uavcan::ServiceClient<> for blocking calls.
  * Blocks on uavcan::Node::spin() internally until the call is complete.
+ * For many concurrent calls, consider @ref AsyncServiceClient instead.
  */
 template <typename DataType>
 class BlockingServiceClient : public uavcan::ServiceClient<DataType>
@@ -171,6 +176,8 @@ class NodeBase : public NodeType
 {
 protected:
     DriverPackPtr driver_pack_;
+    std::shared_ptr<StatsPage> stats_page_;
+    TimerPtr stats_page_timer_;
 
     static void enforce(int error, const std::string& msg)
     {
@@ -296,6 +303,84 @@ public:
         return p;
     }
 
+    /**
+     * Configures the acceptance filters of all ifaces from the current set of subscribers and servers,
+     * see @ref uavcan::CanAcceptanceFilterConfigurator. With SocketCAN, the filters are applied by the kernel,
+     * so the irrelevant frames never reach the process.
+     * Must be called again if new subscribers or servers are added later.
+     * To avoid merging of filters when the node has many subscriptions, increase
+     * UAVCAN_MAX_CAN_ACCEPTANCE_FILTERS.
+     * @throws uavcan_linux::Exception.
+     */
+    void configureAcceptanceFilters(uavcan::CanAcceptanceFilterConfigurator::AnonymousMessages mode =
+                                        uavcan::CanAcceptanceFilterConfigurator::AcceptAnonymousMessages)
+    {
+        enforce(uavcan::configureCanAcceptanceFilters(*this, mode), "Failed to configure acceptance filters");
+    }
+
+    /**
+     * These methods allow to run the node from an external event loop (asio, libuv, etc.) instead of spin(),
+     * so that no dedicated thread is needed:
+     *  - watch the descriptors returned by @ref getPollFds() for the requested events;
+     *  - call @ref processReady() once any of them becomes ready, or once @ref getNextDeadline() is reached;
+     *  - re-read both after every call, since the processing may change them.
+     * The CAN driver must implement @ref IPollableCanDriver, which is the case for the SocketCAN drivers.
+     * @throws uavcan_linux::Exception if the driver is not pollable.
+     */
+    std::vector<::pollfd> getPollFds() const
+    {
+        const auto pollable =
+            dynamic_cast<const IPollableCanDriver*>(&this->getDispatcher().getCanIOManager().getCanDriver());
+        if (pollable == nullptr)
+        {
+            throw Exception("CAN driver does not support external event loops");
+        }
+        return pollable->getPollFds();
+    }
+
+    uavcan::MonotonicTime getNextDeadline() const { return this->getScheduler().getNextWakeupTime(); }
+
+    /**
+     * Time left until @ref getNextDeadline(); zero if it is already due. Can be used as an event loop timeout.
+     */
+    uavcan::MonotonicDuration getTimeUntilNextDeadline() const
+    {
+        const uavcan::MonotonicTime ts = this->getScheduler().getMonotonicTime();
+        const uavcan::MonotonicTime deadline = getNextDeadline();
+        return (deadline > ts) ? (deadline - ts) : uavcan::MonotonicDuration();
+    }
+
+    /**
+     * Processes all pending IO and expired deadlines, never blocks. See @ref getPollFds().
+     * Returns negative error code.
+     */
+    int processReady() { return this->spinOnce(); }
+
+    /**
+     * Exposes the transport statistics of the node (transfer and iface counters, pool usage, TX queue depths)
+     * in the shared memory page of the given name, e.g. "/uavcan_stats_42", see @ref StatsPage.
+     * The page is updated with the specified period from the thread that spins the node, so the statistics
+     * can be read by external monitoring tools without any bus traffic or locks; the page is removed once
+     * the node is destroyed or @ref stopExportingStatsPage() is called.
+     * @throws uavcan_linux::Exception.
+     */
+    void exportStatsPage(const std::string& name,
+                         uavcan::MonotonicDuration period = uavcan::MonotonicDuration::fromMSec(1000))
+    {
+        stopExportingStatsPage();
+        stats_page_ = StatsPage::create(name);
+        stats_page_->write(collectStatsPageData(*this));
+        stats_page_timer_ = makeTimer(period, [this](const uavcan::TimerEvent&) {
+            stats_page_->write(collectStatsPageData(*this));
+        });
+    }
+
+    void stopExportingStatsPage()
+    {
+        stats_page_timer_.reset();
+        stats_page_.reset();
+    }
+
     const DriverPackPtr& getDriverPack() const { return driver_pack_; }
     DriverPackPtr& getDriverPack() { return driver_pack_; }
 };
@@ -0,0 +1,156 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#pragma once
+
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <uavcan/marshal/layout_decoder.hpp>
+#include <uavcan_linux/exception.hpp>
+
+namespace uavcan_linux
+{
+/**
+ * Layout database generated by the DSDL compiler (option --layout-database), loaded into memory.
+ */
+class LayoutDatabaseFile
+{
+    std::vector<std::uint8_t> data_;
+    uavcan::DataTypeLayoutDatabase database_;
+
+public:
+    /**
+     * @throws uavcan_linux::Exception.
+     */
+    explicit LayoutDatabaseFile(const std::string& path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+        {
+            throw Exception("Failed to open the layout database " + path);
+        }
+        data_.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        if (database_.init(data_.data(), unsigned(data_.size())) < 0)
+        {
+            throw Exception("Invalid layout database " + path, EINVAL);
+        }
+    }
+
+    LayoutDatabaseFile(const LayoutDatabaseFile&) = delete;
+    LayoutDatabaseFile& operator=(const LayoutDatabaseFile&) = delete;
+
+    const uavcan::DataTypeLayoutDatabase& getDatabase() const { return database_; }
+};
+
+/**
+ * Converts the output of @ref uavcan::LayoutDecoder into compact JSON, e.g.:
+ *   {"uptime_sec":1234,"health":0,"mode":0,"sub_mode":0,"vendor_specific_status_code":0}
+ * Unions are represented as objects with one member; non-finite floats are written as null.
+ */
+class JsonLayoutWriter : public uavcan::ILayoutVisitor
+{
+    std::string out_;
+    bool first_ = true;
+
+    void writeKey(const char* name)
+    {
+        if (!first_)
+        {
+            out_ += ',';
+        }
+        first_ = false;
+        if (name[0] != '\0')
+        {
+            out_ += '"';
+            out_ += name;           // DSDL identifiers don't need escaping
+            out_ += "\":";
+        }
+    }
+
+    void onBeginStruct(const char* name, bool) override
+    {
+        writeKey(name);
+        out_ += '{';
+        first_ = true;
+    }
+
+    void onEndStruct() override
+    {
+        out_ += '}';
+        first_ = false;
+    }
+
+    void onBeginArray(const char* name) override
+    {
+        writeKey(name);
+        out_ += '[';
+        first_ = true;
+    }
+
+    void onEndArray(unsigned) override
+    {
+        out_ += ']';
+        first_ = false;
+    }
+
+    void onUnsigned(const char* name, std::uint64_t value) override
+    {
+        writeKey(name);
+        out_ += std::to_string(value);
+    }
+
+    void onSigned(const char* name, std::int64_t value) override
+    {
+        writeKey(name);
+        out_ += std::to_string(value);
+    }
+
+    void onFloat(const char* name, double value, unsigned bitlen) override
+    {
+        writeKey(name);
+        if (!std::isfinite(value))
+        {
+            out_ += "null";
+            return;
+        }
+        // Enough significant digits to restore the value of the given precision
+        const int precision = (bitlen > 32) ? 17 : ((bitlen > 16) ? 9 : 5);
+        char buf[32];
+        (void)std::snprintf(buf, sizeof(buf), "%.*g", precision, value);
+        out_ += buf;
+    }
+
+    void onBool(const char* name, bool value) override
+    {
+        writeKey(name);
+        out_ += value ? "true" : "false";
+    }
+
+public:
+    const std::string& getJson() const { return out_; }
+
+    /**
+     * Decodes the payload into JSON.
+     * @return Same as @ref uavcan::LayoutDecoder::decode().
+     */
+    static int decode(const uavcan::DataTypeLayout& layout, uavcan::TransferType transfer_type,
+                      const std::vector<std::uint8_t>& payload, std::string& out_json)
+    {
+        JsonLayoutWriter writer;
+        const int res = uavcan::LayoutDecoder::decode(layout, transfer_type, payload.data(),
+                                                      unsigned(payload.size()), writer);
+        out_json = std::move(writer.out_);
+        return res;
+    }
+};
+
+}
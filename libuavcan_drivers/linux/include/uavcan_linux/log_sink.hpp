@@ -0,0 +1,397 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#pragma once
+
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <uavcan/protocol/logger.hpp>
+#include <uavcan_linux/exception.hpp>
+
+namespace uavcan_linux
+{
+/**
+ * Parameters of @ref BatchedLogSink.
+ */
+struct BatchedLogSinkParams
+{
+    /**
+     * Output file; empty means stderr. The file is opened in append mode.
+     */
+    std::string path;
+
+    /**
+     * Number of preallocated message slots. The messages that don't fit are dropped and counted.
+     */
+    unsigned queue_capacity = 256;
+
+    /**
+     * Maximum time a message can wait in the queue before it is written. The writer thread also wakes up
+     * as soon as the queue is half full.
+     */
+    std::chrono::milliseconds flush_interval = std::chrono::milliseconds(100);
+
+    /**
+     * Token bucket rate limiter; zero disables rate limiting.
+     * The bucket is initially full; it holds up to rate_limit_burst messages.
+     */
+    unsigned rate_limit_per_sec = 0;
+    unsigned rate_limit_burst = 100;
+
+    /**
+     * When the file grows over this size, it is renamed to path.1, the older files are shifted up to
+     * path.<num_rotated_files>, and a new file is started. Zero disables rotation; ignored for stderr.
+     */
+    std::uint64_t max_file_size = 0;
+    unsigned num_rotated_files = 3;
+};
+
+/**
+ * Counters of @ref BatchedLogSink.
+ */
+struct BatchedLogSinkStats
+{
+    std::uint64_t num_written = 0;
+    std::uint64_t num_dropped_overflow = 0;         ///< The queue was full
+    std::uint64_t num_dropped_rate_limit = 0;       ///< The rate limiter has rejected the message
+    std::uint64_t num_batches = 0;                  ///< Number of writev() calls
+    std::uint64_t num_write_errors = 0;
+    std::uint64_t num_rotations = 0;
+};
+
+/**
+ * High-throughput alternative to @ref DefaultLogSink.
+ *
+ * The log() method only formats the message into a preallocated slot, which takes a mutex but no system calls;
+ * a background thread writes the accumulated slots in batches with writev(), one slot per iovec, without
+ * flushing after every message. If any messages were dropped since the last batch, the writer adds a line
+ * with the number of dropped messages.
+ *
+ * The pending messages are written out by @ref flush() and by the destructor.
+ * Usage with the node wrapper:
+ *   uavcan_linux::BatchedLogSink sink(params);
+ *   node->getLogger().setExternalSink(&sink);
+ */
+class BatchedLogSink : public uavcan::ILogSink
+{
+    static constexpr unsigned SlotSize = 192;       ///< Enough for the longest source and text
+
+    struct Slot
+    {
+        char data[SlotSize];
+        unsigned length;
+    };
+
+    const BatchedLogSinkParams params_;
+    int fd_;
+    std::uint64_t file_size_;
+
+    std::vector<Slot> slots_;
+    unsigned head_;             ///< Index of the oldest pending slot
+    unsigned size_;             ///< Number of pending slots, including the ones being written now
+
+    double bucket_tokens_;
+    std::chrono::steady_clock::time_point bucket_timestamp_;
+
+    std::uint64_t num_unreported_drops_;
+    BatchedLogSinkStats stats_;
+    bool flush_requested_;
+    bool stop_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable writer_cond_;
+    std::condition_variable flushed_cond_;
+    std::thread writer_;
+
+    static int openFile(const std::string& path)
+    {
+        if (path.empty())
+        {
+            return -1;
+        }
+        const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd < 0)
+        {
+            throw Exception("Failed to open the log file " + path);
+        }
+        return fd;
+    }
+
+    static std::uint64_t getFileSize(int fd)
+    {
+        struct ::stat st;
+        std::memset(&st, 0, sizeof(st));
+        return (::fstat(fd, &st) == 0) ? std::uint64_t(st.st_size) : 0U;
+    }
+
+    static const char* getLevelName(LogLevel level)
+    {
+        static const char* const Names[] = { "DEBUG", "INFO ", "WARN ", "ERROR" };
+        return (level < (sizeof(Names) / sizeof(Names[0]))) ? Names[level] : "?????";
+    }
+
+    bool tryConsumeToken()
+    {
+        if (params_.rate_limit_per_sec == 0)
+        {
+            return true;
+        }
+        const auto ts = std::chrono::steady_clock::now();
+        const double dt = std::chrono::duration<double>(ts - bucket_timestamp_).count();
+        bucket_timestamp_ = ts;
+        bucket_tokens_ += dt * params_.rate_limit_per_sec;
+        if (bucket_tokens_ > params_.rate_limit_burst)
+        {
+            bucket_tokens_ = params_.rate_limit_burst;
+        }
+        if (bucket_tokens_ < 1.0)
+        {
+            return false;
+        }
+        bucket_tokens_ -= 1.0;
+        return true;
+    }
+
+    unsigned getWakeUpThreshold() const { return unsigned((slots_.size() + 1U) / 2U); }
+
+    static unsigned clampLength(int len)
+    {
+        return (len < 0) ? 0U : ((unsigned(len) >= SlotSize) ? (SlotSize - 1U) : unsigned(len));
+    }
+
+    /**
+     * Called with the mutex locked.
+     */
+    void format(Slot& slot, const uavcan::protocol::debug::LogMessage& message) const
+    {
+        ::timespec ts = ::timespec();
+        (void)::clock_gettime(CLOCK_REALTIME, &ts);
+        ::tm tm = ::tm();
+        (void)::gmtime_r(&ts.tv_sec, &tm);
+
+        const int len = std::snprintf(slot.data, SlotSize, "%04d-%02d-%02d %02d:%02d:%02d.%06ld %s %.*s: %.*s",
+                                      tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
+                                      tm.tm_hour, tm.tm_min, tm.tm_sec, long(ts.tv_nsec / 1000),
+                                      getLevelName(message.level.value),
+                                      int(message.source.size()),
+                                      reinterpret_cast<const char*>(message.source.begin()),
+                                      int(message.text.size()),
+                                      reinterpret_cast<const char*>(message.text.begin()));
+        slot.length = clampLength(len);
+        slot.data[slot.length++] = '\n';
+    }
+
+    void rotate()
+    {
+        (void)::close(fd_);
+        for (unsigned i = params_.num_rotated_files; i > 1; i--)
+        {
+            const std::string older = params_.path + "." + std::to_string(i);
+            const std::string newer = params_.path + "." + std::to_string(i - 1);
+            (void)std::rename(newer.c_str(), older.c_str());
+        }
+        if (params_.num_rotated_files > 0)
+        {
+            (void)std::rename(params_.path.c_str(), (params_.path + ".1").c_str());
+        }
+        else
+        {
+            (void)::unlink(params_.path.c_str());
+        }
+        fd_ = ::open(params_.path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        file_size_ = 0;
+    }
+
+    void writeBatch(unsigned first, unsigned count, std::uint64_t num_drops)
+    {
+        char drop_notice[64];
+        ::iovec iov[IOV_MAX];
+        unsigned num_iov = 0;
+
+        if (num_drops > 0)
+        {
+            const int len = std::snprintf(drop_notice, sizeof(drop_notice), "### %llu log messages dropped\n",
+                                          static_cast<unsigned long long>(num_drops));
+            iov[num_iov].iov_base = drop_notice;
+            iov[num_iov].iov_len = clampLength(len);
+            num_iov++;
+        }
+
+        std::uint64_t bytes = 0;
+        for (unsigned i = 0; i < count; i++)
+        {
+            Slot& slot = slots_[(first + i) % slots_.size()];
+            iov[num_iov].iov_base = slot.data;
+            iov[num_iov].iov_len = slot.length;
+            num_iov++;
+        }
+        for (unsigned i = 0; i < num_iov; i++)
+        {
+            bytes += iov[i].iov_len;
+        }
+
+        const int fd = (fd_ >= 0) ? fd_ : STDERR_FILENO;
+        const ::ssize_t res = ::writev(fd, iov, int(num_iov));
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.num_batches++;
+        if (res < 0 || std::uint64_t(res) < bytes)
+        {
+            stats_.num_write_errors++;
+        }
+        else
+        {
+            stats_.num_written += count;
+        }
+        file_size_ += (res > 0) ? std::uint64_t(res) : 0U;
+    }
+
+    void writerThread()
+    {
+        // One iovec is reserved for the drop notice
+        const unsigned max_batch = unsigned(IOV_MAX) - 1U;
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true)
+        {
+            (void)writer_cond_.wait_for(lock, params_.flush_interval, [this]() {
+                return stop_ || flush_requested_ || (size_ >= getWakeUpThreshold());
+            });
+            flush_requested_ = false;
+
+            if (size_ == 0 && num_unreported_drops_ == 0)
+            {
+                flushed_cond_.notify_all();
+                if (stop_)
+                {
+                    break;
+                }
+                continue;
+            }
+
+            const unsigned first = head_;
+            const unsigned count = (size_ < max_batch) ? size_ : max_batch;
+            const std::uint64_t num_drops = num_unreported_drops_;
+            num_unreported_drops_ = 0;
+
+            lock.unlock();
+            writeBatch(first, count, num_drops);
+            lock.lock();
+
+            head_ = unsigned((head_ + count) % slots_.size());
+            size_ -= count;
+            if (size_ == 0)
+            {
+                flushed_cond_.notify_all();
+            }
+
+            if ((fd_ >= 0) && (params_.max_file_size > 0) && (file_size_ >= params_.max_file_size))
+            {
+                rotate();
+                stats_.num_rotations++;
+            }
+        }
+    }
+
+public:
+    /**
+     * @throws uavcan_linux::Exception if the file could not be opened.
+     */
+    explicit BatchedLogSink(const BatchedLogSinkParams& params = BatchedLogSinkParams())
+        : params_(params)
+        , fd_(openFile(params.path))
+        , file_size_((fd_ >= 0) ? getFileSize(fd_) : 0U)
+        , slots_((params.queue_capacity > 0) ? params.queue_capacity : 1U)
+        , head_(0)
+        , size_(0)
+        , bucket_tokens_(params.rate_limit_burst)
+        , bucket_timestamp_(std::chrono::steady_clock::now())
+        , num_unreported_drops_(0)
+        , flush_requested_(false)
+        , stop_(false)
+        , writer_(&BatchedLogSink::writerThread, this)
+    { }
+
+    ~BatchedLogSink()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        writer_cond_.notify_all();
+        writer_.join();
+        if (fd_ >= 0)
+        {
+            (void)::close(fd_);
+        }
+    }
+
+    BatchedLogSink(const BatchedLogSink&) = delete;
+    BatchedLogSink& operator=(const BatchedLogSink&) = delete;
+
+    void log(const uavcan::protocol::debug::LogMessage& message) override
+    {
+        bool wake_writer = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!tryConsumeToken())
+            {
+                stats_.num_dropped_rate_limit++;
+                num_unreported_drops_++;
+                return;
+            }
+            if (size_ >= slots_.size())
+            {
+                stats_.num_dropped_overflow++;
+                num_unreported_drops_++;
+                return;
+            }
+            format(slots_[(head_ + size_) % slots_.size()], message);
+            size_++;
+            wake_writer = size_ == getWakeUpThreshold();
+        }
+        if (wake_writer)
+        {
+            writer_cond_.notify_one();
+        }
+    }
+
+    /**
+     * Blocks until all messages that were logged before this call are written out.
+     */
+    void flush()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while ((size_ > 0 || num_unreported_drops_ > 0) && !stop_)
+        {
+            flush_requested_ = true;
+            writer_cond_.notify_one();
+            (void)flushed_cond_.wait_for(lock, params_.flush_interval);
+        }
+    }
+
+    BatchedLogSinkStats getStats() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stats_;
+    }
+
+    const BatchedLogSinkParams& getParams() const { return params_; }
+};
+
+}
@@ -0,0 +1,462 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <uavcan/helpers/heap_based_pool_allocator.hpp>
+#include <uavcan/node/global_data_type_registry.hpp>
+#include <uavcan/transport/frame.hpp>
+#include <uavcan/transport/transfer_buffer.hpp>
+#include <uavcan/transport/transfer_receiver.hpp>
+#include <uavcan_linux/bus_log.hpp>
+#include <uavcan_linux/exception.hpp>
+
+namespace uavcan_linux
+{
+/**
+ * Transfer reassembled by @ref OfflineTransferDecoder.
+ */
+struct OfflineTransfer
+{
+    std::uint64_t frame_index = 0;              ///< Index of the last frame of the transfer in the log
+    uavcan::MonotonicTime ts_mono;              ///< Timestamps of the first frame, same as in the library
+    uavcan::UtcTime ts_utc;
+    uavcan::TransferType transfer_type = uavcan::TransferTypeMessageBroadcast;
+    uavcan::DataTypeID data_type_id;
+    uavcan::NodeID src_node_id;                 ///< Broadcast for anonymous transfers
+    uavcan::NodeID dst_node_id;                 ///< Broadcast for messages
+    uavcan::TransferID transfer_id;
+    uavcan::TransferPriority priority;
+    std::uint8_t iface_index = 0;
+
+    /**
+     * False if the CRC of a multi-frame transfer couldn't be verified, because the data type is not registered
+     * with the global data type registry. Single-frame transfers have no transfer CRC.
+     */
+    bool crc_verified = true;
+
+    std::vector<std::uint8_t> payload;
+};
+
+/**
+ * Reassembles the transfers of a recorded bus log using multiple threads.
+ *
+ * Every transfer is a sequence of frames with the same CAN ID (the priority aside), so the frames are distributed
+ * among the worker threads by CAN ID; every worker has its own transfer receivers and buffers, which run exactly
+ * the same reassembly logic as a node does. The log is processed in chunks; while the workers process a chunk,
+ * the transfers of the previous one are merged and passed to the handler, in the order of completion, i.e. in the
+ * order of @ref OfflineTransfer::frame_index.
+ *
+ * The CRC of multi-frame transfers is computed with the data type signature taken from the global data type
+ * registry, so the data types of interest should be registered. Transfers of known data types that fail the
+ * CRC check are dropped and counted as errors.
+ */
+class OfflineTransferDecoder
+{
+public:
+    typedef std::function<void (const OfflineTransfer&)> TransferHandler;
+
+private:
+    enum { DefaultFramesPerChunk = 65536 };
+    enum { MaxTransferPayloadLen = 0xFFFF };
+    enum { AllocatorBlockCapacity = 0x7FFF };
+    enum { AllocatorBlocksPerChunk = 256 };
+
+    struct InputFrame
+    {
+        std::uint64_t index;
+        uavcan::CanRxFrame frame;
+    };
+
+    struct Stream
+    {
+        uavcan::TransferReceiver receiver;
+        uavcan::TransferBufferManager bufmgr;
+        uavcan::TransferCRC crc_base;
+        bool crc_known;
+
+        Stream(uavcan::IPoolAllocator& allocator, const uavcan::DataTypeDescriptor* descriptor)
+            : bufmgr(MaxTransferPayloadLen, allocator)
+            , crc_base((descriptor != nullptr) ? descriptor->getSignature().toTransferCRC() : uavcan::TransferCRC())
+            , crc_known(descriptor != nullptr)
+        { }
+    };
+
+    struct Worker
+    {
+        // The allocator must outlive the streams
+        uavcan::HeapBasedPoolAllocator<uavcan::MemPoolBlockSize, char, AllocatorBlocksPerChunk> allocator;
+        std::unordered_map<std::uint32_t, std::unique_ptr<Stream>> streams;
+        std::vector<InputFrame> input;
+        std::vector<OfflineTransfer> output;
+        std::uint64_t num_errors = 0;
+        std::thread thread;
+
+        Worker() : allocator(AllocatorBlockCapacity) { }
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    const unsigned frames_per_chunk_;
+
+    std::mutex mutex_;
+    std::condition_variable start_cv_;
+    std::condition_variable done_cv_;
+    std::uint64_t generation_ = 0;
+    unsigned num_busy_workers_ = 0;
+    bool stop_ = false;
+
+    std::uint64_t num_frames_ = 0;
+    std::uint64_t num_transfers_ = 0;
+
+    /**
+     * The CAN ID without the priority field identifies the source, the destination and the data type.
+     */
+    static std::uint32_t makeStreamKey(const uavcan::CanFrame& frame)
+    {
+        return frame.id & 0x00FFFFFFU;
+    }
+
+    static void fillTransfer(OfflineTransfer& out, const uavcan::RxFrame& last_frame, std::uint64_t frame_index,
+                             uavcan::MonotonicTime ts_mono, uavcan::UtcTime ts_utc)
+    {
+        out.frame_index = frame_index;
+        out.ts_mono = ts_mono;
+        out.ts_utc = ts_utc;
+        out.transfer_type = last_frame.getTransferType();
+        out.data_type_id = last_frame.getDataTypeID();
+        out.src_node_id = last_frame.getSrcNodeID();
+        out.dst_node_id = last_frame.getDstNodeID();
+        out.transfer_id = last_frame.getTransferID();
+        out.priority = last_frame.getPriority();
+        out.iface_index = last_frame.getIfaceIndex();
+    }
+
+    static void emitSingleFrameTransfer(Worker& w, const uavcan::RxFrame& frame, std::uint64_t frame_index)
+    {
+        w.output.emplace_back();
+        OfflineTransfer& tr = w.output.back();
+        fillTransfer(tr, frame, frame_index, frame.getMonotonicTimestamp(), frame.getUtcTimestamp());
+        tr.payload.assign(frame.getPayloadPtr(), frame.getPayloadPtr() + frame.getPayloadLen());
+    }
+
+    static void processFrame(Worker& w, const InputFrame& input)
+    {
+        uavcan::RxFrame frame;
+        if (!frame.parse(input.frame))
+        {
+            w.num_errors++;
+            return;
+        }
+
+        if (frame.getSrcNodeID().isBroadcast())            // Anonymous transfer
+        {
+            if (frame.isStartOfTransfer() && frame.isEndOfTransfer() && frame.getDstNodeID().isBroadcast())
+            {
+                emitSingleFrameTransfer(w, frame, input.index);
+            }
+            else
+            {
+                w.num_errors++;
+            }
+            return;
+        }
+
+        const std::uint32_t key = makeStreamKey(input.frame);
+        auto it = w.streams.find(key);
+        if (it == w.streams.end())
+        {
+            if (!frame.isStartOfTransfer())
+            {
+                return;
+            }
+            const uavcan::DataTypeDescriptor* const descriptor = uavcan::GlobalDataTypeRegistry::instance().find(
+                uavcan::getDataTypeKindForTransferType(frame.getTransferType()), frame.getDataTypeID());
+            it = w.streams.emplace(key, std::unique_ptr<Stream>(new Stream(w.allocator, descriptor))).first;
+        }
+        Stream& stream = *it->second;
+
+        uavcan::TransferBufferAccessor tba(stream.bufmgr,
+                                           uavcan::TransferBufferManagerKey(frame.getSrcNodeID(),
+                                                                            frame.getTransferType()));
+        switch (stream.receiver.addFrame(frame, tba, stream.crc_base))
+        {
+        case uavcan::TransferReceiver::ResultNotComplete:
+        {
+            w.num_errors += stream.receiver.yieldErrorCount();
+            break;
+        }
+        case uavcan::TransferReceiver::ResultSingleFrame:
+        {
+            emitSingleFrameTransfer(w, frame, input.index);
+            break;
+        }
+        case uavcan::TransferReceiver::ResultComplete:
+        {
+            const uavcan::ITransferBuffer* const buf = tba.access();
+            if (buf == nullptr)
+            {
+                w.num_errors++;
+                break;
+            }
+            const bool crc_matches =
+                stream.receiver.getLastTransferComputedCrc() == stream.receiver.getLastTransferCrc();
+            if (stream.crc_known && !crc_matches)
+            {
+                w.num_errors++;
+                tba.remove();
+                break;
+            }
+            w.output.emplace_back();
+            OfflineTransfer& tr = w.output.back();
+            fillTransfer(tr, frame, input.index, stream.receiver.getLastTransferTimestampMonotonic(),
+                         stream.receiver.getLastTransferTimestampUtc());
+            tr.crc_verified = stream.crc_known;
+            unsigned len = 0;
+            const std::uint8_t* const data = buf->getContiguousData(len);
+            if (data != nullptr)
+            {
+                tr.payload.assign(data, data + len);
+            }
+            else
+            {
+                // The interface does not expose the stored length, so read until the buffer runs out
+                static const unsigned ChunkSize = 256;
+                int res = 0;
+                do
+                {
+                    const unsigned offset = unsigned(tr.payload.size());
+                    tr.payload.resize(offset + ChunkSize);
+                    res = buf->read(offset, tr.payload.data() + offset, ChunkSize);
+                    tr.payload.resize(offset + ((res > 0) ? unsigned(res) : 0U));
+                }
+                while (res == int(ChunkSize));
+            }
+            tba.remove();
+            break;
+        }
+        default:
+        {
+            assert(0);
+            break;
+        }
+        }
+    }
+
+    void runWorker(Worker& w)
+    {
+        std::uint64_t last_generation = 0;
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                start_cv_.wait(lock, [&]() { return stop_ || (generation_ != last_generation); });
+                if (stop_)
+                {
+                    return;
+                }
+                last_generation = generation_;
+            }
+
+            for (const InputFrame& f : w.input)
+            {
+                processFrame(w, f);
+            }
+            w.input.clear();
+
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                num_busy_workers_--;
+            }
+            done_cv_.notify_one();
+        }
+    }
+
+    /**
+     * Returns false if the log has no more frames.
+     */
+    bool distributeChunk(BusLogReader& reader)
+    {
+        InputFrame in;
+        uavcan::CanIOFlags flags = 0;
+        unsigned num_read = 0;
+        while ((num_read < frames_per_chunk_) && reader.next(in.frame, flags))
+        {
+            in.index = num_frames_++;
+            num_read++;
+            if ((flags & uavcan::CanIOFlagLoopback) || !in.frame.isExtended() ||
+                in.frame.isRemoteTransmissionRequest() || in.frame.isErrorFrame())
+            {
+                continue;
+            }
+            const std::uint32_t hash = makeStreamKey(in.frame) * 2654435761U;     // Knuth's multiplicative hash
+            workers_[(hash >> 16) % workers_.size()]->input.push_back(in);
+        }
+        return num_read > 0;
+    }
+
+    void startWorkers()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            generation_++;
+            num_busy_workers_ = unsigned(workers_.size());
+        }
+        start_cv_.notify_all();
+    }
+
+    void waitForWorkers()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_cv_.wait(lock, [&]() { return num_busy_workers_ == 0; });
+    }
+
+    /**
+     * The output of every worker is ordered by frame index already, so a simple K-way merge is enough.
+     */
+    void emit(std::vector<std::vector<OfflineTransfer>>& outputs, const TransferHandler& handler)
+    {
+        std::vector<std::size_t> heads(outputs.size(), 0);
+        while (true)
+        {
+            int best = -1;
+            for (unsigned i = 0; i < outputs.size(); i++)
+            {
+                if ((heads[i] < outputs[i].size()) &&
+                    ((best < 0) || (outputs[i][heads[i]].frame_index < outputs[best][heads[best]].frame_index)))
+                {
+                    best = int(i);
+                }
+            }
+            if (best < 0)
+            {
+                break;
+            }
+            handler(outputs[best][heads[best]]);
+            heads[best]++;
+            num_transfers_++;
+        }
+        for (auto& o : outputs)
+        {
+            o.clear();
+        }
+    }
+
+public:
+    /**
+     * @param num_threads       Number of worker threads; zero selects the number of CPU cores.
+     * @param frames_per_chunk  Number of frames the workers process between synchronizations.
+     */
+    explicit OfflineTransferDecoder(unsigned num_threads = 0, unsigned frames_per_chunk = DefaultFramesPerChunk)
+        : frames_per_chunk_((frames_per_chunk > 0) ? frames_per_chunk : unsigned(DefaultFramesPerChunk))
+    {
+        if (num_threads == 0)
+        {
+            num_threads = std::max(1U, std::thread::hardware_concurrency());
+        }
+        for (unsigned i = 0; i < num_threads; i++)
+        {
+            workers_.emplace_back(new Worker);
+        }
+        for (auto& w : workers_)
+        {
+            Worker* const p = w.get();
+            p->thread = std::thread([this, p]() { runWorker(*p); });
+        }
+    }
+
+    ~OfflineTransferDecoder()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        start_cv_.notify_all();
+        for (auto& w : workers_)
+        {
+            if (w->thread.joinable())
+            {
+                w->thread.join();
+            }
+        }
+    }
+
+    OfflineTransferDecoder(const OfflineTransferDecoder&) = delete;
+    OfflineTransferDecoder& operator=(const OfflineTransferDecoder&) = delete;
+
+    /**
+     * Decodes the log from its current position to the end, passing the transfers to the handler, which is
+     * invoked from the calling thread. The reassembly state is kept between the calls, so a log can be decoded
+     * in several steps. Loopback frames are ignored.
+     */
+    void decode(BusLogReader& reader, const TransferHandler& handler)
+    {
+        std::vector<std::vector<OfflineTransfer>> outputs(workers_.size());
+
+        bool more = distributeChunk(reader);
+        if (more)
+        {
+            startWorkers();
+        }
+        while (more)
+        {
+            waitForWorkers();
+            for (unsigned i = 0; i < workers_.size(); i++)
+            {
+                outputs[i].swap(workers_[i]->output);
+            }
+            more = distributeChunk(reader);
+            if (more)
+            {
+                startWorkers();
+            }
+            try
+            {
+                emit(outputs, handler);             // Concurrently with the workers
+            }
+            catch (...)
+            {
+                if (more)
+                {
+                    waitForWorkers();
+                }
+                throw;
+            }
+        }
+    }
+
+    unsigned getNumThreads() const { return unsigned(workers_.size()); }
+
+    /**
+     * Number of frames read from the log, including the ignored ones.
+     */
+    std::uint64_t getNumFrames() const { return num_frames_; }
+
+    std::uint64_t getNumTransfers() const { return num_transfers_; }
+
+    /**
+     * Malformed frames, reassembly errors and CRC mismatches. Must not be called while decoding.
+     */
+    std::uint64_t getNumErrors() const
+    {
+        std::uint64_t sum = 0;
+        for (auto& w : workers_)
+        {
+            sum += w->num_errors;
+        }
+        return sum;
+    }
+};
+
+}
@@ -0,0 +1,758 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <uavcan/error.hpp>
+#include <uavcan/driver/can.hpp>
+#include <uavcan/transport/frame.hpp>
+#include <uavcan_linux/clock.hpp>
+#include <uavcan_linux/exception.hpp>
+#include <uavcan_linux/socketcan.hpp>
+
+namespace uavcan_linux
+{
+/**
+ * Lock-free queue for exactly one producer thread and one consumer thread.
+ * The capacity is rounded up to a power of two.
+ */
+template <typename T>
+class SpscQueue
+{
+    std::vector<T> items_;
+    const std::size_t mask_;
+    std::atomic<std::size_t> head_;     ///< Written only by the consumer
+    char padding_[64];                  ///< Keeps the indices in different cache lines
+    std::atomic<std::size_t> tail_;     ///< Written only by the producer
+
+    static std::size_t roundUpToPowerOfTwo(std::size_t x)
+    {
+        std::size_t out = 1;
+        while (out < x)
+        {
+            out <<= 1;
+        }
+        return out;
+    }
+
+public:
+    explicit SpscQueue(std::size_t capacity)
+        : items_(roundUpToPowerOfTwo(capacity))
+        , mask_(items_.size() - 1)
+        , head_(0)
+        , padding_()
+        , tail_(0)
+    { }
+
+    /**
+     * Producer side.
+     * The indices are accessed in sequentially consistent order, which guarantees that if the consumer has found
+     * the queue empty, the producer of the next item sees out_was_empty set, so the consumer can safely go to sleep
+     * waiting for a signal from the producer.
+     * @return False if the queue is full.
+     */
+    bool push(const T& item, bool& out_was_empty)
+    {
+        const std::size_t tail = tail_.load(std::memory_order_relaxed);
+        if ((tail - head_.load()) >= items_.size())
+        {
+            out_was_empty = false;
+            return false;
+        }
+        items_[tail & mask_] = item;
+        tail_.store(tail + 1);
+        out_was_empty = head_.load() == tail;
+        return true;
+    }
+
+    /**
+     * Consumer side.
+     * @return Null if the queue is empty. The pointer stays valid until @ref pop().
+     */
+    T* peek()
+    {
+        const std::size_t head = head_.load(std::memory_order_relaxed);
+        return (head == tail_.load()) ? nullptr : &items_[head & mask_];
+    }
+
+    void pop()
+    {
+        head_.store(head_.load(std::memory_order_relaxed) + 1);
+    }
+
+    bool isEmpty() const { return head_.load() == tail_.load(); }
+    bool isFull() const { return (tail_.load() - head_.load()) >= items_.size(); }
+
+    std::size_t getCapacity() const { return items_.size(); }
+};
+
+/**
+ * Parameters of @ref ParallelRxCanDriver.
+ */
+struct ParallelRxParams
+{
+    SocketCanIoMode io_mode = SocketCanIoMode::Batched;
+    SocketCanTimestampMode ts_mode = SocketCanTimestampMode::Software;
+    SocketCanLoopbackMode loopback_mode = SocketCanLoopbackMode::AllFrames;
+
+    /**
+     * Parsed frames waiting for the dispatcher thread, per iface.
+     */
+    unsigned rx_queue_capacity = SocketCanIface::DefaultRxQueueCapacity;
+
+    /**
+     * Frames waiting for the I/O thread, per iface. The frames are prioritized only after they've left this queue,
+     * so it should be short; the transmission queue of the library is in front of it anyway.
+     */
+    unsigned tx_queue_capacity = 64;
+
+    /**
+     * I/O thread of the iface N is pinned to cpu_affinity[N % cpu_affinity.size()]; empty keeps the inherited
+     * affinity.
+     */
+    std::vector<int> cpu_affinity;
+
+    /**
+     * Optional application defined filter, invoked from the I/O threads for every valid non-loopback frame;
+     * it must be thread safe. The frame is dropped if the filter returns false.
+     */
+    std::function<bool (const uavcan::RxFrame&)> rx_filter;
+};
+
+/**
+ * Iface of @ref ParallelRxCanDriver.
+ * The methods of uavcan::ICanIface must be called from the dispatcher thread only.
+ */
+class ParallelRxCanIface : public uavcan::ICanIface
+{
+    friend class ParallelRxCanDriver;
+
+    struct TxItem
+    {
+        uavcan::CanFrame frame;
+        uavcan::MonotonicTime deadline;
+        uavcan::CanIOFlags flags = 0;
+    };
+
+    struct RxItem
+    {
+        uavcan::CanRxFrame frame;
+        uavcan::CanIOFlags flags = 0;
+    };
+
+    const ParallelRxParams& params_;
+    const std::uint8_t iface_index_;
+    std::unique_ptr<SocketCanIface> iface_;
+
+    SpscQueue<RxItem> rx_queue_;        ///< I/O thread --> dispatcher thread
+    SpscQueue<TxItem> tx_queue_;        ///< Dispatcher thread --> I/O thread
+    const int rx_signal_fd_;            ///< Wakes up the dispatcher thread, see @ref getRxSignalFileDescriptor()
+    const int io_signal_fd_;            ///< Wakes up the I/O thread
+
+    std::mutex filters_mutex_;
+    std::vector<uavcan::CanFilterConfig> pending_filters_;
+    std::atomic<bool> filters_pending_;
+
+    const std::atomic<std::uint8_t>& local_node_id_;
+    std::atomic<bool> stop_requested_;
+    std::atomic<bool> down_;
+    std::atomic<std::uint64_t> error_count_;
+    std::atomic<std::uint64_t> num_rx_frames_;
+    std::atomic<std::uint64_t> num_malformed_frames_;
+    std::atomic<std::uint64_t> num_filtered_frames_;
+    std::atomic<std::uint64_t> num_rx_queue_overflows_;
+    std::atomic<std::uint64_t> num_tx_errors_;
+    std::atomic<std::uint64_t> num_filter_errors_;
+    std::thread thread_;
+
+    static void signal(int fd)
+    {
+        const std::uint64_t one = 1;
+        (void)::write(fd, &one, sizeof(one));
+    }
+
+    static void clearSignal(int fd)
+    {
+        std::uint64_t value = 0;
+        (void)::read(fd, &value, sizeof(value));
+    }
+
+    bool accept(const uavcan::CanRxFrame& can_frame, uavcan::CanIOFlags flags);
+
+    void applyPendingFilters();
+    void transferTxFrames();
+    void transferRxFrames();
+    void updateDownStatus(const ::pollfd& pfd);
+    void run();
+
+    ParallelRxCanIface(const SystemClock& clock, const ParallelRxParams& params, std::uint8_t iface_index,
+                       int fd, int loopback_fd, int rx_signal_fd, int io_signal_fd,
+                       const std::atomic<std::uint8_t>& local_node_id)
+        : params_(params)
+        , iface_index_(iface_index)
+        , iface_(new SocketCanIface(clock, fd, SocketCanIface::DefaultMaxFramesInSocketTxQueue, params.io_mode,
+                                    SocketCanIface::DefaultTxQueueCapacity, SocketCanIface::DefaultRxQueueCapacity,
+                                    loopback_fd))
+        , rx_queue_(params.rx_queue_capacity)
+        , tx_queue_(params.tx_queue_capacity)
+        , rx_signal_fd_(rx_signal_fd)
+        , io_signal_fd_(io_signal_fd)
+        , filters_pending_(false)
+        , local_node_id_(local_node_id)
+        , stop_requested_(false)
+        , down_(false)
+        , error_count_(0)
+        , num_rx_frames_(0)
+        , num_malformed_frames_(0)
+        , num_filtered_frames_(0)
+        , num_rx_queue_overflows_(0)
+        , num_tx_errors_(0)
+        , num_filter_errors_(0)
+    { }
+
+    void start()
+    {
+        thread_ = std::thread([this]() { run(); });
+    }
+
+    void stop()
+    {
+        stop_requested_ = true;
+        signal(io_signal_fd_);
+        if (thread_.joinable())
+        {
+            thread_.join();
+        }
+    }
+
+public:
+    ~ParallelRxCanIface()
+    {
+        stop();
+        iface_.reset();                 // Closes the sockets
+        (void)::close(rx_signal_fd_);
+        (void)::close(io_signal_fd_);
+    }
+
+    ParallelRxCanIface(const ParallelRxCanIface&) = delete;
+    ParallelRxCanIface& operator=(const ParallelRxCanIface&) = delete;
+
+    /**
+     * Hands the frame over to the I/O thread.
+     * @return 0 if the queue of the I/O thread is full.
+     */
+    std::int16_t send(const uavcan::CanFrame& frame, const uavcan::MonotonicTime tx_deadline,
+                      const uavcan::CanIOFlags flags) override
+    {
+        if (down_)
+        {
+            return -uavcan::ErrDriver;
+        }
+        TxItem item;
+        item.frame = frame;
+        item.deadline = tx_deadline;
+        item.flags = flags;
+        bool was_empty = false;
+        if (!tx_queue_.push(item, was_empty))
+        {
+            return 0;
+        }
+        if (was_empty)
+        {
+            signal(io_signal_fd_);
+        }
+        return 1;
+    }
+
+    std::int16_t receive(uavcan::CanFrame& out_frame, uavcan::MonotonicTime& out_ts_monotonic,
+                         uavcan::UtcTime& out_ts_utc, uavcan::CanIOFlags& out_flags) override
+    {
+        RxItem* const item = rx_queue_.peek();
+        if (item == nullptr)
+        {
+            return 0;
+        }
+        out_frame = item->frame;
+        out_ts_monotonic = item->frame.ts_mono;
+        out_ts_utc = item->frame.ts_utc;
+        out_flags = item->flags;
+        rx_queue_.pop();
+        return 1;
+    }
+
+    std::int16_t receiveBatch(uavcan::CanRxFrame* out_frames, uavcan::CanIOFlags* out_flags,
+                              std::uint16_t max_frames) override
+    {
+        std::int16_t count = 0;
+        while (count < max_frames)
+        {
+            RxItem* const item = rx_queue_.peek();
+            if (item == nullptr)
+            {
+                break;
+            }
+            const std::uint8_t iface_index = out_frames[count].iface_index;   // Must be left untouched
+            out_frames[count] = item->frame;
+            out_frames[count].iface_index = iface_index;
+            out_flags[count] = item->flags;
+            rx_queue_.pop();
+            count++;
+        }
+        return count;
+    }
+
+    /**
+     * The filters are applied by the I/O thread asynchronously.
+     */
+    std::int16_t configureFilters(const uavcan::CanFilterConfig* filter_configs,
+                                  const std::uint16_t num_configs) override
+    {
+        {
+            std::lock_guard<std::mutex> lock(filters_mutex_);
+            pending_filters_.assign(filter_configs, filter_configs + num_configs);
+        }
+        filters_pending_ = true;
+        signal(io_signal_fd_);
+        return 0;
+    }
+
+    std::uint16_t getNumFilters() const override { return SocketCanIface::NumFilters; }
+
+    /**
+     * Includes the RX queue overflows and the filter configuration failures.
+     */
+    std::uint64_t getErrorCount() const override
+    {
+        return error_count_ + num_rx_queue_overflows_ + num_filter_errors_;
+    }
+
+    bool hasReadyRx() const { return !rx_queue_.isEmpty(); }
+    bool isWriteable() const { return !down_ && !tx_queue_.isFull(); }
+    bool isDown() const { return down_; }
+
+    /**
+     * Becomes readable when the RX queue becomes non-empty, or when the TX queue stops being full.
+     */
+    int getRxSignalFileDescriptor() const { return rx_signal_fd_; }
+
+    std::uint64_t getNumRxFrames() const { return num_rx_frames_; }
+    std::uint64_t getNumMalformedFrames() const { return num_malformed_frames_; }
+    std::uint64_t getNumFilteredFrames() const { return num_filtered_frames_; }
+    std::uint64_t getNumRxQueueOverflows() const { return num_rx_queue_overflows_; }
+    std::uint64_t getNumTxErrors() const { return num_tx_errors_; }
+};
+
+/**
+ * CAN driver that moves the interface level work off the dispatcher thread: every iface has its own I/O thread
+ * that performs the socket system calls, timestamps, parses and validates the received frames and drops
+ * the irrelevant ones, and hands the rest over to the dispatcher thread through a lock-free queue.
+ * This keeps the dispatcher thread busy only with the transfer layer, which matters on a node with several
+ * heavily loaded redundant buses.
+ *
+ * The frames to transmit go the other way through another lock-free queue per iface; a frame is reported sent
+ * once it's been queued for the I/O thread. The hardware filters are configured asynchronously.
+ *
+ * Besides the validity check, the I/O threads drop the service frames addressed to other nodes once the local
+ * node ID is set with @ref setLocalNodeID(); it must not be set if the node has to see all traffic, e.g. because
+ * it's a bus monitor. The application can add its own filter, see @ref ParallelRxParams::rx_filter.
+ * The loopback frames are never dropped.
+ *
+ * The dispatcher interface of the driver (uavcan::ICanDriver, uavcan::ICanIface, @ref IPollableCanDriver) must be
+ * used from one thread. When the private UTC adjustment of @ref SystemClock is used, it's read by the I/O threads
+ * while timestamping the frames, so it should be adjusted from the dispatcher thread only.
+ */
+class ParallelRxCanDriver : public uavcan::ICanDriver
+                          , public IPollableCanDriver
+{
+    const SystemClock& clock_;
+    const ParallelRxParams params_;
+    std::atomic<std::uint8_t> local_node_id_;
+    std::vector<std::unique_ptr<ParallelRxCanIface>> ifaces_;
+
+public:
+    /**
+     * Reference to the clock object shall remain valid.
+     */
+    explicit ParallelRxCanDriver(const SystemClock& clock, const ParallelRxParams& params = ParallelRxParams())
+        : clock_(clock)
+        , params_(params)
+        , local_node_id_(uavcan::NodeID().get())
+    {
+        ifaces_.reserve(uavcan::MaxCanIfaces);
+    }
+
+    /**
+     * Stops the I/O threads.
+     */
+    ~ParallelRxCanDriver() { ifaces_.clear(); }
+
+    /**
+     * Adds one iface by name and starts its I/O thread.
+     * @param iface_name E.g. "can0", "vcan1"
+     * @return Negative on error, interface index on success.
+     * @throws uavcan_linux::Exception.
+     */
+    int addIface(const std::string& iface_name);
+
+    /**
+     * Enables dropping of the service frames addressed to other nodes in the I/O threads.
+     * Invalid node ID disables it; this is the default. Can be called at any time, e.g. once the dynamic node ID
+     * allocation has completed.
+     */
+    void setLocalNodeID(uavcan::NodeID node_id) { local_node_id_ = node_id.get(); }
+
+    std::int16_t select(uavcan::CanSelectMasks& inout_masks,
+                        const uavcan::CanFrame* (&)[uavcan::MaxCanIfaces],
+                        uavcan::MonotonicTime blocking_deadline) override;
+
+    /**
+     * One descriptor per functioning iface; it becomes readable when the iface has received frames.
+     */
+    std::vector<::pollfd> getPollFds() const override
+    {
+        std::vector<::pollfd> pollfds;
+        for (auto& iface : ifaces_)
+        {
+            auto pfd = ::pollfd();
+            pfd.fd = iface->getRxSignalFileDescriptor();
+            pfd.events = POLLIN;
+            pollfds.push_back(pfd);
+        }
+        return pollfds;
+    }
+
+    ParallelRxCanIface* getIface(std::uint8_t iface_index) override
+    {
+        return (iface_index >= ifaces_.size()) ? nullptr : ifaces_[iface_index].get();
+    }
+
+    std::uint8_t getNumIfaces() const override { return std::uint8_t(ifaces_.size()); }
+
+    bool isIfaceDown(std::uint8_t iface_index) const { return ifaces_.at(iface_index)->isDown(); }
+};
+
+// ----------------------------------------------------------------------------
+
+inline bool ParallelRxCanIface::accept(const uavcan::CanRxFrame& can_frame, uavcan::CanIOFlags flags)
+{
+    if (flags & uavcan::CanIOFlagLoopback)
+    {
+        return true;
+    }
+
+    uavcan::RxFrame frame;
+    if (!frame.parse(can_frame))
+    {
+        num_malformed_frames_++;
+        return false;
+    }
+
+    const uavcan::NodeID local_node_id(local_node_id_.load(std::memory_order_relaxed));
+    if (local_node_id.isUnicast() &&
+        (frame.getTransferType() != uavcan::TransferTypeMessageBroadcast) &&
+        (frame.getDstNodeID() != local_node_id))
+    {
+        num_filtered_frames_++;
+        return false;
+    }
+
+    if (params_.rx_filter && !params_.rx_filter(frame))
+    {
+        num_filtered_frames_++;
+        return false;
+    }
+    return true;
+}
+
+inline void ParallelRxCanIface::applyPendingFilters()
+{
+    if (!filters_pending_.exchange(false))
+    {
+        return;
+    }
+    std::vector<uavcan::CanFilterConfig> filters;
+    {
+        std::lock_guard<std::mutex> lock(filters_mutex_);
+        filters.swap(pending_filters_);
+    }
+    if (iface_->configureFilters(filters.data(), std::uint16_t(filters.size())) < 0)
+    {
+        num_filter_errors_++;
+    }
+}
+
+inline void ParallelRxCanIface::transferTxFrames()
+{
+    const bool was_full = tx_queue_.isFull();
+    bool popped = false;
+    while (!iface_->isTxQueueFull())
+    {
+        TxItem* const item = tx_queue_.peek();
+        if (item == nullptr)
+        {
+            break;
+        }
+        if (iface_->send(item->frame, item->deadline, item->flags) < 0)
+        {
+            num_tx_errors_++;
+        }
+        tx_queue_.pop();
+        popped = true;
+    }
+    if (was_full && popped)
+    {
+        signal(rx_signal_fd_);          // The dispatcher thread may be blocked waiting for the queue to release
+    }
+}
+
+inline void ParallelRxCanIface::transferRxFrames()
+{
+    bool need_signal = false;
+    RxItem item;
+    while (iface_->receive(item.frame, item.frame.ts_mono, item.frame.ts_utc, item.flags) > 0)
+    {
+        item.frame.iface_index = iface_index_;
+        if (!accept(item.frame, item.flags))
+        {
+            continue;
+        }
+        bool was_empty = false;
+        if (rx_queue_.push(item, was_empty))
+        {
+            num_rx_frames_++;
+            need_signal = need_signal || was_empty;
+        }
+        else
+        {
+            num_rx_queue_overflows_++;
+        }
+    }
+    if (need_signal)
+    {
+        signal(rx_signal_fd_);
+    }
+}
+
+inline void ParallelRxCanIface::updateDownStatus(const ::pollfd& pfd)
+{
+    if (pfd.revents & POLLERR)
+    {
+        int error = 0;
+        ::socklen_t errlen = sizeof(error);
+        (void)::getsockopt(pfd.fd, SOL_SOCKET, SO_ERROR, reinterpret_cast<void*>(&error), &errlen);
+        if (error == ENETDOWN || error == ENODEV)
+        {
+            UAVCAN_TRACE("ParallelRx", "Iface %d is dead; error %d", pfd.fd, error);
+            down_ = true;
+        }
+    }
+}
+
+inline void ParallelRxCanIface::run()
+{
+    if (!params_.cpu_affinity.empty())
+    {
+        ::cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        CPU_SET(params_.cpu_affinity[iface_index_ % params_.cpu_affinity.size()], &cpuset);
+        (void)::pthread_setaffinity_np(::pthread_self(), sizeof(cpuset), &cpuset);
+    }
+
+    while (!stop_requested_ && !down_)
+    {
+        applyPendingFilters();
+        transferTxFrames();
+
+        ::pollfd pollfds[3] = {};
+        unsigned num_pollfds = 0;
+        pollfds[num_pollfds].fd = io_signal_fd_;
+        pollfds[num_pollfds].events = POLLIN;
+        num_pollfds++;
+        pollfds[num_pollfds].fd = iface_->getFileDescriptor();
+        pollfds[num_pollfds].events = POLLIN;
+        if (iface_->hasReadyTx())
+        {
+            pollfds[num_pollfds].events |= POLLOUT;
+        }
+        num_pollfds++;
+        if (iface_->getLoopbackFileDescriptor() >= 0)
+        {
+            pollfds[num_pollfds].fd = iface_->getLoopbackFileDescriptor();
+            pollfds[num_pollfds].events = POLLIN;
+            num_pollfds++;
+        }
+
+        // The TX deadlines are checked when the socket becomes writeable, so there's no need for a timeout
+        if (::ppoll(pollfds, num_pollfds, nullptr, nullptr) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            UAVCAN_TRACE("ParallelRx", "ppoll() failed, errno %d", errno);
+            down_ = true;
+            break;
+        }
+
+        if (pollfds[0].revents & POLLIN)
+        {
+            clearSignal(io_signal_fd_);
+        }
+        updateDownStatus(pollfds[1]);
+
+        const bool loopback_ready = (num_pollfds > 2) && (pollfds[2].revents & POLLIN);
+        const bool poll_read  = loopback_ready || (pollfds[1].revents & POLLIN);
+        const bool poll_write = loopback_ready || (pollfds[1].revents & POLLOUT);
+        iface_->poll(poll_read, poll_write);
+
+        transferRxFrames();
+        error_count_ = iface_->getErrorCount();
+    }
+}
+
+inline int ParallelRxCanDriver::addIface(const std::string& iface_name)
+{
+    if (ifaces_.size() >= uavcan::MaxCanIfaces)
+    {
+        return -1;
+    }
+
+    const int fd = SocketCanIface::openSocket(iface_name, params_.ts_mode, params_.loopback_mode);
+    if (fd < 0)
+    {
+        return fd;
+    }
+    int loopback_fd = -1;
+    if (params_.loopback_mode == SocketCanLoopbackMode::Selective)
+    {
+        loopback_fd = SocketCanIface::openSocket(iface_name, params_.ts_mode);
+        if (loopback_fd < 0)
+        {
+            (void)::close(fd);
+            return loopback_fd;
+        }
+    }
+
+    const int rx_signal_fd = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    const int io_signal_fd = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if ((rx_signal_fd < 0) || (io_signal_fd < 0))
+    {
+        const int error = errno;
+        (void)::close(fd);
+        (void)::close(loopback_fd);
+        (void)::close(rx_signal_fd);
+        (void)::close(io_signal_fd);
+        throw Exception("Failed to create iface descriptors", error);
+    }
+
+    // Upon successful construction the iface takes ownership of the fds
+    ParallelRxCanIface* iface = nullptr;
+    try
+    {
+        iface = new ParallelRxCanIface(clock_, params_, std::uint8_t(ifaces_.size()), fd, loopback_fd,
+                                       rx_signal_fd, io_signal_fd, local_node_id_);
+    }
+    catch (...)
+    {
+        (void)::close(fd);
+        (void)::close(loopback_fd);
+        (void)::close(rx_signal_fd);
+        (void)::close(io_signal_fd);
+        throw;
+    }
+    ifaces_.emplace_back(iface);
+    iface->start();
+
+    UAVCAN_TRACE("ParallelRx", "New iface '%s' fd %d", iface_name.c_str(), fd);
+
+    return int(ifaces_.size() - 1);
+}
+
+inline std::int16_t ParallelRxCanDriver::select(uavcan::CanSelectMasks& inout_masks,
+                                                const uavcan::CanFrame* (&)[uavcan::MaxCanIfaces],
+                                                uavcan::MonotonicTime blocking_deadline)
+{
+    bool need_block = true;
+    bool all_down = true;
+    for (unsigned i = 0; i < ifaces_.size(); i++)
+    {
+        const bool need_read  = inout_masks.read  & (1 << i);
+        const bool need_write = inout_masks.write & (1 << i);
+        if ((need_read && ifaces_[i]->hasReadyRx()) || (need_write && ifaces_[i]->isWriteable()))
+        {
+            need_block = false;
+        }
+        all_down = all_down && ifaces_[i]->isDown() && !ifaces_[i]->hasReadyRx();
+    }
+    if (all_down)
+    {
+        throw AllIfacesDownException();
+    }
+
+    if (need_block)
+    {
+        ::pollfd pollfds[uavcan::MaxCanIfaces] = {};
+        for (unsigned i = 0; i < ifaces_.size(); i++)
+        {
+            pollfds[i].fd = ifaces_[i]->getRxSignalFileDescriptor();
+            pollfds[i].events = POLLIN;
+        }
+
+        const std::int64_t timeout_usec = (blocking_deadline - clock_.getMonotonic()).toUSec();
+        auto ts = ::timespec();
+        if (timeout_usec > 0)
+        {
+            ts.tv_sec = timeout_usec / 1000000LL;
+            ts.tv_nsec = (timeout_usec % 1000000LL) * 1000;
+        }
+
+        const int res = ::ppoll(pollfds, ifaces_.size(), &ts, nullptr);
+        if (res < 0)
+        {
+            return std::int16_t(res);
+        }
+
+        // The signal must be cleared before the queue is checked, otherwise a new frame could be missed
+        for (unsigned i = 0; i < ifaces_.size(); i++)
+        {
+            if (pollfds[i].revents & POLLIN)
+            {
+                ParallelRxCanIface::clearSignal(pollfds[i].fd);
+            }
+        }
+    }
+
+    inout_masks = uavcan::CanSelectMasks();
+    for (unsigned i = 0; i < ifaces_.size(); i++)
+    {
+        if (ifaces_[i]->isWriteable())
+        {
+            inout_masks.write |= std::uint8_t(1U << i);
+        }
+        if (ifaces_[i]->hasReadyRx())
+        {
+            inout_masks.read |= std::uint8_t(1U << i);
+        }
+    }
+
+    return std::int16_t(ifaces_.size());
+}
+
+}
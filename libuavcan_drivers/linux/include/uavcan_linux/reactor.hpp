@@ -0,0 +1,510 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <uavcan/node/abstract_node.hpp>
+#include <uavcan_linux/exception.hpp>
+#include <uavcan_linux/socketcan.hpp>
+
+namespace uavcan_linux
+{
+/**
+ * Parameters of @ref MultiNodeReactor.
+ */
+struct MultiNodeReactorConfig
+{
+    unsigned num_workers = 2;
+
+    /**
+     * Worker N is pinned to cpu_affinity[N % cpu_affinity.size()]; empty keeps the inherited affinity.
+     */
+    std::vector<unsigned> cpu_affinity;
+
+    /**
+     * How many ready nodes a worker takes from epoll at once; the other workers steal the ones it hasn't got to.
+     */
+    unsigned max_events_per_wait = 8;
+};
+
+/**
+ * Runs many independent nodes, e.g. one per bus of a test stand, on a small pool of worker threads.
+ *
+ * Every node must use a driver that implements @ref IPollableCanDriver (the SocketCAN drivers do). The descriptors
+ * of all nodes, plus a timerfd per node for its deadlines, are registered in one epoll instance in one-shot mode.
+ * A worker that receives an event for a node puts the node into its own run queue; idle workers steal from
+ * the queues of the others before waiting on epoll, so the load is balanced without a central queue.
+ *
+ * A node is processed by at most one worker at a time, so the nodes don't need to be thread safe, but they must
+ * not be accessed from other threads directly while the reactor is running; use @ref post() instead.
+ * The CPU use is bounded by the number of workers, and it doesn't grow with the number of nodes when they are idle.
+ */
+class MultiNodeReactor
+{
+public:
+    /**
+     * All counters are updated by the workers; reading them is thread safe.
+     */
+    struct NodeStats
+    {
+        std::uint64_t num_runs = 0;
+        std::uint64_t num_errors = 0;
+        std::uint64_t total_run_usec = 0;
+        int last_error = 0;
+    };
+
+    struct WorkerStats
+    {
+        std::uint64_t num_runs = 0;
+        std::uint64_t num_steals = 0;
+        std::uint64_t num_wakeups = 0;
+    };
+
+private:
+    enum TaskState : int
+    {
+        TaskIdle,
+        TaskQueued,
+        TaskRunning
+    };
+
+    struct Task
+    {
+        uavcan::INode& node;
+        const IPollableCanDriver& driver;
+        int timer_fd = -1;
+        int post_fd = -1;
+        std::vector<::pollfd> registered_fds;       ///< Accessed only by the worker that owns the task
+
+        std::atomic<int> state;
+        std::atomic<bool> rerun;
+
+        std::mutex mutex;
+        std::deque<std::function<void ()>> posted_functions;
+        NodeStats stats;
+
+        Task(uavcan::INode& n, const IPollableCanDriver& d)
+            : node(n)
+            , driver(d)
+            , state(TaskIdle)
+            , rerun(false)
+        { }
+    };
+
+    struct Worker
+    {
+        std::thread thread;
+        std::mutex mutex;
+        std::deque<Task*> queue;
+        std::atomic<std::uint64_t> num_runs;
+        std::atomic<std::uint64_t> num_steals;
+        std::atomic<std::uint64_t> num_wakeups;
+
+        Worker()
+            : num_runs(0)
+            , num_steals(0)
+            , num_wakeups(0)
+        { }
+    };
+
+    const MultiNodeReactorConfig config_;
+    int epoll_fd_ = -1;
+    int stop_fd_ = -1;
+    std::vector<std::unique_ptr<Task>> tasks_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::atomic<bool> stop_requested_;
+    bool running_ = false;
+
+    static std::uint32_t toEpollEvents(short poll_events)
+    {
+        std::uint32_t events = EPOLLONESHOT;
+        events |= (poll_events & POLLIN) ? std::uint32_t(EPOLLIN) : 0U;
+        events |= (poll_events & POLLOUT) ? std::uint32_t(EPOLLOUT) : 0U;
+        return events;
+    }
+
+    void control(int op, int fd, std::uint32_t events, Task* task)
+    {
+        auto ev = ::epoll_event();
+        ev.events = events;
+        ev.data.ptr = task;
+        if (::epoll_ctl(epoll_fd_, op, fd, &ev) < 0)
+        {
+            throw Exception("epoll_ctl() failed");
+        }
+    }
+
+    /**
+     * Registers the current descriptor set of the node and arms its deadline timer; called by the owner of the task.
+     */
+    void arm(Task& task)
+    {
+        const std::vector<::pollfd> fds = task.driver.getPollFds();
+        for (auto& old : task.registered_fds)
+        {
+            const bool still_there =
+                std::any_of(fds.begin(), fds.end(), [&](const ::pollfd& p) { return p.fd == old.fd; });
+            if (!still_there)
+            {
+                control(EPOLL_CTL_DEL, old.fd, 0, nullptr);
+            }
+        }
+        for (auto& p : fds)
+        {
+            const bool known = std::any_of(task.registered_fds.begin(), task.registered_fds.end(),
+                                           [&](const ::pollfd& old) { return old.fd == p.fd; });
+            control(known ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, p.fd, toEpollEvents(p.events), &task);
+        }
+        task.registered_fds = fds;
+
+        const uavcan::MonotonicTime deadline = task.node.getScheduler().getNextWakeupTime();
+        const std::uint64_t usec = std::max<std::uint64_t>(deadline.toUSec(), 1);
+        auto its = ::itimerspec();
+        its.it_value.tv_sec = ::time_t(usec / 1000000U);
+        its.it_value.tv_nsec = long((usec % 1000000U) * 1000U);
+        if (::timerfd_settime(task.timer_fd, TFD_TIMER_ABSTIME, &its, nullptr) < 0)
+        {
+            throw Exception("timerfd_settime() failed");
+        }
+        control(EPOLL_CTL_MOD, task.timer_fd, EPOLLIN | EPOLLONESHOT, &task);
+        control(EPOLL_CTL_MOD, task.post_fd, EPOLLIN | EPOLLONESHOT, &task);
+    }
+
+    /**
+     * Claims the task for the worker. If the task is running already, its owner is told to run it once more,
+     * since the event that brought us here could have been disarmed before the owner re-armed it.
+     */
+    static void schedule(Task& task, Worker& worker)
+    {
+        while (true)
+        {
+            int expected = TaskIdle;
+            if (task.state.compare_exchange_strong(expected, TaskQueued))
+            {
+                std::lock_guard<std::mutex> lock(worker.mutex);
+                worker.queue.push_back(&task);
+                return;
+            }
+            task.rerun = true;
+            if (task.state.load() != TaskIdle)
+            {
+                return;                                 // The owner will see the flag
+            }
+        }
+    }
+
+    void runTask(Task& task, Worker& worker)
+    {
+        task.state = TaskRunning;
+        task.rerun = false;
+
+        std::uint64_t counter = 0;
+        (void)::read(task.post_fd, &counter, sizeof(counter));
+        std::deque<std::function<void ()>> functions;
+        {
+            std::lock_guard<std::mutex> lock(task.mutex);
+            functions.swap(task.posted_functions);
+        }
+        const auto started_at = std::chrono::steady_clock::now();
+        int res = 0;
+        try
+        {
+            for (auto& fn : functions)
+            {
+                fn();
+            }
+            res = task.node.spinOnce();
+        }
+        catch (const std::exception& ex)
+        {
+            UAVCAN_TRACE("MultiNodeReactor", "Node failed: %s", ex.what());
+            res = -uavcan::ErrFailure;
+        }
+        const auto run_usec =
+            std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started_at);
+        {
+            std::lock_guard<std::mutex> lock(task.mutex);
+            task.stats.num_runs++;
+            task.stats.total_run_usec += std::uint64_t(run_usec.count());
+            if (res < 0)
+            {
+                task.stats.num_errors++;
+                task.stats.last_error = res;
+            }
+        }
+        worker.num_runs++;
+
+        arm(task);
+        task.state = TaskIdle;
+        if (task.rerun.exchange(false))
+        {
+            schedule(task, worker);
+        }
+    }
+
+    Task* popOwn(Worker& worker)
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if (worker.queue.empty())
+        {
+            return nullptr;
+        }
+        Task* const task = worker.queue.front();
+        worker.queue.pop_front();
+        return task;
+    }
+
+    Task* steal(Worker& thief)
+    {
+        for (auto& victim : workers_)
+        {
+            if (victim.get() == &thief)
+            {
+                continue;
+            }
+            std::lock_guard<std::mutex> lock(victim->mutex);
+            if (!victim->queue.empty())
+            {
+                Task* const task = victim->queue.back();
+                victim->queue.pop_back();
+                thief.num_steals++;
+                return task;
+            }
+        }
+        return nullptr;
+    }
+
+    void setAffinity(unsigned worker_index)
+    {
+        if (config_.cpu_affinity.empty())
+        {
+            return;
+        }
+        ::cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        CPU_SET(config_.cpu_affinity[worker_index % config_.cpu_affinity.size()], &cpuset);
+        (void)::pthread_setaffinity_np(::pthread_self(), sizeof(cpuset), &cpuset);
+    }
+
+    void runWorker(unsigned worker_index)
+    {
+        setAffinity(worker_index);
+        Worker& worker = *workers_[worker_index];
+        std::vector<::epoll_event> events(std::max(config_.max_events_per_wait, 1U));
+
+        while (!stop_requested_)
+        {
+            Task* task = popOwn(worker);
+            if (task == nullptr)
+            {
+                task = steal(worker);
+            }
+            if (task != nullptr)
+            {
+                runTask(*task, worker);
+                continue;
+            }
+
+            const int num_events = ::epoll_wait(epoll_fd_, events.data(), int(events.size()), -1);
+            worker.num_wakeups++;
+            for (int i = 0; i < num_events; i++)
+            {
+                if (events[i].data.ptr != nullptr)
+                {
+                    schedule(*static_cast<Task*>(events[i].data.ptr), worker);
+                }
+            }
+        }
+    }
+
+public:
+    /**
+     * @throws uavcan_linux::Exception.
+     */
+    explicit MultiNodeReactor(const MultiNodeReactorConfig& config = MultiNodeReactorConfig())
+        : config_(config)
+        , stop_requested_(false)
+    {
+        if (config_.num_workers == 0)
+        {
+            throw Exception("At least one worker is required", EINVAL);
+        }
+        epoll_fd_ = ::epoll_create1(EPOLL_CLOEXEC);
+        stop_fd_ = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if ((epoll_fd_ < 0) || (stop_fd_ < 0))
+        {
+            const int error = errno;
+            (void)::close(epoll_fd_);
+            (void)::close(stop_fd_);
+            throw Exception("Failed to create reactor descriptors", error);
+        }
+        control(EPOLL_CTL_ADD, stop_fd_, EPOLLIN, nullptr);
+    }
+
+    ~MultiNodeReactor()
+    {
+        stop();
+        for (auto& t : tasks_)
+        {
+            (void)::close(t->timer_fd);
+            (void)::close(t->post_fd);
+        }
+        (void)::close(stop_fd_);
+        (void)::close(epoll_fd_);
+    }
+
+    MultiNodeReactor(const MultiNodeReactor&) = delete;
+    MultiNodeReactor& operator=(const MultiNodeReactor&) = delete;
+
+    /**
+     * Adds a node; the node must outlive the reactor. Nodes can be added only while the reactor is stopped.
+     * @return Index of the node, to be used with the other methods.
+     * @throws uavcan_linux::Exception if the driver is not pollable or the reactor is running.
+     */
+    unsigned addNode(uavcan::INode& node)
+    {
+        if (running_)
+        {
+            throw Exception("Nodes cannot be added while the reactor is running", EBUSY);
+        }
+        const auto driver =
+            dynamic_cast<const IPollableCanDriver*>(&node.getDispatcher().getCanIOManager().getCanDriver());
+        if (driver == nullptr)
+        {
+            throw Exception("CAN driver does not support external event loops", EINVAL);
+        }
+
+        std::unique_ptr<Task> task(new Task(node, *driver));
+        task->timer_fd = ::timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+        task->post_fd = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if ((task->timer_fd < 0) || (task->post_fd < 0))
+        {
+            const int error = errno;
+            (void)::close(task->timer_fd);
+            (void)::close(task->post_fd);
+            throw Exception("Failed to create node descriptors", error);
+        }
+        control(EPOLL_CTL_ADD, task->timer_fd, EPOLLONESHOT, task.get());  // Armed on start
+        control(EPOLL_CTL_ADD, task->post_fd, EPOLLONESHOT, task.get());
+        tasks_.push_back(std::move(task));
+        return unsigned(tasks_.size() - 1U);
+    }
+
+    /**
+     * Starts the workers.
+     * @throws uavcan_linux::Exception.
+     */
+    void start()
+    {
+        if (running_)
+        {
+            throw Exception("Reactor is already running", EBUSY);
+        }
+        std::uint64_t counter = 0;
+        (void)::read(stop_fd_, &counter, sizeof(counter));
+        stop_requested_ = false;
+
+        for (auto& t : tasks_)
+        {
+            t->state = TaskIdle;                        // Tasks that were queued when stopped are dropped
+            t->rerun = false;
+            arm(*t);
+        }
+        workers_.clear();
+        for (unsigned i = 0; i < config_.num_workers; i++)
+        {
+            workers_.emplace_back(new Worker);
+        }
+        for (unsigned i = 0; i < config_.num_workers; i++)
+        {
+            workers_[i]->thread = std::thread([this, i]() { runWorker(i); });
+        }
+        running_ = true;
+    }
+
+    /**
+     * Stops the workers and waits for them to exit; the nodes can be accessed directly after that.
+     */
+    void stop()
+    {
+        if (!running_)
+        {
+            return;
+        }
+        stop_requested_ = true;
+        const std::uint64_t one = 1;
+        (void)::write(stop_fd_, &one, sizeof(one));     // Level triggered, wakes up all workers
+        for (auto& w : workers_)
+        {
+            w->thread.join();
+        }
+        running_ = false;
+    }
+
+    bool isRunning() const { return running_; }
+
+    /**
+     * Schedules the function to be executed by the worker that owns the node, where it can access the node safely.
+     * Thread safe.
+     */
+    void post(unsigned node_index, const std::function<void ()>& fn)
+    {
+        Task& task = *tasks_.at(node_index);
+        {
+            std::lock_guard<std::mutex> lock(task.mutex);
+            task.posted_functions.push_back(fn);
+        }
+        const std::uint64_t one = 1;
+        (void)::write(task.post_fd, &one, sizeof(one));
+    }
+
+    unsigned getNumNodes() const { return unsigned(tasks_.size()); }
+
+    uavcan::INode& getNode(unsigned node_index) { return tasks_.at(node_index)->node; }
+
+    /**
+     * Thread safe.
+     */
+    NodeStats getNodeStats(unsigned node_index) const
+    {
+        Task& task = *tasks_.at(node_index);
+        std::lock_guard<std::mutex> lock(task.mutex);
+        return task.stats;
+    }
+
+    /**
+     * Valid after the reactor has been started. Thread safe.
+     */
+    WorkerStats getWorkerStats(unsigned worker_index) const
+    {
+        const Worker& worker = *workers_.at(worker_index);
+        WorkerStats stats;
+        stats.num_runs = worker.num_runs;
+        stats.num_steals = worker.num_steals;
+        stats.num_wakeups = worker.num_wakeups;
+        return stats;
+    }
+
+    const MultiNodeReactorConfig& getConfig() const { return config_; }
+};
+
+}
@@ -0,0 +1,384 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <uavcan/node/abstract_node.hpp>
+#include <uavcan_linux/exception.hpp>
+#include <uavcan_linux/socketcan.hpp>
+
+namespace uavcan_linux
+{
+/**
+ * Parameters of @ref RealTimeSpinThread.
+ */
+struct RealTimeSpinConfig
+{
+    /**
+     * SCHED_FIFO priority of the spin thread, 1 to 99. Zero keeps the default scheduling policy.
+     * Requires CAP_SYS_NICE or an appropriate RLIMIT_RTPRIO.
+     */
+    int sched_priority = 0;
+
+    /**
+     * CPUs the spin thread is allowed to run on; empty keeps the inherited affinity.
+     * Pinning it to an isolated core (isolcpus=, nohz_full=) gives the best results.
+     */
+    std::vector<unsigned> cpu_affinity;
+
+    /**
+     * Lock all current and future memory of the process (mlockall()), and prefault the node's memory pool and
+     * the stack of the spin thread, so that there are no page faults while the node is running.
+     * Requires CAP_IPC_LOCK or a sufficient RLIMIT_MEMLOCK.
+     */
+    bool lock_memory = true;
+
+    /**
+     * If nonzero, SO_BUSY_POLL is set on all SocketCAN ifaces of the node, see @ref SocketCanIface::setBusyPoll().
+     * Note that poll() does busy polling only if the net.core.busy_poll sysctl is nonzero as well.
+     */
+    unsigned busy_poll_usec = 0;
+
+    /**
+     * The node is spun in chunks of this duration; it defines how fast the thread reacts to stop() and post(),
+     * and it is the period of the scheduling latency measurements.
+     */
+    uavcan::MonotonicDuration spin_period = uavcan::MonotonicDuration::fromMSec(1);
+};
+
+/**
+ * How late the spin thread wakes up after the node's spin() deadline; see @ref RealTimeSpinThread.
+ */
+struct SchedulingLatencyStats
+{
+    static constexpr unsigned NumHistogramBins = 16;
+
+    std::uint64_t num_samples = 0;
+    std::uint64_t min_usec = 0;
+    std::uint64_t max_usec = 0;
+    std::uint64_t sum_usec = 0;
+
+    /**
+     * Bin 0 counts the wakeups delayed by less than 1 usec, bin N by [2^(N-1), 2^N) usec;
+     * the last bin counts all longer delays.
+     */
+    std::uint64_t histogram[NumHistogramBins] = {};
+
+    double getMeanUSec() const { return (num_samples > 0) ? (double(sum_usec) / double(num_samples)) : 0.0; }
+
+    void add(std::uint64_t latency_usec)
+    {
+        min_usec = (num_samples > 0) ? std::min(min_usec, latency_usec) : latency_usec;
+        max_usec = std::max(max_usec, latency_usec);
+        sum_usec += latency_usec;
+        num_samples++;
+
+        unsigned bin = 0;
+        while ((latency_usec > 0) && (bin < (NumHistogramBins - 1)))
+        {
+            latency_usec >>= 1;
+            bin++;
+        }
+        histogram[bin]++;
+    }
+};
+
+/**
+ * Runs a node on a dedicated thread configured for real-time operation, see @ref RealTimeSpinConfig.
+ *
+ * While the thread is running, the node must not be accessed from other threads directly, since libuavcan is
+ * not thread safe; instead, the functions passed to @ref post() are executed on the spin thread between
+ * the spin() calls. The node must outlive this object.
+ *
+ * Every spin() call ends at a known deadline. The difference between the deadline and the time the thread
+ * actually got control back is sampled continuously, giving the scheduling latency statistics; this is
+ * the same metric that cyclictest reports.
+ */
+class RealTimeSpinThread
+{
+public:
+    /**
+     * Size of the stack region that is touched on startup when the memory is locked.
+     */
+    static constexpr std::size_t StackPrefaultSize = 64 * 1024;
+
+private:
+    uavcan::INode& node_;
+    const RealTimeSpinConfig config_;
+
+    std::thread thread_;
+    std::atomic<bool> stop_requested_;
+    std::atomic<bool> has_posted_functions_;
+
+    mutable std::mutex mutex_;
+    std::deque<std::function<void ()>> posted_functions_;
+    SchedulingLatencyStats latency_stats_;
+    std::uint64_t num_spin_errors_ = 0;
+    int last_spin_error_ = 0;
+
+    static void enforce(int res, const std::string& msg)
+    {
+        if (res != 0)
+        {
+            throw Exception(msg, (res > 0) ? res : errno);
+        }
+    }
+
+    static void prefaultStack()
+    {
+        volatile unsigned char stack[StackPrefaultSize];
+        for (std::size_t i = 0; i < StackPrefaultSize; i++)
+        {
+            stack[i] = 0;
+        }
+        (void)stack;
+    }
+
+    /**
+     * Touches all blocks of the pool, so that its pages get mapped now rather than on first use.
+     */
+    void prefaultPool()
+    {
+        uavcan::IPoolAllocator& allocator = node_.getAllocator();
+        std::vector<void*> blocks;
+        blocks.reserve(allocator.getBlockCapacity());
+        while (blocks.size() < allocator.getBlockCapacity())
+        {
+            void* const p = allocator.allocate(uavcan::MemPoolBlockSize);
+            if (p == nullptr)
+            {
+                break;
+            }
+            std::memset(p, 0, uavcan::MemPoolBlockSize);
+            blocks.push_back(p);
+        }
+        for (auto p : blocks)
+        {
+            allocator.deallocate(p);
+        }
+    }
+
+    void setupBusyPoll()
+    {
+        uavcan::ICanDriver& driver = node_.getDispatcher().getCanIOManager().getCanDriver();
+        for (std::uint8_t i = 0; i < driver.getNumIfaces(); i++)
+        {
+            auto iface = dynamic_cast<SocketCanIface*>(driver.getIface(i));
+            if (iface == nullptr)
+            {
+                throw Exception("Busy polling requires SocketCAN ifaces", EINVAL);
+            }
+            enforce(iface->setBusyPoll(config_.busy_poll_usec), "Failed to set SO_BUSY_POLL");
+        }
+    }
+
+    /**
+     * Executed on the spin thread.
+     */
+    void setup()
+    {
+        if (!config_.cpu_affinity.empty())
+        {
+            ::cpu_set_t cpuset;
+            CPU_ZERO(&cpuset);
+            for (auto cpu : config_.cpu_affinity)
+            {
+                CPU_SET(cpu, &cpuset);
+            }
+            enforce(::pthread_setaffinity_np(::pthread_self(), sizeof(cpuset), &cpuset), "Failed to set affinity");
+        }
+
+        if (config_.sched_priority > 0)
+        {
+            ::sched_param param = ::sched_param();
+            param.sched_priority = config_.sched_priority;
+            enforce(::pthread_setschedparam(::pthread_self(), SCHED_FIFO, &param), "Failed to set SCHED_FIFO");
+        }
+
+        if (config_.lock_memory)
+        {
+            enforce(::mlockall(MCL_CURRENT | MCL_FUTURE), "mlockall() failed");
+            prefaultStack();
+            prefaultPool();
+        }
+
+        if (config_.busy_poll_usec > 0)
+        {
+            setupBusyPoll();
+        }
+    }
+
+    void runPostedFunctions()
+    {
+        std::deque<std::function<void ()>> functions;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            functions.swap(posted_functions_);
+            has_posted_functions_ = false;
+        }
+        for (auto& fn : functions)
+        {
+            fn();
+        }
+    }
+
+    void run()
+    {
+        while (!stop_requested_)
+        {
+            if (has_posted_functions_)
+            {
+                runPostedFunctions();
+            }
+
+            const uavcan::MonotonicTime deadline = node_.getMonotonicTime() + config_.spin_period;
+            const int res = node_.spin(deadline);
+            const uavcan::MonotonicTime ts = node_.getMonotonicTime();
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (res < 0)
+            {
+                num_spin_errors_++;
+                last_spin_error_ = res;
+            }
+            else if (ts >= deadline)
+            {
+                latency_stats_.add(static_cast<std::uint64_t>((ts - deadline).toUSec()));
+            }
+            else
+            {
+                ;   // Returned early, nothing to measure
+            }
+        }
+        runPostedFunctions();
+    }
+
+public:
+    RealTimeSpinThread(uavcan::INode& node, const RealTimeSpinConfig& config = RealTimeSpinConfig())
+        : node_(node)
+        , config_(config)
+        , stop_requested_(false)
+        , has_posted_functions_(false)
+    { }
+
+    ~RealTimeSpinThread() { stop(); }
+
+    /**
+     * Starts the spin thread and waits until it's configured.
+     * If the configuration fails, the thread is terminated and the error is thrown from here.
+     * @throws uavcan_linux::Exception.
+     */
+    void start()
+    {
+        if (thread_.joinable())
+        {
+            throw Exception("Spin thread is already running", EBUSY);
+        }
+        stop_requested_ = false;
+
+        // Shared with the thread, since it may still be inside set_value() when the future becomes ready
+        const auto setup_result = std::make_shared<std::promise<void>>();
+        std::future<void> setup_done = setup_result->get_future();
+        thread_ = std::thread([this, setup_result]()
+        {
+            try
+            {
+                setup();
+            }
+            catch (...)
+            {
+                setup_result->set_exception(std::current_exception());
+                return;
+            }
+            setup_result->set_value();
+            run();
+        });
+
+        try
+        {
+            setup_done.get();
+        }
+        catch (...)
+        {
+            thread_.join();
+            throw;
+        }
+    }
+
+    /**
+     * Stops the spin thread and waits for it to exit; the pending posted functions are executed before that.
+     * The memory stays locked.
+     */
+    void stop()
+    {
+        if (thread_.joinable())
+        {
+            stop_requested_ = true;
+            thread_.join();
+        }
+    }
+
+    bool isRunning() const { return thread_.joinable(); }
+
+    /**
+     * Schedules the function to be executed on the spin thread, where it can access the node safely.
+     * Thread safe.
+     */
+    void post(const std::function<void ()>& fn)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        posted_functions_.push_back(fn);
+        has_posted_functions_ = true;
+    }
+
+    /**
+     * Thread safe.
+     */
+    SchedulingLatencyStats getLatencyStats() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return latency_stats_;
+    }
+
+    void resetLatencyStats()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        latency_stats_ = SchedulingLatencyStats();
+    }
+
+    /**
+     * Errors returned by spin() don't stop the thread; they are counted instead. Thread safe.
+     */
+    std::uint64_t getNumSpinErrors() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return num_spin_errors_;
+    }
+
+    int getLastSpinError() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return last_spin_error_;
+    }
+
+    const RealTimeSpinConfig& getConfig() const { return config_; }
+};
+
+}
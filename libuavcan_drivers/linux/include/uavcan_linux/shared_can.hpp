@@ -0,0 +1,1034 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <uavcan/error.hpp>
+#include <uavcan/driver/can.hpp>
+#include <uavcan_linux/clock.hpp>
+#include <uavcan_linux/exception.hpp>
+#include <uavcan_linux/socketcan.hpp>
+
+namespace uavcan_linux
+{
+/**
+ * Frame record in the shared memory segment of @ref SharedCanBroker.
+ * The layout does not depend on the build configuration (e.g. UAVCAN_CAN_FD), so the broker and the clients
+ * need not be built identically.
+ */
+struct SharedCanFrame
+{
+    static constexpr unsigned MaxDataLen = 64;
+
+    std::uint32_t id = 0;               ///< uavcan::CanFrame::id, with its flags
+    std::uint32_t origin = 0;           ///< Client ID of the sender; zero if the frame has come from the bus
+    std::uint64_t ts_mono_usec = 0;     ///< RX timestamp; in the TX ring, the TX deadline
+    std::uint64_t ts_utc_usec = 0;
+    std::uint16_t flags = 0;            ///< uavcan::CanIOFlags requested by the sender
+    std::uint8_t iface_index = 0;
+    std::uint8_t dlc = 0;
+    std::uint8_t data[MaxDataLen] = {};
+
+    SharedCanFrame() { }
+
+    SharedCanFrame(const uavcan::CanFrame& frame, std::uint8_t arg_iface_index)
+        : id(frame.id)
+        , iface_index(arg_iface_index)
+        , dlc(frame.dlc)
+    {
+        (void)std::copy(frame.data, frame.data + frame.dlc, data);
+    }
+
+    uavcan::CanFrame toCanFrame() const
+    {
+        return uavcan::CanFrame(id, data, std::uint8_t(std::min<unsigned>(dlc, uavcan::CanFrame::MaxDataLen)));
+    }
+
+    bool isSameFrame(const SharedCanFrame& rhs) const
+    {
+        return (id == rhs.id) && (iface_index == rhs.iface_index) && (dlc == rhs.dlc) &&
+               std::equal(data, data + std::min<unsigned>(dlc, MaxDataLen), rhs.data);
+    }
+};
+
+static_assert((ATOMIC_INT_LOCK_FREE == 2) && (ATOMIC_LLONG_LOCK_FREE == 2),
+              "Atomics must be lock free to be used in shared memory");
+
+/**
+ * Layout of the shared memory segment. The ring indexes grow monotonically; the slot is the index modulo capacity.
+ *  - RX ring: written by the broker only, read by every client independently. A slot is a seqlock: its sequence
+ *    is 2*index+1 while the frame is being written, and 2*index+2 afterwards, so a client that has been lapped by
+ *    the broker detects that and counts the overwritten frames as lost.
+ *  - TX ring: bounded multi-producer single-consumer queue (D. Vyukov); the sequence of a slot equals the index when
+ *    the slot is free, and index+1 when it contains a frame.
+ */
+struct SharedCanSegmentLayout
+{
+    static constexpr std::uint32_t Magic = 0x53434E55;     ///< "UNCS"
+    static constexpr std::uint32_t Version = 1;
+    static constexpr unsigned RxRingCapacity = 4096;
+    static constexpr unsigned TxRingCapacity = 1024;
+
+    struct Slot
+    {
+        std::atomic<std::uint64_t> sequence;
+        SharedCanFrame frame;
+    };
+
+    std::atomic<std::uint32_t> magic;               ///< Written last by the broker, once the segment is initialized
+    std::uint32_t version;
+    std::uint32_t layout_size;
+    std::uint32_t num_ifaces;
+    std::atomic<std::uint32_t> next_client_id;
+
+    /*
+     * Futex words are incremented on every change. The waiter counters allow to skip FUTEX_WAKE if nobody waits.
+     */
+    alignas(64) std::atomic<std::uint32_t> rx_futex;
+    std::atomic<std::uint32_t> rx_waiters;
+    alignas(64) std::atomic<std::uint32_t> tx_futex;
+    std::atomic<std::uint32_t> tx_waiters;
+
+    alignas(64) std::atomic<std::uint64_t> rx_head;
+    alignas(64) std::atomic<std::uint64_t> tx_enqueue_pos;
+    alignas(64) std::atomic<std::uint64_t> tx_dequeue_pos;
+
+    Slot rx_ring[RxRingCapacity];
+    Slot tx_ring[TxRingCapacity];
+};
+
+/**
+ * Shared memory segment (shm_open()) used by @ref SharedCanBroker and @ref SharedCanDriver.
+ * The broker creates it and removes it when destroyed; the clients open it by name.
+ */
+class SharedCanSegment
+{
+    const std::string name_;
+    const bool owner_;
+    int fd_ = -1;
+    SharedCanSegmentLayout* layout_ = nullptr;
+
+    SharedCanSegment(const std::string& name, bool owner)
+        : name_(name)
+        , owner_(owner)
+    { }
+
+    void map()
+    {
+        void* const p = ::mmap(nullptr, sizeof(SharedCanSegmentLayout), PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+        if (p == MAP_FAILED)
+        {
+            throw Exception("Failed to map the shared CAN segment " + name_);
+        }
+        layout_ = static_cast<SharedCanSegmentLayout*>(p);
+    }
+
+    static void futexWait(std::atomic<std::uint32_t>& word, std::uint32_t expected, std::int64_t timeout_usec)
+    {
+        auto ts = ::timespec();
+        ts.tv_sec = timeout_usec / 1000000LL;
+        ts.tv_nsec = (timeout_usec % 1000000LL) * 1000;
+        (void)::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAIT, expected, &ts, nullptr, 0);
+    }
+
+    static void futexWake(std::atomic<std::uint32_t>& word)
+    {
+        (void)::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+    }
+
+    static void notify(std::atomic<std::uint32_t>& word, const std::atomic<std::uint32_t>& waiters)
+    {
+        word.fetch_add(1);
+        if (waiters.load() > 0)
+        {
+            futexWake(word);
+        }
+    }
+
+    static void wait(std::atomic<std::uint32_t>& word, std::atomic<std::uint32_t>& waiters,
+                     std::uint32_t seen, std::int64_t timeout_usec)
+    {
+        if (timeout_usec <= 0)
+        {
+            return;
+        }
+        waiters.fetch_add(1);
+        if (word.load() == seen)
+        {
+            futexWait(word, seen, timeout_usec);
+        }
+        waiters.fetch_sub(1);
+    }
+
+public:
+    static const char* getDefaultName() { return "/uavcan_can"; }
+
+    /**
+     * Creates the segment; a stale segment with the same name, e.g. left by a crashed broker, is replaced.
+     * @throws uavcan_linux::Exception.
+     */
+    static std::shared_ptr<SharedCanSegment> create(const std::string& name, unsigned num_ifaces)
+    {
+        if ((num_ifaces == 0) || (num_ifaces > uavcan::MaxCanIfaces))
+        {
+            throw Exception("Invalid number of ifaces", EINVAL);
+        }
+        std::shared_ptr<SharedCanSegment> seg(new SharedCanSegment(name, true));
+
+        (void)::shm_unlink(name.c_str());
+        seg->fd_ = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0660);
+        if (seg->fd_ < 0)
+        {
+            throw Exception("Failed to create the shared CAN segment " + name);
+        }
+        if (::ftruncate(seg->fd_, sizeof(SharedCanSegmentLayout)) < 0)
+        {
+            throw Exception("Failed to allocate the shared CAN segment " + name);
+        }
+        seg->map();
+
+        // The memory is zero-filled by the kernel
+        SharedCanSegmentLayout& l = *seg->layout_;
+        l.version = SharedCanSegmentLayout::Version;
+        l.layout_size = sizeof(SharedCanSegmentLayout);
+        l.num_ifaces = num_ifaces;
+        l.next_client_id = 1;                           // Zero denotes the bus
+        for (unsigned i = 0; i < SharedCanSegmentLayout::TxRingCapacity; i++)
+        {
+            l.tx_ring[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        l.magic.store(SharedCanSegmentLayout::Magic, std::memory_order_release);
+        return seg;
+    }
+
+    /**
+     * Opens the segment created by the broker.
+     * @throws uavcan_linux::Exception if the segment does not exist or is incompatible.
+     */
+    static std::shared_ptr<SharedCanSegment> open(const std::string& name)
+    {
+        std::shared_ptr<SharedCanSegment> seg(new SharedCanSegment(name, false));
+
+        seg->fd_ = ::shm_open(name.c_str(), O_RDWR | O_CLOEXEC, 0);
+        if (seg->fd_ < 0)
+        {
+            throw Exception("Failed to open the shared CAN segment " + name + "; is the broker running?");
+        }
+        struct ::stat st = {};
+        if ((::fstat(seg->fd_, &st) < 0) || (std::size_t(st.st_size) < sizeof(SharedCanSegmentLayout)))
+        {
+            throw Exception("Invalid shared CAN segment " + name, EINVAL);
+        }
+        seg->map();
+
+        const SharedCanSegmentLayout& l = *seg->layout_;
+        if ((l.magic.load(std::memory_order_acquire) != SharedCanSegmentLayout::Magic) ||
+            (l.version != SharedCanSegmentLayout::Version) ||
+            (l.layout_size != sizeof(SharedCanSegmentLayout)) ||
+            (l.num_ifaces == 0) || (l.num_ifaces > uavcan::MaxCanIfaces))
+        {
+            throw Exception("Incompatible shared CAN segment " + name, EINVAL);
+        }
+        return seg;
+    }
+
+    ~SharedCanSegment()
+    {
+        if (layout_ != nullptr)
+        {
+            (void)::munmap(layout_, sizeof(SharedCanSegmentLayout));
+        }
+        if (fd_ >= 0)
+        {
+            (void)::close(fd_);
+        }
+        if (owner_)
+        {
+            (void)::shm_unlink(name_.c_str());
+        }
+    }
+
+    SharedCanSegment(const SharedCanSegment&) = delete;
+    SharedCanSegment& operator=(const SharedCanSegment&) = delete;
+
+    const std::string& getName() const { return name_; }
+    unsigned getNumIfaces() const { return layout_->num_ifaces; }
+
+    std::uint32_t allocateClientID()
+    {
+        std::uint32_t id = 0;
+        while (id == 0)
+        {
+            id = layout_->next_client_id.fetch_add(1);
+        }
+        return id;
+    }
+
+    /*
+     * TX ring, multiple producers (clients) and a single consumer (broker).
+     */
+    bool pushTx(const SharedCanFrame& frame)
+    {
+        SharedCanSegmentLayout& l = *layout_;
+        std::uint64_t pos = l.tx_enqueue_pos.load(std::memory_order_relaxed);
+        SharedCanSegmentLayout::Slot* slot = nullptr;
+        while (true)
+        {
+            slot = &l.tx_ring[pos % SharedCanSegmentLayout::TxRingCapacity];
+            const std::uint64_t seq = slot->sequence.load(std::memory_order_acquire);
+            const std::int64_t diff = std::int64_t(seq - pos);
+            if (diff == 0)
+            {
+                if (l.tx_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false;                           // Full
+            }
+            else
+            {
+                pos = l.tx_enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+        slot->frame = frame;
+        slot->sequence.store(pos + 1, std::memory_order_release);
+        notify(l.tx_futex, l.tx_waiters);
+        return true;
+    }
+
+    bool popTx(SharedCanFrame& out_frame)
+    {
+        SharedCanSegmentLayout& l = *layout_;
+        const std::uint64_t pos = l.tx_dequeue_pos.load(std::memory_order_relaxed);
+        SharedCanSegmentLayout::Slot& slot = l.tx_ring[pos % SharedCanSegmentLayout::TxRingCapacity];
+        if (slot.sequence.load(std::memory_order_acquire) != (pos + 1))
+        {
+            return false;                               // Empty, or the producer has not finished writing yet
+        }
+        out_frame = slot.frame;
+        slot.sequence.store(pos + SharedCanSegmentLayout::TxRingCapacity, std::memory_order_release);
+        l.tx_dequeue_pos.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool isTxFull() const
+    {
+        return (layout_->tx_enqueue_pos.load(std::memory_order_acquire) -
+                layout_->tx_dequeue_pos.load(std::memory_order_acquire)) >= SharedCanSegmentLayout::TxRingCapacity;
+    }
+
+    std::uint32_t getTxEventCount() const { return layout_->tx_futex.load(); }
+
+    void waitForTx(std::uint32_t seen_event_count, std::int64_t timeout_usec)
+    {
+        wait(layout_->tx_futex, layout_->tx_waiters, seen_event_count, timeout_usec);
+    }
+
+    /*
+     * RX ring, a single producer (broker) and any number of independent readers (clients).
+     * The producer must call notifyRx() after publishing, possibly once per many frames.
+     */
+    void publishRx(const SharedCanFrame& frame)
+    {
+        SharedCanSegmentLayout& l = *layout_;
+        const std::uint64_t pos = l.rx_head.load(std::memory_order_relaxed);
+        SharedCanSegmentLayout::Slot& slot = l.rx_ring[pos % SharedCanSegmentLayout::RxRingCapacity];
+        slot.sequence.store(pos * 2 + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.frame = frame;
+        slot.sequence.store(pos * 2 + 2, std::memory_order_release);
+        l.rx_head.store(pos + 1, std::memory_order_release);
+    }
+
+    void notifyRx() { notify(layout_->rx_futex, layout_->rx_waiters); }
+
+    std::uint64_t getRxHead() const { return layout_->rx_head.load(std::memory_order_acquire); }
+
+    /**
+     * Reads the frame at the specified position and advances it. If the reader has fallen behind by more than the
+     * capacity of the ring, it skips the overwritten frames, adding their number to inout_num_lost.
+     * @return False if there are no new frames.
+     */
+    bool readRx(std::uint64_t& inout_pos, SharedCanFrame& out_frame, std::uint64_t& inout_num_lost) const
+    {
+        const SharedCanSegmentLayout& l = *layout_;
+        while (true)
+        {
+            const std::uint64_t head = l.rx_head.load(std::memory_order_acquire);
+            if (inout_pos >= head)
+            {
+                return false;
+            }
+            if ((head - inout_pos) > SharedCanSegmentLayout::RxRingCapacity)
+            {
+                const std::uint64_t new_pos = head - SharedCanSegmentLayout::RxRingCapacity;
+                inout_num_lost += new_pos - inout_pos;
+                inout_pos = new_pos;
+            }
+
+            const SharedCanSegmentLayout::Slot& slot = l.rx_ring[inout_pos % SharedCanSegmentLayout::RxRingCapacity];
+            const std::uint64_t expected_seq = inout_pos * 2 + 2;
+            const std::uint64_t seq_before = slot.sequence.load(std::memory_order_acquire);
+            out_frame = slot.frame;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            const std::uint64_t seq_after = slot.sequence.load(std::memory_order_relaxed);
+
+            inout_pos++;
+            if ((seq_before == expected_seq) && (seq_after == expected_seq))
+            {
+                return true;
+            }
+            inout_num_lost++;                           // Overwritten while being read
+        }
+    }
+
+    std::uint32_t getRxEventCount() const { return layout_->rx_futex.load(); }
+
+    void waitForRx(std::uint32_t seen_event_count, std::int64_t timeout_usec)
+    {
+        wait(layout_->rx_futex, layout_->rx_waiters, seen_event_count, timeout_usec);
+    }
+};
+
+/**
+ * Owns the SocketCAN interfaces on behalf of many processes, which access the bus via @ref SharedCanDriver.
+ *
+ * Without the broker, every process opens its own socket, and the kernel clones every frame into each of them.
+ * With the broker, every received frame is read from the socket once and published into a ring buffer in shared
+ * memory, which the clients read without system calls; the clients are woken up via a futex only when they are
+ * blocked in select(), and the broker skips the wakeup system call if no client is waiting.
+ * The frames transmitted by the clients are queued into another shared ring, from which the broker writes them into
+ * the sockets. They are also delivered to the other clients, like they would be by the kernel, and to the sender if
+ * it has requested the loopback (e.g. for time synchronization), timestamped by the kernel when the frame has been
+ * transmitted.
+ *
+ * The broker runs two threads: the RX thread blocks on the sockets, the TX thread waits for the clients on the futex
+ * of the TX ring. The TX ring is FIFO across the clients, so the clients' frames are prioritized only within each
+ * process, by the library; frames that have not been written until their TX deadline are dropped and counted.
+ *
+ * Limitations: a client that has crashed in the middle of pushing a frame (a few instructions) stalls the TX ring
+ * until the broker is restarted; the clients are not notified if the broker exits.
+ */
+class SharedCanBroker
+{
+    /**
+     * Frames written by the TX thread that have not been observed by the RX thread yet.
+     */
+    static constexpr unsigned MaxInFlightFrames = 256;
+
+    static constexpr std::int64_t StopCheckPeriodUSec = 100000;
+
+    SystemClock clock_;
+    const std::shared_ptr<SharedCanSegment> segment_;
+    std::vector<std::unique_ptr<SocketCanIface>> rx_ifaces_;   ///< Receive everything, including the loopback
+    std::vector<int> tx_fds_;                                  ///< Transmit only, nothing is received
+    const int stop_event_fd_;
+
+    std::thread rx_thread_;
+    std::thread tx_thread_;
+    std::atomic<bool> stop_requested_;
+
+    std::mutex in_flight_mutex_;
+    std::deque<SharedCanFrame> in_flight_;
+
+    std::atomic<std::uint64_t> num_rx_frames_{0};
+    std::atomic<std::uint64_t> num_tx_frames_{0};
+    std::atomic<std::uint64_t> num_tx_timeouts_{0};
+    std::atomic<std::uint64_t> num_tx_errors_{0};
+
+    void addInFlight(const SharedCanFrame& frame)
+    {
+        std::lock_guard<std::mutex> lock(in_flight_mutex_);
+        if (in_flight_.size() >= MaxInFlightFrames)
+        {
+            in_flight_.pop_front();
+        }
+        in_flight_.push_back(frame);
+    }
+
+    /**
+     * The frames written by the TX thread are received by the RX thread via the kernel's local loopback.
+     * This is where the origin of the frame is restored.
+     */
+    void claimInFlight(SharedCanFrame& frame)
+    {
+        std::lock_guard<std::mutex> lock(in_flight_mutex_);
+        for (auto it = in_flight_.begin(); it != in_flight_.end(); ++it)
+        {
+            if (it->isSameFrame(frame))
+            {
+                frame.origin = it->origin;
+                frame.flags = it->flags;
+                (void)in_flight_.erase(it);
+                return;
+            }
+        }
+    }
+
+    void removeInFlight(const SharedCanFrame& frame)
+    {
+        std::lock_guard<std::mutex> lock(in_flight_mutex_);
+        for (auto it = in_flight_.begin(); it != in_flight_.end(); ++it)
+        {
+            if (it->isSameFrame(frame) && (it->origin == frame.origin))
+            {
+                (void)in_flight_.erase(it);
+                return;
+            }
+        }
+    }
+
+    void transmit(const SharedCanFrame& frame)
+    {
+        if (frame.iface_index >= tx_fds_.size())
+        {
+            num_tx_errors_++;
+            return;
+        }
+        const int fd = tx_fds_[frame.iface_index];
+        const uavcan::CanFrame can_frame = frame.toCanFrame();
+
+        addInFlight(frame);             // Before writing, because the RX thread may receive the frame immediately
+        while (true)
+        {
+            if (clock_.getMonotonic().toUSec() > frame.ts_mono_usec)
+            {
+                num_tx_timeouts_++;
+                break;
+            }
+            const int res = SocketCanIface::writeFrame(fd, can_frame);
+            if (res > 0)
+            {
+                num_tx_frames_++;
+                return;
+            }
+            if (res < 0)
+            {
+                num_tx_errors_++;
+                break;
+            }
+            // The socket queue is full; POLLOUT is not reliable for ENOBUFS, so the wait is bounded
+            auto pfd = ::pollfd();
+            pfd.fd = fd;
+            pfd.events = POLLOUT;
+            (void)::poll(&pfd, 1, 1);
+        }
+        removeInFlight(frame);
+    }
+
+    void runTx()
+    {
+        while (!stop_requested_)
+        {
+            const std::uint32_t seen = segment_->getTxEventCount();
+            SharedCanFrame frame;
+            if (segment_->popTx(frame))
+            {
+                transmit(frame);
+            }
+            else
+            {
+                segment_->waitForTx(seen, StopCheckPeriodUSec);
+            }
+        }
+    }
+
+    void runRx()
+    {
+        std::vector<::pollfd> pollfds(rx_ifaces_.size() + 1);
+        for (unsigned i = 0; i < rx_ifaces_.size(); i++)
+        {
+            pollfds[i].fd = rx_ifaces_[i]->getFileDescriptor();
+            pollfds[i].events = POLLIN;
+        }
+        pollfds.back().fd = stop_event_fd_;
+        pollfds.back().events = POLLIN;
+
+        while (!stop_requested_)
+        {
+            if (::poll(pollfds.data(), pollfds.size(), -1) < 0)
+            {
+                continue;                               // EINTR
+            }
+
+            bool published = false;
+            for (unsigned i = 0; i < rx_ifaces_.size(); i++)
+            {
+                if (pollfds[i].revents & (POLLERR | POLLHUP | POLLNVAL))
+                {
+                    int error = 0;
+                    ::socklen_t errlen = sizeof(error);
+                    (void)::getsockopt(pollfds[i].fd, SOL_SOCKET, SO_ERROR, &error, &errlen);
+                    if (error == ENETDOWN || error == ENODEV)
+                    {
+                        UAVCAN_TRACE("SharedCanBroker", "Iface %u is dead; error %d", i, error);
+                        pollfds[i].fd = -1;             // Ignored by poll() from now on
+                        continue;
+                    }
+                }
+                if ((pollfds[i].revents & POLLIN) == 0)
+                {
+                    continue;
+                }
+
+                SocketCanIface& iface = *rx_ifaces_[i];
+                iface.poll(true, false);
+
+                uavcan::CanFrame can_frame;
+                uavcan::MonotonicTime ts_mono;
+                uavcan::UtcTime ts_utc;
+                uavcan::CanIOFlags flags = 0;
+                while (iface.receive(can_frame, ts_mono, ts_utc, flags) > 0)
+                {
+                    SharedCanFrame frame(can_frame, std::uint8_t(i));
+                    frame.ts_mono_usec = ts_mono.toUSec();
+                    frame.ts_utc_usec = ts_utc.toUSec();
+                    claimInFlight(frame);
+                    segment_->publishRx(frame);
+                    published = true;
+                    num_rx_frames_++;
+                }
+            }
+
+            if (published)
+            {
+                segment_->notifyRx();                   // Once per batch
+            }
+        }
+    }
+
+public:
+    /**
+     * Opens the sockets and creates the shared memory segment; the threads are started by @ref start().
+     * The order of the ifaces defines their indexes in the clients.
+     * @throws uavcan_linux::Exception.
+     */
+    SharedCanBroker(const std::vector<std::string>& iface_names,
+                    const std::string& segment_name = SharedCanSegment::getDefaultName(),
+                    SocketCanTimestampMode ts_mode = SocketCanTimestampMode::Software)
+        : segment_(SharedCanSegment::create(segment_name, unsigned(iface_names.size())))
+        , stop_event_fd_(::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK))
+        , stop_requested_(false)
+    {
+        if (stop_event_fd_ < 0)
+        {
+            throw Exception("Failed to create eventfd");
+        }
+        try
+        {
+            for (auto& name : iface_names)
+            {
+                const int rx_fd = SocketCanIface::openSocket(name, ts_mode);
+                if (rx_fd < 0)
+                {
+                    throw Exception("Failed to open iface " + name);
+                }
+                rx_ifaces_.emplace_back(new SocketCanIface(clock_, rx_fd));
+
+                // No echo, and nothing is received
+                const int tx_fd = SocketCanIface::openSocket(name, SocketCanTimestampMode::Software,
+                                                             SocketCanLoopbackMode::Selective);
+                if (tx_fd < 0)
+                {
+                    throw Exception("Failed to open iface " + name);
+                }
+                tx_fds_.push_back(tx_fd);
+                if (::setsockopt(tx_fd, SOL_CAN_RAW, CAN_RAW_FILTER, nullptr, 0) < 0)
+                {
+                    throw Exception("Failed to configure iface " + name);
+                }
+            }
+        }
+        catch (...)
+        {
+            for (int fd : tx_fds_)
+            {
+                (void)::close(fd);
+            }
+            (void)::close(stop_event_fd_);
+            throw;
+        }
+    }
+
+    ~SharedCanBroker()
+    {
+        stop();
+        for (int fd : tx_fds_)
+        {
+            (void)::close(fd);
+        }
+        (void)::close(stop_event_fd_);
+    }
+
+    SharedCanBroker(const SharedCanBroker&) = delete;
+    SharedCanBroker& operator=(const SharedCanBroker&) = delete;
+
+    /**
+     * @throws uavcan_linux::Exception if already running.
+     */
+    void start()
+    {
+        if (rx_thread_.joinable() || tx_thread_.joinable())
+        {
+            throw Exception("Broker is already running", EBUSY);
+        }
+        stop_requested_ = false;
+        rx_thread_ = std::thread(&SharedCanBroker::runRx, this);
+        tx_thread_ = std::thread(&SharedCanBroker::runTx, this);
+    }
+
+    /**
+     * The frames that are still in the TX ring are not transmitted.
+     */
+    void stop()
+    {
+        stop_requested_ = true;
+        const std::uint64_t one = 1;
+        (void)::write(stop_event_fd_, &one, sizeof(one));
+        if (rx_thread_.joinable())
+        {
+            rx_thread_.join();
+        }
+        if (tx_thread_.joinable())
+        {
+            tx_thread_.join();
+        }
+        std::uint64_t dummy = 0;
+        (void)::read(stop_event_fd_, &dummy, sizeof(dummy));
+    }
+
+    bool isRunning() const { return rx_thread_.joinable(); }
+
+    const std::string& getSegmentName() const { return segment_->getName(); }
+
+    /**
+     * Statistics; can be called from any thread.
+     */
+    std::uint64_t getNumRxFrames() const { return num_rx_frames_.load(); }
+    std::uint64_t getNumTxFrames() const { return num_tx_frames_.load(); }
+    std::uint64_t getNumTxTimeouts() const { return num_tx_timeouts_.load(); }
+    std::uint64_t getNumTxErrors() const { return num_tx_errors_.load(); }
+
+    /**
+     * Errors of the sockets, see @ref SocketCanIface::getErrors(). Not thread safe; call while stopped.
+     */
+    const SocketCanIface& getRxIface(unsigned index) const { return *rx_ifaces_.at(index); }
+};
+
+class SharedCanDriver;
+
+/**
+ * One interface of @ref SharedCanDriver.
+ */
+class SharedCanIface : public uavcan::ICanIface
+{
+    friend class SharedCanDriver;
+
+    struct RxItem
+    {
+        uavcan::CanFrame frame;
+        uavcan::MonotonicTime ts_mono;
+        uavcan::UtcTime ts_utc;
+        uavcan::CanIOFlags flags = 0;
+    };
+
+    SharedCanDriver& driver_;
+    SharedCanSegment& segment_;
+    const SystemClock& clock_;
+    const std::uint32_t client_id_;
+    const std::uint8_t index_;
+    FixedCapacityQueue<RxItem> rx_queue_;
+    std::vector<uavcan::CanFilterConfig> filters_;
+    std::uint64_t num_rx_overflows_ = 0;
+
+    bool checkFilters(const uavcan::CanFrame& frame) const
+    {
+        if (filters_.empty())
+        {
+            return true;
+        }
+        for (auto& f : filters_)
+        {
+            if (((frame.id ^ f.id) & f.mask) == 0)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void deliver(const SharedCanFrame& shared_frame)
+    {
+        RxItem item;
+        item.frame = shared_frame.toCanFrame();
+        if (shared_frame.origin == client_id_)
+        {
+            if ((shared_frame.flags & uavcan::CanIOFlagLoopback) == 0)
+            {
+                return;                                 // Our own frame
+            }
+            item.flags = uavcan::CanIOFlagLoopback;
+        }
+        else if (!checkFilters(item.frame))
+        {
+            return;
+        }
+        else
+        {
+            ;   // Accepted
+        }
+        item.ts_mono = uavcan::MonotonicTime::fromUSec(shared_frame.ts_mono_usec);
+        item.ts_utc = uavcan::UtcTime::fromUSec(shared_frame.ts_utc_usec) + clock_.getPrivateAdjustment();
+        if (!rx_queue_.push(item))
+        {
+            num_rx_overflows_++;
+        }
+    }
+
+    SharedCanIface(SharedCanDriver& driver, SharedCanSegment& segment, const SystemClock& clock,
+                   std::uint32_t client_id, std::uint8_t index, unsigned rx_queue_capacity)
+        : driver_(driver)
+        , segment_(segment)
+        , clock_(clock)
+        , client_id_(client_id)
+        , index_(index)
+        , rx_queue_(rx_queue_capacity)
+    { }
+
+public:
+    /**
+     * Returns zero if the TX ring of the broker is full.
+     */
+    std::int16_t send(const uavcan::CanFrame& frame, const uavcan::MonotonicTime tx_deadline,
+                      const uavcan::CanIOFlags flags) override
+    {
+        SharedCanFrame shared_frame(frame, index_);
+        shared_frame.origin = client_id_;
+        shared_frame.flags = flags;
+        shared_frame.ts_mono_usec = tx_deadline.toUSec();
+        return segment_.pushTx(shared_frame) ? 1 : 0;
+    }
+
+    std::int16_t receive(uavcan::CanFrame& out_frame, uavcan::MonotonicTime& out_ts_monotonic,
+                         uavcan::UtcTime& out_ts_utc, uavcan::CanIOFlags& out_flags) override;
+
+    std::int16_t receiveBatch(uavcan::CanRxFrame* out_frames, uavcan::CanIOFlags* out_flags,
+                              std::uint16_t max_frames) override
+    {
+        if ((out_frames == nullptr) || (out_flags == nullptr))
+        {
+            return -uavcan::ErrInvalidParam;
+        }
+        std::uint16_t num_received = 0;
+        while (num_received < max_frames)
+        {
+            uavcan::CanRxFrame& f = out_frames[num_received];
+            const std::int16_t res = receive(f, f.ts_mono, f.ts_utc, out_flags[num_received]);
+            if (res <= 0)
+            {
+                break;
+            }
+            num_received++;
+        }
+        return std::int16_t(num_received);
+    }
+
+    /**
+     * The filters are applied by the client, since the broker delivers every frame to every client.
+     */
+    std::int16_t configureFilters(const uavcan::CanFilterConfig* filter_configs, std::uint16_t num_configs) override
+    {
+        if ((filter_configs == nullptr) && (num_configs > 0))
+        {
+            return -uavcan::ErrInvalidParam;
+        }
+        filters_.assign(filter_configs, filter_configs + num_configs);
+        return 0;
+    }
+
+    std::uint16_t getNumFilters() const override { return uavcan::MaxCanAcceptanceFilters; }
+
+    /**
+     * RX queue overflows, plus the frames lost by the driver because it has not kept up with the broker.
+     */
+    std::uint64_t getErrorCount() const override;
+
+    std::uint64_t getNumRxOverflows() const { return num_rx_overflows_; }
+
+    bool hasPendingRx() const { return !rx_queue_.empty(); }
+    bool canAcceptTx() const { return !segment_.isTxFull(); }
+};
+
+/**
+ * CAN driver that accesses the SocketCAN interfaces via @ref SharedCanBroker running in another process.
+ * The interfaces are the ones of the broker, in the same order. Like the other drivers, this one is not thread safe.
+ */
+class SharedCanDriver : public uavcan::ICanDriver
+{
+    friend class SharedCanIface;
+
+    const SystemClock& clock_;
+    const std::shared_ptr<SharedCanSegment> segment_;
+    const std::uint32_t client_id_;
+    std::uint64_t rx_pos_;
+    std::uint64_t num_lost_frames_ = 0;
+    std::vector<std::unique_ptr<SharedCanIface>> ifaces_;
+
+    void pollRing()
+    {
+        SharedCanFrame frame;
+        while (segment_->readRx(rx_pos_, frame, num_lost_frames_))
+        {
+            if (frame.iface_index < ifaces_.size())
+            {
+                ifaces_[frame.iface_index]->deliver(frame);
+            }
+        }
+    }
+
+    void collectReadyIfaces(uavcan::CanSelectMasks& inout_masks) const
+    {
+        uavcan::CanSelectMasks out_masks;
+        for (unsigned i = 0; i < ifaces_.size(); i++)
+        {
+            const std::uint8_t mask = std::uint8_t(1U << i);
+            if ((inout_masks.read & mask) && ifaces_[i]->hasPendingRx())
+            {
+                out_masks.read |= mask;
+            }
+            if ((inout_masks.write & mask) && ifaces_[i]->canAcceptTx())
+            {
+                out_masks.write |= mask;
+            }
+        }
+        inout_masks = out_masks;
+    }
+
+public:
+    /**
+     * Reference to the clock object shall remain valid. Only the frames published after construction are received.
+     * @throws uavcan_linux::Exception if the broker is not running.
+     */
+    explicit SharedCanDriver(const SystemClock& clock,
+                             const std::string& segment_name = SharedCanSegment::getDefaultName(),
+                             unsigned rx_queue_capacity = SocketCanIface::DefaultRxQueueCapacity)
+        : clock_(clock)
+        , segment_(SharedCanSegment::open(segment_name))
+        , client_id_(segment_->allocateClientID())
+        , rx_pos_(segment_->getRxHead())
+    {
+        for (unsigned i = 0; i < segment_->getNumIfaces(); i++)
+        {
+            ifaces_.emplace_back(new SharedCanIface(*this, *segment_, clock_, client_id_, std::uint8_t(i),
+                                                    rx_queue_capacity));
+        }
+    }
+
+    /**
+     * Blocks on the futex of the RX ring; the TX ring becomes writeable when the broker transmits frames, which
+     * are published into the RX ring as well.
+     */
+    std::int16_t select(uavcan::CanSelectMasks& inout_masks,
+                        const uavcan::CanFrame* (&)[uavcan::MaxCanIfaces],
+                        const uavcan::MonotonicTime blocking_deadline) override
+    {
+        const uavcan::CanSelectMasks requested = inout_masks;
+        while (true)
+        {
+            const std::uint32_t seen = segment_->getRxEventCount();
+            pollRing();
+
+            inout_masks = requested;
+            collectReadyIfaces(inout_masks);
+            if ((inout_masks.read != 0) || (inout_masks.write != 0))
+            {
+                break;
+            }
+
+            const uavcan::MonotonicTime now = clock_.getMonotonic();
+            if (now >= blocking_deadline)
+            {
+                break;
+            }
+            segment_->waitForRx(seen, (blocking_deadline - now).toUSec());
+        }
+
+        unsigned num_ready = 0;
+        for (unsigned i = 0; i < ifaces_.size(); i++)
+        {
+            const std::uint8_t mask = std::uint8_t(1U << i);
+            num_ready += ((inout_masks.read | inout_masks.write) & mask) ? 1U : 0U;
+        }
+        return std::int16_t(num_ready);
+    }
+
+    SharedCanIface* getIface(std::uint8_t iface_index) override
+    {
+        return (iface_index >= ifaces_.size()) ? nullptr : ifaces_[iface_index].get();
+    }
+
+    std::uint8_t getNumIfaces() const override { return std::uint8_t(ifaces_.size()); }
+
+    /**
+     * Frames overwritten in the RX ring before this driver has read them.
+     */
+    std::uint64_t getNumLostFrames() const { return num_lost_frames_; }
+
+    std::uint32_t getClientID() const { return client_id_; }
+};
+
+/*
+ * SharedCanIface implementation; it depends on the definition of SharedCanDriver.
+ */
+inline std::int16_t SharedCanIface::receive(uavcan::CanFrame& out_frame, uavcan::MonotonicTime& out_ts_monotonic,
+                                            uavcan::UtcTime& out_ts_utc, uavcan::CanIOFlags& out_flags)
+{
+    if (rx_queue_.empty())
+    {
+        driver_.pollRing();
+        if (rx_queue_.empty())
+        {
+            return 0;
+        }
+    }
+    const RxItem& item = rx_queue_.front();
+    out_frame = item.frame;
+    out_ts_monotonic = item.ts_mono;
+    out_ts_utc = item.ts_utc;
+    out_flags = item.flags;
+    rx_queue_.pop();
+    return 1;
+}
+
+inline std::uint64_t SharedCanIface::getErrorCount() const
+{
+    return num_rx_overflows_ + driver_.getNumLostFrames();
+}
+
+}
@@ -7,10 +7,8 @@
 
 #include <cassert>
 #include <cstdint>
-#include <queue>
 #include <vector>
 #include <map>
-#include <unordered_set>
 #include <memory>
 #include <algorithm>
 
@@ -20,7 +18,13 @@
 #include <net/if.h>
 #include <linux/can.h>
 #include <linux/can/raw.h>
+#include <linux/filter.h>
+#include <linux/if_packet.h>
+#include <linux/net_tstamp.h>
+#include <linux/sockios.h>
+#include <arpa/inet.h>
 #include <poll.h>
+#include <sys/epoll.h>
 
 #include <uavcan/uavcan.hpp>
 #include <uavcan_linux/clock.hpp>
@@ -36,7 +40,119 @@ enum class SocketCanError
 {
     SocketReadFailure,
     SocketWriteFailure,
-    TxTimeout
+    TxTimeout,
+    RxQueueOverflow,        ///< The user space RX queue was full, the received frame was dropped
+    SocketRxOverflow        ///< The socket receive buffer was full, the kernel dropped a frame (SO_RXQ_OVFL)
+};
+
+/**
+ * Defines how SocketCanIface exchanges frames with the socket.
+ *  - PerFrame  - one recvmsg()/write() system call per frame.
+ *  - Batched   - recvmmsg()/sendmmsg(), many frames are transferred per system call. This reduces the CPU load
+ *                under heavy bus traffic at the cost of a bit more stack usage.
+ *  - External  - the iface does not access the sockets; the frames are exchanged by the driver, which
+ *                takes the TX frames from the iface and hands the received ones over to it
+ *                (see @ref SocketCanUringDriver). The iface can't be used with other drivers in this mode.
+ */
+enum class SocketCanIoMode
+{
+    PerFrame,
+    Batched,
+    External
+};
+
+/**
+ * Defines how the RX and TX loopback frames are timestamped.
+ *  - Software  - SO_TIMESTAMP, the timestamp is taken by the kernel when the frame is received from the driver.
+ *                This is the default mode, it works with all CAN interfaces.
+ *  - Hardware  - SO_TIMESTAMPING, the timestamp is taken by the CAN controller; frames that lack the hardware
+ *                timestamp are timestamped in software. Hardware timestamping of the TX loopback frames greatly
+ *                reduces the jitter of the TX timestamps, which defines the accuracy of the time synchronization
+ *                (see uavcan::GlobalTimeSyncMaster). Note that the hardware timestamps are used as is, so the clock
+ *                of the controller must be maintained in the CLOCK_REALTIME domain by the kernel driver (or e.g. by
+ *                phc2sys); otherwise, the Software mode must be used. Enabling the hardware timestamping on the
+ *                interface may require CAP_NET_ADMIN; failure to do so is not an error.
+ */
+enum class SocketCanTimestampMode
+{
+    Software,
+    Hardware
+};
+
+/**
+ * Defines which TX frames are looped back by the kernel.
+ *  - AllFrames - CAN_RAW_RECV_OWN_MSGS is enabled on the socket, every TX frame is echoed back. The echoes are used
+ *                to limit the number of frames in the socket TX queue (see @ref SocketCanIface), so that the TX
+ *                deadlines and the frame priorities are honored precisely. This is the default mode.
+ *  - Selective - Only the frames that the library has requested the loopback for (uavcan::CanIOFlagLoopback, e.g.
+ *                time sync messages) are echoed back. They are sent via a dedicated socket that has
+ *                CAN_RAW_RECV_OWN_MSGS enabled and a CAN filter admitting only their CAN IDs; all other frames are
+ *                sent via the main socket, which produces no echo traffic. This halves the number of frames read
+ *                per transmitted frame, at the cost of the TX flow control: the main socket accepts frames until
+ *                the kernel queue is full, so the TX deadlines are checked only before writing, and a higher
+ *                priority frame may be queued behind the lower priority ones in the kernel.
+ */
+enum class SocketCanLoopbackMode
+{
+    AllFrames,
+    Selective
+};
+
+/**
+ * FIFO queue of fixed capacity. The storage is allocated once at construction, so push()/pop() never allocate.
+ */
+template <typename T>
+class FixedCapacityQueue
+{
+    std::vector<T> storage_;
+    std::size_t head_ = 0;
+    std::size_t size_ = 0;
+
+public:
+    explicit FixedCapacityQueue(std::size_t capacity)
+        : storage_(capacity)
+    { }
+
+    /**
+     * Returns false if the queue is full; the item is not added then.
+     */
+    bool push(const T& item)
+    {
+        if (full())
+        {
+            return false;
+        }
+        std::size_t index = head_ + size_;
+        if (index >= storage_.size())
+        {
+            index -= storage_.size();
+        }
+        storage_[index] = item;
+        size_++;
+        return true;
+    }
+
+    const T& front() const
+    {
+        assert(!empty());
+        return storage_[head_];
+    }
+
+    void pop()
+    {
+        assert(!empty());
+        head_++;
+        if (head_ >= storage_.size())
+        {
+            head_ = 0;
+        }
+        size_--;
+    }
+
+    bool empty() const { return size_ == 0; }
+    bool full() const { return size_ >= storage_.size(); }
+    std::size_t size() const { return size_; }
+    std::size_t capacity() const { return storage_.size(); }
 };
 
 /**
@@ -54,14 +170,60 @@ enum class SocketCanError
  * Note that if max_frames_in_socket_tx_queue_ is greater than one, frame reordering may occur (depending on the
  * unrderlying logic).
  *
+ * In the Selective loopback mode (@ref SocketCanLoopbackMode), only the frames sent via the loopback socket are
+ * echoed back, so the limit applies to them only; the main socket is written until it reports ENOBUFS.
+ *
+ * In the batched IO mode (@ref SocketCanIoMode), the TX queue is flushed with sendmmsg(), up to
+ * max_frames_in_socket_tx_queue_ frames per call, so it makes sense to increase this value accordingly.
+ *
+ * Both user space queues have fixed capacity and are allocated at construction, so that no heap allocations
+ * happen per frame. When the TX queue is full, send() returns zero and the iface is reported as not writeable,
+ * so the frames are kept in the library's TX queue instead; this is counted, see getTxQueueOverflowCount().
+ * When the RX queue is full, the received frames are dropped and SocketCanError::RxQueueOverflow is registered.
+ *
+ * The frames dropped by the kernel because the socket receive buffer was full are reported by the kernel via
+ * SO_RXQ_OVFL and registered as SocketCanError::SocketRxOverflow. The receive buffer can be made to grow
+ * automatically when that happens, see setRxBufferAutoGrowthLimit().
+ *
  * This class is too complex and needs to be refactored later. At least, basic socket IO and configuration
  * should be extracted into a different class.
  */
 class SocketCanIface : public uavcan::ICanIface
 {
-    static inline ::can_frame makeSocketCanFrame(const uavcan::CanFrame& uavcan_frame)
+#if UAVCAN_CAN_FD
+    /**
+     * With CAN FD enabled, the socket exchanges both classic and CAN FD frames; the classic frames use the
+     * same layout (CAN_MTU bytes), so the CAN FD structure is used for all frames.
+     */
+    typedef ::canfd_frame SocketCanFrame;
+
+    static inline std::uint8_t& getSocketCanFrameLength(SocketCanFrame& frame) { return frame.len; }
+    static inline std::uint8_t getSocketCanFrameLength(const SocketCanFrame& frame) { return frame.len; }
+#else
+    typedef ::can_frame SocketCanFrame;
+
+    static inline std::uint8_t& getSocketCanFrameLength(SocketCanFrame& frame) { return frame.can_dlc; }
+    static inline std::uint8_t getSocketCanFrameLength(const SocketCanFrame& frame) { return frame.can_dlc; }
+#endif
+
+    /**
+     * Number of bytes to write into the socket for this frame.
+     */
+    static inline std::size_t getSocketCanFrameMtu(const uavcan::CanFrame& uavcan_frame)
     {
-        ::can_frame sockcan_frame { uavcan_frame.id& uavcan::CanFrame::MaskExtID, uavcan_frame.dlc, { } };
+#if UAVCAN_CAN_FD
+        return uavcan_frame.isCanFD() ? CANFD_MTU : CAN_MTU;
+#else
+        (void)uavcan_frame;
+        return CAN_MTU;
+#endif
+    }
+
+    static inline SocketCanFrame makeSocketCanFrame(const uavcan::CanFrame& uavcan_frame)
+    {
+        auto sockcan_frame = SocketCanFrame();
+        sockcan_frame.can_id = uavcan_frame.id & uavcan::CanFrame::MaskExtID;
+        getSocketCanFrameLength(sockcan_frame) = uavcan_frame.dlc;
         (void)std::copy(uavcan_frame.data, uavcan_frame.data + uavcan_frame.dlc, sockcan_frame.data);
         if (uavcan_frame.isExtended())
         {
@@ -78,9 +240,10 @@ class SocketCanIface : public uavcan::ICanIface
         return sockcan_frame;
     }
 
-    static inline uavcan::CanFrame makeUavcanFrame(const ::can_frame& sockcan_frame)
+    static inline uavcan::CanFrame makeUavcanFrame(const SocketCanFrame& sockcan_frame)
     {
-        uavcan::CanFrame uavcan_frame(sockcan_frame.can_id & CAN_EFF_MASK, sockcan_frame.data, sockcan_frame.can_dlc);
+        uavcan::CanFrame uavcan_frame(sockcan_frame.can_id & CAN_EFF_MASK, sockcan_frame.data,
+                                      getSocketCanFrameLength(sockcan_frame));
         if (sockcan_frame.can_id & CAN_EFF_FLAG)
         {
             uavcan_frame.id |= uavcan::CanFrame::FlagEFF;
@@ -103,6 +266,8 @@ class SocketCanIface : public uavcan::ICanIface
         uavcan::CanIOFlags flags = 0;
         std::uint64_t order = 0;
 
+        TxItem() { }
+
         TxItem(const uavcan::CanFrame& arg_frame, uavcan::MonotonicTime arg_deadline,
                uavcan::CanIOFlags arg_flags, std::uint64_t arg_order)
             : frame(arg_frame)
@@ -137,23 +302,97 @@ class SocketCanIface : public uavcan::ICanIface
         { }
     };
 
+    /**
+     * Ancillary data buffer for the RX timestamp and the drop counter; SO_TIMESTAMPING reports three timestamps
+     * at once.
+     */
+    struct RxControl
+    {
+        alignas(::cmsghdr) std::uint8_t data[CMSG_SPACE(sizeof(::timeval)) + CMSG_SPACE(sizeof(::timespec) * 3) +
+                                             CMSG_SPACE(sizeof(std::uint32_t))];
+    };
+
+    /**
+     * Maximum number of frames transferred per one recvmmsg()/sendmmsg() call.
+     */
+    static constexpr unsigned IoBatchSize = 32;
+
+    /**
+     * Maximum number of CAN IDs admitted by the loopback socket in the Selective loopback mode.
+     * The actual number is normally tiny, since only a few data types are sent with loopback.
+     */
+    static constexpr unsigned MaxLoopbackSocketIDs = 16;
+
     const SystemClock& clock_;
     const int fd_;
+    const int loopback_fd_;                         ///< Negative unless the loopback mode is Selective
 
     const unsigned max_frames_in_socket_tx_queue_;
+    const SocketCanIoMode io_mode_;
     unsigned frames_in_socket_tx_queue_ = 0;
 
     std::uint64_t tx_frame_counter_ = 0;        ///< Increments with every frame pushed into the TX queue
 
     std::map<SocketCanError, std::uint64_t> errors_;
 
-    std::priority_queue<TxItem> tx_queue_;                          // TODO: Use pool allocator
-    std::queue<RxItem> rx_queue_;                                   // TODO: Use pool allocator
-    std::unordered_multiset<std::uint32_t> pending_loopback_ids_;   // TODO: Use pool allocator
+    std::uint32_t socket_drop_count_ = 0;           ///< Last value reported by SO_RXQ_OVFL, it is cumulative
+    unsigned rx_buffer_growth_limit_ = 0;           ///< Bytes; zero disables the growth
+    std::uint64_t rx_buffer_growth_count_ = 0;
+
+    std::vector<TxItem> tx_queue_;                  ///< Binary heap, see std::push_heap(); capacity is reserved
+    const std::size_t tx_queue_capacity_;
+    std::uint64_t tx_queue_overflow_count_ = 0;
+    FixedCapacityQueue<RxItem> rx_queue_;
+    std::vector<std::uint32_t> pending_loopback_ids_;   ///< Oldest first; capacity is reserved
 
     std::vector<::can_filter> hw_filters_container_;
+    std::vector<std::uint32_t> loopback_socket_ids_;    ///< Admitted by the loopback socket; oldest first
 
-    void registerError(SocketCanError e) { errors_[e]++; }
+    std::vector<TxItem> tx_batch_;      ///< Used in the batched IO mode; kept here to avoid reallocations
+
+    /**
+     * The kernel reports the total number of frames dropped on the socket, so the difference is registered.
+     */
+    void updateSocketDropCount(std::uint32_t drop_count)
+    {
+        const std::uint32_t num_new_drops = drop_count - socket_drop_count_;    // Wraps around correctly
+        if ((num_new_drops == 0) || (num_new_drops > 0x7FFFFFFFU))
+        {
+            return;                 // Older frames may carry an older value of the counter
+        }
+        socket_drop_count_ = drop_count;
+        errors_[SocketCanError::SocketRxOverflow] += num_new_drops;
+        UAVCAN_TRACE("SocketCAN", "SocketCanIface: fd %d: %u frames dropped by the kernel", fd_, num_new_drops);
+        if (rx_buffer_growth_limit_ > 0)
+        {
+            growRxBuffer();
+        }
+    }
+
+    void growRxBuffer()
+    {
+        const int current = getRxBufferSize();
+        if ((current <= 0) || (unsigned(current) >= rx_buffer_growth_limit_))
+        {
+            return;
+        }
+        const unsigned target = std::min(unsigned(current) * 2U, rx_buffer_growth_limit_);
+        if (setRxBufferSize(target) < 0)
+        {
+            UAVCAN_TRACE("SocketCAN", "SocketCanIface: fd %d: Failed to grow the RX buffer, errno %d", fd_, errno);
+            return;
+        }
+        if (getRxBufferSize() > current)
+        {
+            rx_buffer_growth_count_++;
+        }
+        else
+        {
+            // The value is capped by net.core.rmem_max; there's no point to try again
+            UAVCAN_TRACE("SocketCAN", "SocketCanIface: fd %d: RX buffer is at the system limit", fd_);
+            rx_buffer_growth_limit_ = 0;
+        }
+    }
 
     void incrementNumFramesInSocketTxQueue()
     {
@@ -173,23 +412,118 @@ class SocketCanIface : public uavcan::ICanIface
         }
     }
 
+    void addPendingLoopbackID(std::uint32_t id)
+    {
+        // Normally there are at most max_frames_in_socket_tx_queue_ entries; the oldest one is stale otherwise
+        if (pending_loopback_ids_.size() >= pending_loopback_ids_.capacity())
+        {
+            (void)pending_loopback_ids_.erase(pending_loopback_ids_.begin());
+        }
+        pending_loopback_ids_.push_back(id);
+    }
+
     bool wasInPendingLoopbackSet(const uavcan::CanFrame& frame)
     {
-        if (pending_loopback_ids_.count(frame.id) > 0)
+        const auto it = std::find(pending_loopback_ids_.begin(), pending_loopback_ids_.end(), frame.id);
+        if (it != pending_loopback_ids_.end())
         {
-            (void)pending_loopback_ids_.erase(frame.id);
+            (void)pending_loopback_ids_.erase(it);
             return true;
         }
         return false;
     }
 
-    int write(const uavcan::CanFrame& frame) const
+    bool isLoopbackSelective() const { return loopback_fd_ >= 0; }
+
+    bool isSentViaLoopbackSocket(const TxItem& tx) const
+    {
+        return isLoopbackSelective() && ((tx.flags & uavcan::CanIOFlagLoopback) != 0);
+    }
+
+    /**
+     * Installs an exact CAN filter per admitted ID on the loopback socket; with no IDs it receives nothing.
+     * @return 0 on success, negative on error.
+     */
+    int updateLoopbackSocketFilter() const
+    {
+        ::can_filter filters[MaxLoopbackSocketIDs] = {};
+        for (unsigned i = 0; i < loopback_socket_ids_.size(); i++)
+        {
+            uavcan::CanFrame frame;
+            frame.id = loopback_socket_ids_[i];
+            filters[i].can_id = makeSocketCanFrame(frame).can_id;
+            filters[i].can_mask = CAN_EFF_FLAG | CAN_RTR_FLAG |
+                                  ((filters[i].can_id & CAN_EFF_FLAG) ? CAN_EFF_MASK : CAN_SFF_MASK);
+        }
+        return ::setsockopt(loopback_fd_, SOL_CAN_RAW, CAN_RAW_FILTER, filters,
+                            static_cast<::socklen_t>(sizeof(::can_filter) * loopback_socket_ids_.size()));
+    }
+
+    /**
+     * Makes the loopback socket admit the echo of a frame with this ID. If the filter set is full, the oldest ID
+     * that is not awaiting an echo is evicted.
+     * @return 0 on success, negative on error.
+     */
+    int admitLoopbackSocketID(std::uint32_t id)
+    {
+        if (std::find(loopback_socket_ids_.begin(), loopback_socket_ids_.end(), id) != loopback_socket_ids_.end())
+        {
+            return 0;
+        }
+        if (loopback_socket_ids_.size() >= MaxLoopbackSocketIDs)
+        {
+            const auto it = std::find_if(loopback_socket_ids_.begin(), loopback_socket_ids_.end(),
+                                         [this](std::uint32_t x)
+                                         {
+                                             return std::find(pending_loopback_ids_.begin(),
+                                                              pending_loopback_ids_.end(), x) ==
+                                                 pending_loopback_ids_.end();
+                                         });
+            if (it == loopback_socket_ids_.end())
+            {
+                return -1;
+            }
+            (void)loopback_socket_ids_.erase(it);
+        }
+        loopback_socket_ids_.push_back(id);
+        return updateLoopbackSocketFilter();
+    }
+
+    /**
+     * In the Selective loopback mode, the frames sent via the loopback socket are also delivered to the main socket
+     * by the kernel as frames originating from this host (MSG_DONTROUTE); they must not be received twice.
+     */
+    bool isFromLoopbackSocket(int msg_flags, const SocketCanFrame& sockcan_frame) const
+    {
+        if (loopback_socket_ids_.empty() || ((msg_flags & static_cast<int>(MSG_DONTROUTE)) == 0))
+        {
+            return false;
+        }
+        const std::uint32_t id = makeUavcanFrame(sockcan_frame).id;
+        return std::find(loopback_socket_ids_.begin(), loopback_socket_ids_.end(), id) != loopback_socket_ids_.end();
+    }
+
+    void pushTx(const TxItem& tx)
+    {
+        assert(tx_queue_.size() < tx_queue_capacity_);
+        tx_queue_.push_back(tx);
+        std::push_heap(tx_queue_.begin(), tx_queue_.end());
+    }
+
+    void popTx()
+    {
+        std::pop_heap(tx_queue_.begin(), tx_queue_.end());
+        tx_queue_.pop_back();
+    }
+
+    static int write(int fd, const uavcan::CanFrame& frame)
     {
         errno = 0;
 
-        const ::can_frame sockcan_frame = makeSocketCanFrame(frame);
+        const SocketCanFrame sockcan_frame = makeSocketCanFrame(frame);
+        const std::size_t mtu = getSocketCanFrameMtu(frame);
 
-        const int res = ::write(fd_, &sockcan_frame, sizeof(sockcan_frame));
+        const int res = ::write(fd, &sockcan_frame, mtu);
         if (res <= 0)
         {
             if (errno == ENOBUFS || errno == EAGAIN)    // Writing is not possible atm, not an error
@@ -198,7 +532,7 @@ class SocketCanIface : public uavcan::ICanIface
             }
             return res;
         }
-        if (res != sizeof(sockcan_frame))
+        if (res != int(mtu))
         {
             return -1;
         }
@@ -212,138 +546,517 @@ class SocketCanIface : public uavcan::ICanIface
      * Diff: https://git.ucsd.edu/abuss/linux/commit/1e55659ce6ddb5247cee0b1f720d77a799902b85
      * Man: https://www.kernel.org/doc/Documentation/networking/can.txt (chapter 4.1.6).
      */
-    int read(uavcan::CanFrame& frame, uavcan::UtcTime& ts_utc, bool& loopback) const
+    int read(int fd, uavcan::CanFrame& frame, uavcan::UtcTime& ts_utc, bool& loopback,
+             std::uint32_t& inout_drop_count) const
     {
-        auto iov = ::iovec();
-        auto sockcan_frame = ::can_frame();
-        iov.iov_base = &sockcan_frame;
-        iov.iov_len  = sizeof(sockcan_frame);
+        while (true)             // Frames rejected by the HW filters are skipped, so the socket is always drained
+        {
+            auto iov = ::iovec();
+            auto sockcan_frame = SocketCanFrame();
+            iov.iov_base = &sockcan_frame;
+            iov.iov_len  = sizeof(sockcan_frame);
+
+            auto control = RxControl();
+
+            auto msg = ::msghdr();
+            msg.msg_iov    = &iov;
+            msg.msg_iovlen = 1;
+            msg.msg_control = &control;
+            msg.msg_controllen = sizeof(control);
+
+            const int res = ::recvmsg(fd, &msg, MSG_DONTWAIT);
+            if (res <= 0)
+            {
+                return (res < 0 && errno == EWOULDBLOCK) ? 0 : res;
+            }
+            /*
+             * Flags
+             */
+            loopback = (msg.msg_flags & static_cast<int>(MSG_CONFIRM)) != 0;
+
+            if (!loopback && (!checkHWFilters(sockcan_frame) ||
+                              ((fd == fd_) && isFromLoopbackSocket(msg.msg_flags, sockcan_frame))))
+            {
+                continue;
+            }
+
+            frame = makeUavcanFrame(sockcan_frame);
+            /*
+             * Timestamp
+             */
+            return parseControlMessages(msg, ts_utc, inout_drop_count) ? 1 : -1;
+        }
+    }
 
-        struct Control
+    /**
+     * Accepts both SO_TIMESTAMP and SO_TIMESTAMPING, see @ref SocketCanTimestampMode.
+     * In the latter case the raw hardware timestamp is preferred over the software one.
+     * The drop counter is updated only if the kernel has reported it (SO_RXQ_OVFL), which happens only after
+     * the first drop.
+     * @return False if there was no timestamp.
+     */
+    static bool parseControlMessages(const ::msghdr& msg, uavcan::UtcTime& ts_utc, std::uint32_t& inout_drop_count)
+    {
+        bool has_timestamp = false;
+        for (const ::cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+             cmsg != nullptr;
+             cmsg = CMSG_NXTHDR(const_cast< ::msghdr*>(&msg), const_cast< ::cmsghdr*>(cmsg)))
         {
-            cmsghdr cm;
-            std::uint8_t data[sizeof(::timeval)];
-        };
-        auto control = Control();
+            if (cmsg->cmsg_level != SOL_SOCKET)
+            {
+                continue;
+            }
+            if (cmsg->cmsg_type == SO_TIMESTAMP)
+            {
+                auto tv = ::timeval();
+                (void)std::memcpy(&tv, CMSG_DATA(cmsg), sizeof(tv));  // Copy to avoid alignment problems
+                assert(tv.tv_sec >= 0 && tv.tv_usec >= 0);
+                ts_utc = uavcan::UtcTime::fromUSec(std::uint64_t(tv.tv_sec) * 1000000ULL + tv.tv_usec);
+                has_timestamp = true;
+            }
+            else if (cmsg->cmsg_type == SCM_TIMESTAMPING)
+            {
+                ::timespec ts[3] = {};          // Software, deprecated, raw hardware
+                (void)std::memcpy(ts, CMSG_DATA(cmsg), sizeof(ts));
+                const ::timespec& best = (ts[2].tv_sec != 0 || ts[2].tv_nsec != 0) ? ts[2] : ts[0];
+                if (best.tv_sec > 0 || best.tv_nsec > 0)
+                {
+                    ts_utc = uavcan::UtcTime::fromUSec(std::uint64_t(best.tv_sec) * 1000000ULL +
+                                                       std::uint64_t(best.tv_nsec) / 1000ULL);
+                    has_timestamp = true;
+                }
+            }
+            else if (cmsg->cmsg_type == SO_RXQ_OVFL)
+            {
+                (void)std::memcpy(&inout_drop_count, CMSG_DATA(cmsg), sizeof(inout_drop_count));
+            }
+            else
+            {
+                ;   // Unknown, ignore
+            }
+        }
+        assert(has_timestamp);
+        return has_timestamp;
+    }
+
+    /**
+     * Same as @ref read() from the main socket, but reads up to IoBatchSize frames with one recvmmsg() call.
+     * Frames rejected by the HW filters are not returned; out_num_accepted is valid even if an error is reported.
+     * @return Number of frames read from the socket, including rejected ones, or negative on error.
+     */
+    int readBatch(RxItem (&out_items)[IoBatchSize], bool (&out_loopback)[IoBatchSize],
+                  unsigned& out_num_accepted, std::uint32_t& inout_drop_count) const
+    {
+        out_num_accepted = 0;
+
+        SocketCanFrame sockcan_frames[IoBatchSize];
+        ::iovec iovs[IoBatchSize];
+        RxControl controls[IoBatchSize];
+        ::mmsghdr msgs[IoBatchSize];
 
-        auto msg = ::msghdr();
-        msg.msg_iov    = &iov;
-        msg.msg_iovlen = 1;
-        msg.msg_control = &control;
-        msg.msg_controllen = sizeof(control);
+        for (unsigned i = 0; i < IoBatchSize; i++)
+        {
+            iovs[i].iov_base = &sockcan_frames[i];
+            iovs[i].iov_len  = sizeof(sockcan_frames[i]);
+            controls[i] = RxControl();
+            msgs[i] = ::mmsghdr();
+            msgs[i].msg_hdr.msg_iov    = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            msgs[i].msg_hdr.msg_control = &controls[i];
+            msgs[i].msg_hdr.msg_controllen = sizeof(controls[i]);
+        }
 
-        const int res = ::recvmsg(fd_, &msg, MSG_DONTWAIT);
+        const int res = ::recvmmsg(fd_, msgs, IoBatchSize, MSG_DONTWAIT, nullptr);
         if (res <= 0)
         {
             return (res < 0 && errno == EWOULDBLOCK) ? 0 : res;
         }
-        /*
-         * Flags
-         */
-        loopback = (msg.msg_flags & static_cast<int>(MSG_CONFIRM)) != 0;
 
-        if (!loopback && !checkHWFilters(sockcan_frame))
+        for (int i = 0; i < res; i++)
         {
-            return 0;
+            const bool loopback = (msgs[i].msg_hdr.msg_flags & static_cast<int>(MSG_CONFIRM)) != 0;
+            if (!loopback && (!checkHWFilters(sockcan_frames[i]) ||
+                              isFromLoopbackSocket(msgs[i].msg_hdr.msg_flags, sockcan_frames[i])))
+            {
+                continue;
+            }
+            if (!parseControlMessages(msgs[i].msg_hdr, out_items[out_num_accepted].ts_utc, inout_drop_count))
+            {
+                return -1;
+            }
+            out_items[out_num_accepted].frame = makeUavcanFrame(sockcan_frames[i]);
+            out_loopback[out_num_accepted] = loopback;
+            out_num_accepted++;
         }
+        return res;
+    }
 
-        frame = makeUavcanFrame(sockcan_frame);
-        /*
-         * Timestamp
-         */
-        const ::cmsghdr* const cmsg = CMSG_FIRSTHDR(&msg);
-        assert(cmsg != nullptr);
-        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_TIMESTAMP)
+    /**
+     * Writes the highest priority frame of the TX queue into the socket, or discards it if it has expired.
+     * @return False if the socket can't accept the frame at the moment; the frame remains enqueued then.
+     */
+    bool transmitNextFrame()
+    {
+        const TxItem tx = tx_queue_.front();
+
+        if (tx.deadline >= clock_.getMonotonic())
         {
-            auto tv = ::timeval();
-            (void)std::memcpy(&tv, CMSG_DATA(cmsg), sizeof(tv));  // Copy to avoid alignment problems
-            assert(tv.tv_sec >= 0 && tv.tv_usec >= 0);
-            ts_utc = uavcan::UtcTime::fromUSec(std::uint64_t(tv.tv_sec) * 1000000ULL + tv.tv_usec);
+            const bool via_loopback_socket = isSentViaLoopbackSocket(tx);
+            int res = -1;
+            if (!via_loopback_socket)
+            {
+                res = write(fd_, tx.frame);
+            }
+            else if (admitLoopbackSocketID(tx.frame.id) >= 0)
+            {
+                res = write(loopback_fd_, tx.frame);
+            }
+            else
+            {
+                UAVCAN_TRACE("SocketCAN", "SocketCanIface: fd %d: Failed to update the loopback filter, errno %d",
+                             loopback_fd_, errno);
+            }
+
+            if (res == 1)                   // Transmitted successfully
+            {
+                if (via_loopback_socket || !isLoopbackSelective())     // Otherwise there will be no echo
+                {
+                    incrementNumFramesInSocketTxQueue();
+                }
+                if (tx.flags & uavcan::CanIOFlagLoopback)
+                {
+                    addPendingLoopbackID(tx.frame.id);
+                }
+            }
+            else if (res == 0)              // Not transmitted, nor is it an error
+            {
+                return false;
+            }
+            else                            // Transmission error
+            {
+                registerError(SocketCanError::SocketWriteFailure);
+            }
         }
         else
         {
-            assert(0);
-            return -1;
+            registerError(SocketCanError::TxTimeout);
         }
-        return 1;
+
+        // Removing the frame from the queue even if transmission failed
+        popTx();
+        return true;
     }
 
     void pollWrite()
     {
-        while (hasReadyTx())
+        if (io_mode_ == SocketCanIoMode::External)
         {
-            const TxItem tx = tx_queue_.top();
+            return;                         // The driver takes the frames, see beginExternalTx()
+        }
+        if (io_mode_ == SocketCanIoMode::Batched)
+        {
+            pollWriteBatched();
+            return;
+        }
+
+        while (hasReadyTx() && transmitNextFrame())
+        {
+            ;   // The frame that could not be transmitted remains enqueued for the next retry
+        }
+    }
 
-            if (tx.deadline >= clock_.getMonotonic())
+    void pollWriteBatched()
+    {
+        while (hasReadyTx())
+        {
+            // The loopback socket carries a few frames only, they are not worth batching
+            if (isSentViaLoopbackSocket(tx_queue_.front()))
             {
-                const int res = write(tx.frame);
-                if (res == 1)                   // Transmitted successfully
+                if (!transmitNextFrame())
                 {
-                    incrementNumFramesInSocketTxQueue();
-                    if (tx.flags & uavcan::CanIOFlagLoopback)
-                    {
-                        (void)pending_loopback_ids_.insert(tx.frame.id);
-                    }
+                    break;
                 }
-                else if (res == 0)              // Not transmitted, nor is it an error
+                continue;
+            }
+
+            // The number of frames in the main socket is not limited in the Selective loopback mode
+            unsigned capacity = isLoopbackSelective() ? IoBatchSize :
+                                (max_frames_in_socket_tx_queue_ - frames_in_socket_tx_queue_);
+            if (capacity > IoBatchSize)
+            {
+                capacity = IoBatchSize;
+            }
+
+            // Collecting the highest priority frames that are not expired yet
+            const uavcan::MonotonicTime ts_mono = clock_.getMonotonic();
+            tx_batch_.clear();
+            while (!tx_queue_.empty() && (tx_batch_.size() < capacity) && !isSentViaLoopbackSocket(tx_queue_.front()))
+            {
+                if (tx_queue_.front().deadline >= ts_mono)
                 {
-                    break;                      // Leaving the loop, the frame remains enqueued for the next retry
+                    tx_batch_.push_back(tx_queue_.front());
                 }
-                else                            // Transmission error
+                else
                 {
-                    registerError(SocketCanError::SocketWriteFailure);
+                    registerError(SocketCanError::TxTimeout);
                 }
+                popTx();
             }
-            else
+            if (tx_batch_.empty())
             {
-                registerError(SocketCanError::TxTimeout);
+                break;
             }
 
-            // Removing the frame from the queue even if transmission failed
-            tx_queue_.pop();
-        }
-    }
+            SocketCanFrame sockcan_frames[IoBatchSize];
+            ::iovec iovs[IoBatchSize];
+            ::mmsghdr msgs[IoBatchSize];
+            for (unsigned i = 0; i < tx_batch_.size(); i++)
+            {
+                sockcan_frames[i] = makeSocketCanFrame(tx_batch_[i].frame);
+                iovs[i].iov_base = &sockcan_frames[i];
+                iovs[i].iov_len  = getSocketCanFrameMtu(tx_batch_[i].frame);
+                msgs[i] = ::mmsghdr();
+                msgs[i].msg_hdr.msg_iov    = &iovs[i];
+                msgs[i].msg_hdr.msg_iovlen = 1;
+            }
 
-    void pollRead()
-    {
-        while (true)
-        {
-            RxItem rx;
-            rx.ts_mono = clock_.getMonotonic();  // Monotonic timestamp is not required to be precise (unlike UTC)
-            bool loopback = false;
-            const int res = read(rx.frame, rx.ts_utc, loopback);
-            if (res == 1)
+            errno = 0;
+            const int res = ::sendmmsg(fd_, msgs, tx_batch_.size(), MSG_DONTWAIT);
+
+            unsigned num_sent = 0;
+            unsigned num_dropped = 0;
+            if (res >= 0)
+            {
+                num_sent = unsigned(res);
+            }
+            else if (errno != ENOBUFS && errno != EAGAIN)   // Writing is not possible atm, not an error
+            {
+                registerError(SocketCanError::SocketWriteFailure);
+                num_dropped = 1;        // Removing the failed frame, same as in the per-frame mode
+            }
+
+            for (unsigned i = 0; i < num_sent; i++)
             {
-                assert(!rx.ts_utc.isZero());
-                bool accept = true;
-                if (loopback)                   // We receive loopback for all CAN frames
+                if (!isLoopbackSelective())
                 {
-                    confirmSentFrame();
-                    rx.flags |= uavcan::CanIOFlagLoopback;
-                    accept = wasInPendingLoopbackSet(rx.frame); // Do we need to send this loopback into the lib?
+                    incrementNumFramesInSocketTxQueue();
                 }
-                if (accept)
+                if (tx_batch_[i].flags & uavcan::CanIOFlagLoopback)
                 {
-                    rx.ts_utc += clock_.getPrivateAdjustment();
-                    rx_queue_.push(rx);
+                    addPendingLoopbackID(tx_batch_[i].frame.id);
                 }
             }
-            else if (res == 0)
+
+            // Frames that were not accepted by the socket are returned back into the queue for the next retry
+            for (unsigned i = num_sent + num_dropped; i < tx_batch_.size(); i++)
             {
-                break;
+                pushTx(tx_batch_[i]);
             }
-            else
+
+            if ((num_sent + num_dropped) < tx_batch_.size())
             {
-                registerError(SocketCanError::SocketReadFailure);
                 break;
             }
         }
     }
 
-    /**
+    void acceptReceivedFrame(RxItem& rx, bool loopback)
+    {
+        assert(!rx.ts_utc.isZero());
+        bool accept = true;
+        if (loopback)                   // We receive loopback for all CAN frames
+        {
+            confirmSentFrame();
+            rx.flags |= uavcan::CanIOFlagLoopback;
+            accept = wasInPendingLoopbackSet(rx.frame); // Do we need to send this loopback into the lib?
+        }
+        if (accept)
+        {
+            rx.ts_utc += clock_.getPrivateAdjustment();
+            if (!rx_queue_.push(rx))
+            {
+                registerError(SocketCanError::RxQueueOverflow);
+            }
+        }
+    }
+
+    void pollRead()
+    {
+        if (io_mode_ == SocketCanIoMode::External)
+        {
+            return;                         // The driver delivers the frames, see acceptExternalRx()
+        }
+        if (io_mode_ == SocketCanIoMode::Batched)
+        {
+            pollReadBatched();
+        }
+        else
+        {
+            pollReadPerFrame();
+        }
+        if (isLoopbackSelective())
+        {
+            pollLoopbackSocket();
+        }
+    }
+
+    void pollReadPerFrame()
+    {
+        while (true)
+        {
+            RxItem rx;
+            rx.ts_mono = clock_.getMonotonic();  // Monotonic timestamp is not required to be precise (unlike UTC)
+            bool loopback = false;
+            std::uint32_t drop_count = socket_drop_count_;
+            const int res = read(fd_, rx.frame, rx.ts_utc, loopback, drop_count);
+            updateSocketDropCount(drop_count);
+            if (res == 1)
+            {
+                acceptReceivedFrame(rx, loopback);
+            }
+            else if (res == 0)
+            {
+                break;
+            }
+            else
+            {
+                registerError(SocketCanError::SocketReadFailure);
+                break;
+            }
+        }
+    }
+
+    void pollReadBatched()
+    {
+        while (true)
+        {
+            RxItem items[IoBatchSize];
+            bool loopback[IoBatchSize] = {};
+            unsigned num_accepted = 0;
+            std::uint32_t drop_count = socket_drop_count_;
+            const int res = readBatch(items, loopback, num_accepted, drop_count);
+            updateSocketDropCount(drop_count);
+
+            // Frames accepted before an error are still valid
+            const uavcan::MonotonicTime ts_mono = clock_.getMonotonic();
+            for (unsigned i = 0; i < num_accepted; i++)
+            {
+                items[i].ts_mono = ts_mono;
+                acceptReceivedFrame(items[i], loopback[i]);
+            }
+
+            if (res < 0)
+            {
+                registerError(SocketCanError::SocketReadFailure);
+                break;
+            }
+            if (res < int(IoBatchSize))
+            {
+                break;                      // Socket buffer is drained
+            }
+        }
+    }
+
+    /**
+     * Besides the echoes, the loopback socket receives the frames of other nodes that happen to have the same
+     * CAN IDs; these are received via the main socket as well, so they are discarded here.
+     */
+    void pollLoopbackSocket()
+    {
+        while (true)
+        {
+            RxItem rx;
+            rx.ts_mono = clock_.getMonotonic();
+            bool loopback = false;
+            std::uint32_t drop_count = 0;   // The echoes are few, so the drops are not tracked on this socket
+            const int res = read(loopback_fd_, rx.frame, rx.ts_utc, loopback, drop_count);
+            if (res == 1)
+            {
+                if (loopback)
+                {
+                    acceptReceivedFrame(rx, true);
+                }
+            }
+            else if (res == 0)
+            {
+                break;
+            }
+            else
+            {
+                registerError(SocketCanError::SocketReadFailure);
+                break;
+            }
+        }
+    }
+
+    /**
+     * Compiles hw_filters_container_ into a classic BPF program and attaches it to the socket, so that the frames
+     * rejected by the filters are dropped by the kernel and never copied into user space.
+     *
+     * Looped back frames are always accepted, because the loopback of our own frames is required for the TX queue
+     * management (see the class comment). Note that on virtual interfaces (vcan) all frames are looped back, so the
+     * kernel-side filtering is not effective there; the filters are still applied in user space.
+     * In the Selective loopback mode the main socket receives no echoes, so the looped back frames are filtered
+     * like any other frames.
+     *
+     * @return 0 on success, negative on error; on error the filtering is done in user space only.
+     */
+    int attachKernelFilter() const
+    {
+        if (hw_filters_container_.empty())
+        {
+            const int dummy = 0;
+            (void)::setsockopt(fd_, SOL_SOCKET, SO_DETACH_FILTER, &dummy, sizeof(dummy));  // May be not attached
+            return 0;
+        }
+
+        static constexpr std::uint32_t Accept = 0xFFFFFFFFU;    // Keep the whole frame
+        static constexpr std::uint32_t Reject = 0;
+
+        std::vector<::sock_filter> program;
+        program.reserve(5 + hw_filters_container_.size() * 4);
+
+        if (!isLoopbackSelective())
+        {
+            program.push_back(BPF_STMT(BPF_LD | BPF_W | BPF_ABS,
+                                           static_cast<std::uint32_t>(SKF_AD_OFF + SKF_AD_PKTTYPE)));
+            program.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, PACKET_LOOPBACK, 0, 1));
+            program.push_back(BPF_STMT(BPF_RET | BPF_K, Accept));
+        }
+
+        // Absolute loads are big endian, whereas the CAN ID is stored in the native byte order
+        program.push_back(BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(SocketCanFrame, can_id)));
+        program.push_back(BPF_STMT(BPF_MISC | BPF_TAX, 0));
+
+        for (auto& f : hw_filters_container_)
+        {
+            if ((f.can_id & ~f.can_mask) != 0)
+            {
+                continue;               // Such filter can never match, see checkHWFilters()
+            }
+            program.push_back(BPF_STMT(BPF_MISC | BPF_TXA, 0));
+            program.push_back(BPF_STMT(BPF_ALU | BPF_AND | BPF_K, ntohl(f.can_mask)));
+            program.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ntohl(f.can_id), 0, 1));
+            program.push_back(BPF_STMT(BPF_RET | BPF_K, Accept));
+        }
+
+        program.push_back(BPF_STMT(BPF_RET | BPF_K, Reject));
+
+        if (program.size() > BPF_MAXINSNS)
+        {
+            return -1;
+        }
+
+        auto fprog = ::sock_fprog();
+        fprog.len = static_cast<unsigned short>(program.size());
+        fprog.filter = program.data();
+        return ::setsockopt(fd_, SOL_SOCKET, SO_ATTACH_FILTER, &fprog, sizeof(fprog));
+    }
+
+    /**
      * Returns true if a frame accepted by HW filters
      */
-    bool checkHWFilters(const ::can_frame& frame) const
+    bool checkHWFilters(const SocketCanFrame& frame) const
     {
         if (!hw_filters_container_.empty())
         {
@@ -363,35 +1076,89 @@ class SocketCanIface : public uavcan::ICanIface
     }
 
 public:
+    static constexpr int DefaultMaxFramesInSocketTxQueue = 2;
+    static constexpr unsigned DefaultTxQueueCapacity = 256;
+    static constexpr unsigned DefaultRxQueueCapacity = 1024;
+
     /**
      * Takes ownership of socket's file descriptor.
      *
      * @ref max_frames_in_socket_tx_queue       See a note in the class comment.
+     * @ref io_mode                             See @ref SocketCanIoMode.
+     * @ref tx_queue_capacity                   Capacity of the user space TX queue, in frames.
+     * @ref rx_queue_capacity                   Capacity of the user space RX queue, in frames.
+     * @ref loopback_socket_fd                  Negative for the AllFrames loopback mode. For the Selective loopback
+     *                                          mode (@ref SocketCanLoopbackMode), this is a second socket on the
+     *                                          same iface opened in the AllFrames mode, whereas the main socket is
+     *                                          opened in the Selective mode; its ownership is taken as well.
+     *                                          The frames in flight (max_frames_in_socket_tx_queue) are counted
+     *                                          on this socket only then.
      */
-    SocketCanIface(const SystemClock& clock, int socket_fd, int max_frames_in_socket_tx_queue = 2)
+    SocketCanIface(const SystemClock& clock, int socket_fd,
+                   int max_frames_in_socket_tx_queue = DefaultMaxFramesInSocketTxQueue,
+                   SocketCanIoMode io_mode = SocketCanIoMode::PerFrame,
+                   unsigned tx_queue_capacity = DefaultTxQueueCapacity,
+                   unsigned rx_queue_capacity = DefaultRxQueueCapacity,
+                   int loopback_socket_fd = -1)
         : clock_(clock)
         , fd_(socket_fd)
+        , loopback_fd_(loopback_socket_fd)
         , max_frames_in_socket_tx_queue_(max_frames_in_socket_tx_queue)
+        , io_mode_(io_mode)
+        , tx_queue_capacity_(tx_queue_capacity)
+        , rx_queue_(rx_queue_capacity)
     {
         assert(fd_ >= 0);
+        assert(tx_queue_capacity_ > 0);
+        assert(rx_queue_capacity > 0);
+        tx_queue_.reserve(tx_queue_capacity_);
+        pending_loopback_ids_.reserve(std::max(max_frames_in_socket_tx_queue_, 1U));
+        if (io_mode_ == SocketCanIoMode::Batched)
+        {
+            tx_batch_.reserve(IoBatchSize);
+        }
+        if (isLoopbackSelective())
+        {
+            loopback_socket_ids_.reserve(MaxLoopbackSocketIDs);
+            if (updateLoopbackSocketFilter() < 0)      // Not fatal, the other frames are discarded in user space
+            {
+                UAVCAN_TRACE("SocketCAN", "SocketCanIface: Failed to set the loopback filter on fd %d, errno %d",
+                             loopback_fd_, errno);
+            }
+        }
     }
 
     /**
-     * Socket file descriptor will be closed.
+     * Socket file descriptors will be closed.
      */
     virtual ~SocketCanIface()
     {
         UAVCAN_TRACE("SocketCAN", "SocketCanIface: Closing fd %d", fd_);
         (void)::close(fd_);
+        if (loopback_fd_ >= 0)
+        {
+            (void)::close(loopback_fd_);
+        }
     }
 
     /**
-     * Assumes that the socket is writeable
+     * Assumes that the socket is writeable.
+     * Returns zero if the TX queue is full, see the class comment.
      */
     std::int16_t send(const uavcan::CanFrame& frame, const uavcan::MonotonicTime tx_deadline,
                       const uavcan::CanIOFlags flags) override
     {
-        tx_queue_.emplace(frame, tx_deadline, flags, tx_frame_counter_);
+        if (isTxQueueFull())
+        {
+            pollRead();
+            pollWrite();
+            if (isTxQueueFull())
+            {
+                tx_queue_overflow_count_++;
+                return 0;
+            }
+        }
+        pushTx(TxItem(frame, tx_deadline, flags, tx_frame_counter_));
         tx_frame_counter_++;
         pollRead();     // Read poll is necessary because it can release the pending TX flag
         pollWrite();
@@ -424,6 +1191,52 @@ public:
         return 1;
     }
 
+    /**
+     * Same as @ref receive(), but returns all frames that are available at once.
+     */
+    std::int16_t receiveBatch(uavcan::CanRxFrame* out_frames, uavcan::CanIOFlags* out_flags,
+                              std::uint16_t max_frames) override
+    {
+        if (out_frames == nullptr || out_flags == nullptr)
+        {
+            assert(0);
+            return -1;
+        }
+        if (rx_queue_.empty())
+        {
+            pollRead();
+        }
+        std::uint16_t num_received = 0;
+        while (num_received < max_frames && !rx_queue_.empty())
+        {
+            const RxItem& rx = rx_queue_.front();
+            static_cast<uavcan::CanFrame&>(out_frames[num_received]) = rx.frame;
+            out_frames[num_received].ts_mono = rx.ts_mono;
+            out_frames[num_received].ts_utc  = rx.ts_utc;
+            out_flags[num_received]          = rx.flags;
+            rx_queue_.pop();
+            num_received++;
+        }
+        return num_received;
+    }
+
+    /**
+     * Returns the CAN ID of the frame at the head of the RX queue; the queue is refilled from the socket if empty.
+     */
+    std::int16_t peekRxFrameId(std::uint32_t& out_can_id) override
+    {
+        if (rx_queue_.empty())
+        {
+            pollRead();
+            if (rx_queue_.empty())
+            {
+                return 0;
+            }
+        }
+        out_can_id = rx_queue_.front().frame.id;
+        return 1;
+    }
+
     /**
      * Performs socket read/write.
      * @param read  Socket is readable
@@ -444,8 +1257,20 @@ public:
     bool hasReadyRx() const { return !rx_queue_.empty(); }
     bool hasReadyTx() const
     {
-        return !tx_queue_.empty() && (frames_in_socket_tx_queue_ < max_frames_in_socket_tx_queue_);
+        if (tx_queue_.empty())
+        {
+            return false;
+        }
+        return (frames_in_socket_tx_queue_ < max_frames_in_socket_tx_queue_) ||
+               (isLoopbackSelective() && !isSentViaLoopbackSocket(tx_queue_.front()));
     }
+    bool isTxQueueFull() const { return tx_queue_.size() >= tx_queue_capacity_; }
+
+    /**
+     * Number of frames that were not accepted by send() because the TX queue was full.
+     * These frames were not lost; they remained in the library's TX queue.
+     */
+    std::uint64_t getTxQueueOverflowCount() const { return tx_queue_overflow_count_; }
 
     std::int16_t configureFilters(const uavcan::CanFilterConfig* const filter_configs,
                                   const std::uint16_t num_configs) override
@@ -481,14 +1306,24 @@ public:
             }
         }
 
+        // The user space check is kept anyway, since the socket may already contain frames received earlier
+        if (attachKernelFilter() < 0)
+        {
+            UAVCAN_TRACE("SocketCAN", "SocketCanIface: Failed to attach kernel filter to fd %d, errno %d",
+                         fd_, errno);
+        }
+
         return 0;
     }
 
     /**
-     * SocketCAN emulates the CAN filters in software, so the number of filters is virtually unlimited.
+     * SocketCAN filters are implemented with a BPF program in the kernel (see attachKernelFilter()) and also
+     * applied in user space, so the number of filters is virtually unlimited; it is bounded only by
+     * the library's @ref uavcan::MaxCanAcceptanceFilters, so that the acceptance filter configurator
+     * could install an exact filter per subscription without merging.
      * This method returns a constant value.
      */
-    static constexpr unsigned NumFilters = 8;
+    static constexpr unsigned NumFilters = uavcan::MaxCanAcceptanceFilters;
     std::uint16_t getNumFilters() const override { return NumFilters; }
 
 
@@ -509,12 +1344,100 @@ public:
 
     int getFileDescriptor() const { return fd_; }
 
+    /**
+     * The socket that carries the loopback frames in the Selective loopback mode; negative in the AllFrames mode.
+     * It must be polled for reading along with the main socket.
+     */
+    int getLoopbackFileDescriptor() const { return loopback_fd_; }
+
+    SocketCanLoopbackMode getLoopbackMode() const
+    {
+        return isLoopbackSelective() ? SocketCanLoopbackMode::Selective : SocketCanLoopbackMode::AllFrames;
+    }
+
+    /**
+     * Size of the socket receive buffer (SO_RCVBUF). Note that the kernel doubles the requested value to account
+     * for the bookkeeping overhead, and caps it by net.core.rmem_max.
+     * @return Bytes, negative on error.
+     */
+    int getRxBufferSize() const
+    {
+        int value = 0;
+        ::socklen_t len = sizeof(value);
+        if (::getsockopt(fd_, SOL_SOCKET, SO_RCVBUF, &value, &len) < 0)
+        {
+            return -1;
+        }
+        return value;
+    }
+
+    /**
+     * @return 0 on success, negative on error.
+     */
+    int setRxBufferSize(unsigned bytes)
+    {
+        const int value = static_cast<int>(std::min(bytes / 2U, 0x7FFFFFFFU / 2U));  // See getRxBufferSize()
+        return ::setsockopt(fd_, SOL_SOCKET, SO_RCVBUF, &value, sizeof(value));
+    }
+
+    /**
+     * If nonzero, the socket receive buffer is doubled every time the kernel reports dropped frames, until
+     * the size reaches this many bytes or the system limit (net.core.rmem_max). Zero disables, which is the default.
+     */
+    void setRxBufferAutoGrowthLimit(unsigned max_bytes) { rx_buffer_growth_limit_ = max_bytes; }
+    unsigned getRxBufferAutoGrowthLimit() const { return rx_buffer_growth_limit_; }
+
+    /**
+     * Number of times the receive buffer has been grown, see @ref setRxBufferAutoGrowthLimit().
+     */
+    std::uint64_t getRxBufferGrowthCount() const { return rx_buffer_growth_count_; }
+
+    /**
+     * Makes the kernel busy-poll the device queue for up to the specified time when the socket is read and
+     * there are no frames yet (SO_BUSY_POLL), trading CPU time for lower RX latency. Zero disables busy polling.
+     * The driver must support it (NAPI); raising the value normally requires CAP_NET_ADMIN.
+     * @return 0 on success, negative on error.
+     */
+    int setBusyPoll(unsigned timeout_usec)
+    {
+        const int value = static_cast<int>(timeout_usec);
+        return ::setsockopt(fd_, SOL_SOCKET, SO_BUSY_POLL, &value, sizeof(value));
+    }
+
+    /**
+     * Asks the CAN controller to timestamp all received frames, including the TX loopback.
+     * Many controllers do that unconditionally, so the failure is ignored; the software timestamps will be used then.
+     */
+    static void enableHardwareTimestamping(int fd, ::ifreq ifr)
+    {
+        auto config = ::hwtstamp_config();
+        config.tx_type = HWTSTAMP_TX_OFF;                   // The TX timestamps are taken from the loopback frames
+        config.rx_filter = HWTSTAMP_FILTER_ALL;
+        ifr.ifr_data = reinterpret_cast<char*>(&config);
+        if (::ioctl(fd, SIOCSHWTSTAMP, &ifr) < 0)
+        {
+            UAVCAN_TRACE("SocketCAN", "SIOCSHWTSTAMP failed on %s, errno %d", ifr.ifr_name, errno);
+            errno = 0;
+        }
+    }
+
+    /**
+     * Writes one frame into a socket opened with @ref openSocket(), bypassing the queues.
+     * @return 1 if written, 0 if the socket can't accept the frame at the moment, negative on error.
+     */
+    static int writeFrame(int socket_fd, const uavcan::CanFrame& frame) { return write(socket_fd, frame); }
+
     /**
      * Open and configure a CAN socket on iface specified by name.
      * @param iface_name String containing iface name, e.g. "can0", "vcan1", "slcan0"
+     * @param ts_mode    See @ref SocketCanTimestampMode.
+     * @param loopback_mode  Selective disables the echo of the TX frames (CAN_RAW_RECV_OWN_MSGS) on this socket,
+     *                       see @ref SocketCanLoopbackMode.
      * @return Socket descriptor or negative number on error.
      */
-    static int openSocket(const std::string& iface_name)
+    static int openSocket(const std::string& iface_name,
+                          SocketCanTimestampMode ts_mode = SocketCanTimestampMode::Software,
+                          SocketCanLoopbackMode loopback_mode = SocketCanLoopbackMode::AllFrames)
     {
         errno = 0;
 
@@ -571,15 +1494,41 @@ public:
         {
             const int on = 1;
             // Timestamping
-            if (::setsockopt(s, SOL_SOCKET, SO_TIMESTAMP, &on, sizeof(on)) < 0)
+            if (ts_mode == SocketCanTimestampMode::Hardware)
             {
-                return -1;
+                enableHardwareTimestamping(s, ifr);
+                const int flags = SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE |
+                                  SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+                if (::setsockopt(s, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) < 0)
+                {
+                    return -1;
+                }
+            }
+            else
+            {
+                if (::setsockopt(s, SOL_SOCKET, SO_TIMESTAMP, &on, sizeof(on)) < 0)
+                {
+                    return -1;
+                }
             }
             // Socket loopback
-            if (::setsockopt(s, SOL_CAN_RAW, CAN_RAW_RECV_OWN_MSGS, &on, sizeof(on)) < 0)
+            if (loopback_mode == SocketCanLoopbackMode::AllFrames &&
+                ::setsockopt(s, SOL_CAN_RAW, CAN_RAW_RECV_OWN_MSGS, &on, sizeof(on)) < 0)
+            {
+                return -1;
+            }
+            // Drop counter; the kernel drops are not detectable otherwise, so this is not optional
+            if (::setsockopt(s, SOL_SOCKET, SO_RXQ_OVFL, &on, sizeof(on)) < 0)
             {
                 return -1;
             }
+#if UAVCAN_CAN_FD
+            // CAN FD frames; sending them will fail if the iface doesn't support CAN FD
+            if (::setsockopt(s, SOL_CAN_RAW, CAN_RAW_FD_FRAMES, &on, sizeof(on)) < 0)
+            {
+                return -1;
+            }
+#endif
             // Non-blocking
             if (::fcntl(s, F_SETFL, O_NONBLOCK) < 0)
             {
@@ -602,6 +1551,174 @@ public:
         raii_closer.disarm();
         return s;
     }
+
+protected:
+    void registerError(SocketCanError e) { errors_[e]++; }
+
+    /**
+     * TX frame taken by the driver in the External IO mode, see @ref SocketCanIoMode.
+     * The frame buffer must stay in place until the write has completed.
+     */
+    struct ExternalTxItem
+    {
+        TxItem tx;
+        SocketCanFrame sockcan_frame = SocketCanFrame();
+        std::size_t mtu = 0;
+        bool via_loopback_socket = false;
+    };
+
+    /**
+     * Size of the frame buffer and of the control buffer of the messages received by the driver in the
+     * External IO mode; the control buffer is filled by the kernel in the same way as for recvmsg().
+     */
+    static constexpr std::size_t ExternalRxFrameSize = sizeof(SocketCanFrame);
+    static constexpr std::size_t ExternalRxControlSize = sizeof(RxControl);
+
+    /**
+     * Removes the highest priority frame from the TX queue for the driver to write into the socket, discarding
+     * the expired ones. The frame is accounted as written, same as in the other IO modes; the driver must report
+     * the result of the write with @ref completeExternalTx().
+     * @return False if no frame can be written at the moment.
+     */
+    bool beginExternalTx(ExternalTxItem& out_item)
+    {
+        const uavcan::MonotonicTime ts_mono = clock_.getMonotonic();
+        while (hasReadyTx())
+        {
+            const TxItem tx = tx_queue_.front();
+            popTx();
+
+            if (tx.deadline < ts_mono)
+            {
+                registerError(SocketCanError::TxTimeout);
+                continue;
+            }
+            const bool via_loopback_socket = isSentViaLoopbackSocket(tx);
+            if (via_loopback_socket && (admitLoopbackSocketID(tx.frame.id) < 0))
+            {
+                UAVCAN_TRACE("SocketCAN", "SocketCanIface: fd %d: Failed to update the loopback filter, errno %d",
+                             loopback_fd_, errno);
+                registerError(SocketCanError::SocketWriteFailure);
+                continue;
+            }
+
+            if (via_loopback_socket || !isLoopbackSelective())     // Otherwise there will be no echo
+            {
+                incrementNumFramesInSocketTxQueue();
+            }
+            if (tx.flags & uavcan::CanIOFlagLoopback)
+            {
+                addPendingLoopbackID(tx.frame.id);
+            }
+
+            out_item.tx = tx;
+            out_item.sockcan_frame = makeSocketCanFrame(tx.frame);
+            out_item.mtu = getSocketCanFrameMtu(tx.frame);
+            out_item.via_loopback_socket = via_loopback_socket;
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * Reports the result of the write of a frame taken with @ref beginExternalTx(): the number of bytes written or
+     * a negated errno. Frames that the socket could not accept at the moment (ENOBUFS, EAGAIN) and frames whose
+     * write was canceled (ECANCELED) are returned into the TX queue for the next retry; other errors are
+     * registered and the frame is dropped, same as in the other IO modes.
+     */
+    void completeExternalTx(const ExternalTxItem& item, int result)
+    {
+        if (result == int(item.mtu))
+        {
+            return;
+        }
+
+        // The frame was not written, so there will be no echo
+        if (item.via_loopback_socket || !isLoopbackSelective())
+        {
+            confirmSentFrame();
+        }
+        if (item.tx.flags & uavcan::CanIOFlagLoopback)
+        {
+            const auto it = std::find(pending_loopback_ids_.rbegin(), pending_loopback_ids_.rend(),
+                                      item.tx.frame.id);
+            if (it != pending_loopback_ids_.rend())
+            {
+                (void)pending_loopback_ids_.erase((it + 1).base());
+            }
+        }
+
+        const bool retry = (result == -ENOBUFS) || (result == -EAGAIN) || (result == -ECANCELED);
+        if (retry && !isTxQueueFull())
+        {
+            pushTx(item.tx);                // The order of the frames of equal priority is preserved
+        }
+        else
+        {
+            registerError(SocketCanError::SocketWriteFailure);
+        }
+    }
+
+    /**
+     * Accepts a frame received by the driver in the External IO mode from the main or the loopback socket.
+     * The message header must provide the control messages and the flags, as returned by recvmsg(); the frames
+     * are filtered in the same way as in the other IO modes.
+     */
+    void acceptExternalRx(const void* frame_data, std::size_t frame_size, const ::msghdr& msg,
+                          bool from_loopback_socket)
+    {
+        auto sockcan_frame = SocketCanFrame();
+        if ((frame_size < CAN_MTU) || (frame_size > sizeof(sockcan_frame)) || ((msg.msg_flags & MSG_TRUNC) != 0))
+        {
+            registerError(SocketCanError::SocketReadFailure);
+            return;
+        }
+        (void)std::memcpy(&sockcan_frame, frame_data, frame_size);
+
+        const bool loopback = (msg.msg_flags & static_cast<int>(MSG_CONFIRM)) != 0;
+        if (from_loopback_socket)
+        {
+            if (!loopback)
+            {
+                return;                     // Received via the main socket as well, see pollLoopbackSocket()
+            }
+        }
+        else if (!loopback && (!checkHWFilters(sockcan_frame) || isFromLoopbackSocket(msg.msg_flags, sockcan_frame)))
+        {
+            return;
+        }
+
+        RxItem rx;
+        rx.ts_mono = clock_.getMonotonic();
+        std::uint32_t drop_count = socket_drop_count_;
+        if (!parseControlMessages(msg, rx.ts_utc, drop_count))
+        {
+            registerError(SocketCanError::SocketReadFailure);
+            return;
+        }
+        if (!from_loopback_socket)
+        {
+            updateSocketDropCount(drop_count);
+        }
+        rx.frame = makeUavcanFrame(sockcan_frame);
+        acceptReceivedFrame(rx, loopback);
+    }
+};
+
+/**
+ * Drivers that implement this interface can be serviced from an external event loop (asio, libuv, etc.)
+ * instead of blocking in select(), see @ref NodeBase::getPollFds().
+ */
+class IPollableCanDriver
+{
+public:
+    virtual ~IPollableCanDriver() { }
+
+    /**
+     * File descriptors to watch, along with the events of interest (POLLIN, POLLOUT).
+     * The set depends on the state of the driver, so it must be re-read after every spin.
+     */
+    virtual std::vector<::pollfd> getPollFds() const = 0;
 };
 
 /**
@@ -615,13 +1732,17 @@ public:
  * Whether a certain interface is down can be checked with @ref SocketCanDriver::isIfaceDown().
  */
 class SocketCanDriver : public uavcan::ICanDriver
+                      , public IPollableCanDriver
 {
     class IfaceWrapper : public SocketCanIface
     {
         bool down_ = false;
 
     public:
-        IfaceWrapper(const SystemClock& clock, int fd) : SocketCanIface(clock, fd) { }
+        IfaceWrapper(const SystemClock& clock, int fd, SocketCanIoMode io_mode, int loopback_fd)
+            : SocketCanIface(clock, fd, DefaultMaxFramesInSocketTxQueue, io_mode, DefaultTxQueueCapacity,
+                             DefaultRxQueueCapacity, loopback_fd)
+        { }
 
         void updateDownStatusFromPollResult(const ::pollfd& pfd)
         {
@@ -639,17 +1760,29 @@ class SocketCanDriver : public uavcan::ICanDriver
         }
 
         bool isDown() const { return down_; }
+
+        bool isWriteable() const { return !down_ && !isTxQueueFull(); }
     };
 
     const SystemClock& clock_;
+    const SocketCanIoMode io_mode_;
+    const SocketCanTimestampMode ts_mode_;
+    const SocketCanLoopbackMode loopback_mode_;
     std::vector<std::unique_ptr<IfaceWrapper>> ifaces_;
 
 public:
     /**
      * Reference to the clock object shall remain valid.
+     * The IO mode, the timestamp mode and the loopback mode will be applied to all ifaces, see @ref SocketCanIoMode,
+     * @ref SocketCanTimestampMode and @ref SocketCanLoopbackMode.
      */
-    explicit SocketCanDriver(const SystemClock& clock)
+    explicit SocketCanDriver(const SystemClock& clock, SocketCanIoMode io_mode = SocketCanIoMode::PerFrame,
+                             SocketCanTimestampMode ts_mode = SocketCanTimestampMode::Software,
+                             SocketCanLoopbackMode loopback_mode = SocketCanLoopbackMode::AllFrames)
         : clock_(clock)
+        , io_mode_(io_mode)
+        , ts_mode_(ts_mode)
+        , loopback_mode_(loopback_mode)
     {
         ifaces_.reserve(uavcan::MaxCanIfaces);
     }
@@ -665,11 +1798,12 @@ public:
                         uavcan::MonotonicTime blocking_deadline) override
     {
         // Detecting whether we need to block at all
-        bool need_block = (inout_masks.write == 0);    // Write queue is infinite
+        bool need_block = true;
         for (unsigned i = 0; need_block && (i < ifaces_.size()); i++)
         {
-            const bool need_read = inout_masks.read  & (1 << i);
-            if (need_read && ifaces_[i]->hasReadyRx())
+            const bool need_read  = inout_masks.read  & (1 << i);
+            const bool need_write = inout_masks.write & (1 << i);
+            if ((need_read && ifaces_[i]->hasReadyRx()) || (need_write && ifaces_[i]->isWriteable()))
             {
                 need_block = false;
             }
@@ -677,10 +1811,10 @@ public:
 
         if (need_block)
         {
-            // Poll FD set setup
-            ::pollfd pollfds[uavcan::MaxCanIfaces] = {};
+            // Poll FD set setup; in the Selective loopback mode there are two sockets per iface
+            ::pollfd pollfds[uavcan::MaxCanIfaces * 2] = {};
             unsigned num_pollfds = 0;
-            IfaceWrapper* pollfd_index_to_iface[uavcan::MaxCanIfaces] = { };
+            IfaceWrapper* pollfd_index_to_iface[uavcan::MaxCanIfaces * 2] = { };
 
             for (unsigned i = 0; i < ifaces_.size(); i++)
             {
@@ -688,12 +1822,20 @@ public:
                 {
                     pollfds[num_pollfds].fd = ifaces_[i]->getFileDescriptor();
                     pollfds[num_pollfds].events = POLLIN;
-                    if (ifaces_[i]->hasReadyTx() || (inout_masks.write & (1U << i)))
+                    if (ifaces_[i]->hasReadyTx())       // Otherwise, only a loopback can release the TX queue
                     {
                         pollfds[num_pollfds].events |= POLLOUT;
                     }
                     pollfd_index_to_iface[num_pollfds] = ifaces_[i].get();
                     num_pollfds++;
+
+                    if (ifaces_[i]->getLoopbackFileDescriptor() >= 0)
+                    {
+                        pollfds[num_pollfds].fd = ifaces_[i]->getLoopbackFileDescriptor();
+                        pollfds[num_pollfds].events = POLLIN;
+                        pollfd_index_to_iface[num_pollfds] = ifaces_[i].get();
+                        num_pollfds++;
+                    }
                 }
             }
 
@@ -722,11 +1864,23 @@ public:
             // Handling poll output
             for (unsigned i = 0; i < num_pollfds; i++)
             {
-                pollfd_index_to_iface[i]->updateDownStatusFromPollResult(pollfds[i]);
+                IfaceWrapper* const iface = pollfd_index_to_iface[i];
+                if (pollfds[i].fd == iface->getFileDescriptor())
+                {
+                    iface->updateDownStatusFromPollResult(pollfds[i]);
 
-                const bool poll_read  = pollfds[i].revents & POLLIN;
-                const bool poll_write = pollfds[i].revents & POLLOUT;
-                pollfd_index_to_iface[i]->poll(poll_read, poll_write);
+                    const bool poll_read  = pollfds[i].revents & POLLIN;
+                    const bool poll_write = pollfds[i].revents & POLLOUT;
+                    iface->poll(poll_read, poll_write);
+                }
+                else if (pollfds[i].revents & POLLIN)
+                {
+                    iface->poll(true, true);    // The echo may release the TX queue, which was not polled for POLLOUT
+                }
+                else
+                {
+                    ;   // Errors are detected on the main socket
+                }
             }
         }
 
@@ -734,9 +1888,9 @@ public:
         inout_masks = uavcan::CanSelectMasks();
         for (unsigned i = 0; i < ifaces_.size(); i++)
         {
-            if (!ifaces_[i]->isDown())
+            if (ifaces_[i]->isWriteable())
             {
-                inout_masks.write |= std::uint8_t(1U << i);     // Always ready to write if not down
+                inout_masks.write |= std::uint8_t(1U << i);     // Ready to write if not down and TX queue not full
             }
             if (ifaces_[i]->hasReadyRx())
             {
@@ -768,21 +1922,35 @@ public:
             return -1;
         }
 
-        // Open the socket
-        const int fd = SocketCanIface::openSocket(iface_name);
+        // Open the socket, and the loopback socket in the Selective loopback mode
+        const int fd = SocketCanIface::openSocket(iface_name, ts_mode_, loopback_mode_);
         if (fd < 0)
         {
             return fd;
         }
+        int loopback_fd = -1;
+        if (loopback_mode_ == SocketCanLoopbackMode::Selective)
+        {
+            loopback_fd = SocketCanIface::openSocket(iface_name, ts_mode_);
+            if (loopback_fd < 0)
+            {
+                (void)::close(fd);
+                return loopback_fd;
+            }
+        }
 
-        // Construct the iface - upon successful construction the iface will take ownership of the fd.
+        // Construct the iface - upon successful construction the iface will take ownership of the fds.
         try
         {
-            ifaces_.emplace_back(new IfaceWrapper(clock_, fd));
+            ifaces_.emplace_back(new IfaceWrapper(clock_, fd, io_mode_, loopback_fd));
         }
         catch (...)
         {
             (void)::close(fd);
+            if (loopback_fd >= 0)
+            {
+                (void)::close(loopback_fd);
+            }
             throw;
         }
 
@@ -798,6 +1966,324 @@ public:
     {
         return ifaces_.at(iface_index)->isDown();
     }
+
+    /**
+     * One descriptor per functioning iface, plus the loopback socket in the Selective loopback mode, same as in
+     * @ref select().
+     */
+    std::vector<::pollfd> getPollFds() const override
+    {
+        std::vector<::pollfd> pollfds;
+        for (auto& iface : ifaces_)
+        {
+            if (!iface->isDown())
+            {
+                auto pfd = ::pollfd();
+                pfd.fd = iface->getFileDescriptor();
+                pfd.events = POLLIN;
+                if (iface->hasReadyTx())
+                {
+                    pfd.events |= POLLOUT;
+                }
+                pollfds.push_back(pfd);
+                if (iface->getLoopbackFileDescriptor() >= 0)
+                {
+                    pfd.fd = iface->getLoopbackFileDescriptor();
+                    pfd.events = POLLIN;
+                    pollfds.push_back(pfd);
+                }
+            }
+        }
+        return pollfds;
+    }
+};
+
+/**
+ * Same as @ref SocketCanDriver, but uses epoll() for multiplexing.
+ *
+ * Sockets are registered with the epoll instance once, when added, in edge-triggered mode, so the cost of
+ * select() does not depend on the number of interfaces, and no FD set needs to be rebuilt on every call.
+ * This is useful when one process runs many nodes or interfaces.
+ *
+ * The epoll file descriptor is available via @ref getEpollFileDescriptor(). It becomes readable when any of the
+ * registered sockets has pending events, which allows to integrate the node into an external event loop:
+ * add the epoll FD into the application's poll()/epoll() set, and call spin() with zero timeout once it becomes
+ * readable.
+ *
+ * Interface down handling is the same as in @ref SocketCanDriver.
+ */
+class SocketCanEpollDriver : public uavcan::ICanDriver
+                           , public IPollableCanDriver
+{
+    class IfaceWrapper : public SocketCanIface
+    {
+        bool down_ = false;
+
+    public:
+        IfaceWrapper(const SystemClock& clock, int fd, SocketCanIoMode io_mode, int loopback_fd)
+            : SocketCanIface(clock, fd, DefaultMaxFramesInSocketTxQueue, io_mode, DefaultTxQueueCapacity,
+                             DefaultRxQueueCapacity, loopback_fd)
+        { }
+
+        /**
+         * Returns true if the iface has just become down.
+         */
+        bool updateDownStatusFromEpollEvents(std::uint32_t events)
+        {
+            if (!down_ && (events & (EPOLLERR | EPOLLHUP)))
+            {
+                int error = 0;
+                ::socklen_t errlen = sizeof(error);
+                (void)::getsockopt(getFileDescriptor(), SOL_SOCKET, SO_ERROR, reinterpret_cast<void*>(&error),
+                                   &errlen);
+
+                down_ = error == ENETDOWN || error == ENODEV;
+
+                UAVCAN_TRACE("SocketCAN", "Iface %d is dead; error %d", this->getFileDescriptor(), error);
+                return down_;
+            }
+            return false;
+        }
+
+        bool isDown() const { return down_; }
+
+        bool isWriteable() const { return !down_ && !isTxQueueFull(); }
+    };
+
+    /**
+     * Set in the epoll event data for the loopback sockets; the rest is the iface index.
+     */
+    static constexpr std::uint32_t LoopbackSocketEventTag = 1U << 31;
+
+    const SystemClock& clock_;
+    const SocketCanIoMode io_mode_;
+    const SocketCanTimestampMode ts_mode_;
+    const SocketCanLoopbackMode loopback_mode_;
+    const int epoll_fd_;
+    std::vector<std::unique_ptr<IfaceWrapper>> ifaces_;
+
+    unsigned getNumIfacesUp() const
+    {
+        unsigned num = 0;
+        for (auto& x : ifaces_)
+        {
+            num += x->isDown() ? 0U : 1U;
+        }
+        return num;
+    }
+
+public:
+    /**
+     * Same as @ref SocketCanDriver::SocketCanDriver().
+     * @throws uavcan_linux::Exception if the epoll instance could not be created.
+     */
+    explicit SocketCanEpollDriver(const SystemClock& clock, SocketCanIoMode io_mode = SocketCanIoMode::PerFrame,
+                                  SocketCanTimestampMode ts_mode = SocketCanTimestampMode::Software,
+                                  SocketCanLoopbackMode loopback_mode = SocketCanLoopbackMode::AllFrames)
+        : clock_(clock)
+        , io_mode_(io_mode)
+        , ts_mode_(ts_mode)
+        , loopback_mode_(loopback_mode)
+        , epoll_fd_(::epoll_create1(EPOLL_CLOEXEC))
+    {
+        if (epoll_fd_ < 0)
+        {
+            throw Exception("Failed to create epoll instance");
+        }
+        ifaces_.reserve(uavcan::MaxCanIfaces);
+    }
+
+    /**
+     * Sockets of all ifaces will be closed with the ifaces.
+     */
+    virtual ~SocketCanEpollDriver()
+    {
+        ifaces_.clear();
+        UAVCAN_TRACE("SocketCAN", "SocketCanEpollDriver: Closing epoll fd %d", epoll_fd_);
+        (void)::close(epoll_fd_);
+    }
+
+    /**
+     * Same as @ref SocketCanDriver::select().
+     * Since epoll_wait() has millisecond resolution, the timeout is rounded up.
+     */
+    std::int16_t select(uavcan::CanSelectMasks& inout_masks,
+                        const uavcan::CanFrame* (&)[uavcan::MaxCanIfaces],
+                        uavcan::MonotonicTime blocking_deadline) override
+    {
+        // Detecting whether we need to block at all
+        bool need_block = true;
+        for (unsigned i = 0; need_block && (i < ifaces_.size()); i++)
+        {
+            const bool need_read  = inout_masks.read  & (1 << i);
+            const bool need_write = inout_masks.write & (1 << i);
+            if ((need_read && ifaces_[i]->hasReadyRx()) || (need_write && ifaces_[i]->isWriteable()))
+            {
+                need_block = false;
+            }
+        }
+
+        if (need_block)
+        {
+            // This is where we abort when the last iface goes down
+            if (getNumIfacesUp() == 0)
+            {
+                throw AllIfacesDownException();
+            }
+
+            // Timeout conversion
+            const std::int64_t timeout_usec = (blocking_deadline - clock_.getMonotonic()).toUSec();
+            const int timeout_ms = (timeout_usec > 0) ? int((timeout_usec + 999) / 1000) : 0;
+
+            // Blocking here
+            ::epoll_event events[uavcan::MaxCanIfaces] = {};
+            const int res = ::epoll_wait(epoll_fd_, events, uavcan::MaxCanIfaces, timeout_ms);
+            if (res < 0)
+            {
+                return res;
+            }
+
+            // Handling epoll output. Edge-triggered mode requires the sockets to be fully drained, which is
+            // always the case with SocketCanIface::poll().
+            for (int i = 0; i < res; i++)
+            {
+                IfaceWrapper* const iface = ifaces_.at(events[i].data.u32 & ~LoopbackSocketEventTag).get();
+                const bool main_socket = (events[i].data.u32 & LoopbackSocketEventTag) == 0;
+                if (main_socket && iface->updateDownStatusFromEpollEvents(events[i].events))
+                {
+                    (void)::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, iface->getFileDescriptor(), nullptr);
+                    if (iface->getLoopbackFileDescriptor() >= 0)
+                    {
+                        (void)::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, iface->getLoopbackFileDescriptor(), nullptr);
+                    }
+                }
+
+                // Writing is attempted on any event, because reading may release the socket TX queue
+                const bool poll_read = events[i].events & EPOLLIN;
+                iface->poll(poll_read, true);
+            }
+        }
+
+        // Writing the output masks
+        inout_masks = uavcan::CanSelectMasks();
+        for (unsigned i = 0; i < ifaces_.size(); i++)
+        {
+            if (ifaces_[i]->isWriteable())
+            {
+                inout_masks.write |= std::uint8_t(1U << i);     // Ready to write if not down and TX queue not full
+            }
+            if (ifaces_[i]->hasReadyRx())
+            {
+                inout_masks.read |= std::uint8_t(1U << i);      // Readability depends only on RX buf, even if down
+            }
+        }
+
+        // Return value is irrelevant as long as it's non-negative
+        return ifaces_.size();
+    }
+
+    SocketCanIface* getIface(std::uint8_t iface_index) override
+    {
+        return (iface_index >= ifaces_.size()) ? nullptr : ifaces_[iface_index].get();
+    }
+
+    std::uint8_t getNumIfaces() const override { return ifaces_.size(); }
+
+    /**
+     * Same as @ref SocketCanDriver::addIface().
+     * The socket (and the loopback socket in the Selective loopback mode) is registered with the epoll instance
+     * here.
+     * @throws uavcan_linux::Exception.
+     */
+    int addIface(const std::string& iface_name)
+    {
+        if (ifaces_.size() >= uavcan::MaxCanIfaces)
+        {
+            return -1;
+        }
+
+        // Open the socket, and the loopback socket in the Selective loopback mode
+        const int fd = SocketCanIface::openSocket(iface_name, ts_mode_, loopback_mode_);
+        if (fd < 0)
+        {
+            return fd;
+        }
+        int loopback_fd = -1;
+        if (loopback_mode_ == SocketCanLoopbackMode::Selective)
+        {
+            loopback_fd = SocketCanIface::openSocket(iface_name, ts_mode_);
+            if (loopback_fd < 0)
+            {
+                (void)::close(fd);
+                return loopback_fd;
+            }
+        }
+
+        // Construct the iface - upon successful construction the iface will take ownership of the fds.
+        try
+        {
+            ifaces_.emplace_back(new IfaceWrapper(clock_, fd, io_mode_, loopback_fd));
+        }
+        catch (...)
+        {
+            (void)::close(fd);
+            if (loopback_fd >= 0)
+            {
+                (void)::close(loopback_fd);
+            }
+            throw;
+        }
+
+        // Register once, in edge-triggered mode
+        auto ev = ::epoll_event();
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLET;
+        ev.data.u32 = std::uint32_t(ifaces_.size() - 1);
+        if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) < 0)
+        {
+            ifaces_.pop_back();     // This will close the socket
+            return -1;
+        }
+        if (loopback_fd >= 0)
+        {
+            ev.events = EPOLLIN | EPOLLET;
+            ev.data.u32 |= LoopbackSocketEventTag;
+            if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, loopback_fd, &ev) < 0)
+            {
+                (void)::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+                ifaces_.pop_back();
+                return -1;
+            }
+        }
+
+        UAVCAN_TRACE("SocketCAN", "New iface '%s' fd %d (epoll)", iface_name.c_str(), fd);
+
+        return ifaces_.size() - 1;
+    }
+
+    /**
+     * Returns false if the specified interface is functioning, true if it became unavailable.
+     */
+    bool isIfaceDown(std::uint8_t iface_index) const
+    {
+        return ifaces_.at(iface_index)->isDown();
+    }
+
+    /**
+     * Returns the epoll file descriptor, see the class comment.
+     * The application must not close it or modify its registrations.
+     */
+    int getEpollFileDescriptor() const { return epoll_fd_; }
+
+    /**
+     * The epoll descriptor only; it becomes readable on any IO event of the ifaces.
+     */
+    std::vector<::pollfd> getPollFds() const override
+    {
+        auto pfd = ::pollfd();
+        pfd.fd = epoll_fd_;
+        pfd.events = POLLIN;
+        return std::vector<::pollfd>{ pfd };
+    }
 };
 
 }
@@ -0,0 +1,879 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#pragma once
+
+#include <cassert>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+#include <linux/io_uring.h>
+
+#include <uavcan/uavcan.hpp>
+#include <uavcan_linux/clock.hpp>
+#include <uavcan_linux/exception.hpp>
+#include <uavcan_linux/socketcan.hpp>
+
+/*
+ * This header is not included by uavcan_linux.hpp, because it requires the kernel headers of Linux 6.0 or newer;
+ * it must be included explicitly.
+ */
+
+namespace uavcan_linux
+{
+/**
+ * Minimal io_uring instance: the submission and the completion rings mapped into the user space.
+ * The system calls are used directly, so liburing is not required.
+ * Not thread safe.
+ */
+class IoUring
+{
+    int fd_ = -1;
+    ::io_uring_params params_ = ::io_uring_params();
+
+    void* sq_ring_ = MAP_FAILED;
+    std::size_t sq_ring_size_ = 0;
+    void* cq_ring_ = MAP_FAILED;
+    std::size_t cq_ring_size_ = 0;
+    void* sqes_ = MAP_FAILED;
+    std::size_t sqes_size_ = 0;
+
+    unsigned* sq_head_ = nullptr;
+    unsigned* sq_tail_ = nullptr;
+    unsigned* sq_flags_ = nullptr;
+    unsigned* sq_array_ = nullptr;
+    unsigned sq_mask_ = 0;
+    unsigned* cq_head_ = nullptr;
+    unsigned* cq_tail_ = nullptr;
+    ::io_uring_cqe* cqes_ = nullptr;
+    unsigned cq_mask_ = 0;
+
+    unsigned sq_local_tail_ = 0;        ///< Includes the prepared entries that are not published to the kernel yet
+
+    template <typename T>
+    static T* atOffset(void* base, std::uint32_t offset)
+    {
+        return reinterpret_cast<T*>(static_cast<std::uint8_t*>(base) + offset);
+    }
+
+    unsigned getSqHead() const { return __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE); }
+
+public:
+    /**
+     * The completion queue must be large enough to hold the completions of all operations in flight, including
+     * the ones of the multishot receives; the kernel keeps the overflowing completions otherwise, which is slow.
+     * @throws uavcan_linux::Exception if the instance could not be created.
+     */
+    IoUring(unsigned sq_entries, unsigned cq_entries)
+    {
+        params_.flags = IORING_SETUP_CQSIZE;
+        params_.cq_entries = cq_entries;
+        fd_ = int(::syscall(SYS_io_uring_setup, sq_entries, &params_));
+        if (fd_ < 0)
+        {
+            throw Exception("Failed to create io_uring instance");
+        }
+        if ((params_.features & IORING_FEAT_EXT_ARG) == 0)
+        {
+            close();
+            throw Exception("io_uring does not support wait timeouts", ENOSYS);
+        }
+
+        sq_ring_size_ = params_.sq_off.array + params_.sq_entries * sizeof(unsigned);
+        cq_ring_size_ = params_.cq_off.cqes + params_.cq_entries * sizeof(::io_uring_cqe);
+        if (params_.features & IORING_FEAT_SINGLE_MMAP)
+        {
+            sq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+            cq_ring_size_ = sq_ring_size_;
+        }
+        sqes_size_ = params_.sq_entries * sizeof(::io_uring_sqe);
+
+        sq_ring_ = ::mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_,
+                          IORING_OFF_SQ_RING);
+        if ((sq_ring_ != MAP_FAILED) && (params_.features & IORING_FEAT_SINGLE_MMAP))
+        {
+            cq_ring_ = sq_ring_;
+        }
+        else if (sq_ring_ != MAP_FAILED)
+        {
+            cq_ring_ = ::mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_,
+                              IORING_OFF_CQ_RING);
+        }
+        if (cq_ring_ != MAP_FAILED)
+        {
+            sqes_ = ::mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_,
+                           IORING_OFF_SQES);
+        }
+        if (sqes_ == MAP_FAILED)
+        {
+            const int error = errno;
+            close();
+            throw Exception("Failed to map io_uring", error);
+        }
+
+        sq_head_  = atOffset<unsigned>(sq_ring_, params_.sq_off.head);
+        sq_tail_  = atOffset<unsigned>(sq_ring_, params_.sq_off.tail);
+        sq_flags_ = atOffset<unsigned>(sq_ring_, params_.sq_off.flags);
+        sq_array_ = atOffset<unsigned>(sq_ring_, params_.sq_off.array);
+        sq_mask_  = *atOffset<unsigned>(sq_ring_, params_.sq_off.ring_mask);
+        cq_head_  = atOffset<unsigned>(cq_ring_, params_.cq_off.head);
+        cq_tail_  = atOffset<unsigned>(cq_ring_, params_.cq_off.tail);
+        cqes_     = atOffset<::io_uring_cqe>(cq_ring_, params_.cq_off.cqes);
+        cq_mask_  = *atOffset<unsigned>(cq_ring_, params_.cq_off.ring_mask);
+
+        sq_local_tail_ = *sq_tail_;
+    }
+
+    ~IoUring() { close(); }
+
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    /**
+     * Destroys the instance; the kernel cancels all operations in flight. Does nothing if already closed.
+     */
+    void close()
+    {
+        if (sqes_ != MAP_FAILED)
+        {
+            (void)::munmap(sqes_, sqes_size_);
+            sqes_ = MAP_FAILED;
+        }
+        if ((cq_ring_ != MAP_FAILED) && (cq_ring_ != sq_ring_))
+        {
+            (void)::munmap(cq_ring_, cq_ring_size_);
+        }
+        cq_ring_ = MAP_FAILED;
+        if (sq_ring_ != MAP_FAILED)
+        {
+            (void)::munmap(sq_ring_, sq_ring_size_);
+            sq_ring_ = MAP_FAILED;
+        }
+        if (fd_ >= 0)
+        {
+            UAVCAN_TRACE("IoUring", "Closing fd %d", fd_);
+            (void)::close(fd_);
+            fd_ = -1;
+        }
+    }
+
+    /**
+     * Returns a zeroed submission queue entry, or null if the queue is full.
+     * The entry is passed to the kernel on the next call of @ref enter().
+     */
+    ::io_uring_sqe* getSqe()
+    {
+        if (getNumFreeSqes() == 0)
+        {
+            return nullptr;
+        }
+        const unsigned index = sq_local_tail_ & sq_mask_;
+        ::io_uring_sqe* const sqe = static_cast<::io_uring_sqe*>(sqes_) + index;
+        *sqe = ::io_uring_sqe();
+        sq_array_[index] = index;
+        sq_local_tail_++;
+        return sqe;
+    }
+
+    unsigned getNumFreeSqes() const { return params_.sq_entries - (sq_local_tail_ - getSqHead()); }
+
+    bool hasUnsubmittedSqes() const { return sq_local_tail_ != getSqHead(); }
+
+    /**
+     * The kernel keeps the completions that did not fit into the completion queue; they are flushed into the queue
+     * by @ref enter().
+     */
+    bool hasCqOverflow() const { return (__atomic_load_n(sq_flags_, __ATOMIC_ACQUIRE) & IORING_SQ_CQ_OVERFLOW) != 0; }
+
+    /**
+     * Submits the prepared entries and waits until at least min_complete completions are available, or until the
+     * timeout expires; zero min_complete does not wait.
+     * @return Non-negative on success, including the timeout and the interruption by a signal; negative on error.
+     */
+    int enter(unsigned min_complete, std::int64_t timeout_usec)
+    {
+        __atomic_store_n(sq_tail_, sq_local_tail_, __ATOMIC_RELEASE);
+
+        auto ts = ::__kernel_timespec();
+        auto arg = ::io_uring_getevents_arg();
+        unsigned flags = IORING_ENTER_GETEVENTS;        // Also flushes the overflown completions
+        void* argp = nullptr;
+        std::size_t argsz = 0;
+        if (min_complete > 0)
+        {
+            if (timeout_usec > 0)
+            {
+                ts.tv_sec = timeout_usec / 1000000LL;
+                ts.tv_nsec = (timeout_usec % 1000000LL) * 1000;
+            }
+            arg.ts = reinterpret_cast<std::uint64_t>(&ts);
+            flags |= IORING_ENTER_EXT_ARG;
+            argp = &arg;
+            argsz = sizeof(arg);
+        }
+
+        const long res = ::syscall(SYS_io_uring_enter, fd_, sq_local_tail_ - getSqHead(), min_complete, flags,
+                                   argp, argsz);
+        if ((res < 0) && (errno != ETIME) && (errno != EINTR) && (errno != EBUSY) && (errno != EAGAIN))
+        {
+            return -1;
+        }
+        return 0;
+    }
+
+    /**
+     * Calls the handler for every completion available; no system calls are involved.
+     * @return Number of completions processed.
+     */
+    template <typename Handler>
+    unsigned reapCompletions(Handler handler)
+    {
+        unsigned head = *cq_head_;                      // Written by the user space only
+        const unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+        unsigned num_reaped = 0;
+        while (head != tail)
+        {
+            const ::io_uring_cqe cqe = cqes_[head & cq_mask_];
+            head++;
+            num_reaped++;
+            handler(cqe);
+        }
+        __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+        return num_reaped;
+    }
+
+    /**
+     * Registers a provided buffer ring, see @ref IoUringBufferRing.
+     * @return 0 on success, negative on error.
+     */
+    int registerBufferRing(void* ring, unsigned num_entries, std::uint16_t group_id)
+    {
+        auto reg = ::io_uring_buf_reg();
+        reg.ring_addr = reinterpret_cast<std::uint64_t>(ring);
+        reg.ring_entries = num_entries;
+        reg.bgid = group_id;
+        return (::syscall(SYS_io_uring_register, fd_, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) ? -1 : 0;
+    }
+
+    /**
+     * The descriptor becomes readable when there are completions available.
+     */
+    int getFileDescriptor() const { return fd_; }
+};
+
+/**
+ * Set of equally sized buffers provided to the kernel via a provided buffer ring; the receive operations that
+ * select a buffer from the group take it out of the ring, and it must be returned with @ref recycle() once
+ * its contents have been processed.
+ */
+class IoUringBufferRing
+{
+    ::io_uring_buf* bufs_ = nullptr;                ///< The tail of the ring overlays the last field of bufs_[0]
+    std::size_t ring_size_ = 0;
+    std::vector<std::uint8_t> storage_;
+    const std::size_t buffer_size_;
+    const unsigned num_buffers_;
+    std::uint16_t tail_ = 0;
+
+public:
+    /**
+     * @param num_buffers   Power of two, at most 32768.
+     * @throws uavcan_linux::Exception if the ring could not be registered.
+     */
+    IoUringBufferRing(IoUring& ring, std::uint16_t group_id, unsigned num_buffers, std::size_t buffer_size)
+        : storage_(num_buffers * buffer_size)
+        , buffer_size_(buffer_size)
+        , num_buffers_(num_buffers)
+    {
+        assert((num_buffers_ > 0) && (num_buffers_ <= 32768) && ((num_buffers_ & (num_buffers_ - 1)) == 0));
+
+        ring_size_ = num_buffers_ * sizeof(::io_uring_buf);
+        void* const mem = ::mmap(nullptr, ring_size_, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+        if (mem == MAP_FAILED)
+        {
+            throw Exception("Failed to allocate io_uring buffer ring");
+        }
+        bufs_ = static_cast<::io_uring_buf*>(mem);
+
+        if (ring.registerBufferRing(bufs_, num_buffers_, group_id) < 0)
+        {
+            const int error = errno;
+            (void)::munmap(bufs_, ring_size_);
+            throw Exception("Failed to register io_uring buffer ring", error);
+        }
+
+        for (unsigned i = 0; i < num_buffers_; i++)
+        {
+            recycle(std::uint16_t(i));
+        }
+        publish();
+    }
+
+    /**
+     * The ring must be unregistered or its io_uring destroyed before.
+     */
+    ~IoUringBufferRing() { (void)::munmap(bufs_, ring_size_); }
+
+    IoUringBufferRing(const IoUringBufferRing&) = delete;
+    IoUringBufferRing& operator=(const IoUringBufferRing&) = delete;
+
+    /**
+     * Returns the buffer into the ring; the kernel sees it after @ref publish().
+     */
+    void recycle(std::uint16_t buffer_id)
+    {
+        assert(buffer_id < num_buffers_);
+        ::io_uring_buf& buf = bufs_[tail_ & (num_buffers_ - 1U)];
+        buf.addr = reinterpret_cast<std::uint64_t>(getBuffer(buffer_id));
+        buf.len = std::uint32_t(buffer_size_);
+        buf.bid = buffer_id;
+        tail_++;
+    }
+
+    void publish() { __atomic_store_n(&bufs_[0].resv, tail_, __ATOMIC_RELEASE); }
+
+    std::uint8_t* getBuffer(std::uint16_t buffer_id) { return storage_.data() + buffer_id * buffer_size_; }
+
+    std::size_t getBufferSize() const { return buffer_size_; }
+};
+
+/**
+ * Same as @ref SocketCanDriver, but performs the socket IO via io_uring, which saves most of the system calls
+ * under heavy traffic:
+ *  - The frames are received by one multishot recvmsg() per socket, which stays armed and delivers the frames
+ *    into a provided buffer ring shared by all sockets; the completions are reaped from the shared memory,
+ *    without system calls.
+ *  - The TX frames are submitted in priority order as linked send operations, one chain per iface; if the socket
+ *    can't accept a frame (ENOBUFS), the rest of the chain is canceled by the kernel, all of them are returned
+ *    into the TX queue of the iface, and the iface waits for POLLOUT before the next attempt.
+ *  - One io_uring_enter() per select() submits all prepared operations and waits for the completions; another
+ *    one is issued only if the reaped completions have released more TX frames.
+ *
+ * The ifaces work in the External IO mode (@ref SocketCanIoMode); their queues, the TX flow control, the
+ * timestamping and the loopback modes work the same way as with the other drivers. The frames are read from the
+ * sockets only in select(), so select() must be called for the RX queues to be refilled.
+ *
+ * Requires Linux 6.0 or newer. The interface down handling is the same as in @ref SocketCanDriver; the iface is
+ * considered down when its socket reports ENETDOWN or ENODEV.
+ *
+ * The io_uring descriptor becomes readable when there are completions to reap, so it can be watched by an
+ * external event loop, see @ref getPollFds().
+ */
+class SocketCanUringDriver : public uavcan::ICanDriver
+                           , public IPollableCanDriver
+{
+    class IfaceWrapper : public SocketCanIface
+    {
+        bool down_ = false;
+        bool tx_blocked_ = false;           ///< The socket did not accept a frame; waiting for POLLOUT
+        bool tx_poll_armed_ = false;
+
+    public:
+        IfaceWrapper(const SystemClock& clock, int fd, int loopback_fd)
+            : SocketCanIface(clock, fd, DefaultMaxFramesInSocketTxQueue, SocketCanIoMode::External,
+                             DefaultTxQueueCapacity, DefaultRxQueueCapacity, loopback_fd)
+        { }
+
+        using SocketCanIface::ExternalTxItem;
+        using SocketCanIface::ExternalRxFrameSize;
+        using SocketCanIface::ExternalRxControlSize;
+        using SocketCanIface::beginExternalTx;
+        using SocketCanIface::completeExternalTx;
+        using SocketCanIface::acceptExternalRx;
+        using SocketCanIface::registerError;
+
+        void setDown(int error)
+        {
+            if (!down_)
+            {
+                down_ = true;
+                UAVCAN_TRACE("SocketCAN", "Iface %d is dead; error %d", this->getFileDescriptor(), error);
+            }
+            (void)error;
+        }
+
+        bool isDown() const { return down_; }
+
+        bool isWriteable() const { return !down_ && !isTxQueueFull(); }
+
+        bool isTxBlocked() const { return tx_blocked_; }
+        void setTxBlocked(bool blocked) { tx_blocked_ = blocked; }
+
+        bool isTxPollArmed() const { return tx_poll_armed_; }
+        void setTxPollArmed(bool armed) { tx_poll_armed_ = armed; }
+    };
+
+    /**
+     * Multishot receive of one socket; the message header defines the layout of the provided buffers.
+     */
+    struct RxSocket
+    {
+        IfaceWrapper* iface = nullptr;
+        int fd = -1;
+        bool loopback_socket = false;
+        bool armed = false;
+        ::msghdr msg = ::msghdr();
+    };
+
+    struct TxSlot
+    {
+        IfaceWrapper::ExternalTxItem item;
+        IfaceWrapper* iface = nullptr;      ///< Null if the slot is free
+    };
+
+    /*
+     * The user data of the operations: the kind in the upper half, the index of the RX socket, the TX slot, or
+     * the iface in the lower half.
+     */
+    static constexpr std::uint64_t RxUserDataKind   = 1ULL << 32;
+    static constexpr std::uint64_t TxUserDataKind   = 2ULL << 32;
+    static constexpr std::uint64_t PollUserDataKind = 3ULL << 32;
+    static constexpr std::uint64_t UserDataKindMask = 0xFFFFFFFF00000000ULL;
+
+    static constexpr std::uint16_t RxBufferGroupID = 0;
+    static constexpr unsigned NumRxBuffers = 256;
+    static constexpr unsigned NumTxSlots = 64;
+    static constexpr unsigned SubmissionQueueSize = 128;
+    static constexpr unsigned CompletionQueueSize = 1024;
+
+    static constexpr std::size_t RxBufferSize =
+        (sizeof(::io_uring_recvmsg_out) + IfaceWrapper::ExternalRxControlSize + IfaceWrapper::ExternalRxFrameSize +
+         15U) & ~std::size_t(15U);
+
+    const SystemClock& clock_;
+    const SocketCanTimestampMode ts_mode_;
+    const SocketCanLoopbackMode loopback_mode_;
+    std::vector<std::unique_ptr<IfaceWrapper>> ifaces_;
+    std::vector<RxSocket> rx_sockets_;              ///< Capacity is reserved, since the kernel refers to msg
+    std::vector<TxSlot> tx_slots_;
+    std::vector<unsigned> free_tx_slots_;
+    IoUring ring_;
+    IoUringBufferRing rx_buffers_;
+
+    static bool isKernelVersionAtLeast(unsigned required_major, unsigned required_minor)
+    {
+        auto uts = ::utsname();
+        unsigned major = 0;
+        unsigned minor = 0;
+        if ((::uname(&uts) != 0) || (std::sscanf(uts.release, "%u.%u", &major, &minor) != 2))
+        {
+            return false;
+        }
+        return (major > required_major) || ((major == required_major) && (minor >= required_minor));
+    }
+
+    unsigned getNumIfacesUp() const
+    {
+        unsigned num = 0;
+        for (auto& x : ifaces_)
+        {
+            num += x->isDown() ? 0U : 1U;
+        }
+        return num;
+    }
+
+    void prepareRx()
+    {
+        for (unsigned i = 0; i < rx_sockets_.size(); i++)
+        {
+            RxSocket& sock = rx_sockets_[i];
+            if (sock.armed || sock.iface->isDown())
+            {
+                continue;
+            }
+            ::io_uring_sqe* const sqe = ring_.getSqe();
+            if (sqe == nullptr)
+            {
+                break;
+            }
+            sqe->opcode = IORING_OP_RECVMSG;
+            sqe->fd = sock.fd;
+            sqe->addr = reinterpret_cast<std::uint64_t>(&sock.msg);
+            sqe->ioprio = IORING_RECV_MULTISHOT;
+            sqe->flags = IOSQE_BUFFER_SELECT;
+            sqe->buf_group = RxBufferGroupID;
+            sqe->user_data = RxUserDataKind | i;
+            sock.armed = true;
+        }
+    }
+
+    /**
+     * Takes the TX frames from the ifaces and submits them as one chain of linked sends per iface.
+     */
+    void prepareTx()
+    {
+        for (unsigned iface_index = 0; iface_index < ifaces_.size(); iface_index++)
+        {
+            IfaceWrapper& iface = *ifaces_[iface_index];
+            if (iface.isDown())
+            {
+                continue;
+            }
+            if (iface.isTxBlocked())
+            {
+                if (!iface.isTxPollArmed() && iface.hasReadyTx())
+                {
+                    ::io_uring_sqe* const sqe = ring_.getSqe();
+                    if (sqe != nullptr)
+                    {
+                        sqe->opcode = IORING_OP_POLL_ADD;
+                        sqe->fd = iface.getFileDescriptor();
+                        sqe->poll32_events = POLLOUT;
+                        sqe->user_data = PollUserDataKind | iface_index;
+                        iface.setTxPollArmed(true);
+                    }
+                }
+                continue;
+            }
+
+            ::io_uring_sqe* prev_sqe = nullptr;
+            while (!free_tx_slots_.empty() && (ring_.getNumFreeSqes() > 0))
+            {
+                const unsigned slot_index = free_tx_slots_.back();
+                TxSlot& slot = tx_slots_[slot_index];
+                if (!iface.beginExternalTx(slot.item))
+                {
+                    break;
+                }
+                free_tx_slots_.pop_back();
+                slot.iface = &iface;
+
+                ::io_uring_sqe* const sqe = ring_.getSqe();
+                assert(sqe != nullptr);
+                sqe->opcode = IORING_OP_SEND;
+                sqe->fd = slot.item.via_loopback_socket ? iface.getLoopbackFileDescriptor() :
+                                                          iface.getFileDescriptor();
+                sqe->addr = reinterpret_cast<std::uint64_t>(&slot.item.sockcan_frame);
+                sqe->len = std::uint32_t(slot.item.mtu);
+                sqe->msg_flags = MSG_DONTWAIT;      // The frame must not wait in the kernel behind the TX queue
+                sqe->user_data = TxUserDataKind | slot_index;
+                if (prev_sqe != nullptr)
+                {
+                    prev_sqe->flags |= IOSQE_IO_LINK;   // The next frame is sent only if this one was accepted
+                }
+                prev_sqe = sqe;
+            }
+        }
+    }
+
+    void handleRxCompletion(const ::io_uring_cqe& cqe)
+    {
+        RxSocket& sock = rx_sockets_.at(std::size_t(cqe.user_data & ~UserDataKindMask));
+        if ((cqe.flags & IORING_CQE_F_MORE) == 0)
+        {
+            sock.armed = false;             // Will be re-armed on the next select()
+        }
+
+        if ((cqe.res >= 0) && (cqe.flags & IORING_CQE_F_BUFFER))
+        {
+            const std::uint16_t buffer_id = std::uint16_t(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+            const std::uint8_t* const buffer = rx_buffers_.getBuffer(buffer_id);
+
+            auto out = ::io_uring_recvmsg_out();
+            (void)std::memcpy(&out, buffer, sizeof(out));
+
+            // Layout: header, name (none), control of the requested size, payload
+            const std::size_t payload_offset = sizeof(out) + sock.msg.msg_namelen + sock.msg.msg_controllen;
+            const std::size_t payload_size = (std::size_t(cqe.res) > payload_offset) ?
+                                             std::min<std::size_t>(out.payloadlen, cqe.res - payload_offset) : 0;
+
+            auto msg = ::msghdr();
+            msg.msg_control = const_cast<std::uint8_t*>(buffer + sizeof(out) + sock.msg.msg_namelen);
+            msg.msg_controllen = out.controllen;
+            msg.msg_flags = int(out.flags);
+
+            sock.iface->acceptExternalRx(buffer + payload_offset, payload_size, msg, sock.loopback_socket);
+            rx_buffers_.recycle(buffer_id);
+        }
+        else if (cqe.res == -ENOBUFS)
+        {
+            ;   // The buffers are recycled by now; the frames remain in the socket until the receive is re-armed
+        }
+        else if ((cqe.res == -ENETDOWN) || (cqe.res == -ENODEV))
+        {
+            sock.iface->setDown(-cqe.res);
+        }
+        else if (cqe.res < 0)
+        {
+            sock.iface->registerError(SocketCanError::SocketReadFailure);
+        }
+        else
+        {
+            ;   // Zero-length message without a buffer, nothing to do
+        }
+    }
+
+    void handleTxCompletion(const ::io_uring_cqe& cqe)
+    {
+        const unsigned slot_index = unsigned(cqe.user_data & ~UserDataKindMask);
+        TxSlot& slot = tx_slots_.at(slot_index);
+        assert(slot.iface != nullptr);
+
+        slot.iface->completeExternalTx(slot.item, cqe.res);
+        if ((cqe.res == -ENOBUFS) || (cqe.res == -EAGAIN))
+        {
+            slot.iface->setTxBlocked(true);
+        }
+
+        slot.iface = nullptr;
+        free_tx_slots_.push_back(slot_index);
+    }
+
+    void handlePollCompletion(const ::io_uring_cqe& cqe)
+    {
+        IfaceWrapper& iface = *ifaces_.at(std::size_t(cqe.user_data & ~UserDataKindMask));
+        iface.setTxPollArmed(false);
+        iface.setTxBlocked(false);          // Retrying on errors as well; they will be reported by the sends
+    }
+
+    void handleCompletion(const ::io_uring_cqe& cqe)
+    {
+        switch (cqe.user_data & UserDataKindMask)
+        {
+        case RxUserDataKind:
+        {
+            handleRxCompletion(cqe);
+            break;
+        }
+        case TxUserDataKind:
+        {
+            handleTxCompletion(cqe);
+            break;
+        }
+        case PollUserDataKind:
+        {
+            handlePollCompletion(cqe);
+            break;
+        }
+        default:
+        {
+            assert(0);
+            break;
+        }
+        }
+    }
+
+    void reapCompletions()
+    {
+        const unsigned num_reaped = ring_.reapCompletions([this](const ::io_uring_cqe& cqe)
+                                                          {
+                                                              handleCompletion(cqe);
+                                                          });
+        if (num_reaped > 0)
+        {
+            rx_buffers_.publish();
+        }
+    }
+
+public:
+    /**
+     * Same as @ref SocketCanDriver::SocketCanDriver(), except that the IO mode is always External.
+     * @throws uavcan_linux::Exception if the io_uring instance could not be created, e.g. if the kernel is too old.
+     */
+    explicit SocketCanUringDriver(const SystemClock& clock,
+                                  SocketCanTimestampMode ts_mode = SocketCanTimestampMode::Software,
+                                  SocketCanLoopbackMode loopback_mode = SocketCanLoopbackMode::AllFrames)
+        : clock_(clock)
+        , ts_mode_(ts_mode)
+        , loopback_mode_(loopback_mode)
+        , tx_slots_(NumTxSlots)
+        , ring_(SubmissionQueueSize, CompletionQueueSize)
+        , rx_buffers_(ring_, RxBufferGroupID, NumRxBuffers, RxBufferSize)
+    {
+        if (!isKernelVersionAtLeast(6, 0))
+        {
+            throw Exception("Multishot receive via io_uring requires Linux 6.0 or newer", ENOSYS);
+        }
+        ifaces_.reserve(uavcan::MaxCanIfaces);
+        rx_sockets_.reserve(uavcan::MaxCanIfaces * 2);
+        free_tx_slots_.reserve(NumTxSlots);
+        for (unsigned i = 0; i < NumTxSlots; i++)
+        {
+            free_tx_slots_.push_back(NumTxSlots - 1 - i);
+        }
+    }
+
+    /**
+     * The io_uring instance is destroyed first, which cancels the operations that refer to the buffers;
+     * the sockets of all ifaces will be closed with the ifaces.
+     */
+    virtual ~SocketCanUringDriver()
+    {
+        ring_.close();
+        ifaces_.clear();
+    }
+
+    /**
+     * Same as @ref SocketCanDriver::select().
+     */
+    std::int16_t select(uavcan::CanSelectMasks& inout_masks,
+                        const uavcan::CanFrame* (&)[uavcan::MaxCanIfaces],
+                        uavcan::MonotonicTime blocking_deadline) override
+    {
+        // Detecting whether we need to block at all
+        bool need_block = true;
+        for (unsigned i = 0; need_block && (i < ifaces_.size()); i++)
+        {
+            const bool need_read  = inout_masks.read  & (1 << i);
+            const bool need_write = inout_masks.write & (1 << i);
+            if ((need_read && ifaces_[i]->hasReadyRx()) || (need_write && ifaces_[i]->isWriteable()))
+            {
+                need_block = false;
+            }
+        }
+
+        prepareRx();
+        prepareTx();
+
+        int res = 0;
+        if (need_block)
+        {
+            // This is where we abort when the last iface goes down
+            if (getNumIfacesUp() == 0)
+            {
+                throw AllIfacesDownException();
+            }
+
+            // Blocking here
+            res = ring_.enter(1, (blocking_deadline - clock_.getMonotonic()).toUSec());
+        }
+        else if (ring_.hasUnsubmittedSqes() || ring_.hasCqOverflow())
+        {
+            res = ring_.enter(0, 0);
+        }
+        else
+        {
+            ;   // The completions are reaped without a system call
+        }
+        if (res < 0)
+        {
+            return std::int16_t(res);
+        }
+
+        reapCompletions();
+
+        // The loopback frames may have released the TX queues
+        prepareTx();
+        if (ring_.hasUnsubmittedSqes() && (ring_.enter(0, 0) < 0))
+        {
+            return -1;
+        }
+
+        // Writing the output masks
+        inout_masks = uavcan::CanSelectMasks();
+        for (unsigned i = 0; i < ifaces_.size(); i++)
+        {
+            if (ifaces_[i]->isWriteable())
+            {
+                inout_masks.write |= std::uint8_t(1U << i);     // Ready to write if not down and TX queue not full
+            }
+            if (ifaces_[i]->hasReadyRx())
+            {
+                inout_masks.read |= std::uint8_t(1U << i);      // Readability depends only on RX buf, even if down
+            }
+        }
+
+        // Return value is irrelevant as long as it's non-negative
+        return ifaces_.size();
+    }
+
+    SocketCanIface* getIface(std::uint8_t iface_index) override
+    {
+        return (iface_index >= ifaces_.size()) ? nullptr : ifaces_[iface_index].get();
+    }
+
+    std::uint8_t getNumIfaces() const override { return ifaces_.size(); }
+
+    /**
+     * Same as @ref SocketCanDriver::addIface().
+     * The receive operations of the new sockets are armed on the next select().
+     * @throws uavcan_linux::Exception.
+     */
+    int addIface(const std::string& iface_name)
+    {
+        if (ifaces_.size() >= uavcan::MaxCanIfaces)
+        {
+            return -1;
+        }
+
+        // Open the socket, and the loopback socket in the Selective loopback mode
+        const int fd = SocketCanIface::openSocket(iface_name, ts_mode_, loopback_mode_);
+        if (fd < 0)
+        {
+            return fd;
+        }
+        int loopback_fd = -1;
+        if (loopback_mode_ == SocketCanLoopbackMode::Selective)
+        {
+            loopback_fd = SocketCanIface::openSocket(iface_name, ts_mode_);
+            if (loopback_fd < 0)
+            {
+                (void)::close(fd);
+                return loopback_fd;
+            }
+        }
+
+        // Construct the iface - upon successful construction the iface will take ownership of the fds.
+        try
+        {
+            ifaces_.emplace_back(new IfaceWrapper(clock_, fd, loopback_fd));
+        }
+        catch (...)
+        {
+            (void)::close(fd);
+            if (loopback_fd >= 0)
+            {
+                (void)::close(loopback_fd);
+            }
+            throw;
+        }
+
+        RxSocket sock;
+        sock.iface = ifaces_.back().get();
+        sock.fd = fd;
+        sock.msg.msg_controllen = IfaceWrapper::ExternalRxControlSize;
+        rx_sockets_.push_back(sock);
+        if (loopback_fd >= 0)
+        {
+            sock.fd = loopback_fd;
+            sock.loopback_socket = true;
+            rx_sockets_.push_back(sock);
+        }
+
+        UAVCAN_TRACE("SocketCAN", "New iface '%s' fd %d (io_uring)", iface_name.c_str(), fd);
+
+        return ifaces_.size() - 1;
+    }
+
+    /**
+     * Returns false if the specified interface is functioning, true if it became unavailable.
+     */
+    bool isIfaceDown(std::uint8_t iface_index) const
+    {
+        return ifaces_.at(iface_index)->isDown();
+    }
+
+    /**
+     * The io_uring descriptor only; it becomes readable when there are completions to reap.
+     */
+    std::vector<::pollfd> getPollFds() const override
+    {
+        auto pfd = ::pollfd();
+        pfd.fd = ring_.getFileDescriptor();
+        pfd.events = POLLIN;
+        return std::vector<::pollfd>{ pfd };
+    }
+};
+
+}
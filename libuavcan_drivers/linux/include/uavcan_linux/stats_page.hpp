@@ -0,0 +1,295 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <uavcan/dynamic_memory.hpp>
+#include <uavcan/driver/can.hpp>
+#include <uavcan/transport/dispatcher.hpp>
+#include <uavcan_linux/exception.hpp>
+
+namespace uavcan_linux
+{
+/**
+ * Statistics of one CAN interface in @ref StatsPageData.
+ */
+struct StatsPageIface
+{
+    std::uint64_t frames_tx = 0;
+    std::uint64_t frames_rx = 0;
+    std::uint64_t errors = 0;
+    std::uint64_t frames_deferred = 0;
+    std::uint32_t tx_queue_num_pending_frames = 0;
+    std::uint32_t tx_queue_num_free_blocks = 0;
+};
+
+/**
+ * Contents of the statistics page, see @ref StatsPage. All fields are in the host byte order.
+ * The layout does not depend on the build configuration of the library, so that the monitoring tools need not be
+ * built identically; the counters that are not available in the given configuration are zero.
+ */
+struct StatsPageData
+{
+    static constexpr unsigned MaxIfaces = 8;
+    static constexpr unsigned MaxPoolUsageTags = 8;
+
+    std::uint64_t ts_mono_usec = 0;                 ///< Time of the update
+
+    std::uint64_t transfers_tx = 0;                 ///< uavcan::TransferPerfCounter
+    std::uint64_t transfers_rx = 0;
+    std::uint64_t transfer_errors = 0;
+    std::uint64_t frames_filtered = 0;
+
+    std::uint32_t node_id = 0;                      ///< Zero if the node is passive
+    std::uint32_t num_ifaces = 0;
+
+    std::uint32_t pool_capacity_blocks = 0;
+    std::uint32_t pool_used_blocks = 0;
+    std::uint32_t pool_peak_used_blocks = 0;
+    std::uint32_t reserved = 0;
+
+    /// Indexed by uavcan::PoolUsageTag; available only if UAVCAN_POOL_USAGE_TRACKING is enabled.
+    std::uint32_t pool_used_blocks_per_tag[MaxPoolUsageTags] = {};
+    std::uint32_t pool_peak_used_blocks_per_tag[MaxPoolUsageTags] = {};
+
+    StatsPageIface ifaces[MaxIfaces];
+};
+
+static_assert((unsigned(uavcan::MaxCanIfaces) <= StatsPageData::MaxIfaces) &&
+              (unsigned(uavcan::NumPoolUsageTags) <= StatsPageData::MaxPoolUsageTags),
+              "Stats page layout is too small");
+
+/**
+ * Layout of the shared memory segment of @ref StatsPage.
+ * The data is protected by a seqlock: the sequence is odd while the writer is updating the data, and it is
+ * incremented again once the update is finished. A reader copies the data out and retries if the sequence was odd
+ * or has changed meanwhile; the writer never waits for the readers.
+ */
+struct StatsPageLayout
+{
+    static constexpr std::uint32_t Magic = 0x53505355;     ///< "USPS"
+    static constexpr std::uint32_t Version = 1;
+
+    std::atomic<std::uint32_t> magic;               ///< Written last by the writer, once the segment is initialized
+    std::uint32_t version;
+    std::uint32_t layout_size;
+    std::atomic<std::uint32_t> sequence;            ///< Twice the number of updates, plus one during an update
+    StatsPageData data;
+};
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "Atomics must be lock free to be used in shared memory");
+
+/**
+ * Shared memory segment (shm_open(), i.e. a file under /dev/shm) where a node exposes its transport statistics for
+ * external monitoring, e.g. by a Prometheus exporter running on the same host. Unlike the stats services, this costs
+ * no bus traffic, and the node is never blocked by the readers.
+ *
+ * The writer creates the segment and removes it when destroyed; the readers open it by name. The segment can also
+ * be read by tools written in other languages: map the file, and follow the protocol of @ref StatsPageLayout.
+ * See @ref NodeBase::exportStatsPage(), which keeps the page updated.
+ */
+class StatsPage
+{
+    const std::string name_;
+    const bool owner_;
+    int fd_ = -1;
+    StatsPageLayout* layout_ = nullptr;
+
+    StatsPage(const std::string& name, bool owner)
+        : name_(name)
+        , owner_(owner)
+    { }
+
+    void map(int prot)
+    {
+        void* const p = ::mmap(nullptr, sizeof(StatsPageLayout), prot, MAP_SHARED, fd_, 0);
+        if (p == MAP_FAILED)
+        {
+            throw Exception("Failed to map the stats page " + name_);
+        }
+        layout_ = static_cast<StatsPageLayout*>(p);
+    }
+
+public:
+    /**
+     * Creates the page; a stale page with the same name, e.g. left by a crashed process, is replaced.
+     * The page is readable by the owner and the group.
+     * @throws uavcan_linux::Exception.
+     */
+    static std::shared_ptr<StatsPage> create(const std::string& name)
+    {
+        std::shared_ptr<StatsPage> page(new StatsPage(name, true));
+
+        (void)::shm_unlink(name.c_str());
+        page->fd_ = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0640);
+        if (page->fd_ < 0)
+        {
+            throw Exception("Failed to create the stats page " + name);
+        }
+        if (::ftruncate(page->fd_, sizeof(StatsPageLayout)) < 0)
+        {
+            throw Exception("Failed to allocate the stats page " + name);
+        }
+        page->map(PROT_READ | PROT_WRITE);
+
+        // The memory is zero-filled by the kernel
+        StatsPageLayout& l = *page->layout_;
+        l.version = StatsPageLayout::Version;
+        l.layout_size = sizeof(StatsPageLayout);
+        l.magic.store(StatsPageLayout::Magic, std::memory_order_release);
+        return page;
+    }
+
+    /**
+     * Opens the page for reading.
+     * @throws uavcan_linux::Exception if the page does not exist or is incompatible.
+     */
+    static std::shared_ptr<StatsPage> open(const std::string& name)
+    {
+        std::shared_ptr<StatsPage> page(new StatsPage(name, false));
+
+        page->fd_ = ::shm_open(name.c_str(), O_RDONLY | O_CLOEXEC, 0);
+        if (page->fd_ < 0)
+        {
+            throw Exception("Failed to open the stats page " + name + "; is the node running?");
+        }
+        struct ::stat st = {};
+        if ((::fstat(page->fd_, &st) < 0) || (std::size_t(st.st_size) < sizeof(StatsPageLayout)))
+        {
+            throw Exception("Invalid stats page " + name, EINVAL);
+        }
+        page->map(PROT_READ);
+
+        const StatsPageLayout& l = *page->layout_;
+        if ((l.magic.load(std::memory_order_acquire) != StatsPageLayout::Magic) ||
+            (l.version != StatsPageLayout::Version) ||
+            (l.layout_size != sizeof(StatsPageLayout)))
+        {
+            throw Exception("Incompatible stats page " + name, EINVAL);
+        }
+        return page;
+    }
+
+    ~StatsPage()
+    {
+        if (layout_ != nullptr)
+        {
+            (void)::munmap(layout_, sizeof(StatsPageLayout));
+        }
+        if (fd_ >= 0)
+        {
+            (void)::close(fd_);
+        }
+        if (owner_)
+        {
+            (void)::shm_unlink(name_.c_str());
+        }
+    }
+
+    StatsPage(const StatsPage&) = delete;
+    StatsPage& operator=(const StatsPage&) = delete;
+
+    const std::string& getName() const { return name_; }
+
+    /**
+     * Replaces the contents of the page; never blocks. Only the process that has created the page can write it,
+     * and the calls must not be made from several threads at once.
+     */
+    void write(const StatsPageData& data)
+    {
+        StatsPageLayout& l = *layout_;
+        const std::uint32_t seq = l.sequence.load(std::memory_order_relaxed);
+        l.sequence.store(seq + 1U, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(&l.data, &data, sizeof(data));
+        l.sequence.store(seq + 2U, std::memory_order_release);
+    }
+
+    /**
+     * Copies out a consistent snapshot of the page. Returns false if the writer was updating the page during
+     * every attempt, which can happen only if it updates the page continuously.
+     */
+    bool read(StatsPageData& out_data, unsigned max_attempts = 1000) const
+    {
+        const StatsPageLayout& l = *layout_;
+        for (unsigned i = 0; i < max_attempts; i++)
+        {
+            const std::uint32_t seq = l.sequence.load(std::memory_order_acquire);
+            if ((seq & 1U) != 0)
+            {
+                continue;
+            }
+            std::memcpy(&out_data, &l.data, sizeof(out_data));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (l.sequence.load(std::memory_order_relaxed) == seq)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+/**
+ * Collects the statistics of the node. The node must own its pool allocator, e.g. uavcan::Node<MemPoolSize> or
+ * uavcan_linux::Node; must be called from the thread that spins the node.
+ */
+template <typename NodeType>
+inline StatsPageData collectStatsPageData(NodeType& node)
+{
+    StatsPageData data;
+    data.ts_mono_usec = node.getMonotonicTime().toUSec();
+
+    const uavcan::TransferPerfCounter& perf = node.getDispatcher().getTransferPerfCounter();
+    data.transfers_tx = perf.getTxTransferCount();
+    data.transfers_rx = perf.getRxTransferCount();
+    data.transfer_errors = perf.getErrorCount();
+    data.frames_filtered = perf.getFilteredFrameCount();
+
+    data.node_id = node.getNodeID().get();
+
+    const uavcan::CanIOManager& canio = node.getDispatcher().getCanIOManager();
+    data.num_ifaces = canio.getNumIfaces();
+    for (std::uint8_t i = 0; i < canio.getNumIfaces(); i++)
+    {
+        const uavcan::CanIfacePerfCounters cnt = canio.getIfacePerfCounters(i);
+        const uavcan::CanIfaceTxQueueStatus txq = canio.getIfaceTxQueueStatus(i);
+        StatsPageIface& iface = data.ifaces[i];
+        iface.frames_tx = cnt.frames_tx;
+        iface.frames_rx = cnt.frames_rx;
+        iface.errors = cnt.errors;
+        iface.frames_deferred = cnt.frames_deferred;
+        iface.tx_queue_num_pending_frames = txq.num_pending_frames;
+        iface.tx_queue_num_free_blocks = txq.num_free_blocks;
+    }
+
+    auto& allocator = node.getAllocator();
+    data.pool_capacity_blocks = allocator.getBlockCapacity();
+    data.pool_used_blocks = allocator.getNumUsedBlocks();
+    data.pool_peak_used_blocks = allocator.getPeakNumUsedBlocks();
+#if UAVCAN_POOL_USAGE_TRACKING
+    if (const uavcan::PoolUsageTracker* const tracker = allocator.getUsageTracker())
+    {
+        for (unsigned i = 0; i < uavcan::NumPoolUsageTags; i++)
+        {
+            data.pool_used_blocks_per_tag[i] = tracker->getNumUsedBlocks(uavcan::PoolUsageTag(i));
+            data.pool_peak_used_blocks_per_tag[i] = tracker->getPeakNumUsedBlocks(uavcan::PoolUsageTag(i));
+        }
+    }
+#endif
+    return data;
+}
+
+}
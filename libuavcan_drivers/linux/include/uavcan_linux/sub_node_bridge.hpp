@@ -0,0 +1,905 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <uavcan/error.hpp>
+#include <uavcan/driver/can.hpp>
+#include <uavcan/node/abstract_node.hpp>
+#include <uavcan/transport/frame.hpp>
+#include <uavcan_linux/exception.hpp>
+#include <uavcan_linux/virtual_can.hpp>
+
+namespace uavcan_linux
+{
+/**
+ * Bounded lock-free multiple producer single consumer queue (D. Vyukov's algorithm).
+ * Capacity must be a power of two.
+ */
+template <typename T, unsigned Capacity>
+class MpscRing
+{
+    static_assert((Capacity > 0) && ((Capacity & (Capacity - 1U)) == 0), "Capacity must be a power of two");
+
+    struct Cell
+    {
+        std::atomic<unsigned> sequence;
+        T data;
+    };
+
+    std::array<Cell, Capacity> cells_;
+    alignas(64) std::atomic<unsigned> enqueue_pos_{0};
+    alignas(64) unsigned dequeue_pos_ = 0;              ///< Accessed by the consumer only
+
+public:
+    MpscRing()
+    {
+        for (unsigned i = 0; i < Capacity; i++)
+        {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * Can be called from any thread. Returns false if the queue is full.
+     */
+    bool push(const T& item)
+    {
+        unsigned pos = enqueue_pos_.load(std::memory_order_relaxed);
+        Cell* cell = nullptr;
+        while (true)
+        {
+            cell = &cells_[pos & (Capacity - 1U)];
+            const int diff = int(cell->sequence.load(std::memory_order_acquire) - pos);
+            if (diff == 0)
+            {
+                if (enqueue_pos_.compare_exchange_weak(pos, pos + 1U, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+        cell->data = item;
+        cell->sequence.store(pos + 1U, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Consumer side. Returns false if the queue is empty.
+     */
+    bool pop(T& out_item)
+    {
+        Cell& cell = cells_[dequeue_pos_ & (Capacity - 1U)];
+        if (int(cell.sequence.load(std::memory_order_acquire) - (dequeue_pos_ + 1U)) < 0)
+        {
+            return false;
+        }
+        out_item = cell.data;
+        cell.sequence.store(dequeue_pos_ + Capacity, std::memory_order_release);
+        dequeue_pos_++;
+        return true;
+    }
+
+    /**
+     * Approximate; can be called from any thread.
+     */
+    bool isFull() const
+    {
+        const unsigned pos = enqueue_pos_.load(std::memory_order_relaxed);
+        return int(cells_[pos & (Capacity - 1U)].sequence.load(std::memory_order_acquire) - pos) < 0;
+    }
+};
+
+class SubNodeBridge;
+
+/**
+ * Acceptance filters of one sub-node interface. They are written by the sub-node thread, normally via
+ * uavcan::CanAcceptanceFilterConfigurator, and read by the main node thread; a sequence lock keeps the readers
+ * wait-free unless a reconfiguration is in progress.
+ */
+class SubNodeFilterSet
+{
+    std::atomic<unsigned> sequence_{0};
+    std::atomic<unsigned> num_filters_{0};
+    std::array<std::atomic<std::uint32_t>, uavcan::MaxCanAcceptanceFilters> ids_;
+    std::array<std::atomic<std::uint32_t>, uavcan::MaxCanAcceptanceFilters> masks_;
+
+public:
+    /**
+     * Only one writer is allowed. Zero filters means that all frames are accepted.
+     */
+    void store(const uavcan::CanFilterConfig* configs, unsigned num_configs)
+    {
+        const unsigned seq = sequence_.load(std::memory_order_relaxed);
+        sequence_.store(seq + 1U, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        for (unsigned i = 0; i < num_configs; i++)
+        {
+            ids_[i].store(configs[i].id, std::memory_order_relaxed);
+            masks_[i].store(configs[i].mask, std::memory_order_relaxed);
+        }
+        num_filters_.store(num_configs, std::memory_order_relaxed);
+
+        sequence_.store(seq + 2U, std::memory_order_release);
+    }
+
+    bool accepts(const uavcan::CanFrame& frame) const
+    {
+        while (true)
+        {
+            const unsigned seq = sequence_.load(std::memory_order_acquire);
+            if (seq & 1U)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+
+            const unsigned num_filters = num_filters_.load(std::memory_order_relaxed);
+            bool accepted = (num_filters == 0);
+            for (unsigned i = 0; (i < num_filters) && !accepted; i++)
+            {
+                const std::uint32_t mask = masks_[i].load(std::memory_order_relaxed);
+                accepted = ((frame.id ^ ids_[i].load(std::memory_order_relaxed)) & mask) == 0;
+            }
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (sequence_.load(std::memory_order_relaxed) == seq)
+            {
+                return accepted;
+            }
+        }
+    }
+};
+
+/**
+ * One interface of @ref SubNodeCanDriver; it mirrors the interface of the main node with the same index.
+ * Methods of ICanIface are invoked by the sub-node thread.
+ */
+class SubNodeCanIface : public uavcan::ICanIface
+{
+    friend class SubNodeBridge;
+    friend class SubNodeCanDriver;
+
+    static constexpr unsigned RxQueueCapacity = 512;
+
+    struct RxItem
+    {
+        uavcan::CanRxFrame frame;
+        uavcan::CanIOFlags flags = 0;
+    };
+
+    SubNodeBridge& bridge_;
+    const std::uint8_t index_;
+    const std::uint8_t sub_node_index_;
+    VirtualCanRing<RxItem, RxQueueCapacity> rx_queue_;         ///< Main node thread -> sub-node thread
+    SubNodeFilterSet filters_;
+    std::atomic<std::uint64_t> num_rx_overflows_{0};
+    std::atomic<std::uint64_t> num_tx_failures_{0};
+
+public:
+    SubNodeCanIface(SubNodeBridge& bridge, std::uint8_t index, std::uint8_t sub_node_index)
+        : bridge_(bridge)
+        , index_(index)
+        , sub_node_index_(sub_node_index)
+    { }
+
+    SubNodeCanIface(const SubNodeCanIface&) = delete;
+    SubNodeCanIface& operator=(const SubNodeCanIface&) = delete;
+
+    /**
+     * Returns 0 if the TX queue of the bridge is full; the sub-node will retry later.
+     */
+    std::int16_t send(const uavcan::CanFrame& frame, const uavcan::MonotonicTime tx_deadline,
+                      const uavcan::CanIOFlags flags) override;
+
+    std::int16_t receive(uavcan::CanFrame& out_frame, uavcan::MonotonicTime& out_ts_monotonic,
+                         uavcan::UtcTime& out_ts_utc, uavcan::CanIOFlags& out_flags) override
+    {
+        const RxItem* const item = rx_queue_.peek();
+        if (item == nullptr)
+        {
+            return 0;
+        }
+        out_frame = item->frame;
+        out_ts_monotonic = item->frame.ts_mono;
+        out_ts_utc = item->frame.ts_utc;
+        out_flags = item->flags;
+        rx_queue_.pop();
+        return 1;
+    }
+
+    /**
+     * The frames that are not accepted by the filters are not delivered to this sub-node at all.
+     */
+    std::int16_t configureFilters(const uavcan::CanFilterConfig* filter_configs, std::uint16_t num_configs) override
+    {
+        if ((num_configs > uavcan::MaxCanAcceptanceFilters) || ((filter_configs == nullptr) && (num_configs > 0)))
+        {
+            return -uavcan::ErrInvalidParam;
+        }
+        filters_.store(filter_configs, num_configs);
+        return 0;
+    }
+
+    std::uint16_t getNumFilters() const override { return std::uint16_t(uavcan::MaxCanAcceptanceFilters); }
+
+    /**
+     * RX queue overflows and the frames that could not be passed to the main node.
+     */
+    std::uint64_t getErrorCount() const override { return num_rx_overflows_.load() + num_tx_failures_.load(); }
+
+    std::uint64_t getNumRxOverflows() const { return num_rx_overflows_.load(); }
+
+    bool hasPendingRx() const { return !rx_queue_.isEmpty(); }
+
+    bool canAcceptTx() const;
+};
+
+/**
+ * CAN driver for a sub-node that runs in its own thread, see @ref SubNodeBridge.
+ * Instances are created by the bridge.
+ */
+class SubNodeCanDriver : public uavcan::ICanDriver
+{
+    friend class SubNodeBridge;
+
+    static constexpr unsigned RoutingEventQueueCapacity = 256;
+
+    /**
+     * Change of the set of data types the sub-node listens to, passed to the main node thread.
+     */
+    struct RoutingEvent
+    {
+        enum Type : std::uint8_t { Reset, Add, Remove };
+
+        Type type = Reset;
+        uavcan::DataTypeKind kind = uavcan::DataTypeKindMessage;
+        std::uint16_t data_type_id = 0;
+    };
+
+    /**
+     * Reports the listeners of the sub-node's dispatcher to the bridge, see @ref enableListenerTracking().
+     */
+    class ListenerTracker : public uavcan::IListenerRegistrationObserver
+    {
+        SubNodeCanDriver& owner_;
+
+        void handleListenerRegistered(const uavcan::TransferListener& listener) override
+        {
+            owner_.postRoutingEvent(RoutingEvent::Add, listener);
+        }
+
+        void handleListenerUnregistered(const uavcan::TransferListener& listener) override
+        {
+            owner_.postRoutingEvent(RoutingEvent::Remove, listener);
+        }
+
+    public:
+        explicit ListenerTracker(SubNodeCanDriver& owner) : owner_(owner) { }
+    };
+
+    const uavcan::ISystemClock& clock_;         ///< Clock of the main node
+    std::vector<std::unique_ptr<SubNodeCanIface>> ifaces_;
+
+    // Listener tracking; the sub-node thread is the producer of the event queue, the main node thread is the consumer
+    ListenerTracker listener_tracker_;
+    uavcan::INode* tracked_node_ = nullptr;                     ///< Accessed by the sub-node thread only
+    VirtualCanRing<RoutingEvent, RoutingEventQueueCapacity> routing_events_;
+    std::atomic<bool> routing_resync_needed_{false};            ///< Set if the event queue has overflowed
+    bool routed_ = false;                                       ///< Accessed by the main node thread only
+
+    // Wakeup of the sub-node thread blocked in select(); the mutex is never taken on the data path
+    std::mutex wakeup_mutex_;
+    std::condition_variable wakeup_cv_;
+    std::atomic<bool> waiting_{false};
+
+    uavcan::CanSelectMasks getReadyIfaces(const uavcan::CanSelectMasks& requested) const
+    {
+        uavcan::CanSelectMasks ready;
+        for (unsigned i = 0; i < ifaces_.size(); i++)
+        {
+            const std::uint8_t mask = std::uint8_t(1U << i);
+            if ((requested.read & mask) && ifaces_[i]->hasPendingRx())
+            {
+                ready.read |= mask;
+            }
+            if ((requested.write & mask) && ifaces_[i]->canAcceptTx())
+            {
+                ready.write |= mask;
+            }
+        }
+        return ready;
+    }
+
+    void postRoutingEvent(RoutingEvent::Type type, const uavcan::TransferListener& listener)
+    {
+        RoutingEvent event;
+        event.type = type;
+        event.kind = listener.getDataTypeDescriptor().getKind();
+        event.data_type_id = listener.getDataTypeDescriptor().getID().get();
+        if (!routing_resync_needed_.load(std::memory_order_relaxed) && !routing_events_.push(event))
+        {
+            // The main node will deliver all frames to this sub-node until the full list is passed again
+            routing_resync_needed_.store(true, std::memory_order_release);
+        }
+    }
+
+    void postListenerList(const uavcan::LinkedListRoot<uavcan::TransferListener>& list)
+    {
+        for (const uavcan::TransferListener* p = list.get(); p != nullptr; p = p->getNextListNode())
+        {
+            postRoutingEvent(RoutingEvent::Add, *p);
+        }
+    }
+
+    /**
+     * Replaces the routing state of this sub-node in the bridge with the current list of listeners.
+     */
+    void postAllListeners()
+    {
+        RoutingEvent reset;
+        reset.type = RoutingEvent::Reset;
+        if (!routing_events_.push(reset))
+        {
+            routing_resync_needed_.store(true, std::memory_order_release);
+            return;
+        }
+        const uavcan::Dispatcher& dispatcher = tracked_node_->getDispatcher();
+        postListenerList(dispatcher.getListOfMessageListeners());
+        postListenerList(dispatcher.getListOfServiceRequestListeners());
+        postListenerList(dispatcher.getListOfServiceResponseListeners());
+    }
+
+    /**
+     * Invoked by the sub-node thread; the resync starts once the main node has processed the pending events.
+     */
+    void resyncRoutingIfNeeded()
+    {
+        if ((tracked_node_ != nullptr) && routing_resync_needed_.load(std::memory_order_acquire) &&
+            routing_events_.isEmpty())
+        {
+            routing_resync_needed_.store(false, std::memory_order_relaxed);
+            postAllListeners();
+        }
+    }
+
+    /**
+     * Invoked by the main node thread after new frames were added to the RX queues or the TX queue was drained.
+     */
+    void wakeUp()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);    // Pairs with the fence in select()
+        if (waiting_.load(std::memory_order_relaxed))
+        {
+            {
+                std::lock_guard<std::mutex> lock(wakeup_mutex_);   // Ensures that the waiter is either blocked or
+            }                                                       // has not checked the queues yet
+            wakeup_cv_.notify_all();
+        }
+    }
+
+public:
+    SubNodeCanDriver(SubNodeBridge& bridge, const uavcan::ISystemClock& clock, std::uint8_t num_ifaces,
+                     std::uint8_t sub_node_index)
+        : clock_(clock)
+        , listener_tracker_(*this)
+    {
+        for (std::uint8_t i = 0; i < num_ifaces; i++)
+        {
+            ifaces_.emplace_back(new SubNodeCanIface(bridge, i, sub_node_index));
+        }
+    }
+
+    ~SubNodeCanDriver()
+    {
+        disableListenerTracking();
+    }
+
+    /**
+     * Makes the main node deliver to this sub-node only the frames of the data types it has listeners for:
+     * the sub-node's subscribers, servers and pending service calls are reported to the bridge as they come and go,
+     * and the bridge routes the received frames with a lookup table instead of checking every frame against
+     * every sub-node. Service frames addressed to other nodes are not delivered.
+     *
+     * This replaces the acceptance filters of the sub-node, and it can't be combined with the automatic
+     * reconfiguration mode of uavcan::CanAcceptanceFilterConfigurator, since both need the listener registration
+     * observer of the dispatcher. Must be invoked from the sub-node thread; the node must use this driver.
+     * Returns negative error code.
+     */
+    int enableListenerTracking(uavcan::INode& sub_node)
+    {
+        if (&sub_node.getDispatcher().getCanIOManager().getCanDriver() != this)
+        {
+            return -uavcan::ErrInvalidParam;
+        }
+        const uavcan::IListenerRegistrationObserver* const observer =
+            sub_node.getDispatcher().getListenerRegistrationObserver();
+        if ((observer != nullptr) && (observer != &listener_tracker_))
+        {
+            return -uavcan::ErrLogic;
+        }
+        sub_node.getDispatcher().installListenerRegistrationObserver(&listener_tracker_);
+        tracked_node_ = &sub_node;
+        routing_resync_needed_.store(true, std::memory_order_release);
+        resyncRoutingIfNeeded();
+        return 0;
+    }
+
+    /**
+     * The bridge will keep using the last known set of listeners. Must be invoked from the sub-node thread.
+     */
+    void disableListenerTracking()
+    {
+        if ((tracked_node_ != nullptr) &&
+            (tracked_node_->getDispatcher().getListenerRegistrationObserver() == &listener_tracker_))
+        {
+            tracked_node_->getDispatcher().removeListenerRegistrationObserver();
+        }
+        tracked_node_ = nullptr;
+    }
+
+    bool isListenerTrackingEnabled() const { return tracked_node_ != nullptr; }
+
+    std::int16_t select(uavcan::CanSelectMasks& inout_masks,
+                        const uavcan::CanFrame* (&)[uavcan::MaxCanIfaces],
+                        const uavcan::MonotonicTime blocking_deadline) override
+    {
+        resyncRoutingIfNeeded();
+
+        const uavcan::CanSelectMasks requested = inout_masks;
+        inout_masks = getReadyIfaces(requested);
+
+        const std::int64_t timeout_usec = (blocking_deadline - clock_.getMonotonic()).toUSec();
+        if ((inout_masks.read == 0) && (inout_masks.write == 0) && (timeout_usec > 0))
+        {
+            waiting_.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            std::unique_lock<std::mutex> lock(wakeup_mutex_);
+            inout_masks = getReadyIfaces(requested);
+            if ((inout_masks.read == 0) && (inout_masks.write == 0))
+            {
+                (void)wakeup_cv_.wait_for(lock, std::chrono::microseconds(timeout_usec));
+                inout_masks = getReadyIfaces(requested);
+            }
+            waiting_.store(false, std::memory_order_relaxed);
+        }
+
+        unsigned num_ready = 0;
+        for (unsigned i = 0; i < ifaces_.size(); i++)
+        {
+            num_ready += ((inout_masks.read | inout_masks.write) & (1U << i)) ? 1U : 0U;
+        }
+        return std::int16_t(num_ready);
+    }
+
+    SubNodeCanIface* getIface(std::uint8_t iface_index) override
+    {
+        return (iface_index >= ifaces_.size()) ? nullptr : ifaces_[iface_index].get();
+    }
+
+    std::uint8_t getNumIfaces() const override { return std::uint8_t(ifaces_.size()); }
+};
+
+/**
+ * Connects sub-nodes running in their own threads to the main node, which owns the CAN driver.
+ *
+ * The sub-nodes pass their TX frames to the main node via one lock-free multiple producer queue, which the main
+ * node thread drains into its prioritized TX queue via @ref flushTxQueue(). RX frames are received by the main node
+ * and copied by the bridge into lock-free queues of those sub-nodes whose acceptance filters accept them; the filters
+ * are expected to be configured by the sub-nodes via uavcan::CanAcceptanceFilterConfigurator, e.g. with
+ * enableAutoReconfiguration(), so that every sub-node only gets the frames of its own listeners. A sub-node that
+ * has not configured its filters receives all frames. Loopback frames are returned to the sub-node that sent them.
+ *
+ * Alternatively, a sub-node can report its listeners to the bridge, see
+ * @ref SubNodeCanDriver::enableListenerTracking(); the frames are then routed to such sub-nodes via a table
+ * indexed by transfer type and data type ID, so the cost of a received frame doesn't grow with the number of
+ * sub-nodes that are not interested in it.
+ *
+ * All sub-node drivers must be created before the main node thread starts spinning, and the bridge must outlive
+ * the sub-nodes. Typical main loop:
+ *
+ *     while (true)
+ *     {
+ *         main_node.spin(uavcan::MonotonicDuration::fromMSec(1));
+ *         bridge.flushTxQueue();
+ *     }
+ */
+class SubNodeBridge : public uavcan::IRxFrameListener
+{
+    friend class SubNodeCanIface;
+
+    static constexpr unsigned TxQueueCapacity = 1024;
+    static constexpr unsigned MaxPendingLoopbackFrames = 64;
+    static constexpr unsigned MaxSubNodes = 255;
+
+    struct TxItem
+    {
+        uavcan::CanFrame frame;
+        uavcan::MonotonicTime deadline;
+        uavcan::CanIOFlags flags = 0;
+        std::uint8_t iface_index = 0;
+        std::uint8_t sub_node_index = 0;
+    };
+
+    struct PendingLoopbackFrame
+    {
+        uavcan::CanFrame frame;
+        std::uint8_t iface_index;
+        std::uint8_t sub_node_index;
+    };
+
+    struct Route
+    {
+        std::uint8_t sub_node_index;
+        std::uint16_t num_listeners;
+    };
+
+    typedef std::unordered_map<std::uint32_t, std::vector<Route>> RoutingTable;
+
+    uavcan::INode& main_node_;
+    MpscRing<TxItem, TxQueueCapacity> tx_queue_;
+    std::vector<std::shared_ptr<SubNodeCanDriver>> sub_nodes_;
+
+    // Accessed by the main node thread only
+    std::deque<PendingLoopbackFrame> pending_loopback_;
+    RoutingTable routing_table_;
+    std::vector<std::uint8_t> unrouted_sub_nodes_;     ///< Sub-nodes that rely on the acceptance filters instead
+    std::uint64_t num_tx_injection_failures_ = 0;
+
+    static std::uint32_t makeRoutingKey(uavcan::TransferType transfer_type, std::uint16_t data_type_id)
+    {
+        return (std::uint32_t(transfer_type) << 16) | data_type_id;
+    }
+
+    void addRoute(std::uint32_t key, std::uint8_t sub_node_index)
+    {
+        std::vector<Route>& routes = routing_table_[key];
+        for (Route& r : routes)
+        {
+            if (r.sub_node_index == sub_node_index)
+            {
+                r.num_listeners++;
+                return;
+            }
+        }
+        routes.push_back(Route{ sub_node_index, 1 });
+    }
+
+    void removeRoute(std::uint32_t key, std::uint8_t sub_node_index)
+    {
+        const auto entry = routing_table_.find(key);
+        if (entry == routing_table_.end())
+        {
+            return;
+        }
+        std::vector<Route>& routes = entry->second;
+        for (auto it = routes.begin(); it != routes.end(); ++it)
+        {
+            if (it->sub_node_index == sub_node_index)
+            {
+                if (--it->num_listeners == 0)
+                {
+                    (void)routes.erase(it);
+                }
+                break;
+            }
+        }
+        if (routes.empty())
+        {
+            (void)routing_table_.erase(entry);
+        }
+    }
+
+    void removeAllRoutes(std::uint8_t sub_node_index)
+    {
+        for (auto entry = routing_table_.begin(); entry != routing_table_.end();)
+        {
+            std::vector<Route>& routes = entry->second;
+            for (auto it = routes.begin(); it != routes.end(); ++it)
+            {
+                if (it->sub_node_index == sub_node_index)
+                {
+                    (void)routes.erase(it);
+                    break;
+                }
+            }
+            entry = routes.empty() ? routing_table_.erase(entry) : std::next(entry);
+        }
+    }
+
+    void applyRoutingEvent(const SubNodeCanDriver::RoutingEvent& event, std::uint8_t sub_node_index)
+    {
+        if (event.type == SubNodeCanDriver::RoutingEvent::Reset)
+        {
+            removeAllRoutes(sub_node_index);
+            return;
+        }
+        // Services are routed in both directions, since the sub-node can be both a server and a client
+        std::uint32_t keys[2] = { makeRoutingKey(uavcan::TransferTypeMessageBroadcast, event.data_type_id), 0 };
+        unsigned num_keys = 1;
+        if (event.kind == uavcan::DataTypeKindService)
+        {
+            keys[0] = makeRoutingKey(uavcan::TransferTypeServiceRequest, event.data_type_id);
+            keys[1] = makeRoutingKey(uavcan::TransferTypeServiceResponse, event.data_type_id);
+            num_keys = 2;
+        }
+        for (unsigned i = 0; i < num_keys; i++)
+        {
+            if (event.type == SubNodeCanDriver::RoutingEvent::Add)
+            {
+                addRoute(keys[i], sub_node_index);
+            }
+            else
+            {
+                removeRoute(keys[i], sub_node_index);
+            }
+        }
+    }
+
+    /**
+     * Applies the listener changes reported by the sub-nodes to the routing table.
+     * Executed once per flush rather than per received frame, so the RX path only has to do a table lookup.
+     */
+    void processRoutingEvents()
+    {
+        bool routing_changed = false;
+        for (std::size_t i = 0; i < sub_nodes_.size(); i++)
+        {
+            SubNodeCanDriver& driver = *sub_nodes_[i];
+            const auto sub_node_index = std::uint8_t(i);
+            while (const SubNodeCanDriver::RoutingEvent* const event = driver.routing_events_.peek())
+            {
+                if (event->type == SubNodeCanDriver::RoutingEvent::Reset)
+                {
+                    routing_changed = routing_changed || !driver.routed_;
+                    driver.routed_ = true;
+                }
+                applyRoutingEvent(*event, sub_node_index);
+                driver.routing_events_.pop();
+            }
+            if (driver.routed_ && driver.routing_resync_needed_.load(std::memory_order_acquire))
+            {
+                // Some events were lost, so the routing table is unreliable until the sub-node sends a reset
+                removeAllRoutes(sub_node_index);
+                driver.routed_ = false;
+                routing_changed = true;
+            }
+        }
+
+        if (routing_changed)
+        {
+            unrouted_sub_nodes_.clear();
+            for (std::size_t i = 0; i < sub_nodes_.size(); i++)
+            {
+                if (!sub_nodes_[i]->routed_)
+                {
+                    unrouted_sub_nodes_.push_back(std::uint8_t(i));
+                }
+            }
+        }
+    }
+
+    void deliver(SubNodeCanDriver& driver, const uavcan::CanRxFrame& frame, uavcan::CanIOFlags flags)
+    {
+        SubNodeCanIface& iface = *driver.ifaces_[frame.iface_index];
+        SubNodeCanIface::RxItem item;
+        item.frame = frame;
+        item.flags = flags;
+        if (!iface.rx_queue_.push(item))
+        {
+            iface.num_rx_overflows_++;
+        }
+        driver.wakeUp();
+    }
+
+    void handleLoopbackFrame(const uavcan::CanRxFrame& frame, uavcan::CanIOFlags flags)
+    {
+        for (auto it = pending_loopback_.begin(); it != pending_loopback_.end(); ++it)
+        {
+            if ((it->iface_index == frame.iface_index) && (it->frame == frame))
+            {
+                const std::uint8_t sub_node_index = it->sub_node_index;
+                (void)pending_loopback_.erase(it);
+                deliver(*sub_nodes_[sub_node_index], frame, flags);
+                return;
+            }
+        }
+        // Loopback frames of the main node itself are of no interest for the sub-nodes
+    }
+
+    void handleRxFrame(const uavcan::CanRxFrame& frame, uavcan::CanIOFlags flags) override
+    {
+        if (frame.iface_index >= getNumIfaces())
+        {
+            return;
+        }
+        if (flags & uavcan::CanIOFlagLoopback)
+        {
+            handleLoopbackFrame(frame, flags);
+            return;
+        }
+
+        uavcan::TransferType transfer_type = uavcan::TransferTypeMessageBroadcast;
+        uavcan::DataTypeID data_type_id;
+        uavcan::NodeID dst_node_id;
+        if (!uavcan::Frame::parseAddressing(frame, transfer_type, data_type_id, dst_node_id))
+        {
+            return;
+        }
+        // The sub-nodes share the node ID of the main node, so the service frames addressed elsewhere are useless
+        const bool foreign_service_frame = (transfer_type != uavcan::TransferTypeMessageBroadcast) &&
+                                           (dst_node_id != main_node_.getNodeID());
+
+        if (!foreign_service_frame && !routing_table_.empty())
+        {
+            const auto entry = routing_table_.find(makeRoutingKey(transfer_type, data_type_id.get()));
+            if (entry != routing_table_.end())
+            {
+                for (const Route& r : entry->second)
+                {
+                    deliver(*sub_nodes_[r.sub_node_index], frame, flags);
+                }
+            }
+        }
+
+        for (const std::uint8_t index : unrouted_sub_nodes_)
+        {
+            SubNodeCanDriver& driver = *sub_nodes_[index];
+            if (driver.ifaces_[frame.iface_index]->filters_.accepts(frame))
+            {
+                deliver(driver, frame, flags);
+            }
+        }
+    }
+
+public:
+    /**
+     * The bridge installs itself as the RX frame listener of the main node.
+     */
+    explicit SubNodeBridge(uavcan::INode& main_node)
+        : main_node_(main_node)
+    {
+        if (main_node_.getDispatcher().getRxFrameListener() != nullptr)
+        {
+            throw Exception("RX frame listener of the main node is already installed");
+        }
+        main_node_.getDispatcher().installRxFrameListener(this);
+    }
+
+    ~SubNodeBridge()
+    {
+        if (main_node_.getDispatcher().getRxFrameListener() == this)
+        {
+            main_node_.getDispatcher().removeRxFrameListener();
+        }
+    }
+
+    SubNodeBridge(const SubNodeBridge&) = delete;
+    SubNodeBridge& operator=(const SubNodeBridge&) = delete;
+
+    /**
+     * Creates a driver for a new sub-node; it has the same number of interfaces as the main node.
+     * The sub-node must use a clock with the same monotonic time base as the main node, since the TX deadlines
+     * are passed to the main node as is.
+     * Must be called before the main node thread starts spinning.
+     */
+    std::shared_ptr<SubNodeCanDriver> makeSubNodeDriver()
+    {
+        if (sub_nodes_.size() >= MaxSubNodes)
+        {
+            throw Exception("Too many sub-nodes");
+        }
+        unrouted_sub_nodes_.push_back(std::uint8_t(sub_nodes_.size()));
+        sub_nodes_.emplace_back(new SubNodeCanDriver(*this, main_node_.getSystemClock(), getNumIfaces(),
+                                                     std::uint8_t(sub_nodes_.size())));
+        return sub_nodes_.back();
+    }
+
+    /**
+     * Moves the frames sent by the sub-nodes into the TX queue of the main node, and updates the RX routing table
+     * of the sub-nodes that have enabled listener tracking.
+     * Must be invoked by the main node thread after every spin.
+     * Returns the number of frames moved.
+     */
+    unsigned flushTxQueue()
+    {
+        processRoutingEvents();
+
+        unsigned num_moved = 0;
+        TxItem item;
+        while (tx_queue_.pop(item))
+        {
+            const int res = main_node_.injectTxFrame(item.frame, item.deadline, std::uint8_t(1U << item.iface_index),
+                                                     uavcan::CanTxQueue::Volatile, item.flags);
+            if (res < 0)        // Zero means that the frame was queued by the main node, which is fine
+            {
+                num_tx_injection_failures_++;
+                sub_nodes_[item.sub_node_index]->ifaces_[item.iface_index]->num_tx_failures_++;
+                continue;
+            }
+            num_moved++;
+
+            if (item.flags & uavcan::CanIOFlagLoopback)
+            {
+                if (pending_loopback_.size() >= MaxPendingLoopbackFrames)
+                {
+                    pending_loopback_.pop_front();      // Normally it means that the frames have timed out
+                }
+                pending_loopback_.push_back(PendingLoopbackFrame{ item.frame, item.iface_index,
+                                                                  item.sub_node_index });
+            }
+        }
+
+        if (num_moved > 0)
+        {
+            for (auto& sub_node : sub_nodes_)
+            {
+                sub_node->wakeUp();     // Some of them may be waiting for the TX queue
+            }
+        }
+        return num_moved;
+    }
+
+    std::uint8_t getNumIfaces() const
+    {
+        return main_node_.getDispatcher().getCanIOManager().getNumIfaces();
+    }
+
+    unsigned getNumSubNodes() const { return unsigned(sub_nodes_.size()); }
+
+    /**
+     * Number of distinct transfer types and data type IDs the main node is forwarding to the sub-nodes.
+     */
+    unsigned getNumRoutes() const { return unsigned(routing_table_.size()); }
+
+    /**
+     * Number of frames from the sub-nodes that were rejected by the main node's TX queue.
+     */
+    std::uint64_t getNumTxInjectionFailures() const { return num_tx_injection_failures_; }
+};
+
+/*
+ * SubNodeCanIface implementation; it depends on the definition of SubNodeBridge.
+ */
+inline std::int16_t SubNodeCanIface::send(const uavcan::CanFrame& frame, const uavcan::MonotonicTime tx_deadline,
+                                          const uavcan::CanIOFlags flags)
+{
+    SubNodeBridge::TxItem item;
+    item.frame = frame;
+    item.deadline = tx_deadline;
+    item.flags = flags;
+    item.iface_index = index_;
+    item.sub_node_index = sub_node_index_;
+    return bridge_.tx_queue_.push(item) ? 1 : 0;
+}
+
+inline bool SubNodeCanIface::canAcceptTx() const
+{
+    return !bridge_.tx_queue_.isFull();
+}
+
+}
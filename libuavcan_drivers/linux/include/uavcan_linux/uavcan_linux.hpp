@@ -9,4 +9,18 @@
 #include <uavcan_linux/clock.hpp>
 #include <uavcan_linux/socketcan.hpp>
 #include <uavcan_linux/helpers.hpp>
+#include <uavcan_linux/async.hpp>
 #include <uavcan_linux/system_utils.hpp>
+#include <uavcan_linux/virtual_can.hpp>
+#include <uavcan_linux/sub_node_bridge.hpp>
+#include <uavcan_linux/bus_log.hpp>
+#include <uavcan_linux/offline_decoder.hpp>
+#include <uavcan_linux/layout_json.hpp>
+#include <uavcan_linux/bus_stats.hpp>
+#include <uavcan_linux/realtime.hpp>
+#include <uavcan_linux/shared_can.hpp>
+#include <uavcan_linux/udp_can.hpp>
+#include <uavcan_linux/reactor.hpp>
+#include <uavcan_linux/parallel_rx.hpp>
+#include <uavcan_linux/event_trace_dump.hpp>
+#include <uavcan_linux/log_sink.hpp>
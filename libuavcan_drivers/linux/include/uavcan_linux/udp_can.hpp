@@ -0,0 +1,697 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <uavcan/error.hpp>
+#include <uavcan/driver/can.hpp>
+#include <uavcan_linux/clock.hpp>
+#include <uavcan_linux/exception.hpp>
+#include <uavcan_linux/socketcan.hpp>
+
+namespace uavcan_linux
+{
+/**
+ * Parameters of @ref UdpCanDriver.
+ */
+struct UdpCanParams
+{
+    std::string local_address = "0.0.0.0";
+    std::uint16_t local_port = 0;               ///< Zero picks an ephemeral port
+
+    /**
+     * Where the datagrams are sent. If the address is empty, the driver replies to the peer the last valid datagram
+     * has come from, and drops the TX frames until the first datagram is received; the other way round, when
+     * the address is set, the datagrams from other peers are ignored.
+     */
+    std::string remote_address;
+    std::uint16_t remote_port = 0;
+
+    /**
+     * Number of tunneled CAN ifaces; both sides must use the same number.
+     */
+    unsigned num_ifaces = 1;
+
+    /**
+     * The first frame of a datagram waits for more frames at most this long; zero sends one datagram per frame.
+     * Longer latency decreases the number of datagrams under load.
+     */
+    uavcan::MonotonicDuration flush_latency = uavcan::MonotonicDuration::fromMSec(1);
+
+    /**
+     * Maximum datagram payload; the default is the Ethernet MTU minus the IPv4 and UDP headers,
+     * which avoids IP fragmentation.
+     */
+    unsigned max_datagram_size = 1472;
+
+    unsigned rx_queue_capacity = SocketCanIface::DefaultRxQueueCapacity;
+};
+
+/**
+ * Datagram format of @ref UdpCanDriver; all fields are little endian.
+ *
+ *      Datagram header:    magic u16, version u8, reserved u8, sequence number u32, number of frames u16
+ *      Frame, repeated:    age u32, CAN ID u32, iface index u8, data length u8, data
+ *
+ * The CAN ID includes the flags of uavcan::CanFrame. The age is the number of microseconds between the moment
+ * the frame has been captured and the moment the datagram has been sent; the receiver timestamps the frame as its
+ * own reception time minus the age, so the frame timing is preserved without synchronizing the clocks of the peers.
+ */
+struct UdpCanDatagram
+{
+    static constexpr std::uint16_t Magic = 0x4355;      ///< "UC"
+    static constexpr std::uint8_t Version = 1;
+    static constexpr unsigned HeaderSize = 10;
+    static constexpr unsigned FrameHeaderSize = 10;
+    static constexpr unsigned MaxSize = 65507;
+
+    static void write16(std::uint8_t* p, std::uint16_t x)
+    {
+        p[0] = std::uint8_t(x);
+        p[1] = std::uint8_t(x >> 8);
+    }
+
+    static void write32(std::uint8_t* p, std::uint32_t x)
+    {
+        write16(p, std::uint16_t(x));
+        write16(p + 2, std::uint16_t(x >> 16));
+    }
+
+    static std::uint16_t read16(const std::uint8_t* p) { return std::uint16_t(p[0] | (p[1] << 8)); }
+
+    static std::uint32_t read32(const std::uint8_t* p)
+    {
+        return std::uint32_t(read16(p)) | (std::uint32_t(read16(p + 2)) << 16);
+    }
+};
+
+class UdpCanDriver;
+
+/**
+ * One tunneled interface of @ref UdpCanDriver.
+ */
+class UdpCanIface : public uavcan::ICanIface
+{
+    friend class UdpCanDriver;
+
+    struct RxItem
+    {
+        uavcan::CanFrame frame;
+        uavcan::MonotonicTime ts_mono;
+        uavcan::UtcTime ts_utc;
+        uavcan::CanIOFlags flags = 0;
+    };
+
+    UdpCanDriver& driver_;
+    const SystemClock& clock_;
+    const std::uint8_t index_;
+    FixedCapacityQueue<RxItem> rx_queue_;
+    std::vector<uavcan::CanFilterConfig> filters_;
+    std::uint64_t num_rx_overflows_ = 0;
+
+    bool checkFilters(const uavcan::CanFrame& frame) const
+    {
+        if (filters_.empty())
+        {
+            return true;
+        }
+        for (auto& f : filters_)
+        {
+            if (((frame.id ^ f.id) & f.mask) == 0)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void deliver(const RxItem& item)
+    {
+        if ((item.flags & uavcan::CanIOFlagLoopback) || checkFilters(item.frame))
+        {
+            if (!rx_queue_.push(item))
+            {
+                num_rx_overflows_++;
+            }
+        }
+    }
+
+    UdpCanIface(UdpCanDriver& driver, const SystemClock& clock, std::uint8_t index, unsigned rx_queue_capacity)
+        : driver_(driver)
+        , clock_(clock)
+        , index_(index)
+        , rx_queue_(rx_queue_capacity)
+    { }
+
+public:
+    /**
+     * The frame is added to the current datagram, which is sent when it's full or when the flush latency expires.
+     * The loopback frames are returned when the datagram has been sent, timestamped at that moment.
+     * Never returns zero.
+     */
+    std::int16_t send(const uavcan::CanFrame& frame, const uavcan::MonotonicTime tx_deadline,
+                      const uavcan::CanIOFlags flags) override
+    {
+        return sendWithTimestamp(frame, clock_.getMonotonic(), tx_deadline, flags);
+    }
+
+    /**
+     * Same as @ref send(), but the frame is reported to the remote side as captured at the specified time rather
+     * than now; e.g. a bridge would pass the RX timestamp of the frame here, so that the original bus timing is
+     * preserved.
+     */
+    std::int16_t sendWithTimestamp(const uavcan::CanFrame& frame, uavcan::MonotonicTime ts_captured,
+                                   uavcan::MonotonicTime tx_deadline, uavcan::CanIOFlags flags);
+
+    std::int16_t receive(uavcan::CanFrame& out_frame, uavcan::MonotonicTime& out_ts_monotonic,
+                         uavcan::UtcTime& out_ts_utc, uavcan::CanIOFlags& out_flags) override
+    {
+        if (rx_queue_.empty())
+        {
+            return 0;
+        }
+        const RxItem& item = rx_queue_.front();
+        out_frame = item.frame;
+        out_ts_monotonic = item.ts_mono;
+        out_ts_utc = item.ts_utc;
+        out_flags = item.flags;
+        rx_queue_.pop();
+        return 1;
+    }
+
+    std::int16_t receiveBatch(uavcan::CanRxFrame* out_frames, uavcan::CanIOFlags* out_flags,
+                              std::uint16_t max_frames) override
+    {
+        if ((out_frames == nullptr) || (out_flags == nullptr))
+        {
+            return -uavcan::ErrInvalidParam;
+        }
+        std::uint16_t num_received = 0;
+        while (num_received < max_frames)
+        {
+            uavcan::CanRxFrame& f = out_frames[num_received];
+            const std::int16_t res = receive(f, f.ts_mono, f.ts_utc, out_flags[num_received]);
+            if (res <= 0)
+            {
+                break;
+            }
+            num_received++;
+        }
+        return std::int16_t(num_received);
+    }
+
+    /**
+     * The filters are applied on reception; the remote side sends all frames anyway.
+     */
+    std::int16_t configureFilters(const uavcan::CanFilterConfig* filter_configs, std::uint16_t num_configs) override
+    {
+        if ((filter_configs == nullptr) && (num_configs > 0))
+        {
+            return -uavcan::ErrInvalidParam;
+        }
+        filters_.assign(filter_configs, filter_configs + num_configs);
+        return 0;
+    }
+
+    std::uint16_t getNumFilters() const override { return uavcan::MaxCanAcceptanceFilters; }
+
+    /**
+     * RX queue overflows, plus the errors of the tunnel, see @ref UdpCanDriver::getErrorCount().
+     */
+    std::uint64_t getErrorCount() const override;
+
+    std::uint64_t getNumRxOverflows() const { return num_rx_overflows_; }
+
+    bool hasPendingRx() const { return !rx_queue_.empty(); }
+};
+
+/**
+ * Tunnels CAN frames of one or more ifaces over UDP/IPv4, e.g. to run a node on a remote analysis station that is
+ * connected to the buses via a bridge (see the uavcan_udp_bridge tool), or to connect two hosts.
+ *
+ * Many frames are batched into one datagram, see @ref UdpCanParams::flush_latency and @ref UdpCanDatagram.
+ * Datagram loss is detected by the sequence numbers and counted; the lost frames are not retransmitted, just like
+ * on a CAN bus with error frames, so the library can handle this as usual.
+ *
+ * The UTC timestamps of the received frames are taken from the local clock, so the time synchronization over
+ * the tunnel is as accurate as the network latency is stable.
+ *
+ * When serviced from an external event loop (see @ref IPollableCanDriver), the application must call spin()
+ * by @ref getFlushDeadline() at the latest, since the flush is not triggered by a file descriptor.
+ */
+class UdpCanDriver : public uavcan::ICanDriver
+                   , public IPollableCanDriver
+{
+    friend class UdpCanIface;
+
+    struct PendingFrame
+    {
+        uavcan::CanFrame frame;
+        uavcan::MonotonicTime ts_captured;
+        uavcan::MonotonicTime tx_deadline;
+        uavcan::CanIOFlags flags = 0;
+        std::uint8_t iface_index = 0;
+    };
+
+    const SystemClock& clock_;
+    const UdpCanParams params_;
+    int fd_ = -1;
+    ::sockaddr_in remote_;
+    bool remote_known_ = false;
+    const bool remote_fixed_;
+
+    std::vector<std::unique_ptr<UdpCanIface>> ifaces_;
+
+    std::vector<PendingFrame> pending_;             ///< Frames of the next datagram; capacity is reserved
+    unsigned pending_size_ = UdpCanDatagram::HeaderSize;
+    uavcan::MonotonicTime flush_deadline_;
+    std::vector<std::uint8_t> tx_buffer_;
+    std::vector<std::uint8_t> rx_buffer_;
+
+    std::uint32_t tx_sequence_ = 0;
+    std::uint32_t rx_sequence_ = 0;
+    bool rx_sequence_known_ = false;
+
+    std::uint64_t num_tx_datagrams_ = 0;
+    std::uint64_t num_rx_datagrams_ = 0;
+    std::uint64_t num_lost_datagrams_ = 0;
+    std::uint64_t num_malformed_datagrams_ = 0;
+    std::uint64_t num_tx_errors_ = 0;           ///< Frames not sent because of socket errors or unknown peer
+    std::uint64_t num_tx_timeouts_ = 0;
+
+    static ::sockaddr_in makeAddress(const std::string& address, std::uint16_t port)
+    {
+        auto addr = ::sockaddr_in();
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        if (::inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1)
+        {
+            throw Exception("Invalid IPv4 address " + address, EINVAL);
+        }
+        return addr;
+    }
+
+    void enqueue(const PendingFrame& pf)
+    {
+        const unsigned size = UdpCanDatagram::FrameHeaderSize + pf.frame.dlc;
+        if ((pending_size_ + size) > params_.max_datagram_size)
+        {
+            flush();
+        }
+        if (pending_.empty())
+        {
+            flush_deadline_ = clock_.getMonotonic() + params_.flush_latency;
+        }
+        pending_.push_back(pf);
+        pending_size_ += size;
+        if (!params_.flush_latency.isPositive())
+        {
+            flush();
+        }
+    }
+
+    void flush()
+    {
+        if (pending_.empty())
+        {
+            return;
+        }
+        const uavcan::MonotonicTime ts_mono = clock_.getMonotonic();
+
+        std::uint8_t* const buf = tx_buffer_.data();
+        UdpCanDatagram::write16(buf, UdpCanDatagram::Magic);
+        buf[2] = UdpCanDatagram::Version;
+        buf[3] = 0;
+        UdpCanDatagram::write32(buf + 4, tx_sequence_);
+        unsigned offset = UdpCanDatagram::HeaderSize;
+        std::uint16_t num_frames = 0;
+        for (auto& pf : pending_)
+        {
+            if (pf.tx_deadline < ts_mono)
+            {
+                num_tx_timeouts_++;
+                continue;
+            }
+            const std::int64_t age = std::max<std::int64_t>((ts_mono - pf.ts_captured).toUSec(), 0);
+            UdpCanDatagram::write32(buf + offset, std::uint32_t(std::min<std::int64_t>(age, 0xFFFFFFFFLL)));
+            UdpCanDatagram::write32(buf + offset + 4, pf.frame.id);
+            buf[offset + 8] = pf.iface_index;
+            buf[offset + 9] = pf.frame.dlc;
+            offset += UdpCanDatagram::FrameHeaderSize;
+            (void)std::copy(pf.frame.data, pf.frame.data + pf.frame.dlc, buf + offset);
+            offset += pf.frame.dlc;
+            num_frames++;
+        }
+        UdpCanDatagram::write16(buf + 8, num_frames);
+
+        bool sent = false;
+        if ((num_frames > 0) && remote_known_)
+        {
+            const ssize_t res = ::sendto(fd_, buf, offset, MSG_DONTWAIT,
+                                         reinterpret_cast<const ::sockaddr*>(&remote_), sizeof(remote_));
+            sent = res == ssize_t(offset);
+            if (sent)
+            {
+                num_tx_datagrams_++;
+                tx_sequence_++;
+            }
+        }
+        if (!sent)
+        {
+            num_tx_errors_ += num_frames;
+        }
+
+        if (sent)
+        {
+            const uavcan::UtcTime ts_utc = clock_.getUtc();
+            for (auto& pf : pending_)
+            {
+                if ((pf.flags & uavcan::CanIOFlagLoopback) && (pf.tx_deadline >= ts_mono))
+                {
+                    UdpCanIface::RxItem item;
+                    item.frame = pf.frame;
+                    item.ts_mono = ts_mono;
+                    item.ts_utc = ts_utc;
+                    item.flags = uavcan::CanIOFlagLoopback;
+                    ifaces_[pf.iface_index]->deliver(item);
+                }
+            }
+        }
+
+        pending_.clear();
+        pending_size_ = UdpCanDatagram::HeaderSize;
+    }
+
+    void handleDatagram(const std::uint8_t* buf, unsigned size, uavcan::MonotonicTime ts_mono,
+                        uavcan::UtcTime ts_utc)
+    {
+        if ((size < UdpCanDatagram::HeaderSize) || (UdpCanDatagram::read16(buf) != UdpCanDatagram::Magic) ||
+            (buf[2] != UdpCanDatagram::Version))
+        {
+            num_malformed_datagrams_++;
+            return;
+        }
+
+        const std::uint32_t sequence = UdpCanDatagram::read32(buf + 4);
+        if (rx_sequence_known_)
+        {
+            const std::int32_t gap = std::int32_t(sequence - rx_sequence_);
+            if (gap > 0)
+            {
+                num_lost_datagrams_ += std::uint64_t(gap);
+            }
+            else if (gap < 0)
+            {
+                UAVCAN_TRACE("UdpCan", "Reordered or restarted, seq %u expected %u", unsigned(sequence),
+                             unsigned(rx_sequence_));
+            }
+            else
+            {
+                ;   // As expected
+            }
+        }
+        rx_sequence_ = sequence + 1;
+        rx_sequence_known_ = true;
+        num_rx_datagrams_++;
+
+        const unsigned num_frames = UdpCanDatagram::read16(buf + 8);
+        unsigned offset = UdpCanDatagram::HeaderSize;
+        for (unsigned i = 0; i < num_frames; i++)
+        {
+            if ((offset + UdpCanDatagram::FrameHeaderSize) > size)
+            {
+                num_malformed_datagrams_++;
+                return;
+            }
+            const std::uint32_t age = UdpCanDatagram::read32(buf + offset);
+            const std::uint32_t id = UdpCanDatagram::read32(buf + offset + 4);
+            const std::uint8_t iface_index = buf[offset + 8];
+            const std::uint8_t dlc = buf[offset + 9];
+            offset += UdpCanDatagram::FrameHeaderSize;
+            if ((dlc > uavcan::CanFrame::MaxDataLen) || ((offset + dlc) > size) || (iface_index >= ifaces_.size()))
+            {
+                num_malformed_datagrams_++;
+                return;
+            }
+
+            UdpCanIface::RxItem item;
+            item.frame = uavcan::CanFrame(id, buf + offset, dlc);
+            item.ts_mono = ts_mono - uavcan::MonotonicDuration::fromUSec(age);
+            item.ts_utc = ts_utc - uavcan::UtcDuration::fromUSec(age);
+            ifaces_[iface_index]->deliver(item);
+            offset += dlc;
+        }
+    }
+
+    void receiveDatagrams()
+    {
+        while (true)
+        {
+            auto src = ::sockaddr_in();
+            ::socklen_t src_len = sizeof(src);
+            const ssize_t res = ::recvfrom(fd_, rx_buffer_.data(), rx_buffer_.size(), MSG_DONTWAIT,
+                                           reinterpret_cast<::sockaddr*>(&src), &src_len);
+            if (res < 0)
+            {
+                break;                                  // EAGAIN normally
+            }
+            if (remote_fixed_ &&
+                ((src.sin_addr.s_addr != remote_.sin_addr.s_addr) || (src.sin_port != remote_.sin_port)))
+            {
+                continue;
+            }
+            const std::uint64_t valid_before = num_rx_datagrams_;
+            handleDatagram(rx_buffer_.data(), unsigned(res), clock_.getMonotonic(), clock_.getUtc());
+            if (!remote_fixed_ && (num_rx_datagrams_ != valid_before))
+            {
+                remote_ = src;                          // Replying to the latest peer
+                remote_known_ = true;
+            }
+        }
+    }
+
+    void collectReadyIfaces(uavcan::CanSelectMasks& inout_masks) const
+    {
+        uavcan::CanSelectMasks out_masks;
+        for (unsigned i = 0; i < ifaces_.size(); i++)
+        {
+            const std::uint8_t mask = std::uint8_t(1U << i);
+            if ((inout_masks.read & mask) && ifaces_[i]->hasPendingRx())
+            {
+                out_masks.read |= mask;
+            }
+            out_masks.write |= inout_masks.write & mask;        // Sending never blocks
+        }
+        inout_masks = out_masks;
+    }
+
+public:
+    /**
+     * Reference to the clock object shall remain valid.
+     * @throws uavcan_linux::Exception if the parameters are invalid or the socket could not be set up.
+     */
+    UdpCanDriver(const SystemClock& clock, const UdpCanParams& params)
+        : clock_(clock)
+        , params_(params)
+        , remote_(::sockaddr_in())
+        , remote_fixed_(!params.remote_address.empty())
+        , tx_buffer_(UdpCanDatagram::MaxSize)
+        , rx_buffer_(UdpCanDatagram::MaxSize)
+    {
+        if ((params_.num_ifaces == 0) || (params_.num_ifaces > uavcan::MaxCanIfaces) ||
+            (params_.max_datagram_size > UdpCanDatagram::MaxSize) ||
+            (params_.max_datagram_size < (UdpCanDatagram::HeaderSize + UdpCanDatagram::FrameHeaderSize +
+                                           uavcan::CanFrame::MaxDataLen)))
+        {
+            throw Exception("Invalid UDP CAN tunnel parameters", EINVAL);
+        }
+        const ::sockaddr_in local = makeAddress(params_.local_address, params_.local_port);
+        if (remote_fixed_)
+        {
+            remote_ = makeAddress(params_.remote_address, params_.remote_port);
+            remote_known_ = true;
+        }
+
+        fd_ = ::socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd_ < 0)
+        {
+            throw Exception("Failed to open UDP socket");
+        }
+        const int on = 1;
+        if ((::setsockopt(fd_, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) < 0) ||
+            (::bind(fd_, reinterpret_cast<const ::sockaddr*>(&local), sizeof(local)) < 0))
+        {
+            const int error = errno;
+            (void)::close(fd_);
+            throw Exception("Failed to bind UDP socket to " + params_.local_address + ":" +
+                            std::to_string(params_.local_port), error);
+        }
+
+        pending_.reserve(params_.max_datagram_size / UdpCanDatagram::FrameHeaderSize);
+        for (unsigned i = 0; i < params_.num_ifaces; i++)
+        {
+            ifaces_.emplace_back(new UdpCanIface(*this, clock_, std::uint8_t(i), params_.rx_queue_capacity));
+        }
+    }
+
+    ~UdpCanDriver()
+    {
+        flush();
+        (void)::close(fd_);
+    }
+
+    UdpCanDriver(const UdpCanDriver&) = delete;
+    UdpCanDriver& operator=(const UdpCanDriver&) = delete;
+
+    /**
+     * Sends the pending datagram when its flush latency expires, and blocks on the socket until then at most.
+     */
+    std::int16_t select(uavcan::CanSelectMasks& inout_masks,
+                        const uavcan::CanFrame* (&)[uavcan::MaxCanIfaces],
+                        const uavcan::MonotonicTime blocking_deadline) override
+    {
+        const uavcan::CanSelectMasks requested = inout_masks;
+        while (true)
+        {
+            uavcan::MonotonicTime now = clock_.getMonotonic();
+            if (!pending_.empty() && (now >= flush_deadline_))
+            {
+                flush();
+            }
+            receiveDatagrams();
+
+            inout_masks = requested;
+            collectReadyIfaces(inout_masks);
+            if ((inout_masks.read != 0) || (inout_masks.write != 0) || (now >= blocking_deadline))
+            {
+                break;
+            }
+
+            const uavcan::MonotonicTime wait_until =
+                pending_.empty() ? blocking_deadline : std::min(blocking_deadline, flush_deadline_);
+            const std::int64_t timeout_usec = (wait_until - now).toUSec();
+            auto ts = ::timespec();
+            if (timeout_usec > 0)
+            {
+                ts.tv_sec = timeout_usec / 1000000LL;
+                ts.tv_nsec = (timeout_usec % 1000000LL) * 1000;
+            }
+            auto pfd = ::pollfd();
+            pfd.fd = fd_;
+            pfd.events = POLLIN;
+            if (::ppoll(&pfd, 1, &ts, nullptr) < 0)
+            {
+                return -1;
+            }
+        }
+
+        unsigned num_ready = 0;
+        for (unsigned i = 0; i < ifaces_.size(); i++)
+        {
+            const std::uint8_t mask = std::uint8_t(1U << i);
+            num_ready += ((inout_masks.read | inout_masks.write) & mask) ? 1U : 0U;
+        }
+        return std::int16_t(num_ready);
+    }
+
+    UdpCanIface* getIface(std::uint8_t iface_index) override
+    {
+        return (iface_index >= ifaces_.size()) ? nullptr : ifaces_[iface_index].get();
+    }
+
+    std::uint8_t getNumIfaces() const override { return std::uint8_t(ifaces_.size()); }
+
+    /**
+     * The UDP socket.
+     */
+    std::vector<::pollfd> getPollFds() const override
+    {
+        auto pfd = ::pollfd();
+        pfd.fd = fd_;
+        pfd.events = POLLIN;
+        return std::vector<::pollfd>{ pfd };
+    }
+
+    /**
+     * When the pending datagram must be sent; zero if there is nothing to send.
+     */
+    uavcan::MonotonicTime getFlushDeadline() const
+    {
+        return pending_.empty() ? uavcan::MonotonicTime() : flush_deadline_;
+    }
+
+    /**
+     * Sends the pending datagram now.
+     */
+    void flushNow() { flush(); }
+
+    /**
+     * The port the socket is bound to, useful if an ephemeral port was requested.
+     */
+    std::uint16_t getLocalPort() const
+    {
+        auto addr = ::sockaddr_in();
+        ::socklen_t len = sizeof(addr);
+        if (::getsockname(fd_, reinterpret_cast<::sockaddr*>(&addr), &len) < 0)
+        {
+            return 0;
+        }
+        return ntohs(addr.sin_port);
+    }
+
+    const UdpCanParams& getParams() const { return params_; }
+
+    /**
+     * Lost and malformed datagrams, plus the frames that could not be sent (socket errors, unknown peer,
+     * TX deadline expired while waiting for the flush).
+     */
+    std::uint64_t getErrorCount() const
+    {
+        return num_lost_datagrams_ + num_malformed_datagrams_ + num_tx_errors_ + num_tx_timeouts_;
+    }
+
+    std::uint64_t getNumTxDatagrams() const { return num_tx_datagrams_; }
+    std::uint64_t getNumRxDatagrams() const { return num_rx_datagrams_; }
+    std::uint64_t getNumLostDatagrams() const { return num_lost_datagrams_; }
+    std::uint64_t getNumMalformedDatagrams() const { return num_malformed_datagrams_; }
+    std::uint64_t getNumTxErrors() const { return num_tx_errors_; }
+    std::uint64_t getNumTxTimeouts() const { return num_tx_timeouts_; }
+};
+
+/*
+ * UdpCanIface implementation; it depends on the definition of UdpCanDriver.
+ */
+inline std::int16_t UdpCanIface::sendWithTimestamp(const uavcan::CanFrame& frame, uavcan::MonotonicTime ts_captured,
+                                                   uavcan::MonotonicTime tx_deadline, uavcan::CanIOFlags flags)
+{
+    UdpCanDriver::PendingFrame pf;
+    pf.frame = frame;
+    pf.ts_captured = ts_captured;
+    pf.tx_deadline = tx_deadline;
+    pf.flags = flags;
+    pf.iface_index = index_;
+    driver_.enqueue(pf);
+    return 1;
+}
+
+inline std::uint64_t UdpCanIface::getErrorCount() const
+{
+    return num_rx_overflows_ + driver_.getErrorCount();
+}
+
+}
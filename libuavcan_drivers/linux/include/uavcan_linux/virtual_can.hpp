@@ -0,0 +1,662 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#pragma once
+
+#include <array>
+#include <cassert>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <vector>
+#include <algorithm>
+
+#include <uavcan/error.hpp>
+#include <uavcan/driver/can.hpp>
+#include <uavcan/driver/system_clock.hpp>
+#include <uavcan_linux/exception.hpp>
+
+namespace uavcan_linux
+{
+/**
+ * Wait-free single producer single consumer ring buffer.
+ * Capacity must be a power of two.
+ */
+template <typename T, unsigned Capacity>
+class VirtualCanRing
+{
+    static_assert((Capacity > 0) && ((Capacity & (Capacity - 1U)) == 0), "Capacity must be a power of two");
+
+    std::array<T, Capacity> buf_;
+    std::atomic<unsigned> in_{0};       ///< Written by the producer only
+    std::atomic<unsigned> out_{0};      ///< Written by the consumer only
+
+public:
+    /**
+     * Producer side.
+     */
+    bool push(const T& item)
+    {
+        const unsigned in = in_.load(std::memory_order_relaxed);
+        if ((in - out_.load(std::memory_order_acquire)) >= Capacity)
+        {
+            return false;
+        }
+        buf_[in & (Capacity - 1U)] = item;
+        in_.store(in + 1U, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Consumer side. The pointer returned by peek() is valid until the next pop().
+     */
+    const T* peek() const
+    {
+        const unsigned out = out_.load(std::memory_order_relaxed);
+        if (out == in_.load(std::memory_order_acquire))
+        {
+            return nullptr;
+        }
+        return &buf_[out & (Capacity - 1U)];
+    }
+
+    void pop()
+    {
+        out_.store(out_.load(std::memory_order_relaxed) + 1U, std::memory_order_release);
+    }
+
+    /**
+     * Approximate if called concurrently with the other side; exact otherwise.
+     */
+    unsigned getSize() const
+    {
+        return in_.load(std::memory_order_acquire) - out_.load(std::memory_order_acquire);
+    }
+
+    bool isEmpty() const { return getSize() == 0; }
+    bool isFull() const { return getSize() >= Capacity; }
+};
+
+/**
+ * Parameters of @ref VirtualCanBus.
+ */
+struct VirtualCanBusParams
+{
+    std::uint32_t bitrate;                  ///< Defines the frame transmission time
+    uavcan::MonotonicDuration latency;      ///< Added to the transmission time for every receiver, except loopback
+    double frame_loss_probability;          ///< Probability of a frame being lost, for every receiver independently
+    std::uint32_t random_seed;              ///< The simulation is deterministic for the given seed
+
+    VirtualCanBusParams()
+        : bitrate(1000000)
+        , frame_loss_probability(0.0)
+        , random_seed(1)
+    { }
+};
+
+class VirtualCanIface;
+
+/**
+ * In-process simulation of a CAN bus, for running many nodes in one process, possibly faster than real time.
+ *
+ * The bus has its own simulated monotonic time, which is moved forward by the application via @ref advance();
+ * the nodes observe this time via @ref VirtualSystemClock. Before the time is moved, the bus replays everything
+ * that would happen on a real bus during the interval: among the frames queued for transmission, the one with the
+ * highest CAN priority wins the arbitration, occupies the bus for the duration defined by its length and the bit
+ * rate, and then is delivered to every other interface after the configured latency, unless it is lost.
+ * Frames that have not won the arbitration until their TX deadline are discarded and counted as errors.
+ *
+ * Interfaces are attached to the bus by creating @ref VirtualCanDriver instances. Every interface exchanges frames
+ * with the bus via wait-free single producer single consumer queues, so the nodes and the bus can run in different
+ * threads without locks on the data path, and the cost of the simulation grows linearly with the number of nodes.
+ *
+ * Simplifications: bit stuffing is always assumed worst case; interframe space and error frames are not modeled;
+ * CAN FD frames are timed as if there was no bit rate switching.
+ *
+ * A single threaded simulation would invoke spinOnce() on every node, then advance the bus by a small step,
+ * and repeat. Note that in this case Node::spin() must not be used with a deadline in the future, because the
+ * simulated time does not progress while the node is blocked in it. In a multithreaded simulation, nodes can use
+ * spin() normally, since select() blocks until the bus advances.
+ */
+class VirtualCanBus
+{
+    friend class VirtualCanIface;
+
+    struct Delivery
+    {
+        std::uint64_t ts_usec = 0;
+        std::uint64_t sequence = 0;         ///< Preserves the order of frames delivered at the same time
+        VirtualCanIface* iface = nullptr;
+        uavcan::CanFrame frame;
+        uavcan::CanIOFlags flags = 0;
+
+        bool operator<(const Delivery& rhs) const       // Inverted, so that the priority queue is a min-heap
+        {
+            return (ts_usec != rhs.ts_usec) ? (ts_usec > rhs.ts_usec) : (sequence > rhs.sequence);
+        }
+    };
+
+    const VirtualCanBusParams params_;
+
+    std::atomic<std::uint64_t> time_usec_;
+    std::atomic<std::uint64_t> num_transmitted_frames_{0};
+    std::atomic<std::uint64_t> num_lost_frames_{0};
+    std::atomic<std::uint64_t> busy_time_usec_{0};
+
+    mutable std::mutex mutex_;          ///< Protects the fields below; never taken on the data path of the nodes
+    std::condition_variable time_advanced_cv_;
+    std::vector<VirtualCanIface*> ifaces_;
+    std::priority_queue<Delivery> deliveries_;
+    std::uint64_t delivery_sequence_ = 0;
+    std::uint64_t busy_until_usec_ = 0;
+    std::minstd_rand random_engine_;
+    std::bernoulli_distribution loss_distribution_;
+
+    void attach(VirtualCanIface* iface)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ifaces_.push_back(iface);
+    }
+
+    void detach(VirtualCanIface* iface);
+
+    void scheduleDelivery(std::uint64_t ts_usec, VirtualCanIface* iface, const uavcan::CanFrame& frame,
+                          uavcan::CanIOFlags flags)
+    {
+        Delivery d;
+        d.ts_usec = ts_usec;
+        d.sequence = delivery_sequence_++;
+        d.iface = iface;
+        d.frame = frame;
+        d.flags = flags;
+        deliveries_.push(d);
+    }
+
+    /**
+     * Returns the index of the interface that wins the arbitration at the specified time, or -1 if the bus is idle.
+     * Expired frames are discarded.
+     */
+    int arbitrate(std::uint64_t time_usec);
+
+    void transmit(VirtualCanIface& winner, std::uint64_t start_usec, std::uint64_t end_usec);
+
+    void deliverUntil(std::uint64_t time_usec);
+
+public:
+    /**
+     * The simulated time starts from an arbitrary non-zero value, because zero timestamps are treated as unknown.
+     */
+    explicit VirtualCanBus(const VirtualCanBusParams& params = VirtualCanBusParams(),
+                           uavcan::MonotonicTime start_time = uavcan::MonotonicTime::fromMSec(1000))
+        : params_(params)
+        , time_usec_(start_time.toUSec())
+        , random_engine_(params.random_seed)
+        , loss_distribution_(std::min(std::max(params.frame_loss_probability, 0.0), 1.0))
+    {
+        if (params_.bitrate == 0)
+        {
+            throw Exception("Invalid bit rate");
+        }
+    }
+
+    /**
+     * All drivers must be destroyed before the bus.
+     */
+    ~VirtualCanBus()
+    {
+        assert(ifaces_.empty());
+    }
+
+    /**
+     * Current simulated time. Can be called from any thread.
+     */
+    uavcan::MonotonicTime getTime() const
+    {
+        return uavcan::MonotonicTime::fromUSec(time_usec_.load(std::memory_order_acquire));
+    }
+
+    /**
+     * Simulates the bus activity until the specified time, then moves the simulated time forward.
+     * Frames that have been queued for transmission by the nodes before the call can be transmitted during the
+     * interval; the nodes will see the received frames once the call returns, timestamped at their arrival time.
+     * A frame that was still being transmitted at the end of the interval will be delivered in the next interval.
+     * Must not be called concurrently with itself.
+     */
+    void advanceTo(uavcan::MonotonicTime target_time);
+
+    void advance(uavcan::MonotonicDuration duration)
+    {
+        if (duration.isPositive())
+        {
+            advanceTo(getTime() + duration);
+        }
+    }
+
+    /**
+     * Blocks the calling thread until the simulated time moves past the specified time, or until the specified
+     * amount of real time has elapsed. Returns true if the simulated time has moved.
+     */
+    bool waitForTimeAfter(uavcan::MonotonicTime time, std::chrono::microseconds max_real_time)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return time_advanced_cv_.wait_for(lock, max_real_time, [this, time]() { return getTime() > time; });
+    }
+
+    /**
+     * Number of bits in the frame, including worst case stuffing, start of frame and end of frame.
+     * Interframe space is not accounted for.
+     */
+    static unsigned computeFrameLengthBits(const uavcan::CanFrame& frame)
+    {
+        const unsigned data_bits = 8U * frame.dlc;
+        // SOF, ID, SRR, IDE, ID extension, RTR, reserved, DLC, data, CRC - these are subject to stuffing
+        const unsigned stuffable_bits = (frame.isExtended() ? 54U : 34U) + data_bits;
+        // CRC delimiter, ACK slot, ACK delimiter, EOF
+        return stuffable_bits + (stuffable_bits - 1U) / 4U + 13U;
+    }
+
+    uavcan::MonotonicDuration computeFrameDuration(const uavcan::CanFrame& frame) const
+    {
+        const std::uint64_t bits = computeFrameLengthBits(frame);
+        return uavcan::MonotonicDuration::fromUSec(std::int64_t((bits * 1000000U + params_.bitrate - 1U) /
+                                                                params_.bitrate));
+    }
+
+    const VirtualCanBusParams& getParams() const { return params_; }
+
+    /**
+     * Statistics. Can be called from any thread.
+     * The number of lost frames is counted per receiver.
+     */
+    std::uint64_t getNumTransmittedFrames() const { return num_transmitted_frames_.load(); }
+    std::uint64_t getNumLostFrames() const { return num_lost_frames_.load(); }
+    uavcan::MonotonicDuration getBusyTime() const
+    {
+        return uavcan::MonotonicDuration::fromUSec(std::int64_t(busy_time_usec_.load()));
+    }
+};
+
+/**
+ * System clock driver that follows the simulated time of @ref VirtualCanBus.
+ * UTC time is the simulated time plus an adjustable offset, so every node can have its own UTC clock,
+ * e.g. for time synchronization tests.
+ */
+class VirtualSystemClock : public uavcan::ISystemClock
+{
+    const VirtualCanBus& bus_;
+    std::atomic<std::int64_t> utc_offset_usec_;
+
+public:
+    explicit VirtualSystemClock(const VirtualCanBus& bus,
+                                uavcan::UtcDuration utc_offset = uavcan::UtcDuration())
+        : bus_(bus)
+        , utc_offset_usec_(utc_offset.toUSec())
+    { }
+
+    uavcan::MonotonicTime getMonotonic() const override { return bus_.getTime(); }
+
+    uavcan::UtcTime getUtc() const override { return convertMonotonicToUtc(getMonotonic()); }
+
+    void adjustUtc(uavcan::UtcDuration adjustment) override
+    {
+        utc_offset_usec_.fetch_add(adjustment.toUSec());
+    }
+
+    /**
+     * Maps a simulated monotonic timestamp to this clock's UTC using the current offset.
+     */
+    uavcan::UtcTime convertMonotonicToUtc(uavcan::MonotonicTime mono) const
+    {
+        return uavcan::UtcTime::fromUSec(std::uint64_t(std::int64_t(mono.toUSec()) + utc_offset_usec_.load()));
+    }
+
+    uavcan::UtcDuration getUtcOffset() const { return uavcan::UtcDuration::fromUSec(utc_offset_usec_.load()); }
+};
+
+/**
+ * One interface of @ref VirtualCanDriver, attached to one @ref VirtualCanBus.
+ *
+ * The TX queue models a controller with a few TX mailboxes: only the oldest frame in the queue takes part in the
+ * arbitration, and the library hands over the frames in the order of their priority anyway. The node thread is the
+ * producer of the TX queue and the consumer of the RX queue; the bus is the other side of both.
+ */
+class VirtualCanIface : public uavcan::ICanIface
+{
+    friend class VirtualCanBus;
+
+    static constexpr unsigned TxQueueCapacity = 4;
+    static constexpr unsigned RxQueueCapacity = 256;
+
+    struct TxItem
+    {
+        uavcan::CanFrame frame;
+        std::uint64_t deadline_usec = 0;
+        uavcan::CanIOFlags flags = 0;
+    };
+
+    struct RxItem
+    {
+        uavcan::CanFrame frame;
+        std::uint64_t ts_usec = 0;
+        uavcan::CanIOFlags flags = 0;
+    };
+
+    VirtualCanBus& bus_;
+    const VirtualSystemClock& clock_;
+    VirtualCanRing<TxItem, TxQueueCapacity> tx_queue_;
+    VirtualCanRing<RxItem, RxQueueCapacity> rx_queue_;
+    std::atomic<std::uint64_t> num_rx_overflows_{0};
+    std::atomic<std::uint64_t> num_tx_timeouts_{0};
+
+public:
+    VirtualCanIface(VirtualCanBus& bus, const VirtualSystemClock& clock)
+        : bus_(bus)
+        , clock_(clock)
+    {
+        bus_.attach(this);
+    }
+
+    ~VirtualCanIface()
+    {
+        bus_.detach(this);
+    }
+
+    VirtualCanIface(const VirtualCanIface&) = delete;
+    VirtualCanIface& operator=(const VirtualCanIface&) = delete;
+
+    std::int16_t send(const uavcan::CanFrame& frame, const uavcan::MonotonicTime tx_deadline,
+                      const uavcan::CanIOFlags flags) override
+    {
+        TxItem item;
+        item.frame = frame;
+        item.deadline_usec = tx_deadline.toUSec();
+        item.flags = flags;
+        return tx_queue_.push(item) ? 1 : 0;
+    }
+
+    std::int16_t receive(uavcan::CanFrame& out_frame, uavcan::MonotonicTime& out_ts_monotonic,
+                         uavcan::UtcTime& out_ts_utc, uavcan::CanIOFlags& out_flags) override
+    {
+        const RxItem* const item = rx_queue_.peek();
+        if (item == nullptr)
+        {
+            return 0;
+        }
+        out_frame = item->frame;
+        out_ts_monotonic = uavcan::MonotonicTime::fromUSec(item->ts_usec);
+        out_ts_utc = clock_.convertMonotonicToUtc(out_ts_monotonic);
+        out_flags = item->flags;
+        rx_queue_.pop();
+        return 1;
+    }
+
+    std::int16_t receiveBatch(uavcan::CanRxFrame* out_frames, uavcan::CanIOFlags* out_flags,
+                              std::uint16_t max_frames) override
+    {
+        if ((out_frames == nullptr) || (out_flags == nullptr))
+        {
+            return -uavcan::ErrInvalidParam;
+        }
+        std::uint16_t num_received = 0;
+        while (num_received < max_frames)
+        {
+            uavcan::CanRxFrame& f = out_frames[num_received];
+            const std::int16_t res = receive(f, f.ts_mono, f.ts_utc, out_flags[num_received]);
+            if (res <= 0)
+            {
+                break;
+            }
+            num_received++;
+        }
+        return std::int16_t(num_received);
+    }
+
+    /**
+     * All frames are accepted, hardware filters are not simulated.
+     */
+    std::int16_t configureFilters(const uavcan::CanFilterConfig*, std::uint16_t) override { return 0; }
+    std::uint16_t getNumFilters() const override { return 0; }
+
+    /**
+     * RX queue overflows and TX timeouts.
+     */
+    std::uint64_t getErrorCount() const override { return num_rx_overflows_.load() + num_tx_timeouts_.load(); }
+
+    std::uint64_t getNumRxOverflows() const { return num_rx_overflows_.load(); }
+    std::uint64_t getNumTxTimeouts() const { return num_tx_timeouts_.load(); }
+
+    VirtualCanBus& getBus() const { return bus_; }
+
+    bool hasPendingRx() const { return !rx_queue_.isEmpty(); }
+    bool canAcceptTx() const { return !tx_queue_.isFull(); }
+};
+
+/**
+ * CAN driver of one simulated node; every interface of the node is attached to its own @ref VirtualCanBus.
+ * The buses of one node should be advanced together, from the same simulation loop.
+ */
+class VirtualCanDriver : public uavcan::ICanDriver
+{
+    /// How long select() blocks in real time at most while waiting for the simulated time to change
+    enum { MaxRealTimeWaitUSec = 1000 };
+
+    const VirtualSystemClock& clock_;
+    std::vector<std::unique_ptr<VirtualCanIface>> ifaces_;
+
+    void collectReadyIfaces(uavcan::CanSelectMasks& inout_masks) const
+    {
+        uavcan::CanSelectMasks out_masks;
+        for (unsigned i = 0; i < ifaces_.size(); i++)
+        {
+            const std::uint8_t mask = std::uint8_t(1U << i);
+            if ((inout_masks.read & mask) && ifaces_[i]->hasPendingRx())
+            {
+                out_masks.read |= mask;
+            }
+            if ((inout_masks.write & mask) && ifaces_[i]->canAcceptTx())
+            {
+                out_masks.write |= mask;
+            }
+        }
+        inout_masks = out_masks;
+    }
+
+public:
+    /**
+     * The buses must outlive the driver.
+     */
+    VirtualCanDriver(const std::vector<VirtualCanBus*>& buses, const VirtualSystemClock& clock)
+        : clock_(clock)
+    {
+        if (buses.empty() || (buses.size() > uavcan::MaxCanIfaces))
+        {
+            throw Exception("Invalid number of virtual CAN buses");
+        }
+        for (VirtualCanBus* const bus : buses)
+        {
+            ifaces_.emplace_back(new VirtualCanIface(*bus, clock_));
+        }
+    }
+
+    VirtualCanDriver(VirtualCanBus& bus, const VirtualSystemClock& clock)
+        : VirtualCanDriver(std::vector<VirtualCanBus*>{ &bus }, clock)
+    { }
+
+    std::int16_t select(uavcan::CanSelectMasks& inout_masks,
+                        const uavcan::CanFrame* (&)[uavcan::MaxCanIfaces],
+                        const uavcan::MonotonicTime blocking_deadline) override
+    {
+        const uavcan::CanSelectMasks requested = inout_masks;
+        while (true)
+        {
+            inout_masks = requested;
+            collectReadyIfaces(inout_masks);
+            if ((inout_masks.read != 0) || (inout_masks.write != 0))
+            {
+                break;
+            }
+
+            const uavcan::MonotonicTime now = clock_.getMonotonic();
+            if (now >= blocking_deadline)
+            {
+                break;
+            }
+            // Returning also if the real time wait has expired, so that a stalled simulation doesn't hang the node
+            if (!ifaces_.front()->getBus().waitForTimeAfter(now, std::chrono::microseconds(MaxRealTimeWaitUSec)))
+            {
+                inout_masks = requested;
+                collectReadyIfaces(inout_masks);
+                break;
+            }
+        }
+
+        unsigned num_ready = 0;
+        for (unsigned i = 0; i < ifaces_.size(); i++)
+        {
+            const std::uint8_t mask = std::uint8_t(1U << i);
+            num_ready += ((inout_masks.read | inout_masks.write) & mask) ? 1U : 0U;
+        }
+        return std::int16_t(num_ready);
+    }
+
+    VirtualCanIface* getIface(std::uint8_t iface_index) override
+    {
+        return (iface_index >= ifaces_.size()) ? nullptr : ifaces_[iface_index].get();
+    }
+
+    std::uint8_t getNumIfaces() const override { return std::uint8_t(ifaces_.size()); }
+};
+
+/*
+ * VirtualCanBus implementation; it depends on the definition of VirtualCanIface.
+ */
+inline void VirtualCanBus::detach(VirtualCanIface* iface)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    ifaces_.erase(std::remove(ifaces_.begin(), ifaces_.end(), iface), ifaces_.end());
+
+    // Pending deliveries to this interface must be dropped
+    std::priority_queue<Delivery> remaining;
+    while (!deliveries_.empty())
+    {
+        if (deliveries_.top().iface != iface)
+        {
+            remaining.push(deliveries_.top());
+        }
+        deliveries_.pop();
+    }
+    deliveries_.swap(remaining);
+}
+
+inline int VirtualCanBus::arbitrate(std::uint64_t time_usec)
+{
+    int winner = -1;
+    const uavcan::CanFrame* winner_frame = nullptr;
+    for (unsigned i = 0; i < ifaces_.size(); i++)
+    {
+        VirtualCanIface& iface = *ifaces_[i];
+        const VirtualCanIface::TxItem* item = nullptr;
+        while (((item = iface.tx_queue_.peek()) != nullptr) && (item->deadline_usec < time_usec))
+        {
+            iface.tx_queue_.pop();
+            iface.num_tx_timeouts_++;
+        }
+        if ((item != nullptr) && ((winner_frame == nullptr) || item->frame.priorityHigherThan(*winner_frame)))
+        {
+            winner = int(i);
+            winner_frame = &item->frame;
+        }
+    }
+    return winner;
+}
+
+inline void VirtualCanBus::transmit(VirtualCanIface& winner, std::uint64_t start_usec, std::uint64_t end_usec)
+{
+    const VirtualCanIface::TxItem item = *winner.tx_queue_.peek();
+    winner.tx_queue_.pop();
+
+    num_transmitted_frames_++;
+    busy_time_usec_ += end_usec - start_usec;
+
+    const std::uint64_t arrival_usec = end_usec + std::uint64_t(std::max<std::int64_t>(params_.latency.toUSec(), 0));
+    for (VirtualCanIface* const iface : ifaces_)
+    {
+        if (iface == &winner)
+        {
+            continue;
+        }
+        if (loss_distribution_(random_engine_))
+        {
+            num_lost_frames_++;
+        }
+        else
+        {
+            scheduleDelivery(arrival_usec, iface, item.frame, 0);
+        }
+    }
+
+    if (item.flags & uavcan::CanIOFlagLoopback)
+    {
+        scheduleDelivery(end_usec, &winner, item.frame, uavcan::CanIOFlagLoopback);
+    }
+}
+
+inline void VirtualCanBus::deliverUntil(std::uint64_t time_usec)
+{
+    while (!deliveries_.empty() && (deliveries_.top().ts_usec <= time_usec))
+    {
+        const Delivery& d = deliveries_.top();
+        VirtualCanIface::RxItem item;
+        item.frame = d.frame;
+        item.ts_usec = d.ts_usec;
+        item.flags = d.flags;
+        if (!d.iface->rx_queue_.push(item))
+        {
+            d.iface->num_rx_overflows_++;
+        }
+        deliveries_.pop();
+    }
+}
+
+inline void VirtualCanBus::advanceTo(uavcan::MonotonicTime target_time)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        const std::uint64_t now_usec = time_usec_.load(std::memory_order_relaxed);
+        const std::uint64_t target_usec = target_time.toUSec();
+        if (target_usec <= now_usec)
+        {
+            return;
+        }
+
+        // The bus may still be busy with a frame that has started in the previous interval
+        std::uint64_t bus_free_usec = std::max(busy_until_usec_, now_usec);
+        while (bus_free_usec < target_usec)
+        {
+            const int winner = arbitrate(bus_free_usec);
+            if (winner < 0)
+            {
+                break;      // Idle; the frames queued later will start at the next interval
+            }
+            VirtualCanIface& iface = *ifaces_[unsigned(winner)];
+            const std::uint64_t end_usec =
+                bus_free_usec + std::uint64_t(computeFrameDuration(iface.tx_queue_.peek()->frame).toUSec());
+            transmit(iface, bus_free_usec, end_usec);
+            bus_free_usec = end_usec;
+        }
+        busy_until_usec_ = bus_free_usec;
+
+        deliverUntil(target_usec);
+        time_usec_.store(target_usec, std::memory_order_release);
+    }
+    time_advanced_cv_.notify_all();
+}
+
+}
@@ -11,6 +11,8 @@ namespace uavcan_lpc11c24
 /**
  * This class implements CAN driver interface for libuavcan.
  * No configuration needed other than CAN baudrate.
+ * The received frames are moved from the hardware RX FIFO into a software queue in the interrupt handler;
+ * both overflow counters are included in the error count.
  * This class is a singleton.
  */
 class CanDriver
@@ -54,10 +56,18 @@ public:
     bool hadActivity();
 
     /**
-     * Returns the number of times the RX queue was overrun.
+     * Returns the number of times the software RX queue was overrun, i.e. the application didn't read the frames
+     * fast enough. The queue length is defined by UAVCAN_LPC11C24_RX_QUEUE_LEN.
      */
     uavcan::uint32_t getRxQueueOverflowCount() const;
 
+    /**
+     * Returns the number of frames lost because a hardware RX FIFO (a chain of message objects) was full,
+     * i.e. the CAN interrupt was not served fast enough.
+     * Every filter gets its own FIFO; the 31 RX message objects are divided evenly between the filters.
+     */
+    uavcan::uint32_t getRxFifoOverflowCount() const;
+
     /**
      * Whether the controller is currently in bus off state.
      * Note that the driver recovers the CAN controller from the bus off state automatically!
@@ -173,6 +173,31 @@ static constexpr std::uint32_t IF_CMDMSK_W_ARB    = 1 << 5;
 static constexpr std::uint32_t IF_CMDMSK_W_MASK   = 1 << 6;
 static constexpr std::uint32_t IF_CMDMSK_W_WR_RD  = 1 << 7;
 
+static constexpr std::uint32_t IF_CMDMSK_R_NEWDAT    = 1 << 2;     ///< Clear NEWDAT in the message object
+static constexpr std::uint32_t IF_CMDMSK_R_CLRINTPND = 1 << 3;     ///< Clear INTPND in the message object
+
+/*
+ * IF.MSK2
+ */
+static constexpr std::uint32_t IF_MSK2_MXTD      = 1 << 15;
+static constexpr std::uint32_t IF_MSK2_MDIR      = 1 << 14;
+static constexpr std::uint32_t IF_MSK2_MSK_MASK  = 0x1FFF;
+
+/*
+ * IF.ARB2
+ */
+static constexpr std::uint32_t IF_ARB2_MSGVAL    = 1 << 15;
+static constexpr std::uint32_t IF_ARB2_XTD       = 1 << 14;
+static constexpr std::uint32_t IF_ARB2_DIR       = 1 << 13;
+static constexpr std::uint32_t IF_ARB2_ID_MASK   = 0x1FFF;
+static constexpr std::uint32_t IF_ARB2_STD_SHIFT = 2;
+
+/*
+ * INT
+ */
+static constexpr std::uint32_t INT_STATUS = 0x8000;
+static constexpr std::uint32_t INT_MASK   = 0xFFFF;
+
 /*
  * IF.MCTRL
  */
@@ -10,19 +10,29 @@
 #include "internal.hpp"
 
 /**
+ * Length of the software RX queue, which is filled from the hardware RX FIFO in the interrupt handler.
  * The default value should be OK for any use case.
  */
 #ifndef UAVCAN_LPC11C24_RX_QUEUE_LEN
-# define UAVCAN_LPC11C24_RX_QUEUE_LEN   8
+# define UAVCAN_LPC11C24_RX_QUEUE_LEN   16
 #endif
 
 #if UAVCAN_LPC11C24_RX_QUEUE_LEN > 254
 # error UAVCAN_LPC11C24_RX_QUEUE_LEN is too large
 #endif
 
-extern "C" void canRxCallback(std::uint8_t msg_obj_num);
-extern "C" void canTxCallback(std::uint8_t msg_obj_num);
-extern "C" void canErrorCallback(std::uint32_t error_info);
+/**
+ * Number of RX message objects that accept standard frames in the default (accept all) filter configuration.
+ * The rest of the RX message objects form the hardware RX FIFO for extended frames, which are used by UAVCAN.
+ * Zero disables reception of standard frames.
+ */
+#ifndef UAVCAN_LPC11C24_NUM_STD_RX_MESSAGE_OBJECTS
+# define UAVCAN_LPC11C24_NUM_STD_RX_MESSAGE_OBJECTS     1
+#endif
+
+#if UAVCAN_LPC11C24_NUM_STD_RX_MESSAGE_OBJECTS > 30
+# error UAVCAN_LPC11C24_NUM_STD_RX_MESSAGE_OBJECTS is too large
+#endif
 
 namespace uavcan_lpc11c24
 {
@@ -31,14 +41,45 @@ namespace
 /**
  * Hardware message objects are allocated as follows:
  *  - 1 - Single TX object
- *  - 2..32 - RX objects
+ *  - 2..32 - RX objects, partitioned into FIFO chains, one chain per filter
  * TX priority is defined by the message object number, not by the CAN ID (chapter 16.7.3.5 of the user manual),
  * hence we can't use more than one object because that would cause priority inversion on long transfers.
+ *
+ * A FIFO chain is a group of consecutive message objects with the same acceptance filter, where only the last
+ * object has the EOB bit set. C_CAN stores a received frame into the lowest numbered object of the chain whose
+ * NEWDAT bit is cleared; if there's none, the last object is overwritten and its MSGLST bit is set.
  */
 constexpr unsigned NumberOfMessageObjects   = 32;
 constexpr unsigned NumberOfTxMessageObjects = 1;
 constexpr unsigned NumberOfRxMessageObjects = NumberOfMessageObjects - NumberOfTxMessageObjects;
 constexpr unsigned TxMessageObjectNumber    = 1;
+constexpr unsigned FirstRxMessageObjectNumber = NumberOfTxMessageObjects + 1;
+
+/**
+ * Consecutive RX message objects [first, last] that are configured with the same filter.
+ */
+struct RxFifo
+{
+    std::uint8_t first = 0;
+    std::uint8_t last = 0;
+
+    /**
+     * The objects up to and including this one are not released upon reading (only INTPND is cleared), so they
+     * can't be refilled while the higher objects of the chain are not read yet. All of them are released at once
+     * when this object is read. This preserves the order of frames, as long as the interrupt handler lags behind
+     * the bus by less than half of the chain.
+     */
+    std::uint8_t getLowHalfLast() const { return std::uint8_t(first + (last - first + 1U) / 2U - 1U); }
+};
+
+RxFifo rx_fifos[NumberOfRxMessageObjects];
+unsigned num_rx_fifos = 0;
+
+/**
+ * Number of frames lost because a hardware RX FIFO was full.
+ * Does not overflow.
+ */
+volatile std::uint32_t rx_fifo_overflow_cnt = 0;
 
 /**
  * Total number of CAN errors.
@@ -132,6 +173,213 @@ public:
 
 RxQueue rx_queue;
 
+/**
+ * Accessors for the message objects; these must be called from the interrupt handler or with interrupts disabled.
+ */
+void transferMessageObject(unsigned msg_obj_num, std::uint32_t cmdmsk)
+{
+    c_can::CAN.IF[0].CMDMSK.W = cmdmsk;
+    c_can::CAN.IF[0].CMDREQ = msg_obj_num;
+
+    while ((c_can::CAN.IF[0].CMDREQ & c_can::IF_CMDREQ_BUSY) != 0)
+    {
+        ; // Nothing to do
+    }
+}
+
+void configureRxMessageObject(unsigned msg_obj_num, std::uint32_t id, std::uint32_t mask, bool ext, bool eob)
+{
+    auto& iface = c_can::CAN.IF[0];
+
+    const std::uint32_t id_bits   = ext ? id : (id << 18);
+    const std::uint32_t mask_bits = ext ? mask : (mask << 18);
+
+    iface.MSK1  = mask_bits & 0xFFFF;
+    iface.MSK2  = ((mask_bits >> 16) & c_can::IF_MSK2_MSK_MASK) | c_can::IF_MSK2_MXTD | c_can::IF_MSK2_MDIR;
+    iface.ARB1  = id_bits & 0xFFFF;
+    iface.ARB2  = ((id_bits >> 16) & c_can::IF_ARB2_ID_MASK) | c_can::IF_ARB2_MSGVAL | (ext ? c_can::IF_ARB2_XTD : 0);
+    iface.MCTRL = c_can::IF_MCTRL_UMASK | c_can::IF_MCTRL_RXIE | (eob ? c_can::IF_MCTRL_EOB : 0);
+
+    transferMessageObject(msg_obj_num, c_can::IF_CMDMSK_W_WR_RD | c_can::IF_CMDMSK_W_MASK | c_can::IF_CMDMSK_W_ARB |
+                                       c_can::IF_CMDMSK_W_CTRL | c_can::IF_CMDMSK_W_DATA_A | c_can::IF_CMDMSK_W_DATA_B);
+}
+
+void disableMessageObject(unsigned msg_obj_num)
+{
+    auto& iface = c_can::CAN.IF[0];
+    iface.ARB1  = 0;
+    iface.ARB2  = 0;            // MSGVAL = 0
+    iface.MCTRL = 0;
+    transferMessageObject(msg_obj_num, c_can::IF_CMDMSK_W_WR_RD | c_can::IF_CMDMSK_W_ARB | c_can::IF_CMDMSK_W_CTRL);
+}
+
+void addRxFifo(unsigned first, unsigned last, std::uint32_t id, std::uint32_t mask, bool ext)
+{
+    for (unsigned i = first; i <= last; i++)
+    {
+        configureRxMessageObject(i, id, mask, ext, i == last);
+    }
+    rx_fifos[num_rx_fifos].first = std::uint8_t(first);
+    rx_fifos[num_rx_fifos].last  = std::uint8_t(last);
+    num_rx_fifos++;
+}
+
+/**
+ * Reads the frame from the message object into the RX queue.
+ * If release is false, the object will not accept new frames until @ref releaseMessageObject() is called.
+ */
+void readRxMessageObject(unsigned msg_obj_num, bool release)
+{
+    auto& iface = c_can::CAN.IF[0];
+
+    transferMessageObject(msg_obj_num, c_can::IF_CMDMSK_W_ARB | c_can::IF_CMDMSK_W_CTRL | c_can::IF_CMDMSK_R_CLRINTPND |
+                                       c_can::IF_CMDMSK_W_DATA_A | c_can::IF_CMDMSK_W_DATA_B |
+                                       (release ? c_can::IF_CMDMSK_R_NEWDAT : 0));
+
+    const std::uint32_t mctrl = iface.MCTRL;
+    if ((mctrl & c_can::IF_MCTRL_NEWDAT) == 0)
+    {
+        return;     // Nothing to read, the interrupt is a leftover
+    }
+
+    uavcan::CanFrame frame;
+
+    const std::uint32_t arb2 = iface.ARB2;
+    if ((arb2 & c_can::IF_ARB2_XTD) != 0)
+    {
+        frame.id = (((arb2 & c_can::IF_ARB2_ID_MASK) << 16) | (iface.ARB1 & 0xFFFF)) & uavcan::CanFrame::MaskExtID;
+        frame.id |= uavcan::CanFrame::FlagEFF;
+    }
+    else
+    {
+        frame.id = ((arb2 & c_can::IF_ARB2_ID_MASK) >> c_can::IF_ARB2_STD_SHIFT) & uavcan::CanFrame::MaskStdID;
+    }
+
+    frame.dlc = std::uint8_t(uavcan::min<std::uint32_t>(mctrl & c_can::IF_MCTRL_DLC_MASK, 8));
+
+    const std::uint32_t data[4] = { iface.DA1, iface.DA2, iface.DB1, iface.DB2 };
+    for (unsigned i = 0; i < 8; i++)
+    {
+        frame.data[i] = std::uint8_t(data[i / 2] >> ((i % 2) * 8));
+    }
+
+    if ((mctrl & c_can::IF_MCTRL_MSGLST) != 0)
+    {
+        if (rx_fifo_overflow_cnt < 0xFFFFFFFFUL)
+        {
+            rx_fifo_overflow_cnt++;
+        }
+        // Clearing MSGLST; NEWDAT is kept set if the object must not be released yet
+        iface.MCTRL = mctrl & ~(c_can::IF_MCTRL_MSGLST | c_can::IF_MCTRL_INTPND |
+                                (release ? c_can::IF_MCTRL_NEWDAT : 0));
+        transferMessageObject(msg_obj_num, c_can::IF_CMDMSK_W_WR_RD | c_can::IF_CMDMSK_W_CTRL);
+    }
+
+    rx_queue.push(frame, last_irq_utc_timestamp);
+    had_activity = true;
+}
+
+void releaseMessageObject(unsigned msg_obj_num)
+{
+    transferMessageObject(msg_obj_num, c_can::IF_CMDMSK_R_NEWDAT);
+}
+
+bool isRxFifoMessageObject(unsigned msg_obj_num)
+{
+    for (unsigned f = 0; f < num_rx_fifos; f++)
+    {
+        if ((msg_obj_num >= rx_fifos[f].first) && (msg_obj_num <= rx_fifos[f].last))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Moves all received frames from the hardware RX FIFOs into the RX queue, preserving their order.
+ */
+void drainRxFifos()
+{
+    for (unsigned f = 0; f < num_rx_fifos; f++)
+    {
+        const RxFifo& fifo = rx_fifos[f];
+        const std::uint8_t low_half_last = fifo.getLowHalfLast();
+
+        while (true)
+        {
+            // Bit N-1 corresponds to the message object N
+            const std::uint32_t pending = (c_can::CAN.IR[0] & 0xFFFF) | ((c_can::CAN.IR[1] & 0xFFFF) << 16);
+
+            unsigned msg_obj_num = fifo.first;
+            while ((msg_obj_num <= fifo.last) && ((pending & (1UL << (msg_obj_num - 1))) == 0))
+            {
+                msg_obj_num++;
+            }
+            if (msg_obj_num > fifo.last)
+            {
+                break;
+            }
+
+            if (msg_obj_num < low_half_last)
+            {
+                readRxMessageObject(msg_obj_num, false);
+            }
+            else if (msg_obj_num == low_half_last)
+            {
+                readRxMessageObject(msg_obj_num, false);
+                for (unsigned i = fifo.first; i <= low_half_last; i++)
+                {
+                    releaseMessageObject(i);
+                }
+            }
+            else
+            {
+                readRxMessageObject(msg_obj_num, true);     // The upper half, or a chain of one object
+            }
+        }
+    }
+}
+
+void handleTxInterrupt()
+{
+    transferMessageObject(TxMessageObjectNumber, c_can::IF_CMDMSK_R_CLRINTPND);
+    tx_pending = false;
+    had_activity = true;
+}
+
+void handleStatusInterrupt()
+{
+    const std::uint32_t stat = c_can::CAN.STAT;     // Reading clears the status interrupt
+    c_can::CAN.STAT = (unsigned(c_can::StatLec::Unused) << c_can::STAT_LEC_SHIFT);  // Resetting TXOK, RXOK, LEC
+
+    const auto lec = (stat >> c_can::STAT_LEC_SHIFT) & c_can::STAT_LEC_MASK;
+    const bool error = ((lec != unsigned(c_can::StatLec::NoError)) && (lec != unsigned(c_can::StatLec::Unused))) ||
+                       ((stat & c_can::STAT_BOFF) != 0);
+    if (!error)
+    {
+        return;
+    }
+
+    // Updating the error counter
+    if (error_cnt < 0xFFFFFFFFUL)
+    {
+        error_cnt++;
+    }
+
+    // Serving abort requests
+    if (tx_pending && tx_abort_on_error)
+    {
+        tx_pending = false;
+        tx_abort_on_error = false;
+
+        // Using the first interface, because this approach seems to be compliant with the BASIC mode (just in case)
+        c_can::CAN.IF[0].CMDREQ = TxMessageObjectNumber;
+        c_can::CAN.IF[0].CMDMSK.W = c_can::IF_CMDMSK_W_WR_RD;   // Clearing IF_CMDMSK_W_TXRQST
+        c_can::CAN.IF[0].MCTRL &= ~c_can::IF_MCTRL_TXRQST;      // Clearing IF_MCTRL_TXRQST
+    }
+}
+
 
 struct BitTimingSettings
 {
@@ -283,6 +531,7 @@ int CanDriver::init(uavcan::uint32_t bitrate)
         CriticalSectionLocker locker;
 
         error_cnt = 0;
+        rx_fifo_overflow_cnt = 0;
         tx_abort_on_error = false;
         tx_pending = false;
         last_irq_utc_timestamp = 0;
@@ -295,23 +544,11 @@ int CanDriver::init(uavcan::uint32_t bitrate)
 
         LPC_CCAN_API->init_can(reinterpret_cast<std::uint32_t*>(&bit_timings), true);
 
-        static CCAN_CALLBACKS_T ccan_callbacks =
-        {
-            canRxCallback,
-            canTxCallback,
-            canErrorCallback,
-            nullptr,
-            nullptr,
-            nullptr,
-            nullptr,
-            nullptr
-        };
-        LPC_CCAN_API->config_calb(&ccan_callbacks);
-
         /*
          * Interrupts
          */
         c_can::CAN.CNTL |= c_can::CNTL_SIE;         // This is necessary for transmission aborts on error
+        // The interrupts are handled by the driver itself rather than by the ROM, see CAN_IRQHandler()
 
         NVIC_EnableIRQ(CAN_IRQn);
     }
@@ -353,6 +590,11 @@ uavcan::uint32_t CanDriver::getRxQueueOverflowCount() const
     return rx_queue.getOverflowCount();
 }
 
+uavcan::uint32_t CanDriver::getRxFifoOverflowCount() const
+{
+    return rx_fifo_overflow_cnt;
+}
+
 bool CanDriver::isInBusOffState() const
 {
     return (c_can::CAN.STAT & c_can::STAT_BOFF) != 0;
@@ -488,51 +730,54 @@ uavcan::int16_t CanDriver::configureFilters(const uavcan::CanFilterConfig* filte
         }
     } can_disabler;    // Must be instantiated AFTER the critical section locker
 
-    if (num_configs == 0)
+    if (num_configs > NumberOfRxMessageObjects)
     {
-        auto msg_obj = CCAN_MSG_OBJ_T();
-        msg_obj.msgobj = NumberOfTxMessageObjects + 1;
-        LPC_CCAN_API->config_rxmsgobj(&msg_obj);    // all STD frames
-
-        msg_obj.mode_id = CAN_MSGOBJ_EXT;
-        msg_obj.msgobj = NumberOfTxMessageObjects + 2;
-        LPC_CCAN_API->config_rxmsgobj(&msg_obj);    // all EXT frames
+        return -1;
     }
-    else if (num_configs <= NumberOfRxMessageObjects)
+
+    // Making sure the configs use only EXT frames; otherwise we can't accept them
+    for (unsigned i = 0; i < num_configs; i++)
     {
-        // Making sure the configs use only EXT frames; otherwise we can't accept them
-        for (unsigned i = 0; i < num_configs; i++)
+        auto& f = filter_configs[i];
+        if ((f.id & f.mask & uavcan::CanFrame::FlagEFF) == 0)
         {
-            auto& f = filter_configs[i];
-            if ((f.id & f.mask & uavcan::CanFrame::FlagEFF) == 0)
-            {
-                return -1;
-            }
+            return -1;
         }
+    }
 
-        // Installing the configuration
-        for (unsigned i = 0; i < NumberOfRxMessageObjects; i++)
-        {
-            auto msg_obj = CCAN_MSG_OBJ_T();
-            msg_obj.msgobj = std::uint8_t(i + 1U + NumberOfTxMessageObjects);   // Message objects are numbered from 1
-
-            if (i < num_configs)
-            {
-                msg_obj.mode_id = (filter_configs[i].id & uavcan::CanFrame::MaskExtID) | CAN_MSGOBJ_EXT; // Only EXT
-                msg_obj.mask    = filter_configs[i].mask & uavcan::CanFrame::MaskExtID;
-            }
-            else
-            {
-                msg_obj.mode_id = CAN_MSGOBJ_RTR;               // Using this configuration to disable the object
-                msg_obj.mask    = uavcan::CanFrame::MaskStdID;
-            }
+    for (unsigned i = FirstRxMessageObjectNumber; i <= NumberOfMessageObjects; i++)
+    {
+        disableMessageObject(i);
+    }
+    num_rx_fifos = 0;
 
-            LPC_CCAN_API->config_rxmsgobj(&msg_obj);
+    if (num_configs == 0)
+    {
+        // One FIFO for all EXT frames, the rest accept all STD frames
+        constexpr unsigned NumStd = UAVCAN_LPC11C24_NUM_STD_RX_MESSAGE_OBJECTS;
+        constexpr unsigned LastExt = NumberOfMessageObjects - NumStd;
+        addRxFifo(FirstRxMessageObjectNumber, LastExt, 0, 0, true);
+        if (NumStd > 0)
+        {
+            addRxFifo(LastExt + 1, NumberOfMessageObjects, 0, 0, false);
         }
     }
     else
     {
-        return -1;
+        // Every filter gets its own FIFO; the remaining objects are added to the first FIFOs
+        const unsigned objects_per_filter = NumberOfRxMessageObjects / num_configs;
+        const unsigned num_extra_objects  = NumberOfRxMessageObjects % num_configs;
+
+        unsigned first = FirstRxMessageObjectNumber;
+        for (unsigned i = 0; i < num_configs; i++)
+        {
+            const unsigned length = objects_per_filter + ((i < num_extra_objects) ? 1 : 0);
+            addRxFifo(first, first + length - 1,
+                      filter_configs[i].id & uavcan::CanFrame::MaskExtID,
+                      filter_configs[i].mask & uavcan::CanFrame::MaskExtID,
+                      true);    // Only EXT
+            first += length;
+        }
     }
 
     return 0;
@@ -541,7 +786,7 @@ uavcan::int16_t CanDriver::configureFilters(const uavcan::CanFilterConfig* filte
 uavcan::uint64_t CanDriver::getErrorCount() const
 {
     CriticalSectionLocker locker;
-    return std::uint64_t(error_cnt) + std::uint64_t(rx_queue.getOverflowCount());
+    return std::uint64_t(error_cnt) + std::uint64_t(rx_fifo_overflow_cnt) + std::uint64_t(rx_queue.getOverflowCount());
 }
 
 uavcan::uint16_t CanDriver::getNumFilters() const
@@ -562,79 +807,11 @@ uavcan::uint8_t CanDriver::getNumIfaces() const
 }
 
 /*
- * C_CAN handlers
+ * C_CAN handler
  */
 extern "C"
 {
 
-void canRxCallback(std::uint8_t msg_obj_num)
-{
-    using namespace uavcan_lpc11c24;
-
-    auto msg_obj = CCAN_MSG_OBJ_T();
-    msg_obj.msgobj = msg_obj_num;
-    LPC_CCAN_API->can_receive(&msg_obj);
-
-    uavcan::CanFrame frame;
-
-    // CAN ID, EXT or not
-    if (msg_obj.mode_id & CAN_MSGOBJ_EXT)
-    {
-        frame.id = msg_obj.mode_id & uavcan::CanFrame::MaskExtID;
-        frame.id |= uavcan::CanFrame::FlagEFF;
-    }
-    else
-    {
-        frame.id = msg_obj.mode_id & uavcan::CanFrame::MaskStdID;
-    }
-
-    // RTR
-    if (msg_obj.mode_id & CAN_MSGOBJ_RTR)
-    {
-        frame.id |= uavcan::CanFrame::FlagRTR;
-    }
-
-    // Payload
-    frame.dlc = msg_obj.dlc;
-    uavcan::copy(msg_obj.data, msg_obj.data + msg_obj.dlc, frame.data);
-
-    rx_queue.push(frame, last_irq_utc_timestamp);
-    had_activity = true;
-}
-
-void canTxCallback(std::uint8_t msg_obj_num)
-{
-    using namespace uavcan_lpc11c24;
-
-    (void)msg_obj_num;
-
-    tx_pending = false;
-    had_activity = true;
-}
-
-void canErrorCallback(std::uint32_t error_info)
-{
-    using namespace uavcan_lpc11c24;
-
-    // Updating the error counter
-    if ((error_info != 0) && (error_cnt < 0xFFFFFFFFUL))
-    {
-        error_cnt++;
-    }
-
-    // Serving abort requests
-    if (tx_pending && tx_abort_on_error)
-    {
-        tx_pending = false;
-        tx_abort_on_error = false;
-
-        // Using the first interface, because this approach seems to be compliant with the BASIC mode (just in case)
-        c_can::CAN.IF[0].CMDREQ = TxMessageObjectNumber;
-        c_can::CAN.IF[0].CMDMSK.W = c_can::IF_CMDMSK_W_WR_RD;   // Clearing IF_CMDMSK_W_TXRQST
-        c_can::CAN.IF[0].MCTRL &= ~c_can::IF_MCTRL_TXRQST;      // Clearing IF_MCTRL_TXRQST
-    }
-}
-
 void CAN_IRQHandler();
 
 void CAN_IRQHandler()
@@ -643,7 +820,39 @@ void CAN_IRQHandler()
 
     last_irq_utc_timestamp = clock::getUtcUSecFromCanInterrupt();
 
-    LPC_CCAN_API->isr();
+    /*
+     * The ROM interrupt handler is not used, because it doesn't allow to control the release of the RX objects,
+     * which is required to read the hardware FIFO in order.
+     * INT reports the most important pending interrupt: status first, then the message objects in ascending order.
+     */
+    while (true)
+    {
+        const std::uint32_t source = c_can::CAN.INT & c_can::INT_MASK;
+        if (source == 0)
+        {
+            break;
+        }
+        else if (source == c_can::INT_STATUS)
+        {
+            handleStatusInterrupt();
+        }
+        else if (source == TxMessageObjectNumber)
+        {
+            handleTxInterrupt();
+        }
+        else if (source <= NumberOfMessageObjects)
+        {
+            drainRxFifos();
+            if (!isRxFifoMessageObject(source))     // The configuration may have just changed
+            {
+                transferMessageObject(source, c_can::IF_CMDMSK_R_CLRINTPND);
+            }
+        }
+        else
+        {
+            break;  // Not documented
+        }
+    }
 }
 
 }
@@ -18,6 +18,8 @@
 #include <ctime>
 #include <unistd.h>
 #include <fcntl.h>
+#include <dirent.h>
+#include <sys/mman.h>
 
 #include <uavcan/node/timer.hpp>
 #include <uavcan/data_type.hpp>
@@ -58,6 +60,37 @@ protected:
             return ::close(fd);
         }
 
+        /**
+         * Reads up to @ref size bytes at the specified offset; fewer bytes are read only if the end of file is
+         * reached. Returns zero or errno.
+         */
+        virtual int read(int fd, uavcan::uint64_t offset, uavcan::uint8_t* out_buffer, ssize_t size,
+                         ssize_t& out_size)
+        {
+            using namespace std;
+
+            out_size = 0;
+
+            if (::lseek(fd, offset, SEEK_SET) < 0)
+            {
+                return errno;
+            }
+
+            ssize_t nread = 0;
+            do
+            {
+                nread = ::read(fd, &out_buffer[out_size], size - out_size);
+                if (nread < 0)
+                {
+                    return errno;
+                }
+                out_size += nread;
+            }
+            while (nread > 0 && out_size < size);
+
+            return 0;
+        }
+
         virtual void init() { }
     };
 
@@ -71,6 +104,9 @@ protected:
         /// Rate in Seconds that the cache will be flushed of stale entries.
         enum { GarbageCollectionSeconds = 60 };
 
+        /// Rate in Seconds that memory mapped files will be checked for modifications.
+        enum { MappingValidationSeconds = 1 };
+
         class FDCacheItem : uavcan::Noncopyable
         {
             friend FDCache;
@@ -81,6 +117,25 @@ protected:
             const int oflags_;
             const char* const path_;
 
+            /*
+             * Read-ahead window: a copy of the file contents starting at window_offset_.
+             * If window_eof_ is set, the file ends where the window ends.
+             */
+            uavcan::uint8_t* window_;
+            uavcan::uint64_t window_offset_;
+            ssize_t window_size_;
+            bool window_eof_;
+
+            /*
+             * Memory mapping of the whole file, if enabled; the file is identified by its inode, size and mtime
+             * at the time of mapping.
+             */
+            const uavcan::uint8_t* mapping_;
+            size_t mapping_size_;
+            ino_t mapping_inode_;
+            std::time_t mapping_mtime_;
+            std::time_t mapping_last_validation_;
+
         public:
             enum { InvalidFD = -1 };
 
@@ -89,7 +144,16 @@ protected:
                 last_access_(0),
                 fd_(InvalidFD),
                 oflags_(0),
-                path_(NULL)
+                path_(NULL),
+                window_(NULL),
+                window_offset_(0),
+                window_size_(0),
+                window_eof_(false),
+                mapping_(NULL),
+                mapping_size_(0),
+                mapping_inode_(0),
+                mapping_mtime_(0),
+                mapping_last_validation_(0)
             { }
 
             FDCacheItem(int fd, const char* path, int oflags) :
@@ -97,7 +161,16 @@ protected:
                 last_access_(0),
                 fd_(fd),
                 oflags_(oflags),
-                path_(::strndup(path, uavcan::protocol::file::Path::FieldTypes::path::MaxSize))
+                path_(::strndup(path, uavcan::protocol::file::Path::FieldTypes::path::MaxSize)),
+                window_(NULL),
+                window_offset_(0),
+                window_size_(0),
+                window_eof_(false),
+                mapping_(NULL),
+                mapping_size_(0),
+                mapping_inode_(0),
+                mapping_mtime_(0),
+                mapping_last_validation_(0)
             { }
 
             ~FDCacheItem()
@@ -107,6 +180,11 @@ protected:
                 {
                     ::free(const_cast<char*>(path_));
                 }
+                delete[] window_;
+                if (mapping_ != NULL)
+                {
+                    (void)::munmap(const_cast<uavcan::uint8_t*>(mapping_), mapping_size_);
+                }
             }
 
             bool valid() const
@@ -152,9 +230,89 @@ protected:
             {
                 return fd_ == fd;
             }
+
+            /**
+             * Returns false if the window could not be allocated.
+             */
+            bool allocateWindow(ssize_t capacity)
+            {
+                if (window_ == NULL)
+                {
+                    window_ = new uavcan::uint8_t[capacity];
+                    window_size_ = 0;
+                }
+                return window_ != NULL;
+            }
+
+            /**
+             * Maps the whole file into memory. Returns false if the file could not be mapped, e.g. if it's empty.
+             */
+            bool map()
+            {
+                using namespace std;
+
+                struct stat sb;
+                if ((::fstat(fd_, &sb) < 0) || !S_ISREG(sb.st_mode) || (sb.st_size <= 0))
+                {
+                    return false;
+                }
+
+                void* const mapping = ::mmap(NULL, size_t(sb.st_size), PROT_READ, MAP_SHARED, fd_, 0);
+                if (mapping == MAP_FAILED)
+                {
+                    return false;
+                }
+
+                mapping_ = static_cast<const uavcan::uint8_t*>(mapping);
+                mapping_size_ = size_t(sb.st_size);
+                mapping_inode_ = sb.st_ino;
+                mapping_mtime_ = sb.st_mtime;
+                mapping_last_validation_ = time(NULL);
+                return true;
+            }
+
+            bool isMapped() const
+            {
+                return mapping_ != NULL;
+            }
+
+            /**
+             * Returns false if the file at the path does not match the mapping anymore.
+             * The check is performed at most once per MappingValidationSeconds.
+             */
+            bool validateMapping()
+            {
+                using namespace std;
+
+                const std::time_t now = time(NULL);
+                if ((now - mapping_last_validation_) < MappingValidationSeconds)
+                {
+                    return true;
+                }
+                mapping_last_validation_ = now;
+
+                struct stat sb;
+                return (::stat(path_, &sb) == 0) &&
+                       (sb.st_ino == mapping_inode_) &&
+                       (sb.st_mtime == mapping_mtime_) &&
+                       (sb.st_size == off_t(mapping_size_));
+            }
+
+            bool windowContains(uavcan::uint64_t offset, ssize_t size) const
+            {
+                if ((window_size_ <= 0) || (offset < window_offset_) ||
+                    (offset >= (window_offset_ + uavcan::uint64_t(window_size_))))
+                {
+                    return false;
+                }
+                const ssize_t available = window_size_ - ssize_t(offset - window_offset_);
+                return (available >= size) || window_eof_;
+            }
         };
 
         FDCacheItem* head_;
+        const ssize_t read_ahead_size_;
+        const bool memory_mapped_;
 
         FDCacheItem* find(const char* path, int oflags)
         {
@@ -237,9 +395,11 @@ protected:
         }
 
     public:
-        FDCache(uavcan::INode& node) :
+        FDCache(uavcan::INode& node, ssize_t read_ahead_size, bool memory_mapped) :
             TimerBase(node),
-            head_(NULL)
+            head_(NULL),
+            read_ahead_size_(read_ahead_size),
+            memory_mapped_(memory_mapped)
         { }
 
         virtual ~FDCache()
@@ -259,6 +419,14 @@ protected:
 
             FDCacheItem* pi = find(path, oflags);
 
+            if ((pi != NULL) && pi->isMapped() && !pi->validateMapping())
+            {
+                /* The file has been modified or replaced, so it has to be reopened and mapped again */
+                pi->expire();
+                removeExpired(&head_);
+                pi = NULL;
+            }
+
             if (pi != NULL)
             {
                 pi->acessed();
@@ -294,6 +462,11 @@ protected:
                 }
                 /* add new */
                 add(pi);
+
+                if (memory_mapped_ && (oflags == O_RDONLY))
+                {
+                    (void)pi->map();      // Falls back to the read-ahead window if the file can't be mapped
+                }
             }
             return pi->getFD();
         }
@@ -311,16 +484,587 @@ protected:
             remove(pi, done);
             return 0;
         }
+
+        /*
+         * Clients normally read files sequentially, so the reads are served from the read-ahead window of the
+         * cache entry, which is refilled with one large read once the requested range falls outside of it.
+         * This takes one seek and read per window rather than per request. Note that the window
+         * can hold stale data if the file is modified while it is being read; the window is discarded together
+         * with the cache entry.
+         *
+         * In the memory mapped mode, reads are copied directly from the mapping of the file.
+         */
+        virtual int read(int fd, uavcan::uint64_t offset, uavcan::uint8_t* out_buffer, ssize_t size,
+                         ssize_t& out_size)
+        {
+            FDCacheItem* pi = find(fd);
+
+            if ((pi != NULL) && pi->isMapped())
+            {
+                out_size = 0;
+                if (offset < pi->mapping_size_)
+                {
+                    out_size = uavcan::min(size, ssize_t(pi->mapping_size_ - size_t(offset)));
+                    (void)std::memcpy(out_buffer, &pi->mapping_[offset], size_t(out_size));
+                }
+                return 0;
+            }
+
+            if ((pi == NULL) || (size > read_ahead_size_) || !pi->allocateWindow(read_ahead_size_))
+            {
+                return FDCacheBase::read(fd, offset, out_buffer, size, out_size);
+            }
+
+            if (!pi->windowContains(offset, size))
+            {
+                pi->window_size_ = 0;
+                ssize_t window_size = 0;
+                const int rv = FDCacheBase::read(fd, offset, pi->window_, read_ahead_size_, window_size);
+                if (rv != 0)
+                {
+                    out_size = 0;
+                    return rv;
+                }
+                pi->window_offset_ = offset;
+                pi->window_size_ = window_size;
+                pi->window_eof_ = window_size < read_ahead_size_;
+            }
+
+            const ssize_t position = ssize_t(offset - pi->window_offset_);
+            out_size = uavcan::min(size, ssize_t(pi->window_size_ - position));
+            if (out_size > 0)
+            {
+                (void)std::memcpy(out_buffer, &pi->window_[position], size_t(out_size));
+            }
+            else
+            {
+                out_size = 0;
+            }
+            return 0;
+        }
+    };
+
+    /**
+     * Write-behind buffers of the files that are being written via uavcan.protocol.file.Write, e.g. logs uploaded
+     * by the nodes. Clients write files sequentially in small chunks, so the contiguous chunks are accumulated in
+     * the buffer of the file and written with one syscall once the buffer is full, or once the oldest buffered
+     * chunk is older than the flush delay, so that the RX path does not wait for the disk on every chunk.
+     *
+     * Failure semantics: a write is acknowledged once its data is accepted into the buffer. If a deferred write
+     * fails, the buffered data is dropped, and the error is reported in response to the next Write request
+     * for the same file, which is not written either; the request after that starts over, so the client
+     * should restart the upload upon an error.
+     *
+     * A file is flushed, fsynced and closed upon an empty Write request, which marks the end of the upload, or
+     * once it has not been written for @ref CloseTimeoutSeconds. A Write at offset zero to a file that is not open
+     * begins a new upload, so the file is truncated.
+     */
+    class WriteCache : protected uavcan::TimerBase
+    {
+        /// Rate in Milliseconds that the buffers are checked for expiration.
+        enum { TimerPeriodMs = 100 };
+
+        /// Age in Seconds a file will stay open if not written.
+        enum { CloseTimeoutSeconds = 5 };
+
+        class WriteCacheItem : uavcan::Noncopyable
+        {
+            friend class WriteCache;
+
+            WriteCacheItem* next_;
+            const int fd_;
+            const char* const path_;
+            uavcan::uint8_t* buffer_;
+            size_t buffer_size_;
+            uavcan::uint64_t buffer_offset_;        ///< File offset of the first buffered byte
+            uavcan::MonotonicTime buffered_at_;     ///< When the first buffered byte was accepted
+            uavcan::MonotonicTime last_write_;
+            int error_;                             ///< Latched errno of a failed deferred write
+
+        public:
+            WriteCacheItem(int fd, const char* path) :
+                next_(NULL),
+                fd_(fd),
+                path_(::strndup(path, uavcan::protocol::file::Path::FieldTypes::path::MaxSize)),
+                buffer_(NULL),
+                buffer_size_(0),
+                buffer_offset_(0),
+                error_(0)
+            { }
+
+            ~WriteCacheItem()
+            {
+                ::free(const_cast<char*>(path_));
+                delete[] buffer_;
+            }
+
+            bool valid() const
+            {
+                return path_ != NULL;
+            }
+
+            uavcan::uint64_t getEndOffset() const
+            {
+                return buffer_offset_ + buffer_size_;
+            }
+
+            /**
+             * Returns false if the buffer could not be allocated.
+             */
+            bool allocateBuffer(size_t capacity)
+            {
+                if (buffer_ == NULL)
+                {
+                    buffer_ = new uavcan::uint8_t[capacity];
+                    buffer_size_ = 0;
+                }
+                return buffer_ != NULL;
+            }
+
+            /**
+             * Writes the buffered data to the file. Returns zero or errno, which is also latched.
+             */
+            int flush()
+            {
+                using namespace std;
+
+                size_t written = 0;
+                while (written < buffer_size_)
+                {
+                    const ssize_t res = ::pwrite(fd_, &buffer_[written], buffer_size_ - written,
+                                                 off_t(buffer_offset_ + written));
+                    if ((res < 0) && (errno == EINTR))
+                    {
+                        continue;
+                    }
+                    if (res <= 0)
+                    {
+                        error_ = (res < 0) ? errno : EIO;
+                        break;
+                    }
+                    written += size_t(res);
+                }
+                buffer_offset_ += buffer_size_;
+                buffer_size_ = 0;
+                return error_;
+            }
+        };
+
+        WriteCacheItem* head_;
+        const size_t buffer_capacity_;
+        const uavcan::MonotonicDuration flush_delay_;
+
+        WriteCacheItem* find(const char* path)
+        {
+            using namespace std;
+
+            for (WriteCacheItem* pi = head_; pi; pi = pi->next_)
+            {
+                if (0 == ::strcmp(path, pi->path_))
+                {
+                    return pi;
+                }
+            }
+            return NULL;
+        }
+
+        /**
+         * Flushes, fsyncs and closes the file. Returns zero or errno.
+         */
+        int close(WriteCacheItem* pi)
+        {
+            int rv = pi->flush();
+            if ((::fsync(pi->fd_) < 0) && (rv == 0))
+            {
+                rv = errno;
+            }
+            if ((::close(pi->fd_) < 0) && (rv == 0))
+            {
+                rv = errno;
+            }
+
+            for (WriteCacheItem** pp = &head_; *pp; pp = &(*pp)->next_)
+            {
+                if (*pp == pi)
+                {
+                    *pp = pi->next_;
+                    break;
+                }
+            }
+            delete pi;
+
+            if (head_ == NULL)
+            {
+                stop();
+            }
+            return rv;
+        }
+
+        virtual void handleTimerEvent(const uavcan::TimerEvent& event)
+        {
+            WriteCacheItem* next = NULL;
+            for (WriteCacheItem* pi = head_; pi; pi = next)
+            {
+                next = pi->next_;
+                if ((event.real_time - pi->last_write_).toMSec() >= (CloseTimeoutSeconds * 1000))
+                {
+                    /* The error, if any, can't be reported to the client anymore */
+                    (void)close(pi);
+                }
+                else if ((pi->buffer_size_ > 0) && ((event.real_time - pi->buffered_at_) >= flush_delay_))
+                {
+                    (void)pi->flush();
+                }
+            }
+        }
+
+    public:
+        WriteCache(uavcan::INode& node, size_t buffer_capacity, uavcan::MonotonicDuration flush_delay) :
+            TimerBase(node),
+            head_(NULL),
+            buffer_capacity_(buffer_capacity),
+            flush_delay_(flush_delay)
+        { }
+
+        ~WriteCache()
+        {
+            sync();
+        }
+
+        /**
+         * Returns zero or errno. Refer to the class documentation for the failure semantics.
+         */
+        int write(const char* path, uavcan::uint64_t offset, const uavcan::uint8_t* data, size_t size)
+        {
+            using namespace std;
+
+            WriteCacheItem* pi = find(path);
+
+            if ((pi != NULL) && (pi->error_ != 0))
+            {
+                /* Reporting the error of a deferred write; the next request will reopen the file */
+                const int rv = pi->error_;
+                (void)close(pi);
+                return rv;
+            }
+
+            if (size == 0)
+            {
+                return (pi != NULL) ? close(pi) : 0;
+            }
+
+            if (pi == NULL)
+            {
+                const int fd = ::open(path, O_WRONLY | O_CREAT | ((offset == 0) ? O_TRUNC : 0), FilePermissions);
+                if (fd < 0)
+                {
+                    return errno;
+                }
+
+                pi = new WriteCacheItem(fd, path);
+                if ((pi != NULL) && !pi->valid())
+                {
+                    delete pi;
+                    pi = NULL;
+                }
+                if (pi == NULL)
+                {
+                    (void)::close(fd);
+                    return ENOMEM;
+                }
+
+                pi->next_ = head_;
+                head_ = pi;
+                if (!isRunning())
+                {
+                    startPeriodic(uavcan::MonotonicDuration::fromMSec(TimerPeriodMs));
+                }
+            }
+
+            const uavcan::MonotonicTime now = getScheduler().getMonotonicTime();
+            pi->last_write_ = now;
+
+            if ((pi->buffer_size_ > 0) &&
+                ((offset != pi->getEndOffset()) || ((pi->buffer_size_ + size) > buffer_capacity_)))
+            {
+                const int rv = pi->flush();
+                if (rv != 0)
+                {
+                    (void)close(pi);
+                    return rv;
+                }
+            }
+
+            if ((size > buffer_capacity_) || !pi->allocateBuffer(buffer_capacity_))
+            {
+                /* Written through if it can't be buffered */
+                ssize_t res = 0;
+                do
+                {
+                    res = ::pwrite(pi->fd_, data, size, off_t(offset));
+                }
+                while ((res < 0) && (errno == EINTR));
+                const int rv = (res < 0) ? errno : ((size_t(res) < size) ? EIO : 0);
+                if (rv != 0)
+                {
+                    (void)close(pi);
+                }
+                return rv;
+            }
+
+            if (pi->buffer_size_ == 0)
+            {
+                pi->buffer_offset_ = offset;
+                pi->buffered_at_ = now;
+            }
+            (void)std::memcpy(&pi->buffer_[pi->buffer_size_], data, size);
+            pi->buffer_size_ += size;
+            return 0;
+        }
+
+        /**
+         * Writes the buffered data of the file, if any, so that it can be read back. Returns zero or errno.
+         */
+        int flush(const char* path)
+        {
+            WriteCacheItem* const pi = find(path);
+            return (pi != NULL) ? pi->flush() : 0;
+        }
+
+        /**
+         * Flushes, fsyncs and closes all files.
+         */
+        void sync()
+        {
+            while (head_ != NULL)
+            {
+                (void)close(head_);
+            }
+        }
     };
 
+    /**
+     * Entries of one directory, in the order they were returned by readdir(), except "." and "..".
+     * GetDirectoryEntryInfo is index-based, so a client lists a directory by requesting every index in turn; the
+     * snapshot allows to serve the whole listing with one directory read rather than one read per entry.
+     */
+    class DirectorySnapshot : uavcan::Noncopyable
+    {
+        Path path_;                         ///< Empty if the snapshot is not used
+        ino_t inode_;
+        std::time_t mtime_;
+        std::time_t taken_at_;
+        char* names_;                       ///< Null-terminated names, one after another
+        size_t names_size_;
+        size_t names_capacity_;
+        uavcan::uint32_t* offsets_;         ///< Offset of every name in names_
+        uavcan::uint32_t num_entries_;
+        uavcan::uint32_t offsets_capacity_;
+
+        bool append(const char* name)
+        {
+            using namespace std;
+
+            const size_t len = strlen(name) + 1U;
+            if ((names_size_ + len) > names_capacity_)
+            {
+                const size_t capacity = uavcan::max(names_capacity_ * 2U, names_size_ + len);
+                char* const names = static_cast<char*>(::realloc(names_, capacity));
+                if (names == NULL)
+                {
+                    return false;
+                }
+                names_ = names;
+                names_capacity_ = capacity;
+            }
+            if (num_entries_ == offsets_capacity_)
+            {
+                const uavcan::uint32_t capacity = uavcan::max(offsets_capacity_ * 2U, 16U);
+                void* const offsets = ::realloc(offsets_, capacity * sizeof(uavcan::uint32_t));
+                if (offsets == NULL)
+                {
+                    return false;
+                }
+                offsets_ = static_cast<uavcan::uint32_t*>(offsets);
+                offsets_capacity_ = capacity;
+            }
+            (void)memcpy(&names_[names_size_], name, len);
+            offsets_[num_entries_++] = uavcan::uint32_t(names_size_);
+            names_size_ += len;
+            return true;
+        }
+
+    public:
+        uavcan::uint32_t last_use;
+
+        DirectorySnapshot() :
+            inode_(0),
+            mtime_(0),
+            taken_at_(0),
+            names_(NULL),
+            names_size_(0),
+            names_capacity_(0),
+            offsets_(NULL),
+            num_entries_(0),
+            offsets_capacity_(0),
+            last_use(0)
+        { }
+
+        ~DirectorySnapshot()
+        {
+            ::free(names_);
+            ::free(offsets_);
+        }
+
+        void clear()
+        {
+            path_.clear();
+            names_size_ = 0;
+            num_entries_ = 0;
+        }
+
+        /**
+         * The snapshot is valid while the inode and mtime of the directory are unchanged, but for no longer than
+         * max_age seconds, because the resolution of mtime is one second and a change made within the same second
+         * as the snapshot would go unnoticed otherwise.
+         */
+        bool matches(const Path& path, const struct stat& sb, std::time_t now, std::time_t max_age) const
+        {
+            return !path_.empty() && (path_ == path) && (inode_ == sb.st_ino) && (mtime_ == sb.st_mtime) &&
+                   ((now - taken_at_) < max_age);
+        }
+
+        /**
+         * Reads the directory. Returns zero or errno.
+         */
+        int take(const Path& path, const struct stat& sb, std::time_t now)
+        {
+            using namespace std;
+
+            clear();
+
+            DIR* const dir = ::opendir(path.c_str());
+            if (dir == NULL)
+            {
+                return errno;
+            }
+
+            int rv = 0;
+            struct dirent* entry = NULL;
+            while ((entry = ::readdir(dir)) != NULL)
+            {
+                if ((strcmp(entry->d_name, ".") == 0) || (strcmp(entry->d_name, "..") == 0))
+                {
+                    continue;
+                }
+                if (!append(entry->d_name))
+                {
+                    rv = ENOMEM;
+                    break;
+                }
+            }
+            (void)::closedir(dir);
+
+            if (rv != 0)
+            {
+                clear();
+                return rv;
+            }
+
+            path_ = path;
+            inode_ = sb.st_ino;
+            mtime_ = sb.st_mtime;
+            taken_at_ = now;
+            return 0;
+        }
+
+        uavcan::uint32_t getNumEntries() const { return num_entries_; }
+
+        const char* getEntryName(uavcan::uint32_t index) const
+        {
+            return (index < num_entries_) ? &names_[offsets_[index]] : NULL;
+        }
+    };
+
+    /// Number of directories whose snapshots are kept; the least recently used one is replaced.
+    enum { DirectoryCacheSize = 4 };
+
+    /// Age in Seconds after which a snapshot is taken again even if the directory looks unchanged.
+    enum { DirectorySnapshotMaxAgeSeconds = 5 };
+
+    DirectorySnapshot directory_cache_[DirectoryCacheSize];
+    uavcan::uint32_t directory_cache_use_counter_;
+
+    /**
+     * Returns zero or error code.
+     */
+    int getDirectorySnapshot(const Path& path, const DirectorySnapshot*& out_snapshot)
+    {
+        using namespace std;
+
+        struct stat sb;
+        if (stat(path.c_str(), &sb) < 0)
+        {
+            return errno;
+        }
+        if (!S_ISDIR(sb.st_mode))
+        {
+            return uavcan::protocol::file::Error::INVALID_VALUE;
+        }
+
+        const std::time_t now = time(NULL);
+        DirectorySnapshot* victim = &directory_cache_[0];
+        for (unsigned i = 0; i < DirectoryCacheSize; i++)
+        {
+            DirectorySnapshot& snapshot = directory_cache_[i];
+            if (snapshot.matches(path, sb, now, DirectorySnapshotMaxAgeSeconds))
+            {
+                snapshot.last_use = ++directory_cache_use_counter_;
+                out_snapshot = &snapshot;
+                return 0;
+            }
+            if (snapshot.last_use < victim->last_use)
+            {
+                victim = &snapshot;
+            }
+        }
+
+        const int rv = victim->take(path, sb, now);
+        if (rv != 0)
+        {
+            return rv;
+        }
+        victim->last_use = ++directory_cache_use_counter_;
+        out_snapshot = victim;
+        return 0;
+    }
+
+    static uavcan::uint8_t getEntryTypeFlags(const struct stat& sb)
+    {
+        // TODO Using fixed flag FLAG_READABLE until we add file permission checks to return actual value.
+        uavcan::uint8_t flags = uavcan::protocol::file::EntryType::FLAG_READABLE;
+        if (S_ISDIR(sb.st_mode))
+        {
+            flags |= uavcan::protocol::file::EntryType::FLAG_DIRECTORY;
+        }
+        else if (S_ISREG(sb.st_mode))
+        {
+            flags |= uavcan::protocol::file::EntryType::FLAG_FILE;
+        }
+        return flags;
+    }
+
     FDCacheBase* fdcache_;
     uavcan::INode& node_;
+    const ssize_t read_ahead_size_;
+    const bool memory_mapped_;
+    WriteCache write_cache_;
 
     FDCacheBase& getFDCache()
     {
         if (fdcache_ == NULL)
         {
-            fdcache_ = new FDCache(node_);
+            fdcache_ = new FDCache(node_, read_ahead_size_, memory_mapped_);
 
             if (fdcache_ == NULL)
             {
@@ -345,6 +1089,8 @@ protected:
         {
             using namespace std;
 
+            (void)write_cache_.flush(path.c_str());     // The size must include the buffered data
+
             struct stat sb;
 
             rv = stat(path.c_str(), &sb);
@@ -357,16 +1103,7 @@ protected:
             {
                 rv = 0;
                 out_size = sb.st_size;
-                out_type.flags = uavcan::protocol::file::EntryType::FLAG_READABLE;
-                if (S_ISDIR(sb.st_mode))
-                {
-                    out_type.flags |= uavcan::protocol::file::EntryType::FLAG_DIRECTORY;
-                }
-                else if (S_ISREG(sb.st_mode))
-                {
-                    out_type.flags |= uavcan::protocol::file::EntryType::FLAG_FILE;
-                }
-                // TODO Using fixed flag FLAG_READABLE until we add file permission checks to return actual value.
+                out_type.flags = getEntryTypeFlags(sb);
             }
         }
         return rv;
@@ -388,6 +1125,8 @@ protected:
         {
             using namespace std;
 
+            (void)write_cache_.flush(path.c_str());
+
             FDCacheBase& cache = getFDCache();
             int fd = cache.open(path.c_str(), O_RDONLY);
 
@@ -399,32 +1138,7 @@ protected:
             {
                 ssize_t total_read = 0;
 
-                rv = ::lseek(fd, offset, SEEK_SET);
-
-                if (rv < 0)
-                {
-                    rv = errno;
-                }
-                else
-                {
-                    rv = 0;
-                    ssize_t remaining = inout_size;
-                    ssize_t nread = 0;
-                    do
-                    {
-                        nread = ::read(fd, &out_buffer[total_read], remaining);
-                        if (nread < 0)
-                        {
-                            rv = errno;
-                        }
-                        else
-                        {
-                            remaining -= nread,
-                            total_read += nread;
-                        }
-                    }
-                    while (nread > 0 && remaining > 0);
-                }
+                rv = cache.read(fd, offset, out_buffer, inout_size, total_read);
 
                 (void)cache.close(fd, rv != 0 || total_read != inout_size);
                 inout_size = total_read;
@@ -433,10 +1147,100 @@ protected:
         return rv;
     }
 
+    /**
+     * Back-end for uavcan.protocol.file.GetDirectoryEntryInfo.
+     * The entries are served from a snapshot of the directory, so listing N entries takes one directory read and
+     * N stat() calls; the snapshot is refreshed when the directory changes, see @ref DirectorySnapshot.
+     * If the index is out of range, NOT_FOUND is returned.
+     * On success the method must return zero.
+     */
+    virtual uavcan::int16_t getDirectoryEntryInfo(const Path& directory_path, const uavcan::uint32_t entry_index,
+                                                  EntryType& out_type, Path& out_entry_full_path)
+    {
+        using namespace std;
+
+        if (directory_path.size() == 0)
+        {
+            return uavcan::protocol::file::Error::INVALID_VALUE;
+        }
+
+        const DirectorySnapshot* snapshot = NULL;
+        const int rv = getDirectorySnapshot(directory_path, snapshot);
+        if (rv != 0)
+        {
+            return uavcan::int16_t(rv);
+        }
+
+        const char* const name = snapshot->getEntryName(entry_index);
+        if (name == NULL)
+        {
+            return uavcan::protocol::file::Error::NOT_FOUND;
+        }
+
+        const bool needs_separator = *(directory_path.end() - 1) != getPathSeparator();
+        if ((directory_path.size() + (needs_separator ? 1U : 0U) + strlen(name)) > out_entry_full_path.capacity())
+        {
+            return uavcan::protocol::file::Error::INVALID_VALUE;
+        }
+        out_entry_full_path = directory_path;
+        if (needs_separator)
+        {
+            out_entry_full_path.push_back(uavcan::uint8_t(getPathSeparator()));
+        }
+        out_entry_full_path += name;
+
+        struct stat sb;
+        if (stat(out_entry_full_path.c_str(), &sb) < 0)
+        {
+            return uavcan::int16_t(errno);      // Removed after the snapshot was taken
+        }
+        out_type.flags = getEntryTypeFlags(sb);
+        return 0;
+    }
+
+    /**
+     * Back-end for uavcan.protocol.file.Write.
+     * The data is buffered, refer to @ref WriteCache for details; an empty request completes the upload.
+     * On success the method must return zero.
+     */
+    virtual uavcan::int16_t write(const Path& path, const uavcan::uint64_t offset, const uavcan::uint8_t* buffer,
+                                  const uavcan::uint16_t size)
+    {
+        if (path.size() == 0)
+        {
+            return uavcan::protocol::file::Error::INVALID_VALUE;
+        }
+        return uavcan::int16_t(write_cache_.write(path.c_str(), offset, buffer, size));
+    }
+
 public:
-    BasicFileServerBackend(uavcan::INode& node) :
+    enum { DefaultReadAheadSize = 16 * ReadSize };
+    enum { DefaultWriteBufferSize = 4096 };
+    enum { DefaultWriteFlushDelayMs = 500 };
+
+    /**
+     * @param node              Node instance
+     * @param read_ahead_size   Size of the read-ahead window of every open file, in bytes.
+     *                          Read requests are served directly from the file if this is less than @ref ReadSize.
+     * @param memory_mapped     If true, files are mapped into memory once, and read requests are copied from the
+     *                          mapping without any syscalls. The read-ahead window is used for files that can't be
+     *                          mapped. Files are remapped if their mtime, size or inode changes; this is checked once
+     *                          per second. A file that is truncated in place while it is mapped will cause SIGBUS,
+     *                          so files should be replaced atomically, e.g. via rename().
+     * @param write_buffer_size Size of the write-behind buffer of every file that is being written, in bytes.
+     *                          Write requests are written through if this is zero.
+     * @param write_flush_delay Maximum time the written data can stay in the buffer before it is written to the file.
+     */
+    BasicFileServerBackend(uavcan::INode& node, unsigned read_ahead_size = DefaultReadAheadSize,
+                           bool memory_mapped = false, unsigned write_buffer_size = DefaultWriteBufferSize,
+                           uavcan::MonotonicDuration write_flush_delay =
+                               uavcan::MonotonicDuration::fromMSec(DefaultWriteFlushDelayMs)) :
+        directory_cache_use_counter_(0),
         fdcache_(NULL),
-        node_(node)
+        node_(node),
+        read_ahead_size_(ssize_t(read_ahead_size)),
+        memory_mapped_(memory_mapped),
+        write_cache_(node, write_buffer_size, write_flush_delay)
     { }
 
     ~BasicFileServerBackend()
@@ -11,9 +11,11 @@
 
 #include <uavcan/protocol/dynamic_node_id_server/event.hpp>
 #include <cstdio>
+#include <cerrno>
 #include <time.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <pthread.h>
 
 namespace uavcan_posix
 {
@@ -31,14 +33,64 @@ class FileEventTracer : public uavcan::dynamic_node_id_server::IEventTracer
 
     enum { FilePermissions = 438 };     ///< 0o666
 
+protected:
     /**
      * This type is used for the path
      */
     typedef uavcan::MakeString<MaxPathLength>::Type PathString;
 
+private:
     PathString path_;
 
 protected:
+    /**
+     * Maximum length of one line of the log, excluding the null terminator
+     */
+    enum { FormatBufferLength = 63 };
+
+    /**
+     * Writes one line "timestamp<TAB>code<TAB>argument" into the buffer, which must be at least
+     * FormatBufferLength + 1 bytes long.
+     * @return Length of the line.
+     */
+    static unsigned formatEvent(const timespec& ts, uavcan::dynamic_node_id_server::TraceCode code,
+                                uavcan::int64_t argument, char* buffer)
+    {
+        using namespace std;
+        const int res = snprintf(buffer, FormatBufferLength, "%ld.%06ld\t%d\t%lld\n",
+                                 static_cast<long>(ts.tv_sec), static_cast<long>(ts.tv_nsec / 1000L),
+                                 static_cast<int>(code), static_cast<long long>(argument));
+        return (res < 0) ? 0U : ((res < FormatBufferLength) ? unsigned(res) : unsigned(FormatBufferLength - 1));
+    }
+
+    /**
+     * The file is opened for every write, so that it is recreated if removed.
+     * @return File descriptor or negative on error.
+     */
+    int openFile() const
+    {
+        using namespace std;
+        return open(path_.c_str(), O_WRONLY | O_CREAT | O_APPEND, FilePermissions);
+    }
+
+    static void writeAll(int fd, const char* data, unsigned size)
+    {
+        using namespace std;
+        ssize_t remaining = static_cast<ssize_t>(size);
+        ssize_t total_written = 0;
+        ssize_t written = 0;
+        do
+        {
+            written = write(fd, &data[total_written], remaining);
+            if (written > 0)
+            {
+                total_written += written;
+                remaining -=  written;
+            }
+        }
+        while (written > 0 && remaining > 0);
+    }
+
     virtual void onEvent(uavcan::dynamic_node_id_server::TraceCode code, uavcan::int64_t argument)
     {
         using namespace std;
@@ -46,27 +98,11 @@ protected:
         timespec ts = timespec();               // If clock_gettime() fails, zero time will be used
         (void)clock_gettime(CLOCK_REALTIME, &ts);
 
-        int fd = open(path_.c_str(), O_WRONLY | O_CREAT | O_APPEND, FilePermissions);
+        int fd = openFile();
         if (fd >= 0)
         {
-            const int FormatBufferLength = 63;
             char buffer[FormatBufferLength + 1];
-            ssize_t remaining = snprintf(buffer, FormatBufferLength, "%ld.%06ld\t%d\t%lld\n",
-                                         static_cast<long>(ts.tv_sec), static_cast<long>(ts.tv_nsec / 1000L),
-                                         static_cast<int>(code), static_cast<long long>(argument));
-
-            ssize_t total_written = 0;
-            ssize_t written = 0;
-            do
-            {
-                written = write(fd, &buffer[total_written], remaining);
-                if (written > 0)
-                {
-                    total_written += written;
-                    remaining -=  written;
-                }
-            }
-            while (written > 0 && remaining > 0);
+            writeAll(fd, buffer, formatEvent(ts, code, argument, buffer));
             (void)close(fd);
         }
     }
@@ -94,6 +130,258 @@ public:
         return rv;
     }
 };
+
+/**
+ * Same as @ref FileEventTracer, but the file is not written from the thread that reports the events.
+ * The events are put into an in-memory ring, and a background thread writes them into the file in batches,
+ * once per flush interval, or earlier if the ring gets half full; so the file IO does not affect the timing of the
+ * server, e.g. the Raft timers during an allocation storm.
+ *
+ * If the ring is full, new events are dropped; see @ref getNumDroppedEvents().
+ * The remaining events are written upon destruction.
+ *
+ * @tparam BufferCapacity   Maximum number of events waiting to be written.
+ */
+template <unsigned BufferCapacity = 512>
+class BufferedFileEventTracer : public FileEventTracer
+{
+    enum { DefaultFlushIntervalMs = 100 };
+
+    /**
+     * Larger batches are written in several parts.
+     */
+    enum { WriteBufferSize = (FormatBufferLength + 1) * 32 };
+
+    struct Event
+    {
+        timespec ts;
+        uavcan::dynamic_node_id_server::TraceCode code;
+        uavcan::int64_t argument;
+    };
+
+    Event ring_[BufferCapacity];
+    uavcan::uint32_t head_;                 ///< Free running; head_ == tail_ means empty
+    uavcan::uint32_t tail_;
+    uavcan::uint32_t num_dropped_events_;
+    uavcan::uint32_t flush_interval_ms_;
+    bool stop_requested_;
+    bool thread_running_;
+
+    mutable pthread_mutex_t mutex_;         ///< Protects all of the above except the contents of the ring
+    pthread_cond_t cond_;
+    pthread_mutex_t flush_mutex_;           ///< Serializes the flushes, protects the write buffer
+    pthread_t thread_;
+
+    char write_buffer_[WriteBufferSize];
+
+    uavcan::uint32_t getNumPendingEventsLocked() const { return tail_ - head_; }
+
+    static void* threadEntry(void* arg)
+    {
+        static_cast<BufferedFileEventTracer*>(arg)->threadMain();
+        return NULL;
+    }
+
+    void threadMain()
+    {
+        (void)pthread_mutex_lock(&mutex_);
+        while (!stop_requested_)
+        {
+            timespec deadline = timespec();
+            (void)clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_sec += static_cast<time_t>(flush_interval_ms_ / 1000U);
+            deadline.tv_nsec += static_cast<long>(flush_interval_ms_ % 1000U) * 1000000L;
+            if (deadline.tv_nsec >= 1000000000L)
+            {
+                deadline.tv_sec += 1;
+                deadline.tv_nsec -= 1000000000L;
+            }
+
+            while (!stop_requested_ && (getNumPendingEventsLocked() < (BufferCapacity / 2U)))
+            {
+                if (pthread_cond_timedwait(&cond_, &mutex_, &deadline) == ETIMEDOUT)
+                {
+                    break;
+                }
+            }
+
+            (void)pthread_mutex_unlock(&mutex_);
+            flush();
+            (void)pthread_mutex_lock(&mutex_);
+        }
+        (void)pthread_mutex_unlock(&mutex_);
+
+        flush();
+    }
+
+    void stopThread()
+    {
+        if (thread_running_)
+        {
+            (void)pthread_mutex_lock(&mutex_);
+            stop_requested_ = true;
+            (void)pthread_cond_signal(&cond_);
+            (void)pthread_mutex_unlock(&mutex_);
+
+            (void)pthread_join(thread_, NULL);
+            thread_running_ = false;
+        }
+    }
+
+protected:
+    virtual void onEvent(uavcan::dynamic_node_id_server::TraceCode code, uavcan::int64_t argument)
+    {
+        if (!thread_running_)
+        {
+            FileEventTracer::onEvent(code, argument);
+            return;
+        }
+
+        timespec ts = timespec();               // If clock_gettime() fails, zero time will be used
+        (void)clock_gettime(CLOCK_REALTIME, &ts);
+
+        (void)pthread_mutex_lock(&mutex_);
+        const uavcan::uint32_t num_pending = getNumPendingEventsLocked();
+        if (num_pending < BufferCapacity)
+        {
+            Event& ev = ring_[tail_ % BufferCapacity];
+            ev.ts = ts;
+            ev.code = code;
+            ev.argument = argument;
+            tail_++;
+            if ((num_pending + 1U) == (BufferCapacity / 2U))
+            {
+                (void)pthread_cond_signal(&cond_);
+            }
+        }
+        else
+        {
+            num_dropped_events_++;
+        }
+        (void)pthread_mutex_unlock(&mutex_);
+    }
+
+public:
+    BufferedFileEventTracer()
+        : head_(0)
+        , tail_(0)
+        , num_dropped_events_(0)
+        , flush_interval_ms_(DefaultFlushIntervalMs)
+        , stop_requested_(false)
+        , thread_running_(false)
+    {
+        uavcan::StaticAssert<(BufferCapacity >= 2)>::check();
+        (void)pthread_mutex_init(&mutex_, NULL);
+        (void)pthread_cond_init(&cond_, NULL);
+        (void)pthread_mutex_init(&flush_mutex_, NULL);
+    }
+
+    virtual ~BufferedFileEventTracer()
+    {
+        stopThread();
+        (void)pthread_mutex_destroy(&flush_mutex_);
+        (void)pthread_cond_destroy(&cond_);
+        (void)pthread_mutex_destroy(&mutex_);
+    }
+
+    /**
+     * Initializes the tracer and starts the background thread.
+     * Until this method succeeds, the events are written synchronously, the same way as by @ref FileEventTracer.
+     * @param path                  Same as for @ref FileEventTracer::init().
+     * @param flush_interval_ms     Maximum time an event waits in the ring, approximately.
+     * @return Negative on error.
+     */
+    int init(const PathString& path, uavcan::uint32_t flush_interval_ms = DefaultFlushIntervalMs)
+    {
+        if (thread_running_)
+        {
+            return -uavcan::ErrLogic;
+        }
+
+        const int rv = FileEventTracer::init(path);
+        if (rv < 0)
+        {
+            return rv;
+        }
+
+        flush_interval_ms_ = (flush_interval_ms > 0) ? flush_interval_ms : 1U;
+        stop_requested_ = false;
+        if (pthread_create(&thread_, NULL, &BufferedFileEventTracer::threadEntry, this) != 0)
+        {
+            return -uavcan::ErrFailure;
+        }
+        thread_running_ = true;
+        return 0;
+    }
+
+    /**
+     * Writes all pending events into the file; blocks until done.
+     * Normally this is done by the background thread.
+     */
+    void flush()
+    {
+        (void)pthread_mutex_lock(&flush_mutex_);
+
+        // The slots between head and tail are not modified by onEvent(), so they can be read without the lock
+        (void)pthread_mutex_lock(&mutex_);
+        uavcan::uint32_t head = head_;
+        const uavcan::uint32_t tail = tail_;
+        (void)pthread_mutex_unlock(&mutex_);
+
+        if (head != tail)
+        {
+            const int fd = openFile();
+            unsigned length = 0;
+            while (head != tail)
+            {
+                if ((WriteBufferSize - length) <= unsigned(FormatBufferLength))
+                {
+                    if (fd >= 0)
+                    {
+                        writeAll(fd, write_buffer_, length);
+                    }
+                    length = 0;
+                }
+                const Event& ev = ring_[head % BufferCapacity];
+                length += formatEvent(ev.ts, ev.code, ev.argument, &write_buffer_[length]);
+                head++;
+            }
+            if (fd >= 0)
+            {
+                writeAll(fd, write_buffer_, length);
+                (void)close(fd);
+            }
+
+            (void)pthread_mutex_lock(&mutex_);
+            head_ = head;
+            (void)pthread_mutex_unlock(&mutex_);
+        }
+
+        (void)pthread_mutex_unlock(&flush_mutex_);
+    }
+
+    /**
+     * Number of events that did not fit into the ring since initialization.
+     */
+    uavcan::uint32_t getNumDroppedEvents() const
+    {
+        (void)pthread_mutex_lock(&mutex_);
+        const uavcan::uint32_t ret = num_dropped_events_;
+        (void)pthread_mutex_unlock(&mutex_);
+        return ret;
+    }
+
+    /**
+     * Number of events waiting in the ring.
+     */
+    uavcan::uint32_t getNumPendingEvents() const
+    {
+        (void)pthread_mutex_lock(&mutex_);
+        const uavcan::uint32_t ret = getNumPendingEventsLocked();
+        (void)pthread_mutex_unlock(&mutex_);
+        return ret;
+    }
+};
 }
 }
 
@@ -26,6 +26,11 @@ namespace dynamic_node_id_server
 {
 /**
  * This interface implements a POSIX compliant IStorageBackend interface
+ *
+ * Recently read and written values are cached in memory, so that repeated reads of the same key don't touch the
+ * file system; the files therefore must not be modified by anyone else while the backend is in use, unless
+ * @ref invalidateCache() is called afterwards. See also @ref LogStructuredStorageBackend, which keeps all keys
+ * in one file and is loaded with one sequential read.
  */
 class FileStorageBackend : public uavcan::dynamic_node_id_server::IStorageBackend
 {
@@ -41,12 +46,82 @@ class FileStorageBackend : public uavcan::dynamic_node_id_server::IStorageBacken
      */
     typedef uavcan::MakeString<MaxPathLength>::Type PathString;
 
+    /**
+     * Number of the cached key/value pairs; the oldest entry is replaced when the cache is full.
+     */
+    enum { CacheSize = 32 };
+
+    struct CacheEntry
+    {
+        String key;
+        String value;
+    };
+
     PathString base_path;
 
+    mutable CacheEntry cache_[CacheSize];
+    mutable unsigned cache_size_;
+    mutable unsigned cache_next_victim_;
+
+    CacheEntry* findInCache(const String& key) const
+    {
+        for (unsigned i = 0; i < cache_size_; i++)
+        {
+            if (cache_[i].key == key)
+            {
+                return &cache_[i];
+            }
+        }
+        return NULL;
+    }
+
+    void putIntoCache(const String& key, const String& value) const
+    {
+        CacheEntry* entry = findInCache(key);
+        if (entry == NULL)
+        {
+            if (cache_size_ < CacheSize)
+            {
+                entry = &cache_[cache_size_++];
+            }
+            else
+            {
+                entry = &cache_[cache_next_victim_];
+                cache_next_victim_ = (cache_next_victim_ + 1U) % CacheSize;
+            }
+            entry->key = key;
+        }
+        entry->value = value;
+    }
+
+    void removeFromCache(const String& key) const
+    {
+        CacheEntry* const entry = findInCache(key);
+        if (entry != NULL)
+        {
+            entry->key.clear();         // Empty keys are never looked up
+        }
+    }
+
+    /**
+     * Values containing whitespace are truncated by get(), so they are not cached.
+     */
+    static bool isCacheable(const String& value)
+    {
+        return std::strpbrk(value.c_str(), " \n\r") == NULL;
+    }
+
 protected:
     virtual String get(const String& key) const
     {
         using namespace std;
+
+        const CacheEntry* const cached = findInCache(key);
+        if (cached != NULL)
+        {
+            return cached->value;
+        }
+
         PathString path = base_path.c_str();
         path += key;
         String value;
@@ -82,6 +157,7 @@ protected:
                 value = buffer;
             }
         }
+        putIntoCache(key, value);       // Missing keys are cached as well
         return value;
     }
 
@@ -90,6 +166,7 @@ protected:
         using namespace std;
         PathString path = base_path.c_str();
         path += key;
+        removeFromCache(key);
         int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, FilePermissions);
         if (fd >= 0)
         {
@@ -109,10 +186,30 @@ protected:
 
             (void)fsync(fd);
             (void)close(fd);
+
+            if ((remaining == 0) && isCacheable(value))
+            {
+                putIntoCache(key, value);
+            }
         }
     }
 
 public:
+    FileStorageBackend()
+        : cache_size_(0)
+        , cache_next_victim_(0)
+    { }
+
+    /**
+     * Drops all cached values; the next reads will go to the file system.
+     * Must be called if the files were modified externally.
+     */
+    void invalidateCache()
+    {
+        cache_size_ = 0;
+        cache_next_victim_ = 0;
+    }
+
     /**
      * Initializes the file based backend storage by passing a path to
      * the directory where the key named files will be stored.
@@ -128,6 +225,7 @@ public:
 
         if (path.size() > 0)
         {
+            invalidateCache();
             base_path = path.c_str();
 
             if (base_path.back() == '/')
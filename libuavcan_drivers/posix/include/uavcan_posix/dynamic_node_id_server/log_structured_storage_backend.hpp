@@ -0,0 +1,452 @@
+/****************************************************************************
+*
+*   Copyright (c) 2015 PX4 Development Team. All rights reserved.
+*      Author: Pavel Kirienko <pavel.kirienko@gmail.com>
+*
+****************************************************************************/
+
+#ifndef UAVCAN_POSIX_DYNAMIC_NODE_ID_SERVER_LOG_STRUCTURED_STORAGE_BACKEND_HPP_INCLUDED
+#define UAVCAN_POSIX_DYNAMIC_NODE_ID_SERVER_LOG_STRUCTURED_STORAGE_BACKEND_HPP_INCLUDED
+
+#include <sys/types.h>
+#include <cstdio>
+#include <cstddef>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <uavcan/protocol/dynamic_node_id_server/storage_backend.hpp>
+
+namespace uavcan_posix
+{
+namespace dynamic_node_id_server
+{
+/**
+ * This is a POSIX compliant IStorageBackend implementation that keeps all key/value pairs in one append-only file,
+ * unlike @ref FileStorageBackend, which keeps every value in a separate file. Every update of the storage results
+ * in one write() and one fsync(), and a batch of updates is written and synchronized at once, so that e.g. a Raft
+ * log entry costs one fsync() instead of four. The data are cached in memory, so reads don't touch the file.
+ *
+ * The file consists of text lines "key value"; a line with the key only deletes the key. Every group of updates
+ * is terminated by an empty line; the lines that follow the last empty line belong to an incomplete write and
+ * are ignored upon loading, so a batch is either stored in full or not at all.
+ *
+ * The file is compacted, i.e. rewritten with the current values only, upon initialization and whenever it grows
+ * larger than MaxFileSize. Compaction writes a temporary file next to the storage file, then renames it.
+ */
+class LogStructuredStorageBackend : public uavcan::dynamic_node_id_server::IStorageBackend
+{
+    /**
+     * Maximum length of the full path to the storage file
+     */
+    enum { MaxPathLength = 128 };
+
+    enum { FilePermissions = 438 };     ///< 0o666
+
+    /**
+     * "key value\n"
+     */
+    enum { MaxRecordLength = MaxStringLength * 2 + 2 };
+
+    /**
+     * Larger batches are written in several parts; the terminating empty line is written last.
+     */
+    enum { BatchBufferSize = MaxRecordLength * 16 };
+
+    /**
+     * The file is compacted once it reaches twice the size of the largest possible data set.
+     */
+    enum { MaxFileSize = MaxRecordLength * MaxKeyValuePairs * 2 };
+
+    typedef uavcan::MakeString<MaxPathLength>::Type PathString;
+
+    struct KeyValuePair
+    {
+        String key;
+        String value;
+    };
+
+    KeyValuePair pairs_[MaxKeyValuePairs];
+    unsigned num_pairs_;
+    PathString path_;
+    int fd_;
+    off_t file_size_;
+    char batch_buffer_[BatchBufferSize + 1];   ///< Plus the terminating empty line
+    unsigned batch_length_;
+    bool in_batch_;
+    bool batch_failed_;
+
+    LogStructuredStorageBackend(const LogStructuredStorageBackend&);
+    LogStructuredStorageBackend& operator=(const LogStructuredStorageBackend&);
+
+    static int writeAll(int fd, const char* data, size_t size)
+    {
+        while (size > 0)
+        {
+            const ssize_t written = ::write(fd, data, size);
+            if (written < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                return -errno;
+            }
+            data += written;
+            size -= size_t(written);
+        }
+        return 0;
+    }
+
+    static unsigned formatRecord(const String& key, const String& value, char* out_buffer)
+    {
+        unsigned len = 0;
+        (void)std::memcpy(out_buffer, key.c_str(), key.size());
+        len += key.size();
+        if (!value.empty())
+        {
+            out_buffer[len++] = ' ';
+            (void)std::memcpy(out_buffer + len, value.c_str(), value.size());
+            len += value.size();
+        }
+        out_buffer[len++] = '\n';
+        return len;
+    }
+
+    KeyValuePair* findPair(const String& key)
+    {
+        for (unsigned i = 0; i < num_pairs_; i++)
+        {
+            if (pairs_[i].key == key)
+            {
+                return &pairs_[i];
+            }
+        }
+        return NULL;
+    }
+
+    void applyRecord(const String& key, const String& value)
+    {
+        KeyValuePair* const pair = findPair(key);
+        if (value.empty())
+        {
+            if (pair != NULL)
+            {
+                *pair = pairs_[--num_pairs_];
+            }
+        }
+        else if (pair != NULL)
+        {
+            pair->value = value;
+        }
+        else if (num_pairs_ < MaxKeyValuePairs)
+        {
+            pairs_[num_pairs_].key = key;
+            pairs_[num_pairs_].value = value;
+            num_pairs_++;
+        }
+        else
+        {
+            ;   // No space left, the value will not be readable; the caller will detect that
+        }
+    }
+
+    void applyLine(const char* line, unsigned length)
+    {
+        const char* const separator = static_cast<const char*>(std::memchr(line, ' ', length));
+        const unsigned key_length = (separator == NULL) ? length : unsigned(separator - line);
+        const unsigned value_length = (separator == NULL) ? 0 : (length - key_length - 1);
+        if ((key_length == 0) || (key_length > MaxStringLength) || (value_length > MaxStringLength))
+        {
+            return;     // Malformed line
+        }
+        String key;
+        String value;
+        for (unsigned i = 0; i < key_length; i++)
+        {
+            key.push_back(uint8_t(line[i]));
+        }
+        for (unsigned i = 0; i < value_length; i++)
+        {
+            value.push_back(uint8_t(separator[i + 1]));
+        }
+        applyRecord(key, value);
+    }
+
+    /**
+     * Replaces the cached data with the committed content of the file.
+     */
+    int load()
+    {
+        num_pairs_ = 0;
+
+        const int fd = ::open(path_.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            return (errno == ENOENT) ? 0 : -errno;
+        }
+
+        char buffer[512];
+
+        /*
+         * First pass - finding the end of the last complete group of records, i.e. the last empty line.
+         */
+        off_t committed_size = 0;
+        off_t offset = 0;
+        char prev_char = '\n';
+        ssize_t nread = 0;
+        while ((nread = ::read(fd, buffer, sizeof(buffer))) > 0)
+        {
+            for (ssize_t i = 0; i < nread; i++, offset++)
+            {
+                if ((buffer[i] == '\n') && (prev_char == '\n'))
+                {
+                    committed_size = offset + 1;
+                }
+                prev_char = buffer[i];
+            }
+        }
+
+        /*
+         * Second pass - applying the committed records.
+         */
+        char line[MaxRecordLength];
+        unsigned line_length = 0;
+        offset = 0;
+        if ((nread == 0) && (::lseek(fd, 0, SEEK_SET) == 0))
+        {
+            while ((offset < committed_size) && ((nread = ::read(fd, buffer, sizeof(buffer))) > 0))
+            {
+                for (ssize_t i = 0; (i < nread) && (offset < committed_size); i++, offset++)
+                {
+                    if (buffer[i] == '\n')
+                    {
+                        applyLine(line, line_length);
+                        line_length = 0;
+                    }
+                    else if (line_length < MaxRecordLength)     // Overlong lines are rejected by applyLine()
+                    {
+                        line[line_length++] = buffer[i];
+                    }
+                    else
+                    {
+                        ;
+                    }
+                }
+            }
+        }
+
+        const int rv = (nread < 0) ? -errno : 0;
+        (void)::close(fd);
+        if (rv < 0)
+        {
+            num_pairs_ = 0;
+        }
+        return rv;
+    }
+
+    /**
+     * Rewrites the file with the cached data, then reopens it for appending.
+     */
+    int compact()
+    {
+        if (fd_ >= 0)
+        {
+            (void)::close(fd_);
+            fd_ = -1;
+        }
+
+        PathString tmp_path = path_;
+        tmp_path += ".tmp";
+
+        int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, FilePermissions);
+        if (fd < 0)
+        {
+            return -errno;
+        }
+
+        int rv = 0;
+        off_t size = 0;
+        for (unsigned i = 0; (i < num_pairs_) && (rv >= 0); i++)
+        {
+            char record[MaxRecordLength];
+            const unsigned len = formatRecord(pairs_[i].key, pairs_[i].value, record);
+            rv = writeAll(fd, record, len);
+            size += off_t(len);
+        }
+        if (rv >= 0)
+        {
+            rv = writeAll(fd, "\n", 1);
+            size += 1;
+        }
+        if ((rv >= 0) && (::fsync(fd) < 0))
+        {
+            rv = -errno;
+        }
+        (void)::close(fd);
+
+        if ((rv >= 0) && (::rename(tmp_path.c_str(), path_.c_str()) < 0))
+        {
+            rv = -errno;
+        }
+        if (rv < 0)
+        {
+            (void)::unlink(tmp_path.c_str());
+            return rv;
+        }
+
+        fd_ = ::open(path_.c_str(), O_WRONLY | O_APPEND);
+        if (fd_ < 0)
+        {
+            return -errno;
+        }
+        file_size_ = size;
+        return 0;
+    }
+
+    /**
+     * Appends the data to the file and synchronizes it.
+     * If that fails, the possibly incomplete tail of the file is dropped by reloading and compacting the file,
+     * so the uncommitted values are lost.
+     */
+    int appendAndSync(const char* data, unsigned size)
+    {
+        int rv = (fd_ < 0) ? -EBADF : writeAll(fd_, data, size);
+        if ((rv >= 0) && (::fsync(fd_) < 0))
+        {
+            rv = -errno;
+        }
+        if (rv < 0)
+        {
+            (void)load();
+            (void)compact();
+            return rv;
+        }
+
+        file_size_ += off_t(size);
+        if (file_size_ > off_t(MaxFileSize))
+        {
+            (void)compact();        // Failure is not fatal, the data are already stored
+        }
+        return 0;
+    }
+
+protected:
+    virtual String get(const String& key) const
+    {
+        for (unsigned i = 0; i < num_pairs_; i++)
+        {
+            if (pairs_[i].key == key)
+            {
+                return pairs_[i].value;
+            }
+        }
+        return String();
+    }
+
+    virtual void set(const String& key, const String& value)
+    {
+        applyRecord(key, value);
+
+        if (in_batch_)
+        {
+            if ((batch_length_ + MaxRecordLength) > BatchBufferSize)
+            {
+                // Written without the terminating empty line, so the batch remains incomplete until committed
+                if ((fd_ < 0) || (writeAll(fd_, batch_buffer_, batch_length_) < 0))
+                {
+                    batch_failed_ = true;
+                }
+                file_size_ += off_t(batch_length_);
+                batch_length_ = 0;
+            }
+            batch_length_ += formatRecord(key, value, &batch_buffer_[batch_length_]);
+        }
+        else
+        {
+            char record[MaxRecordLength + 1];
+            unsigned len = formatRecord(key, value, record);
+            record[len++] = '\n';
+            (void)appendAndSync(record, len);
+        }
+    }
+
+    virtual void beginBatch()
+    {
+        in_batch_ = true;
+        batch_failed_ = false;
+        batch_length_ = 0;
+    }
+
+    virtual int commitBatch()
+    {
+        in_batch_ = false;
+        batch_buffer_[batch_length_++] = '\n';
+        int rv = -EIO;
+        if (batch_failed_)
+        {
+            (void)load();           // Dropping the incomplete batch
+            (void)compact();
+        }
+        else
+        {
+            rv = appendAndSync(batch_buffer_, batch_length_);
+        }
+        batch_length_ = 0;
+        return rv;
+    }
+
+public:
+    LogStructuredStorageBackend()
+        : num_pairs_(0)
+        , fd_(-1)
+        , file_size_(0)
+        , batch_length_(0)
+        , in_batch_(false)
+        , batch_failed_(false)
+    { }
+
+    virtual ~LogStructuredStorageBackend()
+    {
+        if (fd_ >= 0)
+        {
+            (void)::close(fd_);
+        }
+    }
+
+    /**
+     * Initializes the backend by passing the path to the storage file; the file will be created if it doesn't exist.
+     * The return value should be 0 on success.
+     * If it is -ErrInvalidConfiguration then the path name is too long to accommodate the temporary file suffix.
+     * Otherwise a negative errno is returned.
+     */
+    int init(const PathString& path)
+    {
+        if (path.empty() || (path.back() == '/'))
+        {
+            return -uavcan::ErrInvalidParam;
+        }
+        if ((path.size() + 4) > MaxPathLength)
+        {
+            return -uavcan::ErrInvalidConfiguration;
+        }
+        path_ = path;
+
+        const int rv = load();
+        if (rv < 0)
+        {
+            return rv;
+        }
+        return compact();
+    }
+
+    /**
+     * Number of key/value pairs currently stored.
+     */
+    unsigned getNumKeys() const { return num_pairs_; }
+};
+}
+}
+
+#endif // Include guard
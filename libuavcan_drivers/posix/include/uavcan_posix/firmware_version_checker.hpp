@@ -13,8 +13,11 @@
 #include <cstdio>
 #include <cstring>
 #include <fcntl.h>
+#include <unistd.h>
 #include <cerrno>
+#include <ctime>
 #include <dirent.h>
+#include <sys/stat.h>
 
 #include <uavcan/protocol/firmware_update_trigger.hpp>
 
@@ -222,6 +225,157 @@ class FirmwareVersionChecker : public uavcan::IFirmwareVersionChecker
         return rv;
     }
 
+    /**
+     * Number of hardware version directories whose firmware images are remembered.
+     */
+    enum { ImageCacheSize = 4 };
+
+    /**
+     * Result of the scan of one hardware version directory. The entry remains valid as long as the mtime of the
+     * directory and the size and mtime of the cached copy of the image don't change, so that the decisions for
+     * the nodes that share the same hardware don't need to rescan the directory and reread the image.
+     */
+    struct ImageCacheEntry
+    {
+        BasePathString directory;           ///< Empty if the entry is not used
+        std::time_t directory_mtime;
+        FirmwareFilePath file_name;         ///< Empty if the directory doesn't contain a valid image
+        off_t image_size;
+        std::time_t image_mtime;
+        AppDescriptor descriptor;
+        uavcan::uint32_t last_use;
+
+        ImageCacheEntry()
+            : directory_mtime(0)
+            , image_size(0)
+            , image_mtime(0)
+            , last_use(0)
+        {
+            std::memset(&descriptor, 0, sizeof(descriptor));
+        }
+    };
+
+    ImageCacheEntry image_cache_[ImageCacheSize];
+    uavcan::uint32_t image_cache_use_counter_;
+
+    bool isCachedImageUnchanged(const ImageCacheEntry& entry) const
+    {
+        if (entry.file_name.empty())
+        {
+            return true;
+        }
+        PathString full_path = getFirmwareCachePath().c_str();
+        full_path += entry.file_name.c_str();
+
+        struct stat sb;
+        return (stat(full_path.c_str(), &sb) == 0) &&
+               (sb.st_size == entry.image_size) &&
+               (sb.st_mtime == entry.image_mtime);
+    }
+
+    /**
+     * Looks for the first valid image in the directory; copies it into the cache directory if it's not there yet.
+     */
+    void scanFirmwareDirectory(const char* directory, ImageCacheEntry& entry)
+    {
+        using namespace std;
+
+        entry.file_name.clear();
+
+        DIR* const fwdir = opendir(directory);
+        if (fwdir == NULL)
+        {
+            return;
+        }
+
+        struct dirent* pfile = NULL;
+        while ((pfile = readdir(fwdir)) != NULL)
+        {
+            if (DIRENT_ISFILE(pfile->d_type))
+            {
+                // Open any bin file in there.
+                if (strstr(pfile->d_name, ".bin") != NULL)
+                {
+                    PathString full_src_path = directory;
+                    full_src_path += pfile->d_name;
+
+                    PathString full_dst_path = getFirmwareCachePath().c_str();
+                    full_dst_path += pfile->d_name;
+
+                    // ease the burden on the user
+                    int cr = copyIfNot(full_src_path.c_str(), full_dst_path.c_str());
+
+                    // We have a file, is it a valid image
+                    AppDescriptor descriptor;
+
+                    std::memset(&descriptor, 0, sizeof(descriptor));
+
+                    struct stat sb;
+
+                    if (cr == 0 && getFileInfo(full_dst_path.c_str(), descriptor) == 0 &&
+                        stat(full_dst_path.c_str(), &sb) == 0)
+                    {
+                        volatile AppDescriptor descriptorC = descriptor;
+                        descriptorC.reserved[1]++;
+
+                        entry.file_name = pfile->d_name;
+                        entry.image_size = sb.st_size;
+                        entry.image_mtime = sb.st_mtime;
+                        entry.descriptor = descriptor;
+                        break;
+                    }
+                }
+            }
+        }
+        (void)closedir(fwdir);
+    }
+
+    /**
+     * Returns the scan result of the directory, rescanning it only if it has changed since the last scan.
+     * Returns NULL if the directory does not exist.
+     */
+    const ImageCacheEntry* findImage(const char* directory)
+    {
+        using namespace std;
+
+        struct stat sb;
+        if (stat(directory, &sb) != 0 || !S_ISDIR(sb.st_mode))
+        {
+            return NULL;
+        }
+
+        ImageCacheEntry* entry = NULL;
+        for (unsigned i = 0; i < ImageCacheSize; i++)
+        {
+            if (image_cache_[i].directory == directory)
+            {
+                entry = &image_cache_[i];
+                break;
+            }
+        }
+
+        if (entry == NULL || entry->directory_mtime != sb.st_mtime || !isCachedImageUnchanged(*entry))
+        {
+            if (entry == NULL)
+            {
+                entry = &image_cache_[0];               // Least recently used one is replaced
+                for (unsigned i = 1; i < ImageCacheSize; i++)
+                {
+                    if (image_cache_[i].last_use < entry->last_use)
+                    {
+                        entry = &image_cache_[i];
+                    }
+                }
+            }
+            entry->directory = directory;
+            entry->directory_mtime = sb.st_mtime;
+            scanFirmwareDirectory(directory, *entry);
+        }
+
+        entry->last_use = ++image_cache_use_counter_;
+        return entry;
+    }
+
 protected:
     /**
      * This method will be invoked when the class obtains a response to GetNodeInfo request.
@@ -269,53 +423,20 @@ protected:
 
         if (n > 0 && n < (int)sizeof(fname_root) - 2)
         {
-            DIR* const fwdir = opendir(fname_root);
-
             fname_root[n++] = getPathSeparator();
             fname_root[n++] = '\0';
 
-            if (fwdir != NULL)
+            const ImageCacheEntry* const image = findImage(fname_root);
+
+            if (image != NULL && !image->file_name.empty())
             {
-                struct dirent* pfile = NULL;
-                while ((pfile = readdir(fwdir)) != NULL)
+                if (node_info.software_version.image_crc == 0 ||
+                    (node_info.software_version.major == 0 && node_info.software_version.minor == 0) ||
+                    image->descriptor.image_crc != node_info.software_version.image_crc)
                 {
-                    if (DIRENT_ISFILE(pfile->d_type))
-                    {
-                        // Open any bin file in there.
-                        if (strstr(pfile->d_name, ".bin") != NULL)
-                        {
-                            PathString full_src_path = fname_root;
-                            full_src_path += pfile->d_name;
-
-                            PathString full_dst_path = getFirmwareCachePath().c_str();
-                            full_dst_path += pfile->d_name;
-
-                            // ease the burden on the user
-                            int cr = copyIfNot(full_src_path.c_str(), full_dst_path.c_str());
-
-                            // We have a file, is it a valid image
-                            AppDescriptor descriptor;
-
-                            std::memset(&descriptor, 0, sizeof(descriptor));
-
-                            if (cr == 0 && getFileInfo(full_dst_path.c_str(), descriptor) == 0)
-                            {
-                                volatile AppDescriptor descriptorC = descriptor;
-                                descriptorC.reserved[1]++;
-
-                                if (node_info.software_version.image_crc == 0 ||
-                                    (node_info.software_version.major == 0 && node_info.software_version.minor == 0) ||
-                                    descriptor.image_crc != node_info.software_version.image_crc)
-                                {
-                                    rv = true;
-                                    out_firmware_file_path = pfile->d_name;
-                                }
-                                break;
-                            }
-                        }
-                    }
+                    rv = true;
+                    out_firmware_file_path = image->file_name;
                 }
-                (void)closedir(fwdir);
             }
         }
         return rv;
@@ -349,6 +470,22 @@ protected:
     }
 
 public:
+    FirmwareVersionChecker()
+        : image_cache_use_counter_(0)
+    { }
+
+    /**
+     * Forgets the results of the previous scans of the firmware directories.
+     * This is not normally needed, because the changes to the directories are detected automatically.
+     */
+    void resetImageCache()
+    {
+        for (unsigned i = 0; i < ImageCacheSize; i++)
+        {
+            image_cache_[i] = ImageCacheEntry();
+        }
+    }
+
     const BasePathString& getFirmwareBasePath() const { return base_path_; }
 
     const BasePathString& getFirmwareCachePath() const { return cache_path_; }
@@ -375,6 +512,8 @@ public:
 
         if (base_path)
         {
+            resetImageCache();
+
             const int len = strlen(base_path);
 
             if (len > 0 && len < base_path_.MaxSize)
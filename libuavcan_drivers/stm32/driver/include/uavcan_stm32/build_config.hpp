@@ -38,3 +38,22 @@
 // In this case the clock driver should be implemented by the application
 # define UAVCAN_STM32_TIMER_NUMBER 0
 #endif
+
+/**
+ * Tickless idle integration, see uavcan_stm32::getIdleWakeupDeadline().
+ * When enabled, the thread that runs the node blocks in the driver until the next library deadline or CAN event
+ * on all platforms, instead of polling; on bare metal the MCU sleeps via UAVCAN_STM32_BAREMETAL_IDLE().
+ * Use it together with uavcan::Scheduler::SpinModeTickless, otherwise the library wakes up periodically anyway.
+ */
+#ifndef UAVCAN_STM32_TICKLESS_IDLE
+# define UAVCAN_STM32_TICKLESS_IDLE 0
+#endif
+
+/**
+ * Capacity of the driver-side TX queue of each interface, in frames; see uavcan_stm32::CanIface.
+ * The TX interrupt reloads the free mailboxes from this queue, so the transmission continues between the spins of
+ * the library. Each frame takes 32 bytes of RAM. Valid range is [1, 255].
+ */
+#ifndef UAVCAN_STM32_TX_QUEUE_CAPACITY
+# define UAVCAN_STM32_TX_QUEUE_CAPACITY 8
+#endif
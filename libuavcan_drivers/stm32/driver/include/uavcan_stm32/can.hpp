@@ -23,6 +23,7 @@ static const uavcan::int16_t ErrUnsupportedFrame        = 1004; ///< Frame not s
 static const uavcan::int16_t ErrMsrInakNotSet           = 1005; ///< INAK bit of the MSR register is not 1
 static const uavcan::int16_t ErrMsrInakNotCleared       = 1006; ///< INAK bit of the MSR register is not 0
 static const uavcan::int16_t ErrBitRateNotDetected      = 1007; ///< Auto bit rate detection could not be finished
+static const uavcan::int16_t ErrFilterNumConfigs        = 1008; ///< Filter configs don't fit into the filter banks
 
 /**
  * RX queue item.
@@ -45,35 +46,86 @@ struct CanRxItem
  */
 class CanIface : public uavcan::ICanIface, uavcan::Noncopyable
 {
+    /**
+     * Single producer single consumer lock-free ring buffer.
+     * The producers are the RX and TX interrupt handlers; they share the same priority, so they never preempt
+     * each other. The consumer is the thread that calls receive() or receiveBatch(). Neither side disables interrupts.
+     *
+     * The RX interrupt handler decodes the hardware mailbox directly into the queue slot, and the consumer copies
+     * the slots directly into the frame array of the library, so a frame is copied only once on its way from the
+     * mailbox to the library.
+     *
+     * The indices run modulo twice the capacity, so that a full queue can be distinguished from an empty one
+     * without sacrificing a slot; each of them is written by one side only.
+     * If the queue is full, the new frame is dropped and the overflow is registered.
+     */
     class RxQueue
     {
         CanRxItem* const buf_;
-        const uavcan::uint8_t capacity_;
-        uavcan::uint8_t in_;
-        uavcan::uint8_t out_;
-        uavcan::uint8_t len_;
-        uavcan::uint32_t overflow_cnt_;
+        const uavcan::uint16_t capacity_;
+        volatile uavcan::uint32_t in_;          ///< Written by the producer only
+        volatile uavcan::uint32_t out_;         ///< Written by the consumer only
+        volatile uavcan::uint32_t overflow_cnt_;
+        volatile uavcan::uint16_t high_water_mark_;
+
+        uavcan::uint32_t getNextIndex(uavcan::uint32_t index) const
+        {
+            return ((index + 1U) < (2U * capacity_)) ? (index + 1U) : 0U;
+        }
+
+        CanRxItem& getItem(uavcan::uint32_t index) const
+        {
+            return buf_[(index < capacity_) ? index : (index - capacity_)];
+        }
 
-        void registerOverflow();
+        uavcan::uint32_t computeLength(uavcan::uint32_t in, uavcan::uint32_t out) const
+        {
+            return (in >= out) ? (in - out) : (in + 2U * capacity_ - out);
+        }
 
     public:
-        RxQueue(CanRxItem* buf, uavcan::uint8_t capacity)
+        RxQueue(CanRxItem* buf, uavcan::uint16_t capacity)
             : buf_(buf)
             , capacity_(capacity)
             , in_(0)
             , out_(0)
-            , len_(0)
             , overflow_cnt_(0)
+            , high_water_mark_(0)
         { }
 
+        /**
+         * Producer side.
+         * beginPush() returns the slot to be filled, or NULL if the queue is full, in which case the overflow is
+         * registered. The filled slot becomes visible to the consumer once commitPush() is called.
+         */
+        CanRxItem* beginPush();
+        void commitPush();
+
         void push(const uavcan::CanFrame& frame, const uint64_t& utc_usec, uavcan::CanIOFlags flags);
-        void pop(uavcan::CanFrame& out_frame, uavcan::uint64_t& out_utc_usec, uavcan::CanIOFlags& out_flags);
 
+        /**
+         * Consumer side. Returns false if the queue is empty.
+         */
+        bool pop(uavcan::CanFrame& out_frame, uavcan::uint64_t& out_utc_usec, uavcan::CanIOFlags& out_flags);
+
+        /**
+         * Consumer side. Moves up to max_frames frames into the output arrays, assigning the specified monotonic
+         * timestamp to all of them; the slots are released to the producer at once.
+         * Returns the number of frames moved, zero if the queue is empty.
+         */
+        unsigned popBatch(uavcan::CanRxFrame* out_frames, uavcan::CanIOFlags* out_flags, unsigned max_frames,
+                          uavcan::MonotonicTime ts_mono);
+
+        /**
+         * Neither side may access the queue concurrently, e.g. interrupts must be disabled.
+         */
         void reset();
 
-        unsigned getLength() const { return len_; }
+        unsigned getLength() const { return computeLength(in_, out_); }
 
         uavcan::uint32_t getOverflowCount() const { return overflow_cnt_; }
+
+        unsigned getHighWaterMark() const { return high_water_mark_; }
     };
 
     struct Timings
@@ -91,6 +143,9 @@ class CanIface : public uavcan::ICanIface, uavcan::Noncopyable
         { }
     };
 
+    /**
+     * Mailbox or driver-side TX queue item.
+     */
     struct TxItem
     {
         uavcan::MonotonicTime deadline;
@@ -98,16 +153,40 @@ class CanIface : public uavcan::ICanIface, uavcan::Noncopyable
         bool pending;
         bool loopback;
         bool abort_on_error;
+        bool requeue_on_abort;      ///< Aborted to make room for a higher priority frame, see preemptTxMailbox()
 
         TxItem()
             : pending(false)
             , loopback(false)
             , abort_on_error(false)
+            , requeue_on_abort(false)
         { }
     };
 
     enum { NumTxMailboxes = 3 };
     enum { NumFilters = 14 };
+    enum { TxQueueCapacity = UAVCAN_STM32_TX_QUEUE_CAPACITY };
+
+    /**
+     * Contents of the filter banks of one iface, see configureFilters().
+     * Bit N of the bit masks refers to the bank N of the iface, the same way as in the FM1R, FS1R and FFA1R.
+     */
+    struct FilterBankImage
+    {
+        uavcan::uint32_t fr1[NumFilters];
+        uavcan::uint32_t fr2[NumFilters];
+        uavcan::uint32_t list_mode_banks;
+        uavcan::uint32_t scale_32_banks;
+        uavcan::uint32_t fifo1_banks;
+        uavcan::uint8_t num_banks;
+
+        FilterBankImage()
+            : list_mode_banks(0)
+            , scale_32_banks(0)
+            , fifo1_banks(0)
+            , num_banks(0)
+        { }
+    };
 
     static const uavcan::uint32_t TSR_ABRQx[NumTxMailboxes];
 
@@ -117,29 +196,59 @@ class CanIface : public uavcan::ICanIface, uavcan::Noncopyable
     uavcan::uint32_t served_aborts_cnt_;
     BusEvent& update_event_;
     TxItem pending_tx_[NumTxMailboxes];
+    TxItem tx_queue_[TxQueueCapacity];          ///< Ordered by priority, FIFO for equal priority; see send()
+    uavcan::uint8_t tx_queue_len_;
+    uavcan::uint8_t tx_queue_high_water_mark_;
+    uavcan::uint32_t tx_preemption_cnt_;
     uavcan::uint8_t peak_tx_mailbox_index_;
     const uavcan::uint8_t self_index_;
     bool had_activity_;
 
     int computeTimings(uavcan::uint32_t target_bitrate, Timings& out_timings);
 
+    static int computeFilterBankImage(const uavcan::CanFilterConfig* filter_configs, uavcan::uint16_t num_configs,
+                                      bool split_fifos, FilterBankImage& out_image);
+
     virtual uavcan::int16_t send(const uavcan::CanFrame& frame, uavcan::MonotonicTime tx_deadline,
                                  uavcan::CanIOFlags flags);
 
     virtual uavcan::int16_t receive(uavcan::CanFrame& out_frame, uavcan::MonotonicTime& out_ts_monotonic,
                                     uavcan::UtcTime& out_ts_utc, uavcan::CanIOFlags& out_flags);
 
+    virtual uavcan::int16_t receiveBatch(uavcan::CanRxFrame* out_frames, uavcan::CanIOFlags* out_flags,
+                                         uavcan::uint16_t max_frames);
+
     virtual uavcan::int16_t configureFilters(const uavcan::CanFilterConfig* filter_configs,
                                              uavcan::uint16_t num_configs);
 
     virtual uavcan::uint16_t getNumFilters() const { return NumFilters; }
 
+    virtual uavcan::uint16_t getNumFiltersRequired(const uavcan::CanFilterConfig* filter_configs,
+                                                   uavcan::uint16_t num_configs) const;
+
+    virtual uavcan::uint16_t getNumFreeTxSlots() const;
+
     void handleTxMailboxInterrupt(uavcan::uint8_t mailbox_index, bool txok, uavcan::uint64_t utc_usec);
 
+    /**
+     * These methods require a critical section.
+     * @{
+     */
+    int findFreeTxMailbox() const;
+    void loadTxMailbox(uavcan::uint8_t mailbox_index, const TxItem& item);
+    bool isHigherThanAllTxMailboxes(const uavcan::CanFrame& frame) const;
+    bool hasTxMailboxWithId(uavcan::uint32_t can_id) const;
+    unsigned computeNumFreeTxQueueSlots() const;
+    void pushTxQueue(const TxItem& item, bool ahead_of_equal_priority);
+    void refillTxMailboxes();
+    /**
+     * @}
+     */
+
     bool waitMsrINakBitStateChange(bool target_state);
 
 public:
-    enum { MaxRxQueueCapacity = 254 };
+    enum { MaxRxQueueCapacity = 65535 };
 
     enum OperatingMode
     {
@@ -148,17 +257,21 @@ public:
     };
 
     CanIface(bxcan::CanType* can, BusEvent& update_event, uavcan::uint8_t self_index,
-             CanRxItem* rx_queue_buffer, uavcan::uint8_t rx_queue_capacity)
+             CanRxItem* rx_queue_buffer, uavcan::uint16_t rx_queue_capacity)
         : rx_queue_(rx_queue_buffer, rx_queue_capacity)
         , can_(can)
         , error_cnt_(0)
         , served_aborts_cnt_(0)
         , update_event_(update_event)
+        , tx_queue_len_(0)
+        , tx_queue_high_water_mark_(0)
+        , tx_preemption_cnt_(0)
         , peak_tx_mailbox_index_(0)
         , self_index_(self_index)
         , had_activity_(false)
     {
         UAVCAN_ASSERT(self_index_ < UAVCAN_STM32_NUM_IFACES);
+        uavcan::StaticAssert<(TxQueueCapacity >= 1) && (TxQueueCapacity <= 255)>::check();
     }
 
     /**
@@ -184,6 +297,21 @@ public:
 
     void discardTimedOutTxMailboxes(uavcan::MonotonicTime current_time);
 
+    /**
+     * Priority inversion avoidance.
+     * The hardware transmits the mailboxes in the order of their CAN ID priority, but a frame can be loaded into a
+     * mailbox only if it is free. If all mailboxes are occupied by frames of lower priority than the next frame
+     * waiting to be transmitted, either in the driver TX queue or in the library (e.g. because the mailboxes are
+     * losing arbitration), the lowest priority mailbox is aborted. Once the abort is complete, the aborted frame is
+     * put back into the driver TX queue with its deadline and flags, ahead of the frames of the same priority; one
+     * slot of the queue is reserved for it while the abort is in progress.
+     * If the aborted frame has started transmission before the abort request, it is transmitted successfully
+     * and not requeued.
+     *
+     * Should be called from select() with the top priority frame of the library (may be null).
+     */
+    void serveTxPreemption(const uavcan::CanFrame* pending_tx);
+
     bool canAcceptNewTxFrame(const uavcan::CanFrame& frame) const;
     bool isRxBufferEmpty() const;
 
@@ -200,12 +328,31 @@ public:
      */
     uavcan::uint32_t getVoluntaryTxAbortCount() const { return served_aborts_cnt_; }
 
+    /**
+     * Number of frames that were aborted in order to make room for a higher priority frame, and requeued.
+     * This is an atomic read, it doesn't require a critical section.
+     * See @ref serveTxPreemption().
+     */
+    uavcan::uint32_t getTxPreemptionCount() const { return tx_preemption_cnt_; }
+
+    /**
+     * Maximum number of frames that were pending in the driver TX queue at once since initialization.
+     * If it reaches the capacity of the queue, the library had to keep the rest; see UAVCAN_STM32_TX_QUEUE_CAPACITY.
+     */
+    unsigned getTxQueueHighWaterMark() const { return tx_queue_high_water_mark_; }
+
     /**
      * Returns number of frames pending in the RX queue.
      * This is intended for debug use only.
      */
     unsigned getRxQueueLength() const;
 
+    /**
+     * Maximum number of frames that were pending in the RX queue at once since initialization.
+     * If it reaches the capacity of the queue, the frames are being lost; see @ref getErrorCount().
+     */
+    unsigned getRxQueueHighWaterMark() const;
+
     /**
      * Whether this iface had at least one successful IO since previous call of this method.
      * This is designed for use with iface activity LEDs.
@@ -215,7 +362,7 @@ public:
     /**
      * Peak number of TX mailboxes used concurrently since initialization.
      * Range is [1, 3].
-     * Value of 3 suggests that priority inversion could be taking place.
+     * Value of 3 suggests that priority inversion could be taking place; see @ref getTxPreemptionCount().
      */
     uavcan::uint8_t getPeakNumTxMailboxesUsed() const { return uavcan::uint8_t(peak_tx_mailbox_index_ + 1); }
 };
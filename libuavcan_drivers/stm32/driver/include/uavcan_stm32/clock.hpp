@@ -6,6 +6,7 @@
 
 #include <uavcan_stm32/build_config.hpp>
 #include <uavcan/driver/system_clock.hpp>
+#include <uavcan/driver/cycle_counter.hpp>
 
 namespace uavcan_stm32
 {
@@ -118,4 +119,21 @@ public:
     static SystemClock& instance();
 };
 
+#if defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__)
+/**
+ * Adapter for uavcan::ICycleCounter based on the DWT cycle counter, which runs at the core clock rate.
+ * Available on ARMv7-M cores (Cortex-M3/M4/M7) only.
+ */
+class CycleCounter : public uavcan::ICycleCounter, uavcan::Noncopyable
+{
+public:
+    /**
+     * Enables the DWT cycle counter; it's not reset, so this doesn't disturb other users, e.g. a debugger.
+     */
+    CycleCounter();
+
+    virtual uavcan::uint32_t getCycleCount() const;
+};
+#endif
+
 }
@@ -12,6 +12,7 @@
 # include <nuttx/config.h>
 # include <nuttx/fs/fs.h>
 # include <poll.h>
+# include <semaphore.h>
 # include <errno.h>
 # include <cstdio>
 # include <ctime>
@@ -72,6 +73,9 @@ class BusEvent : uavcan::Noncopyable
     ::pollfd* pollset_[MaxPollWaiters];
     CanDriver& can_driver_;
     bool signal_;
+#if UAVCAN_STM32_TICKLESS_IDLE
+    ::sem_t sem_;           ///< Posted from the interrupt handler, so the waiting thread doesn't need to poll
+#endif
 
     static int openTrampoline(::file* filp);
     static int closeTrampoline(::file* filp);
@@ -138,12 +142,19 @@ public:
         (void)can_driver;
     }
 
+#if UAVCAN_STM32_TICKLESS_IDLE
+    /**
+     * Sleeps until the event is signalled or the duration expires.
+     */
+    bool wait(uavcan::MonotonicDuration duration);
+#else
     bool wait(uavcan::MonotonicDuration duration)
     {
         (void)duration;
         bool lready = ready;
         return __atomic_exchange_n (&lready, false, __ATOMIC_SEQ_CST);
     }
+#endif
 
     void signal()
     {
@@ -202,6 +213,19 @@ public:
 #endif
 
 
+#if UAVCAN_STM32_TICKLESS_IDLE
+/**
+ * Tickless idle integration, see UAVCAN_STM32_TICKLESS_IDLE.
+ * Returns the monotonic time when the thread that is blocked in the CAN driver (i.e. in uavcan::Node::spin()) must
+ * be woken up, which is the next deadline of the library if the tickless spin mode is used.
+ * Returns zero if no thread is blocked in the driver, i.e. the MCU must not sleep longer than the RTOS allows.
+ * This is intended for the RTOS idle hook, e.g. to choose the sleep depth; CAN and timer interrupts wake up the MCU
+ * regardless. Note that the timer of the clock driver overflows every 65.536 ms, so the MCU never sleeps longer.
+ * This function can be called from any context except interrupts.
+ */
+uavcan::MonotonicTime getIdleWakeupDeadline();
+#endif
+
 class MutexLocker
 {
     Mutex& mutex_;
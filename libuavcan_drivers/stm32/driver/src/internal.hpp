@@ -74,6 +74,16 @@
 # endif
 #endif
 
+#if UAVCAN_STM32_BAREMETAL
+/**
+ * Enters the sleep mode until the next interrupt; used only with UAVCAN_STM32_TICKLESS_IDLE.
+ * The application may redefine it, e.g. to select a deeper sleep mode.
+ */
+# ifndef UAVCAN_STM32_BAREMETAL_IDLE
+#  define UAVCAN_STM32_BAREMETAL_IDLE()   __WFI()
+# endif
+#endif
+
 #if UAVCAN_STM32_FREERTOS
 /**
  * Priority mask for timer and CAN interrupts.
@@ -152,6 +162,15 @@ struct CriticalSectionLocker
 
 #endif
 
+/**
+ * Orders the memory accesses of the lock-free structures that are shared between ISRs and threads.
+ * Also prevents the compiler from reordering the accesses.
+ */
+inline void memoryBarrier()
+{
+    __asm volatile ("dmb" ::: "memory");
+}
+
 namespace clock
 {
 uavcan::uint64_t getUtcUSecFromCanInterrupt();
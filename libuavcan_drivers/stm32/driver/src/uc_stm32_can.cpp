@@ -119,65 +119,193 @@ inline void handleRxInterrupt(uavcan::uint8_t iface_index, uavcan::uint8_t fifo_
     }
 }
 
+/**
+ * Filter bank modes; one bank holds several filter entries of the same kind.
+ */
+enum FilterEntryKind
+{
+    FilterEntryStdList,         ///< 16-bit scale, identifier list mode
+    FilterEntryStdMask,         ///< 16-bit scale, identifier mask mode
+    FilterEntryExtList,         ///< 32-bit scale, identifier list mode
+    FilterEntryExtMask,         ///< 32-bit scale, identifier mask mode
+    NumFilterEntryKinds
+};
+
+const unsigned FilterEntriesPerBank[NumFilterEntryKinds] = { 4, 2, 2, 1 };
+
+/**
+ * Converts the filter config into the register format of the bank mode it needs; the bank is viewed as one
+ * 64-bit value (FR2:FR1), and the entry is returned in its lower bits.
+ * Exact IDs go into the list mode banks, so that 2 extended or 4 standard IDs take one bank.
+ */
+FilterEntryKind makeFilterEntry(const uavcan::CanFilterConfig& cfg, uavcan::uint64_t& out_entry)
+{
+    using uavcan::CanFrame;
+
+    const bool rtr_matters = (cfg.mask & CanFrame::FlagRTR) != 0;
+    const bool rtr = rtr_matters && ((cfg.id & CanFrame::FlagRTR) != 0);
+
+    if ((cfg.mask & CanFrame::FlagEFF) == 0)
+    {
+        // One bank can't match the same ID bits of both frame formats, so it accepts everything
+        out_entry = 0;
+        return FilterEntryExtMask;
+    }
+
+    if ((cfg.id & CanFrame::FlagEFF) != 0)
+    {
+        // STID[31:21] EXID[20:3] IDE[2] RTR[1]
+        const uavcan::uint32_t id = ((cfg.id & CanFrame::MaskExtID) << 3) | bxcan::RIR_IDE | (rtr ? bxcan::RIR_RTR : 0);
+        if ((cfg.mask & (CanFrame::MaskExtID | CanFrame::FlagRTR)) == (CanFrame::MaskExtID | CanFrame::FlagRTR))
+        {
+            out_entry = id;
+            return FilterEntryExtList;
+        }
+        const uavcan::uint32_t mask =
+            ((cfg.mask & CanFrame::MaskExtID) << 3) | bxcan::RIR_IDE | (rtr_matters ? bxcan::RIR_RTR : 0);
+        out_entry = (uavcan::uint64_t(mask) << 32) | id;
+        return FilterEntryExtMask;
+    }
+
+    // STID[15:5] RTR[4] IDE[3] EXID[2:0]
+    const uavcan::uint32_t id = ((cfg.id & CanFrame::MaskStdID) << 5) | (rtr ? 0x10U : 0);
+    if ((cfg.mask & (CanFrame::MaskStdID | CanFrame::FlagRTR)) == (CanFrame::MaskStdID | CanFrame::FlagRTR))
+    {
+        out_entry = id;
+        return FilterEntryStdList;
+    }
+    const uavcan::uint32_t mask = ((cfg.mask & CanFrame::MaskStdID) << 5) | (rtr_matters ? 0x10U : 0) | 0x08U;
+    out_entry = (mask << 16) | id;
+    return FilterEntryStdMask;
+}
+
+/**
+ * The lowest CAN ID accepted by the config, arranged so that a lower value means higher priority on the bus.
+ */
+uavcan::uint32_t getFilterPriorityKey(const uavcan::CanFilterConfig& cfg)
+{
+    using uavcan::CanFrame;
+    const uavcan::uint32_t lowest_id = cfg.id & cfg.mask;
+    return ((lowest_id & CanFrame::FlagEFF) != 0) ? (lowest_id & CanFrame::MaskExtID) :
+           ((lowest_id & CanFrame::MaskStdID) << 18);
+}
+
+/**
+ * Whether the config is in the higher priority half of all configs; equal keys are ordered by index.
+ */
+bool isInHigherPriorityHalf(const uavcan::CanFilterConfig* filter_configs, uavcan::uint16_t num_configs,
+                            unsigned index)
+{
+    const uavcan::uint32_t key = getFilterPriorityKey(filter_configs[index]);
+    unsigned num_higher = 0;
+    for (unsigned i = 0; i < num_configs; i++)
+    {
+        const uavcan::uint32_t other_key = getFilterPriorityKey(filter_configs[i]);
+        if ((other_key < key) || ((other_key == key) && (i < index)))
+        {
+            num_higher++;
+        }
+    }
+    return num_higher < (num_configs / 2U);
+}
+
 } // namespace
 
 /*
  * CanIface::RxQueue
  */
-void CanIface::RxQueue::registerOverflow()
+CanRxItem* CanIface::RxQueue::beginPush()
 {
-    if (overflow_cnt_ < 0xFFFFFFFF)
+    if (computeLength(in_, out_) >= capacity_)
     {
-        overflow_cnt_++;
+        if (overflow_cnt_ < 0xFFFFFFFF)
+        {
+            overflow_cnt_ = overflow_cnt_ + 1;
+        }
+        return NULL;
+    }
+    return &getItem(in_);
+}
+
+void CanIface::RxQueue::commitPush()
+{
+    const uavcan::uint32_t in = in_;
+    const uavcan::uint32_t len = computeLength(in, out_);
+
+    memoryBarrier();        // The item must be complete before it becomes visible to the consumer
+    in_ = getNextIndex(in);
+
+    if ((len + 1) > high_water_mark_)
+    {
+        high_water_mark_ = uavcan::uint16_t(len + 1);
     }
 }
 
 void CanIface::RxQueue::push(const uavcan::CanFrame& frame, const uint64_t& utc_usec, uavcan::CanIOFlags flags)
 {
-    buf_[in_].frame    = frame;
-    buf_[in_].utc_usec = utc_usec;
-    buf_[in_].flags    = flags;
-    in_++;
-    if (in_ >= capacity_)
+    CanRxItem* const item = beginPush();
+    if (item != NULL)
     {
-        in_ = 0;
+        item->frame    = frame;
+        item->utc_usec = utc_usec;
+        item->flags    = flags;
+        commitPush();
     }
-    len_++;
-    if (len_ > capacity_)
+}
+
+bool CanIface::RxQueue::pop(uavcan::CanFrame& out_frame, uavcan::uint64_t& out_utc_usec, uavcan::CanIOFlags& out_flags)
+{
+    const uavcan::uint32_t out = out_;
+    if (in_ == out)
     {
-        len_ = capacity_;
-        registerOverflow();
-        out_++;
-        if (out_ >= capacity_)
-        {
-            out_ = 0;
-        }
+        return false;
     }
+    memoryBarrier();        // The item must not be read before the index
+
+    const CanRxItem& item = getItem(out);
+    out_frame    = item.frame;
+    out_utc_usec = item.utc_usec;
+    out_flags    = item.flags;
+
+    memoryBarrier();        // The item must be read before the slot is released to the producer
+    out_ = getNextIndex(out);
+    return true;
 }
 
-void CanIface::RxQueue::pop(uavcan::CanFrame& out_frame, uavcan::uint64_t& out_utc_usec, uavcan::CanIOFlags& out_flags)
+unsigned CanIface::RxQueue::popBatch(uavcan::CanRxFrame* out_frames, uavcan::CanIOFlags* out_flags,
+                                     unsigned max_frames, uavcan::MonotonicTime ts_mono)
 {
-    if (len_ > 0)
+    uavcan::uint32_t out = out_;
+    const uavcan::uint32_t len = computeLength(in_, out);
+    const unsigned num_frames = (len < max_frames) ? unsigned(len) : max_frames;
+    if (num_frames == 0)
     {
-        out_frame    = buf_[out_].frame;
-        out_utc_usec = buf_[out_].utc_usec;
-        out_flags    = buf_[out_].flags;
-        out_++;
-        if (out_ >= capacity_)
-        {
-            out_ = 0;
-        }
-        len_--;
+        return 0;
+    }
+    memoryBarrier();        // The items must not be read before the index
+
+    for (unsigned i = 0; i < num_frames; i++)
+    {
+        const CanRxItem& item = getItem(out);
+        uavcan::CanRxFrame& frame = out_frames[i];
+        static_cast<uavcan::CanFrame&>(frame) = item.frame;
+        frame.ts_mono = ts_mono;
+        frame.ts_utc  = uavcan::UtcTime::fromUSec(item.utc_usec);
+        out_flags[i]  = item.flags;
+        out = getNextIndex(out);
     }
-    else { UAVCAN_ASSERT(0); }
+
+    memoryBarrier();        // The items must be read before the slots are released to the producer
+    out_ = out;
+    return num_frames;
 }
 
 void CanIface::RxQueue::reset()
 {
     in_ = 0;
     out_ = 0;
-    len_ = 0;
     overflow_cnt_ = 0;
+    high_water_mark_ = 0;
 }
 
 /*
@@ -348,49 +476,65 @@ uavcan::int16_t CanIface::send(const uavcan::CanFrame& frame, uavcan::MonotonicT
     }
 
     /*
-     * Normally we should perform the same check as in @ref canAcceptNewTxFrame(), because
-     * it is possible that the highest-priority frame between select() and send() could have been
-     * replaced with a lower priority one due to TX timeout. But we don't do this check because:
-     *
-     *  - It is a highly unlikely scenario.
-     *
-     *  - Frames do not timeout on a properly functioning bus. Since frames do not timeout, the new
-     *    frame can only have higher priority, which doesn't break the logic.
-     *
-     *  - If high-priority frames are timing out in the TX queue, there's probably a lot of other
-     *    issues to take care of before this one becomes relevant.
-     *
-     *  - It takes CPU time. Not just CPU time, but critical section time, which is expensive.
+     * The frame is put into the driver TX queue, which keeps the frames in the order of priority, so the library
+     * can hand off any number of frames in any order as long as there's room; see getNumFreeTxSlots().
+     * The free mailboxes are reloaded from the queue right away, and then from the TX interrupt as the mailboxes
+     * are released, so the transmission doesn't depend on how often the library calls select().
      */
     CriticalSectionLocker lock;
 
+    if (computeNumFreeTxQueueSlots() == 0)
+    {
+        return 0;       // No transmission for you.
+    }
+
     /*
-     * Seeking for an empty slot
+     * Registering the pending transmission so we can track its deadline and loopback it as needed
      */
-    uavcan::uint8_t txmailbox = 0xFF;
+    TxItem txi;
+    txi.deadline       = tx_deadline;
+    txi.frame          = frame;
+    txi.loopback       = (flags & uavcan::CanIOFlagLoopback) != 0;
+    txi.abort_on_error = (flags & uavcan::CanIOFlagAbortOnError) != 0;
+    pushTxQueue(txi, false);
+    refillTxMailboxes();
+    return 1;
+}
+
+uavcan::uint16_t CanIface::getNumFreeTxSlots() const
+{
+    CriticalSectionLocker lock;
+    return uavcan::uint16_t(computeNumFreeTxQueueSlots());
+}
+
+int CanIface::findFreeTxMailbox() const
+{
     if ((can_->TSR & bxcan::TSR_TME0) == bxcan::TSR_TME0)
     {
-        txmailbox = 0;
-    }
-    else if ((can_->TSR & bxcan::TSR_TME1) == bxcan::TSR_TME1)
-    {
-        txmailbox = 1;
+        return 0;
     }
-    else if ((can_->TSR & bxcan::TSR_TME2) == bxcan::TSR_TME2)
+    if ((can_->TSR & bxcan::TSR_TME1) == bxcan::TSR_TME1)
     {
-        txmailbox = 2;
+        return 1;
     }
-    else
+    if ((can_->TSR & bxcan::TSR_TME2) == bxcan::TSR_TME2)
     {
-        return 0;       // No transmission for you.
+        return 2;
     }
+    return -1;
+}
 
-    peak_tx_mailbox_index_ = uavcan::max(peak_tx_mailbox_index_, txmailbox);    // Statistics
+void CanIface::loadTxMailbox(uavcan::uint8_t mailbox_index, const TxItem& item)
+{
+    UAVCAN_ASSERT(mailbox_index < NumTxMailboxes);
+
+    peak_tx_mailbox_index_ = uavcan::max(peak_tx_mailbox_index_, mailbox_index);    // Statistics
 
     /*
      * Setting up the mailbox
      */
-    bxcan::TxMailboxType& mb = can_->TxMailbox[txmailbox];
+    const uavcan::CanFrame& frame = item.frame;
+    bxcan::TxMailboxType& mb = can_->TxMailbox[mailbox_index];
     if (frame.isExtended())
     {
         mb.TIR = ((frame.id & uavcan::CanFrame::MaskExtID) << 3) | bxcan::TIR_IDE;
@@ -416,18 +560,108 @@ uavcan::int16_t CanIface::send(const uavcan::CanFrame& frame, uavcan::MonotonicT
               (uavcan::uint32_t(frame.data[1]) << 8)  |
               (uavcan::uint32_t(frame.data[0]) << 0);
 
+    TxItem& txi = pending_tx_[mailbox_index];
+    txi = item;
+    txi.pending = true;
+    txi.requeue_on_abort = false;
+
     mb.TIR |= bxcan::TIR_TXRQ;  // Go.
+}
+
+bool CanIface::isHigherThanAllTxMailboxes(const uavcan::CanFrame& frame) const
+{
+    for (int i = 0; i < NumTxMailboxes; i++)
+    {
+        if (pending_tx_[i].pending && !frame.priorityHigherThan(pending_tx_[i].frame))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool CanIface::hasTxMailboxWithId(uavcan::uint32_t can_id) const
+{
+    for (int i = 0; i < NumTxMailboxes; i++)
+    {
+        if (pending_tx_[i].pending && (pending_tx_[i].frame.id == can_id))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+unsigned CanIface::computeNumFreeTxQueueSlots() const
+{
+    // One slot is reserved for each frame being aborted by serveTxPreemption(), so that it can always be requeued
+    unsigned num_reserved = tx_queue_len_;
+    for (int i = 0; i < NumTxMailboxes; i++)
+    {
+        if (pending_tx_[i].pending && pending_tx_[i].requeue_on_abort)
+        {
+            num_reserved++;
+        }
+    }
+    return (num_reserved < unsigned(TxQueueCapacity)) ? (unsigned(TxQueueCapacity) - num_reserved) : 0U;
+}
+
+void CanIface::pushTxQueue(const TxItem& item, bool ahead_of_equal_priority)
+{
+    UAVCAN_ASSERT(tx_queue_len_ < TxQueueCapacity);
 
     /*
-     * Registering the pending transmission so we can track its deadline and loopback it as needed
+     * Insertion sort from the tail; the queue is never long. The frames with the same CAN ID must be transmitted
+     * in the order they were sent by the library, so the new frames go after the frames of the same priority.
+     * The requeued frames go before them instead, since they were sent by the library earlier.
      */
-    TxItem& txi = pending_tx_[txmailbox];
-    txi.deadline       = tx_deadline;
-    txi.frame          = frame;
-    txi.loopback       = (flags & uavcan::CanIOFlagLoopback) != 0;
-    txi.abort_on_error = (flags & uavcan::CanIOFlagAbortOnError) != 0;
-    txi.pending        = true;
-    return 1;
+    unsigned pos = tx_queue_len_;
+    while (pos > 0)
+    {
+        const uavcan::CanFrame& prev = tx_queue_[pos - 1].frame;
+        const bool after_prev = ahead_of_equal_priority ? prev.priorityHigherThan(item.frame) :
+                                                          !item.frame.priorityHigherThan(prev);
+        if (after_prev)
+        {
+            break;
+        }
+        tx_queue_[pos] = tx_queue_[pos - 1];
+        pos--;
+    }
+
+    TxItem& txi = tx_queue_[pos];
+    txi = item;
+    txi.pending = true;
+    txi.requeue_on_abort = false;
+
+    tx_queue_len_++;
+    tx_queue_high_water_mark_ = uavcan::max(tx_queue_high_water_mark_, tx_queue_len_);     // Statistics
+}
+
+void CanIface::refillTxMailboxes()
+{
+    /*
+     * The hardware transmits the mailboxes in the order of priority; the mailboxes of equal priority are transmitted
+     * in the order of their indexes rather than in the order they were loaded. Hence, a frame is not loaded while
+     * another frame with the same CAN ID occupies a mailbox; the frames of lower priority have to wait as well,
+     * so that the order of the queue is preserved.
+     */
+    while (tx_queue_len_ > 0)
+    {
+        const TxItem& top = tx_queue_[0];
+        const int txmailbox = findFreeTxMailbox();
+        if ((txmailbox < 0) || hasTxMailboxWithId(top.frame.id))
+        {
+            break;
+        }
+        loadTxMailbox(uavcan::uint8_t(txmailbox), top);
+
+        tx_queue_len_--;
+        for (unsigned i = 0; i < tx_queue_len_; i++)
+        {
+            tx_queue_[i] = tx_queue_[i + 1];
+        }
+    }
 }
 
 uavcan::int16_t CanIface::receive(uavcan::CanFrame& out_frame, uavcan::MonotonicTime& out_ts_monotonic,
@@ -435,26 +669,166 @@ uavcan::int16_t CanIface::receive(uavcan::CanFrame& out_frame, uavcan::Monotonic
 {
     out_ts_monotonic = clock::getMonotonic();  // High precision is not required for monotonic timestamps
     uavcan::uint64_t utc_usec = 0;
+    if (!rx_queue_.pop(out_frame, utc_usec, out_flags))     // Lock-free
     {
-        CriticalSectionLocker lock;
-        if (rx_queue_.getLength() == 0)
-        {
-            return 0;
-        }
-        rx_queue_.pop(out_frame, utc_usec, out_flags);
+        return 0;
     }
     out_ts_utc = uavcan::UtcTime::fromUSec(utc_usec);
     return 1;
 }
 
+uavcan::int16_t CanIface::receiveBatch(uavcan::CanRxFrame* out_frames, uavcan::CanIOFlags* out_flags,
+                                       uavcan::uint16_t max_frames)
+{
+    if ((out_frames == NULL) || (out_flags == NULL))
+    {
+        UAVCAN_ASSERT(0);
+        return -uavcan::ErrInvalidParam;
+    }
+    // One monotonic timestamp for the whole batch; high precision is not required for monotonic timestamps
+    return uavcan::int16_t(rx_queue_.popBatch(out_frames, out_flags, max_frames, clock::getMonotonic()));
+}
+
+int CanIface::computeFilterBankImage(const uavcan::CanFilterConfig* filter_configs, uavcan::uint16_t num_configs,
+                                     bool split_fifos, FilterBankImage& out_image)
+{
+    out_image = FilterBankImage();
+
+    if (num_configs == 0)
+    {
+        out_image.fr1[0] = 0;                           // One 32-bit mask bank that accepts everything
+        out_image.fr2[0] = 0;
+        out_image.scale_32_banks = 1;
+        out_image.num_banks = 1;
+        return 0;
+    }
+    if (filter_configs == NULL)
+    {
+        UAVCAN_ASSERT(0);
+        return -uavcan::ErrInvalidParam;
+    }
+
+    uavcan::uint64_t banks[NumFilters];
+    uavcan::uint8_t bank_kinds[NumFilters];
+    uavcan::uint8_t bank_num_entries[NumFilters];
+    int open_banks[2][NumFilterEntryKinds];             // Partially filled bank per FIFO and kind, or negative
+    for (unsigned i = 0; i < NumFilterEntryKinds; i++)
+    {
+        open_banks[0][i] = -1;
+        open_banks[1][i] = -1;
+    }
+
+    for (unsigned i = 0; i < num_configs; i++)
+    {
+        uavcan::uint64_t entry = 0;
+        const FilterEntryKind kind = makeFilterEntry(filter_configs[i], entry);
+        const unsigned fifo = (split_fifos && isInHigherPriorityHalf(filter_configs, num_configs, i)) ? 1 : 0;
+
+        int& bank = open_banks[fifo][kind];
+        if ((bank < 0) || (bank_num_entries[bank] >= FilterEntriesPerBank[kind]))
+        {
+            if (out_image.num_banks >= NumFilters)
+            {
+                return -ErrFilterNumConfigs;
+            }
+            bank = out_image.num_banks++;
+            banks[bank] = 0;
+            bank_kinds[bank] = uavcan::uint8_t(kind);
+            bank_num_entries[bank] = 0;
+
+            const uavcan::uint32_t bit = 1U << bank;
+            if ((kind == FilterEntryStdList) || (kind == FilterEntryExtList))
+            {
+                out_image.list_mode_banks |= bit;
+            }
+            if ((kind == FilterEntryExtList) || (kind == FilterEntryExtMask))
+            {
+                out_image.scale_32_banks |= bit;
+            }
+            if (fifo != 0)
+            {
+                out_image.fifo1_banks |= bit;
+            }
+        }
+
+        const unsigned entry_width = 64U / FilterEntriesPerBank[kind];
+        banks[bank] |= entry << (entry_width * bank_num_entries[bank]);
+        bank_num_entries[bank]++;
+    }
+
+    for (unsigned i = 0; i < out_image.num_banks; i++)
+    {
+        // The unused entries of a bank repeat its first entry, so that they don't accept anything extra
+        const unsigned entries_per_bank = FilterEntriesPerBank[bank_kinds[i]];
+        const unsigned entry_width = 64U / entries_per_bank;
+        for (unsigned k = bank_num_entries[i]; k < entries_per_bank; k++)
+        {
+            const uavcan::uint64_t first_entry = banks[i] & ((uavcan::uint64_t(1) << entry_width) - 1U);
+            banks[i] |= first_entry << (entry_width * k);
+        }
+        out_image.fr1[i] = uavcan::uint32_t(banks[i]);
+        out_image.fr2[i] = uavcan::uint32_t(banks[i] >> 32);
+    }
+    return 0;
+}
+
 uavcan::int16_t CanIface::configureFilters(const uavcan::CanFilterConfig* filter_configs,
                                            uavcan::uint16_t num_configs)
 {
-    // TODO: Hardware filter support
+    /*
+     * The higher priority half of the configs is served by FIFO1, so that the high priority frames are not lost
+     * to the overruns of FIFO0 under high bus load; this takes more banks, so it's done only if they suffice.
+     */
+    FilterBankImage image;
+    int res = computeFilterBankImage(filter_configs, num_configs, true, image);
+    if (res < 0)
+    {
+        res = computeFilterBankImage(filter_configs, num_configs, false, image);
+    }
+    if (res < 0)
+    {
+        return uavcan::int16_t(res);
+    }
+    UAVCAN_STM32_LOG("Iface %d: %u filter configs in %u banks", int(self_index_),
+                     unsigned(num_configs), unsigned(image.num_banks));
+
+    /*
+     * The filter banks of all ifaces are in CAN1; the banks of this iface are never touched by the other one
+     */
+    const unsigned first_bank = unsigned(self_index_) * NumFilters;
+    const uavcan::uint32_t own_banks = ((1U << NumFilters) - 1U) << first_bank;
+    bxcan::CanType* const can1 = bxcan::Can[0];
+
     CriticalSectionLocker lock;
-    (void)filter_configs;
-    (void)num_configs;
-    return -ErrNotImplemented;
+
+    can1->FMR |= bxcan::FMR_FINIT;
+    can1->FA1R &= ~own_banks;                               // Banks can be modified only when deactivated
+
+    for (unsigned i = 0; i < image.num_banks; i++)
+    {
+        can1->FilterRegister[first_bank + i].FR1 = image.fr1[i];
+        can1->FilterRegister[first_bank + i].FR2 = image.fr2[i];
+    }
+    can1->FM1R  = (can1->FM1R  & ~own_banks) | (image.list_mode_banks << first_bank);
+    can1->FS1R  = (can1->FS1R  & ~own_banks) | (image.scale_32_banks << first_bank);
+    can1->FFA1R = (can1->FFA1R & ~own_banks) | (image.fifo1_banks << first_bank);
+    can1->FA1R |= ((1U << image.num_banks) - 1U) << first_bank;
+
+    can1->FMR &= ~bxcan::FMR_FINIT;
+
+    return 0;
+}
+
+uavcan::uint16_t CanIface::getNumFiltersRequired(const uavcan::CanFilterConfig* filter_configs,
+                                                 uavcan::uint16_t num_configs) const
+{
+    // The FIFO split is dropped if the banks don't suffice, see configureFilters()
+    FilterBankImage image;
+    if (computeFilterBankImage(filter_configs, num_configs, false, image) < 0)
+    {
+        return num_configs;         // One bank per config at most, so this exceeds the number of banks
+    }
+    return image.num_banks;
 }
 
 bool CanIface::waitMsrINakBitStateChange(bool target_state)
@@ -511,7 +885,10 @@ int CanIface::init(const uavcan::uint32_t bitrate, const OperatingMode mode)
     rx_queue_.reset();
     error_cnt_ = 0;
     served_aborts_cnt_ = 0;
+    tx_preemption_cnt_ = 0;
     uavcan::fill_n(pending_tx_, NumTxMailboxes, TxItem());
+    tx_queue_len_ = 0;
+    tx_queue_high_water_mark_ = 0;
     peak_tx_mailbox_index_ = 0;
     had_activity_ = false;
 
@@ -598,7 +975,19 @@ void CanIface::handleTxMailboxInterrupt(uavcan::uint8_t mailbox_index, bool txok
         rx_queue_.push(txi.frame, utc_usec, uavcan::CanIOFlagLoopback);
     }
 
+    if (!txok && txi.pending && txi.requeue_on_abort)
+    {
+        txi.requeue_on_abort = false;           // Releases the reserved slot, see computeNumFreeTxQueueSlots()
+        UAVCAN_ASSERT(tx_queue_len_ < TxQueueCapacity);
+        if (tx_queue_len_ < TxQueueCapacity)
+        {
+            pushTxQueue(txi, true);
+            tx_preemption_cnt_++;
+        }
+    }
+
     txi.pending = false;
+    txi.requeue_on_abort = false;
 }
 
 void CanIface::handleTxInterrupt(const uavcan::uint64_t utc_usec)
@@ -622,6 +1011,9 @@ void CanIface::handleTxInterrupt(const uavcan::uint64_t utc_usec)
         can_->TSR = bxcan::TSR_RQCP2;
         handleTxMailboxInterrupt(2, txok, utc_usec);
     }
+
+    refillTxMailboxes();                // Back-to-back transmission, no matter when the library spins next
+
     update_event_.signalFromInterrupt();
 
     pollErrorFlagsFromISR();
@@ -651,43 +1043,50 @@ void CanIface::handleRxInterrupt(uavcan::uint8_t fifo_index, uavcan::uint64_t ut
     }
 
     /*
-     * Read the frame contents
+     * Decode the frame directly into the RX queue slot; if the queue is full, the frame is dropped
      */
-    uavcan::CanFrame frame;
-    const bxcan::RxMailboxType& rf = can_->RxMailbox[fifo_index];
-
-    if ((rf.RIR & bxcan::RIR_IDE) == 0)
-    {
-        frame.id = uavcan::CanFrame::MaskStdID & (rf.RIR >> 21);
-    }
-    else
+    CanRxItem* const item = rx_queue_.beginPush();
+    if (item != NULL)
     {
-        frame.id = uavcan::CanFrame::MaskExtID & (rf.RIR >> 3);
-        frame.id |= uavcan::CanFrame::FlagEFF;
-    }
+        const bxcan::RxMailboxType& rf = can_->RxMailbox[fifo_index];
+        uavcan::CanFrame& frame = item->frame;
 
-    if ((rf.RIR & bxcan::RIR_RTR) != 0)
-    {
-        frame.id |= uavcan::CanFrame::FlagRTR;
-    }
+        if ((rf.RIR & bxcan::RIR_IDE) == 0)
+        {
+            frame.id = uavcan::CanFrame::MaskStdID & (rf.RIR >> 21);
+        }
+        else
+        {
+            frame.id = uavcan::CanFrame::MaskExtID & (rf.RIR >> 3);
+            frame.id |= uavcan::CanFrame::FlagEFF;
+        }
 
-    frame.dlc = rf.RDTR & 15;
+        if ((rf.RIR & bxcan::RIR_RTR) != 0)
+        {
+            frame.id |= uavcan::CanFrame::FlagRTR;
+        }
 
-    frame.data[0] = uavcan::uint8_t(0xFF & (rf.RDLR >> 0));
-    frame.data[1] = uavcan::uint8_t(0xFF & (rf.RDLR >> 8));
-    frame.data[2] = uavcan::uint8_t(0xFF & (rf.RDLR >> 16));
-    frame.data[3] = uavcan::uint8_t(0xFF & (rf.RDLR >> 24));
-    frame.data[4] = uavcan::uint8_t(0xFF & (rf.RDHR >> 0));
-    frame.data[5] = uavcan::uint8_t(0xFF & (rf.RDHR >> 8));
-    frame.data[6] = uavcan::uint8_t(0xFF & (rf.RDHR >> 16));
-    frame.data[7] = uavcan::uint8_t(0xFF & (rf.RDHR >> 24));
+        frame.dlc = rf.RDTR & 15;
+
+        frame.data[0] = uavcan::uint8_t(0xFF & (rf.RDLR >> 0));
+        frame.data[1] = uavcan::uint8_t(0xFF & (rf.RDLR >> 8));
+        frame.data[2] = uavcan::uint8_t(0xFF & (rf.RDLR >> 16));
+        frame.data[3] = uavcan::uint8_t(0xFF & (rf.RDLR >> 24));
+        frame.data[4] = uavcan::uint8_t(0xFF & (rf.RDHR >> 0));
+        frame.data[5] = uavcan::uint8_t(0xFF & (rf.RDHR >> 8));
+        frame.data[6] = uavcan::uint8_t(0xFF & (rf.RDHR >> 16));
+        frame.data[7] = uavcan::uint8_t(0xFF & (rf.RDHR >> 24));
+
+        item->utc_usec = utc_usec;
+        item->flags    = 0;
+    }
 
     *rfr_reg = bxcan::RFR_RFOM | bxcan::RFR_FOVR | bxcan::RFR_FULL;  // Release FIFO entry we just read
 
-    /*
-     * Store with timeout into the FIFO buffer and signal update event
-     */
-    rx_queue_.push(frame, utc_usec, 0);
+    if (item != NULL)
+    {
+        rx_queue_.commitPush();
+    }
     had_activity_ = true;
     update_event_.signalFromInterrupt();
 
@@ -733,49 +1132,80 @@ void CanIface::discardTimedOutTxMailboxes(uavcan::MonotonicTime current_time)
             error_cnt_++;
         }
     }
-}
 
-bool CanIface::canAcceptNewTxFrame(const uavcan::CanFrame& frame) const
-{
-    /*
-     * We can accept more frames only if the following conditions are satisfied:
-     *  - There is at least one TX mailbox free (obvious enough);
-     *  - The priority of the new frame is higher than priority of all TX mailboxes.
-     */
+    unsigned num_kept = 0;
+    for (unsigned i = 0; i < tx_queue_len_; i++)
     {
-        static const uavcan::uint32_t TME = bxcan::TSR_TME0 | bxcan::TSR_TME1 | bxcan::TSR_TME2;
-        const uavcan::uint32_t tme = can_->TSR & TME;
-
-        if (tme == TME)     // All TX mailboxes are free (as in freedom).
+        if (tx_queue_[i].deadline < current_time)
         {
-            return true;
+            error_cnt_++;
         }
-
-        if (tme == 0)       // All TX mailboxes are busy transmitting.
+        else
         {
-            return false;
+            if (num_kept != i)
+            {
+                tx_queue_[num_kept] = tx_queue_[i];
+            }
+            num_kept++;
         }
     }
+    tx_queue_len_ = uavcan::uint8_t(num_kept);
+}
+
+void CanIface::serveTxPreemption(const uavcan::CanFrame* pending_tx)
+{
+    CriticalSectionLocker lock;
+
+    refillTxMailboxes();    // Normally done by the TX interrupt; this is needed if the mailboxes were aborted
 
     /*
-     * The second condition requires a critical section.
+     * Aborting the lowest priority mailbox if all of them are occupied by frames of lower priority than the next
+     * frame to transmit, which is either the top of the driver TX queue or the next frame of the library.
+     * Only one abort is requested at a time, and only if there's room to requeue the aborted frame.
      */
-    CriticalSectionLocker lock;
+    const uavcan::CanFrame* top = (tx_queue_len_ > 0) ? &tx_queue_[0].frame : NULL;
+    if ((pending_tx != NULL) && ((top == NULL) || pending_tx->priorityHigherThan(*top)))
+    {
+        top = pending_tx;
+    }
+    if ((top == NULL) || (findFreeTxMailbox() >= 0) || !isHigherThanAllTxMailboxes(*top))
+    {
+        return;
+    }
 
-    for (int mbx = 0; mbx < NumTxMailboxes; mbx++)
+    int lowest = -1;
+    for (int i = 0; i < NumTxMailboxes; i++)
     {
-        if (pending_tx_[mbx].pending && !frame.priorityHigherThan(pending_tx_[mbx].frame))
+        if (pending_tx_[i].pending && pending_tx_[i].requeue_on_abort)
         {
-            return false;       // There's a mailbox whose priority is higher or equal the priority of the new frame.
+            return;             // Abort is already in progress
+        }
+        if (pending_tx_[i].pending &&
+            ((lowest < 0) || pending_tx_[lowest].frame.priorityHigherThan(pending_tx_[i].frame)))
+        {
+            lowest = i;
         }
     }
 
-    return true;                // This new frame will be added to a free TX mailbox in the next @ref send().
+    if ((lowest >= 0) && (computeNumFreeTxQueueSlots() > 0))
+    {
+        pending_tx_[lowest].requeue_on_abort = true;
+        can_->TSR = TSR_ABRQx[lowest];
+    }
+}
+
+bool CanIface::canAcceptNewTxFrame(const uavcan::CanFrame& frame) const
+{
+    /*
+     * The driver TX queue is ordered by priority, so any frame can be accepted as long as there's room;
+     * the priority inversion is taken care of by serveTxPreemption().
+     */
+    (void)frame;
+    return getNumFreeTxSlots() > 0;
 }
 
 bool CanIface::isRxBufferEmpty() const
 {
-    CriticalSectionLocker lock;
     return rx_queue_.getLength() == 0;
 }
 
@@ -787,10 +1217,14 @@ uavcan::uint64_t CanIface::getErrorCount() const
 
 unsigned CanIface::getRxQueueLength() const
 {
-    CriticalSectionLocker lock;
     return rx_queue_.getLength();
 }
 
+unsigned CanIface::getRxQueueHighWaterMark() const
+{
+    return rx_queue_.getHighWaterMark();
+}
+
 bool CanIface::hadActivity()
 {
     CriticalSectionLocker lock;
@@ -851,6 +1285,7 @@ uavcan::int16_t CanDriver::select(uavcan::CanSelectMasks& inout_masks,
     const uavcan::MonotonicTime time = clock::getMonotonic();
 
     if0_.discardTimedOutTxMailboxes(time);              // Check TX timeouts - this may release some TX slots
+    if0_.serveTxPreemption(pending_tx[0]);
     {
         CriticalSectionLocker cs_locker;
         if0_.pollErrorFlagsFromISR();
@@ -858,6 +1293,7 @@ uavcan::int16_t CanDriver::select(uavcan::CanSelectMasks& inout_masks,
 
 #if UAVCAN_STM32_NUM_IFACES > 1
     if1_.discardTimedOutTxMailboxes(time);
+    if1_.serveTxPreemption(pending_tx[1]);
     {
         CriticalSectionLocker cs_locker;
         if1_.pollErrorFlagsFromISR();
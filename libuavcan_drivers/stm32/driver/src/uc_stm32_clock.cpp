@@ -481,3 +481,35 @@ UAVCAN_STM32_IRQ_HANDLER(TIMX_IRQHandler)
 }
 
 #endif
+
+#if defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__)
+
+namespace uavcan_stm32
+{
+namespace
+{
+/*
+ * Architecturally defined for all ARMv7-M cores, hence no dependency on the CMSIS headers of the OS
+ */
+volatile uavcan::uint32_t& DEMCR      = *reinterpret_cast<volatile uavcan::uint32_t*>(0xE000EDFCU);
+volatile uavcan::uint32_t& DWT_CTRL   = *reinterpret_cast<volatile uavcan::uint32_t*>(0xE0001000U);
+volatile uavcan::uint32_t& DWT_CYCCNT = *reinterpret_cast<volatile uavcan::uint32_t*>(0xE0001004U);
+
+const uavcan::uint32_t DEMCR_TRCENA       = 1U << 24;
+const uavcan::uint32_t DWT_CTRL_CYCCNTENA = 1U << 0;
+}
+
+CycleCounter::CycleCounter()
+{
+    DEMCR |= DEMCR_TRCENA;
+    DWT_CTRL |= DWT_CTRL_CYCCNTENA;
+}
+
+uavcan::uint32_t CycleCounter::getCycleCount() const
+{
+    return DWT_CYCCNT;
+}
+
+}
+
+#endif
@@ -11,6 +11,40 @@
 namespace uavcan_stm32
 {
 
+#if UAVCAN_STM32_TICKLESS_IDLE
+namespace
+{
+
+uavcan::uint64_t idle_wakeup_deadline_usec = 0;     ///< Zero if there's no thread blocked in BusEvent::wait()
+
+/**
+ * Publishes the wakeup deadline for the idle hook while the thread is blocked.
+ */
+class IdleWakeupDeadlineSetter
+{
+public:
+    explicit IdleWakeupDeadlineSetter(uavcan::MonotonicTime deadline)
+    {
+        CriticalSectionLocker locker;
+        idle_wakeup_deadline_usec = deadline.toUSec();
+    }
+
+    ~IdleWakeupDeadlineSetter()
+    {
+        CriticalSectionLocker locker;
+        idle_wakeup_deadline_usec = 0;
+    }
+};
+
+}
+
+uavcan::MonotonicTime getIdleWakeupDeadline()
+{
+    CriticalSectionLocker locker;       // 64-bit access is not atomic
+    return uavcan::MonotonicTime::fromUSec(idle_wakeup_deadline_usec);
+}
+#endif
+
 #if UAVCAN_STM32_CHIBIOS
 /*
  * BusEvent
@@ -32,6 +66,9 @@ bool BusEvent::wait(uavcan::MonotonicDuration duration)
     }
     else
     {
+# if UAVCAN_STM32_TICKLESS_IDLE
+        IdleWakeupDeadlineSetter idle_setter(clock::getMonotonic() + duration);
+# endif
 # if (CH_KERNEL_MAJOR == 2)
         ret = sem_.waitTimeout((msec > MaxDelayMSec) ? MS2ST(MaxDelayMSec) : MS2ST(msec));
 # else // ChibiOS 3
@@ -97,6 +134,9 @@ bool BusEvent::wait(uavcan::MonotonicDuration duration)
     }
     else
     {
+# if UAVCAN_STM32_TICKLESS_IDLE
+        IdleWakeupDeadlineSetter idle_setter(clock::getMonotonic() + duration);
+# endif
         ret = xSemaphoreTake( sem_, (msec > MaxDelayMSec) ? (MaxDelayMSec/portTICK_RATE_MS) : (msec/portTICK_RATE_MS));
     }
     return ret == pdTRUE;
@@ -231,6 +271,9 @@ BusEvent::BusEvent(CanDriver& can_driver)
     file_ops_.open  = &BusEvent::openTrampoline;
     file_ops_.close = &BusEvent::closeTrampoline;
     file_ops_.poll  = &BusEvent::pollTrampoline;
+# if UAVCAN_STM32_TICKLESS_IDLE
+    (void)::sem_init(&sem_, 0, 0);
+# endif
     // TODO: move to init(), add proper error handling
     if (register_driver(DevName, &file_ops_, 0666, static_cast<void*>(this)) != 0)
     {
@@ -241,10 +284,41 @@ BusEvent::BusEvent(CanDriver& can_driver)
 BusEvent::~BusEvent()
 {
     (void)unregister_driver(DevName);
+# if UAVCAN_STM32_TICKLESS_IDLE
+    (void)::sem_destroy(&sem_);
+# endif
 }
 
 bool BusEvent::wait(uavcan::MonotonicDuration duration)
 {
+# if UAVCAN_STM32_TICKLESS_IDLE
+    if (duration.isPositive())
+    {
+        IdleWakeupDeadlineSetter idle_setter(clock::getMonotonic() + duration);
+
+        ::timespec abstime = ::timespec();
+        if (::clock_gettime(CLOCK_REALTIME, &abstime) == 0)
+        {
+            const uavcan::uint64_t nsec = uavcan::uint64_t(abstime.tv_nsec) +
+                                          uavcan::uint64_t(duration.toUSec()) * 1000U;
+            abstime.tv_sec += time_t(nsec / 1000000000U);
+            abstime.tv_nsec = long(nsec % 1000000000U);
+            while ((::sem_timedwait(&sem_, &abstime) < 0) && (errno == EINTR))
+            {
+                ;
+            }
+        }
+    }
+    else
+    {
+        (void)::sem_trywait(&sem_);
+    }
+
+    CriticalSectionLocker locker;
+    const bool ret = signal_;
+    signal_ = false;
+    return ret;
+# else
     // TODO blocking wait
     const uavcan::MonotonicTime deadline = clock::getMonotonic() + duration;
     while (clock::getMonotonic() < deadline)
@@ -260,11 +334,18 @@ bool BusEvent::wait(uavcan::MonotonicDuration duration)
         ::usleep(1000);
     }
     return false;
+# endif
 }
 
 void BusEvent::signalFromInterrupt()
 {
     signal_ = true;  // HACK
+# if UAVCAN_STM32_TICKLESS_IDLE
+    if (sem_.semcount <= 0)
+    {
+        (void)sem_post(&sem_);
+    }
+# endif
     for (unsigned i = 0; i < MaxPollWaiters; i++)
     {
         ::pollfd* const fd = pollset_[i];
@@ -279,6 +360,29 @@ void BusEvent::signalFromInterrupt()
     }
 }
 
+#elif UAVCAN_STM32_BAREMETAL && UAVCAN_STM32_TICKLESS_IDLE
+
+bool BusEvent::wait(uavcan::MonotonicDuration duration)
+{
+    if (duration.isPositive())
+    {
+        const uavcan::MonotonicTime deadline = clock::getMonotonic() + duration;
+        IdleWakeupDeadlineSetter idle_setter(deadline);
+
+        while (clock::getMonotonic() < deadline)
+        {
+            // The event must not be signalled between the check and the sleep, otherwise it would be missed
+            CriticalSectionLocker locker;
+            if (ready)
+            {
+                break;
+            }
+            UAVCAN_STM32_BAREMETAL_IDLE();  // Pending interrupts wake up the core even if they are masked
+        }
+    }
+    return __atomic_exchange_n(&ready, false, __ATOMIC_SEQ_CST);
+}
+
 #endif
 
 }
@@ -0,0 +1,357 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <algorithm>
+#include <unistd.h>
+#include <zubax_chibios/sys/sys.h>
+#include <uavcan_stm32/uavcan_stm32.hpp>
+#include <uavcan/protocol/debug/KeyValue.hpp>
+#include "board/board.hpp"
+
+/*
+ * Latency and throughput benchmark, an alternative main file of this project:
+ *   make MAIN=benchmark.cpp BENCHMARK_NODE_ID=10 BENCHMARK_INITIATOR=1
+ *
+ * One node of the bus is the initiator, the others are responders; any of them can be either a board running
+ * this firmware or a Linux host running test_latency_benchmark from the Linux driver, which implements the same
+ * protocol. The initiator broadcasts uavcan.protocol.debug.KeyValue pings:
+ *   key[0] - 'P' for pings, 'R' for replies
+ *   key[1] - node ID of the initiator
+ *   key[2...] - padding up to the transfer length under test
+ *   value - sequence number, modulo 2^24
+ * A responder echoes every ping back with key[0] replaced. The round trip time is measured by the initiator alone,
+ * from the moment of publication to the hardware RX timestamp of the reply, so no time sync is required.
+ *
+ * For the single-frame and the multi-frame transfers, the initiator reports:
+ *  - min/p50/p99/max round trip time of sequential pings, one at a time;
+ *  - the highest rate of completed pings, with up to N pings in flight, at which no replies were lost.
+ * The results are printed into the serial console after every run.
+ */
+namespace app
+{
+namespace
+{
+
+#ifndef BENCHMARK_NODE_ID
+# define BENCHMARK_NODE_ID 10
+#endif
+#ifndef BENCHMARK_INITIATOR
+# define BENCHMARK_INITIATOR 0
+#endif
+#ifndef BENCHMARK_CAN_BITRATE
+# define BENCHMARK_CAN_BITRATE 1000000
+#endif
+
+using uavcan::protocol::debug::KeyValue;
+
+constexpr std::uint8_t KeyPing = 'P';
+constexpr std::uint8_t KeyReply = 'R';
+constexpr unsigned ValueModulo = 1U << 24;                 // Integers are exact in float32 up to this value
+
+constexpr unsigned SingleFrameKeyLen = 2;                   // 4 bytes of the value + 2 bytes of the key
+constexpr unsigned MultiFrameKeyLen = KeyValue::FieldTypes::key::MaxSize;
+
+constexpr unsigned NumLatencySamples = 1000;
+constexpr unsigned MaxWindow = 16;
+constexpr unsigned ThroughputTestDurationMSec = 3000;
+constexpr unsigned ReplyTimeoutMSec = 100;
+
+uavcan_stm32::CanInitHelper<128> can;
+
+constexpr unsigned NodePoolSize = 16384;
+
+uavcan::Node<NodePoolSize>& getNode()
+{
+    static uavcan::Node<NodePoolSize> node(can.driver, uavcan_stm32::SystemClock::instance());
+    return node;
+}
+
+void init()
+{
+    board::init();
+
+    // Fixed bit rate, because the auto detection needs traffic, and the bench may have none before the start
+    int res = 0;
+    do
+    {
+        ::sleep(1);
+        res = can.init(BENCHMARK_CAN_BITRATE);
+    }
+    while (res < 0);
+    ::lowsyslog("CAN inited at %u bps\n", unsigned(BENCHMARK_CAN_BITRATE));
+}
+
+class Benchmark
+{
+    typedef uavcan::MethodBinder<Benchmark*, void (Benchmark::*)(const uavcan::ReceivedDataStructure<KeyValue>&)>
+        Callback;
+
+    struct PendingPing
+    {
+        uavcan::MonotonicTime sent_at;
+        std::uint32_t seq = 0;
+        bool active = false;
+    };
+
+    uavcan::Publisher<KeyValue> pub_;
+    uavcan::Subscriber<KeyValue, Callback> sub_;
+
+    PendingPing pending_[MaxWindow];
+    std::uint32_t next_seq_ = 0;
+    unsigned num_pending_ = 0;
+    unsigned num_completed_ = 0;
+    unsigned num_lost_ = 0;
+
+    std::uint32_t rtt_samples_[NumLatencySamples] = {};
+    unsigned num_rtt_samples_ = 0;
+
+    void handleKeyValue(const uavcan::ReceivedDataStructure<KeyValue>& msg)
+    {
+        if (msg.key.size() < SingleFrameKeyLen)
+        {
+            return;
+        }
+        if (msg.key[0] == KeyPing)
+        {
+            KeyValue reply = msg;
+            reply.key[0] = KeyReply;
+            (void)pub_.broadcast(reply);
+        }
+        else if ((msg.key[0] == KeyReply) && (msg.key[1] == getNode().getNodeID().get()))
+        {
+            const std::uint32_t seq = std::uint32_t(msg.value);
+            PendingPing& p = pending_[seq % MaxWindow];
+            if (p.active && (p.seq == seq))
+            {
+                p.active = false;
+                num_pending_--;
+                num_completed_++;
+                if (num_rtt_samples_ < NumLatencySamples)
+                {
+                    const uavcan::MonotonicDuration rtt = msg.getMonotonicTimestamp() - p.sent_at;
+                    rtt_samples_[num_rtt_samples_++] = std::uint32_t(rtt.toUSec());
+                }
+            }
+        }
+    }
+
+    bool sendPing(unsigned key_len)
+    {
+        PendingPing& p = pending_[next_seq_ % MaxWindow];
+        if (p.active)
+        {
+            return false;
+        }
+
+        KeyValue msg;
+        msg.value = float(next_seq_);
+        msg.key.push_back(KeyPing);
+        msg.key.push_back(getNode().getNodeID().get());
+        while (msg.key.size() < key_len)
+        {
+            msg.key.push_back('x');
+        }
+
+        p.sent_at = getNode().getMonotonicTime();
+        if (pub_.broadcast(msg) < 0)
+        {
+            return false;                               // TX queue is full, will retry
+        }
+        p.seq = next_seq_;
+        p.active = true;
+        num_pending_++;
+        next_seq_ = (next_seq_ + 1U) % ValueModulo;
+        return true;
+    }
+
+    void expirePendingPings(bool all)
+    {
+        const uavcan::MonotonicTime deadline =
+            getNode().getMonotonicTime() - uavcan::MonotonicDuration::fromMSec(ReplyTimeoutMSec);
+        for (PendingPing& p : pending_)
+        {
+            if (p.active && (all || (p.sent_at < deadline)))
+            {
+                p.active = false;
+                num_pending_--;
+                num_lost_++;
+            }
+        }
+    }
+
+    void spinFor(uavcan::MonotonicDuration duration)
+    {
+        const uavcan::MonotonicTime deadline = getNode().getMonotonicTime() + duration;
+        while (getNode().getMonotonicTime() < deadline)
+        {
+            (void)getNode().spinOnce();
+        }
+    }
+
+    void resetCounters()
+    {
+        expirePendingPings(true);
+        num_completed_ = 0;
+        num_lost_ = 0;
+        num_rtt_samples_ = 0;
+    }
+
+    void runLatencyTest(const char* name, unsigned key_len)
+    {
+        resetCounters();
+        for (unsigned i = 0; i < NumLatencySamples; i++)
+        {
+            while (!sendPing(key_len))
+            {
+                (void)getNode().spinOnce();
+            }
+            const uavcan::MonotonicTime deadline =
+                getNode().getMonotonicTime() + uavcan::MonotonicDuration::fromMSec(ReplyTimeoutMSec);
+            while ((num_pending_ > 0) && (getNode().getMonotonicTime() < deadline))
+            {
+                (void)getNode().spinOnce();
+            }
+            expirePendingPings(true);
+        }
+
+        if (num_rtt_samples_ == 0)
+        {
+            ::lowsyslog("%s RTT: no replies\n", name);
+            return;
+        }
+        std::sort(rtt_samples_, rtt_samples_ + num_rtt_samples_);
+        ::lowsyslog("%s RTT usec: min=%u p50=%u p99=%u max=%u lost=%u\n", name,
+                    unsigned(rtt_samples_[0]),
+                    unsigned(rtt_samples_[num_rtt_samples_ / 2]),
+                    unsigned(rtt_samples_[(num_rtt_samples_ * 99U) / 100U]),
+                    unsigned(rtt_samples_[num_rtt_samples_ - 1U]),
+                    num_lost_);
+    }
+
+    void runThroughputTest(const char* name, unsigned key_len)
+    {
+        unsigned best_rate = 0;
+        unsigned best_window = 0;
+        for (unsigned window = 1; window <= MaxWindow; window *= 2)
+        {
+            resetCounters();
+            const uavcan::MonotonicTime started_at = getNode().getMonotonicTime();
+            const uavcan::MonotonicTime deadline =
+                started_at + uavcan::MonotonicDuration::fromMSec(ThroughputTestDurationMSec);
+            while (getNode().getMonotonicTime() < deadline)
+            {
+                while ((num_pending_ < window) && sendPing(key_len))
+                {
+                    ;
+                }
+                (void)getNode().spinOnce();
+                expirePendingPings(false);
+            }
+            const unsigned completed = num_completed_;
+            spinFor(uavcan::MonotonicDuration::fromMSec(ReplyTimeoutMSec));     // Late replies are not lost
+            expirePendingPings(true);
+
+            const unsigned rate = unsigned((std::uint64_t(completed) * 1000U) / ThroughputTestDurationMSec);
+            ::lowsyslog("%s window=%u: %u transfers/s, lost=%u\n", name, window, rate, num_lost_);
+            if ((num_lost_ == 0) && (rate > best_rate))
+            {
+                best_rate = rate;
+                best_window = window;
+            }
+        }
+        ::lowsyslog("%s max sustainable: %u transfers/s (window %u)\n", name, best_rate, best_window);
+    }
+
+public:
+    Benchmark()
+        : pub_(getNode())
+        , sub_(getNode())
+    { }
+
+    int start()
+    {
+        pub_.setTxTimeout(uavcan::MonotonicDuration::fromMSec(ReplyTimeoutMSec));
+        return sub_.start(Callback(this, &Benchmark::handleKeyValue));
+    }
+
+    void runInitiator()
+    {
+        spinFor(uavcan::MonotonicDuration::fromMSec(3000));     // Let the responders start up
+        while (true)
+        {
+            runLatencyTest("Single-frame", SingleFrameKeyLen);
+            runLatencyTest("Multi-frame", MultiFrameKeyLen);
+            runThroughputTest("Single-frame", SingleFrameKeyLen);
+            runThroughputTest("Multi-frame", MultiFrameKeyLen);
+            ::lowsyslog("Memory usage: used=%u worst=%u\n",
+                        getNode().getAllocator().getNumUsedBlocks(),
+                        getNode().getAllocator().getPeakNumUsedBlocks());
+        }
+    }
+
+    void runResponder()
+    {
+        while (true)
+        {
+            const int spin_res = getNode().spin(uavcan::MonotonicDuration::fromMSec(1000));
+            if (spin_res < 0)
+            {
+                ::lowsyslog("Spin failure: %i\n", spin_res);
+            }
+        }
+    }
+};
+
+class : public chibios_rt::BaseStaticThread<8192>
+{
+public:
+    msg_t main()
+    {
+        getNode().setName("org.uavcan.stm32_test_stm32f107_benchmark");
+        getNode().setNodeID(BENCHMARK_NODE_ID);
+
+        const int node_init_res = getNode().start();
+        if (node_init_res < 0)
+        {
+            board::die(node_init_res);
+        }
+
+        static Benchmark benchmark;
+        const int benchmark_init_res = benchmark.start();
+        if (benchmark_init_res < 0)
+        {
+            board::die(benchmark_init_res);
+        }
+
+        getNode().setModeOperational();
+        ::lowsyslog("Benchmark node %d started as %s\n", int(BENCHMARK_NODE_ID),
+                    BENCHMARK_INITIATOR ? "initiator" : "responder");
+        if (BENCHMARK_INITIATOR)
+        {
+            benchmark.runInitiator();
+        }
+        else
+        {
+            benchmark.runResponder();
+        }
+        return msg_t();
+    }
+} uavcan_node_thread;
+
+}
+}
+
+int main()
+{
+    app::init();
+
+    // High priority, so that the measurements are not affected by the other threads
+    app::uavcan_node_thread.start(HIGHPRIO);
+
+    while (true)
+    {
+        board::setLed(app::can.driver.hadActivity());
+        ::usleep(25000);
+    }
+}